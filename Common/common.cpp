@@ -1,7 +1,7 @@
 #include "common.h"
-#ifndef _WIN32
+#if defined(__ANDROID__)
 #include <android/log.h>
-#else
+#elif defined(_WIN32)
 #include "LogToFile.h"
 #endif
 
@@ -49,8 +49,10 @@ void msglog(BYTE type, const char* msg, ...) {
 	char* curstrtime = ctime(&timenow);
 	curstrtime[strlen(curstrtime) - 1] = '\0';
 
-#ifndef _WIN32
+#if defined(__ANDROID__)
 	__android_log_print(ANDROID_LOG_DEBUG, "TONGITS", "%s%s",curstrtime, szBuffer);
+#elif !defined(_WIN32)
+	std::cout << curstrtime << szBuffer << std::endl;
 #else
 	std::cout << curstrtime << szBuffer << std::endl;
 	tongitslog.Output(szBuffer);
@@ -125,6 +125,15 @@ enum eREQTYPE
 {
 	CREATE_TUNNEL = 0xA1,
 	KEEP_ALIVE = 0xA2,
+	STREAM_OPEN = 0xA3,
+	STREAM_DATA = 0xA4,
+	STREAM_FIN = 0xA5,
+	STREAM_RST = 0xA6,
+	STREAM_WINDOW = 0xA7,
+	STREAM_ZDATA = 0xA8,
+	LINK_PING = 0xA9,
+	LINK_PONG = 0xAA,
+	STREAM_RESUME = 0xAB,
 };
 
 struct _PckCmd
@@ -135,6 +144,41 @@ struct _PckCmd
 	WORD data;
 };
 
+#define MUX_HEAD 0xC3
+#define MUX_MAX_PAYLOAD 16384
+
+// frame header of a multiplexed tunnel link, fields are in network byte order and len bytes of payload follow
+#pragma pack(push, 1)
+struct _MuxHdr
+{
+	BYTE head;
+	BYTE cmd;
+	DWORD stream;
+	WORD len;
+};
+
+// KEEP_ALIVE payload, each side sends its own clock and echoes the last stamp it read with how long it
+// held it, so both measure the round trip on their own clock. a stamp is only compared by its sender
+struct _LinkKeepAlive
+{
+	unsigned long long stamp;
+	unsigned long long echo;	// 0 when nothing arrived since the last one
+	DWORD held;	// usec
+};
+
+// STREAM_OPEN payload of a TCP stream, the addresses the client connected from and to on the listen
+// side, so the connect side can hand them to the local server. an older peer sends none
+struct _MuxOpen
+{
+	BYTE type;	// 0, MUX_OPEN_UDP streams send the type byte alone
+	BYTE family;	// 4 or 6, 0 when the client address isn't known
+	WORD srcport;
+	WORD dstport;
+	BYTE src[16];	// the first 4 bytes for IPv4
+	BYTE dst[16];
+};
+#pragma pack(pop)
+
 enum class _CARD_TYPE
 {
 	_CLUBS = 1,
@@ -0,0 +1,251 @@
+#include "confcache.h"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CONFCACHE_MAGIC "YCCI"
+#define CONFCACHE_HEADER 40	// magic, 32 bit format and the four 64 bit fields
+#define CONFCACHE_MAX_DEPTH 64	// deeper than any conf, a damaged image ends there instead of the stack
+
+enum class _CONF_NODE : unsigned char
+{
+	_NULL = 0,
+	_SCALAR,
+	_SEQUENCE,
+	_MAP,
+};
+
+static uint64_t confhash(const unsigned char* data, size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t n = 0; n < len; n++) {
+		hash ^= data[n];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static void confput(std::string& out, uint64_t v, int bytes)
+{
+	for (int n = 0; n < bytes; n++)
+		out.push_back((char)(v >> (n * 8)));
+}
+
+static uint64_t confget(const unsigned char* p, int bytes)
+{
+	uint64_t v = 0;
+	for (int n = 0; n < bytes; n++)
+		v |= (uint64_t)p[n] << (n * 8);
+	return v;
+}
+
+static void confputvarint(std::string& out, uint64_t v)
+{
+	while (v >= 0x80) {
+		out.push_back((char)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((char)v);
+}
+
+// a view of the body with its read position, every read is bounds checked
+struct _CONF_READER
+{
+	const unsigned char* p;
+	const unsigned char* end;
+
+	bool varint(uint64_t& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 64 && p < end; shift += 7) {
+			unsigned char b = *p++;
+			v |= (uint64_t)(b & 0x7F) << shift;
+			if ((b & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+};
+
+static void confencode(std::string& out, const YAML::Node& node)
+{
+	switch (node.Type()) {
+	case YAML::NodeType::Scalar:
+		out.push_back((char)_CONF_NODE::_SCALAR);
+		confputvarint(out, node.Scalar().size());
+		out += node.Scalar();
+		break;
+	case YAML::NodeType::Sequence:
+		out.push_back((char)_CONF_NODE::_SEQUENCE);
+		confputvarint(out, node.size());
+		for (YAML::const_iterator iter = node.begin(); iter != node.end(); iter++)
+			confencode(out, *iter);
+		break;
+	case YAML::NodeType::Map:
+		out.push_back((char)_CONF_NODE::_MAP);
+		confputvarint(out, node.size());
+		for (YAML::const_iterator iter = node.begin(); iter != node.end(); iter++) {
+			confencode(out, iter->first);
+			confencode(out, iter->second);
+		}
+		break;
+	default:
+		out.push_back((char)_CONF_NODE::_NULL);
+		break;
+	}
+}
+
+static bool confdecode(_CONF_READER& reader, YAML::Node& node, int depth)
+{
+	uint64_t count;
+
+	if (reader.p >= reader.end || depth > CONFCACHE_MAX_DEPTH)
+		return false;
+
+	switch ((_CONF_NODE)*reader.p++) {
+	case _CONF_NODE::_NULL:
+		node = YAML::Node(YAML::NodeType::Null);
+		return true;
+	case _CONF_NODE::_SCALAR:
+		if (!reader.varint(count) || count > (uint64_t)(reader.end - reader.p))
+			return false;
+		node = YAML::Node(std::string((const char*)reader.p, (size_t)count));
+		reader.p += count;
+		return true;
+	case _CONF_NODE::_SEQUENCE:
+		if (!reader.varint(count) || count > (uint64_t)(reader.end - reader.p))
+			return false;
+		node = YAML::Node(YAML::NodeType::Sequence);
+		for (uint64_t n = 0; n < count; n++) {
+			YAML::Node item;
+			if (!confdecode(reader, item, depth + 1))
+				return false;
+			node.push_back(item);
+		}
+		return true;
+	case _CONF_NODE::_MAP:
+		if (!reader.varint(count) || count > (uint64_t)(reader.end - reader.p))
+			return false;
+		node = YAML::Node(YAML::NodeType::Map);
+		for (uint64_t n = 0; n < count; n++) {
+			YAML::Node key;
+			YAML::Node value;
+			if (!confdecode(reader, key, depth + 1) || !confdecode(reader, value, depth + 1))
+				return false;
+			node.force_insert(key, value);
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+// the tree of a whole image that belongs to source, false for a missing, stale or damaged one
+static bool confimage(const unsigned char* data, size_t len, const _CONF_SOURCE& source, YAML::Node& node)
+{
+	if (len < CONFCACHE_HEADER || memcmp(data, CONFCACHE_MAGIC, 4) != 0)
+		return false;
+
+	uint64_t bodysize = confget(data + 24, 8);
+
+	if (confget(data + 4, 4) != CONFCACHE_FORMAT || confget(data + 8, 8) != source.size || confget(data + 16, 8) != source.hash ||
+		bodysize != len - CONFCACHE_HEADER || confget(data + 32, 8) != confhash(data + CONFCACHE_HEADER, (size_t)bodysize))
+		return false;
+
+	_CONF_READER reader = { data + CONFCACHE_HEADER, data + len };
+	return confdecode(reader, node, 0) && reader.p == reader.end;
+}
+
+static bool confmapped(const std::string& path, const _CONF_SOURCE& source, YAML::Node& node)
+{
+#ifdef _WIN32
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	return confimage(data.data(), data.size(), source, node);
+#else
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < CONFCACHE_HEADER) {
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	bool result = confimage((const unsigned char*)data, (size_t)st.st_size, source, node);
+	munmap(data, (size_t)st.st_size);
+	return result;
+#endif
+}
+
+YAML::Node confcacheload(const char* path, _CONF_SOURCE& source)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		throw YAML::BadFile(path);
+
+	std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	source.size = text.size();
+	source.hash = confhash((const unsigned char*)text.data(), text.size());
+	source.iscached = false;
+
+	YAML::Node node;
+	if (confmapped(std::string(path) + ".bin", source, node)) {
+		source.iscached = true;
+		return node;
+	}
+	return YAML::Load(text);
+}
+
+bool confcachesave(const char* path, const _CONF_SOURCE& source, const YAML::Node& node)
+{
+	if (source.iscached)
+		return true;
+
+	std::string body;
+	confencode(body, node);
+
+	std::string image(CONFCACHE_MAGIC);
+	confput(image, CONFCACHE_FORMAT, 4);
+	confput(image, source.size, 8);
+	confput(image, source.hash, 8);
+	confput(image, body.size(), 8);
+	confput(image, confhash((const unsigned char*)body.data(), body.size()), 8);
+	image += body;
+
+	// written aside and renamed over the old one, a reader sees either image whole
+	std::string target = std::string(path) + ".bin";
+	std::string temp = target + ".tmp";
+	FILE* fp = fopen(temp.c_str(), "wb");
+	if (fp == NULL)
+		return false;
+
+	bool result = fwrite(image.data(), 1, image.size(), fp) == image.size();
+	result = (fclose(fp) == 0) && result;
+#ifdef _WIN32
+	if (result)
+		remove(target.c_str());
+#endif
+	if (!result || rename(temp.c_str(), target.c_str()) != 0) {
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,32 @@
+#ifndef CONFCACHE_H
+#define CONFCACHE_H
+
+#include <stdint.h>
+#include <yaml-cpp/yaml.h>
+
+// a binary image of a parsed yaml conf, kept next to it as path.bin. the image holds the hash of the
+// yaml it came from. a load that finds the yaml unchanged maps the image and builds the tree from it
+// without running the yaml parser. any other yaml is parsed as before. the caller saves the image once
+// it has accepted what it read, so an image only ever holds a conf that was used
+//
+// image    "YCCI", format, yaml size, yaml hash, body size, body hash, body
+// node     a type byte, then for a scalar a varint length and its bytes, for a sequence a varint count
+//          and its nodes, for a map a varint count and its key and value nodes in turn
+// hashes are 64 bit FNV-1a, the integers of the header little endian
+
+#define CONFCACHE_FORMAT 1
+
+// the yaml a tree came from
+struct _CONF_SOURCE
+{
+	uint64_t size;
+	uint64_t hash;
+	bool iscached;	// built from the image, which is up to date
+};
+
+// throws the exceptions of YAML::LoadFile
+YAML::Node confcacheload(const char* path, _CONF_SOURCE& source);
+// writes path.bin for node, false when it could not. nothing to do for a tree that came from the image
+bool confcachesave(const char* path, const _CONF_SOURCE& source, const YAML::Node& node);
+
+#endif
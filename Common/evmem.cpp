@@ -0,0 +1,315 @@
+#include "evmem.h"
+#include "memtag.h"
+#include <event2/event.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#define EVMEM_CLASSES 16
+#define EVMEM_LARGE EVMEM_CLASSES	// sizeclass of a block from malloc
+#define EVMEM_SLAB (64 * 1024)	// carved into the blocks of one class at once
+#define EVMEM_CACHE_BYTES (64 * 1024)	// a thread keeps about this much of a class before half goes back
+
+static const size_t classsizes[EVMEM_CLASSES] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096 };
+
+// in front of every block, 16 bytes keep the alignment of malloc
+struct alignas(16) _EvMemHdr
+{
+	unsigned int sizeclass;
+	size_t size;	// asked for, realloc copies this much
+};
+
+// the free blocks are linked through their first bytes past the header
+struct _EvMemFree
+{
+	_EvMemFree* next;
+};
+
+struct _EvMemCache
+{
+	_EvMemFree* head[EVMEM_CLASSES];
+	int count[EVMEM_CLASSES];
+	std::atomic<unsigned long long> allocs;	// only the owner writes, evmemstats reads
+	std::atomic<unsigned long long> frees;
+	_EvMemCache* next;	// in the live caches
+};
+
+// returns the cache of a thread that exits to the pool, its blocks may still be freed by other threads
+struct _EvMemFlush
+{
+	~_EvMemFlush();
+};
+
+static bool installed = false;
+static unsigned char classindex[4096 / 16 + 1];	// by (size + 15) / 16
+
+static std::mutex poollock;
+static _EvMemFree* poolhead[EVMEM_CLASSES];
+static _EvMemCache* caches = NULL;
+static unsigned long long exitedallocs = 0;	// of the caches of exited threads, under poollock
+static unsigned long long exitedfrees = 0;
+static std::atomic<unsigned long long> largeallocs(0);
+static std::atomic<unsigned long long> refills(0);
+static std::atomic<unsigned long long> spills(0);
+static std::atomic<unsigned long long> slabbytes(0);
+
+static thread_local _EvMemCache* cache = NULL;
+static thread_local bool cachedone = false;	// the thread exits, its frees go to the pool
+static thread_local _EvMemFlush flusher;
+
+static inline size_t cachemax(int sizeclass)
+{
+	return std::max((size_t)8, EVMEM_CACHE_BYTES / classsizes[sizeclass]);
+}
+
+static inline void counterinc(std::atomic<unsigned long long>& counter)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// under poollock, one slab more when the pool has none
+static _EvMemFree* poolpop(int sizeclass)
+{
+	if (poolhead[sizeclass] == NULL) {
+		size_t blocksize = sizeof(_EvMemHdr) + classsizes[sizeclass];
+		size_t blocks = EVMEM_SLAB / blocksize;
+		char* slab = (char*)malloc(blocks * blocksize);
+		if (slab == NULL)
+			return NULL;
+		slabbytes += blocks * blocksize;
+
+		for (size_t n = 0; n < blocks; n++) {
+			_EvMemHdr* hdr = (_EvMemHdr*)(slab + n * blocksize);
+			hdr->sizeclass = sizeclass;
+			_EvMemFree* block = (_EvMemFree*)(hdr + 1);
+			block->next = poolhead[sizeclass];
+			poolhead[sizeclass] = block;
+		}
+	}
+
+	_EvMemFree* block = poolhead[sizeclass];
+	poolhead[sizeclass] = block->next;
+	return block;
+}
+
+static _EvMemCache* cacheget()
+{
+	if (cache != NULL || cachedone)
+		return cache;
+
+	(void)&flusher;	// made on first use, its destructor runs at thread exit
+	cache = new _EvMemCache;
+	memset(cache->head, 0, sizeof(cache->head));
+	memset(cache->count, 0, sizeof(cache->count));
+	cache->allocs = 0;
+	cache->frees = 0;
+
+	std::lock_guard<std::mutex> lock(poollock);
+	cache->next = caches;
+	caches = cache;
+	return cache;
+}
+
+_EvMemFlush::~_EvMemFlush()
+{
+	cachedone = true;
+	if (cache == NULL)
+		return;
+
+	std::lock_guard<std::mutex> lock(poollock);
+	for (int n = 0; n < EVMEM_CLASSES; n++) {
+		while (cache->head[n] != NULL) {
+			_EvMemFree* block = cache->head[n];
+			cache->head[n] = block->next;
+			block->next = poolhead[n];
+			poolhead[n] = block;
+		}
+	}
+	exitedallocs += cache->allocs;
+	exitedfrees += cache->frees;
+
+	for (_EvMemCache** iter = &caches; *iter != NULL; iter = &(*iter)->next) {
+		if (*iter == cache) {
+			*iter = cache->next;
+			break;
+		}
+	}
+	delete cache;
+	cache = NULL;
+}
+
+static void* evmemmalloc(size_t size)
+{
+	if (size > classsizes[EVMEM_CLASSES - 1]) {
+		_EvMemHdr* hdr = (_EvMemHdr*)malloc(sizeof(_EvMemHdr) + size);
+		if (hdr == NULL)
+			return NULL;
+		hdr->sizeclass = EVMEM_LARGE;
+		hdr->size = size;
+		largeallocs++;
+		memtagalloc(_MEM_TAG::_EVENT, size);
+		return hdr + 1;
+	}
+
+	int sizeclass = classindex[(size + 15) / 16];
+	_EvMemCache* mycache = cacheget();
+	_EvMemFree* block;
+
+	if (mycache == NULL) {
+		std::lock_guard<std::mutex> lock(poollock);
+		block = poolpop(sizeclass);
+		if (block != NULL)
+			exitedallocs++;
+	}
+	else {
+		// an empty cache takes half of what it may hold in one lock
+		if (mycache->head[sizeclass] == NULL) {
+			std::lock_guard<std::mutex> lock(poollock);
+			size_t batch = cachemax(sizeclass) / 2;
+			for (size_t n = 0; n < batch; n++) {
+				_EvMemFree* next = poolpop(sizeclass);
+				if (next == NULL)
+					break;
+				next->next = mycache->head[sizeclass];
+				mycache->head[sizeclass] = next;
+				mycache->count[sizeclass]++;
+			}
+			refills++;
+		}
+
+		block = mycache->head[sizeclass];
+		if (block != NULL) {
+			mycache->head[sizeclass] = block->next;
+			mycache->count[sizeclass]--;
+			counterinc(mycache->allocs);
+		}
+	}
+
+	if (block == NULL)
+		return NULL;
+	_EvMemHdr* hdr = (_EvMemHdr*)block - 1;
+	hdr->size = size;
+	memtagalloc(_MEM_TAG::_EVENT, size);
+	return block;
+}
+
+static void evmemfree(void* ptr)
+{
+	if (ptr == NULL)
+		return;
+
+	_EvMemHdr* hdr = (_EvMemHdr*)ptr - 1;
+	int sizeclass = (int)hdr->sizeclass;
+	memtagfree(_MEM_TAG::_EVENT, hdr->size);
+
+	if (sizeclass == EVMEM_LARGE) {
+		free(hdr);
+		return;
+	}
+
+	_EvMemFree* block = (_EvMemFree*)ptr;
+	_EvMemCache* mycache = cacheget();
+
+	if (mycache == NULL) {
+		std::lock_guard<std::mutex> lock(poollock);
+		block->next = poolhead[sizeclass];
+		poolhead[sizeclass] = block;
+		exitedfrees++;
+		return;
+	}
+
+	block->next = mycache->head[sizeclass];
+	mycache->head[sizeclass] = block;
+	mycache->count[sizeclass]++;
+	counterinc(mycache->frees);
+
+	// a thread that frees what others allocate, a relay loop closing pairs of the main loop, gives the
+	// surplus back instead of hoarding it
+	if ((size_t)mycache->count[sizeclass] > cachemax(sizeclass)) {
+		std::lock_guard<std::mutex> lock(poollock);
+		for (size_t n = cachemax(sizeclass) / 2; n > 0; n--) {
+			_EvMemFree* next = mycache->head[sizeclass];
+			mycache->head[sizeclass] = next->next;
+			mycache->count[sizeclass]--;
+			next->next = poolhead[sizeclass];
+			poolhead[sizeclass] = next;
+		}
+		spills++;
+	}
+}
+
+static void* evmemrealloc(void* ptr, size_t size)
+{
+	if (ptr == NULL)
+		return evmemmalloc(size);
+	if (size == 0) {
+		evmemfree(ptr);
+		return NULL;
+	}
+
+	_EvMemHdr* hdr = (_EvMemHdr*)ptr - 1;
+
+	if (hdr->sizeclass == EVMEM_LARGE) {
+		if (size > classsizes[EVMEM_CLASSES - 1]) {
+			size_t before = hdr->size;
+			hdr = (_EvMemHdr*)realloc(hdr, sizeof(_EvMemHdr) + size);
+			if (hdr == NULL)
+				return NULL;
+			hdr->size = size;
+			memtagresize(_MEM_TAG::_EVENT, before, size);
+			return hdr + 1;
+		}
+	}
+	else if (size <= classsizes[hdr->sizeclass]) {
+		memtagresize(_MEM_TAG::_EVENT, hdr->size, size);
+		hdr->size = size;
+		return ptr;
+	}
+
+	void* moved = evmemmalloc(size);
+	if (moved == NULL)
+		return NULL;
+	memcpy(moved, ptr, std::min(hdr->size, size));
+	evmemfree(ptr);
+	return moved;
+}
+
+bool evmeminstall()
+{
+#if !defined(EVENT__DISABLE_MM_REPLACEMENT)
+	if (installed)
+		return true;
+
+	int sizeclass = 0;
+	for (size_t n = 0; n < sizeof(classindex); n++) {
+		while (n * 16 > classsizes[sizeclass])
+			sizeclass++;
+		classindex[n] = (unsigned char)sizeclass;
+	}
+
+	event_set_mem_functions(evmemmalloc, evmemrealloc, evmemfree);
+	installed = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void evmemstats(_EvMemStats& stats)
+{
+	std::lock_guard<std::mutex> lock(poollock);
+
+	stats.installed = installed;
+	stats.allocs = exitedallocs;
+	stats.frees = exitedfrees;
+	for (_EvMemCache* iter = caches; iter != NULL; iter = iter->next) {
+		stats.allocs += iter->allocs.load(std::memory_order_relaxed);
+		stats.frees += iter->frees.load(std::memory_order_relaxed);
+	}
+	stats.large = largeallocs;
+	stats.refills = refills;
+	stats.spills = spills;
+	stats.slabbytes = slabbytes;
+}
@@ -0,0 +1,24 @@
+#ifndef EVMEM_H
+#define EVMEM_H
+
+// size classed allocator for libevent, blocks up to 4096 bytes come from per thread caches refilled from a
+// shared pool in batches, bigger ones straight from malloc. the slabs are never given back, a size class
+// keeps what it once held and reuses it instead of fragmenting the heap
+
+struct _EvMemStats
+{
+	bool installed;
+	unsigned long long allocs;	// served by the size classes
+	unsigned long long frees;
+	unsigned long long large;	// above the largest class
+	unsigned long long refills;	// batches a thread cache took from the shared pool, one lock each
+	unsigned long long spills;	// batches a full thread cache gave back
+	unsigned long long slabbytes;	// taken from malloc for the size classes
+};
+
+// before libevent is used at all, evthread_use_pthreads included, false when libevent was built without
+// memory replacement
+bool evmeminstall();
+void evmemstats(_EvMemStats& stats);
+
+#endif
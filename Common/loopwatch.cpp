@@ -0,0 +1,277 @@
+#include "loopwatch.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#define LOOPWATCH_STACKS
+#endif
+
+const int loopwatchbounds[LOOPWATCH_BUCKETS] = { 1, 2, 5, 10, 25, 50, 100, 250, 500, 1000 };
+
+struct _LoopWatch
+{
+	std::string name;
+	unsigned long long period;	// usec between the probes
+	std::atomic<unsigned long long> tick;	// usec of the last probe
+	std::atomic<unsigned long long> buckets[LOOPWATCH_BUCKETS + 1];	// only the loop writes
+	std::atomic<unsigned long long> count;
+	std::atomic<unsigned long long> sumusec;
+	std::atomic<unsigned long long> stalls;
+	unsigned long long reported;	// tick of the stall last reported, watchdog only
+	std::atomic<const char*> handler;
+	std::atomic<long long> arg;
+	bool attached;
+#ifdef LOOPWATCH_STACKS
+	pthread_t thread;
+	void* stack[LOOPWATCH_FRAMES];
+	std::atomic<int> frames;	// -1 until the signal handler took the sample
+#endif
+};
+
+static std::mutex watchlock;
+static std::vector<_LoopWatch*> vWatches;
+static thread_local _LoopWatch* current = NULL;
+
+static std::thread watchdog;
+static std::mutex watchdoglock;
+static std::condition_variable watchdogwake;
+static bool watchdogrunning = false;
+static int stallusec = 0;
+static void (*stallreport)(const char*) = NULL;
+
+#ifdef LOOPWATCH_STACKS
+static std::atomic<_LoopWatch*> sampling(NULL);
+static int samplesignal = 0;
+
+// backtrace is not on the list of async signal safe calls, its libgcc is loaded ahead in loopwatchstart
+// so it takes no lock here, which is what glibc needs of it
+static void loopwatchsignal(int)
+{
+	_LoopWatch* watch = sampling.load();
+	if (watch != NULL)
+		watch->frames = backtrace(watch->stack, LOOPWATCH_FRAMES);
+}
+#endif
+
+static unsigned long long loopwatchusec()
+{
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+_LoopWatch* loopwatchnew(const char* name, int periodmsec)
+{
+	_LoopWatch* watch = new _LoopWatch;
+	watch->name = name;
+	watch->period = (unsigned long long)periodmsec * 1000;
+	watch->tick = loopwatchusec();
+	for (int n = 0; n <= LOOPWATCH_BUCKETS; n++)
+		watch->buckets[n] = 0;
+	watch->count = 0;
+	watch->sumusec = 0;
+	watch->stalls = 0;
+	watch->reported = 0;
+	watch->handler = NULL;
+	watch->arg = 0;
+	watch->attached = false;
+#ifdef LOOPWATCH_STACKS
+	watch->frames = -1;
+#endif
+
+	std::lock_guard<std::mutex> lock(watchlock);
+	vWatches.push_back(watch);
+	return watch;
+}
+
+void loopwatchattach(_LoopWatch* watch)
+{
+	current = watch;
+#ifdef LOOPWATCH_STACKS
+	watch->thread = pthread_self();
+#endif
+	std::lock_guard<std::mutex> lock(watchlock);
+	watch->tick = loopwatchusec();
+	watch->attached = true;
+}
+
+void loopwatchtick(_LoopWatch* watch, unsigned long long lagusec)
+{
+	int bucket = 0;
+	while (bucket < LOOPWATCH_BUCKETS && lagusec > (unsigned long long)loopwatchbounds[bucket] * 1000)
+		bucket++;
+
+	// a single writer, plain stores keep the probe free of locked instructions
+	watch->buckets[bucket].store(watch->buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	watch->count.store(watch->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	watch->sumusec.store(watch->sumusec.load(std::memory_order_relaxed) + lagusec, std::memory_order_relaxed);
+	watch->tick.store(loopwatchusec(), std::memory_order_release);
+}
+
+#ifdef LOOPWATCH_STACKS
+// the loop thread is interrupted where it is stuck and records its own stack
+static void loopwatchsample(_LoopWatch* watch)
+{
+	char line[512];
+
+	watch->frames = -1;
+	sampling = watch;
+	if (pthread_kill(watch->thread, samplesignal) != 0) {
+		sampling = NULL;
+		return;
+	}
+
+	for (int n = 0; n < 100 && watch->frames < 0; n++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	sampling = NULL;
+
+	int frames = watch->frames;
+	if (frames <= 0)
+		return;
+
+	char** symbols = backtrace_symbols(watch->stack, frames);
+	if (symbols == NULL)
+		return;
+	// the first frames are the signal handler and the trampoline of the kernel
+	for (int n = 2; n < frames; n++) {
+		snprintf(line, sizeof(line), "loop %s stall #%d %s", watch->name.c_str(), n - 2, symbols[n]);
+		stallreport(line);
+	}
+	free(symbols);
+}
+#endif
+
+static void loopwatchcheck()
+{
+	char line[256];
+	unsigned long long now = loopwatchusec();
+	std::vector<_LoopWatch*> vStalled;
+
+	{
+		std::lock_guard<std::mutex> lock(watchlock);
+		for (size_t n = 0; n < vWatches.size(); n++) {
+			_LoopWatch* watch = vWatches[n];
+			unsigned long long tick = watch->tick.load(std::memory_order_acquire);
+			if (!watch->attached || tick == watch->reported || now < tick + watch->period + stallusec)
+				continue;
+			watch->reported = tick;
+			watch->stalls++;
+			vStalled.push_back(watch);
+		}
+	}
+
+	// the watches are never freed, the report runs without the lock
+	for (size_t n = 0; n < vStalled.size(); n++) {
+		_LoopWatch* watch = vStalled[n];
+		const char* handler = watch->handler.load();
+		snprintf(line, sizeof(line), "loop %s stalled for %llu ms in %s %lld.", watch->name.c_str(),
+			(now - watch->tick - watch->period) / 1000, (handler != NULL) ? handler : "an unmarked callback", (long long)watch->arg);
+		stallreport(line);
+#ifdef LOOPWATCH_STACKS
+		loopwatchsample(watch);
+#endif
+	}
+}
+
+static void loopwatchrun()
+{
+	std::chrono::microseconds interval(std::max(stallusec / 4, 10000));
+	std::unique_lock<std::mutex> lock(watchdoglock);
+
+	while (watchdogrunning) {
+		watchdogwake.wait_for(lock, interval);
+		if (!watchdogrunning)
+			break;
+		lock.unlock();
+		loopwatchcheck();
+		lock.lock();
+	}
+}
+
+bool loopwatchstart(int stallmsec, void (*report)(const char* text))
+{
+	if (stallmsec <= 0 || watchdogrunning)
+		return false;
+
+	stallusec = stallmsec * 1000;
+	stallreport = report;
+
+	// loops attached a while ago count from now, the setup after them is no stall
+	{
+		std::lock_guard<std::mutex> lock(watchlock);
+		unsigned long long now = loopwatchusec();
+		for (size_t n = 0; n < vWatches.size(); n++)
+			vWatches[n]->tick = now;
+	}
+
+#ifdef LOOPWATCH_STACKS
+	void* prime[1];
+	backtrace(prime, 1);
+
+	samplesignal = SIGRTMIN + 1;
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = loopwatchsignal;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(samplesignal, &sa, NULL);
+#endif
+
+	watchdogrunning = true;
+	watchdog = std::thread(loopwatchrun);
+	return true;
+}
+
+void loopwatchstop()
+{
+	{
+		std::lock_guard<std::mutex> lock(watchdoglock);
+		if (!watchdogrunning)
+			return;
+		watchdogrunning = false;
+	}
+	watchdogwake.notify_all();
+	if (watchdog.joinable())
+		watchdog.join();
+}
+
+void loopwatchstats(std::vector<_LoopWatchStats>& vStats)
+{
+	std::lock_guard<std::mutex> lock(watchlock);
+
+	vStats.resize(vWatches.size());
+	for (size_t n = 0; n < vWatches.size(); n++) {
+		_LoopWatch* watch = vWatches[n];
+		vStats[n].name = watch->name;
+		for (int i = 0; i <= LOOPWATCH_BUCKETS; i++)
+			vStats[n].buckets[i] = watch->buckets[i].load(std::memory_order_relaxed);
+		vStats[n].count = watch->count.load(std::memory_order_relaxed);
+		vStats[n].sumusec = watch->sumusec.load(std::memory_order_relaxed);
+		vStats[n].stalls = watch->stalls;
+	}
+}
+
+_LoopBusy::_LoopBusy(const char* handler, long long arg)
+{
+	this->watch = current;
+	if (this->watch == NULL)
+		return;
+	this->prevhandler = this->watch->handler.load(std::memory_order_relaxed);
+	this->prevarg = this->watch->arg.load(std::memory_order_relaxed);
+	this->watch->arg.store(arg, std::memory_order_relaxed);
+	this->watch->handler.store(handler, std::memory_order_relaxed);
+}
+
+_LoopBusy::~_LoopBusy()
+{
+	if (this->watch == NULL)
+		return;
+	this->watch->handler.store(this->prevhandler, std::memory_order_relaxed);
+	this->watch->arg.store(this->prevarg, std::memory_order_relaxed);
+}
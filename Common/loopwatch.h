@@ -0,0 +1,50 @@
+#ifndef LOOPWATCH_H
+#define LOOPWATCH_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// lag of the event loops. each loop runs a probe timer and passes how late it fired to loopwatchtick,
+// which keeps a histogram of it. with a stall threshold a watchdog thread looks for a loop whose probe
+// is overdue by more than that, a loop stuck in one callback, and reports the handler the loop marked
+// with _LoopBusy and a stack sample of the loop thread where glibc can take one
+
+#define LOOPWATCH_BUCKETS 10
+#define LOOPWATCH_FRAMES 32
+
+struct _LoopWatch;
+
+struct _LoopWatchStats
+{
+	std::string name;
+	unsigned long long buckets[LOOPWATCH_BUCKETS + 1];	// lag up to loopwatchbounds[n] msec, the last one above all of them
+	unsigned long long count;
+	unsigned long long sumusec;
+	unsigned long long stalls;
+};
+
+extern const int loopwatchbounds[LOOPWATCH_BUCKETS];
+
+_LoopWatch* loopwatchnew(const char* name, int periodmsec);	// before the loop runs, kept until exit
+void loopwatchattach(_LoopWatch* watch);	// on the thread of the loop, before it runs
+void loopwatchtick(_LoopWatch* watch, unsigned long long lagusec);	// from the probe of the loop
+bool loopwatchstart(int stallmsec, void (*report)(const char* text));	// the watchdog, 0 keeps it off
+void loopwatchstop();
+void loopwatchstats(std::vector<_LoopWatchStats>& vStats);
+
+// what the loop of the calling thread runs until the end of the scope, a literal and a number like an
+// opcode or a game serial. a thread without a watch pays one thread local read
+class _LoopBusy
+{
+public:
+	_LoopBusy(const char* handler, long long arg);
+	~_LoopBusy();
+
+private:
+	_LoopWatch* watch;
+	const char* prevhandler;
+	long long prevarg;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "memtag.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+static const char tagnames[(int)_MEM_TAG::_MAX][16] = {
+	"relay pair",
+	"user slot",
+	"game",
+	"event",
+	"log",
+	"http"
+};
+
+// only the owning thread writes a counter, the relaxed atomics just let a reader see whole values.
+// bytes freed by another thread than the one allocating them make both tables lopsided, their sum holds
+struct _MemTagCounter
+{
+	std::atomic<long long> bytes;
+	std::atomic<unsigned long long> allocs;
+	std::atomic<unsigned long long> frees;
+};
+
+struct _MemTagTable
+{
+	_MemTagCounter counters[(int)_MEM_TAG::_MAX];
+};
+
+// a table lives as long as the process, a thread that exits leaves its counts in it
+static std::mutex taglock;
+static std::vector<_MemTagTable*> vTables;
+static thread_local _MemTagTable* table = NULL;
+
+static long long peaks[(int)_MEM_TAG::_MAX];	// under taglock
+static unsigned long long lastallocs[(int)_MEM_TAG::_MAX];	// of the previous memtagreport
+static unsigned long long lastfrees[(int)_MEM_TAG::_MAX];
+static std::chrono::steady_clock::time_point lastreport = std::chrono::steady_clock::now();
+
+static _MemTagTable* memtagtable()
+{
+	if (table == NULL) {
+		table = new _MemTagTable();
+		std::lock_guard<std::mutex> lock(taglock);
+		vTables.push_back(table);
+	}
+	return table;
+}
+
+template <typename T>
+static inline void memtagadd(std::atomic<T>& counter, T value)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void memtagalloc(_MEM_TAG tag, size_t bytes)
+{
+	_MemTagCounter& counter = memtagtable()->counters[(int)tag];
+	memtagadd(counter.bytes, (long long)bytes);
+	memtagadd(counter.allocs, 1ULL);
+}
+
+void memtagfree(_MEM_TAG tag, size_t bytes)
+{
+	_MemTagCounter& counter = memtagtable()->counters[(int)tag];
+	memtagadd(counter.bytes, -(long long)bytes);
+	memtagadd(counter.frees, 1ULL);
+}
+
+void memtagresize(_MEM_TAG tag, size_t before, size_t after)
+{
+	memtagadd(memtagtable()->counters[(int)tag].bytes, (long long)after - (long long)before);
+}
+
+// under taglock
+static void memtagsum(long long* live, unsigned long long* allocs, unsigned long long* frees)
+{
+	for (int n = 0; n < (int)_MEM_TAG::_MAX; n++) {
+		live[n] = 0;
+		allocs[n] = 0;
+		frees[n] = 0;
+	}
+	for (size_t i = 0; i < vTables.size(); i++) {
+		for (int n = 0; n < (int)_MEM_TAG::_MAX; n++) {
+			live[n] += vTables[i]->counters[n].bytes.load(std::memory_order_relaxed);
+			allocs[n] += vTables[i]->counters[n].allocs.load(std::memory_order_relaxed);
+			frees[n] += vTables[i]->counters[n].frees.load(std::memory_order_relaxed);
+		}
+	}
+	for (int n = 0; n < (int)_MEM_TAG::_MAX; n++) {
+		if (live[n] > peaks[n])
+			peaks[n] = live[n];
+	}
+}
+
+void memtagsample()
+{
+	long long live[(int)_MEM_TAG::_MAX];
+	unsigned long long allocs[(int)_MEM_TAG::_MAX];
+	unsigned long long frees[(int)_MEM_TAG::_MAX];
+
+	std::lock_guard<std::mutex> lock(taglock);
+	memtagsum(live, allocs, frees);
+}
+
+void memtagstats(std::vector<_MemTagStats>& vStats)
+{
+	long long live[(int)_MEM_TAG::_MAX];
+	unsigned long long allocs[(int)_MEM_TAG::_MAX];
+	unsigned long long frees[(int)_MEM_TAG::_MAX];
+
+	std::lock_guard<std::mutex> lock(taglock);
+	memtagsum(live, allocs, frees);
+
+	vStats.resize((int)_MEM_TAG::_MAX);
+	for (int n = 0; n < (int)_MEM_TAG::_MAX; n++) {
+		vStats[n].name = tagnames[n];
+		vStats[n].live = live[n];
+		vStats[n].peak = peaks[n];
+		vStats[n].allocs = allocs[n];
+		vStats[n].frees = frees[n];
+	}
+}
+
+std::string memtagreport()
+{
+	std::vector<_MemTagStats> vStats;
+	std::string out;
+	char szLine[192];
+
+	memtagstats(vStats);
+
+	std::lock_guard<std::mutex> lock(taglock);
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - lastreport).count();
+	lastreport = now;
+
+	for (size_t n = 0; n < vStats.size(); n++) {
+		double allocrate = (seconds > 0) ? (vStats[n].allocs - lastallocs[n]) / seconds : 0;
+		double freerate = (seconds > 0) ? (vStats[n].frees - lastfrees[n]) / seconds : 0;
+		lastallocs[n] = vStats[n].allocs;
+		lastfrees[n] = vStats[n].frees;
+		snprintf(szLine, sizeof(szLine), "mem %s live %lld peak %lld allocs %llu frees %llu, %.1f allocs %.1f frees per sec\n", vStats[n].name,
+			vStats[n].live, vStats[n].peak, vStats[n].allocs, vStats[n].frees, allocrate, freerate);
+		out += szLine;
+	}
+	return out;
+}
@@ -0,0 +1,58 @@
+#ifndef MEMTAG_H
+#define MEMTAG_H
+
+#include <stddef.h>
+#include <new>
+#include <string>
+#include <vector>
+
+// bytes held per subsystem. every thread counts into its own table without a lock and the tables are
+// summed when a report is asked for, so a tag costs a thread local read and two stores per call. the
+// peak is the highest live sum memtagsample or a report has seen, not an exact high water mark
+
+enum class _MEM_TAG
+{
+	_RELAY_PAIR,	// tunnel pairs, pooled ones included
+	_USER_SLOT,	// user slabs
+	_GAME,	// game slabs
+	_EVENT,	// libevent through Event Memory Pool, the packet buffers with their chains
+	_LOG,	// log ring
+	_HTTP,	// outbound http requests, the sms queue
+	_MAX
+};
+
+struct _MemTagStats
+{
+	const char* name;
+	long long live;	// bytes
+	long long peak;
+	unsigned long long allocs;
+	unsigned long long frees;
+};
+
+void memtagalloc(_MEM_TAG tag, size_t bytes);
+void memtagfree(_MEM_TAG tag, size_t bytes);
+void memtagresize(_MEM_TAG tag, size_t before, size_t after);	// in place, no alloc or free counted
+void memtagsample();	// from a timer, keeps the peaks honest between reports
+void memtagstats(std::vector<_MemTagStats>& vStats);
+std::string memtagreport();	// one line per tag with the rates since the previous report, for a log
+
+// a class deriving from this is counted under tag by its own operator new and delete
+template <_MEM_TAG tag>
+struct _MemTagged
+{
+	static void* operator new(size_t bytes)
+	{
+		void* ptr = ::operator new(bytes);
+		memtagalloc(tag, bytes);
+		return ptr;
+	}
+
+	static void operator delete(void* ptr, size_t bytes)
+	{
+		memtagfree(tag, bytes);
+		::operator delete(ptr);
+	}
+};
+
+#endif
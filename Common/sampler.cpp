@@ -0,0 +1,207 @@
+#include "sampler.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#if defined(__GLIBC__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#define SAMPLER_STACKS
+#endif
+
+#define SAMPLER_MAX_SAMPLES 65536	// 24 MB of slots, about 11 cpu minutes at SAMPLER_HZ
+
+static std::mutex samplerlock;
+static std::condition_variable samplerwake;
+static std::thread runner;
+static bool stopping = false;
+static std::atomic<bool> running(false);
+
+#ifdef SAMPLER_STACKS
+struct _Sample
+{
+	int frames;
+	void* stack[SAMPLER_FRAMES];
+};
+
+// the handler only touches these, the slots are taken in order and a full buffer counts the rest as dropped
+static _Sample* samples = NULL;
+static size_t capacity = 0;
+static std::atomic<size_t> nextslot(0);
+static std::atomic<bool> sampling(false);
+static std::atomic<int> inflight(0);	// handlers between their check of sampling and their return
+static bool installed = false;
+
+// backtrace is not on the list of async signal safe calls, its libgcc is loaded ahead in samplerstart
+static void samplersignal(int)
+{
+	int saved = errno;
+	inflight++;
+	if (sampling) {
+		size_t slot = nextslot.fetch_add(1, std::memory_order_relaxed);
+		if (slot < capacity)
+			samples[slot].frames = backtrace(samples[slot].stack, SAMPLER_FRAMES);
+	}
+	inflight--;
+	errno = saved;
+}
+
+// an exported symbol by its demangled name, anything else as module+offset for addr2line -f -e module
+static std::string samplername(void* addr)
+{
+	Dl_info info;
+	char text[256];
+
+	if (dladdr(addr, &info) == 0 || info.dli_fname == NULL) {
+		snprintf(text, sizeof(text), "%p", addr);
+		return text;
+	}
+	if (info.dli_sname != NULL) {
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+		std::string name = (status == 0 && demangled != NULL) ? demangled : info.dli_sname;
+		free(demangled);
+		for (size_t n = 0; n < name.size(); n++) {
+			if (name[n] == ';')
+				name[n] = ':';
+		}
+		return name;
+	}
+	const char* module = strrchr(info.dli_fname, '/');
+	snprintf(text, sizeof(text), "%s+0x%llx", (module != NULL) ? module + 1 : info.dli_fname,
+		(unsigned long long)((char*)addr - (char*)info.dli_fbase));
+	return text;
+}
+
+static void samplerrun(FILE* fp, std::string path, int seconds, void (*report)(const char* text))
+{
+	{
+		std::unique_lock<std::mutex> lock(samplerlock);
+		samplerwake.wait_for(lock, std::chrono::seconds(seconds), [] { return stopping; });
+	}
+
+	struct itimerval off;
+	memset(&off, 0, sizeof(off));
+	setitimer(ITIMER_PROF, &off, NULL);
+	sampling = false;
+	while (inflight > 0)
+		std::this_thread::yield();
+
+	size_t taken = std::min(nextslot.load(), capacity);
+	size_t dropped = nextslot.load() - taken;
+	std::unordered_map<void*, std::string> names;
+	std::map<std::string, unsigned long long> folded;
+
+	// the first frames are the signal handler and the trampoline of the kernel, the one after them is
+	// where the thread was stopped and every outer one a return address, looked up a byte back in its call
+	for (size_t i = 0; i < taken; i++) {
+		std::string line;
+		for (int n = samples[i].frames - 1; n >= 2; n--) {
+			void* addr = (n > 2) ? (char*)samples[i].stack[n] - 1 : samples[i].stack[n];
+			auto iter = names.find(addr);
+			if (iter == names.end())
+				iter = names.emplace(addr, samplername(addr)).first;
+			if (!line.empty())
+				line += ';';
+			line += iter->second;
+		}
+		if (!line.empty())
+			folded[line]++;
+	}
+
+	for (auto& iter : folded)
+		fprintf(fp, "%s %llu\n", iter.first.c_str(), iter.second);
+	fclose(fp);
+
+	delete[] samples;
+	samples = NULL;
+	capacity = 0;
+
+	char text[512];
+	snprintf(text, sizeof(text), "Profile written to %s, %zu samples in %zu stacks, %zu dropped.", path.c_str(), taken, folded.size(), dropped);
+	running = false;
+	if (report != NULL)
+		report(text);
+}
+#endif
+
+bool samplerstart(const char* path, int seconds, void (*report)(const char* text))
+{
+#ifdef SAMPLER_STACKS
+	std::lock_guard<std::mutex> lock(samplerlock);
+	if (running)
+		return false;
+	// the previous run is done and only waits to be joined
+	if (runner.joinable())
+		runner.join();
+
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL)
+		return false;
+
+	seconds = std::max(1, std::min(seconds, SAMPLER_MAX_SECONDS));
+	unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+	capacity = std::min((size_t)SAMPLER_HZ * seconds * cpus, (size_t)SAMPLER_MAX_SAMPLES);
+	samples = new _Sample[capacity];
+	nextslot = 0;
+
+	if (!installed) {
+		void* prime[1];
+		backtrace(prime, 1);
+
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = samplersignal;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGPROF, &sa, NULL);
+		installed = true;
+	}
+
+	stopping = false;
+	running = true;
+	sampling = true;
+
+	struct itimerval every;
+	every.it_interval.tv_sec = 0;
+	every.it_interval.tv_usec = 1000000 / SAMPLER_HZ;
+	every.it_value = every.it_interval;
+	setitimer(ITIMER_PROF, &every, NULL);
+
+	runner = std::thread(samplerrun, fp, std::string(path), seconds, report);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void samplerstop()
+{
+	std::thread done;
+	{
+		std::lock_guard<std::mutex> lock(samplerlock);
+		stopping = true;
+		done = std::move(runner);
+	}
+	samplerwake.notify_all();
+	if (done.joinable())
+		done.join();
+}
+
+bool samplerrunning()
+{
+	return running;
+}
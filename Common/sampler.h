@@ -0,0 +1,19 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+// a sampling profiler that runs inside the process, for a hot spot seen in production without perf or a
+// rebuild. SIGPROF fires SAMPLER_HZ times per cpu second the process burns, the thread it lands on records
+// its own stack into a preallocated slot, and once the run ends a thread of its own folds the stacks into
+// one line per distinct stack, "outer;...;inner count", the input of flamegraph.pl. glibc only
+
+#define SAMPLER_HZ 99
+#define SAMPLER_FRAMES 48
+#define SAMPLER_MAX_SECONDS 300
+
+// false while a run is going, for a path that cannot be opened or where there are no stacks to take.
+// report gets one line once the file is written, from the thread of the profiler
+bool samplerstart(const char* path, int seconds, void (*report)(const char* text));
+void samplerstop();	// ends a run early and waits for its file, also at exit
+bool samplerrunning();
+
+#endif
@@ -0,0 +1,42 @@
+#!/bin/sh
+# training run of the pgo-gen build: starts the instrumented tongits-server in the current directory,
+# which needs its conf.yaml, plays it with tongits_loadgen and stops it with SIGINT so the profile is written.
+#   pgo-train.sh <build dir> <profile dir> [tongits_loadgen arguments]
+# the default load is the README one, shortened to 2 minutes
+
+BUILD=$1
+PROFILE=$2
+shift 2
+
+if [ ! -x "$BUILD/tongits-server" ] || [ ! -x "$BUILD/tongits_loadgen" ]; then
+	echo "pgo-train: build tongits-server and tongits_loadgen with the pgo-gen preset first."
+	exit 1
+fi
+
+if [ ! -f conf.yaml ]; then
+	echo "pgo-train: run it where the conf.yaml of the server is."
+	exit 1
+fi
+
+if [ $# -eq 0 ]; then
+	set -- -h 127.0.0.1 -p 3000 -n 300 -u load -s load -g 0 -d 120 -t 600 -T 2000 -r 50
+fi
+
+mkdir -p "$PROFILE"
+
+"$BUILD/tongits-server" &
+SERVER=$!
+sleep 2
+
+"$BUILD/tongits_loadgen" "$@"
+RESULT=$?
+
+kill -INT $SERVER
+wait $SERVER
+
+# clang writes raw profiles, the pgo-use build reads the merged one
+if ls "$PROFILE"/*.profraw >/dev/null 2>&1; then
+	llvm-profdata merge -output="$PROFILE/default.profdata" "$PROFILE"/*.profraw || exit 1
+fi
+
+exit $RESULT
@@ -0,0 +1,159 @@
+#!/bin/sh
+# soak run: starts tongits-server in the current directory, which needs its conf.yaml, plays it with
+# tongits_loadgen for hours and, when the build has them, runs tunnel_bench against a tunnel for as long.
+# every minute it writes down the RSS and the open fds of the server, the p99 loop lag of that minute
+# from /stats of the Stats Port and the p99 answer time of the players, and tunnel_bench does the same
+# for its relays. at the end it fits a line through each column past the warmup and fails when one grows
+# faster per hour than its limit, a leak of a few KB a minute never shows in a run of two
+#   soak.sh <build dir> [minutes] [tongits_loadgen arguments]
+# the default is 4 hours of the README load at 50 connections a second. the limits, per hour:
+#   SOAK_RSS_KB=20480 SOAK_FDS=16 SOAK_LAG_MS=5 SOAK_P99_US=20000 SOAK_WARMUP=10 (minutes)
+# SOAK_BENCH is the tunnel_bench load, its -m mode soaks, the samples go to soak-<time>/
+
+BUILD=$1
+MINUTES=${2:-240}
+shift
+[ $# -gt 0 ] && shift
+
+RSS_KB=${SOAK_RSS_KB:-20480}
+FDS=${SOAK_FDS:-16}
+LAG_MS=${SOAK_LAG_MS:-5}
+P99_US=${SOAK_P99_US:-20000}
+WARMUP=${SOAK_WARMUP:-10}
+BENCH=${SOAK_BENCH:--c 8 -n 64 -b 1048576 -s 200 -m mux}
+
+if [ ! -x "$BUILD/tongits-server" ] || [ ! -x "$BUILD/tongits_loadgen" ]; then
+	echo "soak: build tongits-server and tongits_loadgen first."
+	exit 1
+fi
+
+if [ ! -f conf.yaml ]; then
+	echo "soak: run it where the conf.yaml of the server is."
+	exit 1
+fi
+
+if [ $# -eq 0 ]; then
+	set -- -h 127.0.0.1 -p 3000 -n 300 -u load -s load -g 0 -t 600 -T 2000 -r 50
+fi
+
+STATS=$(sed -n 's/^ *Stats Port: *\([0-9]*\).*/\1/p' conf.yaml | head -n 1)
+if [ -z "$STATS" ] || [ "$STATS" = "0" ] || ! command -v curl >/dev/null 2>&1; then
+	echo "soak: no Stats Port in conf.yaml or no curl, the loop lag is not sampled."
+	STATS=
+fi
+
+OUT=soak-$(date +%Y%m%d-%H%M%S)
+mkdir -p "$OUT"
+DURATION=$((MINUTES * 60))
+
+# p99 bound in msec of the lag probes between two /stats, the worst loop
+lagp99() {
+	awk '
+	/ lag / {
+		key = substr($0, 1, index($0, " lag") - 1)
+		nb = 0
+		for (i = 1; i <= NF; i++) {
+			if (split($i, kv, ":") != 2)
+				continue
+			if (FILENAME == ARGV[1])
+				prev[key, kv[1]] = kv[2]
+			else {
+				b[++nb] = kv[1]
+				d[nb] = kv[2] - prev[key, kv[1]]
+			}
+		}
+		# a p99 past the last bound counts as that bound
+		for (i = 1; i <= nb && d[nb] > 0; i++) {
+			if (d[i] >= d[nb] * 0.99) {
+				v = (b[i] == "inf") ? b[i - 1] : b[i]
+				if (v + 0 > worst)
+					worst = v + 0
+				break
+			}
+		}
+	}
+	END { print worst + 0 }' "$1" "$2"
+}
+
+# least squares growth per hour of a column over the minutes past the warmup
+slope() {
+	awk -v col="$2" -v warm="$WARMUP" '
+	$1 >= warm { n++; sx += $1; sy += $col; sxx += $1 * $1; sxy += $1 * $col }
+	END { d = n * sxx - sx * sx; printf "%.2f\n", (n > 2 && d != 0) ? (n * sxy - sx * sy) / d * 60 : 0 }' "$1"
+}
+
+RESULT=0
+
+check() {
+	GROWTH=$(slope "$1" "$2")
+	if awk -v g="$GROWTH" -v l="$4" 'BEGIN { exit !(g > l) }'; then
+		echo "soak: $3 grows $GROWTH per hour, over $4."
+		RESULT=1
+	else
+		echo "soak: $3 grows $GROWTH per hour."
+	fi
+}
+
+"$BUILD/tongits-server" > "$OUT/server.log" 2>&1 &
+SERVER=$!
+sleep 2
+
+"$BUILD/tongits_loadgen" "$@" -d $DURATION -i 60 > "$OUT/loadgen.log" 2>&1 &
+LOADGEN=$!
+
+BENCHPID=
+if [ -x "$BUILD/tunnel_bench" ] && [ -x "$BUILD/tunnel" ]; then
+	"$BUILD/tunnel_bench" -t "$BUILD/tunnel" $BENCH -d $DURATION > "$OUT/bench.log" 2>&1 &
+	BENCHPID=$!
+fi
+
+echo "soak: $MINUTES minutes, samples in $OUT."
+
+MINUTE=0
+while [ $MINUTE -lt $MINUTES ]; do
+	sleep 60
+	MINUTE=$((MINUTE + 1))
+
+	if ! kill -0 $SERVER 2>/dev/null; then
+		echo "soak: tongits-server is gone after $MINUTE minutes, see $OUT/server.log."
+		RESULT=1
+		kill $LOADGEN $BENCHPID 2>/dev/null
+		break
+	fi
+
+	RSS=$(awk '/^VmRSS:/ { print $2 }' /proc/$SERVER/status)
+	OPEN=$(ls /proc/$SERVER/fd | wc -l)
+	LAG=0
+	if [ -n "$STATS" ]; then
+		curl -s "http://127.0.0.1:$STATS/stats" > "$OUT/stats.now"
+		[ -s "$OUT/stats.last" ] && LAG=$(lagp99 "$OUT/stats.last" "$OUT/stats.now")
+		mv "$OUT/stats.now" "$OUT/stats.last"
+	fi
+	P99=$(awk '/ p99 us$/ { v = $(NF - 2) } END { print v + 0 }' "$OUT/loadgen.log")
+
+	echo "$MINUTE $RSS $OPEN $LAG $P99" >> "$OUT/server.txt"
+done
+
+wait $LOADGEN || RESULT=1
+[ -n "$BENCHPID" ] && { wait $BENCHPID || RESULT=1; }
+kill -INT $SERVER 2>/dev/null
+wait $SERVER
+
+if [ -s "$OUT/server.txt" ]; then
+	check "$OUT/server.txt" 2 "server RSS KB" $RSS_KB
+	check "$OUT/server.txt" 3 "server fds" $FDS
+	[ -n "$STATS" ] && check "$OUT/server.txt" 4 "server p99 loop lag ms" $LAG_MS
+	check "$OUT/server.txt" 5 "player p99 answer us" $P99_US
+fi
+
+# mode soak conns Gbit/s p50 p99 p999 failed <rss> kB rss <fds> fds <seconds> s
+if [ -n "$BENCHPID" ]; then
+	awk '$2 == "soak" { print $14 / 60, $9, $12, $6 }' "$OUT/bench.log" > "$OUT/bench.txt"
+	if [ -s "$OUT/bench.txt" ]; then
+		check "$OUT/bench.txt" 2 "tunnel RSS KB" $RSS_KB
+		check "$OUT/bench.txt" 3 "tunnel fds" $FDS
+		check "$OUT/bench.txt" 4 "tunnel p99 connect us" $P99_US
+	fi
+fi
+
+exit $RESULT
@@ -0,0 +1,154 @@
+#include "adminfeed.h"
+#include "eventlog.h"
+#include "common.h"
+#include "user.h"
+#include "socket.h"
+#include <mutex>
+#include <deque>
+#include <vector>
+
+static_assert(sizeof(((_PMSG_FEED_EVENT*)0)->account) == EVENT_MAX_CARDS + 1, "an account event keeps the name in its cards");
+
+struct _FEED_ADMIN
+{
+	uintptr_t userindex;
+	int aindex;
+	std::deque<_EVENT_RECORD> backlog;
+	uint32_t dropped;	// since its last packet
+};
+
+static std::mutex feedlock;
+static std::deque<_EVENT_RECORD> feedpending;	// under feedlock
+static uint32_t feedpendingdropped = 0;	// under feedlock
+static std::atomic<int> feedadmins(0);
+static std::vector<_FEED_ADMIN> vFeedAdmins;	// loop 0 only
+
+void feedpush(const _EVENT_RECORD& rec)
+{
+	if (rec.action < EVENT_START || feedadmins.load(std::memory_order_relaxed) == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(feedlock);
+	feedpending.push_back(rec);
+	if (feedpending.size() > FEED_MAX_PENDING) {
+		feedpending.pop_front();
+		feedpendingdropped++;
+	}
+}
+
+static void feedsend(_FEED_ADMIN& admin, const _EVENT_RECORD* records, int count)
+{
+	unsigned char buffer[sizeof(_PMSG_FEED_INFO) + FEED_BATCH * sizeof(_PMSG_FEED_EVENT)] = { 0 };
+	_PMSG_FEED_INFO* pMsg = (_PMSG_FEED_INFO*)buffer;
+	_PMSG_FEED_EVENT* events = (_PMSG_FEED_EVENT*)(buffer + sizeof(_PMSG_FEED_INFO));
+	int size = sizeof(_PMSG_FEED_INFO) + count * sizeof(_PMSG_FEED_EVENT);
+
+	pMsg->hdr.c = 0xC2;
+	pMsg->hdr.h = 0xF4;
+	pMsg->hdr.len[0] = SET_NUMBERH(size);
+	pMsg->hdr.len[1] = SET_NUMBERL(size);
+	pMsg->sub = 0x0C;
+	pMsg->aindex = admin.aindex;
+	pMsg->dropped = admin.dropped;
+	pMsg->count = (unsigned char)count;
+
+	for (int n = 0; n < count; n++) {
+		const _EVENT_RECORD& rec = records[n];
+		events[n].time = rec.time;
+		events[n].serial = rec.serial;
+		events[n].delta = rec.delta;
+		events[n].action = rec.action;
+		events[n].userpos = rec.userpos;
+		if (EVENT_ISACCOUNT(rec.action))
+			memcpy(events[n].account, rec.cards, rec.count);
+	}
+
+	admin.dropped = 0;
+	::datasend(admin.userindex, buffer, size);
+}
+
+// bytes the admin has not been sent yet, 0 when its connection is on another loop
+static size_t feedunsent(_USER_INFO* userinfo)
+{
+	if (userinfo->packetdata.bev == NULL || userinfo->packetdata.loop != le_getloop())
+		return 0;
+	return evbuffer_get_length(bufferevent_get_output(userinfo->packetdata.bev));
+}
+
+void feedwatch(uintptr_t userindex, int aindex, bool isfeed)
+{
+	if (le_getloop() != 0) {
+		le_post([userindex, aindex, isfeed]() { feedwatch(userindex, aindex, isfeed); });
+		return;
+	}
+
+	size_t n = 0;
+	while (n < vFeedAdmins.size() && vFeedAdmins[n].userindex != userindex)
+		n++;
+
+	if (!isfeed) {
+		if (n < vFeedAdmins.size()) {
+			vFeedAdmins.erase(vFeedAdmins.begin() + n);
+			feedadmins--;
+		}
+		return;
+	}
+
+	if (n == vFeedAdmins.size()) {
+		_FEED_ADMIN admin;
+		admin.userindex = userindex;
+		admin.dropped = 0;
+		vFeedAdmins.push_back(admin);
+		feedadmins++;
+		MSGLOG(eMSGTYPE::INFO, "feedwatch, admin %llu streams the admin feed.", (unsigned long long)userindex);
+	}
+
+	vFeedAdmins[n].aindex = aindex;
+	feedsend(vFeedAdmins[n], NULL, 0);
+}
+
+void feedrun()
+{
+	if (feedadmins.load(std::memory_order_relaxed) == 0)
+		return;
+
+	std::deque<_EVENT_RECORD> records;
+	uint32_t dropped;
+	{
+		std::lock_guard<std::mutex> lock(feedlock);
+		records.swap(feedpending);
+		dropped = feedpendingdropped;
+		feedpendingdropped = 0;
+	}
+
+	for (size_t n = 0; n < vFeedAdmins.size();) {
+		_FEED_ADMIN& admin = vFeedAdmins[n];
+		_USER_INFO* userinfo = guser.getuser(admin.userindex);
+
+		// gone or no longer an admin, the connection of a new user may have the slot
+		if (userinfo == NULL || !(userinfo->ismuadmin || userinfo->isuseradmin) ||
+			!(userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED)) {
+			vFeedAdmins.erase(vFeedAdmins.begin() + n);
+			feedadmins--;
+			continue;
+		}
+
+		admin.dropped += dropped;
+		admin.backlog.insert(admin.backlog.end(), records.begin(), records.end());
+		while (admin.backlog.size() > FEED_MAX_BACKLOG) {
+			admin.backlog.pop_front();
+			admin.dropped++;
+		}
+
+		_EVENT_RECORD batch[FEED_BATCH];
+		while (!admin.backlog.empty() && feedunsent(userinfo) < FEED_MAX_OUTPUT) {
+			int count = 0;
+			while (count < FEED_BATCH && !admin.backlog.empty()) {
+				batch[count++] = admin.backlog.front();
+				admin.backlog.pop_front();
+			}
+			feedsend(admin, batch, count);
+		}
+		n++;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+
+struct _EVENT_RECORD;
+
+// the admin feed, the events of the event log that are not player actions streamed to the mu admins
+// that asked for it: table starts, settlements and ends, logins and the eCoins an admin credited or
+// cashed out. addevent hands every record to feedpush, which keeps nothing while no admin listens.
+// loop 0 moves them to the admins on its tick, FEED_BATCH a packet while the output of the admin holds
+// less than FEED_MAX_OUTPUT unsent. an admin that falls further behind loses the oldest events first,
+// the next packet counts how many
+
+#define FEED_MAX_PENDING 8192	// records between two ticks of loop 0
+#define FEED_MAX_BACKLOG 4096	// records an admin may be behind
+#define FEED_MAX_OUTPUT (64 * 1024)
+#define FEED_BATCH 32	// events a packet
+
+void feedpush(const _EVENT_RECORD& rec);	// any thread
+void feedwatch(uintptr_t userindex, int aindex, bool isfeed);	// any loop
+void feedrun();	// loop 0, from the loop tick
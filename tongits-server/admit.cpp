@@ -0,0 +1,96 @@
+#include "admit.h"
+#include "common.h"
+#include "conf.h"
+#include "socket.h"
+#include "packet.h"
+#include <unordered_map>
+#include <algorithm>
+
+static _ADMIT_STATS admitstats;
+static double admittokens = 0;	// below 0 by the slots handed out
+static uint64_t admittick = 0;
+static std::unordered_map<int64_t, uint64_t> mAdmitSlots;	// session token, when its login may come back
+
+static void admitrefill(uint64_t now)
+{
+	double burst = (double)c.getresumeburst();
+
+	if (admittick == 0)
+		admittokens = burst;
+	else
+		admittokens = std::min(burst, admittokens + (double)(now - admittick) * c.getresumerate() / 1000);
+	admittick = now;
+}
+
+static void admitretry(uintptr_t userindex, uint32_t msec)
+{
+	_PMSG_RETRY_INFO pMsg = pkttemplate<_PMSG_RETRY_INFO>(0xF2, 0x0D);
+	pMsg.retrymsec = msec;
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+	admitstats.deferred++;
+}
+
+bool admitresume(uintptr_t userindex, int64_t token, bool isurgent)
+{
+	int rate = c.getresumerate();
+	if (rate <= 0)
+		return true;
+
+	uint64_t now = clockmsec();
+	admitrefill(now);
+
+	auto iter = mAdmitSlots.find(token);
+	if (iter != mAdmitSlots.end()) {
+		// paid for when the slot was handed out
+		if (isurgent || now + ADMIT_EARLY_MSEC >= iter->second) {
+			mAdmitSlots.erase(iter);
+			admitstats.slots = mAdmitSlots.size();
+			admitstats.admitted++;
+			return true;
+		}
+		admitretry(userindex, (uint32_t)(iter->second - now));
+		return false;
+	}
+
+	if (admittokens >= 1 || isurgent) {
+		if (admittokens >= 1)
+			admitstats.admitted++;
+		else
+			admitstats.urgent++;
+		admittokens -= 1;
+		return true;
+	}
+
+	// when the bucket has the token again, after every slot handed out before
+	uint32_t msec = std::max((uint32_t)((1 - admittokens) * 1000 / rate), (uint32_t)1);
+	if (msec > ADMIT_MAX_RETRY_MSEC) {
+		admitretry(userindex, ADMIT_MAX_RETRY_MSEC);
+		return false;
+	}
+
+	admittokens -= 1;
+	mAdmitSlots[token] = now + msec;
+	admitstats.slots = mAdmitSlots.size();
+	admitretry(userindex, msec);
+	return false;
+}
+
+void admitsweep()
+{
+	if (mAdmitSlots.empty())
+		return;
+
+	uint64_t now = clockmsec();
+	for (auto iter = mAdmitSlots.begin(); iter != mAdmitSlots.end();) {
+		if (now > iter->second + ADMIT_SLOT_MSEC)
+			iter = mAdmitSlots.erase(iter);
+		else
+			iter++;
+	}
+	admitstats.slots = mAdmitSlots.size();
+}
+
+const _ADMIT_STATS& getadmitstats()
+{
+	return admitstats;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+// admission of the token logins that resume a table. after a network blip or a restart the clients log
+// in again all at once, and every resume moves its connection and sends the whole table over. a bucket
+// of "Resume Rate" tokens a second, "Resume Burst" deep, spreads them: a login over it is handed a slot
+// of its own further on and told with _PMSG_RETRY_INFO to come back then. the bucket pays for the slot
+// right away so the slots never overlap, and a client back in time for its slot goes in without another
+// token. a player whose turn it is holds up its table and goes in at once, its token moves the slots
+// handed out after it back. loop 0 only
+
+#define ADMIT_EARLY_MSEC 100	// a client this early for its slot goes in
+#define ADMIT_SLOT_MSEC 10000	// a slot not taken by this long after it is given up
+#define ADMIT_MAX_RETRY_MSEC 30000	// no slot further than this, a login past it is only told to wait that long
+
+struct _ADMIT_STATS
+{
+	std::atomic<uint64_t> admitted;
+	std::atomic<uint64_t> urgent;	// went in over the bucket, their table waited on them
+	std::atomic<uint64_t> deferred;
+	std::atomic<uint64_t> slots;	// handed out and not taken yet
+};
+
+// false when the login of userindex is to come back later, the hint is sent then. token is the guiid
+// of the session it resumes
+bool admitresume(uintptr_t userindex, int64_t token, bool isurgent);
+void admitsweep();	// from the loop tick
+const _ADMIT_STATS& getadmitstats();
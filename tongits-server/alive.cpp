@@ -0,0 +1,103 @@
+#include "alive.h"
+#include "user.h"
+#include "conf.h"
+#include "socket.h"
+
+struct _ALIVE_WHEEL
+{
+	std::vector<uintptr_t> slots[ALIVE_WHEEL_SLOTS];
+	uint64_t cursor;	// the last slot number looked at, clockmsec / ALIVE_SLOT_MSEC
+};
+
+static thread_local _ALIVE_WHEEL wheel;	// of the calling loop
+
+// into the slot of the deadline, a due one goes to the next slot looked at
+static void aliveinsert(uintptr_t userindex, uint64_t deadline)
+{
+	uint64_t slot = deadline / ALIVE_SLOT_MSEC;
+
+	if (slot <= wheel.cursor)
+		slot = wheel.cursor + 1;
+	wheel.slots[slot % ALIVE_WHEEL_SLOTS].push_back(userindex);
+}
+
+static uint64_t alivetimeout()
+{
+	return (uint64_t)c.getalivetimeout() * 1000;
+}
+
+void aliveadd(uintptr_t userindex)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || userinfo->isbot || userinfo->isalivequeued)
+		return;
+
+	userinfo->isalivequeued = true;
+	if (userinfo->alivetick == 0)
+		userinfo->alivetick = clockmsec();
+
+	// owner of the connection, the entry follows it there on its next check otherwise
+	int loop = userinfo->packetdata.loop;
+	uint64_t deadline = userinfo->alivetick + alivetimeout();
+	if (loop == le_getloop())
+		aliveinsert(userindex, deadline);
+	else
+		le_postloop(loop, [userindex, deadline]() { aliveinsert(userindex, deadline); });
+}
+
+// false when the entry is done with, a slot freed since has another generation and is not touched
+static bool alivecheckuser(uintptr_t userindex, uint64_t& deadline)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || !userinfo->isalivequeued)
+		return false;
+
+	int loop = userinfo->packetdata.loop;
+	if (loop != le_getloop()) {
+		uint64_t next = clockmsec();
+		le_postloop(loop, [userindex, next]() { aliveinsert(userindex, next); });
+		return false;
+	}
+
+	// a session waiting for its player has no connection to time out, the resume brings one
+	if (userinfo->packetdata.bev == NULL || userinfo->isdc() || !(userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED)) {
+		deadline = clockmsec() + alivetimeout();
+		return true;
+	}
+
+	deadline = userinfo->alivetick + alivetimeout();
+	if (clockmsec() < deadline)
+		return true;
+
+	MSGLOG(eMSGTYPE::DEBUG, "alive, userindex %llu silent for %llu ms, closed.", userindex, clockmsec() - userinfo->alivetick);
+	le_closeuser(userindex);
+
+	// still there as a session to resume, its next connection is checked from here on
+	if (guser.getuser(userindex) == NULL)
+		return false;
+	deadline = clockmsec() + alivetimeout();
+	return true;
+}
+
+void alivecheck()
+{
+	static thread_local std::vector<uintptr_t> vdue;
+	uint64_t now = clockmsec() / ALIVE_SLOT_MSEC;
+
+	if (wheel.cursor == 0 || now - wheel.cursor > ALIVE_WHEEL_SLOTS)
+		wheel.cursor = (now > ALIVE_WHEEL_SLOTS) ? now - ALIVE_WHEEL_SLOTS : 0;
+
+	while (wheel.cursor < now) {
+		wheel.cursor++;
+		vdue.clear();
+		std::swap(vdue, wheel.slots[wheel.cursor % ALIVE_WHEEL_SLOTS]);
+
+		for (size_t n = 0; n < vdue.size(); n++) {
+			uint64_t deadline = 0;
+			if (alivecheckuser(vdue[n], deadline))
+				aliveinsert(vdue[n], deadline);
+		}
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+// silent connections. every inbound read renews _USER_INFO::alivetick, nothing else, and each loop keeps
+// its connections in a wheel of ALIVE_WHEEL_SLOTS slots of ALIVE_SLOT_MSEC. the loop tick only looks at
+// the slots that came due, an entry whose player was heard since moves on to the slot of its new
+// deadline, one that belongs to another loop now is handed to that loop, and one silent for "Alive
+// Timeout Seconds" is closed like a dropped connection, so a seated player goes to disconnected() and
+// the table decides about the resume without waiting for tcp to notice
+
+#define ALIVE_WHEEL_SLOTS 64
+#define ALIVE_SLOT_MSEC 1000
+#define ALIVE_DEFAULT_TIMEOUT_SEC 30
+
+void aliveadd(uintptr_t userindex);	// loop 0, a slot that got a connection, once until the slot is freed
+void alivecheck();	// from the loop tick, the due slots of the calling loop
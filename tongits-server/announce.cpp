@@ -0,0 +1,197 @@
+#include "announce.h"
+#include "common.h"
+#include "user.h"
+#include "socket.h"
+#include "seal.h"
+#include "wire.h"
+#include "websock.h"
+#include "stats.h"
+#include "packet.h"
+#include "replay.h"
+#include "../Common/loopwatch.h"
+#include <algorithm>
+
+// the packet in one encoding, freed by the last output buffer that sent it
+struct _ANNOUNCE_BLOCK
+{
+	std::atomic<int> refs;
+	std::vector<unsigned char> data;
+};
+
+struct _ANNOUNCE
+{
+	uintptr_t admin;
+	int aindex;
+	unsigned char states;
+	unsigned char ectype;
+	_ANNOUNCE_BLOCK* blocks[2];	// v1 and v2, each holds a reference until the walks are done
+	std::atomic<int> loops;	// still walking
+	std::atomic<int> users;	// reached so far
+	uint64_t start;	// statsusec
+};
+
+// one loop through the slots
+struct _ANNOUNCE_WALK
+{
+	_ANNOUNCE* a;
+	int loop;
+	int slot;	// next to look at
+	struct event* ev;
+};
+
+static void announcerelease(const void*, size_t, void* arg)
+{
+	_ANNOUNCE_BLOCK* block = (_ANNOUNCE_BLOCK*)arg;
+	if (block->refs.fetch_sub(1) == 1)
+		delete block;
+}
+
+static void announceanswer(uintptr_t admin, int aindex, _ANNOUNCE_RESULT result, int users)
+{
+	_PMSG_ANNOUNCE_ANS pMsg = { 0 };
+	pMsg.hdr.c = 0xC2;
+	pMsg.hdr.h = 0xF4;
+	pMsg.hdr.len[0] = SET_NUMBERH(sizeof(pMsg));
+	pMsg.hdr.len[1] = SET_NUMBERL(sizeof(pMsg));
+	pMsg.sub = 0x0B;
+	pMsg.aindex = aindex;
+	pMsg.result = (unsigned char)result;
+	pMsg.users = users;
+	::datasend(admin, (unsigned char*)&pMsg, sizeof(pMsg));
+}
+
+// a player of the walking loop the announcement is for
+static bool announceis(const _ANNOUNCE* a, _USER_INFO* userinfo, int loop)
+{
+	if (userinfo == NULL || userinfo->isbot || userinfo->packetdata.bev == NULL || userinfo->packetdata.loop != loop)
+		return false;
+	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED))
+		return false;
+	if ((userinfo->m_state & a->states) != a->states)
+		return false;
+	return a->ectype == ANNOUNCE_ANY_ECTYPE || userinfo->ectype == a->ectype;
+}
+
+static void announcewrite(_ANNOUNCE* a, _USER_INFO* userinfo)
+{
+	_ANNOUNCE_BLOCK* block = a->blocks[(userinfo->wirever == WIRE_V2) ? 1 : 0];
+	struct evbuffer* output = bufferevent_get_output(userinfo->packetdata.bev);
+
+	replayrecord(userinfo, a->blocks[0]->data.data(), (int)a->blocks[0]->data.size());
+
+	if (userinfo->packetdata.websocket == WS_OPEN) {
+		unsigned char header[WS_MAX_HEADER];
+		evbuffer_add(output, header, wsheader(header, (int)block->data.size()));
+	}
+
+	if (userinfo->packetdata.seal != NULL) {
+		sealwrite(userinfo->packetdata.seal, output, block->data.data(), block->data.size());
+		return;
+	}
+
+	block->refs++;
+	if (evbuffer_add_reference(output, block->data.data(), block->data.size(), announcerelease, block) != 0)
+		block->refs--;
+}
+
+// the last loop through answers and lets go of the blocks
+static void announcedone(_ANNOUNCE* a)
+{
+	if (a->loops.fetch_sub(1) != 1)
+		return;
+
+	int users = a->users.load();
+	MSGLOG(eMSGTYPE::INFO, "announce, %d players reached in %llu msec.", users, (unsigned long long)((statsusec() - a->start) / 1000));
+	if (a->admin != 0)
+		announceanswer(a->admin, a->aindex, _ANNOUNCE_RESULT::_OK, users);
+
+	for (int v = 0; v < 2; v++)
+		announcerelease(NULL, 0, a->blocks[v]);
+	delete a;
+}
+
+static void announcecb(evutil_socket_t, short, void* arg)
+{
+	clockrefresh();
+	_ANNOUNCE_WALK* walk = (_ANNOUNCE_WALK*)arg;
+	_LoopBusy busy("announce", walk->loop);
+	_ANNOUNCE* a = walk->a;
+	int slots = guser.getslots();
+	int end = std::min(walk->slot + ANNOUNCE_BATCH, slots);
+	int users = 0;
+
+	for (; walk->slot < end; walk->slot++) {
+		_USER_INFO* userinfo = guser.getuser(guser.gethandle(walk->slot));
+		if (!announceis(a, userinfo, walk->loop))
+			continue;
+		announcewrite(a, userinfo);
+		users++;
+	}
+	a->users += users;
+
+	if (walk->slot < slots) {
+		event_active(walk->ev, EV_READ, 0);
+		return;
+	}
+
+	event_free(walk->ev);
+	delete walk;
+	announcedone(a);
+}
+
+static void announcestart(_ANNOUNCE* a, int loop)
+{
+	struct event_base* base = le_getbase(loop);
+	_ANNOUNCE_WALK* walk = new _ANNOUNCE_WALK;
+
+	walk->a = a;
+	walk->loop = loop;
+	walk->slot = 1;	// slot 0 is nobody
+	walk->ev = event_new(base, -1, 0, announcecb, walk);
+	event_priority_set(walk->ev, event_base_get_npriorities(base) - 1);
+	event_active(walk->ev, EV_READ, 0);
+}
+
+void announce(uintptr_t admin, int aindex, unsigned char type, unsigned char states, unsigned char ectype, const char* msg)
+{
+	int loops = le_getloops();
+
+	if (msg == NULL || msg[0] == 0 || loops == 0) {
+		if (admin != 0)
+			announceanswer(admin, aindex, _ANNOUNCE_RESULT::_EMPTY, 0);
+		return;
+	}
+
+	_PMSG_NOTICEMSG pMsg = pkttemplate<_PMSG_NOTICEMSG>(0xF2, 0x00);
+	pMsg.type = type;
+	strncpy(pMsg.msg, msg, sizeof(pMsg.msg) - 1);
+
+	_ANNOUNCE* a = new _ANNOUNCE;
+	a->admin = admin;
+	a->aindex = aindex;
+	a->states = states;
+	a->ectype = ectype;
+	a->loops = loops;
+	a->users = 0;
+	a->start = statsusec();
+
+	for (int v = 0; v < 2; v++) {
+		a->blocks[v] = new _ANNOUNCE_BLOCK();
+		a->blocks[v]->refs = 1;
+	}
+	a->blocks[0]->data.assign((unsigned char*)&pMsg, (unsigned char*)&pMsg + pMsg.hdr.len);
+	if (!wireencode(a->blocks[0]->data.data(), (int)a->blocks[0]->data.size(), a->blocks[1]->data)) {
+		MSGLOG(eMSGTYPE::ERROR, "announce, wireencode failed.");
+		if (admin != 0)
+			announceanswer(admin, aindex, _ANNOUNCE_RESULT::_FAILED, 0);
+		for (int v = 0; v < 2; v++)
+			announcerelease(NULL, 0, a->blocks[v]);
+		delete a;
+		return;
+	}
+
+	MSGLOG(eMSGTYPE::INFO, "announce, \"%s\" to the players of %d loops, states 0x%X bet mode %d.", pMsg.msg, loops, states, ectype);
+
+	for (int loop = 0; loop < loops; loop++)
+		le_postloop(loop, [a, loop]() { announcestart(a, loop); });
+}
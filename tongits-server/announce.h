@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+// a text notice to every connected player, a maintenance warning and the like. the _PMSG_NOTICEMSG is
+// built once, encoded once per wire version and added to the output of each player by reference, a
+// sealed connection alone gets a copy sealed with its keys. every loop walks the user slots for the
+// connections it owns, ANNOUNCE_BATCH slots at a time from an event of the lowest priority, so the
+// frames and the tables of the loop go first between two batches. the admin who asked is answered
+// with the players reached once the last loop is through
+
+#define ANNOUNCE_BATCH 256	// slots a loop looks at before it gives way
+#define ANNOUNCE_ANY_ECTYPE 0xFF
+
+enum class _ANNOUNCE_RESULT : unsigned char
+{
+	_OK = 0,
+	_EMPTY,	// no text
+	_FAILED,	// it could not be encoded
+};
+
+// states, the _USER_STATE flags a player must all have, 0 for every connection. ectype, the bet mode
+// the player is in or ANNOUNCE_ANY_ECTYPE. admin 0 asks for no answer, any loop
+void announce(uintptr_t admin, int aindex, unsigned char type, unsigned char states, unsigned char ectype, const char* msg);
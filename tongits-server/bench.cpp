@@ -0,0 +1,481 @@
+#include "bench.h"
+#include "game.h"
+#include "user.h"
+#include "socket.h"
+#include "conf.h"
+#include "gpsindex.h"
+#include "bot.h"
+#include <algorithm>
+#include <random>
+
+#define BENCH_MIN_NSEC 20000000ULL	// iterations are doubled until a run takes this long
+#define BENCH_RUNS 5	// the fastest run is reported
+
+static const int benchsizes[] = { 6, 9, 13 };	// cards held by the player that acts
+
+// seat 0 holds the first size cards of its hand, every rule below finds its cards in the first six
+static const _PMSG_CARD_INFO benchhand[3][13] = {
+	{
+		{ 1, 7 }, { 2, 7 }, { 3, 7 },	// downed as a trio
+		{ 4, 9 },	// sapawed on the nines of seat 1
+		{ 1, 3 }, { 1, 4 },	// chowed with the five seat 2 dropped
+		{ 2, 1 }, { 3, 2 }, { 4, 4 }, { 2, 11 }, { 3, 12 }, { 4, 13 }, { 2, 5 },
+	},
+	{
+		{ 1, 1 }, { 1, 2 }, { 1, 6 }, { 1, 8 }, { 1, 10 }, { 1, 11 }, { 1, 12 }, { 1, 13 },
+		{ 2, 2 }, { 2, 4 }, { 2, 6 }, { 2, 8 }, { 0, 0 },
+	},
+	{
+		{ 2, 10 }, { 2, 12 }, { 2, 13 }, { 3, 1 }, { 3, 3 }, { 3, 4 }, { 3, 5 }, { 3, 6 },
+		{ 3, 8 }, { 3, 10 }, { 3, 11 }, { 3, 13 }, { 0, 0 },
+	},
+};
+
+static const _PMSG_CARD_INFO benchnines[3] = { { 1, 9 }, { 2, 9 }, { 3, 9 } };
+static const _PMSG_CARD_INFO benchdrop = { 1, 5 };
+
+static volatile uint64_t benchsink;
+static const char* benchfilter = NULL;
+
+static uint64_t benchnsec()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <class S, class F>
+static uint64_t benchtime(S& setup, F& op, uint64_t iters, bool isop)
+{
+	uint64_t start = benchnsec();
+
+	for (uint64_t n = 0; n < iters; n++) {
+		setup();
+		if (isop)
+			op();
+	}
+	return benchnsec() - start;
+}
+
+// the setup runs before every call and is timed alone as well, only the difference is reported
+template <class S, class F>
+static void benchrun(const char* name, int size, S setup, F op)
+{
+	if (benchfilter != NULL && strstr(name, benchfilter) == NULL)
+		return;
+
+	setup();
+	if (!op()) {
+		printf("%-24s %5d rejected, the dealt table does not allow it\n", name, size);
+		return;
+	}
+
+	uint64_t iters = 64;
+	while (benchtime(setup, op, iters, true) < BENCH_MIN_NSEC)
+		iters *= 2;
+
+	uint64_t best = UINT64_MAX, base = UINT64_MAX;
+	for (int n = 0; n < BENCH_RUNS; n++) {
+		best = std::min(best, benchtime(setup, op, iters, true));
+		base = std::min(base, benchtime(setup, op, iters, false));
+	}
+
+	double nsec = (best > base) ? (double)(best - base) / iters : 0;
+	if (size > 0)
+		printf("%-24s %5d %12.1f %12llu\n", name, size, nsec, (unsigned long long)iters);
+	else
+		printf("%-24s %5s %12.1f %12llu\n", name, "-", nsec, (unsigned long long)iters);
+}
+
+// a table of three players that never had a connection, their packets pile up in the unread end of a pair
+class gamebench
+{
+public:
+	gamebench();
+	~gamebench();
+
+	void run();
+
+private:
+	void deal(int size);
+	void restore(int status);
+
+	game* g;
+	struct event_base* base;
+	struct bufferevent* pairs[MAX_USER_POS][2];
+	uintptr_t users[MAX_USER_POS];
+	_USER_CARD_INFO saved[MAX_USER_POS];
+	_DROP_PILE saveddropped;
+};
+
+gamebench::gamebench()
+{
+	this->base = event_base_new();
+	this->g = new game();
+	this->g->loadgameconf();
+	this->g->setgameserial(1);
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		uintptr_t userindex = guser.getuserindex(true);
+		_USER_INFO* userinfo = guser.getuser(userindex);
+
+		bufferevent_pair_new(this->base, 0, this->pairs[i]);
+		userinfo->isfreeuser = false;
+		userinfo->account = "bench" + std::to_string(i);
+		userinfo->name = userinfo->account;
+		userinfo->setstate((unsigned char)_USER_STATE::_CONNECTED | (unsigned char)_USER_STATE::_LOGGEDIN | (unsigned char)_USER_STATE::_PLAYING);
+		userinfo->m_gamepos = i;
+		userinfo->packetdata.bev = this->pairs[i][0];
+		userinfo->packetdata.loop = le_getloop();	// no loop runs, a send is written right away instead of posted
+		this->users[i] = userindex;
+		this->g->m_users[i] = userindex;
+	}
+}
+
+gamebench::~gamebench()
+{
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(this->users[i]);
+		userinfo->packetdata.bev = NULL;
+		userinfo->setstate((unsigned char)_USER_STATE::_NONE);
+		userinfo->isfreeuser = true;
+		bufferevent_free(this->pairs[i][0]);
+		bufferevent_free(this->pairs[i][1]);
+	}
+	delete this->g;
+	event_base_free(this->base);
+}
+
+// a started round with seat 0 to act, seat 1 has downed its nines and seat 2 dropped the five of type 1
+void gamebench::deal(int size)
+{
+	game* g = this->g;
+
+	g->reset();
+	metricsgamestate((int)g->m_state, (int)_GAME_STATE::_STARTED);
+	g->m_state = _GAME_STATE::_STARTED;
+	g->m_active_pos = 0;
+	g->m_active_userindex = (int)this->users[0];
+	g->m_active_status = (int)_ACTIVE_STATE::_NONE;
+	g->m_hitter = 0;
+	g->m_hitprizeecoins = 0;
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		guser.getuser(this->users[i])->reset();
+		for (int n = 0; n < ((i == 0) ? size : 12); n++)
+			g->pushusercard(i, benchhand[i][n]);
+	}
+
+	_MELD nines;
+	for (int n = 0; n < 3; n++)
+		nines.push_back(benchnines[n]);
+	g->adddowncards(this->users[1], nines);
+
+	_DROPCARD_INFO drop;
+	drop.card = benchdrop;
+	drop.pos = 0;
+	drop.userpos = 2;
+	g->vDroppedCards.push_back(drop);
+	g->m_dropcardctr = 1;
+
+	for (int i = 0; i < MAX_USER_POS; i++)
+		this->saved[i] = g->m_usercardinfo[i];
+	this->saveddropped = g->vDroppedCards;
+	this->restore((int)_ACTIVE_STATE::_NONE);
+}
+
+void gamebench::restore(int status)
+{
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		struct evbuffer* output = bufferevent_get_output(this->pairs[i][0]);
+		this->g->m_usercardinfo[i] = this->saved[i];
+		guser.getuser(this->users[i])->reset();
+		evbuffer_drain(output, evbuffer_get_length(output));
+	}
+	guser.getuser(this->users[1])->m_isdowncard = true;
+	this->g->vDroppedCards = this->saveddropped;
+	this->g->m_active_status = status;
+	this->g->m_winner = 0;
+}
+
+void gamebench::run()
+{
+	game* g = this->g;
+	uintptr_t active = this->users[0];
+	unsigned char* hand = (unsigned char*)benchhand[0];
+
+	benchrun("shufflecards", 0, [g]() {
+		g->vStockCards.clear();
+		g->m_stocktop = 0;
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			g->m_usercardinfo[i].user.clear();
+			g->m_usercardinfo[i].mask = 0;
+			memset(&g->m_usercardinfo[i].count, 0, sizeof(_USER_CARD_COUNT));
+		}
+	}, [g]() { g->shufflecards(); return true; });
+
+	for (int size : benchsizes) {
+		this->deal(size);
+		benchrun("countusercards", size, []() {}, [g, active]() { g->countusercards(active); return true; });
+	}
+
+	this->deal(13);
+	benchrun("isactionvalid", 0, [this, g]() {
+		g->m_active_status = (int)_ACTIVE_STATE::_DRAWN;
+		guser.getuser(this->users[0])->lastactiontick = 0;
+	}, [g, active]() { return g->isactionvalid(active, _ACTIONS::_DROP); });
+
+	for (int size : benchsizes) {
+		this->deal(size);
+		benchrun("downcards", size, [this]() { this->restore((int)_ACTIVE_STATE::_DRAWN); },
+			[g, active, hand]() { return g->downcards(active, 3, hand); });
+	}
+
+	for (int size : benchsizes) {
+		this->deal(size);
+		benchrun("sapawcard", size, [this]() { this->restore((int)_ACTIVE_STATE::_DRAWN); },
+			[g, active, hand]() { return g->sapawcard(active, 1, 0, 1, hand + 3 * sizeof(_PMSG_CARD_INFO)); });
+	}
+
+	for (int size : benchsizes) {
+		this->deal(size);
+		benchrun("chowcard", size, [this]() { this->restore((int)_ACTIVE_STATE::_NONE); },
+			[g, active, hand]() {
+			unsigned char pos[2] = { benchdrop.cardtype, benchdrop.cardnum };
+			return g->chowcard(active, 2, pos, 2, hand + 4 * sizeof(_PMSG_CARD_INFO));
+		});
+	}
+
+	this->deal(13);
+	benchrun("getwinner", 0, [this, g]() {
+		this->restore((int)_ACTIVE_STATE::_DRAWN);
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			guser.getuser(this->users[i])->ecoins[g->getgametype()] = 1000000;
+			g->countusercards(this->users[i]);
+		}
+		g->m_winner = this->users[0];
+		g->m_hitter = 0;
+		g->m_hitprizeecoins = 0;
+	}, [g]() { g->getwinner(); return true; });
+}
+
+// how the rules checked a selection before the masks, a sorted copy and one pass for each kind of meld
+static bool benchvecmeld(const _PMSG_CARD_INFO* cards, int count)
+{
+	std::vector<_PMSG_CARD_INFO> v(cards, cards + count);
+	bool issamenumber = true;
+	bool issametype = true;
+
+	std::sort(v.begin(), v.end(), [](const _PMSG_CARD_INFO& a, const _PMSG_CARD_INFO& b) { return a.cardnum < b.cardnum; });
+
+	for (size_t n = 1; n < v.size(); n++) {
+		if (v[n].cardnum != v[0].cardnum)
+			issamenumber = false;
+		if (v[n].cardtype != v[0].cardtype || v[n].cardnum != v[n - 1].cardnum + 1)
+			issametype = false;
+	}
+	return v.size() >= 3 && (issamenumber || issametype);
+}
+
+static bool benchmaskmeld(const _PMSG_CARD_INFO* cards, int count)
+{
+	_CARD_MASK mask = 0;
+
+	for (int n = 0; n < count; n++)
+		mask |= cardmask(cards[n].cardtype, cards[n].cardnum);
+	return cardpopcount(mask) == count && cardismeld(mask);
+}
+
+// the old vector kept next to the mask and inline list the server holds cards in now
+static void benchhandops()
+{
+	_PMSG_CARD_INFO run[MAX_CARDS_PER_TYPE];
+	for (int n = 0; n < MAX_CARDS_PER_TYPE; n++) {
+		run[n].cardtype = 2;
+		run[n].cardnum = MAX_CARDS_PER_TYPE - n;	// unsorted, the way a player selects
+	}
+
+	for (int size : benchsizes) {
+		benchrun("meld vector", size, []() {}, [&run, size]() { return benchvecmeld(run, size); });
+		benchrun("meld mask", size, []() {}, [&run, size]() { return benchmaskmeld(run, size); });
+	}
+
+	for (int size : benchsizes) {
+		std::vector<_PMSG_CARD_INFO> v(benchhand[0], benchhand[0] + size);
+		_CARD_MASK mask = 0;
+		for (int n = 0; n < size; n++)
+			mask |= cardmask(benchhand[0][n].cardtype, benchhand[0][n].cardnum);
+
+		benchrun("points vector", size, []() {}, [&v]() {
+			int points = 0;
+			for (size_t n = 0; n < v.size(); n++)
+				points += (v[n].cardnum > 10) ? 10 : v[n].cardnum;
+			benchsink += points;
+			return true;
+		});
+		benchrun("points mask", size, []() {}, [&mask]() { benchsink += cardpoints(mask); return true; });
+	}
+
+	for (int size : benchsizes) {
+		_CARD_MASK mask = 0;
+		for (int n = 0; n < size; n++)
+			mask |= cardmask(benchhand[0][n].cardtype, benchhand[0][n].cardnum);
+
+		benchrun("botdiscards", size, []() {}, [mask]() {
+			_BOT_DISCARD discards[MAX_DECK_CARDS];
+			benchsink += botdiscards(mask, discards);
+			return true;
+		});
+	}
+
+	// seat 0 about to drop from the 13 cards of its hand, the other hands and the stock unseen. a round
+	// plays a deal out once for every candidate, ns/op over the candidates is the time of one rollout
+	_BOT_VIEW view;
+	memset(&view, 0, sizeof(view));
+	for (int n = 0; n < 13; n++)
+		view.hand |= cardmask(benchhand[0][n].cardtype, benchhand[0][n].cardnum);
+	view.unseen = ~view.hand & (((_CARD_MASK)1 << MAX_DECK_CARDS) - 1);
+	view.handcounts[0] = 13;
+	view.handcounts[1] = 12;
+	view.handcounts[2] = 12;
+	view.stockcount = MAX_DECK_CARDS - 13 - 24;
+	_BOT_DISCARD discards[MAX_DECK_CARDS];
+	view.candidatecount = std::min(botdiscards(view.hand, discards), BOT_ROLLOUT_CANDIDATES);
+	for (int n = 0; n < view.candidatecount; n++)
+		view.candidates[n] = cardmask(discards[n].card.cardtype, discards[n].card.cardnum);
+
+	_CARD_RNG dealrng;
+	dealrng.seed();
+	benchrun("botrolloutround", view.candidatecount, []() {}, [&view, &dealrng]() {
+		uint32_t wins[BOT_ROLLOUT_CANDIDATES] = { 0 };
+		botrolloutround(view, dealrng, wins);
+		benchsink += wins[0];
+		return true;
+	});
+
+	// a hand dealt then a card taken from the middle of it
+	for (int size : benchsizes) {
+		benchrun("hand vector", size, []() {}, [size]() {
+			std::vector<_PMSG_CARD_INFO> v;
+			for (int n = 0; n < size; n++)
+				v.push_back(benchhand[0][n]);
+			for (std::vector<_PMSG_CARD_INFO>::iterator iter = v.begin(); iter != v.end(); iter++) {
+				if (iter->cardtype == benchhand[0][size / 2].cardtype && iter->cardnum == benchhand[0][size / 2].cardnum) {
+					v.erase(iter);
+					break;
+				}
+			}
+			benchsink += v.size();
+			return true;
+		});
+		benchrun("hand inline", size, []() {}, [size]() {
+			_CARD_PILE pile;
+			_CARD_MASK mask = 0;
+			for (int n = 0; n < size; n++) {
+				pile.push_back(benchhand[0][n]);
+				mask |= cardmask(benchhand[0][n].cardtype, benchhand[0][n].cardnum);
+			}
+			_CARD_MASK m = cardmask(benchhand[0][size / 2].cardtype, benchhand[0][size / 2].cardnum);
+			if (mask & m) {
+				mask &= ~m;
+				for (_CARD_PILE::iterator iter = pile.begin(); iter != pile.end(); iter++) {
+					if (iter->cardtype == benchhand[0][size / 2].cardtype && iter->cardnum == benchhand[0][size / 2].cardnum) {
+						pile.erase(iter);
+						break;
+					}
+				}
+			}
+			benchsink += pile.size() + cardpopcount(mask);
+			return true;
+		});
+	}
+
+	std::mt19937 mt((unsigned int)benchnsec());
+	_CARD_RNG rng;
+	rng.seed();
+
+	benchrun("shuffle vector", 0, []() {}, [&mt]() {
+		std::vector<_PMSG_CARD_INFO> v;
+		for (int i = 0; i < MAX_CARD_TYPE; i++) {
+			for (int n = 1; n <= MAX_CARDS_PER_TYPE; n++)
+				v.push_back({ (unsigned char)(i + 1), (unsigned char)n });
+		}
+		std::shuffle(v.begin(), v.end(), mt);
+		benchsink += v[0].cardnum;
+		return true;
+	});
+	benchrun("shuffle inline", 0, []() {}, [&rng]() {
+		_CARD_PILE pile;
+		for (int i = 0; i < MAX_CARD_TYPE; i++) {
+			for (int n = 1; n <= MAX_CARDS_PER_TYPE; n++)
+				pile.push_back({ (unsigned char)(i + 1), (unsigned char)n });
+		}
+		rng.shuffle(pile.begin(), (int)pile.size());
+		benchsink += pile[0].cardnum;
+		return true;
+	});
+}
+
+// the distance in km the join check used to take for every pair, against the dot product it takes now
+static void benchgps()
+{
+	static _USER_INFO positions[64];
+	std::mt19937 mt(1);
+	int n = 0;
+
+	for (int i = 0; i < 64; i++)
+		guser.setgps(&positions[i], (double)(mt() % 180000) / 1000.0 - 90.0, (double)(mt() % 360000) / 1000.0 - 180.0);
+
+	benchrun("getdistancegps", 0, []() {}, [&n]() {
+		_USER_INFO& a = positions[n++ & 63];
+		_USER_INFO& b = positions[n & 63];
+		benchsink += guser.getdistancegps(a.gps.latitude, a.gps.longitude, b.gps.latitude, b.gps.longitude) < c.getgpslimitdis();
+		return true;
+	});
+	benchrun("isgpsnear", 0, []() {}, [&n]() {
+		_USER_INFO& a = positions[n++ & 63];
+		_USER_INFO& b = positions[n & 63];
+		benchsink += guser.isgpsnear(&a, &b);
+		return true;
+	});
+
+	// who is close to one player of a city full of them, every pair of the crowd against the grid
+	static _USER_INFO crowd[4096];
+	std::vector<uintptr_t> near;
+
+	for (int i = 0; i < 4096; i++) {
+		guser.setgps(&crowd[i], 14.0 + (double)(mt() % 100000) / 100000.0, 120.5 + (double)(mt() % 100000) / 100000.0);
+		gpsindexupdate(i + 1, crowd[i].gps);
+	}
+	benchrun("isgpsnear 4096", 0, []() {}, [&n]() {
+		_USER_INFO& a = crowd[n++ & 4095];
+		for (int i = 0; i < 4096; i++)
+			benchsink += guser.isgpsnear(&a, &crowd[i]);
+		return true;
+	});
+	benchrun("gpsindexnear 4096", 0, []() {}, [&n, &near]() {
+		near.clear();
+		gpsindexnear(crowd[n & 4095].gps, (n & 4095) + 1, near);
+		n++;
+		benchsink += near.size();
+		return true;
+	});
+	for (int i = 0; i < 4096; i++)
+		gpsindexremove(i + 1);
+}
+
+int benchmain(const char* filter)
+{
+	benchfilter = filter;
+	clockrefresh();
+	botsearchinit();
+
+	printf("%-24s %5s %12s %12s\n", "benchmark", "cards", "ns/op", "iterations");
+
+	gamebench* bench = new gamebench();
+	bench->run();
+	delete bench;
+
+	benchhandops();
+	benchgps();
+	return 0;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// micro benchmarks of the game rules and the hand operations, run with tongits-server --bench [filter].
+// each one runs on a table of three synthetic players whose packets go to a buffer that is thrown away,
+// so a number covers the rule, the bookkeeping and the packet building of the real call. the hand
+// operations are also timed on a plain vector the way the server used to keep cards, next to the mask
+// and inline list it keeps them in now
+
+int benchmain(const char* filter);
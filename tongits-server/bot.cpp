@@ -0,0 +1,106 @@
+#include "bot.h"
+
+#define CARD_SUIT_MASK (((_CARD_MASK)1 << MAX_CARDS_PER_TYPE) - 1)
+
+_CARD_MASK botbestmeld(_CARD_MASK hand)
+{
+	_CARD_MASK best = 0;
+	int bestpoints = 0;
+
+	// trios and quadras, a quadra is kept whole
+	for (int num = 1; num <= MAX_CARDS_PER_TYPE; num++) {
+		_CARD_MASK m = hand & CARD_RANK_MASK(num);
+		if (cardpopcount(m) < 3)
+			continue;
+		int points = cardpoints(m);
+		if (points > bestpoints) {
+			best = m;
+			bestpoints = points;
+		}
+	}
+
+	// every stretch of 3 or more numbers in a row of one type
+	for (int type = 0; type < MAX_CARD_TYPE; type++) {
+		int shift = type * MAX_CARDS_PER_TYPE;
+		int nums = (int)((hand >> shift) & CARD_SUIT_MASK);
+		int low = 0;
+
+		while (low < MAX_CARDS_PER_TYPE) {
+			if (((nums >> low) & 1) == 0) {
+				low++;
+				continue;
+			}
+
+			int len = 0;
+			while (low + len < MAX_CARDS_PER_TYPE && ((nums >> (low + len)) & 1))
+				len++;
+
+			if (len >= 3) {
+				_CARD_MASK m = (((_CARD_MASK)1 << len) - 1) << (shift + low);
+				int points = cardpoints(m);
+				if (points > bestpoints) {
+					best = m;
+					bestpoints = points;
+				}
+			}
+			low += len;
+		}
+	}
+
+	return best;
+}
+
+_CARD_MASK botchowmeld(_CARD_MASK hand, _CARD_MASK card)
+{
+	_CARD_MASK all = hand | card;
+	int bit = cardlowbit(card);
+	int num = bit % MAX_CARDS_PER_TYPE;
+	_CARD_MASK best = 0;
+
+	_CARD_MASK set = all & CARD_RANK_MASK(num + 1);
+	if (cardpopcount(set) >= 3)
+		best = set;
+
+	// the stretch of its type the card sits in
+	int low = bit, high = bit;
+	while (low % MAX_CARDS_PER_TYPE > 0 && ((all >> (low - 1)) & 1))
+		low--;
+	while (high % MAX_CARDS_PER_TYPE < MAX_CARDS_PER_TYPE - 1 && ((all >> (high + 1)) & 1))
+		high++;
+
+	if (high - low >= 2) {
+		_CARD_MASK run = (((_CARD_MASK)1 << (high - low + 1)) - 1) << low;
+		if (cardpoints(run) > cardpoints(best))
+			best = run;
+	}
+
+	return best;
+}
+
+int botdropkey(_CARD_MASK hand, int bit)
+{
+	int num = bit % MAX_CARDS_PER_TYPE;
+	_CARD_MASK suit = CARD_SUIT_MASK << (bit - num);
+
+	// a card of the same number, or of the same type up to two numbers away, could still make a meld
+	_CARD_MASK near = ((((_CARD_MASK)0x1b << bit) >> 2) & suit) | CARD_RANK_MASK(num + 1);
+	bool ispaired = (hand & near & ~((_CARD_MASK)1 << bit)) != 0;
+	int points = (num + 1 > 10) ? 10 : num + 1;
+
+	// loose cards first, then the most points
+	return ((ispaired ? 0 : 1) << 16) | (points << 8) | bit;
+}
+
+int botcardlist(_CARD_MASK mask, _PMSG_CARD_INFO* cards)
+{
+	int count = 0;
+
+	for (; mask != 0; mask &= mask - 1) {
+		int bit = cardlowbit(mask);
+		cards[count].cardtype = (unsigned char)(bit / MAX_CARDS_PER_TYPE + 1);
+		cards[count].cardnum = (unsigned char)(bit % MAX_CARDS_PER_TYPE + 1);
+		count++;
+	}
+
+	return count;
+}
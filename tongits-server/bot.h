@@ -0,0 +1,100 @@
+#pragma once
+#include "game.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// in-process players that take the empty seats of a table once a player waited "Bot Fill Seconds" in
+// the match queue. a bot has a user slot without a connection and never touches the database. its turn
+// is played by the table's own timer with game::autoplay, which also plays the turn of a player who
+// timed out or is gone: chow the last drop when it makes a meld or draw, down the best meld, sapaw what
+// fits, then drop the card that leaves the fewest points out of melds and group the melds that leave them,
+// all worked out on the card mask of the hand
+
+#define BOT_DEFAULT_THINK_MSEC 1500
+#define BOT_DEFAULT_ECOINS 1000000
+#define BOT_FIGHT_POINTS 10	// a bot fights or answers a fight with no more hand points than this
+#define BOT_MAX_MELDS 4	// in a hand of 14 cards, the most a player holds before the drop
+#define BOT_ROLLOUT_CANDIDATES 6	// the drops with the least deadwood the rollouts weigh against each other
+
+// a card of the hand tried as the drop, the points the rest leaves out of its best melds and those melds
+struct _BOT_DISCARD
+{
+	_PMSG_CARD_INFO card;
+	int deadwood;
+	int meldcount;
+	_CARD_MASK melds[BOT_MAX_MELDS];
+};
+
+// the meld of a hand with the most points, a whole set or the longest stretch of a run, 0 when there is none
+_CARD_MASK botbestmeld(_CARD_MASK hand);
+
+// the best meld the card makes with the hand, the card included, 0 when it makes none
+_CARD_MASK botchowmeld(_CARD_MASK hand, _CARD_MASK card);
+
+// of two drops that leave the same points, the one with the higher key goes: a card with nothing near it
+// to make a meld with before one that has, then the card worth more
+int botdropkey(_CARD_MASK hand, int bit);
+
+// botsearch.cpp, the exhaustive search over the partitions of a hand into disjoint melds. every card of
+// the hand is tried as the drop at once, four a vector with avx2, two with neon, one at a time otherwise
+void botsearchinit();	// at startup, picks the backend
+const char* botsearchbackend();
+// the points of the hand its best partition leaves out, the melds of that partition in melds
+int botdeadwood(_CARD_MASK hand, _CARD_MASK* melds, int& meldcount);
+// every card of the hand as the drop, the one that leaves the fewest points first
+int botdiscards(_CARD_MASK hand, _BOT_DISCARD* discards);
+
+// the cards of a mask as the card list the game actions take
+int botcardlist(_CARD_MASK mask, _PMSG_CARD_INFO* cards);
+
+// botrollout.cpp, the bots that weigh their drop with determinized monte carlo rollouts. the cards the seat
+// does not see, the stock and the other hands, are dealt again at random for every round and the hand is
+// played out with the greedy play of autoplay once for every candidate drop. the rounds run on the task
+// pool, one task a pool thread, until "Bot Rollout Msec" from the start is up. the drop that won the most
+// rounds goes back to the loop of the table, which wakes it to play the drop
+
+// the table as the seat about to drop knows it
+struct _BOT_VIEW
+{
+	int seat;
+	_CARD_MASK hand;
+	_CARD_MASK unseen;	// the stock and the other hands
+	int handcounts[MAX_USER_POS];
+	int stockcount;
+	bool isdown[MAX_USER_POS];	// may win the count when the stock is out
+	_CARD_MASK downs[MAX_MELDS];	// of every seat, sapaw goes onto any of them
+	int downcount;
+	_CARD_MASK candidates[BOT_ROLLOUT_CANDIDATES];
+	int candidatecount;
+};
+
+// the rollouts of one turn, shared by the table and the tasks. when the table lets go of it before the
+// tasks are done, g is NULL and their result is thrown away
+struct _BOT_ROLLOUT
+{
+	game* g;	// loop of the table only
+	uintptr_t userindex;
+	int hands;	// m_hands of the table when the turn began
+	bool isdone;
+	int best;	// index into view.candidates
+	_BOT_VIEW view;
+	uint64_t deadline;	// statsusec
+	std::vector<uint32_t> wins;	// candidatecount a task
+	std::vector<uint32_t> rounds;	// one a task
+	std::atomic<int> pending;
+};
+
+struct _BOT_ROLLOUT_STATS
+{
+	std::atomic<uint64_t> moves;
+	std::atomic<uint64_t> rounds;
+	std::atomic<uint64_t> rollouts;	// a round plays one a candidate
+	std::atomic<uint64_t> usec;	// of the pool threads, rollouts per core second come from it
+};
+
+// one deal of the unseen cards played out once for every candidate, wins counts the ones the seat won
+void botrolloutround(const _BOT_VIEW& view, _CARD_RNG& rng, uint32_t* wins);
+// submits the tasks of the search, done may already be set when it returns without a pool
+void botrolloutstart(const std::shared_ptr<_BOT_ROLLOUT>& rollout, int msec, _CARD_RNG& rng);
+const _BOT_ROLLOUT_STATS& getbotrolloutstats();
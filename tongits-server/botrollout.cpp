@@ -0,0 +1,216 @@
+#include "bot.h"
+#include "stats.h"
+#include "taskpool.h"
+#include <algorithm>
+
+static _BOT_ROLLOUT_STATS botrolloutstats;
+
+// a deal being played out, the hands and the downs as the turns change them
+struct _BOT_PLAYOUT
+{
+	_CARD_MASK hands[MAX_USER_POS];
+	bool isdown[MAX_USER_POS];
+	_CARD_MASK downs[MAX_MELDS];
+	int downcount;
+	const _CARD_MASK* stock;
+	int stockcount;
+};
+
+// the lowest deadwood of the seats that went down, of every seat when none did. a tie goes to the seat
+// that drew last and then to the one before it, as procstate_started counts
+static int botplayoutcount(_BOT_PLAYOUT& p, int last)
+{
+	bool isanydown = p.isdown[0] || p.isdown[1] || p.isdown[2];
+	int winner = -1;
+	int best = 0;
+
+	for (int n = 0; n < MAX_USER_POS; n++) {
+		int seat = (last + MAX_USER_POS - n) % MAX_USER_POS;
+		if (isanydown && !p.isdown[seat])
+			continue;
+
+		_CARD_MASK melds[BOT_MAX_MELDS];
+		int meldcount;
+		int deadwood = botdeadwood(p.hands[seat], melds, meldcount);
+		if (winner < 0 || deadwood < best) {
+			winner = seat;
+			best = deadwood;
+		}
+	}
+	return winner;
+}
+
+// the turns of autoplay from the seat after the drop until the hand is over, the seat that won it with
+// the tongits of an empty hand or the count when the stock is out
+static int botplayout(_BOT_PLAYOUT& p, int seat, _CARD_MASK drop)
+{
+	int stocktop = 0;
+
+	while (true) {
+		seat = (seat + 1) % MAX_USER_POS;
+		_CARD_MASK& hand = p.hands[seat];
+
+		_CARD_MASK meld = (drop != 0) ? botchowmeld(hand, drop) : 0;
+		if (meld != 0) {
+			hand = (hand | drop) & ~meld;
+			p.downs[p.downcount++] = meld;
+			p.isdown[seat] = true;
+		}
+		else {
+			hand |= p.stock[stocktop++];
+		}
+
+		if (!p.isdown[seat] && hand != 0) {
+			meld = botbestmeld(hand);
+			if (meld != 0) {
+				hand &= ~meld;
+				p.downs[p.downcount++] = meld;
+				p.isdown[seat] = true;
+			}
+		}
+
+		bool issapaw = true;
+		while (issapaw && hand != 0) {
+			issapaw = false;
+			for (_CARD_MASK m = hand; m != 0 && !issapaw; m &= m - 1) {
+				_CARD_MASK card = m & (0 - m);
+				for (int n = 0; n < p.downcount && !issapaw; n++) {
+					if (!cardismeld(p.downs[n] | card))
+						continue;
+					p.downs[n] |= card;
+					hand &= ~card;
+					issapaw = true;
+				}
+			}
+		}
+
+		if (hand == 0)
+			return seat;
+
+		_BOT_DISCARD discards[MAX_DECK_CARDS];
+		botdiscards(hand, discards);
+		drop = cardmask(discards[0].card.cardtype, discards[0].card.cardnum);
+		hand &= ~drop;
+
+		if (hand == 0)
+			return seat;
+		if (stocktop == p.stockcount)
+			return botplayoutcount(p, seat);
+	}
+}
+
+void botrolloutround(const _BOT_VIEW& view, _CARD_RNG& rng, uint32_t* wins)
+{
+	_CARD_MASK cards[MAX_DECK_CARDS];
+	int count = 0;
+	for (_CARD_MASK m = view.unseen; m != 0; m &= m - 1)
+		cards[count++] = m & (0 - m);
+	rng.shuffle(cards, count);
+
+	// the same deal for every candidate, so the candidates differ by their drop and not by their luck
+	_BOT_PLAYOUT deal;
+	int next = 0;
+	for (int n = 0; n < MAX_USER_POS; n++) {
+		deal.hands[n] = 0;
+		deal.isdown[n] = view.isdown[n];
+		if (n == view.seat)
+			continue;
+		for (int i = 0; i < view.handcounts[n]; i++)
+			deal.hands[n] |= cards[next++];
+	}
+	memcpy(deal.downs, view.downs, sizeof(_CARD_MASK) * view.downcount);
+	deal.downcount = view.downcount;
+	deal.stock = cards + next;
+	deal.stockcount = view.stockcount;
+
+	for (int n = 0; n < view.candidatecount; n++) {
+		_BOT_PLAYOUT p = deal;
+		p.hands[view.seat] = view.hand & ~view.candidates[n];
+
+		// the drop itself may empty the hand or end the count
+		int winner;
+		if (p.hands[view.seat] == 0)
+			winner = view.seat;
+		else if (view.stockcount == 0)
+			winner = botplayoutcount(p, view.seat);
+		else
+			winner = botplayout(p, view.seat, view.candidates[n]);
+
+		if (winner == view.seat)
+			wins[n]++;
+	}
+}
+
+// the rounds of one task until the deadline, a task that starts after it plays none
+static void botrolloutwork(_BOT_ROLLOUT* rollout, int lane, _CARD_RNG rng)
+{
+	uint64_t start = statsusec();
+	uint32_t* wins = &rollout->wins[lane * BOT_ROLLOUT_CANDIDATES];
+	uint32_t rounds = 0;
+
+	uint64_t now = start;
+	while (now < rollout->deadline) {
+		botrolloutround(rollout->view, rng, wins);
+		rounds++;
+		now = statsusec();
+	}
+
+	rollout->rounds[lane] = rounds;
+	botrolloutstats.rounds += rounds;
+	botrolloutstats.rollouts += (uint64_t)rounds * rollout->view.candidatecount;
+	botrolloutstats.usec += now - start;
+}
+
+// the last task in picks the drop, the first candidate unless another won more rounds
+static void botrolloutdone(const std::shared_ptr<_BOT_ROLLOUT>& rollout)
+{
+	if (rollout->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	int lanes = (int)rollout->rounds.size();
+	uint32_t best = 0;
+	rollout->best = 0;
+	for (int n = 0; n < rollout->view.candidatecount; n++) {
+		uint32_t wins = 0;
+		for (int lane = 0; lane < lanes; lane++)
+			wins += rollout->wins[lane * BOT_ROLLOUT_CANDIDATES + n];
+		if (wins > best) {
+			best = wins;
+			rollout->best = n;
+		}
+	}
+
+	rollout->isdone = true;
+	botrolloutstats.moves++;
+	if (rollout->g != NULL)
+		rollout->g->schedule(0);
+}
+
+void botrolloutstart(const std::shared_ptr<_BOT_ROLLOUT>& rollout, int msec, _CARD_RNG& rng)
+{
+	int lanes = std::max(gettaskstats().threads, 1);
+
+	rollout->isdone = false;
+	rollout->best = 0;
+	rollout->deadline = statsusec() + (uint64_t)msec * 1000;
+	rollout->wins.assign((size_t)lanes * BOT_ROLLOUT_CANDIDATES, 0);
+	rollout->rounds.assign(lanes, 0);
+	rollout->pending = lanes;
+
+	// every task deals from its own generator, seeded off the one of the table
+	for (int lane = 0; lane < lanes; lane++) {
+		_CARD_RNG seeded;
+		do {
+			for (int i = 0; i < 4; i++)
+				seeded.s[i] = rng.next();
+		} while ((seeded.s[0] | seeded.s[1] | seeded.s[2] | seeded.s[3]) == 0);
+		tasksubmit(_TASK_LANE::_NORMAL,
+			[rollout, lane, seeded]() { botrolloutwork(rollout.get(), lane, seeded); },
+			[rollout]() { botrolloutdone(rollout); });
+	}
+}
+
+const _BOT_ROLLOUT_STATS& getbotrolloutstats()
+{
+	return botrolloutstats;
+}
@@ -0,0 +1,293 @@
+#include "bot.h"
+#include <vector>
+
+// the discard search of the bots. every way the hand splits into disjoint melds is listed once, then the
+// cards of the hand are tried as the discard side by side in the vector lanes: a partition counts for a
+// discard when it leaves that card out, and the lane keeps the one that covers the most points. what
+// the hand holds after the drop less what the partition covers is its deadwood, counted the way
+// countusercards counts a hand
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define BOT_SEARCH_AVX2
+#define BOT_SEARCH_LANES 4
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BOT_SEARCH_TARGET
+#else
+#define BOT_SEARCH_TARGET __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define BOT_SEARCH_NEON
+#define BOT_SEARCH_LANES 2
+#include <arm_neon.h>
+#else
+#define BOT_SEARCH_LANES 1
+#endif
+
+#define CARD_SUIT_MASK (((_CARD_MASK)1 << MAX_CARDS_PER_TYPE) - 1)
+#define BOT_SEARCH_SLOTS ((MAX_DECK_CARDS + 3) & ~3)	// discard lanes, a whole number of vectors of either width
+
+// the partitions of one hand, masks and points side by side for the lanes and the melds of each apart
+struct _BOT_PARTITIONS
+{
+	std::vector<_CARD_MASK> masks;
+	std::vector<int64_t> points;
+	std::vector<uint32_t> melds;	// BOT_MAX_MELDS indexes into vMelds, 8 bits each
+	std::vector<_CARD_MASK> vMelds;
+};
+
+static thread_local _BOT_PARTITIONS botsearchstate;	// kept so the lists are not allocated again
+
+#ifdef BOT_SEARCH_AVX2
+static bool issearchavx2 = false;
+#endif
+
+// every trio, quadra and stretch of a run in the hand, the trios of a quadra and the shorter stretches
+// of a run included since a discard may break the longer one
+static void botmelds(_CARD_MASK hand, std::vector<_CARD_MASK>& melds)
+{
+	melds.clear();
+
+	for (int num = 1; num <= MAX_CARDS_PER_TYPE; num++) {
+		_CARD_MASK m = hand & CARD_RANK_MASK(num);
+		int count = cardpopcount(m);
+		if (count < 3)
+			continue;
+		melds.push_back(m);
+		if (count == 4) {
+			for (_CARD_MASK b = m; b != 0; b &= b - 1)
+				melds.push_back(m & ~(b & (0 - b)));
+		}
+	}
+
+	for (int type = 0; type < MAX_CARD_TYPE; type++) {
+		int shift = type * MAX_CARDS_PER_TYPE;
+		int nums = (int)((hand >> shift) & CARD_SUIT_MASK);
+
+		for (int low = 0; low + 3 <= MAX_CARDS_PER_TYPE; low++) {
+			for (int len = 3; low + len <= MAX_CARDS_PER_TYPE; len++) {
+				int m = ((1 << len) - 1) << low;
+				if ((nums & m) != m)
+					break;
+				melds.push_back((_CARD_MASK)m << shift);
+			}
+		}
+	}
+}
+
+// the partitions that take melds from first on, each meld only after the ones before it so every set
+// of melds is listed once
+static void botpartition(_BOT_PARTITIONS& p, size_t first, _CARD_MASK mask, int64_t points, uint32_t melds, int depth)
+{
+	p.masks.push_back(mask);
+	p.points.push_back(points);
+	p.melds.push_back(melds);
+
+	if (depth == BOT_MAX_MELDS)
+		return;
+
+	for (size_t n = first; n < p.vMelds.size(); n++) {
+		if (p.vMelds[n] & mask)
+			continue;
+		botpartition(p, n + 1, mask | p.vMelds[n], points + cardpoints(p.vMelds[n]), melds | ((uint32_t)n << (depth * 8)), depth + 1);
+	}
+}
+
+static void botpartitions(_CARD_MASK hand, _BOT_PARTITIONS& p)
+{
+	botmelds(hand, p.vMelds);
+	p.masks.clear();
+	p.points.clear();
+	p.melds.clear();
+	botpartition(p, 0, 0, 0, 0, 0);
+}
+
+#ifdef BOT_SEARCH_AVX2
+// four discards a vector, the best points and the partition that has them per lane
+BOT_SEARCH_TARGET static void botsearchlanes(const _BOT_PARTITIONS& p, const _CARD_MASK* discards, int64_t* best, int64_t* index, int slots)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	size_t count = p.masks.size();
+
+	for (int slot = 0; slot < slots; slot += BOT_SEARCH_LANES) {
+		__m256i d = _mm256_loadu_si256((const __m256i*)(discards + slot));
+		__m256i b = _mm256_set1_epi64x(-1);
+		__m256i i = zero;
+
+		for (size_t n = 0; n < count; n++) {
+			__m256i m = _mm256_set1_epi64x((long long)p.masks[n]);
+			__m256i free = _mm256_cmpeq_epi64(_mm256_and_si256(m, d), zero);
+			__m256i better = _mm256_and_si256(free, _mm256_cmpgt_epi64(_mm256_set1_epi64x(p.points[n]), b));
+			b = _mm256_blendv_epi8(b, _mm256_set1_epi64x(p.points[n]), better);
+			i = _mm256_blendv_epi8(i, _mm256_set1_epi64x((long long)n), better);
+		}
+
+		_mm256_storeu_si256((__m256i*)(best + slot), b);
+		_mm256_storeu_si256((__m256i*)(index + slot), i);
+	}
+}
+
+static bool botsearchsupported()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)	// the os saves the ymm registers
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef BOT_SEARCH_NEON
+static void botsearchlanes(const _BOT_PARTITIONS& p, const _CARD_MASK* discards, int64_t* best, int64_t* index, int slots)
+{
+	size_t count = p.masks.size();
+
+	for (int slot = 0; slot < slots; slot += BOT_SEARCH_LANES) {
+		uint64x2_t d = vld1q_u64((const uint64_t*)(discards + slot));
+		int64x2_t b = vdupq_n_s64(-1);
+		int64x2_t i = vdupq_n_s64(0);
+
+		for (size_t n = 0; n < count; n++) {
+			int64x2_t points = vdupq_n_s64(p.points[n]);
+			uint64x2_t taken = vtstq_u64(vdupq_n_u64(p.masks[n]), d);
+			uint64x2_t better = vbicq_u64(vcgtq_s64(points, b), taken);
+			b = vbslq_s64(better, points, b);
+			i = vbslq_s64(better, vdupq_n_s64((int64_t)n), i);
+		}
+
+		vst1q_s64(best + slot, b);
+		vst1q_s64(index + slot, i);
+	}
+}
+#endif
+
+static void botsearchscalar(const _BOT_PARTITIONS& p, const _CARD_MASK* discards, int64_t* best, int64_t* index, int slots)
+{
+	size_t count = p.masks.size();
+
+	for (int slot = 0; slot < slots; slot++) {
+		best[slot] = -1;
+		index[slot] = 0;
+		for (size_t n = 0; n < count; n++) {
+			if ((p.masks[n] & discards[slot]) == 0 && p.points[n] > best[slot]) {
+				best[slot] = p.points[n];
+				index[slot] = (int64_t)n;
+			}
+		}
+	}
+}
+
+static void botsearch(const _BOT_PARTITIONS& p, const _CARD_MASK* discards, int64_t* best, int64_t* index, int slots)
+{
+#if defined(BOT_SEARCH_AVX2)
+	if (issearchavx2) {
+		botsearchlanes(p, discards, best, index, slots);
+		return;
+	}
+#elif defined(BOT_SEARCH_NEON)
+	botsearchlanes(p, discards, best, index, slots);
+	return;
+#endif
+	botsearchscalar(p, discards, best, index, slots);
+}
+
+static int botmeldlist(const _BOT_PARTITIONS& p, size_t partition, _CARD_MASK* melds)
+{
+	int count = 0;
+	_CARD_MASK left = p.masks[partition];
+
+	for (int n = 0; n < BOT_MAX_MELDS && left != 0; n++) {
+		_CARD_MASK meld = p.vMelds[(p.melds[partition] >> (n * 8)) & 0xff];
+		melds[count++] = meld;
+		left &= ~meld;
+	}
+
+	return count;
+}
+
+void botsearchinit()
+{
+#ifdef BOT_SEARCH_AVX2
+	issearchavx2 = botsearchsupported();
+#endif
+	MSGLOG(INFO, "Bots search their drops with the %s backend.", botsearchbackend());
+}
+
+const char* botsearchbackend()
+{
+#if defined(BOT_SEARCH_AVX2)
+	return issearchavx2 ? "avx2" : "scalar";
+#elif defined(BOT_SEARCH_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+int botdeadwood(_CARD_MASK hand, _CARD_MASK* melds, int& meldcount)
+{
+	_BOT_PARTITIONS& p = botsearchstate;
+	botpartitions(hand, p);
+
+	_CARD_MASK none[BOT_SEARCH_LANES] = { 0 };
+	int64_t best[BOT_SEARCH_LANES], index[BOT_SEARCH_LANES];
+	botsearch(p, none, best, index, BOT_SEARCH_LANES);
+
+	meldcount = botmeldlist(p, (size_t)index[0], melds);
+	return cardpoints(hand) - (int)best[0];
+}
+
+int botdiscards(_CARD_MASK hand, _BOT_DISCARD* discards)
+{
+	_BOT_PARTITIONS& p = botsearchstate;
+	botpartitions(hand, p);
+
+	// a lane past the hand takes every card away, it is never read
+	_CARD_MASK cards[BOT_SEARCH_SLOTS];
+	int count = 0;
+	for (_CARD_MASK m = hand; m != 0; m &= m - 1)
+		cards[count++] = m & (0 - m);
+	int slots = (count + BOT_SEARCH_LANES - 1) / BOT_SEARCH_LANES * BOT_SEARCH_LANES;
+	for (int n = count; n < slots; n++)
+		cards[n] = ~(_CARD_MASK)0;
+
+	int64_t best[BOT_SEARCH_SLOTS], index[BOT_SEARCH_SLOTS];
+	botsearch(p, cards, best, index, slots);
+
+	int points = cardpoints(hand);
+	for (int n = 0; n < count; n++) {
+		_BOT_DISCARD& discard = discards[n];
+		int bit = cardlowbit(cards[n]);
+		discard.card.cardtype = (unsigned char)(bit / MAX_CARDS_PER_TYPE + 1);
+		discard.card.cardnum = (unsigned char)(bit % MAX_CARDS_PER_TYPE + 1);
+		discard.deadwood = points - cardpoints(cards[n]) - (int)best[n];
+		discard.meldcount = botmeldlist(p, (size_t)index[n], discard.melds);
+	}
+
+	// the fewest points left, ties by botdropkey
+	int keys[BOT_SEARCH_SLOTS];
+	for (int n = 0; n < count; n++) {
+		int key = (discards[n].deadwood << 17) - botdropkey(hand, cardlowbit(cards[n]));
+		_BOT_DISCARD discard = discards[n];
+		int m = n;
+		while (m > 0 && keys[m - 1] > key) {
+			keys[m] = keys[m - 1];
+			discards[m] = discards[m - 1];
+			m--;
+		}
+		keys[m] = key;
+		discards[m] = discard;
+	}
+
+	return count;
+}
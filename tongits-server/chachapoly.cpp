@@ -0,0 +1,412 @@
+#include "chachapoly.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHACHA_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define CHACHA_NEON
+#include <arm_neon.h>
+#endif
+
+#define CHACHA_BLOCK_SIZE 64
+#define POLY1305_BLOCK_SIZE 16
+
+struct _POLY1305
+{
+	uint32_t r[5];
+	uint32_t h[5];
+	uint32_t pad[4];
+	uint8_t buffer[POLY1305_BLOCK_SIZE];
+	size_t used;
+};
+
+static inline uint32_t chachaload(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void chachastore(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t chacharol(uint32_t x, int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+#define CHACHA_QR(a, b, c, d) \
+	a += b; d ^= a; d = chacharol(d, 16); \
+	c += d; b ^= c; b = chacharol(b, 12); \
+	a += b; d ^= a; d = chacharol(d, 8); \
+	c += d; b ^= c; b = chacharol(b, 7);
+
+// the words 0 to 3 are the constant, 4 to 11 the key, 12 the block counter and 13 to 15 the nonce
+static void chachainit(uint32_t* state, const uint8_t* key, const uint8_t* nonce, uint32_t counter)
+{
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+	for (int n = 0; n < 8; n++)
+		state[4 + n] = chachaload(key + n * 4);
+	state[12] = counter;
+	for (int n = 0; n < 3; n++)
+		state[13 + n] = chachaload(nonce + n * 4);
+}
+
+static void chachablock(uint32_t* state, uint8_t* out)
+{
+	uint32_t x[16];
+
+	memcpy(x, state, sizeof(x));
+	for (int n = 0; n < 10; n++) {
+		CHACHA_QR(x[0], x[4], x[8], x[12])
+		CHACHA_QR(x[1], x[5], x[9], x[13])
+		CHACHA_QR(x[2], x[6], x[10], x[14])
+		CHACHA_QR(x[3], x[7], x[11], x[15])
+		CHACHA_QR(x[0], x[5], x[10], x[15])
+		CHACHA_QR(x[1], x[6], x[11], x[12])
+		CHACHA_QR(x[2], x[7], x[8], x[13])
+		CHACHA_QR(x[3], x[4], x[9], x[14])
+	}
+	for (int n = 0; n < 16; n++)
+		chachastore(out + n * 4, x[n] + state[n]);
+	state[12]++;
+}
+
+// the same rounds on four blocks, lane i of x[w] is word w of block i. the sums are transposed back
+// to four words of one block per register before they meet the data
+#ifdef CHACHA_SSE2
+#define CHACHA_ROL4(x, n) _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+#define CHACHA_QR4(a, b, c, d) \
+	a = _mm_add_epi32(a, b); d = CHACHA_ROL4(_mm_xor_si128(d, a), 16); \
+	c = _mm_add_epi32(c, d); b = CHACHA_ROL4(_mm_xor_si128(b, c), 12); \
+	a = _mm_add_epi32(a, b); d = CHACHA_ROL4(_mm_xor_si128(d, a), 8); \
+	c = _mm_add_epi32(c, d); b = CHACHA_ROL4(_mm_xor_si128(b, c), 7);
+
+static void chachaxor4(uint32_t* state, uint8_t* data)
+{
+	__m128i x[16], start[16];
+
+	for (int n = 0; n < 16; n++)
+		start[n] = _mm_set1_epi32((int)state[n]);
+	start[12] = _mm_add_epi32(start[12], _mm_set_epi32(3, 2, 1, 0));
+	memcpy(x, start, sizeof(x));
+
+	for (int n = 0; n < 10; n++) {
+		CHACHA_QR4(x[0], x[4], x[8], x[12])
+		CHACHA_QR4(x[1], x[5], x[9], x[13])
+		CHACHA_QR4(x[2], x[6], x[10], x[14])
+		CHACHA_QR4(x[3], x[7], x[11], x[15])
+		CHACHA_QR4(x[0], x[5], x[10], x[15])
+		CHACHA_QR4(x[1], x[6], x[11], x[12])
+		CHACHA_QR4(x[2], x[7], x[8], x[13])
+		CHACHA_QR4(x[3], x[4], x[9], x[14])
+	}
+
+	for (int g = 0; g < 4; g++) {
+		__m128i a = _mm_add_epi32(x[g * 4], start[g * 4]);
+		__m128i b = _mm_add_epi32(x[g * 4 + 1], start[g * 4 + 1]);
+		__m128i c = _mm_add_epi32(x[g * 4 + 2], start[g * 4 + 2]);
+		__m128i d = _mm_add_epi32(x[g * 4 + 3], start[g * 4 + 3]);
+		__m128i ab0 = _mm_unpacklo_epi32(a, b);
+		__m128i ab1 = _mm_unpackhi_epi32(a, b);
+		__m128i cd0 = _mm_unpacklo_epi32(c, d);
+		__m128i cd1 = _mm_unpackhi_epi32(c, d);
+		__m128i block[4] = {
+			_mm_unpacklo_epi64(ab0, cd0),
+			_mm_unpackhi_epi64(ab0, cd0),
+			_mm_unpacklo_epi64(ab1, cd1),
+			_mm_unpackhi_epi64(ab1, cd1),
+		};
+		for (int n = 0; n < 4; n++) {
+			__m128i* p = (__m128i*)(data + n * CHACHA_BLOCK_SIZE + g * 16);
+			_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), block[n]));
+		}
+	}
+	state[12] += 4;
+}
+#endif
+
+#ifdef CHACHA_NEON
+#define CHACHA_ROL4(x, n) vsriq_n_u32(vshlq_n_u32(x, n), x, 32 - (n))
+#define CHACHA_QR4(a, b, c, d) \
+	a = vaddq_u32(a, b); d = veorq_u32(d, a); d = CHACHA_ROL4(d, 16); \
+	c = vaddq_u32(c, d); b = veorq_u32(b, c); b = CHACHA_ROL4(b, 12); \
+	a = vaddq_u32(a, b); d = veorq_u32(d, a); d = CHACHA_ROL4(d, 8); \
+	c = vaddq_u32(c, d); b = veorq_u32(b, c); b = CHACHA_ROL4(b, 7);
+
+static void chachaxor4(uint32_t* state, uint8_t* data)
+{
+	static const uint32_t lanes[4] = { 0, 1, 2, 3 };
+	uint32x4_t x[16], start[16];
+
+	for (int n = 0; n < 16; n++)
+		start[n] = vdupq_n_u32(state[n]);
+	start[12] = vaddq_u32(start[12], vld1q_u32(lanes));
+	for (int n = 0; n < 16; n++)
+		x[n] = start[n];
+
+	for (int n = 0; n < 10; n++) {
+		CHACHA_QR4(x[0], x[4], x[8], x[12])
+		CHACHA_QR4(x[1], x[5], x[9], x[13])
+		CHACHA_QR4(x[2], x[6], x[10], x[14])
+		CHACHA_QR4(x[3], x[7], x[11], x[15])
+		CHACHA_QR4(x[0], x[5], x[10], x[15])
+		CHACHA_QR4(x[1], x[6], x[11], x[12])
+		CHACHA_QR4(x[2], x[7], x[8], x[13])
+		CHACHA_QR4(x[3], x[4], x[9], x[14])
+	}
+
+	for (int g = 0; g < 4; g++) {
+		uint32x4x2_t ab = vtrnq_u32(vaddq_u32(x[g * 4], start[g * 4]), vaddq_u32(x[g * 4 + 1], start[g * 4 + 1]));
+		uint32x4x2_t cd = vtrnq_u32(vaddq_u32(x[g * 4 + 2], start[g * 4 + 2]), vaddq_u32(x[g * 4 + 3], start[g * 4 + 3]));
+		uint32x4_t block[4] = {
+			vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0])),
+			vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1])),
+			vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0])),
+			vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1])),
+		};
+		for (int n = 0; n < 4; n++) {
+			uint8_t* p = data + n * CHACHA_BLOCK_SIZE + g * 16;
+			vst1q_u8(p, veorq_u8(vld1q_u8(p), vreinterpretq_u8_u32(block[n])));
+		}
+	}
+	state[12] += 4;
+}
+#endif
+
+static void chachaxor(uint32_t* state, uint8_t* data, size_t len)
+{
+	uint8_t block[CHACHA_BLOCK_SIZE];
+
+#if defined(CHACHA_SSE2) || defined(CHACHA_NEON)
+	while (len >= CHACHA_BLOCK_SIZE * 4) {
+		chachaxor4(state, data);
+		data += CHACHA_BLOCK_SIZE * 4;
+		len -= CHACHA_BLOCK_SIZE * 4;
+	}
+#endif
+	while (len > 0) {
+		size_t size = (len < CHACHA_BLOCK_SIZE) ? len : CHACHA_BLOCK_SIZE;
+		chachablock(state, block);
+		for (size_t n = 0; n < size; n++)
+			data[n] ^= block[n];
+		data += size;
+		len -= size;
+	}
+}
+
+static void poly1305init(_POLY1305& poly, const uint8_t* key)
+{
+	poly.r[0] = chachaload(key) & 0x3ffffff;
+	poly.r[1] = (chachaload(key + 3) >> 2) & 0x3ffff03;
+	poly.r[2] = (chachaload(key + 6) >> 4) & 0x3ffc0ff;
+	poly.r[3] = (chachaload(key + 9) >> 6) & 0x3f03fff;
+	poly.r[4] = (chachaload(key + 12) >> 8) & 0x00fffff;
+	for (int n = 0; n < 5; n++)
+		poly.h[n] = 0;
+	for (int n = 0; n < 4; n++)
+		poly.pad[n] = chachaload(key + 16 + n * 4);
+	poly.used = 0;
+}
+
+// hibit is the 2^128 of a whole block, the last partial one carries its 1 byte in the data instead
+static void poly1305blocks(_POLY1305& poly, const uint8_t* data, size_t len, uint32_t hibit)
+{
+	const uint32_t r0 = poly.r[0], r1 = poly.r[1], r2 = poly.r[2], r3 = poly.r[3], r4 = poly.r[4];
+	const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = poly.h[0], h1 = poly.h[1], h2 = poly.h[2], h3 = poly.h[3], h4 = poly.h[4];
+
+	while (len >= POLY1305_BLOCK_SIZE) {
+		h0 += chachaload(data) & 0x3ffffff;
+		h1 += (chachaload(data + 3) >> 2) & 0x3ffffff;
+		h2 += (chachaload(data + 6) >> 4) & 0x3ffffff;
+		h3 += (chachaload(data + 9) >> 6) & 0x3ffffff;
+		h4 += (chachaload(data + 12) >> 8) | hibit;
+
+		uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+		uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+		uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+		uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+		uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+		uint32_t carry = (uint32_t)(d0 >> 26);
+		h0 = (uint32_t)d0 & 0x3ffffff;
+		d1 += carry;
+		carry = (uint32_t)(d1 >> 26);
+		h1 = (uint32_t)d1 & 0x3ffffff;
+		d2 += carry;
+		carry = (uint32_t)(d2 >> 26);
+		h2 = (uint32_t)d2 & 0x3ffffff;
+		d3 += carry;
+		carry = (uint32_t)(d3 >> 26);
+		h3 = (uint32_t)d3 & 0x3ffffff;
+		d4 += carry;
+		carry = (uint32_t)(d4 >> 26);
+		h4 = (uint32_t)d4 & 0x3ffffff;
+		h0 += carry * 5;
+		carry = h0 >> 26;
+		h0 &= 0x3ffffff;
+		h1 += carry;
+
+		data += POLY1305_BLOCK_SIZE;
+		len -= POLY1305_BLOCK_SIZE;
+	}
+
+	poly.h[0] = h0;
+	poly.h[1] = h1;
+	poly.h[2] = h2;
+	poly.h[3] = h3;
+	poly.h[4] = h4;
+}
+
+static void poly1305update(_POLY1305& poly, const uint8_t* data, size_t len)
+{
+	if (poly.used > 0) {
+		size_t size = POLY1305_BLOCK_SIZE - poly.used;
+		if (size > len)
+			size = len;
+		memcpy(poly.buffer + poly.used, data, size);
+		poly.used += size;
+		data += size;
+		len -= size;
+		if (poly.used < POLY1305_BLOCK_SIZE)
+			return;
+		poly1305blocks(poly, poly.buffer, POLY1305_BLOCK_SIZE, 1 << 24);
+		poly.used = 0;
+	}
+
+	size_t whole = len & ~(size_t)(POLY1305_BLOCK_SIZE - 1);
+	poly1305blocks(poly, data, whole, 1 << 24);
+	memcpy(poly.buffer, data + whole, len - whole);
+	poly.used = len - whole;
+}
+
+// the aead pads the aad and the ciphertext with zeros to whole blocks
+static void poly1305pad(_POLY1305& poly)
+{
+	if (poly.used == 0)
+		return;
+	memset(poly.buffer + poly.used, 0, POLY1305_BLOCK_SIZE - poly.used);
+	poly1305blocks(poly, poly.buffer, POLY1305_BLOCK_SIZE, 1 << 24);
+	poly.used = 0;
+}
+
+static void poly1305final(_POLY1305& poly, uint8_t* mac)
+{
+	if (poly.used > 0) {
+		poly.buffer[poly.used] = 1;
+		memset(poly.buffer + poly.used + 1, 0, POLY1305_BLOCK_SIZE - poly.used - 1);
+		poly1305blocks(poly, poly.buffer, POLY1305_BLOCK_SIZE, 0);
+	}
+
+	uint32_t h0 = poly.h[0], h1 = poly.h[1], h2 = poly.h[2], h3 = poly.h[3], h4 = poly.h[4];
+	uint32_t carry;
+
+	carry = h1 >> 26; h1 &= 0x3ffffff; h2 += carry;
+	carry = h2 >> 26; h2 &= 0x3ffffff; h3 += carry;
+	carry = h3 >> 26; h3 &= 0x3ffffff; h4 += carry;
+	carry = h4 >> 26; h4 &= 0x3ffffff; h0 += carry * 5;
+	carry = h0 >> 26; h0 &= 0x3ffffff; h1 += carry;
+
+	// h - p, taken when it does not go below zero, without a branch on the value
+	uint32_t g0 = h0 + 5;
+	carry = g0 >> 26; g0 &= 0x3ffffff;
+	uint32_t g1 = h1 + carry;
+	carry = g1 >> 26; g1 &= 0x3ffffff;
+	uint32_t g2 = h2 + carry;
+	carry = g2 >> 26; g2 &= 0x3ffffff;
+	uint32_t g3 = h3 + carry;
+	carry = g3 >> 26; g3 &= 0x3ffffff;
+	uint32_t g4 = h4 + carry - (1 << 26);
+
+	uint32_t mask = (g4 >> 31) - 1;
+	h0 = (h0 & ~mask) | (g0 & mask);
+	h1 = (h1 & ~mask) | (g1 & mask);
+	h2 = (h2 & ~mask) | (g2 & mask);
+	h3 = (h3 & ~mask) | (g3 & mask);
+	h4 = (h4 & ~mask) | (g4 & mask);
+
+	uint32_t w0 = h0 | (h1 << 26);
+	uint32_t w1 = (h1 >> 6) | (h2 << 20);
+	uint32_t w2 = (h2 >> 12) | (h3 << 14);
+	uint32_t w3 = (h3 >> 18) | (h4 << 8);
+
+	uint64_t f = (uint64_t)w0 + poly.pad[0];
+	chachastore(mac, (uint32_t)f);
+	f = (uint64_t)w1 + poly.pad[1] + (f >> 32);
+	chachastore(mac + 4, (uint32_t)f);
+	f = (uint64_t)w2 + poly.pad[2] + (f >> 32);
+	chachastore(mac + 8, (uint32_t)f);
+	f = (uint64_t)w3 + poly.pad[3] + (f >> 32);
+	chachastore(mac + 12, (uint32_t)f);
+}
+
+// the one time key of poly1305 is block 0 of the keystream, the data takes the blocks from 1 on
+static void chachapolytag(uint32_t* state, const uint8_t* aad, size_t aadlen, const uint8_t* data, size_t len, uint8_t* tag)
+{
+	uint8_t block[CHACHA_BLOCK_SIZE];
+	uint8_t lengths[16];
+	_POLY1305 poly;
+
+	state[12] = 0;
+	chachablock(state, block);
+	poly1305init(poly, block);
+
+	poly1305update(poly, aad, aadlen);
+	poly1305pad(poly);
+	poly1305update(poly, data, len);
+	poly1305pad(poly);
+	chachastore(lengths, (uint32_t)aadlen);
+	chachastore(lengths + 4, (uint32_t)((uint64_t)aadlen >> 32));
+	chachastore(lengths + 8, (uint32_t)len);
+	chachastore(lengths + 12, (uint32_t)((uint64_t)len >> 32));
+	poly1305update(poly, lengths, sizeof(lengths));
+	poly1305final(poly, tag);
+}
+
+void chachapolyseal(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aadlen, uint8_t* data, size_t len, uint8_t* tag)
+{
+	uint32_t state[16];
+
+	chachainit(state, key, nonce, 1);
+	chachaxor(state, data, len);
+	chachapolytag(state, aad, aadlen, data, len, tag);
+}
+
+bool chachapolyopen(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aadlen, uint8_t* data, size_t len, const uint8_t* tag)
+{
+	uint32_t state[16];
+	uint8_t expected[CHACHAPOLY_TAG_SIZE];
+
+	chachainit(state, key, nonce, 0);
+	chachapolytag(state, aad, aadlen, data, len, expected);
+
+	// every byte is compared so the time taken says nothing about where a forged tag went wrong
+	uint8_t diff = 0;
+	for (int n = 0; n < CHACHAPOLY_TAG_SIZE; n++)
+		diff |= expected[n] ^ tag[n];
+	if (diff != 0)
+		return false;
+
+	state[12] = 1;
+	chachaxor(state, data, len);
+	return true;
+}
+
+const char* chachapolybackend()
+{
+#if defined(CHACHA_SSE2)
+	return "sse2";
+#elif defined(CHACHA_NEON)
+	return "neon";
+#else
+	return "c";
+#endif
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// chacha20-poly1305 of rfc 8439 for the sealed connections. the keystream is made four blocks at a time
+// in the sse2 registers every x86-64 cpu has or the neon ones of arm64, a block at a time elsewhere and
+// for the tail. poly1305 runs on 26 bit limbs and needs no 128 bit product
+
+#define CHACHAPOLY_KEY_SIZE 32
+#define CHACHAPOLY_NONCE_SIZE 12
+#define CHACHAPOLY_TAG_SIZE 16
+
+// encrypts data in place and writes the tag of aad and the ciphertext
+void chachapolyseal(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aadlen, uint8_t* data, size_t len, uint8_t* tag);
+// checks the tag first and decrypts data in place only when it matches
+bool chachapolyopen(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aadlen, uint8_t* data, size_t len, const uint8_t* tag);
+
+const char* chachapolybackend();
@@ -0,0 +1,349 @@
+#include "cluster.h"
+#include "common.h"
+#include "conf.h"
+#include "user.h"
+#include "gamectrl.h"
+#include "socket.h"
+#include "logintoken.h"
+#include "sha256.h"
+#include "packet.h"
+#include "sessiondir.h"
+#include "migrate.h"
+
+// a live node as the router last heard of it, loop 0 only
+struct _CLUSTER_NODE
+{
+	std::string host;
+	unsigned short port;
+	int games;
+	int maxgames;
+	int players;	// redirected since its last heartbeat, not yet in its table count
+	int64_t wall;
+	uint64_t tick;
+	int64_t sessionboot;	// of the last session datagram
+	uint32_t sessionseq;
+};
+
+static _CLUSTER_ROLE role = _CLUSTER_ROLE::_NONE;
+static _HMAC_SHA256_KEY clusterkey;
+static evutil_socket_t clusterfd = EVUTIL_INVALID_SOCKET;
+static struct event* clusterev = NULL;
+static struct sockaddr_storage routeraddr;
+static ev_socklen_t routeraddrlen = 0;
+static uint64_t heartbeattick = 0;
+static std::vector<_CLUSTER_NODE> vnodes;
+static int64_t sessionboot = 0;	// a node, its session datagrams are numbered from here
+static uint32_t sessionseq = 0;
+
+void clustersign(const void* data, size_t len, uint8_t* mac)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	hmacsha256(clusterkey, data, len, digest);
+	memcpy(mac, digest, CLUSTER_MAC_SIZE);
+}
+
+bool clusterverify(const void* data, size_t len, const uint8_t* mac)
+{
+	uint8_t digest[CLUSTER_MAC_SIZE];
+
+	clustersign(data, len, digest);
+	if (memcmp(digest, mac, CLUSTER_MAC_SIZE) == 0)
+		return true;
+
+	MSGLOG(eMSGTYPE::ERROR, "cluster, message with a bad mac, is Token Secret the same on every server?");
+	return false;
+}
+
+static _CLUSTER_NODE* clusterfindnode(const char* host, unsigned short port)
+{
+	for (size_t n = 0; n < vnodes.size(); n++) {
+		if (vnodes[n].port == port && vnodes[n].host == host)
+			return &vnodes[n];
+	}
+	return NULL;
+}
+
+static void clusterheard(_CLUSTER_HEARTBEAT& hb)
+{
+	if (hb.version != CLUSTER_VERSION || !clusterverify(&hb, offsetof(_CLUSTER_HEARTBEAT, mac), hb.mac))
+		return;
+
+	hb.host[CLUSTER_HOST_SIZE - 1] = 0;
+	_CLUSTER_NODE* node = clusterfindnode(hb.host, hb.port);
+
+	if (node == NULL) {
+		if (vnodes.size() >= CLUSTER_MAX_NODES)
+			return;
+		vnodes.push_back(_CLUSTER_NODE());
+		node = &vnodes.back();
+		node->host = hb.host;
+		node->port = hb.port;
+		node->wall = 0;
+		node->sessionboot = 0;
+		node->sessionseq = 0;
+		MSGLOG(eMSGTYPE::INFO, "cluster, node %s:%d joined.", hb.host, hb.port);
+	}
+	else if (hb.wall <= node->wall)
+		return;
+
+	node->games = (int)hb.games;
+	node->maxgames = (int)hb.maxgames;
+	node->players = 0;
+	node->wall = hb.wall;
+	node->tick = clockmsec();
+}
+
+// the sessions of a node that has sent a heartbeat, the next refresh repeats what comes before it
+static void clustersessionsheard(_CLUSTER_SESSIONS& ss)
+{
+	if (ss.version != CLUSTER_VERSION || !clusterverify(&ss, offsetof(_CLUSTER_SESSIONS, mac), ss.mac))
+		return;
+
+	ss.host[CLUSTER_HOST_SIZE - 1] = 0;
+	_CLUSTER_NODE* node = clusterfindnode(ss.host, ss.port);
+
+	if (node == NULL || ss.boot < node->sessionboot || (ss.boot == node->sessionboot && ss.seq <= node->sessionseq))
+		return;
+	node->sessionboot = ss.boot;
+	node->sessionseq = ss.seq;
+
+	for (int n = 0; n < std::min((int)ss.count, CLUSTER_SESSION_ITEMS); n++) {
+		const _CLUSTER_SESSION_ITEM& item = ss.items[n];
+		sessionreplica(node->host, node->port, item.token, item.gameserial, item.seat, item.isput != 0);
+	}
+}
+
+static void clusterreadcb(evutil_socket_t fd, short, void*)
+{
+	union {
+		_CLUSTER_HEARTBEAT hb;
+		_CLUSTER_SESSIONS ss;
+	} datagram;
+
+	clockrefresh();
+
+	// every datagram waiting, told apart by size and magic
+	while (true) {
+		int len = (int)recvfrom(fd, (char*)&datagram, sizeof(datagram), 0, NULL, NULL);
+		if (len < 0)
+			break;
+		if (len == sizeof(_CLUSTER_HEARTBEAT) && memcmp(datagram.hb.magic, CLUSTER_MAGIC, sizeof(datagram.hb.magic)) == 0)
+			clusterheard(datagram.hb);
+		else if (len == sizeof(_CLUSTER_SESSIONS) && memcmp(datagram.ss.magic, CLUSTER_SESSION_MAGIC, sizeof(datagram.ss.magic)) == 0)
+			clustersessionsheard(datagram.ss);
+	}
+}
+
+bool clusterstart(struct event_base* base)
+{
+	std::string rolename = c.getclusterrole();
+
+	if (rolename.empty())
+		return true;
+
+	if (rolename == "router")
+		role = _CLUSTER_ROLE::_ROUTER;
+	else if (rolename == "node")
+		role = _CLUSTER_ROLE::_NODE;
+	else {
+		MSGLOG(eMSGTYPE::ERROR, "cluster, Cluster Role is router or node, not %s.", rolename.c_str());
+		return false;
+	}
+
+	// a random key would not match the other servers, neither would their tokens
+	std::string secret = c.gettokensecret();
+	if (secret.empty()) {
+		MSGLOG(eMSGTYPE::ERROR, "cluster, Token Secret has to be set and the same on every server.");
+		role = _CLUSTER_ROLE::_NONE;
+		return false;
+	}
+	hmacsha256key(clusterkey, secret.data(), secret.size());
+
+	clusterfd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (clusterfd == EVUTIL_INVALID_SOCKET) {
+		MSGLOG(eMSGTYPE::ERROR, "cluster, socket failed, %s (%d).", __func__, __LINE__);
+		role = _CLUSTER_ROLE::_NONE;
+		return false;
+	}
+	evutil_make_socket_nonblocking(clusterfd);
+
+	if (role == _CLUSTER_ROLE::_ROUTER) {
+		struct sockaddr_in sin;
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(c.getclusterport());
+
+		if (bind(clusterfd, (struct sockaddr*)&sin, sizeof(sin)) != 0) {
+			MSGLOG(eMSGTYPE::ERROR, "cluster, bind failed at udp port %d.", c.getclusterport());
+			clusterstop();
+			return false;
+		}
+
+		clusterev = event_new(base, clusterfd, EV_READ | EV_PERSIST, clusterreadcb, NULL);
+		event_add(clusterev, NULL);
+		MSGLOG(eMSGTYPE::INFO, "cluster, routing players to the nodes heard at udp port %d.", c.getclusterport());
+		return true;
+	}
+
+	struct evutil_addrinfo hints;
+	struct evutil_addrinfo* answer = NULL;
+	char port[8];
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	snprintf(port, sizeof(port), "%d", c.getclusterport());
+
+	if (evutil_getaddrinfo(c.getrouterhost().c_str(), port, &hints, &answer) != 0 || answer == NULL) {
+		MSGLOG(eMSGTYPE::ERROR, "cluster, Router Host %s does not resolve.", c.getrouterhost().c_str());
+		clusterstop();
+		return false;
+	}
+	memcpy(&routeraddr, answer->ai_addr, answer->ai_addrlen);
+	routeraddrlen = (ev_socklen_t)answer->ai_addrlen;
+	evutil_freeaddrinfo(answer);
+	sessionboot = clockwallmsec();
+	sessionseq = 0;
+
+	MSGLOG(eMSGTYPE::INFO, "cluster, node %s:%d reports to %s:%d.", c.getnodehost().c_str(), c.getnodeport(),
+		c.getrouterhost().c_str(), c.getclusterport());
+	return true;
+}
+
+void clusterstop()
+{
+	if (clusterev != NULL)
+		event_free(clusterev);
+	clusterev = NULL;
+
+	if (clusterfd != EVUTIL_INVALID_SOCKET)
+		evutil_closesocket(clusterfd);
+	clusterfd = EVUTIL_INVALID_SOCKET;
+
+	role = _CLUSTER_ROLE::_NONE;
+	vnodes.clear();
+}
+
+void clusterheartbeat()
+{
+	if (role != _CLUSTER_ROLE::_NODE || clockmsec() < heartbeattick)
+		return;
+	heartbeattick = clockmsec() + CLUSTER_HEARTBEAT_MSEC;
+
+	_CLUSTER_HEARTBEAT hb;
+	memset(&hb, 0, sizeof(hb));
+	memcpy(hb.magic, CLUSTER_MAGIC, sizeof(hb.magic));
+	hb.version = CLUSTER_VERSION;
+	hb.port = c.getnodeport();
+	hb.maxgames = (uint32_t)gcontrol.getcapacity();
+	// a draining node is full to the router
+	hb.games = drainisactive() ? hb.maxgames : (uint32_t)gcontrol.getactivegames();
+	hb.wall = clockwallmsec();
+	strncpy(hb.host, c.getnodehost().c_str(), sizeof(hb.host) - 1);
+	clustersign(&hb, offsetof(_CLUSTER_HEARTBEAT, mac), hb.mac);
+
+	sendto(clusterfd, (const char*)&hb, sizeof(hb), 0, (struct sockaddr*)&routeraddr, routeraddrlen);
+}
+
+// the live node with the most room, players sent since its last heartbeat count as seated
+static _CLUSTER_NODE* clusterpicknode()
+{
+	_CLUSTER_NODE* best = NULL;
+	int64_t bestload = 0;
+
+	for (size_t n = 0; n < vnodes.size(); n++) {
+		_CLUSTER_NODE* node = &vnodes[n];
+		if (clockmsec() > node->tick + CLUSTER_NODE_TIMEOUT_MSEC || node->maxgames <= 0)
+			continue;
+
+		int64_t seats = (int64_t)node->maxgames * MAX_USERS_PERGAME;
+		int64_t taken = (int64_t)node->games * MAX_USERS_PERGAME + node->players;
+		if (taken >= seats)
+			continue;
+
+		int64_t load = taken * 10000 / seats;
+		if (best == NULL || load < bestload) {
+			best = node;
+			bestload = load;
+		}
+	}
+	return best;
+}
+
+bool clusterredirect(uintptr_t userindex, unsigned char gametype)
+{
+	if (role != _CLUSTER_ROLE::_ROUTER)
+		return false;
+
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	// only an account of the database can log in on another server
+	if (userinfo == NULL || userinfo->token <= 0)
+		return false;
+
+	_CLUSTER_NODE* node = clusterpicknode();
+	if (node == NULL)
+		return false;
+
+	_PMSG_REDIRECT_INFO pMsg = pkttemplate<_PMSG_REDIRECT_INFO>(0xF2, 0x0C);
+	pMsg.gametype = gametype;
+	pMsg.port = node->port;
+	strncpy(pMsg.host, node->host.c_str(), sizeof(pMsg.host) - 1);
+	logintokenmint(userinfo->token, pMsg.token);
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+
+	node->players++;
+	MSGLOG(eMSGTYPE::DEBUG, "cluster, %s sent to node %s:%d for mode %d.", userinfo->account.c_str(), node->host.c_str(), node->port, gametype);
+	return true;
+}
+
+_CLUSTER_ROLE clusterrole()
+{
+	return role;
+}
+
+void clustersessions(const _CLUSTER_SESSION_ITEM* items, int count)
+{
+	if (role != _CLUSTER_ROLE::_NODE || count <= 0)
+		return;
+
+	_CLUSTER_SESSIONS ss;
+	memset(&ss, 0, sizeof(ss));
+	memcpy(ss.magic, CLUSTER_SESSION_MAGIC, sizeof(ss.magic));
+	ss.version = CLUSTER_VERSION;
+	ss.port = c.getnodeport();
+	ss.boot = sessionboot;
+	ss.seq = ++sessionseq;
+	ss.count = (uint8_t)std::min(count, CLUSTER_SESSION_ITEMS);
+	strncpy(ss.host, c.getnodehost().c_str(), sizeof(ss.host) - 1);
+	memcpy(ss.items, items, ss.count * sizeof(_CLUSTER_SESSION_ITEM));
+	clustersign(&ss, offsetof(_CLUSTER_SESSIONS, mac), ss.mac);
+
+	sendto(clusterfd, (const char*)&ss, sizeof(ss), 0, (struct sockaddr*)&routeraddr, routeraddrlen);
+}
+
+// the server takes the token only when it was signed with the same secret
+bool clustersendto(uintptr_t userindex, const std::string& host, unsigned short port, unsigned char gametype)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || userinfo->token <= 0 || host.empty() || c.gettokensecret().empty())
+		return false;
+
+	_PMSG_REDIRECT_INFO pMsg = pkttemplate<_PMSG_REDIRECT_INFO>(0xF2, 0x0C);
+	pMsg.gametype = gametype;
+	pMsg.port = port;
+	strncpy(pMsg.host, host.c_str(), sizeof(pMsg.host) - 1);
+	logintokenmint(userinfo->token, pMsg.token);
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+	return true;
+}
+
+bool clusterresume(uintptr_t userindex, const std::string& host, unsigned short port)
+{
+	if (!clustersendto(userindex, host, port, SESSION_RESUME_GAMETYPE))
+		return false;
+
+	MSGLOG(eMSGTYPE::INFO, "cluster, %s sent back to its table on %s:%d.", guser.getuser(userindex)->account.c_str(), host.c_str(), port);
+	return true;
+}
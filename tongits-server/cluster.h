@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// several servers behind one address. a router ("Cluster Role: router") takes the logins and, when a
+// player asks for a table, redirects it with a fresh login token to the node with the lowest load, the
+// client connects there, logs in with the token and is matched on that node. each node sends its table
+// count from the loop 0 tick to "Router Host":"Cluster Port" as a udp heartbeat signed with the Token
+// Secret, which has to be the same on every server so the node takes the router's tokens. a router with
+// no live node plays the table itself
+
+#define CLUSTER_MAGIC "TGCL"
+#define CLUSTER_VERSION 1
+#define CLUSTER_HEARTBEAT_MSEC 1000
+#define CLUSTER_NODE_TIMEOUT_MSEC 3500	// a node missing this long takes no more players
+#define CLUSTER_MAX_NODES 64
+#define CLUSTER_MAC_SIZE 16
+#define CLUSTER_HOST_SIZE 64
+#define CLUSTER_SESSION_MAGIC "TGSS"
+#define CLUSTER_SESSION_ITEMS 48	// in one datagram, which stays under 1k
+
+enum class _CLUSTER_ROLE
+{
+	_NONE = 0,
+	_ROUTER,
+	_NODE,
+};
+
+#pragma pack(push, 1)
+struct _CLUSTER_HEARTBEAT
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t port;	// the clients connect to host:port
+	uint32_t games;
+	uint32_t maxgames;
+	int64_t wall;	// clockwallmsec of the node, an old one is a replay
+	char host[CLUSTER_HOST_SIZE];
+	uint8_t mac[CLUSTER_MAC_SIZE];	// of everything before it
+};
+
+// a game session of a node that started or ended, see sessiondir.h
+struct _CLUSTER_SESSION_ITEM
+{
+	int64_t token;
+	int64_t gameserial;
+	uint8_t seat;
+	uint8_t isput;	// 0 when the session ended
+};
+
+// the session changes of a node, sent to the router on the loop 0 tick. boot and seq only grow, so a
+// replayed or late datagram is dropped
+struct _CLUSTER_SESSIONS
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t port;
+	int64_t boot;	// clockwallmsec when the node started
+	uint32_t seq;
+	uint8_t count;
+	char host[CLUSTER_HOST_SIZE];
+	_CLUSTER_SESSION_ITEM items[CLUSTER_SESSION_ITEMS];
+	uint8_t mac[CLUSTER_MAC_SIZE];	// of everything before it
+};
+#pragma pack(pop)
+
+bool clusterstart(struct event_base* base);
+void clusterstop();
+void clusterheartbeat();	// loop 0, sends when one is due
+bool clusterredirect(uintptr_t userindex, unsigned char gametype);	// true when the player was sent to a node
+_CLUSTER_ROLE clusterrole();
+void clustersessions(const _CLUSTER_SESSION_ITEM* items, int count);	// a node, up to CLUSTER_SESSION_ITEMS
+// sends the player to host:port with a login token to join gametype there, false when the servers share
+// no Token Secret
+bool clustersendto(uintptr_t userindex, const std::string& host, unsigned short port, unsigned char gametype);
+// the same to resume its table there
+bool clusterresume(uintptr_t userindex, const std::string& host, unsigned short port);
+// the Token Secret mac of CLUSTER_MAC_SIZE bytes, only once clusterstart set a role
+void clustersign(const void* data, size_t len, uint8_t* mac);
+bool clusterverify(const void* data, size_t len, const uint8_t* mac);
@@ -1,12 +1,24 @@
 #include "common.h"
+#include "cpupin.h"
+#include "../Common/memtag.h"
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
 #ifndef _WIN32
-//#include <android/log.h>
-#else
-#include "LogToFile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <dirent.h>
 #endif
-
-#ifdef _WIN32
-CLogToFile tongitslog("tongits", "Log", 1);
+#ifdef __linux__
+#include <zlib.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #endif
 
 
@@ -16,12 +28,670 @@ DWORD LOGTYPEENABLED = 0;
 DWORD LOGTYPEENABLED = ((DWORD)eMSGTYPE::INFO | (DWORD)eMSGTYPE::ERROR | (DWORD)eMSGTYPE::SQL | (DWORD)eMSGTYPE::DEBUG);
 #endif
 
+// log lines are formatted on the calling loop and handed to one writer thread through a bounded
+// lock free ring, the writer does the console, the daily file, syslog and the time stamps
+struct _LOG_RECORD
+{
+	std::atomic<uint32_t> seq;
+	time_t time;
+	BYTE type;
+	int len;
+	char text[LOG_RECORD_SIZE];
+};
+
+static _LOG_RECORD* logring = NULL;
+static bool logmapped = false;	// the ring is the mapped LOG_RING_FILE
+static std::atomic<uint32_t> loghead(0);
+static std::atomic<uint32_t> logdropped(0);
+static std::atomic<bool> logrunning(false);
+static std::thread logthread;
+
+// set by logsinks, the writer picks them up on its next pass
+static std::atomic<bool> logconsole(true);
+static std::atomic<bool> logsyslog(false);
+static std::atomic<uint64_t> logrotatebytes(0);
+
+// the writer formats the time stamps once per second, not once per line
+struct _LOG_STAMP
+{
+	time_t time;
+	int day;
+	char console[32];
+	char file[16];
+};
+
+static const _LOG_STAMP& logstamp(_LOG_STAMP& stamp, time_t t)
+{
+	if (stamp.time == t)
+		return stamp;
+	struct tm lt;
+#ifdef _WIN32
+	localtime_s(&lt, &t);
+#else
+	localtime_r(&t, &lt);
+#endif
+	stamp.time = t;
+	stamp.day = lt.tm_yday;
+	strftime(stamp.console, sizeof(stamp.console), "%a %b %d %H:%M:%S %Y", &lt);
+	strftime(stamp.file, sizeof(stamp.file), "%H:%M:%S ", &lt);
+	return stamp;
+}
+
+static void logwrite(FILE* fp, const char* stamp, const char* text, int len)
+{
+	fputs(stamp, fp);
+	fwrite(text, 1, len, fp);
+	fputc('\n', fp);
+}
+
+// one pass of the writer, the text stays in its ring slot until the batch is written
+struct _LOG_LINE
+{
+	const char* text;
+	int len;
+	BYTE type;
+	char console[32];
+	char file[16];
+};
+
+// the file of the day, split into name.1.txt, name.2.txt and on once Log Rotate MB is reached
+struct _LOG_FILE
+{
+#ifdef _WIN32
+	FILE* fp;
+#else
+	int fd;
+#endif
+	int day;
+	int part;
+	uint64_t size;
+	char name[260];	// in LOG_DIRECTORY
+};
+
+static bool logisopen(const _LOG_FILE& file)
+{
+#ifdef _WIN32
+	return file.fp != NULL;
+#else
+	return file.fd >= 0;
+#endif
+}
+
+static void logclose(_LOG_FILE& file)
+{
+#ifdef _WIN32
+	if (file.fp != NULL)
+		fclose(file.fp);
+	file.fp = NULL;
+#else
+	if (file.fd >= 0)
+		close(file.fd);
+	file.fd = -1;
+#endif
+}
+
+// opens the first part of the day with room left, after a restart that is the one it was writing
+static void logopen(time_t t, _LOG_FILE& file)
+{
+	struct tm lt;
+	char filename[sizeof(file.name) + 16];
+#ifdef _WIN32
+	localtime_s(&lt, &t);
+	CreateDirectoryA(LOG_DIRECTORY, NULL);
+#else
+	localtime_r(&t, &lt);
+	mkdir(LOG_DIRECTORY, 0755);
+#endif
+	if (lt.tm_yday != file.day)
+		file.part = 0;
+	file.day = lt.tm_yday;
+
+	uint64_t rotate = logrotatebytes.load(std::memory_order_relaxed);
+	for (;;) {
+		if (file.part == 0)
+			snprintf(file.name, sizeof(file.name), "%s_%04d-%02d-%02d.txt", LOG_FILENAME, lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday);
+		else
+			snprintf(file.name, sizeof(file.name), "%s_%04d-%02d-%02d.%d.txt", LOG_FILENAME, lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday, file.part);
+		snprintf(filename, sizeof(filename), "%s/%s", LOG_DIRECTORY, file.name);
+#ifdef _WIN32
+		file.fp = fopen(filename, "a");
+		if (file.fp == NULL)
+			return;
+		fseek(file.fp, 0, SEEK_END);
+		file.size = (uint64_t)ftell(file.fp);
+#else
+		file.fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (file.fd < 0)
+			return;
+		struct stat st;
+		file.size = (fstat(file.fd, &st) == 0) ? (uint64_t)st.st_size : 0;
+#endif
+		if (rotate == 0 || file.size < rotate)
+			return;
+		logclose(file);
+		file.part++;
+	}
+}
+
+#ifdef _WIN32
+static uint64_t logflush(FILE* fp, const _LOG_LINE* lines, int count, bool isconsole)
+{
+	uint64_t bytes = 0;
+	for (int n = 0; n < count; n++) {
+		const char* stamp = isconsole ? lines[n].console : lines[n].file;
+		logwrite(fp, stamp, lines[n].text, lines[n].len);
+		bytes += strlen(stamp) + lines[n].len + 1;
+	}
+	fflush(fp);
+	return bytes;
+}
+#else
+// the whole batch in as few writev calls as IOV_MAX allows, a short write goes on where it stopped
+static uint64_t logflush(int fd, const _LOG_LINE* lines, int count, bool isconsole)
+{
+	static char newline = '\n';
+	struct iovec iov[LOG_BATCH * 3];
+	int iovcnt = 0;
+	uint64_t bytes = 0;
+
+	for (int n = 0; n < count; n++) {
+		const char* stamp = isconsole ? lines[n].console : lines[n].file;
+		iov[iovcnt++] = { (void*)stamp, strlen(stamp) };
+		iov[iovcnt++] = { (void*)lines[n].text, (size_t)lines[n].len };
+		iov[iovcnt++] = { &newline, 1 };
+		bytes += iov[iovcnt - 3].iov_len + lines[n].len + 1;
+	}
+
+	struct iovec* next = iov;
+	while (iovcnt > 0) {
+		ssize_t written = writev(fd, next, std::min(iovcnt, IOV_MAX));
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		while (iovcnt > 0 && (size_t)written >= next->iov_len) {
+			written -= next->iov_len;
+			next++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			next->iov_base = (char*)next->iov_base + written;
+			next->iov_len -= written;
+		}
+	}
+	return bytes;
+}
+
+static int logpriority(BYTE type)
+{
+	switch (type) {
+	case eMSGTYPE::ERROR:
+		return LOG_ERR;
+	case eMSGTYPE::DEBUG:
+	case eMSGTYPE::SQL:
+		return LOG_DEBUG;
+	default:
+		return LOG_INFO;
+	}
+}
+#endif
+
+// the files the writer is done with are compressed and aged out by a thread of their own at the lowest
+// priority, the writer only names the file it moved to and never waits for a pass to finish
+struct _LOG_SEGMENT
+{
+	std::string name;	// in LOG_DIRECTORY
+	uint64_t size;
+	time_t mtime;
+	bool ispacked;
+	bool islive;	// the writer has it open, neither packed nor removed
+};
+
+static std::mutex logpacklock;
+static std::condition_variable logpackwake;
+static std::thread logpackthread;
+static std::string logcurrent;	// the file the writer has open, never touched by a pass
+static bool logpackdirty = false;
+static std::atomic<bool> logpackstop(false);
+
+// set by logretention
+static std::atomic<bool> logcompress(true);
+static std::atomic<int> logkeepdays(0);
+static std::atomic<int> logkeepmb(0);
+
+static bool logsegment(const std::string& name, bool& ispacked)
+{
+	std::string prefix = std::string(LOG_FILENAME) + "_";
+	if (name.compare(0, prefix.size(), prefix) != 0)
+		return false;
+	ispacked = name.size() > 7 && name.compare(name.size() - 7, 7, ".txt.gz") == 0;
+	return ispacked || (name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0);
+}
+
+// the text files of the log and their compressed copies, the event logs beside them are not ours
+static void loglist(std::vector<_LOG_SEGMENT>& segments, const std::string& current)
+{
+	_LOG_SEGMENT segment;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(LOG_DIRECTORY "\\" LOG_FILENAME "_*", &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do {
+		if (!logsegment(data.cFileName, segment.ispacked))
+			continue;
+		ULARGE_INTEGER written;
+		written.LowPart = data.ftLastWriteTime.dwLowDateTime;
+		written.HighPart = data.ftLastWriteTime.dwHighDateTime;
+		segment.name = data.cFileName;
+		segment.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+		segment.mtime = (time_t)(written.QuadPart / 10000000 - 11644473600ULL);
+		segment.islive = (segment.name == current);
+		segments.push_back(segment);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	DIR* dir = opendir(LOG_DIRECTORY);
+	if (dir == NULL)
+		return;
+	while (struct dirent* entry = readdir(dir)) {
+		struct stat st;
+		if (!logsegment(entry->d_name, segment.ispacked) || fstatat(dirfd(dir), entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		segment.name = entry->d_name;
+		segment.size = (uint64_t)st.st_size;
+		segment.mtime = st.st_mtime;
+		segment.islive = (segment.name == current);
+		segments.push_back(segment);
+	}
+	closedir(dir);
+#endif
+}
+
+#ifdef __linux__
+// name.txt to name.txt.gz with the time of the text, false leaves the text as it was
+static bool logpack(_LOG_SEGMENT& segment)
+{
+	std::string source = std::string(LOG_DIRECTORY) + "/" + segment.name;
+	std::string target = source + ".gz";
+	std::string temp = target + ".tmp";
+
+	int fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	gzFile gz = gzopen(temp.c_str(), "wb6");
+	if (gz == NULL) {
+		close(fd);
+		return false;
+	}
+
+	static char buffer[LOG_PACK_CHUNK];
+	bool result = true;
+	ssize_t len;
+	while (result && (len = read(fd, buffer, sizeof(buffer))) != 0) {
+		if (len < 0) {
+			result = (errno == EINTR);
+			continue;
+		}
+		result = !logpackstop.load(std::memory_order_relaxed) && gzwrite(gz, buffer, (unsigned)len) == len;
+	}
+	close(fd);
+	result = (gzclose(gz) == Z_OK) && result;
+
+	struct timespec times[2] = { { segment.mtime, 0 }, { segment.mtime, 0 } };
+	if (!result || utimensat(AT_FDCWD, temp.c_str(), times, 0) != 0 || rename(temp.c_str(), target.c_str()) != 0) {
+		unlink(temp.c_str());
+		return false;
+	}
+	unlink(source.c_str());
+
+	struct stat st;
+	segment.name += ".gz";
+	segment.size = (stat(target.c_str(), &st) == 0) ? (uint64_t)st.st_size : 0;
+	segment.ispacked = true;
+	return true;
+}
+#endif
+
+// the oldest go first, past Log Keep Days and then until the rest fit in Log Keep MB
+static void logexpire(std::vector<_LOG_SEGMENT>& segments, bool isbysize)
+{
+	std::sort(segments.begin(), segments.end(), [](const _LOG_SEGMENT& a, const _LOG_SEGMENT& b) { return a.mtime < b.mtime; });
+	int keepdays = logkeepdays.load(std::memory_order_relaxed);
+	uint64_t keepbytes = isbysize ? (uint64_t)logkeepmb.load(std::memory_order_relaxed) << 20 : 0;
+	time_t oldest = time(NULL) - (time_t)keepdays * 86400;
+	uint64_t total = 0;
+	for (auto& segment : segments)
+		total += segment.size;
+
+	auto iter = segments.begin();
+	while (iter != segments.end()) {
+		if (iter->islive) {
+			iter++;
+			continue;
+		}
+		if (!(keepdays > 0 && iter->mtime < oldest) && !(keepbytes != 0 && total > keepbytes))
+			break;
+		std::string path = std::string(LOG_DIRECTORY) + "/" + iter->name;
+		if (remove(path.c_str()) == 0) {
+			total -= iter->size;
+			iter = segments.erase(iter);
+		}
+		else {
+			iter++;
+		}
+	}
+}
+
+// what is too old goes before anything is compressed, the size is counted once the rest is
+static void logsweep(const std::string& current)
+{
+	// no file open yet, today's may still be the live one
+	if (current.empty())
+		return;
+
+	std::vector<_LOG_SEGMENT> segments;
+	loglist(segments, current);
+	logexpire(segments, false);
+
+#ifdef __linux__
+	if (logcompress.load(std::memory_order_relaxed)) {
+		for (auto& segment : segments) {
+			if (logpackstop.load(std::memory_order_relaxed))
+				return;
+			if (!segment.ispacked && !segment.islive && !logpack(segment))
+				MSGLOG(eMSGTYPE::ERROR, "Log file %s could not be compressed.", segment.name.c_str());
+		}
+	}
+#endif
+
+	logexpire(segments, true);
+}
+
+static void logpacker()
+{
+#ifdef __linux__
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+#elif defined(_WIN32)
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#endif
+	std::unique_lock<std::mutex> lock(logpacklock);
+	// until the writer has a file there is no telling which one is live
+	logpackwake.wait(lock, [] { return logpackstop || !logcurrent.empty(); });
+	while (!logpackstop) {
+		std::string current = logcurrent;
+		logpackdirty = false;
+		lock.unlock();
+		logsweep(current);
+		lock.lock();
+		logpackwake.wait_for(lock, std::chrono::seconds(LOG_PACK_SECONDS), [] { return logpackstop || logpackdirty; });
+	}
+}
+
+// called by the writer with the file it opened, a new one means the last is done with
+static void logmoved(const char* name)
+{
+	{
+		std::lock_guard<std::mutex> lock(logpacklock);
+		if (logcurrent == name)
+			return;
+		logcurrent = name;
+		logpackdirty = true;
+	}
+	logpackwake.notify_one();
+}
+
+static void logworker()
+{
+	_LOG_FILE file;
+#ifdef _WIN32
+	file.fp = NULL;
+#else
+	file.fd = -1;
+	bool issyslog = false;
+#endif
+	file.day = -1;
+	file.part = 0;
+	file.size = 0;
+
+	uint32_t tail = 0;
+	bool isdone = false;
+	_LOG_STAMP stamp = { -1 };
+	static _LOG_LINE lines[LOG_BATCH];
+	char droppedtext[64];
+
+	while (!isdone) {
+
+		isdone = !logrunning.load(std::memory_order_acquire);
+
+		int written = 0;
+		uint32_t dropped = logdropped.exchange(0);
+
+		while (true) {
+			// a batch is of one day, the lines after a midnight start the next one
+			int count = 0;
+			int day = -1;
+			while (count < LOG_BATCH) {
+				_LOG_RECORD* rec = &logring[(tail + count) % LOG_RING_SIZE];
+				if (rec->seq.load(std::memory_order_acquire) != tail + count + 1)
+					break;
+				logstamp(stamp, rec->time);
+				if (count != 0 && stamp.day != day)
+					break;
+				day = stamp.day;
+				_LOG_LINE& line = lines[count++];
+				line.text = rec->text;
+				line.len = rec->len;
+				line.type = rec->type;
+				memcpy(line.console, stamp.console, sizeof(line.console));
+				memcpy(line.file, stamp.file, sizeof(line.file));
+			}
+
+			if (count == 0 && dropped != 0) {
+				_LOG_LINE& line = lines[count++];
+				line.len = snprintf(droppedtext, sizeof(droppedtext), " [ERROR] Log ring full, %u lines dropped.", dropped);
+				line.text = droppedtext;
+				line.type = eMSGTYPE::ERROR;
+				logstamp(stamp, time(NULL));
+				memcpy(line.console, stamp.console, sizeof(line.console));
+				memcpy(line.file, stamp.file, sizeof(line.file));
+				day = stamp.day;
+				dropped = 0;
+			}
+			if (count == 0)
+				break;
+
+			uint64_t rotate = logrotatebytes.load(std::memory_order_relaxed);
+			if (!logisopen(file) || day != file.day || (rotate != 0 && file.size >= rotate)) {
+				if (logisopen(file) && day == file.day)
+					file.part++;
+				logclose(file);
+				logopen(lines[0].text == droppedtext ? time(NULL) : logring[tail % LOG_RING_SIZE].time, file);
+				if (logisopen(file))
+					logmoved(file.name);
+			}
+
+#ifdef _WIN32
+			if (logconsole.load(std::memory_order_relaxed))
+				logflush(stdout, lines, count, true);
+			if (file.fp != NULL)
+				file.size += logflush(file.fp, lines, count, false);
+#else
+			if (logconsole.load(std::memory_order_relaxed))
+				logflush(STDOUT_FILENO, lines, count, true);
+			if (file.fd >= 0)
+				file.size += logflush(file.fd, lines, count, false);
+
+			// journald takes these over the syslog socket as well
+			if (logsyslog.load(std::memory_order_relaxed)) {
+				if (!issyslog) {
+					openlog(LOG_FILENAME, LOG_PID | LOG_NDELAY, LOG_DAEMON);
+					issyslog = true;
+				}
+				for (int n = 0; n < count; n++) {
+					int skip = (lines[n].len > 0 && lines[n].text[0] == ' ') ? 1 : 0;
+					syslog(logpriority(lines[n].type), "%.*s", lines[n].len - skip, lines[n].text + skip);
+				}
+			}
+#endif
+
+			// hand the slots back to the producers one lap later
+			if (lines[0].text != droppedtext) {
+				for (int n = 0; n < count; n++) {
+					logring[tail % LOG_RING_SIZE].seq.store(tail + LOG_RING_SIZE, std::memory_order_release);
+					tail++;
+				}
+			}
+			written += count;
+		}
+
+		if (written == 0 && !isdone)
+			std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_MSEC));
+	}
+
+	logclose(file);
+#ifndef _WIN32
+	if (issyslog)
+		closelog();
+#endif
+}
+
+// on linux the ring is a shared mapping of LOG_RING_FILE, a line a crashed server took but never
+// wrote is still in that file and the next start writes it out ahead of its own lines
+static _LOG_RECORD* logringopen(std::vector<_LOG_RECORD*>& recovered)
+{
+#ifdef _WIN32
+	return NULL;
+#else
+	size_t size = sizeof(_LOG_RECORD) * LOG_RING_SIZE;
+	mkdir(LOG_DIRECTORY, 0755);
+	int fd = open(LOG_DIRECTORY "/" LOG_RING_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	bool isprevious = fstat(fd, &st) == 0 && (size_t)st.st_size == size;
+	if (!isprevious && ftruncate(fd, size) != 0) {
+		close(fd);
+		return NULL;
+	}
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	// a taken slot holds its lap plus one, a written or a free one its lap
+	_LOG_RECORD* ring = (_LOG_RECORD*)data;
+	for (uint32_t n = 0; isprevious && n < LOG_RING_SIZE; n++) {
+		uint32_t seq = ring[n].seq.load(std::memory_order_relaxed);
+		if ((seq - n) % LOG_RING_SIZE == 1 && ring[n].len >= 0 && ring[n].len < LOG_RECORD_SIZE)
+			recovered.push_back(&ring[n]);
+	}
+	std::sort(recovered.begin(), recovered.end(), [](const _LOG_RECORD* a, const _LOG_RECORD* b) {
+		return (int32_t)(a->seq.load(std::memory_order_relaxed) - b->seq.load(std::memory_order_relaxed)) < 0;
+	});
+	return ring;
+#endif
+}
+
+void logstart()
+{
+	if (logrunning)
+		return;
+
+	std::vector<_LOG_RECORD*> recovered;
+	logring = logringopen(recovered);
+	logmapped = logring != NULL;
+	if (!logmapped)
+		logring = new _LOG_RECORD[LOG_RING_SIZE];
+	memtagalloc(_MEM_TAG::_LOG, sizeof(_LOG_RECORD) * LOG_RING_SIZE);
+
+	// the recovered lines move to the front of the ring in their order, behind a line that says so
+	std::vector<_LOG_RECORD> previous(std::min(recovered.size(), (size_t)LOG_RING_SIZE - 1));
+	for (size_t n = 0; n < previous.size(); n++) {
+		previous[n].time = recovered[n]->time;
+		previous[n].type = recovered[n]->type;
+		previous[n].len = recovered[n]->len;
+		memcpy(previous[n].text, recovered[n]->text, recovered[n]->len);
+	}
+
+	uint32_t head = 0;
+	if (!previous.empty()) {
+		_LOG_RECORD& rec = logring[head++];
+		rec.time = time(NULL);
+		rec.type = eMSGTYPE::ERROR;
+		rec.len = snprintf(rec.text, sizeof(rec.text), " [ERROR] %zu lines the previous run logged but did not write follow.", previous.size());
+		for (size_t n = 0; n < previous.size(); n++) {
+			_LOG_RECORD& line = logring[head++];
+			line.time = previous[n].time;
+			line.type = previous[n].type;
+			line.len = previous[n].len;
+			memcpy(line.text, previous[n].text, previous[n].len);
+		}
+	}
+	for (uint32_t n = 0; n < LOG_RING_SIZE; n++)
+		logring[n].seq.store((n < head) ? n + 1 : n, std::memory_order_relaxed);
+	loghead.store(head);
+	logrunning.store(true, std::memory_order_release);
+	logthread = std::thread(logworker);
+	logpackstop = false;
+	logpackthread = std::thread(logpacker);
+}
+
+void logstop()
+{
+	if (!logrunning)
+		return;
+	logrunning.store(false, std::memory_order_release);
+	logthread.join();
+	{
+		std::lock_guard<std::mutex> lock(logpacklock);
+		logpackstop = true;
+	}
+	logpackwake.notify_one();
+	logpackthread.join();
+#ifndef _WIN32
+	if (logmapped)
+		munmap(logring, sizeof(_LOG_RECORD) * LOG_RING_SIZE);
+	else
+#endif
+		delete[] logring;
+	logring = NULL;
+	memtagfree(_MEM_TAG::_LOG, sizeof(_LOG_RECORD) * LOG_RING_SIZE);
+}
+
+void logpin(const std::vector<int>& cpus)
+{
+	cpupinthread(logthread, cpus);
+	cpupinthread(logpackthread, cpus);
+}
+
+void logsinks(bool console, bool syslog, int rotatemb)
+{
+	logconsole = console;
+	logsyslog = syslog;
+	logrotatebytes = (rotatemb > 0) ? (uint64_t)rotatemb << 20 : 0;
+}
+
+void logretention(bool compress, int keepdays, int keepmb)
+{
+	logcompress = compress;
+	logkeepdays = keepdays;
+	logkeepmb = keepmb;
+	{
+		std::lock_guard<std::mutex> lock(logpacklock);
+		logpackdirty = true;
+	}
+	logpackwake.notify_one();
+}
+
 void msglog(BYTE type, const char* msg, ...) {
 
 	if (!(LOGTYPEENABLED & (DWORD)type))
 		return;
 
-	char szBuffer[1024] = { 0 };
+	char szBuffer[LOG_RECORD_SIZE] = { 0 };
 	va_list pArguments;
 
 	switch (type) {
@@ -41,20 +711,47 @@ void msglog(BYTE type, const char* msg, ...) {
 
 	va_start(pArguments, msg);
 	size_t iSize = strlen(szBuffer);
-	vsprintf(&szBuffer[iSize], msg, pArguments);
+	int len = vsnprintf(&szBuffer[iSize], sizeof(szBuffer) - iSize, msg, pArguments);
 	va_end(pArguments);
 
+	if (len < 0)
+		len = 0;
+	len = (iSize + len < sizeof(szBuffer)) ? (int)(iSize + len) : (int)sizeof(szBuffer) - 1;
 
-	auto timenow = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-	char* curstrtime = ctime(&timenow);
-	curstrtime[strlen(curstrtime) - 1] = '\0';
+	time_t timenow = clocktime();
 
-#ifndef _WIN32
-	//__android_log_print(ANDROID_LOG_DEBUG, "TONGITS", "%s%s",curstrtime, szBuffer);
-#else
-	std::cout << curstrtime << szBuffer << std::endl;
-	tongitslog.Output(szBuffer);
-#endif
+	// before logstart and after logstop lines go straight to the console
+	if (!logrunning.load(std::memory_order_acquire)) {
+		_LOG_STAMP stamp = { -1 };
+		logwrite(stdout, logstamp(stamp, timenow).console, szBuffer, len);
+		return;
+	}
+
+	// claim a slot, a full ring drops the line instead of blocking the loop
+	uint32_t head = loghead.load(std::memory_order_relaxed);
+	_LOG_RECORD* rec;
+
+	while (true) {
+		rec = &logring[head % LOG_RING_SIZE];
+		uint32_t seq = rec->seq.load(std::memory_order_acquire);
+		if (seq == head) {
+			if (loghead.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if ((int32_t)(seq - head) < 0) {
+			logdropped++;
+			return;
+		}
+		else {
+			head = loghead.load(std::memory_order_relaxed);
+		}
+	}
+
+	rec->time = timenow;
+	rec->type = type;
+	rec->len = len;
+	memcpy(rec->text, szBuffer, len);
+	rec->seq.store(head + 1, std::memory_order_release);
 }
 
 #ifndef _WIN32
@@ -65,33 +762,67 @@ unsigned long long GetTickCount64()
 }
 #endif
 
-DWORD host2ip(const char* hostname)
+static thread_local uint64_t clocktick = 0;
+static thread_local int64_t clockwall = 0;
+
+// a replay runs on the clock of its trace, once set every refresh reads it instead of the real clocks
+static bool clockpinned = false;
+static uint64_t clockpinnedtick = 0;
+static int64_t clockpinnedwall = 0;
+
+void clockset(uint64_t tick, int64_t wall)
 {
-	struct hostent* h = gethostbyname(hostname);
-	return (h != NULL) ? ntohl(*(DWORD*)h->h_addr) : 0;
+	clockpinned = true;
+	clockpinnedtick = tick;
+	clockpinnedwall = wall;
+	clocktick = tick;
+	clockwall = wall;
 }
 
-int SQLSyntexCheck(char* SQLString)
+void clockrefresh()
 {
-	char* temp;
-
-	temp = strchr(SQLString, 39);
-	if (temp == 0)
-	{
-		temp = strchr(SQLString, 32);
-		if (temp == 0)
-		{
-			return 1;
-		}
-		else
-		{
-			return 0;
-		}
-	}
-	else
-	{
-		return 0;
+	if (clockpinned) {
+		clocktick = clockpinnedtick;
+		clockwall = clockpinnedwall;
+		return;
 	}
+
+	clocktick = GetTickCount64();
+	clockwall = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// the wall clock moves with the tick, the other threads and the pinned clock are left alone
+void clockadvance(uint64_t tick)
+{
+	if (clocktick == 0)
+		clockrefresh();
+	clockwall += (int64_t)(tick - clocktick);
+	clocktick = tick;
+}
+
+uint64_t clockmsec()
+{
+	return (clocktick != 0) ? clocktick : GetTickCount64();
+}
+
+int64_t clockwallmsec()
+{
+	if (clocktick != 0)
+		return clockwall;
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+time_t clocktime()
+{
+	return (clocktick != 0) ? (time_t)(clockwall / 1000) : time(NULL);
+}
+
+DWORD host2ip(const char* hostname)
+{
+	struct hostent* h = gethostbyname(hostname);
+	return (h != NULL) ? ntohl(*(DWORD*)h->h_addr) : 0;
 }
 
 DWORD MakeAccountKey(char* lpszAccountID)
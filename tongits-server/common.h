@@ -10,6 +10,7 @@
 #else
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #endif
 #include <csignal>
 #include <iostream>
@@ -36,6 +37,7 @@
 #include <vector>
 #include <string>
 #include <mutex>
+#include <atomic>
 
 #define GAME_TYPE	1	// 1 is for public, cash mode
 #define APK_VER 5
@@ -50,15 +52,20 @@
 #define SMS_API_SECRET "9qdvuuMwQJT8U82BzOSruHi4DOiBFL"
 #define SMS_CB_URL "http://www.muengine.org/tongits_proc.php"
 
-#define MAX_BUFFER_DATA 8192
+#define MAX_BUFFER_DATA 8192	// largest frame accepted for most requests
+#define MAX_FRAME_DATA 65535	// largest a C2 header can say, for the requests that allow more
 #define MAX_USERS_PERGAME 3
 #define MAX_CARD_TYPE 4
 #define MAX_CARDS_PER_TYPE 13
 #define NOTICE_SECONDS_DURATION 3
+#define GAME_TICK_MSEC 500	// status refresh of a table that has no nearer deadline
 #define MAX_MSECONDS_EACHTURN_TIMEOUT 60000
 #define MAX_MSECONDS_GROUPCARD_TIMEOUT 30000
 #define MAX_MSECONDS_SHOWRESULT_TIMEOUT 10000
 #define MAX_MSECONDS_SHOWCARD_TIMEOUT 30000
+#define MAX_MSECONDS_CLOSED_TIMEOUT 5000	// the timeouts are defaults, each bet mode may set its own
+#define ADAPTIVE_TURN_FACTOR 3	// an adaptive turn is this many times the player's average turn
+#define ADAPTIVE_MIN_TURN_MSEC 15000
 #define CARD_ENTITY_LEFT_CURSOR_POS 17
 #define CARD_ENTITY_RIGHT_CURSOR_POS 17
 #define CARD_TABLE_CURSOR_POS 16
@@ -88,11 +95,20 @@
 #define CARD_GRP_CURSOR_POS 30
 #define MAX_USER_POS 3
 #define SHOWCARDATCENTER_DURATION_MSEC	2000
-#define ALIVE_TICK_TIMEOUT 30000
 
 #define ADD_TEST_ECOINS 1000
 
-#define MAX_GAME_SLOT 1000
+#define LOG_DIRECTORY "Log"
+#define LOG_FILENAME "tongits"
+#define LOG_RING_SIZE 4096	// lines the writer thread may fall behind before lines are dropped
+#define LOG_RECORD_SIZE 1024
+#define LOG_FLUSH_MSEC 50
+#define LOG_PACK_SECONDS 3600	// how often the files are swept for age and size without a rotation to wake it
+#define LOG_PACK_CHUNK 65536
+#define LOG_BATCH 256	// lines the writer puts in one writev
+#define LOG_RING_FILE "tongits.ring"	// in LOG_DIRECTORY, the ring on linux, kept for the lines a crash left in it
+
+#define MAX_GAME_SLOT 1000	// defaults of Max Games and Max Users, the slots are grown up to them as they are taken
 #define MAX_USERS MAX_GAME_SLOT * 5
 
 #define SET_NUMBERH(x) ( (BYTE)((DWORD)(x)>>(DWORD)8) )
@@ -175,10 +191,33 @@ enum class _STATE
 
 extern DWORD LOGTYPEENABLED;
 
+// levels built into the binary, define TONGITS_LOG_COMPILED to a smaller mask to strip the rest out of a release build
+#ifndef TONGITS_LOG_COMPILED
+#define TONGITS_LOG_COMPILED ((DWORD)eMSGTYPE::INFO | (DWORD)eMSGTYPE::ERROR | (DWORD)eMSGTYPE::SQL | (DWORD)eMSGTYPE::DEBUG)
+#endif
+
+// the arguments of a log call are only evaluated when its level is on
+#define LOGENABLED(type) ((TONGITS_LOG_COMPILED & (DWORD)(type)) != 0 && (LOGTYPEENABLED & (DWORD)(type)) != 0)
+#define MSGLOG(type, ...) do { if (LOGENABLED(type)) msglog(type, __VA_ARGS__); } while (0)
+
 void msglog(BYTE type, const char* msg, ...);
+void logstart();
+void logstop();
+void logpin(const std::vector<int>& cpus);	// the logger threads to the cores of cpupin.h
+// the console, syslog and a size in MB past which the file of the day is split, 0 for none
+void logsinks(bool console, bool syslog, int rotatemb);
+// files the writer is done with are gzipped on linux, and removed past keepdays or the oldest beyond keepmb, 0 keeps them
+void logretention(bool compress, int keepdays, int keepmb);
 DWORD host2ip(const char* hostname);
 #ifndef _WIN32
 unsigned long long GetTickCount64();
 #endif
-int SQLSyntexCheck(char* SQLString);
+// loop clock, every event and timer callback refreshes it once on entry so the whole callback
+// shares one reading, threads that never refresh it always read the real clocks
+void clockrefresh();
+void clockset(uint64_t tick, int64_t wall);
+void clockadvance(uint64_t tick);	// this thread only, a simulated table skips ahead to its next deadline
+uint64_t clockmsec();
+int64_t clockwallmsec();
+time_t clocktime();
 DWORD MakeAccountKey(char* lpszAccountID);
\ No newline at end of file
@@ -1,5 +1,14 @@
 #include "conf.h"
 #include "user.h"
+#include "dbpool.h"
+#include "logintoken.h"
+#include "bot.h"
+#include "socket.h"
+#include "packet.h"
+#include "spectate.h"
+#include "alive.h"
+#include "rules.h"
+#include "../Common/confcache.h"
 #include <fstream>
 
 conf c;
@@ -7,63 +16,480 @@ conf c;
 conf::conf()
 {
 	this->m_ispassmd5 = false;
+	this->m_issealed = false;
 	this->m_serverport = 0;
 	this->m_isdebug = false;
-	this->m_gpslimitdis = 0.0f;
+	this->m_workerthreads = 1;
+	this->m_tokenkeyversion = 1;
+	this->m_tokendays = LOGINTOKEN_DEFAULT_DAYS;
+	this->m_statsport = 0;
+	this->m_websocketport = 0;
+	this->m_fastport = 0;
+	this->m_clusterport = 0;
+	this->m_maxgames = MAX_GAME_SLOT;
+	this->m_maxusers = 0;
+	this->m_shrinkidlesec = 0;
+	this->m_suspendsec = 60;
+	this->m_serverslomsec = 50;
+	this->m_roundtripslomsec = 500;
+	this->m_spectatedelay = SPECTATE_DEFAULT_DELAY_SEC;
+	this->m_alivetimeout = ALIVE_DEFAULT_TIMEOUT_SEC;
+	this->m_nodeport = 0;
+	this->m_migrateport = 0;
+	this->m_standbyport = 0;
+	this->m_listenbacklog = -1;
+	this->m_maxconnections = 0;
+	this->m_acceptrate = 0;
+	this->m_acceptburst = 0;
+	this->m_resumerate = 0;
+	this->m_resumeburst = 0;
+	this->m_maxoutput = 512 * 1024;
+	this->m_shedlagmsec = 0;
+	this->m_stallmsec = 0;
+	this->m_lobbybudget = 0;
+	this->m_tickbudgetusec = 0;
+	this->m_taskthreads = 0;
+	this->m_slowtablemsec = 0;
+	this->m_eventmempool = false;
+	this->m_hugepages = _HUGE_PAGES::_OFF;
+	this->m_betconf = NULL;
+	this->m_isreloading = false;
+	this->sql.port = DB_DEFAULT_PORT;
+	this->sql.connections = DB_DEFAULT_CONNECTIONS;
+	this->sql.cachesize = DB_CACHE_DEFAULT_SIZE;
+	this->sql.cacheseconds = DB_CACHE_DEFAULT_SECONDS;
+	this->sql.shard = 0;
 }
 
 conf::~conf()
 {
+	this->stopreload();
+	this->m_betconf = NULL;
+	for (size_t n = 0; n < this->m_betconfs.size(); n++)
+		delete this->m_betconfs[n];
+	this->m_betconfs.clear();
+}
 
+static void parsesockopts(const YAML::Node& node, _SOCKET_OPTS& opts)
+{
+	if (node["No Delay"])
+		opts.nodelay = node["No Delay"].as<bool>();
+	if (node["Keepalive Idle"])
+		opts.keepidle = node["Keepalive Idle"].as<int>();
+	if (node["Keepalive Interval"])
+		opts.keepintvl = node["Keepalive Interval"].as<int>();
+	if (node["Keepalive Count"])
+		opts.keepcnt = node["Keepalive Count"].as<int>();
+	if (node["Send Buffer"])
+		opts.sndbuf = node["Send Buffer"].as<int>();
+	if (node["Receive Buffer"])
+		opts.rcvbuf = node["Receive Buffer"].as<int>();
+	if (node["User Timeout"])
+		opts.usertimeout = node["User Timeout"].as<int>();
+	if (node["Fast Open"])
+		opts.fastopen = node["Fast Open"].as<int>();
+	if (node["Quick Ack"])
+		opts.quickack = node["Quick Ack"].as<bool>();
+	if (node["Busy Poll"])
+		opts.busypoll = node["Busy Poll"].as<int>();
 }
 
 void conf::load()
 {
 	try {
-		msglog(INFO, "Loading configurations...");
-		this->configs = YAML::LoadFile(YAML_CONF);
+		MSGLOG(INFO, "Loading configurations...");
+		_CONF_SOURCE source;
+		YAML::Node configs = confcacheload(YAML_CONF, source);
+		if (source.iscached)
+			MSGLOG(INFO, "%s is unchanged, read from its image.", YAML_CONF);
 		this->m_isdebug = configs["Debug Message"].as<bool>();
+		logsinks(configs["Log Console"] ? configs["Log Console"].as<bool>() : true,
+			configs["Log Syslog"] ? configs["Log Syslog"].as<bool>() : false,
+			configs["Log Rotate MB"] ? configs["Log Rotate MB"].as<int>() : 0);
+		logretention(configs["Log Compress"] ? configs["Log Compress"].as<bool>() : true,
+			configs["Log Keep Days"] ? configs["Log Keep Days"].as<int>() : 0,
+			configs["Log Keep MB"] ? configs["Log Keep MB"].as<int>() : 0);
 		this->m_serverport = configs["Server Port"].as<int>();
 		this->m_ispassmd5 = configs["Secret Is MD5"].as<bool>();
-		this->m_gpslimitdis = configs["GPS Limit Distance"].as<float>();
-		this->m_tax = configs["Tax"].as<float>();
 		this->sql.dbname = configs["SQL OdbcName"].as<std::string>();
 		this->sql.user = configs["SQL User"].as<std::string>();
 		this->sql.secret = configs["SQL Secret"].as<std::string>();
+		if (configs["SQL Host"])
+			this->sql.host = configs["SQL Host"].as<std::string>();
+		if (configs["SQL Database"])
+			this->sql.database = configs["SQL Database"].as<std::string>();
+		if (configs["SQL Port"])
+			this->sql.port = configs["SQL Port"].as<int>();
+		if (configs["SQL Connections"])
+			this->sql.connections = configs["SQL Connections"].as<int>();
+		if (configs["SQL Cache Size"])
+			this->sql.cachesize = configs["SQL Cache Size"].as<int>();
+		if (configs["SQL Cache Seconds"])
+			this->sql.cacheseconds = configs["SQL Cache Seconds"].as<int>();
+		if (configs["SQL Replicas"]) {
+			YAML::Node replicas = configs["SQL Replicas"];
+			this->sql.replicas.clear();
+			for (YAML::iterator iter = replicas.begin(); iter != replicas.end(); ++iter)
+				this->sql.replicas.push_back(iter->as<std::string>());
+		}
+		if (configs["SQL Shards"]) {
+			YAML::Node shards = configs["SQL Shards"];
+			this->m_sqlshards.clear();
+			for (YAML::iterator iter = shards.begin(); iter != shards.end(); ++iter) {
+				const YAML::Node& node = *iter;
+				// what a shard leaves out is taken from the SQL keys
+				_SQL shard = this->sql;
+				shard.shard = node["Id"].as<int>();
+				shard.replicas.clear();
+				if (node["Replicas"]) {
+					for (YAML::const_iterator replica = node["Replicas"].begin(); replica != node["Replicas"].end(); ++replica)
+						shard.replicas.push_back(replica->as<std::string>());
+				}
+				shard.host = node["Host"].as<std::string>();
+				if (node["Database"])
+					shard.database = node["Database"].as<std::string>();
+				if (node["Port"])
+					shard.port = node["Port"].as<int>();
+				if (node["User"])
+					shard.user = node["User"].as<std::string>();
+				if (node["Secret"])
+					shard.secret = node["Secret"].as<std::string>();
+				if (node["Connections"])
+					shard.connections = node["Connections"].as<int>();
+				this->m_sqlshards.push_back(shard);
+			}
+		}
 		this->musecret = configs["MU Secret"].as<std::string>();
-		YAML::Node betmodes = configs["Tongits Bet Modes"];
-		YAML::iterator iter = betmodes.begin();
-		while (iter != betmodes.end()) {
-			const YAML::Node& betmode = *iter;
-			_TONGITS_BET_INFO betinfo;
-			betinfo.name = betmode["Name"].as<std::string>();
-			betinfo.enable = betmode["Enable"].as<bool>();
-			betinfo.type = betmode["Type"].as<int>();
-			betinfo.hits = betmode["Hits Base"].as<int>();
-			betinfo.hitsadd = betmode["Hits Add"].as<int>();
-			betinfo.tongits = betmode["Tongits"].as<int>();
-			betinfo.nontongits = betmode["Non-Tongits"].as<int>();
-			betinfo.fight = betmode["Fight"].as<int>();
-			betinfo.fightpercard = betmode["Fight Per Card"].as<int>();
-			betinfo.quadra = betmode["Quadra"].as<int>();
-			betinfo.royal = betmode["Royal"].as<int>();
-			betinfo.ace = betmode["Ace"].as<int>();
-			betinfo.sagasa = betmode["Sagasa"].as<int>();
-			betinfo.burned = betmode["Burned"].as<int>();
-			this->mTongitsBetModes.insert(std::make_pair(betinfo.type, betinfo));
-			iter++;
+		if (configs["Worker Threads"])
+			this->m_workerthreads = configs["Worker Threads"].as<int>();
+		if (configs["Token Secret"])
+			this->m_tokensecret = configs["Token Secret"].as<std::string>();
+		if (configs["Token Key Version"])
+			this->m_tokenkeyversion = configs["Token Key Version"].as<int>();
+		if (configs["Token Days"])
+			this->m_tokendays = configs["Token Days"].as<int>();
+		if (configs["Sealed Connections"])
+			this->m_issealed = configs["Sealed Connections"].as<bool>();
+		if (configs["Stats Port"])
+			this->m_statsport = configs["Stats Port"].as<int>();
+		if (configs["WebSocket Port"])
+			this->m_websocketport = configs["WebSocket Port"].as<int>();
+		if (configs["Fast Port"])
+			this->m_fastport = configs["Fast Port"].as<int>();
+		if (configs["SMS Providers"]) {
+			YAML::Node providers = configs["SMS Providers"];
+			this->m_smsproviders.clear();
+			for (YAML::iterator iter = providers.begin(); iter != providers.end(); ++iter) {
+				_SMS_PROVIDER provider;
+				provider.name = (*iter)["Name"].as<std::string>();
+				provider.url = (*iter)["URL"].as<std::string>();
+				this->m_smsproviders.push_back(provider);
+			}
+		}
+		if (configs["Latency Regions"]) {
+			YAML::Node regions = configs["Latency Regions"];
+			this->m_latencyregions.clear();
+			for (YAML::iterator iter = regions.begin(); iter != regions.end(); ++iter) {
+				_LATENCY_REGION region;
+				region.name = (*iter)["Name"].as<std::string>();
+				region.minlatitude = (*iter)["Min Latitude"].as<double>();
+				region.maxlatitude = (*iter)["Max Latitude"].as<double>();
+				region.minlongitude = (*iter)["Min Longitude"].as<double>();
+				region.maxlongitude = (*iter)["Max Longitude"].as<double>();
+				this->m_latencyregions.push_back(region);
+			}
+		}
+		if (configs["Server Time SLO"])
+			this->m_serverslomsec = configs["Server Time SLO"].as<int>();
+		if (configs["Round Trip SLO"])
+			this->m_roundtripslomsec = configs["Round Trip SLO"].as<int>();
+		if (configs["Trace File"])
+			this->m_tracefile = configs["Trace File"].as<std::string>();
+		if (configs["Cluster Role"])
+			this->m_clusterrole = configs["Cluster Role"].as<std::string>();
+		if (configs["Cluster Port"])
+			this->m_clusterport = configs["Cluster Port"].as<int>();
+		if (configs["Router Host"])
+			this->m_routerhost = configs["Router Host"].as<std::string>();
+		if (configs["Node Host"])
+			this->m_nodehost = configs["Node Host"].as<std::string>();
+		if (configs["Node Port"])
+			this->m_nodeport = configs["Node Port"].as<int>();
+		if (configs["Session Store"])
+			this->m_sessionstore = configs["Session Store"].as<std::string>();
+		if (configs["Migrate Port"])
+			this->m_migrateport = configs["Migrate Port"].as<int>();
+		if (configs["Standby Role"])
+			this->m_standbyrole = configs["Standby Role"].as<std::string>();
+		if (configs["Standby Host"])
+			this->m_standbyhost = configs["Standby Host"].as<std::string>();
+		if (configs["Standby Port"])
+			this->m_standbyport = configs["Standby Port"].as<int>();
+		if (configs["Max Games"])
+			this->m_maxgames = configs["Max Games"].as<int>();
+		if (configs["Max Users"])
+			this->m_maxusers = configs["Max Users"].as<int>();
+		if (configs["Shrink Idle Seconds"])
+			this->m_shrinkidlesec = configs["Shrink Idle Seconds"].as<int>();
+		if (configs["Suspend Seconds"])
+			this->m_suspendsec = configs["Suspend Seconds"].as<int>();
+		if (configs["Spectate Delay Seconds"])
+			this->m_spectatedelay = configs["Spectate Delay Seconds"].as<int>();
+		if (configs["Alive Timeout Seconds"] && configs["Alive Timeout Seconds"].as<int>() > 0)
+			this->m_alivetimeout = configs["Alive Timeout Seconds"].as<int>();
+		if (configs["Socket Options"])
+			parsesockopts(configs["Socket Options"], this->m_sockopts);
+		this->m_wssockopts = this->m_sockopts;
+		if (configs["WebSocket Socket Options"])
+			parsesockopts(configs["WebSocket Socket Options"], this->m_wssockopts);
+		if (configs["Listen Backlog"] && configs["Listen Backlog"].as<int>() != 0)
+			this->m_listenbacklog = configs["Listen Backlog"].as<int>();
+		if (configs["Max Connections"])
+			this->m_maxconnections = configs["Max Connections"].as<int>();
+		if (configs["Accept Rate"])
+			this->m_acceptrate = std::min(configs["Accept Rate"].as<int>(), 1000);	// a token is at least a msec of refill
+		if (configs["Accept Burst"])
+			this->m_acceptburst = configs["Accept Burst"].as<int>();
+		if (configs["Resume Rate"])
+			this->m_resumerate = configs["Resume Rate"].as<int>();
+		if (configs["Resume Burst"])
+			this->m_resumeburst = configs["Resume Burst"].as<int>();
+		if (configs["Max Output"])
+			this->m_maxoutput = configs["Max Output"].as<int>();
+		if (configs["Shed Loop Lag"])
+			this->m_shedlagmsec = configs["Shed Loop Lag"].as<int>();
+		if (configs["Slow Table"])
+			this->m_slowtablemsec = configs["Slow Table"].as<int>();
+		if (configs["Stall Report"])
+			this->m_stallmsec = configs["Stall Report"].as<int>();
+		if (configs["Task Threads"])
+			this->m_taskthreads = configs["Task Threads"].as<int>();
+		if (configs["Lobby Budget"])
+			this->m_lobbybudget = configs["Lobby Budget"].as<int>();
+		if (configs["Tick Budget Usec"])
+			this->m_tickbudgetusec = configs["Tick Budget Usec"].as<int>();
+		if (configs["Event Memory Pool"])
+			this->m_eventmempool = configs["Event Memory Pool"].as<bool>();
+		if (configs["Huge Pages"]) {
+			std::string hugepages = configs["Huge Pages"].as<std::string>();
+			if (hugepages == "thp")
+				this->m_hugepages = _HUGE_PAGES::_THP;
+			else if (hugepages == "hugetlb")
+				this->m_hugepages = _HUGE_PAGES::_HUGETLB;
+			else if (hugepages != "off")
+				MSGLOG(eMSGTYPE::ERROR, "Huge Pages is off, thp or hugetlb, not %s.", hugepages.c_str());
+		}
+		if (configs["Loop CPUs"])
+			this->m_loopcpus = configs["Loop CPUs"].as<std::string>();
+		if (configs["Loop Interface"])
+			this->m_loopinterface = configs["Loop Interface"].as<std::string>();
+		if (configs["Task CPUs"])
+			this->m_taskcpus = configs["Task CPUs"].as<std::string>();
+		if (configs["Log CPUs"])
+			this->m_logcpus = configs["Log CPUs"].as<std::string>();
+		// another server may have changed a cached account since
+		if (!this->m_clusterrole.empty())
+			this->sql.cachesize = 0;
+		_BET_CONF* betconf = this->parsebetconf(configs);
+		if (betconf != NULL) {
+			this->publish(betconf);
+			if (!confcachesave(YAML_CONF, source, configs))
+				MSGLOG(eMSGTYPE::ERROR, "The image of %s could not be written, it is parsed again next time.", YAML_CONF);
 		}
-		msglog(INFO, "Loading configurations done.");
 	}
 	catch (const YAML::BadFile& e) {
-		msglog(eMSGTYPE::ERROR, "YAML error, %s.", e.msg.c_str());
+		MSGLOG(eMSGTYPE::ERROR, "YAML error, %s.", e.msg.c_str());
 	}
 	catch (const YAML::ParserException& e) {
-		msglog(eMSGTYPE::ERROR, "YAML error, %s.", e.msg.c_str());
+		MSGLOG(eMSGTYPE::ERROR, "YAML error, %s.", e.msg.c_str());
+	}
+}
+
+// the part of the conf a reload may change, NULL when it does not hold together. runs on the reload
+// thread, so it only reads the yaml and touches nothing that is published
+_BET_CONF* conf::parsebetconf(const YAML::Node& configs)
+{
+	_BET_CONF* betconf = new _BET_CONF();
+	betconf->version = 0;	// numbered when it is published
+	betconf->gpslimitdis = configs["GPS Limit Distance"].as<float>();
+	betconf->gpslimitcos = cos(betconf->gpslimitdis / 6371.0);
+	betconf->tax = configs["Tax"].as<float>();
+	betconf->botfillsec = 0;
+	betconf->botthinkmsec = BOT_DEFAULT_THINK_MSEC;
+	betconf->botecoins = BOT_DEFAULT_ECOINS;
+	betconf->botrolloutmsec = 0;
+	betconf->botrolloutpercent = 100;
+	if (configs["Bot Fill Seconds"])
+		betconf->botfillsec = configs["Bot Fill Seconds"].as<int>();
+	if (configs["Bot Think Msec"])
+		betconf->botthinkmsec = configs["Bot Think Msec"].as<int>();
+	if (configs["Bot Ecoins"])
+		betconf->botecoins = configs["Bot Ecoins"].as<int>();
+	if (configs["Bot Rollout Msec"])
+		betconf->botrolloutmsec = configs["Bot Rollout Msec"].as<int>();
+	if (configs["Bot Rollout Percent"])
+		betconf->botrolloutpercent = configs["Bot Rollout Percent"].as<int>();
+	if (betconf->tax < 0.0f || betconf->tax >= 1.0f || betconf->gpslimitdis < 0.0f) {
+		MSGLOG(eMSGTYPE::ERROR, "conf, Tax has to be in [0, 1) and GPS Limit Distance not negative.");
+		delete betconf;
+		return NULL;
+	}
+	YAML::Node betmodes = configs["Tongits Bet Modes"];
+	YAML::iterator iter = betmodes.begin();
+	while (iter != betmodes.end()) {
+		const YAML::Node& betmode = *iter;
+		_TONGITS_BET_INFO betinfo;
+		betinfo.name = betmode["Name"].as<std::string>();
+		betinfo.enable = betmode["Enable"].as<bool>();
+		betinfo.type = betmode["Type"].as<int>();
+		betinfo.hits = betmode["Hits Base"].as<int>();
+		betinfo.hitsadd = betmode["Hits Add"].as<int>();
+		betinfo.tongits = betmode["Tongits"].as<int>();
+		betinfo.nontongits = betmode["Non-Tongits"].as<int>();
+		betinfo.fight = betmode["Fight"].as<int>();
+		betinfo.fightpercard = betmode["Fight Per Card"].as<int>();
+		betinfo.quadra = betmode["Quadra"].as<int>();
+		betinfo.royal = betmode["Royal"].as<int>();
+		betinfo.ace = betmode["Ace"].as<int>();
+		betinfo.sagasa = betmode["Sagasa"].as<int>();
+		betinfo.burned = betmode["Burned"].as<int>();
+		betinfo.turnmsec = MAX_MSECONDS_EACHTURN_TIMEOUT;
+		betinfo.groupcardmsec = MAX_MSECONDS_GROUPCARD_TIMEOUT;
+		betinfo.showcardmsec = MAX_MSECONDS_SHOWCARD_TIMEOUT;
+		betinfo.showresultmsec = MAX_MSECONDS_SHOWRESULT_TIMEOUT;
+		betinfo.closedmsec = MAX_MSECONDS_CLOSED_TIMEOUT;
+		betinfo.isadaptive = false;
+		betinfo.minturnmsec = ADAPTIVE_MIN_TURN_MSEC;
+		betinfo.rules = "Classic";
+		if (betmode["Turn Msec"])
+			betinfo.turnmsec = betmode["Turn Msec"].as<int>();
+		if (betmode["Group Card Msec"])
+			betinfo.groupcardmsec = betmode["Group Card Msec"].as<int>();
+		if (betmode["Show Card Msec"])
+			betinfo.showcardmsec = betmode["Show Card Msec"].as<int>();
+		if (betmode["Show Result Msec"])
+			betinfo.showresultmsec = betmode["Show Result Msec"].as<int>();
+		if (betmode["Closed Msec"])
+			betinfo.closedmsec = betmode["Closed Msec"].as<int>();
+		if (betmode["Adaptive Turn"])
+			betinfo.isadaptive = betmode["Adaptive Turn"].as<bool>();
+		if (betmode["Adaptive Min Turn Msec"])
+			betinfo.minturnmsec = betmode["Adaptive Min Turn Msec"].as<int>();
+		if (betmode["House Rules"])
+			betinfo.rules = betmode["House Rules"].as<std::string>();
+		betconf->modes[betinfo.type] = betinfo;
+		iter++;
+	}
+	for (int n = 0; n < 2; n++) {
+		std::map <unsigned char, _TONGITS_BET_INFO>::const_iterator mode = betconf->modes.find(n);
+		if (mode == betconf->modes.end() || mode->second.turnmsec <= 0 || mode->second.groupcardmsec <= 0 ||
+			mode->second.showcardmsec <= 0 || mode->second.showresultmsec <= 0 || mode->second.closedmsec <= 0) {
+			MSGLOG(eMSGTYPE::ERROR, "conf, bet mode Type %d is missing or has a timeout that is not positive.", n);
+			delete betconf;
+			return NULL;
+		}
+		betconf->rules[n] = rulesfind(mode->second.rules);
+		if (betconf->rules[n] == NULL) {
+			MSGLOG(eMSGTYPE::ERROR, "conf, bet mode Type %d has House Rules %s, not Classic, Casual or Strict.", n, mode->second.rules.c_str());
+			delete betconf;
+			return NULL;
+		}
+	}
+	for (int n = 0; n < 2; n++) {
+		_TONGITS_BET_INFO betinfo = betconf->modes[n];
+		betconf->ecoins[n].hitbaseaddecoins = betinfo.hits;
+		betconf->ecoins[n].hitaddecoins = betinfo.hitsadd;
+		betconf->ecoins[n].nodownaddecoins = betinfo.burned;
+		betconf->ecoins[n].nontongitaddecoins = betinfo.nontongits;
+		betconf->ecoins[n].tongitaddecoins = betinfo.tongits;
+		betconf->ecoins[n].sagasaaddecoins = betinfo.sagasa;
+		betconf->ecoins[n].royaladdecoins = betinfo.royal;
+		betconf->ecoins[n].quadraaddecoins = betinfo.quadra;
+		betconf->ecoins[n].foughtbaseaddecoins = betinfo.fight;
+		betconf->ecoins[n].foughtpercardaddecoins = betinfo.fightpercard;
+		betconf->ecoins[n].aceaddecoins = betinfo.ace;
+		betconf->timeouts[n].turn = betinfo.turnmsec;
+		betconf->timeouts[n].groupcard = betinfo.groupcardmsec;
+		betconf->timeouts[n].showcard = betinfo.showcardmsec;
+		betconf->timeouts[n].showresult = betinfo.showresultmsec;
+		betconf->timeouts[n].closed = betinfo.closedmsec;
+		betconf->timeouts[n].isadaptive = betinfo.isadaptive;
+		betconf->timeouts[n].minturn = std::min(betinfo.minturnmsec, betinfo.turnmsec);
+	}
+	// the constant part of the login result of this version, the senders patch in the account
+	betconf->loginresult = pkttemplate<_PMSG_LOGIN_RESULT>(0xF2, 0x09);
+	betconf->loginresult.result = 1; // option to create game
+	strncpy(betconf->loginresult.ecoinsnote, betconf->modes[0].name.c_str(), sizeof(betconf->loginresult.ecoinsnote) - 1);
+	strncpy(betconf->loginresult.jewelsnote, betconf->modes[1].name.c_str(), sizeof(betconf->loginresult.jewelsnote) - 1);
+	return betconf;
+}
+
+// loop 0, games pick the new modes up from their next round
+void conf::publish(_BET_CONF* betconf)
+{
+	const _BET_CONF* current = this->m_betconf.load(std::memory_order_acquire);
+	betconf->version = (current != NULL) ? current->version + 1 : 1;
+	this->m_betconfs.push_back(betconf);
+	this->m_betconf.store(betconf, std::memory_order_release);
+	MSGLOG(INFO, "Loading configurations done, bet modes version %d.", betconf->version);
+}
+
+// the yaml is parsed on a thread of its own, the loops only see the pointer swap. settings other than
+// those of _BET_CONF keep their startup values until a restart
+void conf::reload()
+{
+	if (this->m_isreloading.exchange(true)) {
+		MSGLOG(INFO, "A reload of the configurations is already running.");
+		return;
 	}
+
+	// the previous reload has long finished, it cleared the flag
+	if (this->m_reloadthread.joinable())
+		this->m_reloadthread.join();
+
+	this->m_reloadthread = std::thread([this]() {
+		_BET_CONF* betconf = NULL;
+		try {
+			_CONF_SOURCE source;
+			YAML::Node configs = confcacheload(YAML_CONF, source);
+			betconf = this->parsebetconf(configs);
+			if (betconf != NULL && !confcachesave(YAML_CONF, source, configs))
+				MSGLOG(eMSGTYPE::ERROR, "The image of %s could not be written, it is parsed again next time.", YAML_CONF);
+		}
+		catch (const YAML::Exception& e) {
+			MSGLOG(eMSGTYPE::ERROR, "YAML error, %s.", e.msg.c_str());
+		}
+
+		if (betconf == NULL) {
+			MSGLOG(eMSGTYPE::ERROR, "Reload of the configurations failed, the running ones stay.");
+			this->m_isreloading = false;
+			return;
+		}
+
+		le_post([this, betconf]() {
+			this->publish(betconf);
+			this->m_isreloading = false;
+		});
+	});
+}
+
+void conf::stopreload()
+{
+	if (this->m_reloadthread.joinable())
+		this->m_reloadthread.join();
+}
+
+const _BET_CONF* conf::getbetconf()
+{
+	static const _BET_CONF empty = {};
+	const _BET_CONF* betconf = this->m_betconf.load(std::memory_order_acquire);
+	return (betconf != NULL) ? betconf : &empty;
 }
 
-_TONGITS_BET_INFO conf::getbetmode(int type)
+const _TONGITS_BET_INFO& conf::getbetmode(int type)
 {
-	return this->mTongitsBetModes[type];
+	static const _TONGITS_BET_INFO empty = {};
+	const _BET_CONF* betconf = this->getbetconf();
+	std::map <unsigned char, _TONGITS_BET_INFO>::const_iterator iter = betconf->modes.find(type);
+	return (iter != betconf->modes.end()) ? iter->second : empty;
 }
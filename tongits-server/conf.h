@@ -1,15 +1,42 @@
 #pragma once
 #include "common.h"
+#include "slabmem.h"
 #include <map>
 #include <vector>
+#include <thread>
 
 #define YAML_CONF "conf.yaml"
 
+struct _HOUSE_RULES;	// rules.h
+
 struct _SQL
 {
 	std::string dbname;
 	std::string  user;
 	std::string  secret;
+	std::string host;	// empty keeps the server without a database
+	std::string database;
+	int port;
+	int connections;
+	int cachesize;	// accounts kept by the login cache, 0 turns it off
+	int cacheseconds;
+	int shard;	// Id of an SQL Shards entry, 0 for the SQL Host alone
+	std::vector<std::string> replicas;	// "host" or "host:port" of its read replicas
+};
+
+struct _SMS_PROVIDER
+{
+	std::string name;
+	std::string url;	// takes the fields of smsfields
+};
+
+struct _LATENCY_REGION
+{
+	std::string name;
+	double minlatitude;
+	double maxlatitude;
+	double minlongitude;
+	double maxlongitude;
 };
 
 struct _TONGITS_BET_INFO
@@ -28,6 +55,90 @@ struct _TONGITS_BET_INFO
 	int ace;
 	int sagasa;
 	int burned;
+	int turnmsec;
+	int groupcardmsec;
+	int showcardmsec;
+	int showresultmsec;
+	int closedmsec;
+	bool isadaptive;	// fast players get a shorter turn, down to minturnmsec
+	int minturnmsec;
+	std::string rules;	// house rules policy, see rules.h
+};
+
+struct _GAME_TIMEOUTS
+{
+	int turn;
+	int groupcard;
+	int showcard;
+	int showresult;
+	int closed;
+	bool isadaptive;
+	int minturn;
+};
+
+struct _GAME_TYPE_ECOINSINFO
+{
+	int hitbaseaddecoins;
+	int hitaddecoins;
+	int nodownaddecoins;
+	int nontongitaddecoins;
+	int tongitaddecoins;
+	int sagasaaddecoins;
+	int royaladdecoins;
+	int quadraaddecoins;
+	int foughtbaseaddecoins;
+	int foughtpercardaddecoins;
+	int aceaddecoins;
+};
+
+// TCP options of the accepted sockets of a port, "Socket Options" and "WebSocket Socket Options", which
+// starts as a copy of the first. a zero keeps the system default, read once at startup
+struct _SOCKET_OPTS
+{
+	_SOCKET_OPTS()
+	{
+		nodelay = true;
+		keepidle = 0;
+		keepintvl = 0;
+		keepcnt = 0;
+		sndbuf = 0;
+		rcvbuf = 0;
+		usertimeout = 0;
+		fastopen = 0;
+		quickack = false;
+		busypoll = 0;
+	}
+
+	bool nodelay;	// a move leaves at once instead of waiting for the ack of the last one
+	int keepidle;	// seconds idle before the first keepalive probe, keepalive stays off at 0
+	int keepintvl;
+	int keepcnt;
+	int sndbuf;
+	int rcvbuf;	// set on the listener too, the window scale is agreed in the handshake
+	int usertimeout;	// msec sent data may stay unacknowledged before the player is dropped
+	int fastopen;	// pending fast open requests the listener queues
+	bool quickack;
+	int busypoll;	// usec
+};
+
+// everything a reload may change, parsed off the loops and published whole, never changed afterwards.
+// the rest of the conf is read once at startup
+struct _BET_CONF
+{
+	int version;
+	std::map <unsigned char, _TONGITS_BET_INFO> modes;
+	_GAME_TYPE_ECOINSINFO ecoins[2];	// modes 0 and 1 as the games score them
+	_GAME_TIMEOUTS timeouts[2];
+	const _HOUSE_RULES* rules[2];
+	_PMSG_LOGIN_RESULT loginresult;	// back in the lobby, only the player's own fields are left to fill
+	float tax;
+	float gpslimitdis;
+	double gpslimitcos;	// cosine of the limit as an angle on the earth
+	int botfillsec;	// wait in the match queue before bots take the empty seats, 0 keeps them out
+	int botthinkmsec;	// a bot plays its turn this long after it began
+	int botecoins;	// stake of a bot in either bet mode
+	int botrolloutmsec;	// a drop weighed with rollouts takes this long, 0 keeps every bot on the greedy play
+	int botrolloutpercent;	// of the bots seated, the ones that weigh their drops
 };
 
 class conf
@@ -37,35 +148,147 @@ public:
 	~conf();
 	
 	void load();
+	void reload();
+	void stopreload();
 
 	unsigned short getserverport() { return m_serverport; }
 	std::string getmusecret() { return musecret; }
 
 	bool isdebug() { return m_isdebug; }
 	bool issecretmd5() { return m_ispassmd5; }
-	float getgpslimitdis() { return this->m_gpslimitdis; }
-	float getax() { return this->m_tax; }
+	float getgpslimitdis() { return this->getbetconf()->gpslimitdis; }
+	double getgpslimitcos() { return this->getbetconf()->gpslimitcos; }
+	float getax() { return this->getbetconf()->tax; }
+	int getworkerthreads() { return this->m_workerthreads; }
+	std::string gettokensecret() { return this->m_tokensecret; }
+	int gettokenkeyversion() { return this->m_tokenkeyversion; }
+	int gettokendays() { return this->m_tokendays; }
+	bool issealed() { return this->m_issealed; }
+	unsigned short getstatsport() { return this->m_statsport; }
+	unsigned short getwebsocketport() { return this->m_websocketport; }
+	unsigned short getfastport() { return this->m_fastport; }
+	std::vector<_SMS_PROVIDER> getsmsproviders() { return this->m_smsproviders; }
+	std::vector<_LATENCY_REGION> getlatencyregions() { return this->m_latencyregions; }
+	int getserverslomsec() { return this->m_serverslomsec; }
+	int getroundtripslomsec() { return this->m_roundtripslomsec; }
+	std::string gettracefile() { return this->m_tracefile; }
+	int getbotfillsec() { return this->getbetconf()->botfillsec; }
+	int getbotthinkmsec() { return this->getbetconf()->botthinkmsec; }
+	int getbotecoins() { return this->getbetconf()->botecoins; }
+	int getbotrolloutmsec() { return this->getbetconf()->botrolloutmsec; }
+	int getbotrolloutpercent() { return this->getbetconf()->botrolloutpercent; }
+	std::string getclusterrole() { return this->m_clusterrole; }
+	unsigned short getclusterport() { return this->m_clusterport; }
+	std::string getrouterhost() { return this->m_routerhost; }
+	std::string getnodehost() { return this->m_nodehost; }
+	unsigned short getnodeport() { return (this->m_nodeport != 0) ? this->m_nodeport : this->m_serverport; }
+	std::string getsessionstore() { return this->m_sessionstore; }
+	unsigned short getmigrateport() { return this->m_migrateport; }
+	std::string getstandbyrole() { return this->m_standbyrole; }
+	std::string getstandbyhost() { return this->m_standbyhost; }
+	unsigned short getstandbyport() { return this->m_standbyport; }
+	int getmaxgames() { return this->m_maxgames; }
+	int getmaxusers() { return (this->m_maxusers != 0) ? this->m_maxusers : this->m_maxgames * (MAX_USERS / MAX_GAME_SLOT); }
+	int getshrinkidlesec() { return this->m_shrinkidlesec; }
+	int getsuspendsec() { return this->m_suspendsec; }
+	int getspectatedelay() { return this->m_spectatedelay; }
+	int getalivetimeout() { return this->m_alivetimeout; }
+	const _SOCKET_OPTS& getsockopts(bool iswebsocket) { return iswebsocket ? this->m_wssockopts : this->m_sockopts; }
+	int getlistenbacklog() { return this->m_listenbacklog; }
+	int getmaxconnections() { return this->m_maxconnections; }
+	int getacceptrate() { return this->m_acceptrate; }
+	int getacceptburst() { return (this->m_acceptburst > 0) ? this->m_acceptburst : this->m_acceptrate; }
+	int getresumerate() { return this->m_resumerate; }
+	int getresumeburst() { return (this->m_resumeburst > 0) ? this->m_resumeburst : this->m_resumerate; }
+	int getmaxoutput() { return this->m_maxoutput; }
+	int getshedlagmsec() { return this->m_shedlagmsec; }
+	int getstallmsec() { return this->m_stallmsec; }
+	int getlobbybudget() { return this->m_lobbybudget; }
+	int gettickbudgetusec() { return this->m_tickbudgetusec; }
+	int gettaskthreads() { return this->m_taskthreads; }
+	int getslowtablemsec() { return this->m_slowtablemsec; }
+	bool geteventmempool() { return this->m_eventmempool; }
+	_HUGE_PAGES gethugepages() { return this->m_hugepages; }
+	std::string getloopcpus() { return this->m_loopcpus; }
+	std::string getloopinterface() { return this->m_loopinterface; }
+	std::string gettaskcpus() { return this->m_taskcpus; }
+	std::string getlogcpus() { return this->m_logcpus; }
 
 	_SQL getsql() { return sql; }
+	std::vector<_SQL> getsqlshards() { return this->m_sqlshards; }
 
-	_TONGITS_BET_INFO getbetmode(int type);
+	const _TONGITS_BET_INFO& getbetmode(int type);
+	const _BET_CONF* getbetconf();
 
 private:
 
-	std::map <unsigned char, _TONGITS_BET_INFO> mTongitsBetModes;
+	_BET_CONF* parsebetconf(const YAML::Node& configs);
+	void publish(_BET_CONF* betconf);
 
-	YAML::Node configs;
+	std::atomic<const _BET_CONF*> m_betconf;
+	std::vector<_BET_CONF*> m_betconfs;	// every published snapshot, games may still hold an old one
+	std::atomic<bool> m_isreloading;
+	std::thread m_reloadthread;
 
 	bool m_ispassmd5;
 	unsigned short m_serverport;
 	bool m_isdebug;
 
-	float m_gpslimitdis;
-	float m_tax;
+	int m_workerthreads;
 
 	std::string musecret;
+	std::string m_tokensecret;	// hmac key of the login tokens, a random one is made when it is missing
+	int m_tokenkeyversion;
+	int m_tokendays;
+	bool m_issealed;	// Sealed Connections, apps with a login token may seal the game port, see seal.h
+	unsigned short m_statsport;	// local http port of the request stats, 0 keeps it closed
+	unsigned short m_websocketport;	// of the web client, 0 keeps it closed
+	unsigned short m_fastport;	// udp port of the fast lane, 0 offers none, see fastlane.h
+	std::vector<_SMS_PROVIDER> m_smsproviders;	// SMS Providers, empty sends to SMS_URL alone, see sms.h, startup only
+	std::vector<_LATENCY_REGION> m_latencyregions;	// Latency Regions by gps box, see latency.h, startup only
+	int m_serverslomsec;	// Server Time SLO, a stamped request that took longer is a breach, 0 counts none
+	int m_roundtripslomsec;	// Round Trip SLO, of the round trips the apps report
+	std::string m_tracefile;	// input trace for --replay, empty keeps it off
+	std::string m_clusterrole;	// router, node or empty for a server on its own
+	unsigned short m_clusterport;	// udp port the router hears the heartbeats at
+	std::string m_routerhost;
+	std::string m_nodehost;	// what the router hands the clients of this node
+	unsigned short m_nodeport;	// 0 is the Server Port
+	std::string m_sessionstore;	// local, replicated or database, see sessiondir.h
+	unsigned short m_migrateport;	// tcp port the tables of a draining node come in at, 0 keeps it closed
+	std::string m_standbyrole;	// primary, standby or empty, see standby.h, startup only
+	std::string m_standbyhost;	// of the standby, on the primary
+	unsigned short m_standbyport;	// tcp port the standby hears the primary at
+	int m_maxgames;	// read once at startup
+	int m_maxusers;	// 0 is five per game
+	int m_shrinkidlesec;	// an idle slab of tables is handed back after this long, 0 keeps them
+	int m_suspendsec;	// a table all its players left goes to the suspend store after this long, 0 keeps it
+	int m_spectatedelay;	// seconds the watchers are behind the players
+	int m_alivetimeout;	// seconds a connection may stay silent
+	_SOCKET_OPTS m_sockopts;	// of the Server Port
+	_SOCKET_OPTS m_wssockopts;	// of the WebSocket Port
+	int m_listenbacklog;	// of both game ports, -1 is libevent's
+	int m_maxconnections;	// open connections of each game port, 0 is unlimited
+	int m_acceptrate;	// connections per second of one address, 0 is unlimited
+	int m_acceptburst;	// 0 is Accept Rate
+	int m_resumerate;	// token logins a second that resume a table, 0 is unlimited, see admit.h
+	int m_resumeburst;	// 0 is Resume Rate
+	int m_maxoutput;	// Max Output, bytes unsent to one connection before it is closed, 0 is unlimited
+	int m_shedlagmsec;	// loop lag that stops both listeners, 0 never
+	int m_slowtablemsec;	// Slow Table, a game timer callback running longer is logged with the table, 0 never
+	int m_stallmsec;	// Stall Report, a loop stuck in one callback for longer is logged with its handler, 0 never, startup only
+	int m_taskthreads;	// Task Threads, of the background task pool, 0 takes the cores the loops leave, startup only
+	int m_lobbybudget;	// Lobby Budget, connections not at a table a loop parses after its other work per pass, 0 parses them at once
+	int m_tickbudgetusec;	// Tick Budget Usec, a loop runs due tables for this long and reads its connections before the rest, 0 runs each from its timer
+	bool m_eventmempool;	// Event Memory Pool, libevent allocates from size classes, startup only
+	_HUGE_PAGES m_hugepages;	// Huge Pages of the user and game slabs, off, thp or hugetlb, startup only
+	std::string m_loopcpus;	// Loop CPUs, a core a loop, empty leaves them to the scheduler, see cpupin.h, startup only
+	std::string m_loopinterface;	// Loop Interface, the loops follow its interrupts when Loop CPUs is empty, startup only
+	std::string m_taskcpus;	// Task CPUs of the task pool threads, startup only
+	std::string m_logcpus;	// Log CPUs of the logger threads, startup only
 
 	_SQL sql;
+	std::vector<_SQL> m_sqlshards;	// SQL Shards, empty keeps every account on SQL Host, see dbpool.h, startup only
 };
 
 extern conf c;
@@ -0,0 +1,207 @@
+#include "cpupin.h"
+#include "common.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+bool cpuparse(const std::string& text, std::vector<int>& cpus)
+{
+	size_t at = 0;
+
+	cpus.clear();
+	while (at < text.length()) {
+		size_t end = text.find(',', at);
+		if (end == std::string::npos)
+			end = text.length();
+
+		std::string item = text.substr(at, end - at);
+		item.erase(std::remove(item.begin(), item.end(), ' '), item.end());
+		at = end + 1;
+		if (item.empty())
+			continue;
+
+		char* rest = NULL;
+		long first = strtol(item.c_str(), &rest, 10);
+		long last = first;
+		if (rest == item.c_str())
+			return false;
+		if (*rest == '-')
+			last = strtol(rest + 1, &rest, 10);
+		if (*rest != 0 || first < 0 || last < first || last >= CPUPIN_MAX)
+			return false;
+
+		for (long cpu = first; cpu <= last; cpu++)
+			cpus.push_back((int)cpu);
+	}
+
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return true;
+}
+
+// runs back to a-b again, for the log
+std::string cpuformat(const std::vector<int>& cpus)
+{
+	std::string text;
+	char item[32];
+
+	for (size_t n = 0; n < cpus.size();) {
+		size_t last = n;
+		while (last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1)
+			last++;
+		if (last > n)
+			snprintf(item, sizeof(item), "%s%d-%d", text.empty() ? "" : ",", cpus[n], cpus[last]);
+		else
+			snprintf(item, sizeof(item), "%s%d", text.empty() ? "" : ",", cpus[n]);
+		text += item;
+		n = last + 1;
+	}
+	return text;
+}
+
+#ifndef _WIN32
+static void cpuirqadd(int irq, std::vector<int>& cpus)
+{
+	char path[64];
+	char line[256];
+	std::vector<int> set;
+
+	snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", irq);
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+		return;
+	if (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\r\n")] = 0;
+		if (cpuparse(line, set))
+			cpus.insert(cpus.end(), set.begin(), set.end());
+	}
+	fclose(fp);
+}
+#endif
+
+bool cpuirqs(const std::string& nic, std::vector<int>& cpus)
+{
+	cpus.clear();
+#ifdef _WIN32
+	return false;
+#else
+	int irqs = 0;
+
+	// the msi vectors of the device, whatever the driver named them
+	std::string dirname = "/sys/class/net/" + nic + "/device/msi_irqs";
+	DIR* dir = opendir(dirname.c_str());
+	if (dir != NULL) {
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if (entry->d_name[0] < '0' || entry->d_name[0] > '9')
+				continue;
+			cpuirqadd(atoi(entry->d_name), cpus);
+			irqs++;
+		}
+		closedir(dir);
+	}
+
+	// a virtual nic without msi, by its name in the interrupt table
+	if (irqs == 0) {
+		FILE* fp = fopen("/proc/interrupts", "r");
+		char line[4096];
+		while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+			char* rest = NULL;
+			long irq = strtol(line, &rest, 10);
+			if (rest == line || *rest != ':' || strstr(rest, nic.c_str()) == NULL)
+				continue;
+			cpuirqadd((int)irq, cpus);
+			irqs++;
+		}
+		if (fp != NULL)
+			fclose(fp);
+	}
+
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return !cpus.empty();
+#endif
+}
+
+int cpunode(int cpu)
+{
+#ifdef _WIN32
+	PROCESSOR_NUMBER number = { 0 };
+	USHORT node = 0;
+	number.Group = (WORD)(cpu / 64);
+	number.Number = (BYTE)(cpu % 64);
+	return GetNumaProcessorNodeEx(&number, &node) ? (int)node : 0;
+#else
+	char dirname[64];
+	int node = 0;
+
+	snprintf(dirname, sizeof(dirname), "/sys/devices/system/cpu/cpu%d", cpu);
+	DIR* dir = opendir(dirname);
+	if (dir == NULL)
+		return 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+			node = atoi(entry->d_name + 4);
+			break;
+		}
+	}
+	closedir(dir);
+	return node;
+#endif
+}
+
+#ifdef _WIN32
+// the first processor group only, a mask is 64 cores
+static DWORD_PTR cpumask(const std::vector<int>& cpus)
+{
+	DWORD_PTR mask = 0;
+	for (size_t n = 0; n < cpus.size(); n++) {
+		if (cpus[n] < (int)(sizeof(DWORD_PTR) * 8))
+			mask |= (DWORD_PTR)1 << cpus[n];
+	}
+	return mask;
+}
+#else
+static void cpumask(const std::vector<int>& cpus, cpu_set_t& set)
+{
+	CPU_ZERO(&set);
+	for (size_t n = 0; n < cpus.size(); n++) {
+		if (cpus[n] < CPU_SETSIZE)
+			CPU_SET(cpus[n], &set);
+	}
+}
+#endif
+
+bool cpupin(const std::vector<int>& cpus)
+{
+	if (cpus.empty())
+		return false;
+#ifdef _WIN32
+	DWORD_PTR mask = cpumask(cpus);
+	return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+	cpu_set_t set;
+	cpumask(cpus, set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+bool cpupinthread(std::thread& thread, const std::vector<int>& cpus)
+{
+	if (cpus.empty() || !thread.joinable())
+		return false;
+#ifdef _WIN32
+	DWORD_PTR mask = cpumask(cpus);
+	return mask != 0 && SetThreadAffinityMask((HANDLE)thread.native_handle(), mask) != 0;
+#else
+	cpu_set_t set;
+	cpumask(cpus, set);
+	return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#endif
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+
+// the cores the threads of the server run on. "Loop CPUs" gives every loop a core of its own, loop n the
+// nth of the list and round again past its end, "Task CPUs" and "Log CPUs" keep the task pool and the
+// logger on a set of cores, so they do not take turns with the loops. a list is like "0-3,8,10-11".
+// without Loop CPUs and with "Loop Interface" set, the loops take the cores the interrupts of that
+// network interface are steered to, so a packet is read on the core its interrupt came in on. a pinned
+// loop is pinned from its own thread before it touches anything, the user and game slabs and the
+// memory of its connections come from the NUMA node of its core then. the slabs are shared by every
+// loop and grown on loop 0, so the loops are best kept on one node, a list over more is logged
+
+#define CPUPIN_MAX 1024	// highest cpu number taken + 1
+
+bool cpuparse(const std::string& text, std::vector<int>& cpus);	// false for a bad list
+std::string cpuformat(const std::vector<int>& cpus);
+bool cpuirqs(const std::string& nic, std::vector<int>& cpus);	// the cores of the interrupts of nic, linux only
+int cpunode(int cpu);	// the NUMA node, 0 where it is not known
+
+bool cpupin(const std::vector<int>& cpus);	// the calling thread
+bool cpupinthread(std::thread& thread, const std::vector<int>& cpus);
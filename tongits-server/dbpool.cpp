@@ -0,0 +1,1169 @@
+#include "dbpool.h"
+#include "common.h"
+#include "conf.h"
+#include "socket.h"
+#include "md5.h"
+#define NO_STD_OPTIONAL
+#include "mysql+++.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+enum
+{
+	DB_STMT_MEMBPASS = 0,
+	DB_STMT_ACCOUNTBYID,
+	DB_STMT_ACCOUNTBYTOKEN,
+	DB_STMT_INSERTACCOUNT,
+	DB_STMT_ACCOUNTBYGUIID,
+	DB_STMT_ACCOUNTBYMOBILE,
+	DB_STMT_INSERTMOBILE,
+	DB_STMT_ADDECOINS,
+	DB_STMT_ADDJEWELS,
+	DB_STMT_SESSIONPUT,	// prepared only for Session Store database, the table is not there otherwise
+	DB_STMT_SESSIONGET,
+	DB_STMT_SESSIONDEL,
+	DB_STMT_MAX
+};
+
+#define DB_ACCOUNT_COLUMNS "guiid, COALESCE(account_id, ''), COALESCE(mobile_num, ''), ecoins, jewels, gametoken, mode, nogps, isadmin"
+
+static const char* dbstmtsql[DB_STMT_MAX] = {
+	"SELECT memb__pwd FROM MEMB_INFO WHERE memb___id = ?",
+	"SELECT " DB_ACCOUNT_COLUMNS " FROM tongits WHERE account_id = ?",
+	"SELECT " DB_ACCOUNT_COLUMNS " FROM tongits WHERE acctoken = ?",
+	"INSERT INTO tongits (account_id, acctoken) VALUES (?, 'NONE')",
+	"SELECT " DB_ACCOUNT_COLUMNS " FROM tongits WHERE guiid = ?",
+	"SELECT " DB_ACCOUNT_COLUMNS " FROM tongits WHERE mobile_num = ? AND mode = 1",
+	"INSERT INTO tongits (account_id, mobile_num, acctoken, mode) VALUES (?, ?, 'NONE', 1)",
+	"UPDATE tongits SET ecoins = ecoins + ? WHERE guiid = ?",
+	"UPDATE tongits SET jewels = jewels + ? WHERE guiid = ?",
+	"REPLACE INTO game_sessions (token, host, port, gameserial, seat) VALUES (?, ?, ?, ?, ?)",
+	"SELECT host, port, gameserial, seat FROM game_sessions WHERE token = ?",
+	"DELETE FROM game_sessions WHERE token = ? AND host = ? AND port = ?",
+};
+
+struct _DB_SHARD;
+struct _DB_REPLICA;
+
+// one per worker thread, the statements live as long as the connection
+struct _DB_CONNECTION
+{
+	daotk::mysql::connection conn;
+	std::unique_ptr<daotk::mysql::prepared_stmt> stmts[DB_STMT_MAX];
+	bool isopen;
+	_DB_SHARD* shard;
+	const _SQL* sql;	// of the shard or of one of its replicas
+	_DB_REPLICA* replica;	// NULL on the primary
+	uint64_t probetick;	// clockmsec of its next heartbeat read, on a replica
+};
+
+static bool dbrunning = false;
+static bool dbissessions = false;	// Session Store is the database
+
+// the ledger keeps the latest balance of every account touched since the last commit, each one is
+// journaled and synced before it is merged so a crash before the commit replays it on the next start
+struct _DB_LEDGER_ENTRY
+{
+	int64_t guiid;
+	int32_t balance;
+	uint8_t ectype;
+	uint8_t reserved[3];
+};
+
+typedef std::map<std::pair<int64_t, int>, int> _DB_BALANCES;
+
+struct _DB_REPLICA
+{
+	_SQL sql;
+	std::atomic<int64_t> lagmsec;	// behind the heartbeat of its primary, -1 until it was read
+
+	_DB_REPLICA() : lagmsec(-1) {}
+};
+
+// a database of its own accounts, its job queue and workers and its ledger
+struct _DB_SHARD
+{
+	_SQL sql;
+	std::string journal;
+	bool issessions;	// the first one, it has game_sessions
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::deque<_DB_JOB*> jobs;
+	std::vector<std::thread> threads;
+
+	std::vector<std::unique_ptr<_DB_REPLICA>> vreplicas;
+	std::condition_variable readcond;
+	std::deque<_DB_JOB*> readjobs;	// for the replicas, behind lock as well
+
+	std::mutex ledgerlock;
+	std::condition_variable ledgercond;
+	std::vector<_DB_LEDGER_ENTRY> vledger;
+	std::thread ledgerthread;
+	std::atomic<int64_t> ledgerheld;	// balances the ledger worker merged and has not committed
+
+	_DB_SHARD() : issessions(false), ledgerheld(0) {}
+};
+
+static std::vector<std::unique_ptr<_DB_SHARD>> vdbshards;
+static std::vector<std::pair<uint32_t, _DB_SHARD*>> vdbring;	// sorted by the point
+static _DB_SHARD* dbshardbyid[DB_SHARD_STRIDE];
+
+// guiids whose balance was written lately, a replica may not have it yet
+static std::mutex writtenlock;
+static std::unordered_map<int64_t, uint64_t> dbwritten;	// clockmsec of the write
+static bool dbisreplicas = false;
+
+// accounts of the last logins, a reconnect inside the ttl is answered without a query. balances
+// follow dbsavebalance, writes made outside this server show up once the entry expires
+struct _DB_CACHE_ENTRY
+{
+	_DB_ACCOUNT account;
+	std::string password;	// memb__pwd as stored, empty until a user login checked it
+	std::string token;	// stored token of an older client, signed tokens are found by guiid
+	unsigned long long expires;
+	std::list<int64_t>::iterator lru;
+};
+
+typedef std::unordered_map<int64_t, _DB_CACHE_ENTRY> _DB_CACHE;
+typedef std::unordered_map<std::string, int64_t> _DB_CACHE_INDEX;
+
+// memb__pwd of a user login read ahead of its job by dbprecheck
+struct _DB_PASSWORD_CHECK
+{
+	std::string password;
+	bool isfetched;
+	bool isvalid;
+};
+
+static std::mutex cachelock;
+static _DB_CACHE cacheaccounts;
+static _DB_CACHE_INDEX cachebyid;
+static _DB_CACHE_INDEX cachebytoken;
+static std::list<int64_t> cachelru;	// most recent first
+static int cachesize = 0;
+static unsigned long long cachemsec = 0;
+
+bool dbisenabled()
+{
+	return dbrunning;
+}
+
+static bool dbconnect(_DB_CONNECTION& db)
+{
+	const _SQL& sql = *db.sql;
+
+	for (int n = 0; n < DB_STMT_MAX; n++)
+		db.stmts[n].reset();
+	db.isopen = false;
+
+	daotk::mysql::connect_options options(sql.host, sql.user, sql.secret, sql.database, DB_CONNECT_TIMEOUT, false, "", "utf8", sql.port);
+
+	if (!db.conn.open(options)) {
+		MSGLOG(ERROR, "dbworker, failed to connect to %s port %d.", sql.host.c_str(), sql.port);
+		return false;
+	}
+
+	try {
+		for (int n = 0; n < ((db.shard->issessions && db.replica == NULL) ? DB_STMT_MAX : DB_STMT_SESSIONPUT); n++)
+			db.stmts[n].reset(new daotk::mysql::prepared_stmt(db.conn, dbstmtsql[n]));
+	}
+	catch (std::exception& e) {
+		MSGLOG(SQL, "dbworker, %s.", e.what());
+		for (int n = 0; n < DB_STMT_MAX; n++)
+			db.stmts[n].reset();
+		db.conn.close();
+		return false;
+	}
+
+	db.isopen = true;
+	return true;
+}
+
+static int64_t dbwallmsec()
+{
+	return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void dbmarkwritten(int64_t guiid)
+{
+	if (!dbisreplicas)
+		return;
+	std::lock_guard<std::mutex> lock(writtenlock);
+	dbwritten[guiid] = clockmsec();
+}
+
+static bool dbisrecent(int64_t guiid)
+{
+	std::lock_guard<std::mutex> lock(writtenlock);
+	std::unordered_map<int64_t, uint64_t>::iterator iter = dbwritten.find(guiid);
+	return iter != dbwritten.end() && clockmsec() - iter->second < DB_REPLICA_STICKY_MSEC;
+}
+
+static void dbprunewritten()
+{
+	uint64_t now = clockmsec();
+	std::lock_guard<std::mutex> lock(writtenlock);
+
+	for (std::unordered_map<int64_t, uint64_t>::iterator iter = dbwritten.begin(); iter != dbwritten.end();) {
+		if (now - iter->second >= DB_REPLICA_STICKY_MSEC)
+			iter = dbwritten.erase(iter);
+		else
+			iter++;
+	}
+}
+
+// a replica within DB_REPLICA_MAX_LAG_MSEC of the shard
+static bool dbisfresh(const _DB_REPLICA* replica)
+{
+	int64_t lag = replica->lagmsec;
+	return lag >= 0 && lag <= DB_REPLICA_MAX_LAG_MSEC;
+}
+
+// a read a replica can not answer goes on to the primary: an account it does not have, which may have
+// just been made or is inserted there, and one whose balance was written within DB_REPLICA_STICKY_MSEC
+static bool dbtoprimary(_DB_CONNECTION& db, _DB_JOB* job, bool found)
+{
+	if (db.replica == NULL || (found && !dbisrecent(job->account.guiid)))
+		return false;
+	job->isprimary = true;
+	return true;
+}
+
+// the lag of a replica, from the heartbeat the ledger worker of its primary writes
+static void dbprobe(_DB_CONNECTION& db)
+{
+	uint64_t now = clockmsec();
+	char query[96];
+	long long tick = 0;
+
+	if (now < db.probetick)
+		return;
+	db.probetick = now + DB_REPLICA_PROBE_MSEC;
+
+	if (!db.isopen && !dbconnect(db)) {
+		db.replica->lagmsec = -1;
+		return;
+	}
+
+	snprintf(query, sizeof(query), "SELECT tick FROM db_heartbeat WHERE shard = %d", db.shard->sql.shard);
+	daotk::mysql::results res = db.conn.query(query);
+	if (!res || !res.get_value(0, tick)) {
+		if (res.error_code() == CR_SERVER_GONE_ERROR || res.error_code() == CR_SERVER_LOST)
+			db.isopen = false;
+		db.replica->lagmsec = -1;
+		return;
+	}
+	db.replica->lagmsec = std::max<int64_t>(dbwallmsec() - tick, 0);
+}
+
+static bool dberror(_DB_CONNECTION& db, daotk::mysql::prepared_stmt* stmt, _DB_JOB* job)
+{
+	unsigned int code = stmt->error_code();
+	MSGLOG(SQL, "dbworker, job %d failed %u (%s).", (int)job->type, code, stmt->error_message());
+	if (code == CR_SERVER_GONE_ERROR || code == CR_SERVER_LOST)
+		db.isopen = false;
+	return false;
+}
+
+// reads the first row and throws away the rest so the statement can run again
+static bool dbfetch(daotk::mysql::prepared_stmt* stmt)
+{
+	bool found = stmt->fetch();
+	while (found && stmt->fetch());
+	return found;
+}
+
+static bool dbfetchaccount(_DB_CONNECTION& db, int n, _DB_JOB* job, bool& found)
+{
+	daotk::mysql::prepared_stmt* stmt = db.stmts[n].get();
+	_DB_ACCOUNT& account = job->account;
+	int nogps = 0;
+	int isadmin = 0;
+
+	if (n == DB_STMT_ACCOUNTBYGUIID)
+		stmt->bind_param(job->guiid);
+	else
+		stmt->bind_param(job->key);
+	if (!stmt->execute())
+		return dberror(db, stmt, job);
+
+	stmt->bind_result(account.guiid, account.account, account.mobilenum, account.ecoins[0], account.ecoins[1],
+		account.gametoken, account.mode, nogps, isadmin);
+	found = dbfetch(stmt);
+	account.nogps = (nogps == 1);
+	account.isadmin = (isadmin == 1);
+	return true;
+}
+
+static bool dbfetchsession(_DB_CONNECTION& db, _DB_JOB* job, bool& found)
+{
+	daotk::mysql::prepared_stmt* stmt = db.stmts[DB_STMT_SESSIONGET].get();
+
+	stmt->bind_param(job->guiid);
+	if (!stmt->execute())
+		return dberror(db, stmt, job);
+
+	stmt->bind_result(job->session.host, job->session.port, job->session.gameserial, job->session.seat);
+	found = dbfetch(stmt);
+	return true;
+}
+
+static bool dbmatchpassword(const _DB_JOB* job, const std::string& password)
+{
+	if (!job->issecretmd5)
+		return (password == job->secret);
+
+	// memb__pwd holds the 16 byte binary md5 key
+	try {
+		MD5 pMD5Hash;
+		DWORD dwAccKey = MakeAccountKey((char*)job->key.c_str());
+		return password.size() >= 16 && pMD5Hash.MD5_CheckValue((char*)job->secret.c_str(), (char*)password.data(), dwAccKey);
+	}
+	catch (...) {
+		MSGLOG(SQL, "MD5 Password Decrypt Failed - AccountId : %s", job->key.c_str());
+	}
+	return false;
+}
+
+static bool dbfetchpassword(_DB_CONNECTION& db, _DB_JOB* job, std::string& password, bool& found)
+{
+	daotk::mysql::prepared_stmt* stmt = db.stmts[DB_STMT_MEMBPASS].get();
+
+	stmt->bind_param(job->key);
+	if (!stmt->execute())
+		return dberror(db, stmt, job);
+
+	stmt->bind_result(password);
+	found = dbfetch(stmt);
+	return true;
+}
+
+static bool dbcheckpassword(_DB_CONNECTION& db, _DB_JOB* job, std::string& password, bool& isvalid)
+{
+	if (!dbfetchpassword(db, job, password, isvalid))
+		return false;
+	isvalid = isvalid && dbmatchpassword(job, password);
+	return true;
+}
+
+static bool dbismd5login(const _DB_JOB* job)
+{
+	return job->type == _DB_JOB_TYPE::_USERLOGIN && job->issecretmd5;
+}
+
+// md5 user logins queued behind each other have their passwords read first and checked in one pass
+// of MD5_CheckValues, a job whose read failed is left to dbrun
+static void dbprecheck(_DB_CONNECTION& db, const std::vector<_DB_JOB*>& vjobs, _DB_PASSWORD_CHECK* checks)
+{
+	const char* inputs[DB_MD5_BATCH];
+	const char* keyvals[DB_MD5_BATCH];
+	int keyindexes[DB_MD5_BATCH];
+	bool results[DB_MD5_BATCH];
+	int index[DB_MD5_BATCH];
+	int count = 0;
+
+	for (size_t n = 0; n < vjobs.size(); n++) {
+		_DB_PASSWORD_CHECK& check = checks[n];
+		_DB_JOB* job = vjobs[n];
+		bool found = false;
+
+		check.isfetched = false;
+		check.isvalid = false;
+		if (!db.isopen && !dbconnect(db))
+			continue;
+		if (!dbfetchpassword(db, job, check.password, found))
+			continue;
+		check.isfetched = true;
+		if (!found || check.password.size() < 16)
+			continue;
+		inputs[count] = job->secret.c_str();
+		keyvals[count] = check.password.data();
+		keyindexes[count] = (int)MakeAccountKey((char*)job->key.c_str());
+		index[count++] = (int)n;
+	}
+
+	MD5::MD5_CheckValues(count, inputs, keyvals, keyindexes, results);
+	for (int n = 0; n < count; n++)
+		checks[index[n]].isvalid = results[n];
+}
+
+static void dbcacheerase(_DB_CACHE::iterator iter)
+{
+	_DB_CACHE_ENTRY& entry = iter->second;
+	_DB_CACHE_INDEX::iterator index = cachebyid.find(entry.account.account);
+
+	if (index != cachebyid.end() && index->second == iter->first)
+		cachebyid.erase(index);
+	if (!entry.token.empty())
+		cachebytoken.erase(entry.token);
+	cachelru.erase(entry.lru);
+	cacheaccounts.erase(iter);
+}
+
+static _DB_CACHE_ENTRY* dbcacheget(_DB_CACHE::iterator iter)
+{
+	if (iter->second.expires <= clockmsec()) {
+		dbcacheerase(iter);
+		return NULL;
+	}
+
+	cachelru.splice(cachelru.begin(), cachelru, iter->second.lru);
+	return &iter->second;
+}
+
+static _DB_CACHE_ENTRY* dbcachefind(_DB_CACHE_INDEX& index, const std::string& key)
+{
+	_DB_CACHE_INDEX::iterator found = index.find(key);
+	if (found == index.end())
+		return NULL;
+
+	_DB_CACHE::iterator iter = cacheaccounts.find(found->second);
+	if (iter == cacheaccounts.end()) {
+		index.erase(found);
+		return NULL;
+	}
+	return dbcacheget(iter);
+}
+
+static _DB_CACHE_ENTRY* dbcachefind(int64_t guiid)
+{
+	_DB_CACHE::iterator iter = cacheaccounts.find(guiid);
+	return (iter != cacheaccounts.end()) ? dbcacheget(iter) : NULL;
+}
+
+static void dbcachesettoken(_DB_CACHE_ENTRY& entry, const std::string& token)
+{
+	if (!entry.token.empty())
+		cachebytoken.erase(entry.token);
+	entry.token = token;
+	cachebytoken[token] = entry.account.guiid;
+}
+
+// password and token are NULL when the query did not read them, the cached ones are kept
+static void dbcachestore(const _DB_ACCOUNT& account, const std::string* password, const std::string* token)
+{
+	if (cachesize <= 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(cachelock);
+	_DB_CACHE::iterator iter = cacheaccounts.find(account.guiid);
+
+	if (iter == cacheaccounts.end()) {
+		while ((int)cacheaccounts.size() >= cachesize)
+			dbcacheerase(cacheaccounts.find(cachelru.back()));
+		iter = cacheaccounts.emplace(account.guiid, _DB_CACHE_ENTRY()).first;
+		cachelru.push_front(account.guiid);
+		iter->second.lru = cachelru.begin();
+	}
+	else {
+		cachelru.splice(cachelru.begin(), cachelru, iter->second.lru);
+	}
+
+	_DB_CACHE_ENTRY& entry = iter->second;
+	entry.account = account;
+	entry.expires = clockmsec() + cachemsec;
+	if (!account.account.empty())
+		cachebyid[account.account] = account.guiid;
+	if (password != NULL)
+		entry.password = *password;
+	if (token != NULL)
+		dbcachesettoken(entry, *token);
+}
+
+// a login answered from the cache, false sends the job to the database
+static bool dbcachelookup(_DB_JOB* job)
+{
+	if (cachesize <= 0)
+		return false;
+
+	std::lock_guard<std::mutex> lock(cachelock);
+	_DB_CACHE_ENTRY* entry = NULL;
+
+	switch (job->type) {
+	case _DB_JOB_TYPE::_USERLOGIN:
+		// a password that does not match the cached one could be a new one, the database decides
+		entry = dbcachefind(cachebyid, job->key);
+		if (entry == NULL || entry->password.empty() || !dbmatchpassword(job, entry->password))
+			return false;
+		break;
+	case _DB_JOB_TYPE::_TOKENLOGIN:
+		entry = (job->guiid != 0) ? dbcachefind(job->guiid) : dbcachefind(cachebytoken, job->key);
+		if (entry == NULL)
+			return false;
+		break;
+	default:
+		return false;
+	}
+
+	job->account = entry->account;
+	job->result = DB_RESULT_OK;
+	return true;
+}
+
+static bool dbexecute(_DB_CONNECTION& db, int n, _DB_JOB* job)
+{
+	daotk::mysql::prepared_stmt* stmt = db.stmts[n].get();
+
+	switch (n) {
+	case DB_STMT_INSERTMOBILE:
+		stmt->bind_param(job->key, job->key);
+		break;
+	case DB_STMT_ADDECOINS:
+	case DB_STMT_ADDJEWELS:
+		stmt->bind_param(job->value, job->account.guiid);
+		break;
+	case DB_STMT_SESSIONPUT:
+		stmt->bind_param(job->guiid, job->session.host, job->session.port, job->session.gameserial, job->session.seat);
+		break;
+	case DB_STMT_SESSIONDEL:
+		// only the row of the server that ends it, the table may have moved on to another one
+		stmt->bind_param(job->guiid, job->session.host, job->session.port);
+		break;
+	default:
+		stmt->bind_param(job->key);
+		break;
+	}
+
+	if (!stmt->execute())
+		return dberror(db, stmt, job);
+	return true;
+}
+
+// a write the cache does not follow drops the account, its next login reads it again
+static void dbcacheinvalidate(int64_t guiid)
+{
+	std::lock_guard<std::mutex> lock(cachelock);
+	_DB_CACHE::iterator iter = cacheaccounts.find(guiid);
+	if (iter != cacheaccounts.end())
+		dbcacheerase(iter);
+}
+
+// fills job->result, false asks for another try on a new connection. check is the password a batch
+// has already read and checked
+static bool dbrun(_DB_CONNECTION& db, _DB_JOB* job, const _DB_PASSWORD_CHECK* check)
+{
+	bool found = false;
+	std::string password;
+
+	switch (job->type) {
+	case _DB_JOB_TYPE::_USERLOGIN:
+		if (check != NULL && check->isfetched) {
+			password = check->password;
+			found = check->isvalid;
+		}
+		else if (!dbcheckpassword(db, job, password, found))
+			return db.isopen;
+		if (dbtoprimary(db, job, found))
+			return true;
+		if (!found) {
+			job->result = DB_RESULT_NOTFOUND;
+			return true;
+		}
+		if (!dbfetchaccount(db, DB_STMT_ACCOUNTBYID, job, found))
+			return db.isopen;
+		if (dbtoprimary(db, job, found))
+			return true;
+		if (!found) {
+			// first login to tongits
+			if (!dbexecute(db, DB_STMT_INSERTACCOUNT, job) || !dbfetchaccount(db, DB_STMT_ACCOUNTBYID, job, found))
+				return db.isopen;
+			MSGLOG(INFO, "%s does not exist in tongits db, inserted.", job->key.c_str());
+		}
+		if (found)
+			dbcachestore(job->account, &password, NULL);
+		break;
+	case _DB_JOB_TYPE::_TOKENLOGIN:
+		// guiid is set when the token carried a valid signature, otherwise key is a stored md5 token
+		if (!dbfetchaccount(db, (job->guiid != 0) ? DB_STMT_ACCOUNTBYGUIID : DB_STMT_ACCOUNTBYTOKEN, job, found))
+			return db.isopen;
+		if (dbtoprimary(db, job, found))
+			return true;
+		if (!found) {
+			job->result = DB_RESULT_NOTFOUND;
+			return true;
+		}
+		dbcachestore(job->account, NULL, (job->guiid != 0) ? NULL : &job->key);
+		break;
+	case _DB_JOB_TYPE::_MOBILELOGIN:
+		if (!dbfetchaccount(db, DB_STMT_ACCOUNTBYMOBILE, job, found))
+			return db.isopen;
+		if (dbtoprimary(db, job, found))
+			return true;
+		if (!found) {
+			if (!dbexecute(db, DB_STMT_INSERTMOBILE, job) || !dbfetchaccount(db, DB_STMT_ACCOUNTBYMOBILE, job, found))
+				return db.isopen;
+			MSGLOG(INFO, "otplogin, %s inserted to tongits db.", job->key.c_str());
+		}
+		if (found)
+			dbcachestore(job->account, NULL, NULL);
+		break;
+	case _DB_JOB_TYPE::_ADDECOINS:
+		if (!dbfetchaccount(db, DB_STMT_ACCOUNTBYID, job, found))
+			return db.isopen;
+		if (!found) {
+			job->result = DB_RESULT_NOTFOUND;
+			return true;
+		}
+		if (job->account.ecoins[job->ectype] + job->value < 0) {
+			job->result = DB_RESULT_NOTENOUGH;
+			return true;
+		}
+		if (!dbexecute(db, (job->ectype == 0) ? DB_STMT_ADDECOINS : DB_STMT_ADDJEWELS, job))
+			return db.isopen;
+		job->account.ecoins[job->ectype] += job->value;
+		dbcacheinvalidate(job->account.guiid);
+		dbmarkwritten(job->account.guiid);
+		break;
+	case _DB_JOB_TYPE::_SESSIONPUT:
+	case _DB_JOB_TYPE::_SESSIONDEL:
+		if (!dbissessions)
+			return true;
+		if (!dbexecute(db, (job->type == _DB_JOB_TYPE::_SESSIONPUT) ? DB_STMT_SESSIONPUT : DB_STMT_SESSIONDEL, job))
+			return db.isopen;
+		found = true;
+		break;
+	case _DB_JOB_TYPE::_SESSIONGET:
+		if (!dbissessions)
+			return true;
+		if (!dbfetchsession(db, job, found))
+			return db.isopen;
+		if (!found) {
+			job->result = DB_RESULT_NOTFOUND;
+			return true;
+		}
+		break;
+	}
+
+	job->result = found ? DB_RESULT_OK : DB_RESULT_FAILED;
+	return true;
+}
+
+static void dbcomplete(_DB_JOB* job)
+{
+	if (!job->done || !dbrunning) {
+		delete job;
+		return;
+	}
+	le_postloop(job->loop, [job]() {
+		job->done(job);
+		delete job;
+	});
+}
+
+static uint32_t dbhash(const void* data, size_t len)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	uint32_t h = 2166136261u;
+
+	for (size_t n = 0; n < len; n++) {
+		h ^= p[n];
+		h *= 16777619u;
+	}
+	// fnv alone leaves the short keys bunched on the ring
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	return h;
+}
+
+static _DB_SHARD* dbshardofkey(const std::string& key)
+{
+	if (vdbshards.size() == 1)
+		return vdbshards[0].get();
+
+	uint32_t point = dbhash(key.data(), key.length());
+	std::vector<std::pair<uint32_t, _DB_SHARD*>>::const_iterator iter = std::upper_bound(vdbring.begin(), vdbring.end(),
+		std::make_pair(point, (_DB_SHARD*)NULL), [](const std::pair<uint32_t, _DB_SHARD*>& a, const std::pair<uint32_t, _DB_SHARD*>& b) { return a.first < b.first; });
+	return (iter != vdbring.end()) ? iter->second : vdbring.front().second;
+}
+
+// a guiid of no listed shard goes to the first one, where a statement for it finds no row
+static _DB_SHARD* dbshardofguiid(int64_t guiid)
+{
+	if (vdbshards.size() == 1)
+		return vdbshards[0].get();
+
+	_DB_SHARD* shard = dbshardbyid[guiid % DB_SHARD_STRIDE];
+	return (shard != NULL) ? shard : vdbshards[0].get();
+}
+
+static _DB_SHARD* dbjobshard(const _DB_JOB* job)
+{
+	switch (job->type) {
+	case _DB_JOB_TYPE::_TOKENLOGIN:
+		return (job->guiid != 0) ? dbshardofguiid(job->guiid) : vdbshards[job->hops].get();
+	case _DB_JOB_TYPE::_SESSIONPUT:
+	case _DB_JOB_TYPE::_SESSIONGET:
+	case _DB_JOB_TYPE::_SESSIONDEL:
+		return vdbshards[0].get();
+	default:
+		return dbshardofkey(job->key);
+	}
+}
+
+// the logins only read, unless the account is new
+static bool dbisread(const _DB_JOB* job)
+{
+	return job->type == _DB_JOB_TYPE::_USERLOGIN || job->type == _DB_JOB_TYPE::_TOKENLOGIN || job->type == _DB_JOB_TYPE::_MOBILELOGIN;
+}
+
+static void dbqueue(_DB_JOB* job)
+{
+	_DB_SHARD* shard = dbjobshard(job);
+
+	if (!job->isprimary && dbisread(job)) {
+		for (size_t n = 0; n < shard->vreplicas.size(); n++) {
+			if (!dbisfresh(shard->vreplicas[n].get()))
+				continue;
+			shard->lock.lock();
+			shard->readjobs.push_back(job);
+			shard->lock.unlock();
+			shard->readcond.notify_one();
+			return;
+		}
+	}
+
+	shard->lock.lock();
+	shard->jobs.push_back(job);
+	shard->lock.unlock();
+	shard->cond.notify_one();
+}
+
+// jobs left in the queue at shutdown are still written, only their completions are dropped. the workers
+// of a replica take the reads and read its lag every DB_REPLICA_PROBE_MSEC, one that fell behind hands
+// what it took to the primary
+static void dbworker(_DB_SHARD* shard, _DB_REPLICA* replica)
+{
+	_DB_CONNECTION db;
+	_DB_PASSWORD_CHECK checks[DB_MD5_BATCH];
+	std::vector<_DB_JOB*> vjobs;
+	std::deque<_DB_JOB*>& jobs = (replica == NULL) ? shard->jobs : shard->readjobs;
+	db.isopen = false;
+	db.shard = shard;
+	db.sql = (replica == NULL) ? &shard->sql : &replica->sql;
+	db.replica = replica;
+	db.probetick = 0;
+
+	// connected while the server starts up, not by the first login
+	dbconnect(db);
+
+	while (true) {
+
+		std::unique_lock<std::mutex> lock(shard->lock);
+		if (replica == NULL)
+			shard->cond.wait(lock, [shard] { return !shard->jobs.empty() || !dbrunning; });
+		else
+			shard->readcond.wait_for(lock, std::chrono::milliseconds(DB_REPLICA_PROBE_MSEC), [shard] { return !shard->readjobs.empty() || !dbrunning; });
+		if (jobs.empty() && !dbrunning)
+			break;
+		vjobs.clear();
+		if (!jobs.empty()) {
+			vjobs.push_back(jobs.front());
+			jobs.pop_front();
+		}
+		while (!vjobs.empty() && dbismd5login(vjobs[0]) && vjobs.size() < DB_MD5_BATCH && !jobs.empty() && dbismd5login(jobs.front())) {
+			vjobs.push_back(jobs.front());
+			jobs.pop_front();
+		}
+		lock.unlock();
+
+		if (replica != NULL) {
+			dbprobe(db);
+			if (!dbisfresh(replica) && dbrunning) {
+				for (size_t n = 0; n < vjobs.size(); n++) {
+					vjobs[n]->isprimary = true;
+					dbqueue(vjobs[n]);
+				}
+				continue;
+			}
+		}
+		if (vjobs.empty())
+			continue;
+
+		if (vjobs.size() > 1)
+			dbprecheck(db, vjobs, checks);
+
+		for (size_t n = 0; n < vjobs.size(); n++) {
+			_DB_JOB* job = vjobs[n];
+			job->result = DB_RESULT_FAILED;
+
+			// a dropped connection is reopened and the job tried once more
+			for (int attempt = 0; attempt < 2; attempt++) {
+				if (!db.isopen && !dbconnect(db))
+					break;
+				if (dbrun(db, job, (vjobs.size() > 1 && attempt == 0) ? &checks[n] : NULL))
+					break;
+			}
+
+			// handed back, or the replica is down
+			if (replica != NULL && dbrunning && (job->isprimary || job->result == DB_RESULT_FAILED)) {
+				job->isprimary = true;
+				dbqueue(job);
+				continue;
+			}
+
+			// a stored token is on one of the shards, the next one is asked
+			if (job->type == _DB_JOB_TYPE::_TOKENLOGIN && job->guiid == 0 && job->result == DB_RESULT_NOTFOUND &&
+				job->hops + 1 < (int)vdbshards.size() && dbrunning) {
+				job->hops++;
+				dbqueue(job);
+				continue;
+			}
+
+			dbcomplete(job);
+		}
+	}
+
+	for (int n = 0; n < DB_STMT_MAX; n++)
+		db.stmts[n].reset();
+	db.conn.close();
+}
+
+static void dbledgerrecover(const std::string& journal, _DB_BALANCES& balances)
+{
+	FILE* fp = fopen(journal.c_str(), "rb");
+	_DB_LEDGER_ENTRY entry;
+
+	if (fp == NULL)
+		return;
+
+	while (fread(&entry, sizeof(entry), 1, fp) == 1)
+		balances[std::make_pair(entry.guiid, (int)entry.ectype)] = entry.balance;
+	fclose(fp);
+
+	if (!balances.empty())
+		MSGLOG(INFO, "dbledger, %d balances recovered from %s.", (int)balances.size(), journal.c_str());
+}
+
+static void dbledgersync(FILE* fp, const std::vector<_DB_LEDGER_ENTRY>& vbuffer)
+{
+	fwrite(vbuffer.data(), sizeof(_DB_LEDGER_ENTRY), vbuffer.size(), fp);
+	fflush(fp);
+#ifdef _WIN32
+	_commit(_fileno(fp));
+#else
+	fsync(fileno(fp));
+#endif
+}
+
+// one statement for the whole batch, the balances are absolute so a replayed batch is harmless
+static bool dbledgercommit(_DB_CONNECTION& db, const _DB_BALANCES& balances)
+{
+	std::string cases[2];
+	std::string ids;
+	char sbuf[64];
+	int64_t last = -1;
+
+	if (!db.isopen && !dbconnect(db))
+		return false;
+
+	for (_DB_BALANCES::const_iterator iter = balances.begin(); iter != balances.end(); iter++) {
+		snprintf(sbuf, sizeof(sbuf), " WHEN %lld THEN %d", (long long)iter->first.first, iter->second);
+		cases[iter->first.second] += sbuf;
+		if (iter->first.first == last)
+			continue;
+		last = iter->first.first;
+		snprintf(sbuf, sizeof(sbuf), "%s%lld", ids.empty() ? "" : ",", (long long)last);
+		ids += sbuf;
+	}
+
+	std::string query = "UPDATE tongits SET ";
+	if (!cases[0].empty())
+		query += "ecoins = CASE guiid" + cases[0] + " ELSE ecoins END";
+	if (!cases[1].empty())
+		query += std::string(cases[0].empty() ? "" : ", ") + "jewels = CASE guiid" + cases[1] + " ELSE jewels END";
+	query += " WHERE guiid IN (" + ids + ")";
+
+	if (!db.conn.exec(query)) {
+		unsigned int code = db.conn.error_code();
+		MSGLOG(SQL, "dbledger, commit of %d balances failed %u (%s).", (int)balances.size(), code, db.conn.error_message());
+		if (code == CR_SERVER_GONE_ERROR || code == CR_SERVER_LOST)
+			db.isopen = false;
+		return false;
+	}
+	return true;
+}
+
+// one a shard, the balances of its accounts
+static void dbledgerworker(_DB_SHARD* shard)
+{
+	_DB_CONNECTION db;
+	_DB_BALANCES balances;
+	std::vector<_DB_LEDGER_ENTRY> vbuffer;
+	uint64_t since = 0;
+	bool isrunning = true;
+
+	uint64_t beattick = 0;
+
+	db.isopen = false;
+	db.shard = shard;
+	db.sql = &shard->sql;
+	db.replica = NULL;
+	db.probetick = 0;
+
+	dbledgerrecover(shard->journal, balances);
+	if (!balances.empty())
+		since = 1;
+
+	FILE* fp = fopen(shard->journal.c_str(), "ab");
+	if (fp == NULL)
+		MSGLOG(ERROR, "dbledger, failed to open %s.", shard->journal.c_str());
+
+	while (isrunning) {
+
+		std::unique_lock<std::mutex> lock(shard->ledgerlock);
+		shard->ledgercond.wait_for(lock, std::chrono::milliseconds(DB_LEDGER_MSEC), [shard] { return !shard->vledger.empty() || !dbrunning; });
+		shard->vledger.swap(vbuffer);
+		isrunning = dbrunning;
+		lock.unlock();
+
+		// the replicas of the shard tell their lag by it
+		if (!shard->vreplicas.empty() && clockmsec() >= beattick) {
+			char query[128];
+			beattick = clockmsec() + DB_REPLICA_BEAT_MSEC;
+			snprintf(query, sizeof(query), "REPLACE INTO db_heartbeat (shard, tick) VALUES (%d, %lld)", shard->sql.shard, (long long)dbwallmsec());
+			if ((db.isopen || dbconnect(db)) && !db.conn.exec(query)) {
+				unsigned int code = db.conn.error_code();
+				if (code == CR_SERVER_GONE_ERROR || code == CR_SERVER_LOST)
+					db.isopen = false;
+			}
+			dbprunewritten();
+		}
+
+		if (!vbuffer.empty()) {
+			if (fp != NULL)
+				dbledgersync(fp, vbuffer);
+			for (size_t n = 0; n < vbuffer.size(); n++)
+				balances[std::make_pair(vbuffer[n].guiid, (int)vbuffer[n].ectype)] = vbuffer[n].balance;
+			if (since == 0)
+				since = GetTickCount64();
+			vbuffer.clear();
+			shard->ledgerheld = (int64_t)balances.size();
+		}
+
+		if (balances.empty())
+			continue;
+
+		if (isrunning && balances.size() < DB_LEDGER_MAXENTRIES && GetTickCount64() - since < DB_LEDGER_MSEC)
+			continue;
+
+		if (dbledgercommit(db, balances)) {
+			for (_DB_BALANCES::const_iterator iter = balances.begin(); iter != balances.end(); iter++)
+				dbmarkwritten(iter->first.first);
+			balances.clear();
+			shard->ledgerheld = 0;
+			since = 0;
+			// everything in the journal is committed now
+			if (fp != NULL)
+				fclose(fp);
+			fp = fopen(shard->journal.c_str(), "wb");
+		}
+	}
+
+	if (!balances.empty())
+		MSGLOG(ERROR, "dbledger, %d balances left in %s for the next start.", (int)balances.size(), shard->journal.c_str());
+
+	if (fp != NULL)
+		fclose(fp);
+	for (int n = 0; n < DB_STMT_MAX; n++)
+		db.stmts[n].reset();
+	db.conn.close();
+}
+
+void dbsavebalance(int64_t guiid, unsigned char ectype, int balance)
+{
+	_DB_LEDGER_ENTRY entry = { 0 };
+	entry.guiid = guiid;
+	entry.balance = balance;
+	entry.ectype = ectype;
+
+	if (vdbshards.empty())
+		return;
+
+	dbmarkwritten(guiid);
+	_DB_SHARD* shard = dbshardofguiid(guiid);
+	shard->ledgerlock.lock();
+	shard->vledger.push_back(entry);
+	shard->ledgerlock.unlock();
+	shard->ledgercond.notify_one();
+
+	cachelock.lock();
+	_DB_CACHE::iterator iter = cacheaccounts.find(guiid);
+	if (iter != cacheaccounts.end() && ectype < 2)
+		iter->second.account.ecoins[ectype] = balance;
+	cachelock.unlock();
+}
+
+void dbbacklog(int64_t& jobs, int64_t& ledger)
+{
+	jobs = 0;
+	ledger = 0;
+
+	for (size_t n = 0; n < vdbshards.size(); n++) {
+		_DB_SHARD* shard = vdbshards[n].get();
+
+		shard->lock.lock();
+		jobs += (int64_t)(shard->jobs.size() + shard->readjobs.size());
+		shard->lock.unlock();
+
+		shard->ledgerlock.lock();
+		ledger += (int64_t)shard->vledger.size() + shard->ledgerheld;
+		shard->ledgerlock.unlock();
+	}
+}
+
+bool dbstart()
+{
+	_SQL sql = c.getsql();
+	std::vector<_SQL> vsql = c.getsqlshards();
+
+	if (sql.host.empty() && vsql.empty()) {
+		MSGLOG(INFO, "SQL Host is not set, running without a database.");
+		return false;
+	}
+
+	if (vsql.empty())
+		vsql.push_back(sql);
+
+	memset(dbshardbyid, 0, sizeof(dbshardbyid));
+	dbisreplicas = false;
+	vdbshards.clear();
+	vdbring.clear();
+	for (size_t n = 0; n < vsql.size(); n++) {
+		int id = vsql[n].shard;
+		if (vsql.size() > 1 && (id <= 0 || id >= DB_SHARD_STRIDE || dbshardbyid[id] != NULL)) {
+			MSGLOG(ERROR, "SQL Shards, Id %d is taken or not within 1 and %d, running without a database.", id, DB_SHARD_STRIDE - 1);
+			vdbshards.clear();
+			vdbring.clear();
+			return false;
+		}
+
+		char journal[64];
+		snprintf(journal, sizeof(journal), DB_LEDGER_SHARD_JOURNAL, id);
+
+		vdbshards.push_back(std::unique_ptr<_DB_SHARD>(new _DB_SHARD()));
+		_DB_SHARD* shard = vdbshards.back().get();
+		shard->sql = vsql[n];
+		shard->journal = (vsql.size() > 1) ? journal : DB_LEDGER_JOURNAL;
+		shard->issessions = (n == 0 && c.getsessionstore() == "database");
+		dbshardbyid[id] = shard;
+
+		// "host" or "host:port", the rest is the shard's
+		for (size_t r = 0; r < vsql[n].replicas.size(); r++) {
+			const std::string& host = vsql[n].replicas[r];
+			size_t colon = host.find(':');
+			shard->vreplicas.push_back(std::unique_ptr<_DB_REPLICA>(new _DB_REPLICA()));
+			_DB_REPLICA* replica = shard->vreplicas.back().get();
+			replica->sql = vsql[n];
+			replica->sql.host = host.substr(0, colon);
+			if (colon != std::string::npos)
+				replica->sql.port = atoi(host.c_str() + colon + 1);
+			dbisreplicas = true;
+		}
+
+		for (uint32_t point = 0; point < DB_SHARD_POINTS; point++) {
+			uint32_t key[2] = { (uint32_t)id, point };
+			vdbring.push_back(std::make_pair(dbhash(key, sizeof(key)), shard));
+		}
+	}
+	std::sort(vdbring.begin(), vdbring.end(), [](const std::pair<uint32_t, _DB_SHARD*>& a, const std::pair<uint32_t, _DB_SHARD*>& b) {
+		return a.first < b.first;
+	});
+
+	cachesize = (sql.cacheseconds > 0) ? sql.cachesize : 0;
+	cachemsec = (unsigned long long)sql.cacheseconds * 1000;
+
+	dbissessions = (c.getsessionstore() == "database");
+	dbrunning = true;
+	for (size_t n = 0; n < vdbshards.size(); n++) {
+		_DB_SHARD* shard = vdbshards[n].get();
+		int connections = (shard->sql.connections > 0) ? shard->sql.connections : 1;
+
+		for (int i = 0; i < connections; i++)
+			shard->threads.push_back(std::thread(dbworker, shard, (_DB_REPLICA*)NULL));
+		shard->ledgerthread = std::thread(dbledgerworker, shard);
+
+		for (size_t r = 0; r < shard->vreplicas.size(); r++) {
+			_DB_REPLICA* replica = shard->vreplicas[r].get();
+			for (int i = 0; i < connections; i++)
+				shard->threads.push_back(std::thread(dbworker, shard, replica));
+			MSGLOG(INFO, "Database replica %s port %d takes the logins of shard %d while it is within %d ms.", replica->sql.host.c_str(),
+				replica->sql.port, shard->sql.shard, DB_REPLICA_MAX_LAG_MSEC);
+		}
+
+		if (vdbshards.size() > 1)
+			MSGLOG(INFO, "Database shard %d, %s on %s port %d with %d connections, ledger %s.", shard->sql.shard, shard->sql.database.c_str(),
+				shard->sql.host.c_str(), shard->sql.port, connections, shard->journal.c_str());
+		else
+			MSGLOG(INFO, "Database %s on %s port %d with %d connections.", shard->sql.database.c_str(), shard->sql.host.c_str(),
+				shard->sql.port, connections);
+	}
+	if (cachesize > 0)
+		MSGLOG(INFO, "Account cache keeps %d accounts for %d seconds.", cachesize, sql.cacheseconds);
+	if (c.issecretmd5())
+		MSGLOG(INFO, "MD5 passwords are checked in batches of %d, md5 backend is %s.", DB_MD5_BATCH, MD5::MD5_Backend());
+	return true;
+}
+
+void dbstop()
+{
+	if (!dbrunning)
+		return;
+
+	for (size_t n = 0; n < vdbshards.size(); n++) {
+		vdbshards[n]->lock.lock();
+		vdbshards[n]->ledgerlock.lock();
+	}
+	dbrunning = false;
+	for (size_t n = 0; n < vdbshards.size(); n++) {
+		vdbshards[n]->ledgerlock.unlock();
+		vdbshards[n]->lock.unlock();
+		vdbshards[n]->cond.notify_all();
+		vdbshards[n]->readcond.notify_all();
+		vdbshards[n]->ledgercond.notify_all();
+	}
+
+	for (size_t n = 0; n < vdbshards.size(); n++) {
+		for (size_t i = 0; i < vdbshards[n]->threads.size(); i++)
+			vdbshards[n]->threads[i].join();
+		vdbshards[n]->threads.clear();
+		vdbshards[n]->ledgerthread.join();
+	}
+
+	cachelock.lock();
+	cacheaccounts.clear();
+	cachebyid.clear();
+	cachebytoken.clear();
+	cachelru.clear();
+	cachelock.unlock();
+}
+
+void dbsubmit(_DB_JOB* job)
+{
+	job->loop = le_getloop();
+
+	if (dbcachelookup(job)) {
+		dbcomplete(job);
+		return;
+	}
+
+	// no database, nothing will take it
+	if (vdbshards.empty()) {
+		delete job;
+		return;
+	}
+	dbqueue(job);
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <string>
+#include <functional>
+#include <stdint.h>
+
+// mysql persistence, a few worker threads each own one connection with its statements prepared once,
+// the loops queue jobs and get the completion back through le_postloop so a slow database never holds a tick
+//
+// with "SQL Shards" the accounts are spread over several databases, each with its own workers and its
+// own ledger worker and journal, so the balance commits of the tables grow with the hosts. an account
+// id or mobile number hashes onto a ring of DB_SHARD_POINTS points per shard, its logins, its otp
+// account and its cashouts go to the shard after it. each shard database hands out the guiids of
+// its accounts with auto_increment_increment DB_SHARD_STRIDE and auto_increment_offset its Id, so a
+// guiid names its shard, the signed token logins and the balances of the ledger are sent there
+// directly. the stored token of an older client is looked for on one shard after the other. the first
+// shard listed keeps game_sessions. the ring only moves with the shards listed, the accounts of the
+// arcs a new shard takes are moved to it before it is listed, and a ledger.journal of the database
+// without shards is drained by a clean stop before the first start with them
+//
+// "SQL Replicas", or "Replicas" of a shard, are read replicas of it. the logins go to them while one is
+// within DB_REPLICA_MAX_LAG_MSEC, the ledger worker of the primary writes the time to
+//   db_heartbeat (shard INT PRIMARY KEY, tick BIGINT)
+// every DB_REPLICA_BEAT_MSEC and the workers of a replica read it back every DB_REPLICA_PROBE_MSEC. a
+// login the replica does not find, a new account or one made a moment ago, and one of an account whose
+// balance was written within DB_REPLICA_STICKY_MSEC is read again on the primary, so a player who comes
+// back right after a hand never sees the balance before it. cashouts and game_sessions stay on the primary
+
+#define DB_DEFAULT_PORT 3306
+#define DB_DEFAULT_CONNECTIONS 2
+#define DB_CONNECT_TIMEOUT 5	// seconds
+#define DB_CACHE_DEFAULT_SIZE 4096
+#define DB_CACHE_DEFAULT_SECONDS 300
+#define DB_MD5_BATCH 32	// md5 user logins a worker takes off the queue at once
+#define DB_LEDGER_JOURNAL "ledger.journal"
+#define DB_LEDGER_SHARD_JOURNAL "ledger.%d.journal"	// of the shard of that Id
+#define DB_LEDGER_MSEC 100	// balances are held this long before they are committed
+#define DB_LEDGER_MAXENTRIES 256	// or until this many accounts are pending
+#define DB_SHARD_STRIDE 64	// the largest shard Id is one less
+#define DB_SHARD_POINTS 64
+#define DB_REPLICA_MAX_LAG_MSEC 1000
+#define DB_REPLICA_BEAT_MSEC 250
+#define DB_REPLICA_PROBE_MSEC 500
+#define DB_REPLICA_STICKY_MSEC (DB_REPLICA_MAX_LAG_MSEC + DB_REPLICA_BEAT_MSEC + DB_REPLICA_PROBE_MSEC)
+
+#define DB_RESULT_FAILED 0
+#define DB_RESULT_OK 1
+#define DB_RESULT_NOTFOUND 2	// no such account, or the password did not match
+#define DB_RESULT_NOTENOUGH 3	// a cashout larger than the balance
+
+enum class _DB_JOB_TYPE
+{
+	_USERLOGIN = 0,
+	_TOKENLOGIN,	// by the guiid of a signed token, or by key for a stored one
+	_MOBILELOGIN,	// the otp account of key, created on its first login
+	_ADDECOINS,	// value added to the ectype balance of an offline account
+	_SESSIONPUT,	// the game session of token guiid, see sessiondir.h
+	_SESSIONGET,
+	_SESSIONDEL,
+};
+
+// row of the tongits table
+struct _DB_ACCOUNT
+{
+	int64_t guiid;
+	std::string account;
+	std::string mobilenum;
+	int ecoins[2];
+	int gametoken;
+	int mode;
+	bool nogps;
+	bool isadmin;
+};
+
+// row of the game_sessions table
+struct _DB_SESSION
+{
+	std::string host;
+	int port;
+	int64_t gameserial;
+	int seat;
+};
+
+struct _DB_JOB
+{
+	_DB_JOB_TYPE type;
+	std::string key;	// account id, mobile number or login token
+	std::string secret;
+	bool issecretmd5;
+	int64_t guiid;
+	int value;
+	unsigned char ectype;
+
+	int result;
+	_DB_ACCOUNT account;
+	_DB_SESSION session;
+
+	int loop;
+	int hops;	// shards a stored token was looked for on
+	bool isprimary;	// a read a replica handed back
+	std::function<void(_DB_JOB*)> done;	// runs on the loop that submitted the job, may be empty
+
+	_DB_JOB() : type(_DB_JOB_TYPE::_USERLOGIN), issecretmd5(false), guiid(0), value(0), ectype(0), result(DB_RESULT_FAILED), account(), session(), loop(0), hops(0), isprimary(false) {}
+};
+
+bool dbstart();
+void dbstop();
+bool dbisenabled();
+void dbsubmit(_DB_JOB* job);
+void dbsavebalance(int64_t guiid, unsigned char ectype, int balance);
+void dbbacklog(int64_t& jobs, int64_t& ledger);	// jobs waiting for a worker, balances not committed yet
@@ -0,0 +1,115 @@
+#include "eventlog.h"
+#include "common.h"
+#include "adminfeed.h"
+#include <thread>
+#include <vector>
+#include <mutex>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+bool endeventworker = false;
+
+static std::mutex eventlock;
+static std::vector<_EVENT_RECORD> veventrecord;
+
+void addevent(const _EVENT_RECORD& rec)
+{
+	eventlock.lock();
+	veventrecord.push_back(rec);
+	eventlock.unlock();
+	feedpush(rec);
+}
+
+void addaccountevent(uint16_t action, int64_t token, const char* account, int delta, uint8_t userpos)
+{
+	_EVENT_RECORD rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.time = clockwallmsec();
+	rec.serial = token;
+	rec.delta = delta;
+	rec.action = action;
+	rec.userpos = userpos;
+
+	size_t len = strlen(account);
+	rec.count = (uint8_t)((len < EVENT_MAX_CARDS) ? len : EVENT_MAX_CARDS);
+	memcpy(rec.cards, account, rec.count);
+	addevent(rec);
+}
+
+static FILE* eventopen(time_t t, int& day)
+{
+	struct tm lt;
+	char filename[260];
+#ifdef _WIN32
+	localtime_s(&lt, &t);
+	CreateDirectoryA(LOG_DIRECTORY, NULL);
+#else
+	localtime_r(&t, &lt);
+	mkdir(LOG_DIRECTORY, 0755);
+#endif
+	day = lt.tm_yday;
+	snprintf(filename, sizeof(filename), "%s/%s_%04d-%02d-%02d.evt", LOG_DIRECTORY, EVENT_FILENAME, lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday);
+
+	FILE* fp = fopen(filename, "ab");
+	if (fp == NULL) {
+		MSGLOG(eMSGTYPE::ERROR, "eventworker, failed to open %s.", filename);
+		return NULL;
+	}
+
+	setvbuf(fp, NULL, _IOFBF, EVENT_BUFFER_SIZE);
+
+	// a new segment starts with the header, appends to an existing one go after its last record
+	fseek(fp, 0, SEEK_END);
+	if (ftell(fp) == 0) {
+		_EVENT_HEADER hdr;
+		memcpy(hdr.magic, EVENT_MAGIC, sizeof(hdr.magic));
+		hdr.version = EVENT_VERSION;
+		hdr.recordsize = sizeof(_EVENT_RECORD);
+		fwrite(&hdr, sizeof(hdr), 1, fp);
+	}
+	return fp;
+}
+
+// writes the queued records in one block per wake up, the segment rolls over at local midnight
+void eventworker()
+{
+	std::vector<_EVENT_RECORD> vbuffer;
+	FILE* fp = NULL;
+	int day = -1;
+
+	while (true) {
+
+		eventlock.lock();
+		veventrecord.swap(vbuffer);
+		eventlock.unlock();
+
+		if (!vbuffer.empty()) {
+			time_t t = (time_t)(vbuffer.front().time / 1000);
+			struct tm lt;
+#ifdef _WIN32
+			localtime_s(&lt, &t);
+#else
+			localtime_r(&t, &lt);
+#endif
+			if (fp == NULL || lt.tm_yday != day) {
+				if (fp != NULL)
+					fclose(fp);
+				fp = eventopen(t, day);
+			}
+
+			if (fp != NULL) {
+				fwrite(vbuffer.data(), sizeof(_EVENT_RECORD), vbuffer.size(), fp);
+				fflush(fp);
+			}
+		}
+
+		vbuffer.clear();
+		if (endeventworker)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(EVENT_FLUSH_MSEC));
+	}
+
+	if (fp != NULL)
+		fclose(fp);
+}
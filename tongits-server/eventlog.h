@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+
+// binary audit log of the game actions, fixed size records appended to a daily segment
+// Log/tongits_YYYY-MM-DD.evt behind a small header, tongits_logdump renders it to text or json
+
+#define EVENT_MAGIC "TGEV"
+#define EVENT_VERSION 1
+#define EVENT_FILENAME "tongits"
+#define EVENT_MAX_CARDS 16
+#define EVENT_FLUSH_MSEC 100
+#define EVENT_BUFFER_SIZE (1 << 20)
+
+// actions are the _ACTIONS values of game.h, these are the events that are not player actions. the
+// account events have the session token of the account for serial and its name in the cards
+#define EVENT_START 0x1000
+#define EVENT_SETTLE 0x2000
+#define EVENT_LOGIN 0x3000	// delta the eCoins it came with
+#define EVENT_ECOINS 0x4000	// an admin credit or cashout, delta the change and userpos the ectype
+#define EVENT_END 0x5000	// the table was let go, delta the hands it settled
+#define EVENT_ISACCOUNT(action) ((action) == EVENT_LOGIN || (action) == EVENT_ECOINS)
+
+#pragma pack(push, 1)
+struct _EVENT_HEADER
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t recordsize;
+};
+
+struct _EVENT_RECORD
+{
+	int64_t time;		// milliseconds since the epoch
+	int64_t serial;
+	int32_t delta;		// ecoins, settle events only
+	uint16_t action;
+	uint8_t userpos;
+	uint8_t count;
+	uint8_t cards[EVENT_MAX_CARDS];	// cardtype << 4 | cardnum
+};
+#pragma pack(pop)
+
+static_assert(sizeof(_EVENT_RECORD) == 40, "_EVENT_RECORD layout is part of the file format");
+
+#define EVENT_CARD(type, num) ((uint8_t)(((type) << 4) | ((num) & 0x0F)))
+#define EVENT_CARDTYPE(c) ((c) >> 4)
+#define EVENT_CARDNUM(c) ((c) & 0x0F)
+
+void eventworker();
+void addevent(const _EVENT_RECORD& rec);
+void addaccountevent(uint16_t action, int64_t token, const char* account, int delta, uint8_t userpos = 0);
+extern bool endeventworker;
@@ -0,0 +1,261 @@
+#include "fastlane.h"
+#include "common.h"
+#include "conf.h"
+#include "user.h"
+#include "socket.h"
+#include "replay.h"
+#include "sha256.h"
+#include "packet.h"
+#include <atomic>
+#include <random>
+
+static evutil_socket_t fastlanefd = EVUTIL_INVALID_SOCKET;	// written to from every loop, read on loop 0
+static struct event* fastlaneev = NULL;
+static _HMAC_SHA256_KEY fastlanekey;	// of a secret made at start, a restart drops the connections anyway
+static unsigned short fastlaneport = 0;
+static std::atomic<uint64_t> fastlaneframes(0);
+static std::atomic<uint64_t> fastlanehellos(0);
+static std::atomic<uint64_t> fastlanerefused(0);
+
+static void fastlanederive(int64_t token, uint32_t id, uint8_t* key)
+{
+	uint8_t material[sizeof(FASTLANE_LABEL) - 1 + sizeof(token) + sizeof(id)];
+
+	memcpy(material, FASTLANE_LABEL, sizeof(FASTLANE_LABEL) - 1);
+	memcpy(material + sizeof(FASTLANE_LABEL) - 1, &token, sizeof(token));
+	memcpy(material + sizeof(FASTLANE_LABEL) - 1 + sizeof(token), &id, sizeof(id));
+	hmacsha256(fastlanekey, material, sizeof(material), key);
+}
+
+// the direction first, 0 from the server and 1 from the app, so both count from 1 under the same key
+static void fastlanenonce(uint8_t direction, uint64_t counter, uint8_t* nonce)
+{
+	memset(nonce, 0, 4);
+	nonce[0] = direction;
+	for (int n = 0; n < 8; n++)
+		nonce[4 + n] = (uint8_t)(counter >> (n * 8));
+}
+
+// the loop of the user, the header and body at datagram sealed and sent to the address of the last hello
+static void fastlanewrite(_FASTLANE_STATE* lane, unsigned char* datagram, int bodylen)
+{
+	_FASTLANE_HDR* hdr = (_FASTLANE_HDR*)datagram;
+	uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+	struct sockaddr_in sin;
+
+	hdr->counter = ++lane->txcounter;
+	fastlanenonce(0, hdr->counter, nonce);
+	chachapolyseal(lane->key, nonce, datagram, sizeof(_FASTLANE_HDR), datagram + sizeof(_FASTLANE_HDR), bodylen,
+		datagram + sizeof(_FASTLANE_HDR) + bodylen);
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = lane->ip;
+	sin.sin_port = lane->port;
+	sendto(fastlanefd, (const char*)datagram, (int)(sizeof(_FASTLANE_HDR) + bodylen + CHACHAPOLY_TAG_SIZE), 0,
+		(struct sockaddr*)&sin, sizeof(sin));
+}
+
+static void fastlaneheader(_FASTLANE_HDR* hdr, uint8_t type, _FASTLANE_STATE* lane, _USER_INFO* userinfo)
+{
+	memset(hdr, 0, sizeof(_FASTLANE_HDR));
+	hdr->c = type;
+	hdr->version = FASTLANE_VERSION;
+	hdr->id = lane->id;
+	hdr->token = userinfo->token;
+	hdr->seq = (userinfo->replay != NULL) ? userinfo->replay->seq : 0;
+}
+
+// the hello of a lane, on the loop of the connection that has it
+static void fastlanebind(uintptr_t userindex, _FASTLANE_HDR hdr, uint32_t ip, uint16_t port)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL)
+		return;
+
+	if (userinfo->packetdata.loop != le_getloop()) {
+		le_postloop(userinfo->packetdata.loop, [userindex, hdr, ip, port]() { fastlanebind(userindex, hdr, ip, port); });
+		return;
+	}
+
+	_FASTLANE_STATE* lane = userinfo->packetdata.fastlane;
+	if (lane == NULL || lane->id != hdr.id || userinfo->token != hdr.token || hdr.counter <= lane->rxcounter)
+		return;
+
+	lane->rxcounter = hdr.counter;
+	lane->hellotick = clockmsec();
+	lane->ip = ip;
+	lane->port = port;
+	fastlanehellos++;
+
+	unsigned char datagram[sizeof(_FASTLANE_HDR) + CHACHAPOLY_TAG_SIZE];
+	fastlaneheader((_FASTLANE_HDR*)datagram, FASTLANE_ACK, lane, userinfo);
+	fastlanewrite(lane, datagram, 0);
+}
+
+// only hellos come in. loop 0 checks the tag with the key the token and id make and hands the hello to
+// the loops of the slots of that token, the one whose lane has the id takes it
+static void fastlanereadcb(evutil_socket_t fd, short, void*)
+{
+	unsigned char datagram[sizeof(_FASTLANE_HDR) + CHACHAPOLY_TAG_SIZE + 1];
+	std::vector<uintptr_t> users;
+
+	clockrefresh();
+
+	for (int n = 0; n < FASTLANE_READS; n++) {
+		struct sockaddr_in sin;
+		ev_socklen_t sinlen = sizeof(sin);
+		int len = (int)recvfrom(fd, (char*)datagram, sizeof(datagram), 0, (struct sockaddr*)&sin, &sinlen);
+		if (len < 0)
+			break;
+
+		_FASTLANE_HDR hdr;
+		memcpy(&hdr, datagram, std::min((size_t)len, sizeof(hdr)));
+		if (len != (int)(sizeof(_FASTLANE_HDR) + CHACHAPOLY_TAG_SIZE) || sin.sin_family != AF_INET ||
+			hdr.c != FASTLANE_HELLO || hdr.version != FASTLANE_VERSION) {
+			fastlanerefused++;
+			continue;
+		}
+
+		uint8_t key[SHA256_DIGEST_SIZE];
+		uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+		fastlanederive(hdr.token, hdr.id, key);
+		fastlanenonce(1, hdr.counter, nonce);
+		if (!chachapolyopen(key, nonce, datagram, sizeof(_FASTLANE_HDR), datagram + sizeof(_FASTLANE_HDR), 0, datagram + sizeof(_FASTLANE_HDR))) {
+			fastlanerefused++;
+			continue;
+		}
+
+		guser.gettokenusers(hdr.token, users);
+		for (size_t i = 0; i < users.size(); i++)
+			fastlanebind(users[i], hdr, sin.sin_addr.s_addr, sin.sin_port);
+	}
+}
+
+bool fastlanestart(struct event_base* base)
+{
+	if (c.getfastport() == 0 || fastlanefd != EVUTIL_INVALID_SOCKET)
+		return true;
+
+	std::random_device rd;
+	uint32_t secret[8];
+	for (int n = 0; n < 8; n++)
+		secret[n] = rd();
+	hmacsha256key(fastlanekey, secret, sizeof(secret));
+
+	fastlanefd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fastlanefd == EVUTIL_INVALID_SOCKET) {
+		MSGLOG(eMSGTYPE::ERROR, "fastlane, socket failed, %s (%d).", __func__, __LINE__);
+		return false;
+	}
+	evutil_make_socket_nonblocking(fastlanefd);
+
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(c.getfastport());
+
+	if (bind(fastlanefd, (struct sockaddr*)&sin, sizeof(sin)) != 0) {
+		MSGLOG(eMSGTYPE::ERROR, "fastlane, bind failed at udp port %d, apps get no fast lane.", c.getfastport());
+		fastlanestop();
+		return false;
+	}
+
+	fastlaneport = c.getfastport();
+	fastlaneev = event_new(base, fastlanefd, EV_READ | EV_PERSIST, fastlanereadcb, NULL);
+	event_add(fastlaneev, NULL);
+	MSGLOG(eMSGTYPE::INFO, "fastlane, apps of APK_VER_FASTLANE get the moves over udp port %d as well.", fastlaneport);
+	return true;
+}
+
+void fastlanestop()
+{
+	if (fastlaneev != NULL)
+		event_free(fastlaneev);
+	fastlaneev = NULL;
+
+	if (fastlanefd != EVUTIL_INVALID_SOCKET)
+		evutil_closesocket(fastlanefd);
+	fastlanefd = EVUTIL_INVALID_SOCKET;
+	fastlaneport = 0;
+}
+
+bool fastlaneisenabled()
+{
+	return fastlaneport != 0;
+}
+
+void fastlaneoffer(uintptr_t userindex)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || !userinfo->isfastlane || !fastlaneisenabled())
+		return;
+
+	if (userinfo->packetdata.loop != le_getloop()) {
+		le_postloop(userinfo->packetdata.loop, [userindex]() { fastlaneoffer(userindex); });
+		return;
+	}
+
+	if (userinfo->packetdata.fastlane == NULL)
+		userinfo->packetdata.fastlane = new _FASTLANE_STATE();
+
+	// a new id for every login, the hellos of the one before are no longer taken. the counter goes on, an
+	// id drawn twice makes the same key
+	_FASTLANE_STATE* lane = userinfo->packetdata.fastlane;
+	uint64_t txcounter = lane->txcounter;
+	std::random_device rd;
+	memset(lane, 0, sizeof(_FASTLANE_STATE));
+	lane->txcounter = txcounter;
+	while (lane->id == 0)
+		lane->id = rd();
+	fastlanederive(userinfo->token, lane->id, lane->key);
+
+	_PMSG_FASTLANE_INFO pMsg = pkttemplate<_PMSG_FASTLANE_INFO>(0xF2, 0x10);
+	pMsg.port = fastlaneport;
+	pMsg.id = lane->id;
+	memcpy(pMsg.key, lane->key, sizeof(pMsg.key));
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
+
+// frames an app may apply ahead of the ones before them, each sets a value or a card at its place:
+// F1 stock, active info, card counts, time left and deadline, F3 draw, drop and action mask
+static bool fastlaneiskind(const unsigned char* data, int len)
+{
+	if (len < 4 || data[0] != 0xC1)
+		return false;
+	if (data[1] == 0xF1)
+		return data[3] == 0x01 || data[3] == 0x02 || data[3] == 0x05 || data[3] == 0x07 || data[3] == 0x0D;
+	if (data[1] == 0xF3)
+		return data[3] == 0x00 || data[3] == 0x01 || data[3] == 0x0A;
+	return false;
+}
+
+void fastlanesend(_USER_INFO* userinfo, const unsigned char* data, int len, const unsigned char* wire, int wirelen)
+{
+	_FASTLANE_STATE* lane = userinfo->packetdata.fastlane;
+
+	if (lane == NULL || lane->hellotick == 0 || clockmsec() > lane->hellotick + FASTLANE_TIMEOUT_MSEC ||
+		wirelen > FASTLANE_MAX_FRAME || !fastlaneiskind(data, len))
+		return;
+
+	unsigned char datagram[sizeof(_FASTLANE_HDR) + FASTLANE_MAX_FRAME + CHACHAPOLY_TAG_SIZE];
+	fastlaneheader((_FASTLANE_HDR*)datagram, FASTLANE_FRAME, lane, userinfo);
+	memcpy(datagram + sizeof(_FASTLANE_HDR), wire, wirelen);
+	fastlanewrite(lane, datagram, wirelen);
+	fastlaneframes++;
+}
+
+void fastlanefree(_FASTLANE_STATE*& lane)
+{
+	delete lane;
+	lane = NULL;
+}
+
+void fastlanestats(_FASTLANE_STATS& stats)
+{
+	stats.frames = fastlaneframes.load();
+	stats.hellos = fastlanehellos.load();
+	stats.refused = fastlanerefused.load();
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+#include "chachapoly.h"
+
+struct _USER_INFO;
+
+// a udp side channel for the moves of a table, on a mobile link one lost tcp segment holds every packet
+// after it back by a retransmit timeout and a draw shows up seconds late. with a "Fast Port" an app of
+// APK_VER_FASTLANE gets _PMSG_FASTLANE_INFO at login, an id and a key of its own for the session token,
+// and sends a hello from its udp socket. the server takes the address the hello came from as the one of
+// the connection and acks it, from then on every frame of FASTLANE kinds its seat is sent goes out twice,
+// on the connection as always and in a datagram with the replay seq of the frame, see replay.h
+//   datagram  _FASTLANE_HDR, the frame as the connection carries it, the tag
+// each datagram is sealed with chacha20-poly1305 under the key, the header is the aad and the nonce is
+// the direction and the counter of the header, which only grows in each direction. the key is
+//   hmac-sha-256(secret of the server, FASTLANE_LABEL | token | id)
+// so loop 0 checks a hello without keeping anything, a forged or replayed one is dropped unanswered
+//
+// tcp stays the one that counts. the kinds set a value or a card at its place, active seat, deadline,
+// time left, stock and card counts, a draw, a drop and the action mask, so the app applies a datagram
+// ahead of the frames before it as long as its seq is one it has not applied, and skips the frame of
+// that seq when the connection brings it. a lost or late datagram costs nothing, the connection brings
+// the frame anyway. the app sends a hello again at least every FASTLANE_HELLO_MSEC to keep its nat
+// mapping, a lane without one for FASTLANE_TIMEOUT_MSEC is not sent to and a hello from a new address
+// moves it there
+
+#define FASTLANE_VERSION 1
+#define FASTLANE_HELLO 0xC5	// app to server, empty
+#define FASTLANE_ACK 0xC6	// the answer to a hello, empty
+#define FASTLANE_FRAME 0xC7
+#define FASTLANE_LABEL "tongits fastlane"
+#define FASTLANE_MAX_FRAME 256	// bytes of a frame sent twice, a longer one goes on the connection only
+#define FASTLANE_HELLO_MSEC 15000
+#define FASTLANE_TIMEOUT_MSEC 45000
+#define FASTLANE_READS 64	// datagrams loop 0 reads in one callback
+
+#pragma pack(push, 1)
+struct _FASTLANE_HDR
+{
+	uint8_t c;	// FASTLANE_HELLO, FASTLANE_ACK or FASTLANE_FRAME
+	uint8_t version;
+	uint16_t reserved;
+	uint32_t id;	// of _PMSG_FASTLANE_INFO
+	int64_t token;	// session token of the app
+	uint64_t counter;	// nonce in its direction
+	uint32_t seq;	// replay seq of the frame, of the newest one for an ack
+};
+#pragma pack(pop)
+
+static_assert(sizeof(_FASTLANE_HDR) == 28, "_FASTLANE_HDR has no padding");
+
+// of a connection, used on the loop that owns it
+struct _FASTLANE_STATE
+{
+	uint32_t id;
+	uint8_t key[CHACHAPOLY_KEY_SIZE];
+	uint64_t rxcounter;	// of the newest hello
+	uint64_t txcounter;
+	uint64_t hellotick;	// clockmsec of the newest hello, 0 before the first
+	uint32_t ip;	// the hello came from, network order
+	uint16_t port;
+};
+
+struct _FASTLANE_STATS
+{
+	uint64_t frames;	// datagrams sent
+	uint64_t hellos;	// taken
+	uint64_t refused;	// hellos dropped
+};
+
+bool fastlanestart(struct event_base* base);	// loop 0, with the game ports
+void fastlanestop();
+bool fastlaneisenabled();
+void fastlaneoffer(uintptr_t userindex);	// any loop, once the session token is known
+// the loop of the user, a frame replayrecord counted, in v1 and as the connection carries it
+void fastlanesend(_USER_INFO* userinfo, const unsigned char* data, int len, const unsigned char* wire, int wirelen);
+void fastlanefree(_FASTLANE_STATE*& lane);
+void fastlanestats(_FASTLANE_STATS& stats);
@@ -0,0 +1,84 @@
+#include "flow.h"
+#include "user.h"
+#include "socket.h"
+#include "sms.h"
+#include <event2/event.h>
+
+static void flowstep(_FLOW* flow)
+{
+	// a wait over before its FLOW_WAIT returned goes on once it has
+	if (flow->isrunning) {
+		flow->isready = true;
+		return;
+	}
+
+	do {
+		flow->isready = false;
+
+		// the client left while it waited
+		if (flow->userindex != 0 && guser.getuser(flow->userindex) == NULL) {
+			delete flow;
+			return;
+		}
+
+		flow->isrunning = true;
+		bool isgoing = flow->run();
+		flow->isrunning = false;
+
+		if (!isgoing) {
+			delete flow;
+			return;
+		}
+	} while (flow->isready);
+}
+
+void flowstart(_FLOW* flow, uintptr_t userindex)
+{
+	flow->loop = le_getloop();
+	flow->userindex = userindex;
+	flowstep(flow);
+}
+
+void flowdb(_FLOW* flow, _DB_JOB* job)
+{
+	job->done = [flow](_DB_JOB* job) {
+		flow->db = *job;
+		flow->db.done = nullptr;
+		flowstep(flow);
+	};
+	dbsubmit(job);
+}
+
+void flowtask(_FLOW* flow, _TASK_LANE lane, std::function<void()> work)
+{
+	tasksubmit(lane, std::move(work), [flow]() { flowstep(flow); });
+}
+
+void flowhttp(_FLOW* flow, const std::string& url, const std::string& fields, const std::string& tag)
+{
+	httppost(url, fields, tag, [flow](bool issent) {
+		flow->isok = issent;
+		flowstep(flow);
+	});
+}
+
+void flowsms(_FLOW* flow, const _SMS_INFO& sms, const std::string& tag)
+{
+	smspost(sms, tag, [flow](bool issent) {
+		flow->isok = issent;
+		flowstep(flow);
+	});
+}
+
+static void flowtimercb(evutil_socket_t fd, short what, void* arg)
+{
+	flowstep((_FLOW*)arg);
+}
+
+void flowsleep(_FLOW* flow, int msec)
+{
+	struct timeval tv;
+	tv.tv_sec = msec / 1000;
+	tv.tv_usec = (msec % 1000) * 1000;
+	event_base_once(le_getbase(flow->loop), -1, EV_TIMEOUT, flowtimercb, flow, &tv);
+}
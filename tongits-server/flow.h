@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <functional>
+#include "dbpool.h"
+#include "taskpool.h"
+
+struct _SMS_INFO;	// sms.h
+
+// a request that waits more than once, on the database, the task pool, an http post or a timer, written
+// top to bottom as one function instead of a callback inside a callback. run is called again from the
+// top after every wait and FLOW_BEGIN jumps back to the line it waited on, so whatever it needs after a
+// wait is a member of the flow and not a local. a FLOW_WAIT is found by its line, so there is one to a
+// line, and it can not sit inside a switch of its own. a flow runs on the loop that started it and every
+// wait resumes it there, it is dropped at the next resume once its user is gone and deleted when run is
+// done
+//
+//	struct _SOME_FLOW : _FLOW
+//	{
+//		bool run() override
+//		{
+//			FLOW_BEGIN;
+//			FLOW_WAIT(flowdb(this, job));
+//			if (db.result != DB_RESULT_OK)
+//				return false;
+//			FLOW_WAIT(flowhttp(this, url, fields, tag));
+//			FLOW_DONE;
+//		}
+//	};
+
+#define FLOW_BEGIN switch (this->line) { case 0:
+#define FLOW_WAIT(start) do { this->line = __LINE__; start; return true; case __LINE__:; } while (0)
+#define FLOW_DONE } return false
+
+struct _FLOW
+{
+	int line;	// where run goes on from, 0 at the start
+	int loop;
+	uintptr_t userindex;	// 0 for a flow of no user
+	bool isrunning;
+	bool isready;	// resumed from inside run, by a wait that was over at once
+	_DB_JOB db;	// the answer of the last flowdb
+	bool isok;	// of the last flowhttp or flowsms
+
+	_FLOW() : line(0), loop(0), userindex(0), isrunning(false), isready(false), db(), isok(false) {}
+	virtual ~_FLOW() {}
+	virtual bool run() = 0;	// false once it is done
+};
+
+void flowstart(_FLOW* flow, uintptr_t userindex);	// on a loop, runs it up to its first wait
+
+// the waits, each started inside a FLOW_WAIT
+void flowdb(_FLOW* flow, _DB_JOB* job);	// its done is the flow's, the job is copied to db
+void flowtask(_FLOW* flow, _TASK_LANE lane, std::function<void()> work);
+void flowhttp(_FLOW* flow, const std::string& url, const std::string& fields, const std::string& tag);
+void flowsms(_FLOW* flow, const _SMS_INFO& sms, const std::string& tag);
+void flowsleep(_FLOW* flow, int msec);
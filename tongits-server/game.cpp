@@ -6,6 +6,33 @@
 #include <random>
 #include <cassert>
 #include "conf.h"
+#include "settle.h"
+#include "eventlog.h"
+#include "snapshot.h"
+#include "wire.h"
+#include "stats.h"
+#include "trace.h"
+#include "bot.h"
+#include "packet.h"
+#include "metrics.h"
+#include "tournament.h"
+#include "cluster.h"
+#include "gamesink.h"
+#include "replay.h"
+#include "suspend.h"
+#include "../Common/loopwatch.h"
+
+void _CARD_RNG::seed()
+{
+	std::random_device rd;
+
+	do {
+		for (int i = 0; i < 4; i++)
+			this->s[i] = ((uint64_t)rd() << 32) | rd();
+	} while ((this->s[0] | this->s[1] | this->s[2] | this->s[3]) == 0);
+}
+
+// the rejects a player gets the most, built at compile time
 
 static char monetary[2][7]{
 	"eCoins",
@@ -16,75 +43,473 @@ game::game()
 {
 	this->m_hitter = 0;
 	this->m_state = _GAME_STATE::_FREE;
+	this->m_loop = -1;
+	this->m_timer = NULL;
+	this->m_runusec = 0;
+	this->m_runmaxusec = 0;
+	this->m_runs = 0;
+	this->m_nextfree = NULL;
+	this->m_isfreelisted = false;
+	this->m_isqueued = false;
 	this->m_counter = 0;
 	this->m_gametick = 0;
 	this->m_active_pos = -1;
 	this->m_resumed = false;
+	this->m_resyncuser = 0;
+	this->m_tourneyhands = 0;
+	this->m_hands = 0;
+	this->m_frozentick = 0;
+	this->m_frozenstate = _GAME_STATE::_FREE;
+	this->m_heldtick = 0;
+	this->m_isplayout = false;
+	this->m_isseatpktsdirty = true;
 	this->m_resumemsleft = 0;
 	this->m_dropcardctr = 0;
+	this->m_stocktop = 0;
 	this->m_ectype = 0;
+	this->m_syncseq = 0;
+	this->m_spectate = NULL;
+	this->m_sink = gamenetsink();
+	this->m_rng.seed();
 
 	for (int n = 0; n < 3; n++) {
 		this->m_usercardinfo[n].user.clear();
+		this->m_usercardinfo[n].mask = 0;
+		memset(&this->m_usercardinfo[n].count, 0, sizeof(_USER_CARD_COUNT));
 		this->m_usercardinfo[n].down.clear();
 		this->m_usercardinfo[n].group.clear();
 		this->m_usercardinfo[n].lastdrawcard.cardtype = 0;
 		this->m_usercardinfo[n].lastdrawcard.cardnum = 0;
 		this->m_usercardinfo[n].iskick = false;
+		this->m_gpsversions[n] = 0;
 	}
 }
 
 game::~game()
 {
+	if (this->m_timer != NULL)
+		event_free(this->m_timer);
 	this->reset();
 }
 
+// with Tick Budget Usec the loop runs the table after its timer, see le_queuegame
+static void le_gametimercb(evutil_socket_t fd, short event, void* arg)
+{
+	game* g = (game*)arg;
+
+	if (c.gettickbudgetusec() > 0)
+		le_queuegame(g);
+	else
+		g->tick();
+}
+
+// one run of the table, from its timer or the due queue of its loop
+void game::tick()
+{
+	clockrefresh();
+	int64_t serial = this->m_gameserial;
+	_GAME_STATE state = this->m_state;
+	_LoopBusy busy("game", serial);
+	uint64_t start = statsusec();
+	tracerun(_TRACE_TYPE::_GAMERUN, serial);
+	this->run();
+	uint64_t usec = statsusec() - start;
+	statstick(_STATS_TICK::_GAMERUN, usec);
+	statsgamestate((int)state, usec);
+	this->accountrun(serial, state, usec);
+	if (this->m_state != _GAME_STATE::_FREE)
+		this->schedule();
+}
+
+// the cost of the table so far, a callback over Slow Table is logged once a second per loop at most,
+// with how many more were left out meanwhile
+void game::accountrun(int64_t serial, _GAME_STATE state, uint64_t usec)
+{
+	static thread_local uint64_t slowlogged = 0;
+	static thread_local int slowskipped = 0;
+
+	// a table that just ended starts counting for its next players
+	if (this->m_state != _GAME_STATE::_FREE) {
+		this->m_runusec += usec;
+		this->m_runs++;
+		if (usec > this->m_runmaxusec)
+			this->m_runmaxusec = usec;
+	}
+
+	uint64_t threshold = (uint64_t)c.getslowtablemsec() * 1000;
+	if (threshold == 0 || usec <= threshold)
+		return;
+
+	uint64_t now = statsusec();
+	if (now - slowlogged < 1000000) {
+		slowskipped++;
+		return;
+	}
+	slowlogged = now;
+
+	MSGLOG(eMSGTYPE::INFO, "game %lld, slow tick of %llu usec in state %s, %u ticks %llu usec in all max %llu, %d dropped cards, %d more slow ticks not logged.",
+		(long long)serial, (unsigned long long)usec, statsgamestatename((int)state), this->m_runs, (unsigned long long)this->m_runusec,
+		(unsigned long long)this->m_runmaxusec, (int)this->vDroppedCards.size(), slowskipped);
+	slowskipped = 0;
+}
+
+// each table sleeps on its own timer until its next deadline, msec -1 asks run for the next one
+void game::schedule(int64_t msec)
+{
+	if (traceisreplay())
+		return;	// the trace says when a table ran
+
+	if (this->m_loop < 0 || this->m_loop != le_getloop())
+		return;
+
+	if (this->m_timer == NULL)
+		this->m_timer = evtimer_new(le_getbase(this->m_loop), le_gametimercb, this);
+
+	if (msec < 0) {
+		uint64_t now = clockmsec();
+		uint64_t deadline = this->getnextdeadline();
+		msec = (deadline > now) ? deadline - now : 0;
+	}
+
+	struct timeval tv;
+	tv.tv_sec = msec / 1000;
+	tv.tv_usec = (msec % 1000) * 1000;
+	evtimer_add(this->m_timer, &tv);
+}
+
+void game::stoptimer()
+{
+	if (this->m_isqueued)
+		le_unqueuegame(this);
+	if (this->m_timer == NULL)
+		return;
+	event_free(this->m_timer);
+	this->m_timer = NULL;
+}
+
+// the deadlines are checked with a strict compare, so wake up just after them
+uint64_t game::getnextdeadline()
+{
+	uint64_t now = clockmsec();
+	uint64_t next = now + GAME_TICK_MSEC;
+
+	switch (this->m_state) {
+	case _GAME_STATE::_NOTICE:
+	case _GAME_STATE::_RESTARTED:
+	case _GAME_STATE::_CLOSED:
+		// nothing happens until the countdown is over
+		if (this->m_gametick > now)
+			next = this->m_gametick + 1;
+		break;
+	case _GAME_STATE::_STARTED:
+	{
+		if (this->m_gametick > now && this->m_gametick + 1 < next)
+			next = this->m_gametick + 1;
+		_USER_INFO* active = guser.getuser(this->m_active_userindex);
+		if (active != NULL && active->activetick != 0) {
+			uint64_t turn = active->activetick + this->getturnmsec(this->m_active_userindex) + 1;
+			if (active->isbot)
+				turn = active->activetick + c.getbotthinkmsec() + 1;
+			if (turn > now && turn < next)
+				next = turn;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	return next;
+}
+
 void game::loadgameconf()
 {
-	_TONGITS_BET_INFO ecoins = c.getbetmode(0);
-	this->m_ecinfo[0].hitbaseaddecoins = ecoins.hits;
-	this->m_ecinfo[0].hitaddecoins = ecoins.hitsadd;
-	this->m_ecinfo[0].nodownaddecoins = ecoins.burned;
-	this->m_ecinfo[0].nontongitaddecoins = ecoins.nontongits;
-	this->m_ecinfo[0].tongitaddecoins = ecoins.tongits;
-	this->m_ecinfo[0].sagasaaddecoins = ecoins.sagasa;
-	this->m_ecinfo[0].royaladdecoins = ecoins.royal;
-	this->m_ecinfo[0].quadraaddecoins = ecoins.quadra;
-	this->m_ecinfo[0].foughtbaseaddecoins = ecoins.fight;
-	this->m_ecinfo[0].foughtpercardaddecoins = ecoins.fightpercard;
-	this->m_ecinfo[0].aceaddecoins = ecoins.ace;
-	_TONGITS_BET_INFO jewels = c.getbetmode(1);
-	this->m_ecinfo[1].hitbaseaddecoins = jewels.hits;
-	this->m_ecinfo[1].hitaddecoins = jewels.hitsadd;
-	this->m_ecinfo[1].nodownaddecoins = jewels.burned;
-	this->m_ecinfo[1].nontongitaddecoins = jewels.nontongits;
-	this->m_ecinfo[1].tongitaddecoins = jewels.tongits;
-	this->m_ecinfo[1].sagasaaddecoins = jewels.sagasa;
-	this->m_ecinfo[1].royaladdecoins = jewels.royal;
-	this->m_ecinfo[1].quadraaddecoins = jewels.quadra;
-	this->m_ecinfo[1].foughtbaseaddecoins = jewels.fight;
-	this->m_ecinfo[1].foughtpercardaddecoins = jewels.fightpercard;
-	this->m_ecinfo[1].aceaddecoins = jewels.ace;
+	// the snapshot stays valid for the whole round even if conf is reloaded meanwhile
+	this->m_betconf = c.getbetconf();
+	this->m_ecinfo = this->m_betconf->ecoins;
+	this->m_timeouts = this->m_betconf->timeouts;
+	this->m_rules = this->m_betconf->rules;
+}
+
+template <class R>
+void game::dealseats(std::vector<unsigned char>& userpos)
+{
+	intptr_t dealer = (this->m_hitter == 0) ? this->m_users[0] : this->m_hitter;
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		int cardscount = (this->m_users[i] == dealer) ? R::dealercards : R::playercards;
+		userpos.insert(userpos.end(), cardscount, (unsigned char)i);
+	}
+}
+
+template <class R>
+bool game::isdown(const _USER_INFO* userinfo)
+{
+	if constexpr (R::handmelds)
+		return userinfo->m_isdowncard || userinfo->m_quadracount > 0 || userinfo->m_royalcount > 0;
+	else
+		return userinfo->m_isdowncard;
+}
+
+template <class R>
+int game::burnedecoins(const _USER_INFO* userinfo)
+{
+	if constexpr (R::burned)
+		return this->isdown<R>(userinfo) ? 0 : this->m_ecinfo[this->m_ectype].nodownaddecoins;
+	else
+		return 0;
+}
+
+template <class R>
+void game::paysagasa(uintptr_t userindex, unsigned char userpos)
+{
+	if constexpr (R::sagasa) {
+		this->sendnotice(0, 3, _NOTICE_ID::_SAGASA, guser.getuser(userindex)->name);
+		GAMELOG(INFO, "%s (%s) is sagasa.", guser.getuser(userindex)->name.c_str(), guser.getuser(userindex)->account.c_str());
+		for (int i = 0; i < 3; i++) {
+			if (userpos == i)
+				guser.getuser(this->m_users[i])->ecoins[this->m_ectype] += this->m_ecinfo[this->m_ectype].sagasaaddecoins * 2;
+			else
+				guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].sagasaaddecoins;
+			this->sendresult(this->m_users[i], 3);
+		}
+		this->senduserecoinsinfo();
+	}
+}
+
+// the most a loser can be asked for in a round, the fight payments aside
+template <class R>
+uintptr_t game::minecoins()
+{
+	const _GAME_TYPE_ECOINSINFO& ecinfo = this->m_ecinfo[this->m_ectype];
+	uintptr_t ecoins = ecinfo.hitbaseaddecoins + ecinfo.tongitaddecoins + ecinfo.royaladdecoins + ecinfo.quadraaddecoins + ecinfo.aceaddecoins * 4;
+
+	if constexpr (R::burned)
+		ecoins += ecinfo.nodownaddecoins;
+	return ecoins;
+}
+
+#define HOUSE_RULES(name, R) { name, &game::dealseats<R>, &game::isdown<R>, &game::burnedecoins<R>, &game::paysagasa<R>, &game::minecoins<R> }
+
+const _HOUSE_RULES* rulesfind(const std::string& name)
+{
+	static const _HOUSE_RULES policies[] = {
+		HOUSE_RULES("Classic", _RULES_CLASSIC),
+		HOUSE_RULES("Casual", _RULES_CASUAL),
+		HOUSE_RULES("Strict", _RULES_STRICT)
+	};
+
+	for (const _HOUSE_RULES& policy : policies) {
+		if (name == policy.name)
+			return &policy;
+	}
+	return NULL;
 }
 
 void game::reset()
 {
+	this->m_isseatpktsdirty = true;
 	this->m_winner = 0;
 	this->m_fightuserindex = 0;
 	this->vStockCards.clear();
+	this->m_stocktop = 0;
 	this->vDroppedCards.clear();
+	this->botrolloutcancel();
 	this->loadgameconf();
 	for (int n = 0; n < 3; n++) {
 		this->m_usercardinfo[n].user.clear();
+		this->m_usercardinfo[n].mask = 0;
+		memset(&this->m_usercardinfo[n].count, 0, sizeof(_USER_CARD_COUNT));
 		this->m_usercardinfo[n].down.clear();
 		this->m_usercardinfo[n].group.clear();
 		this->m_usercardinfo[n].lastdrawcard.cardtype = 0;
 		this->m_usercardinfo[n].lastdrawcard.cardnum = 0;
+		this->m_gpsversions[n] = 0;
+	}
+}
+
+// the table as it stands, false when one of its seats is already gone or a migration holds it
+bool game::savesnapshot(_SNAPSHOT_GAME& s)
+{
+	memset((void*)&s, 0, sizeof(_SNAPSHOT_GAME));	// padding included, the bytes go to the file as they are
+
+	if (this->m_frozentick != 0)
+		return false;
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(this->m_users[i]);
+		if (userinfo == NULL)
+			return false;
+		snapshotsaveuser(s.users[i], this->m_users[i], userinfo);
+	}
+
+	s.serial = this->m_gameserial;
+	s.state = (int)this->m_state;
+	s.active_pos = this->m_active_pos;
+	s.active_status = this->m_active_status;
+	s.counter = this->m_counter;
+	s.resumemsleft = this->m_resumemsleft;
+	s.stocktop = this->m_stocktop;
+	s.gametick = this->m_gametick;
+	s.winner = this->m_winner;
+	s.fightuserindex = this->m_fightuserindex;
+	s.hitter = this->m_hitter;
+	s.active_userindex = (uintptr_t)this->m_active_userindex;
+	s.hitprizeecoins = this->m_hitprizeecoins;
+	memcpy(s.gpsversions, this->m_gpsversions, sizeof(s.gpsversions));
+	s.ectype = this->m_ectype;
+	s.dropcardctr = this->m_dropcardctr;
+	memcpy(s.initdrawcards, this->initdrawcards, sizeof(s.initdrawcards));
+	s.resumed = this->m_resumed;
+	s.rng = this->m_rng;
+	for (int i = 0; i < MAX_USER_POS; i++)
+		s.cardinfo[i] = this->m_usercardinfo[i];
+	s.stock = this->vStockCards;
+	s.dropped = this->vDroppedCards;
+	s.settle = this->m_settle;
+	return true;
+}
+
+// users are the new handles of the seats, every reference to an old handle is moved over to them
+void game::loadsnapshot(const _SNAPSHOT_GAME& s, const uintptr_t* users, int64_t shift)
+{
+	auto remap = [&s, users](uint64_t userindex) -> uintptr_t {
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			if (userindex != 0 && s.users[i].userindex == userindex)
+				return users[i];
+		}
+		return 0;
+	};
+
+	this->loadgameconf();
+	for (int i = 0; i < MAX_USER_POS; i++)
+		this->m_users[i] = users[i];
+
+	metricsgamestate((int)this->m_state, s.state);
+	this->m_state = (_GAME_STATE)s.state;
+	this->m_active_pos = s.active_pos;
+	this->m_active_status = s.active_status;
+	this->m_counter = s.counter;
+	this->m_resumemsleft = s.resumemsleft;
+	this->m_stocktop = s.stocktop;
+	this->m_gametick = (s.gametick != 0) ? s.gametick + shift : 0;
+	this->m_winner = remap(s.winner);
+	this->m_fightuserindex = remap(s.fightuserindex);
+	this->m_hitter = remap(s.hitter);
+	this->m_active_userindex = (int)remap(s.active_userindex);
+	this->m_hitprizeecoins = (uintptr_t)s.hitprizeecoins;
+	memcpy(this->m_gpsversions, s.gpsversions, sizeof(this->m_gpsversions));
+	this->m_ectype = s.ectype;
+	this->m_dropcardctr = s.dropcardctr;
+	memcpy(this->initdrawcards, s.initdrawcards, sizeof(this->initdrawcards));
+	this->m_resumed = s.resumed;
+	this->m_rng = s.rng;
+	for (int i = 0; i < MAX_USER_POS; i++)
+		this->m_usercardinfo[i] = s.cardinfo[i];
+	this->vStockCards = s.stock;
+	this->vDroppedCards = s.dropped;
+	this->m_settle = s.settle;
+}
+
+// between two turns or two hands, nothing a player did is half done. a tournament table stays, loop 0
+// of this server counts its hands
+bool game::ismigratable()
+{
+	if (this->m_frozentick != 0 || this->m_tourneyhands != 0)
+		return false;
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		if (this->m_usercardinfo[i].iskick)
+			return false;
 	}
+
+	if (this->m_state == _GAME_STATE::_RESTARTED)
+		return true;
+	return this->m_state == _GAME_STATE::_STARTED && this->m_active_status == (int)_ACTIVE_STATE::_NONE && this->m_winner == 0;
+}
+
+// _WAITING runs nothing and isactionvalid turns every request down, the deadlines are moved on by the
+// time held when the table plays on here
+void game::freeze()
+{
+	this->m_frozenstate = this->m_state;
+	this->m_frozentick = clockmsec();
+	metricsgamestate((int)this->m_state, (int)_GAME_STATE::_WAITING);
+	this->m_state = _GAME_STATE::_WAITING;
+}
+
+void game::thaw()
+{
+	if (this->m_frozentick == 0)
+		return;
+
+	if (this->m_gametick != 0)
+		this->m_gametick += clockmsec() - this->m_frozentick;
+	metricsgamestate((int)this->m_state, (int)this->m_frozenstate);
+	this->m_state = this->m_frozenstate;
+	this->m_frozentick = 0;
+	this->schedule(0);
+}
+
+// a table of _STARTED its three players all left neither plays their turns nor closes, with a hit prize
+// on it they may still come back for it. once nobody did for "Suspend Seconds" it goes to the suspend
+// store, see suspend.h. true while it is held or gone
+bool game::checksuspend()
+{
+	int seconds = c.getsuspendsec();
+	bool isheld = seconds > 0 && !this->m_isplayout && this->m_state == _GAME_STATE::_STARTED && this->m_hitter != 0
+		&& this->ismigratable() && this->checkactiveusers() == 0;
+
+	if (!isheld) {
+		// one is back, the turn and the deadlines go on from where the table was held
+		if (this->m_heldtick != 0) {
+			uint64_t held = clockmsec() - this->m_heldtick;
+			if (this->m_gametick != 0)
+				this->m_gametick += held;
+			_USER_INFO* active = guser.getuser(this->m_active_userindex);
+			if (active != NULL && active->activetick != 0)
+				active->activetick += held;
+			this->m_heldtick = 0;
+		}
+		return false;
+	}
+
+	if (this->m_heldtick == 0) {
+		this->m_heldtick = clockmsec();
+		GAMELOG(INFO, "checksuspend, all players are away, the table is held.");
+	}
+
+	if (clockmsec() < this->m_heldtick + (uint64_t)seconds * 1000)
+		return true;
+
+	std::shared_ptr<_SNAPSHOT_GAME> s = std::make_shared<_SNAPSHOT_GAME>();
+	if (!this->savesnapshot(*s))
+		return true;
+
+	uint64_t heldtick = this->m_heldtick;
+	GAMELOG(INFO, "checksuspend, nobody came back in %d seconds, the table is suspended.", seconds);
+	this->suspended();
+	suspendput(s, heldtick);
+	return true;
+}
+
+// its record is on the way to the store, the seats are let go and so is the slot. the sessions end on
+// loop 0 before suspendput points them at the store
+void game::suspended()
+{
+	this->cleartable();
+
+	for (int i = 0; i < MAX_USER_POS; i++)
+		guser.deluser(this->m_users[i], true);
+
+	this->releasetable();
 }
 
 void game::run()
 {
+	if (this->checksuspend())
+		return;
+
 	switch (this->m_state) {
 	case _GAME_STATE::_NONE:
 		break;
@@ -107,6 +532,7 @@ void game::run()
 		this->procstate_closed();
 		break;
 	case _GAME_STATE::_ENDED:
+	case _GAME_STATE::_FREE:
 		break;
 	}
 }
@@ -119,39 +545,42 @@ void game::setstate(_GAME_STATE state, bool flag)
 		return;
 	}
 
+	metricsgamestate((int)this->m_state, (int)state);
 	this->m_state = state;
 
 	switch (state) {
 	case _GAME_STATE::_NONE:
-		this->msglog(DEBUG, "Set game state to NONE.");
+		GAMELOG(DEBUG, "Set game state to NONE.");
 		break;
 	case _GAME_STATE::_NOTICE:
 		this->setstate_notice();
-		this->msglog(DEBUG, "Set game state to NOTICE.");
+		GAMELOG(DEBUG, "Set game state to NOTICE.");
 		break;
 	case _GAME_STATE::_PREPARE:
 		this->setstate_prepare();
-		this->msglog(DEBUG, "Set game state to NOTICE.");
+		GAMELOG(DEBUG, "Set game state to NOTICE.");
 		break;
 	case _GAME_STATE::_STARTED:
 		this->setstate_started(flag);
-		this->msglog(DEBUG, "Set game state to STARTED.");
+		GAMELOG(DEBUG, "Set game state to STARTED.");
 		break;
 	case _GAME_STATE::_RESTARTED:
-		this->msglog(DEBUG, "Set game state to RESTARTED.");
+		GAMELOG(DEBUG, "Set game state to RESTARTED.");
 		this->setstate_restarted();
 		break;
 	case _GAME_STATE::_WAITING:
 		this->setstate_waiting();
-		this->msglog(DEBUG, "Set game state to WAITING.");
+		GAMELOG(DEBUG, "Set game state to WAITING.");
 		break;
 	case _GAME_STATE::_CLOSED:
 		this->setstate_closed();
-		this->msglog(DEBUG, "Set game state to CLOSED.");
+		GAMELOG(DEBUG, "Set game state to CLOSED.");
 		break;
 	case _GAME_STATE::_ENDED:
 		this->setstate_ended();
-		this->msglog(DEBUG, "Set game state to ENDED.");
+		GAMELOG(DEBUG, "Set game state to ENDED.");
+		break;
+	case _GAME_STATE::_FREE:
 		break;
 	}
 }
@@ -160,29 +589,9 @@ void game::shufflecards()
 {
 	std::vector<unsigned char> _userpos;
 
-	int cardscount = 12;
-
-	if (this->m_hitter == 0 || this->m_hitter == this->m_users[0])
-		cardscount = 13;
-
-	for (int i = 0; i < cardscount; i++)
-		_userpos.push_back(0);
-
-	cardscount = 12;
-	if (this->m_hitter == this->m_users[1])
-		cardscount = 13;
+	(this->*this->rules()->dealseats)(_userpos);
 
-	for (int i = 0; i < cardscount; i++)
-		_userpos.push_back(1);
-
-	cardscount = 12;
-	if (this->m_hitter == this->m_users[2])
-		cardscount = 13;
-
-	for (int i = 0; i < cardscount; i++)
-		_userpos.push_back(2);
-
-	//m_usercardifo
+	traceseed(this->m_gameserial, this->m_rng);
 
 	for (int i = 0; i < MAX_CARD_TYPE; i++) {
 		for (int n = 1; n < MAX_CARDS_PER_TYPE + 1; n += 1) {
@@ -191,39 +600,30 @@ void game::shufflecards()
 			_c.cardnum = n;
 			this->vStockCards.push_back(_c);
 		}
-
-		auto rng = std::default_random_engine{};
-		rng.seed(GetTickCount64());
-		std::shuffle(std::begin(this->vStockCards), std::end(this->vStockCards), rng);
 	}
 
+	this->m_rng.shuffle(this->vStockCards.begin(), (int)this->vStockCards.size());
+	this->m_rng.shuffle(_userpos.data(), (int)_userpos.size());
 
-	auto rng = std::default_random_engine{};
-	rng.seed(GetTickCount64());
-	std::shuffle(std::begin(_userpos), std::end(_userpos), rng);
-
-	int ctr = 0;
 	std::vector<unsigned char>::iterator iter;
 
 	iter = _userpos.begin();
 
 	while (iter != _userpos.end()) {
 		unsigned char _pos = *iter;
-		this->m_usercardinfo[_pos].user.push_back(this->vStockCards[ctr]);
-		this->vStockCards[ctr].cardtype = 0;
-		this->vStockCards[ctr].cardnum = 0;
+		this->pushusercard(_pos, this->vStockCards[this->m_stocktop++]);
 		iter++;
-		ctr++;
+	}
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_CARD_PILE& pile = this->m_usercardinfo[i].user;
+		this->logevent(i, EVENT_START, NULL, (unsigned char)pile.size(), (const unsigned char*)pile.begin());
 	}
 }
 
 void game::sendresult(uintptr_t userindex, unsigned char result)
 {
-	_PMSG_ACTION_RESULT pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF2;
-	pMsg.hdr.len = sizeof(_PMSG_ACTION_RESULT);
-	pMsg.sub = 0x04;
+	_PMSG_ACTION_RESULT pMsg = pkttemplate<_PMSG_ACTION_RESULT>(0xF2, 0x04);
 	pMsg.result = result;
 	this->datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
 }
@@ -231,22 +631,16 @@ void game::sendresult(uintptr_t userindex, unsigned char result)
 bool game::checkecoins()
 {
 	bool result = true;
-	uintptr_t reqecoinstoplay = 0;
-	reqecoinstoplay += this->m_ecinfo[this->m_ectype].hitbaseaddecoins;
-	reqecoinstoplay += this->m_ecinfo[this->m_ectype].nodownaddecoins;
-	reqecoinstoplay += this->m_ecinfo[this->m_ectype].tongitaddecoins;
-	reqecoinstoplay += this->m_ecinfo[this->m_ectype].royaladdecoins;
-	reqecoinstoplay += this->m_ecinfo[this->m_ectype].quadraaddecoins;
-	reqecoinstoplay += this->m_ecinfo[this->m_ectype].aceaddecoins * 4;
+	int reqecoinstoplay = (int)(this->*this->rules()->minecoins)();
 
-	this->msglog(DEBUG, "checkecoins, reqecoinstoplay %d.", reqecoinstoplay);
+	GAMELOG(DEBUG, "checkecoins, reqecoinstoplay %d.", reqecoinstoplay);
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
 		if (this->m_winner != this->m_users[i]) {
 			if (guser.getuser(this->m_users[i]) == NULL ||
 				guser.getuser(this->m_users[i])->ecoins[this->m_ectype] < reqecoinstoplay) {
-				this->sendnotice(0, 1, "%s does'nt have enough %s to continue.", guser.getuser(this->m_users[i])->name.c_str(), monetary[this->m_ectype]);
-				this->sendnotice(0, 1, "%d %s minimum is required to play.", reqecoinstoplay, monetary[this->m_ectype]);
+				this->sendnotice(0, 1, _NOTICE_ID::_NOTENOUGH, guser.getuser(this->m_users[i])->name.c_str(), monetary[this->m_ectype]);
+				this->sendnotice(0, 1, _NOTICE_ID::_MINIMUM, reqecoinstoplay, monetary[this->m_ectype]);
 				result = false;
 			}
 		}
@@ -260,13 +654,13 @@ bool game::updatehitecoins()
 		if (this->m_hitter == 0) {
 			this->m_hitprizeecoins += this->m_ecinfo[this->m_ectype].hitbaseaddecoins;
 			guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].hitbaseaddecoins;
-			this->msglog(DEBUG, "updatehitecoins, deducted %d ecoins from %s (%s), hit ecoins base.",
+			GAMELOG(DEBUG, "updatehitecoins, deducted %d ecoins from %s (%s), hit ecoins base.",
 				this->m_ecinfo[this->m_ectype].hitbaseaddecoins, guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str());
 		}
 		else {
 			guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].hitaddecoins;
 			this->m_hitprizeecoins += this->m_ecinfo[this->m_ectype].hitaddecoins;
-			this->msglog(DEBUG, "updatehitecoins, deducted %d ecoins from %s (%s), hit ecoins top up.",
+			GAMELOG(DEBUG, "updatehitecoins, deducted %d ecoins from %s (%s), hit ecoins top up.",
 				this->m_ecinfo[this->m_ectype].hitaddecoins, guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str());
 		}
 
@@ -276,163 +670,111 @@ bool game::updatehitecoins()
 
 void game::getwinner(int flag)
 {
-	if (this->m_winner != 0) {
-
-		_PMSG_TRANSACT_INFO pMsg = { 0 };
-		pMsg.hdr.c = 0xC1;
-		pMsg.hdr.h = 0xF2;
-		pMsg.hdr.len = sizeof(_PMSG_TRANSACT_INFO);
-		pMsg.sub = 0x08;
-
-		_USER_INFO* winnerinfo = guser.getuser(this->m_winner);
-
-		if (winnerinfo->m_cardcount == 0) {
-			this->sendnotice(0, 3, "%s Tongits!", winnerinfo->name.c_str());
-			this->sendresult(this->m_winner, 2);
-			this->msglog(DEBUG, "getwinner, %s (%s) is tongits.", winnerinfo->name.c_str(), winnerinfo->account.c_str());
-		}
-		else {
-			this->msglog(DEBUG, "getwinner, %s (%s) won with card count of %d.", winnerinfo->name.c_str(), winnerinfo->account.c_str(), winnerinfo->m_cardcount);
-			this->sendresult(this->m_winner, 2);
-		}
-
-		int totalwonprize = 0;
-
-		// save the current ecoins
-		for (int i = 0; i < MAX_USER_POS; i++) {
-			pMsg.users[i].current_ecoins = guser.getuser(this->m_users[i])->ecoins[this->m_ectype];
-			pMsg.users[i].cardcounts = guser.getuser(this->m_users[i])->m_cardcount;
-		}
-
-		unsigned char winpos = guser.getuser(this->m_winner)->m_gamepos;
-
-		for (int i = 0; i < MAX_USER_POS; i++) {
-
-			if (this->m_winner != this->m_users[i]) {
-				// fight challenge
-				if (winnerinfo->m_cardcount != 0 && guser.getuser(this->m_users[i])->fought == true) {
-
-					int fightpay = ((guser.getuser(this->m_users[i])->m_cardcount - winnerinfo->m_cardcount) *
-						this->m_ecinfo[this->m_ectype].foughtpercardaddecoins) + this->m_ecinfo[this->m_ectype].foughtbaseaddecoins;
-
-					guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= fightpay;
-					totalwonprize += fightpay;
-
-					pMsg.users[i].fight = fightpay;
-
-					this->msglog(INFO, "getwinner, deducted %d ecoins from %s (%s) for challenging a fight.",
-						fightpay, guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str());
-				}
+	if (this->m_winner == 0)
+		return;
 
-				// tongits regular payment
-				if (winnerinfo->m_cardcount == 0) {
+	_USER_INFO* users[MAX_USER_POS];
 
-					guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].tongitaddecoins;
-					totalwonprize += this->m_ecinfo[this->m_ectype].tongitaddecoins;
-					pMsg.users[i].regular = this->m_ecinfo[this->m_ectype].tongitaddecoins;
-					this->msglog(INFO, "getwinner, deducted %d ecoins from %s (%s) for tongits payment.",
-						this->m_ecinfo[this->m_ectype].tongitaddecoins, guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str());
+	for (int i = 0; i < MAX_USER_POS; i++)
+		users[i] = guser.getuser(this->m_users[i]);
 
-				}
-				else {
-					guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].nontongitaddecoins;
-					totalwonprize += this->m_ecinfo[this->m_ectype].nontongitaddecoins;
-					pMsg.users[i].regular = this->m_ecinfo[this->m_ectype].nontongitaddecoins;
-					this->msglog(INFO, "getwinner, deducted %d ecoins from %s (%s) for non-tongits payment.",
-						this->m_ecinfo[this->m_ectype].nontongitaddecoins, guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str());
-				}
+	_USER_INFO* winnerinfo = guser.getuser(this->m_winner);
+	const _GAME_TYPE_ECOINSINFO& ecinfo = this->m_ecinfo[this->m_ectype];
+	_SETTLE_INFO& settle = this->m_settle;
 
-				// quadra prize
-				if (winnerinfo->m_quadracount != 0) {
-					guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].quadraaddecoins * winnerinfo->m_quadracount;
-					totalwonprize += this->m_ecinfo[this->m_ectype].quadraaddecoins * winnerinfo->m_quadracount;
-					pMsg.users[i].quadra = this->m_ecinfo[this->m_ectype].quadraaddecoins * winnerinfo->m_quadracount;
-					this->msglog(INFO, "getwinner, deducted %d ecoins from %s (%s) for %d quadra.",
-						this->m_ecinfo[this->m_ectype].quadraaddecoins * winnerinfo->m_quadracount, guser.getuser(this->m_users[i])->name.c_str()
-						, guser.getuser(this->m_users[i])->account.c_str()
-						, winnerinfo->m_quadracount);
-				}
+	memset(&settle, 0, sizeof(_SETTLE_INFO));
+	settle.serial = this->m_gameserial;
+	settle.time = clocktime();
+	settle.ectype = this->m_ectype;
+	settle.winnerpos = winnerinfo->m_gamepos;
+	settle.istongits = (winnerinfo->m_cardcount == 0);
 
-				// royal prize
-				if (winnerinfo->m_royalcount != 0) {
-					guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].royaladdecoins * winnerinfo->m_royalcount;
-					totalwonprize += this->m_ecinfo[this->m_ectype].royaladdecoins * winnerinfo->m_royalcount;
-					pMsg.users[i].royal = this->m_ecinfo[this->m_ectype].royaladdecoins * winnerinfo->m_royalcount;
-					this->msglog(INFO, "getwinner, deducted %d ecoins from %s (%s) for %d royal.",
-						this->m_ecinfo[this->m_ectype].royaladdecoins * winnerinfo->m_royalcount, guser.getuser(this->m_users[i])->name.c_str()
-						, guser.getuser(this->m_users[i])->account.c_str()
-						, winnerinfo->m_royalcount);
+	if (settle.istongits) {
+		this->sendnotice(0, 3, _NOTICE_ID::_TONGITS, winnerinfo->name);
+	}
+	this->sendresult(this->m_winner, 2);
 
-				}
+	// compute every payment first, nothing is applied until the ledger is complete
+	for (int i = 0; i < MAX_USER_POS; i++) {
 
-				// aces prize
-				if (winnerinfo->m_acecount != 0) {
+		_SETTLE_SEAT& seat = settle.seats[i];
+		seat.token = users[i]->token;
+		seat.before = users[i]->ecoins[this->m_ectype];
+		seat.cardcount = users[i]->m_cardcount;
 
-					guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= winnerinfo->m_acecount * this->m_ecinfo[this->m_ectype].aceaddecoins;
-					totalwonprize += winnerinfo->m_acecount * this->m_ecinfo[this->m_ectype].aceaddecoins;
-					pMsg.users[i].ace = winnerinfo->m_acecount * this->m_ecinfo[this->m_ectype].aceaddecoins;
-					this->msglog(INFO, "getwinner, deducted %d ecoins from %s (%s) for %d ace(s).",
-						winnerinfo->m_acecount * this->m_ecinfo[this->m_ectype].aceaddecoins, guser.getuser(this->m_users[i])->name.c_str()
-						, guser.getuser(this->m_users[i])->account.c_str()
-						, winnerinfo->m_acecount);
-				}
+		if (this->m_winner == this->m_users[i])
+			continue;
 
-				// down cards
-				if (guser.getuser(this->m_users[i])->m_isdowncard == false &&
-					guser.getuser(this->m_users[i])->m_quadracount == 0 &&
-					guser.getuser(this->m_users[i])->m_royalcount == 0
-					) {
+		// fight challenge
+		if (!settle.istongits && users[i]->fought == true)
+			seat.fight = ((users[i]->m_cardcount - winnerinfo->m_cardcount) * ecinfo.foughtpercardaddecoins) + ecinfo.foughtbaseaddecoins;
 
-					//this->sendnotice(0, 1, "%s is burned.", guser.getuser(this->m_users[i])->name.c_str());
+		// tongits or non-tongits regular payment
+		seat.regular = settle.istongits ? ecinfo.tongitaddecoins : ecinfo.nontongitaddecoins;
 
-					guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].nodownaddecoins;
-					totalwonprize += this->m_ecinfo[this->m_ectype].nodownaddecoins;
-					pMsg.users[i].burned = this->m_ecinfo[this->m_ectype].nodownaddecoins;
+		seat.quadra = ecinfo.quadraaddecoins * winnerinfo->m_quadracount;
+		seat.royal = ecinfo.royaladdecoins * winnerinfo->m_royalcount;
+		seat.ace = ecinfo.aceaddecoins * winnerinfo->m_acecount;
 
-					this->msglog(INFO, "getwinner, deducted %d ecoins from %s (%s) for no downcards payment.",
-						this->m_ecinfo[this->m_ectype].nodownaddecoins, guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str());
+		// no down cards
+		seat.burned = (this->*this->rules()->burnedecoins)(users[i]);
 
-				}
+		seat.delta = -(seat.fight + seat.regular + seat.quadra + seat.royal + seat.ace + seat.burned);
+		settle.total -= seat.delta;
+	}
 
-				this->sendresult(this->m_users[i], 4);
-			}
-		}
+	if (this->m_hitter == this->m_winner) {
+		settle.hittax = c.getax() * (float)this->m_hitprizeecoins;
+		settle.hitprize = (int)((float)this->m_hitprizeecoins - settle.hittax);
+		settle.total += settle.hitprize;
+		this->m_hitprizeecoins = 0;
+		this->m_hitter = 0;
+	}
+	else {
+		this->m_hitter = this->m_winner;
+	}
 
-		if (this->m_hitter == this->m_winner) {
-			//this->sendnotice(0, 3, "%s got the hit amount of %d ecoins.", winnerinfo->name.c_str(), this->m_hitprizeecoins);
-			float tax = c.getax() * (float)this->m_hitprizeecoins;
-			int finalhitprize = (int)((float)this->m_hitprizeecoins - tax);
-			totalwonprize += finalhitprize;
-			pMsg.hitecoins = finalhitprize;
-			this->m_hitprizeecoins = 0;
-			this->m_hitter = 0;
-			this->msglog(INFO, "getwinner, %s (%s) got the hit amount of %d ecoins, tax is %0.3f ecoins.", 
-				winnerinfo->name.c_str(), winnerinfo->account.c_str(), finalhitprize, tax);
-		}
-		else {
-			this->m_hitter = this->m_winner;
-		}
+	settle.seats[settle.winnerpos].delta = settle.total;
 
-		//this->sendnotice(this->m_winner, 5, "You won a total of %d ecoins.", totalwonprize);
+	// apply
+	for (int i = 0; i < MAX_USER_POS; i++)
+		users[i]->ecoins[this->m_ectype] += settle.seats[i].delta;
 
-		winnerinfo->ecoins[this->m_ectype] += totalwonprize;
+	GAMELOG(INFO, "getwinner, %s (%s) won %d ecoins%s, hit %d tax %0.3f, paid %d/%d/%d.",
+		winnerinfo->name.c_str(), winnerinfo->account.c_str(), settle.total, settle.istongits ? " by tongits" : "",
+		settle.hitprize, settle.hittax, -settle.seats[0].delta, -settle.seats[1].delta, -settle.seats[2].delta);
 
-		this->msglog(INFO, "getwinner, added total of %d ecoins winning prize to %s (%s).",
-			totalwonprize, winnerinfo->name.c_str(), winnerinfo->account.c_str());
+	this->m_hands++;
+	this->m_sink->settled(this, settle);
 
-		pMsg.winnerpos = winpos;
+	for (int i = 0; i < MAX_USER_POS; i++)
+		this->logevent(i, EVENT_SETTLE, NULL, 0, NULL, settle.seats[i].delta);
 
-		if (flag == 1) {
-			this->datasend(this->m_winner, (unsigned char*)&pMsg, pMsg.hdr.len);
-		}
-		else {
+	_PMSG_TRANSACT_INFO pMsg = pkttemplate<_PMSG_TRANSACT_INFO>(0xF2, 0x08);
+	pMsg.winnerpos = settle.winnerpos;
+	pMsg.hitecoins = settle.hitprize;
 
-			// send results
-			for (int i = 0; i < MAX_USER_POS; i++) {
-				this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-			}
-		}
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		const _SETTLE_SEAT& seat = settle.seats[i];
+		pMsg.users[i].current_ecoins = seat.before;
+		pMsg.users[i].cardcounts = seat.cardcount;
+		pMsg.users[i].fight = seat.fight;
+		pMsg.users[i].regular = seat.regular;
+		pMsg.users[i].quadra = seat.quadra;
+		pMsg.users[i].royal = seat.royal;
+		pMsg.users[i].ace = seat.ace;
+		pMsg.users[i].burned = seat.burned;
+		if (this->m_winner != this->m_users[i])
+			this->sendresult(this->m_users[i], 4);
+	}
+
+	if (flag == 1) {
+		this->datasend(this->m_winner, (unsigned char*)&pMsg, pMsg.hdr.len);
+	}
+	else {
 
+		// send results
+		this->broadcast((unsigned char*)&pMsg, pMsg.hdr.len);
 	}
 }
 
@@ -446,125 +788,91 @@ void game::countusercards(uintptr_t userindex, bool isfoughtstatus)
 		return;
 	}
 
-	std::vector<std::vector <_PMSG_CARD_INFO>>::iterator _iter;
-	std::vector <_PMSG_CARD_INFO>::iterator __iter;
+	_USER_CARD_COUNT& count = this->m_usercardinfo[_pos].count;
 
-	userinfo->resetcount();
+#ifdef _DEBUG
+	_USER_CARD_COUNT recount;
+	this->recountusercards(_pos, recount);
+	assert(memcmp(&recount, &count, sizeof(_USER_CARD_COUNT)) == 0);
+#endif
 
-	this->msglog(DEBUG, "countusercards, get ace count from user downcards");
+	userinfo->m_cardcount = count.points;
+	userinfo->m_cardquantity = count.quantity;
+	if (userinfo->m_gamepos < MAX_USER_POS)
+		this->m_cardpkts[userinfo->m_gamepos].cardcounts = count.quantity;
+	userinfo->m_acecount = count.aces;
+	userinfo->m_royalcount = count.royal;
+	userinfo->m_quadracount = count.quadra;
 
-	for (_iter = this->m_usercardinfo[_pos].down.begin(); _iter != this->m_usercardinfo[_pos].down.end(); _iter++) {
-		std::vector <_PMSG_CARD_INFO> _down = *_iter;
 
-		if (_down.size() == 0)
-			continue;
-
-		int typecounter = 0;
-		int numcounter = 0;
-		_PMSG_CARD_INFO rc = _down.front();
-
-		for (__iter = _down.begin(); __iter != _down.end(); __iter++) {
-
-			_PMSG_CARD_INFO c = *__iter;
+	GAMELOG(DEBUG, "countusercards, %s (%s) cards count %d quantity %d quadra %d royal %d ace %d.",
+		userinfo->name.c_str(), userinfo->account.c_str(), userinfo->m_cardcount, userinfo->m_cardquantity, userinfo->m_quadracount, userinfo->m_royalcount, userinfo->m_acecount);
 
-			if (c.cardnum == 1) {
-				guser.getuser(userindex)->m_acecount += 1;
-			}
-		}
+	if (userinfo->m_cardcount == 0) {
+		this->m_winner = userindex;
 	}
-	
-
-	this->msglog(DEBUG, "countusercards, get royal, quadra and ace count from group.");
-
-	for (_iter = this->m_usercardinfo[_pos].group.begin(); _iter != this->m_usercardinfo[_pos].group.end(); _iter++) {
-		std::vector <_PMSG_CARD_INFO> _group = *_iter;
-
-		if (_group.size() == 0)
-			continue;
-
-		int typecounter = 0;
-		int numcounter = 0;
-		_PMSG_CARD_INFO rc = _group.front();
-
-		guser.getuser(userindex)->m_cardquantity += _group.size();
-
-		for (__iter = _group.begin(); __iter != _group.end(); __iter++) {
-
-			_PMSG_CARD_INFO c = *__iter;
-
-			if (c.cardnum == 1) {
-				guser.getuser(userindex)->m_acecount += 1;
-			}
-			if (rc.cardtype == c.cardtype)
-				typecounter++;
-			if (rc.cardnum == c.cardnum)
-				numcounter++;
+	else {
+		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT) {
+			userinfo->canfight = (this->*this->rules()->isdown)(userinfo);
+			this->sendfightmode(userindex, userinfo->canfight ? 1 : 0);
 		}
-
-		userinfo->m_royalcount = typecounter / 5;
-		userinfo->m_quadracount = numcounter / 4;
 	}
+}
 
+int  game::countstockcards()
+{
+	return (int)this->vStockCards.size() - this->m_stocktop;
+}
 
-	this->msglog(DEBUG, "countusercards, get ace count from user cards");
-
-	guser.getuser(userindex)->m_cardquantity += this->m_usercardinfo[_pos].user.size();
-
-	for (__iter = this->m_usercardinfo[_pos].user.begin(); __iter != this->m_usercardinfo[_pos].user.end(); __iter++) {
-
-		_PMSG_CARD_INFO c = *__iter;
-
-		if (c.cardnum == 1) {
-			guser.getuser(userindex)->m_acecount += 1;
-		}
+void game::countmeld(_USER_CARD_COUNT& count, const _MELD& v, bool isgroup, int sign)
+{
+	if (v.count == 0)
+		return;
 
-		userinfo->m_cardcount += (c.cardnum > 10) ? 10 : c.cardnum;
+	int typecounter = 0;
+	int numcounter = 0;
+	_PMSG_CARD_INFO rc = v.items[0];
 
+	for (int n = 0; n < v.count; n++) {
+		if (v.items[n].cardnum == 1)
+			count.aces += sign;
+		if (rc.cardtype == v.items[n].cardtype)
+			typecounter++;
+		if (rc.cardnum == v.items[n].cardnum)
+			numcounter++;
 	}
 
-
-	this->msglog(DEBUG, "countusercards, %s (%s) cards count %d quantity %d quadra %d royal %d ace %d.",
-		userinfo->name.c_str(), userinfo->account.c_str(), userinfo->m_cardcount, userinfo->m_cardquantity, userinfo->m_quadracount, userinfo->m_royalcount, userinfo->m_acecount);
-
-	if (userinfo->m_cardcount == 0) {
-		this->m_winner = userindex;
-	}
-	else {
-		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT && userinfo->m_isdowncard == true) {
-			userinfo->canfight = true;
-			this->sendfightmode(userindex, 1);
-		}
-		else if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT && userinfo->m_isdowncard == false &&
-			(userinfo->m_quadracount > 0 || userinfo->m_royalcount > 0)) {
-			userinfo->canfight = true;
-			this->sendfightmode(userindex, 1);
-		}
-		else if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT && userinfo->m_isdowncard == false &&
-			userinfo->m_quadracount == 0 && userinfo->m_royalcount == 0)
-		{
-			userinfo->canfight = false;
-			this->sendfightmode(userindex, 0);
-		}
+	// only groups score royal and quadra
+	if (isgroup) {
+		count.quantity += sign * v.count;
+		count.royal += sign * (typecounter / 5);
+		count.quadra += sign * (numcounter / 4);
 	}
 }
 
-int  game::countstockcards()
+// full recount, checks the running counters in debug builds
+void game::recountusercards(unsigned char gamepos, _USER_CARD_COUNT& count)
 {
-	std::vector<_PMSG_CARD_INFO>::iterator _iterstock;
-	int n = 0;
-	for (_iterstock = this->vStockCards.begin(); _iterstock != this->vStockCards.end(); _iterstock++) {
-		_PMSG_CARD_INFO c = *_iterstock;
-		if (c.cardtype == 0) {
-			continue;
-		}
-		n++;
-	}
-	return n;
+	_MELD_LIST::iterator iter;
+	_CARD_MASK hand = this->m_usercardinfo[gamepos].mask;
+
+	memset(&count, 0, sizeof(_USER_CARD_COUNT));
+
+	for (iter = this->m_usercardinfo[gamepos].down.begin(); iter != this->m_usercardinfo[gamepos].down.end(); iter++)
+		this->countmeld(count, *iter, false, 1);
+
+	for (iter = this->m_usercardinfo[gamepos].group.begin(); iter != this->m_usercardinfo[gamepos].group.end(); iter++)
+		this->countmeld(count, *iter, true, 1);
+
+	count.points = cardpoints(hand);
+	count.quantity += cardpopcount(hand);
+	count.aces += cardpopcount(hand & CARD_RANK_MASK(1));
 }
 
-int game::adddowncards(uintptr_t userindex, std::vector <_PMSG_CARD_INFO> v, bool isgroup)
+int game::adddowncards(uintptr_t userindex, const _MELD& v, bool isgroup)
 {
 	unsigned char _pos = guser.getuser(userindex)->m_gamepos;
+	this->countmeld(this->m_usercardinfo[_pos].count, v, isgroup, 1);
 	if (isgroup) {
 		this->m_usercardinfo[_pos].group.push_back(v);
 		return this->m_usercardinfo[_pos].group.size() - 1;
@@ -585,7 +893,7 @@ bool game::getcardfromusercards(uintptr_t userindex, unsigned char pos, unsigned
 	if (pos >= this->m_usercardinfo[_pos].user.size())
 		return false;
 
-	std::vector <_PMSG_CARD_INFO>::iterator iter;
+	_CARD_PILE::iterator iter;
 	int n = 0;
 	for (iter = this->m_usercardinfo[_pos].user.begin(); iter != this->m_usercardinfo[_pos].user.end(); iter++) {
 		if (n == pos) {
@@ -606,16 +914,30 @@ bool game::addtousercards(uintptr_t userindex, unsigned char* card)
 	_PMSG_CARD_INFO cardinfo;
 	cardinfo.cardtype = card[0];
 	cardinfo.cardnum = card[1];
-	this->m_usercardinfo[_pos].user.push_back(cardinfo);
+	this->pushusercard(_pos, cardinfo);
 	return true;
 }
 
+void game::pushusercard(unsigned char gamepos, _PMSG_CARD_INFO card)
+{
+	_USER_CARD_INFO& info = this->m_usercardinfo[gamepos];
+
+	if (!info.user.push_back(card))
+		return;
+
+	info.mask |= cardmask(card.cardtype, card.cardnum);
+	info.count.points += (card.cardnum > 10) ? 10 : card.cardnum;
+	info.count.quantity++;
+	if (card.cardnum == 1)
+		info.count.aces++;
+}
+
 bool game::chooserandomcard(uintptr_t userindex, unsigned char* rcard)
 {
 	unsigned char _pos = guser.getuser(userindex)->m_gamepos;
 
-	std::vector <_PMSG_CARD_INFO> _vcards;
-	std::vector <_PMSG_CARD_INFO>::iterator _iter;
+	_CARD_PILE _vcards;
+	_CARD_PILE::iterator _iter;
 
 	for (_iter = this->m_usercardinfo[_pos].user.begin(); _iter != this->m_usercardinfo[_pos].user.end(); _iter++) {
 		_PMSG_CARD_INFO c = *_iter;
@@ -627,7 +949,7 @@ bool game::chooserandomcard(uintptr_t userindex, unsigned char* rcard)
 	if (_vcards.size() == 0)
 		return false;
 
-	unsigned char rpos = rand() % _vcards.size(); // choose random card
+	unsigned char rpos = this->m_rng.bounded((uint32_t)_vcards.size()); // choose random card
 
 	rcard[0] = _vcards[rpos].cardtype;
 	rcard[1] = _vcards[rpos].cardnum;
@@ -643,11 +965,21 @@ bool game::removefromusercards(uintptr_t userindex, unsigned char* pos, bool isf
 	if (pos == NULL)
 		return false;
 
-	std::vector <_PMSG_CARD_INFO>::iterator _iter;
+	_CARD_MASK m = cardmask(pos[0], pos[1]);
+
+	if ((this->m_usercardinfo[_pos].mask & m) == 0)
+		return false;
+
+	_CARD_PILE::iterator _iter;
 	for (_iter = this->m_usercardinfo[_pos].user.begin(); _iter != this->m_usercardinfo[_pos].user.end(); _iter++) {
 		_usercard = *_iter;
 		if (_usercard.cardtype == pos[0] && _usercard.cardnum == pos[1]) {
 			this->m_usercardinfo[_pos].user.erase(_iter);
+			this->m_usercardinfo[_pos].mask &= ~m;
+			this->m_usercardinfo[_pos].count.points -= (pos[1] > 10) ? 10 : pos[1];
+			this->m_usercardinfo[_pos].count.quantity--;
+			if (pos[1] == 1)
+				this->m_usercardinfo[_pos].count.aces--;
 			return true;
 		}
 	}
@@ -659,7 +991,7 @@ bool game::removefromdropped(unsigned userpos, unsigned char* pos)
 {
 	if (pos == NULL)
 		return false;
-	std::vector<_DROPCARD_INFO>::iterator _iterdropped;
+	_DROP_PILE::iterator _iterdropped;
 	for (_iterdropped = this->vDroppedCards.begin(); _iterdropped != this->vDroppedCards.end(); _iterdropped++) {
 		_DROPCARD_INFO dropinfo = *_iterdropped;
 		if (dropinfo.userpos == userpos && dropinfo.card.cardtype == pos[0] && dropinfo.card.cardnum == pos[1]) {
@@ -677,27 +1009,14 @@ bool game::drawfromstock(uintptr_t userindex)
 		return false;
 
 	_PMSG_CARD_INFO card = { 0 };
-	int n = 0, ctr = 0;
 
-	std::vector<_PMSG_CARD_INFO>::iterator _iterstock;
-
-	for (_iterstock = this->vStockCards.begin(); _iterstock != this->vStockCards.end(); _iterstock++) {
-		if (n == 0) {
-			card = *_iterstock;
-			if (card.cardtype == 0) {
-				ctr++;
-				continue;
-			}
-			this->vStockCards[ctr].cardtype = 0;
-			break;
-		}
-		ctr++;
-		n++;
-	}
+	// cards below the cursor are dealt or drawn
+	if (this->m_stocktop < (int)this->vStockCards.size())
+		card = this->vStockCards[this->m_stocktop++];
 
 
 	if (card.cardtype == 0) {
-		this->msglog(DEBUG, "removefromstock,  card.cardtype == 0.");
+		GAMELOG(DEBUG, "removefromstock,  card.cardtype == 0.");
 		return false;
 	}
 
@@ -706,7 +1025,8 @@ bool game::drawfromstock(uintptr_t userindex)
 
 	unsigned char _pos = guser.getuser(userindex)->m_gamepos;
 
-	this->m_usercardinfo[_pos].user.push_back(card);
+	this->pushusercard(_pos, card);
+	this->logevent(_pos, (int)_ACTIONS::_DRAW, (unsigned char*)&card, 0, NULL);
 
 	this->m_usercardinfo[_pos].lastdrawcard.cardtype = card.cardtype;
 	this->m_usercardinfo[_pos].lastdrawcard.cardnum = card.cardnum;
@@ -721,7 +1041,7 @@ bool game::drawfromstock(uintptr_t userindex)
 	pMsg.userpos = guser.getuser(userindex)->m_gamepos;
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
-		if (userindex == this->m_users[i]) {
+		if (userindex == (uintptr_t)this->m_users[i]) {
 			pMsg.cardtype = card.cardtype;
 			pMsg.cardnum = card.cardnum;
 			this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
@@ -733,26 +1053,30 @@ bool game::drawfromstock(uintptr_t userindex)
 		}
 	}
 
+	pMsg.cardtype = 0;
+	pMsg.cardnum = 0;
+	this->spectate((unsigned char*)&pMsg, pMsg.hdr.len);
+
 	if (this->countstockcards() == 0) {
 		this->m_active_status |= (int)_ACTIVE_STATE::_STOCKZERO;
-		this->msglog(DEBUG, "%s (%s), Flag active status _STOCKZERO.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
-		this->sendtimeoutleft(MAX_MSECONDS_GROUPCARD_TIMEOUT);
-		this->m_gametick = GetTickCount64() + MAX_MSECONDS_GROUPCARD_TIMEOUT;
-		this->sendnotice(0, 0, "You have %d sec. to group your cards, ungrouped cards will be counted.", MAX_MSECONDS_GROUPCARD_TIMEOUT / 1000);
+		GAMELOG(DEBUG, "%s (%s), Flag active status _STOCKZERO.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
+		this->sendtimeoutleft(this->m_timeouts[this->m_ectype].groupcard);
+		this->m_gametick = clockmsec() + this->m_timeouts[this->m_ectype].groupcard;
+		this->sendnotice(0, 0, _NOTICE_ID::_GROUPTIME, this->m_timeouts[this->m_ectype].groupcard / 1000);
 	}
 
-	this->m_active_status |= (int)_ACTIVE_STATE::_DRAWN;
-	this->msglog(DEBUG, "%s (%s), Flag active status _DRAWN.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
+	this->m_active_status = actionentry(this->m_active_status, _ACTIONS::_DRAW).next;
+	GAMELOG(DEBUG, "%s (%s), Flag active status _DRAWN.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
 
 	// check sagasa
 	/*
-	std::vector<std::vector <_PMSG_CARD_INFO>>::iterator iter;
+	_MELD_LIST::iterator iter;
 	n = 0;
 	for (iter = this->m_usercardinfo[_pos].down.begin(); iter != this->m_usercardinfo[_pos].down.end(); iter++) {
-		std::vector <_PMSG_CARD_INFO> v = *iter;
+		_MELD v = *iter;
 		if (v[0].cardnum == card.cardnum) {
 			if (this->sapawcard(userindex, _pos, n, 1, (unsigned char*)&card, false, true)) {
-				this->msglog(INFO, "drawfromstock, %s sagasa, card %d %d", guser.getuser(userindex)->name.c_str(), card.cardtype, card.cardnum);
+				GAMELOG(INFO, "drawfromstock, %s sagasa, card %d %d", guser.getuser(userindex)->name.c_str(), card.cardtype, card.cardnum);
 				return true;
 			}
 		}
@@ -762,226 +1086,233 @@ bool game::drawfromstock(uintptr_t userindex)
 	return true;
 }
 
-bool game::isactionvalid(uintptr_t userindex, _ACTIONS action)
+// the status tests of isactionvalid as they read before gactiontable, the table has to give the same answer
+// to every action in every status. before is what rejects ahead of the tests of the player, after what rejects
+// once they passed
+static constexpr _ACTION_REASON actionreference(int status, _ACTIONS action, bool after)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
-
-	if (this->getstate() != _GAME_STATE::_STARTED) {
-		this->msglog(DEBUG, "user %llu requested an action but game is not started.", userindex);
-		return false;
-	}
-
-	if (userinfo->isauto == false && GetTickCount64() < userinfo->lastactiontick) {
-		this->msglog(DEBUG, "user %llu requested an action but still under time restriction.", userindex);
-		return false;
-	}
-
 	switch (action) {
 	case _ACTIONS::_DRAW:
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT || 
-			this->m_active_status & (int)_ACTIVE_STATE::_STOCKZERO) // no message needed
-			return false;
-
-		if (userindex != this->m_active_userindex) {
-			this->sendnotice(userindex, 7, "It's not your turn yet!");
-			this->msglog(DEBUG, "user %llu requested to draw card but current active is user %llu.", userindex, this->m_active_userindex);
-			return false;
-		}
-
-		if (this->countstockcards() == 0) {
-			this->msglog(DEBUG, "user %llu requested to draw card but current card count is zero.", userindex);
-			return false;
-		}
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_DROPPED || this->m_active_status & (int)_ACTIVE_STATE::_DRAWN
-			|| this->m_active_status & (int)_ACTIVE_STATE::_CHOWED/* || this->m_active_status == _ACTIVE_STATE::_DOWNED*/
-			|| this->m_active_status & (int)_ACTIVE_STATE::_STOCKZERO || this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT
-			) {
-			this->msglog(DEBUG, "user %llu requested to draw card but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-
-		break;
+		if (!after)
+			return (status & (int)_ACTIVE_STATE::_FOUGHT || status & (int)_ACTIVE_STATE::_STOCKZERO) ? _ACTION_REASON::_QUIET : _ACTION_REASON::_OK;
+		return (status & (int)_ACTIVE_STATE::_DROPPED || status & (int)_ACTIVE_STATE::_DRAWN || status & (int)_ACTIVE_STATE::_CHOWED ||
+			status & (int)_ACTIVE_STATE::_STOCKZERO || status & (int)_ACTIVE_STATE::_FOUGHT) ? _ACTION_REASON::_STATUS : _ACTION_REASON::_OK;
 	case _ACTIONS::_CHOW:
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT ||
-			this->m_active_status & (int)_ACTIVE_STATE::_STOCKZERO) // no message needed
-			return false;
-
-		if (userindex != this->m_active_userindex) {
-			this->sendnotice(userindex, 7, "It's not your turn yet!");
-			this->msglog(DEBUG, "user %llu requested to chow card but current active is user %llu.", userindex, this->m_active_userindex);
-			return false;
-		}
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_DROPPED ||
-			this->m_active_status & (int)_ACTIVE_STATE::_DRAWN ||
-			this->m_active_status & (int)_ACTIVE_STATE::_CHOWED ||
-			this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT ||
-			this->m_active_status & (int)_ACTIVE_STATE::_DOWNED) {
-			this->msglog(DEBUG, "user %llu requested to chow card but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-
-		break;
-
+		if (!after)
+			return (status & (int)_ACTIVE_STATE::_FOUGHT || status & (int)_ACTIVE_STATE::_STOCKZERO) ? _ACTION_REASON::_QUIET : _ACTION_REASON::_OK;
+		return (status & (int)_ACTIVE_STATE::_DROPPED || status & (int)_ACTIVE_STATE::_DRAWN || status & (int)_ACTIVE_STATE::_CHOWED ||
+			status & (int)_ACTIVE_STATE::_FOUGHT || status & (int)_ACTIVE_STATE::_DOWNED) ? _ACTION_REASON::_STATUS : _ACTION_REASON::_OK;
 	case _ACTIONS::_DOWN:
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT) // no message needed
-			return false;
-
-		if (userindex != this->m_active_userindex) {
-			this->sendnotice(userindex, 7, "It's not your turn yet!");
-			this->msglog(DEBUG, "user %llu requested to chow card but current active is user %llu.", userindex, this->m_active_userindex);
-			return false;
-		}
-
-		if (userinfo->m_isdowncard == true) {
-			this->msglog(DEBUG, "user %llu requested to down cards but the user already have a down.", userindex);
-			return false;
-		}
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_CHOWED ||
-			this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT ||
-			this->m_active_status & (int)_ACTIVE_STATE::_DOWNED) {
-			this->msglog(DEBUG, "user %llu requested to down cards but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-
-		break;
-
+		if (!after)
+			return (status & (int)_ACTIVE_STATE::_FOUGHT) ? _ACTION_REASON::_QUIET : _ACTION_REASON::_OK;
+		return (status & (int)_ACTIVE_STATE::_CHOWED || status & (int)_ACTIVE_STATE::_FOUGHT || status & (int)_ACTIVE_STATE::_DOWNED) ?
+			_ACTION_REASON::_STATUS : _ACTION_REASON::_OK;
 	case _ACTIONS::_GROUP:
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_RESET) {
-			this->msglog(DEBUG, "user %llu requested to group cards but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-
-		break;
-
 	case _ACTIONS::_UNGROUP:
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_RESET) {
-			this->msglog(DEBUG, "user %llu requested to ungroup cards but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-
-		break;
-
+		if (!after)
+			return _ACTION_REASON::_OK;
+		return (status & (int)_ACTIVE_STATE::_RESET) ? _ACTION_REASON::_STATUS : _ACTION_REASON::_OK;
 	case _ACTIONS::_DROP:
-
-		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT) // no message needed
-			return false;
-
-		if (userindex != this->m_active_userindex) {
-			this->sendnotice(userindex, 7, "It's not your turn yet!");
-			this->msglog(DEBUG, "user %llu requested to drop card but current active is user %llu.", userindex, this->m_active_userindex);
-			return false;
-		}
-
-		if (!(this->m_active_status & (int)_ACTIVE_STATE::_DRAWN) && !(this->m_active_status & (int)_ACTIVE_STATE::_CHOWED))
-		{
-			this->sendnotice(userindex, 7, "You have'nt drawn nor chow card(s) yet!");
-			this->msglog(DEBUG, "user %llu requested to drop card but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-
-		if (this->m_active_status == (int)_ACTIVE_STATE::_NONE || 
-			this->m_active_status & (int)_ACTIVE_STATE::_DROPPED ||
-			this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT) {
-			this->msglog(DEBUG, "user %llu requested to drop card but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-
-		break;
+		if (!after)
+			return (status & (int)_ACTIVE_STATE::_FOUGHT) ? _ACTION_REASON::_QUIET : _ACTION_REASON::_OK;
+		if (!(status & (int)_ACTIVE_STATE::_DRAWN) && !(status & (int)_ACTIVE_STATE::_CHOWED))
+			return _ACTION_REASON::_NOTDRAWN;
+		return (status == (int)_ACTIVE_STATE::_NONE || status & (int)_ACTIVE_STATE::_DROPPED || status & (int)_ACTIVE_STATE::_FOUGHT) ?
+			_ACTION_REASON::_STATUS : _ACTION_REASON::_OK;
 	case _ACTIONS::_FIGHT:
+		if (!after)
+			return (status & (int)_ACTIVE_STATE::_FOUGHT || status & (int)_ACTIVE_STATE::_STOCKZERO) ? _ACTION_REASON::_QUIET : _ACTION_REASON::_OK;
+		return (status != (int)_ACTIVE_STATE::_NONE || status & (int)_ACTIVE_STATE::_FOUGHT) ? _ACTION_REASON::_STATUS : _ACTION_REASON::_OK;
+	case _ACTIONS::_FIGHT2:
+		if (!after)
+			return (status & (int)_ACTIVE_STATE::_STOCKZERO) ? _ACTION_REASON::_QUIET : _ACTION_REASON::_OK;
+		return !(status & (int)_ACTIVE_STATE::_FOUGHT) ? _ACTION_REASON::_STATUS : _ACTION_REASON::_OK;
+	case _ACTIONS::_SAPAW:
+		if (!after)
+			return (status & (int)_ACTIVE_STATE::_FOUGHT) ? _ACTION_REASON::_QUIET : _ACTION_REASON::_OK;
+		return (status & (int)_ACTIVE_STATE::_DROPPED || status & (int)_ACTIVE_STATE::_FOUGHT) ? _ACTION_REASON::_STATUS : _ACTION_REASON::_OK;
+	default:
+		return _ACTION_REASON::_OK;
+	}
+}
 
-		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT ||
-			this->m_active_status & (int)_ACTIVE_STATE::_STOCKZERO) // no message needed
-			return false;
+static constexpr bool actiontablecheck()
+{
+	const _ACTIONS actions[ACTION_KINDS] = { _ACTIONS::_NONE, _ACTIONS::_DRAW, _ACTIONS::_CHOW, _ACTIONS::_DOWN, _ACTIONS::_DROP,
+		_ACTIONS::_SAPAW, _ACTIONS::_FIGHT, _ACTIONS::_FIGHT2, _ACTIONS::_GROUP, _ACTIONS::_UNGROUP };
 
-		if (userindex != this->m_active_userindex) {
-			this->sendnotice(userindex, 7, "It's not your turn yet!");
-			this->msglog(DEBUG, "user %llu requested to fight but current active is user %llu.", userindex, this->m_active_userindex);
+	for (int kind = 0; kind < ACTION_KINDS; kind++) {
+		if (actionindex(actions[kind]) != kind)
 			return false;
+		for (int status = 0; status < ACTIVE_STATES; status++) {
+			const _ACTION_ENTRY& entry = gactiontable.entries[kind][status];
+			if (entry.before != actionreference(status, actions[kind], false) || entry.after != actionreference(status, actions[kind], true))
+				return false;
 		}
+	}
+	return true;
+}
 
-		if (userinfo->m_isdowncard == false) {
-			this->sendnotice(userindex, 7, "You don't have a house yet!");
-			this->msglog(DEBUG, "user %llu requested to fight cards but the user has no down.", userindex);
-			return false;
-		}
+static_assert(actiontablecheck(), "gactiontable differs from the status tests of isactionvalid");
 
-		if (userinfo->canfight == false) {
-			this->msglog(DEBUG, "user %llu requested to fight cards but the user can't fight at this moment.", userindex);
-			return false;
-		}
+static const char actionnames[ACTION_KINDS][8] = {
+	"nothing", "draw", "chow", "down", "drop", "sapaw", "fight", "fight2", "group", "ungroup"
+};
 
-		if (userinfo->fought == true) {
-			this->sendnotice(userindex, 7, "You already fought!");
-			return false;
-		}
+static const char* const reasontexts[(int)_ACTION_REASON::_MAX] = {
+	"",
+	"",
+	"it is not the turn of the user",
+	"the stock is empty",
+	"the user already has a down",
+	"the user has no down",
+	"the user has no down/quadra/royal",
+	"the user can't fight now",
+	"the user already fought",
+	"the user has not drawn",
+	"of the active status",
+	"it came too soon",
+	"it is not valid"
+};
 
-		if (this->m_active_status != (int)_ACTIVE_STATE::_NONE) {
-			this->msglog(DEBUG, "user %llu requested to fight but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
+// the notice a player gets with the rejection, _NONE for only a log line
+static const _NOTICE_ID reasonnotices[(int)_ACTION_REASON::_MAX] = {
+	_NOTICE_ID::_NONE,
+	_NOTICE_ID::_NONE,
+	_NOTICE_ID::_NOTTURN,
+	_NOTICE_ID::_NONE,
+	_NOTICE_ID::_NONE,
+	_NOTICE_ID::_NOHOUSE,
+	_NOTICE_ID::_NOFIGHT,
+	_NOTICE_ID::_NONE,
+	_NOTICE_ID::_FOUGHT,
+	_NOTICE_ID::_NOTDRAWN,
+	_NOTICE_ID::_NONE,
+	_NOTICE_ID::_NONE,
+	_NOTICE_ID::_NONE
+};
 
-		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT) {
-			this->msglog(DEBUG, "user %llu requested to fight but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-		break;
+// the answer of the status and of the tests of the player, nothing is noted or sent
+_ACTION_REASON game::actionreason(_USER_INFO* userinfo, uintptr_t userindex, _ACTIONS action)
+{
+	const _ACTION_ENTRY& entry = actionentry(this->m_active_status, action);
+
+	if (entry.before == _ACTION_REASON::_QUIET)
+		return entry.before;
+
+	int checks = gactionrules[actionindex(action)].checks;
+
+	if ((checks & ACTION_CHECK_TURN) && userindex != (uintptr_t)this->m_active_userindex)
+		return _ACTION_REASON::_NOTTURN;
+	if ((checks & ACTION_CHECK_STOCK) && this->countstockcards() == 0)
+		return _ACTION_REASON::_NOSTOCK;
+	if ((checks & ACTION_CHECK_NODOWN) && userinfo->m_isdowncard)
+		return _ACTION_REASON::_HASDOWN;
+	if ((checks & ACTION_CHECK_DOWN) && !userinfo->m_isdowncard)
+		return _ACTION_REASON::_NOHOUSE;
+	if ((checks & ACTION_CHECK_HOUSEDOWN) && !(this->*this->rules()->isdown)(userinfo))
+		return _ACTION_REASON::_NOFIGHT;	// royal or quadra in the hand count where the house rules say so
+	if ((checks & ACTION_CHECK_CANFIGHT) && !userinfo->canfight)
+		return _ACTION_REASON::_CANTFIGHT;
+	if ((checks & ACTION_CHECK_NOTFOUGHT) && userinfo->fought)
+		return _ACTION_REASON::_FOUGHT;
+	return entry.after;
+}
 
-	case _ACTIONS::_FIGHT2:
+// the actions the table would take from the active seat now, worked out on the card masks so its app
+// offers only those instead of finding out a round trip later. a chow needs the last drop of the seat
+// before to make a meld with the hand, a down a meld in the hand and a sapaw a down one card of the hand
+// extends, a run takes more only when the card next to it fits too
+void game::sendactionmask(uintptr_t userindex)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
 
-		if (this->m_active_status & (int)_ACTIVE_STATE::_STOCKZERO) // no message needed
-			return false;
+	if (userinfo == NULL || !userinfo->isactionmask || !userinfo->isplaying() || this->getstate() != _GAME_STATE::_STARTED)
+		return;
 
+	int pos = userinfo->m_gamepos;
+	_CARD_MASK hand = this->m_usercardinfo[pos].mask;
+	_PMSG_ACTION_MASK pMsg = pkttemplate<_PMSG_ACTION_MASK>(0xF3, 0x0A);
 
-		if (userinfo->m_isdowncard == false) {
-			// check if user has royal or quadra to allow
-			if (userinfo->m_quadracount == 0 && userinfo->m_royalcount == 0) {
-				this->sendnotice(userindex, 7, "You don't have a house nor quadra nor royal!");
-				this->msglog(DEBUG, "user %llu requested to fight2 cards but the user has no down/quadra/royal.", userindex);
-				return false;
-			}
-		}
+	for (int kind = 1; kind < ACTION_KINDS; kind++) {
+		_ACTIONS action = (_ACTIONS)(1 << (kind - 1));
+		if (this->actionreason(userinfo, userindex, action) == _ACTION_REASON::_OK)
+			pMsg.actions |= (unsigned int)action;
+	}
 
-		if (userinfo->fought == true) {
-			this->sendnotice(userindex, 7, "You already fought!");
-			return false;
+	unsigned char droppos = (pos == 0) ? 2 : pos - 1;
+	if ((pMsg.actions & (unsigned int)_ACTIONS::_CHOW) && !this->vDroppedCards.empty() && this->vDroppedCards.back().userpos == droppos) {
+		_PMSG_CARD_INFO drop = this->vDroppedCards.back().card;
+		if (botchowmeld(hand, cardmask(drop.cardtype, drop.cardnum)) != 0) {
+			pMsg.chowtype = drop.cardtype;
+			pMsg.chownum = drop.cardnum;
 		}
+	}
+	if (pMsg.chowtype == 0)
+		pMsg.actions &= ~(unsigned int)_ACTIONS::_CHOW;
 
-		if (!(this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT)) {
-			this->msglog(DEBUG, "user %llu requested to fight2 but current active status is %d.", userindex, this->m_active_status);
-			return false;
+	if ((pMsg.actions & (unsigned int)_ACTIONS::_DOWN) && botbestmeld(hand) == 0)
+		pMsg.actions &= ~(unsigned int)_ACTIONS::_DOWN;
+
+	if (pMsg.actions & (unsigned int)_ACTIONS::_SAPAW) {
+		for (int userpos = 0; userpos < MAX_USER_POS; userpos++) {
+			_MELD_LIST& down = this->m_usercardinfo[userpos].down;
+			for (int downpos = 0; downpos < (int)down.size() && downpos < ACTION_MASK_DOWNS; downpos++) {
+				_CARD_MASK downmask = this->getselectmask(down[downpos].count, (unsigned char*)down[downpos].items);
+				for (_CARD_MASK m = hand; m != 0; m &= m - 1) {
+					if (cardismeld(downmask | (m & (0 - m)))) {
+						pMsg.sapawdowns |= 1u << (userpos * ACTION_MASK_DOWNS + downpos);
+						break;
+					}
+				}
+			}
 		}
+		if (pMsg.sapawdowns == 0)
+			pMsg.actions &= ~(unsigned int)_ACTIONS::_SAPAW;
+	}
 
-		break;
+	this->datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
 
-	case _ACTIONS::_SAPAW:
+bool game::isactionvalid(uintptr_t userindex, _ACTIONS action)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
 
-		if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT)
-			return false;
+	if (this->getstate() != _GAME_STATE::_STARTED) {
+		GAMELOG(DEBUG, "user %llu requested an action but game is not started.", userindex);
+		return false;
+	}
 
-		if (userindex != this->m_active_userindex) {
-			this->sendnotice(userindex, 7, "It's not your turn yet!");
-			this->msglog(DEBUG, "user %llu requested to sapaw card but current active is user %llu.", userindex, this->m_active_userindex);
+	// a pipelined turn arrives at once, its actions share the window of the first up to ACTION_PIPELINE_BURST
+	if (userinfo->isauto == false && userinfo->isbot == false && clockmsec() < userinfo->lastactiontick) {
+		if (!userinfo->ispipelined || userinfo->reqburst >= ACTION_PIPELINE_BURST) {
+			GAMELOG(DEBUG, "user %llu requested an action but still under time restriction.", userindex);
+			userinfo->reqreason = (unsigned char)_ACTION_REASON::_TOOSOON;
 			return false;
 		}
+		userinfo->reqburst++;
+	}
+	else {
+		userinfo->reqburst = 0;
+	}
 
-		if (this->m_active_status & (int)_ACTIVE_STATE::_DROPPED ||
-			this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT
-			) {
-			this->msglog(DEBUG, "user %llu requested to sapaw card but current active status is %d.", userindex, this->m_active_status);
-			return false;
-		}
-		break;
+	int kind = actionindex(action);
+	_ACTION_REASON reason = this->actionreason(userinfo, userindex, action);
+
+	if (reason == _ACTION_REASON::_QUIET) {
+		userinfo->reqreason = (unsigned char)reason;
+		return false;
+	}
+
+	if (reason != _ACTION_REASON::_OK) {
+		userinfo->reqreason = (unsigned char)reason;
+		if (reasonnotices[(int)reason] != _NOTICE_ID::_NONE)
+			this->sendnotice(userindex, 7, reasonnotices[(int)reason]);
+		GAMELOG(DEBUG, "user %llu requested to %s but %s, active status %d.", userindex, actionnames[kind], reasontexts[(int)reason], this->m_active_status);
+		return false;
 	}
 
-	userinfo->lastactiontick = GetTickCount64() + 500;
+	userinfo->lastactiontick = clockmsec() + 500;
 
 	return true;
 }
@@ -1004,17 +1335,17 @@ bool game::trysapawcard(uintptr_t userindex, unsigned char* cardpos)
 bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, unsigned char count, unsigned char* cardpos, bool test, bool skipactioncheck)
 {
 	if (cardpos == NULL || count == 0) {
-		this->msglog(DEBUG, "sapawcard, count/selected card(s) is NULL.");
+		GAMELOG(DEBUG, "sapawcard, count/selected card(s) is NULL.");
 		return false;
 	}
 
 	if (count >= MAX_CARDS_PER_TYPE) {
-		this->msglog(DEBUG, "sapawcard, count %d of selected cards exceeded the limit.", count);
+		GAMELOG(DEBUG, "sapawcard, count %d of selected cards exceeded the limit.", count);
 		return false;
 	}
 
 	if (userpos >= 3) {
-		this->msglog(DEBUG, "sapawcard, userpos is out of bound.", userpos);
+		GAMELOG(DEBUG, "sapawcard, userpos is out of bound.", userpos);
 		return false;
 	}
 
@@ -1022,13 +1353,13 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 		return false;
 
 	if (downpos >= this->m_usercardinfo[userpos].down.size()) {
-		this->msglog(DEBUG, "sapawcard, downpos %d >= this->mUserDownCards.size().", downpos);
+		GAMELOG(DEBUG, "sapawcard, downpos %d >= this->mUserDownCards.size().", downpos);
 		return false;
 	}
 
-	std::vector <_PMSG_CARD_INFO> _down = this->m_usercardinfo[userpos].down[downpos];
+	_MELD _down = this->m_usercardinfo[userpos].down[downpos];
 
-	this->msglog(DEBUG, "sapawcard, userpos %d pos %d cards %d.", userpos, downpos, _down.size());
+	GAMELOG(DEBUG, "sapawcard, userpos %d pos %d cards %d.", userpos, downpos, _down.size());
 
 	if (_down.size() == 0) {
 		return false;
@@ -1044,69 +1375,49 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 		_cardinfo[0] = _card->cardtype;
 		_cardinfo[1] = _card->cardnum;
 
-		this->msglog(DEBUG, "sapawcard, selected card %d/%d (%d) requserpos %d.", _card->cardtype, _card->cardnum, n, requserpos);
+		GAMELOG(DEBUG, "sapawcard, selected card %d/%d (%d) requserpos %d.", _card->cardtype, _card->cardnum, n, requserpos);
 
 		if (this->getposfromusercard(userindex, _cardinfo) == -1) {
-			this->msglog(DEBUG, "sapawcard failed, card %d/%d doest not exist in requserpos %d.", _card->cardtype, _card->cardnum, requserpos);
+			GAMELOG(DEBUG, "sapawcard failed, card %d/%d doest not exist in requserpos %d.", _card->cardtype, _card->cardnum, requserpos);
 			return false;
 		}
 	}
 
-	bool issamenumber = true;
-	bool issametype = true;
-
 	unsigned char c[2];
 
-	this->msglog(DEBUG, "sapawcard, get card to drop info...");
+	GAMELOG(DEBUG, "sapawcard, get card to drop info...");
 
 	_PMSG_CARD_INFO* _cardinfo = (_PMSG_CARD_INFO*)(cardpos);
 
 	c[0] = _cardinfo->cardtype;
 	c[1] = _cardinfo->cardnum;
 
-	this->msglog(DEBUG, "sapawcard, get card to drop info done, %d %d.", c[0], c[1]);
+	GAMELOG(DEBUG, "sapawcard, get card to drop info done, %d %d.", c[0], c[1]);
 
-	std::vector <_PMSG_CARD_INFO>::iterator _viter;
-
-	_viter = _down.begin();
-	_PMSG_CARD_INFO _c = *_viter;
-	_viter++;
-	for (; _viter != _down.end(); _viter++) {
-		_PMSG_CARD_INFO __c = *_viter;
-		if (_c.cardnum != __c.cardnum) {
-			issamenumber = false;
-			break;
-		}
-	}
+	_CARD_PILE::iterator _viter;
 
-	this->msglog(DEBUG, "sapawcard, issamenumber %d.", issamenumber);
+	_CARD_MASK selmask = this->getselectmask(count, cardpos);
+	_CARD_MASK downmask = 0;
 
+	for (_viter = _down.begin(); _viter != _down.end(); _viter++)
+		downmask |= cardmask(_viter->cardtype, _viter->cardnum);
 
-	_viter = _down.begin();
-	_viter++;
-	for (; _viter != _down.end(); _viter++) {
-		_PMSG_CARD_INFO __c = *_viter;
-		if (_c.cardtype != __c.cardtype) {
-			issametype = false;
-			break;
-		}
+	if (cardpopcount(selmask) != count || (selmask & downmask) != 0) {
+		GAMELOG(DEBUG, "sapawcard failed, selected cards are not distinct.");
+		return false;
 	}
 
-	this->msglog(DEBUG, "sapawcard, issametype %d.", issametype);
-
+	bool issamenumber = cardisset(downmask) && cardisset(downmask | selmask);
+	bool issametype = cardisrun(downmask | selmask);
 
-	if (issamenumber && count == 1) { // only possible to be formed is quadra with one selected card
-
-		this->msglog(DEBUG, "sapawcard, issamenumber...");
+	GAMELOG(DEBUG, "sapawcard, issamenumber %d.", issamenumber);
+	GAMELOG(DEBUG, "sapawcard, issametype %d.", issametype);
 
 
-		if (c[1] != _c.cardnum) {
+	if (issamenumber && count == 1) { // only possible to be formed is quadra with one selected card
 
-			this->msglog(DEBUG, "sapawcard, quadra failed bec. selected card num. %d differ with downcard card num. %d.",
-				c[1], _c.cardnum);
+		GAMELOG(DEBUG, "sapawcard, issamenumber...");
 
-			return false;
-		}
 
 		// quadra formed
 		if (test == true) {
@@ -1116,7 +1427,7 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 		// delete the card pointer from user list
 		if (!this->removefromusercards(userindex, c)) {
 
-			this->msglog(DEBUG, "sapawcard, removefromusercards failed with card %d %d.",
+			GAMELOG(DEBUG, "sapawcard, removefromusercards failed with card %d %d.",
 				c[0], c[1]);
 
 			return false;
@@ -1131,22 +1442,15 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 		_cardinfo.cardnum = cardinfo->cardnum;
 
 		this->m_usercardinfo[userpos].down[downpos].push_back(_cardinfo);
+		if (_cardinfo.cardnum == 1)
+			this->m_usercardinfo[userpos].count.aces++;
 
-		if (userpos == guser.getuser(userindex)->m_gamepos) {
+		if ((int)userpos == guser.getuser(userindex)->m_gamepos) {
 			if (this->m_active_status & (int)_ACTIVE_STATE::_DRAWN) {
 				if (this->m_usercardinfo[userpos].lastdrawcard.cardtype != 0 && 
 					this->m_usercardinfo[userpos].lastdrawcard.cardtype == cardinfo->cardtype &&
 					this->m_usercardinfo[userpos].lastdrawcard.cardnum == cardinfo->cardnum) {
-					this->sendnotice(0, 3, "%s Sagasa!", guser.getuser(userindex)->name.c_str());
-					this->msglog(INFO, "%s (%s) is sagasa.", guser.getuser(userindex)->name.c_str(), guser.getuser(userindex)->account.c_str());
-					for (int i = 0; i < 3; i++) {
-						if (userpos == i)
-							guser.getuser(this->m_users[i])->ecoins[this->m_ectype] += this->m_ecinfo[this->m_ectype].sagasaaddecoins * 2;
-						else
-							guser.getuser(this->m_users[i])->ecoins[this->m_ectype] -= this->m_ecinfo[this->m_ectype].sagasaaddecoins;
-						this->sendresult(this->m_users[i], 3);
-					}
-					this->senduserecoinsinfo();
+					(this->*this->rules()->paysagasa)(userindex, userpos);
 				}
 			}
 		}
@@ -1167,17 +1471,16 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 		memcpy(&buf[0], (unsigned char*)&pMsg, size);
 		memcpy(&buf[size], cardpos, sizeof(_PMSG_CARD_INFO));
 
-		for (int i = 0; i < MAX_USER_POS; i++) {
-			this->datasend(this->m_users[i], buf, pMsg.hdr.len);
-		}
+		this->broadcast(buf, pMsg.hdr.len);
 
 		// disable user's fight mode when the user's down cards has sapaw
 		_USER_INFO* _userinfo = guser.getuser(this->m_users[userpos]);
 		_userinfo->canfight = false;
-		if (this->m_users[userpos] == userindex)
+		if ((uintptr_t)this->m_users[userpos] == userindex)
 			_userinfo->isselfblock = true;
 		this->sendfightmode(this->m_users[userpos], 0);
 
+		this->logevent(requserpos, (int)_ACTIONS::_SAPAW, NULL, count, cardpos);
 		this->countusercards(userindex);
 		this->sendusercardcountsinfo(userindex);
 		this->getwinner();
@@ -1186,49 +1489,10 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 	}
 	else if (issametype) {
 
-		this->msglog(DEBUG, "sapawcard, issametype...");
-
-
-		std::vector <unsigned char> __v; // card number list
-
-		for (int n = 0; n < count; n += 1) {
-			_cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-			__v.push_back(_cardinfo->cardnum); // add sapaw cards in list
-
-			if (c[0] != _cardinfo->cardtype) { // recheck card type of sapaw cards
-				return false;
-			}
-		}
-
-		for (_viter = _down.begin(); _viter != _down.end(); _viter++) {
-
-			_PMSG_CARD_INFO __c = *_viter;
-
-			this->msglog(DEBUG, "sapawcard, downcard num %d.", __c.cardnum);
-
-			if (c[0] != __c.cardtype) { // recheck card type of downcards
-				return false;
-			}
-
-			__v.push_back(__c.cardnum); // add downcards in list
-		}
-
-		// sort desc
-		std::sort(__v.begin(), __v.end(), std::greater<unsigned char>());
-
-		for (int i = 0; i < __v.size() - 1; i++) {
-			if ((__v[i] - __v[i + 1]) != 1) {
-
-				this->msglog(DEBUG, "straight failed, card num. %d differ more than 1 with card num. %d.",
-					__v[i], __v[i + 1]);
-
-				return false;
-			}
-		}
+		GAMELOG(DEBUG, "sapawcard, issametype...");
 
 
 		// straight formed
-				// quadra formed
 		if (test == true) {
 			return true;
 		}
@@ -1243,6 +1507,8 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 			_cardinfo.cardtype = cardinfo->cardtype;
 			_cardinfo.cardnum = cardinfo->cardnum;
 			this->m_usercardinfo[userpos].down[downpos].push_back(_cardinfo);
+			if (_cardinfo.cardnum == 1)
+				this->m_usercardinfo[userpos].count.aces++;
 		}
 
 
@@ -1255,7 +1521,7 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 			// delete the card pointer from user list
 			if (!this->removefromusercards(userindex, _c)) {
 
-				this->msglog(DEBUG, "sapawcard, removefromusercards failed with card %d %d.",
+				GAMELOG(DEBUG, "sapawcard, removefromusercards failed with card %d %d.",
 					_c[0], _c[1]);
 
 				return false;
@@ -1278,17 +1544,16 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 		memcpy(&buf[0], (unsigned char*)&pMsg, size);
 		memcpy(&buf[size], cardpos, sizeof(_PMSG_CARD_INFO) * count);
 
-		for (int i = 0; i < MAX_USER_POS; i++) {
-			this->datasend(this->m_users[i], buf, pMsg.hdr.len);
-		}
+		this->broadcast(buf, pMsg.hdr.len);
 
 		// disable user's fight mode when the user's down cards has sapaw
 		_USER_INFO* _userinfo = guser.getuser(this->m_users[userpos]);
 		_userinfo->canfight = false;
-		if (this->m_users[userpos] == userindex)
+		if ((uintptr_t)this->m_users[userpos] == userindex)
 			_userinfo->isselfblock = true;
 		this->sendfightmode(this->m_users[userpos], 0);
 
+		this->logevent(requserpos, (int)_ACTIONS::_SAPAW, NULL, count, cardpos);
 		this->countusercards(userindex);
 		this->sendusercardcountsinfo(userindex);
 		this->getwinner();
@@ -1297,11 +1562,22 @@ bool game::sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, un
 	}
 
 
-	this->msglog(DEBUG, "sapawcard, failed bec. no place to sapaw card %d %d.", cardpos[0], cardpos[1]);
+	GAMELOG(DEBUG, "sapawcard, failed bec. no place to sapaw card %d %d.", cardpos[0], cardpos[1]);
 
 	return false;
 }
 
+bool game::cleargroup(unsigned char gamepos, int downpos)
+{
+	if ((size_t)downpos >= this->m_usercardinfo[gamepos].group.size())
+		return false;
+
+	_MELD& v = this->m_usercardinfo[gamepos].group[downpos];
+	this->countmeld(this->m_usercardinfo[gamepos].count, v, true, -1);
+	v.clear();
+	return true;
+}
+
 bool game::ungroupcards(uintptr_t userindex, int downpos)
 {
 	if (isactionvalid(userindex, _ACTIONS::_UNGROUP) == false)
@@ -1309,13 +1585,13 @@ bool game::ungroupcards(uintptr_t userindex, int downpos)
 
 	unsigned char _pos = guser.getuser(userindex)->m_gamepos;
 
-	if (downpos >= this->m_usercardinfo[_pos].group.size()) {
-		this->msglog(DEBUG, "ungroupcards, downpos %d is out of bound.", downpos);
+	if ((size_t)downpos >= this->m_usercardinfo[_pos].group.size()) {
+		GAMELOG(DEBUG, "ungroupcards, downpos %d is out of bound.", downpos);
 		return false;
 	}
 
-	std::vector <_PMSG_CARD_INFO> _v = this->m_usercardinfo[_pos].group[downpos];
-	std::vector <_PMSG_CARD_INFO>::iterator _viter;
+	_MELD _v = this->m_usercardinfo[_pos].group[downpos];
+	_CARD_PILE::iterator _viter;
 
 	for (_viter = _v.begin(); _viter != _v.end(); _viter++) {
 
@@ -1326,19 +1602,16 @@ bool game::ungroupcards(uintptr_t userindex, int downpos)
 		cc[1] = _card.cardnum;
 
 		if (!this->addtousercards(userindex, cc)) {
-			this->msglog(DEBUG, "ungroupcards, addtousercards failed.", userindex);
+			GAMELOG(DEBUG, "ungroupcards, addtousercards failed.", userindex);
 			return false;
 		}
 
 	}
 
-	this->m_usercardinfo[_pos].group[downpos].clear();
+	this->cleargroup(_pos, downpos);
+	this->logevent(_pos, (int)_ACTIONS::_UNGROUP, NULL, (unsigned char)_v.size(), (const unsigned char*)_v.begin());
 
-	_PMSG_UNGRPCARD_ANS pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF3;
-	pMsg.hdr.len = sizeof(_PMSG_UNGRPCARD_ANS);
-	pMsg.sub = 0x06;
+	_PMSG_UNGRPCARD_ANS pMsg = pkttemplate<_PMSG_UNGRPCARD_ANS>(0xF3, 0x06);
 	pMsg.downpos = downpos;
 	pMsg.gamepos = _pos;
 
@@ -1352,12 +1625,12 @@ bool game::ungroupcards(uintptr_t userindex, int downpos)
 bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* cardpos)
 {
 	if (cardpos == NULL) {
-		this->msglog(DEBUG, "groupcards, drop/selected card(s) is NULL.");
+		GAMELOG(DEBUG, "groupcards, drop/selected card(s) is NULL.");
 		return false;
 	}
 
 	if (count >= MAX_CARDS_PER_TYPE) {
-		this->msglog(DEBUG, "groupcards, count %d of selected cards exceeded the limit.", count);
+		GAMELOG(DEBUG, "groupcards, count %d of selected cards exceeded the limit.", count);
 		return false;
 	}
 
@@ -1365,7 +1638,7 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 		return false;
 
 	if (count < 3) {
-		this->msglog(DEBUG, "3 cards atleast is needed to group a carda.");
+		GAMELOG(DEBUG, "3 cards atleast is needed to group a carda.");
 		return false;
 	}
 
@@ -1378,10 +1651,10 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 		_cardinfo[0] = _card->cardtype;
 		_cardinfo[1] = _card->cardnum;
 
-		this->msglog(DEBUG, "groupcards, selected card %d/%d (%d) requserpos %d.", _card->cardtype, _card->cardnum, n, requserpos);
+		GAMELOG(DEBUG, "groupcards, selected card %d/%d (%d) requserpos %d.", _card->cardtype, _card->cardnum, n, requserpos);
 
 		if (this->getposfromusercard(userindex, _cardinfo) == -1) {
-			this->msglog(DEBUG, "groupcards failed, card %d/%d doest not exist in requserpos %d.", _card->cardtype, _card->cardnum, requserpos);
+			GAMELOG(DEBUG, "groupcards failed, card %d/%d doest not exist in requserpos %d.", _card->cardtype, _card->cardnum, requserpos);
 			return false;
 		}
 	}
@@ -1403,24 +1676,19 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 	c[0] = _cardinfo->cardtype;
 	c[1] = _cardinfo->cardnum;
 
-	for (int n = 1; n < count; n += 1) {
-		_cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-		if (c[1] != _cardinfo->cardnum) { // card number
-			issamenumber = false;
-			break;
-		}
-	}
+	_CARD_MASK selmask = this->getselectmask(count, cardpos);
 
-	for (int n = 1; n < count; n += 1) {
-		_cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-		if (c[0] != _cardinfo->cardtype) { // card type
-			issametype = false;
-			break;
-		}
+	// a card selected twice only sets one bit
+	if (cardpopcount(selmask) != count) {
+		GAMELOG(DEBUG, "groupcards failed, selected cards are not distinct.");
+		return false;
 	}
 
+	issamenumber = cardisset(selmask);
+	issametype = cardisrun(selmask);
+
 	if (issamenumber) {
-		std::vector <_PMSG_CARD_INFO> _vdowncards;
+		_MELD _vdowncards;
 
 		for (int n = 0; n < count; n++) {
 			_PMSG_CARD_INFO* _card = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
@@ -1445,7 +1713,7 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 
 		int downpos = this->adddowncards(userindex, _vdowncards, true);
 
-		this->msglog(DEBUG, "groupcards, grouped trio/quadra at position %d size %d.", downpos, _vdowncards.size());
+		GAMELOG(DEBUG, "groupcards, grouped trio/quadra at position %d size %d.", downpos, _vdowncards.size());
 
 		pMsg.hdr.len = size;
 		pMsg.sub = 0x05;
@@ -1457,6 +1725,7 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 
 		this->datasend(userindex, buf, pMsg.hdr.len);
 
+		this->logevent(requserpos, (int)_ACTIONS::_GROUP, NULL, count, cardpos);
 		this->countusercards(userindex);
 
 		return true;
@@ -1467,25 +1736,12 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 
 		for (int n = 0; n < count; n++) {
 			_PMSG_CARD_INFO* _card = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-			this->msglog(DEBUG, "groupcards, user selected card %d %d.", _card->cardtype, _card->cardnum);
+			GAMELOG(DEBUG, "groupcards, user selected card %d %d.", _card->cardtype, _card->cardnum);
 			_v.push_back(_card->cardnum);
 		}
 
-		// sort desc
-		std::sort(_v.begin(), _v.end(), std::greater<unsigned char>());
-
-		for (int i = 0; i < count - 1; i++) {
-			if ((_v[i] - _v[i + 1]) != 1) {
-
-				this->msglog(DEBUG, "straight failed, card num. %d differ more than 1 with card num. %d.",
-					_v[i], _v[i + 1]);
-
-				return false;
-			}
-		}
-
 		// its straight
-		std::vector <_PMSG_CARD_INFO> _vdowncards;
+		_MELD _vdowncards;
 
 		// sort asc
 		std::sort(_v.begin(), _v.end(), std::less<unsigned char>());
@@ -1493,7 +1749,7 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 
 		_PMSG_CARD_INFO cc = { 0 };
 
-		for (int i = 0; i < _v.size(); i++) {
+		for (int i = 0; i < (int)_v.size(); i++) {
 
 			cc.cardnum = _v[i];
 			cc.cardtype = c[0];
@@ -1501,7 +1757,7 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 			memcpy(&buf[size], (unsigned char*)&cc, sizeof(_PMSG_CARD_INFO));
 			size += sizeof(_PMSG_CARD_INFO);
 
-			this->msglog(DEBUG, "straight formed cards, type %d num %d size %d.", cc.cardtype, cc.cardnum, size);
+			GAMELOG(DEBUG, "straight formed cards, type %d num %d size %d.", cc.cardtype, cc.cardnum, size);
 
 
 			_vdowncards.push_back(cc);
@@ -1519,7 +1775,7 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 
 		int downpos = this->adddowncards(userindex, _vdowncards, true);
 
-		this->msglog(DEBUG, "groupcards, grouped straight at position %d size %d.", downpos, _vdowncards.size());
+		GAMELOG(DEBUG, "groupcards, grouped straight at position %d size %d.", downpos, _vdowncards.size());
 
 		pMsg.hdr.len = size;
 		pMsg.sub = 0x05;
@@ -1531,12 +1787,13 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 
 		this->datasend(userindex, buf, pMsg.hdr.len);
 
+		this->logevent(requserpos, (int)_ACTIONS::_GROUP, NULL, count, cardpos);
 		this->countusercards(userindex);
 
 		return true;
 	}
 
-	this->msglog(DEBUG, "groupcards, failed to create trio/quadra/straight from the selected cards.");
+	GAMELOG(DEBUG, "groupcards, failed to create trio/quadra/straight from the selected cards.");
 
 	return false;
 }
@@ -1544,12 +1801,12 @@ bool game::groupcards(uintptr_t userindex, unsigned char count, unsigned char* c
 bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* cardpos)
 {
 	if (cardpos == NULL) {
-		this->msglog(DEBUG, "downcards, drop/selected card(s) is NULL.");
+		GAMELOG(DEBUG, "downcards, drop/selected card(s) is NULL.");
 		return false;
 	}
 
 	if (count >= MAX_CARDS_PER_TYPE) {
-		this->msglog(DEBUG, "downcards, count %d of selected cards exceeded the limit.", count);
+		GAMELOG(DEBUG, "downcards, count %d of selected cards exceeded the limit.", count);
 		return false;
 	}
 
@@ -1557,7 +1814,7 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 		return false;
 
 	if (count < 3) {
-		this->msglog(DEBUG, "3 cards atleast is needed to down a card.");
+		GAMELOG(DEBUG, "3 cards atleast is needed to down a card.");
 		return false;
 	}
 
@@ -1570,10 +1827,10 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 		_cardinfo[0] = _card->cardtype;
 		_cardinfo[1] = _card->cardnum;
 
-		this->msglog(DEBUG, "downcards, selected card %d/%d (%d) requserpos %d.", _card->cardtype, _card->cardnum, n, requserpos);
+		GAMELOG(DEBUG, "downcards, selected card %d/%d (%d) requserpos %d.", _card->cardtype, _card->cardnum, n, requserpos);
 
 		if (this->getposfromusercard(userindex, _cardinfo) == -1) {
-			this->msglog(DEBUG, "downcards failed, card %d/%d doest not exist in requserpos %d.", _card->cardtype, _card->cardnum, requserpos);
+			GAMELOG(DEBUG, "downcards failed, card %d/%d doest not exist in requserpos %d.", _card->cardtype, _card->cardnum, requserpos);
 			return false;
 		}
 	}
@@ -1595,24 +1852,19 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 	c[0] = _cardinfo->cardtype;
 	c[1] = _cardinfo->cardnum;
 
-	for (int n = 1; n < count; n += 1) {
-		_cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-		if (c[1] != _cardinfo->cardnum) { // card number
-			issamenumber = false;
-			break;
-		}
-	}
+	_CARD_MASK selmask = this->getselectmask(count, cardpos);
 
-	for (int n = 1; n < count; n += 1) {
-		_cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-		if (c[0] != _cardinfo->cardtype) { // card type
-			issametype = false;
-			break;
-		}
+	// a card selected twice only sets one bit
+	if (cardpopcount(selmask) != count) {
+		GAMELOG(DEBUG, "downcards failed, selected cards are not distinct.");
+		return false;
 	}
 
+	issamenumber = cardisset(selmask);
+	issametype = cardisrun(selmask);
+
 	if (issamenumber) {
-		std::vector <_PMSG_CARD_INFO> _vdowncards;
+		_MELD _vdowncards;
 
 		for (int n = 0; n < count; n++) {
 			_PMSG_CARD_INFO* _card = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
@@ -1645,14 +1897,13 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 
 		memcpy(&buf[0], (unsigned char*)&pMsg, sizeof(_PMSG_DOWNCARD_ANS));
 
-		for (int i = 0; i < MAX_USER_POS; i++) {
-			this->datasend(this->m_users[i], buf, pMsg.hdr.len);
-		}
+		this->broadcast(buf, pMsg.hdr.len);
 
-		this->m_active_status |= (int)_ACTIVE_STATE::_DOWNED;
-		this->msglog(DEBUG, "%s (%s), Flag active status _DOWNED.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
+		this->m_active_status = actionentry(this->m_active_status, _ACTIONS::_DOWN).next;
+		GAMELOG(DEBUG, "%s (%s), Flag active status _DOWNED.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
 		guser.getuser(userindex)->m_isdowncard = true;
 
+		this->logevent(guser.getuser(userindex)->m_gamepos, (int)_ACTIONS::_DOWN, NULL, count, cardpos);
 		this->countusercards(userindex);
 		this->sendusercardcountsinfo(userindex);
 		this->getwinner();
@@ -1665,25 +1916,12 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 
 		for (int n = 0; n < count; n++) {
 			_PMSG_CARD_INFO* _card = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-			this->msglog(DEBUG, "downcards, user selected card %d %d.", _card->cardtype, _card->cardnum);
+			GAMELOG(DEBUG, "downcards, user selected card %d %d.", _card->cardtype, _card->cardnum);
 			_v.push_back(_card->cardnum);
 		}
 
-		// sort desc
-		std::sort(_v.begin(), _v.end(), std::greater<unsigned char>());
-
-		for (int i = 0; i < count - 1; i++) {
-			if ((_v[i] - _v[i + 1]) != 1) {
-
-				this->msglog(DEBUG, "straight failed, card num. %d differ more than 1 with card num. %d.",
-					_v[i], _v[i + 1]);
-
-				return false;
-			}
-		}
-
 		// its straight
-		std::vector <_PMSG_CARD_INFO> _vdowncards;
+		_MELD _vdowncards;
 
 		// sort asc
 		std::sort(_v.begin(), _v.end(), std::less<unsigned char>());
@@ -1691,7 +1929,7 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 
 		_PMSG_CARD_INFO cc = { 0 };
 
-		for (int i = 0; i < _v.size(); i++) {
+		for (int i = 0; i < (int)_v.size(); i++) {
 
 			cc.cardnum = _v[i];
 			cc.cardtype = c[0];
@@ -1699,7 +1937,7 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 			memcpy(&buf[size], (unsigned char*)&cc, sizeof(_PMSG_CARD_INFO));
 			size += sizeof(_PMSG_CARD_INFO);
 
-			this->msglog(DEBUG, "straight formed cards, type %d num %d size %d.", cc.cardtype, cc.cardnum, size);
+			GAMELOG(DEBUG, "straight formed cards, type %d num %d size %d.", cc.cardtype, cc.cardnum, size);
 
 
 			// add to chowlist the cards with its new pointer
@@ -1726,15 +1964,14 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 
 		memcpy(&buf[0], (unsigned char*)&pMsg, sizeof(_PMSG_DOWNCARD_ANS));
 
-		for (int i = 0; i < MAX_USER_POS; i++) {
-			this->datasend(this->m_users[i], buf, pMsg.hdr.len);
-		}
+		this->broadcast(buf, pMsg.hdr.len);
 
-		this->m_active_status |= (int)_ACTIVE_STATE::_DOWNED;
-		this->msglog(DEBUG, "%s (%s), Flag active status _DOWNED.", guser.getuser(this->m_active_userindex)->name.c_str(), 
+		this->m_active_status = actionentry(this->m_active_status, _ACTIONS::_DOWN).next;
+		GAMELOG(DEBUG, "%s (%s), Flag active status _DOWNED.", guser.getuser(this->m_active_userindex)->name.c_str(), 
 			guser.getuser(this->m_active_userindex)->account.c_str());
 		guser.getuser(userindex)->m_isdowncard = true;
 
+		this->logevent(guser.getuser(userindex)->m_gamepos, (int)_ACTIONS::_DOWN, NULL, count, cardpos);
 		this->countusercards(userindex);
 		this->sendusercardcountsinfo(userindex);
 		this->getwinner();
@@ -1742,7 +1979,7 @@ bool game::downcards(uintptr_t userindex, unsigned char count, unsigned char* ca
 		return true;
 	}
 
-	this->msglog(DEBUG, "Downcards, failed to create trio/quadra/straight from the selected cards.");
+	GAMELOG(DEBUG, "Downcards, failed to create trio/quadra/straight from the selected cards.");
 	return false;
 }
 
@@ -1762,42 +1999,42 @@ bool game::usercards(uintptr_t userindex)
 bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* pos, unsigned char count, unsigned char* cardpos)
 {
 	if (pos == NULL || cardpos == NULL) {
-		this->msglog(DEBUG, "chowcard, drop/selected card(s) is NULL.");
+		GAMELOG(DEBUG, "chowcard, drop/selected card(s) is NULL.");
 		return false;
 	}
 
 	if (count >= MAX_CARDS_PER_TYPE) {
-		this->msglog(DEBUG, "chowcard, count %d of selected cards exceeded the limit.", count);
+		GAMELOG(DEBUG, "chowcard, count %d of selected cards exceeded the limit.", count);
 		return false;
 	}
 
-	std::vector<_DROPCARD_INFO>::iterator iter;
+	_DROP_PILE::iterator iter;
 
 	if (isactionvalid(userindex, _ACTIONS::_CHOW) == false)
 		return false;
 
 	if (count <= 1) {
-		this->msglog(DEBUG, "2 cards atleast is needed to chow a card.");
+		GAMELOG(DEBUG, "2 cards atleast is needed to chow a card.");
 		return false;
 	}
 
 	int requserpos = guser.getuser(userindex)->m_gamepos;
 
-	this->msglog(DEBUG, "chowcard, requserpos %d userpos %d count %d.", requserpos, userpos, count);
+	GAMELOG(DEBUG, "chowcard, requserpos %d userpos %d count %d.", requserpos, userpos, count);
 
-	if (requserpos == 0 && userpos == 2 ||
-		requserpos == 1 && userpos == 0 ||
-		requserpos == 2 && userpos == 1
+	if ((requserpos == 0 && userpos == 2) ||
+		(requserpos == 1 && userpos == 0) ||
+		(requserpos == 2 && userpos == 1)
 		) {
 
 		int _pos = this->getposfromdropcard(userpos, pos);
 
 		if (_pos == -1) {
-			this->msglog(DEBUG, "chowcard, failed to find drop card %d/%d from userpos %d.", pos[0], pos[1], userpos);
+			GAMELOG(DEBUG, "chowcard, failed to find drop card %d/%d from userpos %d.", pos[0], pos[1], userpos);
 			return false;
 		}
 
-		this->msglog(DEBUG, "chowcard, found dropped card %d/%d from userpos %d drop list at pos %d.", pos[0], pos[1], userpos, _pos);
+		GAMELOG(DEBUG, "chowcard, found dropped card %d/%d from userpos %d drop list at pos %d.", pos[0], pos[1], userpos, _pos);
 
 
 		// pos should be the last drop by the user
@@ -1806,7 +2043,7 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 			_DROPCARD_INFO dropinfo = *iter;
 			if (dropinfo.userpos == userpos) {
 				if (dropinfo.pos > _pos) {
-					this->msglog(DEBUG, "chowcard failed, dropped pos %d is not the last drop of userpos %d, it is %d.", 
+					GAMELOG(DEBUG, "chowcard failed, dropped pos %d is not the last drop of userpos %d, it is %d.", 
 						_pos, userpos, dropinfo.pos);
 					return false;
 				}
@@ -1821,25 +2058,30 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 			_cardinfo[0] = _card->cardtype;
 			_cardinfo[1] = _card->cardnum;
 
-			this->msglog(DEBUG, "chowcard, selected card %d/%d (%d) userpos %d.", _card->cardtype, _card->cardnum, n, userpos);
+			GAMELOG(DEBUG, "chowcard, selected card %d/%d (%d) userpos %d.", _card->cardtype, _card->cardnum, n, userpos);
 
 			if (this->getposfromusercard(userindex, _cardinfo) == -1) {
-				this->msglog(DEBUG, "chowcard failed, card %d/%d doest not exist in userpos %d.", _card->cardtype, _card->cardnum, userpos);
+				GAMELOG(DEBUG, "chowcard failed, card %d/%d doest not exist in userpos %d.", _card->cardtype, _card->cardnum, userpos);
 				return false;
 			}
 		}
 
+		if (cardpopcount(this->getselectmask(count, cardpos)) != count) {
+			GAMELOG(DEBUG, "chowcard failed, selected cards are not distinct.");
+			return false;
+		}
+
 		iter = this->vDroppedCards.begin();
 
 		while (iter != this->vDroppedCards.end()) {
 
 			_DROPCARD_INFO dropinfo = *iter;
 
-			this->msglog(DEBUG, "Drop info, dropped card pos %d userpos %d.", dropinfo.pos, dropinfo.userpos);
+			GAMELOG(DEBUG, "Drop info, dropped card pos %d userpos %d.", dropinfo.pos, dropinfo.userpos);
 
 			if (dropinfo.userpos == userpos && dropinfo.card.cardtype == pos[0] && dropinfo.card.cardnum == pos[1]) {
 
-				this->msglog(DEBUG, "Found match, dropped card pos %d userpos %d.", dropinfo.pos, dropinfo.userpos);
+				GAMELOG(DEBUG, "Found match, dropped card pos %d userpos %d.", dropinfo.pos, dropinfo.userpos);
 
 				unsigned char buf[100] = { 0 };
 				_PMSG_CHOWCARD_ANS pMsg = { 0 };
@@ -1848,50 +2090,24 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 
 				int size = sizeof(_PMSG_CHOWCARD_ANS);
 
-				bool issamenumber = true;
-				bool issametype = true;
-
 				unsigned char c[2];
 
 				_PMSG_CARD_INFO* _cardinfo = (_PMSG_CARD_INFO*)(cardpos);// + (0 * sizeof(_PMSG_CARD_INFO)));
 				c[0] = _cardinfo->cardtype;
 				c[1] = _cardinfo->cardnum;
 
+				_CARD_MASK meld = this->getselectmask(count, cardpos) | cardmask(dropinfo.card.cardtype, dropinfo.card.cardnum);
 
-
-				for (int n = 1; n < count; n += 1) {
-
-					_cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-
-					if (c[1] != _cardinfo->cardnum) { // card number
-						issamenumber = false;
-						break;
-					}
-				}
-
-				for (int n = 1; n < count; n += 1) {
-
-					_cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
-
-					if (c[0] != _cardinfo->cardtype) { // card type
-						issametype = false;
-						break;
-					}
-				}
+				bool issamenumber = cardisset(meld);
+				bool issametype = cardisrun(meld);
 
 				if (issamenumber) { // trio/quadra
 
-					if (dropinfo.card.cardnum != c[1]) { // card number
-						this->msglog(DEBUG, "trio/quadra failed, dropped cardnum %d is not equal to user card %d.", 
-							dropinfo.card.cardnum, c[1]);
-						return false;
-					}
-
 					// its trio/quadra
-					std::vector<_PMSG_CARD_INFO> _vchowcards;
+					_MELD _vchowcards;
 					_vchowcards.push_back(dropinfo.card);
 
-					this->msglog(DEBUG, "chowcard, drop card num %d.", dropinfo.card.cardnum);
+					GAMELOG(DEBUG, "chowcard, drop card num %d.", dropinfo.card.cardnum);
 
 					_PMSG_CARD_INFO cc = { 0 };
 					cc.cardnum = dropinfo.card.cardnum;
@@ -1902,7 +2118,7 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 					for (int n = 0; n < count; n += 1) {
 						_PMSG_CARD_INFO* _cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
 
-						this->msglog(DEBUG, "chowcard, user selected card %d %d.", _cardinfo->cardtype, _cardinfo->cardnum);
+						GAMELOG(DEBUG, "chowcard, user selected card %d %d.", _cardinfo->cardtype, _cardinfo->cardnum);
 
 						memcpy(&buf[size], (unsigned char*)_cardinfo, sizeof(_PMSG_CARD_INFO));
 						size += sizeof(_PMSG_CARD_INFO);
@@ -1923,7 +2139,7 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 						this->removefromusercards(userindex, __card);
 					}
 
-					this->msglog(DEBUG, "trio/quadra formed from dropped card %d %d.", dropinfo.card.cardtype, dropinfo.card.cardnum);
+					GAMELOG(DEBUG, "trio/quadra formed from dropped card %d %d.", dropinfo.card.cardtype, dropinfo.card.cardnum);
 
 					int downpos = this->adddowncards(userindex, _vchowcards);
 
@@ -1938,16 +2154,15 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 
 					memcpy(&buf[0], (unsigned char*)&pMsg, sizeof(_PMSG_CHOWCARD_ANS));
 
-					for (int i = 0; i < MAX_USER_POS; i++) {
-						this->datasend(this->m_users[i], buf, pMsg.hdr.len);
-					}
+					this->broadcast(buf, pMsg.hdr.len);
 
-					this->m_active_status |= (int)_ACTIVE_STATE::_CHOWED;
-					this->msglog(DEBUG, "%s (%s), Flag active status _CHOWED.", guser.getuser(this->m_active_userindex)->name.c_str(), 
+					this->m_active_status = actionentry(this->m_active_status, _ACTIONS::_CHOW).next;
+					GAMELOG(DEBUG, "%s (%s), Flag active status _CHOWED.", guser.getuser(this->m_active_userindex)->name.c_str(), 
 						guser.getuser(this->m_active_userindex)->account.c_str());
 					guser.getuser(userindex)->m_isdowncard = true;
 
 					this->removefromdropped(userpos, pos);
+					this->logevent(guser.getuser(userindex)->m_gamepos, (int)_ACTIONS::_CHOW, pos, count, cardpos);
 
 					this->countusercards(userindex);
 					this->sendusercardcountsinfo(userindex);
@@ -1957,53 +2172,30 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 				}
 				else if (issametype) {
 
-					if (dropinfo.card.cardtype != c[0]) {
-						this->msglog(DEBUG, "straight failed, dropped card type %d is not equal to user card type %d.",
-							dropinfo.card.cardtype, c[0]);
-						return false;
-					}
-
 					std::vector <unsigned char> _v;
 					_v.push_back(dropinfo.card.cardnum);
 
-					this->msglog(DEBUG, "chowcard, drop card num %d.", dropinfo.card.cardnum);
+					GAMELOG(DEBUG, "chowcard, drop card num %d.", dropinfo.card.cardnum);
 
 					for (int n = 0; n < count; n++) {
 
 						_PMSG_CARD_INFO* _cardinfo = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
 							
 
-						this->msglog(DEBUG, "chowcard, user selected card %d %d.", _cardinfo->cardtype, _cardinfo->cardnum);
-
-						if (c[0] != _cardinfo->cardtype) { // recheck card type
-							return false;
-						}
+						GAMELOG(DEBUG, "chowcard, user selected card %d %d.", _cardinfo->cardtype, _cardinfo->cardnum);
 
 						_v.push_back(_cardinfo->cardnum);
 					}
 
-					// sort desc
-					std::sort(_v.begin(), _v.end(), std::greater<unsigned char>());
-
-					for (int i = 0; i < count; i++) {
-						if ((_v[i] - _v[i + 1]) != 1) {
-
-							this->msglog(DEBUG, "straight failed, card num. %d differ more than 1 with card num. %d.",
-								_v[i], _v[i + 1]);
-
-							return false;
-						}
-					}
-
 					// its straight
-					std::vector <_PMSG_CARD_INFO> _vchowcards;
+					_MELD _vchowcards;
 
 					// sort asc
 					std::sort(_v.begin(), _v.end(), std::less<unsigned char>());
 
 					_PMSG_CARD_INFO cc = { 0 };
 
-					for (int i = 0; i < _v.size(); i++) {
+					for (int i = 0; i < (int)_v.size(); i++) {
 
 						cc.cardnum = _v[i];
 						cc.cardtype = c[0];
@@ -2011,7 +2203,7 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 						memcpy(&buf[size], (unsigned char*)&cc, sizeof(_PMSG_CARD_INFO));
 						size += sizeof(_PMSG_CARD_INFO);
 
-						this->msglog(DEBUG, "straight formed cards, type %d num %d size %d.", cc.cardtype, cc.cardnum, size);
+						GAMELOG(DEBUG, "straight formed cards, type %d num %d size %d.", cc.cardtype, cc.cardnum, size);
 
 
 						// add to chowlist the cards with its new pointer
@@ -2028,7 +2220,7 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 						this->removefromusercards(userindex, __card);
 					}
 
-					this->msglog(DEBUG, "straight formed from dropped card %d %d.", dropinfo.card.cardtype, dropinfo.card.cardnum);
+					GAMELOG(DEBUG, "straight formed from dropped card %d %d.", dropinfo.card.cardtype, dropinfo.card.cardnum);
 
 					int downpos = this->adddowncards(userindex, _vchowcards);
 
@@ -2043,16 +2235,15 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 
 					memcpy(&buf[0], (unsigned char*)&pMsg, sizeof(_PMSG_CHOWCARD_ANS));
 
-					for (int i = 0; i < MAX_USER_POS; i++) {
-						this->datasend(this->m_users[i], buf, pMsg.hdr.len);
-					}
+					this->broadcast(buf, pMsg.hdr.len);
 
-					this->m_active_status |= (int)_ACTIVE_STATE::_CHOWED;
-					this->msglog(DEBUG, "%s (%s), Flag active status _CHOWED.", guser.getuser(this->m_active_userindex)->name.c_str(), 
+					this->m_active_status = actionentry(this->m_active_status, _ACTIONS::_CHOW).next;
+					GAMELOG(DEBUG, "%s (%s), Flag active status _CHOWED.", guser.getuser(this->m_active_userindex)->name.c_str(), 
 						guser.getuser(this->m_active_userindex)->account.c_str());
 					guser.getuser(userindex)->m_isdowncard = true;
 
 					this->removefromdropped(userpos, pos);
+					this->logevent(guser.getuser(userindex)->m_gamepos, (int)_ACTIONS::_CHOW, pos, count, cardpos);
 
 					this->countusercards(userindex);
 					this->sendusercardcountsinfo(userindex);
@@ -2061,7 +2252,7 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 					return true;
 				}
 
-				this->msglog(DEBUG, "chowcard, failed to form trio/quadra/straight, type/number test both false.");
+				GAMELOG(DEBUG, "chowcard, failed to form trio/quadra/straight, type/number test both false.");
 
 				return false;
 			}
@@ -2073,7 +2264,7 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 		return false;
 	}
 
-	this->msglog(DEBUG, "The dropped card userpos %d is trying to chow does not belong to this user, card dropped by user %d.",
+	GAMELOG(DEBUG, "The dropped card userpos %d is trying to chow does not belong to this user, card dropped by user %d.",
 		requserpos, userpos);
 
 	return false;
@@ -2082,7 +2273,7 @@ bool game::chowcard(uintptr_t userindex, unsigned char userpos, unsigned char* p
 bool game::dropcard(uintptr_t userindex, unsigned char* pos)
 {
 	if (pos == NULL) {
-		this->msglog(DEBUG, "dropcard, requested card to drop is NULL.");
+		GAMELOG(DEBUG, "dropcard, requested card to drop is NULL.");
 		return false;
 	}
 
@@ -2090,31 +2281,26 @@ bool game::dropcard(uintptr_t userindex, unsigned char* pos)
 		return false;
 
 	if (this->trysapawcard(userindex, pos)) {
-		this->sendnotice(userindex, 7, "You can't dump the card.");
-		this->msglog(DEBUG, "dropcard, request failed as the card can be used for sapaw.");
+		this->sendnotice(userindex, 7, _NOTICE_ID::_NODUMP);
+		GAMELOG(DEBUG, "dropcard, request failed as the card can be used for sapaw.");
 		return false;
 	}
 
 	int gamepos = guser.getuser(userindex)->m_gamepos;
 
-	this->msglog(DEBUG, "dropcard, userpos %d requested card %d/%d to drop.", gamepos, pos[0], pos[1]);
+	GAMELOG(DEBUG, "dropcard, userpos %d requested card %d/%d to drop.", gamepos, pos[0], pos[1]);
 
 	_PMSG_CARD_INFO _droppedcard = { 0 };
 	
 	// remove from user card list
-	std::vector <_PMSG_CARD_INFO>::iterator _iter;
-
-	for (_iter = this->m_usercardinfo[gamepos].user.begin(); _iter != this->m_usercardinfo[gamepos].user.end(); _iter++) {
-		_droppedcard = *_iter;
-		if (_droppedcard.cardtype == pos[0] && _droppedcard.cardnum == pos[1]) {
-			this->msglog(DEBUG, "dropcard, erased dropped card %d/%d from user list.", _droppedcard.cardtype, _droppedcard.cardnum);
-			this->m_usercardinfo[gamepos].user.erase(_iter);
-			break;
-		}
+	if (this->removefromusercards(userindex, pos)) {
+		_droppedcard.cardtype = pos[0];
+		_droppedcard.cardnum = pos[1];
+		GAMELOG(DEBUG, "dropcard, erased dropped card %d/%d from user list.", _droppedcard.cardtype, _droppedcard.cardnum);
 	}
 
 	if (_droppedcard.cardtype == 0) {
-		this->msglog(DEBUG, "dropcard, failed to find card %d/%d from user list.", pos[0], pos[1]);
+		GAMELOG(DEBUG, "dropcard, failed to find card %d/%d from user list.", pos[0], pos[1]);
 		return false;
 	}
 
@@ -2126,7 +2312,7 @@ bool game::dropcard(uintptr_t userindex, unsigned char* pos)
 	dropinfo.pos = this->m_dropcardctr;
 	dropinfo.userpos = guser.getuser(userindex)->m_gamepos;
 
-	this->msglog(DEBUG, "dropcard, add drop card %d %d to %d drop list.", _droppedcard.cardtype, _droppedcard.cardnum, userindex);
+	GAMELOG(DEBUG, "dropcard, add drop card %d %d to %d drop list.", _droppedcard.cardtype, _droppedcard.cardnum, userindex);
 
 	this->vDroppedCards.push_back(dropinfo);
 
@@ -2140,16 +2326,21 @@ bool game::dropcard(uintptr_t userindex, unsigned char* pos)
 	pMsg.cardtype = _droppedcard.cardtype;
 	pMsg.cardnum = _droppedcard.cardnum;
 
-	for (int i = 0; i < MAX_USER_POS; i++) {
-		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-	}
+	this->broadcast((unsigned char*)&pMsg, pMsg.hdr.len);
 
+	this->logevent(gamepos, (int)_ACTIONS::_DROP, pos, 0, NULL);
 	this->countusercards(userindex);
 	this->sendusercardcountsinfo(userindex);
 	this->getwinner();
 
 	// enable user's fight mode 
 	_USER_INFO* _userinfo = guser.getuser(userindex);
+
+	// how long the player takes for a turn, the ones played for them do not count
+	if (_userinfo != NULL && !_userinfo->isauto && !_userinfo->isbot && _userinfo->activetick != 0) {
+		uint32_t msec = (uint32_t)(clockmsec() - _userinfo->activetick);
+		_userinfo->turnmsec = (_userinfo->turnmsec == 0) ? msec : (_userinfo->turnmsec * 3 + msec) / 4;
+	}
 	if (_userinfo != NULL && _userinfo->m_isdowncard) {
 		if (_userinfo->isselfblock == true) {
 			_userinfo->isselfblock = false;
@@ -2160,8 +2351,8 @@ bool game::dropcard(uintptr_t userindex, unsigned char* pos)
 		}
 	}
 
-	this->m_active_status |= (int)_ACTIVE_STATE::_DROPPED;
-	this->msglog(DEBUG, "%s (%s), Flag active status _DROPPED.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
+	this->m_active_status = actionentry(this->m_active_status, _ACTIONS::_DROP).next;
+	GAMELOG(DEBUG, "%s (%s), Flag active status _DROPPED.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
 	return true;
 
 }
@@ -2171,30 +2362,26 @@ bool game::fightcard(uintptr_t userindex)
 	if (isactionvalid(userindex, _ACTIONS::_FIGHT) == false)
 		return false;
 
-	this->msglog(DEBUG, "reqfightcard %s (%s) ask to fight.", guser.getuser(userindex)->name.c_str(), guser.getuser(userindex)->account.c_str());
+	GAMELOG(DEBUG, "reqfightcard %s (%s) ask to fight.", guser.getuser(userindex)->name.c_str(), guser.getuser(userindex)->account.c_str());
 
 	guser.getuser(userindex)->fought = true;
 	this->m_fightuserindex = userindex;
-	this->m_active_status |= (int)_ACTIVE_STATE::_FOUGHT;
-	this->msglog(DEBUG, "%s (%s), Flag active status _FOUGHT.", guser.getuser(this->m_active_userindex)->name.c_str(), 
+	this->logevent(guser.getuser(userindex)->m_gamepos, (int)_ACTIONS::_FIGHT, NULL, 0, NULL);
+	this->m_active_status = actionentry(this->m_active_status, _ACTIONS::_FIGHT).next;
+	GAMELOG(DEBUG, "%s (%s), Flag active status _FOUGHT.", guser.getuser(this->m_active_userindex)->name.c_str(), 
 		guser.getuser(this->m_active_userindex)->account.c_str());
 
-	_PMSG_FIGHTCARD_ANS pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF3;
-	pMsg.hdr.len = sizeof(_PMSG_FIGHTCARD_ANS);
-	pMsg.sub = 0x07;
+	_PMSG_FIGHTCARD_ANS pMsg = pkttemplate<_PMSG_FIGHTCARD_ANS>(0xF3, 0x07);
 	pMsg.userpos = guser.getuser(userindex)->m_gamepos;
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
 		this->countusercards(this->m_users[i]);
 		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-		this->sendnotice(this->m_users[i], 6, 
-			"You have %d sec. to group your cards, only ungrouped cards will be counted.", MAX_MSECONDS_GROUPCARD_TIMEOUT / 1000);
+		this->sendnotice(this->m_users[i], 6, _NOTICE_ID::_FIGHTGROUPTIME, this->m_timeouts[this->m_ectype].groupcard / 1000);
 	}
 
-	this->sendtimeoutleft(MAX_MSECONDS_GROUPCARD_TIMEOUT);
-	this->m_gametick = GetTickCount64() + MAX_MSECONDS_GROUPCARD_TIMEOUT;
+	this->sendtimeoutleft(this->m_timeouts[this->m_ectype].groupcard);
+	this->m_gametick = clockmsec() + this->m_timeouts[this->m_ectype].groupcard;
 
 	return true;
 }
@@ -2203,21 +2390,16 @@ bool game::fight2card(uintptr_t userindex, unsigned char isfight)
 {
 	if (isfight && isactionvalid(userindex, _ACTIONS::_FIGHT2)) {
 		guser.getuser(userindex)->fought = true;
+		this->logevent(guser.getuser(userindex)->m_gamepos, (int)_ACTIONS::_FIGHT2, NULL, 0, NULL);
 	}
 	else {
 		return false;
 	}
 
-	_PMSG_FIGHT2CARD_ANS pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF3;
-	pMsg.hdr.len = sizeof(_PMSG_FIGHT2CARD_ANS);
-	pMsg.sub = 0x08;
+	_PMSG_FIGHT2CARD_ANS pMsg = pkttemplate<_PMSG_FIGHT2CARD_ANS>(0xF3, 0x08);
 	pMsg.userpos = guser.getuser(userindex)->m_gamepos;
 	pMsg.isfight = isfight;
-	for (int i = 0; i < MAX_USER_POS; i++) {
-		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-	}
+	this->broadcast((unsigned char*)&pMsg, pMsg.hdr.len);
 
 	return true;
 }
@@ -2233,13 +2415,20 @@ int game::checkactiveusers()
 	return count;
 }
 
+int game::checkactivehumans()
+{
+	int count = 0;
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(this->m_users[i]);
+		if (!userinfo->isbot && !userinfo->isdc() && this->m_usercardinfo[i].iskick == false)
+			count++;
+	}
+	return count;
+}
+
 void game::sendactivestatus()
 {
-	_PMSG_ACTIVESTATUS pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF2;
-	pMsg.hdr.len = sizeof(_PMSG_ACTIVESTATUS);
-	pMsg.sub = 0x05;
+	_PMSG_ACTIVESTATUS pMsg = pkttemplate<_PMSG_ACTIVESTATUS>(0xF2, 0x05);
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
 		pMsg.userpos[i] = 1;
@@ -2248,18 +2437,12 @@ void game::sendactivestatus()
 		}
 	}
 
-	for (int i = 0; i < MAX_USER_POS; i++) {
-		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-	}
+	this->broadcast((unsigned char*)&pMsg, pMsg.hdr.len);
 }
 
 void game::sendwaitinfo()
 {
-	_PMSG_ACTIVEINFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_ACTIVEINFO);
-	pMsg.sub = 0x02;
+	_PMSG_ACTIVEINFO pMsg = pkttemplate<_PMSG_ACTIVEINFO>(0xF1, 0x02);
 	pMsg.activeuserpos = this->m_active_pos;
 	pMsg.timelimit_msec = 0;
 	pMsg.activegamestate = (unsigned char)this->getstate();
@@ -2273,18 +2456,13 @@ void game::sendwaitinfo()
 		}
 	}
 
-	for (int i = 0; i < MAX_USER_POS; i++) {
-		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-	}
+	this->broadcast((unsigned char*)&pMsg, pMsg.hdr.len);
+	this->senddeadline(0, (unsigned char)this->m_active_pos, 0);
 }
 
 void game::sendclosedinfo()
 {
-	_PMSG_ACTIVEINFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_ACTIVEINFO);
-	pMsg.sub = 0x02;
+	_PMSG_ACTIVEINFO pMsg = pkttemplate<_PMSG_ACTIVEINFO>(0xF1, 0x02);
 	pMsg.activeuserpos = this->m_active_pos;
 	pMsg.timelimit_msec = 0;
 	pMsg.activegamestate = (unsigned char)this->getstate();
@@ -2297,112 +2475,108 @@ void game::sendclosedinfo()
 		}
 	}
 
-	for (int i = 0; i < MAX_USER_POS; i++) {
-		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-	}
+	this->broadcast((unsigned char*)&pMsg, pMsg.hdr.len);
 }
 
 void game::sendendedinfo()
 {
-	_PMSG_ACTIVEINFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_ACTIVEINFO);
-	pMsg.sub = 0x02;
+	_PMSG_ACTIVEINFO pMsg = pkttemplate<_PMSG_ACTIVEINFO>(0xF1, 0x02);
 	pMsg.activeuserpos = this->m_active_pos;
 	pMsg.timelimit_msec = 0;
 	pMsg.activegamestate = (unsigned char)this->getstate();
 	pMsg.activegamecounter = this->m_counter;
 	pMsg.activehitteruserpos = -1;
 
+	GAMELOG(DEBUG, "send ended info to %d, %d, %d.", this->m_users[0], this->m_users[1], this->m_users[2]);
+	this->broadcast((unsigned char*)&pMsg, pMsg.hdr.len);
+}
+
+// the seats are taken and their cards counted by the time a packet goes out, the next reset builds them again
+void game::buildseatpkts()
+{
 	for (int i = 0; i < MAX_USER_POS; i++) {
-		this->msglog(DEBUG, "send ended info to %d.", this->m_users[i]);
-		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-	}
+		_USER_INFO* userinfo = guser.getuser(this->m_users[i]);
 
+		this->m_namepkts[i] = pkttemplate<_PMSG_USERNAMEINFO>(0xF1, 0x03);
+		this->m_namepkts[i].gamepos = i;
+		memcpy(this->m_namepkts[i].name, userinfo->name.c_str(), std::min(userinfo->name.length(), sizeof(this->m_namepkts[i].name)));
+
+		this->m_cardpkts[i] = pkttemplate<_PMSG_USERCARDSINFO>(0xF1, 0x05);
+		this->m_cardpkts[i].gamepos = i;
+		this->m_cardpkts[i].cardcounts = userinfo->m_cardquantity;
+	}
+	this->m_isseatpktsdirty = false;
 }
 
 void game::sendusercardcountsinfo(uintptr_t userindex, uintptr_t touserindex)
 {
-	_PMSG_USERCARDSINFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_USERCARDSINFO);
-	pMsg.sub = 0x05;
-	pMsg.gamepos = guser.getuser(userindex)->m_gamepos;
-	pMsg.cardcounts = guser.getuser(userindex)->m_cardquantity;
+	unsigned char pos = guser.getuser(userindex)->m_gamepos;
+
+	if (pos >= MAX_USER_POS)
+		return;
+	if (this->m_isseatpktsdirty)
+		this->buildseatpkts();
+
+	_PMSG_USERCARDSINFO* pMsg = &this->m_cardpkts[pos];
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
-		if (touserindex != 0 && this->m_users[i] != touserindex)
+		if (touserindex != 0 && (uintptr_t)this->m_users[i] != touserindex)
 			continue;
-		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
+		this->datasend(this->m_users[i], (unsigned char*)pMsg, pMsg->hdr.len);
 	}
+
+	if (touserindex == 0)
+		this->spectate((unsigned char*)pMsg, pMsg->hdr.len);
 }
 
 void game::sendfightmode(uintptr_t userindex, unsigned char enable)
 {
-	_PMSG_FIGHTMODE_INFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_FIGHTMODE_INFO);
-	pMsg.sub = 0x08;
+	_PMSG_FIGHTMODE_INFO pMsg = pkttemplate<_PMSG_FIGHTMODE_INFO>(0xF1, 0x08);
 	pMsg.enable = enable;
 	this->datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
 }
 
 void game::senduserecoinsinfo(uintptr_t userindex)
 {
-	_PMSG_USERECOINSINFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_USERECOINSINFO);
-	pMsg.sub = 0x04;
+	_PMSG_USERECOINSINFO pMsg = pkttemplate<_PMSG_USERECOINSINFO>(0xF1, 0x04);
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
-		if (userindex != 0 && userindex != this->m_users[i])
+		if (userindex != 0 && userindex != (uintptr_t)this->m_users[i])
 			continue;
 		pMsg.gamepos = i;
 		if (guser.getuser(this->m_users[i])->ecoins[this->m_ectype] < 0)
 			guser.getuser(this->m_users[i])->ecoins[this->m_ectype] = 0;
 		pMsg.ecoins = guser.getuser(this->m_users[i])->ecoins[this->m_ectype];
-		this->msglog(DEBUG, "%s (%s) ecoins %d", guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str(), pMsg.ecoins);
+		GAMELOG(DEBUG, "%s (%s) ecoins %d", guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str(), pMsg.ecoins);
 		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
 		guser.saveecoins(this->m_users[i], this->m_ectype);
+		if (userindex == 0)
+			this->spectate((unsigned char*)&pMsg, pMsg.hdr.len);
 	}
 }
 
 void game::sendusernameinfo(uintptr_t userindex)
 {
-	_PMSG_USERNAMEINFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_USERNAMEINFO);
-	pMsg.sub = 0x03;
+	if (this->m_isseatpktsdirty)
+		this->buildseatpkts();
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
-		pMsg.gamepos = i;
-		memcpy(pMsg.name, guser.getuser(this->m_users[i])->name.c_str(), sizeof(pMsg.name));
+		_PMSG_USERNAMEINFO* pMsg = &this->m_namepkts[i];
 		if (userindex != 0) {
-			this->datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+			this->datasend(userindex, (unsigned char*)pMsg, pMsg->hdr.len);
 		}
 		else {
-			for (int n = 0; n < MAX_USER_POS; n++) {
-				this->datasend(this->m_users[n], (unsigned char*)&pMsg, pMsg.hdr.len);
-			}
+			this->broadcast((unsigned char*)pMsg, pMsg->hdr.len);
 		}
 	}
 }
 
 void game::sendactiveinfo(uintptr_t userindex)
 {
-	_PMSG_ACTIVEINFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_ACTIVEINFO);
-	pMsg.sub = 0x02;
+	_PMSG_ACTIVEINFO pMsg = pkttemplate<_PMSG_ACTIVEINFO>(0xF1, 0x02);
 	pMsg.activeuserpos = this->m_active_pos;
 
-	unsigned int msecleft = guser.getuser(this->m_active_userindex)->activetick + MAX_MSECONDS_EACHTURN_TIMEOUT - GetTickCount64();
+	unsigned int msecleft = guser.getuser(this->m_active_userindex)->activetick + this->getturnmsec(this->m_active_userindex) - clockmsec();
 	pMsg.timelimit_msec = msecleft;
 	pMsg.activegamestate = (unsigned char)this->getstate();
 	pMsg.activegamecounter = this->m_counter;
@@ -2417,7 +2591,7 @@ void game::sendactiveinfo(uintptr_t userindex)
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
 
-		if (userindex != 0 && userindex != this->m_users[i])
+		if (userindex != 0 && userindex != (uintptr_t)this->m_users[i])
 			continue;
 
 		if (this->m_usercardinfo[i].iskick == true)
@@ -2425,36 +2599,86 @@ void game::sendactiveinfo(uintptr_t userindex)
 
 		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
 	}
+
+	if (userindex == 0)
+		this->spectate((unsigned char*)&pMsg, pMsg.hdr.len);
+
+	this->senddeadline(userindex, (unsigned char)this->m_active_pos, guser.getuser(this->m_active_userindex)->activetick + this->getturnmsec(this->m_active_userindex));
+
+	if (userindex == 0 || userindex == (uintptr_t)this->m_active_userindex)
+		this->sendactionmask(this->m_active_userindex);
 }
 
 void game::sendtimeoutleft(uintptr_t timemsec) {
 
-	_PMSG_TIMEOUT_INFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_TIMEOUT_INFO);
-	pMsg.sub = 0x07;
+	_PMSG_TIMEOUT_INFO pMsg = pkttemplate<_PMSG_TIMEOUT_INFO>(0xF1, 0x07);
 	pMsg.timemsecleft = timemsec;
+
+	// the apps that count down themselves get the deadline instead
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		if (!guser.getuser(this->m_users[i])->isdeadline)
+			this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
+	}
+	this->spectate((unsigned char*)&pMsg, pMsg.hdr.len);
+
+	this->senddeadline(0, 0xFF, clockmsec() + timemsec);
+}
+
+// the end of the timer running to the apps of APK_VER_DEADLINE, on the clock they got at login. they
+// count it down themselves, so it is only sent when it moves: a new turn, a table timer, a resume or a
+// wait on a player gone, which stops it with 0. userindex 0 for every seat
+void game::senddeadline(uintptr_t userindex, unsigned char pos, uint64_t deadline)
+{
+	_PMSG_DEADLINE_INFO pMsg = pkttemplate<_PMSG_DEADLINE_INFO>(0xF1, 0x0D);
+	pMsg.activeuserpos = pos;
+	pMsg.deadline = (unsigned int)deadline;
+
 	for (int i = 0; i < MAX_USER_POS; i++) {
+
+		if (userindex != 0 && userindex != (uintptr_t)this->m_users[i])
+			continue;
+
+		if (this->m_usercardinfo[i].iskick == true || !guser.getuser(this->m_users[i])->isdeadline)
+			continue;
+
 		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
 	}
 }
 
-void game::sendnotice(uintptr_t userindex, unsigned char type, const char* msg, ...)
+// to every seat with userindex 0, the seats of each kind of app get the same bytes. the text is made
+// only when a seat or a watcher reads it, watchers always get the text
+void game::sendnotice(uintptr_t userindex, const _NOTICE& notice)
 {
-	char szBuffer[1024] = { 0 };
-	va_list pArguments;
-	va_start(pArguments, msg);
-	size_t iSize = strlen(szBuffer);
-	vsprintf(&szBuffer[iSize], msg, pArguments);
-	va_end(pArguments);
+	if (userindex != 0) {
+		this->m_sink->notice(userindex, notice);
+		return;
+	}
 
-	if (userindex == 0) {
-		for (int i = 0; i < MAX_USER_POS; i++) {
-			guser.sendnotice(this->m_users[i], type, szBuffer);
-		}
-	} else 
-		guser.sendnotice(userindex, type, szBuffer);
+	intptr_t idusers[MAX_USER_POS];
+	intptr_t textusers[MAX_USER_POS];
+	int idcount = 0;
+	int textcount = 0;
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(this->m_users[i]);
+		if (userinfo == NULL)
+			continue;
+		if (userinfo->isnoticeid)
+			idusers[idcount++] = this->m_users[i];
+		else
+			textusers[textcount++] = this->m_users[i];
+	}
+
+	if (idcount > 0)
+		this->m_sink->sendall(idusers, idcount, (unsigned char*)notice.data, notice.packet()->hdr.len);
+
+	if (textcount > 0 || this->m_spectate != NULL) {
+		_PMSG_NOTICEMSG pMsg;
+		noticetext(notice, pMsg);
+		if (textcount > 0)
+			this->m_sink->sendall(textusers, textcount, (unsigned char*)&pMsg, pMsg.hdr.len);
+		this->spectate((const unsigned char*)&pMsg, pMsg.hdr.len);
+	}
 }
 
 void game::setstate_restarted()
@@ -2463,7 +2687,7 @@ void game::setstate_restarted()
 	this->m_active_status = (int)_ACTIVE_STATE::_NONE;
 
 	// force stop timeout timer
-	this->sendtimeoutleft(MAX_MSECONDS_SHOWCARD_TIMEOUT + MAX_MSECONDS_SHOWRESULT_TIMEOUT);
+	this->sendtimeoutleft(this->m_timeouts[this->m_ectype].showcard + this->m_timeouts[this->m_ectype].showresult);
 
 	// send some notice
 	//this->sendnotice(0, 0, "Next game will resume after %d seconds.", 
@@ -2477,7 +2701,7 @@ void game::setstate_restarted()
 	}
 
 	// set 3 sec. delay before sending reset game command
-	this->m_gametick = GetTickCount64() + MAX_MSECONDS_SHOWCARD_TIMEOUT + MAX_MSECONDS_SHOWRESULT_TIMEOUT;
+	this->m_gametick = clockmsec() + this->m_timeouts[this->m_ectype].showcard + this->m_timeouts[this->m_ectype].showresult;
 }
 
 void game::resumedcuser()
@@ -2493,11 +2717,7 @@ void game::resumedcuser()
 	if (found == false)
 		return;
 
-	_PMSG_INITINFO pMsgResumed = { 0 };
-	pMsgResumed.hdr.c = 0xC1;
-	pMsgResumed.hdr.h = 0xF2;
-	pMsgResumed.hdr.len = sizeof(_PMSG_INITINFO);
-	pMsgResumed.sub = 0x06;
+	_PMSG_INITINFO pMsgResumed = pkttemplate<_PMSG_INITINFO>(0xF2, 0x06);
 	pMsgResumed.init = 1;
 	pMsgResumed.ectype = this->m_ectype;
 
@@ -2505,6 +2725,7 @@ void game::resumedcuser()
 		if (guser.getuser(this->m_users[i])->isresumed() && guser.getuser(this->m_users[i])->m_resumeflag == 0) {
 
 			// send resume flag enabled
+			this->m_resyncuser = this->m_users[i];
 			pMsgResumed.gamepos = guser.getuser(this->m_users[i])->m_gamepos;
 			pMsgResumed.resume = 1;
 			if (this->datasend(this->m_users[i], (unsigned char*)&pMsgResumed, pMsgResumed.hdr.len))
@@ -2518,6 +2739,30 @@ void game::resumedcuser()
 	// send cards
 	for (int i = 0; i < MAX_USER_POS; i++) {
 		if (guser.getuser(this->m_users[i])->isresumed() && guser.getuser(this->m_users[i])->m_resumeflag == 2) {
+			this->m_resyncuser = this->m_users[i];
+
+			// the frames it missed when the ring still has them all, the table it has is right then
+			int replayed = replaysend(this->m_users[i]);
+			if (replayed >= 0) {
+				guser.getuser(this->m_users[i])->resumed();
+
+				pMsgResumed.gamepos = guser.getuser(this->m_users[i])->m_gamepos;
+				pMsgResumed.resume = 0;
+				pMsgResumed.init = 0;
+				this->datasend(this->m_users[i], (unsigned char*)&pMsgResumed, pMsgResumed.hdr.len);
+
+				this->sendactiveinfo(this->m_users[i]);
+				replaymark(this->m_users[i], false);
+				GAMELOG(INFO, "resumedcuser, %s is sent the %d frames it missed.", guser.getuser(this->m_users[i])->name.c_str(), replayed);
+				break;
+			}
+
+			// a v2 app gets the whole table in one frame, the packets after it are the deltas
+			if (guser.getuser(this->m_users[i])->wirever == WIRE_V2) {
+				this->sendsyncinfo(this->m_users[i]);
+				replaymark(this->m_users[i], false);
+				break;
+			}
 
 			// send user cards
 			this->sendusercards(this->m_users[i]);
@@ -2528,7 +2773,7 @@ void game::resumedcuser()
 			// send drop cards
 			guser.getuser(this->m_users[i])->m_gamedropctr = 0;
 
-			std::vector<_DROPCARD_INFO>::iterator iter;
+			_DROP_PILE::iterator iter;
 			for (iter = this->vDroppedCards.begin(); iter != this->vDroppedCards.end(); iter++) {
 				_DROPCARD_INFO _droppedcard = *iter;
 				_PMSG_DROP_CARD_ANS pMsg = { 0 };
@@ -2568,30 +2813,45 @@ void game::resumedcuser()
 			this->sendstockcardcount(this->m_users[i]);
 			// send active info
 			this->sendactiveinfo(this->m_users[i]);
+			replaymark(this->m_users[i], false);
 			break;
 		}
 	}
+	this->m_resyncuser = 0;
 }
 
 void game::procstate_restarted()
 {
-	if (GetTickCount64() < this->m_gametick) {
+	if (clockmsec() < this->m_gametick) {
+		return;
+	}
+
+	int activecounts = this->checkactiveusers();
+
+	// bots do not play on by themselves
+	if (this->checkactivehumans() == 0) {
+		GAMELOG(INFO, "procstate_restarted, only bots are left at the table.");
+		this->setstate(_GAME_STATE::_CLOSED);
 		return;
 	}
 
-	int activecounts = this->checkactiveusers();
+	if (this->m_tourneyhands != 0 && this->m_hands >= this->m_tourneyhands) {
+		GAMELOG(INFO, "procstate_restarted, the %d hands of the tournament table are played.", this->m_hands);
+		this->setstate(_GAME_STATE::_CLOSED);
+		return;
+	}
 
 	if (activecounts < 3)
 	{
 		if (activecounts == 0 || this->m_hitter == 0 || this->m_counter == 1) {
-			this->msglog(INFO, "procstate_started, players are now less than 3, no hitter and activecounts is %d", activecounts);
+			GAMELOG(INFO, "procstate_started, players are now less than 3, no hitter and activecounts is %d", activecounts);
 			this->setstate(_GAME_STATE::_CLOSED);
 			return;
 		}
 		else {
 			if (this->m_hitter != 0) {
 				if (guser.getuser(this->m_hitter)->isdc()) {
-					this->msglog(INFO, "procstate_started, players are now less than 3, hitter is disconnected and activecounts is %d", activecounts);
+					GAMELOG(INFO, "procstate_started, players are now less than 3, hitter is disconnected and activecounts is %d", activecounts);
 					this->setstate(_GAME_STATE::_CLOSED);
 					return;
 				}
@@ -2599,6 +2859,12 @@ void game::procstate_restarted()
 		}
 	}
 
+	this->dealhand();
+}
+
+// the next hand of a table that plays on, the winner of the last one starts it
+void game::dealhand()
+{
 	// reset user info
 	for (int i = 0; i < MAX_USER_POS; i++) {
 		guser.getuser(this->m_users[i])->reset();
@@ -2611,14 +2877,8 @@ void game::procstate_restarted()
 	this->reset();
 
 	// send reset
-	_PMSG_RESETGAMEINFO pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF1;
-	pMsg.hdr.len = sizeof(_PMSG_RESETGAMEINFO);
-	pMsg.sub = 0x06;
-	for (int i = 0; i < MAX_USER_POS; i++) {
-		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
-	}
+	_PMSG_RESETGAMEINFO pMsg = pkttemplate<_PMSG_RESETGAMEINFO>(0xF1, 0x06);
+	this->broadcast((unsigned char*)&pMsg, pMsg.hdr.len);
 
 	if (!this->checkecoins()) {
 		this->setstate(_GAME_STATE::_CLOSED);
@@ -2647,14 +2907,14 @@ void game::setstate_started(bool isrestarted)
 {
 
 	this->m_active_status = (int)_ACTIVE_STATE::_DRAWN;
-	this->msglog(DEBUG, "%s (%s), Flag active status _DRAWN.", guser.getuser(this->m_active_userindex)->name.c_str(), 
+	GAMELOG(DEBUG, "%s (%s), Flag active status _DRAWN.", guser.getuser(this->m_active_userindex)->name.c_str(), 
 		guser.getuser(this->m_active_userindex)->account.c_str());
 
 
 	this->sendactivestatus();
 
-	guser.getuser(this->m_active_userindex)->activetick = GetTickCount64();
-	this->m_gametick = GetTickCount64() + 1000;
+	guser.getuser(this->m_active_userindex)->activetick = clockmsec();
+	this->m_gametick = clockmsec() + 1000;
 	this->m_counter++;
 
 	// send stock card count
@@ -2664,26 +2924,24 @@ void game::setstate_started(bool isrestarted)
 	this->sendactiveinfo();
 
 	if (this->m_hitter != 0) {
-		this->sendnotice(0, 1, "%s is the Hitter.", guser.getuser(this->m_hitter)->name.c_str());
-		this->msglog(INFO, "%s (%s) is the hitter.", guser.getuser(this->m_hitter)->name.c_str(), guser.getuser(this->m_hitter)->account.c_str());
+		this->sendnotice(0, 1, _NOTICE_ID::_HITTER, guser.getuser(this->m_hitter)->name);
+		GAMELOG(INFO, "%s (%s) is the hitter.", guser.getuser(this->m_hitter)->name.c_str(), guser.getuser(this->m_hitter)->account.c_str());
 	}
 }
 
 void game::setstate_notice()
 {
-	this->m_gametick = GetTickCount64() + NOTICE_SECONDS_DURATION * 1000;
+	this->m_gametick = clockmsec() + NOTICE_SECONDS_DURATION * 1000;
 
 	// send init info
-	_PMSG_INITINFO pMsgResumed = { 0 };
-	pMsgResumed.hdr.c = 0xC1;
-	pMsgResumed.hdr.h = 0xF2;
-	pMsgResumed.hdr.len = sizeof(_PMSG_INITINFO);
-	pMsgResumed.sub = 0x06;
+	_PMSG_INITINFO pMsgResumed = pkttemplate<_PMSG_INITINFO>(0xF2, 0x06);
 	pMsgResumed.init = 1;
 	pMsgResumed.resume = 0;
 	pMsgResumed.ectype = this->m_ectype;
 
 	for (int i = 0; i < 3; i++) {
+		// the seats count their frames from here
+		replaymark(this->m_users[i], true);
 		pMsgResumed.gamepos = i;
 		this->datasend(this->m_users[i], (unsigned char*)&pMsgResumed, pMsgResumed.hdr.len);
 	}
@@ -2698,13 +2956,19 @@ void game::setstate_prepare()
 	this->initdrawcards[0] = 0;
 	this->initdrawcards[1] = 0;
 	this->initdrawcards[2] = 0;
+
+	// a bot has no cards to show, it is ready right away
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		if (guser.getuser(this->m_users[i])->isbot)
+			this->initdrawcards[i] = 1;
+	}
 }
 
 void game::setstate_waiting()
 {
-	this->m_gametick = GetTickCount64() + 1000;
+	this->m_gametick = clockmsec() + 1000;
 	this->m_resumed = false;
-	this->m_resumemsleft = guser.getuser(this->m_active_userindex)->activetick - GetTickCount64();
+	this->m_resumemsleft = guser.getuser(this->m_active_userindex)->activetick - clockmsec();
 	if (this->m_resumemsleft < 0) {
 		this->m_resumemsleft = 0;
 	}
@@ -2717,65 +2981,132 @@ void game::setstate_closed()
 	if (this->m_hitprizeecoins > 0) {
 		for (int i = 0; i < 3; i++) {
 			guser.getuser(this->m_users[i])->ecoins[this->m_ectype] += this->m_hitprizeecoins / 3;
-			this->msglog(INFO, "setstate_closed, %s (%s) received %d ecoins from equally divided hit prize of %d.", 
+			GAMELOG(INFO, "setstate_closed, %s (%s) received %d ecoins from equally divided hit prize of %d.", 
 				guser.getuser(this->m_users[i])->name.c_str(), guser.getuser(this->m_users[i])->account.c_str(), 
 				this->m_hitprizeecoins / 3, this->m_hitprizeecoins);
 		}
 		this->senduserecoinsinfo();
 	}
 
-	this->sendnotice(0, 0, "There has no enough players to continue, ending game...");
-	this->m_gametick = GetTickCount64() + 5000;
+	this->sendnotice(0, 0, _NOTICE_ID::_NOPLAYERS);
+	this->m_gametick = clockmsec() + this->m_timeouts[this->m_ectype].closed;
 }
 
 void game::setstate_ended()
 {
-	this->reset();
+	// the last record of the table, not a turn so the sync seq stays
+	_EVENT_RECORD rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.time = clockwallmsec();
+	rec.serial = this->m_gameserial;
+	rec.delta = this->m_hands;
+	rec.action = EVENT_END;
+	this->m_sink->event(rec);
 
-	this->m_hitprizeecoins = 0;
-	this->m_hitter = 0;
-	this->m_state = _GAME_STATE::_FREE;
-	this->m_counter = 0;
-	this->m_gametick = 0;
-	this->m_active_pos = -1;
-	this->m_winner = 0;
-	this->m_active_userindex = 0;
-	this->m_active_status = (int)_ACTIVE_STATE::_NONE;
+	this->cleartable();
 
 	//this->sendendedinfo();
-	_PMSG_LOGIN_RESULT pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF2;
-	pMsg.hdr.len = sizeof(_PMSG_LOGIN_RESULT);
-	pMsg.sub = 0x09;
-	pMsg.result = 1; // option to create game
-	strcpy(pMsg.ecoinsnote, c.getbetmode(0).name.c_str());
-	strcpy(pMsg.jewelsnote, c.getbetmode(1).name.c_str());
+	_PMSG_LOGIN_RESULT pMsg = c.getbetconf()->loginresult;
 
 	// reset user info
 	for (int i = 0; i < MAX_USER_POS; i++) {
-		if (this->m_usercardinfo[i].iskick == false) {
+		if (guser.getuser(this->m_users[i])->isbot) {
+			// the bot's slot goes back to the free list, its winnings with it
+			guser.delbot(this->m_users[i]);
+		}
+		else if (this->m_usercardinfo[i].iskick == false) {
 			pMsg.isuseradmin = (guser.getuser(this->m_users[i])->isuseradmin) ? 1 : 0;
 			pMsg.ecoins = guser.getuser(this->m_users[i])->ecoins[0];
 			pMsg.jewels = guser.getuser(this->m_users[i])->ecoins[1];
-			strcpy(pMsg.accountid, guser.getuser(this->m_users[i])->account.c_str());
-			::datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
+			guser.getuser(this->m_users[i])->account.copyto(pMsg.accountid);
+			this->m_sink->send(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
 			guser.deluser(this->m_users[i], true);
 			guser.getuser(this->m_users[i])->relog();
+			le_migrateuser(this->m_users[i], 0);
+		}
+		this->m_usercardinfo[i].iskick = false;
+	}
+
+	this->releasetable();
+}
+
+// the target took the table, the players still here are sent after it and the slot is let go without a
+// settlement. the one away finds it through the session directory
+void game::migrated(const std::string& host, unsigned short port)
+{
+	this->cleartable();
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(this->m_users[i]);
+		if (userinfo->isbot) {
+			guser.delbot(this->m_users[i]);
+		}
+		else if (this->m_usercardinfo[i].iskick == false) {
+			if (!userinfo->isdc())
+				clusterresume(this->m_users[i], host, port);
+			guser.deluser(this->m_users[i], true);
+			userinfo->relog();
+			le_migrateuser(this->m_users[i], 0);
 		}
 		this->m_usercardinfo[i].iskick = false;
 	}
 
+	this->releasetable();
+}
+
+void game::cleartable()
+{
+	// the watchers still get what is queued, then the end
+	spectateclose(this);
+	this->reset();
+
+	this->m_hitprizeecoins = 0;
+	this->m_hitter = 0;
+	metricsgamestate((int)this->m_state, (int)_GAME_STATE::_FREE);
+	this->m_state = _GAME_STATE::_FREE;
+	this->m_counter = 0;
+	this->m_syncseq = 0;
+	this->m_gametick = 0;
+	this->m_runusec = 0;
+	this->m_runmaxusec = 0;
+	this->m_runs = 0;
+	this->m_active_pos = -1;
+	this->m_winner = 0;
+	this->m_active_userindex = 0;
+	this->m_active_status = (int)_ACTIVE_STATE::_NONE;
+	this->m_frozentick = 0;
+	this->m_heldtick = 0;
+	this->m_isplayout = false;
+}
+
+void game::releasetable()
+{
 	this->m_users[0] = 0;
 	this->m_users[1] = 0;
 	this->m_users[2] = 0;
 
+	snapshotdrop(this->m_gameserial);
+
+	// told before the slot is given back, so loop 0 is done with the serial before it can be taken again
+	if (this->m_tourneyhands != 0)
+		tourneytabledone(this->m_gameserial);
+	this->m_tourneyhands = 0;
+	this->m_hands = 0;
+
+	// the slot can be taken again only after the owner is done with it
+	this->stoptimer();
+	le_releaseloop(this->m_loop);
+	bool taken = (this->m_loop != -1);
+	this->m_loop = -1;
+	if (taken)
+		gcontrol.freegameslot(this);
+
 }
 
 void game::procstate_notice()
 {
 	// send some notice
-	if (GetTickCount64() < this->m_gametick)
+	if (clockmsec() < this->m_gametick)
 		return;
 
 	// send active info
@@ -2810,7 +3141,7 @@ void game::procstate_prepare()
 {
 	if (this->checkactiveusers() == 0)
 	{
-		this->msglog(INFO, "procstate_started, players are now less than 3, no hitter and activecounts is 0.");
+		GAMELOG(INFO, "procstate_started, players are now less than 3, no hitter and activecounts is 0.");
 		this->setstate(_GAME_STATE::_CLOSED);
 		return;
 	}
@@ -2841,15 +3172,17 @@ void game::procstate_started()
 	if (activecounts < 3)
 	{
 		if (activecounts == 0 && this->m_hitter == 0) {
-			this->msglog(INFO, "procstate_started, players are now less than 3, no hitter and activecounts is %d", activecounts);
+			GAMELOG(INFO, "procstate_started, players are now less than 3, no hitter and activecounts is %d", activecounts);
 			this->setstate(_GAME_STATE::_CLOSED);
 			return;
 		}
 	}
 
+	this->botplay();
+
 	if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT) {
 
-		if (GetTickCount64() > this->m_gametick) {
+		if (clockmsec() > this->m_gametick) {
 
 			uintptr_t winuser = 0;
 			int cardcount = 120;
@@ -2884,7 +3217,7 @@ void game::procstate_started()
 			}
 
 			this->m_active_status |= (int)_ACTIVE_STATE::_RESET;
-			this->msglog(DEBUG, "%s (%s), Flag active status _RESET.", guser.getuser(this->m_active_userindex)->name.c_str(), 
+			GAMELOG(DEBUG, "%s (%s), Flag active status _RESET.", guser.getuser(this->m_active_userindex)->name.c_str(), 
 				guser.getuser(this->m_active_userindex)->account.c_str());
 			this->m_winner = winuser;
 			this->getwinner();
@@ -2894,18 +3227,14 @@ void game::procstate_started()
 	else if (this->m_active_status & (int)_ACTIVE_STATE::_STOCKZERO) {
 
 		// should drop card next
-		if (!(this->m_active_status & (int)_ACTIVE_STATE::_DROPPED) && 
-			guser.getuser(this->m_active_userindex)->activetick != 0 &&
-			GetTickCount64() > (guser.getuser(this->m_active_userindex)->activetick + MAX_MSECONDS_EACHTURN_TIMEOUT)) { // drop timeout, should auto drop random from ungrouped cards
-			// auto drop random cards
-			unsigned char cc[2] = { 0 };
-			this->chooserandomcard(this->m_active_userindex, cc);
-			this->dropcard(this->m_active_userindex, cc);
+		if (!(this->m_active_status & (int)_ACTIVE_STATE::_DROPPED) && this->isautoturn()) {
+			guser.getuser(this->m_active_userindex)->isauto = true;
+			this->autoplay(this->m_active_userindex);
 		}
 
 		// auto check winner in this stage
 
-		if (GetTickCount64() > this->m_gametick) {
+		if (clockmsec() > this->m_gametick) {
 
 			uintptr_t winuser = 0;
 			int cardcount = 120;
@@ -2916,9 +3245,7 @@ void game::procstate_started()
 			bool allnodown = true;
 
 			for (int i = 0; i < MAX_USER_POS; i++) {
-				if (guser.getuser(this->m_users[i])->m_isdowncard == true || 
-					guser.getuser(this->m_users[i])->m_quadracount > 0 || 
-					guser.getuser(this->m_users[i])->m_royalcount > 0) {
+				if ((this->*this->rules()->isdown)(guser.getuser(this->m_users[i]))) {
 					allnodown = false;
 					break;
 				}
@@ -2926,8 +3253,7 @@ void game::procstate_started()
 
 			for (int i = 0; i < MAX_USER_POS; i++) {
 				
-				if (allnodown == false && guser.getuser(this->m_users[i])->m_isdowncard == false 
-					&& guser.getuser(this->m_users[i])->m_quadracount == 0 && guser.getuser(this->m_users[i])->m_royalcount == 0)
+				if (allnodown == false && !(this->*this->rules()->isdown)(guser.getuser(this->m_users[i])))
 					continue;
 
 				if (this->m_usercardinfo[i].iskick == true)
@@ -2956,7 +3282,7 @@ void game::procstate_started()
 			}
 
 			this->m_active_status |= (int)_ACTIVE_STATE::_RESET;
-			this->msglog(DEBUG, "%s (%s), Flag active status _RESET.", guser.getuser(this->m_active_userindex)->name.c_str(), 
+			GAMELOG(DEBUG, "%s (%s), Flag active status _RESET.", guser.getuser(this->m_active_userindex)->name.c_str(), 
 				guser.getuser(this->m_active_userindex)->account.c_str());
 			this->m_winner = winuser;
 			this->getwinner();
@@ -2966,10 +3292,7 @@ void game::procstate_started()
 	else {
 		if (this->m_active_status & (int)_ACTIVE_STATE::_DROPPED) {
 
-			if (guser.getuser(this->m_active_userindex)->activetick != 0 &&
-				GetTickCount64() > (guser.getuser(this->m_active_userindex)->activetick + MAX_MSECONDS_EACHTURN_TIMEOUT)) {
-				guser.getuser(this->m_active_userindex)->isauto = false; // set auto to disable
-			}
+			guser.getuser(this->m_active_userindex)->isauto = false; // the auto play ends with the turn
 
 			this->m_active_pos++;
 			if (this->m_active_pos >= MAX_USER_POS)
@@ -2978,47 +3301,243 @@ void game::procstate_started()
 			this->m_active_userindex = this->m_users[this->m_active_pos];
 
 			this->m_active_status = (int)_ACTIVE_STATE::_NONE;
-			this->msglog(DEBUG, "%s (%s), Flag active status NONE.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
+			GAMELOG(DEBUG, "%s (%s), Flag active status NONE.", guser.getuser(this->m_active_userindex)->name.c_str(), guser.getuser(this->m_active_userindex)->account.c_str());
 			if(guser.getuser(this->m_active_userindex)->isdc() || this->m_usercardinfo[this->m_active_pos].iskick == true)
-				guser.getuser(this->m_active_userindex)->activetick = GetTickCount64() - MAX_MSECONDS_EACHTURN_TIMEOUT + 5;
+				guser.getuser(this->m_active_userindex)->activetick = clockmsec() - this->getturnmsec(this->m_active_userindex) + 5;
 			else
-				guser.getuser(this->m_active_userindex)->activetick = GetTickCount64();
+				guser.getuser(this->m_active_userindex)->activetick = clockmsec();
 
 			this->sendactiveinfo();
 		}
-		else {
+		else if (this->isautoturn()) {
+			// the auto flag bypasses the action time check and keeps the client's requests out until the turn is over
+			guser.getuser(this->m_active_userindex)->isauto = true;
+			this->autoplay(this->m_active_userindex);
+		}
+	}
+}
 
-			if (!(this->m_active_status & (int)_ACTIVE_STATE::_DRAWN) && !(this->m_active_status & (int)_ACTIVE_STATE::_CHOWED)) {
-				// should draw and drop card next
+// a player who is gone is played for at once, one who is there after the turn timed out
+bool game::isautoturn()
+{
+	_USER_INFO* active = guser.getuser(this->m_active_userindex);
 
-				if (guser.getuser(this->m_active_userindex)->activetick != 0 &&
-					GetTickCount64() > (guser.getuser(this->m_active_userindex)->activetick + MAX_MSECONDS_EACHTURN_TIMEOUT)) { // timeout, should auto draw and drop random from ungrouped cards
-					// set the user auto flag first to true to bypass action time check
-					guser.getuser(this->m_active_userindex)->isauto = true;
-					// auto draw
-					this->drawfromstock(this->m_active_userindex);
-					return;
-				}
+	if (active == NULL || active->activetick == 0)
+		return false;
+
+	if (active->isdc() || this->m_usercardinfo[this->m_active_pos].iskick)
+		return true;
+
+	return clockmsec() > active->activetick + this->getturnmsec(this->m_active_userindex);
+}
+
+// turn length of a seat, a player who keeps playing fast gets a shorter one when the bet mode asks for it
+uint64_t game::getturnmsec(uintptr_t userindex)
+{
+	const _GAME_TIMEOUTS& timeouts = this->m_timeouts[this->m_ectype];
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (!timeouts.isadaptive || userinfo == NULL || userinfo->turnmsec == 0)
+		return timeouts.turn;
+
+	uint64_t msec = (uint64_t)userinfo->turnmsec * ADAPTIVE_TURN_FACTOR;
+	if (msec < (uint64_t)timeouts.minturn)
+		msec = timeouts.minturn;
+	if (msec > (uint64_t)timeouts.turn)
+		msec = timeouts.turn;
+	return msec;
+}
+
+// the bots answer a fight at once, the active one calls one or plays its turn after "Bot Think Msec"
+void game::botplay()
+{
+	if (this->m_active_status & (int)_ACTIVE_STATE::_FOUGHT) {
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			_USER_INFO* userinfo = guser.getuser(this->m_users[i]);
+			if (!userinfo->isbot || userinfo->fought || !userinfo->canfight)
+				continue;
+			if (this->m_usercardinfo[i].count.points <= BOT_FIGHT_POINTS)
+				this->fight2card(this->m_users[i], 1);
+		}
+		return;
+	}
+
+	uintptr_t userindex = this->m_active_userindex;
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || !userinfo->isbot || userinfo->activetick == 0 ||
+		clockmsec() < userinfo->activetick + c.getbotthinkmsec())
+		return;
+
+	if (this->m_active_status & (int)_ACTIVE_STATE::_DROPPED)
+		return;
+
+	// the rollouts wake the table when they are done
+	if (this->m_rollout != NULL && this->m_rollout->userindex == userindex && !this->m_rollout->isdone)
+		return;
+
+	// a low hand calls the fight instead of playing the turn
+	if (this->m_active_status == (int)_ACTIVE_STATE::_NONE && userinfo->m_isdowncard && userinfo->canfight &&
+		!userinfo->fought && this->m_usercardinfo[userinfo->m_gamepos].count.points <= BOT_FIGHT_POINTS) {
+		if (this->fightcard(userindex))
+			return;
+	}
+
+	this->autoplay(userindex);
+}
+
+// the rest of the active seat's turn, for a bot or a player who is not there to play it. every move goes
+// through the same action as a client's request, so the rules and the packets are the same
+void game::autoplay(uintptr_t userindex)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+	_USER_CARD_INFO& info = this->m_usercardinfo[userinfo->m_gamepos];
+	_PMSG_CARD_INFO cards[MAX_DECK_CARDS];
+	int count;
+
+	if (!(this->m_active_status & ((int)_ACTIVE_STATE::_DRAWN | (int)_ACTIVE_STATE::_CHOWED))) {
+
+		// the last drop of the previous seat when it makes a meld, the stock otherwise
+		bool ischowed = false;
+		unsigned char droppos = (userinfo->m_gamepos == 0) ? 2 : userinfo->m_gamepos - 1;
+
+		if (!this->vDroppedCards.empty() && this->vDroppedCards.back().userpos == droppos) {
+			_PMSG_CARD_INFO drop = this->vDroppedCards.back().card;
+			_CARD_MASK dropmask = cardmask(drop.cardtype, drop.cardnum);
+			_CARD_MASK meld = botchowmeld(info.mask, dropmask);
+			if (meld != 0) {
+				count = botcardlist(meld & ~dropmask, cards);
+				ischowed = this->chowcard(userindex, droppos, (unsigned char*)&drop, count, (unsigned char*)cards);
 			}
+		}
 
-			if (!(this->m_active_status & (int)_ACTIVE_STATE::_DROPPED)) {
-				// should drop card
-				if (guser.getuser(this->m_active_userindex)->activetick != 0 &&
-					GetTickCount64() > (guser.getuser(this->m_active_userindex)->activetick + MAX_MSECONDS_EACHTURN_TIMEOUT)) { // drop timeout, should auto drop random from ungrouped cards
-					// auto drop random cards
-					unsigned char cc[2] = { 0 };
-					this->chooserandomcard(this->m_active_userindex, cc);
-					this->dropcard(this->m_active_userindex, cc);
-					return;
+		if (!ischowed && !this->drawfromstock(userindex))
+			return;
+	}
+
+	if (this->m_winner != 0 || this->m_state != _GAME_STATE::_STARTED)
+		return;
+
+	// one down in a round, the best meld of the hand
+	if (!userinfo->m_isdowncard) {
+		_CARD_MASK meld = botbestmeld(info.mask);
+		if (meld != 0) {
+			count = botcardlist(meld, cards);
+			this->downcards(userindex, count, (unsigned char*)cards);
+		}
+	}
+
+	// single cards onto any down they extend
+	bool issapaw = true;
+	while (issapaw && this->m_winner == 0 && this->m_state == _GAME_STATE::_STARTED) {
+		issapaw = false;
+		for (_CARD_MASK m = info.mask; m != 0 && !issapaw; m &= m - 1) {
+			_CARD_MASK card = m & (0 - m);
+			for (int userpos = 0; userpos < MAX_USER_POS && !issapaw; userpos++) {
+				_MELD_LIST& down = this->m_usercardinfo[userpos].down;
+				for (int downpos = 0; downpos < (int)down.size() && !issapaw; downpos++) {
+					if (!cardismeld(this->getselectmask(down[downpos].count, (unsigned char*)down[downpos].items) | card))
+						continue;
+					botcardlist(card, cards);
+					issapaw = this->sapawcard(userindex, userpos, downpos, 1, (unsigned char*)cards);
 				}
 			}
 		}
 	}
+
+	if (this->m_winner != 0 || this->m_state != _GAME_STATE::_STARTED)
+		return;
+
+	// the drop that leaves the fewest points out of melds, the melds that leave them are grouped so they do
+	// not count. a drop refused goes on to the next one, a meld grouped for it already stays
+	_BOT_DISCARD discards[MAX_DECK_CARDS];
+	int discardcount = botdiscards(info.mask, discards);
+	if (userinfo->isrollout && !userinfo->isauto && !this->botrollout(userindex, discards, discardcount))
+		return;
+	for (int n = 0; n < discardcount; n++) {
+		for (int m = 0; m < discards[n].meldcount; m++) {
+			if ((info.mask & discards[n].melds[m]) != discards[n].melds[m])
+				continue;
+			count = botcardlist(discards[n].melds[m], cards);
+			this->groupcards(userindex, count, (unsigned char*)cards);
+		}
+		if (this->dropcard(userindex, (unsigned char*)&discards[n].card))
+			return;
+	}
+
+	// nothing could be dropped, a random card as it always was
+	unsigned char cc[2] = { 0 };
+	if (this->chooserandomcard(userindex, cc))
+		this->dropcard(userindex, cc);
+}
+
+// a bot that weighs its drop starts the rollouts of the turn and leaves it to botplay until they are
+// done, then the drop they picked goes first. false while they run
+bool game::botrollout(uintptr_t userindex, _BOT_DISCARD* discards, int count)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+	std::shared_ptr<_BOT_ROLLOUT> rollout = this->m_rollout;
+	int msec = c.getbotrolloutmsec();
+
+	if (msec <= 0 || count <= 1)
+		return true;
+
+	bool isturn = rollout != NULL && rollout->userindex == userindex && rollout->hands == this->m_hands &&
+		rollout->view.hand == this->m_usercardinfo[userinfo->m_gamepos].mask;
+
+	if (!isturn) {
+		this->botrolloutcancel();
+		rollout = std::make_shared<_BOT_ROLLOUT>();
+		rollout->g = this;
+		rollout->userindex = userindex;
+		rollout->hands = this->m_hands;
+
+		_BOT_VIEW& view = rollout->view;
+		view.seat = userinfo->m_gamepos;
+		view.hand = this->m_usercardinfo[view.seat].mask;
+		view.unseen = 0;
+		view.stockcount = this->countstockcards();
+		view.downcount = 0;
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			const _USER_CARD_INFO& info = this->m_usercardinfo[i];
+			view.handcounts[i] = cardpopcount(info.mask);
+			view.isdown[i] = (this->*this->rules()->isdown)(guser.getuser(this->m_users[i]));
+			if (i != view.seat)
+				view.unseen |= info.mask;
+			for (int downpos = 0; downpos < (int)info.down.size() && view.downcount < MAX_MELDS; downpos++)
+				view.downs[view.downcount++] = this->getselectmask(info.down[downpos].count, (unsigned char*)info.down[downpos].items);
+		}
+		for (int n = this->m_stocktop; n < (int)this->vStockCards.size(); n++)
+			view.unseen |= cardmask(this->vStockCards[n].cardtype, this->vStockCards[n].cardnum);
+		view.candidatecount = std::min(count, BOT_ROLLOUT_CANDIDATES);
+		for (int n = 0; n < view.candidatecount; n++)
+			view.candidates[n] = cardmask(discards[n].card.cardtype, discards[n].card.cardnum);
+
+		this->m_rollout = rollout;
+		botrolloutstart(rollout, msec, this->m_rng);
+	}
+
+	if (!rollout->isdone)
+		return false;
+
+	// the drop picked first, the others keep their order behind it
+	std::rotate(discards, discards + rollout->best, discards + rollout->best + 1);
+	return true;
+}
+
+// the table lets go of the search, what it finds is thrown away
+void game::botrolloutcancel()
+{
+	if (this->m_rollout == NULL)
+		return;
+	this->m_rollout->g = NULL;
+	this->m_rollout.reset();
 }
 
 void game::procstate_closed()
 {
-	if (GetTickCount64() < this->m_gametick) {
+	// the notice is only waited on by someone who can read it
+	if (clockmsec() < this->m_gametick && this->checkactivehumans() > 0) {
 		return;
 	}
 	this->setstate(_GAME_STATE::_ENDED);
@@ -3039,7 +3558,7 @@ void game::sendbothcardstouser(uintptr_t userindex)
 	pMsg.userpos = userpos;
 	size = sizeof(_PMSG_SHOW_USERCARDS);
 
-	std::vector <_PMSG_CARD_INFO>::iterator iter;
+	_CARD_PILE::iterator iter;
 
 	iter = this->m_usercardinfo[userpos].user.begin();
 
@@ -3057,7 +3576,7 @@ void game::sendbothcardstouser(uintptr_t userindex)
 	memcpy(&buffer[0], (unsigned char*)&pMsg, sizeof(_PMSG_SHOW_USERCARDS));
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
-		if (this->m_users[i] != userindex) {
+		if ((uintptr_t)this->m_users[i] != userindex) {
 			this->datasend(this->m_users[i], buffer, pMsg.hdr.len);
 		}
 	}
@@ -3069,13 +3588,13 @@ void game::sendbothcardstouser(uintptr_t userindex)
 	pMsg2.userpos = userpos;
 	pMsg2.count = 0;
 
-	std::vector<std::vector <_PMSG_CARD_INFO>>::iterator iter2;// group;
+	_MELD_LIST::iterator iter2;// group;
 
 
 	for (iter2 = this->m_usercardinfo[userpos].group.begin(); iter2 != this->m_usercardinfo[userpos].group.end(); iter2++) {
 
-		std::vector <_PMSG_CARD_INFO> v = *iter2;
-		std::vector <_PMSG_CARD_INFO>::iterator iter3;
+		_MELD v = *iter2;
+		_CARD_PILE::iterator iter3;
 
 		size2 = sizeof(_PMSG_SHOW_GRPCARDS);
 		pMsg2.count = 0;
@@ -3083,7 +3602,7 @@ void game::sendbothcardstouser(uintptr_t userindex)
 		for (iter3 = v.begin(); iter3 != v.end(); iter3++) {
 
 			_PMSG_CARD_INFO cc = *iter3;
-			this->msglog(DEBUG, "%s (%s) grp card %d %d", guser.getuser(userindex)->name.c_str(), guser.getuser(userindex)->account.c_str(), cc.cardtype, cc.cardnum);
+			GAMELOG(DEBUG, "%s (%s) grp card %d %d", guser.getuser(userindex)->name.c_str(), guser.getuser(userindex)->account.c_str(), cc.cardtype, cc.cardnum);
 			memcpy(&buffer2[size2], (unsigned char*)&cc, sizeof(_PMSG_CARD_INFO));
 			size2 += sizeof(_PMSG_CARD_INFO);
 			pMsg2.count++;
@@ -3094,7 +3613,7 @@ void game::sendbothcardstouser(uintptr_t userindex)
 		memcpy(&buffer2[0], (unsigned char*)&pMsg2, sizeof(_PMSG_SHOW_GRPCARDS));
 
 		for (int i = 0; i < MAX_USER_POS; i++) {
-			if (this->m_users[i] != userindex) {
+			if ((uintptr_t)this->m_users[i] != userindex) {
 				this->datasend(this->m_users[i], buffer2, pMsg2.hdr.len);
 			}
 		}
@@ -3108,12 +3627,12 @@ void game::senddowncards(uintptr_t userindex)
 	pMsg.hdr.c = 0xC1;
 	pMsg.hdr.h = 0xF3;
 
-	std::vector<_PMSG_CARD_INFO>::iterator iter;
+	_CARD_PILE::iterator iter;
 
 	for (int userpos = 0; userpos < 3; userpos++) {
 
-		for (int downpos = 0; downpos < this->m_usercardinfo[userpos].down.size(); downpos++) {
-			std::vector<_PMSG_CARD_INFO> _v = this->m_usercardinfo[userpos].down[downpos];
+		for (int downpos = 0; downpos < (int)this->m_usercardinfo[userpos].down.size(); downpos++) {
+			_MELD _v = this->m_usercardinfo[userpos].down[downpos];
 
 			int size = sizeof(_PMSG_DOWNCARD_ANS);
 
@@ -3143,10 +3662,10 @@ void game::sendgroupcards(uintptr_t userindex) {
 	pMsg.hdr.c = 0xC1;
 	pMsg.hdr.h = 0xF3;
 
-	std::vector<_PMSG_CARD_INFO>::iterator iter;
+	_CARD_PILE::iterator iter;
 
-	for (int downpos = 0; downpos < this->m_usercardinfo[_pos].group.size(); downpos++) {
-		std::vector<_PMSG_CARD_INFO> _v = this->m_usercardinfo[_pos].group[downpos];
+	for (int downpos = 0; downpos < (int)this->m_usercardinfo[_pos].group.size(); downpos++) {
+		_MELD _v = this->m_usercardinfo[_pos].group[downpos];
 
 		int size = sizeof(_PMSG_GRPCARD_ANS);
 
@@ -3166,6 +3685,150 @@ void game::sendgroupcards(uintptr_t userindex) {
 	}
 }
 
+// the resume state of one player in a single frame, only sent to v2 apps since the body is already compact
+void game::sendsyncinfo(uintptr_t userindex)
+{
+	static thread_local std::vector<unsigned char> buf;
+
+	unsigned char _pos = guser.getuser(userindex)->m_gamepos;
+
+	_PMSG_DEF_SUB pMsg = { 0 };
+	pMsg.hdr.c = 0xC1;
+	pMsg.hdr.h = 0xF2;
+	pMsg.sub = WIRE_SYNC_SUB;
+
+	buf.clear();
+	buf.insert(buf.end(), (unsigned char*)&pMsg, (unsigned char*)&pMsg + sizeof(pMsg));
+
+	unsigned int msecleft = guser.getuser(this->m_active_userindex)->activetick + this->getturnmsec(this->m_active_userindex) - clockmsec();
+	int hitterpos = (this->m_hitter == 0) ? -1 : guser.getuser(this->m_hitter)->m_gamepos;
+	int counter = this->m_counter;
+
+	wirevarint(buf, this->m_syncseq);
+	buf.push_back(_pos);
+	buf.push_back(this->m_ectype);
+	buf.push_back((unsigned char)this->getstate());
+	buf.push_back((unsigned char)this->m_active_pos);
+	wirevarint(buf, msecleft);
+	wirevarint(buf, ((uint32_t)hitterpos << 1) ^ (uint32_t)(hitterpos >> 31));
+	wirevarint(buf, ((uint32_t)counter << 1) ^ (uint32_t)(counter >> 31));
+	wirevarint(buf, (uint32_t)this->m_hitprizeecoins);
+	buf.push_back((unsigned char)this->countstockcards());
+
+	this->countusercards(userindex);
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* user = guser.getuser(this->m_users[i]);
+
+		if (user->ecoins[this->m_ectype] < 0)
+			user->ecoins[this->m_ectype] = 0;
+
+		size_t n = strnlen(user->name.c_str(), sizeof(((_PMSG_USERNAMEINFO*)0)->name));
+		wirevarint(buf, (uint32_t)n);
+		buf.insert(buf.end(), user->name.c_str(), user->name.c_str() + n);
+		wirevarint(buf, (uint32_t)user->ecoins[this->m_ectype]);
+		wirevarint(buf, (uint32_t)user->m_cardquantity);
+
+		buf.push_back((unsigned char)this->m_usercardinfo[i].down.size());
+		for (int downpos = 0; downpos < (int)this->m_usercardinfo[i].down.size(); downpos++) {
+			_MELD& _v = this->m_usercardinfo[i].down[downpos];
+			wirecards(buf, (const unsigned char*)_v.begin(), NULL, _v.size());
+		}
+	}
+	guser.saveecoins(userindex, this->m_ectype);
+
+	_CARD_PILE hand;
+	_CARD_PILE::iterator iter;
+	for (iter = this->m_usercardinfo[_pos].user.begin(); iter != this->m_usercardinfo[_pos].user.end(); iter++) {
+		if (iter->cardtype != 0)
+			hand.push_back(*iter);
+	}
+	wirecards(buf, (const unsigned char*)hand.begin(), NULL, hand.size());
+
+	buf.push_back((unsigned char)this->m_usercardinfo[_pos].group.size());
+	for (int grppos = 0; grppos < (int)this->m_usercardinfo[_pos].group.size(); grppos++) {
+		_MELD& _v = this->m_usercardinfo[_pos].group[grppos];
+		wirecards(buf, (const unsigned char*)_v.begin(), NULL, _v.size());
+	}
+
+	wirevarint(buf, (uint32_t)this->vDroppedCards.size());
+	_DROP_PILE::iterator drop;
+	for (drop = this->vDroppedCards.begin(); drop != this->vDroppedCards.end(); drop++) {
+		buf.push_back(drop->userpos);
+		buf.push_back(drop->pos);
+		buf.push_back(wirecard(drop->card.cardtype, drop->card.cardnum));
+	}
+
+	if (buf.size() > 0xFFFF) {
+		GAMELOG(ERROR, "sendsyncinfo, snapshot of %d bytes does not fit a frame", (int)buf.size());
+		return;
+	}
+	((_PMSG_DEF_SUB*)buf.data())->hdr.len = (unsigned short)buf.size();
+
+	guser.getuser(userindex)->m_gamedropctr = 0;
+	guser.getuser(userindex)->resumed();
+
+	this->datasend(userindex, buf.data(), (int)buf.size());
+}
+
+// the public table as the packets a player gets, no hand or group of anyone. taken for the watchers
+// that start or fell behind
+void game::spectatesnapshot(std::vector<unsigned char>& buf)
+{
+	if (this->m_isseatpktsdirty)
+		this->buildseatpkts();
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* user = guser.getuser(this->m_users[i]);
+		const _PMSG_USERNAMEINFO* pName = &this->m_namepkts[i];
+		buf.insert(buf.end(), (const unsigned char*)pName, (const unsigned char*)pName + pName->hdr.len);
+
+		_PMSG_USERECOINSINFO pEcoins = pkttemplate<_PMSG_USERECOINSINFO>(0xF1, 0x04);
+		pEcoins.gamepos = i;
+		pEcoins.ecoins = std::max(user->ecoins[this->m_ectype], 0);
+		buf.insert(buf.end(), (unsigned char*)&pEcoins, (unsigned char*)&pEcoins + pEcoins.hdr.len);
+
+		const _PMSG_USERCARDSINFO* pCount = &this->m_cardpkts[i];
+		buf.insert(buf.end(), (const unsigned char*)pCount, (const unsigned char*)pCount + pCount->hdr.len);
+	}
+
+	_PMSG_CARD_STOCKINFO pStock = pkttemplate<_PMSG_CARD_STOCKINFO>(0xF1, 0x01);
+	pStock.stockcount = this->countstockcards();
+	buf.insert(buf.end(), (unsigned char*)&pStock, (unsigned char*)&pStock + pStock.hdr.len);
+
+	_DROP_PILE::iterator drop;
+	for (drop = this->vDroppedCards.begin(); drop != this->vDroppedCards.end(); drop++) {
+		_PMSG_DROP_CARD_ANS pDrop = pkttemplate<_PMSG_DROP_CARD_ANS>(0xF3, 0x01);
+		pDrop.pos = drop->pos;
+		pDrop.userpos = drop->userpos;
+		pDrop.cardtype = drop->card.cardtype;
+		pDrop.cardnum = drop->card.cardnum;
+		buf.insert(buf.end(), (unsigned char*)&pDrop, (unsigned char*)&pDrop + pDrop.hdr.len);
+	}
+
+	for (int userpos = 0; userpos < MAX_USER_POS; userpos++) {
+		for (int downpos = 0; downpos < (int)this->m_usercardinfo[userpos].down.size(); downpos++) {
+			_MELD& _v = this->m_usercardinfo[userpos].down[downpos];
+			_PMSG_DOWNCARD_ANS pDown = pkttemplate<_PMSG_DOWNCARD_ANS>(0xF3, 0x03);
+			pDown.hdr.len = (unsigned short)(sizeof(_PMSG_DOWNCARD_ANS) + _v.size() * sizeof(_PMSG_CARD_INFO));
+			pDown.count = _v.size();
+			pDown.downpos = downpos;
+			pDown.gamepos = userpos;
+			buf.insert(buf.end(), (unsigned char*)&pDown, (unsigned char*)&pDown + sizeof(_PMSG_DOWNCARD_ANS));
+			buf.insert(buf.end(), (unsigned char*)_v.begin(), (unsigned char*)_v.end());
+		}
+	}
+
+	_PMSG_ACTIVEINFO pActive = pkttemplate<_PMSG_ACTIVEINFO>(0xF1, 0x02);
+	pActive.activeuserpos = this->m_active_pos;
+	pActive.timelimit_msec = guser.getuser(this->m_active_userindex)->activetick + this->getturnmsec(this->m_active_userindex) - clockmsec();
+	pActive.activegamestate = (unsigned char)this->getstate();
+	pActive.activegamecounter = this->m_counter;
+	pActive.activehitprizeecoins = this->m_hitprizeecoins;
+	pActive.activehitteruserpos = (this->m_hitter == 0) ? -1 : guser.getuser(this->m_hitter)->m_gamepos;
+	buf.insert(buf.end(), (unsigned char*)&pActive, (unsigned char*)&pActive + pActive.hdr.len);
+}
+
 void game::sendinitusercards()
 {
 	unsigned char pos = this->m_hitter ? guser.getuser(this->m_hitter)->m_gamepos : 0;
@@ -3184,7 +3847,7 @@ void game::sendinitusercards()
 
 			_PMSG_CARD_INFO card = this->m_usercardinfo[pos].user[n];
 
-			this->msglog(DEBUG, "sendinitusercards, pos %d n %d card %d %d", pos, n, card.cardtype, card.cardnum);
+			GAMELOG(DEBUG, "sendinitusercards, pos %d n %d card %d %d", pos, n, card.cardtype, card.cardnum);
 
 			_PMSG_DRAW_CARD_ANS pMsg = { 0 };
 			pMsg.hdr.c = 0xC1;
@@ -3208,6 +3871,10 @@ void game::sendinitusercards()
 				}
 			}
 
+			pMsg.cardtype = 0;
+			pMsg.cardnum = 0;
+			this->spectate((unsigned char*)&pMsg, pMsg.hdr.len);
+
 			pos += 1;
 			if (pos >= 3)
 				pos = 0;
@@ -3227,7 +3894,7 @@ void game::sendusercards(uintptr_t userindex, bool isresumed)
 	pMsg.data.sub = 0;
 	pMsg.data.userpos = _pos;
 
-	std::vector <_PMSG_CARD_INFO>::iterator iter;
+	_CARD_PILE::iterator iter;
 
 	iter = this->m_usercardinfo[_pos].user.begin();
 	while (iter != this->m_usercardinfo[_pos].user.end()) {
@@ -3255,10 +3922,13 @@ void game::sendstockcardcount(uintptr_t userindex)
 	pMsg.stockcount = this->countstockcards();
 
 	for (int i = 0; i < MAX_USER_POS; i++) {
-		if (userindex != 0 && userindex != this->m_users[i])
+		if (userindex != 0 && userindex != (uintptr_t)this->m_users[i])
 			continue;
 		this->datasend(this->m_users[i], (unsigned char*)&pMsg, pMsg.hdr.len);
 	}
+
+	if (userindex == 0)
+		this->spectate((unsigned char*)&pMsg, pMsg.hdr.len);
 }
 
 void game::sendshuffledcards()
@@ -3277,7 +3947,7 @@ int game::getposfromdropcard(unsigned char userpos, unsigned char* card)
 	if (card == NULL)
 		return -1;
 
-	std::vector<_DROPCARD_INFO>::iterator iter;// vDroppedCards
+	_DROP_PILE::iterator iter;// vDroppedCards
 	for (iter = this->vDroppedCards.begin(); iter != this->vDroppedCards.end(); iter++) {
 		_DROPCARD_INFO dropinfo = *iter;
 		if (dropinfo.userpos == userpos && card[0] == dropinfo.card.cardtype && card[1] == dropinfo.card.cardnum) {
@@ -3288,6 +3958,21 @@ int game::getposfromdropcard(unsigned char userpos, unsigned char* card)
 	return -1;
 }
 
+_CARD_MASK game::getselectmask(unsigned char count, unsigned char* cardpos)
+{
+	_CARD_MASK mask = 0;
+
+	if (cardpos == NULL)
+		return 0;
+
+	for (int n = 0; n < count; n++) {
+		_PMSG_CARD_INFO* _card = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
+		mask |= cardmask(_card->cardtype, _card->cardnum);
+	}
+
+	return mask;
+}
+
 int game::getposfromusercard(uintptr_t userindex, unsigned char* card)
 {
 	int pos = 0;
@@ -3296,7 +3981,10 @@ int game::getposfromusercard(uintptr_t userindex, unsigned char* card)
 	if (card == NULL)
 		return -1;
 
-	std::vector <_PMSG_CARD_INFO>::iterator _iter;
+	if ((this->m_usercardinfo[_pos].mask & cardmask(card[0], card[1])) == 0)
+		return -1;
+
+	_CARD_PILE::iterator _iter;
 	for (_iter = this->m_usercardinfo[_pos].user.begin(); _iter != this->m_usercardinfo[_pos].user.end(); _iter++) {
 		_PMSG_CARD_INFO _c = *_iter;
 		if (card[0] == _c.cardtype && card[1] == _c.cardnum) {
@@ -3349,7 +4037,7 @@ bool game::movecardpos(uintptr_t userindex, unsigned char group, unsigned char*
 
 	int _targetpos = this->getposfromusercard(userindex, targetpos);
 
-	this->msglog(DEBUG, "movecardpos, source pos %d target pos %d.", _srcpos, _targetpos);
+	GAMELOG(DEBUG, "movecardpos, source pos %d target pos %d.", _srcpos, _targetpos);
 
 	if (_srcpos == -1 || _targetpos == -1)
 		return false;
@@ -3381,16 +4069,116 @@ bool game::movecardpos(uintptr_t userindex, unsigned char group, unsigned char*
 	return true;
 }
 
+bool game::sethandorder(uintptr_t userindex, unsigned char count, unsigned char* cardpos)
+{
+	unsigned char _pos = guser.getuser(userindex)->m_gamepos;
+	_USER_CARD_INFO& info = this->m_usercardinfo[_pos];
+
+	// every card of the hand once, the mask holds the same cards as the hand
+	_CARD_MASK selmask = this->getselectmask(count, cardpos);
+	if (count != info.user.size() || selmask != info.mask || cardpopcount(selmask) != count) {
+		GAMELOG(DEBUG, "sethandorder, %d cards are not the %d of the hand.", count, (int)info.user.size());
+		this->sendusercards(userindex);
+		return false;
+	}
+
+	for (int n = 0; n < count; n++) {
+		_PMSG_CARD_INFO* _card = (_PMSG_CARD_INFO*)(cardpos + (n * sizeof(_PMSG_CARD_INFO)));
+		info.user[n].cardtype = _card->cardtype;
+		info.user[n].cardnum = _card->cardnum;
+	}
+
+	this->sendusercards(userindex);
+	return true;
+}
+
+bool game::groupbatch(uintptr_t userindex, bool isungroup, const unsigned char* sizes, unsigned char count, unsigned char* cardpos)
+{
+	if (isactionvalid(userindex, _ACTIONS::_GROUP) == false)
+		return false;
+
+	unsigned char _pos = guser.getuser(userindex)->m_gamepos;
+	_USER_CARD_INFO& info = this->m_usercardinfo[_pos];
+
+	// the cards the groups may take, the hand and the groups that go back to it first
+	_CARD_MASK handmask = info.mask;
+	if (isungroup) {
+		for (size_t downpos = 0; downpos < info.group.size(); downpos++)
+			handmask |= this->getselectmask((unsigned char)info.group[downpos].size(), (unsigned char*)info.group[downpos].items);
+	}
+
+	int groups = 0;
+	int offset = 0;
+	while (groups < GRPBATCH_MAX_GROUPS && sizes[groups] != 0) {
+		int size = sizes[groups];
+		if (size < 3 || size >= MAX_CARDS_PER_TYPE || offset + size > count ||
+			!cardismeld(this->getselectmask(size, cardpos + offset * sizeof(_PMSG_CARD_INFO)))) {
+			GAMELOG(DEBUG, "groupbatch, group %d of %d cards is not a meld.", groups, size);
+			return false;
+		}
+		offset += size;
+		groups++;
+	}
+
+	// a grouped card is taken once, each group is a new one after the groups there are
+	_CARD_MASK selmask = this->getselectmask(count, cardpos);
+	if (offset != count || cardpopcount(selmask) != count || (selmask & ~handmask) != 0 ||
+		info.group.size() + groups > MAX_MELDS) {
+		GAMELOG(DEBUG, "groupbatch, %d cards of %d groups are not of the hand.", count, groups);
+		return false;
+	}
+
+	if (isungroup) {
+		for (size_t downpos = 0; downpos < info.group.size(); downpos++) {
+			if (!info.group[downpos].empty() && !this->ungroupcards(userindex, (int)downpos))
+				return false;
+		}
+	}
+
+	offset = 0;
+	for (int n = 0; n < groups; n++) {
+		if (!this->groupcards(userindex, sizes[n], cardpos + offset * sizeof(_PMSG_CARD_INFO)))
+			return false;
+		offset += sizes[n];
+	}
+	return true;
+}
+
+// one fixed size record per action for the binary audit log, card is the drawn, dropped or chowed card
+void game::logevent(unsigned char userpos, int action, const unsigned char* card, unsigned char count, const unsigned char* cardpos, int delta)
+{
+	_EVENT_RECORD rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.time = clockwallmsec();
+	rec.serial = this->m_gameserial;
+	rec.delta = delta;
+	rec.action = (uint16_t)action;
+	rec.userpos = userpos;
+
+	this->m_syncseq++;
+
+	if (card != NULL)
+		rec.cards[rec.count++] = EVENT_CARD(card[0], card[1]);
+
+	for (int n = 0; n < count && rec.count < EVENT_MAX_CARDS; n++)
+		rec.cards[rec.count++] = EVENT_CARD(cardpos[n * sizeof(_PMSG_CARD_INFO)], cardpos[n * sizeof(_PMSG_CARD_INFO) + 1]);
+
+	this->m_sink->event(rec);
+}
+
 void game::msglog(BYTE type, const char* msg, ...)
 {
-	char szBuffer[1024] = { 0 };
+	if (!LOGENABLED(type))
+		return;
+
+	char szBuffer[LOG_RECORD_SIZE] = { 0 };
 	va_list pArguments;
 	va_start(pArguments, msg);
-	sprintf(szBuffer, "[Serial:%llu Type:%d] ", this->m_gameserial, this->m_ectype);
+	snprintf(szBuffer, sizeof(szBuffer), "[Serial:%llu Type:%d] ", (unsigned long long)this->m_gameserial, this->m_ectype);
 	size_t iSize = strlen(szBuffer);
-	vsprintf(&szBuffer[iSize], msg, pArguments);
+	vsnprintf(&szBuffer[iSize], sizeof(szBuffer) - iSize, msg, pArguments);
 	va_end(pArguments);
-	::msglog(type, szBuffer);
+	::msglog(type, "%s", szBuffer);
 }
 
 bool game::checkgpsdistance()
@@ -3401,6 +4189,17 @@ bool game::checkgpsdistance()
 	if (guser.getuser(this->m_users[0])->isnogps)
 		return true;
 
+	// pairs are only compared again after one of the players moved
+	bool ismoved = false;
+
+	for (int n = 0; n < 3; n++) {
+		uint32_t version = guser.getuser(this->m_users[n])->gps.version;
+		if (this->m_gpsversions[n] != version) {
+			this->m_gpsversions[n] = version;
+			ismoved = true;
+		}
+	}
+
 	// check distance using gps
 	for (int n = 0; n < 3; n++) {
 
@@ -3409,12 +4208,12 @@ bool game::checkgpsdistance()
 
 		_USER_INFO* user1 = guser.getuser(this->m_users[n]);
 
-		if (GetTickCount64() > user1->gps.tick || user1->gps.longitude == 0.000000 || user1->gps.latitude == 0.000000) {
-			this->sendnotice(this->m_users[n], 1, "Your location is invalid so you will be kicked from this game.");
-			gcontrol.addkickuser(this->m_users[n]);
+		if (clockmsec() > user1->gps.tick || user1->gps.longitude == 0.000000 || user1->gps.latitude == 0.000000) {
+			this->sendnotice(this->m_users[n], 1, _NOTICE_ID::_BADLOCATION);
+			this->m_sink->kick(this->m_users[n]);
 			this->m_usercardinfo[n].iskick = true;
 		}
-		else {
+		else if (ismoved) {
 			for (int i = 0; i < 3; i++) {
 
 				if (n == i || this->m_usercardinfo[i].iskick == true)
@@ -3422,18 +4221,15 @@ bool game::checkgpsdistance()
 
 				_USER_INFO* user2 = guser.getuser(this->m_users[i]);
 
-				double dist = guser.getdistancegps(user1->gps.latitude, user1->gps.longitude,
-					user2->gps.latitude, user2->gps.longitude);
-
-				if (dist < c.getgpslimitdis()) {
+				if (guser.isgpsnear(user1, user2)) {
 
-					this->sendnotice(this->m_users[i], 1, "Your location is invalid so you will be kicked from this game.");
-					gcontrol.addkickuser(this->m_users[i]);
+					this->sendnotice(this->m_users[i], 1, _NOTICE_ID::_BADLOCATION);
+					this->m_sink->kick(this->m_users[i]);
 					this->m_usercardinfo[i].iskick = true;
 
 					if (this->m_usercardinfo[n].iskick == false) {
-						this->sendnotice(this->m_users[n], 1, "Your location is invalid so you will be kicked from this game.");
-						gcontrol.addkickuser(this->m_users[n]);
+						this->sendnotice(this->m_users[n], 1, _NOTICE_ID::_BADLOCATION);
+						this->m_sink->kick(this->m_users[n]);
 						this->m_usercardinfo[n].iskick = true;
 					}
 				}
@@ -3454,8 +4250,8 @@ bool game::checkgpsdistance()
 	if (countactive <= 1) { // end the game when active is below or equal to 1 
 		if (posactive != -1) {
 			this->m_winner = this->m_users[posactive];
-			this->sendnotice(0, 0, "%s won and got the hits by default!", guser.getuser(this->m_winner)->name.c_str());
-			this->msglog(INFO, "%s (%s) won and got the hits by default.", guser.getuser(this->m_winner)->name.c_str(), guser.getuser(this->m_winner)->account.c_str());
+			this->sendnotice(0, 0, _NOTICE_ID::_DEFAULTWIN, guser.getuser(this->m_winner)->name);
+			GAMELOG(INFO, "%s (%s) won and got the hits by default.", guser.getuser(this->m_winner)->name.c_str(), guser.getuser(this->m_winner)->account.c_str());
 			this->m_hitter = this->m_winner;
 			this->getwinner(1);
 			this->senduserecoinsinfo();
@@ -3464,7 +4260,7 @@ bool game::checkgpsdistance()
 		else {
 			this->senduserecoinsinfo();
 			this->setstate(_GAME_STATE::_ENDED);
-			msglog(INFO, "All users kicked so no hits (%d) refunded, game ended.", this->m_hitprizeecoins);
+			MSGLOG(INFO, "All users kicked so no hits (%d) refunded, game ended.", this->m_hitprizeecoins);
 		}
 		return false;
 	}
@@ -3472,13 +4268,45 @@ bool game::checkgpsdistance()
 	return true;
 }
 
+// a seat away gets the frames too, they wait in its replay ring for its resume
 bool game::datasend(intptr_t userindex, unsigned char* data, int len)
 {
-	if (guser.getuser(userindex)->isplaying()) {
-		return ::datasend(userindex, data, len);
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (this->isresyncing(userinfo, userindex)) {
+		replayhold(userinfo, data, len);
+		return true;
+	}
+
+	if (userinfo->isplaying() || userinfo->isdc()) {
+		return this->m_sink->send(userindex, data, len);
 	}
 	return false;
 }
 
+// a seat that logged in again and has not been sent the table yet, its frames wait behind the ones it missed
+bool game::isresyncing(_USER_INFO* userinfo, intptr_t userindex)
+{
+	return userinfo->isresumed() && userinfo->m_resumeflag != 0 && userindex != this->m_resyncuser;
+}
+
+// every seat still playing or away, the packet is encoded once for all of them
+void game::broadcast(unsigned char* data, int len)
+{
+	intptr_t users[MAX_USER_POS];
+	int count = 0;
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(this->m_users[i]);
+		if (this->isresyncing(userinfo, this->m_users[i]))
+			replayhold(userinfo, data, len);
+		else if (userinfo->isplaying() || userinfo->isdc())
+			users[count++] = this->m_users[i];
+	}
+
+	this->m_sink->sendall(users, count, data, len);
+	this->spectate(data, len);
+}
+
 
 
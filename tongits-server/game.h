@@ -1,5 +1,16 @@
 #pragma once
 #include "common.h"
+#include "conf.h"
+#include "settle.h"
+#include "spectate.h"
+#include "notice.h"
+#include "rules.h"
+#include <memory>
+
+struct _USER_INFO;
+struct _BOT_DISCARD;
+struct _BOT_ROLLOUT;
+class gamesink;
 
 struct _CARD_INFO
 {
@@ -33,6 +44,123 @@ enum class _ACTIONS
 	_FIGHT2 = 64
 };
 
+#define ACTION_KINDS 10	// _NONE and the nine actions, see actionindex
+#define ACTIVE_STATES 128	// every combination of the _ACTIVE_STATE bits
+
+// 0 for _NONE, then the bit position of the action plus one
+constexpr int actionindex(_ACTIONS action)
+{
+	int index = 0;
+	for (int bits = (int)action; bits != 0; bits >>= 1)
+		index++;
+	return index;
+}
+
+// why isactionvalid turns a request down
+enum class _ACTION_REASON : unsigned char
+{
+	_OK = 0,
+	_QUIET,	// a fight or the end of the stock is on, no message needed
+	_NOTTURN,
+	_NOSTOCK,
+	_HASDOWN,
+	_NOHOUSE,
+	_NOFIGHT,
+	_CANTFIGHT,
+	_FOUGHT,
+	_NOTDRAWN,
+	_STATUS,
+	_TOOSOON,	// inside the 500 ms after the last action, past the pipelined burst
+	_INVALID,	// the move itself, or no table to make it on
+	_MAX
+};
+
+#define ACTION_PIPELINE_BURST 4	// sequenced actions that may follow each other inside the 500 ms, a whole turn
+
+// the tests of the player, made between the two status lookups in this order
+#define ACTION_CHECK_TURN 1
+#define ACTION_CHECK_STOCK 2
+#define ACTION_CHECK_NODOWN 4
+#define ACTION_CHECK_DOWN 8	// a down of the player's own
+#define ACTION_CHECK_HOUSEDOWN 16	// a down as the house rules count it
+#define ACTION_CHECK_CANFIGHT 32
+#define ACTION_CHECK_NOTFOUGHT 64
+
+#define ACTION_MASK_DOWNS 8	// downs of a seat in _PMSG_ACTION_MASK::sapawdowns
+
+struct _ACTION_RULE
+{
+	int quiet;	// any of these status bits turns the request down before the player is looked at
+	int checks;	// ACTION_CHECK_
+	int required;	// one of these bits has to be set, 0 for none
+	_ACTION_REASON missing;	// the answer when none is
+	int forbidden;	// none of these may be set
+	int next;	// the bit the action sets once it is done
+};
+
+static constexpr _ACTION_RULE gactionrules[ACTION_KINDS] = {
+	{ 0, 0, 0, _ACTION_REASON::_OK, 0, 0 },	// _NONE
+	{ (int)_ACTIVE_STATE::_FOUGHT | (int)_ACTIVE_STATE::_STOCKZERO, ACTION_CHECK_TURN | ACTION_CHECK_STOCK, 0, _ACTION_REASON::_OK,
+		(int)_ACTIVE_STATE::_DROPPED | (int)_ACTIVE_STATE::_DRAWN | (int)_ACTIVE_STATE::_CHOWED | (int)_ACTIVE_STATE::_STOCKZERO | (int)_ACTIVE_STATE::_FOUGHT,
+		(int)_ACTIVE_STATE::_DRAWN },	// _DRAW
+	{ (int)_ACTIVE_STATE::_FOUGHT | (int)_ACTIVE_STATE::_STOCKZERO, ACTION_CHECK_TURN, 0, _ACTION_REASON::_OK,
+		(int)_ACTIVE_STATE::_DROPPED | (int)_ACTIVE_STATE::_DRAWN | (int)_ACTIVE_STATE::_CHOWED | (int)_ACTIVE_STATE::_FOUGHT | (int)_ACTIVE_STATE::_DOWNED,
+		(int)_ACTIVE_STATE::_CHOWED },	// _CHOW
+	{ (int)_ACTIVE_STATE::_FOUGHT, ACTION_CHECK_TURN | ACTION_CHECK_NODOWN, 0, _ACTION_REASON::_OK,
+		(int)_ACTIVE_STATE::_CHOWED | (int)_ACTIVE_STATE::_FOUGHT | (int)_ACTIVE_STATE::_DOWNED,
+		(int)_ACTIVE_STATE::_DOWNED },	// _DOWN
+	{ (int)_ACTIVE_STATE::_FOUGHT, ACTION_CHECK_TURN, (int)_ACTIVE_STATE::_DRAWN | (int)_ACTIVE_STATE::_CHOWED, _ACTION_REASON::_NOTDRAWN,
+		(int)_ACTIVE_STATE::_DROPPED | (int)_ACTIVE_STATE::_FOUGHT,
+		(int)_ACTIVE_STATE::_DROPPED },	// _DROP
+	{ (int)_ACTIVE_STATE::_FOUGHT, ACTION_CHECK_TURN, 0, _ACTION_REASON::_OK,
+		(int)_ACTIVE_STATE::_DROPPED | (int)_ACTIVE_STATE::_FOUGHT, 0 },	// _SAPAW
+	{ (int)_ACTIVE_STATE::_FOUGHT | (int)_ACTIVE_STATE::_STOCKZERO,
+		ACTION_CHECK_TURN | ACTION_CHECK_DOWN | ACTION_CHECK_CANFIGHT | ACTION_CHECK_NOTFOUGHT, 0, _ACTION_REASON::_OK,
+		ACTIVE_STATES - 1,
+		(int)_ACTIVE_STATE::_FOUGHT },	// _FIGHT, only at the start of a turn
+	{ (int)_ACTIVE_STATE::_STOCKZERO, ACTION_CHECK_HOUSEDOWN | ACTION_CHECK_NOTFOUGHT, (int)_ACTIVE_STATE::_FOUGHT, _ACTION_REASON::_STATUS, 0, 0 },	// _FIGHT2
+	{ 0, 0, 0, _ACTION_REASON::_OK, (int)_ACTIVE_STATE::_RESET, 0 },	// _GROUP
+	{ 0, 0, 0, _ACTION_REASON::_OK, (int)_ACTIVE_STATE::_RESET, 0 }	// _UNGROUP
+};
+
+struct _ACTION_ENTRY
+{
+	_ACTION_REASON before;	// of the status alone, ahead of the tests of the player
+	_ACTION_REASON after;	// and after them
+	unsigned char next;	// the status once the action is done
+};
+
+// (action, active status) to its answer, generated at compile time from gactionrules
+struct _ACTION_TABLE
+{
+	_ACTION_ENTRY entries[ACTION_KINDS][ACTIVE_STATES];
+
+	constexpr _ACTION_TABLE() : entries{}
+	{
+		for (int kind = 0; kind < ACTION_KINDS; kind++) {
+			const _ACTION_RULE& rule = gactionrules[kind];
+			for (int status = 0; status < ACTIVE_STATES; status++) {
+				_ACTION_ENTRY& entry = entries[kind][status];
+				entry.before = (status & rule.quiet) ? _ACTION_REASON::_QUIET : _ACTION_REASON::_OK;
+				if (rule.required != 0 && !(status & rule.required))
+					entry.after = rule.missing;
+				else if (status & rule.forbidden)
+					entry.after = _ACTION_REASON::_STATUS;
+				else
+					entry.after = _ACTION_REASON::_OK;
+				entry.next = (unsigned char)(status | rule.next);
+			}
+		}
+	}
+};
+
+static constexpr _ACTION_TABLE gactiontable;
+
+inline const _ACTION_ENTRY& actionentry(int status, _ACTIONS action)
+{
+	return gactiontable.entries[actionindex(action)][status & (ACTIVE_STATES - 1)];
+}
+
 struct _DROPCARD_INFO
 {
 	_PMSG_CARD_INFO card;
@@ -40,32 +168,247 @@ struct _DROPCARD_INFO
 	unsigned char userpos;
 };
 
+// a set of cards as a 52 bit mask, card (type, num) is bit (type - 1) * 13 + (num - 1)
+typedef uint64_t _CARD_MASK;
+
+#define CARD_RANK_MASK(num) ((_CARD_MASK)0x8004002001ULL << ((num) - 1))	// one bit per suit
+
+inline int cardpopcount(_CARD_MASK mask)
+{
+#ifdef _MSC_VER
+	return (int)__popcnt64(mask);
+#else
+	return __builtin_popcountll(mask);
+#endif
+}
+
+inline int cardlowbit(_CARD_MASK mask)
+{
+#ifdef _MSC_VER
+	unsigned long pos;
+	_BitScanForward64(&pos, mask);
+	return (int)pos;
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
+inline _CARD_MASK cardmask(unsigned char type, unsigned char num)
+{
+	if (type < 1 || type > MAX_CARD_TYPE || num < 1 || num > MAX_CARDS_PER_TYPE)
+		return 0;
+	return (_CARD_MASK)1 << ((type - 1) * MAX_CARDS_PER_TYPE + (num - 1));
+}
+
+// valid melds of one type or one number, generated at compile time
+struct _MELD_TABLE
+{
+	uint64_t run[(1 << MAX_CARDS_PER_TYPE) / 64];	// 13 bit numbers of one type, 3..13 in a row
+	uint16_t set;	// 4 bit types of one number, trio or quadra
+
+	constexpr _MELD_TABLE() : run{}, set(0)
+	{
+		for (int len = 3; len <= MAX_CARDS_PER_TYPE; len++) {
+			for (int low = 0; low + len <= MAX_CARDS_PER_TYPE; low++) {
+				int m = ((1 << len) - 1) << low;
+				run[m / 64] |= (uint64_t)1 << (m % 64);
+			}
+		}
+		for (int m = 0; m < (1 << MAX_CARD_TYPE); m++) {
+			int n = 0;
+			for (int t = 0; t < MAX_CARD_TYPE; t++)
+				n += (m >> t) & 1;
+			if (n >= 3)
+				set |= (uint16_t)(1 << m);
+		}
+	}
+};
+
+static constexpr _MELD_TABLE gmeldtable;
+static_assert((gmeldtable.run[0] & 0x4080) == 0x4080 && (gmeldtable.run[0x1c00 / 64] >> (0x1c00 % 64)) & 1
+	&& (gmeldtable.run[0x1fff / 64] >> (0x1fff % 64)) & 1, "gmeldtable misses a-2-3, 2-3-4, j-q-k or the whole suit");
+static_assert((gmeldtable.run[0] & 0x80a) == 0 && gmeldtable.set == 0xe880, "gmeldtable takes a gap or a pair as a meld");
+
+// trio or quadra
+inline bool cardisset(_CARD_MASK mask)
+{
+	if (mask == 0)
+		return false;
+	int num = cardlowbit(mask) % MAX_CARDS_PER_TYPE;
+	if ((mask & ~CARD_RANK_MASK(num + 1)) != 0)
+		return false;
+	int types = 0;
+	for (int t = 0; t < MAX_CARD_TYPE; t++)
+		types |= (int)((mask >> (t * MAX_CARDS_PER_TYPE + num)) & 1) << t;
+	return (gmeldtable.set >> types) & 1;
+}
+
+// straight
+inline bool cardisrun(_CARD_MASK mask)
+{
+	if (mask == 0)
+		return false;
+	int shift = (cardlowbit(mask) / MAX_CARDS_PER_TYPE) * MAX_CARDS_PER_TYPE;
+	if ((mask >> shift) >> MAX_CARDS_PER_TYPE != 0)
+		return false;
+	int nums = (int)(mask >> shift);
+	return (gmeldtable.run[nums / 64] >> (nums % 64)) & 1;
+}
+
+inline bool cardismeld(_CARD_MASK mask)
+{
+	return cardisset(mask) || cardisrun(mask);
+}
+
+// card points, face cards count as 10
+inline int cardpoints(_CARD_MASK mask)
+{
+	int points = 0;
+	for (int num = 1; num <= MAX_CARDS_PER_TYPE; num++)
+		points += cardpopcount(mask & CARD_RANK_MASK(num)) * ((num > 10) ? 10 : num);
+	return points;
+}
+
+// xoshiro256**, each table owns one seeded once from the system CSPRNG
+struct _CARD_RNG
+{
+	uint64_t s[4];
+
+	void seed();
+
+	static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+	uint64_t next()
+	{
+		uint64_t result = rotl(this->s[1] * 5, 7) * 9;
+		uint64_t t = this->s[1] << 17;
+		this->s[2] ^= this->s[0];
+		this->s[3] ^= this->s[1];
+		this->s[1] ^= this->s[2];
+		this->s[0] ^= this->s[3];
+		this->s[2] ^= t;
+		this->s[3] = rotl(this->s[3], 45);
+		return result;
+	}
+
+	// uniform in [0, n), rejects the biased low range of the multiply
+	uint32_t bounded(uint32_t n)
+	{
+		uint64_t m = (this->next() >> 32) * n;
+		if ((uint32_t)m < n) {
+			uint32_t threshold = (uint32_t)(0 - n) % n;
+			while ((uint32_t)m < threshold)
+				m = (this->next() >> 32) * n;
+		}
+		return (uint32_t)(m >> 32);
+	}
+
+	// fisher-yates
+	template <class T>
+	void shuffle(T* first, int n)
+	{
+		for (int i = n - 1; i > 0; i--) {
+			int j = this->bounded(i + 1);
+			T t = first[i];
+			first[i] = first[j];
+			first[j] = t;
+		}
+	}
+};
+
+#define MAX_DECK_CARDS (MAX_CARD_TYPE * MAX_CARDS_PER_TYPE)
+#define MAX_MELDS (MAX_DECK_CARDS / 3)
+
+// fixed capacity list stored inline, nothing in a game outgrows the deck
+template <class T, int N>
+struct _CARD_LIST
+{
+	typedef T* iterator;
+
+	T items[N];
+	int count;
+
+	_CARD_LIST() : count(0) {}
+
+	iterator begin() { return this->items; }
+	iterator end() { return this->items + this->count; }
+	size_t size() const { return this->count; }
+	bool empty() const { return this->count == 0; }
+	void clear() { this->count = 0; }
+	T& operator[](size_t n) { return this->items[n]; }
+	const T& operator[](size_t n) const { return this->items[n]; }
+	T& at(size_t n) { return this->items[n]; }
+	T& front() { return this->items[0]; }
+	T& back() { return this->items[this->count - 1]; }
+
+	bool push_back(const T& v)
+	{
+		if (this->count >= N)
+			return false;
+		this->items[this->count++] = v;
+		return true;
+	}
+
+	iterator erase(iterator it)
+	{
+		iterator last = this->end() - 1;
+		for (iterator i = it; i < last; i++)
+			*i = *(i + 1);
+		this->count--;
+		return it;
+	}
+};
+
+typedef _CARD_LIST<_PMSG_CARD_INFO, MAX_DECK_CARDS> _CARD_PILE;
+typedef _CARD_LIST<_DROPCARD_INFO, MAX_DECK_CARDS> _DROP_PILE;
+typedef _CARD_LIST<_PMSG_CARD_INFO, MAX_CARDS_PER_TYPE> _MELD;
+typedef _CARD_LIST<_MELD, MAX_MELDS> _MELD_LIST;
+
+// score of one seat, kept up to date as cards move
+struct _USER_CARD_COUNT
+{
+	int points;	// hand card points
+	int quantity;	// cards in hand and groups
+	int aces;	// aces in hand, groups and downs
+	int royal;
+	int quadra;
+};
+
 struct _USER_CARD_INFO
 {
-	std::vector<std::vector <_PMSG_CARD_INFO>> group;
-	std::vector<std::vector <_PMSG_CARD_INFO>> down;
-	std::vector <_PMSG_CARD_INFO> user;
+	_MELD_LIST group;
+	_MELD_LIST down;
+	_CARD_PILE user;	// display order
+	_CARD_MASK mask;	// the same cards as user
+	_USER_CARD_COUNT count;
 	_PMSG_CARD_INFO lastdrawcard;
 	bool iskick;
 };
 
-struct _GAME_TYPE_ECOINSINFO
-{
-	int hitbaseaddecoins;
-	int hitaddecoins;
-	int nodownaddecoins;
-	int nontongitaddecoins;
-	int tongitaddecoins;
-	int sagasaaddecoins;
-	int royaladdecoins;
-	int quadraaddecoins;
-	int foughtbaseaddecoins;
-	int foughtpercardaddecoins;
-	int aceaddecoins;
-};
+struct _SNAPSHOT_GAME;
+
+#define GAMELOG(type, ...) do { if (LOGENABLED(type)) this->msglog(type, __VA_ARGS__); } while (0)
 
 class game
 {
+	// turn state read on every timer tick, kept together at the front of the slot
+	_GAME_STATE m_state;
+	int m_active_pos;
+	int m_active_status;
+	int m_counter;
+	uintptr_t m_gametick;
+	intptr_t m_winner;
+	uintptr_t m_fightuserindex;
+	bool m_resumed;
+	int m_resumemsleft;
+	intptr_t m_resyncuser;	// the seat resumedcuser is sending the table to, 0 when none
+	unsigned char m_ectype;
+	std::atomic<int> m_loop;	// worker loop running this game, -1 when the slot is free
+	struct event* m_timer;	// on the base of m_loop, only touched by that loop
+	uint64_t m_runusec;	// timer callbacks of the table since it was taken, and their cost
+	uint64_t m_runmaxusec;
+	uint32_t m_runs;
+
 public:
 	game();
 	~game();
@@ -83,6 +426,8 @@ public:
 	bool sapawcard(uintptr_t userindex, unsigned userpos, unsigned downpos, unsigned char count, unsigned char* cardpos, bool test = false,  bool skipactioncheck = false);
 	bool groupcards(uintptr_t userindex, unsigned char count, unsigned char* cardpos);
 	bool ungroupcards(uintptr_t userindex, int downpos);
+	bool sethandorder(uintptr_t userindex, unsigned char count, unsigned char* cardpos);
+	bool groupbatch(uintptr_t userindex, bool isungroup, const unsigned char* sizes, unsigned char count, unsigned char* cardpos);
 	bool fightcard(uintptr_t userindex);
 	bool fight2card(uintptr_t userindex, unsigned char isfight);
 	bool usercards(uintptr_t userindex);
@@ -90,13 +435,24 @@ public:
 
 	intptr_t m_users[MAX_USERS_PERGAME];
 
-	std::map<uintptr_t, int>mUserWinnings;
-
 	void setstate(_GAME_STATE state, bool flag=false);
 	_GAME_STATE getstate() { return m_state; }
 
 	void setgameserial(int64_t serial) { this->m_gameserial = serial; }
 	int64_t getgameserial() { return this->m_gameserial; }
+	uint32_t getsyncseq() { return this->m_syncseq; }
+
+	void setloop(int loop) { this->m_loop = loop; }
+	int getloop() { return this->m_loop; }
+
+	void schedule(int64_t msec = -1);
+	void tick();
+	void accountrun(int64_t serial, _GAME_STATE state, uint64_t usec);
+
+	game* m_nextfree;
+	bool m_isfreelisted;
+	bool m_isqueued;	// waits in the due queue of its loop, see le_queuegame
+	void stoptimer();
 
 	bool checkecoins();
 	int checkactiveusers();
@@ -106,22 +462,52 @@ public:
 
 	void sendresult(uintptr_t userindex, unsigned char result);
 
-	uintptr_t m_hitter;
+	intptr_t m_hitter;
 	int m_active_userindex;
 
+	int m_tourneyhands;	// hands a tournament table plays before it closes, 0 for any other table
+	int m_hands;	// settled since the table was taken
+	uint64_t m_frozentick;	// since when a migration holds the table, 0 while it plays
+	_GAME_STATE m_frozenstate;	// the state it goes back to when the migration fails
+	uint64_t m_heldtick;	// since when all of its players are away, 0 while one is here. see suspend.h
+	bool m_isplayout;	// read back from the suspend store at its keep, it plays out and is not held again
+
 	void senduserecoinsinfo(uintptr_t userindex = 0);
 
+	bool savesnapshot(_SNAPSHOT_GAME& s);
+	void loadsnapshot(const _SNAPSHOT_GAME& s, const uintptr_t* users, int64_t shift);
+
+	// a table moving to another server, see migrate.h. frozen it neither runs nor takes an action
+	bool ismigratable();
+	void freeze();
+	void thaw();
+	void migrated(const std::string& host, unsigned short port);
+
+	_SPECTATE_STREAM* m_spectate;	// NULL while nobody watches
+	void setsink(gamesink* sink) { this->m_sink = sink; }
+	void spectatesnapshot(std::vector<unsigned char>& buf);
+
 private:
 
+	friend class gamebench;	// bench.cpp deals its tables directly
+	friend class simtable;	// tongits_sim plays its tables hand after hand
+	friend const _HOUSE_RULES* rulesfind(const std::string& name);	// takes the rule members of each policy
+
 	bool checkgpsdistance();
+	uint32_t m_gpsversions[3];	// seat positions the last pair check saw
 
 	bool datasend(intptr_t userindex, unsigned char* data, int len);
+	void broadcast(unsigned char* data, int len);
+	bool isresyncing(_USER_INFO* userinfo, intptr_t userindex);
+	void spectate(const unsigned char* data, int len) { if (this->m_spectate != NULL) spectatepush(this->m_spectate, data, len); }
 
 	_USER_CARD_INFO m_usercardinfo[3];
 	unsigned char initdrawcards[3];
 
-	std::vector<_PMSG_CARD_INFO> vStockCards;
-	std::vector<_DROPCARD_INFO> vDroppedCards;
+	_CARD_PILE vStockCards;
+	int m_stocktop;	// next card to draw from vStockCards
+	_CARD_RNG m_rng;
+	_DROP_PILE vDroppedCards;
 	unsigned char m_dropcardctr;
 
 	void countusercards(uintptr_t userindex, bool isfoughtstatus = false);
@@ -132,19 +518,33 @@ private:
 
 	int getposfromdropcard(unsigned char userpos, unsigned char* card);
 	int getposfromusercard(uintptr_t userindex, unsigned char* card);
+	_CARD_MASK getselectmask(unsigned char count, unsigned char* cardpos);
 
 	bool removefromdropped(unsigned userpos, unsigned char* pos);
 	bool removefromusercards(uintptr_t userindex, unsigned char* pos, bool isfree = false);
 	bool chooserandomcard(uintptr_t userindex, unsigned char* rcard);
 	bool addtousercards(uintptr_t userindex, unsigned char* pos);
+	void pushusercard(unsigned char gamepos, _PMSG_CARD_INFO card);
+	void countmeld(_USER_CARD_COUNT& count, const _MELD& v, bool isgroup, int sign);
+	void recountusercards(unsigned char gamepos, _USER_CARD_COUNT& count);
+	bool cleargroup(unsigned char gamepos, int downpos);
 	bool getcardfromusercards(uintptr_t userindex, unsigned char pos, unsigned char* card);
-	int adddowncards(uintptr_t userindex, std::vector <_PMSG_CARD_INFO> v, bool isgroup = false);
+	int adddowncards(uintptr_t userindex, const _MELD& v, bool isgroup = false);
 
+	_ACTION_REASON actionreason(_USER_INFO* userinfo, uintptr_t userindex, _ACTIONS action);
 	bool isactionvalid(uintptr_t userindex, _ACTIONS action);
 
 	bool trysapawcard(uintptr_t userindex, unsigned char* cardpos);
 	void shufflecards();
 
+	// the rule decisions, one instantiation per policy of rules.h in the _HOUSE_RULES table
+	const _HOUSE_RULES* rules() const { return this->m_rules[this->m_ectype]; }
+	template <class R> void dealseats(std::vector<unsigned char>& userpos);
+	template <class R> bool isdown(const _USER_INFO* userinfo);
+	template <class R> int burnedecoins(const _USER_INFO* userinfo);
+	template <class R> void paysagasa(uintptr_t userindex, unsigned char userpos);
+	template <class R> uintptr_t minecoins();
+
 	void sendstockcardcount(uintptr_t userindex = 0);
 	void sendshuffledcards();
 
@@ -152,6 +552,7 @@ private:
 	void sendinitusercards();
 	void sendgroupcards(uintptr_t userindex);
 	void senddowncards(uintptr_t userindex);
+	void sendsyncinfo(uintptr_t userindex);
 
 	void sendactiveinfo(uintptr_t userindex = 0);
 	void sendbothcardstouser(uintptr_t userindex);
@@ -159,13 +560,23 @@ private:
 	void sendusercardcountsinfo(uintptr_t userindex, uintptr_t touserindex = 0);
 	void sendusernameinfo(uintptr_t userindex = 0);
 	void sendtimeoutleft(uintptr_t timemsec);
+	void senddeadline(uintptr_t userindex, unsigned char pos, uint64_t deadline);
+	void sendactionmask(uintptr_t userindex);
 	void sendclosedinfo();
 	void sendwaitinfo();
 	void sendendedinfo();
 	void sendfightmode(uintptr_t userindex, unsigned char enable);
 	void sendactivestatus();
 
-	void sendnotice(uintptr_t userindex, unsigned char type, const char* msg, ...);
+	void sendnotice(uintptr_t userindex, const _NOTICE& notice);
+
+	template <typename... A>
+	void sendnotice(uintptr_t userindex, unsigned char type, _NOTICE_ID id, const A&... args)
+	{
+		_NOTICE notice;
+		noticemake(notice, type, id, args...);
+		this->sendnotice(userindex, notice);
+	}
 
 	void setstate_restarted();
 	void setstate_started(bool isrestarted=false);
@@ -173,19 +584,46 @@ private:
 	void setstate_prepare();
 	void setstate_closed();
 	void setstate_ended();
+	void cleartable();
+	void releasetable();
 	void setstate_waiting();
 
+	uint64_t getnextdeadline();
+
 	void procstate_notice();
 	void procstate_prepare();
 	void procstate_started();
 	void procstate_closed();
 	void procstate_restarted();
+	void dealhand();
 
 	void resumedcuser();
+	void botplay();
+	void autoplay(uintptr_t userindex);
+	bool botrollout(uintptr_t userindex, _BOT_DISCARD* discards, int count);
+	void botrolloutcancel();
+	bool isautoturn();
+	uint64_t getturnmsec(uintptr_t userindex);
+	int checkactivehumans();
+	bool checksuspend();
+	void suspended();
 
 	void msglog(BYTE type, const char* msg, ...);
-
-	_GAME_TYPE_ECOINSINFO m_ecinfo[2];
+	void logevent(unsigned char userpos, int action, const unsigned char* card, unsigned char count, const unsigned char* cardpos, int delta = 0);
+
+	const _BET_CONF* m_betconf;	// shared, read only
+	const _GAME_TYPE_ECOINSINFO* m_ecinfo;	// m_betconf->ecoins
+	const _GAME_TIMEOUTS* m_timeouts;	// m_betconf->timeouts
+	const _HOUSE_RULES* const* m_rules;	// m_betconf->rules
+	_SETTLE_INFO m_settle;	// ledger of the last settled round
+	gamesink* m_sink;	// gamenetsink unless set otherwise
+	std::shared_ptr<_BOT_ROLLOUT> m_rollout;	// the drop search of the active bot, NULL when none was started
+	// the name and card count packets of the seats as they go out, a resume or a state change sends these.
+	// reset dirties them, countusercards keeps the counts current
+	_PMSG_USERNAMEINFO m_namepkts[MAX_USER_POS];
+	_PMSG_USERCARDSINFO m_cardpkts[MAX_USER_POS];
+	bool m_isseatpktsdirty;
+	void buildseatpkts();
 	// server constant config specifics
 	/*uintptr_t m_hitbaseaddecoins;
 	uintptr_t m_hitaddecoins;
@@ -202,21 +640,20 @@ private:
 	// running values
 	uintptr_t m_hitprizeecoins;
 
-	uintptr_t m_winner;
-	_GAME_STATE m_state;
-	int m_counter;
-
-	uintptr_t m_gametick;
 	int64_t m_gameserial;
+	uint32_t m_syncseq;	// bumped with every logged action, tells which state a sync snapshot holds
 
-	int m_active_pos;
-	int m_active_status;
-
-	uintptr_t m_fightuserindex;
-	bool m_resumed;
-	int m_resumemsleft;
-	unsigned char m_ectype;
+public:
+	std::map<uintptr_t, int>mUserWinnings;
 };
 
-
-
+// the rules of one policy, the members of game it is played with
+struct _HOUSE_RULES
+{
+	const char* name;
+	void (game::*dealseats)(std::vector<unsigned char>& userpos);	// a seat per card dealt, in seat order
+	bool (game::*isdown)(const _USER_INFO* userinfo);	// may fight, is not burned, competes when the stock is out
+	int (game::*burnedecoins)(const _USER_INFO* userinfo);	// paid to the winner by a loser
+	void (game::*paysagasa)(uintptr_t userindex, unsigned char userpos);
+	uintptr_t (game::*minecoins)();	// a player needs to stay for the next round
+};
@@ -4,88 +4,371 @@
 #include <algorithm>
 #include <random>
 #include "conf.h"
+#include "snapshot.h"
+#include "cluster.h"
+#include "alive.h"
+#include "gpsindex.h"
+#include "tournament.h"
+#include "sessiondir.h"
+#include "migrate.h"
+#include "standby.h"
+#include "lobby.h"
+#include "leaderboard.h"
+#include "admit.h"
+#include "adminfeed.h"
+#include "tablelist.h"
+#include "otp.h"
+#include "suspend.h"
+#include "replay.h"
+#include "packet.h"
+#include "slabmem.h"
 
 gamecontrol gcontrol;
 
 
 gamecontrol::gamecontrol()
 {
-	this->m_games.reserve(MAX_GAME_SLOT);
-	msglog(DEBUG, "Loading %d game slots...", MAX_GAME_SLOT);
-	for (int n = 1; n < MAX_GAME_SLOT + 1; n++) {
-		game* g = new game;
-		g->setgameserial(n);
-		g->setstate(_GAME_STATE::_FREE);
-		this->m_games.push_back(g);
-	}
-	msglog(DEBUG, "Loading game slots done.");
+	// nothing is allocated before the conf is read, slabs are grown as tables are taken
+	this->m_capacity = MAX_GAME_SLOT;
+	this->m_games.assign(MAX_GAME_SLOT, NULL);
+	this->m_gamecount = 0;
+	this->m_idletick = 0;
+	this->m_freegames = NULL;
+	this->m_activegames = 0;
+	this->m_loops = 1;
 }
 
 gamecontrol::~gamecontrol()
 {
 }
 
-void gamecontrol::run()
+void gamecontrol::setloops(int loops)
 {
-	int activegames = 0;
-	char sbuf[100] = { 0 };
+	this->m_loops = loops;
+	this->m_kickusers.resize(loops);
+	this->m_snapshotticks.resize(loops, 0);
+}
 
-	this->kickusers();
+// before the loops start, the pointer table is never resized once they read it
+void gamecontrol::setcapacity(int games)
+{
+	if (games < 1)
+		games = 1;
+	if (games < this->m_gamecount)
+		games = this->m_gamecount;
+
+	this->m_capacity = games;
+	this->m_games.resize(games, NULL);
+	MSGLOG(DEBUG, "Game slots grow up to %d in slabs of %d.", games, GAME_SLAB_SIZE);
+}
 
-	std::vector <game*>::iterator iter;
-	iter = this->m_games.begin();
+// adds slabs until serial exists, the new slots go on top of the free list lowest serial first
+bool gamecontrol::growgames(int64_t serial)
+{
+	int count = this->m_gamecount;
 
-	while (iter != this->m_games.end()) {
-		game* g = *iter;
-		if (g->getstate() == _GAME_STATE::_FREE) {
-			iter++;
-			continue;
+	if (serial > this->m_capacity)
+		return false;
+
+	while (count < serial) {
+		int size = std::min(GAME_SLAB_SIZE, this->m_capacity - count);
+		game* slab = slabnew<game>(size, _MEM_TAG::_GAME);
+
+		for (int n = 0; n < size; n++) {
+			slab[n].setgameserial(count + n + 1);
+			slab[n].setstate(_GAME_STATE::_FREE);
+			this->m_games[count + n] = &slab[n];
+		}
+		for (int n = size - 1; n >= 0; n--) {
+			slab[n].m_nextfree = this->m_freegames;
+			slab[n].m_isfreelisted = true;
+			this->m_freegames = &slab[n];
 		}
-		g->run();
-		activegames++;
-		iter++;
+
+		this->m_gameslabs.push_back(slab);
+		count += size;
+		this->m_gamecount.store(count, std::memory_order_release);
+		MSGLOG(DEBUG, "Game slots grown to %d.", count);
 	}
+	return true;
+}
 
-	sprintf(sbuf, "Tongits Server Active: %d Ver: %d.%02d.%03d%s",
-		activegames,
-		TUNNEL_PROXY_VER_MAJOR, TUNNEL_PROXY_VER_MINOR, TUNNEL_PROXY_VER_REV, TUNNEL_PROXY_VER_STG);
-	//SetConsoleTitle(sbuf);
+// a slab is deleted once every other loop has worked its queue, none of them is still reading it then
+static void retiregames(game* slab, int size, int loop, int loops)
+{
+	if (loop >= loops) {
+		le_postloop(0, [slab, size]() { slabdelete(slab, size, _MEM_TAG::_GAME); });
+		return;
+	}
+	le_postloop(loop, [slab, size, loop, loops]() { retiregames(slab, size, loop + 1, loops); });
 }
 
-void gamecontrol::clear()
+// the last slab goes back after all of it stayed free for Shrink Idle Seconds, one slab at a time
+void gamecontrol::shrinkgames()
+{
+	int seconds = c.getshrinkidlesec();
+	int count = this->m_gamecount;
+
+	if (seconds <= 0 || this->m_gameslabs.empty())
+		return;
+
+	int first = (int)(this->m_gameslabs.size() - 1) * GAME_SLAB_SIZE;
+
+	for (int n = first; n < count; n++) {
+		game* g = this->m_games[n];
+		if (!g->m_isfreelisted || g->getstate() != _GAME_STATE::_FREE || g->getloop() != -1) {
+			this->m_idletick = 0;
+			return;
+		}
+	}
+
+	if (this->m_idletick == 0)
+		this->m_idletick = clockmsec();
+	if (clockmsec() < this->m_idletick + (uint64_t)seconds * 1000)
+		return;
+
+	game* slab = this->m_gameslabs.back();
+	this->m_gameslabs.pop_back();
+	this->m_gamecount.store(first, std::memory_order_release);
+	for (int n = first; n < count; n++)
+		this->m_games[n] = NULL;
+	this->rebuildfreegames();
+	this->m_idletick = 0;
+
+	retiregames(slab, count - first, 1, this->m_loops);
+	MSGLOG(DEBUG, "Game slots shrunk to %d.", first);
+}
+
+// lowest serial on top
+void gamecontrol::rebuildfreegames()
+{
+	this->m_freegames = NULL;
+	for (int n = this->m_gamecount - 1; n >= 0; n--) {
+		game* g = this->m_games[n];
+		g->m_isfreelisted = (g->getstate() == _GAME_STATE::_FREE);
+		g->m_nextfree = NULL;
+		if (g->m_isfreelisted) {
+			g->m_nextfree = this->m_freegames;
+			this->m_freegames = g;
+		}
+	}
+}
+
+// games run from their own timers, the loop tick handles the kick list and the watchers of its shard
+void gamecontrol::run(int loop)
+{
+	this->kickusers(loop);
+	spectateflush();
+	alivecheck();
+
+	// matchmaking is on loop 0
+	if (loop == 0) {
+		guser.botfill();
+		gpsindexaudit();
+		tourneyrun();
+		leaderrun();
+		lobbyrun();
+		admitsweep();
+		otpexpire();
+		suspendrun();
+		feedrun();
+		tablesrun();
+		sessionrun();
+		drainrun();
+		snapshotrun();
+		if (!standbyiswaiting())
+			clusterheartbeat();
+		this->shrinkgames();
+	}
+
+	if (clockmsec() >= this->m_snapshotticks[loop]) {
+		this->m_snapshotticks[loop] = clockmsec() + SNAPSHOT_MSEC;
+		this->snapshotgames(loop);
+	}
+}
+
+// captures the tables of one loop, loop -1 takes all of them once the loops are stopped
+void gamecontrol::snapshotgames(int loop)
+{
+	_SNAPSHOT_GAME snapshot;
+	int count = this->m_gamecount.load(std::memory_order_acquire);
+
+	for (int n = 0; n < count; n++) {
+		game* g = this->m_games[n];
+		int owner = g->getloop();
+
+		// the state of a table is only read by its own loop
+		if (owner < 0 || (loop >= 0 && owner != loop))
+			continue;
+		if (g->getstate() == _GAME_STATE::_FREE || g->getstate() == _GAME_STATE::_ENDED)
+			continue;
+		if (g->savesnapshot(snapshot))
+			snapshotput(snapshot);
+	}
+}
+
+// the table of a snapshot record in g, which is taken already. every seat gets a disconnected placeholder
+// that the player's next login resumes, false when the user slots ran out. isplayout for a table that
+// is not to be suspended again, see suspend.h
+bool gamecontrol::loadgame(game* g, const _SNAPSHOT_GAME& s, int64_t shift, bool isplayout)
 {
-	msglog(DEBUG, "Clear %d game slots...", MAX_GAME_SLOT);
-	std::vector <game*>::iterator iter;
-	iter = this->m_games.begin();
-	while (iter != this->m_games.end()) {
-		game* g = *iter;
-		delete g;
-		iter++;
+	uintptr_t users[MAX_USER_POS] = { 0 };
+	int seats = 0;
+
+	for (; seats < MAX_USER_POS; seats++) {
+		users[seats] = guser.getuserindex(true);
+		if (users[seats] == 0)
+			break;
 	}
-	msglog(DEBUG, "Clear game slots done.");
+
+	if (seats < MAX_USER_POS) {
+		for (int i = 0; i < seats; i++)
+			guser.freeslot(users[i]);
+		MSGLOG(ERROR, "loadgame, no user slot left for table %lld.", (long long)s.serial);
+		return false;
+	}
+
+	g->reset();
+	g->loadsnapshot(s, users, shift);
+	g->m_isplayout = isplayout;
+	g->setloop(le_pickloop());
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(users[i]);
+		snapshotloaduser(s.users[i], userinfo, shift);
+		userinfo->m_gameserial = g->getgameserial();
+		userinfo->m_gamepos = i;
+		userinfo->packetdata.loop = g->getloop();
+		if (userinfo->isbot)
+			continue;
+		guser.indexuser(users[i]);
+		// a suspended table read back late, its player sits at another one by now
+		if (this->getsessionuserid(userinfo->token) == 0)
+			this->startgamesession(userinfo->token, users[i]);
+	}
+
+	le_postloop(g->getloop(), [g]() { g->schedule(SNAPSHOT_GRACE_MSEC); });
+	return true;
 }
 
+// tables of the previous run or of a primary that was taken over, each under the serial it had
+int gamecontrol::restoregames(const _SNAPSHOT_GAME* games, size_t count, int64_t shift)
+{
+	int restored = 0;
+
+	for (size_t n = 0; n < count; n++) {
+		const _SNAPSHOT_GAME& s = games[n];
+		this->growgames(s.serial);
+		game* g = this->getgame(s.serial);
+
+		if (g == NULL || g->getstate() != _GAME_STATE::_FREE || g->getloop() != -1)
+			continue;
+
+		if (!this->loadgame(g, s, shift))
+			break;
+
+		this->m_activegames++;
+		restored++;
+	}
+
+	// restored slots are still on the free list, it is built again from the ones left free
+	this->rebuildfreegames();
+	return restored;
+}
+
+int gamecontrol::restoresnapshot()
+{
+	_SNAPSHOT_VIEW view;
+
+	if (!snapshotopen(view))
+		return 0;
+
+	// the tables stood still while the server was down
+	int64_t shift = (int64_t)clockmsec() - (int64_t)view.header->tick;
+	int restored = this->restoregames(view.games, view.header->games, shift);
+
+	snapshotclose(view);
+
+	if (restored > 0)
+		MSGLOG(INFO, "Restored %d tables from %s.", restored, SNAPSHOT_FILE);
+	return restored;
+}
+
+// a table sent by another server, seated under a serial of this one. 0 when there is no room for it
+int64_t gamecontrol::importgame(const _SNAPSHOT_GAME& s, int64_t shift, bool isplayout)
+{
+	game* g = this->getgameslot();
+
+	if (g == NULL)
+		return 0;
+
+	if (!this->loadgame(g, s, shift, isplayout)) {
+		this->freegameslot(g);
+		return 0;
+	}
+	return g->getgameserial();
+}
+
+void gamecontrol::clear()
+{
+	int count = this->m_gamecount;
+	MSGLOG(DEBUG, "Clear %d game slots...", count);
+	this->m_gamecount = 0;
+	this->m_games.assign(this->m_games.size(), NULL);
+	this->m_freegames = NULL;
+	for (size_t n = 0; n < this->m_gameslabs.size(); n++)
+		slabdelete(this->m_gameslabs[n], std::min(GAME_SLAB_SIZE, count - (int)n * GAME_SLAB_SIZE), _MEM_TAG::_GAME);
+	this->m_gameslabs.clear();
+	MSGLOG(DEBUG, "Clear game slots done.");
+}
+
+// takes a slot off the free list, the most recently freed one is reused first while it is still warm
 game* gamecontrol::getgameslot()
 {
-	std::vector <game*>::iterator iter;// m_games
-	for (iter = this->m_games.begin(); iter != this->m_games.end(); iter++) {
-		game* _g = *iter;
-		if (_g->getstate() == _GAME_STATE::_FREE)
-			return _g;
+	while (true) {
+		while (this->m_freegames != NULL) {
+			game* _g = this->m_freegames;
+			this->m_freegames = _g->m_nextfree;
+			_g->m_nextfree = NULL;
+			_g->m_isfreelisted = false;
+			if (_g->getstate() == _GAME_STATE::_FREE && _g->getloop() == -1) {
+				this->m_activegames++;
+				return _g;
+			}
+		}
+		if (!this->growgames(this->m_gamecount + 1))
+			return NULL;
 	}
-	return NULL;
+}
 
+bool gamecontrol::hasgameslot()
+{
+	return this->m_freegames != NULL || this->m_gamecount < this->m_capacity;
 }
 
-game* gamecontrol::getgame(int64_t serial)
+// a table ends on its own loop, the slot goes back to the free list on loop 0
+void gamecontrol::freegameslot(game* g)
 {
-	std::vector <game*>::iterator iter;// m_games
-	for (iter = this->m_games.begin(); iter != this->m_games.end(); iter++) {
-		game* _g = *iter;
-		if (_g->getgameserial() == serial)
-			return _g;
+	if (le_getloop() > 0) {
+		le_post([this, g]() { this->freegameslot(g); });
+		return;
 	}
-	return NULL;
+
+	if (g->m_isfreelisted)
+		return;
+
+	g->m_isfreelisted = true;
+	g->m_nextfree = this->m_freegames;
+	this->m_freegames = g;
+	this->m_activegames--;
+}
+
+// serials are handed out in slot order at startup, so the serial is the index
+game* gamecontrol::getgame(int64_t serial)
+{
+	if (serial < 1 || serial > this->m_gamecount.load(std::memory_order_acquire))
+		return NULL;
+	return this->m_games[serial - 1];
 }
 
 static const char names[3][10] = {
@@ -100,119 +383,163 @@ void gamecontrol::addgame(uintptr_t user1, uintptr_t user2, uintptr_t user3, uns
 
 	if (g == NULL) {
 		// send notice
-		msglog(DEBUG, "gamecontroller, addgame returned no slot available.");
+		MSGLOG(DEBUG, "gamecontroller, addgame returned no slot available.");
 		return;
 	}
 
 	g->reset();
 	g->setgametype(gametype);
+	g->setloop(le_pickloop());
 
-	msglog(DEBUG, "gamecontroller, addgame serial %d.", g->getgameserial());
+	MSGLOG(DEBUG, "gamecontroller, addgame serial %d.", g->getgameserial());
 
-	g->m_users[0] = user1;
-	g->m_users[1] = user2;
-	g->m_users[2] = user3;
+	uintptr_t users[MAX_USER_POS] = { user1, user2, user3 };
 
-	if (g->checkactiveusers() < 3) {
-		g->setstate(_GAME_STATE::_ENDED);
-		msglog(DEBUG, "gamecontroller, addgame checkactiveusers failed.");
+	if (!this->seatgame(g, users))
 		return;
+
+	le_postloop(g->getloop(), [g]() {
+		g->setstate(_GAME_STATE::_NOTICE);
+		g->schedule();
+	});
+}
+
+// every three of seats at a table of their own. the slots are all taken before anyone is seated, so the
+// batch goes ahead whole or not at all, and each loop gets one post that starts all of its tables.
+// serials gets the table of every three, 0 where the three could not be seated
+bool gamecontrol::addgames(const std::vector<uintptr_t>& seats, unsigned char gametype, int hands, std::vector<int64_t>& serials)
+{
+	size_t tables = seats.size() / MAX_USER_POS;
+	std::vector<game*> slots;
+	std::map<int, std::vector<game*>> loops;
+
+	slots.reserve(tables);
+	while (slots.size() < tables) {
+		game* g = this->getgameslot();
+		if (g == NULL) {
+			MSGLOG(INFO, "gamecontroller, addgames found %d of the %d slots it needs.", (int)slots.size(), (int)tables);
+			for (game* taken : slots)
+				this->freegameslot(taken);
+			return false;
+		}
+		slots.push_back(g);
 	}
 
-	if (!g->checkecoins()) {
-		g->setstate(_GAME_STATE::_ENDED);
-		msglog(DEBUG, "gamecontroller, addgame checkecoins failed.");
-		return;
+	serials.assign(tables, 0);
+
+	for (size_t n = 0; n < tables; n++) {
+		game* g = slots[n];
+
+		g->reset();
+		g->setgametype(gametype);
+		g->setloop(le_pickloop());
+
+		if (!this->seatgame(g, &seats[n * MAX_USER_POS]))
+			continue;
+
+		g->m_tourneyhands = hands;
+		serials[n] = g->getgameserial();
+		loops[g->getloop()].push_back(g);
 	}
 
-	_USER_INFO* _userinfo1 = guser.getuser(user1);
-	_USER_INFO* _userinfo2 = guser.getuser(user2);
-	_USER_INFO* _userinfo3 = guser.getuser(user3);
+	for (auto& iter : loops) {
+		std::vector<game*> games = std::move(iter.second);
+		le_postloop(iter.first, [games]() {
+			for (game* g : games) {
+				g->setstate(_GAME_STATE::_NOTICE);
+				g->schedule();
+			}
+		});
+	}
 
-	_userinfo1->init();
-	_userinfo2->init();
-	_userinfo3->init();
+	MSGLOG(INFO, "gamecontroller, addgames seated %d tables over %d loops.", (int)tables, (int)loops.size());
+	return true;
+}
 
-	_userinfo1->m_gameserial = g->getgameserial();
-	_userinfo2->m_gameserial = g->getgameserial();
-	_userinfo3->m_gameserial = g->getgameserial();
+// the players take their seats and follow the table to its loop, the table is ended when one of them
+// can not play. a player queued for a match is dropped from the queue once it sees the player seated
+bool gamecontrol::seatgame(game* g, const uintptr_t* users)
+{
+	for (int i = 0; i < MAX_USER_POS; i++)
+		g->m_users[i] = users[i];
 
-	_userinfo1->m_gamepos = 0;
-	_userinfo2->m_gamepos = 1;
-	_userinfo3->m_gamepos = 2;
+	if (g->checkactiveusers() < 3) {
+		g->setstate(_GAME_STATE::_ENDED);
+		MSGLOG(DEBUG, "gamecontroller, addgame checkactiveusers failed.");
+		return false;
+	}
 
-	_userinfo1->m_state ^= (unsigned char)_USER_STATE::_WAITING;
-	_userinfo2->m_state ^= (unsigned char)_USER_STATE::_WAITING;
-	_userinfo3->m_state ^= (unsigned char)_USER_STATE::_WAITING;
+	if (!g->checkecoins()) {
+		g->setstate(_GAME_STATE::_ENDED);
+		MSGLOG(DEBUG, "gamecontroller, addgame checkecoins failed.");
+		return false;
+	}
 
-	_userinfo1->m_state |= (unsigned char)_USER_STATE::_PLAYING;
-	_userinfo2->m_state |= (unsigned char)_USER_STATE::_PLAYING;
-	_userinfo3->m_state |= (unsigned char)_USER_STATE::_PLAYING;
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* _userinfo = guser.getuser(users[i]);
 
-	// temporary give a unique name
-	_userinfo1->name = names[0];
-	_userinfo2->name = names[1];
-	_userinfo3->name = names[2];
+		_userinfo->init();
+		_userinfo->m_gameserial = g->getgameserial();
+		_userinfo->m_gamepos = i;
+		_userinfo->setstate((_userinfo->m_state & ~(unsigned char)_USER_STATE::_WAITING) | (unsigned char)_USER_STATE::_PLAYING);
 
+		// temporary give a unique name
+		_userinfo->name = names[i];
 
-	msglog(DEBUG, "Added game %llu with %s (%d), %s (%d) and %s (%d).",
+		if (!_userinfo->isbot)
+			this->startgamesession(_userinfo->token, users[i]);
+	}
+
+	MSGLOG(DEBUG, "Added game %llu with %s (%d), %s (%d) and %s (%d).",
 		g->getgameserial(),
-		_userinfo1->name.c_str(), user1,
-		_userinfo2->name.c_str(), user2,
-		_userinfo3->name.c_str(), user3
+		guser.getuser(users[0])->name.c_str(), users[0],
+		guser.getuser(users[1])->name.c_str(), users[1],
+		guser.getuser(users[2])->name.c_str(), users[2]
 	);
 
-	g->setstate(_GAME_STATE::_NOTICE);
-}
-
-void gamecontrol::checkaliveusers()
-{
-	//guser.checkaliveusers();
+	// the players follow the table to its loop, which takes the game over from here
+	for (int i = 0; i < MAX_USER_POS; i++)
+		le_migrateuser(users[i], g->getloop());
+	return true;
 }
 
 void gamecontrol::addkickuser(uintptr_t userid)
 {
 	_USER_KICK_INFO kickinfo;
-	kickinfo.tick = GetTickCount64() + 5000;
+	kickinfo.tick = clockmsec() + 5000;
 	kickinfo.userid = userid;
-	this->m_kickusers.push_back(kickinfo);
+	this->m_kickusers[le_getloop()].push(kickinfo);
 	guser.getuser(userid)->iskick = true;
-	msglog(INFO, "addkickuser, added %s (%s) userid %d.", 
+	MSGLOG(INFO, "addkickuser, added %s (%s) userid %d.", 
 		guser.getuser(userid)->name.c_str(),
 		guser.getuser(userid)->account.c_str(),
 		userid
 		);
 }
 
-void gamecontrol::kickusers()
+void gamecontrol::kickusers(int loop)
 {
-	std::vector <_USER_KICK_INFO>::iterator iter; //m_kickusers
-
-	_PMSG_LOGIN_RESULT pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF2;
-	pMsg.hdr.len = sizeof(_PMSG_LOGIN_RESULT);
-	pMsg.sub = 0x09;
-	pMsg.result = 1; // option to create game
-	strcpy(pMsg.ecoinsnote, c.getbetmode(0).name.c_str());
-	strcpy(pMsg.jewelsnote, c.getbetmode(1).name.c_str());
-
-	for (iter = this->m_kickusers.begin(); iter != this->m_kickusers.end(); iter++) {
-		_USER_KICK_INFO kickinfo = *iter;
-		if (GetTickCount64() > kickinfo.tick) {
-
-			strcpy(pMsg.accountid, guser.getuser(kickinfo.userid)->account.c_str());
-			pMsg.isuseradmin = (guser.getuser(kickinfo.userid)->isuseradmin) ? 1 : 0;
-			pMsg.ecoins = guser.getuser(kickinfo.userid)->ecoins[0];
-			pMsg.jewels = guser.getuser(kickinfo.userid)->ecoins[1];
-			::datasend(kickinfo.userid, (unsigned char*)&pMsg, pMsg.hdr.len);
-			
-			guser.deluser(kickinfo.userid, true);
-
-			iter = this->m_kickusers.erase(iter);
-			if (iter == this->m_kickusers.end())
-				break;
-		}
+	_KICK_QUEUE& kicks = this->m_kickusers[loop];
+
+	// only the top is looked at while nothing is due
+	while (!kicks.empty() && clockmsec() > kicks.top().tick) {
+
+		_USER_KICK_INFO kickinfo = kicks.top();
+		kicks.pop();
+
+		_USER_INFO* userinfo = guser.getuser(kickinfo.userid);
+		if (userinfo == NULL)
+			continue;
+
+		_PMSG_LOGIN_RESULT pMsg = c.getbetconf()->loginresult;
+		userinfo->account.copyto(pMsg.accountid);
+		pMsg.isuseradmin = (userinfo->isuseradmin) ? 1 : 0;
+		pMsg.ecoins = userinfo->ecoins[0];
+		pMsg.jewels = userinfo->ecoins[1];
+		::datasend(kickinfo.userid, (unsigned char*)&pMsg, pMsg.hdr.len);
+
+		guser.deluser(kickinfo.userid, true);
+		le_migrateuser(kickinfo.userid, 0);
 	}
 }
 
@@ -225,20 +552,37 @@ uintptr_t gamecontrol::getsessionuserid(uintptr_t token)
 	return 0;
 }
 
+// game sessions belong to loop 0
 void gamecontrol::endgamesession(uintptr_t token, uintptr_t userid)
 {
+	if (le_getloop() != 0) {
+		le_post([this, token, userid]() { this->endgamesession(token, userid); });
+		return;
+	}
+
 	std::map <uintptr_t, uintptr_t>::iterator iter;
 	iter = this->m_gamesessions.find(token);
-	if (iter != this->m_gamesessions.end()) {
+	// the seat of a table that lost the token to another one keeps nothing
+	if (iter != this->m_gamesessions.end() && iter->second == userid) {
 		this->m_gamesessions.erase(iter);
-		msglog(DEBUG, "endgamesession, removed game session, token %llu.", token);
+		MSGLOG(DEBUG, "endgamesession, removed game session, token %llu.", token);
+		sessiondel((int64_t)token);
 	}
 }
 
 void gamecontrol::startgamesession(uintptr_t token, uintptr_t userid)
 {
+	if (le_getloop() != 0) {
+		le_post([this, token, userid]() { this->startgamesession(token, userid); });
+		return;
+	}
+
 	this->m_gamesessions.insert(std::make_pair(token, userid));
-	msglog(DEBUG, "startgamesession, started a new game session, token %llu.", token);
+	MSGLOG(DEBUG, "startgamesession, started a new game session, token %llu.", token);
+
+	_USER_INFO* userinfo = guser.getuser(userid);
+	if (userinfo != NULL)
+		sessionput((int64_t)token, userinfo->m_gameserial, userinfo->m_gamepos);
 
 }
 
@@ -248,86 +592,115 @@ bool gamecontrol::getusersessioninfo(uintptr_t token, uintptr_t userid)
 
 	if (resume_userid != 0) {
 
-		//le_updatecbfd(userid, resume_userid);
+		game* _g = gcontrol.getgame(guser.getuser(resume_userid)->m_gameserial);
 
-		// copy the current packet
-		_PACKET_DATA _packet;
-		memcpy(&_packet, &guser.getuser(userid)->packetdata, sizeof(_PACKET_DATA));
+		if (_g == NULL)
+			return false;
 
-		// copy fresh ecoins
-		int _ecoins[2];
-		_ecoins[0] = guser.getuser(userid)->ecoins[0];
-		_ecoins[1] = guser.getuser(userid)->ecoins[1];
+		// the resume touches the game, so it is done on the game's loop with the new connection moved there first
+		int loop = _g->getloop();
+		if (loop < 0)
+			loop = le_getloop();
 
-		// copy fresh gametoken
-		int _gametoken = guser.getuser(userid)->gametoken;
+		le_migrateuser(userid, loop, [this, token, userid, resume_userid]() {
+			this->resumegamesession(token, userid, resume_userid);
+		});
+	}
+	else if (suspendresume((int64_t)token, [this, token, userid](bool isseated) {
+			_USER_INFO* userinfo = guser.getuser(userid);
+
+			if (userinfo == NULL || (uintptr_t)userinfo->token != token)
+				return;
+
+			// the table is in a slot again and resumes like a live one
+			if (isseated && this->getsessionuserid(token) != 0)
+				this->getusersessioninfo(token, userid);
+			else
+				this->sendloginresult(userid);
+		})) {
+		MSGLOG(DEBUG, "getusersessioninfo, token %llu has a suspended table.", token);
+	}
+	else {
+		// a table of another server is found in the session directory, which may answer later
+		sessionfind((int64_t)token, [this, token, userid](const _SESSION_ENTRY* entry) {
+			_USER_INFO* userinfo = guser.getuser(userid);
+
+			if (userinfo == NULL || (uintptr_t)userinfo->token != token)
+				return;
+
+			if (entry != NULL) {
+				if (!sessionislocal(*entry) && clusterresume(userid, entry->host, entry->port))
+					return;
+				// written by this server before it restarted, the table is gone
+				if (sessionislocal(*entry) && this->getsessionuserid(token) == 0)
+					sessiondel((int64_t)token);
+			}
+
+			this->sendloginresult(userid);
+		});
+	}
 
-		// now copy all the old user info
-		memcpy(guser.getuser(userid), guser.getuser(resume_userid), sizeof(_USER_INFO));
-		
-		// then restore back the current packet data
-		memcpy(&guser.getuser(userid)->packetdata, &_packet, sizeof(_PACKET_DATA));
+	return true;
+}
 
-		// restore ecoins
-		guser.getuser(userid)->ecoins[0] = _ecoins[0];
-		guser.getuser(userid)->ecoins[1] = _ecoins[1];
+void gamecontrol::sendloginresult(uintptr_t userid)
+{
+	_PMSG_LOGIN_RESULT pMsg = c.getbetconf()->loginresult;
+	pMsg.isuseradmin = (guser.getuser(userid)->isuseradmin) ? 1 : 0;
+	guser.getuser(userid)->account.copyto(pMsg.accountid);
+	pMsg.ecoins = guser.getuser(userid)->ecoins[0];
+	pMsg.jewels = guser.getuser(userid)->ecoins[1];
+	::datasend(userid, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
 
-		// restore game token
-		guser.getuser(userid)->gametoken = _gametoken;
+// the session keeps its slot, so the game and m_gamesessions never change. the new connection is
+// attached to it and the slot the login came in on is released
+void gamecontrol::resumegamesession(uintptr_t token, uintptr_t userid, uintptr_t resume_userid)
+{
+	_USER_INFO* login = guser.getuser(userid);
+	_USER_INFO* session = guser.getuser(resume_userid);
 
-		// update the game user id with the new id
-		unsigned char gamepos = guser.getuser(userid)->m_gamepos;
-		game* _g = gcontrol.getgame(guser.getuser(userid)->m_gameserial);
+	if (login == NULL || session == NULL)
+		return;
 
-		if (_g == NULL)
-			return false;
+	game* _g = gcontrol.getgame(session->m_gameserial);
 
-		_PMSG_LOGIN_RESULT pMsg = { 0 };
-		pMsg.hdr.c = 0xC1;
-		pMsg.hdr.h = 0xF2;
-		pMsg.hdr.len = sizeof(_PMSG_LOGIN_RESULT);
-		pMsg.sub = 0x09;
-		pMsg.result = 2; // resume game
-		::datasend(userid, (unsigned char*)&pMsg, pMsg.hdr.len);
-
-		// update hitter and active id accordingly
-		_g->m_users[gamepos] = userid;
-		if (_g->m_hitter == resume_userid)
-			_g->m_hitter = userid;
-		if (_g->m_active_userindex == resume_userid)
-			_g->m_active_userindex = userid;
-
-		// update the token userid
-		this->m_gamesessions[token] = userid;
-
-		//userid = resume_userid;
-		guser.getuser(userid)->resumegame();
-
-		// clear the old user id
-		guser.getuser(resume_userid)->set();
-		guser.getuser(resume_userid)->init();
-		if(guser.getuser(resume_userid)->packetdata.bev != NULL)
-			bufferevent_free(guser.getuser(resume_userid)->packetdata.bev);
-		
-		msglog(DEBUG, "getusersessioninfo, %s resume game session with serial no. %llu, token %llu.", 
-			guser.getuser(userid)->name.c_str(),
-			guser.getuser(userid)->m_gameserial, token);
-	}
-	else {
-		_PMSG_LOGIN_RESULT pMsg = { 0 };
-		pMsg.hdr.c = 0xC1;
-		pMsg.hdr.h = 0xF2;
-		pMsg.hdr.len = sizeof(_PMSG_LOGIN_RESULT);
-		pMsg.sub = 0x09;
-		pMsg.result = 1; // option to create game
-		pMsg.isuseradmin = (guser.getuser(userid)->isuseradmin) ? 1 : 0;
-		strcpy(pMsg.accountid, guser.getuser(userid)->account.c_str());
-		pMsg.ecoins = guser.getuser(userid)->ecoins[0];
-		pMsg.jewels = guser.getuser(userid)->ecoins[1];
-		strcpy(pMsg.ecoinsnote, c.getbetmode(0).name.c_str());
-		strcpy(pMsg.jewelsnote, c.getbetmode(1).name.c_str());
-		::datasend(userid, (unsigned char*)&pMsg, pMsg.hdr.len);
-	}
+	if (_g == NULL)
+		return;
 
-	return true;
-}
\ No newline at end of file
+	// fresh ecoins and game token of the login
+	session->ecoins[0] = login->ecoins[0];
+	session->ecoins[1] = login->ecoins[1];
+	session->gametoken = login->gametoken;
+	session->ip = login->ip;
+	session->wirever = login->wirever;
+	session->isnoticeid = login->isnoticeid;
+	session->isdeadline = login->isdeadline;
+	session->isactionmask = login->isactionmask;
+
+	// a still open old connection is closed, the callbacks of the new one now carry the session id
+	le_updatecbfd(userid, resume_userid);
+	guser.updateuserbev(userid, resume_userid);
+	login->packetdata.bev = NULL;
+	replayunmark(session);
+	session->setstate(session->m_state | (unsigned char)_USER_STATE::_CONNECTED);
+	session->alivetick = clockmsec();
+	aliveadd(resume_userid);
+
+	_PMSG_LOGIN_RESULT pMsg = pkttemplate<_PMSG_LOGIN_RESULT>(0xF2, 0x09);
+	pMsg.result = 2; // resume game
+	::datasend(resume_userid, (unsigned char*)&pMsg, pMsg.hdr.len);
+
+	session->resumegame();
+
+	login->set();
+	login->init();
+	guser.freeslot(userid);
+
+	// a table restored from a snapshot sleeps until its first player is back
+	_g->schedule(0);
+
+	MSGLOG(DEBUG, "getusersessioninfo, %s resume game session with serial no. %llu, token %llu.", 
+		session->name.c_str(),
+		session->m_gameserial, token);
+}
@@ -4,26 +4,42 @@
 #include "user.h"
 #include <map>
 #include <vector>
+#include <queue>
+#include <functional>
+#include <atomic>
+
+#define GAME_SLAB_SIZE 64	// tables allocated together, the last slab goes back whole once idle
 
 struct _USER_KICK_INFO
 {
 	uintptr_t tick;
 	uintptr_t userid;
+
+	bool operator>(const _USER_KICK_INFO& other) const { return tick > other.tick; }
 };
 
+// due kicks of one loop, the earliest on top
+typedef std::priority_queue<_USER_KICK_INFO, std::vector<_USER_KICK_INFO>, std::greater<_USER_KICK_INFO>> _KICK_QUEUE;
+
 class gamecontrol
 {
 public:
 	gamecontrol();
 	~gamecontrol();
 
-	void run();
+	void setloops(int loops);
+	void setcapacity(int games);
+	int getcapacity() { return this->m_capacity; }
+	void run(int loop);
 	void clear();
-	void kickusers();
-	void checkaliveusers();
+	void kickusers(int loop);
 	void addgame(uintptr_t user1, uintptr_t user2, uintptr_t user3, unsigned char gametype);
+	bool addgames(const std::vector<uintptr_t>& seats, unsigned char gametype, int hands, std::vector<int64_t>& serials);
 	game* getgame(int64_t serial);
 	game* getgameslot();
+	bool hasgameslot();
+	void freegameslot(game* g);
+	int getactivegames() { return this->m_activegames; }
 
 	bool getusersessioninfo(uintptr_t token, uintptr_t userid);
 	void endgamesession(uintptr_t token, uintptr_t userid);
@@ -32,11 +48,32 @@ public:
 
 	void addkickuser(uintptr_t userid);
 
+	void snapshotgames(int loop);
+	int restoresnapshot();
+	int restoregames(const _SNAPSHOT_GAME* games, size_t count, int64_t shift);
+	int64_t importgame(const _SNAPSHOT_GAME& s, int64_t shift, bool isplayout = false);
+
 private:
 
+	void resumegamesession(uintptr_t token, uintptr_t userid, uintptr_t resume_userid);
+	bool seatgame(game* g, const uintptr_t* users);
+	bool loadgame(game* g, const _SNAPSHOT_GAME& s, int64_t shift, bool isplayout = false);
+	void sendloginresult(uintptr_t userid);
+	bool growgames(int64_t serial);
+	void shrinkgames();
+	void rebuildfreegames();
+
 	std::map <uintptr_t, uintptr_t> m_gamesessions;
-	std::vector <game*> m_games;
-	std::vector <_USER_KICK_INFO> m_kickusers;
+	std::vector <game*> m_games;	// index serial - 1, points into m_gameslabs, NULL past m_gamecount
+	std::vector <game*> m_gameslabs;	// loop 0 only
+	std::atomic<int> m_gamecount;	// slots grown, stored after their pointers so any loop may read below it
+	int m_capacity;	// Max Games
+	uint64_t m_idletick;	// since when the last slab has been all free, 0 while a table of it is used
+	game* m_freegames;	// intrusive free list through game::m_nextfree, loop 0 only
+	int m_activegames;
+	int m_loops;
+	std::vector <_KICK_QUEUE> m_kickusers;	// one heap per loop
+	std::vector <uint64_t> m_snapshotticks;	// next capture of each loop
 };
 
 extern gamecontrol gcontrol;
@@ -0,0 +1,57 @@
+#include "gamesink.h"
+#include "game.h"
+#include "gamectrl.h"
+#include "socket.h"
+#include "user.h"
+#include "snapshot.h"
+#include "standby.h"
+#include "tournament.h"
+#include "leaderboard.h"
+
+class netsink : public gamesink
+{
+public:
+	bool send(intptr_t userindex, unsigned char* data, int len) override
+	{
+		return ::datasend(userindex, data, len);
+	}
+
+	void sendall(const intptr_t* users, int count, unsigned char* data, int len) override
+	{
+		::datasendall(users, count, data, len);
+	}
+
+	void notice(uintptr_t userindex, const _NOTICE& notice) override
+	{
+		guser.sendnotice(userindex, notice);
+	}
+
+	void settled(game* g, const _SETTLE_INFO& settle) override
+	{
+		addsettle(settle);
+		leaderhand(settle, g->m_users);
+		if (g->m_tourneyhands != 0)
+			tourneyhand(g->getgameserial(), settle);
+
+		_SNAPSHOT_GAME snapshot;
+		if (g->savesnapshot(snapshot))
+			snapshotput(snapshot, true);
+	}
+
+	void event(const _EVENT_RECORD& rec) override
+	{
+		addevent(rec);
+		standbytouch(rec.serial, le_getloop());
+	}
+
+	void kick(uintptr_t userindex) override
+	{
+		gcontrol.addkickuser(userindex);
+	}
+};
+
+gamesink* gamenetsink()
+{
+	static netsink sink;
+	return &sink;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+#include "settle.h"
+#include "notice.h"
+#include "eventlog.h"
+
+class game;
+
+// where a table's output goes. every packet, notice, settled hand, audit record and kick of game.cpp
+// leaves through the sink of its table, so the rules run the same without a connection behind them.
+// the tables of the server share gamenetsink, the packets go to the connections of the seats and the
+// ledger to the settle log, the tournament and the snapshot. tongits_sim gives each of its threads a sink
+// of its own that throws the packets away and only adds up the ledgers
+class gamesink
+{
+public:
+	virtual ~gamesink() {}
+
+	virtual bool send(intptr_t userindex, unsigned char* data, int len) = 0;
+	virtual void sendall(const intptr_t* users, int count, unsigned char* data, int len) = 0;
+	virtual void notice(uintptr_t userindex, const _NOTICE& notice) = 0;	// one seat, as id or text as its app reads it
+	virtual void settled(game* g, const _SETTLE_INFO& settle) = 0;	// a hand, once its ledger is applied
+	virtual void event(const _EVENT_RECORD& rec) = 0;
+	virtual void kick(uintptr_t userindex) = 0;
+};
+
+gamesink* gamenetsink();
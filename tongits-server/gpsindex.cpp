@@ -0,0 +1,218 @@
+#include "gpsindex.h"
+#include "user.h"
+#include "conf.h"
+#include "metrics.h"
+#include <unordered_map>
+#include <set>
+
+// a cell is one limit of arc high and wide in degrees, a row of the grid a band of latitude
+struct _GPS_ENTRY
+{
+	double latitude;
+	double longitude;
+	double x, y, z;
+	uint64_t cell;
+	size_t pos;	// in the list of its cell
+};
+
+static std::unordered_map<uintptr_t, _GPS_ENTRY> gpsentries;
+static std::unordered_map<uint64_t, std::vector<uintptr_t>> gpscells;
+static double gpscos = 2.0;	// the limit the grid is cut for, no cosine is 2 so the first use cuts it
+static double gpsradius = 0.0;	// the limit as an angle, degrees
+static int gpsrows = 0;
+static int gpscols = 0;
+static uint64_t gpsaudittick = 0;
+static std::set<std::pair<uintptr_t, uintptr_t>> gpsauditpairs;	// found by the last audit, logged once
+
+static uint64_t gpskey(int row, int col)
+{
+	return ((uint64_t)(uint32_t)row << 32) | (uint32_t)col;
+}
+
+static uint64_t gpscellof(double latitude, double longitude)
+{
+	int row = std::min(gpsrows - 1, std::max(0, (int)floor((latitude + 90.0) / gpsradius)));
+	int col = (int)floor((longitude + 180.0) / gpsradius) % gpscols;
+	return gpskey(row, (col < 0) ? col + gpscols : col);
+}
+
+static void gpscelladd(uintptr_t userindex, _GPS_ENTRY& entry)
+{
+	entry.cell = gpscellof(entry.latitude, entry.longitude);
+	std::vector<uintptr_t>& players = gpscells[entry.cell];
+	entry.pos = players.size();
+	players.push_back(userindex);
+}
+
+// the last of the cell takes the place of the one leaving
+static void gpscelldel(_GPS_ENTRY& entry)
+{
+	auto iter = gpscells.find(entry.cell);
+	if (iter == gpscells.end())
+		return;
+
+	std::vector<uintptr_t>& players = iter->second;
+	uintptr_t last = players.back();
+	players[entry.pos] = last;
+	gpsentries[last].pos = entry.pos;
+	players.pop_back();
+	if (players.empty())
+		gpscells.erase(iter);
+}
+
+// the grid is cut again when a reload changed the limit, false while there is no limit
+static bool gpsgrid()
+{
+	double limitcos = c.getgpslimitcos();
+
+	if (c.getgpslimitdis() <= 0.0f) {
+		gpscells.clear();
+		gpscos = 2.0;
+		return false;
+	}
+
+	if (limitcos == gpscos)
+		return true;
+
+	gpscos = limitcos;
+	gpsradius = acos(std::min(1.0, std::max(-1.0, limitcos))) * 180.0 / M_PI;
+	if (gpsradius <= 0.0)
+		gpsradius = 1e-6;
+	gpsrows = (int)ceil(180.0 / gpsradius);
+	gpscols = (int)ceil(360.0 / gpsradius);
+
+	gpscells.clear();
+	for (auto& iter : gpsentries)
+		gpscelladd(iter.first, iter.second);
+	return true;
+}
+
+void gpsindexupdate(uintptr_t userindex, const _GPS_INFO& gps)
+{
+	bool isgrid = gpsgrid();
+	auto iter = gpsentries.find(userindex);
+
+	if (iter == gpsentries.end())
+		iter = gpsentries.emplace(userindex, _GPS_ENTRY()).first;
+	else if (isgrid)
+		gpscelldel(iter->second);
+
+	_GPS_ENTRY& entry = iter->second;
+	entry.latitude = gps.latitude;
+	entry.longitude = gps.longitude;
+	entry.x = gps.x;
+	entry.y = gps.y;
+	entry.z = gps.z;
+
+	if (isgrid)
+		gpscelladd(userindex, entry);
+}
+
+void gpsindexremove(uintptr_t userindex)
+{
+	auto iter = gpsentries.find(userindex);
+
+	if (iter == gpsentries.end())
+		return;
+
+	if (gpsgrid())
+		gpscelldel(iter->second);
+	gpsentries.erase(iter);
+}
+
+// the rows the circle reaches, and in them the columns it spans at its widest, all of them near a pole
+void gpsindexnear(const _GPS_INFO& at, uintptr_t except, std::vector<uintptr_t>& near)
+{
+	if (!gpsgrid())
+		return;
+
+	double top = at.latitude + gpsradius;
+	double bottom = at.latitude - gpsradius;
+	int row0 = std::max(0, (int)floor((bottom + 90.0) / gpsradius));
+	int row1 = std::min(gpsrows - 1, (int)floor((top + 90.0) / gpsradius));
+	int col0 = 0;
+	int col1 = gpscols - 1;
+
+	if (top < 90.0 && bottom > -90.0) {
+		double span = asin(std::min(1.0, sin(gpsradius * M_PI / 180.0) / cos(at.latitude * M_PI / 180.0))) * 180.0 / M_PI;
+		if ((int)ceil(2.0 * span / gpsradius) + 1 < gpscols) {
+			col0 = (int)floor((at.longitude - span + 180.0) / gpsradius);
+			col1 = (int)floor((at.longitude + span + 180.0) / gpsradius);
+		}
+	}
+
+	uint64_t now = clockmsec();
+
+	for (int row = row0; row <= row1; row++) {
+		for (int col = col0; col <= col1; col++) {
+
+			auto iter = gpscells.find(gpskey(row, ((col % gpscols) + gpscols) % gpscols));
+			if (iter == gpscells.end())
+				continue;
+
+			for (uintptr_t userindex : iter->second) {
+
+				if (userindex == except)
+					continue;
+
+				const _GPS_ENTRY& entry = gpsentries[userindex];
+				if (at.x * entry.x + at.y * entry.y + at.z * entry.z <= gpscos)
+					continue;
+
+				_USER_INFO* _info = guser.getuser(userindex);
+				if (_info != NULL && now <= _info->gps.tick)
+					near.push_back(userindex);
+			}
+		}
+	}
+}
+
+// seated players closer than the limit to a player of another table, a pair is logged the first audit
+// it shows up in and counted in the metrics for as long as it lasts
+void gpsindexaudit()
+{
+	if (clockmsec() < gpsaudittick)
+		return;
+	gpsaudittick = clockmsec() + GPS_AUDIT_MSEC;
+
+	std::set<std::pair<uintptr_t, uintptr_t>> pairs;
+	std::vector<uintptr_t> near;
+	std::vector<uintptr_t> gone;
+
+	for (auto& iter : gpsentries) {
+
+		// a move posted after its slot was freed
+		_USER_INFO* _info = guser.getuser(iter.first);
+		if (_info == NULL) {
+			gone.push_back(iter.first);
+			continue;
+		}
+
+		if (_info->m_gameserial == 0 || _info->isbot || clockmsec() > _info->gps.tick)
+			continue;
+
+		near.clear();
+		gpsindexnear(_info->gps, iter.first, near);
+
+		for (uintptr_t userindex : near) {
+
+			_USER_INFO* other = guser.getuser(userindex);
+			if (userindex < iter.first || other->m_gameserial == 0 || other->m_gameserial == _info->m_gameserial || other->isbot)
+				continue;
+
+			std::pair<uintptr_t, uintptr_t> pair(iter.first, userindex);
+			pairs.insert(pair);
+			if (gpsauditpairs.count(pair) == 0) {
+				MSGLOG(INFO, "GPS audit, %s at table %lld and %s at table %lld are %f km apart, closer than %f.",
+					_info->account.c_str(), _info->m_gameserial, other->account.c_str(), other->m_gameserial,
+					guser.getdistancegps(_info->gps.latitude, _info->gps.longitude, other->gps.latitude, other->gps.longitude), c.getgpslimitdis());
+			}
+		}
+	}
+
+	for (uintptr_t userindex : gone)
+		gpsindexremove(userindex);
+
+	gpsauditpairs.swap(pairs);
+	metricsgpsaudit((int64_t)gpsentries.size(), (int64_t)gpsauditpairs.size());
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// every player with a gps fix, on a grid of cells "GPS Limit Distance" high. the players within the
+// limit of a point are in the few cells its circle touches, a query reads those and not every user.
+// reqgpsinfo hands a moved player to loop 0, which owns the grid, and freeslot takes the player out.
+// the audit on the loop 0 tick looks for players sitting at different tables of the same venue, which
+// the checks of a single table can never see
+
+#define GPS_AUDIT_MSEC 30000
+
+struct _GPS_INFO;
+
+void gpsindexupdate(uintptr_t userindex, const _GPS_INFO& gps);	// loop 0 only, the others post it
+void gpsindexremove(uintptr_t userindex);
+// players of the grid closer than the limit to at, except, with a fix that has not run out
+void gpsindexnear(const _GPS_INFO& at, uintptr_t except, std::vector<uintptr_t>& near);
+void gpsindexaudit();	// on every loop 0 tick, runs once GPS_AUDIT_MSEC have passed
@@ -0,0 +1,395 @@
+#include "history.h"
+#include <string.h>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct _HISTORY_FIELD
+{
+	uint16_t offset;
+	uint16_t width;
+};
+
+#define HISTORY_FIELD(f) { (uint16_t)offsetof(_SETTLE_INFO, f), (uint16_t)sizeof(((_SETTLE_INFO*)0)->f) }
+#define HISTORY_SEAT_FIELDS(n) \
+	HISTORY_FIELD(seats[n].token), HISTORY_FIELD(seats[n].before), HISTORY_FIELD(seats[n].cardcount), \
+	HISTORY_FIELD(seats[n].fight), HISTORY_FIELD(seats[n].regular), HISTORY_FIELD(seats[n].quadra), \
+	HISTORY_FIELD(seats[n].royal), HISTORY_FIELD(seats[n].ace), HISTORY_FIELD(seats[n].burned), \
+	HISTORY_FIELD(seats[n].delta)
+
+// in _HISTORY_COLUMN order
+static const _HISTORY_FIELD historyfields[HISTORY_COLUMNS] = {
+	HISTORY_FIELD(serial), HISTORY_FIELD(time), HISTORY_FIELD(ectype), HISTORY_FIELD(winnerpos),
+	HISTORY_FIELD(istongits), HISTORY_FIELD(hitprize), HISTORY_FIELD(hittax), HISTORY_FIELD(total),
+	HISTORY_SEAT_FIELDS(0), HISTORY_SEAT_FIELDS(1), HISTORY_SEAT_FIELDS(2),
+};
+
+static_assert(sizeof(((_SETTLE_INFO*)0)->seats) / sizeof(_SETTLE_SEAT) == 3, "a block has the columns of three seats");
+
+static size_t historypad(size_t n)
+{
+	return (n + 7) & ~(size_t)7;
+}
+
+// where column starts in a block of rows, the size of the block for HISTORY_COLUMNS
+static size_t historycolumnat(uint32_t rows, int column)
+{
+	size_t at = sizeof(_HISTORY_BLOCK);
+	for (int c = 0; c < column; c++)
+		at += historypad((size_t)rows * historyfields[c].width);
+	return at;
+}
+
+// the chunk at offset when the whole of it is in the view
+static const _HISTORY_CHUNK* historychunk(const unsigned char* base, size_t size, size_t at)
+{
+	if (at + sizeof(_HISTORY_CHUNK) > size)
+		return NULL;
+
+	const _HISTORY_CHUNK* chunk = (const _HISTORY_CHUNK*)(base + at);
+	bool isblock = memcmp(chunk->magic, HISTORY_BLOCK_MAGIC, sizeof(chunk->magic)) == 0;
+	bool isindex = memcmp(chunk->magic, HISTORY_INDEX_MAGIC, sizeof(chunk->magic)) == 0;
+
+	if ((!isblock && !isindex) || chunk->version != HISTORY_VERSION || chunk->size % 8 != 0 || chunk->size > size - at)
+		return NULL;
+	if (isblock && (chunk->size < sizeof(_HISTORY_BLOCK) || chunk->size != historycolumnat(((const _HISTORY_BLOCK*)chunk)->rows, HISTORY_COLUMNS)))
+		return NULL;
+	if (isindex && (chunk->size < sizeof(_HISTORY_INDEX) || chunk->size != sizeof(_HISTORY_INDEX) +
+		((uint64_t)((const _HISTORY_INDEX*)chunk)->tokens + ((const _HISTORY_INDEX*)chunk)->serials) * sizeof(_HISTORY_ENTRY)))
+		return NULL;
+	return chunk;
+}
+
+static bool historyisindex(const _HISTORY_CHUNK* chunk)
+{
+	return memcmp(chunk->magic, HISTORY_INDEX_MAGIC, sizeof(chunk->magic)) == 0;
+}
+
+// a column of a block, the chunks and the columns in them start 8 byte aligned
+template<typename T>
+static const T* historycolumn(const _HISTORY_VIEW& view, size_t block, int column)
+{
+	const _HISTORY_BLOCK* b = (const _HISTORY_BLOCK*)(view.base + block);
+	return (const T*)(view.base + block + historycolumnat(b->rows, column));
+}
+
+static void historyrow(const _HISTORY_VIEW& view, size_t block, uint32_t row, _SETTLE_INFO& hand)
+{
+	const _HISTORY_BLOCK* b = (const _HISTORY_BLOCK*)(view.base + block);
+	size_t at = block + sizeof(_HISTORY_BLOCK);
+
+	memset(&hand, 0, sizeof(hand));
+	for (int c = 0; c < HISTORY_COLUMNS; c++) {
+		const _HISTORY_FIELD& field = historyfields[c];
+		memcpy((unsigned char*)&hand + field.offset, view.base + at + (size_t)row * field.width, field.width);
+		at += historypad((size_t)b->rows * field.width);
+	}
+}
+
+// the last index and the blocks after it
+static const _HISTORY_INDEX* historylayout(const _HISTORY_VIEW& view, std::vector<size_t>* blocks)
+{
+	const _HISTORY_INDEX* index = NULL;
+	const _HISTORY_CHUNK* chunk;
+
+	for (size_t at = 0; at < view.valid && (chunk = historychunk(view.base, view.valid, at)) != NULL; at += (size_t)chunk->size) {
+		if (historyisindex(chunk)) {
+			index = (const _HISTORY_INDEX*)chunk;
+			if (blocks != NULL)
+				blocks->clear();
+		}
+		else if (blocks != NULL)
+			blocks->push_back(at);
+	}
+	return index;
+}
+
+static const _HISTORY_ENTRY* historyentries(const _HISTORY_INDEX* index)
+{
+	return (const _HISTORY_ENTRY*)((const unsigned char*)index + sizeof(_HISTORY_INDEX));
+}
+
+static bool historykeyless(const _HISTORY_ENTRY& a, const _HISTORY_ENTRY& b)
+{
+	return a.key < b.key;
+}
+
+bool historyopen(const char* filename, _HISTORY_VIEW& view)
+{
+	memset(&view, 0, sizeof(view));
+
+#ifdef _WIN32
+	view.file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (view.file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(view.file, &size) || size.QuadPart == 0) {
+		CloseHandle(view.file);
+		return false;
+	}
+	view.size = (size_t)size.QuadPart;
+	view.mapping = CreateFileMappingA(view.file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (view.mapping != NULL)
+		view.base = (const unsigned char*)MapViewOfFile(view.mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view.base == NULL) {
+		if (view.mapping != NULL)
+			CloseHandle(view.mapping);
+		CloseHandle(view.file);
+		return false;
+	}
+#else
+	view.fd = open(filename, O_RDONLY);
+	if (view.fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(view.fd, &st) != 0 || st.st_size == 0) {
+		close(view.fd);
+		return false;
+	}
+	view.size = (size_t)st.st_size;
+	void* base = mmap(NULL, view.size, PROT_READ, MAP_PRIVATE, view.fd, 0);
+	if (base == MAP_FAILED) {
+		close(view.fd);
+		return false;
+	}
+	view.base = (const unsigned char*)base;
+#endif
+
+	const _HISTORY_CHUNK* chunk;
+	while ((chunk = historychunk(view.base, view.size, view.valid)) != NULL)
+		view.valid += (size_t)chunk->size;
+	return true;
+}
+
+void historyclose(_HISTORY_VIEW& view)
+{
+	if (view.base == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(view.base);
+	CloseHandle(view.mapping);
+	CloseHandle(view.file);
+#else
+	munmap((void*)view.base, view.size);
+	close(view.fd);
+#endif
+	view.base = NULL;
+}
+
+void historyblock(const _SETTLE_INFO* hands, int count, std::vector<unsigned char>& out)
+{
+	size_t start = out.size();
+	size_t size = historycolumnat((uint32_t)count, HISTORY_COLUMNS);
+	out.resize(start + size, 0);
+
+	_HISTORY_BLOCK block;
+	memset(&block, 0, sizeof(block));
+	memcpy(block.chunk.magic, HISTORY_BLOCK_MAGIC, sizeof(block.chunk.magic));
+	block.chunk.version = HISTORY_VERSION;
+	block.chunk.size = size;
+	block.rows = (uint32_t)count;
+	block.mintime = block.minserial = INT64_MAX;
+	block.maxtime = block.maxserial = INT64_MIN;
+
+	for (int n = 0; n < count; n++) {
+		block.mintime = std::min(block.mintime, (int64_t)hands[n].time);
+		block.maxtime = std::max(block.maxtime, (int64_t)hands[n].time);
+		block.minserial = std::min(block.minserial, (int64_t)hands[n].serial);
+		block.maxserial = std::max(block.maxserial, (int64_t)hands[n].serial);
+	}
+	memcpy(out.data() + start, &block, sizeof(block));
+
+	size_t at = start + sizeof(_HISTORY_BLOCK);
+	for (int c = 0; c < HISTORY_COLUMNS; c++) {
+		const _HISTORY_FIELD& field = historyfields[c];
+		for (int n = 0; n < count; n++)
+			memcpy(out.data() + at + (size_t)n * field.width, (const unsigned char*)&hands[n] + field.offset, field.width);
+		at += historypad((size_t)count * field.width);
+	}
+}
+
+void historyindex(const _HISTORY_VIEW& view, std::vector<unsigned char>& out)
+{
+	std::vector<_HISTORY_ENTRY> vtokens;
+	std::vector<_HISTORY_ENTRY> vserials;
+	const _HISTORY_CHUNK* chunk;
+	bool islast = false;
+
+	for (size_t at = 0; at < view.valid && (chunk = historychunk(view.base, view.valid, at)) != NULL; at += (size_t)chunk->size) {
+		islast = historyisindex(chunk);
+		if (islast)
+			continue;
+
+		const int64_t* serials = historycolumn<int64_t>(view, at, HISTORY_SERIAL);
+		const int64_t* tokens[3];
+		for (int seat = 0; seat < 3; seat++)
+			tokens[seat] = historycolumn<int64_t>(view, at, HISTORY_SEAT + seat * HISTORY_SEAT_COLUMNS + HISTORY_TOKEN);
+
+		_HISTORY_ENTRY entry = { 0 };
+		entry.block = at;
+		for (entry.row = 0; entry.row < ((const _HISTORY_BLOCK*)chunk)->rows; entry.row++) {
+			entry.key = serials[entry.row];
+			vserials.push_back(entry);
+			for (int seat = 0; seat < 3; seat++) {
+				entry.key = tokens[seat][entry.row];
+				if ((seat < 1 || entry.key != tokens[0][entry.row]) && (seat < 2 || entry.key != tokens[1][entry.row]))
+					vtokens.push_back(entry);
+			}
+		}
+	}
+
+	out.clear();
+	if (islast || vserials.empty())
+		return;
+
+	// stable, the hands of a key stay in the order they were played
+	std::stable_sort(vtokens.begin(), vtokens.end(), historykeyless);
+	std::stable_sort(vserials.begin(), vserials.end(), historykeyless);
+
+	_HISTORY_INDEX index;
+	memset(&index, 0, sizeof(index));
+	memcpy(index.chunk.magic, HISTORY_INDEX_MAGIC, sizeof(index.chunk.magic));
+	index.chunk.version = HISTORY_VERSION;
+	index.tokens = (uint32_t)vtokens.size();
+	index.serials = (uint32_t)vserials.size();
+	index.chunk.size = sizeof(_HISTORY_INDEX) + ((uint64_t)index.tokens + index.serials) * sizeof(_HISTORY_ENTRY);
+
+	out.resize((size_t)index.chunk.size);
+	memcpy(out.data(), &index, sizeof(index));
+	memcpy(out.data() + sizeof(index), vtokens.data(), vtokens.size() * sizeof(_HISTORY_ENTRY));
+	memcpy(out.data() + sizeof(index) + vtokens.size() * sizeof(_HISTORY_ENTRY), vserials.data(), vserials.size() * sizeof(_HISTORY_ENTRY));
+}
+
+void historylast(const _HISTORY_VIEW& view, int64_t token, int count, std::vector<_SETTLE_INFO>& hands)
+{
+	std::vector<size_t> blocks;
+	std::vector<std::pair<size_t, uint32_t>> found;	// in the order of the file
+	const _HISTORY_INDEX* index = historylayout(view, &blocks);
+
+	if (count <= 0)
+		return;
+
+	if (index != NULL) {
+		const _HISTORY_ENTRY* entries = historyentries(index);
+		_HISTORY_ENTRY key = { 0 };
+		key.key = token;
+		auto range = std::equal_range(entries, entries + index->tokens, key, historykeyless);
+		for (const _HISTORY_ENTRY* entry = range.first; entry != range.second; entry++)
+			found.push_back(std::make_pair((size_t)entry->block, entry->row));
+	}
+
+	for (size_t n = 0; n < blocks.size(); n++) {
+		const _HISTORY_BLOCK* block = (const _HISTORY_BLOCK*)(view.base + blocks[n]);
+		const int64_t* tokens[3];
+		for (int seat = 0; seat < 3; seat++)
+			tokens[seat] = historycolumn<int64_t>(view, blocks[n], HISTORY_SEAT + seat * HISTORY_SEAT_COLUMNS + HISTORY_TOKEN);
+		for (uint32_t row = 0; row < block->rows; row++) {
+			if (tokens[0][row] == token || tokens[1][row] == token || tokens[2][row] == token)
+				found.push_back(std::make_pair(blocks[n], row));
+		}
+	}
+
+	size_t first = (found.size() > (size_t)count) ? found.size() - count : 0;
+	for (size_t n = found.size(); n > first; n--) {
+		_SETTLE_INFO hand;
+		historyrow(view, found[n - 1].first, found[n - 1].second, hand);
+		hands.push_back(hand);
+	}
+}
+
+bool historyserial(const _HISTORY_VIEW& view, int64_t serial, _SETTLE_INFO& hand)
+{
+	std::vector<size_t> blocks;
+	const _HISTORY_INDEX* index = historylayout(view, &blocks);
+
+	if (index != NULL) {
+		const _HISTORY_ENTRY* entries = historyentries(index) + index->tokens;
+		_HISTORY_ENTRY key = { 0 };
+		key.key = serial;
+		const _HISTORY_ENTRY* entry = std::lower_bound(entries, entries + index->serials, key, historykeyless);
+		if (entry != entries + index->serials && entry->key == serial) {
+			historyrow(view, (size_t)entry->block, entry->row, hand);
+			return true;
+		}
+	}
+
+	for (size_t n = 0; n < blocks.size(); n++) {
+		const _HISTORY_BLOCK* block = (const _HISTORY_BLOCK*)(view.base + blocks[n]);
+		if (serial < block->minserial || serial > block->maxserial)
+			continue;
+		const int64_t* serials = historycolumn<int64_t>(view, blocks[n], HISTORY_SERIAL);
+		for (uint32_t row = 0; row < block->rows; row++) {
+			if (serials[row] == serial) {
+				historyrow(view, blocks[n], row, hand);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void historytotals(const _HISTORY_VIEW& view, _HISTORY_TOTALS* totals, int modes)
+{
+	const _HISTORY_CHUNK* chunk;
+
+	for (size_t at = 0; at < view.valid && (chunk = historychunk(view.base, view.valid, at)) != NULL; at += (size_t)chunk->size) {
+		if (historyisindex(chunk))
+			continue;
+
+		// column by column, the ectype of every row first
+		const _HISTORY_BLOCK* block = (const _HISTORY_BLOCK*)chunk;
+		const unsigned char* ectypes = historycolumn<unsigned char>(view, at, HISTORY_ECTYPE);
+		const bool* istongits = historycolumn<bool>(view, at, HISTORY_ISTONGITS);
+		const int* pots = historycolumn<int>(view, at, HISTORY_TOTAL);
+		const int* hitprizes = historycolumn<int>(view, at, HISTORY_HITPRIZE);
+
+		for (uint32_t row = 0; row < block->rows; row++) {
+			if (ectypes[row] >= modes)
+				continue;
+			_HISTORY_TOTALS& t = totals[ectypes[row]];
+			t.hands++;
+			t.tongits += istongits[row] ? 1 : 0;
+			t.pot += pots[row];
+			t.hitprize += hitprizes[row];
+		}
+
+		static const int amounts[] = { HISTORY_REGULAR, HISTORY_FIGHT, HISTORY_QUADRA, HISTORY_ROYAL, HISTORY_ACE, HISTORY_BURNED };
+		static int64_t _HISTORY_TOTALS::* const sums[] = { &_HISTORY_TOTALS::regular, &_HISTORY_TOTALS::fight,
+			&_HISTORY_TOTALS::quadra, &_HISTORY_TOTALS::royal, &_HISTORY_TOTALS::ace, &_HISTORY_TOTALS::burned };
+
+		for (int seat = 0; seat < 3; seat++) {
+			for (int a = 0; a < 6; a++) {
+				const int* values = historycolumn<int>(view, at, HISTORY_SEAT + seat * HISTORY_SEAT_COLUMNS + amounts[a]);
+				for (uint32_t row = 0; row < block->rows; row++) {
+					if (ectypes[row] < modes)
+						totals[ectypes[row]].*sums[a] += values[row];
+				}
+			}
+		}
+	}
+}
+
+int historyread(const _HISTORY_VIEW& view, size_t& at, std::vector<_SETTLE_INFO>& hands)
+{
+	const _HISTORY_CHUNK* chunk;
+
+	while (at < view.valid && (chunk = historychunk(view.base, view.valid, at)) != NULL) {
+		size_t block = at;
+		at += (size_t)chunk->size;
+		if (historyisindex(chunk))
+			continue;
+
+		uint32_t rows = ((const _HISTORY_BLOCK*)chunk)->rows;
+		hands.resize(rows);
+		for (uint32_t row = 0; row < rows; row++)
+			historyrow(view, block, row, hands[row]);
+		return (int)rows;
+	}
+	return 0;
+}
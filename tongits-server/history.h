@@ -0,0 +1,139 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "settle.h"
+
+// match history, every settled hand kept in columns next to the event log, Log/tongits_YYYY-MM-DD.hist
+// by local day. a segment is a run of chunks that are only ever appended. a block chunk holds up to
+// HISTORY_BLOCK_ROWS hands one fixed width column of _SETTLE_INFO after the other, so a scan for a token
+// or the sum of an amount reads only its own columns of the mapped file. once the day is over or the
+// server stops, an index chunk of every hand before it by token and by serial goes at the end, a query
+// searches the last index and scans only the blocks after it. a segment torn by a crash ends at its last
+// whole chunk, the writer cuts it there before it appends again
+//
+// this file and history.cpp do not depend on the rest of the server, tongits_logdump reads with them too
+
+#define HISTORY_BLOCK_MAGIC "TGHB"
+#define HISTORY_INDEX_MAGIC "TGHI"
+#define HISTORY_VERSION 1
+#define HISTORY_FILENAME "tongits"
+#define HISTORY_BLOCK_ROWS 4096
+#define HISTORY_BLOCK_MSEC 10000	// a hand waits in the settle worker this long at most for its block
+#define HISTORY_MAX_DAYS 31	// segments a query for the last games of a player goes back over
+#define HISTORY_MAX_GAMES 50	// games in one answer
+
+// the columns a query reads, every field of _SETTLE_INFO has one
+enum _HISTORY_COLUMN
+{
+	HISTORY_SERIAL = 0,
+	HISTORY_TIME,
+	HISTORY_ECTYPE,
+	HISTORY_WINNERPOS,
+	HISTORY_ISTONGITS,
+	HISTORY_HITPRIZE,
+	HISTORY_HITTAX,
+	HISTORY_TOTAL,
+	HISTORY_SEAT,	// the first column of seat 0, HISTORY_SEAT_COLUMNS of each seat follow
+	HISTORY_SEAT_COLUMNS = 10,
+	HISTORY_COLUMNS = HISTORY_SEAT + 3 * HISTORY_SEAT_COLUMNS,
+};
+
+// of a seat, from HISTORY_SEAT + seat * HISTORY_SEAT_COLUMNS
+enum _HISTORY_SEAT_COLUMN
+{
+	HISTORY_TOKEN = 0,
+	HISTORY_BEFORE,
+	HISTORY_CARDCOUNT,
+	HISTORY_FIGHT,
+	HISTORY_REGULAR,
+	HISTORY_QUADRA,
+	HISTORY_ROYAL,
+	HISTORY_ACE,
+	HISTORY_BURNED,
+	HISTORY_DELTA,
+};
+
+struct _HISTORY_CHUNK
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t reserved;
+	uint64_t size;	// header included, a multiple of 8
+};
+
+// followed by the columns in _HISTORY_COLUMN order, each rows * its width padded to 8
+struct _HISTORY_BLOCK
+{
+	_HISTORY_CHUNK chunk;
+	uint32_t rows;
+	uint32_t reserved;
+	int64_t mintime;
+	int64_t maxtime;
+	int64_t minserial;
+	int64_t maxserial;
+};
+
+// followed by tokens _HISTORY_ENTRY, a hand once for each player in it, then serials more, one a hand.
+// both in key order and then in the order of the file
+struct _HISTORY_INDEX
+{
+	_HISTORY_CHUNK chunk;
+	uint32_t tokens;
+	uint32_t serials;
+};
+
+struct _HISTORY_ENTRY
+{
+	int64_t key;
+	uint64_t block;	// offset of the block chunk in the segment
+	uint32_t row;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(_HISTORY_BLOCK) == 56 && sizeof(_HISTORY_INDEX) == 24 && sizeof(_HISTORY_ENTRY) == 24,
+	"the history chunks are part of the file format");
+
+// one bet mode of a day
+struct _HISTORY_TOTALS
+{
+	int64_t hands;
+	int64_t tongits;
+	int64_t pot;	// every total won
+	int64_t hitprize;
+	int64_t regular;
+	int64_t fight;
+	int64_t quadra;
+	int64_t royal;
+	int64_t ace;
+	int64_t burned;
+};
+
+// a segment mapped read only
+struct _HISTORY_VIEW
+{
+	const unsigned char* base;
+	size_t size;
+	size_t valid;	// up to the end of the last whole chunk
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int fd;
+#endif
+};
+
+bool historyopen(const char* filename, _HISTORY_VIEW& view);	// false for a missing or empty segment
+void historyclose(_HISTORY_VIEW& view);
+
+// the block chunk of count hands appended to out
+void historyblock(const _SETTLE_INFO* hands, int count, std::vector<unsigned char>& out);
+// the index chunk of the segment, empty when its last chunk is an index already
+void historyindex(const _HISTORY_VIEW& view, std::vector<unsigned char>& out);
+
+// the last count hands token played in the segment, appended newest first
+void historylast(const _HISTORY_VIEW& view, int64_t token, int count, std::vector<_SETTLE_INFO>& hands);
+bool historyserial(const _HISTORY_VIEW& view, int64_t serial, _SETTLE_INFO& hand);
+void historytotals(const _HISTORY_VIEW& view, _HISTORY_TOTALS* totals, int modes);	// added to, by ectype
+// the hands of the next block from offset at on, 0 at the end of the segment
+int historyread(const _HISTORY_VIEW& view, size_t& at, std::vector<_SETTLE_INFO>& hands);
@@ -0,0 +1,133 @@
+#include "latency.h"
+#include "common.h"
+#include "conf.h"
+#include "user.h"
+#include "metrics.h"
+#include <atomic>
+#include <vector>
+
+const int latencybounds[LATENCY_BUCKETS - 1] = { 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000 };
+
+static const char latencykindnames[(int)_LATENCY_KIND::_MAX][12] = { "server", "roundtrip", "network" };
+static const char latencyectypenames[METRICS_ECTYPES][8] = { "ecoins", "jewels" };
+
+// a sample is a relaxed add on the loop that has it, the reader sums nothing
+struct _LATENCY_HISTOGRAM
+{
+	std::atomic<uint64_t> buckets[LATENCY_BUCKETS];
+	std::atomic<uint64_t> sumusec;
+	std::atomic<uint64_t> breaches;	// over the SLO of its kind, the network has none
+};
+
+static _LATENCY_HISTOGRAM latencyhistograms[METRICS_ECTYPES][LATENCY_REGIONS + 1][(int)_LATENCY_KIND::_MAX];
+static std::vector<_LATENCY_REGION> latencyregions;	// read once, the loops only look
+
+void latencystart()
+{
+	latencyregions = c.getlatencyregions();
+	if (latencyregions.size() > LATENCY_REGIONS)
+		latencyregions.resize(LATENCY_REGIONS);
+
+	for (size_t n = 0; n < latencyregions.size(); n++)
+		MSGLOG(INFO, "Latency region %s is latitude %g to %g, longitude %g to %g.", latencyregions[n].name.c_str(),
+			latencyregions[n].minlatitude, latencyregions[n].maxlatitude, latencyregions[n].minlongitude, latencyregions[n].maxlongitude);
+}
+
+int latencyregion(const _GPS_INFO& gps)
+{
+	if (gps.version == 0)
+		return LATENCY_OTHER;
+
+	for (size_t n = 0; n < latencyregions.size(); n++) {
+		const _LATENCY_REGION& region = latencyregions[n];
+		if (gps.latitude >= region.minlatitude && gps.latitude <= region.maxlatitude &&
+			gps.longitude >= region.minlongitude && gps.longitude <= region.maxlongitude)
+			return (int)n;
+	}
+	return LATENCY_OTHER;
+}
+
+static void latencyadd(unsigned char ectype, int region, _LATENCY_KIND kind, uint64_t usec, int slomsec)
+{
+	if (ectype >= METRICS_ECTYPES || region < 0 || region > LATENCY_OTHER)
+		return;
+
+	_LATENCY_HISTOGRAM& histogram = latencyhistograms[ectype][region][(int)kind];
+	int bucket = 0;
+	while (bucket < LATENCY_BUCKETS - 1 && usec > (uint64_t)latencybounds[bucket])
+		bucket++;
+
+	histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	histogram.sumusec.fetch_add(usec, std::memory_order_relaxed);
+	if (slomsec > 0 && usec > (uint64_t)slomsec * 1000)
+		histogram.breaches.fetch_add(1, std::memory_order_relaxed);
+}
+
+void latencyserver(unsigned char ectype, int region, uint64_t usec)
+{
+	latencyadd(ectype, region, _LATENCY_KIND::_SERVER, usec, c.getserverslomsec());
+}
+
+void latencyreport(unsigned char ectype, int region, uint32_t rttusec, uint32_t serverusec)
+{
+	latencyadd(ectype, region, _LATENCY_KIND::_ROUNDTRIP, rttusec, c.getroundtripslomsec());
+	// a clock of the app that went back, or an answer that was not to this sample
+	if (rttusec >= serverusec)
+		latencyadd(ectype, region, _LATENCY_KIND::_NETWORK, rttusec - serverusec, 0);
+}
+
+// the series that have a sample, a region without any is left out
+std::string latencydump()
+{
+	std::string out;
+	std::string breaches;
+	char szLine[256];
+
+	out += "# HELP tongits_latency_seconds Server time of the stamped requests, round trips the apps saw and the network part of them.\n# TYPE tongits_latency_seconds histogram\n";
+	breaches += "# HELP tongits_latency_slo_breaches_total Server times over Server Time SLO and round trips over Round Trip SLO.\n# TYPE tongits_latency_slo_breaches_total counter\n";
+
+	for (int e = 0; e < METRICS_ECTYPES; e++) {
+		for (int r = 0; r <= LATENCY_OTHER; r++) {
+			const char* region = (r < (int)latencyregions.size()) ? latencyregions[r].name.c_str() : "other";
+			if (r != LATENCY_OTHER && r >= (int)latencyregions.size())
+				continue;
+
+			for (int k = 0; k < (int)_LATENCY_KIND::_MAX; k++) {
+				_LATENCY_HISTOGRAM& histogram = latencyhistograms[e][r][k];
+				uint64_t counts[LATENCY_BUCKETS];
+				uint64_t total = 0;
+				for (int n = 0; n < LATENCY_BUCKETS; n++) {
+					counts[n] = histogram.buckets[n].load(std::memory_order_relaxed);
+					total += counts[n];
+				}
+				if (total == 0)
+					continue;
+
+				uint64_t cumulative = 0;
+				for (int n = 0; n < LATENCY_BUCKETS; n++) {
+					cumulative += counts[n];
+					if (n < LATENCY_BUCKETS - 1)
+						snprintf(szLine, sizeof(szLine), "tongits_latency_seconds_bucket{kind=\"%s\",ectype=\"%s\",region=\"%s\",le=\"%g\"} %llu\n",
+							latencykindnames[k], latencyectypenames[e], region, latencybounds[n] / 1000000.0, (unsigned long long)cumulative);
+					else
+						snprintf(szLine, sizeof(szLine), "tongits_latency_seconds_bucket{kind=\"%s\",ectype=\"%s\",region=\"%s\",le=\"+Inf\"} %llu\n",
+							latencykindnames[k], latencyectypenames[e], region, (unsigned long long)cumulative);
+					out += szLine;
+				}
+				snprintf(szLine, sizeof(szLine), "tongits_latency_seconds_sum{kind=\"%s\",ectype=\"%s\",region=\"%s\"} %g\n"
+					"tongits_latency_seconds_count{kind=\"%s\",ectype=\"%s\",region=\"%s\"} %llu\n",
+					latencykindnames[k], latencyectypenames[e], region, histogram.sumusec.load(std::memory_order_relaxed) / 1000000.0,
+					latencykindnames[k], latencyectypenames[e], region, (unsigned long long)cumulative);
+				out += szLine;
+
+				if ((_LATENCY_KIND)k == _LATENCY_KIND::_NETWORK)
+					continue;
+				snprintf(szLine, sizeof(szLine), "tongits_latency_slo_breaches_total{kind=\"%s\",ectype=\"%s\",region=\"%s\"} %llu\n",
+					latencykindnames[k], latencyectypenames[e], region, (unsigned long long)histogram.breaches.load(std::memory_order_relaxed));
+				breaches += szLine;
+			}
+		}
+	}
+
+	return out + breaches;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// how long a player waits for an answer, split in the time of the server and the time of the network.
+// an app of APK_VER_LATENCY may send an F2 or F3 request inside _PMSG_STAMP_REQ with a stamp of its own
+// clock. the server runs the request and then sends _PMSG_STAMP_ANS with the stamp and the usec from
+// the read callback that brought the bytes of the request to the end of its handler, when its answers
+// are on the connection. the app takes the round trip on its clock and reports the ones it saw with
+// _PMSG_LATENCY_REPORT every while, the round trip less the server usec of the answer is the network.
+// all three land in histograms by bet mode and region, a region is the first of "Latency Regions" the
+// gps fix of the player is in. a server time over "Server Time SLO" or a round trip over "Round Trip
+// SLO" counts as a breach of its kind. served at /metrics of the Stats Port after the gauges
+
+#define LATENCY_REGIONS 8	// of "Latency Regions", the ones past it are not read
+#define LATENCY_OTHER LATENCY_REGIONS	// players without a fix or outside of every region
+#define LATENCY_BUCKETS 14	// usec up to latencybounds[n], the last one above all of them
+
+extern const int latencybounds[LATENCY_BUCKETS - 1];
+
+enum class _LATENCY_KIND
+{
+	_SERVER = 0,
+	_ROUNDTRIP,
+	_NETWORK,
+	_MAX
+};
+
+struct _GPS_INFO;
+
+void latencystart();	// the regions of the conf, before the loops
+int latencyregion(const _GPS_INFO& gps);
+// any loop. ectype is the bet mode of the player, the other modes are not counted
+void latencyserver(unsigned char ectype, int region, uint64_t usec);
+void latencyreport(unsigned char ectype, int region, uint32_t rttusec, uint32_t serverusec);
+std::string latencydump();	// prometheus text
@@ -0,0 +1,448 @@
+#include "leaderboard.h"
+#include "common.h"
+#include "user.h"
+#include "socket.h"
+#include "settle.h"
+#include "taskpool.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+struct _LEADER_NODE;
+
+struct _LEADER_LINK
+{
+	_LEADER_NODE* next;
+	uint32_t span;	// players the link jumps over, the one it lands on included
+};
+
+// allocated with as many links as its levels
+struct _LEADER_NODE
+{
+	int64_t token;
+	int64_t won;
+	char account[20];
+	int levels;
+	_LEADER_LINK links[1];
+};
+
+struct _LEADER_BOARD
+{
+	int64_t period;	// day or week since the epoch the players are of
+	_LEADER_NODE* head;	// no player, LEADER_LEVELS links
+	int levels;
+	uint32_t players;
+	std::unordered_map<int64_t, _LEADER_NODE*> mNodes;	// by token
+};
+
+struct _LEADER_HAND
+{
+	unsigned char ectype;
+	int64_t tokens[MAX_USER_POS];	// 0 for a bot
+	int deltas[MAX_USER_POS];
+	char accounts[MAX_USER_POS][20];
+};
+
+struct _LEADER_HEADER
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t rows;
+	uint32_t reserved2;
+	int64_t time;
+};
+
+struct _LEADER_RECORD
+{
+	int64_t token;
+	int64_t won;
+	int64_t period;
+	unsigned char ectype;
+	unsigned char window;
+	char account[20];
+	unsigned char reserved[2];
+};
+
+static_assert(sizeof(_LEADER_HEADER) == 24 && sizeof(_LEADER_RECORD) == 48, "the leader file has no padding");
+
+static _LEADER_BOARD leaderboards[LEADER_MODES][(int)_LEADER_WINDOW::_MAX];	// loop 0 only
+static uint32_t leaderseed = 0x9E3779B9;
+static bool isleaderdirty = false;
+static bool isleaderwriting = false;
+static uint64_t leaderduetick = 0;
+
+static int64_t leaderperiod(time_t time, int window)
+{
+	int64_t day = (int64_t)time / 86400;
+	// 1970-01-01 was a thursday, the weeks start 3 days later
+	return (window == (int)_LEADER_WINDOW::_DAILY) ? day : (day + 3) / 7;
+}
+
+static _LEADER_NODE* leadernew(int levels)
+{
+	_LEADER_NODE* node = (_LEADER_NODE*)calloc(1, offsetof(_LEADER_NODE, links) + levels * sizeof(_LEADER_LINK));
+	node->levels = levels;
+	return node;
+}
+
+static int leaderlevels()
+{
+	int levels = 1;
+	while (levels < LEADER_LEVELS) {
+		leaderseed ^= leaderseed << 13;
+		leaderseed ^= leaderseed >> 17;
+		leaderseed ^= leaderseed << 5;
+		if ((leaderseed & 3) != 0)
+			break;
+		levels++;
+	}
+	return levels;
+}
+
+// more won first, the older account first on a tie so a rank does not move by itself
+static bool leaderbefore(const _LEADER_NODE* a, const _LEADER_NODE* b)
+{
+	return a->won > b->won || (a->won == b->won && a->token < b->token);
+}
+
+static void leaderclear(_LEADER_BOARD& board, int64_t period)
+{
+	if (board.head == NULL)
+		board.head = leadernew(LEADER_LEVELS);
+
+	_LEADER_NODE* node = board.head->links[0].next;
+	while (node != NULL) {
+		_LEADER_NODE* next = node->links[0].next;
+		free(node);
+		node = next;
+	}
+
+	memset(board.head->links, 0, LEADER_LEVELS * sizeof(_LEADER_LINK));
+	board.period = period;
+	board.levels = 1;
+	board.players = 0;
+	board.mNodes.clear();
+}
+
+static void leaderinsert(_LEADER_BOARD& board, _LEADER_NODE* node)
+{
+	_LEADER_NODE* update[LEADER_LEVELS];
+	uint32_t rank[LEADER_LEVELS];
+	_LEADER_NODE* x = board.head;
+
+	for (int i = board.levels - 1; i >= 0; i--) {
+		rank[i] = (i == board.levels - 1) ? 0 : rank[i + 1];
+		while (x->links[i].next != NULL && leaderbefore(x->links[i].next, node)) {
+			rank[i] += x->links[i].span;
+			x = x->links[i].next;
+		}
+		update[i] = x;
+	}
+
+	if (node->levels > board.levels) {
+		for (int i = board.levels; i < node->levels; i++) {
+			rank[i] = 0;
+			update[i] = board.head;
+			update[i]->links[i].span = board.players;
+		}
+		board.levels = node->levels;
+	}
+
+	for (int i = 0; i < node->levels; i++) {
+		node->links[i].next = update[i]->links[i].next;
+		update[i]->links[i].next = node;
+		node->links[i].span = update[i]->links[i].span - (rank[0] - rank[i]);
+		update[i]->links[i].span = rank[0] - rank[i] + 1;
+	}
+
+	for (int i = node->levels; i < board.levels; i++)
+		update[i]->links[i].span++;
+
+	board.players++;
+}
+
+static void leadererase(_LEADER_BOARD& board, _LEADER_NODE* node)
+{
+	_LEADER_NODE* update[LEADER_LEVELS];
+	_LEADER_NODE* x = board.head;
+
+	for (int i = board.levels - 1; i >= 0; i--) {
+		while (x->links[i].next != NULL && leaderbefore(x->links[i].next, node))
+			x = x->links[i].next;
+		update[i] = x;
+	}
+
+	for (int i = 0; i < board.levels; i++) {
+		if (update[i]->links[i].next == node) {
+			update[i]->links[i].span += node->links[i].span - 1;
+			update[i]->links[i].next = node->links[i].next;
+		}
+		else
+			update[i]->links[i].span--;
+	}
+
+	while (board.levels > 1 && board.head->links[board.levels - 1].next == NULL)
+		board.levels--;
+
+	board.players--;
+}
+
+// 1 for the first, the sum of the spans on the way down to it
+static uint32_t leaderrank(const _LEADER_BOARD& board, const _LEADER_NODE* node)
+{
+	uint32_t rank = 0;
+	_LEADER_NODE* x = board.head;
+
+	for (int i = board.levels - 1; i >= 0; i--) {
+		while (x->links[i].next != NULL && (x->links[i].next == node || leaderbefore(x->links[i].next, node))) {
+			rank += x->links[i].span;
+			x = x->links[i].next;
+		}
+		if (x == node)
+			return rank;
+	}
+	return 0;
+}
+
+// the board as of now, a past day or week starts over
+static _LEADER_BOARD& leaderboard(int ectype, int window, time_t time)
+{
+	_LEADER_BOARD& board = leaderboards[ectype][window];
+	int64_t period = leaderperiod(time, window);
+
+	if (board.head == NULL || board.period != period)
+		leaderclear(board, period);
+	return board;
+}
+
+static void leadermove(_LEADER_BOARD& board, int64_t token, const char* account, int64_t delta)
+{
+	_LEADER_NODE*& node = board.mNodes[token];
+
+	if (node == NULL) {
+		node = leadernew(leaderlevels());
+		node->token = token;
+		node->won = delta;
+		strncpy(node->account, account, sizeof(node->account) - 1);
+		leaderinsert(board, node);
+		return;
+	}
+
+	leadererase(board, node);
+	node->won += delta;
+	leaderinsert(board, node);
+}
+
+static void leaderapply(const _LEADER_HAND& hand)
+{
+	// a hand of a day that ended while it was on the way counts for the new one
+	time_t now = clocktime();
+
+	for (int window = 0; window < (int)_LEADER_WINDOW::_MAX; window++) {
+		_LEADER_BOARD& board = leaderboard(hand.ectype, window, now);
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			if (hand.tokens[i] != 0)
+				leadermove(board, hand.tokens[i], hand.accounts[i], hand.deltas[i]);
+		}
+	}
+	isleaderdirty = true;
+}
+
+void leaderhand(const _SETTLE_INFO& settle, const intptr_t* users)
+{
+	_LEADER_HAND hand;
+	memset(&hand, 0, sizeof(hand));
+	hand.ectype = settle.ectype;
+
+	if (hand.ectype >= LEADER_MODES)
+		return;
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(users[i]);
+		if (userinfo == NULL || userinfo->isbot || settle.seats[i].token <= 0)
+			continue;
+		hand.tokens[i] = settle.seats[i].token;
+		hand.deltas[i] = settle.seats[i].delta;
+		userinfo->account.copyto(hand.accounts[i]);
+	}
+
+	if (le_getloop() > 0) {
+		le_post([hand]() { leaderapply(hand); });
+		return;
+	}
+	leaderapply(hand);
+}
+
+static int leaderclamp(int64_t won)
+{
+	return (won > INT32_MAX) ? INT32_MAX : (won < INT32_MIN) ? INT32_MIN : (int)won;
+}
+
+void leaderquery(uintptr_t userindex, unsigned char ectype, unsigned char window, unsigned char count)
+{
+	if (le_getloop() > 0) {
+		le_post([userindex, ectype, window, count]() { leaderquery(userindex, ectype, window, count); });
+		return;
+	}
+
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || ectype >= LEADER_MODES || window >= (unsigned char)_LEADER_WINDOW::_MAX)
+		return;
+
+	_LEADER_BOARD& board = leaderboard(ectype, window, clocktime());
+	int rows = (count < LEADER_MAX_TOP) ? count : LEADER_MAX_TOP;
+
+	unsigned char buffer[sizeof(_PMSG_LEADER_ANS) + LEADER_MAX_TOP * sizeof(_PMSG_LEADER_ROW)] = { 0 };
+	_PMSG_LEADER_ANS* pMsg = (_PMSG_LEADER_ANS*)buffer;
+	_PMSG_LEADER_ROW* pRows = (_PMSG_LEADER_ROW*)(buffer + sizeof(_PMSG_LEADER_ANS));
+
+	pMsg->ectype = ectype;
+	pMsg->window = window;
+	pMsg->players = (int)board.players;
+
+	auto iter = board.mNodes.find(userinfo->token);
+	if (iter != board.mNodes.end()) {
+		pMsg->rank = (int)leaderrank(board, iter->second);
+		pMsg->won = leaderclamp(iter->second->won);
+	}
+
+	_LEADER_NODE* node = board.head->links[0].next;
+	while (node != NULL && pMsg->count < rows) {
+		memcpy(pRows[pMsg->count].accountid, node->account, sizeof(pRows[pMsg->count].accountid));
+		pRows[pMsg->count].won = leaderclamp(node->won);
+		pMsg->count++;
+		node = node->links[0].next;
+	}
+
+	int size = sizeof(_PMSG_LEADER_ANS) + pMsg->count * sizeof(_PMSG_LEADER_ROW);
+	pMsg->hdr.c = 0xC1;
+	pMsg->hdr.h = 0xF1;
+	pMsg->hdr.len = size;
+	pMsg->sub = 0x0E;
+	::datasend(userindex, buffer, size);
+}
+
+static void leadercollect(std::vector<_LEADER_RECORD>& vrecords)
+{
+	for (int ectype = 0; ectype < LEADER_MODES; ectype++) {
+		for (int window = 0; window < (int)_LEADER_WINDOW::_MAX; window++) {
+			_LEADER_BOARD& board = leaderboards[ectype][window];
+			for (_LEADER_NODE* node = (board.head != NULL) ? board.head->links[0].next : NULL; node != NULL; node = node->links[0].next) {
+				_LEADER_RECORD rec;
+				memset(&rec, 0, sizeof(rec));
+				rec.token = node->token;
+				rec.won = node->won;
+				rec.period = board.period;
+				rec.ectype = (unsigned char)ectype;
+				rec.window = (unsigned char)window;
+				memcpy(rec.account, node->account, sizeof(rec.account));
+				vrecords.push_back(rec);
+			}
+		}
+	}
+}
+
+// written next to the old file and renamed over it like the snapshot
+static bool leaderwrite(const std::vector<_LEADER_RECORD>& vrecords)
+{
+	const char* tmpfile = LEADER_FILE ".tmp";
+	_LEADER_HEADER header = { 0 };
+
+	memcpy(header.magic, LEADER_MAGIC, sizeof(header.magic));
+	header.version = LEADER_VERSION;
+	header.rows = (uint32_t)vrecords.size();
+	header.time = clockwallmsec();
+
+	FILE* fp = fopen(tmpfile, "wb");
+
+	if (fp == NULL) {
+		MSGLOG(ERROR, "leaderwrite, failed to open %s.", tmpfile);
+		return false;
+	}
+
+	bool iswritten = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& (vrecords.empty() || fwrite(vrecords.data(), sizeof(_LEADER_RECORD), vrecords.size(), fp) == vrecords.size());
+
+	if (fclose(fp) != 0)
+		iswritten = false;
+
+	if (!iswritten) {
+		MSGLOG(ERROR, "leaderwrite, failed to write %s.", tmpfile);
+		return false;
+	}
+
+#ifdef _WIN32
+	if (!MoveFileExA(tmpfile, LEADER_FILE, MOVEFILE_REPLACE_EXISTING)) {
+#else
+	if (rename(tmpfile, LEADER_FILE) != 0) {
+#endif
+		MSGLOG(ERROR, "leaderwrite, failed to replace %s.", LEADER_FILE);
+		return false;
+	}
+	return true;
+}
+
+void leaderrun()
+{
+	if (!isleaderdirty || isleaderwriting || clockmsec() < leaderduetick)
+		return;
+
+	std::shared_ptr<std::vector<_LEADER_RECORD>> vrecords = std::make_shared<std::vector<_LEADER_RECORD>>();
+	leadercollect(*vrecords);
+	isleaderdirty = false;
+	isleaderwriting = true;
+
+	tasksubmit(_TASK_LANE::_LOW, [vrecords]() { leaderwrite(*vrecords); }, []() {
+		isleaderwriting = false;
+		leaderduetick = clockmsec() + LEADER_SAVE_MSEC;
+	});
+}
+
+void leaderload()
+{
+	FILE* fp = fopen(LEADER_FILE, "rb");
+	_LEADER_HEADER header;
+	_LEADER_RECORD rec;
+	time_t now = clocktime();
+	int rows = 0;
+
+	if (fp == NULL)
+		return;
+
+	if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, LEADER_MAGIC, sizeof(header.magic)) != 0 || header.version != LEADER_VERSION) {
+		MSGLOG(ERROR, "leaderload, %s is not a leader file of this build.", LEADER_FILE);
+		fclose(fp);
+		return;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+		if (rec.ectype >= LEADER_MODES || rec.window >= (unsigned char)_LEADER_WINDOW::_MAX)
+			continue;
+		_LEADER_BOARD& board = leaderboard(rec.ectype, rec.window, now);
+		if (rec.period != board.period || board.mNodes.count(rec.token) != 0)
+			continue;
+		rec.account[sizeof(rec.account) - 1] = 0;
+		leadermove(board, rec.token, rec.account, rec.won);
+		rows++;
+	}
+	fclose(fp);
+
+	if (rows > 0)
+		MSGLOG(INFO, "Leaderboards of %d players read from %s.", rows, LEADER_FILE);
+}
+
+void leaderflush()
+{
+	if (!isleaderdirty)
+		return;
+
+	std::vector<_LEADER_RECORD> vrecords;
+	leadercollect(vrecords);
+	isleaderdirty = false;
+	leaderwrite(vrecords);
+}
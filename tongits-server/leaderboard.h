@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+
+// the eCoins won by the players of this server, today and this week, by bet mode. every settled hand
+// moves the net delta of each of its players on loop 0, which keeps a board per bet mode and window as
+// a skiplist that counts the players every link jumps over, so a move, the rank of a player and the top
+// of a board take a few dozen steps however many played. the days and weeks are those of UTC, a week
+// starts on a monday, and a board of a past one is empty again on its next move or read. the boards are
+// written whole to LEADER_FILE at most every LEADER_SAVE_MSEC by the task pool, the way the snapshot
+// is, and read back at the next start when they are still of the current day and week
+
+#define LEADER_FILE "tongits.leaders"
+#define LEADER_MAGIC "TGLB"
+#define LEADER_VERSION 1
+#define LEADER_MODES 2	// eCoins and Jewels
+#define LEADER_LEVELS 24	// a link goes up a level one time in four
+#define LEADER_MAX_TOP 20	// rows in one answer
+#define LEADER_SAVE_MSEC 60000
+
+enum class _LEADER_WINDOW : unsigned char
+{
+	_DAILY = 0,
+	_WEEKLY,
+	_MAX,
+};
+
+struct _SETTLE_INFO;
+
+// the table loop of a settled hand, its players are read here and their deltas posted to loop 0
+void leaderhand(const _SETTLE_INFO& settle, const intptr_t* users);
+// any loop, the first count of the board and the rank of the player, answered with 0xF1 0x0E
+void leaderquery(uintptr_t userindex, unsigned char ectype, unsigned char window, unsigned char count);
+void leaderrun();	// on every loop 0 tick
+void leaderload();	// loop 0, before the tables start
+void leaderflush();	// at shutdown once the task pool is stopped
@@ -0,0 +1,103 @@
+#include "lobby.h"
+#include "common.h"
+#include "user.h"
+#include "socket.h"
+#include "packet.h"
+#include "metrics.h"
+#include <vector>
+
+static_assert(sizeof(((_PMSG_LOBBY_INFO*)0)->waiting) / sizeof(int) == METRICS_ECTYPES, "a lobby counter per bet mode of the gauges");
+
+static std::vector<intptr_t> vLobbyWatchers;	// loop 0 only, an entry whose user stopped goes on the next push
+static _PMSG_LOBBY_INFO lobbysent;	// the counters as the subscribers know them
+static uint64_t lobbytick = 0;
+
+static void lobbyread(_PMSG_LOBBY_INFO& info)
+{
+	for (int e = 0; e < METRICS_ECTYPES; e++) {
+		info.waiting[e] = (int)metricsusers((unsigned char)e, (unsigned char)_USER_STATE::_WAITING);
+		info.playing[e] = (int)metricsusers((unsigned char)e, (unsigned char)_USER_STATE::_PLAYING);
+	}
+
+	info.tables = 0;
+	for (int state = (int)_GAME_STATE::_NOTICE; state <= (int)_GAME_STATE::_RESTARTED; state++)
+		info.tables += (int)metricsgames(state);
+}
+
+void lobbywatch(uintptr_t userindex, bool islobby)
+{
+	if (le_getloop() != 0) {
+		le_post([userindex, islobby]() { lobbywatch(userindex, islobby); });
+		return;
+	}
+
+	_USER_INFO* userinfo = guser.getuser(userindex);
+	if (userinfo == NULL)
+		return;
+
+	if (!islobby) {
+		userinfo->islobby = false;
+		return;
+	}
+
+	if (!userinfo->islobby) {
+		userinfo->islobby = true;
+		vLobbyWatchers.push_back((intptr_t)userindex);
+	}
+
+	if (lobbytick == 0)
+		lobbyread(lobbysent);
+
+	_PMSG_LOBBY_INFO pMsg = lobbysent;
+	pMsg.hdr = pkthdr<_PMSG_LOBBY_INFO>(0xF1);
+	pMsg.sub = 0x0C;
+	pMsg.changed = LOBBY_ALL;
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
+
+void lobbyrun()
+{
+	if (clockmsec() < lobbytick)
+		return;
+	lobbytick = clockmsec() + LOBBY_PUSH_MSEC;
+
+	_PMSG_LOBBY_INFO pMsg = pkttemplate<_PMSG_LOBBY_INFO>(0xF1, 0x0C);
+	_PMSG_LOBBY_INFO now;
+	lobbyread(now);
+
+	for (int e = 0; e < METRICS_ECTYPES; e++) {
+		if (now.waiting[e] != lobbysent.waiting[e]) {
+			pMsg.changed |= LOBBY_WAITING(e);
+			pMsg.waiting[e] = now.waiting[e];
+		}
+		if (now.playing[e] != lobbysent.playing[e]) {
+			pMsg.changed |= LOBBY_PLAYING(e);
+			pMsg.playing[e] = now.playing[e];
+		}
+	}
+	if (now.tables != lobbysent.tables) {
+		pMsg.changed |= LOBBY_TABLES;
+		pMsg.tables = now.tables;
+	}
+
+	if (pMsg.changed == 0)
+		return;
+	lobbysent = now;
+
+	// the ones that stopped or dropped their connection are let go here and not where they stopped
+	size_t kept = 0;
+	for (size_t n = 0; n < vLobbyWatchers.size(); n++) {
+		_USER_INFO* userinfo = guser.getuser(vLobbyWatchers[n]);
+		if (userinfo == NULL || !userinfo->islobby)
+			continue;
+		if (!(userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED)) {
+			userinfo->islobby = false;
+			continue;
+		}
+		vLobbyWatchers[kept++] = vLobbyWatchers[n];
+	}
+	vLobbyWatchers.resize(kept);
+
+	if (kept > 0)
+		::datasendall(vLobbyWatchers.data(), (int)kept, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
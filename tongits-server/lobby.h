@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+
+// the lobby counters, players waiting and seated by bet mode and the tables running. they are the
+// gauges of metrics.h, which every setstate of a user and of a table moves as it happens, so nothing is
+// counted here. loop 0 reads them once every LOBBY_PUSH_MSEC and sends the fields that changed to the
+// clients that asked for them, in one _PMSG_LOBBY_INFO encoded once for all of them
+
+#define LOBBY_PUSH_MSEC 1000
+
+// bits of _PMSG_LOBBY_INFO::changed
+#define LOBBY_WAITING(ectype) (1 << (ectype))
+#define LOBBY_PLAYING(ectype) (1 << (2 + (ectype)))
+#define LOBBY_TABLES (1 << 4)
+#define LOBBY_ALL 0x1F
+
+// any loop, a new subscriber gets every counter right away and the changes after that. a subscription
+// ends with islobby false or with the connection
+void lobbywatch(uintptr_t userindex, bool islobby);
+void lobbyrun();	// loop 0, from the loop tick
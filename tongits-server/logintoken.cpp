@@ -0,0 +1,139 @@
+#include "logintoken.h"
+#include "sha256.h"
+#include "common.h"
+#include "conf.h"
+#include <random>
+
+#define LOGINTOKEN_SIZE 24
+#define LOGINTOKEN_SIGNED LOGINTOKEN_SIGNED_SIZE
+
+static _HMAC_SHA256_KEY tokenkey;
+static uint8_t tokenversion = 1;
+static uint32_t tokenseconds = LOGINTOKEN_DEFAULT_DAYS * 86400;
+
+static const char tokenalphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// set once at startup before the loops take logins, read only afterwards
+void logintokeninit()
+{
+	std::string secret = c.gettokensecret();
+
+	if (secret.empty()) {
+		std::random_device rd;
+		uint32_t key[8];
+		for (int n = 0; n < 8; n++)
+			key[n] = rd();
+		hmacsha256key(tokenkey, key, sizeof(key));
+		MSGLOG(INFO, "Token Secret is not set, login tokens last until the server restarts.");
+	}
+	else {
+		hmacsha256key(tokenkey, secret.data(), secret.size());
+	}
+
+	tokenversion = (uint8_t)c.gettokenkeyversion();
+	if (c.gettokendays() > 0)
+		tokenseconds = (uint32_t)c.gettokendays() * 86400;
+
+	MSGLOG(INFO, "Login tokens are signed with key version %d, sha-256 backend is %s.", tokenversion, sha256backend());
+}
+
+static void logintokensign(const uint8_t* raw, uint8_t* mac)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	hmacsha256(tokenkey, raw, LOGINTOKEN_SIGNED, digest);
+	memcpy(mac, digest, LOGINTOKEN_MAC_SIZE);
+}
+
+void logintokenmint(int64_t guiid, char* token)
+{
+	uint8_t raw[LOGINTOKEN_SIZE];
+	uint32_t expiry = (uint32_t)clocktime() + tokenseconds;
+
+	for (int n = 0; n < 6; n++)
+		raw[n] = (uint8_t)(guiid >> (n * 8));
+	for (int n = 0; n < 4; n++)
+		raw[6 + n] = (uint8_t)(expiry >> (n * 8));
+	raw[10] = tokenversion;
+	raw[11] = 0;	// flags
+	logintokensign(raw, raw + LOGINTOKEN_SIGNED);
+
+	for (int n = 0, i = 0; n < LOGINTOKEN_SIZE; n += 3) {
+		uint32_t v = ((uint32_t)raw[n] << 16) | ((uint32_t)raw[n + 1] << 8) | raw[n + 2];
+		token[i++] = tokenalphabet[(v >> 18) & 63];
+		token[i++] = tokenalphabet[(v >> 12) & 63];
+		token[i++] = tokenalphabet[(v >> 6) & 63];
+		token[i++] = tokenalphabet[v & 63];
+	}
+	token[LOGINTOKEN_LENGTH] = 0;
+}
+
+static int logintokendigit(char ch)
+{
+	if (ch >= 'A' && ch <= 'Z')
+		return ch - 'A';
+	if (ch >= 'a' && ch <= 'z')
+		return ch - 'a' + 26;
+	if (ch >= '0' && ch <= '9')
+		return ch - '0' + 52;
+	if (ch == '-')
+		return 62;
+	if (ch == '_')
+		return 63;
+	return -1;
+}
+
+// the guiid of signed bytes that have not expired
+static bool logintokenread(const uint8_t* raw, int64_t& guiid)
+{
+	uint32_t expiry = 0;
+	for (int n = 0; n < 4; n++)
+		expiry |= (uint32_t)raw[6 + n] << (n * 8);
+	if ((uint32_t)clocktime() >= expiry)
+		return false;
+
+	guiid = 0;
+	for (int n = 0; n < 6; n++)
+		guiid |= (int64_t)raw[n] << (n * 8);
+	return guiid != 0;
+}
+
+bool logintokenverify(const char* token, int64_t& guiid)
+{
+	uint8_t raw[LOGINTOKEN_SIZE];
+	uint8_t mac[LOGINTOKEN_MAC_SIZE];
+
+	for (int n = 0, i = 0; n < LOGINTOKEN_SIZE; n += 3) {
+		uint32_t v = 0;
+		for (int k = 0; k < 4; k++) {
+			int digit = logintokendigit(token[i++]);
+			if (digit < 0)
+				return false;
+			v = (v << 6) | (uint32_t)digit;
+		}
+		raw[n] = (uint8_t)(v >> 16);
+		raw[n + 1] = (uint8_t)(v >> 8);
+		raw[n + 2] = (uint8_t)v;
+	}
+
+	if (raw[10] != tokenversion)
+		return false;
+
+	// every byte is compared so the time taken says nothing about where a forged mac went wrong
+	logintokensign(raw, mac);
+	uint8_t diff = 0;
+	for (int n = 0; n < LOGINTOKEN_MAC_SIZE; n++)
+		diff |= mac[n] ^ raw[LOGINTOKEN_SIGNED + n];
+	if (diff != 0)
+		return false;
+
+	return logintokenread(raw, guiid);
+}
+
+bool logintokenmac(const uint8_t* signedbytes, int64_t& guiid, uint8_t* mac)
+{
+	if (signedbytes[10] != tokenversion || !logintokenread(signedbytes, guiid))
+		return false;
+
+	logintokensign(signedbytes, mac);
+	return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+
+// login tokens signed with hmac-sha-256 instead of stored, a token login checks the signature in process
+// and only reads the account by guiid. the 24 bytes below go out as 32 base64url characters, the size
+// of the md5 tokens the clients already keep:
+//   guiid 6 bytes, expiry 4 bytes unix seconds, key version, flags, first 12 bytes of the mac
+// changing Token Secret or Token Key Version in the conf retires every token handed out before
+
+#define LOGINTOKEN_LENGTH 32
+#define LOGINTOKEN_DEFAULT_DAYS 30
+#define LOGINTOKEN_MAC_SIZE 12
+#define LOGINTOKEN_SIGNED_SIZE 12	// the bytes before the mac
+
+void logintokeninit();
+void logintokenmint(int64_t guiid, char* token);	// token holds LOGINTOKEN_LENGTH + 1
+bool logintokenverify(const char* token, int64_t& guiid);	// false for a forged, expired or older token
+// the mac of a token the app names by its signed bytes alone, false for an expired or older one
+bool logintokenmac(const uint8_t* signedbytes, int64_t& guiid, uint8_t* mac);
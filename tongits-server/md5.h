@@ -29,6 +29,16 @@ public:
 		int iKeyIndex							// Űε (0~255)
 	);
 
+	static void MD5_CheckValues(				// MD5_CheckValue over iCount inputs, eight at a time with avx2 or four with neon
+		int iCount,
+		const char* const* lpszInputStrs,
+		const char* const* szKeyVals,
+		const int* iKeyIndexes,
+		bool* bResults							// one verdict per input, the same MD5_CheckValue gives
+	);
+
+	static const char* MD5_Backend();
+
 
 	//---------------------------------------------
 	//	MD5  ޼
@@ -0,0 +1,248 @@
+#include "md5.h"
+#include "md5_keyval.h"
+#include <string.h>
+#include <stdint.h>
+
+// multi-buffer form of MD5_CheckValue for the login storm after a restart. every lane is one password
+// hashed from its keyed initial state, lanes run side by side in the vector registers. a password longer
+// than one block and a key index outside the table take the scalar path so the verdicts never differ.
+// MD5_BATCH_SCALAR builds the scalar path alone, for the test that holds it against the vector one
+
+#if defined(MD5_BATCH_SCALAR)
+#define MD5_BATCH_LANES 1
+#elif defined(_M_X64) || defined(__x86_64__)
+#define MD5_BATCH_AVX2
+#define MD5_BATCH_LANES 8
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MD5_BATCH_TARGET
+#else
+#define MD5_BATCH_TARGET __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MD5_BATCH_NEON
+#define MD5_BATCH_LANES 4
+#include <arm_neon.h>
+#else
+#define MD5_BATCH_LANES 1
+#endif
+
+#define MD5_BATCH_MAXINPUT 55	// what fits one block with its padding
+
+// the 64 steps of MD5::transform, STEP(fn, a, b, c, d, word, shift, constant)
+#define MD5_BATCH_ROUNDS(STEP) \
+	STEP(F, a, b, c, d, 0, S11, 0xd76aa478) STEP(F, d, a, b, c, 1, S12, 0xe8c7b756) \
+	STEP(F, c, d, a, b, 2, S13, 0x242070db) STEP(F, b, c, d, a, 3, S14, 0xc1bdceee) \
+	STEP(F, a, b, c, d, 4, S11, 0xf57c0faf) STEP(F, d, a, b, c, 5, S12, 0x4787c62a) \
+	STEP(F, c, d, a, b, 6, S13, 0xa8304613) STEP(F, b, c, d, a, 7, S14, 0xfd469501) \
+	STEP(F, a, b, c, d, 8, S11, 0x698098d8) STEP(F, d, a, b, c, 9, S12, 0x8b44f7af) \
+	STEP(F, c, d, a, b, 10, S13, 0xffff5bb1) STEP(F, b, c, d, a, 11, S14, 0x895cd7be) \
+	STEP(F, a, b, c, d, 12, S11, 0x6b901122) STEP(F, d, a, b, c, 13, S12, 0xfd987193) \
+	STEP(F, c, d, a, b, 14, S13, 0xa679438e) STEP(F, b, c, d, a, 15, S14, 0x49b40821) \
+	STEP(G, a, b, c, d, 1, S21, 0xf61e2562) STEP(G, d, a, b, c, 6, S22, 0xc040b340) \
+	STEP(G, c, d, a, b, 11, S23, 0x265e5a51) STEP(G, b, c, d, a, 0, S24, 0xe9b6c7aa) \
+	STEP(G, a, b, c, d, 5, S21, 0xd62f105d) STEP(G, d, a, b, c, 10, S22, 0x02441453) \
+	STEP(G, c, d, a, b, 15, S23, 0xd8a1e681) STEP(G, b, c, d, a, 4, S24, 0xe7d3fbc8) \
+	STEP(G, a, b, c, d, 9, S21, 0x21e1cde6) STEP(G, d, a, b, c, 14, S22, 0xc33707d6) \
+	STEP(G, c, d, a, b, 3, S23, 0xf4d50d87) STEP(G, b, c, d, a, 8, S24, 0x455a14ed) \
+	STEP(G, a, b, c, d, 13, S21, 0xa9e3e905) STEP(G, d, a, b, c, 2, S22, 0xfcefa3f8) \
+	STEP(G, c, d, a, b, 7, S23, 0x676f02d9) STEP(G, b, c, d, a, 12, S24, 0x8d2a4c8a) \
+	STEP(H, a, b, c, d, 5, S31, 0xfffa3942) STEP(H, d, a, b, c, 8, S32, 0x8771f681) \
+	STEP(H, c, d, a, b, 11, S33, 0x6d9d6122) STEP(H, b, c, d, a, 14, S34, 0xfde5380c) \
+	STEP(H, a, b, c, d, 1, S31, 0xa4beea44) STEP(H, d, a, b, c, 4, S32, 0x4bdecfa9) \
+	STEP(H, c, d, a, b, 7, S33, 0xf6bb4b60) STEP(H, b, c, d, a, 10, S34, 0xbebfbc70) \
+	STEP(H, a, b, c, d, 13, S31, 0x289b7ec6) STEP(H, d, a, b, c, 0, S32, 0xeaa127fa) \
+	STEP(H, c, d, a, b, 3, S33, 0xd4ef3085) STEP(H, b, c, d, a, 6, S34, 0x04881d05) \
+	STEP(H, a, b, c, d, 9, S31, 0xd9d4d039) STEP(H, d, a, b, c, 12, S32, 0xe6db99e5) \
+	STEP(H, c, d, a, b, 15, S33, 0x1fa27cf8) STEP(H, b, c, d, a, 2, S34, 0xc4ac5665) \
+	STEP(I, a, b, c, d, 0, S41, 0xf4292244) STEP(I, d, a, b, c, 7, S42, 0x432aff97) \
+	STEP(I, c, d, a, b, 14, S43, 0xab9423a7) STEP(I, b, c, d, a, 5, S44, 0xfc93a039) \
+	STEP(I, a, b, c, d, 12, S41, 0x655b59c3) STEP(I, d, a, b, c, 3, S42, 0x8f0ccc92) \
+	STEP(I, c, d, a, b, 10, S43, 0xffeff47d) STEP(I, b, c, d, a, 1, S44, 0x85845dd1) \
+	STEP(I, a, b, c, d, 8, S41, 0x6fa87e4f) STEP(I, d, a, b, c, 15, S42, 0xfe2ce6e0) \
+	STEP(I, c, d, a, b, 6, S43, 0xa3014314) STEP(I, b, c, d, a, 13, S44, 0x4e0811a1) \
+	STEP(I, a, b, c, d, 4, S41, 0xf7537e82) STEP(I, d, a, b, c, 11, S42, 0xbd3af235) \
+	STEP(I, c, d, a, b, 2, S43, 0x2ad7d2bb) STEP(I, b, c, d, a, 9, S44, 0xeb86d391)
+
+// words[n][lane] is word n of the padded block of a lane, state[n][lane] its keyed initial state
+struct _MD5_BATCH
+{
+	uint32_t words[16][MD5_BATCH_LANES];
+	uint32_t state[4][MD5_BATCH_LANES];
+	int inputs[MD5_BATCH_LANES];	// index into the caller's arrays
+	int lanes;
+};
+
+#ifdef MD5_BATCH_AVX2
+#define MD5V_F(x, y, z) _mm256_or_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z))
+#define MD5V_G(x, y, z) _mm256_or_si256(_mm256_and_si256(x, z), _mm256_andnot_si256(z, y))
+#define MD5V_H(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define MD5V_I(x, y, z) _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, ones)))
+#define MD5V_STEP(fn, a, b, c, d, k, s, ac) \
+	a = _mm256_add_epi32(a, _mm256_add_epi32(MD5V_##fn(b, c, d), _mm256_add_epi32(x[k], _mm256_set1_epi32((int)ac)))); \
+	a = _mm256_add_epi32(b, _mm256_or_si256(_mm256_slli_epi32(a, s), _mm256_srli_epi32(a, 32 - s)));
+
+MD5_BATCH_TARGET static void md5batchtransform(_MD5_BATCH& batch)
+{
+	const __m256i ones = _mm256_set1_epi32(-1);
+	__m256i x[16];
+
+	for (int n = 0; n < 16; n++)
+		x[n] = _mm256_loadu_si256((const __m256i*)batch.words[n]);
+
+	__m256i a0 = _mm256_loadu_si256((const __m256i*)batch.state[0]);
+	__m256i b0 = _mm256_loadu_si256((const __m256i*)batch.state[1]);
+	__m256i c0 = _mm256_loadu_si256((const __m256i*)batch.state[2]);
+	__m256i d0 = _mm256_loadu_si256((const __m256i*)batch.state[3]);
+	__m256i a = a0, b = b0, c = c0, d = d0;
+
+	MD5_BATCH_ROUNDS(MD5V_STEP)
+
+	_mm256_storeu_si256((__m256i*)batch.state[0], _mm256_add_epi32(a, a0));
+	_mm256_storeu_si256((__m256i*)batch.state[1], _mm256_add_epi32(b, b0));
+	_mm256_storeu_si256((__m256i*)batch.state[2], _mm256_add_epi32(c, c0));
+	_mm256_storeu_si256((__m256i*)batch.state[3], _mm256_add_epi32(d, d0));
+}
+
+static bool md5batchsupported()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)	// the os saves the ymm registers
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef MD5_BATCH_NEON
+#define MD5V_F(x, y, z) vbslq_u32(x, y, z)
+#define MD5V_G(x, y, z) vbslq_u32(z, x, y)
+#define MD5V_H(x, y, z) veorq_u32(veorq_u32(x, y), z)
+#define MD5V_I(x, y, z) veorq_u32(y, vornq_u32(x, z))
+#define MD5V_STEP(fn, a, b, c, d, k, s, ac) \
+	a = vaddq_u32(a, vaddq_u32(MD5V_##fn(b, c, d), vaddq_u32(x[k], vdupq_n_u32(ac)))); \
+	a = vaddq_u32(b, vsriq_n_u32(vshlq_n_u32(a, s), a, 32 - s));
+
+static void md5batchtransform(_MD5_BATCH& batch)
+{
+	uint32x4_t x[16];
+
+	for (int n = 0; n < 16; n++)
+		x[n] = vld1q_u32(batch.words[n]);
+
+	uint32x4_t a0 = vld1q_u32(batch.state[0]);
+	uint32x4_t b0 = vld1q_u32(batch.state[1]);
+	uint32x4_t c0 = vld1q_u32(batch.state[2]);
+	uint32x4_t d0 = vld1q_u32(batch.state[3]);
+	uint32x4_t a = a0, b = b0, c = c0, d = d0;
+
+	MD5_BATCH_ROUNDS(MD5V_STEP)
+
+	vst1q_u32(batch.state[0], vaddq_u32(a, a0));
+	vst1q_u32(batch.state[1], vaddq_u32(b, b0));
+	vst1q_u32(batch.state[2], vaddq_u32(c, c0));
+	vst1q_u32(batch.state[3], vaddq_u32(d, d0));
+}
+
+static bool md5batchsupported()
+{
+	return true;
+}
+#endif
+
+#if MD5_BATCH_LANES > 1
+static const bool ismd5batch = md5batchsupported();
+
+static void md5batchadd(_MD5_BATCH& batch, int input, const char* str, size_t len, int keyindex)
+{
+	int lane = batch.lanes++;
+	uint8_t block[64] = { 0 };
+
+	memcpy(block, str, len);
+	block[len] = 0x80;
+	uint32_t bits = (uint32_t)len << 3;
+	block[56] = (uint8_t)bits;
+	block[57] = (uint8_t)(bits >> 8);
+
+	for (int n = 0; n < 16; n++)
+		batch.words[n][lane] = (uint32_t)block[n * 4] | ((uint32_t)block[n * 4 + 1] << 8)
+			| ((uint32_t)block[n * 4 + 2] << 16) | ((uint32_t)block[n * 4 + 3] << 24);
+	for (int n = 0; n < 4; n++)
+		batch.state[n][lane] = MD5_KEYVAL[keyindex * 4 + n];
+	batch.inputs[lane] = input;
+}
+
+static void md5batchflush(_MD5_BATCH& batch, const char* const* szKeyVals, bool* bResults)
+{
+	// the unused lanes hash whatever was left in them, their results are not read
+	md5batchtransform(batch);
+
+	for (int lane = 0; lane < batch.lanes; lane++) {
+		const unsigned char* keyval = (const unsigned char*)szKeyVals[batch.inputs[lane]];
+		bool ismatch = true;
+		for (int n = 0; n < 16; n++) {
+			if (keyval[n] != (unsigned char)(batch.state[n / 4][lane] >> ((n % 4) * 8)))
+				ismatch = false;
+		}
+		bResults[batch.inputs[lane]] = ismatch;
+	}
+	batch.lanes = 0;
+}
+#endif
+
+void MD5::MD5_CheckValues(
+	int iCount,
+	const char* const* lpszInputStrs,
+	const char* const* szKeyVals,
+	const int* iKeyIndexes,
+	bool* bResults
+)
+{
+#if MD5_BATCH_LANES > 1
+	if (ismd5batch) {
+		_MD5_BATCH batch;
+		::memset(&batch, 0, sizeof(batch));
+
+		for (int i = 0; i < iCount; i++) {
+			size_t len = strlen(lpszInputStrs[i]);
+			if (len > MD5_BATCH_MAXINPUT || iKeyIndexes[i] < 0 || iKeyIndexes[i] >= MAX_KEY_INDEX) {
+				MD5 pMD5Hash;
+				bResults[i] = pMD5Hash.MD5_CheckValue((char*)lpszInputStrs[i], (char*)szKeyVals[i], iKeyIndexes[i]);
+				continue;
+			}
+			md5batchadd(batch, i, lpszInputStrs[i], len, iKeyIndexes[i]);
+			if (batch.lanes == MD5_BATCH_LANES)
+				md5batchflush(batch, szKeyVals, bResults);
+		}
+		if (batch.lanes != 0)
+			md5batchflush(batch, szKeyVals, bResults);
+		return;
+	}
+#endif
+
+	for (int i = 0; i < iCount; i++) {
+		MD5 pMD5Hash;
+		bResults[i] = pMD5Hash.MD5_CheckValue((char*)lpszInputStrs[i], (char*)szKeyVals[i], iKeyIndexes[i]);
+	}
+}
+
+const char* MD5::MD5_Backend()
+{
+#if defined(MD5_BATCH_AVX2)
+	return ismd5batch ? "avx2" : "scalar";
+#elif defined(MD5_BATCH_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
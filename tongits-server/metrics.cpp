@@ -0,0 +1,186 @@
+#include "metrics.h"
+#include "common.h"
+#include "sms.h"
+#include "dbpool.h"
+
+const int metricswaitbounds[METRICS_WAIT_BUCKETS - 1] = { 1, 2, 5, 10, 30, 60, 120 };
+
+static const char userflagnames[METRICS_USER_FLAGS][16] = {
+	"connected",
+	"loggedin",
+	"waiting",
+	"playing",
+	"disconnected"
+};
+
+static const char gamestatenames[METRICS_GAME_STATES][12] = {
+	"none",
+	"notice",
+	"prepare",
+	"waiting",
+	"started",
+	"restarted",
+	"closed",
+	"ended"
+};
+
+// users and tables change on every loop, a change is a relaxed add and the reader sums nothing
+static std::atomic<int64_t> users[METRICS_ECTYPES][METRICS_USER_FLAGS];
+static std::atomic<int64_t> games[METRICS_GAME_STATES];
+static std::atomic<int64_t> matchqueued(0);
+static std::atomic<uint64_t> matchwaits[METRICS_WAIT_BUCKETS];	// loop 0 only writes them
+static std::atomic<uint64_t> matchwaitmsec(0);
+static std::atomic<int64_t> gpsindexed(0);	// loop 0 only writes them
+static std::atomic<int64_t> gpsnearpairs(0);
+
+static void metricsuseradd(unsigned char ectype, unsigned char state, int delta)
+{
+	if (ectype >= METRICS_ECTYPES)
+		return;
+	for (int n = 0; n < METRICS_USER_FLAGS; n++) {
+		if (state & (1 << n))
+			users[ectype][n].fetch_add(delta, std::memory_order_relaxed);
+	}
+}
+
+void metricsuserstate(unsigned char ectype, unsigned char before, unsigned char after)
+{
+	if (before == after)
+		return;
+	metricsuseradd(ectype, before & ~after, -1);
+	metricsuseradd(ectype, after & ~before, 1);
+}
+
+void metricsuserectype(unsigned char state, unsigned char before, unsigned char after)
+{
+	if (before == after)
+		return;
+	metricsuseradd(before, state, -1);
+	metricsuseradd(after, state, 1);
+}
+
+void metricsgamestate(int before, int after)
+{
+	if (before == after)
+		return;
+	if (before >= 0 && before < METRICS_GAME_STATES)
+		games[before].fetch_add(-1, std::memory_order_relaxed);
+	if (after >= 0 && after < METRICS_GAME_STATES)
+		games[after].fetch_add(1, std::memory_order_relaxed);
+}
+
+void metricsmatchqueued(int delta)
+{
+	matchqueued.fetch_add(delta, std::memory_order_relaxed);
+}
+
+void metricsmatchwait(uint64_t msec)
+{
+	int bucket = 0;
+	while (bucket < METRICS_WAIT_BUCKETS - 1 && msec > (uint64_t)metricswaitbounds[bucket] * 1000)
+		bucket++;
+
+	matchwaits[bucket].store(matchwaits[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	matchwaitmsec.store(matchwaitmsec.load(std::memory_order_relaxed) + msec, std::memory_order_relaxed);
+}
+
+void metricsgpsaudit(int64_t indexed, int64_t nearpairs)
+{
+	gpsindexed.store(indexed, std::memory_order_relaxed);
+	gpsnearpairs.store(nearpairs, std::memory_order_relaxed);
+}
+
+int64_t metricsusers(unsigned char ectype, unsigned char flag)
+{
+	if (ectype >= METRICS_ECTYPES)
+		return 0;
+	for (int n = 0; n < METRICS_USER_FLAGS; n++) {
+		if (flag == (1 << n))
+			return users[ectype][n].load(std::memory_order_relaxed);
+	}
+	return 0;
+}
+
+int64_t metricsgames(int state)
+{
+	if (state < 0 || state >= METRICS_GAME_STATES)
+		return 0;
+	return games[state].load(std::memory_order_relaxed);
+}
+
+void metricsget(_METRICS_SNAPSHOT& snapshot)
+{
+	for (int e = 0; e < METRICS_ECTYPES; e++) {
+		for (int n = 0; n < METRICS_USER_FLAGS; n++)
+			snapshot.users[e][n] = users[e][n].load(std::memory_order_relaxed);
+	}
+	for (int n = 0; n < METRICS_GAME_STATES; n++)
+		snapshot.games[n] = games[n].load(std::memory_order_relaxed);
+	snapshot.matchqueued = matchqueued.load(std::memory_order_relaxed);
+	for (int n = 0; n < METRICS_WAIT_BUCKETS; n++)
+		snapshot.matchwaits[n] = matchwaits[n].load(std::memory_order_relaxed);
+	snapshot.matchwaitmsec = matchwaitmsec.load(std::memory_order_relaxed);
+	snapshot.smsqueued = gethttpstats().queued.load(std::memory_order_relaxed);
+	dbbacklog(snapshot.dbjobs, snapshot.dbledger);
+	snapshot.gpsindexed = gpsindexed.load(std::memory_order_relaxed);
+	snapshot.gpsnearpairs = gpsnearpairs.load(std::memory_order_relaxed);
+}
+
+std::string metricsdump()
+{
+	static const char ectypenames[METRICS_ECTYPES][8] = { "ecoins", "jewels" };
+	_METRICS_SNAPSHOT snapshot;
+	std::string out;
+	char szLine[256];
+
+	metricsget(snapshot);
+
+	out += "# HELP tongits_users Users with the state flag set, by the bet mode they are in.\n# TYPE tongits_users gauge\n";
+	for (int e = 0; e < METRICS_ECTYPES; e++) {
+		for (int n = 0; n < METRICS_USER_FLAGS; n++) {
+			snprintf(szLine, sizeof(szLine), "tongits_users{ectype=\"%s\",state=\"%s\"} %lld\n", ectypenames[e], userflagnames[n], (long long)snapshot.users[e][n]);
+			out += szLine;
+		}
+	}
+
+	out += "# HELP tongits_games Tables by their state.\n# TYPE tongits_games gauge\n";
+	for (int n = 0; n < METRICS_GAME_STATES; n++) {
+		snprintf(szLine, sizeof(szLine), "tongits_games{state=\"%s\"} %lld\n", gamestatenames[n], (long long)snapshot.games[n]);
+		out += szLine;
+	}
+
+	snprintf(szLine, sizeof(szLine), "# HELP tongits_match_queued Players waiting in the match queues.\n# TYPE tongits_match_queued gauge\ntongits_match_queued %lld\n",
+		(long long)snapshot.matchqueued);
+	out += szLine;
+
+	out += "# HELP tongits_match_wait_seconds How long a player waited in the match queue for a table.\n# TYPE tongits_match_wait_seconds histogram\n";
+	uint64_t cumulative = 0;
+	for (int n = 0; n < METRICS_WAIT_BUCKETS; n++) {
+		cumulative += snapshot.matchwaits[n];
+		if (n < METRICS_WAIT_BUCKETS - 1)
+			snprintf(szLine, sizeof(szLine), "tongits_match_wait_seconds_bucket{le=\"%d\"} %llu\n", metricswaitbounds[n], (unsigned long long)cumulative);
+		else
+			snprintf(szLine, sizeof(szLine), "tongits_match_wait_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+		out += szLine;
+	}
+	snprintf(szLine, sizeof(szLine), "tongits_match_wait_seconds_sum %g\ntongits_match_wait_seconds_count %llu\n",
+		snapshot.matchwaitmsec / 1000.0, (unsigned long long)cumulative);
+	out += szLine;
+
+	snprintf(szLine, sizeof(szLine), "# HELP tongits_http_queued Outbound http requests, otp messages among them, not finished yet.\n# TYPE tongits_http_queued gauge\ntongits_http_queued %lld\n",
+		(long long)snapshot.smsqueued);
+	out += szLine;
+	snprintf(szLine, sizeof(szLine), "# HELP tongits_db_jobs Database jobs waiting for a connection.\n# TYPE tongits_db_jobs gauge\ntongits_db_jobs %lld\n",
+		(long long)snapshot.dbjobs);
+	out += szLine;
+	snprintf(szLine, sizeof(szLine), "# HELP tongits_db_ledger Balances not committed to the database yet.\n# TYPE tongits_db_ledger gauge\ntongits_db_ledger %lld\n",
+		(long long)snapshot.dbledger);
+	out += szLine;
+	snprintf(szLine, sizeof(szLine), "# HELP tongits_gps_indexed Players with a gps position on the grid of the audit.\n# TYPE tongits_gps_indexed gauge\ntongits_gps_indexed %lld\n",
+		(long long)snapshot.gpsindexed);
+	out += szLine;
+	snprintf(szLine, sizeof(szLine), "# HELP tongits_gps_near_pairs Players at different tables closer than GPS Limit Distance, as of the last audit.\n# TYPE tongits_gps_near_pairs gauge\ntongits_gps_near_pairs %lld\n",
+		(long long)snapshot.gpsnearpairs);
+	out += szLine;
+	return out;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// gauges of the whole server, moved by whoever changes what they count so a read never walks the user
+// or game tables. served as prometheus text at /metrics of the Stats Port and to the mu admin
+
+#define METRICS_ECTYPES 2	// eCoins, Jewels, the bet modes the games score, users of other modes are not counted
+#define METRICS_USER_FLAGS 5	// _USER_STATE _CONNECTED to _DISCONNECTED, one per bit
+#define METRICS_GAME_STATES 8	// _GAME_STATE _NONE to _ENDED, a _FREE slot is no table
+#define METRICS_WAIT_BUCKETS 8	// seconds in the match queue up to metricswaitbounds[n], the last one above all of them
+
+extern const int metricswaitbounds[METRICS_WAIT_BUCKETS - 1];
+
+struct _METRICS_SNAPSHOT
+{
+	int64_t users[METRICS_ECTYPES][METRICS_USER_FLAGS];	// users with the flag set, by the bet mode they are in
+	int64_t games[METRICS_GAME_STATES];
+	int64_t matchqueued;
+	uint64_t matchwaits[METRICS_WAIT_BUCKETS];
+	uint64_t matchwaitmsec;	// sum of the waits
+	int64_t smsqueued;	// http requests not finished yet, the otp messages among them
+	int64_t dbjobs;
+	int64_t dbledger;	// balances not committed yet
+	int64_t gpsindexed;	// players on the gps grid, as of the last audit
+	int64_t gpsnearpairs;	// seated at different tables and closer than the limit
+};
+
+void metricsuserstate(unsigned char ectype, unsigned char before, unsigned char after);
+void metricsuserectype(unsigned char state, unsigned char before, unsigned char after);
+void metricsgamestate(int before, int after);	// _GAME_STATE values
+void metricsmatchqueued(int delta);
+void metricsmatchwait(uint64_t msec);	// a queued player got a table
+void metricsgpsaudit(int64_t indexed, int64_t nearpairs);
+int64_t metricsusers(unsigned char ectype, unsigned char flag);	// one gauge, flag is a single _USER_STATE bit
+int64_t metricsgames(int state);
+void metricsget(_METRICS_SNAPSHOT& snapshot);
+std::string metricsdump();
@@ -0,0 +1,460 @@
+#include "migrate.h"
+#include "common.h"
+#include "conf.h"
+#include "gamectrl.h"
+#include "socket.h"
+#include "user.h"
+#include "snapshot.h"
+#include "packet.h"
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#define MIGRATE_RECORD_SIZE (sizeof(_MIGRATE_HEADER) + sizeof(_SNAPSHOT_GAME))
+
+typedef std::shared_ptr<std::vector<unsigned char>> _MIGRATE_RECORD;
+
+// one tcp connection, a record going out or coming in, loop 0 only
+struct _MIGRATE_CONN
+{
+	struct bufferevent* bev;
+	int64_t serial;	// of the table going out, 0 for a record coming in
+	int loop;	// of the table going out
+	int64_t wall;	// of the record going out
+	std::string host;	// where its players go, the drain may have stopped meanwhile
+	unsigned short port;
+};
+
+static struct event_base* migratebase = NULL;
+static struct evconnlistener* migratelistener = NULL;
+
+static std::atomic<bool> isdraining(false);
+static std::string draintarget;	// empty when the tables finish here
+static unsigned short drainport = 0;
+static struct sockaddr_storage drainaddr;	// the target's Migrate Port
+static ev_socklen_t drainaddrlen = 0;
+static std::unordered_set<int64_t> draininflight;	// serials frozen or asked to freeze
+static std::unordered_map<int64_t, uint64_t> drainwait;	// serial, not looked at again before
+static uint64_t drainscantick = 0;
+static int drainmoved = 0;
+static int drainfailed = 0;
+static bool isdrained = false;	// logged once every table is gone
+
+static void migratefree(_MIGRATE_CONN* conn)
+{
+	if (conn->bev != NULL)
+		bufferevent_free(conn->bev);
+	delete conn;
+}
+
+// the table plays on here or goes, on its own loop
+static void migratedone(_MIGRATE_CONN* conn, _MIGRATE_RESULT result, int64_t newserial)
+{
+	int64_t serial = conn->serial;
+	int loop = conn->loop;
+	std::string host = conn->host;
+	unsigned short port = conn->port;
+	game* g = gcontrol.getgame(serial);
+
+	migratefree(conn);
+	draininflight.erase(serial);
+
+	if (result == _MIGRATE_RESULT::_OK) {
+		drainwait.erase(serial);
+		drainmoved++;
+		MSGLOG(eMSGTYPE::INFO, "drain, table %lld moved to %s:%d as %lld.", (long long)serial, host.c_str(), port, (long long)newserial);
+		le_postloop(loop, [g, host, port]() { g->migrated(host, port); });
+		return;
+	}
+
+	drainfailed++;
+	drainwait[serial] = clockmsec() + MIGRATE_RETRY_MSEC;
+	MSGLOG(eMSGTYPE::ERROR, "drain, table %lld was not taken by %s, result %d, it plays on here.", (long long)serial,
+		host.c_str(), (int)result);
+	le_postloop(loop, [g]() { g->thaw(); });
+}
+
+static void migrateanswer(_MIGRATE_CONN* conn, const _MIGRATE_ANSWER& answer)
+{
+	if (memcmp(answer.magic, MIGRATE_MAGIC, sizeof(answer.magic)) != 0 || answer.version != MIGRATE_VERSION
+		|| answer.serial != conn->serial || answer.wall != conn->wall
+		|| !clusterverify(&answer, offsetof(_MIGRATE_ANSWER, mac), answer.mac)) {
+		migratedone(conn, _MIGRATE_RESULT::_REFUSED, 0);
+		return;
+	}
+	migratedone(conn, (_MIGRATE_RESULT)answer.result, answer.newserial);
+}
+
+static _MIGRATE_RESULT migrateimport(const unsigned char* record, int64_t& newserial)
+{
+	const _MIGRATE_HEADER* header = (const _MIGRATE_HEADER*)record;
+	const _SNAPSHOT_GAME* s = (const _SNAPSHOT_GAME*)(header + 1);
+
+	newserial = 0;
+
+	if (memcmp(header->magic, MIGRATE_MAGIC, sizeof(header->magic)) != 0 || header->version != MIGRATE_VERSION
+		|| header->gamesize != sizeof(_SNAPSHOT_GAME)) {
+		MSGLOG(eMSGTYPE::ERROR, "drain, a table of another build was refused.");
+		return _MIGRATE_RESULT::_REFUSED;
+	}
+
+	if (!clusterverify(record, MIGRATE_RECORD_SIZE, record + MIGRATE_RECORD_SIZE))
+		return _MIGRATE_RESULT::_REFUSED;
+
+	if (header->wall < clockwallmsec() - MIGRATE_SKEW_MSEC || header->wall > clockwallmsec() + MIGRATE_SKEW_MSEC)
+		return _MIGRATE_RESULT::_REFUSED;
+
+	if (isdraining)
+		return _MIGRATE_RESULT::_DRAINING;
+
+	// a replay, or a table that came here before and is still playing
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		if (!s->users[i].isbot && s->users[i].token > 0 && gcontrol.getsessionuserid((uintptr_t)s->users[i].token) != 0)
+			return _MIGRATE_RESULT::_DUPLICATE;
+	}
+
+	// the table stood still from the freeze until now
+	newserial = gcontrol.importgame(*s, (int64_t)clockmsec() - (int64_t)header->tick);
+	if (newserial == 0)
+		return _MIGRATE_RESULT::_NOSLOTS;
+
+	MSGLOG(eMSGTYPE::INFO, "drain, table %lld of another server seated as %lld.", (long long)s->serial, (long long)newserial);
+	return _MIGRATE_RESULT::_OK;
+}
+
+static void migrateeventcb(struct bufferevent* bev, short events, void* arg);
+
+// the answer is written out before the connection is let go
+static void migrateflushcb(struct bufferevent* bev, void* arg)
+{
+	migratefree((_MIGRATE_CONN*)arg);
+}
+
+static void migratereadcb(struct bufferevent* bev, void* arg)
+{
+	_MIGRATE_CONN* conn = (_MIGRATE_CONN*)arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+	size_t len = evbuffer_get_length(input);
+
+	clockrefresh();
+
+	if (conn->serial != 0) {
+		if (len < sizeof(_MIGRATE_ANSWER))
+			return;
+		_MIGRATE_ANSWER answer;
+		evbuffer_remove(input, &answer, sizeof(answer));
+		migrateanswer(conn, answer);
+		return;
+	}
+
+	if (len < MIGRATE_RECORD_SIZE + CLUSTER_MAC_SIZE)
+		return;
+	if (len > MIGRATE_RECORD_SIZE + CLUSTER_MAC_SIZE) {
+		migratefree(conn);
+		return;
+	}
+
+	std::vector<unsigned char> record(len);
+	evbuffer_remove(input, record.data(), len);
+
+	const _MIGRATE_HEADER* header = (const _MIGRATE_HEADER*)record.data();
+	const _SNAPSHOT_GAME* s = (const _SNAPSHOT_GAME*)(header + 1);
+
+	_MIGRATE_ANSWER answer;
+	memset(&answer, 0, sizeof(answer));
+	answer.result = (uint8_t)migrateimport(record.data(), answer.newserial);
+	memcpy(answer.magic, MIGRATE_MAGIC, sizeof(answer.magic));
+	answer.version = MIGRATE_VERSION;
+	answer.serial = s->serial;
+	answer.wall = header->wall;
+	clustersign(&answer, offsetof(_MIGRATE_ANSWER, mac), answer.mac);
+
+	bufferevent_disable(bev, EV_READ);
+	bufferevent_setcb(bev, NULL, migrateflushcb, migrateeventcb, conn);
+	bufferevent_write(bev, &answer, sizeof(answer));
+}
+
+static void migrateeventcb(struct bufferevent* bev, short events, void* arg)
+{
+	_MIGRATE_CONN* conn = (_MIGRATE_CONN*)arg;
+
+	if (events & BEV_EVENT_CONNECTED)
+		return;
+
+	clockrefresh();
+
+	if (conn->serial != 0) {
+		MSGLOG(eMSGTYPE::ERROR, "drain, %s for table %lld at %s.", (events & BEV_EVENT_TIMEOUT) ? "no answer" : "connection lost",
+			(long long)conn->serial, conn->host.c_str());
+		migratedone(conn, _MIGRATE_RESULT::_REFUSED, 0);
+		return;
+	}
+	migratefree(conn);
+}
+
+static void migrateacceptcb(struct evconnlistener*, evutil_socket_t fd, struct sockaddr*, int, void*)
+{
+	struct timeval tv = { MIGRATE_TIMEOUT_MSEC / 1000, (MIGRATE_TIMEOUT_MSEC % 1000) * 1000 };
+	_MIGRATE_CONN* conn = new _MIGRATE_CONN();
+
+	conn->bev = bufferevent_socket_new(migratebase, fd, BEV_OPT_CLOSE_ON_FREE);
+	conn->serial = 0;
+	conn->loop = -1;
+	conn->wall = 0;
+	conn->port = 0;
+	if (conn->bev == NULL) {
+		evutil_closesocket(fd);
+		delete conn;
+		return;
+	}
+
+	bufferevent_setcb(conn->bev, migratereadcb, NULL, migrateeventcb, conn);
+	bufferevent_set_timeouts(conn->bev, &tv, &tv);
+	bufferevent_enable(conn->bev, EV_READ | EV_WRITE);
+}
+
+// loop 0, the record of a frozen table goes to the target. NULL when the table was not between turns
+static void drainsend(int64_t serial, int loop, _MIGRATE_RECORD record)
+{
+	if (record == nullptr) {
+		draininflight.erase(serial);
+		drainwait[serial] = clockmsec() + MIGRATE_RETRY_MSEC;
+		return;
+	}
+
+	struct timeval tv = { MIGRATE_TIMEOUT_MSEC / 1000, (MIGRATE_TIMEOUT_MSEC % 1000) * 1000 };
+	_MIGRATE_CONN* conn = new _MIGRATE_CONN();
+	_MIGRATE_HEADER* header = (_MIGRATE_HEADER*)record->data();
+
+	clustersign(record->data(), MIGRATE_RECORD_SIZE, record->data() + MIGRATE_RECORD_SIZE);
+	conn->serial = serial;
+	conn->loop = loop;
+	conn->wall = header->wall;
+	conn->host = draintarget;
+	conn->port = drainport;
+	conn->bev = bufferevent_socket_new(migratebase, -1, BEV_OPT_CLOSE_ON_FREE);
+
+	if (conn->bev == NULL || bufferevent_socket_connect(conn->bev, (struct sockaddr*)&drainaddr, (int)drainaddrlen) != 0) {
+		MSGLOG(eMSGTYPE::ERROR, "drain, no connection to %s for table %lld.", draintarget.c_str(), (long long)serial);
+		migratedone(conn, _MIGRATE_RESULT::_REFUSED, 0);
+		return;
+	}
+
+	bufferevent_setcb(conn->bev, migratereadcb, NULL, migrateeventcb, conn);
+	bufferevent_set_timeouts(conn->bev, &tv, &tv);
+	bufferevent_enable(conn->bev, EV_READ | EV_WRITE);
+	bufferevent_write(conn->bev, record->data(), record->size());
+}
+
+// on the loop of the table, which is captured and frozen only between turns
+static void drainfreeze(int64_t serial, int loop)
+{
+	game* g = gcontrol.getgame(serial);
+	_MIGRATE_RECORD record;
+
+	if (g != NULL && g->getloop() == loop && g->ismigratable()) {
+		record = std::make_shared<std::vector<unsigned char>>(MIGRATE_RECORD_SIZE + CLUSTER_MAC_SIZE, 0);
+		_MIGRATE_HEADER* header = (_MIGRATE_HEADER*)record->data();
+		_SNAPSHOT_GAME* s = (_SNAPSHOT_GAME*)(header + 1);
+
+		if (g->savesnapshot(*s)) {
+			memcpy(header->magic, MIGRATE_MAGIC, sizeof(header->magic));
+			header->version = MIGRATE_VERSION;
+			header->gamesize = sizeof(_SNAPSHOT_GAME);
+			header->wall = clockwallmsec();
+			header->tick = clockmsec();
+			g->freeze();
+		}
+		else
+			record.reset();
+	}
+
+	le_post([serial, loop, record]() { drainsend(serial, loop, record); });
+}
+
+bool migratestart(struct event_base* base)
+{
+	migratebase = base;
+
+	if (c.getmigrateport() == 0)
+		return true;
+
+	// the records are signed with the key of the cluster
+	if (clusterrole() == _CLUSTER_ROLE::_NONE) {
+		MSGLOG(eMSGTYPE::ERROR, "drain, Migrate Port needs a Cluster Role, no tables are taken in.");
+		return false;
+	}
+
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(c.getmigrateport());
+
+	migratelistener = evconnlistener_new_bind(base, migrateacceptcb, NULL, LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, -1,
+		(struct sockaddr*)&sin, sizeof(sin));
+	if (migratelistener == NULL) {
+		MSGLOG(eMSGTYPE::ERROR, "drain, evconnlistener_new_bind failed at migrate port %d.", c.getmigrateport());
+		return false;
+	}
+
+	MSGLOG(eMSGTYPE::INFO, "drain, tables of draining nodes are taken in at tcp port %d.", c.getmigrateport());
+	return true;
+}
+
+void migratestop()
+{
+	if (migratelistener != NULL)
+		evconnlistener_free(migratelistener);
+	migratelistener = NULL;
+}
+
+bool drainisactive()
+{
+	return isdraining;
+}
+
+// the target is read on loop 0
+bool drainredirect(uintptr_t userindex, unsigned char gametype)
+{
+	if (!isdraining)
+		return false;
+
+	le_post([userindex, gametype]() {
+		if (draintarget.empty() || !clustersendto(userindex, draintarget, drainport, gametype))
+			guser.sendnotice(userindex, 8, _NOTICE_ID::_MODEOFF);
+	});
+	return true;
+}
+
+static void drainanswer(uintptr_t userindex, int aindex, unsigned char action, _DRAIN_RESULT result)
+{
+	_PMSG_DRAIN_ANS pMsg = { 0 };
+	pMsg.hdr.c = 0xC2;
+	pMsg.hdr.h = 0xF4;
+	pMsg.hdr.len[0] = SET_NUMBERH(sizeof(pMsg));
+	pMsg.hdr.len[1] = SET_NUMBERL(sizeof(pMsg));
+	pMsg.sub = 0x0A;
+	pMsg.aindex = aindex;
+	pMsg.action = action;
+	pMsg.result = (unsigned char)result;
+	pMsg.isdraining = isdraining ? 1 : 0;
+	pMsg.port = drainport;
+	strncpy(pMsg.host, draintarget.c_str(), sizeof(pMsg.host) - 1);
+	pMsg.tables = gcontrol.getactivegames();
+	pMsg.inflight = (int)draininflight.size();
+	pMsg.moved = drainmoved;
+	pMsg.failed = drainfailed;
+	::datasend(userindex, (unsigned char*)&pMsg, sizeof(pMsg));
+}
+
+static _DRAIN_RESULT drainstart(const std::string& host, unsigned short port)
+{
+	if (isdraining)
+		return _DRAIN_RESULT::_BADSTATE;
+
+	drainaddrlen = 0;
+
+	if (!host.empty()) {
+		if (clusterrole() == _CLUSTER_ROLE::_NONE || c.getmigrateport() == 0)
+			return _DRAIN_RESULT::_NOMIGRATE;
+
+		struct evutil_addrinfo hints;
+		struct evutil_addrinfo* answer = NULL;
+		char service[8];
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		snprintf(service, sizeof(service), "%d", c.getmigrateport());
+
+		if (evutil_getaddrinfo(host.c_str(), service, &hints, &answer) != 0 || answer == NULL)
+			return _DRAIN_RESULT::_BADTARGET;
+		memcpy(&drainaddr, answer->ai_addr, answer->ai_addrlen);
+		drainaddrlen = (ev_socklen_t)answer->ai_addrlen;
+		evutil_freeaddrinfo(answer);
+	}
+
+	draintarget = host;
+	drainport = (port != 0) ? port : c.getnodeport();
+	drainwait.clear();
+	drainmoved = 0;
+	drainfailed = 0;
+	isdrained = false;
+	isdraining = true;
+
+	if (host.empty())
+		MSGLOG(eMSGTYPE::INFO, "drain, no new tables, the %d playing finish here.", gcontrol.getactivegames());
+	else
+		MSGLOG(eMSGTYPE::INFO, "drain, no new tables, the %d playing move to %s:%d.", gcontrol.getactivegames(), host.c_str(), drainport);
+	return _DRAIN_RESULT::_OK;
+}
+
+void drainadmin(uintptr_t userindex, int aindex, unsigned char action, const char* host, unsigned short port)
+{
+	if (le_getloop() != 0) {
+		std::string target = host;
+		le_post([userindex, aindex, action, target, port]() { drainadmin(userindex, aindex, action, target.c_str(), port); });
+		return;
+	}
+
+	_DRAIN_RESULT result = _DRAIN_RESULT::_OK;
+
+	switch ((_DRAIN_ACTION)action) {
+	case _DRAIN_ACTION::_START:
+		result = drainstart(host, port);
+		break;
+
+	case _DRAIN_ACTION::_STOP:
+		if (!isdraining) {
+			result = _DRAIN_RESULT::_BADSTATE;
+			break;
+		}
+		// the tables on the way finish their move
+		isdraining = false;
+		draintarget.clear();
+		drainaddrlen = 0;
+		MSGLOG(eMSGTYPE::INFO, "drain, stopped, %d tables moved, %d tries failed.", drainmoved, drainfailed);
+		break;
+
+	case _DRAIN_ACTION::_STATUS:
+		break;
+
+	default:
+		return;
+	}
+
+	drainanswer(userindex, aindex, action, result);
+}
+
+void drainrun()
+{
+	if (!isdraining || clockmsec() < drainscantick)
+		return;
+	drainscantick = clockmsec() + MIGRATE_SCAN_MSEC;
+
+	if (!isdrained && gcontrol.getactivegames() == 0) {
+		isdrained = true;
+		MSGLOG(eMSGTYPE::INFO, "drain, no table left, %d moved.", drainmoved);
+	}
+
+	if (drainaddrlen == 0)
+		return;
+
+	for (int64_t serial = 1; (int)draininflight.size() < MIGRATE_INFLIGHT; serial++) {
+		game* g = gcontrol.getgame(serial);
+		if (g == NULL)
+			break;
+
+		// a free slot, or one whose loop decides at the freeze
+		int loop = g->getloop();
+		if (loop < 0 || draininflight.count(serial) != 0)
+			continue;
+
+		auto wait = drainwait.find(serial);
+		if (wait != drainwait.end() && clockmsec() < wait->second)
+			continue;
+
+		draininflight.insert(serial);
+		le_postloop(loop, [serial, loop]() { drainfreeze(serial, loop); });
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include "cluster.h"
+
+// a node taken out of service. "drain" stops new tables here: a player who asks for one is sent to the
+// target node and the router sees this node as full. with a target the running tables move there too.
+// a table is frozen between two turns or two hands and its snapshot record goes over tcp to the target's
+// Migrate Port, signed with the Token Secret. the target seats it under a serial of its own and starts the
+// sessions of its players. once it answers, the connected players are sent there with a resume redirect
+// and the table is let go here without a settlement. a table the target turns down, or does not answer
+// for in MIGRATE_TIMEOUT_MSEC, plays on here and is tried again after MIGRATE_RETRY_MSEC. when only the
+// answer was lost the target holds a copy nobody comes back to, which closes like any table left alone
+//
+// the record is the raw struct of snapshot.h, so tables only move between builds of the same layout and
+// the target refuses any other. a player who is away when its table moves finds it through the session
+// directory, with a local Session Store only the connected ones follow it. tournament tables finish here,
+// loop 0 of this server counts their hands
+
+#define MIGRATE_MAGIC "TGMG"
+#define MIGRATE_VERSION 1
+#define MIGRATE_INFLIGHT 4	// tables frozen and on the way at once
+#define MIGRATE_SCAN_MSEC 500
+#define MIGRATE_TIMEOUT_MSEC 5000
+#define MIGRATE_RETRY_MSEC 2000	// a table that was not between turns or was refused is looked at again after
+#define MIGRATE_SKEW_MSEC 30000	// a record older than this by the wall clock of its sender is a replay
+
+enum class _DRAIN_ACTION : unsigned char
+{
+	_START = 0,
+	_STOP,
+	_STATUS,
+};
+
+enum class _DRAIN_RESULT : unsigned char
+{
+	_OK = 0,
+	_BADSTATE,	// start while draining, stop while not
+	_NOMIGRATE,	// a target without Cluster Role and Migrate Port
+	_BADTARGET,	// the host does not resolve
+};
+
+enum class _MIGRATE_RESULT : unsigned char
+{
+	_OK = 0,
+	_REFUSED,	// not a record of this build, a bad mac or too old
+	_DRAINING,
+	_DUPLICATE,	// one of its players already has a table here
+	_NOSLOTS,	// past Max Games or Max Users
+};
+
+// followed by the _SNAPSHOT_GAME and the mac of both
+struct _MIGRATE_HEADER
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t gamesize;	// sizeof(_SNAPSHOT_GAME) of the sender
+	uint32_t reserved2;
+	int64_t wall;	// clockwallmsec of the sender
+	uint64_t tick;	// clockmsec of the sender when the table was frozen, it stands still from here
+};
+
+static_assert(sizeof(_MIGRATE_HEADER) == 32, "_MIGRATE_HEADER keeps the record 8 byte aligned");
+
+struct _MIGRATE_ANSWER
+{
+	char magic[4];
+	uint16_t version;
+	uint8_t result;	// _MIGRATE_RESULT
+	uint8_t reserved;
+	int64_t serial;	// of the table at the sender
+	int64_t wall;	// of the record, an answer belongs to it
+	int64_t newserial;	// at the target
+	uint8_t mac[CLUSTER_MAC_SIZE];	// of everything before it
+};
+
+static_assert(sizeof(_MIGRATE_ANSWER) == 48, "_MIGRATE_ANSWER has no padding");
+
+bool migratestart(struct event_base* base);	// after clusterstart, false when Migrate Port can not be used
+void migratestop();
+
+bool drainisactive();
+// a player that asks for a table on a draining node, true when it was sent on or told no
+bool drainredirect(uintptr_t userindex, unsigned char gametype);
+void drainadmin(uintptr_t userindex, int aindex, unsigned char action, const char* host, unsigned short port);
+void drainrun();	// on every loop 0 tick
@@ -92,7 +92,7 @@ namespace daotk {
 			va_start(vargs, fmt_str);
 			std::string res = format_string_vargs(fmt_str, vargs);
 			va_end(vargs);
-			return std::move(res);
+			return res;
 		}
 
 
@@ -103,7 +103,7 @@ namespace daotk {
 
 		// iterator class that can be used for iterating returned result rows
 		template <typename... Values>
-		class result_iterator : std::iterator<std::random_access_iterator_tag, std::tuple<Values...>, int> {
+		class result_iterator {
 		protected:
 			results* res;
 			std::shared_ptr<std::tuple<Values...>> data;
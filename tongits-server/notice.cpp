@@ -0,0 +1,82 @@
+#include "notice.h"
+
+static const char* noticetexts[(int)_NOTICE_ID::_MAX] = {
+	"",
+	"%s does'nt have enough %s to continue.",
+	"%d %s minimum is required to play.",
+	"%s Tongits!",
+	"You have %d sec. to group your cards, ungrouped cards will be counted.",
+	"It's not your turn yet!",
+	"You have'nt drawn nor chow card(s) yet!",
+	"You don't have a house yet!",
+	"You already fought!",
+	"You don't have a house nor quadra nor royal!",
+	"%s Sagasa!",
+	"You can't dump the card.",
+	"You have %d sec. to group your cards, only ungrouped cards will be counted.",
+	"%s is the Hitter.",
+	"There has no enough players to continue, ending game...",
+	"Your location is invalid so you will be kicked from this game.",
+	"%s won and got the hits by default!",
+	"Too many attempts, please try again later.",
+	"The game mode you chosed is disabled at the moment.",
+	"You are using an outdated app, please update our app from playstore.",
+	"Your app is outdated, you can get the updated version from our Download page.",
+	"%d %s has been added to your account.",
+	"%d %s has been deducted to your account.",
+	"You have entered a wrong OTP code.",
+	"Fetching your account's data failed!",
+	"You mobile number %s is invalid, format should be like 09170342328.",
+	"Your account is already logged in!",
+	"Something went wrong with our OTP system, please try again in few minutes.",
+	"OTP code is sent to your mobile number %s.",
+	"Wrong username or password!",
+	"The server is busy, please try again in a moment.",
+};
+
+// only %d and %s, each takes the next argument of the packet, a missing one prints nothing
+void noticetext(const _NOTICE& n, _PMSG_NOTICEMSG& text)
+{
+	const _PMSG_NOTICEID* p = n.packet();
+	const unsigned char* arg = n.data + sizeof(_PMSG_NOTICEID);
+	const unsigned char* end = n.data + p->hdr.len;
+	const char* fmt = (p->id < (int)_NOTICE_ID::_MAX) ? noticetexts[p->id] : "";
+	size_t out = 0;
+	size_t max = sizeof(text.msg) - 1;
+
+	text = pkttemplate<_PMSG_NOTICEMSG>(0xF2, 0x00);
+	text.type = p->type;
+
+	for (; *fmt != 0 && out < max; fmt++) {
+		if (fmt[0] != '%' || (fmt[1] != 'd' && fmt[1] != 's')) {
+			text.msg[out++] = *fmt;
+			continue;
+		}
+
+		fmt++;
+		if (*fmt == 'd' && arg + sizeof(int) <= end) {
+			int v;
+			memcpy(&v, arg, sizeof(v));
+			arg += sizeof(v);
+
+			char num[12];
+			int len = 0;
+			unsigned int u = (v < 0) ? 0u - (unsigned int)v : (unsigned int)v;
+			do {
+				num[len++] = (char)('0' + u % 10);
+				u /= 10;
+			} while (u != 0);
+			if (v < 0)
+				num[len++] = '-';
+			while (len > 0 && out < max)
+				text.msg[out++] = num[--len];
+		}
+		else if (*fmt == 's' && arg < end && arg + 1 + arg[0] <= end) {
+			size_t len = arg[0];
+			for (size_t i = 0; i < len && out < max; i++)
+				text.msg[out++] = (char)arg[1 + i];
+			arg += 1 + len;
+		}
+	}
+	text.msg[out] = 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "prodef.h"
+#include "packet.h"
+#include <string.h>
+#include <string>
+
+// notices by number. an app of APK_VER_NOTICE_ID gets F2 0B, the id and its arguments, and shows the
+// text of the id in the language of the player. the other apps get the english text below formatted
+// from the same arguments as before, only when one of them is there to read it. the arguments follow
+// the id in the order of the text, a number as a 4 byte int and a text as a length byte and its bytes
+
+#define NOTICE_MAX_SIZE 128	// of the packet with its arguments
+#define NOTICE_MAX_STRING 40	// longer text arguments are cut
+
+enum class _NOTICE_ID : unsigned short
+{
+	_NONE = 0,
+	_NOTENOUGH,	// %s does'nt have enough %s to continue.
+	_MINIMUM,	// %d %s minimum is required to play.
+	_TONGITS,	// %s Tongits!
+	_GROUPTIME,	// You have %d sec. to group your cards, ungrouped cards will be counted.
+	_NOTTURN,
+	_NOTDRAWN,
+	_NOHOUSE,
+	_FOUGHT,
+	_NOFIGHT,
+	_SAGASA,	// %s Sagasa!
+	_NODUMP,
+	_FIGHTGROUPTIME,	// You have %d sec. to group your cards, only ungrouped cards will be counted.
+	_HITTER,	// %s is the Hitter.
+	_NOPLAYERS,
+	_BADLOCATION,
+	_DEFAULTWIN,	// %s won and got the hits by default!
+	_TOOMANY,
+	_MODEOFF,
+	_OUTDATED,
+	_OUTDATEDWEB,
+	_ADDED,	// %d %s has been added to your account.
+	_DEDUCTED,	// %d %s has been deducted to your account.
+	_WRONGOTP,
+	_FETCHFAILED,
+	_BADMOBILE,	// You mobile number %s is invalid, format should be like 09170342328.
+	_LOGGEDIN,
+	_OTPFAILED,
+	_OTPSENT,	// OTP code is sent to your mobile number %s.
+	_WRONGLOGIN,
+	_BUSY,
+	_MAX,
+};
+
+struct _NOTICE
+{
+	unsigned char data[NOTICE_MAX_SIZE];	// _PMSG_NOTICEID and the arguments
+
+	_PMSG_NOTICEID* packet() { return (_PMSG_NOTICEID*)this->data; }
+	const _PMSG_NOTICEID* packet() const { return (const _PMSG_NOTICEID*)this->data; }
+};
+
+inline void noticearg(_NOTICE& n, int v)
+{
+	_PMSG_NOTICEID* p = n.packet();
+	if (p->hdr.len + sizeof(v) > NOTICE_MAX_SIZE)
+		return;
+	memcpy(&n.data[p->hdr.len], &v, sizeof(v));
+	p->hdr.len += sizeof(v);
+}
+
+inline void noticearg(_NOTICE& n, const char* v)
+{
+	_PMSG_NOTICEID* p = n.packet();
+	size_t len = strnlen(v, NOTICE_MAX_STRING);
+	if (p->hdr.len + 1 + len > NOTICE_MAX_SIZE)
+		return;
+	n.data[p->hdr.len] = (unsigned char)len;
+	memcpy(&n.data[p->hdr.len + 1], v, len);
+	p->hdr.len += (unsigned short)(1 + len);
+}
+
+inline void noticearg(_NOTICE& n, const std::string& v)
+{
+	noticearg(n, v.c_str());
+}
+
+template <typename... A>
+void noticemake(_NOTICE& n, unsigned char type, _NOTICE_ID id, const A&... args)
+{
+	_PMSG_NOTICEID* p = n.packet();
+	*p = pkttemplate<_PMSG_NOTICEID>(0xF2, 0x0B);
+	p->type = type;
+	p->id = (unsigned short)id;
+	(noticearg(n, args), ...);
+}
+
+// the english text of a notice as the packet of the apps that do not know the numbers
+void noticetext(const _NOTICE& n, _PMSG_NOTICEMSG& text);
@@ -0,0 +1,147 @@
+#include "otp.h"
+#include "common.h"
+#include "ratelimit.h"
+#include <mutex>
+#include <vector>
+
+struct _OTP_ENTRY
+{
+	uint64_t key;
+	char mobilenum[16];
+	int code;
+	int attempts;	// wrong guesses
+	uint64_t senttick;	// clockmsec of its last sms
+	uint64_t expiretick;
+	bool isused;
+};
+
+static std::mutex otplock;
+static _OTP_ENTRY otptable[OTP_TABLE_SIZE];
+static std::vector<uint32_t> otpwheel[OTP_WHEEL_SLOTS];	// entries by the slot of their expiry
+static uint64_t otpwheelslot = 0;	// the first slot number otpexpire has not looked at
+
+static int otpslot(uint64_t key)
+{
+	return (int)((key * 0x9E3779B97F4A7C15ULL) >> 40) & (OTP_TABLE_SIZE - 1);
+}
+
+static _OTP_ENTRY* otpfind(const std::string& mobilenum, uint64_t key, uint64_t now)
+{
+	int slot = otpslot(key);
+
+	for (int n = 0; n < OTP_PROBES; n++) {
+		_OTP_ENTRY* e = &otptable[(slot + n) & (OTP_TABLE_SIZE - 1)];
+		if (e->isused && e->key == key && e->expiretick > now && mobilenum == e->mobilenum)
+			return e;
+	}
+	return NULL;
+}
+
+// a free or expired entry of the run, else the one that expires first
+static _OTP_ENTRY* otpvictim(uint64_t key, uint64_t now)
+{
+	int slot = otpslot(key);
+	_OTP_ENTRY* victim = NULL;
+
+	for (int n = 0; n < OTP_PROBES; n++) {
+		_OTP_ENTRY* e = &otptable[(slot + n) & (OTP_TABLE_SIZE - 1)];
+		if (!e->isused || e->expiretick <= now)
+			return e;
+		if (victim == NULL || e->expiretick < victim->expiretick)
+			victim = e;
+	}
+	return victim;
+}
+
+static void otpschedule(_OTP_ENTRY* e)
+{
+	otpwheel[(e->expiretick / OTP_SLOT_MSEC) % OTP_WHEEL_SLOTS].push_back((uint32_t)(e - otptable));
+}
+
+int otpissue(const std::string& mobilenum, bool& issend)
+{
+	uint64_t key = ratekey(mobilenum.c_str(), mobilenum.length());
+	uint64_t now = clockmsec();
+	std::lock_guard<std::mutex> lock(otplock);
+
+	_OTP_ENTRY* e = otpfind(mobilenum, key, now);
+	issend = (e == NULL || now >= e->senttick + OTP_RESEND_MSEC);
+
+	if (e == NULL) {
+		e = otpvictim(key, now);
+		e->key = key;
+		strncpy(e->mobilenum, mobilenum.c_str(), sizeof(e->mobilenum) - 1);
+		e->mobilenum[sizeof(e->mobilenum) - 1] = 0;
+		e->code = rand() % 9000 + 1000;
+		e->attempts = 0;
+		e->isused = true;
+	}
+
+	// a resend renews the code it carries
+	if (issend) {
+		e->senttick = now;
+		e->expiretick = now + OTP_EXPIRE_MSEC;
+		otpschedule(e);
+	}
+	return e->code;
+}
+
+_OTP_RESULT otpverify(const std::string& mobilenum, int code)
+{
+	uint64_t key = ratekey(mobilenum.c_str(), mobilenum.length());
+	std::lock_guard<std::mutex> lock(otplock);
+
+	_OTP_ENTRY* e = otpfind(mobilenum, key, clockmsec());
+	if (e == NULL)
+		return _OTP_RESULT::_NONE;
+
+	if (e->code == code) {
+		e->isused = false;
+		return _OTP_RESULT::_OK;
+	}
+
+	if (++e->attempts < OTP_MAX_ATTEMPTS)
+		return _OTP_RESULT::_WRONG;
+	e->isused = false;
+	return _OTP_RESULT::_LOCKED;
+}
+
+void otpdrop(const std::string& mobilenum, int code)
+{
+	uint64_t key = ratekey(mobilenum.c_str(), mobilenum.length());
+	std::lock_guard<std::mutex> lock(otplock);
+
+	// a newer code of the number stays
+	_OTP_ENTRY* e = otpfind(mobilenum, key, clockmsec());
+	if (e != NULL && e->code == code)
+		e->isused = false;
+}
+
+void otpexpire()
+{
+	uint64_t slot = clockmsec() / OTP_SLOT_MSEC;
+	std::lock_guard<std::mutex> lock(otplock);
+
+	// a slot is done once the clock left it, a tick late by more than the wheel looks at each slot once
+	if (otpwheelslot == 0)
+		otpwheelslot = slot;
+	if (slot - otpwheelslot > OTP_WHEEL_SLOTS)
+		otpwheelslot = slot - OTP_WHEEL_SLOTS;
+
+	for (; otpwheelslot < slot; otpwheelslot++) {
+		std::vector<uint32_t>& due = otpwheel[otpwheelslot % OTP_WHEEL_SLOTS];
+		size_t kept = 0;
+		for (size_t n = 0; n < due.size(); n++) {
+			_OTP_ENTRY* e = &otptable[due[n]];
+			if (!e->isused)
+				continue;
+			if (e->expiretick / OTP_SLOT_MSEC <= otpwheelslot) {
+				e->isused = false;
+				continue;
+			}
+			// a lap ahead after a late tick, or renewed and in its new slot as well
+			due[kept++] = due[n];
+		}
+		due.resize(kept);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// the otp codes, kept by mobile number and not by the connection that asked, so a player who comes back
+// on a new connection and asks again is answered with the code already on its phone and no second sms,
+// a new one goes out only once OTP_RESEND_MSEC passed. a fixed open addressing table, a number hashes to
+// a run of OTP_PROBES entries and a full run gives up the one that expires first. a code lives
+// OTP_EXPIRE_MSEC from its last sms and OTP_MAX_ATTEMPTS wrong guesses burn it. each issue puts the entry
+// in a wheel of OTP_WHEEL_SLOTS slots of OTP_SLOT_MSEC by its expiry and the tick of loop 0 only looks at
+// the slots that came due. the loops share the table behind one lock, a check is a hash and a few compares
+
+#define OTP_TABLE_SIZE 4096	// a power of two
+#define OTP_PROBES 8
+#define OTP_EXPIRE_MSEC 300000
+#define OTP_RESEND_MSEC 60000
+#define OTP_MAX_ATTEMPTS 5
+#define OTP_WHEEL_SLOTS 64	// times OTP_SLOT_MSEC is past OTP_EXPIRE_MSEC
+#define OTP_SLOT_MSEC 5000
+
+enum class _OTP_RESULT
+{
+	_OK = 0,
+	_WRONG,
+	_LOCKED,	// the last guess it had, the number needs a new code
+	_NONE,	// never issued, expired or burned
+};
+
+// the code of the number, the live one or a new one. issend is set when an sms should go out for it
+int otpissue(const std::string& mobilenum, bool& issend);
+_OTP_RESULT otpverify(const std::string& mobilenum, int code);	// an _OK takes the code
+void otpdrop(const std::string& mobilenum, int code);	// its sms failed, the next ask makes a new one
+void otpexpire();	// loop 0, from the loop tick
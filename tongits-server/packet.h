@@ -0,0 +1,22 @@
+#pragma once
+#include "prodef.h"
+
+// the constant part of the packets sent the most, laid out at compile time. a sender copies the
+// template and patches only its own fields in place, a fixed text is never formatted per send
+
+// the C1 header of a packet of fixed size
+template <typename T>
+constexpr _PMSG_HDR pkthdr(unsigned char h)
+{
+	return _PMSG_HDR{ 0xC1, (unsigned short)sizeof(T), h };
+}
+
+// header and sub set, every other field zero
+template <typename T>
+constexpr T pkttemplate(unsigned char h, unsigned char sub)
+{
+	T pkt = {};
+	pkt.hdr = pkthdr<T>(h);
+	pkt.sub = sub;
+	return pkt;
+}
@@ -49,6 +49,17 @@ struct _PMSG_MOVECARD_REQ
 	unsigned char t_pos[2];
 };
 
+// F2 04, the whole hand in the order the app shows it, in place of one _PMSG_MOVECARD_REQ a card moved.
+// the hand is sent back once either way, as it was and a result 0 after it when the order does not hold
+// every card of it once
+struct _PMSG_HANDORDER_REQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char count;
+	// cards...
+};
+
 struct _PMSG_DRAW_CARD_ANS
 {
 	_PMSG_HDR hdr;
@@ -207,6 +218,15 @@ struct _PMSG_NOTICEMSG
 	char msg[100];
 };
 
+// F2 0B, a notice by number, see notice.h, its arguments follow
+struct _PMSG_NOTICEID
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char type;
+	unsigned short id;
+};
+
 struct _PMSG_GRPCARD_REQ
 {
 	_PMSG_HDR hdr;
@@ -232,6 +252,22 @@ struct _PMSG_UNGRPCARD_REQ
 	int downpos;
 };
 
+#define GRPBATCH_MAX_GROUPS 4
+
+// F3 0B, the groups of a hand set at once. every group of the seat goes back to the hand first when
+// isungroup, then sizes[n] cards after the ones of the group before it are grouped as group n. nothing
+// is applied unless all of it can be, the answers are the ones of _PMSG_UNGRPCARD_REQ and
+// _PMSG_GRPCARD_REQ
+struct _PMSG_GRPBATCH_REQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char isungroup;
+	unsigned char sizes[GRPBATCH_MAX_GROUPS];	// 0 after the last group
+	unsigned char count;	// of all the groups
+	// cards...
+};
+
 struct _PMSG_UNGRPCARD_ANS
 {
 	_PMSG_HDR hdr;
@@ -276,6 +312,49 @@ struct _PMSG_FIGHT2CARD_ANS
 	unsigned char isfight;
 };
 
+// F3 09, one of the F3 requests above follows whole, header included. a client can send its next action
+// without waiting for the answer of the last one, seq only grows within a connection and a seq already
+// seen is not applied again
+struct _PMSG_SEQ_REQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned int seq;
+};
+
+enum class _SEQ_RESULT : unsigned char
+{
+	_REJECTED = 0,
+	_APPLIED = 1,
+	_DUPLICATE = 2,	// seq was not above the newest one, nothing done
+};
+
+// F3 09, after the packets of the action itself. the client rolls back what it applied for seq when
+// it is not _APPLIED and compares version with the seq of a resume snapshot
+struct _PMSG_SEQ_ANS
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char result;	// _SEQ_RESULT
+	unsigned char reason;	// _ACTION_REASON of game.h when rejected
+	unsigned int seq;
+	unsigned int version;	// actions the table has taken this round, after this one
+};
+
+// F3 0A, to the active seat of an app of APK_VER_ACTION_MASK as its turn starts, the actions the table
+// would take from it now. actions holds the _ACTIONS bits of game.h, chowtype and chownum the last drop
+// it may chow, 0 when none, and bit userpos * ACTION_MASK_DOWNS + downpos of sapawdowns a down one card
+// of its hand extends
+struct _PMSG_ACTION_MASK
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char chowtype;
+	unsigned char chownum;
+	unsigned int actions;
+	unsigned int sapawdowns;
+};
+
 struct _PMSG_ALIVE
 {
 	_PMSG_HDR hdr;
@@ -350,6 +429,206 @@ struct _PMSG_TOKEN_INFO
 	char token[33];
 };
 
+// 0xF1 sub 0x07, iswatch 0 stops watching
+struct _PMSG_WATCH_REQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char iswatch;
+	int gameserial;
+};
+
+// 0xF1 sub 0x0A, result 0 refused, 1 watching, 2 the table ended. the public packets of the table
+// follow delaysec behind the players
+struct _PMSG_WATCH_ANS
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char result;
+	unsigned char ectype;
+	unsigned short delaysec;
+	int gameserial;
+};
+
+// 0xF1 sub 0x08, registers for the tournament open for gametype
+struct _PMSG_TOURNEY_JOIN
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char gametype;
+};
+
+// 0xF1 sub 0x0B, status is a _TOURNEY_STATUS of tournament.h. sent on registering and to every entrant
+// once its round is decided. rank is among those still in, the final place of an entrant that is out
+struct _PMSG_TOURNEY_INFO
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char status;
+	unsigned char ectype;
+	unsigned char round;
+	int entrants;
+	int remaining;
+	int score;
+	int rank;
+};
+
+// 0xF1 sub 0x09, islobby 0 stops the lobby counters
+struct _PMSG_LOBBY_REQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char islobby;
+};
+
+// 0xF1 sub 0x0C, the lobby counters at most once a second. a field counts only when its LOBBY_ bit of
+// lobby.h is set in changed, the first one after subscribing has all of them. by bet mode, eCoins and Jewels
+struct _PMSG_LOBBY_INFO
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char changed;
+	int waiting[2];	// joined and not seated yet
+	int playing[2];	// seated at a table
+	int tables;	// dealt and not closed
+};
+
+// 0xF1 sub 0x0D, to an app of APK_VER_DEADLINE instead of the msec left of the turn or of the table timer.
+// deadline is on the clock of _PMSG_CLOCK_INFO, 0 when no timer runs. activeuserpos 0xFF is a timer of
+// the whole table
+struct _PMSG_DEADLINE_INFO
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char activeuserpos;
+	unsigned int deadline;
+};
+
+// 0xF1 sub 0x0A, window is a _LEADER_WINDOW of leaderboard.h, count the rows up to LEADER_MAX_TOP
+struct _PMSG_LEADER_REQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char ectype;
+	unsigned char window;
+	unsigned char count;
+};
+
+// 0xF1 sub 0x0E, the best count of the board and where the player is on it, rank 0 and won 0 while it
+// has not played in the window
+struct _PMSG_LEADER_ANS
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char ectype;
+	unsigned char window;
+	unsigned char count;
+	int players;
+	int rank;
+	int won;
+	// _PMSG_LEADER_ROW...
+};
+
+struct _PMSG_LEADER_ROW
+{
+	char accountid[20];
+	int won;
+};
+
+// 0xF2 sub 0x0C, the table is on another server, the client logs in there with the token and joins gametype
+// gametype 0xFF sends it back to a table it left there, it logs in and resumes without joining
+struct _PMSG_REDIRECT_INFO
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char gametype;
+	unsigned short port;
+	char host[64];
+	char token[33];
+};
+
+// 0xF2 sub 0x0D, the token login that resumes a table is not taken yet, the client logs in with its token
+// again retrymsec later, see admit.h
+struct _PMSG_RETRY_INFO
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned int retrymsec;
+};
+
+// 0xF2 sub 0x0E, the frames after this one are counted from seq on, the mark itself is not, see replay.h
+struct _PMSG_REPLAY_SEQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned int seq;
+};
+
+// 0xF2 sub 0x0F, the msec clock of the server at the login of an app of APK_VER_DEADLINE, the app keeps
+// the offset to its own clock and counts the deadlines down with it
+struct _PMSG_CLOCK_INFO
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned int servermsec;
+};
+
+// 0xF2 sub 0x10, to an app of APK_VER_FASTLANE once it is logged in, the udp port, id and key of its
+// side channel, see fastlane.h
+struct _PMSG_FASTLANE_INFO
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned short port;
+	unsigned int id;
+	unsigned char key[32];
+};
+
+// F2 07, an F2 or F3 request follows whole, header included. the app stamps it with its own clock and
+// gets _PMSG_STAMP_ANS after the answers of the request, see latency.h
+struct _PMSG_STAMP_REQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned int clientstamp;
+};
+
+// 0xF2 sub 0x11, the stamp back and the usec the server took from the read that brought the request
+// to its answers being on the connection
+struct _PMSG_STAMP_ANS
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char head;	// of the request
+	unsigned char reqsub;
+	unsigned int clientstamp;
+	unsigned int serverusec;
+};
+
+// F2 08, round trips the app saw of its stamped requests since its last report
+struct _PMSG_LATENCY_REPORT
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned char count;
+	// samples...
+};
+
+struct _PMSG_LATENCY_SAMPLE
+{
+	unsigned int rttusec;	// from the stamp to the answer on the clock of the app
+	unsigned int serverusec;	// of its _PMSG_STAMP_ANS
+};
+
+// 0xF2 sub 0x06 from an app that counts its frames, the last one it read before it lost the connection.
+// the short _PMSG_DEF_SUB of the older apps asks for the whole table
+struct _PMSG_RESUME_REQ
+{
+	_PMSG_HDR hdr;
+	unsigned char sub;
+	unsigned int lastseq;
+};
+
 
 struct _USER_TRANSACT_INFO
 {
@@ -491,6 +770,369 @@ struct _PMSG_RELOAD_REQ
 	int aindex;
 };
 
+struct _PMSG_STATS_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+};
+
+struct _PMSG_STATS_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char count;
+	// _PMSG_STATS_INFO...
+};
+
+struct _PMSG_STATS_INFO
+{
+	unsigned char head;	// 0 for a tick, sub is then its _STATS_TICK
+	unsigned char sub;
+	unsigned int calls;
+	unsigned int bytes;
+	unsigned int avgusec;
+	unsigned int p50usec;
+	unsigned int p99usec;
+	unsigned int maxusec;
+};
+
+struct _PMSG_METRICS_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+};
+
+// the gauges of metrics.h, users are by ectype and _USER_STATE bit, games by _GAME_STATE
+struct _PMSG_METRICS_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	int users[2][5];
+	int games[8];
+	int matchqueued;
+	unsigned int matchwaits[8];	// seconds waited up to 1, 2, 5, 10, 30, 60, 120 and above
+	int smsqueued;
+	int dbjobs;
+	int dbledger;
+};
+
+struct _PMSG_MEMTAG_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+};
+
+struct _PMSG_MEMTAG_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char count;
+	// _PMSG_MEMTAG_INFO...
+};
+
+// seconds of sampling, 0 takes 30
+struct _PMSG_PROFILE_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	int seconds;
+};
+
+struct _PMSG_PROFILE_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char result;	// _PROFILE_RESULT
+	char path[64];	// where the folded stacks are written, on the server
+};
+
+// action is a _TOURNEY_ACTION of tournament.h. open takes the gametype and the hands every table plays,
+// 0 for TOURNEY_DEFAULT_HANDS, standings the first count entrants
+struct _PMSG_TOURNEY_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char action;
+	unsigned char gametype;
+	unsigned char hands;
+	unsigned char count;
+};
+
+// seatusec is how long the start or the last round took to seat, tables the tables still playing
+struct _PMSG_TOURNEY_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char action;
+	unsigned char result;	// _TOURNEY_RESULT
+	unsigned char state;	// _TOURNEY_STATE
+	unsigned char round;
+	int entrants;
+	int remaining;
+	int tables;
+	int seatusec;
+	unsigned char count;
+	// _PMSG_TOURNEY_STANDING...
+};
+
+// best first, those still in ahead of those out, then by score
+struct _PMSG_TOURNEY_STANDING
+{
+	char accountid[20];
+	int score;
+	unsigned short hands;
+	unsigned short wins;
+	unsigned char round;	// the last round played
+	unsigned char isin;
+};
+
+// 0xF4 sub 0x0A, action is a _DRAIN_ACTION of migrate.h. start takes the node the tables move to, host
+// and the port its clients connect to, an empty host only stops new tables here
+struct _PMSG_DRAIN_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char action;
+	unsigned short port;
+	char host[64];
+};
+
+// tables are still here, inflight frozen and on the way, moved and failed counted since the start
+struct _PMSG_DRAIN_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char action;
+	unsigned char result;	// _DRAIN_RESULT
+	unsigned char isdraining;
+	unsigned short port;
+	char host[64];
+	int tables;
+	int inflight;
+	int moved;
+	int failed;
+};
+
+// 0xF4 sub 0x0B, a text notice to every connected player of states, the _USER_STATE flags they must all
+// have, and of the bet mode ectype, 0xFF for any, see announce.h
+struct _PMSG_ANNOUNCE_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char type;	// of _PMSG_NOTICEMSG
+	unsigned char states;
+	unsigned char ectype;
+	char msg[100];
+};
+
+// once every loop is through, result is an _ANNOUNCE_RESULT
+struct _PMSG_ANNOUNCE_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char result;
+	int users;	// players it was sent to
+};
+
+// 0xF4 sub 0x0C, isfeed 0 stops the stream of the admin feed, see adminfeed.h
+struct _PMSG_FEED_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char isfeed;
+};
+
+// one record of the event log, account is the name of an account event and empty for a table
+struct _PMSG_FEED_EVENT
+{
+	long long time;	// msec since the epoch
+	long long serial;	// the table, or the session token of the account
+	int delta;
+	unsigned short action;	// EVENT_ of eventlog.h
+	unsigned char userpos;
+	char account[17];
+};
+
+// 0xF4 sub 0x0C, count events in the order they were logged, dropped the ones lost before them since the
+// last packet because the admin fell behind. count 0 answers a _PMSG_FEED_REQ
+struct _PMSG_FEED_INFO
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned int dropped;
+	unsigned char count;
+	// _PMSG_FEED_EVENT...
+};
+
+// 0xF4 sub 0x0D, action is a _HISTORY_ACTION of settle.h. last takes the last count games of token up
+// to HISTORY_MAX_GAMES, totals the day date as yyyymmdd, 0 for today
+struct _PMSG_HISTORY_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char action;
+	unsigned char count;
+	long long token;
+	int date;
+};
+
+// count _PMSG_HISTORY_GAME newest first for last, a _PMSG_HISTORY_TOTAL for each bet mode for totals
+struct _PMSG_HISTORY_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char action;
+	unsigned char result;	// _HISTORY_RESULT
+	unsigned char count;
+	int date;
+	// _PMSG_HISTORY_GAME... or _PMSG_HISTORY_TOTAL...
+};
+
+// one hand of the player, its own seat of it
+struct _PMSG_HISTORY_GAME
+{
+	long long time;
+	long long serial;
+	unsigned char ectype;
+	unsigned char winnerpos;
+	unsigned char istongits;
+	unsigned char userpos;
+	int hitprize;
+	int total;
+	int before;
+	int delta;
+	int cardcount;
+	int fight;
+	int regular;
+	int quadra;
+	int royal;
+	int ace;
+	int burned;
+};
+
+struct _PMSG_HISTORY_TOTAL
+{
+	unsigned char ectype;
+	long long hands;
+	long long tongits;
+	long long pot;
+	long long hitprize;
+	long long regular;
+	long long fight;
+	long long quadra;
+	long long royal;
+	long long ace;
+	long long burned;
+};
+
+// 0xF4 sub 0x0E, the running tables from serial cursor on, count a page up to TABLES_PAGE. with stream
+// the pages follow each other until the last, otherwise the next is asked for with the cursor of the
+// answer. a new request of the admin replaces its listing, see tablelist.h
+struct _PMSG_TABLES_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char count;
+	unsigned char stream;
+	long long cursor;	// 0 from the first
+};
+
+// a seat of a listed table, token 0 for an empty one
+struct _PMSG_TABLE_SEAT
+{
+	long long token;
+	int ecoins;	// of the bet mode of the table
+	unsigned char isbot;
+	unsigned char isdc;
+	char account[17];
+};
+
+struct _PMSG_TABLE_INFO
+{
+	long long serial;
+	unsigned char state;	// _GAME_STATE
+	unsigned char ectype;
+	unsigned char istourney;
+	unsigned char isfrozen;	// on its way to another server
+	unsigned char iswatched;
+	int loop;
+	int hands;
+	_PMSG_TABLE_SEAT seats[3];
+};
+
+// 0xF4 sub 0x0E, count _PMSG_TABLE_INFO in serial order, next the cursor of the following page, 0 after
+// the last. tables is the count of the running ones when the page was read
+struct _PMSG_TABLES_ANS
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char count;
+	long long next;
+	int tables;
+	// _PMSG_TABLE_INFO...
+};
+
+// one _MEM_TAG of memtag.h, in its order
+struct _PMSG_MEMTAG_INFO
+{
+	long long live;	// bytes
+	long long peak;
+	unsigned long long allocs;
+	unsigned long long frees;
+};
+
+// credits many accounts at once, an account may be listed more than once
+struct _PMSG_BULKECOINS_REQ
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char count;
+	// _PMSG_BULKECOINS_INFO...
+};
+
+struct _PMSG_BULKECOINS_INFO
+{
+	char accountid[20];
+	unsigned char ectype;
+	int ecoins;
+};
+
+// answered once every entry is written, offline ones included
+struct _PMSG_BULKECOINS_RES
+{
+	_PMSG_HDR_MU hdr;
+	unsigned char sub;
+	int aindex;
+	unsigned char count;
+	unsigned char online;	// credited in memory, saved through the ledger
+	unsigned char offline;	// credited in the database
+	unsigned char notfound;
+	unsigned char notenough;
+	unsigned char failed;	// a bad ectype or a database error
+	int total[2];	// ecoins and jewels credited
+};
+
 struct _PMSG_OTP_REQ
 {
 	_PMSG_HDR hdr;
@@ -4,6 +4,25 @@
 #include "gamectrl.h"
 #include "socket.h"
 #include "conf.h"
+#include "ratelimit.h"
+#include "stats.h"
+#include "trace.h"
+#include "cluster.h"
+#include "packet.h"
+#include "spectate.h"
+#include "gpsindex.h"
+#include "tournament.h"
+#include "migrate.h"
+#include "announce.h"
+#include "lobby.h"
+#include "leaderboard.h"
+#include "adminfeed.h"
+#include "tablelist.h"
+#include "replay.h"
+#include "metrics.h"
+#include "latency.h"
+#include "../Common/loopwatch.h"
+#include "../Common/memtag.h"
 
 protocol gprotocol;
 
@@ -17,186 +36,226 @@ protocol::~protocol()
 
 }
 
-bool protocol::doprotocol(uintptr_t userindex, unsigned char* data, unsigned char head)
-{
+#define PROTOCOL_HEADS 4	// 0xF1 to 0xF4
+#define PROTOCOL_SUBS 15
 
-	//msglog(DEBUG, "doprotocol, 0x%X", head);
+static_assert(PROTOCOL_SUBS <= 16 && PROTOCOL_HEADS * 16 <= STATS_OPCODES, "every request needs its own stats counter");
 
-	switch (head) {
+#define PROTOCOL_ADMIN 1	// mu admin or user admin only
+#define PROTOCOL_NOKICK 2	// dropped once the player is kicked from the table
 
-	case 0xF1:
-	{
-		_PMSG_DEF_SUB* _sub = (_PMSG_DEF_SUB*)data;
+typedef void (*_PROTOCOL_CALL)(protocol* p, unsigned char* data, _USER_INFO* userinfo, uintptr_t userindex);
 
-		switch (_sub->sub) {
+struct _PROTOCOL_HANDLER
+{
+	_PROTOCOL_CALL call;	// NULL for a sub nobody handles
+	unsigned short size;	// smallest frame the handler may read
+	unsigned short countoffset;	// of the count of a trailing list, 0 without one
+	unsigned short itemsize;	// of one entry of that list
+	unsigned char state;	// _USER_STATE bits the sender must have
+	_RATE_RULE rule;	// keyed by the sender's ip, _MAX for none
+	unsigned char flags;
+	unsigned short maxlen;	// largest frame taken in, past MAX_BUFFER_DATA only for a list that needs it
+};
+
+template <typename T, void (protocol::*fn)(T*, _USER_INFO*, uintptr_t)>
+static void protocolcall(protocol* p, unsigned char* data, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	(p->*fn)((T*)data, userinfo, userindex);
+}
 
-		case 0x00: // login user/pass
-			this->reqotplogin((_PMSG_OTP_REQ*)data, userindex);
-			break;
-		case 0x01: // login token
-			this->reqtokenlogin((_PMSG_LOGIN_TOKEN*)data, userindex);
-			break;
-		case 0x02:
-			this->requserlogin((_PMSG_LOGIN_USER*)data, userindex);
-			break;
-		case 0x03: // join game
-			this->reqjoingame((_PMSG_JOINGAME_INFO *)data, userindex);
-			break;
-		case 0x04: // gps info
-			this->reqgpsinfo((_PMSG_GPS_INFO*)data, userindex);
-			break;
-		case 0x05: //_PMSG_RESETINFO_REQ
-			this->reqresetinfo((_PMSG_RESETINFO_REQ *)data, userindex);
-			break;
-		case 0x06: // _PMSG_OTPCODE_REQ
-			this->reqotpcode((_PMSG_OTPCODE_REQ *)data, userindex);
-			break;
-		}
-	}
-		break;
+#define PROTOCOL_LISTMAX(T, I) (sizeof(T) + 255 * sizeof(I) > MAX_BUFFER_DATA ? sizeof(T) + 255 * sizeof(I) : MAX_BUFFER_DATA)
+#define PROTOCOL_REQ(T, fn, state, rule, flags) { protocolcall<T, &protocol::fn>, sizeof(T), 0, 0, (unsigned char)(state), rule, flags, MAX_BUFFER_DATA }
+#define PROTOCOL_LIST(T, fn, I, state, flags) { protocolcall<T, &protocol::fn>, sizeof(T), offsetof(T, count), sizeof(I), (unsigned char)(state), _RATE_RULE::_MAX, flags, PROTOCOL_LISTMAX(T, I) }
+#define PROTOCOL_CARDS(T, fn, state, flags) PROTOCOL_LIST(T, fn, _PMSG_CARD_INFO, state, flags)
+#define PROTOCOL_NONE { NULL, 0, 0, 0, 0, _RATE_RULE::_MAX, 0, MAX_BUFFER_DATA }
+#define PROTOCOL_PLAYING _USER_STATE::_PLAYING
+
+// indexed by head and sub, every check a request needs before its handler runs is in its row
+static const _PROTOCOL_HANDLER protocolhandlers[PROTOCOL_HEADS][PROTOCOL_SUBS] = {
+	{	// 0xF1
+		PROTOCOL_REQ(_PMSG_OTP_REQ, reqotplogin, 0, _RATE_RULE::_OTPSEND_IP, 0),
+		PROTOCOL_REQ(_PMSG_LOGIN_TOKEN, reqtokenlogin, 0, _RATE_RULE::_TOKENLOGIN_IP, 0),
+		PROTOCOL_REQ(_PMSG_LOGIN_USER, requserlogin, 0, _RATE_RULE::_USERLOGIN_IP, 0),
+		PROTOCOL_REQ(_PMSG_JOINGAME_INFO, reqjoingame, 0, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_GPS_INFO, reqgpsinfo, 0, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_RESETINFO_REQ, reqresetinfo, 0, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_OTPCODE_REQ, reqotpcode, 0, _RATE_RULE::_OTPCODE_IP, 0),
+		PROTOCOL_REQ(_PMSG_WATCH_REQ, reqwatchgame, _USER_STATE::_LOGGEDIN, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_TOURNEY_JOIN, reqtourneyjoin, _USER_STATE::_LOGGEDIN, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_LOBBY_REQ, reqlobby, _USER_STATE::_LOGGEDIN, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_LEADER_REQ, reqleader, _USER_STATE::_LOGGEDIN, _RATE_RULE::_MAX, 0),
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+	},
+	{	// 0xF2
+		PROTOCOL_REQ(_PMSG_MOVECARD_REQ, reqmovecardpos, PROTOCOL_PLAYING, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_ALIVE, reqalive, 0, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_REQ_USERCARDS, requsercards, PROTOCOL_PLAYING, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_REQ_DRAWINIT, reqgamestart, PROTOCOL_PLAYING, _RATE_RULE::_MAX, 0),
+		PROTOCOL_CARDS(_PMSG_HANDORDER_REQ, reqhandorder, PROTOCOL_PLAYING, 0),
+		PROTOCOL_NONE,
+		PROTOCOL_REQ(_PMSG_DEF_SUB, reqresume, 0, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_STAMP_REQ, reqstamped, _USER_STATE::_LOGGEDIN, _RATE_RULE::_MAX, 0),
+		PROTOCOL_LIST(_PMSG_LATENCY_REPORT, reqlatencyreport, _PMSG_LATENCY_SAMPLE, _USER_STATE::_LOGGEDIN, 0),
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+	},
+	{	// 0xF3
+		PROTOCOL_REQ(_PMSG_DRAW_CARD_REQ, reqdrawcard, PROTOCOL_PLAYING, _RATE_RULE::_MAX, PROTOCOL_NOKICK),
+		PROTOCOL_REQ(_PMSG_DROP_CARD_REQ, reqdropcard, PROTOCOL_PLAYING, _RATE_RULE::_MAX, PROTOCOL_NOKICK),
+		PROTOCOL_CARDS(_PMSG_CHOWCARD_REQ, reqchowcard, PROTOCOL_PLAYING, PROTOCOL_NOKICK),
+		PROTOCOL_CARDS(_PMSG_DOWNCARD_REQ, reqdowncard, PROTOCOL_PLAYING, PROTOCOL_NOKICK),
+		PROTOCOL_CARDS(_PMSG_SAPAWCARD_REQ, reqsapawcard, PROTOCOL_PLAYING, PROTOCOL_NOKICK),
+		PROTOCOL_CARDS(_PMSG_GRPCARD_REQ, reqgroupcard, PROTOCOL_PLAYING, PROTOCOL_NOKICK),
+		PROTOCOL_REQ(_PMSG_UNGRPCARD_REQ, requngroupcard, PROTOCOL_PLAYING, _RATE_RULE::_MAX, PROTOCOL_NOKICK),
+		PROTOCOL_REQ(_PMSG_FIGHTCARD_REQ, reqfightcard, PROTOCOL_PLAYING, _RATE_RULE::_MAX, PROTOCOL_NOKICK),
+		PROTOCOL_REQ(_PMSG_FIGHTCARD_REQ, reqfight2card, PROTOCOL_PLAYING, _RATE_RULE::_MAX, PROTOCOL_NOKICK),
+		PROTOCOL_REQ(_PMSG_SEQ_REQ, reqsequenced, PROTOCOL_PLAYING, _RATE_RULE::_MAX, PROTOCOL_NOKICK),
+		PROTOCOL_NONE,
+		PROTOCOL_CARDS(_PMSG_GRPBATCH_REQ, reqgroupbatch, PROTOCOL_PLAYING, PROTOCOL_NOKICK),
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+		PROTOCOL_NONE,
+	},
+	{	// 0xF4 mu admin
+		PROTOCOL_REQ(_PMSG_MUADMIN_LOGIN, reqmulogin, 0, _RATE_RULE::_MAX, 0),
+		PROTOCOL_REQ(_PMSG_ADDECOINS_REQ, reqaddecoins, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_GETECOINS_REQ, reqgetecoins, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_RELOAD_REQ, reqreloadconf, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_STATS_REQ, reqstats, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_LIST(_PMSG_BULKECOINS_REQ, reqbulkecoins, _PMSG_BULKECOINS_INFO, 0, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_METRICS_REQ, reqmetrics, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_MEMTAG_REQ, reqmemtag, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_PROFILE_REQ, reqprofile, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_TOURNEY_REQ, reqtourney, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_DRAIN_REQ, reqdrain, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_ANNOUNCE_REQ, reqannounce, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_FEED_REQ, reqfeed, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_HISTORY_REQ, reqhistory, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+		PROTOCOL_REQ(_PMSG_TABLES_REQ, reqtables, 0, _RATE_RULE::_MAX, PROTOCOL_ADMIN),
+	},
+};
+
+static_assert(MAX_BUFFER_DATA <= MAX_FRAME_DATA, "MAX_BUFFER_DATA is past what a frame header can say");
+
+// the largest frame parsedata waits for, known from the header and the sub before the rest is in. a
+// frame over MAX_BUFFER_DATA is only taken for a handler that can need it, and for an admin request
+// only from an admin, so a client can not park a large partial frame on its connection
+static int protocolmaxlen(const _USER_INFO* userinfo, unsigned char head, unsigned char sub)
+{
+	if (head < 0xF1 || head >= 0xF1 + PROTOCOL_HEADS || sub >= PROTOCOL_SUBS)
+		return MAX_BUFFER_DATA;
 
-	case 0xF2:
-	{
-		_PMSG_DEF_SUB* _sub = (_PMSG_DEF_SUB*)data;
+	const _PROTOCOL_HANDLER* handler = &protocolhandlers[head - 0xF1][sub];
 
-		switch (_sub->sub) {
-		case 0x00:
-			this->reqmovecardpos((_PMSG_MOVECARD_REQ*)data, userindex);
-			break;
-		case 0x01: // alive
-			this->reqalive((_PMSG_ALIVE*)data, userindex);
-			break;
-		case 0x02: // _PMSG_REQ_USERCARDS
-			this->requsercards((_PMSG_REQ_USERCARDS*)data, userindex);
-			break;
-		case 0x03: // init draw cards
-			this->reqgamestart((_PMSG_REQ_DRAWINIT *)data, userindex);
-			break;
-		case 0x06: // resume
-			guser.getuser(userindex)->m_resumeflag = 2;
-			break;
-		}
+	if ((handler->flags & PROTOCOL_ADMIN) && userinfo->ismuadmin == false && userinfo->isuseradmin == false)
+		return MAX_BUFFER_DATA;
 
-	}
-		break;
+	return handler->maxlen;
+}
 
-	case 0xF3:
-	{
-		_PMSG_DEF_SUB* _sub = (_PMSG_DEF_SUB*)data;
+// checked before the request is looked at, only the first rejection of a run gets an answer
+static bool protocolallow(uintptr_t userindex, _RATE_RULE rule, uint64_t key)
+{
+	bool isfirst = false;
 
-		if (guser.getuser(userindex)->iskick == true)
-			return true;
-
-		switch (_sub->sub) {
-		case 0x00:
-			this->reqdrawcard((_PMSG_DRAW_CARD_REQ*)data, userindex);
-			break;
-		case 0x01:
-			this->reqdropcard((_PMSG_DROP_CARD_REQ*)data, userindex);
-			break;
-		case 0x02:
-			this->reqchowcard(data, userindex);
-			break;
-		case 0x03:
-			this->reqdowncard(data, userindex);
-			break;
-		case 0x04:
-			this->reqsapawcard(data, userindex);
-			break;
-		case 0x05: // group
-			this->reqgroupcard(data, userindex);
-			break;
-		case 0x06: // ungroup
-			this->requngroupcard((_PMSG_UNGRPCARD_REQ *)data, userindex);
-			break;
-		case 0x07: // fight
-			this->reqfightcard((_PMSG_FIGHTCARD_REQ *)data, userindex);
-			break;
-		case 0x08: // fight2
-			this->reqfight2card((_PMSG_FIGHTCARD_REQ*)data, userindex);
-			break;
-		}
+	if (rateallow(rule, key, &isfirst))
+		return true;
 
+	if (isfirst) {
+		guser.sendnotice(userindex, 8, _NOTICE_ID::_TOOMANY);
+		MSGLOG(INFO, "protocolallow, userindex %llu over the limit of rule %d.", userindex, (int)rule);
 	}
-	break;
-
-	case 0xF4: // MU Admin
-	{
-		_PMSG_DEF_SUB_MU* _sub = (_PMSG_DEF_SUB_MU*)data;
+	return false;
+}
 
-		//msglog(DEBUG, "doprotocol, 0x%X 0x%X", head, _sub->sub);
+// false drops the connection, only for a frame too short for what it claims to be
+bool protocol::doprotocol(uintptr_t userindex, _USER_INFO* userinfo, unsigned char* data, int len, unsigned char head)
+{
+	if (head < 0xF1 || head >= 0xF1 + PROTOCOL_HEADS)
+		return true;
 
-		switch (_sub->sub) {
-		case 0x00: // mu admin login //_PMSG_MUADMIN_LOGIN
-			this->reqmulogin((_PMSG_MUADMIN_LOGIN *)data, userindex);
-			break;
-		case 0x01: // add ecoins/jewels
-			this->reqaddecoins((_PMSG_ADDECOINS_REQ *)data, userindex);
-			break;
-		case 0x02: // get ecoins/jewels
-			this->reqgetecoins((_PMSG_GETECOINS_REQ*)data, userindex);
-			break;
-		case 0x03: // reload conf
-			this->reqreloadconf((_PMSG_RELOAD_REQ*)data, userindex);
-			break;
-		}
+	int suboffset = (head == 0xF4) ? (int)offsetof(_PMSG_DEF_SUB_MU, sub) : (int)offsetof(_PMSG_DEF_SUB, sub);
 
+	if (len <= suboffset) {
+		MSGLOG(ERROR, "doprotocol, userindex %llu 0x%X frame of %d bytes has no sub.", userindex, head, len);
+		return false;
 	}
-	break;
 
-	}
-	return true;
-}
+	unsigned char sub = data[suboffset];
 
-void protocol::reqgamestart(_PMSG_REQ_DRAWINIT* lpMsg, uintptr_t userindex)
-{
-	_USER_INFO* userinfo = guser.getuser(userindex);
+	if (sub >= PROTOCOL_SUBS)
+		return true;
 
-	if (userinfo == NULL) {
-		return;
-	}
+	const _PROTOCOL_HANDLER* handler = &protocolhandlers[head - 0xF1][sub];
 
-	if (userinfo->isauto || lpMsg->flag != 1)
-		return;
+	if (handler->call == NULL)
+		return true;
 
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
-		return;
+	int size = handler->size;
+	if (handler->countoffset != 0 && len > handler->countoffset)
+		size += data[handler->countoffset] * (int)handler->itemsize;
 
-	int64_t gameserial = userinfo->m_gameserial;
+	if (len < size) {
+		MSGLOG(ERROR, "doprotocol, userindex %llu 0x%X 0x%X frame of %d bytes, %d expected.", userindex, head, sub, len, size);
+		return false;
+	}
 
-	if (gameserial == 0)
-		return;
+	if ((userinfo->m_state & handler->state) != handler->state)
+		return true;
 
+	if ((handler->flags & PROTOCOL_NOKICK) && userinfo->iskick == true)
+		return true;
 
-	game* _g = gcontrol.getgame(gameserial);
+	if ((handler->flags & PROTOCOL_ADMIN) && userinfo->ismuadmin == false && userinfo->isuseradmin == false) {
+		MSGLOG(INFO, "doprotocol, %s sent admin request 0x%X but is not an admin.", userinfo->account.c_str(), sub);
+		return true;
+	}
 
-	if (_g == NULL)
-		return;
+	if (handler->rule != _RATE_RULE::_MAX && !protocolallow(userindex, handler->rule, userinfo->ip))
+		return true;
 
-	_g->gamestart(userindex);
+	uint64_t start = statsusec();
+	handler->call(this, data, userinfo, userindex);
+	statsopcode(STATS_OPCODE(head, sub), len, statsusec() - start);
+	return true;
 }
 
-void protocol::requsercards(_PMSG_REQ_USERCARDS* lpMsg, uintptr_t userindex)
+// the game of a player that may act on it, NULL for a bot or once the game is gone
+static game* protocolgame(_USER_INFO* userinfo)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
+	if (userinfo->isauto)
+		return NULL;
 
-	if (userinfo == NULL) {
-		return;
-	}
+	if (userinfo->m_gameserial == 0)
+		return NULL;
 
-	if (userinfo->isauto)
-		return;
+	return gcontrol.getgame(userinfo->m_gameserial);
+}
 
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
+void protocol::reqgamestart(_PMSG_REQ_DRAWINIT* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	if (lpMsg->flag != 1)
 		return;
 
-	int64_t gameserial = userinfo->m_gameserial;
+	game* _g = protocolgame(userinfo);
 
-	if (gameserial == 0)
+	if (_g == NULL)
 		return;
 
+	_g->gamestart(userindex);
+}
 
-	game* _g = gcontrol.getgame(gameserial);
+void protocol::requsercards(_PMSG_REQ_USERCARDS* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	game* _g = protocolgame(userinfo);
 
 	if (_g == NULL)
 		return;
@@ -204,310 +263,406 @@ void protocol::requsercards(_PMSG_REQ_USERCARDS* lpMsg, uintptr_t userindex)
 	_g->usercards(userindex);
 }
 
-void protocol::reqresetinfo(_PMSG_RESETINFO_REQ* lpMsg, uintptr_t userindex)
+void protocol::reqresetinfo(_PMSG_RESETINFO_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
 	guser.deluser(userindex, true);
-	guser.getuser(userindex)->relog();
+	userinfo->relog();
 
-	_PMSG_LOGIN_RESULT pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF2;
-	pMsg.hdr.len = sizeof(_PMSG_LOGIN_RESULT);
-	pMsg.sub = 0x09;
-	pMsg.result = 1; // option to create game
-	pMsg.isuseradmin = (guser.getuser(userindex)->isuseradmin) ? 1 : 0;
-	strcpy(pMsg.accountid, guser.getuser(userindex)->account.c_str());
-	pMsg.ecoins = guser.getuser(userindex)->ecoins[0];
-	pMsg.jewels = guser.getuser(userindex)->ecoins[1];
-	strcpy(pMsg.ecoinsnote, c.getbetmode(0).name.c_str());
-	strcpy(pMsg.jewelsnote, c.getbetmode(1).name.c_str());
+	_PMSG_LOGIN_RESULT pMsg = c.getbetconf()->loginresult;
+	pMsg.isuseradmin = (userinfo->isuseradmin) ? 1 : 0;
+	userinfo->account.copyto(pMsg.accountid);
+	pMsg.ecoins = userinfo->ecoins[0];
+	pMsg.jewels = userinfo->ecoins[1];
 
 	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
 }
 
-void protocol::reqgpsinfo(_PMSG_GPS_INFO* lpMsg, uintptr_t userindex)
+void protocol::reqgpsinfo(_PMSG_GPS_INFO* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* _user = guser.getuser(userindex);
-	_user->gps.longitude = lpMsg->longitude;
-	_user->gps.latitude = lpMsg->latitue;
-	_user->gps.tick = GetTickCount64() + 60000;
-	//if(_user->isplaying())
-		//msglog(INFO, "GPS Info, %s (%s) %llu long:%f lat:%f", _user->name.c_str(), _user->account.c_str(), userindex, lpMsg->longitude, lpMsg->latitue);
+	uint32_t version = userinfo->gps.version;
+	guser.setgps(userinfo, lpMsg->latitue, lpMsg->longitude);
+
+	// the grid of loop 0 learns of a move, not of every refresh of the fix
+	if (userinfo->gps.version != version) {
+		_GPS_INFO gps = userinfo->gps;
+		le_post([userindex, gps]() { gpsindexupdate(userindex, gps); });
+	}
+
+	// a waiting player without a fix enters the queue once the fix arrives
+	if (userinfo->iswaiting() && !userinfo->isplaying())
+		guser.trystartgame(userinfo->ectype, userindex);
+	//if(userinfo->isplaying())
+		//MSGLOG(INFO, "GPS Info, %s (%s) %llu long:%f lat:%f", userinfo->name.c_str(), userinfo->account.c_str(), userindex, lpMsg->longitude, lpMsg->latitue);
 	//else
-		//msglog(INFO, "GPS Info, %llu long:%f lat:%f", userindex, lpMsg->longitude, lpMsg->latitue);
+		//MSGLOG(INFO, "GPS Info, %llu long:%f lat:%f", userindex, lpMsg->longitude, lpMsg->latitue);
 }
 
-void protocol::reqjoingame(_PMSG_JOINGAME_INFO* lpMsg, uintptr_t userindex)
+void protocol::reqjoingame(_PMSG_JOINGAME_INFO* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
 	if (lpMsg->gametype > 1)
 		return;
 
 	if (c.getbetmode(lpMsg->gametype).enable == false) {
-		guser.sendnotice(userindex, 8, "The game mode you chosed is disabled at the moment.");
+		guser.sendnotice(userindex, 8, _NOTICE_ID::_MODEOFF);
 		return;
 	}
 
-	guser.getuser(userindex)->setgametype(lpMsg->gametype);
-	guser.getuser(userindex)->setlognwait();
-	guser.trystartgame(lpMsg->gametype);
+	if (clusterredirect(userindex, lpMsg->gametype) || drainredirect(userindex, lpMsg->gametype))
+		return;
 
-	_PMSG_LOGIN_RESULT pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF2;
-	pMsg.hdr.len = sizeof(_PMSG_LOGIN_RESULT);
-	pMsg.sub = 0x09;
+	userinfo->m_watchid = 0;
+
+	userinfo->setgametype(lpMsg->gametype);
+	userinfo->setlognwait();
+	guser.trystartgame(lpMsg->gametype, userindex);
+
+	_PMSG_LOGIN_RESULT pMsg = pkttemplate<_PMSG_LOGIN_RESULT>(0xF2, 0x09);
 	pMsg.result = 3; 
 	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
 }
 
-void protocol::reqmulogin(_PMSG_MUADMIN_LOGIN* lpMsg, uintptr_t userindex)
+// the watcher is moved to the loop of the table, which owns its stream
+void protocol::reqwatchgame(_PMSG_WATCH_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	guser.mulogin(lpMsg->secret, userindex);
-}
+	// the stream lets go of it on its next tick
+	userinfo->m_watchid = 0;
 
-void protocol::reqaddecoins(_PMSG_ADDECOINS_REQ* lpMsg, uintptr_t userindex)
-{
-	if (guser.getuser(userindex)->ismuadmin == false && guser.getuser(userindex)->isuseradmin == false) {
-		msglog(INFO, "reqaddecoins, %s requesting to top up user ecoins but not an admin.", guser.getuser(userindex)->account.c_str());
+	if (lpMsg->iswatch == 0)
 		return;
-	}
-	guser.adduserecoins(userindex, lpMsg->accountid, lpMsg->ecoins, lpMsg->ectype, lpMsg->aindex);
-}
 
-void protocol::reqreloadconf(_PMSG_RELOAD_REQ* lpMsg, uintptr_t userindex)
-{
-	if (guser.getuser(userindex)->ismuadmin == false && guser.getuser(userindex)->isuseradmin == false) {
-		msglog(INFO, "reqreloadconf, %s requesting to reload conf but not an admin.", guser.getuser(userindex)->account.c_str());
+	game* g = gcontrol.getgame(lpMsg->gameserial);
+	int loop = (g != NULL) ? g->getloop() : -1;
+
+	if (loop < 0 || userinfo->isplaying() || userinfo->iswaiting()) {
+		spectateanswer(userindex, 0, lpMsg->gameserial, 0);
 		return;
 	}
 
-	msglog(INFO, "Reloaded configs via admin command.");
-	c.load();
+	le_migrateuser(userindex, loop, [g, userindex]() { spectatewatch(g, userindex); });
 }
 
-void protocol::reqgetecoins(_PMSG_GETECOINS_REQ* lpMsg, uintptr_t userindex)
+// loop 0 keeps the registrations
+void protocol::reqtourneyjoin(_PMSG_TOURNEY_JOIN* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	if (guser.getuser(userindex)->ismuadmin == false && guser.getuser(userindex)->isuseradmin == false) {
-		msglog(INFO, "reqgetecoins, %s requesting to get user ecoins but not an admin.", guser.getuser(userindex)->account.c_str());
+	if (lpMsg->gametype > 1)
 		return;
-	}
-	guser.getuserecoins(userindex, lpMsg->accountid, lpMsg->ecoins, lpMsg->ectype, lpMsg->aindex);
+
+	tourneyjoin(userindex, lpMsg->gametype);
 }
 
-void protocol::reqotpcode(_PMSG_OTPCODE_REQ* lpMsg, uintptr_t userindex)
+void protocol::reqlobby(_PMSG_LOBBY_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	guser.otpcode(lpMsg->otpcode, userindex);
+	lobbywatch(userindex, lpMsg->islobby != 0);
 }
 
-void protocol::reqotplogin(_PMSG_OTP_REQ* lpMsg, uintptr_t userindex)
+void protocol::reqleader(_PMSG_LEADER_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	guser.otplogin(lpMsg->mobilenum, userindex);
+	leaderquery(userindex, lpMsg->ectype, lpMsg->window, lpMsg->count);
 }
 
-void protocol::reqtokenlogin(_PMSG_LOGIN_TOKEN* lpMsg, uintptr_t userindex)
+void protocol::reqmulogin(_PMSG_MUADMIN_LOGIN* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	if (lpMsg->gamever != APK_VER) {
-#if GAME_TYPE == 1
-		guser.sendnotice(userindex, 8, "You are using an outdated app, please update our app from playstore.");
-#else
-		guser.sendnotice(userindex, 8, "Your app is outdated, you can get the updated version from our Download page.");
-#endif
-		return;
-	}
-	
-	guser.tokenlogin(lpMsg->md5token, userindex);
+	guser.mulogin(lpMsg->secret, userindex);
 }
 
-void protocol::requserlogin(_PMSG_LOGIN_USER* lpMsg, uintptr_t userindex)
+void protocol::reqaddecoins(_PMSG_ADDECOINS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	if (lpMsg->gamever != APK_VER) {
-#if GAME_TYPE == 1
-		guser.sendnotice(userindex, 8, "You are using an outdated app, please update our app from playstore.");
-#else
-		guser.sendnotice(userindex, 8, "Your app is outdated, you can get the updated version from our Download page.");
-#endif
-		return;
-	}
+	guser.adduserecoins(userindex, lpMsg->accountid, lpMsg->ecoins, lpMsg->ectype, lpMsg->aindex);
+}
 
-	guser.userlogin(lpMsg->user, lpMsg->secret, userindex);
+void protocol::reqbulkecoins(_PMSG_BULKECOINS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	guser.addbulkecoins(userindex, (_PMSG_BULKECOINS_INFO*)((unsigned char*)lpMsg + sizeof(_PMSG_BULKECOINS_REQ)), lpMsg->count, lpMsg->aindex);
 }
 
-void protocol::reqsapawcard(unsigned char* lpMsg, uintptr_t userindex)
+void protocol::reqreloadconf(_PMSG_RELOAD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
+	MSGLOG(INFO, "Reloading configs via admin command.");
+	c.reload();
+}
 
-	if (userinfo == NULL) {
-		return;
+// every counter that was hit, in one answer
+void protocol::reqstats(_PMSG_STATS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	unsigned char szBuffer[sizeof(_PMSG_STATS_ANS) + (STATS_OPCODES + (int)_STATS_TICK::_MAX) * sizeof(_PMSG_STATS_INFO)] = { 0 };
+	_PMSG_STATS_ANS* pMsg = (_PMSG_STATS_ANS*)szBuffer;
+	_PMSG_STATS_INFO* pInfo = (_PMSG_STATS_INFO*)(szBuffer + sizeof(_PMSG_STATS_ANS));
+	_STATS_SUMMARY summary;
+
+	for (int n = 0; n < STATS_OPCODES + (int)_STATS_TICK::_MAX; n++) {
+		if (n < STATS_OPCODES)
+			statsgetopcode(n, summary);
+		else
+			statsgettick((_STATS_TICK)(n - STATS_OPCODES), summary);
+		if (summary.calls == 0)
+			continue;
+		_PMSG_STATS_INFO* info = &pInfo[pMsg->count++];
+		info->head = (n < STATS_OPCODES) ? 0xF1 + (n >> 4) : 0;
+		info->sub = (n < STATS_OPCODES) ? n & 0x0F : n - STATS_OPCODES;
+		info->calls = (unsigned int)summary.calls;
+		info->bytes = (unsigned int)summary.bytes;
+		info->avgusec = (unsigned int)(summary.totalusec / summary.calls);
+		info->p50usec = (unsigned int)summary.p50usec;
+		info->p99usec = (unsigned int)summary.p99usec;
+		info->maxusec = (unsigned int)summary.maxusec;
 	}
 
-	if (userinfo->isauto)
-		return;
+	int size = sizeof(_PMSG_STATS_ANS) + pMsg->count * sizeof(_PMSG_STATS_INFO);
+	pMsg->hdr.c = 0xC2;
+	pMsg->hdr.h = 0xF4;
+	pMsg->hdr.len[0] = SET_NUMBERH(size);
+	pMsg->hdr.len[1] = SET_NUMBERL(size);
+	pMsg->sub = 0x04;
+	pMsg->aindex = lpMsg->aindex;
 
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
-		return;
+	::datasend(userindex, szBuffer, size);
+}
 
-	int64_t gameserial = userinfo->m_gameserial;
+// the same gauges as /metrics of the Stats Port
+void protocol::reqmetrics(_PMSG_METRICS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	static_assert(sizeof(((_PMSG_METRICS_ANS*)0)->users) == sizeof(int) * METRICS_ECTYPES * METRICS_USER_FLAGS
+		&& sizeof(((_PMSG_METRICS_ANS*)0)->games) == sizeof(int) * METRICS_GAME_STATES
+		&& sizeof(((_PMSG_METRICS_ANS*)0)->matchwaits) == sizeof(int) * METRICS_WAIT_BUCKETS, "_PMSG_METRICS_ANS follows metrics.h");
+	_PMSG_METRICS_ANS pMsg = { 0 };
+	_METRICS_SNAPSHOT snapshot;
+
+	metricsget(snapshot);
+	for (int e = 0; e < METRICS_ECTYPES; e++) {
+		for (int n = 0; n < METRICS_USER_FLAGS; n++)
+			pMsg.users[e][n] = (int)snapshot.users[e][n];
+	}
+	for (int n = 0; n < METRICS_GAME_STATES; n++)
+		pMsg.games[n] = (int)snapshot.games[n];
+	pMsg.matchqueued = (int)snapshot.matchqueued;
+	for (int n = 0; n < METRICS_WAIT_BUCKETS; n++)
+		pMsg.matchwaits[n] = (unsigned int)snapshot.matchwaits[n];
+	pMsg.smsqueued = (int)snapshot.smsqueued;
+	pMsg.dbjobs = (int)snapshot.dbjobs;
+	pMsg.dbledger = (int)snapshot.dbledger;
+
+	pMsg.hdr.c = 0xC2;
+	pMsg.hdr.h = 0xF4;
+	pMsg.hdr.len[0] = SET_NUMBERH(sizeof(pMsg));
+	pMsg.hdr.len[1] = SET_NUMBERL(sizeof(pMsg));
+	pMsg.sub = 0x06;
+	pMsg.aindex = lpMsg->aindex;
+
+	::datasend(userindex, (unsigned char*)&pMsg, sizeof(pMsg));
+}
 
-	if (gameserial == 0)
-		return;
+// the bytes each subsystem holds, rates are left to the admin polling it
+void protocol::reqmemtag(_PMSG_MEMTAG_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	unsigned char szBuffer[sizeof(_PMSG_MEMTAG_ANS) + (int)_MEM_TAG::_MAX * sizeof(_PMSG_MEMTAG_INFO)] = { 0 };
+	_PMSG_MEMTAG_ANS* pMsg = (_PMSG_MEMTAG_ANS*)szBuffer;
+	_PMSG_MEMTAG_INFO* pInfo = (_PMSG_MEMTAG_INFO*)(szBuffer + sizeof(_PMSG_MEMTAG_ANS));
+	std::vector<_MemTagStats> vStats;
+
+	memtagstats(vStats);
+	for (size_t n = 0; n < vStats.size(); n++) {
+		_PMSG_MEMTAG_INFO* info = &pInfo[pMsg->count++];
+		info->live = vStats[n].live;
+		info->peak = vStats[n].peak;
+		info->allocs = vStats[n].allocs;
+		info->frees = vStats[n].frees;
+	}
 
+	int size = sizeof(_PMSG_MEMTAG_ANS) + pMsg->count * sizeof(_PMSG_MEMTAG_INFO);
+	pMsg->hdr.c = 0xC2;
+	pMsg->hdr.h = 0xF4;
+	pMsg->hdr.len[0] = SET_NUMBERH(size);
+	pMsg->hdr.len[1] = SET_NUMBERL(size);
+	pMsg->sub = 0x07;
+	pMsg->aindex = lpMsg->aindex;
 
-	game* _g = gcontrol.getgame(gameserial);
+	::datasend(userindex, szBuffer, size);
+}
 
-	if (_g == NULL)
-		return;
+// starts the sampling profiler, its file is announced in the log once written
+void protocol::reqprofile(_PMSG_PROFILE_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	_PMSG_PROFILE_ANS pMsg = { 0 };
+	std::string path;
 
-	_PMSG_SAPAWCARD_REQ* _lpMsg = (_PMSG_SAPAWCARD_REQ*)lpMsg;
-	int size = sizeof(_PMSG_SAPAWCARD_REQ);
+	pMsg.result = (unsigned char)le_profile((lpMsg->seconds > 0) ? lpMsg->seconds : 30, path);
+	strncpy(pMsg.path, path.c_str(), sizeof(pMsg.path) - 1);
 
-	if(!_g->sapawcard(userindex, _lpMsg->userpos, _lpMsg->downpos, _lpMsg->count, lpMsg + sizeof(_PMSG_SAPAWCARD_REQ)))
-		_g->sendresult(userindex, 0);
+	pMsg.hdr.c = 0xC2;
+	pMsg.hdr.h = 0xF4;
+	pMsg.hdr.len[0] = SET_NUMBERH(sizeof(pMsg));
+	pMsg.hdr.len[1] = SET_NUMBERL(sizeof(pMsg));
+	pMsg.sub = 0x08;
+	pMsg.aindex = lpMsg->aindex;
+
+	::datasend(userindex, (unsigned char*)&pMsg, sizeof(pMsg));
 }
 
-void protocol::requngroupcard(_PMSG_UNGRPCARD_REQ* lpMsg, uintptr_t userindex)
+void protocol::reqtourney(_PMSG_TOURNEY_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
+	tourneyadmin(userindex, lpMsg->aindex, lpMsg->action, lpMsg->gametype, lpMsg->hands, lpMsg->count);
+}
 
-	if (userinfo == NULL) {
-		return;
-	}
+void protocol::reqdrain(_PMSG_DRAIN_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	lpMsg->host[sizeof(lpMsg->host) - 1] = 0;
+	drainadmin(userindex, lpMsg->aindex, lpMsg->action, lpMsg->host, lpMsg->port);
+}
 
-	if (userinfo->isauto)
-		return;
+void protocol::reqannounce(_PMSG_ANNOUNCE_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	lpMsg->msg[sizeof(lpMsg->msg) - 1] = 0;
+	announce(userindex, lpMsg->aindex, lpMsg->type, lpMsg->states, lpMsg->ectype, lpMsg->msg);
+}
 
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
-		return;
+void protocol::reqfeed(_PMSG_FEED_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	feedwatch(userindex, lpMsg->aindex, lpMsg->isfeed != 0);
+}
 
-	int64_t gameserial = userinfo->m_gameserial;
+void protocol::reqhistory(_PMSG_HISTORY_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	historyquery(userindex, lpMsg->aindex, lpMsg->action, lpMsg->token, lpMsg->count, lpMsg->date);
+}
 
-	if (gameserial == 0)
-		return;
+void protocol::reqtables(_PMSG_TABLES_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	tablesquery(userindex, lpMsg->aindex, lpMsg->cursor, lpMsg->count, lpMsg->stream != 0);
+}
 
-	game* _g = gcontrol.getgame(gameserial);
+void protocol::reqgetecoins(_PMSG_GETECOINS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	guser.getuserecoins(userindex, lpMsg->accountid, lpMsg->ecoins, lpMsg->ectype, lpMsg->aindex);
+}
 
-	if (_g == NULL)
+void protocol::reqotpcode(_PMSG_OTPCODE_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	guser.otpcode(lpMsg->otpcode, userindex);
+}
+
+void protocol::reqotplogin(_PMSG_OTP_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	if (!protocolallow(userindex, _RATE_RULE::_OTPSEND_MOBILE, ratekey(lpMsg->mobilenum, sizeof(lpMsg->mobilenum))))
 		return;
 
-	if(!_g->ungroupcards(userindex, lpMsg->downpos))
-		_g->sendresult(userindex, 0);
+	guser.otplogin(lpMsg->mobilenum, userindex);
 }
 
-void protocol::reqgroupcard(unsigned char* lpMsg, uintptr_t userindex)
+// an outdated app is told to update, a v2 app gets the compact encoding from its first answer on
+static bool protocolversion(_USER_INFO* userinfo, uintptr_t userindex, unsigned char gamever)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
+	if (gamever != APK_VER && gamever != APK_VER_WIRE_V2 && gamever != APK_VER_NOTICE_ID && gamever != APK_VER_DEADLINE &&
+		gamever != APK_VER_ACTION_MASK && gamever != APK_VER_FASTLANE && gamever != APK_VER_LATENCY) {
+#if GAME_TYPE == 1
+		guser.sendnotice(userindex, 8, _NOTICE_ID::_OUTDATED);
+#else
+		guser.sendnotice(userindex, 8, _NOTICE_ID::_OUTDATEDWEB);
+#endif
+		return false;
+	}
 
-	if (userinfo == NULL) {
-		return;
+	userinfo->wirever = (gamever == APK_VER) ? WIRE_V1 : WIRE_V2;
+	userinfo->isnoticeid = (gamever >= APK_VER_NOTICE_ID);
+	userinfo->isdeadline = (gamever >= APK_VER_DEADLINE);
+	userinfo->isactionmask = (gamever >= APK_VER_ACTION_MASK);
+	userinfo->isfastlane = (gamever >= APK_VER_FASTLANE);
+
+	// the clock the deadlines are on, before any of them
+	if (userinfo->isdeadline) {
+		_PMSG_CLOCK_INFO pMsg = pkttemplate<_PMSG_CLOCK_INFO>(0xF2, 0x0F);
+		pMsg.servermsec = (unsigned int)clockmsec();
+		::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
 	}
+	return true;
+}
 
-	if (userinfo->isauto)
+void protocol::reqtokenlogin(_PMSG_LOGIN_TOKEN* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	if (!protocolversion(userinfo, userindex, lpMsg->gamever))
 		return;
+	
+	guser.tokenlogin(lpMsg->md5token, userindex);
+}
 
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
+void protocol::requserlogin(_PMSG_LOGIN_USER* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	if (!protocolversion(userinfo, userindex, lpMsg->gamever))
 		return;
 
-	int64_t gameserial = userinfo->m_gameserial;
-
-	if (gameserial == 0)
-		return;
+	guser.userlogin(lpMsg->user, lpMsg->secret, userindex);
+}
 
-	game* _g = gcontrol.getgame(gameserial);
+void protocol::reqsapawcard(_PMSG_SAPAWCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	game* _g = protocolgame(userinfo);
 
 	if (_g == NULL)
 		return;
 
-	_PMSG_GRPCARD_REQ* _lpMsg = (_PMSG_GRPCARD_REQ*)lpMsg;
-	int size = sizeof(_PMSG_GRPCARD_REQ);
-
-	if(!_g->groupcards(userindex, _lpMsg->count, lpMsg + size))
+	if(!_g->sapawcard(userindex, lpMsg->userpos, lpMsg->downpos, lpMsg->count, (unsigned char*)lpMsg + sizeof(_PMSG_SAPAWCARD_REQ)))
 		_g->sendresult(userindex, 0);
 }
 
-void protocol::reqdowncard(unsigned char* lpMsg, uintptr_t userindex)
+void protocol::requngroupcard(_PMSG_UNGRPCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
-
-	if (userinfo == NULL) {
-		return;
-	}
-
-	if (userinfo->isauto)
-		return;
-
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
-		return;
-
-	int64_t gameserial = userinfo->m_gameserial;
-
-	if (gameserial == 0)
-		return;
-
-	game* _g = gcontrol.getgame(gameserial);
+	game* _g = protocolgame(userinfo);
 
 	if (_g == NULL)
 		return;
 
-	_PMSG_DOWNCARD_REQ* _lpMsg = (_PMSG_DOWNCARD_REQ*)lpMsg;
-	int size = sizeof(_PMSG_DOWNCARD_REQ);
-
-	if(!_g->downcards(userindex, _lpMsg->count, lpMsg + size))
+	if(!_g->ungroupcards(userindex, lpMsg->downpos))
 		_g->sendresult(userindex, 0);
-
 }
 
-void protocol::reqchowcard(unsigned char* lpMsg, uintptr_t userindex)
+void protocol::reqgroupbatch(_PMSG_GRPBATCH_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
-
-	if (userinfo == NULL) {
-		return;
-	}
+	game* _g = protocolgame(userinfo);
 
-	if (userinfo->isauto)
+	if (_g == NULL)
 		return;
 
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
-		return;
+	if (!_g->groupbatch(userindex, lpMsg->isungroup != 0, lpMsg->sizes, lpMsg->count, (unsigned char*)lpMsg + sizeof(_PMSG_GRPBATCH_REQ)))
+		_g->sendresult(userindex, 0);
+}
 
-	int64_t gameserial = userinfo->m_gameserial;
+void protocol::reqgroupcard(_PMSG_GRPCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	game* _g = protocolgame(userinfo);
 
-	if (gameserial == 0)
+	if (_g == NULL)
 		return;
 
+	if(!_g->groupcards(userindex, lpMsg->count, (unsigned char*)lpMsg + sizeof(_PMSG_GRPCARD_REQ)))
+		_g->sendresult(userindex, 0);
+}
 
-	game* _g = gcontrol.getgame(gameserial);
+void protocol::reqdowncard(_PMSG_DOWNCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	game* _g = protocolgame(userinfo);
 
 	if (_g == NULL)
 		return;
 
-	_PMSG_CHOWCARD_REQ* _lpMsg = (_PMSG_CHOWCARD_REQ*)lpMsg;
-	int size = sizeof(_PMSG_CHOWCARD_REQ);
-
-	if(!_g->chowcard(userindex, _lpMsg->userpos, _lpMsg->pos, _lpMsg->count, lpMsg + size))
+	if(!_g->downcards(userindex, lpMsg->count, (unsigned char*)lpMsg + sizeof(_PMSG_DOWNCARD_REQ)))
 		_g->sendresult(userindex, 0);
 
 }
 
-void protocol::reqdropcard(_PMSG_DROP_CARD_REQ* lpMsg, uintptr_t userindex)
+void protocol::reqchowcard(_PMSG_CHOWCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
-
-	if (userinfo == NULL) {
-		return;
-	}
+	game* _g = protocolgame(userinfo);
 
-	if (userinfo->isauto)
-		return;
-
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
+	if (_g == NULL)
 		return;
 
-	int64_t gameserial = userinfo->m_gameserial;
+	if(!_g->chowcard(userindex, lpMsg->userpos, lpMsg->pos, lpMsg->count, (unsigned char*)lpMsg + sizeof(_PMSG_CHOWCARD_REQ)))
+		_g->sendresult(userindex, 0);
 
-	if (gameserial == 0)
-		return;
+}
 
-	game* _g = gcontrol.getgame(gameserial);
+void protocol::reqdropcard(_PMSG_DROP_CARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	game* _g = protocolgame(userinfo);
 
 	if (_g == NULL)
 		return;
@@ -516,26 +671,9 @@ void protocol::reqdropcard(_PMSG_DROP_CARD_REQ* lpMsg, uintptr_t userindex)
 		_g->sendresult(userindex, 0);
 }
 
-void protocol::reqdrawcard(_PMSG_DRAW_CARD_REQ* lpMsg, uintptr_t userindex)
+void protocol::reqdrawcard(_PMSG_DRAW_CARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
-
-	if (userinfo == NULL) {
-		return;
-	}
-
-	if (userinfo->isauto)
-		return;
-
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
-		return;
-
-	int64_t gameserial = userinfo->m_gameserial;
-
-	if (gameserial == 0)
-		return;
-
-	game* _g = gcontrol.getgame(gameserial);
+	game* _g = protocolgame(userinfo);
 
 	if (_g == NULL)
 		return;
@@ -545,16 +683,11 @@ void protocol::reqdrawcard(_PMSG_DRAW_CARD_REQ* lpMsg, uintptr_t userindex)
 
 }
 
-void protocol::reqalive(_PMSG_ALIVE* lpMsg, uintptr_t userindex)
+void protocol::reqalive(_PMSG_ALIVE* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
-
-	if (userinfo == NULL)
-		return;
-
-	userinfo->alivetick = GetTickCount64();
+	// the read that brought it already renewed alivetick, see alive.h
 
-	//msglog(DEBUG, "reqalive, %s alive packet recvd.", userinfo->name.c_str());
+	//MSGLOG(DEBUG, "reqalive, %s alive packet recvd.", userinfo->name.c_str());
 
 	/*_PMSG_ALIVE pMsg;
 	pMsg.hdr.c = 0xC1;
@@ -563,29 +696,23 @@ void protocol::reqalive(_PMSG_ALIVE* lpMsg, uintptr_t userindex)
 	pMsg.sub = 0x01;*/
 }
 
-void protocol::reqmovecardpos(_PMSG_MOVECARD_REQ* lpMsg, uintptr_t userindex)
+void protocol::reqresume(_PMSG_DEF_SUB* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	if (lpMsg->group != 0)
-		return;
-
-	_USER_INFO* userinfo = guser.getuser(userindex);
-
-	if (userinfo == NULL) {
-		return;
+	// the app that tells where it stopped may be sent only what it missed, see replay.h
+	if (lpMsg->hdr.len >= sizeof(_PMSG_RESUME_REQ) && userinfo->replay != NULL) {
+		userinfo->replay->resumeseq = ((_PMSG_RESUME_REQ*)lpMsg)->lastseq;
+		userinfo->replay->isresumeseq = true;
 	}
 
-	if (userinfo->isauto)
-		return;
-
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
-		return;
-
-	int64_t gameserial = userinfo->m_gameserial;
+	userinfo->m_resumeflag = 2;
+}
 
-	if (gameserial == 0)
+void protocol::reqmovecardpos(_PMSG_MOVECARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	if (lpMsg->group != 0)
 		return;
 
-	game* _g = gcontrol.getgame(gameserial);
+	game* _g = protocolgame(userinfo);
 
 	if (_g == NULL)
 		return;
@@ -594,67 +721,131 @@ void protocol::reqmovecardpos(_PMSG_MOVECARD_REQ* lpMsg, uintptr_t userindex)
 		_g->sendresult(userindex, 0);
 }
 
-void protocol::reqfightcard(_PMSG_FIGHTCARD_REQ* lpMsg, uintptr_t userindex)
+void protocol::reqhandorder(_PMSG_HANDORDER_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
+	game* _g = protocolgame(userinfo);
 
-	if (userinfo == NULL) {
+	if (_g == NULL)
 		return;
-	}
 
-	if (userinfo->isauto)
-		return;
+	if (!_g->sethandorder(userindex, lpMsg->count, (unsigned char*)lpMsg + sizeof(_PMSG_HANDORDER_REQ)))
+		_g->sendresult(userindex, 0);
+}
 
-	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
+void protocol::reqfightcard(_PMSG_FIGHTCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	game* _g = protocolgame(userinfo);
+
+	if (_g == NULL)
 		return;
 
-	int64_t gameserial = userinfo->m_gameserial;
+	if(!_g->fightcard(userindex))
+		_g->sendresult(userindex, 0);
 
-	if (gameserial == 0)
-		return;
+}
 
-	game* _g = gcontrol.getgame(gameserial);
+void protocol::reqfight2card(_PMSG_FIGHTCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	MSGLOG(DEBUG, "reqfight2card %s accepted fight.", userinfo->name.c_str());
+
+	game* _g = protocolgame(userinfo);
 
 	if (_g == NULL)
 		return;
 
-	if(!_g->fightcard(userindex))
+	if(!_g->fight2card(userindex, lpMsg->isfight))
 		_g->sendresult(userindex, 0);
 
 }
 
-void protocol::reqfight2card(_PMSG_FIGHTCARD_REQ* lpMsg, uintptr_t userindex)
+// the action inside runs through doprotocol like one sent alone, it was applied when the table logged it
+void protocol::reqsequenced(_PMSG_SEQ_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
 {
-	_USER_INFO* userinfo = guser.getuser(userindex);
+	int len = lpMsg->hdr.len - (int)sizeof(_PMSG_SEQ_REQ);
+	_PMSG_DEF_SUB* action = (_PMSG_DEF_SUB*)((unsigned char*)lpMsg + sizeof(_PMSG_SEQ_REQ));
 
-	if (userinfo == NULL) {
-		return;
+	_PMSG_SEQ_ANS pMsg = pkttemplate<_PMSG_SEQ_ANS>(0xF3, 0x09);
+	pMsg.result = (unsigned char)_SEQ_RESULT::_REJECTED;
+	pMsg.reason = (unsigned char)_ACTION_REASON::_INVALID;
+	pMsg.seq = lpMsg->seq;
+
+	game* _g = protocolgame(userinfo);
+
+	if (lpMsg->seq <= userinfo->reqseq) {
+		pMsg.result = (unsigned char)_SEQ_RESULT::_DUPLICATE;
+		pMsg.reason = (unsigned char)_ACTION_REASON::_OK;
+	}
+	else if (len < (int)sizeof(_PMSG_DEF_SUB) || action->hdr.c != 0xC1 || action->hdr.h != 0xF3 || action->hdr.len != len || action->sub == 0x09) {
+		MSGLOG(ERROR, "reqsequenced, %s seq %u does not hold an F3 request of %d bytes.", userinfo->account.c_str(), lpMsg->seq, len);
+		userinfo->reqseq = lpMsg->seq;
+	}
+	else {
+		userinfo->reqseq = lpMsg->seq;
+		if (_g != NULL) {
+			uint32_t version = _g->getsyncseq();
+			userinfo->ispipelined = true;
+			userinfo->reqreason = (unsigned char)_ACTION_REASON::_OK;
+			this->doprotocol(userindex, userinfo, (unsigned char*)action, len, 0xF3);
+			userinfo->ispipelined = false;
+			if (_g->getsyncseq() != version) {
+				pMsg.result = (unsigned char)_SEQ_RESULT::_APPLIED;
+				pMsg.reason = (unsigned char)_ACTION_REASON::_OK;
+			}
+			else if (userinfo->reqreason != (unsigned char)_ACTION_REASON::_OK)
+				pMsg.reason = userinfo->reqreason;
+		}
 	}
 
-	msglog(DEBUG, "reqfight2card %s accepted fight.", userinfo->name.c_str());
+	pMsg.version = (_g != NULL) ? _g->getsyncseq() : 0;
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
 
-	if (userinfo->isauto)
-		return;
+// the request runs as if it came alone, the stamp goes back after its answers
+void protocol::reqstamped(_PMSG_STAMP_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	int len = lpMsg->hdr.len - (int)sizeof(_PMSG_STAMP_REQ);
+	_PMSG_DEF_SUB* request = (_PMSG_DEF_SUB*)((unsigned char*)lpMsg + sizeof(_PMSG_STAMP_REQ));
 
-	if(!(userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING))
+	if (len < (int)sizeof(_PMSG_DEF_SUB) || request->hdr.c != 0xC1 || request->hdr.len != len ||
+		(request->hdr.h != 0xF2 && request->hdr.h != 0xF3) || (request->hdr.h == 0xF2 && (request->sub == 0x07 || request->sub == 0x08))) {
+		MSGLOG(ERROR, "reqstamped, %s stamp %u does not hold an F2 or F3 request of %d bytes.", userinfo->account.c_str(), lpMsg->clientstamp, len);
 		return;
+	}
 
-	int64_t gameserial = userinfo->m_gameserial;
+	// a resume in the request moves the connection to another slot, the sample is of the one it came in on
+	uint64_t readusec = userinfo->packetdata.readusec;
+	unsigned char ectype = userinfo->ectype;
+	int region = latencyregion(userinfo->gps);
 
-	if (gameserial == 0)
-		return;
+	_PMSG_STAMP_ANS pMsg = pkttemplate<_PMSG_STAMP_ANS>(0xF2, 0x11);
+	pMsg.head = request->hdr.h;
+	pMsg.reqsub = request->sub;
+	pMsg.clientstamp = lpMsg->clientstamp;
 
-	game* _g = gcontrol.getgame(gameserial);
+	this->doprotocol(userindex, userinfo, (unsigned char*)request, len, request->hdr.h);
 
-	if (_g == NULL)
-		return;
+	uint64_t usec = statsusec() - readusec;
+	latencyserver(ectype, region, usec);
+	pMsg.serverusec = (unsigned int)std::min<uint64_t>(usec, 0xFFFFFFFF);
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
 
-	if(!_g->fight2card(userindex, lpMsg->isfight))
-		_g->sendresult(userindex, 0);
+void protocol::reqlatencyreport(_PMSG_LATENCY_REPORT* lpMsg, _USER_INFO* userinfo, uintptr_t userindex)
+{
+	const unsigned char* samples = (const unsigned char*)lpMsg + sizeof(_PMSG_LATENCY_REPORT);
+	int region = latencyregion(userinfo->gps);
 
+	for (int n = 0; n < lpMsg->count; n++) {
+		_PMSG_LATENCY_SAMPLE sample;
+		memcpy(&sample, samples + n * sizeof(_PMSG_LATENCY_SAMPLE), sizeof(sample));
+		latencyreport(userinfo->ectype, region, sample.rttusec, sample.serverusec);
+	}
 }
 
-bool protocol::parsedata(uintptr_t userindex)
+// frames are dispatched in place from the bufferevent input, a partial frame stays there for the next read.
+// a frame within one chain of the input is read where it is, only one that spans chains is pulled
+// together, which the large ones mostly do
+bool protocol::parsedata(uintptr_t userindex, struct evbuffer* input)
 {
 	_USER_INFO* userinfo = guser.getuser(userindex);
 
@@ -663,32 +854,57 @@ bool protocol::parsedata(uintptr_t userindex)
 
 	while (true) {
 
-		if (userinfo->packetdata.bufferlen < 5)
+		size_t bufferlen = evbuffer_get_length(input);
+
+		if (bufferlen < 5)
 			break;
 
-		_PMSG_HDR* data = (_PMSG_HDR*)userinfo->packetdata.buffer;
+		_PMSG_HDR* data = (_PMSG_HDR*)evbuffer_pullup(input, 5);
 		int len = data->len;
 		unsigned char head = data->h;
 
 		if (data->c == 0xC2) {
-			_PMSG_HDR_MU* data2 = (_PMSG_HDR_MU*)userinfo->packetdata.buffer;
+			_PMSG_HDR_MU* data2 = (_PMSG_HDR_MU*)data;
 			len = MAKE_NUMBERW(data2->len[0], data2->len[1]);
 			head = data2->h;
 		}
 
-		if (doprotocol(userindex, (unsigned char*)userinfo->packetdata.buffer, head) == false) {
+		int maxlen = MAX_BUFFER_DATA;
+		if (len > MAX_BUFFER_DATA) {
+			// only the sub says whether a frame may be larger, it is read as doprotocol reads it
+			size_t suboffset = (head == 0xF4) ? offsetof(_PMSG_DEF_SUB_MU, sub) : offsetof(_PMSG_DEF_SUB, sub);
+			if (bufferlen <= suboffset)
+				break;
+			maxlen = protocolmaxlen(userinfo, head, evbuffer_pullup(input, suboffset + 1)[suboffset]);
+		}
+
+		if (len < 5 || len > maxlen) {
+			MSGLOG(ERROR, "parsedata, userindex %llu invalid packet length %d.", userindex, len);
+			traceclose(userindex);
 			guser.deluser(userindex);
 			return false;
 		}
 
-		userinfo->packetdata.bufferlen -= len;
-
-		if (userinfo->packetdata.bufferlen <= 0)
+		if (bufferlen < (size_t)len)
 			break;
 
-		memcpy(&userinfo->packetdata.buffer[0], userinfo->packetdata.buffer + len, userinfo->packetdata.bufferlen);
+		unsigned char* frame = evbuffer_pullup(input, len);
+		traceframe(userindex, frame, len);
+		_LoopBusy busy("opcode", head);
+
+		if (doprotocol(userindex, userinfo, frame, len, head) == false) {
+			guser.deluser(userindex);
+			return false;
+		}
+
+		evbuffer_drain(input, len);
 	}
 
+	// a move can make the table due right away, wake it instead of waiting for its timer
+	game* _g = gcontrol.getgame(userinfo->m_gameserial);
+	if (_g != NULL && _g->getstate() != _GAME_STATE::_FREE)
+		_g->schedule(0);
+
 	return true;
 }
 
@@ -1,45 +1,68 @@
 #pragma once
 #include "common.h"
 
+struct _USER_INFO;
+
 class protocol
 {
 public:
 	protocol();
 	~protocol();
 
-	void reqotpcode(_PMSG_OTPCODE_REQ* lpMsg, uintptr_t userindex);
-	void reqotplogin(_PMSG_OTP_REQ* lpMsg, uintptr_t userindex);
-	void reqtokenlogin(_PMSG_LOGIN_TOKEN* lpMsg, uintptr_t userindex);
-	void requserlogin(_PMSG_LOGIN_USER* lpMsg, uintptr_t userindex);
-	void reqjoingame(_PMSG_JOINGAME_INFO* lpMsg, uintptr_t userindex);
-	void reqgpsinfo(_PMSG_GPS_INFO* lpMsg, uintptr_t userindex);
-	void reqresetinfo(_PMSG_RESETINFO_REQ* lpMsg, uintptr_t userindex);
+	void reqotpcode(_PMSG_OTPCODE_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqotplogin(_PMSG_OTP_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqtokenlogin(_PMSG_LOGIN_TOKEN* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void requserlogin(_PMSG_LOGIN_USER* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqjoingame(_PMSG_JOINGAME_INFO* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqgpsinfo(_PMSG_GPS_INFO* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqresetinfo(_PMSG_RESETINFO_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqwatchgame(_PMSG_WATCH_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqtourneyjoin(_PMSG_TOURNEY_JOIN* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqlobby(_PMSG_LOBBY_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqleader(_PMSG_LEADER_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
 
-	void reqaddecoins(_PMSG_ADDECOINS_REQ* lpMsg, uintptr_t userindex);
-	void reqgetecoins(_PMSG_GETECOINS_REQ* lpMsg, uintptr_t userindex);
+	void reqaddecoins(_PMSG_ADDECOINS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqgetecoins(_PMSG_GETECOINS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqbulkecoins(_PMSG_BULKECOINS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
 
-	void reqreloadconf(_PMSG_RELOAD_REQ* lpMsg, uintptr_t userindex);
+	void reqreloadconf(_PMSG_RELOAD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqstats(_PMSG_STATS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqmetrics(_PMSG_METRICS_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqmemtag(_PMSG_MEMTAG_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqprofile(_PMSG_PROFILE_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqtourney(_PMSG_TOURNEY_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqdrain(_PMSG_DRAIN_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqannounce(_PMSG_ANNOUNCE_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqfeed(_PMSG_FEED_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqhistory(_PMSG_HISTORY_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqtables(_PMSG_TABLES_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
 
 
-	void reqmulogin(_PMSG_MUADMIN_LOGIN* lpMsg, uintptr_t userindex);
+	void reqmulogin(_PMSG_MUADMIN_LOGIN* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
 
-	void reqalive(_PMSG_ALIVE* lpMsg, uintptr_t userindex);
-	void reqgamestart(_PMSG_REQ_DRAWINIT* lpMsg, uintptr_t userindex);
-	void requsercards(_PMSG_REQ_USERCARDS* lpMsg, uintptr_t userindex);
-	void reqmovecardpos(_PMSG_MOVECARD_REQ* lpMsg, uintptr_t userindex);
-	void reqdropcard(_PMSG_DROP_CARD_REQ* lpMsg, uintptr_t userindex);
-	void reqdrawcard(_PMSG_DRAW_CARD_REQ* lpMsg, uintptr_t userindex);
-	void reqchowcard(unsigned char* lpMsg, uintptr_t userindex);
-	void reqdowncard(unsigned char* lpMsg, uintptr_t userindex);
-	void reqgroupcard(unsigned char* lpMsg, uintptr_t userindex);
-	void requngroupcard(_PMSG_UNGRPCARD_REQ* lpMsg, uintptr_t userindex);
-	void reqsapawcard(unsigned char* lpMsg, uintptr_t userindex);
+	void reqalive(_PMSG_ALIVE* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqresume(_PMSG_DEF_SUB* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqgamestart(_PMSG_REQ_DRAWINIT* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void requsercards(_PMSG_REQ_USERCARDS* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqmovecardpos(_PMSG_MOVECARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqhandorder(_PMSG_HANDORDER_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqdropcard(_PMSG_DROP_CARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqdrawcard(_PMSG_DRAW_CARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqchowcard(_PMSG_CHOWCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqdowncard(_PMSG_DOWNCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqgroupcard(_PMSG_GRPCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void requngroupcard(_PMSG_UNGRPCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqgroupbatch(_PMSG_GRPBATCH_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqsapawcard(_PMSG_SAPAWCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
 
-	void reqfightcard(_PMSG_FIGHTCARD_REQ* lpMsg, uintptr_t userindex);
-	void reqfight2card(_PMSG_FIGHTCARD_REQ* lpMsg, uintptr_t userindex);
+	void reqfightcard(_PMSG_FIGHTCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqfight2card(_PMSG_FIGHTCARD_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqsequenced(_PMSG_SEQ_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqstamped(_PMSG_STAMP_REQ* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
+	void reqlatencyreport(_PMSG_LATENCY_REPORT* lpMsg, _USER_INFO* userinfo, uintptr_t userindex);
 
-	bool parsedata(uintptr_t userindex);
-	bool doprotocol(uintptr_t userindex, unsigned char* data, unsigned char head);
+	bool parsedata(uintptr_t userindex, struct evbuffer* input);
+	bool doprotocol(uintptr_t userindex, _USER_INFO* userinfo, unsigned char* data, int len, unsigned char head);
 
 	//void sendinitcards(uintptr_t userindex, _PMSG_SEND_INIT_CARDS);
 
@@ -0,0 +1,123 @@
+#include "ratelimit.h"
+#include "common.h"
+
+struct _RATE_LIMIT
+{
+	int burst;
+	int refillmsec;	// one request is given back this often
+};
+
+static _RATE_LIMIT ratelimits[(int)_RATE_RULE::_MAX] = {
+	{ 3, 60000 },	// otp sms per address
+	{ 3, 120000 },	// otp sms per mobile number
+	{ 5, 10000 },	// otp code guesses per address
+	{ 10, 1000 },	// token logins per address
+	{ 5, 5000 },	// user logins per address
+	{ 1, 1 },	// accepts per address, from Accept Rate
+};
+
+// credit is kept in milliseconds of refill, a request costs refillmsec of it
+struct _RATE_BUCKET
+{
+	uint64_t key;
+	uint64_t tick;
+	int32_t credit;
+	uint8_t rule;
+	bool isrejected;
+	bool isused;
+};
+
+static thread_local _RATE_BUCKET ratetable[RATE_TABLE_SIZE];
+static thread_local int ratecursor = 0;
+
+static int rateslot(_RATE_RULE rule, uint64_t key)
+{
+	uint64_t h = (key ^ ((uint64_t)rule << 56)) * 0x9E3779B97F4A7C15ULL;
+	return (int)(h >> 40) & (RATE_TABLE_SIZE - 1);
+}
+
+static int32_t ratecapacity(const _RATE_LIMIT& limit)
+{
+	return limit.burst * limit.refillmsec;
+}
+
+bool rateallow(_RATE_RULE rule, uint64_t key, bool* isfirst)
+{
+	const _RATE_LIMIT& limit = ratelimits[(int)rule];
+	uint64_t now = clockmsec();
+	int slot = rateslot(rule, key);
+	_RATE_BUCKET* bucket = NULL;
+	_RATE_BUCKET* victim = NULL;
+
+	for (int n = 0; n < RATE_PROBES; n++) {
+		_RATE_BUCKET* b = &ratetable[(slot + n) & (RATE_TABLE_SIZE - 1)];
+		if (b->isused && b->key == key && b->rule == (uint8_t)rule) {
+			bucket = b;
+			break;
+		}
+		// a free bucket, else the fullest one as it is the least worth keeping
+		if (victim == NULL || !b->isused || (victim->isused && b->credit > victim->credit))
+			victim = b;
+	}
+
+	if (bucket == NULL) {
+		bucket = victim;
+		bucket->key = key;
+		bucket->rule = (uint8_t)rule;
+		bucket->tick = now;
+		bucket->credit = ratecapacity(limit);
+		bucket->isrejected = false;
+		bucket->isused = true;
+	}
+
+	uint64_t elapsed = now - bucket->tick;
+	bucket->tick = now;
+	if (elapsed >= (uint64_t)ratecapacity(limit) || bucket->credit + (int32_t)elapsed > ratecapacity(limit))
+		bucket->credit = ratecapacity(limit);
+	else
+		bucket->credit += (int32_t)elapsed;
+
+	if (isfirst != NULL)
+		*isfirst = false;
+
+	if (bucket->credit < limit.refillmsec) {
+		if (isfirst != NULL)
+			*isfirst = !bucket->isrejected;
+		bucket->isrejected = true;
+		return false;
+	}
+
+	bucket->credit -= limit.refillmsec;
+	bucket->isrejected = false;
+	return true;
+}
+
+// fnv-1a of a fixed size field, stops at the first zero
+uint64_t ratekey(const char* s, size_t maxlen)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	for (size_t n = 0; n < maxlen && s[n] != 0; n++) {
+		h ^= (unsigned char)s[n];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+void ratesetlimit(_RATE_RULE rule, int burst, int refillmsec)
+{
+	ratelimits[(int)rule].burst = burst;
+	ratelimits[(int)rule].refillmsec = refillmsec;
+}
+
+void ratesweep()
+{
+	uint64_t now = clockmsec();
+
+	for (int n = 0; n < RATE_SWEEP_BUCKETS; n++) {
+		_RATE_BUCKET& b = ratetable[ratecursor];
+		ratecursor = (ratecursor + 1) & (RATE_TABLE_SIZE - 1);
+		if (b.isused && now - b.tick >= (uint64_t)(ratecapacity(ratelimits[b.rule]) - b.credit))
+			b.isused = false;
+	}
+}
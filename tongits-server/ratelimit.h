@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// token buckets in front of the login and otp handlers. each loop has its own fixed table, so a check
+// is a hash and a few probes with no lock and no allocation. a bucket that has refilled completely
+// says nothing and is swept away
+
+enum class _RATE_RULE
+{
+	_OTPSEND_IP = 0,
+	_OTPSEND_MOBILE,
+	_OTPCODE_IP,
+	_TOKENLOGIN_IP,
+	_USERLOGIN_IP,
+	_ACCEPT_IP,	// Accept Rate of the game ports, off until ratesetlimit
+	_MAX
+};
+
+#define RATE_TABLE_SIZE 4096	// buckets per loop, a power of two
+#define RATE_PROBES 4
+#define RATE_SWEEP_BUCKETS 256	// looked at on every loop tick
+
+// false when key is over the limit of rule, isfirst tells the first rejection since the bucket ran dry
+bool rateallow(_RATE_RULE rule, uint64_t key, bool* isfirst = NULL);
+uint64_t ratekey(const char* s, size_t maxlen);
+void ratesweep();
+void ratesetlimit(_RATE_RULE rule, int burst, int refillmsec);	// at startup, before any loop checks it
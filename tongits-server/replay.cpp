@@ -0,0 +1,127 @@
+#include "replay.h"
+#include "common.h"
+#include "user.h"
+#include "socket.h"
+#include "packet.h"
+#include <vector>
+
+static void replaykeep(_REPLAY_RING* ring, const unsigned char* data, int len)
+{
+	ring->seq++;
+	if (len > REPLAY_MAX_BYTES) {
+		// the frames before it can not be sent again without it
+		ring->lens.clear();
+		ring->bytes.clear();
+		return;
+	}
+
+	ring->lens.push_back((uint16_t)len);
+	ring->bytes.insert(ring->bytes.end(), data, data + len);
+
+	while (ring->lens.size() > REPLAY_MAX_FRAMES || ring->bytes.size() > REPLAY_MAX_BYTES) {
+		ring->bytes.erase(ring->bytes.begin(), ring->bytes.begin() + ring->lens.front());
+		ring->lens.pop_front();
+	}
+}
+
+void replaymark(uintptr_t userindex, bool isreset)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || userinfo->isbot)
+		return;
+
+	// the mark goes between the frames around it, on the loop that writes them
+	if (userinfo->packetdata.loop != le_getloop()) {
+		le_postloop(userinfo->packetdata.loop, [userindex, isreset]() { replaymark(userindex, isreset); });
+		return;
+	}
+
+	if (userinfo->replay == NULL)
+		userinfo->replay = new _REPLAY_RING();
+
+	_REPLAY_RING* ring = userinfo->replay;
+	if (isreset) {
+		ring->seq = 0;
+		ring->lens.clear();
+		ring->bytes.clear();
+	}
+	ring->isresumeseq = false;
+
+	// not counted itself
+	ring->ismarked = false;
+	_PMSG_REPLAY_SEQ pMsg = pkttemplate<_PMSG_REPLAY_SEQ>(0xF2, 0x0E);
+	pMsg.seq = ring->seq;
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+	ring->ismarked = true;
+}
+
+bool replayrecord(_USER_INFO* userinfo, const unsigned char* data, int len)
+{
+	_REPLAY_RING* ring = userinfo->replay;
+
+	if (ring == NULL)
+		return false;
+
+	// up from the table, the ring goes with the first frame after
+	if (userinfo->m_gameserial == 0) {
+		replayfree(userinfo->replay);
+		return false;
+	}
+
+	if ((userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED) && !ring->ismarked)
+		return false;
+
+	replaykeep(ring, data, len);
+	return true;
+}
+
+void replayhold(_USER_INFO* userinfo, const unsigned char* data, int len)
+{
+	if (userinfo->replay != NULL && userinfo->m_gameserial != 0)
+		replaykeep(userinfo->replay, data, len);
+}
+
+int replaysend(uintptr_t userindex)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || userinfo->replay == NULL || !userinfo->replay->isresumeseq)
+		return -1;
+
+	_REPLAY_RING* ring = userinfo->replay;
+	ring->isresumeseq = false;
+
+	uint32_t missed = ring->seq - ring->resumeseq;
+	if (ring->resumeseq > ring->seq || missed > ring->lens.size())
+		return -1;
+
+	// the connection is not marked yet, nothing sent here is counted again
+	static thread_local std::vector<unsigned char> vFrame;
+	size_t skip = ring->lens.size() - missed;
+	size_t offset = 0;
+
+	for (size_t n = 0; n < ring->lens.size(); n++) {
+		int len = ring->lens[n];
+		if (n >= skip) {
+			vFrame.assign(ring->bytes.begin() + offset, ring->bytes.begin() + offset + len);
+			::datasend(userindex, vFrame.data(), len);
+		}
+		offset += len;
+	}
+	return (int)missed;
+}
+
+void replayunmark(_USER_INFO* userinfo)
+{
+	if (userinfo->replay != NULL) {
+		userinfo->replay->ismarked = false;
+		userinfo->replay->isresumeseq = false;
+	}
+}
+
+void replayfree(_REPLAY_RING*& ring)
+{
+	delete ring;
+	ring = NULL;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <deque>
+
+struct _USER_INFO;
+
+// the frames a seated player was sent last, so a resume sends only the ones it missed. the seat counts
+// every frame the server writes to it from the _PMSG_REPLAY_SEQ mark on, the app counts every frame it
+// reads after the mark the same way, and a frame of the table to a disconnected seat is counted as well
+// and only kept. the resume of an app that tells the last one it read with _PMSG_RESUME_REQ gets the
+// frames after it again as they were and a short tail, an app too far behind for the ring or one that
+// does not tell gets the whole table as before. the ring is of the seat's own loop, which is the loop of
+// the table while it sits, and a connection counts nothing from its login until the table marks it.
+// the frames of the table between its login and the mark wait in the ring too, they come after the
+// ones it missed or are in the whole table it is sent
+
+#define REPLAY_MAX_FRAMES 256
+#define REPLAY_MAX_BYTES (8 * 1024)
+
+struct _REPLAY_RING
+{
+	uint32_t seq;	// of the newest frame
+	std::deque<uint16_t> lens;	// the newest REPLAY_MAX_FRAMES, lens.back() is seq
+	std::deque<unsigned char> bytes;	// the v1 frames one after the other
+	bool ismarked;	// the connection counts
+	bool isresumeseq;	// the app told resumeseq for its resume
+	uint32_t resumeseq;
+};
+
+// any loop. the seat starts counting with the mark, at 0 when isreset for a new table
+void replaymark(uintptr_t userindex, bool isreset);
+// the loop of the user, a frame written or meant for it. true when it was counted
+bool replayrecord(_USER_INFO* userinfo, const unsigned char* data, int len);
+// the loop of the user, a frame of its table while it resumes, counted and kept for after the frames it
+// missed and not sent
+void replayhold(_USER_INFO* userinfo, const unsigned char* data, int len);
+// the frames after resumeseq sent again, -1 when the ring does not have them all
+int replaysend(uintptr_t userindex);
+void replayunmark(_USER_INFO* userinfo);	// a new connection of the seat
+void replayfree(_REPLAY_RING*& ring);
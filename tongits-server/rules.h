@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+// house rules, picked per bet mode with its "House Rules" key. a policy is a set of compile time
+// choices, game.cpp instantiates its rule members once per policy and a table of those instantiations
+// is what a game holds for the round, so an action calls straight into the variant without a flag to test
+
+struct _HOUSE_RULES;
+
+// the rules the server always played
+struct _RULES_CLASSIC
+{
+	static constexpr int dealercards = 13;	// the hitter, seat 0 in a round without one
+	static constexpr int playercards = 12;
+	static constexpr bool sagasa = true;	// sapawing the card just drawn is paid by the other two
+	static constexpr bool burned = true;	// a loser without a down pays the burned amount
+	static constexpr bool handmelds = true;	// a quadra or royal in the hand counts as a down, for fights too
+};
+
+// no side payments, the round is settled by the cards alone
+struct _RULES_CASUAL : _RULES_CLASSIC
+{
+	static constexpr bool sagasa = false;
+	static constexpr bool burned = false;
+};
+
+// only melds on the table count, a fight is answered with a down or not at all
+struct _RULES_STRICT : _RULES_CLASSIC
+{
+	static constexpr bool handmelds = false;
+};
+
+const _HOUSE_RULES* rulesfind(const std::string& name);	// NULL for a name no policy has
@@ -0,0 +1,169 @@
+#include "seal.h"
+#include "sha256.h"
+#include "common.h"
+#include "conf.h"
+#include <unordered_map>
+
+static bool issealed = false;
+static std::unordered_map<uint64_t, time_t> sealnonces;	// loop 0, a hello nonce and until when it can be replayed
+static time_t sealsweeptime = 0;
+
+void sealinit()
+{
+	issealed = c.issealed();
+	if (issealed)
+		MSGLOG(INFO, "Apps with a login token may seal the game port, chacha20 backend is %s.", chachapolybackend());
+}
+
+bool sealisenabled()
+{
+	return issealed;
+}
+
+static void sealnonce(uint64_t count, uint8_t* nonce)
+{
+	memset(nonce, 0, 4);
+	for (int n = 0; n < 8; n++)
+		nonce[4 + n] = (uint8_t)(count >> (n * 8));
+}
+
+// at the hello, the nonce is not taken until its first record opened, see sealdecode
+static bool sealisnew(uint64_t key, time_t now)
+{
+	if (now >= sealsweeptime) {
+		sealsweeptime = now + SEAL_SKEW_SEC;
+		for (auto iter = sealnonces.begin(); iter != sealnonces.end();) {
+			if (iter->second < now)
+				iter = sealnonces.erase(iter);
+			else
+				iter++;
+		}
+	}
+
+	return sealnonces.size() < SEAL_MAX_NONCES && sealnonces.find(key) == sealnonces.end();
+}
+
+int sealhello(struct evbuffer* input, _SEAL_STATE*& seal)
+{
+	size_t bufferlen = evbuffer_get_length(input);
+
+	if (bufferlen < 3)
+		return 0;
+
+	unsigned char* data = evbuffer_pullup(input, 3);
+	if (data[0] != SEAL_HELLO || (((size_t)data[1] << 8) | data[2]) != sizeof(_SEAL_HELLO_MSG))
+		return -1;
+	if (bufferlen < sizeof(_SEAL_HELLO_MSG))
+		return 0;
+
+	_SEAL_HELLO_MSG hello;
+	evbuffer_remove(input, &hello, sizeof(hello));
+
+	time_t now = clocktime();
+	if (hello.version != SEAL_VERSION || (time_t)hello.wall < now - SEAL_SKEW_SEC || (time_t)hello.wall > now + SEAL_SKEW_SEC)
+		return -1;
+
+	int64_t guiid = 0;
+	uint64_t nonce;
+	uint8_t mac[LOGINTOKEN_MAC_SIZE];
+	memcpy(&nonce, hello.nonce, sizeof(nonce));
+	if (!logintokenmac(hello.token, guiid, mac) || !sealisnew(nonce, now))
+		return -1;
+
+	uint8_t material[sizeof(SEAL_LABEL) - 1 + sizeof(_SEAL_HELLO_MSG)];
+	uint8_t key[SHA256_DIGEST_SIZE];
+	_HMAC_SHA256_KEY hkey;
+
+	memcpy(material, SEAL_LABEL, sizeof(SEAL_LABEL) - 1);
+	memcpy(material + sizeof(SEAL_LABEL) - 1, &hello, sizeof(hello));
+	hmacsha256key(hkey, mac, sizeof(mac));
+	hmacsha256(hkey, material, sizeof(material), key);
+
+	seal = new _SEAL_STATE();
+	hmacsha256key(hkey, key, sizeof(key));
+	hmacsha256(hkey, "client", 6, seal->rxkey);
+	hmacsha256(hkey, "server", 6, seal->txkey);
+	seal->rxcount = 0;
+	seal->txcount = 0;
+	seal->guiid = guiid;
+	seal->nonce = nonce;
+	seal->nonceexpire = (int64_t)hello.wall + SEAL_SKEW_SEC;
+	seal->input = evbuffer_new();
+	return 1;
+}
+
+int sealdecode(_SEAL_STATE* seal, struct evbuffer* input)
+{
+	while (true) {
+
+		size_t bufferlen = evbuffer_get_length(input);
+
+		if (bufferlen < SEAL_RECORD_HEADER)
+			break;
+
+		unsigned char* data = evbuffer_pullup(input, SEAL_RECORD_HEADER);
+		if (data[0] != SEAL_RECORD)
+			return -1;
+
+		size_t len = ((size_t)data[1] << 8) | data[2];
+		if (bufferlen < SEAL_RECORD_HEADER + len + CHACHAPOLY_TAG_SIZE)
+			break;
+
+		uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+		sealnonce(seal->rxcount, nonce);
+		data = evbuffer_pullup(input, SEAL_RECORD_HEADER + len + CHACHAPOLY_TAG_SIZE);
+		if (!chachapolyopen(seal->rxkey, nonce, data, SEAL_RECORD_HEADER, data + SEAL_RECORD_HEADER, len, data + SEAL_RECORD_HEADER + len))
+			return -1;
+		// the app knows the mac, still on loop 0. two connections of one recorded hello meet here
+		if (seal->rxcount == 0 && (sealnonces.size() >= SEAL_MAX_NONCES || !sealnonces.emplace(seal->nonce, (time_t)seal->nonceexpire).second))
+			return -1;
+		seal->rxcount++;
+
+		evbuffer_drain(input, SEAL_RECORD_HEADER);
+		evbuffer_remove_buffer(input, seal->input, len);
+		evbuffer_drain(input, CHACHAPOLY_TAG_SIZE);
+	}
+
+	return 0;
+}
+
+// the plaintext is copied once, into the space of the record, and sealed there
+bool sealwrite(_SEAL_STATE* seal, struct evbuffer* output, const unsigned char* data, size_t len)
+{
+	while (len > 0) {
+		size_t size = (len < SEAL_MAX_RECORD) ? len : SEAL_MAX_RECORD;
+		struct evbuffer_iovec vec;
+
+		if (evbuffer_reserve_space(output, SEAL_RECORD_HEADER + size + CHACHAPOLY_TAG_SIZE, &vec, 1) != 1)
+			return false;
+
+		uint8_t* record = (uint8_t*)vec.iov_base;
+		uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+
+		record[0] = SEAL_RECORD;
+		record[1] = (uint8_t)(size >> 8);
+		record[2] = (uint8_t)size;
+		memcpy(record + SEAL_RECORD_HEADER, data, size);
+		sealnonce(seal->txcount++, nonce);
+		chachapolyseal(seal->txkey, nonce, record, SEAL_RECORD_HEADER, record + SEAL_RECORD_HEADER, size, record + SEAL_RECORD_HEADER + size);
+
+		vec.iov_len = SEAL_RECORD_HEADER + size + CHACHAPOLY_TAG_SIZE;
+		if (evbuffer_commit_space(output, &vec, 1) != 0)
+			return false;
+
+		data += size;
+		len -= size;
+	}
+
+	return true;
+}
+
+void sealfree(_SEAL_STATE*& seal)
+{
+	if (seal == NULL)
+		return;
+
+	evbuffer_free(seal->input);
+	delete seal;
+	seal = NULL;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "chachapoly.h"
+#include "logintoken.h"
+
+// sealed connections, the game port under chacha20-poly1305 for an app that holds a login token. the
+// app writes its hello and its first sealed record together, a sealed connection costs no round trip:
+//   hello   C4, length of the hello in 2 bytes, version, the signed bytes of its token, its unix
+//           seconds and a nonce of its own
+//   record  C3, length of the ciphertext in 2 bytes, the ciphertext of whole packets, the tag
+// the mac of the token is the secret both sides know, the hello does not carry it and the server signs
+// the named bytes again instead of keeping anything. both take
+//   key = hmac-sha-256(mac, SEAL_LABEL | hello) and hmac-sha-256(key, "client" or "server") from it
+// and the nonce of a record is the count of records before it in its direction, nothing of it goes over
+// the wire. a record is opened in place in the input buffer and sealed in place in the output one
+//
+// an app gets a token at every login, so it logs in in the clear once and seals every connection after,
+// a resume included. a hello SEAL_SKEW_SEC away from the clock of the server or with a nonce seen in
+// that time is refused, a recorded connection can not be played again. anyone can make a hello the
+// server takes, so its nonce is kept only once its first record opened, SEAL_MAX_NONCES at most. the
+// packets inside are v1 or v2 as agreed at login, a websocket client has the tls of its browser instead
+
+#define SEAL_HELLO 0xC4
+#define SEAL_RECORD 0xC3
+#define SEAL_VERSION 1
+#define SEAL_LABEL "tongits seal"
+#define SEAL_NONCE_SIZE 16
+#define SEAL_RECORD_HEADER 3
+#define SEAL_MAX_RECORD 0xFFFF	// ciphertext of a record, a longer send is cut into several
+#define SEAL_SKEW_SEC 60
+#define SEAL_MAX_NONCES 65536	// a full window refuses the hellos until some expire
+
+struct _SEAL_HELLO_MSG
+{
+	uint8_t c;	// SEAL_HELLO
+	uint8_t len[2];	// sizeof(_SEAL_HELLO_MSG), big endian like a C2 header
+	uint8_t version;
+	uint8_t token[LOGINTOKEN_SIGNED_SIZE];
+	uint32_t wall;	// unix seconds of the app
+	uint8_t nonce[SEAL_NONCE_SIZE];
+};
+
+static_assert(sizeof(_SEAL_HELLO_MSG) == 36, "_SEAL_HELLO_MSG has no padding");
+
+// of a connection, used on the loop that owns it
+struct _SEAL_STATE
+{
+	uint8_t rxkey[CHACHAPOLY_KEY_SIZE];
+	uint8_t txkey[CHACHAPOLY_KEY_SIZE];
+	uint64_t rxcount;
+	uint64_t txcount;
+	int64_t guiid;	// of the token of the hello
+	uint64_t nonce;	// of the hello, kept once the first record opens
+	int64_t nonceexpire;	// unix seconds
+	struct evbuffer* input;	// opened packets not parsed yet
+};
+
+void sealinit();	// at startup, after logintokeninit
+bool sealisenabled();
+
+// the hello at the front of input, 1 once seal is made, 0 while it is incomplete, -1 when it is refused.
+// loop 0, where every connection reads first
+int sealhello(struct evbuffer* input, _SEAL_STATE*& seal);
+// opens every complete record of input into seal->input, -1 for a forged or malformed one
+int sealdecode(_SEAL_STATE* seal, struct evbuffer* input);
+bool sealwrite(_SEAL_STATE* seal, struct evbuffer* output, const unsigned char* data, size_t len);
+void sealfree(_SEAL_STATE*& seal);
@@ -0,0 +1,225 @@
+#include "sessiondir.h"
+#include "common.h"
+#include "conf.h"
+#include "cluster.h"
+#include "dbpool.h"
+#include <unordered_map>
+#include <vector>
+
+// a session the directory knows and until when
+struct _SESSION_SLOT
+{
+	_SESSION_ENTRY entry;
+	uint64_t expires;	// 0 for a session of this server, which stays until it ends
+	bool isfound;	// false for a database read without a session
+};
+
+static _SESSION_STORE sessionstore = _SESSION_STORE::_LOCAL;
+static std::unordered_map<int64_t, _SESSION_SLOT> sessionslots;	// loop 0 only
+static std::vector<_CLUSTER_SESSION_ITEM> sessionqueue;	// changes the router has not been sent
+static uint64_t sessionreplicatetick = 0;
+static uint64_t sessionsweeptick = 0;
+
+static const char* sessionstorenames[] = { "local", "replicated", "database" };
+
+static bool sessionisown(const _SESSION_SLOT& slot)
+{
+	return slot.expires == 0;
+}
+
+static void sessionqueueitem(int64_t token, int64_t gameserial, int seat, bool isput)
+{
+	_CLUSTER_SESSION_ITEM item;
+
+	item.token = token;
+	item.gameserial = gameserial;
+	item.seat = (uint8_t)seat;
+	item.isput = isput ? 1 : 0;
+	sessionqueue.push_back(item);
+}
+
+// the change goes to where the other servers look, nowhere for a local store
+static void sessionpublish(int64_t token, int64_t gameserial, int seat, bool isput)
+{
+	if (sessionstore == _SESSION_STORE::_REPLICATED) {
+		if (clusterrole() == _CLUSTER_ROLE::_NODE)
+			sessionqueueitem(token, gameserial, seat, isput);
+		return;
+	}
+
+	if (sessionstore != _SESSION_STORE::_DATABASE)
+		return;
+
+	_DB_JOB* job = new _DB_JOB();
+	job->type = isput ? _DB_JOB_TYPE::_SESSIONPUT : _DB_JOB_TYPE::_SESSIONDEL;
+	job->guiid = token;
+	job->session.host = c.getnodehost();
+	job->session.port = c.getnodeport();
+	job->session.gameserial = gameserial;
+	job->session.seat = seat;
+	dbsubmit(job);
+}
+
+bool sessionstart()
+{
+	std::string name = c.getsessionstore();
+
+	sessionstore = _SESSION_STORE::_LOCAL;
+
+	if (name.empty() || name == "local")
+		return true;
+
+	if (name == "replicated") {
+		if (clusterrole() == _CLUSTER_ROLE::_NONE) {
+			MSGLOG(eMSGTYPE::ERROR, "Session Store replicated needs a Cluster Role, sessions stay local.");
+			return false;
+		}
+		sessionstore = _SESSION_STORE::_REPLICATED;
+	}
+	else if (name == "database") {
+		if (c.getsql().host.empty()) {
+			MSGLOG(eMSGTYPE::ERROR, "Session Store database needs SQL Host, sessions stay local.");
+			return false;
+		}
+		sessionstore = _SESSION_STORE::_DATABASE;
+	}
+	else {
+		MSGLOG(eMSGTYPE::ERROR, "Session Store is local, replicated or database, not %s.", name.c_str());
+		return false;
+	}
+
+	if (c.getnodehost().empty() && clusterrole() != _CLUSTER_ROLE::_ROUTER)
+		MSGLOG(eMSGTYPE::ERROR, "Node Host is not set, the other servers can not send a player back to this one.");
+
+	MSGLOG(eMSGTYPE::INFO, "Game sessions are shared through the %s store.", sessionstorenames[(int)sessionstore]);
+	return true;
+}
+
+void sessionput(int64_t token, int64_t gameserial, int seat)
+{
+	if (token <= 0)
+		return;
+
+	_SESSION_SLOT& slot = sessionslots[token];
+
+	slot.entry.host.clear();
+	slot.entry.port = 0;
+	slot.entry.gameserial = gameserial;
+	slot.entry.seat = seat;
+	slot.expires = 0;
+	slot.isfound = true;
+
+	sessionpublish(token, gameserial, seat, true);
+}
+
+void sessiondel(int64_t token)
+{
+	if (token <= 0)
+		return;
+
+	auto iter = sessionslots.find(token);
+	if (iter != sessionslots.end() && sessionisown(iter->second))
+		sessionslots.erase(iter);
+
+	sessionpublish(token, 0, 0, false);
+}
+
+void sessionfind(int64_t token, std::function<void(const _SESSION_ENTRY*)> done)
+{
+	auto iter = sessionslots.find(token);
+
+	if (iter != sessionslots.end() && (sessionisown(iter->second) || clockmsec() < iter->second.expires)) {
+		done(iter->second.isfound ? &iter->second.entry : NULL);
+		return;
+	}
+
+	if (sessionstore != _SESSION_STORE::_DATABASE || token <= 0) {
+		done(NULL);
+		return;
+	}
+
+	_DB_JOB* job = new _DB_JOB();
+	job->type = _DB_JOB_TYPE::_SESSIONGET;
+	job->guiid = token;
+	job->done = [token, done](_DB_JOB* job) {
+		// a failed read is not kept, the next login asks again
+		if (job->result == DB_RESULT_FAILED) {
+			done(NULL);
+			return;
+		}
+
+		auto result = sessionslots.emplace(token, _SESSION_SLOT());
+		_SESSION_SLOT& slot = result.first->second;
+
+		// not over a table of this server that started while the read was out
+		if (result.second || !sessionisown(slot)) {
+			slot.entry.host = job->session.host;
+			slot.entry.port = (unsigned short)job->session.port;
+			slot.entry.gameserial = job->session.gameserial;
+			slot.entry.seat = job->session.seat;
+			slot.expires = clockmsec() + SESSION_CACHE_MSEC;
+			slot.isfound = (job->result == DB_RESULT_OK);
+		}
+		done(slot.isfound ? &slot.entry : NULL);
+	};
+	dbsubmit(job);
+}
+
+// a session of this server, or one written by it before a restart
+bool sessionislocal(const _SESSION_ENTRY& entry)
+{
+	return entry.host.empty() || (entry.host == c.getnodehost() && entry.port == c.getnodeport());
+}
+
+void sessionreplica(const std::string& host, unsigned short port, int64_t token, int64_t gameserial, int seat, bool isput)
+{
+	auto iter = sessionslots.find(token);
+
+	// a table of the router itself, the node's is older
+	if (iter != sessionslots.end() && sessionisown(iter->second))
+		return;
+
+	// only the node that has the table ends its session, a migrated table is put by its new node first
+	if (!isput) {
+		if (iter != sessionslots.end() && iter->second.entry.host == host && iter->second.entry.port == port)
+			sessionslots.erase(iter);
+		return;
+	}
+
+	_SESSION_SLOT& slot = sessionslots[token];
+	slot.entry.host = host;
+	slot.entry.port = port;
+	slot.entry.gameserial = gameserial;
+	slot.entry.seat = seat;
+	slot.expires = clockmsec() + SESSION_REPLICA_TIMEOUT_MSEC;
+	slot.isfound = true;
+}
+
+void sessionrun()
+{
+	if (sessionstore == _SESSION_STORE::_REPLICATED && clusterrole() == _CLUSTER_ROLE::_NODE) {
+
+		if (clockmsec() >= sessionreplicatetick) {
+			sessionreplicatetick = clockmsec() + SESSION_REPLICATE_MSEC;
+			for (auto& iter : sessionslots) {
+				if (sessionisown(iter.second))
+					sessionqueueitem(iter.first, iter.second.entry.gameserial, iter.second.entry.seat, true);
+			}
+		}
+
+		for (size_t n = 0; n < sessionqueue.size(); n += CLUSTER_SESSION_ITEMS)
+			clustersessions(&sessionqueue[n], (int)std::min(sessionqueue.size() - n, (size_t)CLUSTER_SESSION_ITEMS));
+		sessionqueue.clear();
+	}
+
+	if (clockmsec() < sessionsweeptick)
+		return;
+	sessionsweeptick = clockmsec() + SESSION_CACHE_MSEC;
+
+	for (auto iter = sessionslots.begin(); iter != sessionslots.end();) {
+		if (!sessionisown(iter->second) && clockmsec() >= iter->second.expires)
+			iter = sessionslots.erase(iter);
+		else
+			iter++;
+	}
+}
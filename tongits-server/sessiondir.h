@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <functional>
+
+// where the game session of a token is, so a player that comes back on another server of a cluster
+// is sent to its table. the sessions of this server are always in the directory, "Session Store"
+// decides where the others come from
+//   local       nowhere, a player resumes only on the server of its table
+//   replicated  a node sends its session changes to the router, and all of its sessions every
+//               SESSION_REPLICATE_MSEC so a lost datagram is made good. the router drops a session it
+//               has not heard of for SESSION_REPLICA_TIMEOUT_MSEC
+//   database    every server writes its sessions to
+//                 game_sessions (token BIGINT PRIMARY KEY, host VARCHAR(64), port INT,
+//                   gameserial BIGINT, seat INT)
+//               and reads what it does not know from there. a read, also one without a session, is
+//               kept for SESSION_CACHE_MSEC
+// the login looks the token up once. a session on another server gets a redirect with a login token
+// and the client resumes there
+
+#define SESSION_REPLICATE_MSEC 10000
+#define SESSION_REPLICA_TIMEOUT_MSEC 35000
+#define SESSION_CACHE_MSEC 5000
+#define SESSION_RESUME_GAMETYPE 0xFF	// of a redirect to resume, the client does not join a table
+
+enum class _SESSION_STORE
+{
+	_LOCAL = 0,
+	_REPLICATED,
+	_DATABASE,
+};
+
+struct _SESSION_ENTRY
+{
+	std::string host;	// the Node Host of the server, empty for this one
+	unsigned short port;
+	int64_t gameserial;
+	int seat;
+};
+
+bool sessionstart();	// after clusterstart, false when Session Store can not be used
+// the sessions of this server, loop 0
+void sessionput(int64_t token, int64_t gameserial, int seat);
+void sessiondel(int64_t token);
+// done runs on loop 0 with the session or NULL, at once when the directory has the answer
+void sessionfind(int64_t token, std::function<void(const _SESSION_ENTRY*)> done);
+bool sessionislocal(const _SESSION_ENTRY& entry);
+// the router, for a datagram of a node
+void sessionreplica(const std::string& host, unsigned short port, int64_t token, int64_t gameserial, int seat, bool isput);
+void sessionrun();	// on every loop 0 tick
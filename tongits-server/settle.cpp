@@ -0,0 +1,379 @@
+#include "settle.h"
+#include "history.h"
+#include "common.h"
+#include "socket.h"
+#include "taskpool.h"
+#include <thread>
+#include <algorithm>
+#include <memory>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool endsettleworker = false;
+
+static std::mutex settlelock;
+static std::vector<_SETTLE_INFO> vsettleinfo;
+
+void addsettle(const _SETTLE_INFO& info)
+{
+	settlelock.lock();
+	vsettleinfo.push_back(info);
+	settlelock.unlock();
+}
+
+// the queued rounds for whoever checks them instead of the worker
+void swapsettle(std::vector<_SETTLE_INFO>& vbuffer)
+{
+	settlelock.lock();
+	vsettleinfo.swap(vbuffer);
+	settlelock.unlock();
+}
+
+// yyyymmdd of the local day
+static int historydate(time_t t)
+{
+	struct tm lt;
+#ifdef _WIN32
+	localtime_s(&lt, &t);
+#else
+	localtime_r(&t, &lt);
+#endif
+	return (lt.tm_year + 1900) * 10000 + (lt.tm_mon + 1) * 100 + lt.tm_mday;
+}
+
+static void historyname(int date, char* filename, size_t size)
+{
+	snprintf(filename, size, "%s/%s_%04d-%02d-%02d.hist", LOG_DIRECTORY, HISTORY_FILENAME, date / 10000, date / 100 % 100, date % 100);
+}
+
+// the writer of the settle worker, the hands of a block wait in vhands for up to HISTORY_BLOCK_MSEC
+struct _HISTORY_WRITER
+{
+	FILE* fp;
+	int date;
+	char filename[260];
+	unsigned long long since;
+	std::vector<_SETTLE_INFO> vhands;
+	std::vector<unsigned char> vchunk;
+};
+
+static FILE* historyappendto(const char* filename)
+{
+	_HISTORY_VIEW view;
+
+	// a torn chunk of a crash is cut before anything goes after it
+	if (historyopen(filename, view)) {
+		size_t valid = view.valid;
+		size_t size = view.size;
+		historyclose(view);
+		if (valid < size) {
+			MSGLOG(eMSGTYPE::INFO, "settleworker, %s cut from %zu to %zu bytes.", filename, size, valid);
+#ifdef _WIN32
+			FILE* fp = fopen(filename, "r+b");
+			if (fp != NULL) {
+				_chsize_s(_fileno(fp), (long long)valid);
+				fclose(fp);
+			}
+#else
+			if (truncate(filename, (off_t)valid) != 0)
+				MSGLOG(eMSGTYPE::ERROR, "settleworker, failed to cut %s.", filename);
+#endif
+		}
+	}
+
+#ifdef _WIN32
+	CreateDirectoryA(LOG_DIRECTORY, NULL);
+#else
+	mkdir(LOG_DIRECTORY, 0755);
+#endif
+	FILE* fp = fopen(filename, "ab");
+	if (fp == NULL)
+		MSGLOG(eMSGTYPE::ERROR, "settleworker, failed to open %s.", filename);
+	return fp;
+}
+
+static void historywrite(_HISTORY_WRITER& writer)
+{
+	if (writer.vhands.empty())
+		return;
+
+	if (writer.fp == NULL)
+		writer.fp = historyappendto(writer.filename);
+
+	if (writer.fp != NULL) {
+		writer.vchunk.clear();
+		historyblock(writer.vhands.data(), (int)writer.vhands.size(), writer.vchunk);
+		fwrite(writer.vchunk.data(), 1, writer.vchunk.size(), writer.fp);
+		fflush(writer.fp);
+	}
+	writer.vhands.clear();
+}
+
+// the day is over, its index goes at the end of the segment
+static void historyseal(_HISTORY_WRITER& writer)
+{
+	historywrite(writer);
+	if (writer.fp == NULL)
+		return;
+
+	fclose(writer.fp);
+	writer.fp = NULL;
+
+	_HISTORY_VIEW view;
+	if (!historyopen(writer.filename, view))
+		return;
+	writer.vchunk.clear();
+	historyindex(view, writer.vchunk);
+	historyclose(view);
+
+	if (writer.vchunk.empty())
+		return;
+
+	FILE* fp = fopen(writer.filename, "ab");
+	if (fp == NULL) {
+		MSGLOG(eMSGTYPE::ERROR, "settleworker, failed to open %s.", writer.filename);
+		return;
+	}
+	fwrite(writer.vchunk.data(), 1, writer.vchunk.size(), fp);
+	fclose(fp);
+}
+
+static void historyadd(_HISTORY_WRITER& writer, const _SETTLE_INFO& info)
+{
+	int date = historydate((time_t)info.time);
+
+	if (date != writer.date) {
+		historyseal(writer);
+		writer.date = date;
+		historyname(date, writer.filename, sizeof(writer.filename));
+	}
+
+	if (writer.vhands.empty())
+		writer.since = GetTickCount64();
+	writer.vhands.push_back(info);
+	if (writer.vhands.size() >= HISTORY_BLOCK_ROWS)
+		historywrite(writer);
+}
+
+// appends the settled rounds to the audit log and the match history off the event loops
+void settleworker()
+{
+	std::vector<_SETTLE_INFO> vbuffer;
+	std::vector<_SETTLE_INFO>::iterator iter;
+	_HISTORY_WRITER writer;
+
+	writer.fp = NULL;
+	writer.date = 0;
+	writer.filename[0] = 0;
+	writer.since = 0;
+
+	FILE* fp = fopen(SETTLE_LOG, "a");
+
+	if (fp == NULL) {
+		MSGLOG(eMSGTYPE::ERROR, "settleworker, failed to open %s.", SETTLE_LOG);
+	}
+
+	while (true) {
+
+		settlelock.lock();
+		vsettleinfo.swap(vbuffer);
+		settlelock.unlock();
+
+		for (iter = vbuffer.begin(); iter != vbuffer.end() && fp != NULL; iter++) {
+			const _SETTLE_INFO& info = *iter;
+			fprintf(fp, "%lld serial %lld type %d winner %d tongits %d total %d hit %d tax %0.3f",
+				(long long)info.time, (long long)info.serial, info.ectype, info.winnerpos, info.istongits, info.total, info.hitprize, info.hittax);
+			for (int i = 0; i < 3; i++) {
+				const _SETTLE_SEAT& seat = info.seats[i];
+				fprintf(fp, " | %lld %d %+d fight %d regular %d quadra %d royal %d ace %d burned %d",
+					(long long)seat.token, seat.before, seat.delta, seat.fight, seat.regular, seat.quadra, seat.royal, seat.ace, seat.burned);
+			}
+			fprintf(fp, "\n");
+		}
+
+		if (fp != NULL && !vbuffer.empty())
+			fflush(fp);
+
+		for (iter = vbuffer.begin(); iter != vbuffer.end(); iter++)
+			historyadd(writer, *iter);
+		if (!writer.vhands.empty() && GetTickCount64() - writer.since >= HISTORY_BLOCK_MSEC)
+			historywrite(writer);
+
+		vbuffer.clear();
+		if (endsettleworker)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	if (fp != NULL)
+		fclose(fp);
+	historyseal(writer);
+}
+
+// the outcome of a query, filled by the task pool
+struct _HISTORY_ANSWER
+{
+	_HISTORY_RESULT result;
+	int date;
+	std::vector<_PMSG_HISTORY_GAME> vgames;
+	_HISTORY_TOTALS totals[2];
+};
+
+static void historylastwork(_HISTORY_ANSWER& answer, int64_t token, int count)
+{
+	std::vector<_SETTLE_INFO> vhands;
+	char filename[260];
+	time_t now = clocktime();
+	bool isfound = false;
+
+	for (int day = 0; day < HISTORY_MAX_DAYS && (int)vhands.size() < count; day++) {
+		struct tm lt;
+#ifdef _WIN32
+		localtime_s(&lt, &now);
+#else
+		localtime_r(&now, &lt);
+#endif
+		lt.tm_mday -= day;
+		lt.tm_isdst = -1;
+		int date = historydate(mktime(&lt));
+		if (day == 0)
+			answer.date = date;
+
+		_HISTORY_VIEW view;
+		historyname(date, filename, sizeof(filename));
+		if (!historyopen(filename, view))
+			continue;
+		isfound = true;
+		historylast(view, token, count - (int)vhands.size(), vhands);
+		historyclose(view);
+	}
+
+	if (!isfound) {
+		answer.result = _HISTORY_RESULT::_NOSEGMENT;
+		return;
+	}
+
+	for (const _SETTLE_INFO& hand : vhands) {
+		int pos = 0;
+		while (pos < 2 && hand.seats[pos].token != token)
+			pos++;
+		const _SETTLE_SEAT& seat = hand.seats[pos];
+
+		_PMSG_HISTORY_GAME game;
+		memset(&game, 0, sizeof(game));
+		game.time = hand.time;
+		game.serial = hand.serial;
+		game.ectype = hand.ectype;
+		game.winnerpos = hand.winnerpos;
+		game.istongits = hand.istongits ? 1 : 0;
+		game.userpos = (unsigned char)pos;
+		game.hitprize = hand.hitprize;
+		game.total = hand.total;
+		game.before = seat.before;
+		game.delta = seat.delta;
+		game.cardcount = seat.cardcount;
+		game.fight = seat.fight;
+		game.regular = seat.regular;
+		game.quadra = seat.quadra;
+		game.royal = seat.royal;
+		game.ace = seat.ace;
+		game.burned = seat.burned;
+		answer.vgames.push_back(game);
+	}
+}
+
+static void historytotalswork(_HISTORY_ANSWER& answer, int date)
+{
+	char filename[260];
+	_HISTORY_VIEW view;
+
+	answer.date = (date != 0) ? date : historydate(clocktime());
+	historyname(answer.date, filename, sizeof(filename));
+	if (!historyopen(filename, view)) {
+		answer.result = _HISTORY_RESULT::_NOSEGMENT;
+		return;
+	}
+	historytotals(view, answer.totals, 2);
+	historyclose(view);
+}
+
+static void historyanswer(uintptr_t userindex, int aindex, unsigned char action, const _HISTORY_ANSWER& answer)
+{
+	std::vector<unsigned char> buffer;
+	int count = 0;
+
+	if (answer.result == _HISTORY_RESULT::_OK)
+		count = ((_HISTORY_ACTION)action == _HISTORY_ACTION::_LAST) ? (int)answer.vgames.size() : 2;
+
+	size_t item = ((_HISTORY_ACTION)action == _HISTORY_ACTION::_LAST) ? sizeof(_PMSG_HISTORY_GAME) : sizeof(_PMSG_HISTORY_TOTAL);
+	buffer.resize(sizeof(_PMSG_HISTORY_ANS) + count * item);
+
+	_PMSG_HISTORY_ANS* pMsg = (_PMSG_HISTORY_ANS*)buffer.data();
+	unsigned char* pInfo = buffer.data() + sizeof(_PMSG_HISTORY_ANS);
+
+	if ((_HISTORY_ACTION)action == _HISTORY_ACTION::_LAST) {
+		if (count > 0)
+			memcpy(pInfo, answer.vgames.data(), count * item);
+	}
+	else {
+		for (int n = 0; n < count; n++) {
+			const _HISTORY_TOTALS& totals = answer.totals[n];
+			_PMSG_HISTORY_TOTAL* pTotal = (_PMSG_HISTORY_TOTAL*)(pInfo + n * item);
+			pTotal->ectype = (unsigned char)n;
+			pTotal->hands = totals.hands;
+			pTotal->tongits = totals.tongits;
+			pTotal->pot = totals.pot;
+			pTotal->hitprize = totals.hitprize;
+			pTotal->regular = totals.regular;
+			pTotal->fight = totals.fight;
+			pTotal->quadra = totals.quadra;
+			pTotal->royal = totals.royal;
+			pTotal->ace = totals.ace;
+			pTotal->burned = totals.burned;
+		}
+	}
+
+	int size = (int)buffer.size();
+	pMsg->hdr.c = 0xC2;
+	pMsg->hdr.h = 0xF4;
+	pMsg->hdr.len[0] = SET_NUMBERH(size);
+	pMsg->hdr.len[1] = SET_NUMBERL(size);
+	pMsg->sub = 0x0D;
+	pMsg->aindex = aindex;
+	pMsg->action = action;
+	pMsg->result = (unsigned char)answer.result;
+	pMsg->count = (unsigned char)count;
+	pMsg->date = answer.date;
+	::datasend(userindex, buffer.data(), size);
+}
+
+void historyquery(uintptr_t userindex, int aindex, unsigned char action, int64_t token, unsigned char count, int date)
+{
+	std::shared_ptr<_HISTORY_ANSWER> answer = std::make_shared<_HISTORY_ANSWER>();
+
+	answer->result = _HISTORY_RESULT::_OK;
+	answer->date = date;
+	memset(answer->totals, 0, sizeof(answer->totals));
+
+	if (action >= (unsigned char)_HISTORY_ACTION::_MAX || ((_HISTORY_ACTION)action == _HISTORY_ACTION::_LAST && (count == 0 || token == 0))) {
+		answer->result = _HISTORY_RESULT::_BADREQ;
+		historyanswer(userindex, aindex, action, *answer);
+		return;
+	}
+
+	// the segments are mapped and read off the loops, the writer only ever appends to them
+	int n = std::min((int)count, HISTORY_MAX_GAMES);
+	tasksubmit(_TASK_LANE::_NORMAL,
+		[answer, action, token, n, date]() {
+			if ((_HISTORY_ACTION)action == _HISTORY_ACTION::_LAST)
+				historylastwork(*answer, token, n);
+			else
+				historytotalswork(*answer, date);
+		},
+		[userindex, aindex, action, answer]() { historyanswer(userindex, aindex, action, *answer); });
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+
+// one seat of a settled round, losers pay the listed amounts and the winner gets delta
+struct _SETTLE_SEAT
+{
+	int64_t token;
+	int before;
+	int cardcount;
+	int fight;
+	int regular;
+	int quadra;
+	int royal;
+	int ace;
+	int burned;
+	int delta;
+};
+
+// ledger of one round, filled by game::getwinner then sent to the players and queued for the settle worker
+struct _SETTLE_INFO
+{
+	int64_t serial;
+	int64_t time;
+	unsigned char ectype;
+	unsigned char winnerpos;
+	bool istongits;
+	int hitprize;
+	float hittax;
+	int total;
+	_SETTLE_SEAT seats[3];
+};
+
+#define SETTLE_LOG "settle.log"
+
+// the settle worker also keeps every hand in the match history segments of history.h
+enum class _HISTORY_ACTION : unsigned char
+{
+	_LAST = 0,
+	_TOTALS,
+	_MAX,
+};
+
+enum class _HISTORY_RESULT : unsigned char
+{
+	_OK = 0,
+	_NOSEGMENT,	// no history of the day, or of any day the last games were looked for in
+	_BADREQ,
+};
+
+void settleworker();
+void addsettle(const _SETTLE_INFO& info);
+void swapsettle(std::vector<_SETTLE_INFO>& vbuffer);
+// any loop, read by the task pool and answered with 0xF4 0x0D
+void historyquery(uintptr_t userindex, int aindex, unsigned char action, int64_t token, unsigned char count, int date);
+extern bool endsettleworker;
@@ -0,0 +1,307 @@
+#include "sha256.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SHA256_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SHA256_TARGET
+#else
+#include <cpuid.h>
+#define SHA256_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+#elif defined(__ARM_FEATURE_SHA2) || defined(_M_ARM64)
+#define SHA256_ARM
+#include <arm_neon.h>
+#endif
+
+typedef void (*_SHA256_BLOCKS)(uint32_t* state, const uint8_t* data, size_t blocks);
+
+static const uint32_t sha256k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t sha256ror(uint32_t x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static void sha256blocks_c(uint32_t* state, const uint8_t* data, size_t blocks)
+{
+	uint32_t w[64];
+
+	while (blocks--) {
+		for (int n = 0; n < 16; n++)
+			w[n] = ((uint32_t)data[n * 4] << 24) | ((uint32_t)data[n * 4 + 1] << 16) | ((uint32_t)data[n * 4 + 2] << 8) | data[n * 4 + 3];
+		for (int n = 16; n < 64; n++) {
+			uint32_t s0 = sha256ror(w[n - 15], 7) ^ sha256ror(w[n - 15], 18) ^ (w[n - 15] >> 3);
+			uint32_t s1 = sha256ror(w[n - 2], 17) ^ sha256ror(w[n - 2], 19) ^ (w[n - 2] >> 10);
+			w[n] = w[n - 16] + s0 + w[n - 7] + s1;
+		}
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int n = 0; n < 64; n++) {
+			uint32_t t1 = h + (sha256ror(e, 6) ^ sha256ror(e, 11) ^ sha256ror(e, 25)) + ((e & f) ^ (~e & g)) + sha256k[n] + w[n];
+			uint32_t t2 = (sha256ror(a, 2) ^ sha256ror(a, 13) ^ sha256ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+		data += SHA256_BLOCK_SIZE;
+	}
+}
+
+#ifdef SHA256_X86
+// the state is kept as abef and cdgh, the layout sha256rnds2 works on
+SHA256_TARGET static void sha256blocks_shani(uint32_t* state, const uint8_t* data, size_t blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	while (blocks--) {
+		__m128i abef = state0;
+		__m128i cdgh = state1;
+		__m128i w[16];
+
+		for (int n = 0; n < 4; n++)
+			w[n] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + n * 16)), mask);
+		for (int n = 4; n < 16; n++)
+			w[n] = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(w[n - 4], w[n - 3]), _mm_alignr_epi8(w[n - 1], w[n - 2], 4)), w[n - 1]);
+
+		for (int n = 0; n < 16; n++) {
+			__m128i msg = _mm_add_epi32(w[n], _mm_loadu_si128((const __m128i*)&sha256k[n * 4]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+		data += SHA256_BLOCK_SIZE;
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	_mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+	_mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+static bool sha256hasshani()
+{
+	unsigned int ebx = 0, ecx = 0;
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	ecx = (unsigned int)info[2];
+	__cpuidex(info, 7, 0);
+	ebx = (unsigned int)info[1];
+#else
+	unsigned int eax = 0, edx = 0;
+	if (__get_cpuid_max(0, NULL) < 7)
+		return false;
+	__cpuid(1, eax, ebx, ecx, edx);
+	unsigned int ecx1 = ecx;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	ecx = ecx1;
+#endif
+	return (ebx & (1u << 29)) != 0 && (ecx & (1u << 19)) != 0;	// sha and sse4.1
+}
+#endif
+
+#ifdef SHA256_ARM
+static void sha256blocks_arm(uint32_t* state, const uint8_t* data, size_t blocks)
+{
+	uint32x4_t state0 = vld1q_u32(&state[0]);
+	uint32x4_t state1 = vld1q_u32(&state[4]);
+
+	while (blocks--) {
+		uint32x4_t abcd = state0;
+		uint32x4_t efgh = state1;
+		uint32x4_t w[16];
+
+		for (int n = 0; n < 4; n++)
+			w[n] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + n * 16)));
+		for (int n = 4; n < 16; n++)
+			w[n] = vsha256su1q_u32(vsha256su0q_u32(w[n - 4], w[n - 3]), w[n - 2], w[n - 1]);
+
+		for (int n = 0; n < 16; n++) {
+			uint32x4_t msg = vaddq_u32(w[n], vld1q_u32(&sha256k[n * 4]));
+			uint32x4_t prev = state0;
+			state0 = vsha256hq_u32(state0, state1, msg);
+			state1 = vsha256h2q_u32(state1, prev, msg);
+		}
+
+		state0 = vaddq_u32(state0, abcd);
+		state1 = vaddq_u32(state1, efgh);
+		data += SHA256_BLOCK_SIZE;
+	}
+
+	vst1q_u32(&state[0], state0);
+	vst1q_u32(&state[4], state1);
+}
+#endif
+
+struct _SHA256_IMPL
+{
+	_SHA256_BLOCKS blocks;
+	const char* name;
+};
+
+static _SHA256_IMPL sha256select()
+{
+#ifdef SHA256_X86
+	if (sha256hasshani())
+		return { sha256blocks_shani, "sha-ni" };
+#endif
+#ifdef SHA256_ARM
+	return { sha256blocks_arm, "armv8" };
+#else
+	return { sha256blocks_c, "c" };
+#endif
+}
+
+static const _SHA256_IMPL sha256impl = sha256select();
+
+const char* sha256backend()
+{
+	return sha256impl.name;
+}
+
+void sha256init(_SHA256_CTX& ctx)
+{
+	static const uint32_t iv[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+	memcpy(ctx.state, iv, sizeof(iv));
+	ctx.length = 0;
+	ctx.used = 0;
+}
+
+void sha256update(_SHA256_CTX& ctx, const void* data, size_t len)
+{
+	const uint8_t* p = (const uint8_t*)data;
+
+	ctx.length += len;
+
+	if (ctx.used != 0) {
+		size_t take = SHA256_BLOCK_SIZE - ctx.used;
+		if (take > len)
+			take = len;
+		memcpy(ctx.buffer + ctx.used, p, take);
+		ctx.used += take;
+		p += take;
+		len -= take;
+		if (ctx.used < SHA256_BLOCK_SIZE)
+			return;
+		sha256impl.blocks(ctx.state, ctx.buffer, 1);
+		ctx.used = 0;
+	}
+
+	if (len >= SHA256_BLOCK_SIZE) {
+		size_t blocks = len / SHA256_BLOCK_SIZE;
+		sha256impl.blocks(ctx.state, p, blocks);
+		p += blocks * SHA256_BLOCK_SIZE;
+		len -= blocks * SHA256_BLOCK_SIZE;
+	}
+
+	if (len != 0) {
+		memcpy(ctx.buffer, p, len);
+		ctx.used = len;
+	}
+}
+
+void sha256final(_SHA256_CTX& ctx, uint8_t* digest)
+{
+	uint64_t bits = ctx.length * 8;
+
+	ctx.buffer[ctx.used++] = 0x80;
+	if (ctx.used > SHA256_BLOCK_SIZE - 8) {
+		memset(ctx.buffer + ctx.used, 0, SHA256_BLOCK_SIZE - ctx.used);
+		sha256impl.blocks(ctx.state, ctx.buffer, 1);
+		ctx.used = 0;
+	}
+	memset(ctx.buffer + ctx.used, 0, SHA256_BLOCK_SIZE - 8 - ctx.used);
+	for (int n = 0; n < 8; n++)
+		ctx.buffer[SHA256_BLOCK_SIZE - 1 - n] = (uint8_t)(bits >> (n * 8));
+	sha256impl.blocks(ctx.state, ctx.buffer, 1);
+
+	for (int n = 0; n < 8; n++) {
+		digest[n * 4] = (uint8_t)(ctx.state[n] >> 24);
+		digest[n * 4 + 1] = (uint8_t)(ctx.state[n] >> 16);
+		digest[n * 4 + 2] = (uint8_t)(ctx.state[n] >> 8);
+		digest[n * 4 + 3] = (uint8_t)ctx.state[n];
+	}
+}
+
+void sha256(const void* data, size_t len, uint8_t* digest)
+{
+	_SHA256_CTX ctx;
+	sha256init(ctx);
+	sha256update(ctx, data, len);
+	sha256final(ctx, digest);
+}
+
+void hmacsha256key(_HMAC_SHA256_KEY& hkey, const void* key, size_t keylen)
+{
+	uint8_t block[SHA256_BLOCK_SIZE] = { 0 };
+	uint8_t pad[SHA256_BLOCK_SIZE];
+
+	if (keylen > SHA256_BLOCK_SIZE)
+		sha256(key, keylen, block);
+	else if (keylen != 0)
+		memcpy(block, key, keylen);
+
+	for (int n = 0; n < SHA256_BLOCK_SIZE; n++)
+		pad[n] = block[n] ^ 0x36;
+	sha256init(hkey.inner);
+	sha256update(hkey.inner, pad, sizeof(pad));
+
+	for (int n = 0; n < SHA256_BLOCK_SIZE; n++)
+		pad[n] = block[n] ^ 0x5c;
+	sha256init(hkey.outer);
+	sha256update(hkey.outer, pad, sizeof(pad));
+
+	memset(block, 0, sizeof(block));
+	memset(pad, 0, sizeof(pad));
+}
+
+void hmacsha256(const _HMAC_SHA256_KEY& hkey, const void* data, size_t len, uint8_t* mac)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	_SHA256_CTX ctx = hkey.inner;
+
+	sha256update(ctx, data, len);
+	sha256final(ctx, digest);
+	ctx = hkey.outer;
+	sha256update(ctx, digest, sizeof(digest));
+	sha256final(ctx, mac);
+}
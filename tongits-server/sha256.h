@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// sha-256 and hmac-sha-256 for the login tokens. blocks go through the sha extensions on x86 cpus that
+// have them, checked once at startup, or the armv8 crypto instructions when the build targets them,
+// and through the portable rounds otherwise
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+struct _SHA256_CTX
+{
+	uint32_t state[8];
+	uint64_t length;	// bytes hashed so far
+	uint8_t buffer[SHA256_BLOCK_SIZE];
+	size_t used;
+};
+
+// the key padded and hashed once, a mac then costs the two blocks of the message and the outer hash
+struct _HMAC_SHA256_KEY
+{
+	_SHA256_CTX inner;
+	_SHA256_CTX outer;
+};
+
+void sha256init(_SHA256_CTX& ctx);
+void sha256update(_SHA256_CTX& ctx, const void* data, size_t len);
+void sha256final(_SHA256_CTX& ctx, uint8_t* digest);
+void sha256(const void* data, size_t len, uint8_t* digest);
+
+void hmacsha256key(_HMAC_SHA256_KEY& hkey, const void* key, size_t keylen);
+void hmacsha256(const _HMAC_SHA256_KEY& hkey, const void* data, size_t len, uint8_t* mac);
+
+const char* sha256backend();
@@ -0,0 +1,86 @@
+#include "slabmem.h"
+#include "common.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static _HUGE_PAGES slabmode = _HUGE_PAGES::_OFF;
+static std::atomic<bool> hugetlbempty(false);	// the pool refused once, the rest go to thp
+
+void slabmeminit(_HUGE_PAGES mode)
+{
+	slabmode = mode;
+	if (mode != _HUGE_PAGES::_OFF)
+		MSGLOG(eMSGTYPE::INFO, "slabmem, user and game slabs are mapped with %s huge pages.", (mode == _HUGE_PAGES::_THP) ? "transparent" : "hugetlb");
+}
+
+// the length of the mapping, whole huge pages so either kind covers all of it
+static size_t slabmemlength(size_t bytes)
+{
+	return (bytes + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+}
+
+#ifndef _WIN32
+// over mapped by one huge page and trimmed, thp only backs the aligned huge pages of a mapping
+static void* slabmemthp(size_t length)
+{
+	char* base = (char*)mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == (char*)MAP_FAILED)
+		return NULL;
+
+	char* aligned = (char*)(((uintptr_t)base + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+	if (aligned > base)
+		munmap(base, aligned - base);
+	if (aligned + length < base + length + HUGE_PAGE_SIZE)
+		munmap(aligned + length, base + length + HUGE_PAGE_SIZE - (aligned + length));
+
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+	return aligned;
+}
+#endif
+
+void* slabmemalloc(size_t bytes)
+{
+	if (slabmode == _HUGE_PAGES::_OFF)
+		return ::operator new(bytes, std::nothrow);
+
+	size_t length = slabmemlength(bytes);
+#ifdef _WIN32
+	// large pages need the lock pages privilege, without it the slab is a plain allocation of its own
+	void* ptr = VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	if (ptr == NULL)
+		ptr = VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	return ptr;
+#else
+#ifdef MAP_HUGETLB
+	if (slabmode == _HUGE_PAGES::_HUGETLB && !hugetlbempty) {
+		void* ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED)
+			return ptr;
+		if (!hugetlbempty.exchange(true))
+			MSGLOG(eMSGTYPE::INFO, "slabmem, no hugetlb pages for a slab of %d KB, see vm.nr_hugepages, transparent ones are asked for from now on.", (int)(length / 1024));
+	}
+#endif
+	return slabmemthp(length);
+#endif
+}
+
+void slabmemfree(void* ptr, size_t bytes)
+{
+	if (ptr == NULL)
+		return;
+
+	if (slabmode == _HUGE_PAGES::_OFF) {
+		::operator delete(ptr);
+		return;
+	}
+#ifdef _WIN32
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	munmap(ptr, slabmemlength(bytes));
+#endif
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <stddef.h>
+#include <new>
+#include "../Common/memtag.h"
+
+// storage of the user and game slabs. with "Huge Pages" set each slab is a mapping of its own, "thp" asks
+// the kernel to back it with transparent huge pages and "hugetlb" takes it from the reserved huge page
+// pool, falling back to thp when the pool is empty or missing, so the tick loop and the user scans walk
+// a few TLB entries instead of one per 4 KB, a slab is rounded up to whole 2 MB pages. the pages are
+// touched first by the thread constructing the slab, so a slab grown on the loop that owns its slots is
+// local to that loop's NUMA node
+
+enum class _HUGE_PAGES
+{
+	_OFF,	// operator new, like any other object
+	_THP,
+	_HUGETLB
+};
+
+void slabmeminit(_HUGE_PAGES mode);	// once, before the first slab
+void* slabmemalloc(size_t bytes);
+void slabmemfree(void* ptr, size_t bytes);
+
+// tag is the subsystem the slab is counted under, see memtag.h
+template <typename T>
+T* slabnew(int count, _MEM_TAG tag)
+{
+	T* slab = (T*)slabmemalloc(sizeof(T) * count);
+	if (slab == NULL)
+		throw std::bad_alloc();
+	memtagalloc(tag, sizeof(T) * count);
+	for (int n = 0; n < count; n++)
+		new (&slab[n]) T();
+	return slab;
+}
+
+template <typename T>
+void slabdelete(T* slab, int count, _MEM_TAG tag)
+{
+	if (slab == NULL)
+		return;
+	for (int n = 0; n < count; n++)
+		slab[n].~T();
+	slabmemfree(slab, sizeof(T) * count);
+	memtagfree(tag, sizeof(T) * count);
+}
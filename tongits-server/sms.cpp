@@ -1,45 +1,564 @@
 #include "sms.h"
 #include "common.h"
+#include "socket.h"
+#include "conf.h"
+#include "../Common/memtag.h"
 #include <curl/curl.h>
+#include <mutex>
+#include <vector>
+#include <deque>
+#include <algorithm>
 
 bool endworker = false;
 
-std::mutex lock;
-std::vector<_SMS_INFO>vsmsinfo;
+// one otp, shared by its requests on the providers
+struct _SMS_SEND : _MemTagged<_MEM_TAG::_HTTP>
+{
+	uint32_t tried;	// a bit per provider
+	int live;	// its requests pending or in flight
+	int failures;
+	bool ishedged;
+	uint64_t hedgetick;	// clockmsec a second provider is asked at when the first has not answered
+	int loop;
+	std::function<void(bool)> done;
+};
+
+// of the worker only
+struct _SMS_PROVIDER_STATE
+{
+	std::string name;
+	std::string url;
+	std::deque<uint32_t> vmsec;	// latency of its last SMS_LATENCY_SAMPLES sends
+	int failures;	// in a row
+	uint64_t openuntil;	// clockmsec its open circuit lets a probe through at
+	bool isprobing;
+	uint64_t sent;
+	uint64_t failed;
+};
+
+// counted by its own size, the strings it holds are not
+struct _HTTP_REQUEST : _MemTagged<_MEM_TAG::_HTTP>
+{
+	std::string url;
+	std::string fields;	// the post body has to live until the transfer is done
+	std::string tag;	// what the log lines name the request by
+	CURL* hnd;
+	int attempt;
+	uint64_t due;
+	bool issent;
+	int loop;
+	std::function<void(bool)> done;
+	_SMS_SEND* sms;	// of an otp, NULL for any other post
+	int provider;	// of an otp, -1 until it is started
+};
+
+static std::mutex httplock;
+static std::vector<_HTTP_REQUEST*> vhttprequests;
+static CURLM* httpmulti = NULL;	// set while the worker runs, httppost wakes it through it
+static _HTTP_STATS httpstats;
+static std::vector<_SMS_PROVIDER_STATE> vsmsproviders;
+
+static _HTTP_REQUEST* httprequest(const std::string& url, const std::string& fields, const std::string& tag)
+{
+	_HTTP_REQUEST* req = new _HTTP_REQUEST();
+	req->url = url;
+	req->fields = fields;
+	req->tag = tag;
+	req->hnd = NULL;
+	req->attempt = 0;
+	req->due = 0;
+	req->issent = false;
+	req->loop = le_getloop();
+	req->sms = NULL;
+	req->provider = -1;
+	return req;
+}
+
+static void httpqueue(_HTTP_REQUEST* req)
+{
+	httpstats.queued++;
+	httplock.lock();
+	vhttprequests.push_back(req);
+	if (httpmulti != NULL)
+		curl_multi_wakeup(httpmulti);
+	httplock.unlock();
+}
+
+void httppost(const std::string& url, const std::string& fields, const std::string& tag, std::function<void(bool)> done)
+{
+	_HTTP_REQUEST* req = httprequest(url, fields, tag);
+	req->done = std::move(done);
+	httpqueue(req);
+}
+
+void smspost(const _SMS_INFO& info, const std::string& tag, std::function<void(bool)> done)
+{
+	_SMS_SEND* sms = new _SMS_SEND();
+	sms->tried = 0;
+	sms->live = 1;
+	sms->failures = 0;
+	sms->ishedged = false;
+	sms->hedgetick = 0;
+	sms->loop = le_getloop();
+	sms->done = std::move(done);
+
+	_HTTP_REQUEST* req = httprequest("", smsfields(info), tag);
+	req->sms = sms;
+	httpqueue(req);
+}
+
+static std::string httpescape(const std::string& s)
+{
+	char* escaped = curl_easy_escape(NULL, s.c_str(), (int)s.length());
+	std::string result = (escaped != NULL) ? escaped : "";
+	curl_free(escaped);
+	return result;
+}
+
+std::string smsfields(const _SMS_INFO& info)
+{
+	return "smsnumber=" + httpescape(info.mobilenumber) + "&otpmsg=" + httpescape(info.otpmsg);
+}
+
+void addsms(const _SMS_INFO& info)
+{
+	smspost(info, "otp to " + info.mobilenumber);
+}
+
+const _HTTP_STATS& gethttpstats()
+{
+	return httpstats;
+}
+
+static void smsproviders()
+{
+	std::vector<_SMS_PROVIDER> providers = c.getsmsproviders();
+
+	if (providers.empty())
+		providers.push_back({ "default", SMS_URL });
+	if (providers.size() > SMS_MAX_PROVIDERS)
+		providers.resize(SMS_MAX_PROVIDERS);
+
+	vsmsproviders.clear();
+	vsmsproviders.resize(providers.size());
+	for (size_t n = 0; n < providers.size(); n++) {
+		vsmsproviders[n].name = providers[n].name;
+		vsmsproviders[n].url = providers[n].url;
+		vsmsproviders[n].failures = 0;
+		vsmsproviders[n].openuntil = 0;
+		vsmsproviders[n].isprobing = false;
+		vsmsproviders[n].sent = 0;
+		vsmsproviders[n].failed = 0;
+	}
+
+	if (vsmsproviders.size() > 1)
+		MSGLOG(INFO, "httpworker, otps go to the fastest of %d sms providers.", (int)vsmsproviders.size());
+}
+
+static uint32_t smspercentile(const _SMS_PROVIDER_STATE& provider, int percent)
+{
+	if (provider.vmsec.empty())
+		return 0;
+
+	std::vector<uint32_t> vmsec(provider.vmsec.begin(), provider.vmsec.end());
+	size_t k = (vmsec.size() - 1) * percent / 100;
+	std::nth_element(vmsec.begin(), vmsec.begin() + k, vmsec.end());
+	return vmsec[k];
+}
+
+static uint64_t smshedgemsec(const _SMS_PROVIDER_STATE& provider)
+{
+	if (provider.vmsec.size() < SMS_HEDGE_MIN_SAMPLES)
+		return SMS_HEDGE_MAX_MSEC;
+	return std::min<uint64_t>(std::max<uint64_t>(smspercentile(provider, 95), SMS_HEDGE_MIN_MSEC), SMS_HEDGE_MAX_MSEC);
+}
+
+// a closed circuit, or an open one past its time with no probe out
+static bool smsisup(const _SMS_PROVIDER_STATE& provider, uint64_t now)
+{
+	if (provider.failures < SMS_BREAK_FAILURES)
+		return true;
+	return now >= provider.openuntil && !provider.isprobing;
+}
+
+// the fastest provider not in tried that takes an otp, -1 when there is none. one with no sends yet
+// counts as the fastest so a new one is found out, each failure in a row adds SMS_HEDGE_MAX_MSEC
+static int smspick(uint32_t tried, uint64_t now)
+{
+	int best = -1;
+	uint64_t bestmsec = 0;
+
+	for (int n = 0; n < (int)vsmsproviders.size(); n++) {
+		if ((tried & (1u << n)) != 0 || !smsisup(vsmsproviders[n], now))
+			continue;
+		uint64_t msec = smspercentile(vsmsproviders[n], 50) + (uint64_t)vsmsproviders[n].failures * SMS_HEDGE_MAX_MSEC;
+		if (best < 0 || msec < bestmsec) {
+			best = n;
+			bestmsec = msec;
+		}
+	}
+	return best;
+}
+
+static void smsuse(_HTTP_REQUEST* req, int provider, uint64_t now)
+{
+	_SMS_PROVIDER_STATE& state = vsmsproviders[provider];
+
+	if (state.failures >= SMS_BREAK_FAILURES)
+		state.isprobing = true;
+	req->provider = provider;
+	req->url = state.url;
+	req->sms->tried |= 1u << provider;
+	req->sms->hedgetick = now + smshedgemsec(state);
+}
+
+// the provider of the next attempt, past the untried ones it starts over. with every circuit open the
+// one that opens first still gets it, an otp is not dropped for the breakers
+static void smsassign(_HTTP_REQUEST* req, uint64_t now)
+{
+	int provider = smspick(req->sms->tried, now);
+
+	if (provider < 0)
+		provider = smspick(0, now);
+	if (provider < 0) {
+		provider = 0;
+		for (int n = 1; n < (int)vsmsproviders.size(); n++) {
+			if (vsmsproviders[n].openuntil < vsmsproviders[provider].openuntil)
+				provider = n;
+		}
+	}
+	smsuse(req, provider, now);
+}
+
+static void smsrecord(int provider, bool issent, uint64_t msec)
+{
+	_SMS_PROVIDER_STATE& state = vsmsproviders[provider];
+
+	state.isprobing = false;
+
+	if (issent) {
+		if (state.failures >= SMS_BREAK_FAILURES)
+			MSGLOG(INFO, "httpworker, sms provider %s sends again, its circuit is closed.", state.name.c_str());
+		state.failures = 0;
+		state.sent++;
+		state.vmsec.push_back((uint32_t)msec);
+		if (state.vmsec.size() > SMS_LATENCY_SAMPLES)
+			state.vmsec.pop_front();
+		return;
+	}
+
+	state.failed++;
+	if (++state.failures >= SMS_BREAK_FAILURES) {
+		state.openuntil = clockmsec() + SMS_BREAK_MSEC;
+		MSGLOG(INFO, "httpworker, sms provider %s failed %d times in a row, its circuit is open for %d s.", state.name.c_str(),
+			state.failures, SMS_BREAK_MSEC / 1000);
+	}
+}
+
+static void httpfree(_HTTP_REQUEST* req)
+{
+	if (req->sms != NULL && --req->sms->live == 0)
+		delete req->sms;
+	delete req;
+}
+
+static void httpstart(CURLM* multi, _HTTP_REQUEST* req, std::vector<CURL*>& vhandles)
+{
+	if (vhandles.empty()) {
+		req->hnd = curl_easy_init();
+	}
+	else {
+		req->hnd = vhandles.back();
+		vhandles.pop_back();
+		curl_easy_reset(req->hnd);
+	}
+
+	curl_easy_setopt(req->hnd, CURLOPT_URL, req->url.c_str());
+	curl_easy_setopt(req->hnd, CURLOPT_POSTFIELDS, req->fields.c_str());
+	curl_easy_setopt(req->hnd, CURLOPT_TIMEOUT_MS, (long)HTTP_TIMEOUT_MSEC);
+	curl_easy_setopt(req->hnd, CURLOPT_CONNECTTIMEOUT_MS, (long)HTTP_CONNECT_TIMEOUT_MSEC);
+	curl_easy_setopt(req->hnd, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(req->hnd, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(req->hnd, CURLOPT_PRIVATE, req);
+	curl_multi_add_handle(multi, req->hnd);
+	req->attempt++;
+}
+
+// true when a failed request is worth another attempt, after a transport error or a server side status
+static bool httpfinish(CURLM* multi, _HTTP_REQUEST* req, CURLcode ret, std::vector<CURL*>& vhandles)
+{
+	long status = 0;
+	curl_off_t usec = 0;
+	curl_easy_getinfo(req->hnd, CURLINFO_RESPONSE_CODE, &status);
+	curl_easy_getinfo(req->hnd, CURLINFO_TOTAL_TIME_T, &usec);
+	curl_multi_remove_handle(multi, req->hnd);
+	vhandles.push_back(req->hnd);
+	req->hnd = NULL;
+
+	if (ret == CURLE_OK && status < 400) {
+		uint64_t msec = (uint64_t)usec / 1000;
+		httpstats.sent++;
+		httpstats.totalmsec += msec;
+		if (msec > httpstats.maxmsec)
+			httpstats.maxmsec = msec;
+		MSGLOG(DEBUG, "httpworker, %s sent in %llu ms.", req->tag.c_str(), (unsigned long long)msec);
+		req->issent = true;
+		if (req->sms != NULL)
+			smsrecord(req->provider, true, msec);
+		return false;
+	}
+
+	MSGLOG(DEBUG, "httpworker, %s attempt %d failed with curl code %d http %ld.", req->tag.c_str(), req->attempt, ret, status);
+	if (req->sms != NULL)
+		smsrecord(req->provider, false, 0);
+	return ret != CURLE_OK || status >= 500 || status == 429;
+}
+
+static void httpdone(std::function<void(bool)>& done, int loop, bool issent)
+{
+	if (!done)
+		return;
+	if (loop >= 0)
+		le_postloop(loop, [done = std::move(done), issent]() { done(issent); });
+	else
+		done(issent);
+}
+
+// the otp of winner is sent, its other requests are dropped. a probe among them did not tell anything
+static void smscancel(CURLM* multi, _HTTP_REQUEST* winner, std::vector<_HTTP_REQUEST*>& vinflight, std::deque<_HTTP_REQUEST*>& vpending,
+	std::vector<CURL*>& vhandles)
+{
+	for (size_t n = 0; n < vinflight.size();) {
+		_HTTP_REQUEST* req = vinflight[n];
+		if (req == winner || req->sms != winner->sms) {
+			n++;
+			continue;
+		}
+		curl_multi_remove_handle(multi, req->hnd);
+		vhandles.push_back(req->hnd);
+		vinflight.erase(vinflight.begin() + n);
+		vsmsproviders[req->provider].isprobing = false;
+		httpstats.cancelled++;
+		httpfree(req);
+	}
+
+	for (size_t n = 0; n < vpending.size();) {
+		_HTTP_REQUEST* req = vpending[n];
+		if (req == winner || req->sms != winner->sms) {
+			n++;
+			continue;
+		}
+		vpending.erase(vpending.begin() + n);
+		if (req->provider >= 0)
+			vsmsproviders[req->provider].isprobing = false;
+		httpstats.cancelled++;
+		httpfree(req);
+	}
+}
+
+// the first request of an otp that is sent wins. a failed one with another of its otp still out leaves
+// it to that one, else the otp moves to a provider it was not tried on at once or, once it was tried on
+// every one, after the backoff
+static void smsfinish(CURLM* multi, _HTTP_REQUEST* req, bool isretry, std::vector<_HTTP_REQUEST*>& vinflight,
+	std::deque<_HTTP_REQUEST*>& vpending, std::vector<CURL*>& vhandles)
+{
+	_SMS_SEND* sms = req->sms;
+	uint64_t now = clockmsec();
+
+	if (req->issent) {
+		smscancel(multi, req, vinflight, vpending, vhandles);
+		httpdone(sms->done, sms->loop, true);
+		httpfree(req);
+		httpstats.queued--;
+		return;
+	}
+
+	if (sms->live > 1) {
+		httpfree(req);
+		return;
+	}
+
+	sms->failures++;
+	bool isuntried = smspick(sms->tried, now) >= 0;
+	if (sms->failures < std::max(HTTP_MAX_ATTEMPTS, (int)vsmsproviders.size()) && (isuntried || isretry)) {
+		req->provider = -1;
+		req->due = isuntried ? now : now + ((uint64_t)HTTP_BACKOFF_MSEC << std::min(sms->failures - 1, 5));
+		vpending.push_back(req);
+		httpstats.retried++;
+		return;
+	}
+
+	httpstats.failed++;
+	httpdone(sms->done, sms->loop, false);
+	httpfree(req);
+	httpstats.queued--;
+}
+
+// an otp whose provider has not answered by its p95 goes to the next fastest one as well, once
+static void smshedge(std::vector<_HTTP_REQUEST*>& vinflight, std::deque<_HTTP_REQUEST*>& vpending, uint64_t now)
+{
+	for (size_t n = 0; n < vinflight.size(); n++) {
+		_SMS_SEND* sms = vinflight[n]->sms;
+		if (sms == NULL || sms->ishedged || sms->live > 1 || now < sms->hedgetick)
+			continue;
+
+		sms->ishedged = true;
+		int provider = smspick(sms->tried, now);
+		if (provider < 0)
+			continue;
+
+		_HTTP_REQUEST* hedge = httprequest("", vinflight[n]->fields, vinflight[n]->tag);
+		hedge->sms = sms;
+		smsuse(hedge, provider, now);
+		sms->live++;
+		vpending.push_front(hedge);
+		httpstats.hedged++;
+		MSGLOG(DEBUG, "httpworker, %s hedged to sms provider %s, %s is slow.", hedge->tag.c_str(), vsmsproviders[provider].name.c_str(),
+			vsmsproviders[vinflight[n]->provider].name.c_str());
+	}
+}
+
+static void httplogstats(uint64_t& lastsent, uint64_t& lastfailed)
+{
+	uint64_t sent = httpstats.sent;
+	uint64_t failed = httpstats.failed;
+
+	if (sent == lastsent && failed == lastfailed)
+		return;
+
+	MSGLOG(INFO, "httpworker, %llu sent %llu failed %llu retried %llu hedged, latency avg %llu ms max %llu ms.",
+		(unsigned long long)sent, (unsigned long long)failed, (unsigned long long)httpstats.retried.load(),
+		(unsigned long long)httpstats.hedged.load(), (unsigned long long)((sent > 0) ? httpstats.totalmsec / sent : 0),
+		(unsigned long long)httpstats.maxmsec.load());
+	for (size_t n = 0; n < vsmsproviders.size() && vsmsproviders.size() > 1; n++) {
+		const _SMS_PROVIDER_STATE& provider = vsmsproviders[n];
+		MSGLOG(INFO, "httpworker, sms provider %s %llu sent %llu failed, p50 %u ms p95 %u ms%s.", provider.name.c_str(),
+			(unsigned long long)provider.sent, (unsigned long long)provider.failed, smspercentile(provider, 50),
+			smspercentile(provider, 95), (provider.failures >= SMS_BREAK_FAILURES) ? ", circuit open" : "");
+	}
+	lastsent = sent;
+	lastfailed = failed;
+}
 
 void smsworker()
 {
-	std::vector<_SMS_INFO>vbuffer;
-	std::vector<_SMS_INFO>::iterator iter;
-	char sbuf[100] = { 0 };
+	std::vector<_HTTP_REQUEST*> vbuffer;
+	std::deque<_HTTP_REQUEST*> vpending;	// waiting for a free transfer or for their retry time
+	std::vector<_HTTP_REQUEST*> vinflight;
+	std::vector<CURL*> vhandles;	// idle easy handles
+	uint64_t nextstats = clockmsec() + HTTP_STATS_MSEC;
+	uint64_t lastsent = 0;
+	uint64_t lastfailed = 0;
+
+	CURLM* multi = curl_multi_init();
+	curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)HTTP_MAX_HOST_CONNECTIONS);
+	curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)HTTP_MAX_CONNECTIONS);
+	smsproviders();
 
-	CURL* hnd = curl_easy_init();
+	httplock.lock();
+	httpmulti = multi;
+	httplock.unlock();
 
-	while (true) {
+	while (!endworker) {
 
-		lock.lock();
-		vsmsinfo.swap(vbuffer);
-		lock.unlock();
+		httplock.lock();
+		vhttprequests.swap(vbuffer);
+		httplock.unlock();
 
-		for (iter = vbuffer.begin(); iter != vbuffer.end(); iter++) {
-			_SMS_INFO smsinfo = *iter;
-			curl_easy_setopt(hnd, CURLOPT_URL, "http://muengine.org/smsapi.php");
-			sprintf(sbuf, "smsnumber=%s&otpmsg=%s", smsinfo.mobilenumber.c_str(), smsinfo.otpmsg.c_str());
-			curl_easy_setopt(hnd, CURLOPT_POSTFIELDS, sbuf);
-			CURLcode ret = curl_easy_perform(hnd);
-			if (ret != CURLE_OK) {
-				msglog(DEBUG, "smsworker, curl_easy_perform error code %d, mobile number %s.", ret, smsinfo.mobilenumber.c_str());
+		vpending.insert(vpending.end(), vbuffer.begin(), vbuffer.end());
+		vbuffer.clear();
+
+		uint64_t now = clockmsec();
+
+		for (size_t n = 0; n < vpending.size() && vinflight.size() < HTTP_MAX_INFLIGHT;) {
+			if (vpending[n]->due > now) {
+				n++;
 				continue;
 			}
-			msglog(DEBUG, "smsworker, sent otp code to mobile number %s.", smsinfo.mobilenumber.c_str());
+			if (vpending[n]->sms != NULL && vpending[n]->provider < 0)
+				smsassign(vpending[n], now);
+			httpstart(multi, vpending[n], vhandles);
+			vinflight.push_back(vpending[n]);
+			vpending.erase(vpending.begin() + n);
 		}
 
-		vbuffer.clear();
-		if (endworker)
-			break;
-		sleep(100);
+		int running = 0;
+		curl_multi_perform(multi, &running);
+
+		CURLMsg* msg;
+		int left = 0;
+		while ((msg = curl_multi_info_read(multi, &left)) != NULL) {
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			_HTTP_REQUEST* req = NULL;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&req);
+			vinflight.erase(std::find(vinflight.begin(), vinflight.end(), req));
+			bool isretry = httpfinish(multi, req, msg->data.result, vhandles);
+			if (req->sms != NULL) {
+				smsfinish(multi, req, isretry, vinflight, vpending, vhandles);
+			}
+			else if (isretry && req->attempt < HTTP_MAX_ATTEMPTS) {
+				req->due = clockmsec() + ((uint64_t)HTTP_BACKOFF_MSEC << (req->attempt - 1));
+				vpending.push_back(req);
+				httpstats.retried++;
+			}
+			else {
+				if (!req->issent)
+					httpstats.failed++;
+				httpdone(req->done, req->loop, req->issent);
+				delete req;
+				httpstats.queued--;
+			}
+		}
+
+		now = clockmsec();
+		smshedge(vinflight, vpending, now);
+		if (now >= nextstats) {
+			httplogstats(lastsent, lastfailed);
+			nextstats = now + HTTP_STATS_MSEC;
+		}
+
+		// sleeps until a transfer moves, a retry or hedge is due or httppost wakes it
+		int timeout = HTTP_POLL_MSEC;
+		for (size_t n = 0; n < vinflight.size(); n++) {
+			_SMS_SEND* sms = vinflight[n]->sms;
+			if (sms == NULL || sms->ishedged || sms->live > 1)
+				continue;
+			int wait = (sms->hedgetick > now) ? (int)(sms->hedgetick - now) : 0;
+			if (wait < timeout)
+				timeout = wait;
+		}
+		if (vinflight.size() < HTTP_MAX_INFLIGHT) {
+			for (size_t n = 0; n < vpending.size(); n++) {
+				int wait = (vpending[n]->due > now) ? (int)(vpending[n]->due - now) : 0;
+				if (wait < timeout)
+					timeout = wait;
+			}
+		}
+		curl_multi_poll(multi, NULL, 0, timeout, NULL);
+	}
+
+	httplock.lock();
+	httpmulti = NULL;
+	vpending.insert(vpending.end(), vhttprequests.begin(), vhttprequests.end());
+	vhttprequests.clear();
+	httplock.unlock();
+
+	httplogstats(lastsent, lastfailed);
+	if (!vinflight.empty() || !vpending.empty())
+		MSGLOG(INFO, "httpworker, %d requests dropped at shutdown.", (int)(vinflight.size() + vpending.size()));
+
+	for (size_t n = 0; n < vinflight.size(); n++) {
+		curl_multi_remove_handle(multi, vinflight[n]->hnd);
+		curl_easy_cleanup(vinflight[n]->hnd);
+		httpfree(vinflight[n]);
 	}
+	for (size_t n = 0; n < vpending.size(); n++)
+		httpfree(vpending[n]);
+	httpstats.queued = 0;
+	for (size_t n = 0; n < vhandles.size(); n++)
+		curl_easy_cleanup(vhandles[n]);
 
-	curl_easy_cleanup(hnd);
+	curl_multi_cleanup(multi);
 	curl_global_cleanup();
 }
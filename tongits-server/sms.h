@@ -1,6 +1,38 @@
 #pragma once
-#include <vector>
-#include <mutex>
+#include <string>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+// the one outbound http path, a worker running a curl multi handle posts otp messages and any other
+// request queued with httppost. each host keeps a few keep-alive connections, requests past that wait
+// in curl's queue and a failed one is tried again after a backoff. a done given to httppost runs on the
+// loop that posted once the request is sent or out of attempts, with whether it was sent
+//
+// an otp goes through smspost to one of the "SMS Providers", the one with the lowest p50 of its last
+// SMS_LATENCY_SAMPLES sends. when it has not answered by its own p95 the otp is sent to the next fastest
+// one as well and the first to send it wins, the other transfer is dropped, so only the slowest twenty
+// or so in a thousand reach two gateways. a failed one moves to a provider it was not tried on at once.
+// SMS_BREAK_FAILURES in a row open the circuit of a provider, it gets nothing for SMS_BREAK_MSEC and
+// then one otp as a probe, which closes it again when it is sent
+
+#define SMS_URL "http://muengine.org/smsapi.php"
+#define HTTP_MAX_HOST_CONNECTIONS 4	// keep-alive connections per upstream host
+#define HTTP_MAX_CONNECTIONS 16	// connection cache of the worker
+#define HTTP_MAX_INFLIGHT 32
+#define HTTP_TIMEOUT_MSEC 10000
+#define HTTP_CONNECT_TIMEOUT_MSEC 3000
+#define HTTP_MAX_ATTEMPTS 3
+#define HTTP_BACKOFF_MSEC 1000	// doubled on every retry
+#define HTTP_POLL_MSEC 1000	// longest sleep, endworker is seen within this
+#define HTTP_STATS_MSEC 60000
+#define SMS_MAX_PROVIDERS 8
+#define SMS_LATENCY_SAMPLES 64	// sends of a provider its p50 and p95 are taken over
+#define SMS_HEDGE_MIN_SAMPLES 8	// below this a provider is hedged after SMS_HEDGE_MAX_MSEC
+#define SMS_HEDGE_MIN_MSEC 300
+#define SMS_HEDGE_MAX_MSEC 3000
+#define SMS_BREAK_FAILURES 3
+#define SMS_BREAK_MSEC 30000
 
 struct _SMS_INFO
 {
@@ -8,8 +40,22 @@ struct _SMS_INFO
 	std::string otpmsg;
 };
 
+struct _HTTP_STATS
+{
+	std::atomic<uint64_t> sent;
+	std::atomic<uint64_t> failed;	// out of attempts or not worth another one
+	std::atomic<uint64_t> retried;
+	std::atomic<uint64_t> hedged;	// otps sent to a second provider while the first was slow
+	std::atomic<uint64_t> cancelled;	// transfers dropped once another of their otp was sent
+	std::atomic<uint64_t> totalmsec;	// latency of the sent ones
+	std::atomic<uint64_t> maxmsec;
+	std::atomic<int64_t> queued;	// posted and not finished yet
+};
+
 void smsworker();
-extern std::mutex lock;
-extern std::vector<_SMS_INFO>vsmsinfo;
+void addsms(const _SMS_INFO& info);
+void httppost(const std::string& url, const std::string& fields, const std::string& tag, std::function<void(bool)> done = nullptr);
+void smspost(const _SMS_INFO& info, const std::string& tag, std::function<void(bool)> done = nullptr);
+std::string smsfields(const _SMS_INFO& info);	// the post body of every provider
+const _HTTP_STATS& gethttpstats();
 extern bool endworker;
-
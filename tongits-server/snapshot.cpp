@@ -0,0 +1,320 @@
+#include "snapshot.h"
+#include "common.h"
+#include "taskpool.h"
+#include "standby.h"
+#include <mutex>
+#include <map>
+#include <memory>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static std::mutex snapshotlock;
+static std::map<int64_t, _SNAPSHOT_GAME> msnapshotgames;	// latest capture of every live table by serial
+static bool issnapshotdirty = false;
+static bool issnapshoturgent = false;
+static bool issnapshotwriting = false;	// a write is out on the task pool
+static uint64_t snapshotduetick = 0;
+
+static void snapshotkick();
+
+void snapshotput(const _SNAPSHOT_GAME& s, bool isurgent)
+{
+	snapshotlock.lock();
+	msnapshotgames[s.serial] = s;
+	issnapshotdirty = true;
+	issnapshoturgent |= isurgent;
+	snapshotlock.unlock();
+
+	standbyput(s);
+
+	if (isurgent)
+		snapshotkick();
+}
+
+void snapshotdrop(int64_t serial)
+{
+	bool isdropped = false;
+
+	standbydrop(serial);
+
+	snapshotlock.lock();
+	if (msnapshotgames.erase(serial) != 0) {
+		issnapshotdirty = true;
+		issnapshoturgent = true;
+		isdropped = true;
+	}
+	snapshotlock.unlock();
+
+	if (isdropped)
+		snapshotkick();
+}
+
+static uint32_t snapshotchecksum(const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	uint32_t hash = 2166136261u;
+
+	for (size_t n = 0; n < size; n++) {
+		hash ^= p[n];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+template <size_t N>
+static void snapshotcopy(char* dst, size_t size, const _INLINE_STR<N>& src)
+{
+	size_t len = (src.length() < size) ? src.length() : size - 1;
+	memcpy(dst, src.c_str(), len);
+	dst[len] = 0;
+}
+
+void snapshotsaveuser(_SNAPSHOT_USER& s, uintptr_t userindex, const _USER_INFO* info)
+{
+	memset(&s, 0, sizeof(_SNAPSHOT_USER));
+	s.userindex = userindex;
+	s.token = info->token;
+	snapshotcopy(s.account, sizeof(s.account), info->account);
+	snapshotcopy(s.name, sizeof(s.name), info->name);
+	snapshotcopy(s.mobilenum, sizeof(s.mobilenum), info->mobilenum);
+	s.gametoken = info->gametoken;
+	s.ecoins[0] = info->ecoins[0];
+	s.ecoins[1] = info->ecoins[1];
+	s.gamedropctr = info->m_gamedropctr;
+	s.cardcount = info->m_cardcount;
+	s.cardquantity = info->m_cardquantity;
+	s.royalcount = info->m_royalcount;
+	s.quadracount = info->m_quadracount;
+	s.acecount = info->m_acecount;
+	s.lastactiontick = info->lastactiontick;
+	s.activetick = info->activetick;
+	s.gps = info->gps;
+	s.ectype = info->ectype;
+	s.isnogps = info->isnogps;
+	s.isuseradmin = info->isuseradmin;
+	s.isdowncard = info->m_isdowncard;
+	s.fought = info->fought;
+	s.canfight = info->canfight;
+	s.isauto = info->isauto;
+	s.isselfblock = info->isselfblock;
+	s.isbot = info->isbot;
+}
+
+// the seat comes back as a disconnected player, the next login with its token resumes it
+void snapshotloaduser(const _SNAPSHOT_USER& s, _USER_INFO* info, int64_t shift)
+{
+	info->set();
+	info->init();
+	info->isfreeuser = false;
+	info->token = s.token;
+	info->account = s.account;
+	info->name = s.name;
+	info->mobilenum = s.mobilenum;
+	info->gametoken = s.gametoken;
+	info->ecoins[0] = s.ecoins[0];
+	info->ecoins[1] = s.ecoins[1];
+	info->m_gamedropctr = s.gamedropctr;
+	info->m_cardcount = s.cardcount;
+	info->m_cardquantity = s.cardquantity;
+	info->m_royalcount = s.royalcount;
+	info->m_quadracount = s.quadracount;
+	info->m_acecount = s.acecount;
+	info->lastactiontick = (s.lastactiontick != 0) ? s.lastactiontick + shift : 0;
+	info->activetick = (s.activetick != 0) ? s.activetick + shift : 0;
+	info->gps = s.gps;
+	if (info->gps.tick != 0)
+		info->gps.tick += shift;
+	info->setgametype(s.ectype);
+	info->isnogps = s.isnogps;
+	info->isuseradmin = s.isuseradmin;
+	info->m_isdowncard = s.isdowncard;
+	info->fought = s.fought;
+	info->canfight = s.canfight;
+	info->isauto = s.isauto;
+	info->isselfblock = s.isselfblock;
+	info->isbot = s.isbot;
+	info->setstate((unsigned char)_USER_STATE::_LOGGEDIN | (unsigned char)_USER_STATE::_DISCONNECTED);
+	info->disconnectedtick = clockmsec();
+
+	// a bot has nobody to come back for it, it sits at the table again right away
+	if (info->isbot) {
+		info->setstate((unsigned char)_USER_STATE::_LOGGEDIN | (unsigned char)_USER_STATE::_PLAYING);
+		info->disconnectedtick = 0;
+	}
+}
+
+// written next to the old file and renamed over it, a crash while writing keeps the previous snapshot
+static bool snapshotwrite(const std::vector<_SNAPSHOT_GAME>& vgames)
+{
+	const char* tmpfile = SNAPSHOT_FILE ".tmp";
+	_SNAPSHOT_HEADER header = { 0 };
+
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.gamesize = sizeof(_SNAPSHOT_GAME);
+	header.games = (uint32_t)vgames.size();
+	header.tick = clockmsec();
+	header.time = clockwallmsec();
+	header.checksum = snapshotchecksum(vgames.data(), vgames.size() * sizeof(_SNAPSHOT_GAME));
+
+	FILE* fp = fopen(tmpfile, "wb");
+
+	if (fp == NULL) {
+		MSGLOG(ERROR, "snapshotwrite, failed to open %s.", tmpfile);
+		return false;
+	}
+
+	bool iswritten = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& (vgames.empty() || fwrite(vgames.data(), sizeof(_SNAPSHOT_GAME), vgames.size(), fp) == vgames.size());
+
+	if (fclose(fp) != 0)
+		iswritten = false;
+
+	if (!iswritten) {
+		MSGLOG(ERROR, "snapshotwrite, failed to write %s.", tmpfile);
+		return false;
+	}
+
+#ifdef _WIN32
+	if (!MoveFileExA(tmpfile, SNAPSHOT_FILE, MOVEFILE_REPLACE_EXISTING)) {
+#else
+	if (rename(tmpfile, SNAPSHOT_FILE) != 0) {
+#endif
+		MSGLOG(ERROR, "snapshotwrite, failed to replace %s.", SNAPSHOT_FILE);
+		return false;
+	}
+	return true;
+}
+
+// a settled round is written right away, a restore must never replay a round that was already paid.
+// one write is out at a time, a change while it is out goes with the next one
+static void snapshotkick()
+{
+	std::shared_ptr<std::vector<_SNAPSHOT_GAME>> vgames;
+
+	snapshotlock.lock();
+	if (!issnapshotwriting && issnapshotdirty && (issnapshoturgent || clockmsec() >= snapshotduetick)) {
+		vgames = std::make_shared<std::vector<_SNAPSHOT_GAME>>();
+		vgames->reserve(msnapshotgames.size());
+		for (auto iter = msnapshotgames.begin(); iter != msnapshotgames.end(); iter++)
+			vgames->push_back(iter->second);
+		issnapshotdirty = false;
+		issnapshoturgent = false;
+		issnapshotwriting = true;
+	}
+	snapshotlock.unlock();
+
+	if (vgames == nullptr)
+		return;
+
+	tasksubmit(_TASK_LANE::_NORMAL, [vgames]() { snapshotwrite(*vgames); }, []() {
+		snapshotlock.lock();
+		issnapshotwriting = false;
+		snapshotduetick = clockmsec() + SNAPSHOT_MSEC;
+		snapshotlock.unlock();
+		snapshotkick();
+	});
+}
+
+void snapshotrun()
+{
+	snapshotkick();
+}
+
+void snapshotflush()
+{
+	std::vector<_SNAPSHOT_GAME> vgames;
+
+	snapshotlock.lock();
+	bool iswrite = issnapshotdirty;
+	for (auto iter = msnapshotgames.begin(); iswrite && iter != msnapshotgames.end(); iter++)
+		vgames.push_back(iter->second);
+	issnapshotdirty = false;
+	snapshotlock.unlock();
+
+	if (iswrite && snapshotwrite(vgames))
+		MSGLOG(INFO, "Snapshot of %d tables written to %s.", (int)vgames.size(), SNAPSHOT_FILE);
+}
+
+bool snapshotopen(_SNAPSHOT_VIEW& view)
+{
+	memset(&view, 0, sizeof(view));
+
+#ifdef _WIN32
+	view.file = CreateFileA(SNAPSHOT_FILE, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (view.file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(view.file, &size) || size.QuadPart < (LONGLONG)sizeof(_SNAPSHOT_HEADER)) {
+		CloseHandle(view.file);
+		return false;
+	}
+	view.size = (size_t)size.QuadPart;
+	view.mapping = CreateFileMappingA(view.file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (view.mapping != NULL)
+		view.base = MapViewOfFile(view.mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view.base == NULL) {
+		if (view.mapping != NULL)
+			CloseHandle(view.mapping);
+		CloseHandle(view.file);
+		return false;
+	}
+#else
+	view.fd = open(SNAPSHOT_FILE, O_RDONLY);
+	if (view.fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(view.fd, &st) != 0 || st.st_size < (off_t)sizeof(_SNAPSHOT_HEADER)) {
+		close(view.fd);
+		return false;
+	}
+	view.size = (size_t)st.st_size;
+	view.base = mmap(NULL, view.size, PROT_READ, MAP_PRIVATE, view.fd, 0);
+	if (view.base == MAP_FAILED) {
+		close(view.fd);
+		return false;
+	}
+#endif
+
+	view.header = (const _SNAPSHOT_HEADER*)view.base;
+	view.games = (const _SNAPSHOT_GAME*)(view.header + 1);
+
+	const _SNAPSHOT_HEADER* header = view.header;
+	size_t records = view.size - sizeof(_SNAPSHOT_HEADER);
+
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != SNAPSHOT_VERSION
+		|| header->gamesize != sizeof(_SNAPSHOT_GAME) || records != (size_t)header->games * sizeof(_SNAPSHOT_GAME)) {
+		MSGLOG(ERROR, "%s is not a snapshot of this build, ignored.", SNAPSHOT_FILE);
+		snapshotclose(view);
+		return false;
+	}
+
+	if (snapshotchecksum(view.games, records) != header->checksum) {
+		MSGLOG(ERROR, "%s is damaged, ignored.", SNAPSHOT_FILE);
+		snapshotclose(view);
+		return false;
+	}
+
+	return true;
+}
+
+void snapshotclose(_SNAPSHOT_VIEW& view)
+{
+	if (view.base == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(view.base);
+	CloseHandle(view.mapping);
+	CloseHandle(view.file);
+#else
+	munmap(view.base, view.size);
+	close(view.fd);
+#endif
+	view.base = NULL;
+	view.header = NULL;
+	view.games = NULL;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "game.h"
+#include "user.h"
+
+// live tables written to disk every few seconds and on shutdown, a restarted server maps the file back
+// and its players reconnect into their round. records are raw structs, the writer's record size is
+// checked on load so a snapshot of another build is ignored instead of misread
+
+#define SNAPSHOT_FILE "tongits.snapshot"
+#define SNAPSHOT_MAGIC "TGSS"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_MSEC 5000	// tables are captured by their loop this often
+#define SNAPSHOT_GRACE_MSEC 30000	// a restored table sleeps this long unless one of its players comes back
+
+struct _SNAPSHOT_HEADER
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t gamesize;	// sizeof(_SNAPSHOT_GAME) of the writer
+	uint32_t games;
+	uint64_t tick;	// clockmsec of the writer, the tables stand still from here until they are loaded
+	int64_t time;
+	uint32_t checksum;	// fnv-1a of the records
+	uint32_t reserved2;
+};
+
+static_assert(sizeof(_SNAPSHOT_HEADER) == 40, "_SNAPSHOT_HEADER keeps the records 8 byte aligned");
+
+// the _USER_INFO fields of a seat that resumegamesession carries over to the new connection
+struct _SNAPSHOT_USER
+{
+	uint64_t userindex;	// handle of the writer, only used to map the game's references to the new slot
+	int64_t token;
+	char account[32];
+	char name[16];
+	char mobilenum[16];
+	int gametoken;
+	int ecoins[2];
+	int gamedropctr;
+	int cardcount;
+	int cardquantity;
+	int royalcount;
+	int quadracount;
+	int acecount;
+	uint64_t lastactiontick;
+	uint64_t activetick;
+	_GPS_INFO gps;
+	unsigned char ectype;
+	bool isnogps;
+	bool isuseradmin;
+	bool isdowncard;
+	bool fought;
+	bool canfight;
+	bool isauto;
+	bool isselfblock;
+	bool isbot;
+};
+
+struct _SNAPSHOT_GAME
+{
+	int64_t serial;
+	int state;
+	int active_pos;
+	int active_status;
+	int counter;
+	int resumemsleft;
+	int stocktop;
+	uint64_t gametick;
+	uint64_t winner;
+	uint64_t fightuserindex;
+	uint64_t hitter;
+	uint64_t active_userindex;
+	uint64_t hitprizeecoins;
+	uint32_t gpsversions[3];
+	unsigned char ectype;
+	unsigned char dropcardctr;
+	unsigned char initdrawcards[3];
+	bool resumed;
+	_CARD_RNG rng;
+	_USER_CARD_INFO cardinfo[3];
+	_CARD_PILE stock;
+	_DROP_PILE dropped;
+	_SETTLE_INFO settle;
+	_SNAPSHOT_USER users[3];
+};
+
+// a mapped snapshot, games points into the mapping until snapshotclose
+struct _SNAPSHOT_VIEW
+{
+	const _SNAPSHOT_HEADER* header;
+	const _SNAPSHOT_GAME* games;
+	size_t size;
+	void* base;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+void snapshotput(const _SNAPSHOT_GAME& s, bool isurgent = false);
+void snapshotdrop(int64_t serial);
+void snapshotrun();	// on every loop 0 tick, writes the captures every SNAPSHOT_MSEC
+void snapshotflush();	// at shutdown once the task pool is stopped
+
+void snapshotsaveuser(_SNAPSHOT_USER& s, uintptr_t userindex, const _USER_INFO* info);
+void snapshotloaduser(const _SNAPSHOT_USER& s, _USER_INFO* info, int64_t shift);
+
+bool snapshotopen(_SNAPSHOT_VIEW& view);
+void snapshotclose(_SNAPSHOT_VIEW& view);
@@ -6,14 +6,114 @@
 #include "gamectrl.h"
 #include "conf.h"
 #include "sms.h"
+#include "settle.h"
+#include "snapshot.h"
+#include "../Common/evmem.h"
+#include "../Common/loopwatch.h"
+#include "../Common/memtag.h"
+#include "../Common/sampler.h"
+#include "eventlog.h"
+#include "dbpool.h"
+#include "ratelimit.h"
+#include "logintoken.h"
+#include "wire.h"
+#include "stats.h"
+#include "metrics.h"
+#include "websock.h"
+#include "trace.h"
+#include "cluster.h"
+#include "sessiondir.h"
+#include "migrate.h"
+#include "standby.h"
+#include "seal.h"
+#include "fastlane.h"
+#include "taskpool.h"
+#include "alive.h"
+#include "bot.h"
+#include "admit.h"
+#include "replay.h"
+#include "leaderboard.h"
+#include "cpupin.h"
+#include "suspend.h"
+#include "latency.h"
+#include <event2/keyvalq_struct.h>
 #include <mutex>
 #include <thread>
+#include <atomic>
+#include <algorithm>
 
 
 std::mutex mlock;
 
+#define SHED_PROBE_MSEC 100	// each loop measures how late this timer fires
+#define SHED_RECOVER_PROBES 10	// probes below half of Shed Loop Lag before the game ports accept again
+#define LOOP_PRIORITIES 3	// an event gets the middle one, the lobby event the last
+#define LOBBY_QUEUE_MAX 1024	// connections waiting on a loop, the next one is told the server is busy
+#define LOBBY_WAIT_MSEC 3000	// a connection that waited longer is told the same
+
 static struct event_base* base;
 
+// each loop thread owns its bufferevents and games, other threads hand it work through this queue
+struct _LoopCommand
+{
+	std::function<void()> fn;
+	std::atomic<_LoopCommand*> next;
+};
+
+struct _LobbyWait
+{
+	uintptr_t userindex;
+	uint64_t tick;	// clockmsec it was queued
+};
+
+struct _LoopWorker
+{
+	int index;
+	struct event_base* base;
+	struct event* cmdev;
+	struct event* timer;
+	std::atomic<_LoopCommand*> cmdhead;	// producers push here
+	_LoopCommand* cmdtail;	// only the loop pops, starts at a stub node
+	std::thread::id threadid;
+	std::thread thread;
+	std::atomic<int> games;
+	struct event* probe;
+	std::atomic<uint64_t> probetick;	// msec it last fired
+	std::atomic<uint64_t> lagmsec;	// how late it was
+	_LoopWatch* watch;	// lag histogram and stall reports
+	struct event* lobbyev;
+	std::deque<_LobbyWait> lobbyqueue;	// only the loop
+	std::atomic<uint64_t> lobbyqueued;
+	std::atomic<uint64_t> lobbybusy;
+	struct event* tableev;	// a timer of 0, so the loop polls its connections between two passes
+	std::deque<game*> tablequeue;	// due tables, only the loop
+	std::atomic<uint64_t> tablepasses;
+	std::atomic<uint64_t> tablecuts;	// passes that left tables for the next one
+	int cpu;	// pinned to, -1 for none
+};
+
+// a game port, loop 0 accepts on it and a connection is given back on whichever loop it ends
+struct _Listener
+{
+	struct evconnlistener* listener;
+	unsigned char websocket;	// WS_ state its clients start in
+	std::atomic<int> conns;	// counted against Max Connections
+	std::atomic<uint64_t> rejectedfull;
+	std::atomic<uint64_t> rejectedrate;
+};
+
+static _Listener listeners[2];	// Server Port, WebSocket Port
+static bool isshedding = false;	// loop 0 only
+static uint64_t startusec = 0;	// statsusec when le_start began, for the startup log
+static int shedcalm = 0;	// probes in a row below half the lag while shedding
+static uint64_t shedtotal = 0;
+static std::atomic<uint64_t> outputcoalesced(0);	// turn refreshes a newer one replaced before they left
+static std::atomic<uint64_t> outputoverflows(0);	// connections closed over Max Output
+
+// loop 0 accepts and runs the lobby, the rest only run games
+static std::vector<_LoopWorker*> vLoops;
+static thread_local int currentloop = -1;
+
 
 static void signal_handler(int signal);
 
@@ -21,15 +121,87 @@ static void le_listener_cb(struct evconnlistener*, evutil_socket_t,
 	struct sockaddr*, int socklen, void*);
 
 static void le_readcb(struct bufferevent*, void*);
+static void le_parse(uintptr_t fd, _USER_INFO* userinfo, struct evbuffer* input);
+static void le_lobbycb(evutil_socket_t, short, void*);
+static void le_tablecb(evutil_socket_t, short, void*);
+static bool le_wsread(uintptr_t fd, _USER_INFO* userinfo, struct bufferevent* bev);
+static bool le_sealread(uintptr_t fd, _USER_INFO* userinfo, struct bufferevent* bev);
 static void le_eventcb(struct bufferevent*, short, void*);
+static void le_dropuser(uintptr_t fd);
 static void le_timercb(evutil_socket_t, short, void*);
+static struct evhttp* le_startstats(struct event_base* base);
+static void le_cmdcb(evutil_socket_t, short, void*);
+static _LoopWorker* le_newloop(int index);
+static void le_setbase(_LoopWorker* loop, struct event_base* base);
+static void le_freeloop(_LoopWorker* loop);
+static void le_loopworker(_LoopWorker* loop);
+static void le_writecb(struct bufferevent*, void*);
+static bool le_admit(_USER_INFO* userinfo, intptr_t userindex, const unsigned char* data, int len);
+static bool le_send(_USER_INFO* userinfo, intptr_t userindex, unsigned char* data, int len);
+static bool le_write(_USER_INFO* userinfo, intptr_t userindex, unsigned char* data, int len);
+static void le_setsockopts(evutil_socket_t fd, const _SOCKET_OPTS& opts);
+static void le_setlistenopts(struct evconnlistener* listener, const _SOCKET_OPTS& opts);
+static void le_probecb(evutil_socket_t, short, void*);
+static void le_shedcheck();
+static void le_stallreport(const char* text);
+static void le_memdumpcb(evutil_socket_t, short, void*);
+static void le_profilereport(const char* text);
+static void le_pincpus(int loops);
+static bool le_bindports();
+
+// the game ports, false when the Server Port can not be bound
+static bool le_bindports()
+{
+	struct sockaddr_in sin;
+	int serverport = c.getserverport();
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(serverport);
+
+	struct evconnlistener* listener = evconnlistener_new_bind(base, le_listener_cb, (void*)&listeners[0],
+		LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, c.getlistenbacklog(),
+		(struct sockaddr*)&sin,
+		sizeof(sin));
+
+	if (!listener) {
+		MSGLOG(eMSGTYPE::ERROR, "evconnlistener_new_bind failed at port %d, %s (%d).", serverport, __func__, __LINE__);
+		return false;
+	}
+
+	le_setlistenopts(listener, c.getsockopts(false));
+	listeners[0].listener = listener;
+	listeners[0].websocket = WS_NONE;
+
+	MSGLOG(eMSGTYPE::INFO, "Server is listening to port %d, %llu ms after start.", serverport, (unsigned long long)(statsusec() - startusec) / 1000);
+
+	int wsport = c.getwebsocketport();
+
+	if (wsport != 0) {
+		sin.sin_port = htons(wsport);
+		struct evconnlistener* wslistener = evconnlistener_new_bind(base, le_listener_cb, (void*)&listeners[1],
+			LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, c.getlistenbacklog(),
+			(struct sockaddr*)&sin,
+			sizeof(sin));
+		if (!wslistener)
+			MSGLOG(eMSGTYPE::ERROR, "evconnlistener_new_bind failed at websocket port %d, %s (%d).", wsport, __func__, __LINE__);
+		else {
+			le_setlistenopts(wslistener, c.getsockopts(true));
+			listeners[1].listener = wslistener;
+			listeners[1].websocket = WS_HANDSHAKE;
+			MSGLOG(eMSGTYPE::INFO, "Web clients are served at websocket port %d.", wsport);
+		}
+	}
+
+	fastlanestart(base);
+	return true;
+}
 
 int le_start()
 {
-	struct sockaddr_in sin;
 	struct timeval tv;
-	struct event* timeout;
-	struct evconnlistener* listener;
+
+	startusec = statsusec();
 
 	std::signal(SIGINT, signal_handler);
 
@@ -50,10 +222,13 @@ int le_start()
 	base = event_base_new_with_config(pConfig);
 	event_config_free(pConfig);
 #else
+	evthread_use_pthreads();
 	base = event_base_new();
 #endif
+	event_base_priority_init(base, LOOP_PRIORITIES);
+
 
-	msglog(eMSGTYPE::INFO, "Tongits Server %d.%d.%d.%s, socket backend is %s.",
+	MSGLOG(eMSGTYPE::INFO, "Tongits Server %d.%d.%d.%s, socket backend is %s.",
 		TUNNEL_PROXY_VER_MAJOR,
 		TUNNEL_PROXY_VER_MINOR,
 		TUNNEL_PROXY_VER_REV,
@@ -64,74 +239,871 @@ int le_start()
 		LOGTYPEENABLED |= eMSGTYPE::DEBUG;
 	}
 
-	int serverport = c.getserverport();
-
-	memset(&sin, 0, sizeof(sin));
-	sin.sin_family = AF_INET;
-	sin.sin_port = htons(serverport);
-
-	listener = evconnlistener_new_bind(base, le_listener_cb, (void*)NULL,
-		LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, -1,
-		(struct sockaddr*)&sin,
-		sizeof(sin));
+	// the port is taken before anything else is set up, clients queue in the backlog meanwhile and a
+	// restart on deploy is reachable again within a few ms. a standby takes it once its primary is gone
+	bool isstandby = c.getstandbyrole() == "standby";
 
-	if (!listener) {
-		msglog(eMSGTYPE::ERROR, "evconnlistener_new_bind failed at port %d, %s (%d).", serverport, __func__, __LINE__);
+	if (!isstandby && !le_bindports()) {
 		event_base_free(base);
 		return -1;
 	}
 
-	msglog(eMSGTYPE::INFO, "Server is listening to port %d.", serverport);
+	if (c.getacceptrate() > 0) {
+		ratesetlimit(_RATE_RULE::_ACCEPT_IP, c.getacceptburst(), 1000 / c.getacceptrate());
+		MSGLOG(eMSGTYPE::INFO, "Accept rate is %d connections per second of an address, %d at once.", c.getacceptrate(), c.getacceptburst());
+	}
+
+	int workers = c.getworkerthreads();
+#ifdef _WIN32
+	workers = 1;	// IOCP bufferevents cannot move to another base
+#endif
+	if (workers < 1)
+		workers = 1;
+
+	vLoops.push_back(le_newloop(0));
+	le_setbase(vLoops[0], base);
+	vLoops[0]->threadid = std::this_thread::get_id();
+	currentloop = 0;
+
+	for (int n = 1; n < workers; n++) {
+		_LoopWorker* loop = le_newloop(n);
+		le_setbase(loop, event_base_new());
+		vLoops.push_back(loop);
+	}
+
+	le_pincpus(workers);
+	gcontrol.setloops(workers);
+	gcontrol.setcapacity(c.getmaxgames());
+	guser.setcapacity(c.getmaxusers());
+	botsearchinit();
+	latencystart();
+
+	struct evhttp* statshttp = le_startstats(base);
+#ifndef _WIN32
+	struct event* memdumpev = evsignal_new(base, SIGUSR2, le_memdumpcb, NULL);
+	event_add(memdumpev, NULL);
+#endif
+	clusterstart(base);
+	sessionstart();
+	migratestart(base);
+	standbystart(base, le_bindports);
 
-	timeout = event_new(base, -1, EV_PERSIST, le_timercb, NULL);
 	evutil_timerclear(&tv);
 	tv.tv_usec = 1000000 / 2;
 	tv.tv_sec = 0;
-	event_add(timeout, &tv);
 
-#if GAME_TYPE == 1
-	std::thread t(smsworker);
-#endif
+	// the probes always run for the lag histograms, they only shed with Shed Loop Lag
+	for (auto loop : vLoops) {
+		char szName[32];
+		snprintf(szName, sizeof(szName), "loop %d", loop->index);
+		loop->watch = loopwatchnew(szName, SHED_PROBE_MSEC);
+
+		struct timeval probetv = { 0, SHED_PROBE_MSEC * 1000 };
+		loop->timer = event_new(loop->base, -1, EV_PERSIST, le_timercb, loop);
+		event_add(loop->timer, &tv);
+		loop->probetick = statsusec() / 1000;
+		loop->probe = event_new(loop->base, -1, EV_PERSIST, le_probecb, loop);
+		event_add(loop->probe, &probetv);
+		if (loop->index != 0)
+			loop->thread = std::thread(le_loopworker, loop);
+		else
+			loopwatchattach(loop->watch);
+	}
+
+	if (loopwatchstart(c.getstallmsec(), le_stallreport))
+		MSGLOG(eMSGTYPE::INFO, "A loop stuck in one callback for more than %d ms is reported.", c.getstallmsec());
+	if (c.getshedlagmsec() > 0)
+		MSGLOG(eMSGTYPE::INFO, "Game ports stop accepting while a loop lags more than %d ms.", c.getshedlagmsec());
+	if (c.getresumerate() > 0)
+		MSGLOG(eMSGTYPE::INFO, "Token logins resume their tables at %d a second, %d at once.", c.getresumerate(), c.getresumeburst());
+	if (c.getlobbybudget() > 0)
+		MSGLOG(eMSGTYPE::INFO, "Players at a table go first, a loop parses %d other connections after them per pass.", c.getlobbybudget());
+	if (c.gettickbudgetusec() > 0)
+		MSGLOG(eMSGTYPE::INFO, "A loop runs due tables for %d usec, then reads its connections before the rest.", c.gettickbudgetusec());
+
+	if (workers > 1)
+		MSGLOG(eMSGTYPE::INFO, "Games are sharded over %d worker loops.", workers - 1);
+
+	std::thread httpthread(smsworker);
+
+	// a trace has to start from empty tables, the replay cannot rebuild restored ones
+	bool istracing = !c.gettracefile().empty() && tracestart(c.gettracefile().c_str());
+	std::thread tracethread;
+	if (istracing) {
+		tracethread = std::thread(traceworker);
+		MSGLOG(eMSGTYPE::INFO, "Snapshot is not restored while tracing.");
+	}
+	else if (isstandby)
+		MSGLOG(eMSGTYPE::INFO, "Snapshot is not restored on a standby, the tables of its primary are.");
+	else
+		gcontrol.restoresnapshot();
+	suspendstart(!istracing && !isstandby);
+	leaderload();
+
+	logintokeninit();
+	sealinit();
+	taskstart(c.gettaskthreads(), workers);
+	dbstart();
+	std::thread settlethread(settleworker);
+	std::thread eventthread(eventworker);
+
+	std::vector<int> cpus;
+	if (cpuparse(c.gettaskcpus(), cpus) && !cpus.empty()) {
+		taskpin(cpus);
+		MSGLOG(eMSGTYPE::INFO, "Background tasks run on cpus %s.", cpuformat(cpus).c_str());
+	}
+	if (cpuparse(c.getlogcpus(), cpus) && !cpus.empty()) {
+		logpin(cpus);
+		MSGLOG(eMSGTYPE::INFO, "The logger runs on cpus %s.", cpuformat(cpus).c_str());
+	}
+
+	// last, a thread started from this one takes its cpus, the workers above keep every one
+	if (vLoops[0]->cpu >= 0 && !cpupin(std::vector<int>(1, vLoops[0]->cpu)))
+		MSGLOG(eMSGTYPE::ERROR, "Loop 0 could not be pinned to cpu %d.", vLoops[0]->cpu);
 
+	MSGLOG(eMSGTYPE::INFO, "Server is ready, %llu ms after start.", (unsigned long long)(statsusec() - startusec) / 1000);
 	event_base_dispatch(base);
+	loopwatchstop();
+	samplerstop();
+
+	// a reload still parsing is waited for, loop 0 no longer runs to publish it
+	c.stopreload();
+
+	endsettleworker = true;
+	settlethread.join();
+
+	endworker = true;
+	httpthread.join();
+
+	for (auto loop : vLoops) {
+		if (loop->index == 0)
+			continue;
+		event_base_loopbreak(loop->base);
+		loop->thread.join();
+	}
+
+	endeventworker = true;
+	eventthread.join();
 
-	if (timeout != NULL) {
-		event_del(timeout);
-		event_free(timeout);
+	if (istracing) {
+		endtraceworker = true;
+		tracethread.join();
 	}
 
-	evconnlistener_free(listener);
+	// every loop is stopped, the tables are taken as they are for the next start
+	gcontrol.snapshotgames(-1);
+	taskstop();
+	snapshotflush();
+	leaderflush();
+
+	// pending saves are written before the loops go away
+	dbstop();
+
+	if (statshttp != NULL)
+		evhttp_free(statshttp);
+#ifndef _WIN32
+	event_free(memdumpev);
+#endif
+
+	migratestop();
+	clusterstop();
+
+	standbystop();
+	fastlanestop();
 
-	event_base_free(base);
+	for (int n = 0; n < 2; n++) {
+		if (listeners[n].listener != NULL)
+			evconnlistener_free(listeners[n].listener);
+		listeners[n].listener = NULL;
+	}
 
+	// game timers live on the loop bases
 	gcontrol.clear();
 
+	for (auto loop : vLoops)
+		le_freeloop(loop);
+	vLoops.clear();
+
 #ifdef _WIN32
 	WSACleanup();
 #endif
 
-	msglog(eMSGTYPE::DEBUG, "Memory cleanup done.");
+	MSGLOG(eMSGTYPE::DEBUG, "Memory cleanup done.");
 
 	return 0;
 }
 
+// loop 0 alone on this thread, no listener and no timers, whoever owns it drives the base
+struct event_base* le_startlocal()
+{
+	base = event_base_new();
+	event_base_priority_init(base, LOOP_PRIORITIES);
+
+	vLoops.push_back(le_newloop(0));
+	le_setbase(vLoops[0], base);
+	vLoops[0]->threadid = std::this_thread::get_id();
+	currentloop = 0;
+
+	gcontrol.setloops(1);
+	gcontrol.setcapacity(c.getmaxgames());
+	guser.setcapacity(c.getmaxusers());
+	return base;
+}
+
+void le_stoplocal()
+{
+	gcontrol.clear();
+
+	for (auto loop : vLoops)
+		le_freeloop(loop);
+	vLoops.clear();
+	currentloop = -1;
+	base = NULL;
+}
+
+// GET /stats answers the request and tick counters as text, loopback only as it has no login
+static void le_statscb(struct evhttp_request* req, void*)
+{
+	if (evhttp_request_get_command(req) != EVHTTP_REQ_GET) {
+		evhttp_send_error(req, HTTP_BADMETHOD, NULL);
+		return;
+	}
+
+	std::string text = statsdump();
+	char szLine[160];
+	for (int n = 0; n < 2; n++) {
+		if (listeners[n].listener == NULL)
+			continue;
+		snprintf(szLine, sizeof(szLine), "%s port open %d full %llu rate %llu\n", (n == 0) ? "game" : "websocket",
+			(int)listeners[n].conns, (unsigned long long)listeners[n].rejectedfull, (unsigned long long)listeners[n].rejectedrate);
+		text += szLine;
+	}
+	if (c.getshedlagmsec() > 0) {
+		snprintf(szLine, sizeof(szLine), "shedding %d times %llu\n", isshedding ? 1 : 0, (unsigned long long)shedtotal);
+		text += szLine;
+	}
+	if (c.getlobbybudget() > 0) {
+		uint64_t queued = 0, busy = 0;
+		for (auto loop : vLoops) {
+			queued += loop->lobbyqueued;
+			busy += loop->lobbybusy;
+		}
+		snprintf(szLine, sizeof(szLine), "lobby queued %llu busy %llu\n", (unsigned long long)queued, (unsigned long long)busy);
+		text += szLine;
+	}
+	if (c.gettickbudgetusec() > 0) {
+		uint64_t passes = 0, cuts = 0;
+		for (auto loop : vLoops) {
+			passes += loop->tablepasses;
+			cuts += loop->tablecuts;
+		}
+		snprintf(szLine, sizeof(szLine), "table passes %llu cut %llu\n", (unsigned long long)passes, (unsigned long long)cuts);
+		text += szLine;
+	}
+	int games = 0;
+	for (auto loop : vLoops)
+		games += loop->games;
+	snprintf(szLine, sizeof(szLine), "games active %d\n", games);
+	text += szLine;
+	const _TASK_STATS& tasks = gettaskstats();
+	snprintf(szLine, sizeof(szLine), "tasks threads %d queued %lld submitted %llu stolen %llu\n", tasks.threads,
+		(long long)tasks.queued, (unsigned long long)tasks.submitted, (unsigned long long)tasks.stolen);
+	text += szLine;
+	if (c.getresumerate() > 0) {
+		const _ADMIT_STATS& admits = getadmitstats();
+		snprintf(szLine, sizeof(szLine), "resumes admitted %llu urgent %llu deferred %llu slots %llu\n", (unsigned long long)admits.admitted,
+			(unsigned long long)admits.urgent, (unsigned long long)admits.deferred, (unsigned long long)admits.slots);
+		text += szLine;
+	}
+	snprintf(szLine, sizeof(szLine), "output coalesced %llu overflows %llu\n", (unsigned long long)outputcoalesced.load(),
+		(unsigned long long)outputoverflows.load());
+	text += szLine;
+	if (fastlaneisenabled()) {
+		_FASTLANE_STATS fast;
+		fastlanestats(fast);
+		snprintf(szLine, sizeof(szLine), "fastlane frames %llu hellos %llu refused %llu\n", (unsigned long long)fast.frames,
+			(unsigned long long)fast.hellos, (unsigned long long)fast.refused);
+		text += szLine;
+	}
+	if (c.getsuspendsec() > 0) {
+		_SUSPEND_STATS suspends;
+		suspendstats(suspends);
+		snprintf(szLine, sizeof(szLine), "suspend kept %d suspended %llu resumed %llu expired %llu\n", suspends.kept,
+			(unsigned long long)suspends.suspended, (unsigned long long)suspends.resumed, (unsigned long long)suspends.expired);
+		text += szLine;
+	}
+	const _BOT_ROLLOUT_STATS& rollouts = getbotrolloutstats();
+	if (rollouts.moves > 0) {
+		snprintf(szLine, sizeof(szLine), "bots moves %llu rounds %llu rollouts %llu per core sec %llu\n", (unsigned long long)rollouts.moves,
+			(unsigned long long)rollouts.rounds, (unsigned long long)rollouts.rollouts,
+			(unsigned long long)(rollouts.rollouts * 1000000 / std::max<uint64_t>(rollouts.usec, 1)));
+		text += szLine;
+	}
+	// a loop per line, the probes that fired up to each bound in msec
+	std::vector<_LoopWatchStats> vWatches;
+	loopwatchstats(vWatches);
+	for (auto& watch : vWatches) {
+		unsigned long long cumulative = 0;
+		text += watch.name + " lag";
+		for (int n = 0; n < LOOPWATCH_BUCKETS; n++) {
+			cumulative += watch.buckets[n];
+			snprintf(szLine, sizeof(szLine), " %d:%llu", loopwatchbounds[n], cumulative);
+			text += szLine;
+		}
+		snprintf(szLine, sizeof(szLine), " inf:%llu sum %llu ms stalls %llu\n", watch.count, watch.sumusec / 1000, watch.stalls);
+		text += szLine;
+	}
+	_EvMemStats memstats;
+	evmemstats(memstats);
+	if (memstats.installed) {
+		snprintf(szLine, sizeof(szLine), "evmem allocs %llu held %lld malloc %llu refills %llu spills %llu slab %llu\n",
+			memstats.allocs, (long long)(memstats.allocs - memstats.frees), memstats.large, memstats.refills, memstats.spills, memstats.slabbytes);
+		text += szLine;
+	}
+	text += memtagreport();
+	struct evbuffer* out = evbuffer_new();
+	evbuffer_add(out, text.data(), text.size());
+	evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", "text/plain");
+	evhttp_send_reply(req, HTTP_OK, "OK", out);
+	evbuffer_free(out);
+}
+
+// GET /metrics, the gauges of metrics in prometheus text
+static void le_metricscb(struct evhttp_request* req, void*)
+{
+	if (evhttp_request_get_command(req) != EVHTTP_REQ_GET) {
+		evhttp_send_error(req, HTTP_BADMETHOD, NULL);
+		return;
+	}
+
+	std::string text = metricsdump() + latencydump();
+	struct evbuffer* out = evbuffer_new();
+	evbuffer_add(out, text.data(), text.size());
+	evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", "text/plain; version=0.0.4");
+	evhttp_send_reply(req, HTTP_OK, "OK", out);
+	evbuffer_free(out);
+}
+
+// GET /profile?seconds=N, the stacks of every thread for N seconds, 30 without it, answers the file name
+static void le_profilecb(struct evhttp_request* req, void*)
+{
+	if (evhttp_request_get_command(req) != EVHTTP_REQ_GET) {
+		evhttp_send_error(req, HTTP_BADMETHOD, NULL);
+		return;
+	}
+
+	int seconds = 30;
+	struct evkeyvalq query;
+	const char* querystr = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(req));
+	if (querystr != NULL && evhttp_parse_query_str(querystr, &query) == 0) {
+		const char* value = evhttp_find_header(&query, "seconds");
+		if (value != NULL)
+			seconds = atoi(value);
+		evhttp_clear_headers(&query);
+	}
+
+	std::string path;
+	switch (le_profile(seconds, path)) {
+	case _PROFILE_RESULT::_STARTED:
+		break;
+	case _PROFILE_RESULT::_RUNNING:
+		evhttp_send_error(req, 409, "A profile is running");
+		return;
+	default:
+		evhttp_send_error(req, HTTP_INTERNAL, "The profile could not start");
+		return;
+	}
+
+	struct evbuffer* out = evbuffer_new();
+	evbuffer_add_printf(out, "%s\n", path.c_str());
+	evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", "text/plain");
+	evhttp_send_reply(req, HTTP_OK, "OK", out);
+	evbuffer_free(out);
+}
+
+static void le_profilereport(const char* text)
+{
+	MSGLOG(eMSGTYPE::INFO, "%s", text);
+}
+
+// into tongits-<pid>-<time>.folded of the working directory, by /profile or the mu admin
+_PROFILE_RESULT le_profile(int seconds, std::string& path)
+{
+	char szPath[64];
+
+	seconds = std::max(1, std::min(seconds, SAMPLER_MAX_SECONDS));
+#ifdef _WIN32
+	snprintf(szPath, sizeof(szPath), "tongits-%d-%lld.folded", (int)_getpid(), (long long)time(NULL));
+#else
+	snprintf(szPath, sizeof(szPath), "tongits-%d-%lld.folded", (int)getpid(), (long long)time(NULL));
+#endif
+	if (samplerrunning())
+		return _PROFILE_RESULT::_RUNNING;
+	if (!samplerstart(szPath, seconds, le_profilereport))
+		return _PROFILE_RESULT::_FAILED;
+
+	path = szPath;
+	MSGLOG(eMSGTYPE::INFO, "Profiling %d seconds into %s.", seconds, szPath);
+	return _PROFILE_RESULT::_STARTED;
+}
+
+static struct evhttp* le_startstats(struct event_base* base)
+{
+	int statsport = c.getstatsport();
+
+	if (statsport == 0)
+		return NULL;
+
+	struct evhttp* http = evhttp_new(base);
+	evhttp_set_cb(http, "/stats", le_statscb, NULL);
+	evhttp_set_cb(http, "/metrics", le_metricscb, NULL);
+	evhttp_set_cb(http, "/profile", le_profilecb, NULL);
+
+	if (evhttp_bind_socket(http, "127.0.0.1", statsport) != 0) {
+		MSGLOG(eMSGTYPE::ERROR, "evhttp_bind_socket failed at port %d, stats are not served.", statsport);
+		evhttp_free(http);
+		return NULL;
+	}
+
+	MSGLOG(eMSGTYPE::INFO, "Stats are served at http://127.0.0.1:%d/stats and /metrics.", statsport);
+	return http;
+}
+
 static void le_timercb(evutil_socket_t fd, short event, void* arg)
 {
-	gcontrol.run();
+	clockrefresh();
+	_LoopWorker* loop = (_LoopWorker*)arg;
+	_LoopBusy busy("loop timer", loop->index);
+	uint64_t start = statsusec();
+	tracerun(_TRACE_TYPE::_CTRLRUN, loop->index);
+	gcontrol.run(loop->index);
+	ratesweep();
+	statstick(_STATS_TICK::_CTRLRUN, statsusec() - start);
+}
+
+// how much later than SHED_PROBE_MSEC the probe of a loop fired, read on the wall of the process and
+// not the game clock, which a replay pins
+static void le_probecb(evutil_socket_t fd, short event, void* arg)
+{
+	_LoopWorker* loop = (_LoopWorker*)arg;
+	uint64_t now = statsusec() / 1000;
+	uint64_t due = loop->probetick + SHED_PROBE_MSEC;
+
+	loop->lagmsec = (now > due) ? now - due : 0;
+	loop->probetick = now;
+	loopwatchtick(loop->watch, loop->lagmsec * 1000);
+
+	if (loop->index == 0) {
+		memtagsample();
+		if (c.getshedlagmsec() > 0)
+			le_shedcheck();
+	}
+}
+
+static void le_stallreport(const char* text)
+{
+	MSGLOG(eMSGTYPE::ERROR, "%s", text);
+}
+
+// SIGUSR2, the bytes each subsystem holds, the same lines as /stats
+static void le_memdumpcb(evutil_socket_t fd, short event, void* arg)
+{
+	std::string report = memtagreport();
+	size_t start = 0;
+
+	MSGLOG(eMSGTYPE::INFO, "Memory by subsystem.");
+	while (start < report.size()) {
+		size_t end = report.find('\n', start);
+		MSGLOG(eMSGTYPE::INFO, "%s", report.substr(start, end - start).c_str());
+		start = end + 1;
+	}
+}
+
+// loop 0 stops both game ports while any loop is behind, a loop stuck in one callback fires no probe and
+// how long it is overdue counts as its lag. clients wait in the accept queue meanwhile
+static void le_shedcheck()
+{
+	uint64_t now = statsusec() / 1000;
+	uint64_t threshold = (uint64_t)c.getshedlagmsec();
+	uint64_t worst = 0;
+
+	for (auto loop : vLoops) {
+		uint64_t due = loop->probetick + SHED_PROBE_MSEC;
+		worst = std::max(worst, (uint64_t)loop->lagmsec);
+		if (now > due)
+			worst = std::max(worst, now - due);
+	}
+
+	if (worst > threshold) {
+		shedcalm = 0;
+		if (isshedding)
+			return;
+		isshedding = true;
+		shedtotal++;
+		for (auto& port : listeners) {
+			if (port.listener != NULL)
+				evconnlistener_disable(port.listener);
+		}
+		MSGLOG(eMSGTYPE::INFO, "Loop lag of %llu ms, game ports stop accepting.", (unsigned long long)worst);
+		return;
+	}
+
+	if (!isshedding)
+		return;
+
+	if (worst >= threshold / 2) {
+		shedcalm = 0;
+		return;
+	}
+
+	if (++shedcalm < SHED_RECOVER_PROBES)
+		return;
+
+	isshedding = false;
+	for (auto& port : listeners) {
+		if (port.listener != NULL)
+			evconnlistener_enable(port.listener);
+	}
+	MSGLOG(eMSGTYPE::INFO, "Loop lag is back to %llu ms, game ports accept again.", (unsigned long long)worst);
+}
+
+static _LoopWorker* le_newloop(int index)
+{
+	_LoopWorker* loop = new _LoopWorker;
+	loop->index = index;
+	loop->cpu = -1;
+	loop->base = NULL;
+	loop->cmdev = NULL;
+	loop->timer = NULL;
+	loop->cmdtail = new _LoopCommand;
+	loop->cmdtail->next = NULL;
+	loop->cmdhead = loop->cmdtail;
+	loop->games = 0;
+	loop->probe = NULL;
+	loop->probetick = 0;
+	loop->lagmsec = 0;
+	loop->watch = NULL;
+	loop->lobbyev = NULL;
+	loop->lobbyqueued = 0;
+	loop->lobbybusy = 0;
+	loop->tableev = NULL;
+	loop->tablepasses = 0;
+	loop->tablecuts = 0;
+	return loop;
+}
+
+// the lobby event runs once no other callback of the loop is ready, see le_parse
+static void le_setbase(_LoopWorker* loop, struct event_base* base)
+{
+	if (loop->index != 0)
+		event_base_priority_init(base, LOOP_PRIORITIES);
+
+	loop->base = base;
+	loop->cmdev = event_new(base, -1, EV_PERSIST, le_cmdcb, loop);
+	loop->lobbyev = event_new(base, -1, 0, le_lobbycb, loop);
+	event_priority_set(loop->lobbyev, LOOP_PRIORITIES - 1);
+	loop->tableev = evtimer_new(base, le_tablecb, loop);
+}
+
+static void le_freeloop(_LoopWorker* loop)
+{
+	le_cmdcb(-1, 0, loop);
+
+	if (loop->timer != NULL) {
+		event_del(loop->timer);
+		event_free(loop->timer);
+	}
+	if (loop->probe != NULL)
+		event_free(loop->probe);
+	event_free(loop->lobbyev);
+	event_free(loop->tableev);
+	for (game* g : loop->tablequeue)
+		g->m_isqueued = false;
+	loop->tablequeue.clear();
+	event_free(loop->cmdev);
+	delete loop->cmdtail;
+
+	event_base_free(loop->base);
+	delete loop;
+}
+
+// the cores of Loop CPUs, or of the interrupts of Loop Interface, a loop each in turn
+static void le_pincpus(int loops)
+{
+	std::vector<int> cpus;
+	const char* from = "Loop CPUs";
+
+	if (!cpuparse(c.getloopcpus(), cpus)) {
+		MSGLOG(eMSGTYPE::ERROR, "Loop CPUs is a list like 0-3,8, not %s.", c.getloopcpus().c_str());
+		return;
+	}
+
+	if (cpus.empty() && !c.getloopinterface().empty()) {
+		from = c.getloopinterface().c_str();
+		if (!cpuirqs(c.getloopinterface(), cpus)) {
+			MSGLOG(eMSGTYPE::ERROR, "The interrupts of %s are not found, the loops are not pinned.", from);
+			return;
+		}
+		MSGLOG(eMSGTYPE::INFO, "The interrupts of %s are on cpus %s.", from, cpuformat(cpus).c_str());
+	}
+
+	if (cpus.empty())
+		return;
+
+	for (int n = 0; n < loops; n++)
+		vLoops[n]->cpu = cpus[n % cpus.size()];
+
+	int node = cpunode(vLoops[0]->cpu);
+	for (int n = 1; n < loops; n++) {
+		if (cpunode(vLoops[n]->cpu) != node) {
+			MSGLOG(eMSGTYPE::INFO, "The loops are on more than one NUMA node, the slabs they share are on node %d of loop 0.", node);
+			break;
+		}
+	}
+	if ((int)cpus.size() < loops)
+		MSGLOG(eMSGTYPE::INFO, "%d loops share the %d cpus of %s.", loops, (int)cpus.size(), from);
+	else
+		MSGLOG(eMSGTYPE::INFO, "Loops are pinned to cpus %s of %s.", cpuformat(cpus).c_str(), from);
+}
+
+static void le_loopworker(_LoopWorker* loop)
+{
+	// before the loop touches any memory, so what it allocates is on its node
+	if (loop->cpu >= 0 && !cpupin(std::vector<int>(1, loop->cpu)))
+		MSGLOG(eMSGTYPE::ERROR, "Loop %d could not be pinned to cpu %d.", loop->index, loop->cpu);
+	loop->threadid = std::this_thread::get_id();
+	currentloop = loop->index;
+	loopwatchattach(loop->watch);
+	event_base_dispatch(loop->base);
+}
+
+// lock free multi producer queue, a push is one exchange and the loop is woken with event_active.
+// without loops, the --bench run or after le_start returned, fn runs in place
+void le_postloop(int index, std::function<void()> fn)
+{
+	if (vLoops.empty()) {
+		fn();
+		return;
+	}
+
+	_LoopWorker* loop = vLoops[index];
+	_LoopCommand* cmd = new _LoopCommand;
+	cmd->fn = std::move(fn);
+	cmd->next = NULL;
+
+	_LoopCommand* prev = loop->cmdhead.exchange(cmd, std::memory_order_acq_rel);
+	prev->next.store(cmd, std::memory_order_release);
+
+	event_active(loop->cmdev, EV_READ, 0);
+}
+
+void le_post(std::function<void()> fn)
+{
+	le_postloop(0, std::move(fn));
+}
+
+static void le_cmdcb(evutil_socket_t, short, void* arg)
+{
+	clockrefresh();
+	_LoopWorker* loop = (_LoopWorker*)arg;
+	_LoopBusy busy("loop command", loop->index);
+	_LoopCommand* next = loop->cmdtail->next.load(std::memory_order_acquire);
+
+	while (next != NULL) {
+		delete loop->cmdtail;
+		loop->cmdtail = next;
+		std::function<void()> fn = std::move(next->fn);
+		fn();
+		next = loop->cmdtail->next.load(std::memory_order_acquire);
+	}
+}
+
+int le_getloop()
+{
+	return currentloop;
+}
+
+struct event_base* le_getbase(int index)
+{
+	return vLoops[index]->base;
+}
+
+int le_getloops()
+{
+	return (int)vLoops.size();
+}
+
+// least loaded game loop, loop 0 keeps the games only when there are no workers
+int le_pickloop()
+{
+	int best = 0;
+
+	for (int n = 1; n < (int)vLoops.size(); n++) {
+		if (best == 0 || vLoops[n]->games < vLoops[best]->games)
+			best = n;
+	}
+
+	vLoops[best]->games++;
+	return best;
+}
+
+void le_releaseloop(int index)
+{
+	if (index >= 0 && index < (int)vLoops.size())
+		vLoops[index]->games--;
+}
+
+// hand the user's bufferevent to another loop, it is moved by its owner outside of its own callbacks
+void le_migrateuser(uintptr_t userindex, int index, std::function<void()> then)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL)
+		return;
+
+	le_postloop(userinfo->packetdata.loop, [userindex, index, then]() {
+		_USER_INFO* userinfo = guser.getuser(userindex);
+
+		if (userinfo == NULL)
+			return;
+
+		struct bufferevent* bev = userinfo->packetdata.bev;
+
+		if (userinfo->packetdata.loop != currentloop) {
+			le_migrateuser(userindex, index, then);
+			return;
+		}
+
+		if (bev == NULL || currentloop == index) {
+			if (then)
+				then();
+			return;
+		}
+
+		bufferevent_disable(bev, EV_READ | EV_WRITE);
+		if (bufferevent_base_set(vLoops[index]->base, bev) != 0) {
+			MSGLOG(eMSGTYPE::ERROR, "bufferevent_base_set failed, userindex %llu, %s (%d).", userindex, __func__, __LINE__);
+			bufferevent_enable(bev, EV_READ | EV_WRITE);
+			if (then)
+				le_postloop(index, then);
+			return;
+		}
+		userinfo->packetdata.loop = index;
+
+		le_postloop(index, [bev, then]() {
+			bufferevent_enable(bev, EV_READ | EV_WRITE);
+			if (then)
+				then();
+		});
+	});
+}
+
+void le_freebev(struct bufferevent* bev, int index)
+{
+	if (bev == NULL)
+		return;
+
+	if (index == currentloop || index < 0 || index >= (int)vLoops.size())
+		bufferevent_free(bev);
+	else
+		le_postloop(index, [bev]() { bufferevent_free(bev); });
+}
+
+// what the system does not know is skipped, a refused option leaves the default and the player plays anyway
+static void le_setsockopts(evutil_socket_t fd, const _SOCKET_OPTS& opts)
+{
+	int on = 1;
+
+	if (opts.nodelay)
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+
+	if (opts.keepidle > 0) {
+		setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (const char*)&on, sizeof(on));
+#if defined(TCP_KEEPIDLE)
+		setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, (const char*)&opts.keepidle, sizeof(opts.keepidle));
+#elif defined(TCP_KEEPALIVE)
+		setsockopt(fd, IPPROTO_TCP, TCP_KEEPALIVE, (const char*)&opts.keepidle, sizeof(opts.keepidle));
+#endif
+#ifdef TCP_KEEPINTVL
+		if (opts.keepintvl > 0)
+			setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, (const char*)&opts.keepintvl, sizeof(opts.keepintvl));
+#endif
+#ifdef TCP_KEEPCNT
+		if (opts.keepcnt > 0)
+			setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, (const char*)&opts.keepcnt, sizeof(opts.keepcnt));
+#endif
+	}
+
+	if (opts.sndbuf > 0)
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (const char*)&opts.sndbuf, sizeof(opts.sndbuf));
+	if (opts.rcvbuf > 0)
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char*)&opts.rcvbuf, sizeof(opts.rcvbuf));
+
+#ifdef TCP_USER_TIMEOUT
+	if (opts.usertimeout > 0)
+		setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, (const char*)&opts.usertimeout, sizeof(opts.usertimeout));
+#endif
+	// the kernel falls back to delayed acks on its own, this only covers the login exchange
+#ifdef TCP_QUICKACK
+	if (opts.quickack)
+		setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, (const char*)&on, sizeof(on));
+#endif
+#ifdef SO_BUSY_POLL
+	if (opts.busypoll > 0)
+		setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, (const char*)&opts.busypoll, sizeof(opts.busypoll));
+#endif
+}
+
+// the accepted sockets inherit the buffer sizes of the listener, fast open is of the listener only
+static void le_setlistenopts(struct evconnlistener* listener, const _SOCKET_OPTS& opts)
+{
+	evutil_socket_t fd = evconnlistener_get_fd(listener);
+
+	if (opts.rcvbuf > 0)
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char*)&opts.rcvbuf, sizeof(opts.rcvbuf));
+	if (opts.sndbuf > 0)
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (const char*)&opts.sndbuf, sizeof(opts.sndbuf));
+
+	if (opts.fastopen > 0) {
+#if defined(TCP_FASTOPEN) && !defined(_WIN32)
+		if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, (const char*)&opts.fastopen, sizeof(opts.fastopen)) != 0)
+			MSGLOG(eMSGTYPE::INFO, "TCP fast open is refused by the system, the listener keeps plain handshakes.");
+#else
+		MSGLOG(eMSGTYPE::INFO, "TCP fast open is not supported, the listener keeps plain handshakes.");
+#endif
+	}
 }
 
 static void le_listener_cb(struct evconnlistener* listener, evutil_socket_t fd,
 	struct sockaddr* sa, int socklen, void* user_data) {
+	clockrefresh();
+	_Listener* port = (_Listener*)user_data;
 
+	// turned away before a bufferevent or a user slot is spent on it
+	if (c.getmaxconnections() > 0 && port->conns >= c.getmaxconnections()) {
+		port->rejectedfull++;
+		evutil_closesocket(fd);
+		return;
+	}
+	if (c.getacceptrate() > 0 && !rateallow(_RATE_RULE::_ACCEPT_IP, ntohl(((struct sockaddr_in*)sa)->sin_addr.s_addr))) {
+		port->rejectedrate++;
+		evutil_closesocket(fd);
+		return;
+	}
+
+	// frames of one dispatch already leave in a single write, nagle would only hold the next batch back
+	le_setsockopts(fd, c.getsockopts(port->websocket != WS_NONE));
+
+	// only the loop thread touches it, IOCP bufferevents need the lock
 	struct bufferevent* _bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE
-//#ifdef _WIN32
-		| BEV_OPT_THREADSAFE | BEV_OPT_UNLOCK_CALLBACKS | BEV_OPT_DEFER_CALLBACKS
-//#endif
+#ifdef _WIN32
+		| BEV_OPT_THREADSAFE
+#endif
 	);
 
 	if (!_bev)
 	{
-		msglog(eMSGTYPE::ERROR, "bufferevent_socket_new failed, %s (%d).", __func__, __LINE__);
+		MSGLOG(eMSGTYPE::ERROR, "bufferevent_socket_new failed, %s (%d).", __func__, __LINE__);
 		return;
 	}
 
@@ -141,11 +1113,11 @@ static void le_listener_cb(struct evconnlistener* listener, evutil_socket_t fd,
 
 	uintptr_t newfd = guser.getuserindex();
 
-	msglog(eMSGTYPE::DEBUG, "Client connection accepted, userindex %llu.", newfd);
+	MSGLOG(eMSGTYPE::DEBUG, "Client connection accepted, userindex %llu.", newfd);
 
 	if (newfd == 0) {
 		bufferevent_free(_bev);
-		msglog(eMSGTYPE::DEBUG, "Client connection failed, max user reached.");
+		MSGLOG(eMSGTYPE::DEBUG, "Client connection failed, max user reached.");
 		return;
 	}
 
@@ -157,35 +1129,71 @@ static void le_listener_cb(struct evconnlistener* listener, evutil_socket_t fd,
 	}
 
 	if (userinfo->packetdata.bev != NULL) {
-		bufferevent_free(userinfo->packetdata.bev);
+		le_releaseconn(userinfo->packetdata);
+		le_freebev(userinfo->packetdata.bev, userinfo->packetdata.loop);
 	}
 
 	userinfo->reset();
 	userinfo->set();
 
-	//msglog(eMSGTYPE::DEBUG, "userindex %llu ecoins %d.", newfd, (int)userinfo->ecoins);
+	//MSGLOG(eMSGTYPE::DEBUG, "userindex %llu ecoins %d.", newfd, (int)userinfo->ecoins);
 
 	userinfo->isfreeuser = false;
 	userinfo->packetdata.bev = _bev;
-	userinfo->m_state = (unsigned char)_USER_STATE::_CONNECTED;
+	userinfo->packetdata.loop = 0;
+	userinfo->setstate((unsigned char)_USER_STATE::_CONNECTED);
+	userinfo->ip = ntohl(((struct sockaddr_in*)sa)->sin_addr.s_addr);
+	userinfo->wirever = WIRE_V1;
+	userinfo->isnoticeid = false;
+	userinfo->isdeadline = false;
+	userinfo->isactionmask = false;
+	userinfo->isfastlane = false;
+	userinfo->alivetick = clockmsec();
+
+	// the listener of the websocket port starts at WS_HANDSHAKE, the raw one at WS_NONE
+	userinfo->packetdata.websocket = port->websocket;
+	userinfo->packetdata.listener = (int)(port - listeners);
+	sealfree(userinfo->packetdata.seal);
+	fastlanefree(userinfo->packetdata.fastlane);
+	replayfree(userinfo->replay);
+	userinfo->packetdata.parked.clear();
+	userinfo->packetdata.isoverflow = false;
+	port->conns++;
+	if (userinfo->packetdata.websocket != WS_NONE) {
+		if (userinfo->packetdata.wsinput == NULL)
+			userinfo->packetdata.wsinput = evbuffer_new();
+		evbuffer_drain(userinfo->packetdata.wsinput, evbuffer_get_length(userinfo->packetdata.wsinput));
+	}
 
 	// temporarily we will force login and waiting status of user here to trigger the game
 	//userinfo->m_state  |= (unsigned char)_USER_STATE::_LOGGEDIN;
 	//userinfo->m_state |= (unsigned char)_USER_STATE::_WAITING;
 
-	bufferevent_setcb(_bev, le_readcb, NULL, le_eventcb, (void*)newfd);
+	bufferevent_setcb(_bev, le_readcb, le_writecb, le_eventcb, (void*)newfd);
 	bufferevent_enable(_bev, EV_READ | EV_WRITE);
+	aliveadd(newfd);
+
+	traceopen(newfd, userinfo->ip);
 }
 
 void le_updatecbfd(uintptr_t userid, uintptr_t resume_userid)
 {
 	bufferevent_setcb(guser.getuser(userid)->packetdata.bev, 
-		le_readcb, NULL, le_eventcb, (void*)resume_userid);
+		le_readcb, le_writecb, le_eventcb, (void*)resume_userid);
+}
+
+// a client that is not logged in yet may start sealing, the packets in the clear never begin with it
+static bool le_ishello(_USER_INFO* userinfo, struct evbuffer* input)
+{
+	if (!sealisenabled() || (userinfo->m_state & (unsigned char)_USER_STATE::_LOGGEDIN) != 0 || evbuffer_get_length(input) == 0)
+		return false;
+	return evbuffer_pullup(input, 1)[0] == SEAL_HELLO;
 }
 
 static void
 le_readcb(struct bufferevent* bev, void* user_data)
 {
+	clockrefresh();
 	uintptr_t fd = (uintptr_t)user_data;
 	_USER_INFO* userinfo = guser.getuser(fd);
 
@@ -194,34 +1202,266 @@ le_readcb(struct bufferevent* bev, void* user_data)
 		return;
 	}
 
-	int len = bufferevent_read(bev, userinfo->packetdata.buffer + userinfo->packetdata.bufferlen, MAX_BUFFER_DATA - userinfo->packetdata.bufferlen);
+	// any bytes count, a player busy sending moves needs no alive packet
+	userinfo->alivetick = clockmsec();
+	userinfo->packetdata.readusec = statsusec();
+
+	if (userinfo->packetdata.websocket == WS_NONE) {
+		if (userinfo->packetdata.seal == NULL && !le_ishello(userinfo, bufferevent_get_input(bev))) {
+			le_parse(fd, userinfo, bufferevent_get_input(bev));
+			return;
+		}
+		if (le_sealread(fd, userinfo, bev) == false) {
+			MSGLOG(eMSGTYPE::DEBUG, "Sealed client sent a refused hello or a bad record, fd %llu.", fd);
+			traceclose(fd);
+			guser.deluser(fd);
+		}
+		return;
+	}
+
+	if (le_wsread(fd, userinfo, bev) == false) {
+		MSGLOG(eMSGTYPE::DEBUG, "Websocket client closed or sent a bad frame, fd %llu.", fd);
+		traceclose(fd);
+		guser.deluser(fd);
+	}
+}
+
+// upgrade first, then every complete frame is unmasked in place and its payload parsed like a raw read
+static bool le_wsread(uintptr_t fd, _USER_INFO* userinfo, struct bufferevent* bev)
+{
+	struct evbuffer* input = bufferevent_get_input(bev);
+	struct evbuffer* output = bufferevent_get_output(bev);
+
+	if (userinfo->packetdata.websocket == WS_HANDSHAKE) {
+		int ret = wshandshake(input, output);
+		if (ret <= 0)
+			return ret == 0;
+		userinfo->packetdata.websocket = WS_OPEN;
+	}
+
+	if (wsdecode(input, userinfo->packetdata.wsinput, output) != 0)
+		return false;
+
+	if (evbuffer_get_length(userinfo->packetdata.wsinput) == 0)
+		return true;
+
+	// a resume in here swaps the buffer to the session slot, the frames left in it still get parsed
+	le_parse(fd, userinfo, userinfo->packetdata.wsinput);
+	return true;
+}
+
+// the hello first, then every complete record is opened in place and its packets parsed like a raw read
+static bool le_sealread(uintptr_t fd, _USER_INFO* userinfo, struct bufferevent* bev)
+{
+	struct evbuffer* input = bufferevent_get_input(bev);
+
+	if (userinfo->packetdata.seal == NULL) {
+		int ret = sealhello(input, userinfo->packetdata.seal);
+		if (ret <= 0)
+			return ret == 0;
+	}
+
+	_SEAL_STATE* seal = userinfo->packetdata.seal;
+	if (sealdecode(seal, input) != 0)
+		return false;
+
+	if (evbuffer_get_length(seal->input) > 0)
+		le_parse(fd, userinfo, seal->input);
+	return true;
+}
+
+static struct evbuffer* le_input(_USER_INFO* userinfo)
+{
+	if (userinfo->packetdata.seal != NULL)
+		return userinfo->packetdata.seal->input;
+	if (userinfo->packetdata.websocket == WS_NONE)
+		return bufferevent_get_input(userinfo->packetdata.bev);
+	return userinfo->packetdata.wsinput;
+}
+
+static void le_lobbyreject(_LoopWorker* loop, uintptr_t fd, struct evbuffer* input)
+{
+	evbuffer_drain(input, evbuffer_get_length(input));
+	guser.sendnotice(fd, 8, _NOTICE_ID::_BUSY);
+	loop->lobbybusy++;
+}
+
+// the frames of a player at a table are parsed at once. with Lobby Budget those of everyone else, the
+// logins above all, wait in the lobby queue of the loop for its lobby event, which libevent runs after
+// the reads and timers that are ready. a connection has one place in the queue however often it reads,
+// its bytes stay in its buffer meanwhile. past LOBBY_QUEUE_MAX waiting or LOBBY_WAIT_MSEC in the queue
+// its bytes are dropped and the client is told the server is busy
+static void le_parse(uintptr_t fd, _USER_INFO* userinfo, struct evbuffer* input)
+{
+	if (c.getlobbybudget() <= 0 || (userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING) != 0) {
+		gprotocol.parsedata(fd, input);
+		return;
+	}
+
+	if (userinfo->packetdata.lobbyqueued == fd)
+		return;
+
+	_LoopWorker* loop = vLoops[currentloop];
+
+	if (loop->lobbyqueue.size() >= LOBBY_QUEUE_MAX) {
+		le_lobbyreject(loop, fd, input);
+		return;
+	}
+
+	loop->lobbyqueue.push_back({ fd, clockmsec() });
+	loop->lobbyqueued++;
+	userinfo->packetdata.lobbyqueued = fd;
+	event_active(loop->lobbyev, EV_READ, 0);
+}
+
+static void le_lobbycb(evutil_socket_t, short, void* arg)
+{
+	clockrefresh();
+	_LoopWorker* loop = (_LoopWorker*)arg;
+	_LoopBusy busy("lobby", loop->index);
+	int budget = c.getlobbybudget();
+
+	while (budget > 0 && !loop->lobbyqueue.empty()) {
+		_LobbyWait wait = loop->lobbyqueue.front();
+		loop->lobbyqueue.pop_front();
+
+		_USER_INFO* userinfo = guser.getuser(wait.userindex);
+		if (userinfo == NULL || userinfo->packetdata.lobbyqueued != wait.userindex)
+			continue;
+		userinfo->packetdata.lobbyqueued = 0;
+		if (userinfo->packetdata.bev == NULL)
+			continue;
+
+		// moved to a game loop while it waited, its bytes are parsed there
+		if (userinfo->packetdata.loop != loop->index) {
+			uintptr_t userindex = wait.userindex;
+			le_postloop(userinfo->packetdata.loop, [userindex]() {
+				_USER_INFO* userinfo = guser.getuser(userindex);
+				if (userinfo != NULL && userinfo->packetdata.bev != NULL && userinfo->packetdata.loop == currentloop)
+					le_parse(userindex, userinfo, le_input(userinfo));
+			});
+			continue;
+		}
+
+		if (clockmsec() - wait.tick > LOBBY_WAIT_MSEC) {
+			le_lobbyreject(loop, wait.userindex, le_input(userinfo));
+			continue;
+		}
+
+		gprotocol.parsedata(wait.userindex, le_input(userinfo));
+		budget--;
+	}
+
+	if (!loop->lobbyqueue.empty())
+		event_active(loop->lobbyev, EV_READ, 0);
+}
+
+void le_queuegame(game* g)
+{
+	if (g->m_isqueued)
+		return;
+
+	_LoopWorker* loop = vLoops[currentloop];
+	bool isidle = loop->tablequeue.empty();
+
+	g->m_isqueued = true;
+	loop->tablequeue.push_back(g);
+	if (isidle) {
+		struct timeval tv = { 0, 0 };
+		evtimer_add(loop->tableev, &tv);
+	}
+}
+
+void le_unqueuegame(game* g)
+{
+	_LoopWorker* loop = vLoops[g->getloop()];
+	auto iter = std::find(loop->tablequeue.begin(), loop->tablequeue.end(), g);
+
+	if (iter != loop->tablequeue.end())
+		loop->tablequeue.erase(iter);
+	g->m_isqueued = false;
+}
+
+// a burst of deadlines, the turn timeouts of many tables at once, is spread over passes. the timer of
+// the next pass fires once libevent polled again, so a read waits one pass at most. a table that runs
+// goes behind the others the next time its timer fires
+static void le_tablecb(evutil_socket_t, short, void* arg)
+{
+	_LoopWorker* loop = (_LoopWorker*)arg;
+	uint64_t start = statsusec();
+	uint64_t budget = (uint64_t)c.gettickbudgetusec();
+
+	loop->tablepasses++;
+	while (!loop->tablequeue.empty()) {
+		game* g = loop->tablequeue.front();
+		loop->tablequeue.pop_front();
+		g->m_isqueued = false;
+		g->tick();
+		if (statsusec() - start >= budget)
+			break;
+	}
+
+	if (!loop->tablequeue.empty()) {
+		loop->tablecuts++;
+		struct timeval tv = { 0, 0 };
+		evtimer_add(loop->tableev, &tv);
+	}
+}
 
-	if (len == 0) {
+static void le_dropuser(uintptr_t fd)
+{
+	if (guser.getuser(fd) == NULL)
+		return;
+
+	traceclose(fd);
+	le_releaseconn(guser.getuser(fd)->packetdata);
+
+	if (guser.getuser(fd)->ismuadmin) {
+		MSGLOG(eMSGTYPE::DEBUG, "MU Admin disconnected, fd %llu.", fd);
+		guser.delmuadmin(fd);
+	}
+	else {
+		MSGLOG(eMSGTYPE::DEBUG, "Client disconnected, fd %llu.", fd);
 		guser.deluser(fd);
+	}
+}
+
+// the connection stays with the slot like a dropped one until the slot is reused or resumed, it only
+// falls silent so a late eof can not drop the player a second time
+void le_closeuser(uintptr_t userindex)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL)
 		return;
+
+	struct bufferevent* bev = userinfo->packetdata.bev;
+	if (bev != NULL) {
+		bufferevent_setcb(bev, NULL, NULL, NULL, NULL);
+		bufferevent_disable(bev, EV_READ | EV_WRITE);
+		shutdown(bufferevent_getfd(bev), 2);	// SHUT_RDWR, SD_BOTH
 	}
 
-	userinfo->packetdata.bufferlen += len;
+	le_dropuser(userindex);
+}
+
+// exchanged, a resume handing the connection to another slot and a drop on its own loop may meet
+void le_releaseconn(_PACKET_DATA& packetdata)
+{
+	int index = packetdata.listener.exchange(-1);
 
-	gprotocol.parsedata(fd);
+	if (index >= 0)
+		listeners[index].conns--;
 }
 
 static void
 le_eventcb(struct bufferevent* bev, short events, void* user_data)
 {
+	clockrefresh();
 	uintptr_t fd = (uintptr_t)user_data;
 
 	if ((events & BEV_EVENT_EOF) || (events & BEV_EVENT_ERROR))
-	{
-		if (guser.getuser(fd)->ismuadmin) {
-			msglog(eMSGTYPE::DEBUG, "MU Admin disconnected, fd %llu.", fd);
-			guser.delmuadmin(fd);
-		}
-		else {
-			msglog(eMSGTYPE::DEBUG, "Client disconnected, fd %llu.", fd);
-			guser.deluser(fd);
-		}
-	}
+		le_dropuser(fd);
 	else if (events & BEV_EVENT_CONNECTED)
 	{
 	}
@@ -235,71 +1475,226 @@ bool datasend(intptr_t userindex, unsigned char* data, int len)
 		return false;
 	}
 
-	struct bufferevent* bev = userinfo->packetdata.bev;
+	// nothing to send to, a bot reads the table directly
+	if (userinfo->isbot)
+		return true;
+
+	// bufferevent_write only appends, everything queued for a user during one dispatch is
+	// flushed with one writev when the loop gets back to the write event
+	// the owner may change while this is queued, the posted send checks again
+	if (userinfo->packetdata.loop != currentloop) {
+		std::vector<unsigned char> vData(data, data + len);
+		le_postloop(userinfo->packetdata.loop, [userindex, vData]() { datasend(userindex, (unsigned char*)vData.data(), (int)vData.size()); });
+		return true;
+	}
 
 	if (!(userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED)) {
-		msglog(eMSGTYPE::ERROR, "user fd %llu is not connected.", userindex);
+		// a seat away keeps the frames of its table for its resume
+		if (!replayrecord(userinfo, data, len))
+			MSGLOG(eMSGTYPE::ERROR, "user fd %llu is not connected.", userindex);
 		return false;
 	}
 
-	if (bufferevent_write(bev, data, len) == -1) {
-		msglog(eMSGTYPE::ERROR, "bufferevent_write failed, fd %llu.", userindex);
-		return false;
+	if (!le_admit(userinfo, userindex, data, len))
+		return !userinfo->packetdata.isoverflow;
+
+	return le_send(userinfo, userindex, data, len);
+}
+
+// loop of the user, connected, the v1 frame counted for the replay ring and written in its wire version
+static bool le_send(_USER_INFO* userinfo, intptr_t userindex, unsigned char* data, int len)
+{
+	bool iscounted = replayrecord(userinfo, data, len);
+	unsigned char* wire = data;
+	int wirelen = len;
+
+	if (userinfo->wirever == WIRE_V2) {
+		static thread_local std::vector<unsigned char> vWire;
+		vWire.clear();
+		if (!wireencode(data, len, vWire)) {
+			MSGLOG(eMSGTYPE::ERROR, "wireencode failed, packet 0x%X len %d, fd %llu.", (len > 4) ? data[4] : 0, len, userindex);
+			return false;
+		}
+		wire = vWire.data();
+		wirelen = (int)vWire.size();
 	}
 
-	//msglog(eMSGTYPE::DEBUG, "bufferevent_write %d data, fd %llu.", len, userindex);
+	// the frames the fast lane carries go out ahead of the connection too
+	if (iscounted && userinfo->packetdata.fastlane != NULL)
+		fastlanesend(userinfo, data, len, wire, wirelen);
 
-	return true;
+	return le_write(userinfo, userindex, wire, wirelen);
 }
 
-struct _HTTP_PTR
+// the same packet to several users, encoded once for all the v2 clients. a user of another loop or
+// not connected goes through datasend. the packets are a few dozen bytes, copying them into each
+// output buffer is cheaper than the chain an evbuffer reference would allocate per user
+bool datasendall(const intptr_t* users, int count, unsigned char* data, int len)
 {
-	struct evhttp_connection* conn;
-	struct evhttp_request* req;
-};
+	static thread_local std::vector<unsigned char> vBroadcast;
+	bool isencoded = false;
+	bool issent = true;
+
+	for (int n = 0; n < count; n++) {
+		_USER_INFO* userinfo = guser.getuser(users[n]);
+
+		if (userinfo == NULL || userinfo->isbot)
+			continue;
+
+		if (userinfo->packetdata.loop != currentloop || !(userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED)) {
+			issent &= datasend(users[n], data, len);
+			continue;
+		}
+
+		if (!le_admit(userinfo, users[n], data, len)) {
+			issent &= !userinfo->packetdata.isoverflow;
+			continue;
+		}
+
+		bool iscounted = replayrecord(userinfo, data, len);
 
-void http_request_done(struct evhttp_request* req, void* arg) {
+		if (userinfo->wirever != WIRE_V2) {
+			if (iscounted && userinfo->packetdata.fastlane != NULL)
+				fastlanesend(userinfo, data, len, data, len);
+			issent &= le_write(userinfo, users[n], data, len);
+			continue;
+		}
+
+		if (!isencoded) {
+			vBroadcast.clear();
+			if (!wireencode(data, len, vBroadcast)) {
+				MSGLOG(eMSGTYPE::ERROR, "wireencode failed, packet 0x%X len %d.", (len > 4) ? data[4] : 0, len);
+				return false;
+			}
+			isencoded = true;
+		}
+		if (iscounted && userinfo->packetdata.fastlane != NULL)
+			fastlanesend(userinfo, data, len, vBroadcast.data(), (int)vBroadcast.size());
+		issent &= le_write(userinfo, users[n], vBroadcast.data(), (int)vBroadcast.size());
+	}
 
-	msglog(DEBUG, "http_request_done.");
+	return issent;
+}
+
+// a frame a newer one of the same kind makes stale, the client only needs the last
+static bool le_issuperseded(const unsigned char* data, int len)
+{
+	if (len < 4 || data[0] != 0xC1 || data[1] != 0xF1)
+		return false;
+	return data[3] == 0x02 || data[3] == 0x07;	// active info, turn time left
+}
 
-	_HTTP_PTR* _ptr = (_HTTP_PTR*)arg;
-	evhttp_connection_free(_ptr->conn);
-	evhttp_request_free(_ptr->req);
-	delete _ptr;
+static void le_unpark(_USER_INFO* userinfo, intptr_t userindex)
+{
+	std::vector<unsigned char> vParked;
+	vParked.swap(userinfo->packetdata.parked);
+	le_send(userinfo, userindex, vParked.data(), (int)vParked.size());
 }
 
-bool sendotp(const char *smsnum, char* otpmsg)
+// a client that reads too slowly is let go instead of its output growing, its seat resumes from the
+// replay ring or the whole table when it is back. closed from its loop later, the table that sends may
+// be walking its seats
+static void le_overflow(_USER_INFO* userinfo, intptr_t userindex, size_t pending)
 {
-	char reqpath[100] = { 0 };
-	//sprintf(reqpath, "/index.php?smsnumber=%s&otpmsg=%s", smsnum, otpmsg);
+	struct bufferevent* bev = userinfo->packetdata.bev;
 
-	_HTTP_PTR* _ptr = new _HTTP_PTR;
+	userinfo->packetdata.isoverflow = true;
+	userinfo->packetdata.parked.clear();
+	outputoverflows++;
+	MSGLOG(eMSGTYPE::INFO, "%s has %llu bytes unsent, over Max Output, fd %llu is closed.", userinfo->name.c_str(), (unsigned long long)pending, userindex);
 
-	_ptr->conn = evhttp_connection_base_new(base, NULL, "139.99.38.94", 80);
+	le_postloop(currentloop, [userindex, bev]() {
+		_USER_INFO* userinfo = guser.getuser(userindex);
+		if (userinfo != NULL && userinfo->packetdata.bev == bev)
+			le_closeuser(userindex);
+	});
+}
+
+// loop of the user, connected. false when the frame is not written now: a turn refresh waits while the
+// output is busy and a newer one of its kind replaces it, any other frame writes the waiting one first
+// so the order stays. the frames of the game are never dropped, a connection they would take over Max
+// Output is closed
+static bool le_admit(_USER_INFO* userinfo, intptr_t userindex, const unsigned char* data, int len)
+{
+	_PACKET_DATA& packetdata = userinfo->packetdata;
 
-	if (_ptr->conn == NULL) {
-		delete _ptr;
+	// kept for the resume like the frames of a seat away
+	if (packetdata.isoverflow) {
+		replayrecord(userinfo, data, len);
 		return false;
 	}
 
-	_ptr->req = evhttp_request_new(http_request_done, (void*)_ptr);
+	bool issuperseded = le_issuperseded(data, len);
 
-	if (_ptr->req == NULL) {
-		evhttp_connection_free(_ptr->conn);
-		delete _ptr;
+	if (!packetdata.parked.empty()) {
+		if (issuperseded && packetdata.parked[3] == data[3]) {
+			packetdata.parked.assign(data, data + len);
+			outputcoalesced++;
+			return false;
+		}
+		le_unpark(userinfo, userindex);
+	}
+
+	size_t pending = evbuffer_get_length(bufferevent_get_output(packetdata.bev));
+
+	if (issuperseded && pending > 0) {
+		packetdata.parked.assign(data, data + len);
+		return false;
+	}
+
+	// without loops, the --bench run, nothing reads the pairs and there is no loop to close on
+	int maxoutput = c.getmaxoutput();
+	if (maxoutput > 0 && currentloop >= 0 && pending + len > (size_t)maxoutput) {
+		le_overflow(userinfo, userindex, pending);
+		replayrecord(userinfo, data, len);
 		return false;
 	}
 
-	evhttp_add_header(_ptr->req->output_headers, "Host", "muengine.org");
+	return true;
+}
+
+// the output drained, the turn refresh that waited for it goes
+static void le_writecb(struct bufferevent* bev, void* user_data)
+{
+	uintptr_t fd = (uintptr_t)user_data;
+	_USER_INFO* userinfo = guser.getuser(fd);
+
+	if (userinfo == NULL || userinfo->packetdata.bev != bev || userinfo->packetdata.parked.empty())
+		return;
+
+	clockrefresh();
+	le_unpark(userinfo, fd);
+}
+
+// loop of the user, connected, the packet already in its wire version
+static bool le_write(_USER_INFO* userinfo, intptr_t userindex, unsigned char* data, int len)
+{
+	struct bufferevent* bev = userinfo->packetdata.bev;
+
+	if (userinfo->packetdata.seal != NULL) {
+		if (!sealwrite(userinfo->packetdata.seal, bufferevent_get_output(bev), data, len)) {
+			MSGLOG(eMSGTYPE::ERROR, "sealwrite failed, fd %llu.", userindex);
+			return false;
+		}
+		return true;
+	}
+
+	// the header and the packet leave in the same writev
+	if (userinfo->packetdata.websocket == WS_OPEN) {
+		unsigned char header[WS_MAX_HEADER];
+		if (bufferevent_write(bev, header, wsheader(header, len)) == -1) {
+			MSGLOG(eMSGTYPE::ERROR, "bufferevent_write failed, fd %llu.", userindex);
+			return false;
+		}
+	}
 
-	if (evhttp_make_request(_ptr->conn, _ptr->req, EVHTTP_REQ_GET, "/index.php?v=1") != 0) {
-		evhttp_connection_free(_ptr->conn);
-		delete _ptr;
+	if (bufferevent_write(bev, data, len) == -1) {
+		MSGLOG(eMSGTYPE::ERROR, "bufferevent_write failed, fd %llu.", userindex);
 		return false;
 	}
 
-	evhttp_connection_set_timeout(_ptr->req->evcon, 60);
-	msglog(DEBUG, "sendotp.");
+	//MSGLOG(eMSGTYPE::DEBUG, "bufferevent_write %d data, fd %llu.", len, userindex);
+
 	return true;
 }
 
@@ -1,7 +1,37 @@
 #pragma once
+#include <functional>
+#include <string>
+
+struct _PACKET_DATA;
+class game;
+
+enum class _PROFILE_RESULT : unsigned char
+{
+	_STARTED,
+	_RUNNING,	// one profile at a time
+	_FAILED	// the file cannot be written or there are no stacks to take, Windows
+};
 
 int le_start();
+struct event_base* le_startlocal();
+void le_stoplocal();
 bool datasend(intptr_t userindex, unsigned char* data, int len);
-bool sendotp(const char* smsnum, char* otpmsg);
+bool datasendall(const intptr_t* users, int count, unsigned char* data, int len);
+void le_post(std::function<void()> fn);
+void le_postloop(int index, std::function<void()> fn);
+int le_getloop();
+int le_getloops();
+struct event_base* le_getbase(int index);
+int le_pickloop();
+void le_releaseloop(int index);
+void le_migrateuser(uintptr_t userindex, int index, std::function<void()> then = nullptr);
+void le_freebev(struct bufferevent* bev, int index);
 void le_updatecbfd(uintptr_t userid, uintptr_t resume_userid);
+// on the loop of the table, its timer fired. the loop runs due tables in the order they came for Tick
+// Budget Usec a pass, at least one, and reads its connections before the next pass
+void le_queuegame(game* g);
+void le_unqueuegame(game* g);	// its slot is let go while it waits
+void le_closeuser(uintptr_t userindex);	// on the loop of the connection, as if the client dropped it
+void le_releaseconn(_PACKET_DATA& packetdata);	// the connection no longer counts against Max Connections, on any loop
+_PROFILE_RESULT le_profile(int seconds, std::string& path);	// the folded stacks go to path once seconds are over
 extern std::mutex mlock;
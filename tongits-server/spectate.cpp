@@ -0,0 +1,247 @@
+#include "spectate.h"
+#include "game.h"
+#include "user.h"
+#include "conf.h"
+#include "socket.h"
+#include "seal.h"
+#include "packet.h"
+
+// the bytes of one tick in one encoding, freed by the last output buffer that sent them
+struct _SPECTATE_BLOCK
+{
+	std::atomic<int> refs;
+	std::vector<unsigned char> data;
+};
+
+static thread_local std::vector<_SPECTATE_STREAM*> vstreams;	// of the calling loop
+static std::atomic<uint64_t> spectateids(0);
+
+static void spectaterelease(const void*, size_t, void* arg)
+{
+	_SPECTATE_BLOCK* block = (_SPECTATE_BLOCK*)arg;
+	if (block->refs.fetch_sub(1) == 1)
+		delete block;
+}
+
+void spectateanswer(intptr_t userindex, unsigned char result, int64_t gameserial, unsigned char ectype)
+{
+	_PMSG_WATCH_ANS pMsg = pkttemplate<_PMSG_WATCH_ANS>(0xF1, 0x0A);
+	pMsg.result = result;
+	pMsg.ectype = ectype;
+	pMsg.delaysec = (unsigned short)c.getspectatedelay();
+	pMsg.gameserial = (int)gameserial;
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
+
+bool spectatewatch(game* g, intptr_t userindex)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL)
+		return false;
+
+	if (g->getloop() != le_getloop() || g->getstate() == _GAME_STATE::_FREE) {
+		spectateanswer(userindex, 0, g->getgameserial(), 0);
+		return false;
+	}
+
+	_SPECTATE_STREAM* s = g->m_spectate;
+	if (s == NULL) {
+		s = new _SPECTATE_STREAM();
+		s->id = ++spectateids;
+		s->g = g;
+		s->gameserial = g->getgameserial();
+		s->snapshottick = 0;
+		g->m_spectate = s;
+		vstreams.push_back(s);
+	}
+
+	if (userinfo->m_watchid == s->id)
+		return true;
+
+	if (s->watchers.size() >= SPECTATE_MAX_WATCHERS) {
+		spectateanswer(userindex, 0, s->gameserial, 0);
+		return false;
+	}
+
+	_SPECTATE_WATCHER watcher;
+	watcher.userindex = userindex;
+	watcher.isbehind = true;
+	s->watchers.push_back(watcher);
+	userinfo->m_watchid = s->id;
+
+	if (s->snapshottick == 0)
+		s->snapshottick = clockmsec();
+
+	spectateanswer(userindex, 1, s->gameserial, g->getgametype());
+	return true;
+}
+
+void spectatepush(_SPECTATE_STREAM* s, const unsigned char* data, int len)
+{
+	uint64_t due = clockmsec() + (uint64_t)c.getspectatedelay() * 1000;
+
+	// what happens in the same msec is one event
+	if (s->events.empty() || s->events.back().due != due || s->events.back().issnapshot) {
+		s->events.push_back(_SPECTATE_EVENT());
+		s->events.back().due = due;
+		s->events.back().issnapshot = false;
+	}
+	s->events.back().data.insert(s->events.back().data.end(), data, data + len);
+}
+
+void spectateclose(game* g)
+{
+	if (g->m_spectate == NULL)
+		return;
+	g->m_spectate->g = NULL;
+	g->m_spectate = NULL;
+}
+
+// a watcher still on the stream and connected
+static _USER_INFO* spectateuser(_SPECTATE_STREAM* s, const _SPECTATE_WATCHER& watcher)
+{
+	_USER_INFO* userinfo = guser.getuser(watcher.userindex);
+
+	if (userinfo == NULL || userinfo->m_watchid != s->id || userinfo->packetdata.bev == NULL ||
+		!(userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED))
+		return NULL;
+	return userinfo;
+}
+
+// the packets of one event or run of events to the watchers it is for, each encoding built once
+static void spectatesend(_SPECTATE_STREAM* s, const std::vector<unsigned char>& data, bool issnapshot)
+{
+	_SPECTATE_BLOCK* blocks[2] = { NULL, NULL };	// v1 and v2
+	bool isfailed[2] = { false, false };
+
+	for (size_t n = 0; n < s->watchers.size(); n++) {
+		_SPECTATE_WATCHER& watcher = s->watchers[n];
+		_USER_INFO* userinfo = spectateuser(s, watcher);
+
+		if (userinfo == NULL || watcher.isbehind != issnapshot)
+			continue;
+
+		struct evbuffer* output = bufferevent_get_output(userinfo->packetdata.bev);
+		if (evbuffer_get_length(output) > SPECTATE_MAX_BACKLOG) {
+			watcher.isbehind = true;
+			continue;
+		}
+
+		int v = (userinfo->wirever == WIRE_V2) ? 1 : 0;
+		if (blocks[v] == NULL && !isfailed[v]) {
+			blocks[v] = new _SPECTATE_BLOCK();
+			blocks[v]->refs = 1;
+			if (v == 0)
+				blocks[v]->data = data;
+			else if (!wireencode(data.data(), (int)data.size(), blocks[v]->data)) {
+				MSGLOG(eMSGTYPE::ERROR, "spectate, wireencode failed for table %lld.", s->gameserial);
+				delete blocks[v];
+				blocks[v] = NULL;
+				isfailed[v] = true;
+			}
+		}
+		if (blocks[v] == NULL)
+			continue;
+
+		// one websocket message for the whole block
+		if (userinfo->packetdata.websocket == WS_OPEN) {
+			unsigned char header[WS_MAX_HEADER];
+			evbuffer_add(output, header, wsheader(header, (int)blocks[v]->data.size()));
+		}
+
+		// a sealed watcher gets a copy sealed with its own keys
+		if (userinfo->packetdata.seal != NULL)
+			sealwrite(userinfo->packetdata.seal, output, blocks[v]->data.data(), blocks[v]->data.size());
+		else {
+			blocks[v]->refs++;
+			if (evbuffer_add_reference(output, blocks[v]->data.data(), blocks[v]->data.size(), spectaterelease, blocks[v]) != 0)
+				blocks[v]->refs--;
+		}
+
+		watcher.isbehind = false;
+	}
+
+	for (int v = 0; v < 2; v++) {
+		if (blocks[v] != NULL)
+			spectaterelease(NULL, 0, blocks[v]);
+	}
+}
+
+// false once the stream is done with
+static bool spectateflushstream(_SPECTATE_STREAM* s)
+{
+	static thread_local std::vector<unsigned char> vrun;
+
+	// the ones gone, moved on or watching another table
+	for (size_t n = 0; n < s->watchers.size();) {
+		_USER_INFO* userinfo = spectateuser(s, s->watchers[n]);
+		if (userinfo != NULL && userinfo->packetdata.loop == le_getloop()) {
+			n++;
+			continue;
+		}
+		s->watchers[n] = s->watchers.back();
+		s->watchers.pop_back();
+	}
+
+	if (s->g != NULL && s->watchers.empty()) {
+		s->g->m_spectate = NULL;
+		return false;
+	}
+
+	bool isbehind = false;
+	for (size_t n = 0; n < s->watchers.size(); n++)
+		isbehind |= s->watchers[n].isbehind;
+
+	if (s->g != NULL && isbehind && s->snapshottick == 0)
+		s->snapshottick = clockmsec();
+
+	if (s->g != NULL && s->snapshottick != 0 && clockmsec() >= s->snapshottick) {
+		s->events.push_back(_SPECTATE_EVENT());
+		s->events.back().due = clockmsec() + (uint64_t)c.getspectatedelay() * 1000;
+		s->events.back().issnapshot = true;
+		s->g->spectatesnapshot(s->events.back().data);
+		s->snapshottick = isbehind ? clockmsec() + SPECTATE_SNAPSHOT_MSEC : 0;
+	}
+
+	// runs of due events go out as one block, a snapshot on its own
+	vrun.clear();
+	while (!s->events.empty() && s->events.front().due <= clockmsec()) {
+		_SPECTATE_EVENT& event = s->events.front();
+		if (event.issnapshot) {
+			if (!vrun.empty())
+				spectatesend(s, vrun, false);
+			vrun.clear();
+			spectatesend(s, event.data, true);
+		}
+		else
+			vrun.insert(vrun.end(), event.data.begin(), event.data.end());
+		s->events.pop_front();
+	}
+	if (!vrun.empty())
+		spectatesend(s, vrun, false);
+
+	// the table ended and everything it did is out
+	if (s->g == NULL && s->events.empty()) {
+		for (size_t n = 0; n < s->watchers.size(); n++) {
+			guser.getuser(s->watchers[n].userindex)->m_watchid = 0;
+			spectateanswer(s->watchers[n].userindex, 2, s->gameserial, 0);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+void spectateflush()
+{
+	for (size_t n = 0; n < vstreams.size();) {
+		if (spectateflushstream(vstreams[n])) {
+			n++;
+			continue;
+		}
+		delete vstreams[n];
+		vstreams[n] = vstreams.back();
+		vstreams.pop_back();
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "common.h"
+#include <deque>
+#include <vector>
+
+// watchers of a table. what every seat gets alike is public, the packets of game::broadcast and the
+// hidden side of a draw are copied into the stream of the table and reach the watchers "Spectate Delay
+// Seconds" later from the loop tick, never inline with the sends to the players. the events due at a
+// tick are joined in one block, encoded once per wire version and framing and added to the output of
+// every watcher by reference. a watcher with more than SPECTATE_MAX_BACKLOG bytes still unsent skips
+// the events until the next snapshot, the public table as it stood, which the stream takes every
+// SPECTATE_SNAPSHOT_MSEC while someone waits for one. a new watcher starts with a snapshot too
+
+#define SPECTATE_DEFAULT_DELAY_SEC 10
+#define SPECTATE_MAX_WATCHERS 64	// per table
+#define SPECTATE_MAX_BACKLOG (32 * 1024)
+#define SPECTATE_SNAPSHOT_MSEC 3000
+
+struct _SPECTATE_EVENT
+{
+	uint64_t due;
+	bool issnapshot;	// a whole table, a watcher that fell behind picks up from here
+	std::vector<unsigned char> data;	// v1 packets
+};
+
+struct _SPECTATE_WATCHER
+{
+	intptr_t userindex;
+	bool isbehind;	// only takes a snapshot
+};
+
+class game;
+
+// lives on the loop of its table, and after the table ended until its last events are out
+struct _SPECTATE_STREAM
+{
+	uint64_t id;	// _USER_INFO::m_watchid of its watchers
+	game* g;	// NULL once the table ended
+	int64_t gameserial;
+	std::deque<_SPECTATE_EVENT> events;
+	std::vector<_SPECTATE_WATCHER> watchers;
+	uint64_t snapshottick;	// next snapshot, 0 when nobody waits for one
+};
+
+// on the loop of the table, false with the refusal sent when it is not in play or has no room
+bool spectatewatch(game* g, intptr_t userindex);
+void spectateanswer(intptr_t userindex, unsigned char result, int64_t gameserial, unsigned char ectype);
+void spectatepush(_SPECTATE_STREAM* s, const unsigned char* data, int len);
+void spectateclose(game* g);	// the table ended, its stream drains on its own
+void spectateflush();	// from the loop tick, every stream of the calling loop
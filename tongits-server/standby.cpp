@@ -0,0 +1,456 @@
+#include "standby.h"
+#include "common.h"
+#include "conf.h"
+#include "gamectrl.h"
+#include "socket.h"
+#include "snapshot.h"
+#include <mutex>
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <thread>
+
+#define STANDBY_GAME_SIZE (sizeof(_STANDBY_FRAME) + sizeof(_SNAPSHOT_GAME))
+
+static struct event_base* standbybase = NULL;
+static struct event* standbytimer = NULL;
+static bool (*standbybindports)() = NULL;
+static std::atomic<bool> isprimary(false);
+static std::atomic<bool> iswaiting(false);	// a standby until it takes over
+
+static std::mutex standbylock;
+static std::map<int64_t, _SNAPSHOT_GAME> mstandbygames;	// the primary's live tables, or the copy a standby holds
+static std::set<int64_t> sstandbydirty;	// primary, to send, a serial no longer in mstandbygames was dropped
+static std::unordered_set<int64_t> sstandbytouched;	// primary, captures posted to their loop and not run yet
+
+// the primary, loop 0
+static struct bufferevent* standbybev = NULL;	// to the standby
+static std::atomic<bool> isstandbyup(false);	// connected, the events are captured
+static struct sockaddr_storage standbyaddr;
+static ev_socklen_t standbyaddrlen = 0;
+static uint64_t standbyretrytick = 0;
+static uint64_t standbybeattick = 0;
+static bool isstandbylost = false;	// a failed connect is logged once until one succeeds
+
+// the standby, loop 0
+static struct evconnlistener* standbylistener = NULL;
+static struct bufferevent* primarybev = NULL;	// the one primary it listens to, a new connection replaces it
+static bool isprimaryseen = false;	// a primary spoke since the start or since it stopped on purpose
+static bool isprimaryfresh = false;	// nothing was read from this connection yet
+static uint64_t primarytick = 0;	// clockmsec of the last frame
+static uint64_t primaryclock = 0;	// clockmsec of the primary in that frame
+
+static void standbysign(unsigned char* frame, _STANDBY_FRAME_TYPE type, int64_t serial, const _SNAPSHOT_GAME* s)
+{
+	_STANDBY_FRAME* header = (_STANDBY_FRAME*)frame;
+	size_t size = (s != NULL) ? STANDBY_GAME_SIZE : sizeof(_STANDBY_FRAME);
+
+	memset(header, 0, sizeof(_STANDBY_FRAME));
+	memcpy(header->magic, STANDBY_MAGIC, sizeof(header->magic));
+	header->version = STANDBY_VERSION;
+	header->type = (uint8_t)type;
+	header->gamesize = sizeof(_SNAPSHOT_GAME);
+	header->serial = serial;
+	header->wall = clockwallmsec();
+	header->tick = clockmsec();
+	if (s != NULL)
+		memcpy(header + 1, s, sizeof(_SNAPSHOT_GAME));
+	clustersign(frame, size, frame + size);
+}
+
+static void standbysend(_STANDBY_FRAME_TYPE type, int64_t serial, const _SNAPSHOT_GAME* s)
+{
+	unsigned char frame[STANDBY_GAME_SIZE + CLUSTER_MAC_SIZE];
+	size_t size = ((s != NULL) ? STANDBY_GAME_SIZE : sizeof(_STANDBY_FRAME)) + CLUSTER_MAC_SIZE;
+
+	standbysign(frame, type, serial, s);
+	bufferevent_write(standbybev, frame, size);
+	standbybeattick = clockmsec() + STANDBY_BEAT_MSEC;
+}
+
+// the tables that changed since the last pass, each once with its latest record
+static void standbyflush()
+{
+	if (evbuffer_get_length(bufferevent_get_output(standbybev)) > STANDBY_BACKLOG)
+		return;
+
+	std::vector<_SNAPSHOT_GAME> vgames;
+	std::vector<int64_t> vdrops;
+
+	standbylock.lock();
+	for (auto serial : sstandbydirty) {
+		auto iter = mstandbygames.find(serial);
+		if (iter != mstandbygames.end())
+			vgames.push_back(iter->second);
+		else
+			vdrops.push_back(serial);
+	}
+	sstandbydirty.clear();
+	standbylock.unlock();
+
+	for (size_t n = 0; n < vgames.size(); n++)
+		standbysend(_STANDBY_FRAME_TYPE::_GAME, vgames[n].serial, &vgames[n]);
+	for (size_t n = 0; n < vdrops.size(); n++)
+		standbysend(_STANDBY_FRAME_TYPE::_DROP, vdrops[n], NULL);
+
+	if (clockmsec() >= standbybeattick)
+		standbysend(_STANDBY_FRAME_TYPE::_BEAT, gcontrol.getactivegames(), NULL);
+}
+
+static void standbyclose()
+{
+	if (standbybev != NULL)
+		bufferevent_free(standbybev);
+	standbybev = NULL;
+	isstandbyup = false;
+	standbyretrytick = clockmsec() + STANDBY_RETRY_MSEC;
+}
+
+static void standbyeventcb(struct bufferevent* bev, short events, void* arg)
+{
+	clockrefresh();
+
+	if (events & BEV_EVENT_CONNECTED) {
+		// the standby starts over from whatever it had, every live table goes again
+		standbylock.lock();
+		for (auto iter = mstandbygames.begin(); iter != mstandbygames.end(); iter++)
+			sstandbydirty.insert(iter->first);
+		int tables = (int)mstandbygames.size();
+		standbylock.unlock();
+
+		isstandbyup = true;
+		isstandbylost = false;
+		MSGLOG(eMSGTYPE::INFO, "standby, connected to %s:%d, %d tables go over.", c.getstandbyhost().c_str(), c.getstandbyport(), tables);
+		return;
+	}
+
+	if (isstandbyup)
+		MSGLOG(eMSGTYPE::ERROR, "standby, connection to %s:%d lost, the tables have no copy until it is back.",
+			c.getstandbyhost().c_str(), c.getstandbyport());
+	else if (!isstandbylost)
+		MSGLOG(eMSGTYPE::ERROR, "standby, no connection to %s:%d, tried again every %d ms.",
+			c.getstandbyhost().c_str(), c.getstandbyport(), STANDBY_RETRY_MSEC);
+	isstandbylost = true;
+	standbyclose();
+}
+
+// the standby sends nothing, whatever comes is dropped
+static void standbyreadcb(struct bufferevent* bev, void* arg)
+{
+	struct evbuffer* input = bufferevent_get_input(bev);
+	evbuffer_drain(input, evbuffer_get_length(input));
+}
+
+static void standbyconnect()
+{
+	standbybev = bufferevent_socket_new(standbybase, -1, BEV_OPT_CLOSE_ON_FREE);
+	if (standbybev == NULL) {
+		standbyclose();
+		return;
+	}
+
+	struct timeval tv = { STANDBY_TIMEOUT_MSEC / 1000, (STANDBY_TIMEOUT_MSEC % 1000) * 1000 };
+	bufferevent_setcb(standbybev, standbyreadcb, NULL, standbyeventcb, NULL);
+	bufferevent_set_timeouts(standbybev, NULL, &tv);
+	bufferevent_enable(standbybev, EV_READ | EV_WRITE);
+	if (bufferevent_socket_connect(standbybev, (struct sockaddr*)&standbyaddr, (int)standbyaddrlen) != 0)
+		standbyeventcb(standbybev, BEV_EVENT_ERROR, NULL);
+}
+
+static void primaryclose()
+{
+	if (primarybev != NULL)
+		bufferevent_free(primarybev);
+	primarybev = NULL;
+}
+
+// the copy of the primary's tables seated here, then the game ports are taken
+static void standbytakeover()
+{
+	std::vector<_SNAPSHOT_GAME> vgames;
+
+	iswaiting = false;
+	primaryclose();
+	if (standbylistener != NULL)
+		evconnlistener_free(standbylistener);
+	standbylistener = NULL;
+
+	standbylock.lock();
+	vgames.reserve(mstandbygames.size());
+	for (auto iter = mstandbygames.begin(); iter != mstandbygames.end(); iter++)
+		vgames.push_back(iter->second);
+	mstandbygames.clear();
+	standbylock.unlock();
+
+	// the times of the records are on the primary's clock and the tables stood still from its last frame
+	int64_t shift = (int64_t)clockmsec() - (int64_t)primaryclock;
+	int restored = gcontrol.restoregames(vgames.data(), vgames.size(), shift);
+
+	MSGLOG(eMSGTYPE::ERROR, "standby, no word from the primary for %llu ms, %d of its %d tables taken over.",
+		(unsigned long long)(clockmsec() - primarytick), restored, (int)vgames.size());
+
+	if (!standbybindports())
+		MSGLOG(eMSGTYPE::ERROR, "standby, the game ports could not be taken, the tables wait for a restart.");
+}
+
+// a signed frame of the primary, false to drop the connection
+static bool standbyapply(const unsigned char* frame, size_t size)
+{
+	const _STANDBY_FRAME* header = (const _STANDBY_FRAME*)frame;
+
+	if (!clusterverify(frame, size, frame + size))
+		return false;
+	if (header->wall < clockwallmsec() - STANDBY_SKEW_MSEC || header->wall > clockwallmsec() + STANDBY_SKEW_MSEC) {
+		MSGLOG(eMSGTYPE::ERROR, "standby, a frame %lld ms off the clock here, refused.", (long long)(header->wall - clockwallmsec()));
+		return false;
+	}
+
+	if (!isprimaryseen)
+		MSGLOG(eMSGTYPE::INFO, "standby, the primary is up, its tables are held here.");
+	isprimaryseen = true;
+	primarytick = clockmsec();
+	primaryclock = header->tick;
+
+	standbylock.lock();
+	// what it had may hold tables that went away meanwhile, the primary sends every live one again
+	if (isprimaryfresh)
+		mstandbygames.clear();
+	isprimaryfresh = false;
+
+	switch ((_STANDBY_FRAME_TYPE)header->type) {
+	case _STANDBY_FRAME_TYPE::_GAME:
+		mstandbygames[header->serial] = *(const _SNAPSHOT_GAME*)(header + 1);
+		break;
+	case _STANDBY_FRAME_TYPE::_DROP:
+		mstandbygames.erase(header->serial);
+		break;
+	case _STANDBY_FRAME_TYPE::_STOP:
+		mstandbygames.clear();
+		isprimaryseen = false;
+		break;
+	default:
+		break;
+	}
+	standbylock.unlock();
+
+	if (!isprimaryseen)
+		MSGLOG(eMSGTYPE::INFO, "standby, the primary stopped on purpose, its tables are dropped here.");
+	return true;
+}
+
+static void primaryreadcb(struct bufferevent* bev, void* arg)
+{
+	struct evbuffer* input = bufferevent_get_input(bev);
+	unsigned char frame[STANDBY_GAME_SIZE + CLUSTER_MAC_SIZE];
+
+	clockrefresh();
+
+	while (evbuffer_get_length(input) >= sizeof(_STANDBY_FRAME)) {
+		_STANDBY_FRAME header;
+		evbuffer_copyout(input, &header, sizeof(header));
+
+		if (memcmp(header.magic, STANDBY_MAGIC, sizeof(header.magic)) != 0 || header.version != STANDBY_VERSION
+			|| header.gamesize != sizeof(_SNAPSHOT_GAME)) {
+			MSGLOG(eMSGTYPE::ERROR, "standby, a primary of another build was refused.");
+			primaryclose();
+			return;
+		}
+
+		size_t size = (header.type == (uint8_t)_STANDBY_FRAME_TYPE::_GAME) ? STANDBY_GAME_SIZE : sizeof(_STANDBY_FRAME);
+		if (evbuffer_get_length(input) < size + CLUSTER_MAC_SIZE)
+			return;
+
+		evbuffer_remove(input, frame, size + CLUSTER_MAC_SIZE);
+		if (!standbyapply(frame, size)) {
+			primaryclose();
+			return;
+		}
+	}
+}
+
+static void primaryeventcb(struct bufferevent* bev, short events, void* arg)
+{
+	// the timeout takes over, a primary that restarts its connection is back before it
+	if (isprimaryseen)
+		MSGLOG(eMSGTYPE::ERROR, "standby, connection of the primary lost, it takes over in %d ms unless it is back.", STANDBY_TIMEOUT_MSEC);
+	primaryclose();
+}
+
+static void primaryacceptcb(struct evconnlistener*, evutil_socket_t fd, struct sockaddr*, int, void*)
+{
+	primaryclose();
+	isprimaryfresh = true;
+
+	primarybev = bufferevent_socket_new(standbybase, fd, BEV_OPT_CLOSE_ON_FREE);
+	if (primarybev == NULL) {
+		evutil_closesocket(fd);
+		return;
+	}
+	bufferevent_setcb(primarybev, primaryreadcb, NULL, primaryeventcb, NULL);
+	bufferevent_enable(primarybev, EV_READ);
+}
+
+static void standbytimercb(evutil_socket_t, short, void*)
+{
+	clockrefresh();
+
+	if (iswaiting) {
+		if (isprimaryseen && clockmsec() - primarytick >= STANDBY_TIMEOUT_MSEC)
+			standbytakeover();
+		return;
+	}
+
+	if (standbybev == NULL && clockmsec() >= standbyretrytick)
+		standbyconnect();
+	else if (isstandbyup)
+		standbyflush();
+}
+
+bool standbystart(struct event_base* base, bool (*bindports)())
+{
+	std::string role = c.getstandbyrole();
+
+	standbybase = base;
+	standbybindports = bindports;
+
+	if (role.empty())
+		return true;
+
+	if (role != "primary" && role != "standby") {
+		MSGLOG(eMSGTYPE::ERROR, "standby, Standby Role is primary or standby, not %s.", role.c_str());
+		return false;
+	}
+
+	// the frames are signed with the key of the cluster
+	if (clusterrole() == _CLUSTER_ROLE::_NONE || c.getstandbyport() == 0) {
+		MSGLOG(eMSGTYPE::ERROR, "standby, Standby Role needs a Cluster Role and a Standby Port.");
+		if (role == "standby")
+			bindports();
+		return false;
+	}
+
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(c.getstandbyport());
+
+	if (role == "standby") {
+		standbylistener = evconnlistener_new_bind(base, primaryacceptcb, NULL, LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, -1,
+			(struct sockaddr*)&sin, sizeof(sin));
+		if (standbylistener == NULL) {
+			MSGLOG(eMSGTYPE::ERROR, "standby, evconnlistener_new_bind failed at standby port %d, serving as a server on its own.", c.getstandbyport());
+			bindports();
+			return false;
+		}
+		iswaiting = true;
+		MSGLOG(eMSGTYPE::INFO, "standby, waiting for the primary at tcp port %d, the game ports are taken when it is gone.", c.getstandbyport());
+	}
+	else {
+		struct evutil_addrinfo hints;
+		struct evutil_addrinfo* answer = NULL;
+		char service[8];
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		snprintf(service, sizeof(service), "%d", c.getstandbyport());
+
+		if (evutil_getaddrinfo(c.getstandbyhost().c_str(), service, &hints, &answer) != 0 || answer == NULL) {
+			MSGLOG(eMSGTYPE::ERROR, "standby, Standby Host %s does not resolve, the tables have no copy.", c.getstandbyhost().c_str());
+			return false;
+		}
+		memcpy(&standbyaddr, answer->ai_addr, answer->ai_addrlen);
+		standbyaddrlen = (ev_socklen_t)answer->ai_addrlen;
+		evutil_freeaddrinfo(answer);
+		isprimary = true;
+		MSGLOG(eMSGTYPE::INFO, "standby, the tables are copied to %s:%d.", c.getstandbyhost().c_str(), c.getstandbyport());
+	}
+
+	struct timeval tv = { 0, STANDBY_SEND_MSEC * 1000 };
+	standbytimer = event_new(base, -1, EV_PERSIST, standbytimercb, NULL);
+	event_add(standbytimer, &tv);
+	return true;
+}
+
+// the standby is told the primary stops on purpose, the loops are stopped so the socket is written here
+void standbystop()
+{
+	if (standbytimer != NULL)
+		event_free(standbytimer);
+	standbytimer = NULL;
+
+	if (isstandbyup) {
+		struct evbuffer* output = bufferevent_get_output(standbybev);
+		evutil_socket_t fd = bufferevent_getfd(standbybev);
+
+		standbysend(_STANDBY_FRAME_TYPE::_STOP, 0, NULL);
+		for (int n = 0; n < 100 && evbuffer_get_length(output) > 0; n++) {
+			if (evbuffer_write(output, fd) <= 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+	if (standbybev != NULL)
+		bufferevent_free(standbybev);
+	standbybev = NULL;
+	isstandbyup = false;
+	isprimary = false;
+
+	primaryclose();
+	if (standbylistener != NULL)
+		evconnlistener_free(standbylistener);
+	standbylistener = NULL;
+}
+
+bool standbyiswaiting()
+{
+	return iswaiting;
+}
+
+void standbyput(const _SNAPSHOT_GAME& s)
+{
+	if (!isprimary)
+		return;
+
+	standbylock.lock();
+	mstandbygames[s.serial] = s;
+	sstandbydirty.insert(s.serial);
+	standbylock.unlock();
+}
+
+void standbydrop(int64_t serial)
+{
+	if (!isprimary)
+		return;
+
+	standbylock.lock();
+	if (mstandbygames.erase(serial) != 0)
+		sstandbydirty.insert(serial);
+	standbylock.unlock();
+}
+
+void standbytouch(int64_t serial, int loop)
+{
+	if (!isstandbyup || serial <= 0)
+		return;
+
+	standbylock.lock();
+	bool isposted = sstandbytouched.insert(serial).second;
+	standbylock.unlock();
+
+	if (!isposted)
+		return;
+
+	le_postloop(loop, [serial, loop]() {
+		standbylock.lock();
+		sstandbytouched.erase(serial);
+		standbylock.unlock();
+
+		game* g = gcontrol.getgame(serial);
+		_SNAPSHOT_GAME s;
+
+		if (g == NULL || g->getloop() != loop || g->getstate() == _GAME_STATE::_FREE || g->getstate() == _GAME_STATE::_ENDED)
+			return;
+		if (g->savesnapshot(s))
+			standbyput(s);
+	});
+}
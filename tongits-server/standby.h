@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include "cluster.h"
+
+struct _SNAPSHOT_GAME;
+
+// a second server that holds a copy of the live tables and takes over when the primary dies. the primary
+// ("Standby Role: primary") keeps a tcp connection to "Standby Host":"Standby Port" and sends it the
+// snapshot record of a table after every game event, on its SNAPSHOT_MSEC capture and right away on a
+// settle, and a drop when the table is let go. the records are coalesced by serial, a table that changed
+// twice before the next send goes once, and every frame is signed with the Token Secret. the standby
+// ("Standby Role: standby") binds no game port, sends no cluster heartbeat and restores no snapshot file.
+// it keeps the last record of each table and once the primary is silent for STANDBY_TIMEOUT_MSEC it
+// seats them under their serials with the same loadgame a restart uses, then binds the game ports. the
+// players log in again and resume their seats, behind a router the session directory sends them here
+//
+// a primary that stops on purpose tells the standby, which drops its copy and waits for the next one. a
+// standby that has not heard a primary since it started never takes over. the old primary must not come
+// back as a primary after a takeover, it has the same tables in its snapshot file: it is started as the
+// standby of the new one. the records are the raw struct of snapshot.h, both run the same build
+
+#define STANDBY_MAGIC "TGSB"
+#define STANDBY_VERSION 1
+#define STANDBY_SEND_MSEC 50	// changed tables go out this often
+#define STANDBY_BEAT_MSEC 500	// a frame at least this often while the primary is up
+#define STANDBY_TIMEOUT_MSEC 3000	// the standby takes over after this long without one
+#define STANDBY_RETRY_MSEC 1000	// the primary connects again after
+#define STANDBY_BACKLOG (4 << 20)	// bytes of output the primary lets pile up before it waits
+#define STANDBY_SKEW_MSEC 30000	// a frame older than this by the wall clock of its sender is a replay
+
+enum class _STANDBY_FRAME_TYPE : uint8_t
+{
+	_GAME = 0,	// a _SNAPSHOT_GAME follows
+	_DROP,
+	_BEAT,
+	_STOP,	// the primary is going down on purpose
+};
+
+// followed by the record of a _GAME and the mac of both
+struct _STANDBY_FRAME
+{
+	char magic[4];
+	uint16_t version;
+	uint8_t type;	// _STANDBY_FRAME_TYPE
+	uint8_t reserved;
+	uint32_t gamesize;	// sizeof(_SNAPSHOT_GAME) of the sender
+	uint32_t reserved2;
+	int64_t serial;	// of the table, the table count of a beat
+	int64_t wall;	// clockwallmsec of the sender
+	uint64_t tick;	// clockmsec of the sender
+};
+
+static_assert(sizeof(_STANDBY_FRAME) == 40, "_STANDBY_FRAME keeps the record 8 byte aligned");
+
+bool standbystart(struct event_base* base, bool (*bindports)());	// after clusterstart, bindports is called at a takeover
+void standbystop();
+bool standbyiswaiting();	// a standby that has not taken over, it binds no game port
+
+// the primary, from any loop
+void standbyput(const _SNAPSHOT_GAME& s);
+void standbydrop(int64_t serial);
+void standbytouch(int64_t serial, int loop);	// a game event, the table is captured on its loop once the event is done
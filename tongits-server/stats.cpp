@@ -0,0 +1,229 @@
+#include "stats.h"
+#include "common.h"
+
+// only the owning thread writes a counter, the relaxed atomics just let a reader see whole values
+struct _STATS_COUNTER
+{
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> totalusec;
+	std::atomic<uint64_t> maxusec;
+	std::atomic<uint64_t> buckets[STATS_BUCKETS];
+};
+
+// the ticks follow the opcodes, the game states follow the ticks
+#define STATS_TICKS STATS_OPCODES
+#define STATS_STATES (STATS_TICKS + (int)_STATS_TICK::_MAX)
+#define STATS_COUNTERS (STATS_STATES + STATS_GAMESTATES)
+
+static const char gamestatenames[STATS_GAMESTATES][12] = {
+	"none",
+	"notice",
+	"prepare",
+	"waiting",
+	"started",
+	"restarted",
+	"closed",
+	"ended",
+	"free"
+};
+
+struct _STATS_TABLE
+{
+	_STATS_COUNTER counters[STATS_COUNTERS];
+};
+
+// a table lives as long as the process, the threads that count are the loops and they never end before it
+static std::mutex statslock;
+static std::vector<_STATS_TABLE*> vstatstables;
+static thread_local _STATS_TABLE* statstable = NULL;
+
+static _STATS_TABLE* statsgettable()
+{
+	if (statstable == NULL) {
+		statstable = new _STATS_TABLE();
+		statslock.lock();
+		vstatstables.push_back(statstable);
+		statslock.unlock();
+	}
+	return statstable;
+}
+
+static void statsadd(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static int statsbucket(uint64_t usec)
+{
+	int n = 0;
+
+	while (usec != 0 && n < STATS_BUCKETS - 1) {
+		usec >>= 1;
+		n++;
+	}
+	return n;
+}
+
+static void statscount(_STATS_COUNTER& counter, int bytes, uint64_t usec)
+{
+	statsadd(counter.calls, 1);
+	statsadd(counter.bytes, bytes);
+	statsadd(counter.totalusec, usec);
+	if (usec > counter.maxusec.load(std::memory_order_relaxed))
+		counter.maxusec.store(usec, std::memory_order_relaxed);
+	statsadd(counter.buckets[statsbucket(usec)], 1);
+}
+
+uint64_t statsusec()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void statsopcode(int opcode, int bytes, uint64_t usec)
+{
+	if (opcode < 0 || opcode >= STATS_OPCODES)
+		return;
+	statscount(statsgettable()->counters[opcode], bytes, usec);
+}
+
+void statstick(_STATS_TICK tick, uint64_t usec)
+{
+	statscount(statsgettable()->counters[STATS_TICKS + (int)tick], 0, usec);
+}
+
+void statsgamestate(int state, uint64_t usec)
+{
+	if (state < 0 || state >= STATS_GAMESTATES)
+		return;
+	statscount(statsgettable()->counters[STATS_STATES + state], 0, usec);
+}
+
+const char* statsgamestatename(int state)
+{
+	return (state >= 0 && state < STATS_GAMESTATES) ? gamestatenames[state] : "unknown";
+}
+
+// bucket n holds latencies below 2^n usec
+static uint64_t statspercentile(const uint64_t* buckets, uint64_t calls, int percent)
+{
+	uint64_t rank = (calls * percent + 99) / 100;
+	uint64_t seen = 0;
+
+	for (int n = 0; n < STATS_BUCKETS; n++) {
+		seen += buckets[n];
+		if (seen >= rank)
+			return (uint64_t)1 << n;
+	}
+	return (uint64_t)1 << (STATS_BUCKETS - 1);
+}
+
+static void statssum(int index, _STATS_SUMMARY& summary, uint64_t* buckets)
+{
+	memset(&summary, 0, sizeof(summary));
+	memset(buckets, 0, sizeof(uint64_t) * STATS_BUCKETS);
+
+	statslock.lock();
+	for (size_t n = 0; n < vstatstables.size(); n++) {
+		_STATS_COUNTER& counter = vstatstables[n]->counters[index];
+		summary.calls += counter.calls.load(std::memory_order_relaxed);
+		summary.bytes += counter.bytes.load(std::memory_order_relaxed);
+		summary.totalusec += counter.totalusec.load(std::memory_order_relaxed);
+		uint64_t maxusec = counter.maxusec.load(std::memory_order_relaxed);
+		if (maxusec > summary.maxusec)
+			summary.maxusec = maxusec;
+		for (int b = 0; b < STATS_BUCKETS; b++)
+			buckets[b] += counter.buckets[b].load(std::memory_order_relaxed);
+	}
+	statslock.unlock();
+
+	if (summary.calls == 0)
+		return;
+
+	summary.p50usec = statspercentile(buckets, summary.calls, 50);
+	summary.p99usec = statspercentile(buckets, summary.calls, 99);
+}
+
+void statsgetopcode(int opcode, _STATS_SUMMARY& summary)
+{
+	uint64_t buckets[STATS_BUCKETS];
+
+	if (opcode < 0 || opcode >= STATS_OPCODES) {
+		memset(&summary, 0, sizeof(summary));
+		return;
+	}
+	statssum(opcode, summary, buckets);
+}
+
+void statsgettick(_STATS_TICK tick, _STATS_SUMMARY& summary)
+{
+	uint64_t buckets[STATS_BUCKETS];
+
+	statssum(STATS_TICKS + (int)tick, summary, buckets);
+}
+
+static void statsline(std::string& out, const char* name, const _STATS_SUMMARY& summary)
+{
+	char szBuffer[256];
+
+	snprintf(szBuffer, sizeof(szBuffer), "%s calls %llu bytes %llu avg %llu p50 %llu p99 %llu max %llu usec\n", name,
+		(unsigned long long)summary.calls, (unsigned long long)summary.bytes,
+		(unsigned long long)(summary.totalusec / summary.calls), (unsigned long long)summary.p50usec,
+		(unsigned long long)summary.p99usec, (unsigned long long)summary.maxusec);
+	out += szBuffer;
+}
+
+// the whole histogram of a counter, how the tick cost moves with the number of tables
+static void statsbuckets(std::string& out, const char* name, const uint64_t* buckets)
+{
+	char szBuffer[64];
+
+	out += name;
+	out += " usec";
+	for (int n = 0; n < STATS_BUCKETS; n++) {
+		if (buckets[n] == 0)
+			continue;
+		snprintf(szBuffer, sizeof(szBuffer), " <%llu:%llu", (unsigned long long)1 << n, (unsigned long long)buckets[n]);
+		out += szBuffer;
+	}
+	out += "\n";
+}
+
+// one line per counter that was ever hit
+std::string statsdump()
+{
+	static const char ticknames[(int)_STATS_TICK::_MAX][16] = {
+		"game run",
+		"loop run"
+	};
+	std::string out;
+	_STATS_SUMMARY summary;
+	uint64_t buckets[STATS_BUCKETS];
+	char szName[32];
+
+	for (int n = 0; n < STATS_OPCODES; n++) {
+		statsgetopcode(n, summary);
+		if (summary.calls == 0)
+			continue;
+		snprintf(szName, sizeof(szName), "0x%X 0x%02X", 0xF1 + (n >> 4), n & 0x0F);
+		statsline(out, szName, summary);
+	}
+
+	for (int n = 0; n < (int)_STATS_TICK::_MAX; n++) {
+		statssum(STATS_TICKS + n, summary, buckets);
+		if (summary.calls == 0)
+			continue;
+		statsline(out, ticknames[n], summary);
+		statsbuckets(out, ticknames[n], buckets);
+	}
+
+	for (int n = 0; n < STATS_GAMESTATES; n++) {
+		statssum(STATS_STATES + n, summary, buckets);
+		if (summary.calls == 0)
+			continue;
+		snprintf(szName, sizeof(szName), "game run %.11s", gamestatenames[n]);
+		statsline(out, szName, summary);
+	}
+	return out;
+}
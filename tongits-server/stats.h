@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// call counts, bytes and latencies of every request and of the loop ticks. each thread counts into its
+// own table without a lock, the tables are only summed when someone asks. a latency lands in a power
+// of two bucket of microseconds, enough to tell a p99 from the median without keeping samples
+
+#define STATS_OPCODES 64	// head 0xF1 to 0xF4, 16 subs each
+#define STATS_BUCKETS 24	// the last one also takes everything slower than 2^22 usec
+#define STATS_GAMESTATES 9	// _GAME_STATE::_NONE to _FREE
+
+#define STATS_OPCODE(head, sub) ((((head) - 0xF1) << 4) | (sub))
+
+enum class _STATS_TICK
+{
+	_GAMERUN = 0,	// one game timer callback
+	_CTRLRUN,	// one loop timer callback
+	_MAX
+};
+
+struct _STATS_SUMMARY
+{
+	uint64_t calls;
+	uint64_t bytes;
+	uint64_t totalusec;
+	uint64_t maxusec;
+	uint64_t p50usec;	// upper bound of the bucket
+	uint64_t p99usec;
+};
+
+uint64_t statsusec();
+void statsopcode(int opcode, int bytes, uint64_t usec);
+void statstick(_STATS_TICK tick, uint64_t usec);
+void statsgamestate(int state, uint64_t usec);	// a game timer callback by the state the table was in
+const char* statsgamestatename(int state);
+void statsgetopcode(int opcode, _STATS_SUMMARY& summary);
+void statsgettick(_STATS_TICK tick, _STATS_SUMMARY& summary);
+std::string statsdump();
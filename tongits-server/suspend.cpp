@@ -0,0 +1,338 @@
+#include "suspend.h"
+#include "common.h"
+#include "gamectrl.h"
+#include "socket.h"
+#include "sessiondir.h"
+#include "taskpool.h"
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+
+// a record of the store, loop 0
+struct _SUSPEND_ENTRY
+{
+	int64_t serial;	// of the table when it was held
+	int64_t tokens[MAX_USER_POS];	// 0 for a seat without one
+	uint64_t heldtick;
+	int64_t heldtime;
+	std::shared_ptr<_SNAPSHOT_GAME> game;	// until its write is done, a read back takes it from here
+	std::vector<std::function<void(bool)>> waiters;	// logins of its players while it is read
+	bool isused;
+	bool iswriting;
+	bool isreading;
+};
+
+static std::vector<_SUSPEND_ENTRY> suspendslots;	// by the place of the record in the file
+static std::vector<int> suspendfree;	// cleared on disk, a write may take them
+static std::unordered_map<int64_t, int> suspendtokens;
+static uint64_t suspendscantick = 0;
+static std::atomic<uint64_t> suspendedtotal(0);
+static std::atomic<uint64_t> suspendresumed(0);
+static std::atomic<uint64_t> suspendexpired(0);
+
+static uint32_t suspendchecksum(const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	uint32_t hash = 2166136261u;
+
+	for (size_t n = 0; n < size; n++) {
+		hash ^= p[n];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static long suspendoffset(int slot)
+{
+	return (long)slot * (long)(sizeof(_SUSPEND_HEADER) + sizeof(_SNAPSHOT_GAME));
+}
+
+// the pool threads open the file for each record, two of them never share a place. s is NULL for a clear
+static bool suspendwrite(int slot, const _SUSPEND_HEADER& header, const _SNAPSHOT_GAME* s)
+{
+	FILE* fp = fopen(SUSPEND_FILE, "r+b");
+
+	if (fp == NULL) {
+		MSGLOG(ERROR, "suspendwrite, failed to open %s.", SUSPEND_FILE);
+		return false;
+	}
+
+	bool iswritten = fseek(fp, suspendoffset(slot), SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1
+		&& (s == NULL || fwrite(s, sizeof(_SNAPSHOT_GAME), 1, fp) == 1);
+
+	if (fclose(fp) != 0)
+		iswritten = false;
+
+	if (!iswritten)
+		MSGLOG(ERROR, "suspendwrite, failed to write record %d of %s.", slot, SUSPEND_FILE);
+	return iswritten;
+}
+
+static bool suspendread(FILE* fp, _SUSPEND_HEADER& header, _SNAPSHOT_GAME& s)
+{
+	if (fread(&header, sizeof(header), 1, fp) != 1 || fread(&s, sizeof(s), 1, fp) != 1)
+		return false;
+
+	return memcmp(header.magic, SUSPEND_MAGIC, sizeof(header.magic)) == 0 && header.version == SUSPEND_VERSION
+		&& header.gamesize == sizeof(_SNAPSHOT_GAME) && header.checksum == suspendchecksum(&s, sizeof(s));
+}
+
+// a slot is taken again only once its clear is on disk
+static void suspendclear(int slot)
+{
+	_SUSPEND_HEADER header;
+	memset(&header, 0, sizeof(header));
+
+	tasksubmit(_TASK_LANE::_NORMAL, [slot, header]() { suspendwrite(slot, header, NULL); }, [slot]() {
+		suspendfree.push_back(slot);
+	});
+}
+
+static void suspenddrop(int slot)
+{
+	_SUSPEND_ENTRY& e = suspendslots[slot];
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		auto iter = suspendtokens.find(e.tokens[i]);
+		if (iter != suspendtokens.end() && iter->second == slot)
+			suspendtokens.erase(iter);
+	}
+
+	e.isused = false;
+	e.game.reset();
+	if (!e.iswriting)
+		suspendclear(slot);
+}
+
+static void suspenddone(int slot, bool isseated)
+{
+	std::vector<std::function<void(bool)>> waiters;
+	waiters.swap(suspendslots[slot].waiters);
+
+	for (size_t n = 0; n < waiters.size(); n++)
+		waiters[n](isseated);
+}
+
+static void suspendseat(int slot, const _SNAPSHOT_GAME& s, bool isexpired)
+{
+	_SUSPEND_ENTRY& e = suspendslots[slot];
+	int64_t shift = (int64_t)clockmsec() - (int64_t)e.heldtick;
+	int64_t serial = gcontrol.importgame(s, shift, isexpired);
+
+	// no slot for it now, the record waits for the next login or scan
+	if (serial == 0) {
+		MSGLOG(ERROR, "suspendseat, no game slot for suspended table %lld.", (long long)e.serial);
+		suspenddone(slot, false);
+		return;
+	}
+
+	MSGLOG(INFO, "suspendseat, suspended table %lld is back as %lld%s.", (long long)e.serial, (long long)serial,
+		isexpired ? " to play out its hand" : "");
+	if (isexpired)
+		suspendexpired++;
+	else
+		suspendresumed++;
+
+	suspenddrop(slot);
+	suspenddone(slot, true);
+}
+
+static void suspendload(int slot, std::function<void(bool)> done, bool isexpired)
+{
+	_SUSPEND_ENTRY& e = suspendslots[slot];
+
+	if (done)
+		e.waiters.push_back(done);
+	if (e.isreading)
+		return;
+
+	if (e.game != nullptr) {
+		std::shared_ptr<_SNAPSHOT_GAME> s = e.game;
+		suspendseat(slot, *s, isexpired);
+		return;
+	}
+
+	std::shared_ptr<_SNAPSHOT_GAME> s = std::make_shared<_SNAPSHOT_GAME>();
+	std::shared_ptr<_SUSPEND_HEADER> header = std::make_shared<_SUSPEND_HEADER>();
+	std::shared_ptr<bool> isread = std::make_shared<bool>(false);
+	e.isreading = true;
+
+	tasksubmit(isexpired ? _TASK_LANE::_NORMAL : _TASK_LANE::_HIGH, [slot, s, header, isread]() {
+		FILE* fp = fopen(SUSPEND_FILE, "rb");
+		if (fp == NULL)
+			return;
+		*isread = fseek(fp, suspendoffset(slot), SEEK_SET) == 0 && suspendread(fp, *header, *s);
+		fclose(fp);
+	}, [slot, s, header, isread, isexpired]() {
+		_SUSPEND_ENTRY& e = suspendslots[slot];
+		e.isreading = false;
+
+		if (*isread && header->heldtick == e.heldtick) {
+			suspendseat(slot, *s, isexpired);
+			return;
+		}
+
+		// the table is lost, its players are told they have none
+		MSGLOG(ERROR, "suspendload, record %d of %s for table %lld is damaged, dropped.", slot, SUSPEND_FILE, (long long)e.serial);
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			if (e.tokens[i] != 0 && gcontrol.getsessionuserid((uintptr_t)e.tokens[i]) == 0)
+				sessiondel(e.tokens[i]);
+		}
+		suspenddrop(slot);
+		suspenddone(slot, false);
+	});
+}
+
+static int suspendindex(int slot, const _SNAPSHOT_GAME& s, uint64_t heldtick, int64_t heldtime)
+{
+	_SUSPEND_ENTRY& e = suspendslots[slot];
+	int players = 0;
+
+	e.serial = s.serial;
+	e.heldtick = heldtick;
+	e.heldtime = heldtime;
+	e.isused = true;
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		e.tokens[i] = s.users[i].isbot ? 0 : s.users[i].token;
+		if (e.tokens[i] == 0)
+			continue;
+		suspendtokens[e.tokens[i]] = slot;
+		sessionput(e.tokens[i], s.serial, i);
+		players++;
+	}
+	return players;
+}
+
+void suspendstart(bool isread)
+{
+	FILE* fp = isread ? fopen(SUSPEND_FILE, "rb") : NULL;
+	int records = 0;
+	int kept = 0;
+
+	if (fp != NULL && fseek(fp, 0, SEEK_END) == 0)
+		records = (int)(ftell(fp) / suspendoffset(1));
+
+	_SUSPEND_HEADER header;
+	std::unique_ptr<_SNAPSHOT_GAME> s(new _SNAPSHOT_GAME());
+
+	for (int slot = 0; slot < records; slot++) {
+		suspendslots.push_back(_SUSPEND_ENTRY());
+
+		// a record of a table without players is never asked for, its place is written over
+		if (fseek(fp, suspendoffset(slot), SEEK_SET) == 0 && suspendread(fp, header, *s)
+			&& suspendindex(slot, *s, header.heldtick, header.heldtime) > 0)
+			kept++;
+		else {
+			suspendslots[slot].isused = false;
+			suspendfree.push_back(slot);
+		}
+	}
+
+	if (fp != NULL)
+		fclose(fp);
+
+	if (kept > 0)
+		MSGLOG(INFO, "%d suspended tables are kept in %s.", kept, SUSPEND_FILE);
+
+	// a standby or a trace starts with an empty store
+	if (records == 0) {
+		fp = fopen(SUSPEND_FILE, "wb");
+		if (fp != NULL)
+			fclose(fp);
+		else
+			MSGLOG(ERROR, "suspendstart, failed to create %s.", SUSPEND_FILE);
+	}
+}
+
+void suspendput(std::shared_ptr<_SNAPSHOT_GAME> s, uint64_t heldtick)
+{
+	// after the session ends the table posted on its way out
+	if (le_getloop() != 0) {
+		le_post([s, heldtick]() { suspendput(s, heldtick); });
+		return;
+	}
+
+	int slot;
+	if (!suspendfree.empty()) {
+		slot = suspendfree.back();
+		suspendfree.pop_back();
+	}
+	else {
+		slot = (int)suspendslots.size();
+		suspendslots.push_back(_SUSPEND_ENTRY());
+	}
+
+	_SUSPEND_ENTRY& e = suspendslots[slot];
+	e = _SUSPEND_ENTRY();
+	e.game = s;
+	e.iswriting = true;
+	suspendindex(slot, *s, heldtick, clockwallmsec() - (int64_t)(clockmsec() - heldtick));
+	suspendedtotal++;
+
+	_SUSPEND_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SUSPEND_MAGIC, sizeof(header.magic));
+	header.version = SUSPEND_VERSION;
+	header.gamesize = sizeof(_SNAPSHOT_GAME);
+	header.checksum = suspendchecksum(s.get(), sizeof(_SNAPSHOT_GAME));
+	header.heldtick = e.heldtick;
+	header.heldtime = e.heldtime;
+
+	std::shared_ptr<bool> iswritten = std::make_shared<bool>(false);
+	tasksubmit(_TASK_LANE::_NORMAL, [slot, header, s, iswritten]() { *iswritten = suspendwrite(slot, header, s.get()); },
+		[slot, iswritten]() {
+		_SUSPEND_ENTRY& e = suspendslots[slot];
+		e.iswriting = false;
+		// read back while it was written, or the write failed and the record lives on in memory
+		if (!e.isused)
+			suspendclear(slot);
+		else if (*iswritten)
+			e.game.reset();
+	});
+
+	MSGLOG(INFO, "suspendput, table %lld is suspended to record %d of %s.", (long long)s->serial, slot, SUSPEND_FILE);
+}
+
+bool suspendresume(int64_t token, std::function<void(bool)> done)
+{
+	auto iter = suspendtokens.find(token);
+
+	if (iter == suspendtokens.end())
+		return false;
+
+	suspendload(iter->second, done, false);
+	return true;
+}
+
+void suspendrun()
+{
+	if (clockmsec() < suspendscantick)
+		return;
+	suspendscantick = clockmsec() + SUSPEND_SCAN_MSEC;
+
+	int64_t now = clockwallmsec();
+	int loads = 0;
+
+	for (int slot = 0; slot < (int)suspendslots.size() && loads < SUSPEND_EXPIRE_BATCH; slot++) {
+		_SUSPEND_ENTRY& e = suspendslots[slot];
+		if (!e.isused || e.isreading || now < e.heldtime + SUSPEND_KEEP_MSEC)
+			continue;
+		if (!gcontrol.hasgameslot())
+			break;
+		suspendload(slot, nullptr, true);
+		loads++;
+	}
+}
+
+void suspendstats(_SUSPEND_STATS& stats)
+{
+	stats.suspended = suspendedtotal.load();
+	stats.resumed = suspendresumed.load();
+	stats.expired = suspendexpired.load();
+	stats.kept = 0;
+	for (size_t n = 0; n < suspendslots.size(); n++) {
+		if (suspendslots[n].isused)
+			stats.kept++;
+	}
+}
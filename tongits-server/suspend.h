@@ -0,0 +1,52 @@
+#pragma once
+#include "snapshot.h"
+#include <memory>
+#include <functional>
+
+// tables nobody is at any more, kept on disk instead of in a game slot. a table of _STARTED whose three
+// seats are all disconnected is held by its loop, it neither plays their turns nor closes, and once
+// "Suspend Seconds" pass without one of them back its record goes to SUSPEND_FILE and the slot is let go.
+// the session directory still has its players here, the login of one of them reads the record back
+// into a free slot, shifted by the time it was held, and resumes as from a restored snapshot. the
+// others find it live. a player back while it is held plays on, the deadlines moved on by that time
+//   SUSPEND_FILE  records of _SUSPEND_HEADER and _SNAPSHOT_GAME, each at a fixed place, a free one has
+//                 no magic. a record is written once and cleared once it is read back
+// a record kept SUSPEND_KEEP_MSEC is read back by loop 0 without a player, its table plays out the hand
+// and closes, so the hit prize is settled. the store is read at start, a restart keeps the tables
+
+#define SUSPEND_FILE "tongits.suspend"
+#define SUSPEND_MAGIC "TGSU"
+#define SUSPEND_VERSION 1
+#define SUSPEND_KEEP_MSEC 86400000
+#define SUSPEND_SCAN_MSEC 10000	// loop 0 looks for records past their keep this often
+#define SUSPEND_EXPIRE_BATCH 4	// records of a scan read back without a player
+
+struct _SUSPEND_HEADER
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t gamesize;	// sizeof(_SNAPSHOT_GAME) of the writer
+	uint32_t checksum;	// fnv-1a of the record
+	uint64_t heldtick;	// clockmsec of the writer, the table stands still from here until it is read back
+	int64_t heldtime;	// wall clock of the same, for SUSPEND_KEEP_MSEC across a restart
+};
+
+static_assert(sizeof(_SUSPEND_HEADER) == 32, "_SUSPEND_HEADER keeps the records 8 byte aligned");
+
+struct _SUSPEND_STATS
+{
+	uint64_t suspended;
+	uint64_t resumed;	// read back for a player
+	uint64_t expired;	// read back at their keep
+	int kept;	// in the store now
+};
+
+void suspendstart(bool isread);	// before the loops, isread with the snapshot
+// the loop of the table once it let the slot go, s is its record and heldtick when it was held
+void suspendput(std::shared_ptr<_SNAPSHOT_GAME> s, uint64_t heldtick);
+// loop 0, false when token has no suspended table. else done runs on loop 0 once the table is in a slot
+// again, or could not be
+bool suspendresume(int64_t token, std::function<void(bool)> done);
+void suspendrun();	// on every loop 0 tick
+void suspendstats(_SUSPEND_STATS& stats);
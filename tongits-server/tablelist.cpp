@@ -0,0 +1,256 @@
+#include "tablelist.h"
+#include "common.h"
+#include "gamectrl.h"
+#include "socket.h"
+#include "user.h"
+#include <algorithm>
+#include <vector>
+
+struct _TABLES_LIST
+{
+	uintptr_t userindex;
+	int aindex;
+	uint32_t id;	// of the request, the answers of a replaced listing are dropped
+	int64_t cursor;
+	int64_t next;	// of the page out on the loops
+	int count;
+	bool isstream;
+	bool isbusy;	// a page is out on the loops
+	int pending;	// loops that have not answered for it
+	std::vector<_PMSG_TABLE_INFO> rows;
+};
+
+static std::vector<_TABLES_LIST> vTablesLists;	// loop 0 only
+static uint32_t tablesid = 0;
+
+static _TABLES_LIST* tablesfind(uint32_t id)
+{
+	for (size_t n = 0; n < vTablesLists.size(); n++) {
+		if (vTablesLists[n].id == id)
+			return &vTablesLists[n];
+	}
+	return NULL;
+}
+
+static void tablesremove(uint32_t id)
+{
+	for (size_t n = 0; n < vTablesLists.size(); n++) {
+		if (vTablesLists[n].id == id) {
+			vTablesLists.erase(vTablesLists.begin() + n);
+			return;
+		}
+	}
+}
+
+// gone or no longer an admin, the connection of a new user may have the slot
+static _USER_INFO* tablesadmin(uintptr_t userindex)
+{
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL || !(userinfo->ismuadmin || userinfo->isuseradmin) ||
+		!(userinfo->m_state & (unsigned char)_USER_STATE::_CONNECTED))
+		return NULL;
+	return userinfo;
+}
+
+// bytes the admin has not been sent yet, 0 when its connection is on another loop
+static size_t tablesunsent(_USER_INFO* userinfo)
+{
+	if (userinfo->packetdata.bev == NULL || userinfo->packetdata.loop != le_getloop())
+		return 0;
+	return evbuffer_get_length(bufferevent_get_output(userinfo->packetdata.bev));
+}
+
+// on the loop of the table, the seats are read by it too
+static void tablesrow(game* g, _PMSG_TABLE_INFO& row)
+{
+	memset(&row, 0, sizeof(row));
+	row.serial = g->getgameserial();
+	row.state = (unsigned char)g->getstate();
+	row.ectype = g->getgametype();
+	row.istourney = (g->m_tourneyhands != 0) ? 1 : 0;
+	row.isfrozen = (g->m_frozentick != 0) ? 1 : 0;
+	row.iswatched = (g->m_spectate != NULL) ? 1 : 0;
+	row.loop = g->getloop();
+	row.hands = g->m_hands;
+
+	for (int i = 0; i < MAX_USERS_PERGAME; i++) {
+		_USER_INFO* userinfo = (g->m_users[i] != 0) ? guser.getuser(g->m_users[i]) : NULL;
+		if (userinfo == NULL)
+			continue;
+		_PMSG_TABLE_SEAT& seat = row.seats[i];
+		seat.token = userinfo->token;
+		seat.ecoins = userinfo->ecoins[(row.ectype < 2) ? row.ectype : 0];
+		seat.isbot = userinfo->isbot ? 1 : 0;
+		seat.isdc = userinfo->isdc() ? 1 : 0;
+		userinfo->account.copyto(seat.account);
+	}
+}
+
+static void tablessend(_TABLES_LIST& list)
+{
+	unsigned char buffer[sizeof(_PMSG_TABLES_ANS) + TABLES_PAGE * sizeof(_PMSG_TABLE_INFO)] = { 0 };
+	_PMSG_TABLES_ANS* pMsg = (_PMSG_TABLES_ANS*)buffer;
+	int count = (int)list.rows.size();
+	int size = sizeof(_PMSG_TABLES_ANS) + count * sizeof(_PMSG_TABLE_INFO);
+
+	std::sort(list.rows.begin(), list.rows.end(), [](const _PMSG_TABLE_INFO& a, const _PMSG_TABLE_INFO& b) { return a.serial < b.serial; });
+
+	pMsg->hdr.c = 0xC2;
+	pMsg->hdr.h = 0xF4;
+	pMsg->hdr.len[0] = SET_NUMBERH(size);
+	pMsg->hdr.len[1] = SET_NUMBERL(size);
+	pMsg->sub = 0x0E;
+	pMsg->aindex = list.aindex;
+	pMsg->count = (unsigned char)count;
+	pMsg->next = list.next;
+	pMsg->tables = gcontrol.getactivegames();
+	if (count > 0)
+		memcpy(buffer + sizeof(_PMSG_TABLES_ANS), list.rows.data(), count * sizeof(_PMSG_TABLE_INFO));
+
+	list.rows.clear();
+	::datasend(list.userindex, buffer, size);
+}
+
+static void tablespage(_TABLES_LIST& list);
+
+// the page is out, the listing goes on from its next cursor or is done
+static void tablesdone(_TABLES_LIST& list)
+{
+	uint32_t id = list.id;
+
+	list.isbusy = false;
+	tablessend(list);
+
+	if (!list.isstream || list.next == 0) {
+		tablesremove(id);
+		return;
+	}
+
+	list.cursor = list.next;
+
+	// the next pass of loop 0, or its tick once the admin read what it was sent
+	le_post([id]() {
+		_TABLES_LIST* list = tablesfind(id);
+		_USER_INFO* userinfo = (list != NULL) ? tablesadmin(list->userindex) : NULL;
+		if (list == NULL || list->isbusy || userinfo == NULL || tablesunsent(userinfo) >= TABLES_MAX_OUTPUT)
+			return;
+		tablespage(*list);
+	});
+}
+
+static void tablesanswer(uint32_t id, const std::vector<_PMSG_TABLE_INFO>& rows)
+{
+	_TABLES_LIST* list = tablesfind(id);
+
+	if (list == NULL || !list->isbusy)
+		return;
+
+	list->rows.insert(list->rows.end(), rows.begin(), rows.end());
+	if (--list->pending == 0)
+		tablesdone(*list);
+}
+
+// loop 0 takes the serials of the page, each loop reads its own tables of it
+static void tablespage(_TABLES_LIST& list)
+{
+	std::vector<std::vector<int64_t>> vserials(le_getloops());
+	int64_t serial = (list.cursor > 0) ? list.cursor : 1;
+	int found = 0;
+
+	for (int scanned = 0; found < list.count && scanned < TABLES_SCAN; serial++, scanned++) {
+		game* g = gcontrol.getgame(serial);
+		if (g == NULL)
+			break;
+		int loop = g->getloop();
+		if (loop < 0 || loop >= (int)vserials.size())
+			continue;
+		vserials[loop].push_back(serial);
+		found++;
+	}
+
+	list.next = (gcontrol.getgame(serial) != NULL) ? serial : 0;
+	list.rows.clear();
+	list.pending = 0;
+	list.isbusy = true;
+
+	// a run of free slots only moves the cursor
+	if (found == 0) {
+		tablesdone(list);
+		return;
+	}
+
+	uint32_t id = list.id;
+	for (int loop = 0; loop < (int)vserials.size(); loop++) {
+		if (vserials[loop].empty())
+			continue;
+		list.pending++;
+		std::vector<int64_t> serials;
+		serials.swap(vserials[loop]);
+		le_postloop(loop, [id, loop, serials]() {
+			std::vector<_PMSG_TABLE_INFO> rows;
+			rows.reserve(serials.size());
+			for (size_t n = 0; n < serials.size(); n++) {
+				game* g = gcontrol.getgame(serials[n]);
+				// let go or moved meanwhile
+				if (g == NULL || g->getloop() != loop)
+					continue;
+				rows.resize(rows.size() + 1);
+				tablesrow(g, rows.back());
+			}
+			le_post([id, rows]() { tablesanswer(id, rows); });
+		});
+	}
+}
+
+void tablesquery(uintptr_t userindex, int aindex, int64_t cursor, unsigned char count, bool isstream)
+{
+	if (le_getloop() != 0) {
+		le_post([userindex, aindex, cursor, count, isstream]() { tablesquery(userindex, aindex, cursor, count, isstream); });
+		return;
+	}
+
+	size_t n = 0;
+	while (n < vTablesLists.size() && vTablesLists[n].userindex != userindex)
+		n++;
+	if (n == vTablesLists.size())
+		vTablesLists.push_back(_TABLES_LIST());
+
+	_TABLES_LIST& list = vTablesLists[n];
+	list.userindex = userindex;
+	list.aindex = aindex;
+	list.id = ++tablesid;
+	list.cursor = (cursor > 0) ? cursor : 1;
+	list.next = 0;
+	list.count = (count == 0 || count > TABLES_PAGE) ? TABLES_PAGE : count;
+	list.isstream = isstream;
+	list.isbusy = false;
+	list.pending = 0;
+	list.rows.clear();
+
+	if (isstream)
+		MSGLOG(eMSGTYPE::INFO, "tablesquery, admin %llu lists the tables from %lld.", (unsigned long long)userindex, (long long)list.cursor);
+	tablespage(list);
+}
+
+void tablesrun()
+{
+	for (size_t n = 0; n < vTablesLists.size();) {
+		_TABLES_LIST& list = vTablesLists[n];
+		_USER_INFO* userinfo = tablesadmin(list.userindex);
+
+		if (userinfo == NULL) {
+			vTablesLists.erase(vTablesLists.begin() + n);
+			continue;
+		}
+
+		// a stream that waited for the admin to read, tablespage may let the listing go
+		if (!list.isbusy && tablesunsent(userinfo) < TABLES_MAX_OUTPUT) {
+			uint32_t id = list.id;
+			tablespage(list);
+			if (tablesfind(id) == NULL)
+				continue;
+		}
+		n++;
+	}
+}
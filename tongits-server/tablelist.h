@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+
+// the running tables listed to a mu admin a page at a time. loop 0 walks the serials from the admin's
+// cursor, at most TABLES_SCAN slots for a page, and hands each loop the tables of the page it runs. a
+// loop reads only its own tables and their seats, loop 0 sends the page once every loop answered. the
+// next page of a stream waits for the next pass of loop 0 and for the admin's output to fall under
+// TABLES_MAX_OUTPUT, so listing every table costs any loop one page of work at a time
+
+#define TABLES_PAGE 32	// tables in one answer
+#define TABLES_SCAN 512	// slots loop 0 looks at for one page
+#define TABLES_MAX_OUTPUT (64 * 1024)
+
+void tablesquery(uintptr_t userindex, int aindex, int64_t cursor, unsigned char count, bool isstream);	// any loop
+void tablesrun();	// loop 0, from the loop tick
@@ -0,0 +1,159 @@
+#include "taskpool.h"
+#include "common.h"
+#include "socket.h"
+#include "cpupin.h"
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct _Task
+{
+	std::function<void()> work;
+	std::function<void()> done;
+	int loop;	// of the submitter, -1 for another thread
+};
+
+struct _TaskWorker
+{
+	std::mutex lock;
+	std::deque<_Task*> lanes[(int)_TASK_LANE::_MAX];	// the owner takes the front, a thief the back
+	std::thread thread;
+};
+
+static std::vector<_TaskWorker*> taskworkers;
+static std::atomic<unsigned int> tasknext{ 0 };
+static std::mutex taskwakelock;
+static std::condition_variable taskwake;
+static bool isstopping = false;	// under taskwakelock
+static _TASK_STATS taskstats;
+
+static _Task* tasktake(int self)
+{
+	int count = (int)taskworkers.size();
+
+	for (int lane = 0; lane < (int)_TASK_LANE::_MAX; lane++) {
+		for (int n = 0; n < count; n++) {
+			_TaskWorker* worker = taskworkers[(self + n) % count];
+			std::lock_guard<std::mutex> lock(worker->lock);
+			std::deque<_Task*>& queue = worker->lanes[lane];
+
+			if (queue.empty())
+				continue;
+
+			_Task* task;
+			if (n == 0) {
+				task = queue.front();
+				queue.pop_front();
+			}
+			else {
+				task = queue.back();
+				queue.pop_back();
+				taskstats.stolen++;
+			}
+			taskstats.queued--;
+			return task;
+		}
+	}
+	return NULL;
+}
+
+static void taskrun(_Task* task)
+{
+	task->work();
+
+	if (task->done) {
+		if (task->loop >= 0)
+			le_postloop(task->loop, std::move(task->done));
+		else
+			task->done();
+	}
+	delete task;
+}
+
+static void taskworker(int self)
+{
+	while (true) {
+		_Task* task = tasktake(self);
+
+		if (task != NULL) {
+			taskrun(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(taskwakelock);
+		if (isstopping && taskstats.queued <= 0)
+			break;
+		taskwake.wait_for(lock, std::chrono::milliseconds(TASK_IDLE_MSEC), [] { return isstopping || taskstats.queued > 0; });
+	}
+}
+
+void taskstart(int threads, int loops)
+{
+	if (threads <= 0)
+		threads = std::max((int)std::thread::hardware_concurrency() - loops, TASK_MIN_THREADS);
+
+	taskstats.threads = threads;
+	for (int n = 0; n < threads; n++)
+		taskworkers.push_back(new _TaskWorker);
+	for (int n = 0; n < threads; n++)
+		taskworkers[n]->thread = std::thread(taskworker, n);
+
+	MSGLOG(INFO, "Background tasks run on %d threads.", threads);
+}
+
+void taskpin(const std::vector<int>& cpus)
+{
+	for (size_t n = 0; n < taskworkers.size(); n++)
+		cpupinthread(taskworkers[n]->thread, cpus);
+}
+
+void taskstop()
+{
+	{
+		std::lock_guard<std::mutex> lock(taskwakelock);
+		isstopping = true;
+	}
+	taskwake.notify_all();
+
+	// a thread still running may look into the queues of one already joined
+	for (auto worker : taskworkers)
+		worker->thread.join();
+	for (auto worker : taskworkers)
+		delete worker;
+	taskworkers.clear();
+	taskstats.threads = 0;
+}
+
+void tasksubmit(_TASK_LANE lane, std::function<void()> work, std::function<void()> done)
+{
+	_Task* task = new _Task;
+	task->work = std::move(work);
+	task->done = std::move(done);
+	task->loop = le_getloop();
+	taskstats.submitted++;
+
+	if (taskworkers.empty()) {
+		taskrun(task);
+		return;
+	}
+
+	_TaskWorker* worker = taskworkers[tasknext++ % taskworkers.size()];
+	{
+		std::lock_guard<std::mutex> lock(worker->lock);
+		worker->lanes[(int)lane].push_back(task);
+		taskstats.queued++;
+	}
+
+	// the lock orders the count against a thread that just found nothing and is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(taskwakelock);
+	}
+	taskwake.notify_one();
+}
+
+const _TASK_STATS& gettaskstats()
+{
+	return taskstats;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+// background threads the subsystems share for work that would stall a loop, writing a file or
+// compressing or hashing a batch. every thread keeps a queue per lane and a task goes to the threads
+// in turn. a thread out of work takes the newest task of another one before it sleeps, and a lane is
+// only looked at once the lanes above it are empty everywhere. the completion runs on the loop that
+// submitted, posted with le_postloop and so woken with event_active, and on the pool thread for a
+// submitter that is no loop. without a pool, in the tools and the benchmark, a task runs at once
+
+#define TASK_MIN_THREADS 2	// when Task Threads is 0 and the loops take every core
+#define TASK_IDLE_MSEC 100	// a sleeping thread looks again this often, taskstop is seen within this
+
+enum class _TASK_LANE : unsigned char
+{
+	_HIGH = 0,	// a player waits for it
+	_NORMAL,
+	_LOW,	// housekeeping, runs when nothing else does
+	_MAX,
+};
+
+struct _TASK_STATS
+{
+	std::atomic<uint64_t> submitted;
+	std::atomic<uint64_t> stolen;	// taken off the queue of another thread
+	std::atomic<int64_t> queued;	// submitted and not started yet
+	int threads;
+};
+
+void taskstart(int threads, int loops);	// threads 0 takes the cores the loops leave
+void taskstop();	// runs every task already submitted, then joins the threads
+void tasksubmit(_TASK_LANE lane, std::function<void()> work, std::function<void()> done = nullptr);
+const _TASK_STATS& gettaskstats();
+void taskpin(const std::vector<int>& cpus);	// the pool threads to the cores of cpupin.h
@@ -2,21 +2,43 @@
 #include "socket.h"
 #include "game.h"
 #include "conf.h"
-#include "db.h"
+#include "bench.h"
+#include "trace.h"
+#include "slabmem.h"
+#include "../Common/evmem.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+	logstart();
 	c.load();
 
+	// ahead of everything of libevent, the bench and the replay included
+	if (c.geteventmempool() && !evmeminstall())
+		MSGLOG(eMSGTYPE::INFO, "libevent is built without memory replacement, Event Memory Pool is ignored.");
+	slabmeminit(c.gethugepages());
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		int result = benchmain((argc > 2) ? argv[2] : NULL);
+		logstop();
+		return result;
+	}
+
+	if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+		int result = tracereplay(argv[2]);
+		logstop();
+		return result;
+	}
+
 	/*if (db.Connect(3, c.getsql().dbname.c_str(), c.getsql().user.c_str(), c.getsql().secret.c_str())) {
-		msglog(INFO, "Connected to database server, odbc %s.", c.getsql().dbname.c_str());
+		MSGLOG(INFO, "Connected to database server, odbc %s.", c.getsql().dbname.c_str());
 	}
 	else {
-		msglog(ERROR, "Failed to connect to database server, odbc %s.", c.getsql().dbname.c_str());
+		MSGLOG(ERROR, "Failed to connect to database server, odbc %s.", c.getsql().dbname.c_str());
 		return -1;
 	}*/
 
 	le_start();
 
+	logstop();
 	return 0;
 }
\ No newline at end of file
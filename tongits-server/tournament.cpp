@@ -0,0 +1,506 @@
+#include "tournament.h"
+#include "gamectrl.h"
+#include "socket.h"
+#include "user.h"
+#include "settle.h"
+#include "stats.h"
+#include "packet.h"
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+struct _TOURNEY_ENTRANT
+{
+	std::string account;	// a player that logs in again is found by it
+	int64_t score;	// every hand summed
+	int64_t roundscore;	// of the round, decides the table
+	int hands;
+	int wins;
+	int round;	// the last round played, a bye counts
+	bool isin;
+};
+
+struct _TOURNEY_TABLE
+{
+	int entrants[MAX_USER_POS];	// in seat order
+};
+
+static _TOURNEY_STATE tourneystate = _TOURNEY_STATE::_NONE;
+static unsigned char tourneytype = 0;
+static int tourneytablehands = TOURNEY_DEFAULT_HANDS;
+static int tourneyround = 0;
+static int tourneyremaining = 0;	// entrants still in
+static int tourneyseatusec = 0;
+static uint64_t tourneyretrytick = 0;
+static std::vector<_TOURNEY_ENTRANT> tourneyentrants;	// in the order they registered
+static std::unordered_map<std::string, int> tourneyaccounts;
+static std::vector<_TOURNEY_TABLE> tourneytables;	// of the round
+static std::unordered_map<int64_t, int> tourneyserials;	// the tables of the round still playing
+static std::vector<int> tourneybyes;	// sit the round out, through to the next
+static std::vector<int> tourneypending;	// a round that found no slots, seated again on the tick
+
+// best first, those still in ahead of those out, then the round reached and the score
+static void tourneyorder(std::vector<int>& order)
+{
+	order.resize(tourneyentrants.size());
+	for (size_t n = 0; n < order.size(); n++)
+		order[n] = (int)n;
+
+	std::sort(order.begin(), order.end(), [](int a, int b) {
+		const _TOURNEY_ENTRANT& x = tourneyentrants[a];
+		const _TOURNEY_ENTRANT& y = tourneyentrants[b];
+		if (x.isin != y.isin)
+			return x.isin;
+		if (x.round != y.round)
+			return x.round > y.round;
+		if (x.score != y.score)
+			return x.score > y.score;
+		return a < b;
+	});
+}
+
+// the slot of an entrant that can take a seat now, 0 for one that is gone or at another table
+static uintptr_t tourneypresent(int e)
+{
+	uintptr_t userindex = guser.findaccount(tourneyentrants[e].account.c_str());
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userindex == 0 || userinfo == NULL || !userinfo->isloggedin() || userinfo->isdc() || userinfo->isplaying())
+		return 0;
+	return userindex;
+}
+
+static void tourneysend(uintptr_t userindex, _TOURNEY_STATUS status, const _TOURNEY_ENTRANT* entrant, int rank)
+{
+	_PMSG_TOURNEY_INFO pMsg = pkttemplate<_PMSG_TOURNEY_INFO>(0xF1, 0x0B);
+
+	pMsg.status = (unsigned char)status;
+	pMsg.ectype = tourneytype;
+	pMsg.round = (unsigned char)std::min(tourneyround, 255);
+	pMsg.entrants = (int)tourneyentrants.size();
+	pMsg.remaining = tourneyremaining;
+	pMsg.score = (entrant != NULL) ? (int)entrant->score : 0;
+	pMsg.rank = rank;
+
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
+
+// every entrant whose round was decided hears of it once, with its rank after the decision
+static void tourneyinform(const std::vector<std::pair<int, _TOURNEY_STATUS>>& news)
+{
+	std::vector<int> order;
+	std::vector<int> ranks(tourneyentrants.size());
+
+	tourneyorder(order);
+	for (size_t n = 0; n < order.size(); n++)
+		ranks[order[n]] = (int)n + 1;
+
+	for (const auto& item : news) {
+		uintptr_t userindex = guser.findaccount(tourneyentrants[item.first].account.c_str());
+		if (userindex != 0)
+			tourneysend(userindex, item.second, &tourneyentrants[item.first], ranks[item.first]);
+	}
+}
+
+static void tourneyout(int e)
+{
+	if (tourneyentrants[e].isin) {
+		tourneyentrants[e].isin = false;
+		tourneyremaining--;
+	}
+}
+
+static void tourneyin(int e)
+{
+	if (!tourneyentrants[e].isin) {
+		tourneyentrants[e].isin = true;
+		tourneyremaining++;
+	}
+}
+
+// champion -1 when nobody was left to play
+static void tourneyfinish(int champion, std::vector<std::pair<int, _TOURNEY_STATUS>>& news)
+{
+	for (int e = 0; e < (int)tourneyentrants.size(); e++) {
+		if (e != champion)
+			tourneyout(e);
+	}
+
+	tourneystate = _TOURNEY_STATE::_DONE;
+	tourneytables.clear();
+	tourneyserials.clear();
+	tourneybyes.clear();
+	tourneypending.clear();
+
+	if (champion >= 0) {
+		news.emplace_back(champion, _TOURNEY_STATUS::_CHAMPION);
+		MSGLOG(INFO, "Tournament, %s won after %d rounds with a score of %lld.",
+			tourneyentrants[champion].account.c_str(), tourneyround, tourneyentrants[champion].score);
+	}
+	else
+		MSGLOG(INFO, "Tournament, ended after %d rounds without a champion.", tourneyround);
+	tourneyinform(news);
+}
+
+static void tourneyadvance();
+
+// players take the tables of the next round three at a time. the best losers of the last round fill it up
+// to a multiple of three, what is still short sits the round out. one that is not there is out, and with
+// fewer than three left the best score wins. the round is only taken over once its tables are seated
+static _TOURNEY_RESULT tourneyseat(const std::vector<int>& players, const std::vector<int>& losers)
+{
+	std::vector<std::pair<int, _TOURNEY_STATUS>> news;
+	std::vector<int> seated;
+	std::vector<int> gone;
+
+	for (int e : players)
+		(tourneypresent(e) != 0 ? seated : gone).push_back(e);
+
+	for (size_t n = 0; n < losers.size() && seated.size() % MAX_USER_POS != 0; n++) {
+		if (tourneypresent(losers[n]) != 0)
+			seated.push_back(losers[n]);
+	}
+
+	if (seated.size() < MAX_USER_POS) {
+		if (tourneystate == _TOURNEY_STATE::_OPEN)
+			return _TOURNEY_RESULT::_NOTENOUGH;
+
+		for (int e : gone) {
+			tourneyout(e);
+			news.emplace_back(e, _TOURNEY_STATUS::_ELIMINATED);
+		}
+
+		auto best = std::max_element(seated.begin(), seated.end(), [](int a, int b) {
+			return tourneyentrants[a].score < tourneyentrants[b].score;
+		});
+		tourneyfinish((best != seated.end()) ? *best : -1, news);
+		return _TOURNEY_RESULT::_OK;
+	}
+
+	size_t tables = seated.size() / MAX_USER_POS;
+	std::vector<uintptr_t> seats;
+	std::vector<int64_t> serials;
+
+	seats.reserve(tables * MAX_USER_POS);
+	for (size_t n = 0; n < tables * MAX_USER_POS; n++) {
+		uintptr_t userindex = tourneypresent(seated[n]);
+		guser.getuser(userindex)->setgametype(tourneytype);
+		seats.push_back(userindex);
+	}
+
+	uint64_t start = statsusec();
+
+	if (!gcontrol.addgames(seats, tourneytype, tourneytablehands, serials)) {
+		if (tourneystate == _TOURNEY_STATE::_RUNNING) {
+			tourneypending = players;
+			tourneypending.insert(tourneypending.end(), seated.begin() + (players.size() - gone.size()), seated.end());
+			tourneyretrytick = clockmsec() + TOURNEY_RETRY_MSEC;
+		}
+		return _TOURNEY_RESULT::_NOSLOTS;
+	}
+
+	tourneyseatusec = (int)(statsusec() - start);
+	tourneystate = _TOURNEY_STATE::_RUNNING;
+	tourneyround++;
+	tourneytables.clear();
+	tourneyserials.clear();
+	tourneybyes.assign(seated.begin() + tables * MAX_USER_POS, seated.end());
+	tourneypending.clear();
+
+	for (int e : gone) {
+		tourneyout(e);
+		news.emplace_back(e, _TOURNEY_STATUS::_ELIMINATED);
+	}
+
+	for (size_t n = 0; n < seated.size(); n++) {
+		_TOURNEY_ENTRANT& entrant = tourneyentrants[seated[n]];
+		size_t table = n / MAX_USER_POS;
+
+		entrant.roundscore = 0;
+		entrant.round = tourneyround;
+		tourneyin(seated[n]);
+
+		if (table >= tables) {
+			news.emplace_back(seated[n], _TOURNEY_STATUS::_BYE);
+			continue;
+		}
+
+		// three that could not be seated, one of them without the ecoins for the table
+		if (serials[table] == 0) {
+			tourneyout(seated[n]);
+			news.emplace_back(seated[n], _TOURNEY_STATUS::_ELIMINATED);
+			continue;
+		}
+
+		if (n % MAX_USER_POS == 0) {
+			tourneyserials[serials[table]] = (int)tourneytables.size();
+			tourneytables.emplace_back();
+		}
+		tourneytables.back().entrants[n % MAX_USER_POS] = seated[n];
+		news.emplace_back(seated[n], _TOURNEY_STATUS::_ADVANCED);
+	}
+
+	MSGLOG(INFO, "Tournament, round %d seated %d tables in %d usec, %d byes and %d of %d entrants still in.",
+		tourneyround, (int)tourneyserials.size(), tourneyseatusec, (int)tourneybyes.size(), tourneyremaining, (int)tourneyentrants.size());
+	tourneyinform(news);
+
+	if (tourneyserials.empty())
+		tourneyadvance();
+	return _TOURNEY_RESULT::_OK;
+}
+
+// the best of every table of the round is through, with those who had a bye
+static void tourneyadvance()
+{
+	std::vector<int> next = tourneybyes;
+	std::vector<int> losers;
+
+	for (const _TOURNEY_TABLE& table : tourneytables) {
+		int winner = table.entrants[0];
+
+		for (int i = 1; i < MAX_USER_POS; i++) {
+			const _TOURNEY_ENTRANT& entrant = tourneyentrants[table.entrants[i]];
+			if (entrant.roundscore > tourneyentrants[winner].roundscore ||
+				(entrant.roundscore == tourneyentrants[winner].roundscore && entrant.score > tourneyentrants[winner].score))
+				winner = table.entrants[i];
+		}
+
+		next.push_back(winner);
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			if (table.entrants[i] != winner) {
+				tourneyout(table.entrants[i]);
+				losers.push_back(table.entrants[i]);
+			}
+		}
+	}
+
+	std::sort(losers.begin(), losers.end(), [](int a, int b) {
+		const _TOURNEY_ENTRANT& x = tourneyentrants[a];
+		const _TOURNEY_ENTRANT& y = tourneyentrants[b];
+		if (x.roundscore != y.roundscore)
+			return x.roundscore > y.roundscore;
+		return x.score > y.score;
+	});
+
+	std::vector<std::pair<int, _TOURNEY_STATUS>> news;
+
+	if (next.size() <= 1) {
+		for (int e : losers)
+			news.emplace_back(e, _TOURNEY_STATUS::_ELIMINATED);
+		tourneyfinish(next.empty() ? -1 : next[0], news);
+		return;
+	}
+
+	tourneyseat(next, losers);
+
+	// told once the seating has taken back the losers it needed
+	for (int e : losers) {
+		if (!tourneyentrants[e].isin)
+			news.emplace_back(e, _TOURNEY_STATUS::_ELIMINATED);
+	}
+	tourneyinform(news);
+}
+
+static void tourneyanswer(uintptr_t userindex, int aindex, unsigned char action, _TOURNEY_RESULT result, int count)
+{
+	std::vector<int> order;
+	std::vector<unsigned char> buffer;
+
+	count = std::max(0, std::min(std::min(count, TOURNEY_MAX_STANDINGS), (int)tourneyentrants.size()));
+	buffer.resize(sizeof(_PMSG_TOURNEY_ANS) + count * sizeof(_PMSG_TOURNEY_STANDING));
+
+	_PMSG_TOURNEY_ANS* pMsg = (_PMSG_TOURNEY_ANS*)buffer.data();
+	_PMSG_TOURNEY_STANDING* pInfo = (_PMSG_TOURNEY_STANDING*)(buffer.data() + sizeof(_PMSG_TOURNEY_ANS));
+
+	if (count > 0)
+		tourneyorder(order);
+
+	for (int n = 0; n < count; n++) {
+		const _TOURNEY_ENTRANT& entrant = tourneyentrants[order[n]];
+		strncpy(pInfo[n].accountid, entrant.account.c_str(), sizeof(pInfo[n].accountid) - 1);
+		pInfo[n].score = (int)entrant.score;
+		pInfo[n].hands = (unsigned short)std::min(entrant.hands, 65535);
+		pInfo[n].wins = (unsigned short)std::min(entrant.wins, 65535);
+		pInfo[n].round = (unsigned char)std::min(entrant.round, 255);
+		pInfo[n].isin = entrant.isin ? 1 : 0;
+	}
+
+	int size = (int)buffer.size();
+	pMsg->hdr.c = 0xC2;
+	pMsg->hdr.h = 0xF4;
+	pMsg->hdr.len[0] = SET_NUMBERH(size);
+	pMsg->hdr.len[1] = SET_NUMBERL(size);
+	pMsg->sub = 0x09;
+	pMsg->aindex = aindex;
+	pMsg->action = action;
+	pMsg->result = (unsigned char)result;
+	pMsg->state = (unsigned char)tourneystate;
+	pMsg->round = (unsigned char)std::min(tourneyround, 255);
+	pMsg->entrants = (int)tourneyentrants.size();
+	pMsg->remaining = tourneyremaining;
+	pMsg->tables = (int)tourneyserials.size();
+	pMsg->seatusec = tourneyseatusec;
+	pMsg->count = (unsigned char)count;
+
+	::datasend(userindex, buffer.data(), size);
+}
+
+static void tourneyclear()
+{
+	tourneyround = 0;
+	tourneyremaining = 0;
+	tourneyseatusec = 0;
+	tourneyentrants.clear();
+	tourneyaccounts.clear();
+	tourneytables.clear();
+	tourneyserials.clear();
+	tourneybyes.clear();
+	tourneypending.clear();
+}
+
+void tourneyjoin(uintptr_t userindex, unsigned char gametype)
+{
+	if (le_getloop() != 0) {
+		le_post([userindex, gametype]() { tourneyjoin(userindex, gametype); });
+		return;
+	}
+
+	_USER_INFO* userinfo = guser.getuser(userindex);
+
+	if (userinfo == NULL)
+		return;
+
+	if (tourneystate != _TOURNEY_STATE::_OPEN || gametype != tourneytype || userinfo->isbot || userinfo->isplaying() ||
+		tourneyaccounts.count(userinfo->account) != 0) {
+		tourneysend(userindex, _TOURNEY_STATUS::_REFUSED, NULL, 0);
+		return;
+	}
+
+	int e = (int)tourneyentrants.size();
+	_TOURNEY_ENTRANT entrant = {};
+
+	entrant.account = userinfo->account;
+	entrant.isin = true;
+	tourneyentrants.push_back(entrant);
+	tourneyaccounts[userinfo->account] = e;
+	tourneyremaining++;
+
+	tourneysend(userindex, _TOURNEY_STATUS::_REGISTERED, &tourneyentrants[e], e + 1);
+}
+
+void tourneyadmin(uintptr_t userindex, int aindex, unsigned char action, unsigned char gametype, unsigned char hands, unsigned char count)
+{
+	if (le_getloop() != 0) {
+		le_post([userindex, aindex, action, gametype, hands, count]() { tourneyadmin(userindex, aindex, action, gametype, hands, count); });
+		return;
+	}
+
+	_TOURNEY_RESULT result = _TOURNEY_RESULT::_OK;
+	std::vector<std::pair<int, _TOURNEY_STATUS>> news;
+
+	switch ((_TOURNEY_ACTION)action) {
+	case _TOURNEY_ACTION::_OPEN:
+		if (tourneystate == _TOURNEY_STATE::_OPEN || tourneystate == _TOURNEY_STATE::_RUNNING) {
+			result = _TOURNEY_RESULT::_BADSTATE;
+			break;
+		}
+		if (gametype > 1) {
+			result = _TOURNEY_RESULT::_BADTYPE;
+			break;
+		}
+		tourneyclear();
+		tourneystate = _TOURNEY_STATE::_OPEN;
+		tourneytype = gametype;
+		tourneytablehands = (hands > 0) ? hands : TOURNEY_DEFAULT_HANDS;
+		MSGLOG(INFO, "Tournament, open for gametype %d, %d hands a table.", tourneytype, tourneytablehands);
+		break;
+
+	case _TOURNEY_ACTION::_START:
+		if (tourneystate != _TOURNEY_STATE::_OPEN) {
+			result = _TOURNEY_RESULT::_BADSTATE;
+			break;
+		}
+		{
+			std::vector<int> players(tourneyentrants.size());
+			for (size_t n = 0; n < players.size(); n++)
+				players[n] = (int)n;
+			result = tourneyseat(players, std::vector<int>());
+		}
+		break;
+
+	case _TOURNEY_ACTION::_STANDINGS:
+		break;
+
+	case _TOURNEY_ACTION::_CANCEL:
+		if (tourneystate != _TOURNEY_STATE::_OPEN && tourneystate != _TOURNEY_STATE::_RUNNING) {
+			result = _TOURNEY_RESULT::_BADSTATE;
+			break;
+		}
+		// the tables still playing finish as ordinary ones, their hands are no longer counted
+		for (int e = 0; e < (int)tourneyentrants.size(); e++) {
+			if (tourneyentrants[e].isin)
+				news.emplace_back(e, _TOURNEY_STATUS::_CANCELLED);
+		}
+		tourneyinform(news);
+		MSGLOG(INFO, "Tournament, cancelled in round %d with %d tables playing.", tourneyround, (int)tourneyserials.size());
+		tourneyclear();
+		tourneystate = _TOURNEY_STATE::_NONE;
+		break;
+
+	default:
+		return;
+	}
+
+	tourneyanswer(userindex, aindex, action, result, ((_TOURNEY_ACTION)action == _TOURNEY_ACTION::_STANDINGS) ? count : 0);
+}
+
+void tourneyhand(int64_t serial, const _SETTLE_INFO& settle)
+{
+	if (le_getloop() != 0) {
+		_SETTLE_INFO copy = settle;
+		le_post([serial, copy]() { tourneyhand(serial, copy); });
+		return;
+	}
+
+	auto iter = tourneyserials.find(serial);
+
+	if (iter == tourneyserials.end())
+		return;
+
+	const _TOURNEY_TABLE& table = tourneytables[iter->second];
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_TOURNEY_ENTRANT& entrant = tourneyentrants[table.entrants[i]];
+		entrant.score += settle.seats[i].delta;
+		entrant.roundscore += settle.seats[i].delta;
+		entrant.hands++;
+		if (settle.winnerpos == i)
+			entrant.wins++;
+	}
+}
+
+void tourneytabledone(int64_t serial)
+{
+	if (le_getloop() != 0) {
+		le_post([serial]() { tourneytabledone(serial); });
+		return;
+	}
+
+	if (tourneyserials.erase(serial) == 0)
+		return;
+
+	if (tourneyserials.empty())
+		tourneyadvance();
+}
+
+void tourneyrun()
+{
+	if (tourneypending.empty() || clockmsec() < tourneyretrytick)
+		return;
+
+	std::vector<int> players;
+	players.swap(tourneypending);
+	tourneyseat(players, std::vector<int>());
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+
+// one knockout tournament at a time, run on loop 0. an admin opens it for a gametype, players register
+// with 0xF1 0x08 and the start seats every entrant in one batch of tables spread over the loops. each
+// table plays its hands and closes, the best of the round at a table goes through and the next round is
+// seated as soon as the last table of the round is done. the standings are summed hand by hand as the
+// tables settle, an admin reads them at any time without walking the tables
+//
+// a field that is not a multiple of three gives the last registered a bye in the first round, later
+// rounds are filled up with the best losers of the round instead. a round of one table has the champion
+
+#define TOURNEY_DEFAULT_HANDS 3	// hands a table plays when the admin leaves it at 0
+#define TOURNEY_MAX_STANDINGS 100	// entrants in one answer of the standings
+#define TOURNEY_RETRY_MSEC 5000	// a round that found no free slots is seated again after
+
+struct _SETTLE_INFO;
+
+enum class _TOURNEY_ACTION : unsigned char
+{
+	_OPEN = 0,
+	_START,
+	_STANDINGS,
+	_CANCEL,
+};
+
+enum class _TOURNEY_RESULT : unsigned char
+{
+	_OK = 0,
+	_BADSTATE,	// open while one is on, start or cancel without one
+	_BADTYPE,
+	_NOTENOUGH,	// fewer than three entrants
+	_NOSLOTS,	// the tables of the round are past Max Games
+};
+
+enum class _TOURNEY_STATE : unsigned char
+{
+	_NONE = 0,
+	_OPEN,
+	_RUNNING,
+	_DONE,
+};
+
+// what an entrant is told, 0xF1 0x0B
+enum class _TOURNEY_STATUS : unsigned char
+{
+	_REGISTERED = 0,
+	_REFUSED,	// nothing open for the gametype, already in, or at a table
+	_ADVANCED,
+	_BYE,
+	_ELIMINATED,
+	_CHAMPION,
+	_CANCELLED,
+};
+
+void tourneyjoin(uintptr_t userindex, unsigned char gametype);
+void tourneyadmin(uintptr_t userindex, int aindex, unsigned char action, unsigned char gametype, unsigned char hands, unsigned char count);
+// from the loop of a tournament table, posted on to loop 0
+void tourneyhand(int64_t serial, const _SETTLE_INFO& settle);
+void tourneytabledone(int64_t serial);
+void tourneyrun();	// on every loop 0 tick
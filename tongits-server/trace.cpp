@@ -0,0 +1,325 @@
+#include "trace.h"
+#include "common.h"
+#include "game.h"
+#include "gamectrl.h"
+#include "user.h"
+#include "protocol.h"
+#include "socket.h"
+#include "settle.h"
+#include "ratelimit.h"
+#include "stats.h"
+#include "websock.h"
+#include "wire.h"
+#include <thread>
+#include <deque>
+
+bool endtraceworker = false;
+
+static bool istracing = false;	// set once before the loops start
+static bool isreplay = false;
+static FILE* tracefp = NULL;
+static std::mutex tracelock;
+static std::vector<unsigned char> vtracebuffer;
+
+// recorded rng states of each table, handed back in order as the replayed tables shuffle
+static std::map<int64_t, std::deque<_CARD_RNG>> mtraceseeds;
+
+bool tracestart(const char* filename)
+{
+	tracefp = fopen(filename, "wb");
+	if (tracefp == NULL) {
+		MSGLOG(eMSGTYPE::ERROR, "tracestart, failed to open %s.", filename);
+		return false;
+	}
+
+	setvbuf(tracefp, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+	_TRACE_HEADER hdr;
+	memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version = TRACE_VERSION;
+	hdr.recordsize = sizeof(_TRACE_RECORD);
+	fwrite(&hdr, sizeof(hdr), 1, tracefp);
+
+	istracing = true;
+	MSGLOG(eMSGTYPE::INFO, "Inputs are traced to %s.", filename);
+	return true;
+}
+
+static void tracewrite(_TRACE_TYPE type, uint64_t id, uint32_t ip, const void* data, int len)
+{
+	_TRACE_RECORD rec;
+	rec.type = (uint8_t)type;
+	rec.loop = (uint8_t)le_getloop();
+	rec.len = (uint16_t)len;
+	rec.ip = ip;
+	rec.tick = clockmsec();
+	rec.wall = clockwallmsec();
+	rec.id = id;
+
+	tracelock.lock();
+	vtracebuffer.insert(vtracebuffer.end(), (const unsigned char*)&rec, (const unsigned char*)&rec + sizeof(rec));
+	if (len > 0)
+		vtracebuffer.insert(vtracebuffer.end(), (const unsigned char*)data, (const unsigned char*)data + len);
+	tracelock.unlock();
+}
+
+void traceworker()
+{
+	std::vector<unsigned char> vbuffer;
+
+	while (true) {
+
+		tracelock.lock();
+		vtracebuffer.swap(vbuffer);
+		tracelock.unlock();
+
+		if (!vbuffer.empty()) {
+			fwrite(vbuffer.data(), 1, vbuffer.size(), tracefp);
+			fflush(tracefp);
+		}
+
+		vbuffer.clear();
+		if (endtraceworker)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_FLUSH_MSEC));
+	}
+
+	fclose(tracefp);
+	tracefp = NULL;
+}
+
+void traceopen(uintptr_t userindex, uint32_t ip)
+{
+	if (istracing)
+		tracewrite(_TRACE_TYPE::_OPEN, userindex, ip, NULL, 0);
+}
+
+void traceclose(uintptr_t userindex)
+{
+	if (istracing)
+		tracewrite(_TRACE_TYPE::_CLOSE, userindex, 0, NULL, 0);
+}
+
+void traceframe(uintptr_t userindex, const unsigned char* data, int len)
+{
+	if (istracing)
+		tracewrite(_TRACE_TYPE::_FRAME, userindex, 0, data, len);
+}
+
+void tracerun(_TRACE_TYPE type, uint64_t id)
+{
+	if (istracing)
+		tracewrite(type, id, 0, NULL, 0);
+}
+
+void traceseed(int64_t serial, _CARD_RNG& rng)
+{
+	if (istracing) {
+		tracewrite(_TRACE_TYPE::_SEED, serial, 0, &rng, sizeof(rng));
+		return;
+	}
+
+	if (!isreplay)
+		return;
+
+	auto iter = mtraceseeds.find(serial);
+	if (iter == mtraceseeds.end() || iter->second.empty()) {
+		MSGLOG(eMSGTYPE::ERROR, "traceseed, no recorded shuffle left for serial %lld, the replay has diverged.", serial);
+		return;
+	}
+	rng = iter->second.front();
+	iter->second.pop_front();
+}
+
+bool traceisreplay()
+{
+	return isreplay;
+}
+
+static bool traceload(const char* filename, std::vector<unsigned char>& vtrace)
+{
+	FILE* fp = fopen(filename, "rb");
+
+	if (fp == NULL) {
+		MSGLOG(eMSGTYPE::ERROR, "tracereplay, failed to open %s.", filename);
+		return false;
+	}
+
+	unsigned char buf[65536];
+	size_t size;
+	while ((size = fread(buf, 1, sizeof(buf), fp)) > 0)
+		vtrace.insert(vtrace.end(), buf, buf + size);
+	fclose(fp);
+
+	_TRACE_HEADER* hdr = (_TRACE_HEADER*)vtrace.data();
+	if (vtrace.size() < sizeof(_TRACE_HEADER) || memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic)) != 0 ||
+		hdr->version != TRACE_VERSION || hdr->recordsize != sizeof(_TRACE_RECORD)) {
+		MSGLOG(eMSGTYPE::ERROR, "tracereplay, %s is not a version %d trace.", filename, TRACE_VERSION);
+		return false;
+	}
+	return true;
+}
+
+// fnv-1a of the settled rounds, two replays of one trace have to agree on it
+static uint64_t tracedigest(const std::vector<_SETTLE_INFO>& vsettles)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (size_t n = 0; n < vsettles.size(); n++) {
+		const unsigned char* p = (const unsigned char*)&vsettles[n];
+		for (size_t i = 0; i < sizeof(_SETTLE_INFO); i++) {
+			hash ^= p[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+// every loop of the recording runs as loop 0 here, the records are already in one order
+int tracereplay(const char* filename)
+{
+	std::vector<unsigned char> vtrace;
+
+	if (!traceload(filename, vtrace))
+		return -1;
+
+	size_t offset = sizeof(_TRACE_HEADER);
+	while (offset + sizeof(_TRACE_RECORD) <= vtrace.size()) {
+		_TRACE_RECORD* rec = (_TRACE_RECORD*)&vtrace[offset];
+		if (rec->type == (uint8_t)_TRACE_TYPE::_SEED && rec->len == sizeof(_CARD_RNG) && offset + sizeof(_TRACE_RECORD) + rec->len <= vtrace.size()) {
+			_CARD_RNG rng;
+			memcpy(&rng, &vtrace[offset + sizeof(_TRACE_RECORD)], sizeof(rng));
+			mtraceseeds[(int64_t)rec->id].push_back(rng);
+		}
+		offset += sizeof(_TRACE_RECORD) + rec->len;
+	}
+
+	isreplay = true;
+	struct event_base* base = le_startlocal();
+	struct evbuffer* input = evbuffer_new();
+	std::map<uint64_t, uintptr_t> musers;	// userindex of the recording to the one of the replay
+	std::vector<struct bufferevent*> vpeers;	// both ends of the pairs the users write to, odd ones are never read
+	uint64_t records = 0, frames = 0, runs = 0;
+	uint64_t start = statsusec();
+
+	offset = sizeof(_TRACE_HEADER);
+	while (offset + sizeof(_TRACE_RECORD) <= vtrace.size()) {
+
+		_TRACE_RECORD rec;
+		memcpy(&rec, &vtrace[offset], sizeof(rec));
+		const unsigned char* data = &vtrace[offset + sizeof(_TRACE_RECORD)];
+
+		if (offset + sizeof(_TRACE_RECORD) + rec.len > vtrace.size())
+			break;
+		offset += sizeof(_TRACE_RECORD) + rec.len;
+		records++;
+
+		clockset(rec.tick, rec.wall);
+
+		switch ((_TRACE_TYPE)rec.type) {
+		case _TRACE_TYPE::_OPEN:
+		{
+			// the recorded slot timing does not hold on this clock, any free slot will do
+			uintptr_t userindex = guser.getuserindex(true);
+			_USER_INFO* userinfo = guser.getuser(userindex);
+
+			if (userinfo == NULL) {
+				MSGLOG(eMSGTYPE::ERROR, "tracereplay, no free slot for userindex %llu.", rec.id);
+				break;
+			}
+
+			struct bufferevent* pair[2];
+			bufferevent_pair_new(base, 0, pair);
+			vpeers.push_back(pair[0]);
+			vpeers.push_back(pair[1]);
+
+			// an old pair of the slot stays in vpeers until the end
+			userinfo->reset();
+			userinfo->set();
+			userinfo->isfreeuser = false;
+			userinfo->packetdata.bev = pair[0];
+			userinfo->packetdata.loop = 0;
+			userinfo->setstate((unsigned char)_USER_STATE::_CONNECTED);
+			userinfo->ip = rec.ip;
+			userinfo->wirever = WIRE_V1;
+			userinfo->isnoticeid = false;
+			userinfo->isdeadline = false;
+			userinfo->isactionmask = false;
+			userinfo->packetdata.websocket = WS_NONE;	// frames were taken after the websocket decode
+			musers[rec.id] = userindex;
+		}
+		break;
+
+		case _TRACE_TYPE::_CLOSE:
+		{
+			auto iter = musers.find(rec.id);
+			if (iter == musers.end())
+				break;
+			_USER_INFO* userinfo = guser.getuser(iter->second);
+			if (userinfo != NULL && userinfo->ismuadmin)
+				guser.delmuadmin(iter->second);
+			else
+				guser.deluser(iter->second);
+			musers.erase(iter);
+		}
+		break;
+
+		case _TRACE_TYPE::_FRAME:
+		{
+			auto iter = musers.find(rec.id);
+			if (iter == musers.end())
+				break;
+			evbuffer_add(input, data, rec.len);
+			gprotocol.parsedata(iter->second, input);
+			evbuffer_drain(input, evbuffer_get_length(input));
+			frames++;
+		}
+		break;
+
+		case _TRACE_TYPE::_GAMERUN:
+		{
+			game* g = gcontrol.getgame((int64_t)rec.id);
+			if (g != NULL)
+				g->run();
+			runs++;
+		}
+		break;
+
+		case _TRACE_TYPE::_CTRLRUN:
+			gcontrol.run(0);
+			ratesweep();
+			break;
+
+		default:
+			break;
+		}
+
+		// work the handlers posted to the loop, and nobody reads what was sent
+		event_base_loop(base, EVLOOP_NONBLOCK);
+		if ((records & 4095) == 0) {
+			for (size_t n = 1; n < vpeers.size(); n += 2) {
+				struct evbuffer* sent = bufferevent_get_input(vpeers[n]);
+				evbuffer_drain(sent, evbuffer_get_length(sent));
+			}
+		}
+	}
+
+	uint64_t usec = statsusec() - start;
+	std::vector<_SETTLE_INFO> vsettles;
+	swapsettle(vsettles);
+
+	printf("%llu records, %llu frames, %llu table runs in %.3f s, %.0f frames/s\n",
+		(unsigned long long)records, (unsigned long long)frames, (unsigned long long)runs, usec / 1e6,
+		(usec > 0) ? frames * 1e6 / usec : 0.0);
+	printf("%llu rounds settled, digest %016llx\n", (unsigned long long)vsettles.size(), (unsigned long long)tracedigest(vsettles));
+
+	if (offset != vtrace.size())
+		MSGLOG(eMSGTYPE::ERROR, "tracereplay, %s ends in a partial record.", filename);
+
+	evbuffer_free(input);
+	for (size_t n = 0; n < vpeers.size(); n++)
+		bufferevent_free(vpeers[n]);
+	le_stoplocal();
+	isreplay = false;
+	return 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+
+// binary trace of every input of the server, taken when "Trace File" is set and played back by
+// tongits-server --replay <file> on one thread at full speed, without sockets or timers. each record
+// carries the loop clock of its callback so the replay reads the same time, a frame is taken right
+// before doprotocol and the card rng of a table right before it shuffles, the replay hands the same
+// state back to the same table so every round deals and settles as it did
+
+#define TRACE_MAGIC "TGTR"
+#define TRACE_VERSION 1
+#define TRACE_FLUSH_MSEC 100
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+enum class _TRACE_TYPE
+{
+	_OPEN = 1,	// a client connected, id is its userindex
+	_CLOSE,	// the client went away
+	_FRAME,	// one packet of the client follows
+	_GAMERUN,	// timer of a table, id is its serial
+	_CTRLRUN,	// timer of a loop, id is the loop
+	_SEED,	// card rng of a table before its shuffle follows, id is its serial
+};
+
+#pragma pack(push, 1)
+struct _TRACE_HEADER
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t recordsize;
+};
+
+struct _TRACE_RECORD
+{
+	uint8_t type;
+	uint8_t loop;
+	uint16_t len;	// of what follows the record
+	uint32_t ip;	// of an open, host order
+	uint64_t tick;	// clockmsec
+	int64_t wall;	// clockwallmsec
+	uint64_t id;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(_TRACE_RECORD) == 32, "_TRACE_RECORD layout is part of the file format");
+
+struct _CARD_RNG;
+
+bool tracestart(const char* filename);
+void traceworker();
+extern bool endtraceworker;
+
+void traceopen(uintptr_t userindex, uint32_t ip);
+void traceclose(uintptr_t userindex);
+void traceframe(uintptr_t userindex, const unsigned char* data, int len);
+void tracerun(_TRACE_TYPE type, uint64_t id);
+void traceseed(int64_t serial, _CARD_RNG& rng);
+
+bool traceisreplay();
+int tracereplay(const char* filename);
@@ -3,20 +3,34 @@
 #include "gamectrl.h"
 #include "socket.h"
 //#include "db.h"
-#include "md5.h"
+#include "logintoken.h"
+#include "seal.h"
+#include "fastlane.h"
+#include "replay.h"
 #include "conf.h"
 #include "sms.h"
+#include "dbpool.h"
+#include "packet.h"
+#include "slabmem.h"
+#include "gpsindex.h"
+#include "admit.h"
+#include "eventlog.h"
+#include "flow.h"
+#include "otp.h"
+#include <memory>
 
 
 user guser;
 
 user::user()
 {
-	this->m_waitings = 0;
-	this->m_userindex = 1;
-	for (int i = 1; i < MAX_USERS + 1; i++) {
-		this->adduser(i, NULL);
-	}
+	this->m_gpsversion = 0;
+	this->m_freehead = 0;
+	this->m_freetail = 0;
+	// slabs are grown as clients come, slot 0 is never handed out so a zero userindex stays invalid
+	memset(this->m_userslabs, 0, sizeof(this->m_userslabs));
+	this->m_slots = 0;
+	this->m_capacity = MAX_USERS;
 }
 
 user::~user()
@@ -26,21 +40,70 @@ user::~user()
 
 void user::clear()
 {
-	std::map <uintptr_t, _USER_INFO*>::iterator iter;// m_mUsers
-	for (iter = this->m_mUsers.begin(); iter != this->m_mUsers.end(); iter++) {
-		bufferevent_free(iter->second->packetdata.bev);
-		delete iter->second;
+	int slots = this->m_slots;
+	this->m_slots = 0;
+
+	for (int slot = 1; slot < slots; slot++) {
+		if (this->getslot(slot)->packetdata.bev != NULL)
+			bufferevent_free(this->getslot(slot)->packetdata.bev);
+		if (this->getslot(slot)->packetdata.wsinput != NULL)
+			evbuffer_free(this->getslot(slot)->packetdata.wsinput);
+		sealfree(this->getslot(slot)->packetdata.seal);
+		fastlanefree(this->getslot(slot)->packetdata.fastlane);
+		replayfree(this->getslot(slot)->replay);
+	}
+
+	for (int n = 0; n < (int)(sizeof(this->m_userslabs) / sizeof(this->m_userslabs[0])); n++) {
+		slabdelete(this->m_userslabs[n], USER_SLAB_SIZE, _MEM_TAG::_USER_SLOT);
+		this->m_userslabs[n] = NULL;
+	}
+	this->m_freehead = 0;
+	this->m_freetail = 0;
+}
+
+void user::setcapacity(int users)
+{
+	if (users < 1)
+		users = 1;
+	if (users > USER_SLOT_MASK)
+		users = USER_SLOT_MASK;
+	this->m_capacity = users;
+}
+
+// one more slab, its slots go to the front of the free list as nobody used them before
+bool user::growusers()
+{
+	int slots = this->m_slots;
+
+	if (slots > this->m_capacity)
+		return false;
+
+	this->m_userslabs[slots >> USER_SLAB_BITS] = slabnew<_USER_INFO>(USER_SLAB_SIZE, _MEM_TAG::_USER_SLOT);
+	int first = (slots == 0) ? 1 : slots;
+	int last = std::min(slots + USER_SLAB_SIZE, this->m_capacity + 1);
+	this->m_vIndexKeys.resize(last);
+
+	for (int slot = last - 1; slot >= first; slot--) {
+		_USER_INFO* userinfo = this->getslot(slot);
+		userinfo->deltick = 0;
+		userinfo->isfreelisted = true;
+		userinfo->nextfree = this->m_freehead;
+		this->m_freehead = slot;
+		if (this->m_freetail == 0)
+			this->m_freetail = slot;
 	}
-	this->m_mUsers.clear();
+
+	this->m_slots.store(last, std::memory_order_release);
+	MSGLOG(DEBUG, "User slots grown to %d.", last - 1);
+	return true;
 }
 
 void user::adduser(uintptr_t userindex, struct bufferevent* bev)
 {
-	_USER_INFO* userinfo = new _USER_INFO;
+	_USER_INFO* userinfo = this->getslot(userindex & USER_SLOT_MASK);
 	userinfo->packetdata.bev = bev;
-	this->m_mUsers[userindex] = userinfo;
 	//userinfo->name = names[this->m_mUsers.size()-1];
-	//msglog(DEBUG, "adduser, name %s userindex %d.", userinfo->name.c_str(), userindex);
+	//MSGLOG(DEBUG, "adduser, name %s userindex %d.", userinfo->name.c_str(), userindex);
 }
 
 bool user::isuserloggedin(uintptr_t token)
@@ -48,114 +111,245 @@ bool user::isuserloggedin(uintptr_t token)
 	if (token == 0)
 		return false;
 
-	std::map <uintptr_t, _USER_INFO*>::iterator iter;
-	for (iter = this->m_mUsers.begin(); iter != this->m_mUsers.end(); iter++) {
-		_USER_INFO* _user = iter->second;
-		if (token == _user->token && _user->isloggedin() && !_user->isdc())
+	auto range = this->m_mTokens.equal_range((int64_t)token);
+	for (auto iter = range.first; iter != range.second; iter++) {
+		_USER_INFO* _user = this->getuser(iter->second);
+		if (_user != NULL && (int64_t)token == _user->token && _user->isloggedin() && !_user->isdc())
 			return true;
 	}
 	return false;
 }
 
-uintptr_t user::getuserindex()
+void user::gettokenusers(int64_t token, std::vector<uintptr_t>& users)
+{
+	users.clear();
+	auto range = this->m_mTokens.equal_range(token);
+	for (auto iter = range.first; iter != range.second; iter++)
+		users.push_back(iter->second);
+}
+
+// token and account indexes, only used on loop 0 and checked against the user on every hit
+void user::indexuser(uintptr_t userindex)
 {
-	uintptr_t freeindex = 0;
-	int passctr = 0;
+	if (le_getloop() > 0) {
+		le_post([this, userindex]() { this->indexuser(userindex); });
+		return;
+	}
+
+	_USER_INFO* userinfo = this->getuser(userindex);
 
-	while (true) {
+	if (userinfo == NULL)
+		return;
+
+	int slot = userindex & USER_SLOT_MASK;
+	this->unindexuser(slot);
 
-		if (this->m_userindex >= MAX_USERS + 1)
-			this->m_userindex = 1;
+	this->m_vIndexKeys[slot] = std::make_pair(userinfo->token, userinfo->account.substr(0, 10));
+	this->m_mTokens.insert(std::make_pair(userinfo->token, userindex));
+	this->m_mAccounts.insert(std::make_pair(this->m_vIndexKeys[slot].second, userindex));
+}
 
-		if (this->m_mUsers[this->m_userindex]->isfreeuser && 
-			GetTickCount64() > this->m_mUsers[this->m_userindex]->deltick) {
-			freeindex = this->m_userindex;
-			this->m_userindex += 1;
+void user::unindexuser(int slot)
+{
+	uintptr_t userindex = this->gethandle(slot);
+	std::pair<int64_t, std::string>& keys = this->m_vIndexKeys[slot];
+
+	auto tokens = this->m_mTokens.equal_range(keys.first);
+	for (auto iter = tokens.first; iter != tokens.second; iter++) {
+		if (iter->second == userindex) {
+			this->m_mTokens.erase(iter);
 			break;
 		}
+	}
 
-		if (passctr >= MAX_USERS) {
-			this->m_userindex += 1;
+	auto accounts = this->m_mAccounts.equal_range(keys.second);
+	for (auto iter = accounts.first; iter != accounts.second; iter++) {
+		if (iter->second == userindex) {
+			this->m_mAccounts.erase(iter);
 			break;
 		}
-
-		this->m_userindex += 1;
-		passctr++;
 	}
 
-	return freeindex;
+	keys.first = 0;
+	keys.second.clear();
 }
 
-_USER_INFO* user::getuser(uintptr_t userindex) 
+uintptr_t user::findaccount(const char* accountid)
 {
-	std::map <uintptr_t, _USER_INFO*>::iterator iter;
-	iter = this->m_mUsers.find(userindex);
-	if (iter == this->m_mUsers.end()) {
-		msglog(DEBUG, "getuser, userindex %llu does not exist.", userindex);
-		return NULL;
+	auto range = this->m_mAccounts.equal_range(std::string(accountid, strnlen(accountid, 10)));
+	for (auto iter = range.first; iter != range.second; iter++) {
+		_USER_INFO* _info = this->getuser(iter->second);
+
+		if (_info == NULL || _info->isfreeuser || _info->ismuadmin)
+			continue;
+
+		if (strncmp(accountid, _info->account.c_str(), 10) == 0)
+			return iter->second;
 	}
-	return iter->second;
+	return 0;
 }
 
-void user::checkaliveusers()
+// the free list is in release order, so when its head is still cooling down every other slot is too,
+// a restore at startup takes the slots before any connection could have held them
+uintptr_t user::getuserindex(bool isrestore)
 {
-	/*std::map <uintptr_t, _USER_INFO*>::iterator iter;
-	for (iter = this->m_mUsers.begin(); iter != this->m_mUsers.end(); iter++) {
-		_USER_INFO* userinfo = iter->second;
-		if (userinfo->alivetick != 0 && 
-			GetTickCount64() > (userinfo->alivetick + ALIVE_TICK_TIMEOUT)) { // timeout occured, should save session info to try resuming the game later...
-			if (iter == this->m_mUsers.end())
-				break;
+	if (this->m_freehead == 0 && !this->growusers())
+		this->refillfreeslots();
+
+	while (this->m_freehead != 0) {
+		int slot = this->m_freehead;
+		_USER_INFO* userinfo = this->getslot(slot);
+
+		// the oldest free slot is still cooling down, so are the ones behind it
+		if (!isrestore && userinfo->isfreeuser && clockmsec() <= userinfo->deltick) {
+			if (!this->growusers())
+				return 0;
+			continue;
 		}
-	}*/
+
+		this->m_freehead = userinfo->nextfree;
+		if (this->m_freehead == 0)
+			this->m_freetail = 0;
+		userinfo->nextfree = 0;
+		userinfo->isfreelisted = false;
+
+		if (!userinfo->isfreeuser)
+			continue;
+
+		// a new generation makes every index still held for the previous owner stale
+		userinfo->gen++;
+		return this->gethandle(slot);
+	}
+
+	return 0;
 }
 
+void user::pushfreeslot(int slot)
+{
+	_USER_INFO* userinfo = this->getslot(slot);
+
+	if (userinfo->isfreelisted || !userinfo->isfreeuser)
+		return;
+
+	userinfo->isfreelisted = true;
+	userinfo->nextfree = 0;
+
+	if (this->m_freetail != 0)
+		this->getslot(this->m_freetail)->nextfree = slot;
+	else
+		this->m_freehead = slot;
+	this->m_freetail = slot;
+}
 
-void user::sendnotice(uintptr_t userindex, unsigned char type, const char* msg, ...)
+// releases happen on any loop, the free list is only touched on loop 0
+void user::freeslot(uintptr_t userindex)
 {
-	char szBuffer[1024] = { 0 };
-	va_list pArguments;
-	va_start(pArguments, msg);
-	size_t iSize = strlen(szBuffer);
-	vsprintf(&szBuffer[iSize], msg, pArguments);
-	va_end(pArguments);
+	if (le_getloop() > 0) {
+		le_post([this, userindex]() { this->freeslot(userindex); });
+		return;
+	}
 
-	_PMSG_NOTICEMSG pMsg = { 0 };
-	pMsg.hdr.c = 0xC1;
-	pMsg.hdr.h = 0xF2;
-	pMsg.hdr.len = sizeof(_PMSG_NOTICEMSG);
-	pMsg.sub = 0x00;
-	pMsg.type = type;
-	memcpy(pMsg.msg, szBuffer, sizeof(pMsg.msg));
+	if (this->getuser(userindex) == NULL)
+		return;
 
-	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+	this->getuser(userindex)->isalivequeued = false;
+	this->unindexuser(userindex & USER_SLOT_MASK);
+	gpsindexremove(userindex);
+	this->pushfreeslot(userindex & USER_SLOT_MASK);
 }
 
-bool user::adduserecoins(uintptr_t userindex, char* accountid, int ecoins, unsigned char ectype, int aindex)
+// picks up slots released by a path that did not go through freeslot
+void user::refillfreeslots()
 {
-	if (accountid == NULL || ectype > 1)
-		return false;
+	int slots = this->m_slots;
+	for (int slot = 1; slot < slots; slot++)
+		this->pushfreeslot(slot);
+}
 
-	uintptr_t _userindex = 0;
-	char sbuf[11] = { 0 };
-	std::map <uintptr_t, _USER_INFO*>::iterator iter;
-	for (iter = this->m_mUsers.begin(); iter != this->m_mUsers.end(); iter++) {
+_USER_INFO* user::getuser(uintptr_t userindex) 
+{
+	uintptr_t slot = userindex & USER_SLOT_MASK;
 
-		if (iter->second->isfreeuser)
-			continue;
+	if (slot == 0 || (int)slot >= this->m_slots.load(std::memory_order_acquire) || this->getslot((int)slot)->gen != (userindex >> USER_SLOT_BITS)) {
+		MSGLOG(DEBUG, "getuser, userindex %llu does not exist.", userindex);
+		return NULL;
+	}
+	return this->getslot((int)slot);
+}
 
-		if (iter->second->ismuadmin)
-			continue;
 
-		memcpy(sbuf, iter->second->account.c_str(), 10);
+// the number to an app that knows it, the english text to the others
+void user::sendnotice(uintptr_t userindex, const _NOTICE& notice)
+{
+	_USER_INFO* userinfo = this->getuser(userindex);
 
-		if (accountid[0] == sbuf[0] && accountid[3] == sbuf[3]) {
-			if (strncmp(accountid, sbuf, 10) == 0) {
-				_userindex = iter->first;
-				break;
+	if (userinfo == NULL)
+		return;
+
+	if (userinfo->isnoticeid) {
+		::datasend(userindex, (unsigned char*)notice.data, notice.packet()->hdr.len);
+		return;
+	}
+
+	_PMSG_NOTICEMSG pMsg;
+	noticetext(notice, pMsg);
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
+
+// adds to the balance of an online account and tells its owner, false when the slot is gone
+bool user::creditecoins(uintptr_t _userindex, int ecoins, unsigned char ectype)
+{
+	_USER_INFO* userinfo = guser.getuser(_userindex);
+
+	if (userinfo == NULL)
+		return false;
+
+	userinfo->ecoins[ectype] += ecoins;
+
+	MSGLOG(INFO, "%d eCoins (%d) added to %s, ecoins now is %d.", ecoins, ectype, userinfo->account.c_str(), userinfo->ecoins[ectype]);
+	addaccountevent(EVENT_ECOINS, userinfo->token, userinfo->account.c_str(), ecoins, ectype);
+
+	if ((userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING)) {
+		int64_t gameserial = userinfo->m_gameserial;
+		if (gameserial == 0) {
+			this->saveecoins(_userindex, ectype);
+		}
+		else {
+			game* _g = gcontrol.getgame(gameserial);
+			if (_g != NULL) {
+				_g->senduserecoinsinfo(_userindex);
+			}
+			else {
+				this->saveecoins(_userindex, ectype);
 			}
 		}
 	}
+	else {
+		this->saveecoins(_userindex, ectype);
+	}
+
+	if (ectype <= 1)
+		this->sendnotice(_userindex, 0, _NOTICE_ID::_ADDED, ecoins, (ectype == 0) ? "eCoins" : "Jewels");
+
+	if (!userinfo->isplaying()) {
+		guser.deluser(_userindex, true);
+		userinfo->relog();
+		_PMSG_LOGIN_RESULT pMsg = c.getbetconf()->loginresult;
+		pMsg.isuseradmin = (userinfo->isuseradmin) ? 1 : 0;
+		userinfo->account.copyto(pMsg.accountid);
+		pMsg.ecoins = userinfo->ecoins[0];
+		pMsg.jewels = userinfo->ecoins[1];
+		::datasend(_userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+	}
+	return true;
+}
+
+bool user::adduserecoins(uintptr_t userindex, char* accountid, int ecoins, unsigned char ectype, int aindex)
+{
+	if (accountid == NULL || ectype > 1)
+		return false;
+
+	uintptr_t _userindex = this->findaccount(accountid);
 
 	_PMSG_ADDECOINS_RES pMsg = { 0 };
 	pMsg.hdr.c = 0xC2;
@@ -168,86 +362,15 @@ bool user::adduserecoins(uintptr_t userindex, char* accountid, int ecoins, unsig
 	pMsg.aindex = aindex;
 	pMsg.ecoins = ecoins;
 
-	if (_userindex != 0) { 
-
-		_USER_INFO* userinfo = guser.getuser(_userindex);
-
-		if (userinfo == NULL)
+	if (_userindex != 0) {
+		if (!this->creditecoins(_userindex, ecoins, ectype))
 			return false;
-
-		userinfo->ecoins[ectype] += ecoins;
-
-		msglog(INFO, "%d eCoins (%d) added to %s, ecoins now is %d.", ecoins, ectype, userinfo->account.c_str(), userinfo->ecoins[ectype]);
-
-		if ((userinfo->m_state & (unsigned char)_USER_STATE::_PLAYING)) {
-			int64_t gameserial = userinfo->m_gameserial;
-			if (gameserial == 0) {
-				this->saveecoins(_userindex, ectype);
-			}
-			else {
-				game* _g = gcontrol.getgame(gameserial);
-				if (_g != NULL) {
-					_g->senduserecoinsinfo(_userindex);
-				}
-				else {
-					this->saveecoins(_userindex, ectype);
-				}
-			}
-		}
-		else {
-			this->saveecoins(_userindex, ectype);
-		}
-
-		if(ectype == 0)
-			this->sendnotice(_userindex, 0, "%d eCoins has been added to your account.", ecoins);
-		else if (ectype == 1)
-			this->sendnotice(_userindex, 0, "%d Jewels has been added to your account.", ecoins);
-
 		pMsg.ecointstotal = guser.getuser(_userindex)->ecoins[ectype];
 		pMsg.result = 1;
-
-		if (!guser.getuser(_userindex)->isplaying()) {
-			guser.deluser(_userindex, true);
-			guser.getuser(_userindex)->relog();
-			_PMSG_LOGIN_RESULT pMsg = { 0 };
-			pMsg.hdr.c = 0xC1;
-			pMsg.hdr.h = 0xF2;
-			pMsg.hdr.len = sizeof(_PMSG_LOGIN_RESULT);
-			pMsg.sub = 0x09;
-			pMsg.result = 1; // option to create game
-			pMsg.isuseradmin = (guser.getuser(userindex)->isuseradmin) ? 1 : 0;
-			strcpy(pMsg.accountid, guser.getuser(_userindex)->account.c_str());
-			pMsg.ecoins = guser.getuser(_userindex)->ecoins[0];
-			pMsg.jewels = guser.getuser(_userindex)->ecoins[1];
-			strcpy(pMsg.ecoinsnote, c.getbetmode(0).name.c_str());
-			strcpy(pMsg.jewelsnote, c.getbetmode(1).name.c_str());
-			::datasend(_userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
-		}
 	}
-	else {
-		/*db.ExecQuery("select guiid, ecoins, jewels from tongits where account_id = '%s'", accountid);
-		if (db.Fetch() != SQL_NO_DATA) 
-		{
-			uintptr_t guiid = db.Geti64("guiid");
-			int currentecoins = db.GetInt("ecoins");
-			int currentjewels = db.GetInt("jewels");
-			db.Clear();
-			if (ectype == 0) {
-				db.ExecQuery("update tongits set ecoins = ecoins + %d where guiid =  %llu", ecoins, guiid);
-				pMsg.ecointstotal = currentecoins + ecoins;
-			}
-			else if(ectype == 1) {
-				db.ExecQuery("update tongits set jewels = jewels + %d where guiid =  %llu", ecoins, guiid);
-				pMsg.ecointstotal = currentjewels + ecoins;
-			}
-			pMsg.result = 1;
-			::datasend(userindex, (unsigned char*)&pMsg, size);
-			return true;
-		}
-		else {
-			db.Clear();
-			pMsg.result = 0;
-		}*/
+	else if (dbisenabled()) {
+		this->addofflineecoins(userindex, accountid, ecoins, ectype, (unsigned char*)&pMsg, size);
+		return true;
 	}
 
 	::datasend(userindex, (unsigned char*)&pMsg, size);
@@ -259,26 +382,7 @@ bool user::getuserecoins(uintptr_t userindex, char* accountid, int ecoins, unsig
 	if (accountid == NULL || ectype > 1)
 		return false;
 
-	uintptr_t _userindex = 0;
-	char sbuf[11] = { 0 };
-	std::map <uintptr_t, _USER_INFO*>::iterator iter;
-	for (iter = this->m_mUsers.begin(); iter != this->m_mUsers.end(); iter++) {
-
-		if (iter->second->isfreeuser)
-			continue;
-
-		if (iter->second->ismuadmin)
-			continue;
-
-		memcpy(sbuf, iter->second->account.c_str(), 10);
-
-		if (accountid[0] == sbuf[0] && accountid[3] == sbuf[3]) {
-			if (strncmp(accountid, sbuf, 10) == 0) {
-				_userindex = iter->first;
-				break;
-			}
-		}
-	}
+	uintptr_t _userindex = this->findaccount(accountid);
 
 	_PMSG_GETECOINS_ANS pMsg = { 0 };
 	pMsg.hdr.c = 0xC2;
@@ -313,72 +417,36 @@ bool user::getuserecoins(uintptr_t userindex, char* accountid, int ecoins, unsig
 
 		userinfo->ecoins[ectype] -= ecoins;
 
-		msglog(INFO, "%d eCoins (%d) cashedout to %s, ecoins now is %d.", ecoins, ectype, userinfo->account.c_str(), userinfo->ecoins[ectype]);
+		MSGLOG(INFO, "%d eCoins (%d) cashedout to %s, ecoins now is %d.", ecoins, ectype, userinfo->account.c_str(), userinfo->ecoins[ectype]);
+		addaccountevent(EVENT_ECOINS, userinfo->token, userinfo->account.c_str(), -ecoins, ectype);
 
 		this->saveecoins(_userindex, ectype);
 
-		if (ectype == 0)
-			this->sendnotice(_userindex, 0, "%d eCoins has been deducted to your account.", ecoins);
-		else if (ectype == 1)
-			this->sendnotice(_userindex, 0, "%d Jewels has been deducted to your account.", ecoins);
+		if (ectype <= 1)
+			this->sendnotice(_userindex, 0, _NOTICE_ID::_DEDUCTED, ecoins, (ectype == 0) ? "eCoins" : "Jewels");
 
-		pMsg.ecointstotal = guser.getuser(_userindex)->ecoins[ectype];
+		pMsg.ecointstotal = userinfo->ecoins[ectype];
 		pMsg.result = 1;
 
-		if (!guser.getuser(_userindex)->isplaying()) {
+		if (!userinfo->isplaying()) {
 			guser.deluser(_userindex, true);
-			guser.getuser(_userindex)->relog();
-			_PMSG_LOGIN_RESULT pMsg = { 0 };
-			pMsg.hdr.c = 0xC1;
-			pMsg.hdr.h = 0xF2;
-			pMsg.hdr.len = sizeof(_PMSG_LOGIN_RESULT);
-			pMsg.sub = 0x09;
-			pMsg.result = 1; // option to create game
-			pMsg.isuseradmin = (guser.getuser(userindex)->isuseradmin) ? 1 : 0;
-			strcpy(pMsg.accountid, guser.getuser(_userindex)->account.c_str());
-			pMsg.ecoins = guser.getuser(_userindex)->ecoins[0];
-			pMsg.jewels = guser.getuser(_userindex)->ecoins[1];
-			strcpy(pMsg.ecoinsnote, c.getbetmode(0).name.c_str());
-			strcpy(pMsg.jewelsnote, c.getbetmode(1).name.c_str());
-			::datasend(_userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
-		}
-	}
-	else {
-		/*db.ExecQuery("select guiid, ecoins, jewels from tongits where account_id = '%s'", accountid);
-		if (db.Fetch() != SQL_NO_DATA) {
-			uintptr_t guiid = db.Geti64("guiid");
-			int currentecoins = db.GetInt("ecoins");
-			int currentjewels = db.GetInt("jewels");
-			db.Clear();
-
-			if (currentecoins < ecoins && ectype == 0) {
-				pMsg.ecointstotal = currentecoins;
-				pMsg.result = 2; // not enough ecoins
-				::datasend(userindex, (unsigned char*)&pMsg, size);
-				return true;
-			}
-
-			if (currentjewels < ecoins && ectype == 1) {
-				pMsg.ecointstotal = currentjewels;
-				pMsg.result = 2; // not enough ecoins
-				::datasend(userindex, (unsigned char*)&pMsg, size);
-				return true;
+			// a disconnected one gave its slot back with the reset
+			_USER_INFO* relogged = guser.getuser(_userindex);
+			_USER_INFO* admininfo = guser.getuser(userindex);
+			if (relogged != NULL) {
+				relogged->relog();
+				_PMSG_LOGIN_RESULT pMsg = c.getbetconf()->loginresult;
+				pMsg.isuseradmin = (admininfo != NULL && admininfo->isuseradmin) ? 1 : 0;
+				relogged->account.copyto(pMsg.accountid);
+				pMsg.ecoins = relogged->ecoins[0];
+				pMsg.jewels = relogged->ecoins[1];
+				::datasend(_userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
 			}
-
-			if (ectype == 0) {
-				db.ExecQuery("update tongits set ecoins = ecoins - %d where guiid =  %llu", ecoins, guiid);
-				pMsg.ecointstotal = currentecoins - ecoins;
-			}
-			else if (ectype == 1) {
-				db.ExecQuery("update tongits set jewels = jewels - %d where guiid =  %llu", ecoins, guiid);
-				pMsg.ecointstotal = currentjewels - ecoins;
-			}
-			pMsg.result = 1;
 		}
-		else {
-			db.Clear();
-			pMsg.result = 0;
-		}*/
+	}
+	else if (dbisenabled()) {
+		this->addofflineecoins(userindex, accountid, -ecoins, ectype, (unsigned char*)&pMsg, size);
+		return true;
 	}
 
 	::datasend(userindex, (unsigned char*)&pMsg, size);
@@ -386,87 +454,202 @@ bool user::getuserecoins(uintptr_t userindex, char* accountid, int ecoins, unsig
 }
 
 
-void user::saveecoins(uintptr_t userindex, unsigned char type)
+// ecoins of an account that is not online go straight to the database, pmsg is the add or cashout
+// answer and gets the result and the new total before it is sent back to the admin
+void user::addofflineecoins(uintptr_t userindex, const char* accountid, int ecoins, unsigned char ectype, unsigned char* pmsg, int size)
 {
-	char szTemp[256] = { 0 };
+	std::vector<unsigned char> msg(pmsg, pmsg + size);
+
+	_DB_JOB* job = new _DB_JOB();
+	job->type = _DB_JOB_TYPE::_ADDECOINS;
+	job->key = accountid;
+	job->value = ecoins;
+	job->ectype = ectype;
+	job->done = [userindex, msg](_DB_JOB* job) mutable {
+
+		if (guser.getuser(userindex) == NULL)
+			return;
+
+		// both answers share the layout up to the result
+		_PMSG_ADDECOINS_RES* pMsg = (_PMSG_ADDECOINS_RES*)msg.data();
+
+		if (job->result == DB_RESULT_OK) {
+			pMsg->ecointstotal = job->account.ecoins[job->ectype];
+			pMsg->result = 1;
+			MSGLOG(INFO, "%+d eCoins (%d) to offline %s, ecoins now is %d.", job->value, job->ectype, job->key.c_str(), pMsg->ecointstotal);
+			addaccountevent(EVENT_ECOINS, job->account.guiid, job->key.c_str(), job->value, job->ectype);
+		}
+		else if (job->result == DB_RESULT_NOTENOUGH) {
+			pMsg->ecointstotal = job->account.ecoins[job->ectype];
+			pMsg->result = 2; // not enough ecoins
+		}
+		else {
+			pMsg->result = 0;
+		}
+
+		::datasend(userindex, (unsigned char*)msg.data(), (int)msg.size());
+	};
+	dbsubmit(job);
+}
 
-	if (type == 0) { // ecoins
-		if (this->getuser(userindex)->ecoins[0] < 0)
-			this->getuser(userindex)->ecoins[0] = 0;
-		sprintf(szTemp, "update tongits set ecoins = %d where guiid =  %llu", this->getuser(userindex)->ecoins[0], this->getuser(userindex)->token);
+// one answer for the whole list, sent by whichever credit finishes last. online accounts are credited
+// here and saved through the ledger, offline ones are queued for the database workers together
+void user::addbulkecoins(uintptr_t userindex, _PMSG_BULKECOINS_INFO* infos, int count, int aindex)
+{
+	std::shared_ptr<_PMSG_BULKECOINS_RES> pMsg = std::make_shared<_PMSG_BULKECOINS_RES>();
+	memset(pMsg.get(), 0, sizeof(_PMSG_BULKECOINS_RES));
+	pMsg->hdr.c = 0xC2;
+	pMsg->hdr.h = 0xF4;
+	pMsg->hdr.len[0] = SET_NUMBERH(sizeof(_PMSG_BULKECOINS_RES));
+	pMsg->hdr.len[1] = SET_NUMBERL(sizeof(_PMSG_BULKECOINS_RES));
+	pMsg->sub = 0x05;
+	pMsg->aindex = aindex;
+	pMsg->count = (unsigned char)count;
+
+	std::vector<_DB_JOB*> vjobs;
+
+	for (int n = 0; n < count; n++) {
+		char accountid[sizeof(infos[n].accountid) + 1] = { 0 };
+		memcpy(accountid, infos[n].accountid, sizeof(infos[n].accountid));
+		int ecoins = infos[n].ecoins;
+		unsigned char ectype = infos[n].ectype;
+
+		if (ectype > 1) {
+			pMsg->failed++;
+			continue;
+		}
+
+		uintptr_t _userindex = this->findaccount(accountid);
+
+		if (_userindex != 0) {
+			if (this->creditecoins(_userindex, ecoins, ectype)) {
+				pMsg->online++;
+				pMsg->total[ectype] += ecoins;
+			}
+			else
+				pMsg->failed++;
+			continue;
+		}
+
+		if (!dbisenabled()) {
+			pMsg->notfound++;
+			continue;
+		}
+
+		_DB_JOB* job = new _DB_JOB();
+		job->type = _DB_JOB_TYPE::_ADDECOINS;
+		job->key = accountid;
+		job->value = ecoins;
+		job->ectype = ectype;
+		vjobs.push_back(job);
 	}
-	else if (type == 1) {
-		if (this->getuser(userindex)->ecoins[1] < 0)
-			this->getuser(userindex)->ecoins[1] = 0;
-		sprintf(szTemp, "update tongits set jewels = %d where guiid =  %llu", this->getuser(userindex)->ecoins[1], this->getuser(userindex)->token);
+
+	MSGLOG(INFO, "Bulk eCoins of %d entries, %d credited online, %d queued offline.", count, pMsg->online, (int)vjobs.size());
+
+	if (vjobs.empty()) {
+		::datasend(userindex, (unsigned char*)pMsg.get(), sizeof(_PMSG_BULKECOINS_RES));
+		return;
 	}
-	//db.ExecQuery(szTemp);
-	//db.Fetch();
-	//db.Clear();
+
+	// completions come back on this loop one at a time
+	std::shared_ptr<int> pending = std::make_shared<int>((int)vjobs.size());
+
+	for (size_t n = 0; n < vjobs.size(); n++) {
+		vjobs[n]->done = [userindex, pMsg, pending](_DB_JOB* job) {
+
+			if (job->result == DB_RESULT_OK) {
+				pMsg->offline++;
+				pMsg->total[job->ectype] += job->value;
+				MSGLOG(INFO, "%+d eCoins (%d) to offline %s, ecoins now is %d.", job->value, job->ectype, job->key.c_str(), job->account.ecoins[job->ectype]);
+				addaccountevent(EVENT_ECOINS, job->account.guiid, job->key.c_str(), job->value, job->ectype);
+			}
+			else if (job->result == DB_RESULT_NOTFOUND)
+				pMsg->notfound++;
+			else if (job->result == DB_RESULT_NOTENOUGH)
+				pMsg->notenough++;
+			else
+				pMsg->failed++;
+
+			if (--(*pending) > 0 || guser.getuser(userindex) == NULL)
+				return;
+
+			::datasend(userindex, (unsigned char*)pMsg.get(), sizeof(_PMSG_BULKECOINS_RES));
+		};
+		dbsubmit(vjobs[n]);
+	}
+}
+
+void user::saveecoins(uintptr_t userindex, unsigned char type)
+{
+	_USER_INFO* _user = this->getuser(userindex);
+
+	if (_user == NULL || type > 1)
+		return;
+
+	if (_user->ecoins[type] < 0)
+		_user->ecoins[type] = 0;
+
+	// coalesced with the other balances of the batch by the ledger
+	if (dbisenabled() && _user->token > 0)
+		dbsavebalance(_user->token, type, _user->ecoins[type]);
 }
 
+// the number is the one this connection asked a code for, the code is the store's
 void user::otpcode(int otpcode, uintptr_t userindex)
 {
-	char sbuf[100] = { 0 };
 	std::string _mobilenum;
 
-	int _otpcode = this->getuser(userindex)->otpcode;
 	_mobilenum = this->getuser(userindex)->mobilenum;
 
-	if (_otpcode == 0)
+	if (_mobilenum.empty())
+		return;
+
+	_OTP_RESULT result = otpverify(_mobilenum, otpcode);
+	if (result == _OTP_RESULT::_NONE)
 		return;
-	if (_otpcode != otpcode) {
-		this->sendnotice(userindex, 8, "You have entered a wrong OTP code.");
-		msglog(INFO, "Wrong OTP Code %d / %d, mobile num %s.", otpcode, _otpcode, _mobilenum.c_str());
+	if (result != _OTP_RESULT::_OK) {
+		this->sendnotice(userindex, 8, _NOTICE_ID::_WRONGOTP);
+		MSGLOG(INFO, "Wrong OTP Code %d, mobile num %s%s.", otpcode, _mobilenum.c_str(),
+			(result == _OTP_RESULT::_LOCKED) ? ", the code is burned" : "");
 		return;
 	}
 
-	char logintoken[33] = { 0 };
-	MD5 pMD5Hash;
-	DWORD dwAccKey = MakeAccountKey((char*)_mobilenum.c_str());
-	sprintf(sbuf, "%s%d%llu", _mobilenum.c_str(), otpcode, GetTickCount64());
-	pMD5Hash.MD5_EncodeString(sbuf, logintoken, dwAccKey);
+	if (!dbisenabled()) {
+		this->setuserlogin(userindex, _mobilenum.c_str(), NULL, NULL);
+		return;
+	}
 
-	sprintf(sbuf, "select guiid, ecoins from tongits where mobile_num='%s' and mode = 1", _mobilenum.c_str());
-	/*if (db.ExecQuery(sbuf)) {
-		if (db.Fetch() == SQL_NO_DATA) {
-			this->sendnotice(userindex, 8, "Fetching your account's data failed!");
-			msglog(SQL, "otplogin, failed (%s).", sbuf);
+	_DB_JOB* job = new _DB_JOB();
+	job->type = _DB_JOB_TYPE::_MOBILELOGIN;
+	job->key = _mobilenum;
+	job->done = [userindex](_DB_JOB* job) {
+
+		if (guser.getuser(userindex) == NULL)
+			return;
+
+		if (job->result != DB_RESULT_OK) {
+			guser.sendnotice(userindex, 8, _NOTICE_ID::_FETCHFAILED);
 			return;
 		}
-		else {
-			this->getuser(userindex)->token = db.Geti64("guiid");
-			this->getuser(userindex)->ecoins[0] = db.GetInt("ecoins");
-			this->getuser(userindex)->account = _mobilenum;
-		}
-	}
-	else {
-		this->sendnotice(userindex, 8, "Fetching your account's data failed!");
-		msglog(SQL, "otplogin, failed (%s).", sbuf);
-		return;
-	}*/
 
-	//db.Clear();
+		guser.setuserlogin(userindex, job->key.c_str(), &job->account, NULL);
+	};
+	dbsubmit(job);
+}
 
-	/*if (db.ExecQuery("update tongits set acctoken='%s' where guiid = %llu", logintoken, guser.getuser(userindex)->token)) {
-		_PMSG_TOKEN_INFO pMsg = { 0 };
-		pMsg.hdr.c = 0xC1;
-		pMsg.hdr.h = 0xF2;
-		pMsg.hdr.len = sizeof(_PMSG_TOKEN_INFO);
-		pMsg.sub = 0x07;
-		pMsg.flag = 1; // set token
-		memcpy(pMsg.token, logintoken, sizeof(pMsg.token));
-		msglog(DEBUG, "otpcode, assigned token %s to %s.", logintoken, _mobilenum.c_str());
-		::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
-	}*/
-	this->getuser(userindex)->setlogged();
-	gcontrol.getusersessioninfo(guser.getuser(userindex)->token, userindex);
+struct _OTP_FLOW : _FLOW
+{
+	std::string mobilenum;	// 63 and the number
+	std::string entered;	// as the player typed it
+	int otpcode;
+	bool issend;	// false when the code of the number is on its phone already
+	_SMS_INFO sms;
 
-}
+	bool run() override;
+};
 
 void user::otplogin(char* mobilenum, uintptr_t userindex)
 {
-	char sbuf[100] = { 0 };
 	std::string _m;
 	std::string _mobilenum;
 
@@ -475,72 +658,86 @@ void user::otplogin(char* mobilenum, uintptr_t userindex)
 	if (strlen(mobilenum) < 11)
 		return;
 
-	if (!SQLSyntexCheck(mobilenum))
-		return;
-
-	int otpcode = rand() % 9000 + 1000;
-
-	msglog(INFO, "otplogin, mobile number %s.", mobilenum);
+	MSGLOG(INFO, "otplogin, mobile number %s.", mobilenum);
 
 	if (mobilenum[0] == '0' && (mobilenum[1] == '8' || mobilenum[1] == '9') && strlen(mobilenum) == 11) {
 		_m = mobilenum;
-		msglog(INFO, "otplogin, mobile number %s otp code %d.", _m.c_str(), otpcode);
 		_mobilenum = "63" + _m.substr(1, _m.length() - 1);
-		msglog(INFO, "otplogin, mobile number %s otp code %d.", _mobilenum.c_str(), otpcode);
 	}
 	else if (mobilenum[0] == '6' && mobilenum[1] == '3' && (mobilenum[2] == '8' || mobilenum[2] == '9') && strlen(mobilenum) == 12)
 	{
 		_mobilenum = mobilenum;
-		msglog(INFO, "otplogin, mobile number %s otp code %d.", _mobilenum.c_str(), otpcode);
 	}
 	else {
-		guser.sendnotice(userindex, 8, "You mobile number %s is invalid, format should be like 09170342328.");
+		guser.sendnotice(userindex, 8, _NOTICE_ID::_BADMOBILE, mobilenum);
 		return;
 	}
 
-	sprintf(sbuf, "select guiid from tongits where mobile_num='%s' and mode = 1", _mobilenum.c_str());
+	_OTP_FLOW* flow = new _OTP_FLOW();
+	flow->mobilenum = _mobilenum;
+	flow->entered = mobilenum;
+	flow->otpcode = 0;
+	flow->issend = false;
+	flowstart(flow, userindex);
+}
 
-	uintptr_t _token = 0;
+static _DB_JOB* otpjob(const std::string& mobilenum)
+{
+	_DB_JOB* job = new _DB_JOB();
+	job->type = _DB_JOB_TYPE::_MOBILELOGIN;
+	job->key = mobilenum;
+	return job;
+}
 
-	/*if (db.ExecQuery(sbuf)) {
-		if (db.Fetch() == SQL_NO_DATA) {
-			db.Clear();
-			sprintf(sbuf, "insert into tongits (account_id, mobile_num, acctoken, mode) values ('%s', '%s', 'NONE', 1)",
-				_mobilenum.c_str(),
-				_mobilenum.c_str()
-			);
-			if (!db.ExecQuery(sbuf)) {
-				msglog(SQL, "otplogin, failed (%s).", sbuf);
-				return;
-			}
+// the account is looked up first so a logged in account gets no sms, and the player is told the code
+// is sent once the sms gateway took it. a number that has a live code is answered at once, a reconnect
+// that asks again costs no sms
+bool _OTP_FLOW::run()
+{
+	char sbuf[100] = { 0 };
+
+	FLOW_BEGIN;
+
+	if (dbisenabled()) {
+		FLOW_WAIT(flowdb(this, otpjob(mobilenum)));
+
+		if (db.result != DB_RESULT_OK) {
+			MSGLOG(SQL, "otplogin, failed to fetch %s.", mobilenum.c_str());
+			return false;
 		}
-		else {
-			_token = db.Geti64("guiid");
+
+		if (guser.isuserloggedin(db.account.guiid)) {
+			guser.sendnotice(userindex, 8, _NOTICE_ID::_LOGGEDIN);
+			return false;
 		}
 	}
-	else {
-		msglog(SQL, "otplogin, failed (%s).", sbuf);
-		return;
-	}*/
-
-	//db.Clear();
 
-	if (this->isuserloggedin(_token)) {
-		this->sendnotice(userindex, 8, "Your account is already logged in!");
-		return;
+	// the code is taken while the gateway is still answering, the sms may be on the phone before
+	otpcode = otpissue(mobilenum, issend);
+	guser.getuser(userindex)->mobilenum = mobilenum;
+	MSGLOG(INFO, "otplogin, mobile number %s otp code %d%s.", mobilenum.c_str(), otpcode, issend ? "" : ", sent already");
+
+	isok = true;
+	if (issend) {
+		snprintf(sbuf, sizeof(sbuf), "Your Tongits Classic OTP Code is %d.", otpcode);
+		sms.mobilenumber = mobilenum;
+		sms.otpmsg = sbuf;
+		FLOW_WAIT(flowsms(this, sms, "otp to " + mobilenum));
 	}
 
-	sprintf(sbuf, "Your Tongits Classic OTP Code is %d.", otpcode);
+	guser.sendotp(userindex, mobilenum, entered.c_str(), otpcode, isok);
+	FLOW_DONE;
+}
 
-	if (!this->sendsmsotp(_mobilenum.c_str(), sbuf)) {
-		this->sendnotice(userindex, 8, "Something went wrong with our OTP system, please try again in few minutes.");
+void user::sendotp(uintptr_t userindex, const std::string& mobilenum, const char* entered, int otpcode, bool issent)
+{
+	if (!issent) {
+		otpdrop(mobilenum, otpcode);
+		this->sendnotice(userindex, 8, _NOTICE_ID::_OTPFAILED);
 		return;
 	}
-	else {
-		this->getuser(userindex)->otpcode = otpcode;
-		this->getuser(userindex)->mobilenum = _mobilenum;
-		this->sendnotice(userindex, 8, "OTP code is sent to your mobile number %s.", mobilenum);
-	}
+
+	this->sendnotice(userindex, 8, _NOTICE_ID::_OTPSENT, entered);
 
 	_PMSG_OTP_RES pMsg;
 	pMsg.hdr.c = 0xC1;
@@ -553,8 +750,13 @@ void user::otplogin(char* mobilenum, uintptr_t userindex)
 
 void user::mulogin(char* musecret, uintptr_t userindex)
 {
+	_USER_INFO* userinfo = this->getuser(userindex);
+
+	if (userinfo == NULL)
+		return;
+
 	if (strncmp(musecret, c.getmusecret().c_str(), c.getmusecret().length()) == 0) {
-		this->getuser(userindex)->setmuadmin();
+		userinfo->setmuadmin();
 
 		_PMSG_MULOGIN_RES pMsg = { 0 };
 		pMsg.hdr.c = 0xC2;
@@ -566,263 +768,186 @@ void user::mulogin(char* musecret, uintptr_t userindex)
 		pMsg.result = 1;
 		::datasend(userindex, (unsigned char*)&pMsg, size);
 
-		msglog(INFO, "mulogin, MU Admin set at index %d.", userindex);
+		MSGLOG(INFO, "mulogin, MU Admin set at index %d.", userindex);
 	}
 }
 
-void user::tokenlogin(char* logintoken, uintptr_t userindex)
+static void sendcleartoken(uintptr_t userindex)
 {
-	char szTemp[256] = { 0 };
-	bool clearlogintoken = false;
+	_PMSG_TOKEN_INFO pMsg = pkttemplate<_PMSG_TOKEN_INFO>(0xF2, 0x07);
+	pMsg.flag = 0; // delete token
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
+}
 
-	if (logintoken == NULL) {
-		clearlogintoken = true;
+void user::tokenlogin(char* logintoken, uintptr_t userindex)
+{
+	// token login needs the database, without it the client is sent back to the user login
+	if (logintoken == NULL || strlen(logintoken) != 32 || !dbisenabled()) {
+		sendcleartoken(userindex);
+		MSGLOG(DEBUG, "sent clear login token packet.");
+		return;
 	}
 
-	if (logintoken != NULL && strlen(logintoken) != 32) {
-		clearlogintoken = true;
-	}
+	// a token that does not verify may still be an md5 token stored by an older server
+	int64_t guiid;
+	if (!logintokenverify(logintoken, guiid))
+		guiid = 0;
 
-	uintptr_t _token = 0;
+	// a resume takes its turn in a reconnect storm before the query, the player the table waits on first
+	uintptr_t session = (guiid != 0) ? gcontrol.getsessionuserid((uintptr_t)guiid) : 0;
+	_USER_INFO* sessioninfo = (session != 0) ? this->getuser(session) : NULL;
+	if (sessioninfo != NULL && !admitresume(userindex, guiid, sessioninfo->activetick != 0))
+		return;
 
-	if (clearlogintoken == false) {
+	_DB_JOB* job = new _DB_JOB();
+	job->type = _DB_JOB_TYPE::_TOKENLOGIN;
+	job->key = logintoken;
+	job->guiid = guiid;
+	job->done = [userindex](_DB_JOB* job) {
 
-		if (!SQLSyntexCheck(logintoken)) {
-			msglog(SQL, "tokenlogin, anti-sql injection invoked, logintoken %s", logintoken);
+		// the client left while the query ran
+		if (guser.getuser(userindex) == NULL)
 			return;
-		}
 
-		sprintf(szTemp, "SELECT guiid, account_id, acctoken, mobile_num, ecoins, jewels, gametoken, mode, nogps, isadmin from tongits where acctoken='%s'", logintoken);
+		if (job->result == DB_RESULT_FAILED)
+			guser.sendnotice(userindex, 8, _NOTICE_ID::_FETCHFAILED);
 
-		/*if (db.ExecQuery(szTemp)) {
-			if (db.Fetch() == SQL_NO_DATA) {
-				this->sendnotice(userindex, 8, "Fetching your account's data failed!");
-				clearlogintoken = true;
-			}
-			else {
-				_token = db.Geti64("guiid");
-			}
+		if (job->result != DB_RESULT_OK || job->account.mode != GAME_TYPE) {
+			sendcleartoken(userindex);
+			MSGLOG(DEBUG, "sent clear login token packet, %d %d.", job->result, job->account.mode);
+			return;
 		}
-		else {
-			this->sendnotice(userindex, 8, "Fetching your account's data failed!");
-			msglog(SQL, "Failed query, (%s).", szTemp);
-			clearlogintoken = true;
-		}*/
-
-		//db.Clear();
-	}
-
-	if (this->isuserloggedin(_token)) {
-		this->sendnotice(userindex, 8, "Your account is already logged in!");
-		return;
-	}
-	/*
-	int gametype = db.GetInt("mode");
-
-	if (clearlogintoken || gametype != GAME_TYPE) {
-		_PMSG_TOKEN_INFO pMsg = { 0 };
-		pMsg.hdr.c = 0xC1;
-		pMsg.hdr.h = 0xF2;
-		pMsg.hdr.len = sizeof(_PMSG_TOKEN_INFO);
-		pMsg.sub = 0x07;
-		pMsg.flag = 0; // delete token
-		::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
-		msglog(DEBUG, "sent clear login token packet, %d %d.", clearlogintoken, gametype);
-		return;
-	}
-
-	_USER_INFO* _user = this->getuser(userindex);
-	char sbuf[20] = { 0 };
-	db.GetStr("account_id", sbuf);
-	_user->account = sbuf;
-	db.GetStr("mobile_num", sbuf);
-	_user->mobilenum = sbuf;
-	if (_user->account.length() == 0)
-		_user->account = _user->mobilenum;
-	_user->token = db.Geti64("guiid");
-	_user->ecoins[0] = db.GetInt("ecoins");
-	_user->ecoins[1] = db.GetInt("jewels");
-	_user->gametoken = db.GetInt("gametoken");
-	_user->isuseradmin = (db.GetInt("isadmin") == 1) ? true : false;
-	_user->isnogps = (db.GetInt("nogps") == 1) ? true : false;
-	
-	msglog(INFO, "[tokenlogin] %s login data, login token: %s session token: %d ecoins: %d jewels: %d gametoken: %d",
-		_user->account,
-		logintoken,
-		_user->token,
-		_user->ecoins[0],
-		_user->ecoins[1],
-		_user->gametoken
-	);
-	*/
-	//_user->setlogged();
-	//gcontrol.getusersessioninfo(_user->token, userindex);
 
+		guser.setuserlogin(userindex, job->account.account.c_str(), &job->account, job->key.c_str());
+	};
+	dbsubmit(job);
 }
 
 void user::userlogin(char* username, char* secret, uintptr_t userindex)
 {
-	char sbuf[50] = { 0 };
-	char logintoken[33] = { 0 };
-	char szTemp[256] = { 0 };
-	BYTE btBinaryPass[16] = { 0 };
-	int err = 0;
-
 	if (username == NULL || secret == NULL)
 		return;
 
 	if (strlen(username) >= 20 || strlen(secret) >= 20)
 		return;
 
-	if (!SQLSyntexCheck(username) || !SQLSyntexCheck(secret)) {
-		msglog(SQL, "userlogin, anti-sql injection invoked, user %s pass %s", username, secret);
+	if (!dbisenabled()) {
+		this->setuserlogin(userindex, username, NULL, NULL);
 		return;
 	}
 
-	try
-	{
-		MD5 pMD5Hash;
-		DWORD dwAccKey = MakeAccountKey(username);
-
-		/*if (c.issecretmd5() == false) {
-			sprintf(szTemp, "SELECT memb__pwd from MEMB_INFO where memb___id='%s' and memb__pwd = '%s'", username, secret);
-			if (db.ExecQuery(szTemp)) {
-				if (db.Fetch() == SQL_NO_DATA) {
-					this->sendnotice(userindex, 8, "Wrong username or password!");
-					msglog(SQL, "Account %s does not exist.", username);
-					db.Clear();
-					return;
-				}
-			}
-			else {
-				this->sendnotice(userindex, 8, "Wrong username or password!");
-				msglog(SQL, "Failed query, (%s).", szTemp);
-				db.Clear();
-				return;
-			}
-		}
-		else {
+	_DB_JOB* job = new _DB_JOB();
+	job->type = _DB_JOB_TYPE::_USERLOGIN;
+	job->key = username;
+	job->secret = secret;
+	job->issecretmd5 = c.issecretmd5();
+	job->done = [userindex](_DB_JOB* job) {
 
-			sprintf(szTemp, "SELECT memb__pwd from MEMB_INFO where memb___id='%s'", username);
-			if (db.ReadBlob(szTemp, btBinaryPass) < 0) {
-				this->sendnotice(userindex, 8, "Wrong username or password!");
-				msglog(SQL, "Account %s does not exist.", username);
-				db.Clear();
-				return;
-			}
+		if (guser.getuser(userindex) == NULL)
+			return;
 
-			if (pMD5Hash.MD5_CheckValue(secret, (char*)btBinaryPass, dwAccKey) == false)
-			{
-				this->sendnotice(userindex, 8, "Wrong username or password!");
-				msglog(SQL, "%s wrong password.", username);
-				db.Clear();
-				return;
-			}
+		if (job->result == DB_RESULT_NOTFOUND) {
+			guser.sendnotice(userindex, 8, _NOTICE_ID::_WRONGLOGIN);
+			MSGLOG(SQL, "userlogin, %s wrong username or password.", job->key.c_str());
+			return;
 		}
 
-		db.Clear();*/
-		msglog(INFO, "%s logged in.", username);
-
-		sprintf(szTemp, "SELECT guiid, mobile_num, ecoins, jewels, gametoken, nogps from tongits where account_id='%s'", username);
-
-		/*if (db.ExecQuery(szTemp)) {
-			if (db.Fetch() == SQL_NO_DATA) {
-				msglog(INFO, "%s does not exist in tongits db, inserting...", username);
-				sprintf(szTemp, "insert into tongits (account_id, acctoken) values ('%s', 'NONE')", username);
-				db.Clear();
-				if (db.ExecQuery(szTemp)) {
-					msglog(INFO, "%s does not exist in tongits db, inserting done.", username);
-					sprintf(szTemp, "SELECT guiid, acctoken, mobile_num, ecoins, jewels, gametoken, nogps from tongits where account_id='%s'", username);
-					if (db.ExecQuery(szTemp)) {
-						if (db.Fetch() == SQL_NO_DATA) {
-							this->sendnotice(userindex, 8, "Fetching your account's data failed!");
-							return;
-						}
-					}
-					else {
-						this->sendnotice(userindex, 8, "Fetching your account's data failed!");
-						msglog(SQL, "Failed query, (%s).", szTemp);
-						return;
-					}
-				}
-				else {
-					this->sendnotice(userindex, 8, "Fetching your account's data failed!");
-					msglog(SQL, "Failed query, (%s).", szTemp);
-					return;
-				}
-			}
-		}
-		else {
-			msglog(SQL, "Failed query, (%s).", szTemp);
-			this->sendnotice(userindex, 8, "Fetching your account's data failed!");
+		if (job->result != DB_RESULT_OK) {
+			guser.sendnotice(userindex, 8, _NOTICE_ID::_FETCHFAILED);
 			return;
-		}*/
+		}
 
+		guser.setuserlogin(userindex, job->key.c_str(), &job->account, NULL);
+	};
+	dbsubmit(job);
+}
 
-		_USER_INFO* _user = this->getuser(userindex);
-		_user->account = username;
-		//_user->token = db.Geti64("guiid");
-		//_user->ecoins[0] = db.GetInt("ecoins");
-		//_user->ecoins[1] = db.GetInt("jewels");
-		//_user->gametoken = db.GetInt("gametoken");
-		//_user->isnogps = (db.GetInt("nogps") == 1) ? true : false;
+// finishes a login on the loop, account is NULL without a database and logintoken is set for a token login
+void user::setuserlogin(uintptr_t userindex, const char* username, const _DB_ACCOUNT* account, const char* logintoken)
+{
+	_USER_INFO* _user = this->getuser(userindex);
 
-		if (this->isuserloggedin(_user->token)) {
-			this->sendnotice(userindex, 8, "Your account is already logged in!");
-			return;
-		}
+	if (_user == NULL)
+		return;
 
-		sprintf(sbuf, "%s%llu%llu", username, _user->token, GetTickCount64());
-		pMD5Hash.MD5_EncodeString(sbuf, logintoken, dwAccKey);
-
-
-		msglog(INFO, "[userlogin] %s login data, login token: %s session token: %d ecoins: %d jewels: %d gametoken: %d", 
-			username,
-			logintoken, 
-			_user->token, 
-			_user->ecoins[0],
-			_user->ecoins[1],
-			_user->gametoken
-		);
-
-		//db.Clear();
-
-		/*if (db.ExecQuery("update tongits set acctoken='%s' where guiid = %llu", logintoken, _user->token)) {
-			_PMSG_TOKEN_INFO pMsg = { 0 };
-			pMsg.hdr.c = 0xC1;
-			pMsg.hdr.h = 0xF2;
-			pMsg.hdr.len = sizeof(_PMSG_TOKEN_INFO);
-			pMsg.sub = 0x07;
-			pMsg.flag = 1; // set token
-			memcpy(pMsg.token, logintoken, sizeof(pMsg.token));
-			msglog(DEBUG, "userlogin, assignd token %s to %s.", logintoken, username);
-			::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
-		}*/
-
-		_user->setlogged();
-		gcontrol.getusersessioninfo(_user->token, userindex);
-	}
-	catch (...)
-	{
-		msglog(SQL, "MD5 Password Decrypt Failed - AccountId : %s", username);
+	_user->account = username;
+
+	if (account != NULL) {
+		_user->mobilenum = account->mobilenum;
+		if (_user->account.length() == 0)
+			_user->account = _user->mobilenum;
+		_user->token = account->guiid;
+		_user->ecoins[0] = account->ecoins[0];
+		_user->ecoins[1] = account->ecoins[1];
+		_user->gametoken = account->gametoken;
+		_user->isuseradmin = account->isadmin;
+		_user->isnogps = account->nogps;
+	}
+
+	if (this->isuserloggedin(_user->token)) {
+		this->sendnotice(userindex, 8, _NOTICE_ID::_LOGGEDIN);
+		return;
+	}
+
+	// a user login hands out a new login token, a token login keeps the one it came with
+	char newtoken[LOGINTOKEN_LENGTH + 1] = { 0 };
+
+	if (logintoken == NULL && account != NULL) {
+		logintokenmint(_user->token, newtoken);
+		this->sendlogintoken(userindex, newtoken);
 	}
+
+	MSGLOG(INFO, "[%s] %s login data, login token: %s session token: %lld ecoins: %d jewels: %d gametoken: %d",
+		(logintoken == NULL) ? "userlogin" : "tokenlogin",
+		_user->account.c_str(),
+		(logintoken == NULL) ? newtoken : logintoken,
+		(long long)_user->token,
+		_user->ecoins[0],
+		_user->ecoins[1],
+		_user->gametoken
+	);
+
+	_user->setlogged();
+	this->indexuser(userindex);
+	fastlaneoffer(userindex);
+	addaccountevent(EVENT_LOGIN, _user->token, _user->account.c_str(), _user->ecoins[0]);
+	gcontrol.getusersessioninfo(_user->token, userindex);
+}
+
+// the token is signed rather than stored, so it goes out before the session is looked up and a
+// resume moves the connection
+void user::sendlogintoken(uintptr_t userindex, const char* logintoken)
+{
+	_PMSG_TOKEN_INFO pMsg = pkttemplate<_PMSG_TOKEN_INFO>(0xF2, 0x07);
+	pMsg.flag = 1; // set token
+	memcpy(pMsg.token, logintoken, sizeof(pMsg.token));
+	MSGLOG(DEBUG, "userlogin, assigned token %s to %s.", logintoken, this->getuser(userindex)->account.c_str());
+	::datasend(userindex, (unsigned char*)&pMsg, pMsg.hdr.len);
 }
 
 void user::delmuadmin(uintptr_t userindex)
 {
-	_USER_INFO* userinfo = this->m_mUsers[userindex];
+	_USER_INFO* userinfo = this->getuser(userindex);
+	if (userinfo == NULL)
+		return;
 	userinfo->set();
 	userinfo->init();
+	this->freeslot(userindex);
 }
 
 void user::deluser(uintptr_t userindex, bool isreset)
 {
-	_USER_INFO* userinfo = this->m_mUsers[userindex];
+	_USER_INFO* userinfo = this->getuser(userindex);
+
+	if (userinfo == NULL)
+		return;
 
 	if (isreset) {
 		gcontrol.endgamesession(userinfo->token, userindex);
-		if(userinfo->isdc())
+		if (userinfo->isdc()) {
 			userinfo->set();
+			this->freeslot(userindex);
+		}
 		else
 			userinfo->endgame();
 		userinfo->init();
@@ -831,23 +956,43 @@ void user::deluser(uintptr_t userindex, bool isreset)
 
 	// the session data should be saved to database before resetting this user info so later the user can resume the game
 	if (userinfo->m_gameserial == 0) { // we can end the session now as the  user is not linked to game
-		msglog(DEBUG, "deluser, userindex %llu endgamesession.", userindex);
+		MSGLOG(DEBUG, "deluser, userindex %llu endgamesession.", userindex);
 		gcontrol.endgamesession(userinfo->token, userindex);
 		// finally we will do init to reset info
 		userinfo->set();
 		userinfo->init();
+		this->freeslot(userindex);
 	}
 	else {
-		msglog(DEBUG, "deluser, userindex %llu disconnected with resume option.", userindex);
+		MSGLOG(DEBUG, "deluser, userindex %llu disconnected with resume option.", userindex);
 		userinfo->disconnected(); // player can go back and resume game session later
 	}
 }
 
 void user::updateuserbev(uintptr_t userid, uintptr_t resume_userid)
 {
-	bufferevent_free(this->getuser(resume_userid)->packetdata.bev);
-	this->getuser(resume_userid)->packetdata.bev = this->getuser(userid)->packetdata.bev;
-	this->getuser(resume_userid)->packetdata.bufferlen = 0;
+	_USER_INFO* userinfo = this->getuser(userid);
+	_USER_INFO* resumeinfo = this->getuser(resume_userid);
+
+	if (userinfo == NULL || resumeinfo == NULL)
+		return;
+
+	_PACKET_DATA& from = userinfo->packetdata;
+	_PACKET_DATA& to = resumeinfo->packetdata;
+
+	le_releaseconn(to);
+	le_freebev(to.bev, to.loop);
+	to.bev = from.bev;
+	to.loop = from.loop.load();
+	// the payloads still to parse follow the connection, each slot keeps a buffer of its own
+	to.websocket = from.websocket;
+	std::swap(to.wsinput, from.wsinput);
+	std::swap(to.seal, from.seal);
+	std::swap(to.fastlane, from.fastlane);
+	to.listener = from.listener.exchange(-1);
+	// a refresh the old connection held back is stale by now
+	to.parked.clear();
+	to.isoverflow = false;
 }
 
 double user::getdistancegps(double lat1, double long1, double lat2, double long2)
@@ -861,96 +1006,319 @@ double user::getdistancegps(double lat1, double long1, double lat2, double long2
 	return dist;
 }
 
-bool user::sendsmsotp(const char* smsnum, char* otpmsg) 
+void user::setgps(_USER_INFO* _info, double latitude, double longitude)
 {
-	lock.lock();
-	_SMS_INFO smsinfo;
-	smsinfo.mobilenumber = smsnum;
-	smsinfo.otpmsg = otpmsg;
-	vsmsinfo.push_back(smsinfo);
-	lock.unlock();
+	_info->gps.tick = clockmsec() + 60000;
+
+	if (_info->gps.version != 0 && _info->gps.latitude == latitude && _info->gps.longitude == longitude)
+		return;
+
+	_info->gps.latitude = latitude;
+	_info->gps.longitude = longitude;
+	_info->gps.x = cos(toRad(latitude)) * cos(toRad(longitude));
+	_info->gps.y = cos(toRad(latitude)) * sin(toRad(longitude));
+	_info->gps.z = sin(toRad(latitude));
+
+	uint32_t version = ++this->m_gpsversion;
+	if (version == 0)
+		version = ++this->m_gpsversion;
+	_info->gps.version = version;
+}
+
+// closer than the gps limit, no trig as the limit is kept as a cosine
+bool user::isgpsnear(_USER_INFO* _info1, _USER_INFO* _info2)
+{
+	double dot = _info1->gps.x * _info2->gps.x + _info1->gps.y * _info2->gps.y + _info1->gps.z * _info2->gps.z;
+	return dot > c.getgpslimitcos();
+}
+
+// players of a bet mode wait in queues, gps players are bucketed by a grid cell about the size of the
+// gps limit so a table is built from the fronts of a few cells instead of a walk over every user
+bool user::ismatchable(uintptr_t userindex, unsigned char gametype)
+{
+	_USER_INFO* _info = this->getuser(userindex);
+
+	if (_info == NULL || _info->isfreeuser)
+		return false;
+
+	if (!(_info->m_state & (unsigned char)_USER_STATE::_WAITING))
+		return false;
+
+	if (_info->ectype != gametype)
+		return false;
+
+	if (this->isgpsmatch(_info) && !this->hasgpsfix(_info))
+		return false;
+
 	return true;
 }
 
-void user::trystartgame(unsigned char gametype)
+bool user::isgpsmatch(_USER_INFO* _info)
 {
-	int ctr = 0;
-	uintptr_t user[3];
-	std::map <uintptr_t, _USER_INFO*>::iterator iter;
-	for (iter = this->m_mUsers.begin(); iter != this->m_mUsers.end(); iter++) {
+	return c.getgpslimitdis() != 0.0f && !_info->isnogps;
+}
 
-		if (iter->second->isfreeuser)
-			continue;
+bool user::hasgpsfix(_USER_INFO* _info)
+{
+	return !(_info->gps.longitude == 0.000000f || _info->gps.latitude == 0.000000f || clockmsec() > _info->gps.tick);
+}
 
-		if (!(iter->second->m_state & (unsigned char)_USER_STATE::_WAITING))
-			continue;
+std::pair<int, int> user::getgpscell(_USER_INFO* _info)
+{
+	// one degree of latitude is about 111 km
+	double celldeg = c.getgpslimitdis() / 111.0;
+	if (celldeg <= 0.0)
+		celldeg = 1.0;
+	return std::make_pair((int)floor(_info->gps.latitude / celldeg), (int)floor(_info->gps.longitude / celldeg));
+}
 
-		if (iter->second->ectype != gametype)
-			continue;
+void user::queuematch(uintptr_t userindex, unsigned char gametype)
+{
+	_USER_INFO* _info = this->getuser(userindex);
 
-		if (iter->second->isnogps)
-			continue;
+	if (_info == NULL || _info->ismatchqueued || !this->ismatchable(userindex, gametype))
+		return;
 
+	_MATCH_QUEUE& queue = this->m_mMatchQueues[gametype];
 
-		if (c.getgpslimitdis() != 0.0f) {
+	if (this->isgpsmatch(_info))
+		queue.mCells[this->getgpscell(_info)].push_back(userindex);
+	else
+		queue.vNoGps.push_back(userindex);
 
-			if (iter->second->gps.longitude == 0.000000f || iter->second->gps.latitude == 0.000000f || GetTickCount64() > iter->second->gps.tick)
-				continue;
+	_info->setmatchqueued(true);
+	_info->matchtick = clockmsec();
+}
 
-			// check distance using gps
-			for (int n = 0; n < ctr; n++) {
+// drops the players at the front that left the queue since they entered it
+bool user::frontmatch(std::deque<uintptr_t>& dq, unsigned char gametype)
+{
+	while (!dq.empty()) {
+		if (this->ismatchable(dq.front(), gametype))
+			return true;
+		_USER_INFO* _info = this->getuser(dq.front());
+		if (_info != NULL)
+			_info->setmatchqueued(false);
+		dq.pop_front();
+	}
+	return false;
+}
 
-				double dist = this->getdistancegps(this->getuser(user[n])->gps.latitude, this->getuser(user[n])->gps.longitude,
-					this->getuser(iter->first)->gps.latitude, this->getuser(iter->first)->gps.longitude);
+void user::trystartgame(unsigned char gametype, uintptr_t userindex)
+{
+	// matchmaking runs on loop 0, a player still parked on a game loop hands it over
+	if (le_getloop() != 0) {
+		le_post([this, gametype, userindex]() { this->trystartgame(gametype, userindex); });
+		return;
+	}
 
-				msglog(INFO, "trystartgame, %s and %s distance %f",
-					this->getuser(user[n])->account.c_str(), this->getuser(iter->first)->account.c_str(), dist);
+	this->queuematch(userindex, gametype);
 
-				if (dist < c.getgpslimitdis()) {
-					msglog(INFO, "Failed to join %s to %s game because the players distance of %f < %f.",
-						this->getuser(iter->first)->account.c_str(), this->getuser(user[n])->account.c_str(), dist, c.getgpslimitdis());
-					continue;
+	_MATCH_QUEUE& queue = this->m_mMatchQueues[gametype];
+
+	while (gcontrol.hasgameslot()) {
+
+		std::vector<std::deque<uintptr_t>*> vPicked;
+		uintptr_t user[3];
+		int ctr = 0;
+
+		// gps players first, one per cell and far enough from everyone picked so far
+		auto iter = queue.mCells.begin();
+		while (iter != queue.mCells.end() && ctr < 3) {
+
+			if (!this->frontmatch(iter->second, gametype)) {
+				iter = queue.mCells.erase(iter);
+				continue;
+			}
+
+			_USER_INFO* _info = this->getuser(iter->second.front());
+			bool isfar = true;
+
+			for (int n = 0; n < ctr; n++) {
+
+				if (this->isgpsnear(this->getuser(user[n]), _info)) {
+					double dist = this->getdistancegps(this->getuser(user[n])->gps.latitude, this->getuser(user[n])->gps.longitude,
+						_info->gps.latitude, _info->gps.longitude);
+					MSGLOG(INFO, "Failed to join %s to %s game because the players distance of %f < %f.",
+						_info->account.c_str(), this->getuser(user[n])->account.c_str(), dist, c.getgpslimitdis());
+					isfar = false;
+					break;
 				}
 			}
-		}
 
+			if (isfar) {
+				user[ctr++] = iter->second.front();
+				vPicked.push_back(&iter->second);
+			}
+			iter++;
+		}
 
+		// then the players without gps, in arrival order
+		size_t nogps = 0;
+		while (ctr < 3 && this->frontmatch(queue.vNoGps, gametype) && nogps < queue.vNoGps.size()) {
+			uintptr_t _userindex = queue.vNoGps[nogps++];
+			if (!this->ismatchable(_userindex, gametype))
+				continue;
+			user[ctr++] = _userindex;
+		}
 
-		user[ctr++] = iter->first;
-		
-		if (ctr >= 3) {
-			gcontrol.startgamesession(guser.getuser(user[0])->token, user[0]);
-			gcontrol.startgamesession(guser.getuser(user[1])->token, user[1]);
-			gcontrol.startgamesession(guser.getuser(user[2])->token, user[2]);
-			gcontrol.addgame(user[0], user[1], user[2], gametype);
+		if (ctr < 3)
 			break;
+
+		for (auto dq : vPicked)
+			dq->pop_front();
+		for (size_t n = 0; n < nogps; n++) {
+			_USER_INFO* _info = this->getuser(queue.vNoGps.front());
+			if (_info != NULL)
+				_info->setmatchqueued(false);
+			queue.vNoGps.pop_front();
+		}
+
+		for (int n = 0; n < 3; n++) {
+			_USER_INFO* _info = this->getuser(user[n]);
+			if (_info->ismatchqueued)
+				metricsmatchwait(clockmsec() - _info->matchtick);
+			_info->setmatchqueued(false);
 		}
+
+		this->startmatch(user, gametype);
 	}
+}
 
-	for (iter = this->m_mUsers.begin(); iter != this->m_mUsers.end(); iter++) {
+// the game sessions start once the players have their seats
+void user::startmatch(uintptr_t* users, unsigned char gametype)
+{
+	gcontrol.addgame(users[0], users[1], users[2], gametype);
+}
 
-		if (iter->second->isfreeuser)
-			continue;
+// a player left in the queue past "Bot Fill Seconds" gets bots for the empty seats, whoever else waits
+// in the same bet mode and is far enough takes a seat before a bot does. loop 0 only
+void user::botfill()
+{
+	if (c.getbotfillsec() <= 0)
+		return;
 
-		if (!(iter->second->m_state & (unsigned char)_USER_STATE::_WAITING))
-			continue;
+	uint64_t fillmsec = (uint64_t)c.getbotfillsec() * 1000;
 
-		if (iter->second->ectype != gametype)
-			continue;
+	for (auto& iterqueue : this->m_mMatchQueues) {
 
-		if (!iter->second->isnogps)
-			continue;
+		unsigned char gametype = iterqueue.first;
+		_MATCH_QUEUE& queue = iterqueue.second;
 
-		user[ctr++] = iter->first;
+		while (gcontrol.hasgameslot()) {
 
-		if (ctr >= 3) {
-			gcontrol.startgamesession(guser.getuser(user[0])->token, user[0]);
-			gcontrol.startgamesession(guser.getuser(user[1])->token, user[1]);
-			gcontrol.startgamesession(guser.getuser(user[2])->token, user[2]);
-			gcontrol.addgame(user[0], user[1], user[2], gametype);
-			break;
+			std::vector<std::deque<uintptr_t>*> vPicked;
+			uintptr_t user[3];
+			int ctr = 0;
+			bool isexpired = false;
+
+			auto iter = queue.mCells.begin();
+			while (iter != queue.mCells.end() && ctr < 2) {
+
+				if (!this->frontmatch(iter->second, gametype)) {
+					iter = queue.mCells.erase(iter);
+					continue;
+				}
+
+				_USER_INFO* _info = this->getuser(iter->second.front());
+				bool isfar = true;
+
+				for (int n = 0; n < ctr; n++) {
+					if (this->isgpsnear(this->getuser(user[n]), _info)) {
+						isfar = false;
+						break;
+					}
+				}
+
+				if (isfar) {
+					user[ctr++] = iter->second.front();
+					vPicked.push_back(&iter->second);
+					isexpired |= clockmsec() >= _info->matchtick + fillmsec;
+				}
+				iter++;
+			}
+
+			size_t nogps = 0;
+			while (ctr < 2 && this->frontmatch(queue.vNoGps, gametype) && nogps < queue.vNoGps.size()) {
+				uintptr_t _userindex = queue.vNoGps[nogps++];
+				if (!this->ismatchable(_userindex, gametype))
+					continue;
+				user[ctr++] = _userindex;
+				isexpired |= clockmsec() >= this->getuser(_userindex)->matchtick + fillmsec;
+			}
+
+			if (ctr == 0 || !isexpired)
+				break;
+
+			for (int n = ctr; n < 3; n++) {
+				user[n] = this->addbot(gametype);
+				if (user[n] == 0) {
+					for (int i = ctr; i < n; i++)
+						this->delbot(user[i]);
+					MSGLOG(ERROR, "botfill, no user slot left for a bot.");
+					return;
+				}
+			}
+
+			for (auto dq : vPicked)
+				dq->pop_front();
+			for (size_t n = 0; n < nogps; n++) {
+				_USER_INFO* _info = this->getuser(queue.vNoGps.front());
+				if (_info != NULL)
+					_info->setmatchqueued(false);
+				queue.vNoGps.pop_front();
+			}
+
+			for (int n = 0; n < ctr; n++) {
+				if (this->getuser(user[n])->ismatchqueued)
+					metricsmatchwait(clockmsec() - this->getuser(user[n])->matchtick);
+				this->getuser(user[n])->setmatchqueued(false);
+				MSGLOG(INFO, "%s waited %llu sec. in the queue, %d bot(s) join the table.", this->getuser(user[n])->account.c_str(),
+					(clockmsec() - this->getuser(user[n])->matchtick) / 1000, 3 - ctr);
+			}
+
+			this->startmatch(user, gametype);
 		}
 	}
 }
 
+// a logged in player without a connection, waiting in the given bet mode
+uintptr_t user::addbot(unsigned char gametype)
+{
+	uintptr_t userindex = this->getuserindex();
+	_USER_INFO* userinfo = this->getuser(userindex);
 
+	if (userinfo == NULL)
+		return 0;
+
+	char account[16];
+	snprintf(account, sizeof(account), "bot%d", (int)(userindex & USER_SLOT_MASK));
+
+	userinfo->set();
+	userinfo->init();
+	userinfo->isfreeuser = false;
+	userinfo->isbot = true;
+	userinfo->isrollout = c.getbotrolloutmsec() > 0 && rand() % 100 < c.getbotrolloutpercent();
+	userinfo->isnogps = true;
+	userinfo->account = account;
+	userinfo->name = account;
+	userinfo->ecoins[0] = c.getbotecoins();
+	userinfo->ecoins[1] = c.getbotecoins();
+	userinfo->setgametype(gametype);
+	userinfo->setlognwait();
+	userinfo->packetdata.bev = NULL;
+	userinfo->packetdata.loop = 0;
+	return userindex;
+}
+
+void user::delbot(uintptr_t userindex)
+{
+	_USER_INFO* userinfo = this->getuser(userindex);
+
+	if (userinfo == NULL || !userinfo->isbot)
+		return;
+
+	userinfo->set();
+	userinfo->init();
+	this->freeslot(userindex);
+}
@@ -1,19 +1,44 @@
 #pragma once
 #include "common.h"
+#include "wire.h"
+#include "websock.h"
+#include "notice.h"
+#include "metrics.h"
+#include <unordered_map>
+#include <deque>
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+struct _SEAL_STATE;
+struct _FASTLANE_STATE;
+struct _REPLAY_RING;
+
 struct _PACKET_DATA
 {
 	_PACKET_DATA()
 	{
 		bev = NULL;
-		bufferlen = 0;
-		memset(buffer, 0, MAX_BUFFER_DATA);
+		loop = 0;
+		websocket = WS_NONE;
+		wsinput = NULL;
+		listener = -1;
+		lobbyqueued = 0;
+		seal = NULL;
+		fastlane = NULL;
+		readusec = 0;
+		isoverflow = false;
 	}
 	struct bufferevent* bev;
-	char buffer[MAX_BUFFER_DATA];
-	int bufferlen;
+	std::atomic<int> loop;	// owner of bev
+	unsigned char websocket;	// WS_ state of bev
+	struct evbuffer* wsinput;	// unmasked payloads not parsed yet, made on the first websocket client of the slot
+	std::atomic<int> listener;	// the game port bev counts against for Max Connections, -1 once given back
+	uintptr_t lobbyqueued;	// the userindex while it waits in the lobby queue of its loop, 0 otherwise
+	_SEAL_STATE* seal;	// keys of a sealed connection from its hello, NULL in the clear
+	_FASTLANE_STATE* fastlane;	// the udp side channel offered at login, see fastlane.h
+	std::vector<unsigned char> parked;	// a turn refresh waiting for the output to drain, v1
+	uint64_t readusec;	// statsusec as the read callback that brought the bytes being parsed began
+	bool isoverflow;	// went over Max Output, the connection is being closed
 };
 
 enum class _USER_STATE
@@ -32,12 +57,85 @@ struct _GPS_INFO
 	uint64_t tick;
 	double longitude;
 	double latitude;
+	double x, y, z;	// position on the unit sphere, dot product of two is the cosine of their distance
+	uint32_t version;	// changes with every new position, 0 when none is known
+};
+
+// a string kept inside its struct behind a length byte, for the _USER_INFO fields every message logs or
+// copies, so reading one is no trip to the heap. a longer value is cut at N - 2 bytes, the logins take
+// well below that
+template <size_t N>
+class _INLINE_STR
+{
+	static_assert(N >= 2 && N <= 256, "_INLINE_STR keeps its length in a byte");
+
+public:
+	_INLINE_STR() { this->clear(); }
+	_INLINE_STR(const char* s) { this->assign(s, strlen(s)); }
+	_INLINE_STR(const std::string& s) { this->assign(s.c_str(), s.length()); }
+
+	_INLINE_STR& operator=(const char* s) { this->assign(s, strlen(s)); return *this; }
+	_INLINE_STR& operator=(const std::string& s) { this->assign(s.c_str(), s.length()); return *this; }
+	operator std::string() const { return std::string(m_data, m_len); }
+
+	const char* c_str() const { return m_data; }
+	size_t length() const { return m_len; }
+	bool empty() const { return m_len == 0; }
+	void clear() { m_len = 0; m_data[0] = 0; }
+	std::string substr(size_t pos, size_t count = std::string::npos) const { return std::string(m_data, m_len).substr(pos, count); }
+	// into a packet field, cut to S - 1 bytes, 0 terminated and 0 padded as strncpy left it
+	template <size_t S>
+	void copyto(char (&dst)[S]) const
+	{
+		size_t len = (m_len < S - 1) ? m_len : S - 1;
+		memcpy(dst, m_data, len);
+		memset(dst + len, 0, S - len);
+	}
+
+	bool operator==(const char* s) const { return strcmp(m_data, s) == 0; }
+	bool operator==(const std::string& s) const { return s.length() == m_len && memcmp(m_data, s.c_str(), m_len) == 0; }
+	bool operator!=(const char* s) const { return !(*this == s); }
+	bool operator!=(const std::string& s) const { return !(*this == s); }
+
+private:
+	void assign(const char* s, size_t len)
+	{
+		if (len > N - 2)
+			len = N - 2;
+		memmove(m_data, s, len);
+		m_data[len] = 0;
+		m_len = (unsigned char)len;
+	}
+
+	unsigned char m_len;
+	char m_data[N - 1];	// 0 terminated for c_str
 };
 
+// a userindex is the slot in the low bits and the slot generation above them
+#define USER_SLOT_BITS 16
+#define USER_SLOT_MASK ((1 << USER_SLOT_BITS) - 1)
+static_assert(MAX_USERS < (1 << USER_SLOT_BITS), "MAX_USERS does not fit in a userindex slot");
+#define USER_SLAB_BITS 8	// slots allocated together as the server fills up
+#define USER_SLAB_SIZE (1 << USER_SLAB_BITS)
+
 struct _USER_INFO
 {
 	_USER_INFO()
 	{
+		gen = 0;
+		nextfree = 0;
+		isfreelisted = false;
+		ip = 0;
+		wirever = WIRE_V1;
+		isnoticeid = false;
+		isdeadline = false;
+		isactionmask = false;
+		isfastlane = false;
+		isalivequeued = false;
+		m_state = (unsigned char)_USER_STATE::_NONE;
+		ectype = 0;
+		ismatchqueued = false;
+		replay = NULL;
 		this->set();
 		this->init();
 	}
@@ -52,16 +150,21 @@ struct _USER_INFO
 		ecoins[0] = 0;
 		ecoins[1] = 0;
 		isfreeuser = true;
-		m_state = (unsigned char)_USER_STATE::_NONE;
-		deltick = GetTickCount64() + 1000;
-		ectype = 0;
+		setstate((unsigned char)_USER_STATE::_NONE);
+		deltick = clockmsec() + 1000;
+		matchtick = 0;
+		setgametype(0);
 		ismuadmin = false;
 		gps.tick = 0;
 		gps.longitude = 0.000000f;
 		gps.latitude = 0.000000f;
-		otpcode = 0;
+		gps.version = 0;
 		isuseradmin = false;
 		isnogps = false;
+		setmatchqueued(false);
+		isbot = false;
+		isrollout = false;
+		islobby = false;
 	}
 
 	void setmuadmin()
@@ -73,7 +176,7 @@ struct _USER_INFO
 		gametoken = 0;
 		ecoins[0] = 0;
 		ecoins[1] = 0;
-		ectype = 0;
+		setgametype(0);
 		ismuadmin = true;
 	}
 
@@ -84,6 +187,10 @@ struct _USER_INFO
 		m_gamepos = -1;
 		alivetick = 0;
 		iskick = false;
+		turnmsec = 0;
+		m_watchid = 0;
+		reqseq = 0;
+		ispipelined = false;
 		this->reset();
 	}
 
@@ -108,6 +215,7 @@ struct _USER_INFO
 	void reset()
 	{
 		lastactiontick = 0;
+		reqburst = 0;
 		m_isdowncard = false;
 		activetick = 0;
 		m_gamedropctr = 0;
@@ -118,42 +226,51 @@ struct _USER_INFO
 		this->resetcount();
 	}
 
+	// m_state, ectype and ismatchqueued only change through these, the gauges of metrics follow them
+	void setstate(unsigned char state) {
+		metricsuserstate(ectype, m_state, state);
+		m_state = state;
+	}
+
 	void setgametype(unsigned char gametype) {
+		metricsuserectype(m_state, ectype, gametype);
 		ectype = gametype;
 	}
 
+	void setmatchqueued(bool queued) {
+		if (queued != ismatchqueued)
+			metricsmatchqueued(queued ? 1 : -1);
+		ismatchqueued = queued;
+	}
+
 	void endgame()
 	{
 		if(isplaying())
-			m_state ^= (unsigned char)_USER_STATE::_PLAYING;
+			setstate(m_state ^ (unsigned char)_USER_STATE::_PLAYING);
 		reset();
 	}
 
 	void resumegame()
 	{
-		m_state ^= (unsigned char)_USER_STATE::_DISCONNECTED;
-		m_state |= (unsigned char)_USER_STATE::_RESUMED;
-		m_state |= (unsigned char)_USER_STATE::_PLAYING;
+		setstate((m_state ^ (unsigned char)_USER_STATE::_DISCONNECTED) | (unsigned char)_USER_STATE::_RESUMED | (unsigned char)_USER_STATE::_PLAYING);
 		this->m_resumeflag = 0;
 		disconnectedtick = 0;
 	}
 
 	void disconnected()
 	{
-		m_state ^= (unsigned char)_USER_STATE::_PLAYING;
-		m_state |= (unsigned char)_USER_STATE::_DISCONNECTED;
-		disconnectedtick = GetTickCount64();
+		setstate((m_state ^ (unsigned char)_USER_STATE::_PLAYING) | (unsigned char)_USER_STATE::_DISCONNECTED);
+		disconnectedtick = clockmsec();
 	}
 
 	void setlognwait()
 	{
-		m_state |= (unsigned char)_USER_STATE::_LOGGEDIN;
-		m_state |= (unsigned char)_USER_STATE::_WAITING;
+		setstate(m_state | (unsigned char)_USER_STATE::_LOGGEDIN | (unsigned char)_USER_STATE::_WAITING);
 	}
 
 	void setlogged()
 	{
-		m_state |= (unsigned char)_USER_STATE::_LOGGEDIN;
+		setstate(m_state | (unsigned char)_USER_STATE::_LOGGEDIN);
 	}
 
 	bool isresumed()
@@ -164,7 +281,7 @@ struct _USER_INFO
 	void resumed()
 	{
 		if(isresumed())
-			m_state ^= (unsigned char)_USER_STATE::_RESUMED;
+			setstate(m_state ^ (unsigned char)_USER_STATE::_RESUMED);
 	}
 
 	bool isdc()
@@ -185,7 +302,7 @@ struct _USER_INFO
 	void relog()
 	{
 		if (iswaiting()) {
-			m_state ^= (unsigned char)_USER_STATE::_WAITING;
+			setstate(m_state ^ (unsigned char)_USER_STATE::_WAITING);
 		}
 	}
 
@@ -194,26 +311,48 @@ struct _USER_INFO
 		return (m_state & (unsigned char)_USER_STATE::_PLAYING);
 	}
 
-	int otpcode;
+	// fields scanned by matchmaking and slot lookup come first so a table walk stays in few cache lines
+	uintptr_t gen;
+	int nextfree;	// free list link, loop 0 only
+	bool isfreelisted;
+	bool isfreeuser;
+	bool ismatchqueued;
+	bool isbot;	// played by the server, has no connection
+	bool isrollout;	// a bot that weighs its drops with rollouts
+	bool islobby;	// gets the lobby counters, loop 0 only, see lobby.h
+	unsigned char m_state;
+	unsigned char m_resumeflag;
+	unsigned char ectype;
+	bool isnogps;
+	uint64_t deltick;
+	uint64_t matchtick;	// when it entered the match queue
+	int64_t token;
+	_GPS_INFO gps;
 
-	std::string account;
-	std::string name;
-	std::string mobilenum;
+	_INLINE_STR<32> account;
+	_INLINE_STR<16> name;
+	_INLINE_STR<16> mobilenum;
 
-	int64_t token;
 	int gametoken;
 	int ecoins[2];
 
-	uint64_t alivetick;
+	uint64_t alivetick;	// last read of its connection, see alive.h
+	bool isalivequeued;	// has an entry in a wheel of alive.h, loop 0 only
 	uint64_t lastactiontick;
+	uint32_t reqseq;	// newest _PMSG_SEQ_REQ of this connection
+	bool ispipelined;	// its action is being dispatched
+	unsigned char reqreason;	// _ACTION_REASON isactionvalid turned it down for
+	unsigned char reqburst;	// actions it took inside the 500 ms of the one before
 	uint64_t activetick;
-	uint64_t deltick;
 	uint64_t disconnectedtick;
+	uint32_t turnmsec;	// running average of the player's turns in this game, 0 before the first
 
 	int64_t m_gameserial;
+	uint64_t m_watchid;	// _SPECTATE_STREAM::id of the table it watches, 0 for none
 	int m_gamepos;
 	int m_gamedropctr;
 	bool m_isdowncard;
+	_REPLAY_RING* replay;	// the frames its seat was sent last, see replay.h
 
 	int m_cardcount;
 	int m_cardquantity;
@@ -226,23 +365,29 @@ struct _USER_INFO
 	bool isauto;
 	bool isselfblock;
 
-	bool isfreeuser;
-
-	unsigned char m_state;
-	unsigned char m_resumeflag;
-
-	unsigned char ectype;
-
 	bool ismuadmin;
 	bool isuseradmin;
-	bool isnogps;
 
 	bool iskick;
 
-	_GPS_INFO gps;
+	uint32_t ip;	// address of the connection, host order
+	unsigned char wirever;	// encoding the client asked for at login, see wire.h
+	bool isnoticeid;	// renders the notices by number itself, see notice.h
+	bool isdeadline;	// counts the turns down from _PMSG_DEADLINE_INFO itself
+	bool isactionmask;	// offers only the actions of _PMSG_ACTION_MASK on its turn
+	bool isfastlane;	// takes the udp side channel of fastlane.h
 	_PACKET_DATA packetdata;
 };
 
+// waiting players of one bet mode, entries are checked when they reach the front
+struct _DB_ACCOUNT;
+
+struct _MATCH_QUEUE
+{
+	std::deque<uintptr_t> vNoGps;
+	std::map<std::pair<int, int>, std::deque<uintptr_t>> mCells;	// gps players by grid cell
+};
+
 class user
 {
 public:
@@ -255,50 +400,101 @@ public:
 	void deluser(uintptr_t userindex, bool isreset = false);
 	void delmuadmin(uintptr_t userindex);
 	void updateuserbev(uintptr_t userid, uintptr_t resume_userid);
-	void checkaliveusers();
 	_USER_INFO* getuser(uintptr_t userindex);
 
-	int getcount() { return this->m_mUsers.size(); }
+	int getcount() { return this->m_capacity; }
+	void setcapacity(int users);
+	void freeslot(uintptr_t userindex);
+	void indexuser(uintptr_t userindex);
+	uintptr_t findaccount(const char* accountid);
 
-	void trystartgame(unsigned char gametype); // temporary function, starting game should be in protocol
+	void trystartgame(unsigned char gametype, uintptr_t userindex);
+	void botfill();
+	void delbot(uintptr_t userindex);
 
 	void setstate(_USER_STATE state) { m_state = state; }
 	_USER_STATE getstate() { return m_state; }
 
-	uintptr_t getuserindex();
+	uintptr_t getuserindex(bool isrestore = false);
 
 	void otpcode(int otpcode, uintptr_t userindex);
 	void otplogin(char* mobilenum, uintptr_t userindex);
+	bool isuserloggedin(uintptr_t token);
+	void gettokenusers(int64_t token, std::vector<uintptr_t>& users);	// loop 0, the slots indexed under token
+	void sendotp(uintptr_t userindex, const std::string& mobilenum, const char* entered, int otpcode, bool issent);
 	void mulogin(char* musecret, uintptr_t userindex);
 	void tokenlogin(char* logintoken, uintptr_t userindex);
 	void userlogin(char* username, char* secret, uintptr_t userindex);
-	void sendnotice(uintptr_t userindex, unsigned char type, const char* msg, ...);
+	void setuserlogin(uintptr_t userindex, const char* username, const _DB_ACCOUNT* account, const char* logintoken);
+	void sendlogintoken(uintptr_t userindex, const char* logintoken);
+	void sendnotice(uintptr_t userindex, const _NOTICE& notice);
+
+	template <typename... A>
+	void sendnotice(uintptr_t userindex, unsigned char type, _NOTICE_ID id, const A&... args)
+	{
+		_NOTICE notice;
+		noticemake(notice, type, id, args...);
+		this->sendnotice(userindex, notice);
+	}
 
 	void saveecoins(uintptr_t userindex, unsigned char type);
 
+	bool creditecoins(uintptr_t _userindex, int ecoins, unsigned char ectype);
 	bool adduserecoins(uintptr_t userindex, char* accountid, int ecoins, unsigned char ectype, int aindex);
 	bool getuserecoins(uintptr_t userindex, char* accountid, int ecoins, unsigned char ectype, int aindex);
+	void addofflineecoins(uintptr_t userindex, const char* accountid, int ecoins, unsigned char ectype, unsigned char* pmsg, int size);
+	void addbulkecoins(uintptr_t userindex, _PMSG_BULKECOINS_INFO* infos, int count, int aindex);
 
 
 	double getdistancegps(double lat1, double long1, double lat2, double long2);
+	void setgps(_USER_INFO* _info, double latitude, double longitude);
+	bool isgpsnear(_USER_INFO* _info1, _USER_INFO* _info2);
+
+	// joined a bet mode and not seated yet, the gauge of metrics.h
+	int getwaitings() { return (int)(metricsusers(0, (unsigned char)_USER_STATE::_WAITING) + metricsusers(1, (unsigned char)_USER_STATE::_WAITING)); }
 
-	int getwaitings() { return m_waitings; }
+	// a walk over every slot from any loop, slot 0 is nobody. getuser takes the handle of a free slot too
+	int getslots() { return this->m_slots.load(std::memory_order_acquire); }
+	uintptr_t gethandle(int slot) { return (this->getslot(slot)->gen << USER_SLOT_BITS) | slot; }
 
 private:
 
-	bool isuserloggedin(uintptr_t token);
+	friend class simtable;	// tongits_sim seats its own bots, addbot and delbot
 
-	bool sendsmsotp(const char* smsnum, char* otpmsg);
+	std::atomic<uint32_t> m_gpsversion;
 
 	double toRad(double degree) {
 		return degree / 180 * M_PI;
 	}
 
-	std::map <uintptr_t, _USER_INFO*> m_mUsers;
+	void pushfreeslot(int slot);
+	bool growusers();
+	void refillfreeslots();
+	void unindexuser(int slot);
+
+	bool ismatchable(uintptr_t userindex, unsigned char gametype);
+	bool isgpsmatch(_USER_INFO* _info);
+	bool hasgpsfix(_USER_INFO* _info);
+	std::pair<int, int> getgpscell(_USER_INFO* _info);
+	void queuematch(uintptr_t userindex, unsigned char gametype);
+	bool frontmatch(std::deque<uintptr_t>& dq, unsigned char gametype);
+	void startmatch(uintptr_t* users, unsigned char gametype);
+	uintptr_t addbot(unsigned char gametype);
+	_USER_INFO* getslot(int slot) { return &this->m_userslabs[slot >> USER_SLAB_BITS][slot & (USER_SLAB_SIZE - 1)]; }
+
+	_USER_INFO* m_userslabs[(USER_SLOT_MASK + 1) / USER_SLAB_SIZE];	// a userindex maps to its slot directly
+	std::atomic<int> m_slots;	// grown so far slot 0 included, stored after the slab so any loop may read below it
+	int m_capacity;	// Max Users
 	_USER_STATE m_state;
 
-	uintptr_t m_userindex;
-	int m_waitings;
+	std::unordered_multimap <int64_t, uintptr_t> m_mTokens;	// token and account indexes, loop 0 only
+	std::unordered_multimap <std::string, uintptr_t> m_mAccounts;
+	std::vector <std::pair<int64_t, std::string>> m_vIndexKeys;	// keys each slot was indexed under
+
+	std::map <unsigned char, _MATCH_QUEUE> m_mMatchQueues;	// per bet mode, loop 0 only
+
+	int m_freehead;
+	int m_freetail;
 
 };
 
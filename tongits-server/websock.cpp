@@ -0,0 +1,290 @@
+#include "websock.h"
+#include "common.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define WS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define WS_NEON
+#include <arm_neon.h>
+#endif
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+static inline uint32_t wsrol(uint32_t x, int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+// sha-1 of the key and the guid, only the upgrade answer needs it
+static void wssha1(const unsigned char* data, size_t len, unsigned char* digest)
+{
+	uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+	unsigned char block[64];
+	uint32_t w[80];
+	size_t total = ((len + 8) / 64 + 1) * 64;
+
+	for (size_t offset = 0; offset < total; offset += 64) {
+		for (size_t n = 0; n < 64; n++) {
+			size_t at = offset + n;
+			if (at < len)
+				block[n] = data[at];
+			else if (at == len)
+				block[n] = 0x80;
+			else if (at >= total - 8)
+				block[n] = (unsigned char)(((uint64_t)len * 8) >> ((total - 1 - at) * 8));
+			else
+				block[n] = 0;
+		}
+
+		for (int n = 0; n < 16; n++)
+			w[n] = ((uint32_t)block[n * 4] << 24) | ((uint32_t)block[n * 4 + 1] << 16) | ((uint32_t)block[n * 4 + 2] << 8) | block[n * 4 + 3];
+		for (int n = 16; n < 80; n++)
+			w[n] = wsrol(w[n - 3] ^ w[n - 8] ^ w[n - 14] ^ w[n - 16], 1);
+
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+		for (int n = 0; n < 80; n++) {
+			uint32_t f, k;
+			if (n < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			}
+			else if (n < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if (n < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+			uint32_t t = wsrol(a, 5) + f + e + k + w[n];
+			e = d;
+			d = c;
+			c = wsrol(b, 30);
+			b = a;
+			a = t;
+		}
+
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+
+	for (int n = 0; n < 20; n++)
+		digest[n] = (unsigned char)(h[n / 4] >> ((3 - n % 4) * 8));
+}
+
+static std::string wsbase64(const unsigned char* data, size_t len)
+{
+	static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string out;
+
+	for (size_t n = 0; n < len; n += 3) {
+		uint32_t v = (uint32_t)data[n] << 16;
+		if (n + 1 < len)
+			v |= (uint32_t)data[n + 1] << 8;
+		if (n + 2 < len)
+			v |= data[n + 2];
+		out += table[(v >> 18) & 0x3F];
+		out += table[(v >> 12) & 0x3F];
+		out += (n + 1 < len) ? table[(v >> 6) & 0x3F] : '=';
+		out += (n + 2 < len) ? table[v & 0x3F] : '=';
+	}
+	return out;
+}
+
+static bool wsnameis(const char* s, const char* name, size_t len)
+{
+	for (size_t n = 0; n < len; n++) {
+		if (tolower((unsigned char)s[n]) != tolower((unsigned char)name[n]))
+			return false;
+	}
+	return true;
+}
+
+// value of a header, the name matched without case
+static bool wsgetheader(const std::string& request, const char* name, std::string& value)
+{
+	size_t namelen = strlen(name);
+	size_t pos = request.find("\r\n");
+
+	while (pos != std::string::npos) {
+		size_t start = pos + 2;
+		size_t end = request.find("\r\n", start);
+		if (end == std::string::npos || end == start)
+			return false;
+
+		if (end - start > namelen && request[start + namelen] == ':' && wsnameis(request.c_str() + start, name, namelen)) {
+			size_t from = start + namelen + 1;
+			while (from < end && (request[from] == ' ' || request[from] == '\t'))
+				from++;
+			size_t to = end;
+			while (to > from && (request[to - 1] == ' ' || request[to - 1] == '\t'))
+				to--;
+			value = request.substr(from, to - from);
+			return true;
+		}
+		pos = end;
+	}
+	return false;
+}
+
+int wshandshake(struct evbuffer* input, struct evbuffer* output)
+{
+	struct evbuffer_ptr end = evbuffer_search(input, "\r\n\r\n", 4, NULL);
+
+	if (end.pos < 0)
+		return (evbuffer_get_length(input) > WS_MAX_REQUEST) ? -1 : 0;
+
+	size_t len = end.pos + 4;
+	std::string request((const char*)evbuffer_pullup(input, len), len);
+	evbuffer_drain(input, len);
+
+	std::string key;
+	if (request.compare(0, 4, "GET ") != 0 || !wsgetheader(request, "Sec-WebSocket-Key", key) || key.empty())
+		return -1;
+
+	key += WS_GUID;
+	unsigned char digest[20];
+	wssha1((const unsigned char*)key.data(), key.size(), digest);
+
+	evbuffer_add_printf(output,
+		"HTTP/1.1 101 Switching Protocols\r\n"
+		"Upgrade: websocket\r\n"
+		"Connection: Upgrade\r\n"
+		"Sec-WebSocket-Accept: %s\r\n\r\n", wsbase64(digest, sizeof(digest)).c_str());
+	return 1;
+}
+
+// 16 bytes per xor, the mask lines up again at every multiple of 4 so the tail keeps its phase
+void wsunmask(unsigned char* data, size_t len, const unsigned char* mask)
+{
+	size_t n = 0;
+
+#if defined(WS_SSE2) || defined(WS_NEON)
+	uint32_t mask32;
+	memcpy(&mask32, mask, 4);
+#ifdef WS_SSE2
+	__m128i m = _mm_set1_epi32((int)mask32);
+	for (; n + 16 <= len; n += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + n));
+		_mm_storeu_si128((__m128i*)(data + n), _mm_xor_si128(v, m));
+	}
+#else
+	uint8x16_t m = vreinterpretq_u8_u32(vdupq_n_u32(mask32));
+	for (; n + 16 <= len; n += 16)
+		vst1q_u8(data + n, veorq_u8(vld1q_u8(data + n), m));
+#endif
+#endif
+
+	for (; n < len; n++)
+		data[n] ^= mask[n & 3];
+}
+
+int wsdecode(struct evbuffer* input, struct evbuffer* payload, struct evbuffer* output)
+{
+	while (true) {
+
+		size_t bufferlen = evbuffer_get_length(input);
+
+		if (bufferlen < 2)
+			break;
+
+		unsigned char* data = evbuffer_pullup(input, (bufferlen < 14) ? bufferlen : 14);
+		unsigned char opcode = data[0] & 0x0F;
+		uint64_t len = data[1] & 0x7F;
+		size_t hdrlen = 2;
+
+		// every client frame is masked
+		if (!(data[1] & 0x80))
+			return -1;
+
+		if (len == 126) {
+			if (bufferlen < 4)
+				break;
+			len = ((uint64_t)data[2] << 8) | data[3];
+			hdrlen = 4;
+		}
+		else if (len == 127) {
+			if (bufferlen < 10)
+				break;
+			len = 0;
+			for (int n = 0; n < 8; n++)
+				len = (len << 8) | data[2 + n];
+			hdrlen = 10;
+		}
+
+		// a payload may carry a request allowed past MAX_BUFFER_DATA, parsedata checks each one
+		if (len > MAX_FRAME_DATA)
+			return -1;
+
+		if (bufferlen < hdrlen + 4 + len)
+			break;
+
+		data = evbuffer_pullup(input, hdrlen + 4 + len);
+		unsigned char mask[4];
+		memcpy(mask, data + hdrlen, 4);
+		wsunmask(data + hdrlen + 4, (size_t)len, mask);
+		evbuffer_drain(input, hdrlen + 4);
+
+		switch (opcode) {
+		case WS_OP_CONTINUATION:
+		case WS_OP_TEXT:
+		case WS_OP_BINARY:
+			evbuffer_remove_buffer(input, payload, (size_t)len);
+			break;
+		case WS_OP_PING:
+		{
+			unsigned char header[WS_MAX_HEADER];
+			int size = wsheader(header, (size_t)len);
+			header[0] = 0x80 | WS_OP_PONG;
+			evbuffer_add(output, header, size);
+			evbuffer_remove_buffer(input, output, (size_t)len);
+		}
+		break;
+		case WS_OP_CLOSE:
+			return -1;
+		default:
+			evbuffer_drain(input, (size_t)len);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int wsheader(unsigned char* out, size_t len)
+{
+	out[0] = 0x80 | WS_OP_BINARY;
+
+	if (len < 126) {
+		out[1] = (unsigned char)len;
+		return 2;
+	}
+
+	if (len <= 0xFFFF) {
+		out[1] = 126;
+		out[2] = (unsigned char)(len >> 8);
+		out[3] = (unsigned char)len;
+		return 4;
+	}
+
+	out[1] = 127;
+	for (int n = 0; n < 8; n++)
+		out[2 + n] = (unsigned char)((uint64_t)len >> ((7 - n) * 8));
+	return 10;
+}
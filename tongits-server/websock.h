@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// websocket front of the game listener for the web client. a browser connects to its own port, the
+// upgrade request is answered right on the connection and the binary frames it sends carry the same
+// v1 packets an apk writes on the raw port. payloads are unmasked in place and gathered in a buffer
+// of the user that protocol::parsedata reads like a socket, packets to the client go out as one
+// unmasked binary frame each
+
+#define WS_NONE 0	// raw tcp client
+#define WS_HANDSHAKE 1	// waiting for the upgrade request
+#define WS_OPEN 2
+
+#define WS_MAX_REQUEST 4096	// longest upgrade request accepted
+#define WS_MAX_HEADER 10	// of a frame the server sends
+
+// answers the upgrade request in input, 1 once answered, 0 while it is incomplete, -1 when it is not one
+int wshandshake(struct evbuffer* input, struct evbuffer* output);
+
+// moves the payload of every complete frame in input to payload and answers pings on output, -1 once
+// the client closed or sent something that is not a client frame
+int wsdecode(struct evbuffer* input, struct evbuffer* payload, struct evbuffer* output);
+
+// header of a final binary frame of len bytes, returns its size
+int wsheader(unsigned char* out, size_t len);
+
+void wsunmask(unsigned char* data, size_t len, const unsigned char* mask);
@@ -0,0 +1,387 @@
+#include "wire.h"
+#include "prodef.h"
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+enum class _WIRE_FIELD
+{
+	_BYTES = 0,	// copied as they are
+	_UINT,
+	_INT,
+	_STR,
+	_CARD,
+	_CARDS,	// the count byte at offset, the cards follow the struct
+	_INITCARDS,	// _INIT_CARDS with its cardtype and cardnum arrays
+	_END,
+};
+
+struct _WIRE_FIELD_INFO
+{
+	_WIRE_FIELD type;
+	unsigned short offset;
+	unsigned short size;
+};
+
+struct _WIRE_PACKET
+{
+	unsigned char h;
+	unsigned char sub;
+	unsigned short size;	// sizeof the v1 struct, where a trailing card list starts
+	_WIRE_FIELD_INFO fields[28];	// _PMSG_TRANSACT_INFO is the longest
+};
+
+#define WIRE_FIELD(type, s, f) { _WIRE_FIELD::type, (unsigned short)offsetof(s, f), (unsigned short)sizeof(((s*)0)->f) }
+#define WIRE_END { _WIRE_FIELD::_END, 0, 0 }
+#define WIRE_TRANSACT_USER(n) \
+	WIRE_FIELD(_BYTES, _PMSG_TRANSACT_INFO, users[n].cardcounts), \
+	WIRE_FIELD(_UINT, _PMSG_TRANSACT_INFO, users[n].current_ecoins), \
+	WIRE_FIELD(_UINT, _PMSG_TRANSACT_INFO, users[n].regular), \
+	WIRE_FIELD(_UINT, _PMSG_TRANSACT_INFO, users[n].quadra), \
+	WIRE_FIELD(_UINT, _PMSG_TRANSACT_INFO, users[n].royal), \
+	WIRE_FIELD(_UINT, _PMSG_TRANSACT_INFO, users[n].ace), \
+	WIRE_FIELD(_UINT, _PMSG_TRANSACT_INFO, users[n].fight), \
+	WIRE_FIELD(_UINT, _PMSG_TRANSACT_INFO, users[n].burned)
+
+// the body of every packet the server sends during a game, field by field after sub
+static const _WIRE_PACKET wirepackets[] = {
+	{ 0xF1, 0x00, sizeof(_PMSG_SEND_INIT_CARDS), {
+		WIRE_FIELD(_BYTES, _PMSG_SEND_INIT_CARDS, data.userpos),
+		WIRE_FIELD(_INITCARDS, _PMSG_SEND_INIT_CARDS, data),
+		WIRE_END } },
+	{ 0xF1, 0x01, sizeof(_PMSG_CARD_STOCKINFO), {
+		WIRE_FIELD(_BYTES, _PMSG_CARD_STOCKINFO, stockcount),
+		WIRE_END } },
+	{ 0xF1, 0x02, sizeof(_PMSG_ACTIVEINFO), {
+		WIRE_FIELD(_BYTES, _PMSG_ACTIVEINFO, activeuserpos),
+		WIRE_FIELD(_UINT, _PMSG_ACTIVEINFO, timelimit_msec),
+		WIRE_FIELD(_BYTES, _PMSG_ACTIVEINFO, activegamestate),
+		WIRE_FIELD(_INT, _PMSG_ACTIVEINFO, activehitteruserpos),
+		WIRE_FIELD(_INT, _PMSG_ACTIVEINFO, activegamecounter),
+		WIRE_FIELD(_UINT, _PMSG_ACTIVEINFO, activehitprizeecoins),
+		WIRE_END } },
+	{ 0xF1, 0x03, sizeof(_PMSG_USERNAMEINFO), {
+		WIRE_FIELD(_BYTES, _PMSG_USERNAMEINFO, gamepos),
+		WIRE_FIELD(_STR, _PMSG_USERNAMEINFO, name),
+		WIRE_END } },
+	{ 0xF1, 0x04, sizeof(_PMSG_USERECOINSINFO), {
+		WIRE_FIELD(_BYTES, _PMSG_USERECOINSINFO, gamepos),
+		WIRE_FIELD(_UINT, _PMSG_USERECOINSINFO, ecoins),
+		WIRE_END } },
+	{ 0xF1, 0x05, sizeof(_PMSG_USERCARDSINFO), {
+		WIRE_FIELD(_BYTES, _PMSG_USERCARDSINFO, gamepos),
+		WIRE_FIELD(_UINT, _PMSG_USERCARDSINFO, cardcounts),
+		WIRE_END } },
+	{ 0xF1, 0x06, sizeof(_PMSG_RESETGAMEINFO), {
+		WIRE_END } },
+	{ 0xF1, 0x07, sizeof(_PMSG_TIMEOUT_INFO), {
+		WIRE_FIELD(_UINT, _PMSG_TIMEOUT_INFO, timemsecleft),
+		WIRE_END } },
+	{ 0xF1, 0x08, sizeof(_PMSG_FIGHTMODE_INFO), {
+		WIRE_FIELD(_BYTES, _PMSG_FIGHTMODE_INFO, enable),
+		WIRE_END } },
+	{ 0xF1, 0x09, sizeof(_PMSG_OTP_RES), {
+		WIRE_FIELD(_BYTES, _PMSG_OTP_RES, result),
+		WIRE_END } },
+	{ 0xF1, 0x0A, sizeof(_PMSG_WATCH_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_WATCH_ANS, result),
+		WIRE_FIELD(_BYTES, _PMSG_WATCH_ANS, ectype),
+		WIRE_FIELD(_BYTES, _PMSG_WATCH_ANS, delaysec),
+		WIRE_FIELD(_UINT, _PMSG_WATCH_ANS, gameserial),
+		WIRE_END } },
+	{ 0xF1, 0x0B, sizeof(_PMSG_TOURNEY_INFO), {
+		WIRE_FIELD(_BYTES, _PMSG_TOURNEY_INFO, status),
+		WIRE_FIELD(_BYTES, _PMSG_TOURNEY_INFO, ectype),
+		WIRE_FIELD(_BYTES, _PMSG_TOURNEY_INFO, round),
+		WIRE_FIELD(_UINT, _PMSG_TOURNEY_INFO, entrants),
+		WIRE_FIELD(_UINT, _PMSG_TOURNEY_INFO, remaining),
+		WIRE_FIELD(_INT, _PMSG_TOURNEY_INFO, score),
+		WIRE_FIELD(_UINT, _PMSG_TOURNEY_INFO, rank),
+		WIRE_END } },
+	{ 0xF1, 0x0C, sizeof(_PMSG_LOBBY_INFO), {
+		WIRE_FIELD(_BYTES, _PMSG_LOBBY_INFO, changed),
+		WIRE_FIELD(_UINT, _PMSG_LOBBY_INFO, waiting[0]),
+		WIRE_FIELD(_UINT, _PMSG_LOBBY_INFO, waiting[1]),
+		WIRE_FIELD(_UINT, _PMSG_LOBBY_INFO, playing[0]),
+		WIRE_FIELD(_UINT, _PMSG_LOBBY_INFO, playing[1]),
+		WIRE_FIELD(_UINT, _PMSG_LOBBY_INFO, tables),
+		WIRE_END } },
+	{ 0xF1, 0x0D, sizeof(_PMSG_DEADLINE_INFO), {
+		WIRE_FIELD(_BYTES, _PMSG_DEADLINE_INFO, activeuserpos),
+		WIRE_FIELD(_UINT, _PMSG_DEADLINE_INFO, deadline),
+		WIRE_END } },
+	{ 0xF2, 0x00, sizeof(_PMSG_NOTICEMSG), {
+		WIRE_FIELD(_BYTES, _PMSG_NOTICEMSG, userpos),
+		WIRE_FIELD(_BYTES, _PMSG_NOTICEMSG, type),
+		WIRE_FIELD(_STR, _PMSG_NOTICEMSG, msg),
+		WIRE_END } },
+	{ 0xF2, 0x02, sizeof(_PMSG_SHOW_USERCARDS), {
+		WIRE_FIELD(_BYTES, _PMSG_SHOW_USERCARDS, userpos),
+		WIRE_FIELD(_CARDS, _PMSG_SHOW_USERCARDS, count),
+		WIRE_END } },
+	{ 0xF2, 0x03, sizeof(_PMSG_SHOW_GRPCARDS), {
+		WIRE_FIELD(_BYTES, _PMSG_SHOW_GRPCARDS, userpos),
+		WIRE_FIELD(_CARDS, _PMSG_SHOW_GRPCARDS, count),
+		WIRE_END } },
+	{ 0xF2, 0x04, sizeof(_PMSG_ACTION_RESULT), {
+		WIRE_FIELD(_BYTES, _PMSG_ACTION_RESULT, result),
+		WIRE_END } },
+	{ 0xF2, 0x05, sizeof(_PMSG_ACTIVESTATUS), {
+		WIRE_FIELD(_BYTES, _PMSG_ACTIVESTATUS, userpos),
+		WIRE_END } },
+	{ 0xF2, 0x06, sizeof(_PMSG_INITINFO), {
+		WIRE_FIELD(_BYTES, _PMSG_INITINFO, init),
+		WIRE_FIELD(_BYTES, _PMSG_INITINFO, gamepos),
+		WIRE_FIELD(_BYTES, _PMSG_INITINFO, resume),
+		WIRE_FIELD(_BYTES, _PMSG_INITINFO, ectype),
+		WIRE_END } },
+	{ 0xF2, 0x07, sizeof(_PMSG_TOKEN_INFO), {
+		WIRE_FIELD(_BYTES, _PMSG_TOKEN_INFO, flag),
+		WIRE_FIELD(_STR, _PMSG_TOKEN_INFO, token),
+		WIRE_END } },
+	{ 0xF2, 0x08, sizeof(_PMSG_TRANSACT_INFO), {
+		WIRE_FIELD(_BYTES, _PMSG_TRANSACT_INFO, winnerpos),
+		WIRE_FIELD(_UINT, _PMSG_TRANSACT_INFO, hitecoins),
+		WIRE_TRANSACT_USER(0),
+		WIRE_TRANSACT_USER(1),
+		WIRE_TRANSACT_USER(2),
+		WIRE_END } },
+	{ 0xF2, 0x09, sizeof(_PMSG_LOGIN_RESULT), {
+		WIRE_FIELD(_BYTES, _PMSG_LOGIN_RESULT, result),
+		WIRE_FIELD(_STR, _PMSG_LOGIN_RESULT, accountid),
+		WIRE_FIELD(_UINT, _PMSG_LOGIN_RESULT, ecoins),
+		WIRE_FIELD(_UINT, _PMSG_LOGIN_RESULT, jewels),
+		WIRE_FIELD(_STR, _PMSG_LOGIN_RESULT, ecoinsnote),
+		WIRE_FIELD(_STR, _PMSG_LOGIN_RESULT, jewelsnote),
+		WIRE_FIELD(_BYTES, _PMSG_LOGIN_RESULT, isuseradmin),
+		WIRE_END } },
+	{ 0xF2, 0x0C, sizeof(_PMSG_REDIRECT_INFO), {
+		WIRE_FIELD(_BYTES, _PMSG_REDIRECT_INFO, gametype),
+		WIRE_FIELD(_BYTES, _PMSG_REDIRECT_INFO, port),
+		WIRE_FIELD(_STR, _PMSG_REDIRECT_INFO, host),
+		WIRE_FIELD(_STR, _PMSG_REDIRECT_INFO, token),
+		WIRE_END } },
+	{ 0xF2, 0x0D, sizeof(_PMSG_RETRY_INFO), {
+		WIRE_FIELD(_UINT, _PMSG_RETRY_INFO, retrymsec),
+		WIRE_END } },
+	{ 0xF2, 0x0E, sizeof(_PMSG_REPLAY_SEQ), {
+		WIRE_FIELD(_UINT, _PMSG_REPLAY_SEQ, seq),
+		WIRE_END } },
+	{ 0xF2, 0x0F, sizeof(_PMSG_CLOCK_INFO), {
+		WIRE_FIELD(_UINT, _PMSG_CLOCK_INFO, servermsec),
+		WIRE_END } },
+	{ 0xF2, 0x11, sizeof(_PMSG_STAMP_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_STAMP_ANS, head),
+		WIRE_FIELD(_BYTES, _PMSG_STAMP_ANS, reqsub),
+		WIRE_FIELD(_UINT, _PMSG_STAMP_ANS, clientstamp),
+		WIRE_FIELD(_UINT, _PMSG_STAMP_ANS, serverusec),
+		WIRE_END } },
+	{ 0xF3, 0x00, sizeof(_PMSG_DRAW_CARD_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_DRAW_CARD_ANS, userpos),
+		WIRE_FIELD(_BYTES, _PMSG_DRAW_CARD_ANS, init),
+		WIRE_FIELD(_CARD, _PMSG_DRAW_CARD_ANS, cardtype),
+		WIRE_END } },
+	{ 0xF3, 0x01, sizeof(_PMSG_DROP_CARD_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_DROP_CARD_ANS, userpos),
+		WIRE_FIELD(_BYTES, _PMSG_DROP_CARD_ANS, pos),
+		WIRE_FIELD(_CARD, _PMSG_DROP_CARD_ANS, cardtype),
+		WIRE_END } },
+	{ 0xF3, 0x02, sizeof(_PMSG_CHOWCARD_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_CHOWCARD_ANS, downpos),
+		WIRE_FIELD(_BYTES, _PMSG_CHOWCARD_ANS, gamepos),
+		WIRE_FIELD(_BYTES, _PMSG_CHOWCARD_ANS, userpos),
+		WIRE_FIELD(_CARD, _PMSG_CHOWCARD_ANS, chowpos),
+		WIRE_FIELD(_CARDS, _PMSG_CHOWCARD_ANS, count),
+		WIRE_END } },
+	{ 0xF3, 0x03, sizeof(_PMSG_DOWNCARD_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_DOWNCARD_ANS, downpos),
+		WIRE_FIELD(_BYTES, _PMSG_DOWNCARD_ANS, gamepos),
+		WIRE_FIELD(_CARDS, _PMSG_DOWNCARD_ANS, count),
+		WIRE_END } },
+	{ 0xF3, 0x04, sizeof(_PMSG_SAPAWCARD_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_SAPAWCARD_ANS, downpos),
+		WIRE_FIELD(_BYTES, _PMSG_SAPAWCARD_ANS, gamepos),
+		WIRE_FIELD(_BYTES, _PMSG_SAPAWCARD_ANS, usergamepos),
+		WIRE_FIELD(_CARDS, _PMSG_SAPAWCARD_ANS, count),
+		WIRE_END } },
+	{ 0xF3, 0x05, sizeof(_PMSG_GRPCARD_ANS), {
+		WIRE_FIELD(_INT, _PMSG_GRPCARD_ANS, grppos),
+		WIRE_FIELD(_BYTES, _PMSG_GRPCARD_ANS, gamepos),
+		WIRE_FIELD(_CARDS, _PMSG_GRPCARD_ANS, count),
+		WIRE_END } },
+	{ 0xF3, 0x06, sizeof(_PMSG_UNGRPCARD_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_UNGRPCARD_ANS, downpos),
+		WIRE_FIELD(_BYTES, _PMSG_UNGRPCARD_ANS, gamepos),
+		WIRE_END } },
+	{ 0xF3, 0x07, sizeof(_PMSG_FIGHTCARD_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_FIGHTCARD_ANS, userpos),
+		WIRE_END } },
+	{ 0xF3, 0x08, sizeof(_PMSG_FIGHT2CARD_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_FIGHT2CARD_ANS, userpos),
+		WIRE_FIELD(_BYTES, _PMSG_FIGHT2CARD_ANS, isfight),
+		WIRE_END } },
+	{ 0xF3, 0x09, sizeof(_PMSG_SEQ_ANS), {
+		WIRE_FIELD(_BYTES, _PMSG_SEQ_ANS, result),
+		WIRE_FIELD(_BYTES, _PMSG_SEQ_ANS, reason),
+		WIRE_FIELD(_UINT, _PMSG_SEQ_ANS, seq),
+		WIRE_FIELD(_UINT, _PMSG_SEQ_ANS, version),
+		WIRE_END } },
+	{ 0xF3, 0x0A, sizeof(_PMSG_ACTION_MASK), {
+		WIRE_FIELD(_UINT, _PMSG_ACTION_MASK, actions),
+		WIRE_FIELD(_CARD, _PMSG_ACTION_MASK, chowtype),
+		WIRE_FIELD(_UINT, _PMSG_ACTION_MASK, sapawdowns),
+		WIRE_END } },
+};
+
+static const _WIRE_PACKET* wirefind(unsigned char h, unsigned char sub)
+{
+	for (size_t n = 0; n < sizeof(wirepackets) / sizeof(wirepackets[0]); n++) {
+		if (wirepackets[n].h == h && wirepackets[n].sub == sub)
+			return &wirepackets[n];
+	}
+	return NULL;
+}
+
+void wirevarint(std::vector<unsigned char>& out, uint32_t v)
+{
+	while (v >= 0x80) {
+		out.push_back((unsigned char)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((unsigned char)v);
+}
+
+unsigned char wirecard(unsigned char cardtype, unsigned char cardnum)
+{
+	return (unsigned char)(((cardtype & 0x0F) << 4) | (cardnum & 0x0F));
+}
+
+void wirecards(std::vector<unsigned char>& out, const unsigned char* cards, const unsigned char* nums, int count)
+{
+	uint64_t mask = 0;
+	int last = -1;
+	bool issorted = count >= 8;	// below this the list is not longer than the mask
+
+	for (int n = 0; n < count && issorted; n++) {
+		int cardtype = (nums != NULL) ? cards[n] : cards[n * 2];
+		int cardnum = (nums != NULL) ? nums[n] : cards[n * 2 + 1];
+		int bit = (cardtype - 1) * 13 + cardnum - 1;
+		if (cardtype < 1 || cardtype > 4 || cardnum < 1 || cardnum > 13 || bit <= last)
+			issorted = false;
+		mask |= 1ULL << bit;
+		last = bit;
+	}
+
+	if (issorted) {
+		out.push_back((unsigned char)(0x80 | count));
+		for (int n = 0; n < 7; n++)
+			out.push_back((unsigned char)(mask >> (n * 8)));
+		return;
+	}
+
+	out.push_back((unsigned char)count);
+	for (int n = 0; n < count; n++) {
+		if (nums != NULL)
+			out.push_back(wirecard(cards[n], nums[n]));
+		else
+			out.push_back(wirecard(cards[n * 2], cards[n * 2 + 1]));
+	}
+}
+
+static bool wirepacket(const _WIRE_PACKET* packet, const unsigned char* data, int len, std::vector<unsigned char>& out)
+{
+	int32_t i;
+	uint32_t u;
+
+	for (const _WIRE_FIELD_INFO* field = packet->fields; field->type != _WIRE_FIELD::_END; field++) {
+
+		const unsigned char* p = data + field->offset;
+
+		if (field->type != _WIRE_FIELD::_INITCARDS && field->offset + field->size > len)
+			return false;
+
+		switch (field->type) {
+		case _WIRE_FIELD::_BYTES:
+			out.insert(out.end(), p, p + field->size);
+			break;
+		case _WIRE_FIELD::_UINT:
+			memcpy(&u, p, sizeof(u));
+			wirevarint(out, u);
+			break;
+		case _WIRE_FIELD::_INT:
+			memcpy(&i, p, sizeof(i));
+			wirevarint(out, ((uint32_t)i << 1) ^ (uint32_t)(i >> 31));
+			break;
+		case _WIRE_FIELD::_STR:
+		{
+			size_t n = 0;
+			while (n < field->size && p[n] != 0)
+				n++;
+			wirevarint(out, (uint32_t)n);
+			out.insert(out.end(), p, p + n);
+			break;
+		}
+		case _WIRE_FIELD::_CARD:
+			out.push_back(wirecard(p[0], p[1]));
+			break;
+		case _WIRE_FIELD::_CARDS:
+		{
+			// the count decides, a few senders put a larger length in the header than they wrote
+			int count = p[0];
+			if (count >= 0x80 || packet->size + count * (int)sizeof(_PMSG_CARD_INFO) > len)
+				return false;
+			wirecards(out, data + packet->size, NULL, count);
+			break;
+		}
+		case _WIRE_FIELD::_INITCARDS:
+		{
+			const _INIT_CARDS* cards = (const _INIT_CARDS*)p;
+			if (packet->size > len || cards->cardcounts > sizeof(cards->cardtype))
+				return false;
+			wirecards(out, cards->cardtype, cards->cardnum, cards->cardcounts);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+bool wireencode(const unsigned char* data, int len, std::vector<unsigned char>& out)
+{
+	static thread_local std::vector<unsigned char> body;
+
+	while (len > 0) {
+
+		if (len < (int)sizeof(_PMSG_DEF_SUB) || data[0] != 0xC1)
+			return false;
+
+		const _PMSG_DEF_SUB* hdr = (const _PMSG_DEF_SUB*)data;
+		int size = hdr->hdr.len;
+		if (size < (int)sizeof(_PMSG_DEF_SUB))
+			return false;
+		if (size > len)
+			size = len;
+
+		const _WIRE_PACKET* packet = wirefind(hdr->hdr.h, hdr->sub);
+
+		body.clear();
+		body.push_back(hdr->hdr.h);
+		body.push_back(hdr->sub);
+		if (packet != NULL) {
+			if (!wirepacket(packet, data, size, body))
+				return false;
+		}
+		else {
+			body.insert(body.end(), data + sizeof(_PMSG_DEF_SUB), data + size);
+		}
+
+		wirevarint(out, (uint32_t)body.size());
+		out.insert(out.end(), body.begin(), body.end());
+
+		data += size;
+		len -= size;
+	}
+	return true;
+}
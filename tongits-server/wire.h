@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+// compact encoding of the packets sent to a client with the v2 app. the game code keeps building the
+// prodef.h structs, datasend rewrites each one into a byte stream that does not depend on how the
+// compiler padded them:
+//   frame    varint length of what follows, h, sub, body
+//   integers unsigned varint, signed ones zigzag first
+//   strings  varint length and the bytes up to the first nul of the fixed field
+//   card     one byte, cardtype << 4 | cardnum, 0 for a hidden card
+//   cards    a count byte below 0x80 and that many cards in their order, or 0x80 | count and a 7 byte
+//            mask of bits (cardtype - 1) * 13 + cardnum - 1 when the list is already in that order
+// packets without an entry in the table keep their v1 body after the compact header. requests from
+// the client still use the v1 framing
+//
+// a v2 app that resumes a game gets F2 0A, the whole table in one frame instead of the v1 burst of
+// cards, melds and infos. the game writes its body in the form above, the packets that follow are
+// the usual per action ones and act as the deltas on top of it:
+//   seq, gamepos, ectype, state, activepos, timelimit_msec, hitter (int, -1 none), counter (int),
+//   hitprize, stockcount, per seat name, ecoins, cardcounts and its downs (count, cards each),
+//   own hand cards, own groups (count, cards each), drops (count, userpos pos card each)
+
+#define WIRE_V1 1
+#define WIRE_V2 2
+#define APK_VER_WIRE_V2 6	// gamever of the apps that read v2, APK_VER ones get v1
+#define APK_VER_NOTICE_ID 7	// v2 and the notices by number, see notice.h
+#define APK_VER_DEADLINE 8	// and the turn deadlines on the clock of the server, see game::senddeadline
+#define APK_VER_ACTION_MASK 9	// and the actions open to it as its turn starts, see game::sendactionmask
+#define APK_VER_FASTLANE 10	// and the udp side channel when the server has one, see fastlane.h
+#define APK_VER_LATENCY 11	// and stamps its requests and reports the round trips, see latency.h
+#define WIRE_SYNC_SUB 0x0A	// F2 sub of the resume snapshot
+
+// appends the v2 form of the v1 packets in data to out, false when one of them is malformed
+bool wireencode(const unsigned char* data, int len, std::vector<unsigned char>& out);
+
+// for bodies written straight in v2 form, cards holds count {cardtype, cardnum} pairs, or the types
+// and nums the numbers when nums is set
+void wirevarint(std::vector<unsigned char>& out, uint32_t v);
+unsigned char wirecard(unsigned char cardtype, unsigned char cardnum);
+void wirecards(std::vector<unsigned char>& out, const unsigned char* cards, const unsigned char* nums, int count);
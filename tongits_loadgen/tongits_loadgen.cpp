@@ -0,0 +1,936 @@
+/** @file tongits_loadgen.cpp
+	Load generator for tongits-server, simulated players log in, join games and play legal moves over plain TCP.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <signal.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <event2/event.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include "../tongits-server/prodef.h"
+
+#define LOADGEN_GAMEVER 5	// APK_VER of tongits-server/common.h, answered in v1
+#define LOADGEN_STARTED 4	// _GAME_STATE::_STARTED of tongits-server/common.h
+#define LOADGEN_MAX_CARDS 13
+#define LOADGEN_ALIVE_MSEC 10000
+#define LOADGEN_REPORT_MSEC 5000
+#define LOADGEN_DROP_TRIES 4	// a drop the server refuses is tried with the next card
+#define LOADGEN_FIGHT_PERCENT 10	// turns a player with a down starts with a fight
+
+struct _LoadConfig
+{
+	std::string host;
+	int port;
+	int clients;
+	std::string prefix;	// accounts are prefix0, prefix1, ...
+	std::string secret;
+	std::string tokens;	// file of login tokens, one per line, used instead of the accounts
+	int gametype;
+	int seconds;
+	int thinkmin;	// msec between two requests of a player, the server takes one every 500
+	int thinkmax;
+	int ramp;	// connections opened per second
+	int report;	// seconds between two report lines
+};
+
+struct _LoadCard
+{
+	unsigned char type;
+	unsigned char num;
+};
+
+// every request that is timed, its answer is the first packet of the same head and sub for the player
+// or the F2 04 refusal
+enum class _LoadOp
+{
+	_LOGIN = 0,
+	_JOIN,
+	_DRAW,
+	_DROP,
+	_DOWN,
+	_SAPAW,
+	_FIGHT,
+	_FIGHT2,
+	_MAX
+};
+
+static const struct {
+	const char* name;
+	bool ismove;
+} loadops[(int)_LoadOp::_MAX] = {
+	{ "login", false },
+	{ "join", false },
+	{ "draw", true },
+	{ "drop", true },
+	{ "down", true },
+	{ "sapaw", true },
+	{ "fight", true },
+	{ "fight2", true },
+};
+
+enum class _LoadStep
+{
+	_NONE,
+	_LOGIN,
+	_JOIN,
+	_DRAWINIT,
+	_TURN,	// fight or draw
+	_DOWN,
+	_SAPAW,
+	_DROP,
+	_FIGHT2,
+};
+
+struct _LoadClient
+{
+	int index;
+	struct bufferevent* bev;
+	struct event* timer;
+	struct event* alive;
+	_LoadStep step;	// run when timer fires
+	int gamepos;
+	bool isingame;
+	bool isturn;
+	bool hasdown;
+	int droptries;
+	std::vector<_LoadCard> hand;
+	std::vector<std::vector<_LoadCard>> downs[3];
+	unsigned long long jointick;
+	int pending;	// _LoadOp waiting for its answer, -1 for none
+	unsigned long long pendingtick;
+};
+
+struct _LoadStats
+{
+	std::vector<unsigned long long> vLatency[(int)_LoadOp::_MAX];	// usec
+	long long refused[(int)_LoadOp::_MAX];
+	std::vector<unsigned long long> vWait;	// msec from join to the table
+	std::vector<unsigned long long> vWindow;	// usec of every answer since the last report line
+	long long moves;
+	long long games;
+	long long disconnects;
+	long long notices;
+};
+
+static _LoadConfig config;
+static _LoadStats stats;
+static std::vector<std::string> vTokens;
+static std::vector<_LoadClient*> vClients;
+static struct event_base* base;
+static std::mt19937 rng;
+static unsigned long long starttick;
+static bool isstopping = false;
+
+static unsigned long long le_nowusec();
+static void le_connect(_LoadClient* client);
+static void le_readcb(struct bufferevent*, void*);
+static void le_eventcb(struct bufferevent*, short, void*);
+static void le_timercb(evutil_socket_t, short, void*);
+static void le_alivecb(evutil_socket_t, short, void*);
+static void le_think(_LoadClient* client, _LoadStep step);
+static void le_step(_LoadClient* client);
+static void le_packet(_LoadClient* client, unsigned char* data, int len);
+static void le_answer(_LoadClient* client, _LoadOp op, bool isrefused);
+static void le_report(bool isfinal);
+
+static unsigned long long le_nowusec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static unsigned long long le_percentile(std::vector<unsigned long long>& v, double p)
+{
+	if (v.empty())
+		return 0;
+	std::sort(v.begin(), v.end());
+	size_t n = (size_t)(p * (v.size() - 1));
+	return v[n];
+}
+
+static void le_header(_PMSG_HDR& hdr, unsigned char head, int len)
+{
+	hdr.c = 0xC1;
+	hdr.h = head;
+	hdr.len = (unsigned short)len;
+}
+
+static void le_send(_LoadClient* client, void* data, int len, int op)
+{
+	if (client->bev == NULL)
+		return;
+
+	if (op >= 0) {
+		client->pending = op;
+		client->pendingtick = le_nowusec();
+	}
+	bufferevent_write(client->bev, data, len);
+}
+
+static void le_sendcards(_LoadClient* client, void* msg, int size, const std::vector<_LoadCard>& cards, _LoadOp op)
+{
+	unsigned char buf[sizeof(_PMSG_SAPAWCARD_REQ) + LOADGEN_MAX_CARDS * sizeof(_PMSG_CARD_INFO)] = { 0 };
+	int len = size + (int)(cards.size() * sizeof(_PMSG_CARD_INFO));
+
+	((_PMSG_HDR*)msg)->len = (unsigned short)len;
+	memcpy(buf, msg, size);
+	for (size_t n = 0; n < cards.size(); n++) {
+		_PMSG_CARD_INFO* card = (_PMSG_CARD_INFO*)(buf + size + n * sizeof(_PMSG_CARD_INFO));
+		card->cardtype = cards[n].type;
+		card->cardnum = cards[n].num;
+	}
+	le_send(client, buf, len, (int)op);
+}
+
+static void le_removecard(_LoadClient* client, unsigned char type, unsigned char num)
+{
+	for (size_t n = 0; n < client->hand.size(); n++) {
+		if (client->hand[n].type == type && client->hand[n].num == num) {
+			client->hand.erase(client->hand.begin() + n);
+			return;
+		}
+	}
+}
+
+// three or more of a number, else three or more in a row of a suit
+static bool le_findmeld(const std::vector<_LoadCard>& hand, std::vector<_LoadCard>& meld)
+{
+	bool has[5][LOADGEN_MAX_CARDS + 2] = { { false } };
+
+	for (size_t n = 0; n < hand.size(); n++) {
+		if (hand[n].type >= 1 && hand[n].type <= 4 && hand[n].num >= 1 && hand[n].num <= LOADGEN_MAX_CARDS)
+			has[hand[n].type][hand[n].num] = true;
+	}
+
+	for (int num = 1; num <= LOADGEN_MAX_CARDS; num++) {
+		meld.clear();
+		for (int type = 1; type <= 4; type++) {
+			if (has[type][num])
+				meld.push_back({ (unsigned char)type, (unsigned char)num });
+		}
+		if (meld.size() >= 3)
+			return true;
+	}
+
+	for (int type = 1; type <= 4; type++) {
+		meld.clear();
+		for (int num = 1; num <= LOADGEN_MAX_CARDS + 1; num++) {
+			if (num <= LOADGEN_MAX_CARDS && has[type][num]) {
+				meld.push_back({ (unsigned char)type, (unsigned char)num });
+				continue;
+			}
+			if (meld.size() >= 3)
+				return true;
+			meld.clear();
+		}
+	}
+	return false;
+}
+
+// a card of the hand that extends a down on the table
+static bool le_findsapaw(_LoadClient* client, int& userpos, int& downpos, _LoadCard& card)
+{
+	for (int pos = 0; pos < 3; pos++) {
+		for (size_t d = 0; d < client->downs[pos].size(); d++) {
+			const std::vector<_LoadCard>& down = client->downs[pos][d];
+			if (down.empty())
+				continue;
+
+			bool isset = down.size() > 1 && down[0].num == down[1].num;
+			int low = LOADGEN_MAX_CARDS, high = 0;
+			for (size_t n = 0; n < down.size(); n++) {
+				low = std::min(low, (int)down[n].num);
+				high = std::max(high, (int)down[n].num);
+			}
+
+			for (size_t n = 0; n < client->hand.size(); n++) {
+				const _LoadCard& c = client->hand[n];
+				bool isfit = isset ? (c.num == down[0].num) : (c.type == down[0].type && (c.num == low - 1 || c.num == high + 1));
+				if (isfit) {
+					userpos = pos;
+					downpos = (int)d;
+					card = c;
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+// the highest card that is not part of a meld, later tries walk down the hand
+static bool le_pickdrop(_LoadClient* client, _LoadCard& card)
+{
+	std::vector<_LoadCard> sorted = client->hand;
+	std::vector<_LoadCard> meld;
+
+	if (sorted.empty())
+		return false;
+
+	std::sort(sorted.begin(), sorted.end(), [](const _LoadCard& a, const _LoadCard& b) { return a.num > b.num; });
+
+	if (le_findmeld(sorted, meld)) {
+		std::stable_partition(sorted.begin(), sorted.end(), [&meld](const _LoadCard& c) {
+			for (size_t n = 0; n < meld.size(); n++) {
+				if (meld[n].type == c.type && meld[n].num == c.num)
+					return false;
+			}
+			return true;
+		});
+	}
+
+	card = sorted[client->droptries % sorted.size()];
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	config.host = "127.0.0.1";
+	config.port = 3000;
+	config.clients = 300;
+	config.prefix = "load";
+	config.secret = "load";
+	config.gametype = 0;
+	config.seconds = 60;
+	config.thinkmin = 600;
+	config.thinkmax = 2000;
+	config.ramp = 200;
+	config.report = LOADGEN_REPORT_MSEC / 1000;
+
+	for (int n = 1; n < argc; n++) {
+		std::string arg = argv[n];
+		const char* value = (n + 1 < argc) ? argv[n + 1] : NULL;
+
+		if (value == NULL) {
+			printf("usage: tongits_loadgen [-h host] [-p port] [-n clients] [-u prefix] [-s secret] [-k tokenfile] [-g gametype] [-d seconds] [-t thinkmin] [-T thinkmax] [-r ramp] [-i report]\n");
+			return -1;
+		}
+
+		if (arg == "-h")
+			config.host = value;
+		else if (arg == "-p")
+			config.port = atoi(value);
+		else if (arg == "-n")
+			config.clients = atoi(value);
+		else if (arg == "-u")
+			config.prefix = value;
+		else if (arg == "-s")
+			config.secret = value;
+		else if (arg == "-k")
+			config.tokens = value;
+		else if (arg == "-g")
+			config.gametype = atoi(value);
+		else if (arg == "-d")
+			config.seconds = atoi(value);
+		else if (arg == "-t")
+			config.thinkmin = atoi(value);
+		else if (arg == "-T")
+			config.thinkmax = atoi(value);
+		else if (arg == "-r")
+			config.ramp = atoi(value);
+		else if (arg == "-i")
+			config.report = atoi(value);
+		n++;
+	}
+
+	if (config.thinkmax < config.thinkmin)
+		config.thinkmax = config.thinkmin;
+	if (config.ramp < 1)
+		config.ramp = 1;
+	if (config.report < 1)
+		config.report = 1;
+
+	if (config.tokens.size() > 0) {
+		std::ifstream file(config.tokens);
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.size() > 0)
+				vTokens.push_back(line);
+		}
+		if (vTokens.empty()) {
+			printf("No login token found in %s.\n", config.tokens.c_str());
+			return -1;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	rng.seed((unsigned int)le_nowusec());
+	base = event_base_new();
+	starttick = le_nowusec();
+
+	for (int n = 0; n < config.clients; n++) {
+		_LoadClient* client = new _LoadClient();
+		client->index = n;
+		client->bev = NULL;
+		client->timer = evtimer_new(base, le_timercb, client);
+		client->alive = event_new(base, -1, EV_PERSIST, le_alivecb, client);
+		client->step = _LoadStep::_NONE;
+		client->pending = -1;
+		vClients.push_back(client);
+
+		// the connections are spread over the ramp instead of hitting the listener at once
+		struct timeval tv;
+		unsigned long long usec = (unsigned long long)n * 1000000ULL / config.ramp;
+		tv.tv_sec = usec / 1000000;
+		tv.tv_usec = usec % 1000000;
+		event_base_once(base, -1, EV_TIMEOUT, [](evutil_socket_t, short, void* arg) { le_connect((_LoadClient*)arg); }, client, &tv);
+	}
+
+	struct event* report = event_new(base, -1, EV_PERSIST, [](evutil_socket_t, short, void*) {
+		le_report(false);
+		if (le_nowusec() - starttick >= (unsigned long long)config.seconds * 1000000ULL) {
+			isstopping = true;
+			event_base_loopbreak(base);
+		}
+	}, NULL);
+	struct timeval tv = { config.report, 0 };
+	event_add(report, &tv);
+
+	printf("%d clients to %s:%d for %d s, think %d-%d ms.\n", config.clients, config.host.c_str(), config.port, config.seconds, config.thinkmin, config.thinkmax);
+
+	event_base_dispatch(base);
+
+	le_report(true);
+
+	for (size_t n = 0; n < vClients.size(); n++) {
+		if (vClients[n]->bev != NULL)
+			bufferevent_free(vClients[n]->bev);
+		event_free(vClients[n]->timer);
+		event_free(vClients[n]->alive);
+		delete vClients[n];
+	}
+	event_free(report);
+	event_base_free(base);
+	return 0;
+}
+
+static void le_connect(_LoadClient* client)
+{
+	if (isstopping)
+		return;
+
+	struct sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(config.port);
+	inet_pton(AF_INET, config.host.c_str(), &sa.sin_addr);
+
+	client->bev = bufferevent_socket_new(base, -1, BEV_OPT_CLOSE_ON_FREE);
+	client->gamepos = -1;
+	client->isingame = false;
+	client->isturn = false;
+	client->hasdown = false;
+	client->pending = -1;
+	client->hand.clear();
+	bufferevent_setcb(client->bev, le_readcb, NULL, le_eventcb, client);
+	bufferevent_enable(client->bev, EV_READ | EV_WRITE);
+
+	if (bufferevent_socket_connect(client->bev, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+		bufferevent_free(client->bev);
+		client->bev = NULL;
+		stats.disconnects++;
+	}
+}
+
+static void le_eventcb(struct bufferevent* bev, short events, void* arg)
+{
+	_LoadClient* client = (_LoadClient*)arg;
+
+	if (events & BEV_EVENT_CONNECTED) {
+		struct timeval tv = { LOADGEN_ALIVE_MSEC / 1000, 0 };
+		event_add(client->alive, &tv);
+		le_think(client, _LoadStep::_LOGIN);
+		return;
+	}
+
+	if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+		stats.disconnects++;
+		bufferevent_free(bev);
+		client->bev = NULL;
+		event_del(client->timer);
+		event_del(client->alive);
+
+		// a dropped player comes back after a while like a phone would
+		struct timeval tv = { 1 + (long)(rng() % 5), 0 };
+		event_base_once(base, -1, EV_TIMEOUT, [](evutil_socket_t, short, void* arg) { le_connect((_LoadClient*)arg); }, client, &tv);
+	}
+}
+
+static void le_readcb(struct bufferevent* bev, void* arg)
+{
+	_LoadClient* client = (_LoadClient*)arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+
+	while (client->bev != NULL) {
+
+		size_t bufferlen = evbuffer_get_length(input);
+
+		if (bufferlen < sizeof(_PMSG_HDR))
+			break;
+
+		unsigned char* data = evbuffer_pullup(input, sizeof(_PMSG_HDR));
+		int len = ((_PMSG_HDR*)data)->len;
+
+		if (data[0] == 0xC2)
+			len = (data[1] << 8) | data[2];
+
+		if (len < (int)sizeof(_PMSG_HDR)) {
+			printf("client %d, invalid packet length %d.\n", client->index, len);
+			le_eventcb(bev, BEV_EVENT_ERROR, client);
+			return;
+		}
+
+		if (bufferlen < (size_t)len)
+			break;
+
+		data = evbuffer_pullup(input, len);
+		if (data[0] == 0xC1)
+			le_packet(client, data, len);
+		evbuffer_drain(input, len);
+	}
+}
+
+static void le_alivecb(evutil_socket_t, short, void* arg)
+{
+	_LoadClient* client = (_LoadClient*)arg;
+	_PMSG_ALIVE pMsg = { 0 };
+	le_header(pMsg.hdr, 0xF2, sizeof(pMsg));
+	pMsg.sub = 0x01;
+	le_send(client, &pMsg, sizeof(pMsg), -1);
+}
+
+static void le_think(_LoadClient* client, _LoadStep step)
+{
+	client->step = step;
+	struct timeval tv;
+	int msec = config.thinkmin + (int)(rng() % (config.thinkmax - config.thinkmin + 1));
+	tv.tv_sec = msec / 1000;
+	tv.tv_usec = (msec % 1000) * 1000;
+	evtimer_add(client->timer, &tv);
+}
+
+static void le_timercb(evutil_socket_t, short, void* arg)
+{
+	le_step((_LoadClient*)arg);
+}
+
+// the next request of the player, steps with nothing to do fall through to the next one right away
+static void le_step(_LoadClient* client)
+{
+	if (client->bev == NULL)
+		return;
+
+	switch (client->step) {
+	case _LoadStep::_NONE:
+		break;
+
+	case _LoadStep::_LOGIN:
+	{
+		if (vTokens.size() > 0) {
+			_PMSG_LOGIN_TOKEN pMsg = { 0 };
+			le_header(pMsg.hdr, 0xF1, sizeof(pMsg));
+			pMsg.sub = 0x01;
+			strncpy(pMsg.md5token, vTokens[client->index % vTokens.size()].c_str(), sizeof(pMsg.md5token) - 1);
+			pMsg.gamever = LOADGEN_GAMEVER;
+			le_send(client, &pMsg, sizeof(pMsg), (int)_LoadOp::_LOGIN);
+		}
+		else {
+			_PMSG_LOGIN_USER pMsg = { 0 };
+			le_header(pMsg.hdr, 0xF1, sizeof(pMsg));
+			pMsg.sub = 0x02;
+			snprintf(pMsg.user, sizeof(pMsg.user), "%s%d", config.prefix.c_str(), client->index);
+			strncpy(pMsg.secret, config.secret.c_str(), sizeof(pMsg.secret) - 1);
+			pMsg.gamever = LOADGEN_GAMEVER;
+			le_send(client, &pMsg, sizeof(pMsg), (int)_LoadOp::_LOGIN);
+		}
+
+		// players are spread over the globe so the distance check never keeps two of them apart
+		_PMSG_GPS_INFO gps = { 0 };
+		le_header(gps.hdr, 0xF1, sizeof(gps));
+		gps.sub = 0x04;
+		gps.latitue = (double)(rng() % 120000) / 1000.0 - 60.0;
+		gps.longitude = (double)(rng() % 360000) / 1000.0 - 180.0;
+		le_send(client, &gps, sizeof(gps), -1);
+		client->step = _LoadStep::_NONE;
+	}
+	break;
+
+	case _LoadStep::_JOIN:
+	{
+		_PMSG_JOINGAME_INFO pMsg = { 0 };
+		le_header(pMsg.hdr, 0xF1, sizeof(pMsg));
+		pMsg.sub = 0x03;
+		pMsg.gametype = (unsigned char)config.gametype;
+		client->jointick = le_nowusec();
+		le_send(client, &pMsg, sizeof(pMsg), (int)_LoadOp::_JOIN);
+		client->step = _LoadStep::_NONE;
+	}
+	break;
+
+	case _LoadStep::_DRAWINIT:
+	{
+		_PMSG_REQ_DRAWINIT pMsg = { 0 };
+		le_header(pMsg.hdr, 0xF2, sizeof(pMsg));
+		pMsg.sub = 0x03;
+		pMsg.flag = 1;
+		le_send(client, &pMsg, sizeof(pMsg), -1);
+		client->step = _LoadStep::_NONE;
+	}
+	break;
+
+	case _LoadStep::_TURN:
+	{
+		client->droptries = 0;
+
+		if (client->hasdown && (int)(rng() % 100) < LOADGEN_FIGHT_PERCENT) {
+			_PMSG_FIGHTCARD_REQ pMsg = { 0 };
+			le_header(pMsg.hdr, 0xF3, sizeof(pMsg));
+			pMsg.sub = 0x07;
+			le_send(client, &pMsg, sizeof(pMsg), (int)_LoadOp::_FIGHT);
+			client->step = _LoadStep::_NONE;
+			break;
+		}
+
+		// the first player of a round starts with the extra card already dealt
+		if (client->hand.size() >= LOADGEN_MAX_CARDS) {
+			client->step = _LoadStep::_DOWN;
+			le_step(client);
+			break;
+		}
+
+		_PMSG_DRAW_CARD_REQ pMsg = { 0 };
+		le_header(pMsg.hdr, 0xF3, sizeof(pMsg));
+		pMsg.sub = 0x00;
+		le_send(client, &pMsg, sizeof(pMsg), (int)_LoadOp::_DRAW);
+		client->step = _LoadStep::_NONE;
+	}
+	break;
+
+	case _LoadStep::_DOWN:
+	{
+		std::vector<_LoadCard> meld;
+
+		if (client->hasdown || !le_findmeld(client->hand, meld)) {
+			client->step = _LoadStep::_SAPAW;
+			le_step(client);
+			break;
+		}
+
+		_PMSG_DOWNCARD_REQ pMsg = { 0 };
+		le_header(pMsg.hdr, 0xF3, sizeof(pMsg));
+		pMsg.sub = 0x03;
+		pMsg.count = (unsigned char)meld.size();
+		le_sendcards(client, &pMsg, sizeof(pMsg), meld, _LoadOp::_DOWN);
+		client->step = _LoadStep::_NONE;
+	}
+	break;
+
+	case _LoadStep::_SAPAW:
+	{
+		int userpos, downpos;
+		_LoadCard card;
+
+		if (!le_findsapaw(client, userpos, downpos, card)) {
+			client->step = _LoadStep::_DROP;
+			le_step(client);
+			break;
+		}
+
+		_PMSG_SAPAWCARD_REQ pMsg = { 0 };
+		le_header(pMsg.hdr, 0xF3, sizeof(pMsg));
+		pMsg.sub = 0x04;
+		pMsg.userpos = (unsigned char)userpos;
+		pMsg.downpos = (unsigned char)downpos;
+		pMsg.count = 1;
+		le_sendcards(client, &pMsg, sizeof(pMsg), std::vector<_LoadCard>(1, card), _LoadOp::_SAPAW);
+		client->step = _LoadStep::_NONE;
+	}
+	break;
+
+	case _LoadStep::_DROP:
+	{
+		_LoadCard card;
+
+		if (client->droptries >= LOADGEN_DROP_TRIES || !le_pickdrop(client, card)) {
+			// the server drops for the player once the turn times out
+			client->step = _LoadStep::_NONE;
+			break;
+		}
+
+		_PMSG_DROP_CARD_REQ pMsg = { 0 };
+		le_header(pMsg.hdr, 0xF3, sizeof(pMsg));
+		pMsg.sub = 0x01;
+		pMsg.pos[0] = card.type;
+		pMsg.pos[1] = card.num;
+		client->droptries++;
+		le_send(client, &pMsg, sizeof(pMsg), (int)_LoadOp::_DROP);
+		client->step = _LoadStep::_NONE;
+	}
+	break;
+
+	case _LoadStep::_FIGHT2:
+	{
+		_PMSG_FIGHTCARD_REQ pMsg = { 0 };
+		le_header(pMsg.hdr, 0xF3, sizeof(pMsg));
+		pMsg.sub = 0x08;
+		pMsg.isfight = 1;
+		le_send(client, &pMsg, sizeof(pMsg), (int)_LoadOp::_FIGHT2);
+		client->step = _LoadStep::_NONE;
+	}
+	break;
+	}
+}
+
+static void le_answer(_LoadClient* client, _LoadOp op, bool isrefused)
+{
+	if (client->pending != (int)op)
+		return;
+
+	stats.vLatency[(int)op].push_back(le_nowusec() - client->pendingtick);
+	stats.vWindow.push_back(stats.vLatency[(int)op].back());
+	if (isrefused)
+		stats.refused[(int)op]++;
+	else if (loadops[(int)op].ismove)
+		stats.moves++;
+	client->pending = -1;
+}
+
+static void le_packet(_LoadClient* client, unsigned char* data, int len)
+{
+	unsigned char head = ((_PMSG_HDR*)data)->h;
+	unsigned char sub = (len > (int)offsetof(_PMSG_DEF_SUB, sub)) ? data[offsetof(_PMSG_DEF_SUB, sub)] : 0xFF;
+
+	if (head == 0xF2 && sub == 0x09 && len >= (int)sizeof(_PMSG_LOGIN_RESULT)) {
+		_PMSG_LOGIN_RESULT* pMsg = (_PMSG_LOGIN_RESULT*)data;
+		int op = client->pending;
+		if (op == (int)_LoadOp::_LOGIN || op == (int)_LoadOp::_JOIN)
+			le_answer(client, (_LoadOp)op, false);
+
+		// 1 is the lobby, after a login or at the end of a round
+		if (pMsg->result == 1) {
+			if (client->isingame)
+				stats.games++;
+			client->isingame = false;
+			client->isturn = false;
+			le_think(client, _LoadStep::_JOIN);
+		}
+		return;
+	}
+
+	if (head == 0xF2 && sub == 0x00) {
+		stats.notices++;
+		return;
+	}
+
+	if (head == 0xF2 && sub == 0x04) {
+		if (client->pending < 0)
+			return;
+		_LoadOp op = (_LoadOp)client->pending;
+		le_answer(client, op, true);
+
+		// a refused move goes on with the next step, a refused drop with the next card
+		if (op == _LoadOp::_DRAW || op == _LoadOp::_FIGHT)
+			le_think(client, _LoadStep::_DOWN);
+		else if (op == _LoadOp::_DOWN)
+			le_think(client, _LoadStep::_SAPAW);
+		else if (op == _LoadOp::_SAPAW || op == _LoadOp::_DROP)
+			le_think(client, _LoadStep::_DROP);
+		return;
+	}
+
+	if (head == 0xF2 && sub == 0x06 && len >= (int)sizeof(_PMSG_INITINFO)) {
+		_PMSG_INITINFO* pMsg = (_PMSG_INITINFO*)data;
+		client->gamepos = pMsg->gamepos;
+		if (!client->isingame && client->jointick != 0)
+			stats.vWait.push_back((le_nowusec() - client->jointick) / 1000);
+		client->jointick = 0;
+		client->isingame = true;
+		client->isturn = false;
+		client->hasdown = false;
+		client->hand.clear();
+		for (int n = 0; n < 3; n++)
+			client->downs[n].clear();
+		return;
+	}
+
+	if (head == 0xF1 && sub == 0x00 && len >= (int)sizeof(_PMSG_SEND_INIT_CARDS)) {
+		_PMSG_SEND_INIT_CARDS* pMsg = (_PMSG_SEND_INIT_CARDS*)data;
+		client->hand.clear();
+		for (int n = 0; n < pMsg->data.cardcounts && n < LOADGEN_MAX_CARDS; n++)
+			client->hand.push_back({ pMsg->data.cardtype[n], pMsg->data.cardnum[n] });
+		return;
+	}
+
+	if (head == 0xF1 && sub == 0x02 && len >= (int)sizeof(_PMSG_ACTIVEINFO)) {
+		_PMSG_ACTIVEINFO* pMsg = (_PMSG_ACTIVEINFO*)data;
+		if (pMsg->activegamestate != LOADGEN_STARTED || pMsg->activeuserpos != client->gamepos) {
+			client->isturn = false;
+			return;
+		}
+		if (!client->isturn) {
+			client->isturn = true;
+			le_think(client, _LoadStep::_TURN);
+		}
+		return;
+	}
+
+	if (head != 0xF3)
+		return;
+
+	switch (sub) {
+	case 0x00:
+	{
+		if (len < (int)sizeof(_PMSG_DRAW_CARD_ANS))
+			return;
+		_PMSG_DRAW_CARD_ANS* pMsg = (_PMSG_DRAW_CARD_ANS*)data;
+		if (pMsg->userpos != client->gamepos || pMsg->cardtype == 0)
+			return;
+		client->hand.push_back({ pMsg->cardtype, pMsg->cardnum });
+
+		// the deal is done once the last card of the own hand arrived, the table waits for everyone
+		if (pMsg->init) {
+			if (client->hand.size() == 12 || client->hand.size() == LOADGEN_MAX_CARDS)
+				le_think(client, _LoadStep::_DRAWINIT);
+			return;
+		}
+		le_answer(client, _LoadOp::_DRAW, false);
+		le_think(client, _LoadStep::_DOWN);
+	}
+	break;
+
+	case 0x01:
+	{
+		if (len < (int)sizeof(_PMSG_DROP_CARD_ANS))
+			return;
+		_PMSG_DROP_CARD_ANS* pMsg = (_PMSG_DROP_CARD_ANS*)data;
+		if (pMsg->userpos != client->gamepos)
+			return;
+		le_removecard(client, pMsg->cardtype, pMsg->cardnum);
+		le_answer(client, _LoadOp::_DROP, false);
+		client->isturn = false;
+	}
+	break;
+
+	case 0x02:
+	case 0x03:
+	{
+		// a chow and a down both leave a new down on the table
+		int size = (sub == 0x02) ? (int)sizeof(_PMSG_CHOWCARD_ANS) : (int)sizeof(_PMSG_DOWNCARD_ANS);
+		if (len < size)
+			return;
+		unsigned char downpos, gamepos, count;
+		if (sub == 0x02) {
+			_PMSG_CHOWCARD_ANS* pMsg = (_PMSG_CHOWCARD_ANS*)data;
+			downpos = pMsg->downpos;
+			gamepos = pMsg->gamepos;
+			count = pMsg->count;
+		}
+		else {
+			_PMSG_DOWNCARD_ANS* pMsg = (_PMSG_DOWNCARD_ANS*)data;
+			downpos = pMsg->downpos;
+			gamepos = pMsg->gamepos;
+			count = pMsg->count;
+		}
+		if (gamepos >= 3 || len < size + count * (int)sizeof(_PMSG_CARD_INFO))
+			return;
+
+		std::vector<_LoadCard> down;
+		for (int n = 0; n < count; n++) {
+			_PMSG_CARD_INFO* card = (_PMSG_CARD_INFO*)(data + size + n * sizeof(_PMSG_CARD_INFO));
+			down.push_back({ card->cardtype, card->cardnum });
+			if (gamepos == client->gamepos)
+				le_removecard(client, card->cardtype, card->cardnum);
+		}
+		if (client->downs[gamepos].size() <= downpos)
+			client->downs[gamepos].resize(downpos + 1);
+		client->downs[gamepos][downpos] = down;
+
+		if (gamepos == client->gamepos && sub == 0x03) {
+			client->hasdown = true;
+			le_answer(client, _LoadOp::_DOWN, false);
+			le_think(client, _LoadStep::_SAPAW);
+		}
+	}
+	break;
+
+	case 0x04:
+	{
+		if (len < (int)(sizeof(_PMSG_SAPAWCARD_ANS) + sizeof(_PMSG_CARD_INFO)))
+			return;
+		_PMSG_SAPAWCARD_ANS* pMsg = (_PMSG_SAPAWCARD_ANS*)data;
+		_PMSG_CARD_INFO* card = (_PMSG_CARD_INFO*)(data + sizeof(_PMSG_SAPAWCARD_ANS));
+		if (pMsg->usergamepos < 3 && pMsg->downpos < client->downs[pMsg->usergamepos].size())
+			client->downs[pMsg->usergamepos][pMsg->downpos].push_back({ card->cardtype, card->cardnum });
+		if (pMsg->gamepos != client->gamepos)
+			return;
+		le_removecard(client, card->cardtype, card->cardnum);
+		le_answer(client, _LoadOp::_SAPAW, false);
+		le_think(client, _LoadStep::_SAPAW);
+	}
+	break;
+
+	case 0x07:
+	{
+		if (len < (int)sizeof(_PMSG_FIGHTCARD_ANS))
+			return;
+		_PMSG_FIGHTCARD_ANS* pMsg = (_PMSG_FIGHTCARD_ANS*)data;
+		client->isturn = false;
+		if (pMsg->userpos == client->gamepos)
+			le_answer(client, _LoadOp::_FIGHT, false);
+		else if (client->hasdown)
+			le_think(client, _LoadStep::_FIGHT2);
+	}
+	break;
+
+	case 0x08:
+	{
+		if (len < (int)sizeof(_PMSG_FIGHT2CARD_ANS))
+			return;
+		_PMSG_FIGHT2CARD_ANS* pMsg = (_PMSG_FIGHT2CARD_ANS*)data;
+		if (pMsg->userpos == client->gamepos)
+			le_answer(client, _LoadOp::_FIGHT2, false);
+	}
+	break;
+	}
+}
+
+static void le_report(bool isfinal)
+{
+	double seconds = (le_nowusec() - starttick) / 1e6;
+	int connected = 0, playing = 0;
+
+	for (size_t n = 0; n < vClients.size(); n++) {
+		if (vClients[n]->bev != NULL)
+			connected++;
+		if (vClients[n]->isingame)
+			playing++;
+	}
+
+	// the p99 of the answers since the last line, a drift of it shows where the total would bury it
+	printf("%6.0f s %6d connected %6d playing %8lld moves %8.1f moves/s %6lld games %6lld drops %6lld notices %8llu p99 us\n", seconds,
+		connected, playing, stats.moves, (seconds > 0) ? stats.moves / seconds : 0, stats.games, stats.disconnects, stats.notices,
+		le_percentile(stats.vWindow, 0.99));
+	stats.vWindow.clear();
+	fflush(stdout);
+
+	if (!isfinal)
+		return;
+
+	printf("\n%-8s %10s %10s %10s %10s\n", "request", "count", "refused", "p50 us", "p99 us");
+	for (int n = 0; n < (int)_LoadOp::_MAX; n++) {
+		printf("%-8s %10zu %10lld %10llu %10llu\n", loadops[n].name, stats.vLatency[n].size(), stats.refused[n],
+			le_percentile(stats.vLatency[n], 0.5), le_percentile(stats.vLatency[n], 0.99));
+	}
+	printf("\nmatchmaking wait, %zu tables joined, p50 %llu ms p99 %llu ms\n", stats.vWait.size(),
+		le_percentile(stats.vWait, 0.5), le_percentile(stats.vWait, 0.99));
+}
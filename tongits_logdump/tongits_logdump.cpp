@@ -0,0 +1,243 @@
+/** @file tongits_logdump.cpp
+	Renders the binary tongits event log (Log/tongits_YYYY-MM-DD.evt) as text or as one json object per line,
+	and the match history (Log/tongits_YYYY-MM-DD.hist) by hand, by player or as totals of the day.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "../tongits-server/eventlog.h"
+#include "../tongits-server/history.h"
+
+// the _ACTIONS values of tongits-server/game.h
+static const char* actionname(uint16_t action)
+{
+	switch (action) {
+	case 1: return "draw";
+	case 2: return "chow";
+	case 4: return "down";
+	case 8: return "drop";
+	case 16: return "sapaw";
+	case 32: return "fight";
+	case 64: return "fight2";
+	case 128: return "group";
+	case 256: return "ungroup";
+	case EVENT_START: return "start";
+	case EVENT_SETTLE: return "settle";
+	case EVENT_LOGIN: return "login";
+	case EVENT_ECOINS: return "ecoins";
+	case EVENT_END: return "end";
+	}
+	return "unknown";
+}
+
+static void printtext(const _EVENT_RECORD& rec)
+{
+	time_t t = (time_t)(rec.time / 1000);
+	struct tm lt;
+#ifdef _WIN32
+	localtime_s(&lt, &t);
+#else
+	localtime_r(&t, &lt);
+#endif
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &lt);
+
+	printf("%s.%03d serial %lld pos %d %s", stamp, (int)(rec.time % 1000), (long long)rec.serial, rec.userpos, actionname(rec.action));
+	if (EVENT_ISACCOUNT(rec.action))
+		printf(" %.*s", (int)rec.count, (const char*)rec.cards);
+	else {
+		for (int i = 0; i < rec.count && i < EVENT_MAX_CARDS; i++)
+			printf(" %d/%d", EVENT_CARDTYPE(rec.cards[i]), EVENT_CARDNUM(rec.cards[i]));
+	}
+	if (rec.action == EVENT_SETTLE || rec.action == EVENT_ECOINS)
+		printf(" %+d", rec.delta);
+	else if (rec.action == EVENT_LOGIN || rec.action == EVENT_END)
+		printf(" %d", rec.delta);
+	printf("\n");
+}
+
+static void printjson(const _EVENT_RECORD& rec)
+{
+	printf("{\"time\":%lld,\"serial\":%lld,\"pos\":%d,\"action\":\"%s\",",
+		(long long)rec.time, (long long)rec.serial, rec.userpos, actionname(rec.action));
+	if (EVENT_ISACCOUNT(rec.action)) {
+		printf("\"account\":\"%.*s\",\"delta\":%d}\n", (int)rec.count, (const char*)rec.cards, rec.delta);
+		return;
+	}
+	printf("\"cards\":[");
+	for (int i = 0; i < rec.count && i < EVENT_MAX_CARDS; i++)
+		printf("%s[%d,%d]", i ? "," : "", EVENT_CARDTYPE(rec.cards[i]), EVENT_CARDNUM(rec.cards[i]));
+	printf("],\"delta\":%d}\n", rec.delta);
+}
+
+static int dumpfile(const char* filename, bool isjson, long long serial)
+{
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: cannot open.\n", filename);
+		return 1;
+	}
+
+	_EVENT_HEADER hdr;
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || memcmp(hdr.magic, EVENT_MAGIC, sizeof(hdr.magic)) != 0) {
+		fprintf(stderr, "%s: not an event log.\n", filename);
+		fclose(fp);
+		return 1;
+	}
+
+	if (hdr.version != EVENT_VERSION || hdr.recordsize != sizeof(_EVENT_RECORD)) {
+		fprintf(stderr, "%s: unsupported version %d record size %d.\n", filename, hdr.version, hdr.recordsize);
+		fclose(fp);
+		return 1;
+	}
+
+	static _EVENT_RECORD records[4096];
+	size_t n;
+
+	while ((n = fread(records, sizeof(_EVENT_RECORD), sizeof(records) / sizeof(records[0]), fp)) > 0) {
+		for (size_t i = 0; i < n; i++) {
+			if (serial != -1 && records[i].serial != serial)
+				continue;
+			if (isjson)
+				printjson(records[i]);
+			else
+				printtext(records[i]);
+		}
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+static void printhand(const _SETTLE_INFO& info, bool isjson)
+{
+	if (isjson) {
+		printf("{\"time\":%lld,\"serial\":%lld,\"type\":%d,\"winner\":%d,\"tongits\":%d,\"total\":%d,\"hit\":%d,\"seats\":[",
+			(long long)info.time, (long long)info.serial, info.ectype, info.winnerpos, info.istongits, info.total, info.hitprize);
+		for (int i = 0; i < 3; i++) {
+			const _SETTLE_SEAT& seat = info.seats[i];
+			printf("%s{\"token\":%lld,\"before\":%d,\"delta\":%d,\"cards\":%d,\"fight\":%d,\"regular\":%d,\"quadra\":%d,\"royal\":%d,\"ace\":%d,\"burned\":%d}",
+				i ? "," : "", (long long)seat.token, seat.before, seat.delta, seat.cardcount, seat.fight, seat.regular, seat.quadra, seat.royal, seat.ace, seat.burned);
+		}
+		printf("]}\n");
+		return;
+	}
+
+	time_t t = (time_t)info.time;
+	struct tm lt;
+#ifdef _WIN32
+	localtime_s(&lt, &t);
+#else
+	localtime_r(&t, &lt);
+#endif
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &lt);
+
+	printf("%s serial %lld type %d winner %d tongits %d total %d hit %d", stamp, (long long)info.serial, info.ectype, info.winnerpos, info.istongits, info.total, info.hitprize);
+	for (int i = 0; i < 3; i++) {
+		const _SETTLE_SEAT& seat = info.seats[i];
+		printf(" | %lld %d %+d fight %d regular %d quadra %d royal %d ace %d burned %d",
+			(long long)seat.token, seat.before, seat.delta, seat.fight, seat.regular, seat.quadra, seat.royal, seat.ace, seat.burned);
+	}
+	printf("\n");
+}
+
+// every hand, the one of serial, the last count of token, or the totals of the day by bet mode
+static int dumphistory(const char* filename, bool isjson, long long serial, long long token, int count, bool istotals)
+{
+	_HISTORY_VIEW view;
+	std::vector<_SETTLE_INFO> hands;
+
+	if (!historyopen(filename, view)) {
+		fprintf(stderr, "%s: cannot open or empty.\n", filename);
+		return 1;
+	}
+	if (view.valid < view.size)
+		fprintf(stderr, "%s: %zu bytes past the last whole chunk.\n", filename, view.size - view.valid);
+
+	if (istotals) {
+		_HISTORY_TOTALS totals[2];
+		memset(totals, 0, sizeof(totals));
+		historytotals(view, totals, 2);
+		for (int ectype = 0; ectype < 2; ectype++) {
+			const _HISTORY_TOTALS& t = totals[ectype];
+			printf(isjson ? "{\"type\":%d,\"hands\":%lld,\"tongits\":%lld,\"pot\":%lld,\"hit\":%lld,\"regular\":%lld,\"fight\":%lld,\"quadra\":%lld,\"royal\":%lld,\"ace\":%lld,\"burned\":%lld}\n"
+				: "type %d hands %lld tongits %lld pot %lld hit %lld regular %lld fight %lld quadra %lld royal %lld ace %lld burned %lld\n",
+				ectype, (long long)t.hands, (long long)t.tongits, (long long)t.pot, (long long)t.hitprize, (long long)t.regular,
+				(long long)t.fight, (long long)t.quadra, (long long)t.royal, (long long)t.ace, (long long)t.burned);
+		}
+	}
+	else if (serial != -1) {
+		_SETTLE_INFO info;
+		if (historyserial(view, serial, info))
+			printhand(info, isjson);
+	}
+	else if (token != 0) {
+		historylast(view, token, count, hands);
+		for (size_t i = 0; i < hands.size(); i++)
+			printhand(hands[i], isjson);
+	}
+	else {
+		size_t at = 0;
+		while (historyread(view, at, hands) > 0) {
+			for (size_t i = 0; i < hands.size(); i++)
+				printhand(hands[i], isjson);
+		}
+	}
+
+	historyclose(view);
+	return 0;
+}
+
+static bool ishistory(const char* filename)
+{
+	size_t len = strlen(filename);
+	return len >= 5 && strcmp(filename + len - 5, ".hist") == 0;
+}
+
+int main(int argc, char** argv)
+{
+	bool isjson = false;
+	bool istotals = false;
+	long long serial = -1;
+	long long token = 0;
+	int count = HISTORY_MAX_GAMES;
+	int rc = 0;
+	int files = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0) {
+			isjson = true;
+		}
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			serial = atoll(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			token = atoll(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			count = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-d") == 0) {
+			istotals = true;
+		}
+		else {
+			if (ishistory(argv[i]))
+				rc |= dumphistory(argv[i], isjson, serial, token, count, istotals);
+			else
+				rc |= dumpfile(argv[i], isjson, serial);
+			files++;
+		}
+	}
+
+	if (files == 0) {
+		fprintf(stderr, "usage: tongits_logdump [-j] [-s serial] file.evt ...\n"
+			"       tongits_logdump [-j] [-s serial | -t token [-n count] | -d] file.hist ...\n");
+		return 1;
+	}
+
+	return rc;
+}
@@ -0,0 +1,333 @@
+/** @file tongits_sim.cpp
+	Headless simulator of tongits-server, tables of three bots play hand after hand on every core with the
+	game engine of the server and nothing behind it, to tune the payouts and the bots and to time the rules.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "../tongits-server/common.h"
+#include "../tongits-server/conf.h"
+#include "../tongits-server/game.h"
+#include "../tongits-server/gamesink.h"
+#include "../tongits-server/user.h"
+#include "../tongits-server/slabmem.h"
+#include "../tongits-server/bot.h"
+
+#define SIM_MAX_STEPS 100000	// runs of one hand before the table is taken for stuck and dealt again
+#define SIM_REPORT_MSEC 5000
+
+struct _SimConfig
+{
+	int threads;	// 0 for every core
+	int64_t hands;	// in all, 0 to play until the time is up, whichever comes first
+	int seconds;	// 0 to play until the hands are done
+	int gametype;
+	bool isrollout;	// only the bot of seat 0 weighs its drops, with the Bot Rollout Msec of conf.yaml
+};
+
+// the ledgers of the hands of one thread, added up when the threads are done
+struct _SimTotals
+{
+	int64_t hands;
+	int64_t tongits;
+	int64_t stuck;
+	int64_t pot;	// every loser paid, the hit prize included
+	int64_t fight;
+	int64_t regular;
+	int64_t quadra;
+	int64_t royal;
+	int64_t ace;
+	int64_t burned;
+	int64_t hitprize;
+	double hittax;
+	int64_t wins[MAX_USER_POS];	// by seat, seat 0 starts the first hand of a table
+	int64_t simmsec;	// of the clock of the tables
+};
+
+static _SimConfig config;
+static std::atomic<int64_t> handsplayed{ 0 };
+static std::atomic<bool> isstopping{ false };
+
+// the packets go nowhere, a hand only leaves its ledger behind
+class simsink : public gamesink
+{
+public:
+	simsink() { memset(&this->totals, 0, sizeof(this->totals)); }
+
+	bool send(intptr_t userindex, unsigned char* data, int len) override { return true; }
+	void sendall(const intptr_t* users, int count, unsigned char* data, int len) override {}
+	void notice(uintptr_t userindex, const _NOTICE& notice) override {}
+	void event(const _EVENT_RECORD& rec) override {}
+	void kick(uintptr_t userindex) override {}
+
+	void settled(game* g, const _SETTLE_INFO& settle) override
+	{
+		_SimTotals& t = this->totals;
+
+		t.hands++;
+		t.tongits += settle.istongits ? 1 : 0;
+		t.pot += settle.total;
+		t.hitprize += settle.hitprize;
+		t.hittax += settle.hittax;
+		t.wins[settle.winnerpos]++;
+
+		for (int i = 0; i < MAX_USER_POS; i++) {
+			const _SETTLE_SEAT& seat = settle.seats[i];
+			t.fight += seat.fight;
+			t.regular += seat.regular;
+			t.quadra += seat.quadra;
+			t.royal += seat.royal;
+			t.ace += seat.ace;
+			t.burned += seat.burned;
+		}
+	}
+
+	_SimTotals totals;
+};
+
+// a table of three bots on one thread, its clock jumps to the next deadline of the table instead of
+// waiting for it. the bots are taken from guser before the threads start, the slots are only read after
+class simtable
+{
+public:
+	simtable(int64_t serial);
+	~simtable();
+
+	void play();
+
+	simsink sink;
+	uintptr_t users[MAX_USER_POS];
+
+private:
+	void seat();
+	bool playhand();
+
+	game* g;
+};
+
+simtable::simtable(int64_t serial)
+{
+	this->g = new game();
+	this->g->setsink(&this->sink);
+	this->g->setgametype((unsigned char)config.gametype);
+	this->g->setgameserial(serial);
+
+	for (int i = 0; i < MAX_USER_POS; i++)
+		this->users[i] = guser.addbot((unsigned char)config.gametype);
+}
+
+simtable::~simtable()
+{
+	for (int i = 0; i < MAX_USER_POS; i++)
+		guser.delbot(this->users[i]);
+	delete this->g;
+}
+
+// what gamecontrol::seatgame does for a new table, with a bankroll a hand can not run out of
+void simtable::seat()
+{
+	game* g = this->g;
+
+	g->cleartable();
+	g->loadgameconf();
+
+	for (int i = 0; i < MAX_USER_POS; i++) {
+		_USER_INFO* userinfo = guser.getuser(this->users[i]);
+
+		userinfo->init();
+		userinfo->ecoins[config.gametype] = INT32_MAX / 2;
+		userinfo->m_gameserial = g->getgameserial();
+		userinfo->m_gamepos = i;
+		if (config.isrollout)
+			userinfo->isrollout = (i == 0);
+		userinfo->setstate((userinfo->m_state & ~(unsigned char)_USER_STATE::_WAITING) | (unsigned char)_USER_STATE::_PLAYING);
+		g->m_users[i] = this->users[i];
+	}
+
+	g->setstate(_GAME_STATE::_NOTICE);
+}
+
+// runs the table until a hand is settled, false when it closed or got stuck on the way
+bool simtable::playhand()
+{
+	game* g = this->g;
+	int hands = g->m_hands;
+
+	for (int n = 0; n < SIM_MAX_STEPS; n++) {
+		clockadvance(g->getnextdeadline());
+		g->run();
+
+		if (g->m_hands != hands)
+			return true;
+		if (g->getstate() == _GAME_STATE::_CLOSED || g->getstate() == _GAME_STATE::_ENDED)
+			return false;
+	}
+	return false;
+}
+
+void simtable::play()
+{
+	uint64_t start = clockmsec();
+	bool isseated = false;
+
+	while (!isstopping.load(std::memory_order_relaxed)) {
+
+		if (!isseated) {
+			this->seat();
+			isseated = true;
+		}
+		else {
+			// bots leave a table as soon as no player is left, here they play the next hand right away
+			for (int i = 0; i < MAX_USER_POS; i++)
+				guser.getuser(this->users[i])->ecoins[config.gametype] = INT32_MAX / 2;
+			this->g->dealhand();
+		}
+
+		if (!this->playhand()) {
+			this->sink.totals.stuck++;
+			isseated = false;
+			continue;
+		}
+
+		int64_t played = handsplayed.fetch_add(1, std::memory_order_relaxed) + 1;
+		if (config.hands > 0 && played >= config.hands)
+			isstopping = true;
+	}
+
+	this->sink.totals.simmsec = clockmsec() - start;
+}
+
+static void simprint(const _SimTotals& t, double sec, int threads)
+{
+	double hands = (t.hands > 0) ? (double)t.hands : 1.0;
+
+	printf("%lld hands on %d threads in %.1f sec, %.0f hands/sec, %.0f hands/min\n",
+		(long long)t.hands, threads, sec, t.hands / sec, t.hands / sec * 60);
+	printf("%.1f days of play at the pace of the bots, %lld tables got stuck and were dealt again\n",
+		t.simmsec / 86400000.0, (long long)t.stuck);
+	printf("tongits %.2f%%, wins by seat %.2f%% %.2f%% %.2f%%\n", t.tongits * 100.0 / hands,
+		t.wins[0] * 100.0 / hands, t.wins[1] * 100.0 / hands, t.wins[2] * 100.0 / hands);
+	printf("per hand, pot %.2f regular %.2f fight %.2f quadra %.2f royal %.2f ace %.2f burned %.2f\n",
+		t.pot / hands, t.regular / hands, t.fight / hands, t.quadra / hands, t.royal / hands, t.ace / hands, t.burned / hands);
+	printf("per hand, hit prize %.2f tax %.2f\n", t.hitprize / hands, t.hittax / hands);
+
+	const _BOT_ROLLOUT_STATS& rollouts = getbotrolloutstats();
+	if (rollouts.moves > 0) {
+		printf("%llu drops weighed with %llu rollouts, %.0f rollouts a drop, %.0f rollouts/sec per core\n",
+			(unsigned long long)rollouts.moves, (unsigned long long)rollouts.rollouts, (double)rollouts.rollouts / rollouts.moves,
+			rollouts.rollouts * 1000000.0 / std::max<uint64_t>(rollouts.usec, 1));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	config.threads = 0;
+	config.hands = 1000000;
+	config.seconds = 0;
+	config.gametype = 0;
+	config.isrollout = false;
+
+	for (int n = 1; n < argc; n++) {
+		std::string arg = argv[n];
+		const char* value = (n + 1 < argc) ? argv[n + 1] : NULL;
+
+		if (arg == "-r") {
+			config.isrollout = true;
+			continue;
+		}
+
+		if (value == NULL) {
+			printf("usage: tongits_sim [-t threads] [-n hands] [-d seconds] [-g gametype] [-r]\n");
+			return -1;
+		}
+
+		if (arg == "-t")
+			config.threads = atoi(value);
+		else if (arg == "-n")
+			config.hands = atoll(value);
+		else if (arg == "-d")
+			config.seconds = atoi(value);
+		else if (arg == "-g")
+			config.gametype = atoi(value);
+		n++;
+	}
+
+	if (config.threads <= 0)
+		config.threads = std::max((int)std::thread::hardware_concurrency(), 1);
+	if (config.gametype < 0 || config.gametype > 1) {
+		printf("gametype is 0 for eCoins or 1 for Jewels.\n");
+		return -1;
+	}
+
+	// the bet modes and the house rules of conf.yaml, only the errors of the engine are logged
+	logstart();
+	c.load();
+	slabmeminit(c.gethugepages());
+	botsearchinit();
+	LOGTYPEENABLED = (DWORD)eMSGTYPE::ERROR;
+	clockrefresh();
+
+	std::vector<simtable*> tables;
+	for (int n = 0; n < config.threads; n++) {
+		simtable* table = new simtable(n + 1);
+		if (table->users[0] == 0 || table->users[1] == 0 || table->users[2] == 0) {
+			printf("No user slot left for the bots of %d tables, Max Users is too low.\n", config.threads);
+			return -1;
+		}
+		tables.push_back(table);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (auto table : tables)
+		threads.emplace_back([table]() { table->play(); });
+
+	int64_t nextreport = SIM_REPORT_MSEC;
+	while (!isstopping) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		if (config.seconds > 0 && elapsed >= (int64_t)config.seconds * 1000)
+			isstopping = true;
+		if (elapsed >= nextreport) {
+			nextreport += SIM_REPORT_MSEC;
+			fprintf(stderr, "%lld hands\n", (long long)handsplayed.load());
+		}
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	_SimTotals totals;
+	memset(&totals, 0, sizeof(totals));
+	for (auto table : tables) {
+		const _SimTotals& t = table->sink.totals;
+		totals.hands += t.hands;
+		totals.tongits += t.tongits;
+		totals.stuck += t.stuck;
+		totals.pot += t.pot;
+		totals.fight += t.fight;
+		totals.regular += t.regular;
+		totals.quadra += t.quadra;
+		totals.royal += t.royal;
+		totals.ace += t.ace;
+		totals.burned += t.burned;
+		totals.hitprize += t.hitprize;
+		totals.hittax += t.hittax;
+		for (int i = 0; i < MAX_USER_POS; i++)
+			totals.wins[i] += t.wins[i];
+		totals.simmsec += t.simmsec;
+		delete table;
+	}
+
+	simprint(totals, sec, config.threads);
+	logstop();
+	return 0;
+}
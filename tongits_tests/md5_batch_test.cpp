@@ -0,0 +1,87 @@
+#include "md5.h"
+#include "md5_keyval.h"
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+
+// MD5::MD5_CheckValues against the digest of MD5::MD5_EncodeKeyVal, which runs MD5::transform. each
+// input sits once in every lane of a batch behind short fillers, with its own digest and with the
+// digest one bit off. the lengths around the block edge, 55 the last that fits a lane, the keys of
+// MD5_KEYVAL and the ones outside it, and random inputs. built once as the server has it and once with
+// MD5_BATCH_SCALAR, an arm build runs the neon lanes
+
+#define TEST_LANES 8	// the widest batch, avx2
+#define TEST_RANDOM 4096
+
+static int failures = 0;
+
+static std::string testinput(std::mt19937& rng, size_t len)
+{
+	std::string input(len, 'a');
+	for (size_t n = 0; n < len; n++)
+		input[n] = (char)(1 + rng() % 255);	// no NUL, the inputs are C strings
+	return input;
+}
+
+// the verdict of every lane for the digest and for each byte of it one bit off
+static void testcheck(const std::string& input, int keyindex)
+{
+	char digest[16] = { 0 };
+	MD5 md5;
+	md5.MD5_EncodeKeyVal((char*)input.c_str(), digest, keyindex);
+
+	for (int lane = 0; lane < TEST_LANES; lane++) {
+		for (int flip = -1; flip < 16; flip++) {
+			char keyval[16];
+			memcpy(keyval, digest, sizeof(keyval));
+			if (flip >= 0)
+				keyval[flip] ^= (char)(1 << (flip % 8));
+
+			// the fillers take the lanes before it, one more follows so the batch is never its alone
+			std::vector<const char*> inputs(lane + 2, "filler");
+			std::vector<const char*> keyvals(lane + 2, digest);
+			std::vector<int> keyindexes(lane + 2, 0);
+			bool results[TEST_LANES + 2];
+			inputs[lane] = input.c_str();
+			keyvals[lane] = keyval;
+			keyindexes[lane] = keyindex;
+
+			MD5::MD5_CheckValues((int)inputs.size(), inputs.data(), keyvals.data(), keyindexes.data(), results);
+
+			// a key outside the table leaves the digest zero in both forms
+			bool expected = (flip < 0);
+			if (results[lane] != expected) {
+				if (failures++ < 20)
+					printf("FAIL length %zu key %d lane %d flip %d, got %d\n", input.size(), keyindex, lane, flip, (int)results[lane]);
+			}
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(20261015);
+	const size_t edges[] = { 0, 1, 55, 56, 63, 64, 119 };
+	int checks = 0;
+
+	printf("md5 backend %s\n", MD5::MD5_Backend());
+
+	for (size_t len : edges) {
+		std::string input = testinput(rng, len);
+		for (int keyindex = 0; keyindex < MAX_KEY_INDEX; keyindex++, checks++)
+			testcheck(input, keyindex);
+	}
+
+	for (int keyindex : { -1, MAX_KEY_INDEX }) {
+		testcheck(testinput(rng, 8), keyindex);
+		checks++;
+	}
+
+	for (int n = 0; n < TEST_RANDOM; n++, checks++)
+		testcheck(testinput(rng, rng() % 120), (int)(rng() % MAX_KEY_INDEX));
+
+	printf("%d inputs, %d failures\n", checks, failures);
+	return (failures == 0) ? 0 : 1;
+}
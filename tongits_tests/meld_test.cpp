@@ -0,0 +1,68 @@
+#include "game.h"
+#include <stdio.h>
+
+// cardisset and cardisrun, which read gmeldtable, against the rules written out by hand. every hand
+// of 1 to 5 cards of the deck, a set is one number in 3 or 4 types, a run one type with the
+// numbers in a row
+
+static int failures = 0;
+
+static bool testisset(const int* cards, int count)
+{
+	for (int n = 1; n < count; n++) {
+		if (cards[n] % MAX_CARDS_PER_TYPE != cards[0] % MAX_CARDS_PER_TYPE)
+			return false;
+	}
+	return count >= 3 && count <= MAX_CARD_TYPE;	// the cards differ, so the types do
+}
+
+// the cards come in ascending order
+static bool testisrun(const int* cards, int count)
+{
+	for (int n = 1; n < count; n++) {
+		if (cards[n] / MAX_CARDS_PER_TYPE != cards[0] / MAX_CARDS_PER_TYPE || cards[n] != cards[n - 1] + 1)
+			return false;
+	}
+	return count >= 3;
+}
+
+static void testcheck(const int* cards, int count)
+{
+	_CARD_MASK mask = 0;
+	for (int n = 0; n < count; n++)
+		mask |= cardmask((unsigned char)(cards[n] / MAX_CARDS_PER_TYPE + 1), (unsigned char)(cards[n] % MAX_CARDS_PER_TYPE + 1));
+
+	bool isset = testisset(cards, count);
+	bool isrun = testisrun(cards, count);
+	if (cardisset(mask) != isset || cardisrun(mask) != isrun || cardismeld(mask) != (isset || isrun)) {
+		if (failures++ < 20)
+			printf("FAIL mask %016llx, set %d run %d\n", (unsigned long long)mask, (int)isset, (int)isrun);
+	}
+}
+
+// every ascending choice of count cards from pos on
+static int testhands(int* cards, int depth, int count, int pos)
+{
+	if (depth == count) {
+		testcheck(cards, count);
+		return 1;
+	}
+	int hands = 0;
+	for (int card = pos; card < MAX_DECK_CARDS; card++) {
+		cards[depth] = card;
+		hands += testhands(cards, depth + 1, count, card + 1);
+	}
+	return hands;
+}
+
+int main()
+{
+	int cards[5];
+	int hands = 0;
+
+	for (int count = 1; count <= 5; count++)
+		hands += testhands(cards, 0, count, 0);
+
+	printf("%d hands, %d failures\n", hands, failures);
+	return (failures == 0) ? 0 : 1;
+}
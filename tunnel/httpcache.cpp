@@ -0,0 +1,1178 @@
+#include "httpcache.h"
+
+#define HTTP_HEAD_MAX (64 * 1024)	// a longer request or response head is not parsed, the connection is relayed as is
+#define HTTP_HIGH_WATER (256 * 1024)	// a side stops reading while the other holds this much unsent
+
+struct _HttpClient;
+
+// a 200 response of the HTTP Cache, the head stays in memory and the body may move to the disk tier
+struct _HttpEntry
+{
+	std::string key;
+	std::string headers;	// end to end headers of the response, each line with its CRLF
+	std::string etag;
+	std::string lastmodified;
+	std::string body;	// empty while on disk
+	size_t size;	// body bytes
+	unsigned long long stored;	// usec it was received or last revalidated
+	unsigned long long lifetime;	// usec it stays fresh, 0 is revalidated on every request
+	unsigned long long file;	// number of its disk tier file, 0 while the body is in memory
+	std::list<_HttpEntry*>::iterator lru;
+};
+
+// the HTTP Cache of a tunnel and its clients, main loop only
+struct _HttpCache
+{
+	_HttpCache()
+	{
+		memorybytes = 0;
+		diskbytes = 0;
+		nextfile = 1;
+		unsigned int random[2];
+		evutil_secure_rng_get_bytes(random, sizeof(random));
+		snprintf(prefix, sizeof(prefix), "%08x%08x", random[0], random[1]);
+	}
+
+	std::map<std::string, _HttpEntry*> mEntries;	// keyed by host, target and Accept-Encoding
+	std::list<_HttpEntry*> lMemory;	// most recently used first
+	std::list<_HttpEntry*> lDisk;
+	size_t memorybytes;
+	size_t diskbytes;
+	unsigned long long nextfile;
+	char prefix[20];	// of its file names, a restarted tunnel or the process of an upgrade may share the directory
+	std::vector<_HttpClient*> vClients;
+};
+
+enum class _HTTP_STATE : unsigned char
+{
+	_REQUEST,	// waits for a request head, answered from the cache or sent on
+	_FORWARD,	// the request went to the local server, its response is read
+	_RELAY,	// not a request the cache handles, both sides are copied as they are from now on
+	_CLOSING	// the client output is flushed and then the client freed
+};
+
+// a client connection of a tunnel with HTTP Cache, requests are handled one at a time
+struct _HttpClient
+{
+	_TunnelsInfo* tunnelinfo;
+	struct bufferevent* bev;
+	struct bufferevent* origin;	// the local server, directly or over a link stream, NULL until a request needs it
+	_HTTP_STATE state;
+	size_t index;	// in the client list of the cache
+	std::string request;	// head sent to the origin, sent again on a new origin when the kept one closed unanswered
+	size_t requestleft;	// body bytes of the request still to send on
+	bool head;	// HEAD request, the response has no body
+	bool close;	// the client is closed after this response
+	bool retried;
+	std::string key;	// cache key of the request, empty when its response is not stored
+	std::string clientetag;	// If-None-Match of the client
+	bool revalidate;	// the request is conditional on the stale entry of key
+	bool responsehead;	// the response head is parsed
+	bool forward;	// the response goes to the client as it arrives, false for the 304 of a revalidation
+	bool originclose;	// the origin closes after the response
+	int status;
+	bool chunked;
+	bool untilclose;	// the body ends with the connection
+	int chunkstate;	// 0 size line, 1 data, 2 CRLF after the data, 3 trailer
+	long long bodyleft;	// Content-Length bytes or bytes of the current chunk still to read
+	bool storing;	// the body is kept for the cache
+	std::string storeheaders;
+	std::string storeetag;
+	std::string storelastmodified;
+	unsigned long long storelifetime;
+	bool storelifetimeset;	// the response had max-age or no-cache, a 304 takes it over
+	std::string storebody;
+};
+
+static void le_httpprocess(_HttpClient* client);
+static bool le_httporigin(_HttpClient* client);
+static void le_httprelay(_HttpClient* client);
+static void le_httpforward(_HttpClient* client);
+static bool le_httpserve(_HttpClient* client, _HttpEntry* entry);
+static void le_httpfail(_HttpClient* client);
+static void le_httpmove(_HttpClient* client, struct evbuffer* input, size_t len, bool body);
+static bool le_httpresponsehead(_HttpClient* client, struct evbuffer* input);
+static bool le_httpbody(_HttpClient* client, struct evbuffer* input);
+static void le_httpdone(_HttpClient* client);
+static void le_httpclosing(_HttpClient* client);
+static void le_httpfree(_HttpClient* client);
+static void le_httpreadcb(struct bufferevent*, void*);
+static void le_httpwritecb(struct bufferevent*, void*);
+static void le_httpeventcb(struct bufferevent*, short, void*);
+static void le_httporiginreadcb(struct bufferevent*, void*);
+static void le_httporiginwritecb(struct bufferevent*, void*);
+static void le_httporigineventcb(struct bufferevent*, short, void*);
+static _HttpEntry* le_cacheget(_HttpCache* cache, const std::string& key);
+static void le_cachestore(_TunnelsInfo* tunnelinfo, _HttpClient* client);
+static void le_cacheremove(_TunnelsInfo* tunnelinfo, _HttpEntry* entry);
+static void le_cachetrim(_TunnelsInfo* tunnelinfo);
+
+typedef std::vector<std::pair<std::string, std::string>> _HttpHeaders;
+
+// splits a head into its first line and its headers, false when it is not one
+static bool le_httpparse(const std::string& head, std::string& line, _HttpHeaders& vHeaders)
+{
+	size_t pos = head.find("\r\n");
+
+	if (pos == std::string::npos)
+		return false;
+	line = head.substr(0, pos);
+	pos += 2;
+
+	while (pos < head.size()) {
+		size_t end = head.find("\r\n", pos);
+		if (end == std::string::npos || end == pos)
+			break;
+
+		size_t colon = head.find(':', pos);
+		if (colon == std::string::npos || colon > end || colon == pos)
+			return false;
+
+		size_t value = colon + 1;
+		size_t valueend = end;
+		while (value < end && (head[value] == ' ' || head[value] == '\t'))
+			value++;
+		while (valueend > value && (head[valueend - 1] == ' ' || head[valueend - 1] == '\t'))
+			valueend--;
+
+		vHeaders.push_back(std::make_pair(head.substr(pos, colon - pos), head.substr(value, valueend - value)));
+		pos = end + 2;
+	}
+	return true;
+}
+
+static const std::string* le_httpheader(const _HttpHeaders& vHeaders, const char* name)
+{
+	for (size_t n = 0; n < vHeaders.size(); n++) {
+		if (evutil_ascii_strcasecmp(vHeaders[n].first.c_str(), name) == 0)
+			return &vHeaders[n].second;
+	}
+	return NULL;
+}
+
+// lower case copy of a header for token searches, empty when it is missing
+static std::string le_httplower(const std::string* value)
+{
+	std::string lower = (value != NULL) ? *value : std::string();
+
+	for (size_t n = 0; n < lower.size(); n++)
+		lower[n] = (char)tolower((unsigned char)lower[n]);
+	return lower;
+}
+
+// seconds of a Cache-Control directive like max-age=600, -1 when it is missing
+static long long le_httpdirective(const std::string& lower, const char* name)
+{
+	size_t pos = lower.find(name);
+
+	if (pos == std::string::npos)
+		return -1;
+	pos += strlen(name);
+	if (pos >= lower.size() || lower[pos] != '=')
+		return -1;
+	return atoll(lower.c_str() + pos + 1);
+}
+
+// If-None-Match of the client against the entry, weak tags compare like strong ones for GET
+static bool le_httpetagmatch(const std::string& list, const std::string& etag)
+{
+	std::string tag = (etag.compare(0, 2, "W/") == 0) ? etag.substr(2) : etag;
+	size_t pos = 0;
+
+	while (pos < list.size()) {
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+			end = list.size();
+
+		size_t first = list.find_first_not_of(" \t", pos);
+		size_t last = list.find_last_not_of(" \t", end - 1);
+		if (first != std::string::npos && first < end && last != std::string::npos && last >= first) {
+			std::string item = list.substr(first, last - first + 1);
+			if (item.compare(0, 2, "W/") == 0)
+				item = item.substr(2);
+			if (item == "*" || item == tag)
+				return true;
+		}
+		pos = end + 1;
+	}
+	return false;
+}
+
+static std::string le_cachepath(_TunnelsInfo* tunnelinfo, unsigned long long file)
+{
+	char name[64];
+
+	snprintf(name, sizeof(name), "/%s-%llu.cache", tunnelinfo->cache->prefix, file);
+	return std::string(tunnelinfo->httpdir) + name;
+}
+
+// what an entry holds of a tier, the head counts so empty bodies are bounded too
+static size_t le_cachecost(_HttpEntry* entry)
+{
+	return entry->size + entry->headers.size() + entry->key.size();
+}
+
+void le_httpaccept(_TunnelsInfo* tunnelinfo, evutil_socket_t fd)
+{
+	tunnelinfo->stats.accepted++;
+	le_setsockopts(fd, tunnelinfo->sockopts);
+
+	struct bufferevent* _bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE
+#ifdef _WIN32
+		| BEV_OPT_THREADSAFE
+#endif
+	);
+
+	if (!_bev) {
+		msglog(eMSGTYPE::ERROR, "%s bufferevent_socket_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		evutil_closesocket(fd);
+		return;
+	}
+
+	_HttpClient* client = new _HttpClient;
+	client->tunnelinfo = tunnelinfo;
+	client->bev = _bev;
+	client->origin = NULL;
+	client->state = _HTTP_STATE::_REQUEST;
+	client->requestleft = 0;
+	client->head = false;
+	client->close = false;
+	client->retried = false;
+	client->revalidate = false;
+	client->responsehead = false;
+	client->forward = true;
+	client->originclose = false;
+	client->status = 0;
+	client->chunked = false;
+	client->untilclose = false;
+	client->chunkstate = 0;
+	client->bodyleft = 0;
+	client->storing = false;
+	client->storelifetime = 0;
+	client->storelifetimeset = false;
+	client->index = tunnelinfo->cache->vClients.size();
+	tunnelinfo->cache->vClients.push_back(client);
+	tunnelinfo->stats.activepairs++;
+
+	if (tunnelinfo->readtimeout > 0 || tunnelinfo->writetimeout > 0) {
+		struct timeval readtv = { tunnelinfo->readtimeout, 0 };
+		struct timeval writetv = { tunnelinfo->writetimeout, 0 };
+		bufferevent_set_timeouts(_bev, tunnelinfo->readtimeout > 0 ? &readtv : NULL, tunnelinfo->writetimeout > 0 ? &writetv : NULL);
+	}
+
+	bufferevent_setwatermark(_bev, EV_WRITE, HTTP_HIGH_WATER / 2, 0);
+	bufferevent_setcb(_bev, le_httpreadcb, le_httpwritecb, le_httpeventcb, (void*)client);
+	bufferevent_enable(_bev, EV_READ | EV_WRITE);
+}
+
+// the local server of the client, kept across its requests until either side closes
+static bool le_httporigin(_HttpClient* client)
+{
+	_TunnelsInfo* tunnelinfo = client->tunnelinfo;
+	struct bufferevent* _bev = NULL;
+
+	if (client->origin != NULL)
+		return true;
+
+	if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN) {
+		// one end of a socket pair becomes a link stream like an accepted client
+		evutil_socket_t fds[2];
+#ifdef _WIN32
+		if (evutil_socketpair(AF_INET, SOCK_STREAM, 0, fds) != 0) {
+#else
+		if (evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+#endif
+			msglog(eMSGTYPE::ERROR, "%s evutil_socketpair failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+			tunnelinfo->stats.errors++;
+			return false;
+		}
+		evutil_make_socket_nonblocking(fds[0]);
+		evutil_make_socket_nonblocking(fds[1]);
+
+		if (!le_muxstream(tunnelinfo, fds[0], bufferevent_getfd(client->bev))) {
+			evutil_closesocket(fds[1]);
+			return false;
+		}
+
+		_bev = bufferevent_socket_new(base, fds[1], BEV_OPT_CLOSE_ON_FREE
+#ifdef _WIN32
+			| BEV_OPT_THREADSAFE
+#endif
+		);
+		if (!_bev) {
+			msglog(eMSGTYPE::ERROR, "%s bufferevent_socket_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+			evutil_closesocket(fds[1]);
+			return false;
+		}
+	}
+	else {
+		_bev = le_poolget(base, tunnelinfo);
+
+		if (_bev == NULL) {
+			struct sockaddr_storage ss;
+			int socklen;
+
+			if (le_getlocaladdr(tunnelinfo, &ss, &socklen))
+				_bev = le_connect(base, (struct sockaddr*)&ss, socklen, false, &tunnelinfo->sockopts);
+		}
+
+		if (_bev == NULL) {
+			msglog(eMSGTYPE::ERROR, "%s connect to local server %s failed, %s (%d).", tunnelinfo->name, tunnelinfo->local_serverip, __func__, __LINE__);
+			tunnelinfo->stats.errors++;
+			return false;
+		}
+
+		if (tunnelinfo->proxyprotocol) {
+			_MuxOpen open;
+			le_proxyaddrs(bufferevent_getfd(client->bev), &open);
+			le_proxyheader(_bev, &open);
+		}
+	}
+
+	client->origin = _bev;
+	bufferevent_setwatermark(_bev, EV_WRITE, HTTP_HIGH_WATER / 2, 0);
+	bufferevent_setcb(_bev, le_httporiginreadcb, le_httporiginwritecb, le_httporigineventcb, (void*)client);
+	bufferevent_enable(_bev, EV_READ | EV_WRITE);
+	return true;
+}
+
+// the local server can't be reached, the client is told so and closed
+static void le_httpfail(_HttpClient* client)
+{
+	static const char reply[] = "HTTP/1.1 502 Bad Gateway\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+	bufferevent_write(client->bev, reply, sizeof(reply) - 1);
+	le_httpclosing(client);
+}
+
+// reads the requests the client sent, as long as they are answered from the cache
+static void le_httpprocess(_HttpClient* client)
+{
+	_TunnelsInfo* tunnelinfo = client->tunnelinfo;
+	struct evbuffer* input = bufferevent_get_input(client->bev);
+
+	while (client->state == _HTTP_STATE::_REQUEST) {
+		size_t len = evbuffer_get_length(input);
+		if (len == 0)
+			return;
+
+		struct evbuffer_ptr end = evbuffer_search(input, "\r\n\r\n", 4, NULL);
+		if (end.pos == -1) {
+			if (len > HTTP_HEAD_MAX)
+				le_httprelay(client);
+			return;
+		}
+
+		size_t headlen = (size_t)end.pos + 4;
+		std::string head(headlen, '\0');
+		evbuffer_copyout(input, &head[0], headlen);
+
+		std::string line;
+		_HttpHeaders vHeaders;
+		size_t sp1 = std::string::npos, sp2 = std::string::npos;
+
+		if (le_httpparse(head, line, vHeaders)) {
+			sp1 = line.find(' ');
+			sp2 = line.rfind(' ');
+		}
+		if (sp1 == std::string::npos || sp2 == sp1 || line.compare(sp2 + 1, std::string::npos, "HTTP/1.1") != 0) {
+			le_httprelay(client);
+			return;
+		}
+
+		// only bodies of a known length are sent on between requests
+		const std::string* length = le_httpheader(vHeaders, "Content-Length");
+		if (le_httpheader(vHeaders, "Transfer-Encoding") != NULL || le_httpheader(vHeaders, "Upgrade") != NULL
+			|| le_httpheader(vHeaders, "Expect") != NULL
+			|| (length != NULL && (length->empty() || length->find_first_not_of("0123456789") != std::string::npos))) {
+			le_httprelay(client);
+			return;
+		}
+
+		std::string method = line.substr(0, sp1);
+		std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+		const std::string* host = le_httpheader(vHeaders, "Host");
+		std::string requestcc = le_httplower(le_httpheader(vHeaders, "Cache-Control"));
+		bool nocache = requestcc.find("no-cache") != std::string::npos || le_httplower(le_httpheader(vHeaders, "Pragma")).find("no-cache") != std::string::npos;
+
+		client->requestleft = (length != NULL) ? (size_t)strtoull(length->c_str(), NULL, 10) : 0;
+		client->retried = (client->requestleft > 0);
+		client->head = (method == "HEAD");
+		client->close = (le_httplower(le_httpheader(vHeaders, "Connection")).find("close") != std::string::npos);
+		client->key.clear();
+		client->clientetag.clear();
+		client->revalidate = false;
+
+		if (method != "GET" && method != "HEAD") {
+			// a change on the local server makes what the cache has of the target stale
+			if (host != NULL) {
+				std::string prefix = *host + " " + target + " ";
+				std::map<std::string, _HttpEntry*>::iterator iter = tunnelinfo->cache->mEntries.lower_bound(prefix);
+				while (iter != tunnelinfo->cache->mEntries.end() && iter->first.compare(0, prefix.size(), prefix) == 0) {
+					_HttpEntry* entry = iter->second;
+					iter++;
+					le_cacheremove(tunnelinfo, entry);
+				}
+			}
+		}
+		else if (host != NULL && client->requestleft == 0 && le_httpheader(vHeaders, "Authorization") == NULL
+			&& le_httpheader(vHeaders, "Range") == NULL && requestcc.find("no-store") == std::string::npos) {
+			const std::string* encoding = le_httpheader(vHeaders, "Accept-Encoding");
+			client->key = *host + " " + target + " " + (encoding != NULL ? *encoding : std::string());
+		}
+
+		if (!client->key.empty()) {
+			const std::string* clientetag = le_httpheader(vHeaders, "If-None-Match");
+			if (clientetag != NULL)
+				client->clientetag = *clientetag;
+
+			_HttpEntry* entry = le_cacheget(tunnelinfo->cache, client->key);
+			if (entry != NULL && !nocache && entry->stored + entry->lifetime > le_nowusec()) {
+				if (le_httpserve(client, entry)) {
+					tunnelinfo->stats.httphits++;
+					evbuffer_drain(input, headlen);
+					if (client->close)
+						le_httpclosing(client);
+					continue;
+				}
+				entry = NULL;
+			}
+
+			// sent without the validators of the client so the answer is one the cache can store
+			client->request = line + "\r\n";
+			for (size_t n = 0; n < vHeaders.size(); n++) {
+				if (evutil_ascii_strcasecmp(vHeaders[n].first.c_str(), "If-None-Match") == 0
+					|| evutil_ascii_strcasecmp(vHeaders[n].first.c_str(), "If-Modified-Since") == 0)
+					continue;
+				client->request += vHeaders[n].first + ": " + vHeaders[n].second + "\r\n";
+			}
+			if (entry != NULL && !entry->etag.empty())
+				client->request += "If-None-Match: " + entry->etag + "\r\n";
+			if (entry != NULL && !entry->lastmodified.empty())
+				client->request += "If-Modified-Since: " + entry->lastmodified + "\r\n";
+			client->request += "\r\n";
+
+			client->revalidate = (entry != NULL && (!entry->etag.empty() || !entry->lastmodified.empty()));
+			if (!client->revalidate)
+				tunnelinfo->stats.httpmisses++;
+		}
+		else
+			client->request = head;
+		evbuffer_drain(input, headlen);
+
+		client->state = _HTTP_STATE::_FORWARD;
+		client->responsehead = false;
+		client->storing = false;
+
+		if (!le_httporigin(client)) {
+			le_httpfail(client);
+			return;
+		}
+
+		tunnelinfo->stats.bytesin += client->request.size();
+		bufferevent_write(client->origin, client->request.data(), client->request.size());
+		le_httpforward(client);
+		return;
+	}
+}
+
+// the request body goes on as it arrives, further requests wait in the client input for the response
+static void le_httpforward(_HttpClient* client)
+{
+	struct evbuffer* input = bufferevent_get_input(client->bev);
+	struct evbuffer* output = bufferevent_get_output(client->origin);
+	size_t len = evbuffer_get_length(input);
+
+	if (len > client->requestleft)
+		len = client->requestleft;
+
+	if (len > 0) {
+		client->tunnelinfo->stats.bytesin += len;
+		evbuffer_remove_buffer(input, output, len);
+		client->requestleft -= len;
+	}
+
+	if (client->requestleft == 0 || evbuffer_get_length(output) >= HTTP_HIGH_WATER)
+		bufferevent_disable(client->bev, EV_READ);
+}
+
+// not a request the cache understands, the rest of the connection is copied as is
+static void le_httprelay(_HttpClient* client)
+{
+	if (!le_httporigin(client)) {
+		le_httpclosing(client);
+		return;
+	}
+
+	struct evbuffer* input = bufferevent_get_input(client->bev);
+
+	client->state = _HTTP_STATE::_RELAY;
+	client->tunnelinfo->stats.bytesin += evbuffer_get_length(input);
+	evbuffer_add_buffer(bufferevent_get_output(client->origin), input);
+
+	// a quiet side of an upgraded connection is not idle
+	bufferevent_set_timeouts(client->bev, NULL, NULL);
+	bufferevent_enable(client->bev, EV_READ);
+	bufferevent_enable(client->origin, EV_READ);
+}
+
+// answers the request from entry, false when its body is gone from the disk tier and the entry with it
+static bool le_httpserve(_HttpClient* client, _HttpEntry* entry)
+{
+	_TunnelsInfo* tunnelinfo = client->tunnelinfo;
+	_HttpCache* cache = tunnelinfo->cache;
+	struct evbuffer* output = bufferevent_get_output(client->bev);
+	size_t before = evbuffer_get_length(output);
+
+	if (entry->file != 0) {
+		std::string path = le_cachepath(tunnelinfo, entry->file);
+		FILE* fp = fopen(path.c_str(), "rb");
+		bool loaded = false;
+
+		entry->body.resize(entry->size);
+		if (fp != NULL) {
+			loaded = (fread(&entry->body[0], 1, entry->size, fp) == entry->size);
+			fclose(fp);
+		}
+
+		if (!loaded) {
+			msglog(eMSGTYPE::DEBUG, "%s HTTP Cache file %s is unreadable, %s (%d).", tunnelinfo->name, path.c_str(), __func__, __LINE__);
+			entry->body.clear();
+			le_cacheremove(tunnelinfo, entry);
+			return false;
+		}
+
+		// back in memory as the most recently used
+		remove(path.c_str());
+		cache->lDisk.erase(entry->lru);
+		cache->diskbytes -= le_cachecost(entry);
+		entry->file = 0;
+		cache->lMemory.push_front(entry);
+		entry->lru = cache->lMemory.begin();
+		cache->memorybytes += le_cachecost(entry);
+	}
+	else
+		cache->lMemory.splice(cache->lMemory.begin(), cache->lMemory, entry->lru);
+
+	unsigned long long age = (le_nowusec() - entry->stored) / 1000000;
+	const char* connection = client->close ? "Connection: close\r\n" : "";
+
+	if (!client->clientetag.empty() && !entry->etag.empty() && le_httpetagmatch(client->clientetag, entry->etag))
+		evbuffer_add_printf(output, "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nAge: %llu\r\n%s\r\n", entry->etag.c_str(), age, connection);
+	else {
+		evbuffer_add_printf(output, "HTTP/1.1 200 OK\r\n");
+		evbuffer_add(output, entry->headers.data(), entry->headers.size());
+		evbuffer_add_printf(output, "Content-Length: %llu\r\nAge: %llu\r\n%s\r\n", (unsigned long long)entry->size, age, connection);
+		if (!client->head) {
+			evbuffer_add(output, entry->body.data(), entry->size);
+			tunnelinfo->stats.httphitbytes += entry->size;
+		}
+	}
+	tunnelinfo->stats.bytesout += evbuffer_get_length(output) - before;
+
+	le_cachetrim(tunnelinfo);
+	return true;
+}
+
+// the status line and headers of the response, false until they are complete or when the client is no longer
+// waiting for a response
+static bool le_httpresponsehead(_HttpClient* client, struct evbuffer* input)
+{
+	_TunnelsInfo* tunnelinfo = client->tunnelinfo;
+	struct evbuffer* output = bufferevent_get_output(client->bev);
+
+	while (true) {
+		struct evbuffer_ptr end = evbuffer_search(input, "\r\n\r\n", 4, NULL);
+		if (end.pos == -1) {
+			if (evbuffer_get_length(input) > HTTP_HEAD_MAX) {
+				msglog(eMSGTYPE::DEBUG, "%s HTTP response head over %d bytes, client closed.", tunnelinfo->name, HTTP_HEAD_MAX);
+				le_httpclosing(client);
+			}
+			return false;
+		}
+
+		size_t headlen = (size_t)end.pos + 4;
+		std::string head(headlen, '\0');
+		evbuffer_copyout(input, &head[0], headlen);
+
+		std::string line;
+		_HttpHeaders vHeaders;
+		int status = 0;
+
+		if (le_httpparse(head, line, vHeaders) && line.compare(0, 5, "HTTP/") == 0 && line.size() >= 12)
+			status = atoi(line.c_str() + 9);
+		if (status < 100) {
+			msglog(eMSGTYPE::DEBUG, "%s HTTP response is not one, client closed.", tunnelinfo->name);
+			le_httpclosing(client);
+			return false;
+		}
+
+		// interim responses go to the client and the final one follows
+		if (status < 200 && status != 101) {
+			tunnelinfo->stats.bytesout += headlen;
+			evbuffer_remove_buffer(input, output, headlen);
+			continue;
+		}
+
+		client->status = status;
+		client->responsehead = true;
+
+		if (status == 101) {
+			tunnelinfo->stats.bytesout += headlen;
+			evbuffer_remove_buffer(input, output, headlen);
+			le_httprelay(client);
+			return false;
+		}
+
+		const std::string* length = le_httpheader(vHeaders, "Content-Length");
+		client->chunked = (le_httplower(le_httpheader(vHeaders, "Transfer-Encoding")).find("chunked") != std::string::npos);
+		client->untilclose = false;
+		client->chunkstate = 0;
+		client->bodyleft = 0;
+		if (client->head || status == 204 || status == 304)
+			client->chunked = false;
+		else if (!client->chunked && length != NULL)
+			client->bodyleft = atoll(length->c_str());
+		else if (!client->chunked)
+			client->untilclose = true;
+		client->originclose = client->untilclose || le_httplower(le_httpheader(vHeaders, "Connection")).find("close") != std::string::npos;
+
+		// the 304 of a revalidation refreshes the entry, any other answer replaces it
+		client->forward = !(client->revalidate && status == 304);
+		if (client->revalidate && status != 304) {
+			_HttpEntry* entry = le_cacheget(tunnelinfo->cache, client->key);
+			if (entry != NULL)
+				le_cacheremove(tunnelinfo, entry);
+			client->revalidate = false;
+			tunnelinfo->stats.httpmisses++;
+		}
+
+		std::string cc = le_httplower(le_httpheader(vHeaders, "Cache-Control"));
+		long long maxage = le_httpdirective(cc, "s-maxage");
+		if (maxage < 0)
+			maxage = le_httpdirective(cc, "max-age");
+		bool nocache = cc.find("no-cache") != std::string::npos || le_httplower(le_httpheader(vHeaders, "Pragma")).find("no-cache") != std::string::npos;
+		const std::string* etag = le_httpheader(vHeaders, "ETag");
+		const std::string* lastmodified = le_httpheader(vHeaders, "Last-Modified");
+
+		client->storelifetimeset = (maxage >= 0 || nocache);
+		client->storelifetime = (nocache || maxage < 0) ? 0 : (unsigned long long)maxage * 1000000;
+		client->storeetag = (etag != NULL) ? *etag : std::string();
+		client->storelastmodified = (lastmodified != NULL) ? *lastmodified : std::string();
+
+		// the key holds Accept-Encoding already, a response varying on more is not stored
+		std::string vary = le_httplower(le_httpheader(vHeaders, "Vary"));
+		bool varies = false;
+		for (size_t pos = 0; pos < vary.size();) {
+			size_t comma = vary.find(',', pos);
+			if (comma == std::string::npos)
+				comma = vary.size();
+			size_t first = vary.find_first_not_of(" \t", pos);
+			size_t last = vary.find_last_not_of(" \t", comma - 1);
+			if (first != std::string::npos && first < comma && last >= first && vary.compare(first, last - first + 1, "accept-encoding") != 0)
+				varies = true;
+			pos = comma + 1;
+		}
+
+		client->storing = !client->key.empty() && status == 200 && !client->head && !varies
+			&& cc.find("no-store") == std::string::npos && cc.find("private") == std::string::npos
+			&& le_httpheader(vHeaders, "Set-Cookie") == NULL
+			&& (maxage >= 0 || etag != NULL || lastmodified != NULL)
+			&& (client->chunked || client->untilclose || (size_t)client->bodyleft <= tunnelinfo->httpobject);
+
+		if (client->storing) {
+			client->storeheaders.clear();
+			client->storebody.clear();
+			for (size_t n = 0; n < vHeaders.size(); n++) {
+				const char* name = vHeaders[n].first.c_str();
+				if (evutil_ascii_strcasecmp(name, "Connection") == 0 || evutil_ascii_strcasecmp(name, "Keep-Alive") == 0
+					|| evutil_ascii_strcasecmp(name, "Proxy-Connection") == 0 || evutil_ascii_strcasecmp(name, "Transfer-Encoding") == 0
+					|| evutil_ascii_strcasecmp(name, "TE") == 0 || evutil_ascii_strcasecmp(name, "Trailer") == 0
+					|| evutil_ascii_strcasecmp(name, "Upgrade") == 0 || evutil_ascii_strcasecmp(name, "Content-Length") == 0
+					|| evutil_ascii_strcasecmp(name, "Age") == 0)
+					continue;
+				client->storeheaders += vHeaders[n].first + ": " + vHeaders[n].second + "\r\n";
+			}
+		}
+
+		if (client->forward) {
+			tunnelinfo->stats.bytesout += headlen;
+			evbuffer_remove_buffer(input, output, headlen);
+		}
+		else
+			evbuffer_drain(input, headlen);
+		return true;
+	}
+}
+
+// len bytes of the response, body bytes are also kept when the response is stored
+static void le_httpmove(_HttpClient* client, struct evbuffer* input, size_t len, bool body)
+{
+	if (body && client->storing) {
+		if (client->storebody.size() + len > client->tunnelinfo->httpobject) {
+			client->storing = false;
+			std::string().swap(client->storebody);
+		}
+		else {
+			size_t size = client->storebody.size();
+			client->storebody.resize(size + len);
+			evbuffer_copyout(input, &client->storebody[size], len);
+		}
+	}
+
+	if (client->forward) {
+		client->tunnelinfo->stats.bytesout += len;
+		evbuffer_remove_buffer(input, bufferevent_get_output(client->bev), len);
+	}
+	else
+		evbuffer_drain(input, len);
+}
+
+// moves the body as it arrives, true once it is complete, a body until close ends in le_httporigineventcb
+static bool le_httpbody(_HttpClient* client, struct evbuffer* input)
+{
+	if (client->untilclose) {
+		le_httpmove(client, input, evbuffer_get_length(input), true);
+		return false;
+	}
+
+	if (!client->chunked) {
+		size_t len = evbuffer_get_length(input);
+		if ((long long)len > client->bodyleft)
+			len = (size_t)client->bodyleft;
+		le_httpmove(client, input, len, true);
+		client->bodyleft -= len;
+		return (client->bodyleft == 0);
+	}
+
+	while (true) {
+		size_t eollen = 0;
+		struct evbuffer_ptr eol;
+
+		switch (client->chunkstate) {
+		case 0:
+		case 3:
+			eol = evbuffer_search_eol(input, NULL, &eollen, EVBUFFER_EOL_CRLF);
+			if (eol.pos == -1) {
+				if (evbuffer_get_length(input) > HTTP_HEAD_MAX)
+					le_httpclosing(client);
+				return false;
+			}
+
+			if (client->chunkstate == 3) {
+				// trailer lines up to an empty one
+				le_httpmove(client, input, (size_t)eol.pos + eollen, false);
+				if (eol.pos == 0)
+					return true;
+				break;
+			}
+
+			{
+				char line[32] = { 0 };
+				evbuffer_copyout(input, line, (size_t)eol.pos < sizeof(line) - 1 ? (size_t)eol.pos : sizeof(line) - 1);
+				client->bodyleft = strtoll(line, NULL, 16);
+			}
+			le_httpmove(client, input, (size_t)eol.pos + eollen, false);
+			client->chunkstate = (client->bodyleft > 0) ? 1 : 3;
+			break;
+		case 1:
+			{
+				size_t len = evbuffer_get_length(input);
+				if ((long long)len > client->bodyleft)
+					len = (size_t)client->bodyleft;
+				if (len == 0)
+					return false;
+				le_httpmove(client, input, len, true);
+				client->bodyleft -= len;
+				if (client->bodyleft > 0)
+					return false;
+				client->chunkstate = 2;
+			}
+			break;
+		default:
+			if (evbuffer_get_length(input) < 2)
+				return false;
+			le_httpmove(client, input, 2, false);
+			client->chunkstate = 0;
+			break;
+		}
+	}
+}
+
+// the response is complete, the next request of the client is read
+static void le_httpdone(_HttpClient* client)
+{
+	_TunnelsInfo* tunnelinfo = client->tunnelinfo;
+
+	if (client->storing) {
+		le_cachestore(tunnelinfo, client);
+		client->storing = false;
+	}
+
+	// the client was told the connection closes
+	if (client->forward && client->originclose)
+		client->close = true;
+
+	if (client->originclose && client->origin != NULL) {
+		bufferevent_free(client->origin);
+		client->origin = NULL;
+	}
+
+	if (!client->forward) {
+		_HttpEntry* entry = le_cacheget(tunnelinfo->cache, client->key);
+
+		// pushed out by other clients while this one revalidated, it has nothing to answer with
+		if (entry == NULL) {
+			le_httpclosing(client);
+			return;
+		}
+
+		entry->stored = le_nowusec();
+		if (client->storelifetimeset)
+			entry->lifetime = client->storelifetime;
+		tunnelinfo->stats.httprevalidated++;
+
+		if (!le_httpserve(client, entry)) {
+			le_httpclosing(client);
+			return;
+		}
+	}
+
+	if (client->close) {
+		le_httpclosing(client);
+		return;
+	}
+
+	client->state = _HTTP_STATE::_REQUEST;
+	bufferevent_enable(client->bev, EV_READ);
+	le_httpprocess(client);
+}
+
+// the origin goes at once, the client once its output is flushed. it is freed from le_httpwritecb even when the
+// output is empty already, so the callers up the stack can still look at its state
+static void le_httpclosing(_HttpClient* client)
+{
+	client->state = _HTTP_STATE::_CLOSING;
+
+	if (client->origin != NULL) {
+		bufferevent_free(client->origin);
+		client->origin = NULL;
+	}
+
+	bufferevent_disable(client->bev, EV_READ);
+	bufferevent_setwatermark(client->bev, EV_WRITE, 0, 0);
+	if (evbuffer_get_length(bufferevent_get_output(client->bev)) == 0)
+		bufferevent_trigger(client->bev, EV_WRITE, BEV_TRIG_IGNORE_WATERMARKS | BEV_TRIG_DEFER_CALLBACKS);
+}
+
+static void le_httpfree(_HttpClient* client)
+{
+	_TunnelsInfo* tunnelinfo = client->tunnelinfo;
+	std::vector<_HttpClient*>& vClients = tunnelinfo->cache->vClients;
+
+	vClients[client->index] = vClients.back();
+	vClients[client->index]->index = client->index;
+	vClients.pop_back();
+
+	if (client->origin != NULL)
+		bufferevent_free(client->origin);
+	bufferevent_free(client->bev);
+	tunnelinfo->stats.activepairs--;
+	delete client;
+}
+
+static void le_httpreadcb(struct bufferevent* bev, void* arg)
+{
+	_HttpClient* client = (_HttpClient*)arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+
+	switch (client->state) {
+	case _HTTP_STATE::_REQUEST:
+		le_httpprocess(client);
+		break;
+	case _HTTP_STATE::_FORWARD:
+		le_httpforward(client);
+		break;
+	case _HTTP_STATE::_RELAY:
+		client->tunnelinfo->stats.bytesin += evbuffer_get_length(input);
+		evbuffer_add_buffer(bufferevent_get_output(client->origin), input);
+		if (evbuffer_get_length(bufferevent_get_output(client->origin)) >= HTTP_HIGH_WATER)
+			bufferevent_disable(bev, EV_READ);
+		break;
+	default:
+		evbuffer_drain(input, evbuffer_get_length(input));
+		break;
+	}
+}
+
+static void le_httpwritecb(struct bufferevent* bev, void* arg)
+{
+	_HttpClient* client = (_HttpClient*)arg;
+
+	if (client->state == _HTTP_STATE::_CLOSING) {
+		if (evbuffer_get_length(bufferevent_get_output(bev)) == 0)
+			le_httpfree(client);
+		return;
+	}
+
+	if (client->origin != NULL)
+		bufferevent_enable(client->origin, EV_READ);
+}
+
+static void le_httpeventcb(struct bufferevent* bev, short events, void* arg)
+{
+	_HttpClient* client = (_HttpClient*)arg;
+
+	// a client done sending after its request still gets the response
+	if ((events & BEV_EVENT_EOF) && client->state == _HTTP_STATE::_FORWARD && client->requestleft == 0) {
+		client->close = true;
+		bufferevent_disable(bev, EV_READ);
+		return;
+	}
+
+	le_httpfree(client);
+}
+
+static void le_httporiginreadcb(struct bufferevent* bev, void* arg)
+{
+	_HttpClient* client = (_HttpClient*)arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+	struct evbuffer* output = bufferevent_get_output(client->bev);
+
+	if (client->state == _HTTP_STATE::_FORWARD) {
+		if (!client->responsehead && !le_httpresponsehead(client, input) && client->state != _HTTP_STATE::_RELAY)
+			return;
+
+		if (client->state == _HTTP_STATE::_FORWARD) {
+			if (le_httpbody(client, input)) {
+				le_httpdone(client);
+				return;
+			}
+			if (client->state != _HTTP_STATE::_FORWARD)
+				return;
+		}
+	}
+
+	if (client->state == _HTTP_STATE::_RELAY) {
+		client->tunnelinfo->stats.bytesout += evbuffer_get_length(input);
+		evbuffer_add_buffer(output, input);
+	}
+	// a local server talking out of turn is not listened to
+	else if (client->state != _HTTP_STATE::_FORWARD) {
+		evbuffer_drain(input, evbuffer_get_length(input));
+		return;
+	}
+
+	if (evbuffer_get_length(output) >= HTTP_HIGH_WATER)
+		bufferevent_disable(bev, EV_READ);
+}
+
+static void le_httporiginwritecb(struct bufferevent* bev, void* arg)
+{
+	_HttpClient* client = (_HttpClient*)arg;
+
+	if (client->state == _HTTP_STATE::_RELAY || (client->state == _HTTP_STATE::_FORWARD && client->requestleft > 0))
+		bufferevent_enable(client->bev, EV_READ);
+}
+
+static void le_httporigineventcb(struct bufferevent* bev, short events, void* arg)
+{
+	_HttpClient* client = (_HttpClient*)arg;
+
+	if (events & BEV_EVENT_CONNECTED)
+		return;
+
+	bufferevent_free(client->origin);
+	client->origin = NULL;
+
+	switch (client->state) {
+	case _HTTP_STATE::_FORWARD:
+		if (client->responsehead && client->untilclose) {
+			le_httpdone(client);
+			break;
+		}
+
+		// a kept connection the local server closed as the request went out, it is sent again on a new one
+		if (!client->responsehead && !client->retried) {
+			client->retried = true;
+			if (!le_httporigin(client)) {
+				le_httpfail(client);
+				break;
+			}
+			bufferevent_write(client->origin, client->request.data(), client->request.size());
+			break;
+		}
+
+		if (!client->responsehead)
+			le_httpfail(client);
+		else
+			le_httpclosing(client);
+		break;
+	case _HTTP_STATE::_RELAY:
+		le_httpclosing(client);
+		break;
+	default:
+		break;
+	}
+}
+
+static _HttpEntry* le_cacheget(_HttpCache* cache, const std::string& key)
+{
+	std::map<std::string, _HttpEntry*>::iterator iter = cache->mEntries.find(key);
+
+	return (iter != cache->mEntries.end()) ? iter->second : NULL;
+}
+
+// the response client read becomes the entry of its key
+static void le_cachestore(_TunnelsInfo* tunnelinfo, _HttpClient* client)
+{
+	_HttpCache* cache = tunnelinfo->cache;
+	_HttpEntry* entry = le_cacheget(cache, client->key);
+
+	if (entry != NULL)
+		le_cacheremove(tunnelinfo, entry);
+	if (tunnelinfo->retired)
+		return;
+
+	entry = new _HttpEntry;
+	entry->key = client->key;
+	entry->headers.swap(client->storeheaders);
+	entry->etag = client->storeetag;
+	entry->lastmodified = client->storelastmodified;
+	entry->body.swap(client->storebody);
+	entry->size = entry->body.size();
+	entry->stored = le_nowusec();
+	entry->lifetime = client->storelifetime;
+	entry->file = 0;
+
+	cache->lMemory.push_front(entry);
+	entry->lru = cache->lMemory.begin();
+	cache->memorybytes += le_cachecost(entry);
+	cache->mEntries[entry->key] = entry;
+
+	le_cachetrim(tunnelinfo);
+}
+
+static void le_cacheremove(_TunnelsInfo* tunnelinfo, _HttpEntry* entry)
+{
+	_HttpCache* cache = tunnelinfo->cache;
+
+	cache->mEntries.erase(entry->key);
+
+	if (entry->file != 0) {
+		remove(le_cachepath(tunnelinfo, entry->file).c_str());
+		cache->lDisk.erase(entry->lru);
+		cache->diskbytes -= le_cachecost(entry);
+	}
+	else {
+		cache->lMemory.erase(entry->lru);
+		cache->memorybytes -= le_cachecost(entry);
+	}
+	delete entry;
+}
+
+// least recently used bodies go from memory to the disk tier and from there out of the cache
+static void le_cachetrim(_TunnelsInfo* tunnelinfo)
+{
+	_HttpCache* cache = tunnelinfo->cache;
+
+	while (cache->memorybytes > tunnelinfo->httpmemory && !cache->lMemory.empty()) {
+		_HttpEntry* entry = cache->lMemory.back();
+		bool written = false;
+
+		if (tunnelinfo->httpdir[0] != 0 && le_cachecost(entry) <= tunnelinfo->httpdisk) {
+			unsigned long long file = cache->nextfile++;
+			std::string path = le_cachepath(tunnelinfo, file);
+			FILE* fp = fopen(path.c_str(), "wb");
+
+			if (fp != NULL) {
+				written = (fwrite(entry->body.data(), 1, entry->size, fp) == entry->size);
+				written = (fclose(fp) == 0) && written;
+				if (!written)
+					remove(path.c_str());
+			}
+
+			if (written) {
+				cache->lMemory.pop_back();
+				cache->memorybytes -= le_cachecost(entry);
+				std::string().swap(entry->body);
+				entry->file = file;
+				cache->lDisk.push_front(entry);
+				entry->lru = cache->lDisk.begin();
+				cache->diskbytes += le_cachecost(entry);
+			}
+			else
+				msglog(eMSGTYPE::DEBUG, "%s HTTP Cache file %s is not writable, %s (%d).", tunnelinfo->name, path.c_str(), __func__, __LINE__);
+		}
+
+		if (!written)
+			le_cacheremove(tunnelinfo, entry);
+	}
+
+	while (cache->diskbytes > tunnelinfo->httpdisk && !cache->lDisk.empty())
+		le_cacheremove(tunnelinfo, cache->lDisk.back());
+}
+
+// at exit, the files of the disk tier are removed with their entries
+void le_httpstop(_TunnelsInfo* tunnelinfo)
+{
+	_HttpCache* cache = tunnelinfo->cache;
+
+	if (cache == NULL)
+		return;
+
+	while (cache->vClients.size() > 0)
+		le_httpfree(cache->vClients.back());
+	while (cache->mEntries.size() > 0)
+		le_cacheremove(tunnelinfo, cache->mEntries.begin()->second);
+
+	delete cache;
+	tunnelinfo->cache = NULL;
+}
+
+void le_httpstart(_TunnelsInfo* tunnelinfo)
+{
+	tunnelinfo->cache = new _HttpCache;
+	msglog(eMSGTYPE::INFO, "%s HTTP Cache keeps %llu bytes in memory%s%s.", tunnelinfo->name, (unsigned long long)tunnelinfo->httpmemory,
+		tunnelinfo->httpdir[0] != 0 ? " and more in " : "", tunnelinfo->httpdir);
+}
+
+void le_cacheclear(_TunnelsInfo* tunnelinfo)
+{
+	if (tunnelinfo->cache == NULL)
+		return;
+	while (tunnelinfo->cache->mEntries.size() > 0)
+		le_cacheremove(tunnelinfo, tunnelinfo->cache->mEntries.begin()->second);
+}
+
+void le_httpmetrics(struct evbuffer* reply)
+{
+	evbuffer_add_printf(reply, "# HELP tunnel_http_cache_requests_total Cacheable requests by what answered them, hit and revalidated came from the cache.\n# TYPE tunnel_http_cache_requests_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->cache == NULL)
+			continue;
+		evbuffer_add_printf(reply, "tunnel_http_cache_requests_total{tunnel=\"%s\",result=\"hit\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.httphits);
+		evbuffer_add_printf(reply, "tunnel_http_cache_requests_total{tunnel=\"%s\",result=\"revalidated\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.httprevalidated);
+		evbuffer_add_printf(reply, "tunnel_http_cache_requests_total{tunnel=\"%s\",result=\"miss\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.httpmisses);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_http_cache_hit_bytes_total Body bytes sent from the cache instead of the local server.\n# TYPE tunnel_http_cache_hit_bytes_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->cache != NULL)
+			evbuffer_add_printf(reply, "tunnel_http_cache_hit_bytes_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.httphitbytes);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_http_cache_bytes Bytes of the cached responses by tier.\n# TYPE tunnel_http_cache_bytes gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->cache == NULL)
+			continue;
+		evbuffer_add_printf(reply, "tunnel_http_cache_bytes{tunnel=\"%s\",tier=\"memory\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->cache->memorybytes);
+		evbuffer_add_printf(reply, "tunnel_http_cache_bytes{tunnel=\"%s\",tier=\"disk\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->cache->diskbytes);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_http_cache_entries Responses in the cache.\n# TYPE tunnel_http_cache_entries gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->cache != NULL)
+			evbuffer_add_printf(reply, "tunnel_http_cache_entries{tunnel=\"%s\"} %d\n", vTunnels[n]->name, (int)vTunnels[n]->cache->mEntries.size());
+	}
+}
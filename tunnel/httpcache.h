@@ -0,0 +1,16 @@
+#ifndef HTTPCACHE_H
+#define HTTPCACHE_H
+
+#include "tunnel.h"
+
+// HTTP Cache, clients of the proxy port are read as HTTP/1.1 one request at a time. a GET of a response the local
+// server marked cacheable is answered from memory or the disk tier while fresh and revalidated with its validators
+// once stale, everything else is sent on. an upgrade or a body of unknown length turns the connection into a relay
+
+void le_httpstart(_TunnelsInfo* tunnelinfo);	// the cache of a tunnel with HTTP Cache, main loop only
+void le_httpaccept(_TunnelsInfo* tunnelinfo, evutil_socket_t fd);	// a client of its proxy port
+void le_cacheclear(_TunnelsInfo* tunnelinfo);	// drops the responses, the clients keep going
+void le_httpstop(_TunnelsInfo* tunnelinfo);	// frees the clients and the cache
+void le_httpmetrics(struct evbuffer* reply);	// the tunnel_http_cache_ families of every tunnel with a cache
+
+#endif
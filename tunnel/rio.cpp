@@ -0,0 +1,747 @@
+#include "rio.h"
+
+#ifdef _WIN32
+struct _RioPair;
+
+#define RIO_BUF_SIZE 16384
+#define RIO_BUF_COUNT 1024	// slices of the registered region of one worker
+#define RIO_QUEUE_DEPTH 8	// sends outstanding per socket, the rest wait in the pair
+#define RIO_CQ_SIZE 4096	// grown when the pairs of a worker would not fit
+#define RIO_MAX_RESULTS 256
+#define RIO_ACCEPTS 16	// AcceptEx kept posted per tunnel
+
+enum class _RIO_OP
+{
+	_RECV0,
+	_RECV1,
+	_SEND0,
+	_SEND1,
+};
+
+// completion keys of a worker's port
+enum class _RIO_KEY
+{
+	_CQ = 1,
+	_ACCEPT,
+	_ADOPT,
+	_CONNECT,
+	_STOP,
+};
+
+// one per core, a thread waiting on its own completion port. the RIO completion queue, AcceptEx and
+// ConnectEx all complete there, receives and sends use slices of one registered buffer region
+struct _RioWorker
+{
+	_RioWorker()
+	{
+		index = 0;
+		iocp = NULL;
+		cq = RIO_INVALID_CQ;
+		cqsize = 0;
+		reserved = 0;
+		bufs = NULL;
+		bufid = RIO_INVALID_BUFFERID;
+		accepts = 0;
+		stopping = false;
+		connections = 0;
+		memset(&cqov, 0, sizeof(cqov));
+	}
+
+	int index;
+	HANDLE iocp;
+	std::thread thread;
+	RIO_CQ cq;
+	DWORD cqsize;
+	DWORD reserved;	// entries the request queues of the pairs may fill
+	OVERLAPPED cqov;
+	char* bufs;
+	RIO_BUFFERID bufid;
+	std::vector<int> vFree;	// slices not holding received bytes
+	std::vector<std::pair<_RioPair*, int>> vStarved;	// receives not posted for want of a slice
+	std::vector<_RioPair*> vPairs;
+	std::vector<std::pair<_RioPair*, int>> vCommit;	// request queues with deferred sends, committed once per batch
+	int accepts;	// AcceptEx outstanding on this port
+	bool stopping;
+	std::atomic<int> connections;
+};
+
+struct _RioAccept
+{
+	OVERLAPPED ov;
+	_TunnelsInfo* tunnelinfo;
+	SOCKET fd;
+	char addrs[2 * (sizeof(struct sockaddr_storage) + 16)];
+};
+
+struct _RioChunk
+{
+	int slot;
+	ULONG len;
+};
+
+// relay pair forwarded through registered I/O, dir 0 is client to local server
+struct _RioPair
+{
+	_RioPair()
+	{
+		memset(&connectov, 0, sizeof(connectov));
+		worker = NULL;
+		tunnelinfo = NULL;
+		connectstart = 0;
+		activetick = 0;
+		inflight = 0;
+		connected = false;
+		closing = false;
+		index = 0;
+		for (int n = 0; n < 2; n++) {
+			fd[n] = INVALID_SOCKET;
+			rq[n] = RIO_INVALID_RQ;
+			eof[n] = false;
+			recving[n] = false;
+			sending[n] = 0;
+			sendtick[n] = 0;
+			commit[n] = false;
+		}
+	}
+
+	OVERLAPPED connectov;	// the port hands it back for the pair
+	_RioWorker* worker;
+	_TunnelsInfo* tunnelinfo;
+	unsigned long long connectstart;
+	unsigned long long activetick;
+	SOCKET fd[2];
+	RIO_RQ rq[2];	// rq[n] receives from fd[n] and sends to it
+	bool eof[2];
+	bool recving[2];
+	int sending[2];	// sends of a direction outstanding
+	unsigned long long sendtick[2];
+	bool commit[2];	// rq[n] is in vCommit
+	std::deque<_RioChunk> queue[2];	// received, sent or waiting to be, in order
+	int inflight;	// requests and the connect the system still holds, the pair is freed at 0 once closing
+	bool connected;
+	bool closing;
+	size_t index;	// in vPairs of its worker
+};
+
+static RIO_EXTENSION_FUNCTION_TABLE rio;
+static LPFN_ACCEPTEX rioacceptex = NULL;
+static LPFN_CONNECTEX rioconnectex = NULL;
+static std::vector<_RioWorker*> vRioWorkers;
+static size_t rionext = 0;
+
+static bool le_rioinit();
+static void le_rioloop(_RioWorker* worker);
+static bool le_rioaccept(_TunnelsInfo* tunnelinfo);
+static void le_rioaccepted(_RioAccept* accept, bool success);
+static void le_riostart(_RioWorker* worker, _TunnelsInfo* tunnelinfo, SOCKET fd);
+static void le_rioconnected(_RioPair* pair, bool success);
+static void le_riocomplete(_RioWorker* worker, const RIORESULT* result);
+static void le_riorecv(_RioPair* pair, int dir);
+static void le_riosend(_RioPair* pair, int dir);
+static void le_riotimeouts(_RioWorker* worker);
+static void le_rioclose(_RioPair* pair);
+static void le_riopairfree(_RioPair* pair);
+
+// the RIO table and the AcceptEx and ConnectEx pointers, and one worker per core on first use
+static bool le_rioinit()
+{
+	if (vRioWorkers.size() > 0)
+		return true;
+
+	SOCKET s = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+	if (s == INVALID_SOCKET)
+		return false;
+
+	GUID rioid = WSAID_MULTIPLE_RIO;
+	GUID acceptid = WSAID_ACCEPTEX;
+	GUID connectid = WSAID_CONNECTEX;
+	DWORD bytes = 0;
+
+	memset(&rio, 0, sizeof(rio));
+	rio.cbSize = sizeof(rio);
+	bool loaded = WSAIoctl(s, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &rioid, sizeof(rioid), &rio, sizeof(rio), &bytes, NULL, NULL) == 0
+		&& WSAIoctl(s, SIO_GET_EXTENSION_FUNCTION_POINTER, &acceptid, sizeof(acceptid), &rioacceptex, sizeof(rioacceptex), &bytes, NULL, NULL) == 0
+		&& WSAIoctl(s, SIO_GET_EXTENSION_FUNCTION_POINTER, &connectid, sizeof(connectid), &rioconnectex, sizeof(rioconnectex), &bytes, NULL, NULL) == 0;
+	closesocket(s);
+	if (!loaded)
+		return false;
+
+	unsigned int cpus = std::thread::hardware_concurrency();
+	if (cpus == 0)
+		cpus = 1;
+
+	for (unsigned int n = 0; n < cpus; n++) {
+		_RioWorker* worker = new _RioWorker;
+		worker->index = (int)n;
+		worker->iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+
+		RIO_NOTIFICATION_COMPLETION notify;
+		memset(&notify, 0, sizeof(notify));
+		notify.Type = RIO_IOCP_COMPLETION;
+		notify.Iocp.IocpHandle = worker->iocp;
+		notify.Iocp.CompletionKey = (PVOID)(ULONG_PTR)_RIO_KEY::_CQ;
+		notify.Iocp.Overlapped = &worker->cqov;
+
+		size_t bufsize = (size_t)RIO_BUF_COUNT * RIO_BUF_SIZE;
+		if (worker->iocp != NULL) {
+			worker->cqsize = RIO_CQ_SIZE;
+			worker->cq = rio.RIOCreateCompletionQueue(worker->cqsize, &notify);
+			worker->bufs = (char*)VirtualAlloc(NULL, bufsize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		}
+		if (worker->bufs != NULL)
+			worker->bufid = rio.RIORegisterBuffer(worker->bufs, (DWORD)bufsize);
+
+		if (worker->iocp == NULL || worker->cq == RIO_INVALID_CQ || worker->bufid == RIO_INVALID_BUFFERID) {
+			msglog(eMSGTYPE::ERROR, "registered I/O setup failed for worker %d (%d), %s (%d).", n, (int)GetLastError(), __func__, __LINE__);
+			if (worker->bufid != RIO_INVALID_BUFFERID)
+				rio.RIODeregisterBuffer(worker->bufid);
+			if (worker->bufs)
+				VirtualFree(worker->bufs, 0, MEM_RELEASE);
+			if (worker->cq != RIO_INVALID_CQ)
+				rio.RIOCloseCompletionQueue(worker->cq);
+			if (worker->iocp)
+				CloseHandle(worker->iocp);
+			delete worker;
+			le_riostop();
+			return false;
+		}
+
+		for (int slot = RIO_BUF_COUNT - 1; slot >= 0; slot--)
+			worker->vFree.push_back(slot);
+		rio.RIONotify(worker->cq);
+
+		worker->thread = std::thread([worker]() {
+			le_rioloop(worker);
+		});
+		if (cpus > 1)
+			SetThreadAffinityMask(worker->thread.native_handle(), (DWORD_PTR)1 << (n % cpus));
+
+		vRioWorkers.push_back(worker);
+	}
+
+	msglog(eMSGTYPE::INFO, "Started %d registered I/O workers.", (int)vRioWorkers.size());
+	return true;
+}
+
+// the tunnel's own listener, the accepted sockets have to be created for registered I/O
+bool le_riolisten(_TunnelsInfo* tunnelinfo, const struct sockaddr* sa, int socklen)
+{
+	if (!le_rioinit()) {
+		msglog(eMSGTYPE::INFO, "%s Registered I/O is not available, relaying through IOCP.", tunnelinfo->name);
+		return false;
+	}
+
+	SOCKET fd = WSASocket(sa->sa_family, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+	if (fd == INVALID_SOCKET)
+		return false;
+
+	BOOL on = TRUE;
+	setsockopt(fd, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, (const char*)&on, sizeof(on));
+	le_setsockopts(fd, tunnelinfo->sockopts);
+
+	if (bind(fd, sa, socklen) != 0 || listen(fd, SOMAXCONN) != 0
+		|| CreateIoCompletionPort((HANDLE)fd, vRioWorkers[0]->iocp, (ULONG_PTR)_RIO_KEY::_ACCEPT, 0) == NULL) {
+		msglog(eMSGTYPE::ERROR, "%s registered I/O listen failed (%d), %s (%d).", tunnelinfo->name, WSAGetLastError(), __func__, __LINE__);
+		closesocket(fd);
+		return false;
+	}
+
+	tunnelinfo->riolistener = fd;
+	for (int n = 0; n < RIO_ACCEPTS; n++) {
+		if (!le_rioaccept(tunnelinfo))
+			break;
+	}
+
+	msglog(eMSGTYPE::DEBUG, "%s Proxy Server relays through registered I/O.", tunnelinfo->name);
+	return true;
+}
+
+static bool le_rioaccept(_TunnelsInfo* tunnelinfo)
+{
+	_RioAccept* accept = new _RioAccept;
+	memset(&accept->ov, 0, sizeof(accept->ov));
+	accept->tunnelinfo = tunnelinfo;
+
+	struct sockaddr_storage ss;
+	int sslen = sizeof(ss);
+	getsockname(tunnelinfo->riolistener, (struct sockaddr*)&ss, &sslen);
+
+	accept->fd = WSASocket(ss.ss_family, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+	if (accept->fd == INVALID_SOCKET) {
+		delete accept;
+		return false;
+	}
+
+	DWORD bytes = 0;
+	if (!rioacceptex(tunnelinfo->riolistener, accept->fd, accept->addrs, 0, sizeof(struct sockaddr_storage) + 16,
+		sizeof(struct sockaddr_storage) + 16, &bytes, &accept->ov) && WSAGetLastError() != ERROR_IO_PENDING) {
+		closesocket(accept->fd);
+		delete accept;
+		return false;
+	}
+
+	vRioWorkers[0]->accepts++;
+	return true;
+}
+
+// on worker 0, the socket goes to the worker that will relay it
+static void le_rioaccepted(_RioAccept* accept, bool success)
+{
+	_TunnelsInfo* tunnelinfo = accept->tunnelinfo;
+
+	vRioWorkers[0]->accepts--;
+	if (!success || vRioWorkers[0]->stopping) {
+		closesocket(accept->fd);
+		delete accept;
+		if (!vRioWorkers[0]->stopping && tunnelinfo->riolistener != INVALID_SOCKET)
+			le_rioaccept(tunnelinfo);
+		return;
+	}
+
+	le_rioaccept(tunnelinfo);
+
+	setsockopt(accept->fd, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, (const char*)&tunnelinfo->riolistener, sizeof(tunnelinfo->riolistener));
+	tunnelinfo->stats.accepted++;
+	le_setsockopts(accept->fd, tunnelinfo->sockopts);
+
+	_RioWorker* worker = vRioWorkers[(rionext++) % vRioWorkers.size()];
+	if (workerdispatch == _DISPATCH_TYPE::_LEAST_CONNECTIONS) {
+		worker = vRioWorkers[0];
+		for (size_t n = 1; n < vRioWorkers.size(); n++) {
+			if (vRioWorkers[n]->connections < worker->connections)
+				worker = vRioWorkers[n];
+		}
+	}
+	worker->connections++;
+
+	if (!PostQueuedCompletionStatus(worker->iocp, 0, (ULONG_PTR)_RIO_KEY::_ADOPT, &accept->ov)) {
+		worker->connections--;
+		closesocket(accept->fd);
+		delete accept;
+	}
+}
+
+static void le_rioloop(_RioWorker* worker)
+{
+	RIORESULT results[RIO_MAX_RESULTS];
+	unsigned long long timeouttick = GetTickCount64() + 1000;
+
+	while (true) {
+		DWORD bytes = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* ov = NULL;
+		BOOL success = GetQueuedCompletionStatus(worker->iocp, &bytes, &key, &ov, 1000);
+
+		if (ov != NULL || success) {
+			switch ((_RIO_KEY)key) {
+			case _RIO_KEY::_CQ:
+				while (true) {
+					ULONG count = rio.RIODequeueCompletion(worker->cq, results, RIO_MAX_RESULTS);
+					if (count == 0 || count == RIO_CORRUPT_CQ)
+						break;
+					for (ULONG n = 0; n < count; n++)
+						le_riocomplete(worker, &results[n]);
+				}
+				rio.RIONotify(worker->cq);
+				break;
+			case _RIO_KEY::_ACCEPT:
+				le_rioaccepted(CONTAINING_RECORD(ov, _RioAccept, ov), success == TRUE);
+				break;
+			case _RIO_KEY::_ADOPT: {
+				_RioAccept* accept = CONTAINING_RECORD(ov, _RioAccept, ov);
+				if (worker->stopping) {
+					worker->connections--;
+					closesocket(accept->fd);
+				}
+				else
+					le_riostart(worker, accept->tunnelinfo, accept->fd);
+				delete accept;
+				break;
+			}
+			case _RIO_KEY::_CONNECT:
+				le_rioconnected(CONTAINING_RECORD(ov, _RioPair, connectov), success == TRUE);
+				break;
+			case _RIO_KEY::_STOP:
+				// everything still open is closed, the thread ends once the system handed back what it held
+				worker->stopping = true;
+				for (size_t n = worker->vPairs.size(); n > 0; n--)
+					le_rioclose(worker->vPairs[n - 1]);
+				break;
+			}
+		}
+
+		// deferred sends go to the network once per batch of completions
+		for (size_t n = 0; n < worker->vCommit.size(); n++) {
+			_RioPair* pair = worker->vCommit[n].first;
+			int sink = worker->vCommit[n].second;
+			rio.RIOSend(pair->rq[sink], NULL, 0, RIO_MSG_COMMIT_ONLY, NULL);
+			pair->commit[sink] = false;
+		}
+		worker->vCommit.clear();
+
+		if (GetTickCount64() >= timeouttick) {
+			timeouttick = GetTickCount64() + 1000;
+			le_riotimeouts(worker);
+		}
+
+		if (worker->stopping && worker->vPairs.empty() && worker->accepts == 0)
+			break;
+	}
+}
+
+static void le_riostart(_RioWorker* worker, _TunnelsInfo* tunnelinfo, SOCKET fd)
+{
+	_RioPair* pair = new _RioPair;
+	pair->worker = worker;
+	pair->tunnelinfo = tunnelinfo;
+	pair->fd[0] = fd;
+	pair->index = worker->vPairs.size();
+	pair->activetick = GetTickCount64();
+	worker->vPairs.push_back(pair);
+	tunnelinfo->stats.activepairs++;
+
+	unsigned int clienthash = 0;
+	if (tunnelinfo->balance == _BALANCE_TYPE::_CLIENT_HASH) {
+		struct sockaddr_storage ss;
+		int sslen = sizeof(ss);
+		if (getpeername(fd, (struct sockaddr*)&ss, &sslen) == 0)
+			clienthash = le_clienthash((struct sockaddr*)&ss);
+	}
+
+	struct sockaddr_storage remote_address;
+	int socklen;
+	if (!le_getlocaladdr(tunnelinfo, &remote_address, &socklen, clienthash)) {
+		le_rioclose(pair);
+		return;
+	}
+
+	// ConnectEx needs a bound socket
+	struct sockaddr_storage local;
+	memset(&local, 0, sizeof(local));
+	local.ss_family = remote_address.ss_family;
+
+	pair->fd[1] = WSASocket(remote_address.ss_family, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+	if (pair->fd[1] == INVALID_SOCKET || bind(pair->fd[1], (struct sockaddr*)&local, socklen) != 0
+		|| CreateIoCompletionPort((HANDLE)pair->fd[1], worker->iocp, (ULONG_PTR)_RIO_KEY::_CONNECT, 0) == NULL) {
+		msglog(eMSGTYPE::ERROR, "%s socket setup failed (%d), %s (%d).", tunnelinfo->name, WSAGetLastError(), __func__, __LINE__);
+		tunnelinfo->stats.errors++;
+		le_rioclose(pair);
+		return;
+	}
+	le_setsockopts(pair->fd[1], tunnelinfo->sockopts);
+
+	pair->connectstart = le_nowusec();
+	if (!rioconnectex(pair->fd[1], (struct sockaddr*)&remote_address, socklen, NULL, 0, NULL, &pair->connectov)
+		&& WSAGetLastError() != ERROR_IO_PENDING) {
+		msglog(eMSGTYPE::ERROR, "%s connect failed (%d), %s (%d).", tunnelinfo->name, WSAGetLastError(), __func__, __LINE__);
+		tunnelinfo->stats.errors++;
+		le_rioclose(pair);
+		return;
+	}
+	pair->inflight++;
+
+	msglog(eMSGTYPE::DEBUG, "%s Client connection accepted, registered I/O mode...", tunnelinfo->name);
+}
+
+static void le_rioconnected(_RioPair* pair, bool success)
+{
+	_RioWorker* worker = pair->worker;
+
+	pair->inflight--;
+	if (pair->closing) {
+		if (pair->inflight == 0)
+			le_riopairfree(pair);
+		return;
+	}
+
+	if (!success) {
+		msglog(eMSGTYPE::ERROR, "%s connect to local server failed, %s (%d).", pair->tunnelinfo->name, __func__, __LINE__);
+		pair->tunnelinfo->stats.errors++;
+		le_rioclose(pair);
+		return;
+	}
+
+	setsockopt(pair->fd[1], SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, NULL, 0);
+	le_statsconnected(pair->tunnelinfo, pair->connectstart);
+
+	// every pair may fill its share of the completion queue, it grows before it could overflow
+	DWORD need = 2 * (1 + RIO_QUEUE_DEPTH);
+	if (worker->reserved + need > worker->cqsize) {
+		DWORD cqsize = worker->cqsize * 2;
+		if (!rio.RIOResizeCompletionQueue(worker->cq, cqsize)) {
+			msglog(eMSGTYPE::ERROR, "%s RIOResizeCompletionQueue failed (%d), %s (%d).", pair->tunnelinfo->name, WSAGetLastError(), __func__, __LINE__);
+			le_rioclose(pair);
+			return;
+		}
+		worker->cqsize = cqsize;
+	}
+
+	for (int n = 0; n < 2; n++) {
+		pair->rq[n] = rio.RIOCreateRequestQueue(pair->fd[n], 1, 1, RIO_QUEUE_DEPTH, 1, worker->cq, worker->cq, (PVOID)pair);
+		if (pair->rq[n] == RIO_INVALID_RQ) {
+			msglog(eMSGTYPE::ERROR, "%s RIOCreateRequestQueue failed (%d), %s (%d).", pair->tunnelinfo->name, WSAGetLastError(), __func__, __LINE__);
+			le_rioclose(pair);
+			return;
+		}
+	}
+	worker->reserved += need;
+	pair->connected = true;
+	pair->activetick = GetTickCount64();
+
+	le_riorecv(pair, 0);
+	le_riorecv(pair, 1);
+}
+
+// one receive per direction into a free slice, a starved one is posted again when a slice comes back
+static void le_riorecv(_RioPair* pair, int dir)
+{
+	_RioWorker* worker = pair->worker;
+
+	if (pair->closing || pair->eof[dir] || pair->recving[dir])
+		return;
+
+	if (worker->vFree.empty()) {
+		worker->vStarved.push_back(std::make_pair(pair, dir));
+		return;
+	}
+
+	int slot = worker->vFree.back();
+	RIO_BUF buf;
+	buf.BufferId = worker->bufid;
+	buf.Offset = (ULONG)slot * RIO_BUF_SIZE;
+	buf.Length = RIO_BUF_SIZE;
+
+	if (!rio.RIOReceive(pair->rq[dir], &buf, 1, 0, (PVOID)(((ULONG_PTR)slot << 2) | (ULONG_PTR)((dir == 0) ? _RIO_OP::_RECV0 : _RIO_OP::_RECV1)))) {
+		msglog(eMSGTYPE::ERROR, "%s RIOReceive failed (%d), %s (%d).", pair->tunnelinfo->name, WSAGetLastError(), __func__, __LINE__);
+		le_rioclose(pair);
+		return;
+	}
+
+	worker->vFree.pop_back();
+	pair->recving[dir] = true;
+	pair->inflight++;
+}
+
+// the chunks of a direction not yet posted, up to RIO_QUEUE_DEPTH outstanding, committed with the batch
+static void le_riosend(_RioPair* pair, int dir)
+{
+	_RioWorker* worker = pair->worker;
+	int sink = 1 - dir;
+
+	while (!pair->closing && pair->sending[dir] < RIO_QUEUE_DEPTH && (size_t)pair->sending[dir] < pair->queue[dir].size()) {
+		const _RioChunk& chunk = pair->queue[dir][pair->sending[dir]];
+		RIO_BUF buf;
+		buf.BufferId = worker->bufid;
+		buf.Offset = (ULONG)chunk.slot * RIO_BUF_SIZE;
+		buf.Length = chunk.len;
+
+		if (!rio.RIOSend(pair->rq[sink], &buf, 1, RIO_MSG_DEFER, (PVOID)(((ULONG_PTR)chunk.slot << 2) | (ULONG_PTR)((dir == 0) ? _RIO_OP::_SEND0 : _RIO_OP::_SEND1)))) {
+			msglog(eMSGTYPE::ERROR, "%s RIOSend failed (%d), %s (%d).", pair->tunnelinfo->name, WSAGetLastError(), __func__, __LINE__);
+			le_rioclose(pair);
+			return;
+		}
+
+		if (pair->sending[dir] == 0)
+			pair->sendtick[dir] = GetTickCount64();
+		pair->sending[dir]++;
+		pair->inflight++;
+		if (!pair->commit[sink]) {
+			pair->commit[sink] = true;
+			worker->vCommit.push_back(std::make_pair(pair, sink));
+		}
+	}
+}
+
+// a slice is free again, the oldest starved receive takes it
+static void le_riorecycle(_RioWorker* worker, int slot)
+{
+	worker->vFree.push_back(slot);
+
+	if (!worker->vStarved.empty()) {
+		std::pair<_RioPair*, int> starved = worker->vStarved.front();
+		worker->vStarved.erase(worker->vStarved.begin());
+		le_riorecv(starved.first, starved.second);
+	}
+}
+
+// both directions are done once each source hit eof and its bytes are out
+static void le_riodrained(_RioPair* pair, int dir)
+{
+	if (!pair->eof[dir] || !pair->queue[dir].empty())
+		return;
+
+	shutdown(pair->fd[1 - dir], SD_SEND);
+	if (pair->eof[1 - dir] && pair->queue[1 - dir].empty())
+		le_rioclose(pair);
+}
+
+static void le_riocomplete(_RioWorker* worker, const RIORESULT* result)
+{
+	_RioPair* pair = (_RioPair*)(ULONG_PTR)result->SocketContext;
+	_RIO_OP op = (_RIO_OP)(result->RequestContext & 3);
+	int slot = (int)(result->RequestContext >> 2);
+
+	pair->inflight--;
+
+	if (op == _RIO_OP::_RECV0 || op == _RIO_OP::_RECV1) {
+		int dir = (op == _RIO_OP::_RECV0) ? 0 : 1;
+		pair->recving[dir] = false;
+
+		if (pair->closing)
+			le_riorecycle(worker, slot);
+		else if (result->Status != 0) {
+			le_riorecycle(worker, slot);
+			msglog(eMSGTYPE::DEBUG, "Proxy disconnected.");
+			le_rioclose(pair);
+		}
+		else if (result->BytesTransferred == 0) {
+			le_riorecycle(worker, slot);
+			pair->eof[dir] = true;
+			le_riodrained(pair, dir);
+		}
+		else {
+			_RioChunk chunk;
+			chunk.slot = slot;
+			chunk.len = result->BytesTransferred;
+			pair->queue[dir].push_back(chunk);
+			pair->activetick = GetTickCount64();
+			le_riosend(pair, dir);
+			le_riorecv(pair, dir);
+		}
+	}
+	else {
+		int dir = (op == _RIO_OP::_SEND0) ? 0 : 1;
+		_RioChunk chunk = pair->queue[dir].front();
+		pair->queue[dir].pop_front();
+		pair->sending[dir]--;
+		le_riorecycle(worker, chunk.slot);
+
+		if (pair->closing)
+			;
+		else if (result->Status != 0 || result->BytesTransferred < chunk.len) {
+			pair->tunnelinfo->stats.errors++;
+			le_rioclose(pair);
+		}
+		else {
+			if (dir == 0)
+				pair->tunnelinfo->stats.bytesin += chunk.len;
+			else
+				pair->tunnelinfo->stats.bytesout += chunk.len;
+			pair->sendtick[dir] = GetTickCount64();
+			le_riosend(pair, dir);
+			le_riodrained(pair, dir);
+		}
+	}
+
+	if (pair->closing && pair->inflight == 0)
+		le_riopairfree(pair);
+}
+
+static void le_riotimeouts(_RioWorker* worker)
+{
+	unsigned long long now = GetTickCount64();
+
+	for (size_t n = worker->vPairs.size(); n > 0; n--) {
+		_RioPair* pair = worker->vPairs[n - 1];
+		_TunnelsInfo* tunnelinfo = pair->tunnelinfo;
+
+		if (pair->closing)
+			continue;
+
+		if (tunnelinfo->readtimeout > 0 && now - pair->activetick >= (unsigned long long)tunnelinfo->readtimeout * 1000)
+			msglog(eMSGTYPE::DEBUG, "%s Proxy idle timeout.", tunnelinfo->name);
+		else if (tunnelinfo->writetimeout > 0 && ((pair->sending[0] > 0 && now - pair->sendtick[0] >= (unsigned long long)tunnelinfo->writetimeout * 1000)
+			|| (pair->sending[1] > 0 && now - pair->sendtick[1] >= (unsigned long long)tunnelinfo->writetimeout * 1000)))
+			msglog(eMSGTYPE::DEBUG, "%s Proxy write timeout.", tunnelinfo->name);
+		else
+			continue;
+
+		le_rioclose(pair);
+	}
+}
+
+// closing the sockets aborts what the system still holds, the pair goes with the last of those completions
+static void le_rioclose(_RioPair* pair)
+{
+	_RioWorker* worker = pair->worker;
+
+	if (pair->closing)
+		return;
+	pair->closing = true;
+
+	worker->connections--;
+	pair->tunnelinfo->stats.activepairs--;
+	if (pair->connected)
+		worker->reserved -= 2 * (1 + RIO_QUEUE_DEPTH);
+
+	for (size_t n = 0; n < worker->vStarved.size();) {
+		if (worker->vStarved[n].first == pair)
+			worker->vStarved.erase(worker->vStarved.begin() + n);
+		else
+			n++;
+	}
+
+	// a deferred send still to be committed belongs to a queue that is going away
+	for (size_t n = 0; n < worker->vCommit.size();) {
+		if (worker->vCommit[n].first == pair)
+			worker->vCommit.erase(worker->vCommit.begin() + n);
+		else
+			n++;
+	}
+
+	for (int n = 0; n < 2; n++) {
+		if (pair->fd[n] != INVALID_SOCKET)
+			closesocket(pair->fd[n]);
+		pair->fd[n] = INVALID_SOCKET;
+	}
+
+	if (pair->inflight == 0)
+		le_riopairfree(pair);
+}
+
+static void le_riopairfree(_RioPair* pair)
+{
+	_RioWorker* worker = pair->worker;
+
+	for (int n = 0; n < 2; n++) {
+		while (!pair->queue[n].empty()) {
+			worker->vFree.push_back(pair->queue[n].front().slot);
+			pair->queue[n].pop_front();
+		}
+	}
+
+	worker->vPairs[pair->index] = worker->vPairs.back();
+	worker->vPairs[pair->index]->index = pair->index;
+	worker->vPairs.pop_back();
+
+	delete pair;
+}
+
+// the listeners first so no accept is handed out, then each worker drains and ends
+void le_riostop()
+{
+	std::vector<_TunnelsInfo*>::iterator titer = vTunnels.begin();
+	while (titer != vTunnels.end()) {
+		_TunnelsInfo* tunnelinfo = *titer;
+		if (tunnelinfo->riolistener != INVALID_SOCKET)
+			closesocket(tunnelinfo->riolistener);
+		tunnelinfo->riolistener = INVALID_SOCKET;
+		titer++;
+	}
+
+	for (size_t n = 0; n < vRioWorkers.size(); n++)
+		PostQueuedCompletionStatus(vRioWorkers[n]->iocp, 0, (ULONG_PTR)_RIO_KEY::_STOP, NULL);
+
+	for (size_t n = 0; n < vRioWorkers.size(); n++) {
+		_RioWorker* worker = vRioWorkers[n];
+		if (worker->thread.joinable())
+			worker->thread.join();
+		rio.RIOCloseCompletionQueue(worker->cq);
+		rio.RIODeregisterBuffer(worker->bufid);
+		VirtualFree(worker->bufs, 0, MEM_RELEASE);
+		CloseHandle(worker->iocp);
+		delete worker;
+	}
+	vRioWorkers.clear();
+}
+#endif
@@ -0,0 +1,14 @@
+#ifndef RIO_H
+#define RIO_H
+
+#include "tunnel.h"
+
+// the registered I/O relay path of Registered IO tunnels on Windows. one worker thread per core waits on
+// its own completion port, AcceptEx, ConnectEx and the RIO completion queue of the worker complete there
+
+#ifdef _WIN32
+bool le_riolisten(_TunnelsInfo* tunnelinfo, const struct sockaddr* sa, int socklen);	// false falls back to the libevent listener
+void le_riostop();
+#endif
+
+#endif
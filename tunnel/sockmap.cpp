@@ -0,0 +1,484 @@
+#include "sockmap.h"
+
+#ifdef __linux__
+#define SOCKMAP_MAX_PAIRS 32768
+#define SOCKMAP_DRAIN_MSEC 10
+#define SOCKMAP_DRAIN_TICKS 500	// the peer gets 5 seconds to take the redirected bytes before its FIN
+
+// remote address and both ports of a socket as __sk_buff has them, the key the verdict program looks up
+struct _SockmapKey
+{
+	unsigned int remoteip[4];
+	unsigned int localip[4];
+	unsigned int remoteport;
+	unsigned int localport;
+};
+
+// the kernel's struct tcp_info, the copy of glibc ends before the byte counters
+struct _TcpInfoExt
+{
+	struct tcp_info info;
+	unsigned long long pacingrate;
+	unsigned long long maxpacingrate;
+	unsigned long long bytesacked;
+	unsigned long long bytesreceived;
+};
+
+// relay pair whose bytes the verdict program redirects, index 0 is proxy_bev
+struct _SockmapPair
+{
+	_SockmapPair()
+	{
+		slot = -1;
+		seen = 0;
+		drains = 0;
+		timer = NULL;
+		for (int n = 0; n < 2; n++) {
+			memset(&key[n], 0, sizeof(key[n]));
+			recv[n] = 0;
+			sent[n] = 0;
+			drain[n] = false;
+		}
+	}
+
+	int slot;	// sockmap keys 2 * slot and 2 * slot + 1
+	_SockmapKey key[2];
+	unsigned long long recv[2];	// bytes received when armed
+	unsigned long long sent[2];	// bytes taken into the send queue when armed
+	unsigned long long seen;	// received bytes of both sides at the last read timeout
+	bool drain[2];	// the write side is shut down once the redirected bytes are in its send queue
+	int drains;
+	struct event* timer;
+};
+
+static int sockmapfd = -1;
+static int sockpeerfd = -1;	// _SockmapKey to the sockmap key of the other side
+static std::atomic<bool> sockmapfailed(false);
+static std::mutex sockmaplock;	// the maps and the free slots
+static std::vector<int> vSockmapSlots;
+
+static bool le_sockmapinit();
+static void le_sockmaptimer_cb(evutil_socket_t, short, void*);
+
+static long le_bpf(int cmd, union bpf_attr* attr)
+{
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static struct bpf_insn le_bpfinsn(unsigned char code, unsigned char dst, unsigned char src, short off, int imm)
+{
+	struct bpf_insn insn;
+
+	insn.code = code;
+	insn.dst_reg = dst;
+	insn.src_reg = src;
+	insn.off = off;
+	insn.imm = imm;
+	return insn;
+}
+
+static int le_bpfmap(unsigned int type, unsigned int keysize, unsigned int valuesize, unsigned int entries)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = type;
+	attr.key_size = keysize;
+	attr.value_size = valuesize;
+	attr.max_entries = entries;
+	return (int)le_bpf(BPF_MAP_CREATE, &attr);
+}
+
+static bool le_bpfupdate(int fd, const void* key, const void* value)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = fd;
+	attr.key = (unsigned long long)(uintptr_t)key;
+	attr.value = (unsigned long long)(uintptr_t)value;
+	attr.flags = BPF_ANY;
+	return le_bpf(BPF_MAP_UPDATE_ELEM, &attr) == 0;
+}
+
+static void le_bpfdelete(int fd, const void* key)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = fd;
+	attr.key = (unsigned long long)(uintptr_t)key;
+	le_bpf(BPF_MAP_DELETE_ELEM, &attr);
+}
+
+// the maps and the verdict program, made by the first Sockmap pair under sockmaplock
+static bool le_sockmapinit()
+{
+	if (sockmapfd != -1 || sockmapfailed)
+		return sockmapfd != -1;
+
+	int progfd = -1;
+	bool attached = false;
+
+	sockmapfd = le_bpfmap(BPF_MAP_TYPE_SOCKMAP, sizeof(unsigned int), sizeof(unsigned int), SOCKMAP_MAX_PAIRS * 2);
+	sockpeerfd = le_bpfmap(BPF_MAP_TYPE_HASH, sizeof(_SockmapKey), sizeof(unsigned int), SOCKMAP_MAX_PAIRS * 2);
+
+	if (sockmapfd >= 0 && sockpeerfd >= 0) {
+		const short len = offsetof(struct __sk_buff, len);
+		const short family = offsetof(struct __sk_buff, family);
+		const short remoteip4 = offsetof(struct __sk_buff, remote_ip4);
+		const short localip4 = offsetof(struct __sk_buff, local_ip4);
+		const short remoteip6 = offsetof(struct __sk_buff, remote_ip6);
+		const short localip6 = offsetof(struct __sk_buff, local_ip6);
+		const short remoteport = offsetof(struct __sk_buff, remote_port);
+		const short localport = offsetof(struct __sk_buff, local_port);
+		std::vector<struct bpf_insn> vProg;
+
+		// the _SockmapKey of the receiving socket at r10 - 40, the other side of the pair when the key is found.
+		// an empty skb is the FIN, it stays with the socket so the tunnel reads the EOF and sends its own
+		vProg.push_back(le_bpfinsn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0));
+		vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, len, 0));
+		size_t empty = vProg.size();
+		vProg.push_back(le_bpfinsn(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_2, 0, 0, 0));
+		for (int n = 0; n < 5; n++)
+			vProg.push_back(le_bpfinsn(BPF_ST | BPF_MEM | BPF_DW, BPF_REG_10, 0, (short)(-40 + n * 8), 0));
+		vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, family, 0));
+		vProg.push_back(le_bpfinsn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_2, 0, 5, AF_INET));
+		vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, remoteip4, 0));
+		vProg.push_back(le_bpfinsn(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_3, -40, 0));
+		vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, localip4, 0));
+		vProg.push_back(le_bpfinsn(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_3, -24, 0));
+		vProg.push_back(le_bpfinsn(BPF_JMP | BPF_JA, 0, 0, 16, 0));
+		for (int n = 0; n < 4; n++) {
+			vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, (short)(remoteip6 + n * 4), 0));
+			vProg.push_back(le_bpfinsn(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_3, (short)(-40 + n * 4), 0));
+		}
+		for (int n = 0; n < 4; n++) {
+			vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, (short)(localip6 + n * 4), 0));
+			vProg.push_back(le_bpfinsn(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_3, (short)(-24 + n * 4), 0));
+		}
+		vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, remoteport, 0));
+		vProg.push_back(le_bpfinsn(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_3, -8, 0));
+		vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, localport, 0));
+		vProg.push_back(le_bpfinsn(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_3, -4, 0));
+		vProg.push_back(le_bpfinsn(BPF_LD | BPF_IMM | BPF_DW, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, sockpeerfd));
+		vProg.push_back(le_bpfinsn(0, 0, 0, 0, 0));
+		vProg.push_back(le_bpfinsn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0));
+		vProg.push_back(le_bpfinsn(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -40));
+		vProg.push_back(le_bpfinsn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem));
+		// not a pair of ours, or one being taken back, the socket keeps the bytes
+		size_t unknown = vProg.size();
+		vProg.push_back(le_bpfinsn(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, 0, 0));
+		vProg.push_back(le_bpfinsn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_0, 0, 0));
+		vProg.push_back(le_bpfinsn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_1, BPF_REG_6, 0, 0));
+		vProg.push_back(le_bpfinsn(BPF_LD | BPF_IMM | BPF_DW, BPF_REG_2, BPF_PSEUDO_MAP_FD, 0, sockmapfd));
+		vProg.push_back(le_bpfinsn(0, 0, 0, 0, 0));
+		vProg.push_back(le_bpfinsn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_4, 0, 0, 0));
+		vProg.push_back(le_bpfinsn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_sk_redirect_map));
+		vProg.push_back(le_bpfinsn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+		vProg[empty].off = (short)(vProg.size() - empty - 1);
+		vProg[unknown].off = (short)(vProg.size() - unknown - 1);
+		vProg.push_back(le_bpfinsn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, SK_PASS));
+		vProg.push_back(le_bpfinsn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+		union bpf_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.prog_type = BPF_PROG_TYPE_SK_SKB;
+		attr.insns = (unsigned long long)(uintptr_t)vProg.data();
+		attr.insn_cnt = (unsigned int)vProg.size();
+		attr.license = (unsigned long long)(uintptr_t)"Dual MIT/GPL";
+		progfd = (int)le_bpf(BPF_PROG_LOAD, &attr);
+	}
+
+	// the plain verdict needs 5.13, older kernels take it as a stream verdict
+	if (progfd >= 0) {
+		unsigned int types[] = { BPF_SK_SKB_VERDICT, BPF_SK_SKB_STREAM_VERDICT };
+		for (size_t n = 0; n < sizeof(types) / sizeof(types[0]) && !attached; n++) {
+			union bpf_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.target_fd = sockmapfd;
+			attr.attach_bpf_fd = progfd;
+			attr.attach_type = types[n];
+			attached = (le_bpf(BPF_PROG_ATTACH, &attr) == 0);
+		}
+	}
+
+	int error = errno;
+
+	// the map holds the program now
+	if (progfd >= 0)
+		close(progfd);
+
+	if (!attached) {
+		if (sockmapfd >= 0)
+			close(sockmapfd);
+		if (sockpeerfd >= 0)
+			close(sockpeerfd);
+		sockmapfd = -1;
+		sockpeerfd = -1;
+		sockmapfailed = true;
+		msglog(eMSGTYPE::INFO, "BPF sockmap is not available (%s), Sockmap tunnels relay through bufferevents.", strerror(error));
+		return false;
+	}
+
+	for (int n = SOCKMAP_MAX_PAIRS - 1; n >= 0; n--)
+		vSockmapSlots.push_back(n);
+
+	msglog(eMSGTYPE::DEBUG, "BPF sockmap ready for %d pairs.", SOCKMAP_MAX_PAIRS);
+	return true;
+}
+
+static bool le_sockmapkey(evutil_socket_t fd, _SockmapKey* key)
+{
+	struct sockaddr_storage remote, local;
+	socklen_t remotelen = sizeof(remote);
+	socklen_t locallen = sizeof(local);
+
+	memset(key, 0, sizeof(*key));
+	if (getpeername(fd, (struct sockaddr*)&remote, &remotelen) != 0 || getsockname(fd, (struct sockaddr*)&local, &locallen) != 0)
+		return false;
+
+	// remote_port is the network order port in the upper half, local_port is in host order
+	if (remote.ss_family == AF_INET) {
+		struct sockaddr_in* sin = (struct sockaddr_in*)&remote;
+		key->remoteip[0] = sin->sin_addr.s_addr;
+		key->remoteport = (unsigned int)sin->sin_port << 16;
+		sin = (struct sockaddr_in*)&local;
+		key->localip[0] = sin->sin_addr.s_addr;
+		key->localport = ntohs(sin->sin_port);
+	}
+	else if (remote.ss_family == AF_INET6) {
+		struct sockaddr_in6* sin6 = (struct sockaddr_in6*)&remote;
+		memcpy(key->remoteip, &sin6->sin6_addr, sizeof(key->remoteip));
+		key->remoteport = (unsigned int)sin6->sin6_port << 16;
+		sin6 = (struct sockaddr_in6*)&local;
+		memcpy(key->localip, &sin6->sin6_addr, sizeof(key->localip));
+		key->localport = ntohs(sin6->sin6_port);
+	}
+	else
+		return false;
+	return true;
+}
+
+// bytes that arrived on fd and bytes written to it, written counts from the send queue, not the wire
+static bool le_tcpbytes(evutil_socket_t fd, unsigned long long* received, unsigned long long* sent)
+{
+	_TcpInfoExt ti;
+	socklen_t len = sizeof(ti);
+	int outq = 0;
+
+	memset(&ti, 0, sizeof(ti));
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) != 0 || len < sizeof(ti) || ioctl(fd, SIOCOUTQ, &outq) != 0)
+		return false;
+
+	*received = ti.bytesreceived;
+	*sent = ti.bytesacked + (unsigned int)outq;
+	return true;
+}
+
+static int le_readable(evutil_socket_t fd)
+{
+	int len = 0;
+
+	if (ioctl(fd, FIONREAD, &len) != 0)
+		return -1;
+	return len;
+}
+
+// hands a quiet pair to the verdict program, anything buffered on either side would be passed by the redirected bytes
+void le_sockmaparm(_RelayPair* pair)
+{
+	if (!pair->tunnelinfo->sockmap || sockmapfailed || pair->sockmap != NULL || pair->proxyeof || pair->localeof)
+		return;
+
+	struct bufferevent* bev[2] = { pair->proxy_bev, pair->local_bev };
+	evutil_socket_t fd[2];
+
+	for (int n = 0; n < 2; n++) {
+		fd[n] = bufferevent_getfd(bev[n]);
+		if (evbuffer_get_length(bufferevent_get_input(bev[n])) > 0 || evbuffer_get_length(bufferevent_get_output(bev[n])) > 0
+			|| le_readable(fd[n]) != 0)
+			return;
+	}
+
+	_SockmapPair* sm = new _SockmapPair;
+	for (int n = 0; n < 2; n++) {
+		if (!le_sockmapkey(fd[n], &sm->key[n]) || !le_tcpbytes(fd[n], &sm->recv[n], &sm->sent[n])) {
+			delete sm;
+			return;
+		}
+	}
+	sm->seen = sm->recv[0] + sm->recv[1];
+
+	{
+		std::lock_guard<std::mutex> lock(sockmaplock);
+		if (!le_sockmapinit() || vSockmapSlots.empty()) {
+			delete sm;
+			return;
+		}
+		sm->slot = vSockmapSlots.back();
+		vSockmapSlots.pop_back();
+	}
+	pair->sockmap = sm;
+
+	// the sockets first, a key found by the program always has its peer in place
+	for (int n = 0; n < 2; n++) {
+		unsigned int index = (unsigned int)(sm->slot * 2 + n);
+		unsigned int value = (unsigned int)fd[n];
+		if (!le_bpfupdate(sockmapfd, &index, &value)) {
+			le_sockmapdisarm(pair);
+			return;
+		}
+	}
+	for (int n = 0; n < 2; n++) {
+		unsigned int peer = (unsigned int)(sm->slot * 2 + 1 - n);
+		if (!le_bpfupdate(sockpeerfd, &sm->key[n], &peer)) {
+			le_sockmapdisarm(pair);
+			return;
+		}
+	}
+
+	// bytes that came in between the check and the insert sit in the socket until more arrive, they are read here
+	// as before unless the program already moved some, taking the pair back then would drop those on their way
+	bool stale = false;
+	bool moved = false;
+	for (int n = 0; n < 2; n++) {
+		unsigned long long received, sent;
+		int queued = le_readable(fd[n]);
+		if (queued < 0 || !le_tcpbytes(fd[n], &received, &sent))
+			moved = true;
+		else {
+			stale |= (queued > 0);
+			moved |= (received - sm->recv[n] > (unsigned long long)queued);
+		}
+	}
+	if (stale && !moved) {
+		le_sockmapdisarm(pair);
+		return;
+	}
+
+	msglog(eMSGTYPE::DEBUG, "%s Relay pair forwarded by the kernel.", pair->tunnelinfo->name);
+}
+
+// takes the pair back from the verdict program and counts what it forwarded, the sockets are still open
+void le_sockmapdisarm(_RelayPair* pair)
+{
+	_SockmapPair* sm = pair->sockmap;
+	evutil_socket_t fd[2] = { bufferevent_getfd(pair->proxy_bev), bufferevent_getfd(pair->local_bev) };
+
+	// the keys first, the program passes anything arriving meanwhile to the socket itself
+	for (int n = 0; n < 2; n++)
+		le_bpfdelete(sockpeerfd, &sm->key[n]);
+	for (int n = 0; n < 2; n++) {
+		unsigned int index = (unsigned int)(sm->slot * 2 + n);
+		le_bpfdelete(sockmapfd, &index);
+	}
+
+	for (int n = 0; n < 2; n++) {
+		unsigned long long received, sent;
+		int queued = le_readable(fd[n]);
+		bool eof = (n == 0) ? pair->proxyeof : pair->localeof;
+
+		// still queued bytes are counted by le_readcb, a FIN read counts as one
+		unsigned long long unread = (queued > 0 ? queued : 0) + (eof ? 1 : 0);
+		if (!le_tcpbytes(fd[n], &received, &sent) || received < sm->recv[n] + unread)
+			continue;
+
+		received -= sm->recv[n] + unread;
+		if (n == 0)
+			pair->tunnelinfo->stats.bytesin += received;
+		else
+			pair->tunnelinfo->stats.bytesout += received;
+	}
+
+	if (sm->timer)
+		event_free(sm->timer);
+
+	{
+		std::lock_guard<std::mutex> lock(sockmaplock);
+		vSockmapSlots.push_back(sm->slot);
+	}
+
+	delete sm;
+	pair->sockmap = NULL;
+}
+
+// whether the bytes the program took from the other side of index are all in the send queue of index
+static bool le_sockmapflushed(_RelayPair* pair, int index)
+{
+	_SockmapPair* sm = pair->sockmap;
+	struct bufferevent* to = (index == 0) ? pair->proxy_bev : pair->local_bev;
+	struct bufferevent* from = (index == 0) ? pair->local_bev : pair->proxy_bev;
+	unsigned long long received, sent, unused;
+
+	if (!le_tcpbytes(bufferevent_getfd(from), &received, &unused) || !le_tcpbytes(bufferevent_getfd(to), &unused, &sent))
+		return true;
+	// the other side read its EOF, the received count has the FIN in it
+	return sent - sm->sent[index] + 1 >= received - sm->recv[1 - index];
+}
+
+// false while bev still waits for redirected bytes, the drain timer shuts it down once they are in
+bool le_sockmapdrained(_RelayPair* pair, struct bufferevent* bev)
+{
+	_SockmapPair* sm = pair->sockmap;
+	int index = (bev == pair->proxy_bev) ? 0 : 1;
+	struct timeval tv = { 0, SOCKMAP_DRAIN_MSEC * 1000 };
+
+	if (le_sockmapflushed(pair, index))
+		return true;
+
+	if (sm->timer == NULL)
+		sm->timer = evtimer_new(bufferevent_get_base(bev), le_sockmaptimer_cb, (void*)pair);
+	if (sm->timer == NULL)
+		return true;
+
+	sm->drain[index] = true;
+	if (!evtimer_pending(sm->timer, NULL))
+		evtimer_add(sm->timer, &tv);
+	return false;
+}
+
+static void le_sockmaptimer_cb(evutil_socket_t, short, void* arg)
+{
+	_RelayPair* pair = (_RelayPair*)arg;
+	_SockmapPair* sm = pair->sockmap;
+	struct timeval tv = { 0, SOCKMAP_DRAIN_MSEC * 1000 };
+	bool ready[2];
+
+	sm->drains++;
+	for (int n = 0; n < 2; n++) {
+		ready[n] = sm->drain[n] && (sm->drains >= SOCKMAP_DRAIN_TICKS || le_sockmapflushed(pair, n));
+		if (ready[n])
+			sm->drain[n] = false;
+	}
+
+	if (sm->drain[0] || sm->drain[1])
+		evtimer_add(sm->timer, &tv);
+	else if (sm->drains >= SOCKMAP_DRAIN_TICKS)
+		msglog(eMSGTYPE::DEBUG, "%s Redirected bytes not taken by the peer, shut down anyway.", pair->tunnelinfo->name);
+
+	// a side waiting here isn't shut yet, so only the second shutdown can free the pair
+	if (ready[0])
+		le_pairshutdown(pair, pair->proxy_bev);
+	if (ready[1])
+		le_pairshutdown(pair, pair->local_bev);
+}
+
+// a forwarded pair never reads, its traffic shows in the received bytes of its sockets
+void le_sockmapactive(_RelayPair* pair)
+{
+	_SockmapPair* sm = pair->sockmap;
+	unsigned long long total = 0;
+	unsigned long long received, sent;
+
+	if (le_tcpbytes(bufferevent_getfd(pair->proxy_bev), &received, &sent))
+		total += received;
+	if (le_tcpbytes(bufferevent_getfd(pair->local_bev), &received, &sent))
+		total += received;
+
+	if (total != sm->seen) {
+		sm->seen = total;
+		pair->activetick = GetTickCount64();
+	}
+}
+#endif
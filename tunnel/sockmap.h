@@ -0,0 +1,16 @@
+#ifndef SOCKMAP_H
+#define SOCKMAP_H
+
+#include "tunnel.h"
+
+// the sockmap path of Sockmap tunnels on Linux. an established relay pair is armed once its buffers are
+// empty, from then on a verdict program redirects the bytes of each socket to the other one in the kernel
+
+#ifdef __linux__
+void le_sockmaparm(_RelayPair* pair);	// no-op unless the pair can be forwarded now
+void le_sockmapdisarm(_RelayPair* pair);
+bool le_sockmapdrained(_RelayPair* pair, struct bufferevent* bev);	// the redirected bytes of bev's peer are in its send queue
+void le_sockmapactive(_RelayPair* pair);	// the read timeout of an armed pair
+#endif
+
+#endif
@@ -26,66 +26,328 @@
 	A tunnel system capable of multiple tunnels with yaml config for Tunnel Proxy.
  */
 
-#include "common.h"
-#include <yaml-cpp/yaml.h>
+#include "tunnel.h"
+#include "uring.h"
+#include "rio.h"
+#include "sockmap.h"
+#include "upgrade.h"
+#include "httpcache.h"
 
-struct bufferevent* le_connect(DWORD ip, WORD port);
+struct _SockOpts;
+static void le_loadsockopts(const YAML::Node& node, _SockOpts& opts);
+static void le_setlistenopts(struct evconnlistener* listener, const _SockOpts& opts);
 static void signal_handler(int signal);
 static void le_readcb(struct bufferevent*, void*);
+static void le_writecb(struct bufferevent*, void*);
 static void le_eventcb(struct bufferevent*, short, void*);
 
 static void le_proxylistener_cb(struct evconnlistener*, evutil_socket_t,
 	struct sockaddr*, int socklen, void*);
+static void le_shardlistener_cb(struct evconnlistener*, evutil_socket_t,
+	struct sockaddr*, int socklen, void*);
+static void le_workeraccept_cb(evutil_socket_t, short, void*);
+static bool le_listen(_TunnelsInfo* tunnelinfo, const struct sockaddr* sa, int socklen);
+struct _VhostPeek;
+static bool le_vhostjoin(_TunnelsInfo* tunnelinfo, const struct sockaddr* sa, int socklen);
+static void le_vhostleave(_TunnelsInfo* tunnelinfo);
+static void le_vhostfree(_VhostListener* vhost);
+static void le_vhostlistener_cb(struct evconnlistener*, evutil_socket_t,
+	struct sockaddr*, int socklen, void*);
+static void le_vhostpeekcb(evutil_socket_t, short, void*);
+static int le_vhostsni(const unsigned char* data, int len, std::string& name);
+static int le_vhosthost(const unsigned char* data, int len, std::string& name);
+static _TunnelsInfo* le_vhostroute(_VhostListener* vhost, const std::string& name);
+static void le_vhostdone(_VhostPeek* peek, _TunnelsInfo* tunnelinfo);
+static bool le_relaystart(struct event_base* evbase, _TunnelsInfo* tunnelinfo, evutil_socket_t fd);
+static struct event_base* le_newbase();
+static bool le_startworkers(int count);
+static void le_stopworkers();
+struct _UpstreamPool;
+static bool le_resolve(_TunnelsInfo* tunnelinfo);
+struct _AddrInfo;
+struct _RelayPair;
+struct _ConnectRace;
+static void le_pairfree(struct event_base* evbase, _RelayPair* pair);
+static size_t le_readsize(_RelayPair* pair, struct bufferevent* bev, struct evbuffer* output, size_t len);
+static void le_growsockbuf(evutil_socket_t fd, int opt, int size);
+static void le_setlocaladdrs(_TunnelsInfo* tunnelinfo, struct evutil_addrinfo* res);
+static bool le_getlocaladdrs(_TunnelsInfo* tunnelinfo, std::vector<_AddrInfo>& vAddrs, unsigned int clienthash = 0);
+struct _Backend;
+static void le_backendstart(_TunnelsInfo* tunnelinfo);
+static void le_backendstop(_TunnelsInfo* tunnelinfo);
+static bool le_backendaddrs(_TunnelsInfo* tunnelinfo, std::vector<_AddrInfo>& vAddrs, unsigned int clienthash);
+static _Backend* le_backendfind(_TunnelsInfo* tunnelinfo, evutil_socket_t fd);
+static void le_healthtimer_cb(evutil_socket_t, short, void*);
+static void le_healtheventcb(struct bufferevent*, short, void*);
+static unsigned int le_hash(const void* data, size_t len, unsigned int hash = 2166136261u);
+static void le_ratestart(_TunnelsInfo* tunnelinfo);
+static void le_ratestop(_TunnelsInfo* tunnelinfo);
+static void le_rateattach(_RelayPair* pair);
+static void le_ratedetach(_RelayPair* pair);
+struct _TalkerSketch;
+static void le_talkerstart(_TunnelsInfo* tunnelinfo);
+static void le_talkerstop(_TunnelsInfo* tunnelinfo);
+static void le_talkertimer_cb(evutil_socket_t, short, void*);
+static std::string le_talkername(const std::string& key);
+static void le_talkerslots(const std::string& key, size_t* slots);
+static unsigned long long le_talkerrank(_TalkerSketch* sketch, const size_t* slots);
+static void le_talkeradd(_TunnelsInfo* tunnelinfo, const std::string& key, unsigned long long bytes, unsigned long long accepts, _RelayPair* pair);
+static void le_talkerthrottle(_RelayPair* pair);
+static bool le_acceptallow(_TunnelsInfo* tunnelinfo, evutil_socket_t fd, const struct sockaddr* sa);
+static bool le_acceptrate(_TunnelsInfo* tunnelinfo, unsigned int key);
+static bool le_breakerallow(_TunnelsInfo* tunnelinfo);
+static void le_shedstart();
+static void le_shedstop();
+static void le_lagprobe_cb(evutil_socket_t, short, void*);
+static void le_shedcheck(unsigned long long now);
+static void le_stallreport(const char* text);
+static void le_shedlisteners(bool enable);
+static bool le_racestart(struct event_base* evbase, _RelayPair* pair);
+static void le_racenext(_ConnectRace* race);
+static void le_racefree(_ConnectRace* race);
+static void le_racetimer_cb(evutil_socket_t, short, void*);
+static void le_raceeventcb(struct bufferevent*, short, void*);
+static void le_dnstimer_cb(evutil_socket_t, short, void*);
+static void le_dns_cb(int result, struct evutil_addrinfo* res, void* arg);
+static void le_startpools(_TunnelsInfo* tunnelinfo);
+static void le_freepools(_TunnelsInfo* tunnelinfo);
+static void le_poolfill(_UpstreamPool* pool);
+static void le_pooltimer_cb(evutil_socket_t, short, void*);
+static void le_pooleventcb(struct bufferevent*, short, void*);
+struct _PairTrace;
+enum class _TRACE_EVENT : BYTE;
+static void le_tracestart(_RelayPair* pair, evutil_socket_t fd);
+static void le_traceadd(_PairTrace* trace, _TRACE_EVENT type);
+static void le_tracedone(_RelayPair* pair);
+static void le_tracefree();
+static void le_outputcb(struct evbuffer* buffer, const struct evbuffer_cb_info* info, void* arg);
+static bool le_startmetrics(const char* ip, int port);
+static void le_metrics_cb(struct evhttp_request* req, void* arg);
+#ifndef _WIN32
+static void le_profile_cb(struct evhttp_request* req, void* arg);
+#endif
+static void le_traces_cb(struct evhttp_request* req, void* arg);
+static bool le_loopbackonly(struct evhttp_request* req);
+struct _MuxLink;
+struct _MuxStream;
+static bool le_startlink(_TunnelsInfo* tunnelinfo);
+static void le_pathstart(_TunnelsInfo* tunnelinfo);
+static void le_stoplink(_TunnelsInfo* tunnelinfo);
+static void le_linklistener_cb(struct evconnlistener*, evutil_socket_t,
+	struct sockaddr*, int socklen, void*);
+static void le_linktimer_cb(evutil_socket_t, short, void*);
+static _MuxLink* le_linknew(_TunnelsInfo* tunnelinfo, struct bufferevent* bev);
+static void le_linkclose(_MuxLink* link);
+static void le_linksend(_MuxLink* link, BYTE cmd, DWORD stream, const void* data, WORD len);
+static void le_linkrequest(_TunnelsInfo* tunnelinfo);
+static void le_linkreadcb(struct bufferevent*, void*);
+static void le_linkwritecb(struct bufferevent*, void*);
+static void le_linkeventcb(struct bufferevent*, short, void*);
+static void le_muxaccept(_TunnelsInfo* tunnelinfo, evutil_socket_t fd);
+static void le_muxopen(_MuxLink* link, DWORD id, const _MuxOpen* open);
+static _MuxStream* le_streamnew(_MuxLink* link, DWORD id, struct bufferevent* bev);
+static void le_streamflush(_MuxStream* stream, bool turn);
+static bool le_linkroom(_MuxStream* stream, bool turn);
+static void le_streamshutdown(_MuxStream* stream);
+static void le_streamclose(_MuxStream* stream, bool reset);
+static void le_streamreadcb(struct bufferevent*, void*);
+static void le_streamwritecb(struct bufferevent*, void*);
+static void le_streameventcb(struct bufferevent*, short, void*);
+static void le_streamoutputcb(struct evbuffer* buffer, const struct evbuffer_cb_info* info, void* arg);
+#ifdef __linux__
+static bool le_tlsinit(_TunnelsInfo* tunnelinfo);
+static int le_tlssession_cb(SSL* ssl, SSL_SESSION* session);
+static struct bufferevent* le_tlsconnect(_TunnelsInfo* tunnelinfo, evutil_socket_t fd);
+#endif
+static struct bufferevent* le_linkconnect(_TunnelsInfo* tunnelinfo, int source);
+static _MuxLink* le_linkpick(_TunnelsInfo* tunnelinfo);
+static void le_pathtimer_cb(evutil_socket_t, short, void*);
+static void le_keepalivetimer_cb(evutil_socket_t, short, void*);
+static void le_linkrtt(_MuxLink* link, unsigned long long rtt);
+static bool le_linkhealthy(_MuxLink* link, unsigned long long now);
+static void le_linkoutputcb(struct evbuffer* buffer, const struct evbuffer_cb_info* info, void* arg);
+static void le_pathorphan(_MuxStream* stream);
+static void le_pathresume(_TunnelsInfo* tunnelinfo, _MuxLink* to = NULL, DWORD id = 0);
+static void le_pathhint(_MuxLink* link);
+static void le_streamresume(_MuxStream* stream, DWORD peerrecv, DWORD peercredited);
+struct _UdpFlow;
+struct _UdpDatagram;
+static bool le_udpbind(_TunnelsInfo* tunnelinfo, const struct sockaddr* sa, int socklen);
+static void le_udpstop(_TunnelsInfo* tunnelinfo);
+static int le_udprecv(evutil_socket_t fd);
+static void le_udpsend(evutil_socket_t fd, const struct sockaddr* sa, int socklen, int first, int count);
+static void le_udpreadcb(evutil_socket_t, short, void*);
+static void le_udpflowreadcb(evutil_socket_t, short, void*);
+static void le_udpforward(_UdpFlow* flow, struct evbuffer* input, size_t len);
+static _UdpFlow* le_udpflownew(_TunnelsInfo* tunnelinfo, const std::string& key);
+static _UdpFlow* le_udpflowget(_TunnelsInfo* tunnelinfo, _UdpDatagram* datagram);
+static void le_udpopen(_MuxLink* link, DWORD id);
+static bool le_udpconnect(_UdpFlow* flow);
+static void le_udpflowfree(_UdpFlow* flow);
+static void le_udptimer_cb(evutil_socket_t, short, void*);
+static _TunnelsInfo* le_loadtunnel(const YAML::Node& _tunnelinfo);
+static bool le_starttunnel(_TunnelsInfo* tunnelinfo);
+static void le_pooldrain(_UpstreamPool* pool);
+#ifndef _WIN32
+static void le_reload_cb(evutil_socket_t, short, void*);
+static void le_memdump_cb(evutil_socket_t, short, void*);
+static bool le_tunnelchanged(_TunnelsInfo* running, _TunnelsInfo* loaded);
+static void le_updatetunnel(_TunnelsInfo* running, _TunnelsInfo* loaded);
+static void le_retiretunnel(_TunnelsInfo* tunnelinfo);
+static void le_tunneladd(_TunnelsInfo* tunnelinfo);
+static void le_tunnelremove(_TunnelsInfo* tunnelinfo);
+static _TunnelsInfo* le_tunnelport(_TunnelsInfo* tunnelinfo);
+static bool le_tunnelswap(_TunnelsInfo* running, _TunnelsInfo* loaded);
+static void le_tunnels_cb(struct evhttp_request* req, void* arg);
+static void le_shardfree_cb(evutil_socket_t, short, void*);
+#endif
+#ifdef __linux__
+static void le_streamdeflate(_MuxStream* stream, struct evbuffer* input, size_t len);
+static bool le_streaminflate(_MuxStream* stream, struct evbuffer* input, size_t len);
+#endif
+#ifdef __linux__
+struct _SplicePair;
+static bool le_splicestart(struct event_base* evbase, _TunnelsInfo* tunnelinfo, evutil_socket_t fd);
+static void le_spliceconnect_cb(evutil_socket_t, short, void*);
+static void le_splicereadcb(evutil_socket_t, short, void*);
+static void le_splicewritecb(evutil_socket_t, short, void*);
+static void le_spliceread(_SplicePair* pair, int dir);
+static bool le_splicepump(_SplicePair* pair, int dir);
+static void le_spliceclose(_SplicePair* pair);
+static void le_splicefree(_SplicePair* pair);
+#endif
 
 struct event_base* base;
+static struct evdns_base* dnsbase = NULL;
+static struct evhttp* metricshttp = NULL;
+static struct event* reloadev = NULL;
+static struct event* memdumpev = NULL;
+
+// process wide cap on bytes queued in relay output buffers, 0 is unlimited
+long long bufferbudget = 0;
+std::atomic<long long> bufferedbytes(0);
+static std::atomic<long long> relaypairs(0);
+static std::atomic<unsigned long long> budgetthrottled(0);
+
+static const unsigned long long statslatencybounds[STATS_LATENCY_BUCKETS] = { 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000 }; // usec
+
+// udp batches are only handled from the main loop
+static unsigned char udpbuf[UDP_BATCH][UDP_DATAGRAM_MAX];
+static _UdpDatagram udpdatagrams[UDP_BATCH];
+
+// the running tunnels, indexed by name and by the proxy port of the ones without Virtual Hosts, so a
+// reload or the control API finds one in O(1) among thousands. main loop only
+std::vector< _TunnelsInfo*> vTunnels;
+std::unordered_map<std::string, _TunnelsInfo*> mTunnelNames;
+static std::unordered_map<int, _TunnelsInfo*> mTunnelPorts;
+std::vector< _TunnelsInfo*> vRetired;	// removed by a reload or the control API, freed on exit
+static std::string controltoken;	// bearer token of /tunnels, the control API is off without it
+
+// an accepted client whose first bytes are peeked at until they name a tunnel, they stay in the socket for the relay
+struct _VhostPeek
+{
+	_VhostListener* vhost;
+	evutil_socket_t fd;
+	struct event* ev;
+#ifdef _WIN32
+	struct event* retry;	// no edge triggered reads, a peek that found nothing new waits on this
+#endif
+	int peeked;
+	size_t index;	// in vPeeks of its listener
+};
+
+std::vector<_VhostListener*> vVhosts;
+static unsigned char vhostbuf[VHOST_PEEK_MAX];
+
+static std::vector<_RelayPair*> vMainPairs;	// established pairs of the main loop
+static std::vector<_RelayPair*> vMainFreePairs;
+
+#ifdef __linux__
+#define SPLICE_CHUNK_SIZE 65536
+#define SPLICE_MAX_CHUNKS_PERCB 16
 
-struct _TunnelsInfo
+// relay pair forwarded in kernel through one pipe per direction, dir 0 is client to local server
+struct _SplicePair
 {
-	_TunnelsInfo()
+	_SplicePair()
 	{
-		memset(name, 0, sizeof(name));
-		memset(proxyip, 0, sizeof(proxyip));
-		proxyport = -1;
-		memset(local_serverip, 0, sizeof(local_serverip));
-		local_serverport = -1;
-		proxy_listener = NULL;
-	}
-
-	char name[50];
-	char proxyip[16];
-	int proxyport;
-	char local_serverip[16];
-	int local_serverport;
-	struct evconnlistener* proxy_listener;
+		base = NULL;
+		tunnelinfo = NULL;
+		connectstart = 0;
+		activetick = 0;
+		for (int n = 0; n < 2; n++) {
+			fd[n] = -1;
+			eof[n] = false;
+			pipefd[n][0] = -1;
+			pipefd[n][1] = -1;
+			pending[n] = 0;
+			readev[n] = NULL;
+			writeev[n] = NULL;
+		}
+	}
+
+	struct event_base* base;
+	_TunnelsInfo* tunnelinfo;
+	unsigned long long connectstart;
+	unsigned long long activetick;
+	evutil_socket_t fd[2];
+	bool eof[2];
+	int pipefd[2][2];
+	size_t pending[2];
+	struct event* readev[2];
+	struct event* writeev[2];
 };
 
-static std::vector< _TunnelsInfo*> vTunnels;
+#endif
+
+std::vector<_RelayWorker*> vWorkers;
+_DISPATCH_TYPE workerdispatch = _DISPATCH_TYPE::_ROUND_ROBIN;
+static size_t workernext = 0;
+
+static int shedlagmsec = 0;	// loop lag that stops the proxy listeners, 0 never
+static int stallmsec = 0;	// loop stuck in one callback for longer is reported, 0 never
+static unsigned int tracesample = 0;	// one in this many pairs is traced, 0 none
+static std::atomic<unsigned long long> traceaccepts(0);
+static std::atomic<unsigned long long> tracehead(0);
+static std::atomic<_PairTrace*> traceRing[TRACE_RING];	// finished traces, taken by /traces
+static _LagProbe mainprobe;
+static std::atomic<bool> shedding(false);
+static int shedcalm = 0;	// probes in a row below half the lag while shedding
+static std::atomic<unsigned long long> shedtotal(0);
 
 int main()
 {
-	struct sockaddr_in sin;
-
 	std::signal(SIGINT, signal_handler);
+#ifndef _WIN32
+	// a peer resetting mid write, a dropped link among them, is an error of that socket and not of the process
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
 
 #ifdef _WIN32
-	SYSTEM_INFO SystemInfo;
 	WORD wVersionRequested;
 	WSADATA wsaData;
 	wVersionRequested = MAKEWORD(2, 2);
 	int ret = WSAStartup(wVersionRequested, &wsaData);
+#endif
 
-	GetSystemInfo(&SystemInfo);
-	evthread_use_windows_threads();
+	// libevent takes its allocator before it allocates anything, so this key is read ahead of the rest
+	try {
+		_CONF_SOURCE source;
+		YAML::Node configs = confcacheload("proxy.yaml", source);
+		if (configs["Event Memory Pool"] && configs["Event Memory Pool"].as<bool>() && !evmeminstall())
+			msglog(eMSGTYPE::INFO, "libevent is built without memory replacement, Event Memory Pool is ignored.");
+	}
+	catch (const YAML::Exception&) {
+	}
 
-	event_config* pConfig = event_config_new();
-	event_config_set_flag(pConfig, EVENT_BASE_FLAG_STARTUP_IOCP);
-	event_config_set_num_cpus_hint(pConfig, SystemInfo.dwNumberOfProcessors);
-	base = event_base_new_with_config(pConfig);
-	event_config_free(pConfig);
+#ifdef _WIN32
+	evthread_use_windows_threads();
 #else
-	base = event_base_new();
+	evthread_use_pthreads();
 #endif
 
+	base = le_newbase();
+
 	msglog(eMSGTYPE::INFO, "Proxy Server %d.%d.%d.%s, socket backend is %s.",
 		TUNNEL_PROXY_VER_MAJOR,
 		TUNNEL_PROXY_VER_MINOR,
@@ -95,13 +357,67 @@ int main()
 
 	try {
 
-		YAML::Node configs = YAML::LoadFile("proxy.yaml");
+		_CONF_SOURCE source;
+		YAML::Node configs = confcacheload("proxy.yaml", source);
+
+		if (source.iscached)
+			msglog(eMSGTYPE::INFO, "proxy.yaml is unchanged, read from its image.");
 
 		if (configs["Debug Message"].as<bool>() == true) {
 			LOGTYPEENABLED |= eMSGTYPE::DEBUG;
 			msglog(eMSGTYPE::INFO, "Debug message is enabled.");
 		}
 
+		if (configs["Worker Dispatch"] && configs["Worker Dispatch"].as<std::string>() == "Least Connections") {
+			workerdispatch = _DISPATCH_TYPE::_LEAST_CONNECTIONS;
+		}
+
+		if (configs["Buffer Budget"]) {
+			bufferbudget = configs["Buffer Budget"].as<long long>();
+			msglog(eMSGTYPE::INFO, "Relay buffer budget is %lld bytes.", bufferbudget);
+		}
+
+		if (configs["Shed Loop Lag"])
+			shedlagmsec = configs["Shed Loop Lag"].as<int>();
+
+		if (configs["Stall Report"])
+			stallmsec = configs["Stall Report"].as<int>();
+
+		if (configs["Trace Sample"] && configs["Trace Sample"].as<int>() > 0) {
+			tracesample = configs["Trace Sample"].as<unsigned int>();
+			msglog(eMSGTYPE::INFO, "One in %u connections is traced.", tracesample);
+		}
+
+		if (configs["Control Token"])
+			controltoken = configs["Control Token"].as<std::string>();
+
+		if (configs["Metrics Port"]) {
+			std::string metricsip = configs["Metrics IP"] ? configs["Metrics IP"].as<std::string>() : "127.0.0.1";
+			if (!le_startmetrics(metricsip.c_str(), configs["Metrics Port"].as<int>())) {
+				event_base_free(base);
+				return -1;
+			}
+		}
+
+		if (configs["Worker Threads"]) {
+			int workercount = configs["Worker Threads"].as<int>();
+			if (workercount < 0)
+				workercount = std::thread::hardware_concurrency();
+			if (!le_startworkers(workercount)) {
+				le_stopworkers();
+				event_base_free(base);
+				return -1;
+			}
+		}
+
+#ifndef _WIN32
+		// a running process on the socket hands its listeners over before the tunnels bind
+		if (configs["Upgrade Socket"]) {
+			upgradepath = configs["Upgrade Socket"].as<std::string>();
+			le_upgradereceive(configs["Upgrade Pairs"] && configs["Upgrade Pairs"].as<bool>());
+		}
+#endif
+
 		YAML::Node tunnellist = configs["Proxy  Servers"];
 
 		msglog(eMSGTYPE::DEBUG, "Proxy server count is %d.", tunnellist.size());
@@ -112,44 +428,39 @@ int main()
 		{
 			const YAML::Node& _tunnelinfo = *iter;
 
-			_TunnelsInfo* tunnelinfo = new _TunnelsInfo;
-
-			memcpy(tunnelinfo->name, _tunnelinfo["Name"].as<std::string>().c_str(), sizeof(tunnelinfo->name));
-			tunnelinfo->proxyport = _tunnelinfo["Proxy Port"].as<int>();
-			memcpy(tunnelinfo->proxyip, _tunnelinfo["Proxy IP"].as<std::string>().c_str(), sizeof(tunnelinfo->local_serverip));
-			tunnelinfo->local_serverport = _tunnelinfo["Local Server Port"].as<int>();
-			memcpy(tunnelinfo->local_serverip, _tunnelinfo["Local Server IP"].as<std::string>().c_str(), sizeof(tunnelinfo->local_serverip));
-
 			if (_tunnelinfo["Enable"].as<bool>() == false) {
 				iter++;
-				msglog(eMSGTYPE::DEBUG, "Proxy server %s is disabled.", tunnelinfo->name);
+				msglog(eMSGTYPE::DEBUG, "Proxy server %s is disabled.", _tunnelinfo["Name"].as<std::string>().c_str());
 				continue;
 			}
 
-			msglog(eMSGTYPE::INFO, "%s Proxy Server IP %s.", tunnelinfo->name, tunnelinfo->proxyip);
-
-			memset(&sin, 0, sizeof(sin));
-			sin.sin_family = AF_INET;
-			sin.sin_addr.s_addr = htonl(host2ip(tunnelinfo->proxyip));
-			sin.sin_port = htons(tunnelinfo->proxyport);
+			_TunnelsInfo* tunnelinfo = le_loadtunnel(_tunnelinfo);
 
-			tunnelinfo->proxy_listener = evconnlistener_new_bind(base, le_proxylistener_cb, (void*)tunnelinfo,
-				LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, -1,
-				(struct sockaddr*)&sin,
-				sizeof(sin));
-
-			if (!tunnelinfo->proxy_listener) {
-				msglog(eMSGTYPE::ERROR, "evconnlistener_new_bind failed at port %d, %s (%d).", tunnelinfo->proxyport, __func__, __LINE__);
+			if (!le_starttunnel(tunnelinfo)) {
+				le_stopworkers();
 				event_base_free(base);
 				return -1;
 			}
 
-			msglog(eMSGTYPE::INFO, "%s Proxy Server is listening to proxy port %d.", tunnelinfo->name, tunnelinfo->proxyport);
-
-			vTunnels.push_back(tunnelinfo);
+			le_tunneladd(tunnelinfo);
 
 			iter++;
 		}
+
+		if (!confcachesave("proxy.yaml", source, configs))
+			msglog(eMSGTYPE::ERROR, "The image of proxy.yaml could not be written, it is parsed again next time.");
+
+#ifndef _WIN32
+		reloadev = evsignal_new(base, SIGHUP, le_reload_cb, NULL);
+		event_add(reloadev, NULL);
+		memdumpev = evsignal_new(base, SIGUSR2, le_memdump_cb, NULL);
+		event_add(memdumpev, NULL);
+
+		if (!upgradepath.empty()) {
+			le_upgradeadopt();
+			le_upgradelisten();
+		}
+#endif
 	}
 	catch (const YAML::BadFile& e) {
 		msglog(eMSGTYPE::ERROR, "YAML error, %s.", e.msg.c_str());
@@ -160,17 +471,59 @@ int main()
 		return -1;
 	}
 
+	le_shedstart();
 	event_base_loop(base, EVLOOP_NO_EXIT_ON_EMPTY);
 
+	if (reloadev)
+		event_free(reloadev);
+	if (memdumpev)
+		event_free(memdumpev);
+	loopwatchstop();
+	samplerstop();
+	le_shedstop();
+#ifndef _WIN32
+	le_upgradestop();
+#endif
+
+	while (vVhosts.size() > 0)
+		le_vhostfree(vVhosts.back());
+
+	// retired tunnels may still have pairs, they are torn down with the rest
+	vTunnels.insert(vTunnels.end(), vRetired.begin(), vRetired.end());
+	vRetired.clear();
+
+#ifdef _WIN32
+	le_riostop();
+#endif
+	le_stopworkers();
+
 	std::vector<_TunnelsInfo*>::iterator viter = vTunnels.begin();
 	while (viter != vTunnels.end()) {
 		_TunnelsInfo* _tunneninfo = *viter;
+		if (_tunneninfo->dnstimer)
+			event_free(_tunneninfo->dnstimer);
+		le_httpstop(_tunneninfo);
+		le_stoplink(_tunneninfo);
+		le_udpstop(_tunneninfo);
+		le_ratestop(_tunneninfo);
+		le_talkerstop(_tunneninfo);
+		le_backendstop(_tunneninfo);
 		delete _tunneninfo;
 		viter++;
 	}
 
 	vTunnels.clear();
 
+	if (dnsbase)
+		evdns_base_free(dnsbase, 0);
+
+	if (metricshttp)
+		evhttp_free(metricshttp);
+	le_tracefree();
+
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+	le_uringstop();
+#endif
 	event_base_free(base);
 
 #ifdef _WIN32
@@ -186,90 +539,5592 @@ static void le_proxylistener_cb(struct evconnlistener* listener, evutil_socket_t
 	struct sockaddr* sa, int socklen, void* user_data) {
 
 	_TunnelsInfo* tunnelproxyinfo = (_TunnelsInfo*)user_data;
+
+	if (!le_acceptallow(tunnelproxyinfo, fd, sa))
+		return;
+
+	if (tunnelproxyinfo->cache != NULL) {
+		le_httpaccept(tunnelproxyinfo, fd);
+		return;
+	}
+
+	if (tunnelproxyinfo->linkmode == _LINK_MODE::_LISTEN) {
+		le_muxaccept(tunnelproxyinfo, fd);
+		return;
+	}
+
+	if (vWorkers.size() == 0) {
+		le_relaystart(base, tunnelproxyinfo, fd);
+		return;
+	}
+
+	_AcceptInfo* acceptinfo = new _AcceptInfo;
+	acceptinfo->fd = fd;
+	acceptinfo->tunnelinfo = tunnelproxyinfo;
+	acceptinfo->worker = le_getworker();
+	acceptinfo->worker->connections++;
+
+	// hand the accepted socket to the worker loop, the pair is created in the worker thread
+	if (event_base_once(acceptinfo->worker->base, -1, EV_TIMEOUT, le_workeraccept_cb, (void*)acceptinfo, NULL) == -1) {
+		msglog(eMSGTYPE::ERROR, "%s event_base_once failed, %s (%d).", tunnelproxyinfo->name, __func__, __LINE__);
+		acceptinfo->worker->connections--;
+		evutil_closesocket(fd);
+		delete acceptinfo;
+	}
+}
+
+static void le_shardlistener_cb(struct evconnlistener* listener, evutil_socket_t fd,
+	struct sockaddr* sa, int socklen, void* user_data) {
+
+	_TunnelsInfo* tunnelproxyinfo = (_TunnelsInfo*)user_data;
+	_RelayWorker* worker = le_getworker(evconnlistener_get_base(listener));
+
+	if (!le_acceptallow(tunnelproxyinfo, fd, sa))
+		return;
+
+	worker->connections++;
+
+	if (!le_relaystart(worker->base, tunnelproxyinfo, fd)) {
+		worker->connections--;
+	}
+}
+
+static void le_workeraccept_cb(evutil_socket_t, short, void* arg)
+{
+	_AcceptInfo* acceptinfo = (_AcceptInfo*)arg;
+
+	if (!le_relaystart(acceptinfo->worker->base, acceptinfo->tunnelinfo, acceptinfo->fd)) {
+		acceptinfo->worker->connections--;
+	}
+
+	delete acceptinfo;
+}
+
+static bool le_relaystart(struct event_base* evbase, _TunnelsInfo* tunnelinfo, evutil_socket_t fd)
+{
 	struct bufferevent* proxy_bev;
 
-	proxy_bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE
+	tunnelinfo->stats.accepted++;
+	le_setsockopts(fd, tunnelinfo->sockopts);
+
+#ifdef __linux__
+	if (tunnelinfo->splice)
+		return le_splicestart(evbase, tunnelinfo, fd);
+#endif
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+	if (tunnelinfo->uring && le_uringloop(evbase) != NULL)
+		return le_uringstart(evbase, tunnelinfo, fd);
+#endif
+
+	proxy_bev = bufferevent_socket_new(evbase, fd, BEV_OPT_CLOSE_ON_FREE
 #ifdef _WIN32
 		| BEV_OPT_THREADSAFE
 #endif
+		| (le_ratelocked(tunnelinfo) ? BEV_OPT_THREADSAFE : 0)
 	);
 
 	if (!proxy_bev)
 	{
-		msglog(eMSGTYPE::ERROR, "%s bufferevent_socket_new failed, %s (%d).", tunnelproxyinfo->name, __func__, __LINE__);
-		return;
+		msglog(eMSGTYPE::ERROR, "%s bufferevent_socket_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		evutil_closesocket(fd);
+		return false;
+	}
+
+	msglog(eMSGTYPE::DEBUG, "%s Client connection accepted...", tunnelinfo->name);
+
+	_RelayPair* pair = le_pairnew(evbase, tunnelinfo);
+	pair->proxy_bev = proxy_bev;
+
+	if (tracesample > 0)
+		le_tracestart(pair, fd);
+
+	if (tunnelinfo->talkers != NULL && le_talkerkey(fd, pair->talkerkey))
+		le_talkeradd(tunnelinfo, pair->talkerkey, 0, 1, NULL);
+
+	// pooled connections aren't made for a client, a client hash tunnel always connects
+	if (tunnelinfo->balance == _BALANCE_TYPE::_CLIENT_HASH && tunnelinfo->vBackends.size() > 0) {
+		struct sockaddr_storage ss;
+		ev_socklen_t socklen = sizeof(ss);
+		if (getpeername(fd, (struct sockaddr*)&ss, &socklen) == 0)
+			pair->clienthash = le_clienthash((struct sockaddr*)&ss);
+		pair->local_bev = NULL;
 	}
+	else
+		pair->local_bev = le_poolget(evbase, tunnelinfo);
 
-	msglog(eMSGTYPE::DEBUG, "%s Client connection accepted...", tunnelproxyinfo->name);
+	if (pair->local_bev != NULL) {
+		if (pair->trace != NULL)
+			le_traceadd(pair->trace, _TRACE_EVENT::_POOLED);
+		if (tunnelinfo->proxyprotocol) {
+			_MuxOpen open;
+			le_proxyaddrs(fd, &open);
+			le_proxyheader(pair->local_bev, &open);
+		}
+		le_pairstart(pair);
+		return true;
+	}
 
-	bufferevent* local_bev = le_connect(host2ip(tunnelproxyinfo->local_serverip), tunnelproxyinfo->local_serverport);
+	// client data waits in the socket buffer until a local connect wins
+	pair->connectstart = le_nowusec();
+	bufferevent_setcb(proxy_bev, NULL, NULL, NULL, (void*)pair);
 
-	if (local_bev == NULL) {
+	if (!le_racestart(evbase, pair)) {
+		tunnelinfo->stats.errors++;
+		if (pair->trace != NULL)
+			le_traceadd(pair->trace, _TRACE_EVENT::_FAILED);
 		bufferevent_free(proxy_bev);
-		return;
+		le_pairfree(evbase, pair);
+		return false;
 	}
+	return true;
+}
+
+void le_pairstart(_RelayPair* pair)
+{
+	_TunnelsInfo* tunnelinfo = pair->tunnelinfo;
+	struct bufferevent* proxy_bev = pair->proxy_bev;
+
+	// write callbacks fire once a side's output drains below the low watermark
+	bufferevent_setcb(proxy_bev, le_readcb, le_writecb, le_eventcb, (void*)pair);
+	bufferevent_setcb(pair->local_bev, le_readcb, le_writecb, le_eventcb, (void*)pair);
 
-	bufferevent_setcb(proxy_bev, le_readcb, NULL, le_eventcb, (void*)local_bev);
-	bufferevent_setcb(local_bev, le_readcb, NULL, le_eventcb, (void*)proxy_bev);
+	if (tunnelinfo->highwatermark > 0) {
+		bufferevent_setwatermark(proxy_bev, EV_WRITE, tunnelinfo->lowwatermark, 0);
+		bufferevent_setwatermark(pair->local_bev, EV_WRITE, tunnelinfo->lowwatermark, 0);
+	}
 
+	if (tunnelinfo->readtimeout > 0 || tunnelinfo->writetimeout > 0) {
+		struct timeval rtv = { tunnelinfo->readtimeout, 0 };
+		struct timeval wtv = { tunnelinfo->writetimeout, 0 };
+		bufferevent_set_timeouts(proxy_bev, (tunnelinfo->readtimeout > 0) ? &rtv : NULL, (tunnelinfo->writetimeout > 0) ? &wtv : NULL);
+		bufferevent_set_timeouts(pair->local_bev, (tunnelinfo->readtimeout > 0) ? &rtv : NULL, (tunnelinfo->writetimeout > 0) ? &wtv : NULL);
+	}
 
 	bufferevent_enable(proxy_bev, EV_READ | EV_WRITE);
-	bufferevent_enable(local_bev, EV_READ | EV_WRITE);
+	bufferevent_enable(pair->local_bev, EV_READ | EV_WRITE);
+
+	if (bufferbudget > 0) {
+		evbuffer_add_cb(bufferevent_get_output(proxy_bev), le_outputcb, NULL);
+		evbuffer_add_cb(bufferevent_get_output(pair->local_bev), le_outputcb, NULL);
+	}
+
+	le_rateattach(pair);
+
+	if (tunnelinfo->vBackends.size() > 0) {
+		pair->backend = le_backendfind(tunnelinfo, bufferevent_getfd(pair->local_bev));
+		if (pair->backend)
+			pair->backend->active++;
+	}
+
+	std::vector<_RelayPair*>& vPairs = le_pairlist(bufferevent_get_base(proxy_bev));
+	pair->index = vPairs.size();
+	vPairs.push_back(pair);
+
+	tunnelinfo->stats.activepairs++;
+	relaypairs++;
+
+	// a pooled upstream may already hold data like a server banner
+	if (evbuffer_get_length(bufferevent_get_input(pair->local_bev)) > 0)
+		le_readcb(pair->local_bev, (void*)pair);
+#ifdef __linux__
+	le_sockmaparm(pair);
+#endif
 }
 
-struct bufferevent* le_connect(DWORD ip, WORD port)
+static bool le_racestart(struct event_base* evbase, _RelayPair* pair)
 {
-	struct sockaddr_in remote_address;
-	int result;
+	_ConnectRace* race = new _ConnectRace;
+	race->base = evbase;
+	race->pair = pair;
+	race->next = 0;
+	race->timer = NULL;
 
-	struct bufferevent* _bev = bufferevent_socket_new(base, -1,
-		BEV_OPT_CLOSE_ON_FREE
-#ifdef _WIN32
-		| BEV_OPT_THREADSAFE
-#endif
-	);
+	if (!le_getlocaladdrs(pair->tunnelinfo, race->vAddrs, pair->clienthash)) {
+		delete race;
+		return false;
+	}
 
-	if (!_bev) {
-		msglog(eMSGTYPE::ERROR, "bufferevent_socket_new failed, %s (%d).", __func__, __LINE__);
-		return NULL;
+	if (pair->trace != NULL)
+		le_traceadd(pair->trace, _TRACE_EVENT::_ADDRS);
+
+	if (race->vAddrs.size() > 1)
+		race->timer = event_new(evbase, -1, 0, le_racetimer_cb, (void*)race);
+
+	le_racenext(race);
+
+	if (race->vAttempts.size() == 0) {
+		le_racefree(race);
+		return false;
 	}
+	return true;
+}
 
-	remote_address.sin_family = AF_INET;
-	remote_address.sin_addr.s_addr = htonl(ip);
-	remote_address.sin_port = htons(port);
+// starts the next candidate, the rest follow every RACE_DELAY_MSEC or as soon as an attempt fails
+static void le_racenext(_ConnectRace* race)
+{
+	while (race->next < race->vAddrs.size()) {
+		_AddrInfo& addrinfo = race->vAddrs[race->next++];
+		struct bufferevent* _bev = le_connect(race->base, (struct sockaddr*)&addrinfo.addr, addrinfo.addrlen, le_ratelocked(race->pair->tunnelinfo), &race->pair->tunnelinfo->sockopts);
 
-	result = bufferevent_socket_connect(_bev, (struct sockaddr*)&remote_address, sizeof(remote_address));
+		if (_bev == NULL)
+			continue;
 
-	if (result == -1) {
-		msglog(eMSGTYPE::ERROR, "bufferevent_socket_connect failed, %s (%d).", __func__, __LINE__);
-		return NULL;
+		bufferevent_setcb(_bev, NULL, NULL, le_raceeventcb, (void*)race);
+		if (race->pair->tunnelinfo->connecttimeout > 0) {
+			struct timeval tv = { race->pair->tunnelinfo->connecttimeout, 0 };
+			bufferevent_set_timeouts(_bev, NULL, &tv);
+		}
+		race->vAttempts.push_back(_bev);
+		if (race->pair->trace != NULL)
+			le_traceadd(race->pair->trace, _TRACE_EVENT::_CONNECT);
+
+		if (race->timer && race->next < race->vAddrs.size()) {
+			struct timeval tv = { 0, RACE_DELAY_MSEC * 1000 };
+			event_add(race->timer, &tv);
+		}
+		return;
 	}
-	return _bev;
 }
 
+static void le_racefree(_ConnectRace* race)
+{
+	for (size_t n = 0; n < race->vAttempts.size(); n++)
+		bufferevent_free(race->vAttempts[n]);
+	if (race->timer)
+		event_free(race->timer);
+	delete race;
+}
 
-static void
-le_readcb(struct bufferevent* bev, void* user_data)
+static void le_racetimer_cb(evutil_socket_t, short, void* arg)
 {
-	bufferevent* _bev = (bufferevent*)user_data;
-	if (bufferevent_read_buffer(bev, bufferevent_get_output(_bev)) == -1) {
-		msglog(eMSGTYPE::ERROR, "bufferevent_read_buffer failed, %s (%d).", __func__, __LINE__);
+	le_racenext((_ConnectRace*)arg);
+}
+
+static void le_raceeventcb(struct bufferevent* bev, short events, void* user_data)
+{
+	_ConnectRace* race = (_ConnectRace*)user_data;
+	_RelayPair* pair = race->pair;
+
+	std::vector<struct bufferevent*>::iterator iter = std::find(race->vAttempts.begin(), race->vAttempts.end(), bev);
+	if (iter != race->vAttempts.end())
+		race->vAttempts.erase(iter);
+
+	if (events & BEV_EVENT_CONNECTED) {
+		struct sockaddr_storage ss;
+		ev_socklen_t socklen = sizeof(ss);
+		if (getpeername(bufferevent_getfd(bev), (struct sockaddr*)&ss, &socklen) == 0)
+			pair->tunnelinfo->preferfamily = ss.ss_family;
+
+		le_statsconnected(pair->tunnelinfo, pair->connectstart);
+		le_breakerresult(pair->tunnelinfo, true);
+		pair->connectstart = 0;
+		pair->local_bev = bev;
+		le_racefree(race);
+		// le_pairstart sets the relay timeouts of its own
+		if (pair->tunnelinfo->connecttimeout > 0)
+			bufferevent_set_timeouts(bev, NULL, NULL);
+		if (pair->trace != NULL)
+			le_traceadd(pair->trace, _TRACE_EVENT::_CONNECTED);
+		if (pair->tunnelinfo->proxyprotocol) {
+			_MuxOpen open;
+			le_proxyaddrs(bufferevent_getfd(pair->proxy_bev), &open);
+			le_proxyheader(bev, &open);
+		}
+		le_pairstart(pair);
+		return;
+	}
+
+	bufferevent_free(bev);
+
+	if (race->vAttempts.size() == 0)
+		le_racenext(race);
+
+	if (race->vAttempts.size() == 0) {
+		msglog(eMSGTYPE::ERROR, "%s connect to local server %s failed, %s (%d).", pair->tunnelinfo->name, pair->tunnelinfo->local_serverip, __func__, __LINE__);
+		le_breakerresult(pair->tunnelinfo, false);
+
+		_RelayWorker* worker = le_getworker(race->base);
+		if (worker != NULL)
+			worker->connections--;
+
+		pair->tunnelinfo->stats.errors++;
+		if (pair->trace != NULL)
+			le_traceadd(pair->trace, _TRACE_EVENT::_FAILED);
+		bufferevent_free(pair->proxy_bev);
+		le_pairfree(race->base, pair);
+		le_racefree(race);
 	}
 }
 
-static void
-le_eventcb(struct bufferevent* bev, short events, void* user_data)
+// the address a client connected from and the one it connected to, family 0 for a unix socket or a failed lookup
+void le_proxyaddrs(evutil_socket_t fd, _MuxOpen* open)
 {
-	bufferevent* _bev = (bufferevent*)user_data;
-	if (events & BEV_EVENT_EOF || events & BEV_EVENT_ERROR)
-	{
-		bufferevent_free(bev);
-		bufferevent_free(_bev);
-		msglog(eMSGTYPE::DEBUG, "Proxy disconnected.");
+	struct sockaddr_storage src, dst;
+	ev_socklen_t srclen = sizeof(src), dstlen = sizeof(dst);
+
+	memset(open, 0, sizeof(*open));
+	if (getpeername(fd, (struct sockaddr*)&src, &srclen) != 0 || getsockname(fd, (struct sockaddr*)&dst, &dstlen) != 0
+		|| src.ss_family != dst.ss_family)
+		return;
+
+	if (src.ss_family == AF_INET) {
+		open->family = 4;
+		open->srcport = ((struct sockaddr_in*)&src)->sin_port;
+		open->dstport = ((struct sockaddr_in*)&dst)->sin_port;
+		memcpy(open->src, &((struct sockaddr_in*)&src)->sin_addr, 4);
+		memcpy(open->dst, &((struct sockaddr_in*)&dst)->sin_addr, 4);
 	}
-	else if (events & BEV_EVENT_CONNECTED)
+	else if (src.ss_family == AF_INET6) {
+		open->family = 6;
+		open->srcport = ((struct sockaddr_in6*)&src)->sin6_port;
+		open->dstport = ((struct sockaddr_in6*)&dst)->sin6_port;
+		memcpy(open->src, &((struct sockaddr_in6*)&src)->sin6_addr, 16);
+		memcpy(open->dst, &((struct sockaddr_in6*)&dst)->sin6_addr, 16);
+	}
+}
+
+// queues a binary PROXY protocol v2 header ahead of anything the client sends, an unknown address is sent
+// as a LOCAL header the local server takes as a connection of its own
+void le_proxyheader(struct bufferevent* bev, const _MuxOpen* open)
+{
+	static const BYTE signature[12] = { 0x0D, 0x0A, 0x0D, 0x0A, 0x00, 0x0D, 0x0A, 0x51, 0x55, 0x49, 0x54, 0x0A };
+	BYTE header[16 + 36];
+	size_t addrlen = 0;
+
+	memcpy(header, signature, sizeof(signature));
+	header[12] = 0x20;	// version 2, LOCAL
+	header[13] = 0x00;	// UNSPEC
+
+	if (open != NULL && (open->family == 4 || open->family == 6)) {
+		size_t iplen = (open->family == 4) ? 4 : 16;
+		header[12] = 0x21;	// PROXY
+		header[13] = (open->family == 4) ? 0x11 : 0x21;	// TCP over IPv4 or IPv6
+		memcpy(header + 16, open->src, iplen);
+		memcpy(header + 16 + iplen, open->dst, iplen);
+		memcpy(header + 16 + iplen * 2, &open->srcport, sizeof(WORD));
+		memcpy(header + 16 + iplen * 2 + sizeof(WORD), &open->dstport, sizeof(WORD));
+		addrlen = iplen * 2 + sizeof(WORD) * 2;
+	}
+
+	header[14] = (BYTE)(addrlen >> 8);
+	header[15] = (BYTE)addrlen;
+	evbuffer_add(bufferevent_get_output(bev), header, 16 + addrlen);
+}
+
+// resolves the local server once at startup, names are refreshed with evdns so the relay never blocks on DNS
+static bool le_resolve(_TunnelsInfo* tunnelinfo)
+{
+	struct evutil_addrinfo hints, *res = NULL;
+	char port[8];
+	struct in6_addr literal;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	sprintf(port, "%d", tunnelinfo->local_serverport);
+
+	int result = evutil_getaddrinfo(tunnelinfo->local_serverip, port, &hints, &res);
+	if (result == 0 && res != NULL) {
+		le_setlocaladdrs(tunnelinfo, res);
+		evutil_freeaddrinfo(res);
+	}
+	else {
+		msglog(eMSGTYPE::ERROR, "%s failed to resolve %s, %s, %s (%d).", tunnelinfo->name, tunnelinfo->local_serverip,
+			evutil_gai_strerror(result), __func__, __LINE__);
+	}
+
+	if (tunnelinfo->dnsrefresh <= 0 || evutil_inet_pton(AF_INET, tunnelinfo->local_serverip, &literal) == 1
+		|| evutil_inet_pton(AF_INET6, tunnelinfo->local_serverip, &literal) == 1)
+		return (result == 0);
+
+	if (dnsbase == NULL) {
+		dnsbase = evdns_base_new(base, EVDNS_BASE_INITIALIZE_NAMESERVERS);
+		if (dnsbase == NULL) {
+			msglog(eMSGTYPE::ERROR, "evdns_base_new failed, %s (%d).", __func__, __LINE__);
+			return (result == 0);
+		}
+	}
+
+	struct timeval tv = { tunnelinfo->dnsrefresh, 0 };
+	tunnelinfo->dnstimer = event_new(base, -1, EV_PERSIST, le_dnstimer_cb, (void*)tunnelinfo);
+	event_add(tunnelinfo->dnstimer, &tv);
+
+	return (result == 0);
+}
+
+static void le_dnstimer_cb(evutil_socket_t, short, void* arg)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)arg;
+	struct evutil_addrinfo hints;
+	char port[8];
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	sprintf(port, "%d", tunnelinfo->local_serverport);
+
+	evdns_getaddrinfo(dnsbase, tunnelinfo->local_serverip, port, &hints, le_dns_cb, (void*)tunnelinfo);
+}
+
+static void le_dns_cb(int result, struct evutil_addrinfo* res, void* arg)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)arg;
+
+	if (result != 0 || res == NULL) {
+		// keep the last good address
+		if (result != EVUTIL_EAI_CANCEL)
+			msglog(eMSGTYPE::ERROR, "%s failed to refresh %s, %s, %s (%d).", tunnelinfo->name, tunnelinfo->local_serverip,
+				evutil_gai_strerror(result), __func__, __LINE__);
+		return;
+	}
+
+	le_setlocaladdrs(tunnelinfo, res);
+	evutil_freeaddrinfo(res);
+}
+
+static void le_setlocaladdrs(_TunnelsInfo* tunnelinfo, struct evutil_addrinfo* res)
+{
+	std::vector<_AddrInfo> vAddrs;
+
+	for (struct evutil_addrinfo* ai = res; ai != NULL && vAddrs.size() < MAX_RACE_ADDRS; ai = ai->ai_next) {
+		if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6)
+			continue;
+		_AddrInfo addrinfo;
+		memcpy(&addrinfo.addr, ai->ai_addr, ai->ai_addrlen);
+		addrinfo.addrlen = (int)ai->ai_addrlen;
+		vAddrs.push_back(addrinfo);
+	}
+
+	std::lock_guard<std::mutex> lock(tunnelinfo->addrlock);
+	tunnelinfo->vLocalAddrs.swap(vAddrs);
+}
+
+// candidates alternate between families, starting with the family that won last
+static bool le_getlocaladdrs(_TunnelsInfo* tunnelinfo, std::vector<_AddrInfo>& vAddrs, unsigned int clienthash)
+{
+	if (tunnelinfo->vBackends.size() > 0)
+		return le_backendaddrs(tunnelinfo, vAddrs, clienthash);
+
+	std::vector<_AddrInfo> vPreferred, vOther;
 	{
+		std::lock_guard<std::mutex> lock(tunnelinfo->addrlock);
+		if (tunnelinfo->vLocalAddrs.size() == 0) {
+			msglog(eMSGTYPE::ERROR, "%s local server %s is not resolved, %s (%d).", tunnelinfo->name, tunnelinfo->local_serverip, __func__, __LINE__);
+			return false;
+		}
+
+		int family = tunnelinfo->preferfamily;
+		if (family == AF_UNSPEC)
+			family = tunnelinfo->vLocalAddrs[0].addr.ss_family;
+
+		for (size_t n = 0; n < tunnelinfo->vLocalAddrs.size(); n++) {
+			if (tunnelinfo->vLocalAddrs[n].addr.ss_family == family)
+				vPreferred.push_back(tunnelinfo->vLocalAddrs[n]);
+			else
+				vOther.push_back(tunnelinfo->vLocalAddrs[n]);
+		}
+	}
+
+	vAddrs.clear();
+	for (size_t n = 0; n < vPreferred.size() || n < vOther.size(); n++) {
+		if (n < vPreferred.size())
+			vAddrs.push_back(vPreferred[n]);
+		if (n < vOther.size())
+			vAddrs.push_back(vOther[n]);
 	}
+	return true;
+}
+
+bool le_getlocaladdr(_TunnelsInfo* tunnelinfo, struct sockaddr_storage* ss, int* socklen, unsigned int clienthash)
+{
+	std::vector<_AddrInfo> vAddrs;
+
+	if (!le_getlocaladdrs(tunnelinfo, vAddrs, clienthash))
+		return false;
+
+	memcpy(ss, &vAddrs[0].addr, vAddrs[0].addrlen);
+	*socklen = vAddrs[0].addrlen;
+	return true;
+}
+
+// backends are resolved once, a name that doesn't resolve stays down until a reload
+static void le_backendstart(_TunnelsInfo* tunnelinfo)
+{
+	struct evutil_addrinfo hints, *res = NULL;
+	char port[8];
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = tunnelinfo->udp ? SOCK_DGRAM : SOCK_STREAM;
+
+	for (size_t n = 0; n < tunnelinfo->vBackends.size(); n++) {
+		_Backend* backend = tunnelinfo->vBackends[n];
+		sprintf(port, "%d", backend->port);
+
+		int result = evutil_getaddrinfo(backend->ip, port, &hints, &res);
+		if (result != 0 || res == NULL) {
+			msglog(eMSGTYPE::ERROR, "%s failed to resolve %s, %s, %s (%d).", tunnelinfo->name, backend->ip,
+				evutil_gai_strerror(result), __func__, __LINE__);
+			backend->up = false;
+			continue;
+		}
+
+		for (struct evutil_addrinfo* ai = res; ai != NULL && backend->vAddrs.size() < MAX_RACE_ADDRS; ai = ai->ai_next) {
+			if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6)
+				continue;
+			_AddrInfo addrinfo;
+			memcpy(&addrinfo.addr, ai->ai_addr, ai->ai_addrlen);
+			addrinfo.addrlen = (int)ai->ai_addrlen;
+			backend->vAddrs.push_back(addrinfo);
+		}
+		evutil_freeaddrinfo(res);
+
+		for (int i = 0; i < BACKEND_VNODES; i++) {
+			unsigned int hash = le_hash(port, strlen(port), le_hash(backend->ip, strlen(backend->ip)));
+			tunnelinfo->vHashRing.push_back(std::make_pair(le_hash(&i, sizeof(i), hash), (int)n));
+		}
+	}
+
+	std::sort(tunnelinfo->vHashRing.begin(), tunnelinfo->vHashRing.end());
+
+	msglog(eMSGTYPE::INFO, "%s Balancing %d local servers by %s.", tunnelinfo->name, (int)tunnelinfo->vBackends.size(),
+		(tunnelinfo->balance == _BALANCE_TYPE::_CLIENT_HASH) ? "client hash" : "least connections");
+
+	if (tunnelinfo->healthcheck <= 0 || tunnelinfo->udp)
+		return;
+
+	struct timeval tv = { tunnelinfo->healthcheck, 0 };
+	tunnelinfo->healthtimer = event_new(base, -1, EV_PERSIST, le_healthtimer_cb, (void*)tunnelinfo);
+	event_add(tunnelinfo->healthtimer, &tv);
+	le_healthtimer_cb(-1, EV_TIMEOUT, (void*)tunnelinfo);
+}
+
+static void le_backendstop(_TunnelsInfo* tunnelinfo)
+{
+	if (tunnelinfo->healthtimer)
+		event_free(tunnelinfo->healthtimer);
+	tunnelinfo->healthtimer = NULL;
+
+	for (size_t n = 0; n < tunnelinfo->vBackends.size(); n++) {
+		if (tunnelinfo->vBackends[n]->checkbev)
+			bufferevent_free(tunnelinfo->vBackends[n]->checkbev);
+		delete tunnelinfo->vBackends[n];
+	}
+	tunnelinfo->vBackends.clear();
+	tunnelinfo->vHashRing.clear();
+}
+
+// the chosen backend's addresses come first, the race falls over to the next backends when they fail
+static bool le_backendaddrs(_TunnelsInfo* tunnelinfo, std::vector<_AddrInfo>& vAddrs, unsigned int clienthash)
+{
+	std::vector<int> vOrder;
+	size_t count = tunnelinfo->vBackends.size();
+
+	if (tunnelinfo->balance == _BALANCE_TYPE::_CLIENT_HASH && tunnelinfo->vHashRing.size() > 0) {
+		std::vector<std::pair<unsigned int, int>>::iterator iter = std::lower_bound(tunnelinfo->vHashRing.begin(),
+			tunnelinfo->vHashRing.end(), std::make_pair(clienthash, 0));
+
+		for (size_t n = 0; n < tunnelinfo->vHashRing.size() && vOrder.size() < count; n++, iter++) {
+			if (iter == tunnelinfo->vHashRing.end())
+				iter = tunnelinfo->vHashRing.begin();
+			if (std::find(vOrder.begin(), vOrder.end(), iter->second) == vOrder.end())
+				vOrder.push_back(iter->second);
+		}
+	}
+	else {
+		for (size_t n = 0; n < count; n++)
+			vOrder.push_back((int)n);
+	}
+
+	// backends failing their check are only tried when none pass
+	std::vector<int>::iterator down = std::stable_partition(vOrder.begin(), vOrder.end(),
+		[tunnelinfo](int n) { return (bool)tunnelinfo->vBackends[n]->up; });
+	if (down != vOrder.begin())
+		vOrder.erase(down, vOrder.end());
+
+	// ties rotate so idle backends take turns
+	if (tunnelinfo->balance == _BALANCE_TYPE::_LEAST_CONNECTIONS) {
+		std::rotate(vOrder.begin(), vOrder.begin() + (tunnelinfo->nextbackend++ % vOrder.size()), vOrder.end());
+		std::stable_sort(vOrder.begin(), vOrder.end(), [tunnelinfo](int a, int b) {
+			return tunnelinfo->vBackends[a]->active < tunnelinfo->vBackends[b]->active;
+		});
+	}
+
+	vAddrs.clear();
+	for (size_t n = 0; n < vOrder.size(); n++)
+		vAddrs.insert(vAddrs.end(), tunnelinfo->vBackends[vOrder[n]]->vAddrs.begin(), tunnelinfo->vBackends[vOrder[n]]->vAddrs.end());
+
+	if (vAddrs.size() == 0) {
+		msglog(eMSGTYPE::ERROR, "%s no local server is resolved, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		return false;
+	}
+	return true;
+}
+
+static _Backend* le_backendfind(_TunnelsInfo* tunnelinfo, evutil_socket_t fd)
+{
+	struct sockaddr_storage ss;
+	ev_socklen_t socklen = sizeof(ss);
+
+	if (getpeername(fd, (struct sockaddr*)&ss, &socklen) != 0)
+		return NULL;
+
+	for (size_t n = 0; n < tunnelinfo->vBackends.size(); n++) {
+		_Backend* backend = tunnelinfo->vBackends[n];
+		for (size_t i = 0; i < backend->vAddrs.size(); i++) {
+			struct sockaddr* sa = (struct sockaddr*)&backend->vAddrs[i].addr;
+			if (sa->sa_family != ss.ss_family)
+				continue;
+			if (sa->sa_family == AF_INET6) {
+				struct sockaddr_in6* a = (struct sockaddr_in6*)sa;
+				struct sockaddr_in6* b = (struct sockaddr_in6*)&ss;
+				if (a->sin6_port == b->sin6_port && memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr)) == 0)
+					return backend;
+			}
+			else {
+				struct sockaddr_in* a = (struct sockaddr_in*)sa;
+				struct sockaddr_in* b = (struct sockaddr_in*)&ss;
+				if (a->sin_port == b->sin_port && a->sin_addr.s_addr == b->sin_addr.s_addr)
+					return backend;
+			}
+		}
+	}
+	return NULL;
+}
+
+static void le_healthtimer_cb(evutil_socket_t, short, void* arg)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)arg;
+	_LoopBusy busy("health check of proxy port", tunnelinfo->proxyport);
+	struct timeval tv = { HEALTH_TIMEOUT_MSEC / 1000, (HEALTH_TIMEOUT_MSEC % 1000) * 1000 };
+
+	for (size_t n = 0; n < tunnelinfo->vBackends.size(); n++) {
+		_Backend* backend = tunnelinfo->vBackends[n];
+
+		if (backend->checkbev != NULL || backend->vAddrs.size() == 0)
+			continue;
+
+		backend->checkbev = le_connect(base, (struct sockaddr*)&backend->vAddrs[0].addr, backend->vAddrs[0].addrlen);
+		if (backend->checkbev == NULL)
+			continue;
+
+		bufferevent_setcb(backend->checkbev, NULL, NULL, le_healtheventcb, (void*)backend);
+		bufferevent_set_timeouts(backend->checkbev, NULL, &tv);
+	}
+}
+
+static void le_healtheventcb(struct bufferevent* bev, short events, void* user_data)
+{
+	_Backend* backend = (_Backend*)user_data;
+	bool up = (events & BEV_EVENT_CONNECTED) != 0;
+
+	bufferevent_free(bev);
+	backend->checkbev = NULL;
+
+	if (up != backend->up)
+		msglog(eMSGTYPE::INFO, "%s Local server %s port %d is %s.", backend->tunnelinfo->name, backend->ip, backend->port, up ? "up" : "down");
+	backend->up = up;
+}
+
+// FNV-1a with a final mix, addresses differing in the last byte land far apart on the ring
+static unsigned int le_hash(const void* data, size_t len, unsigned int hash)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t n = 0; n < len; n++) {
+		hash ^= p[n];
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+// the port is left out so every connection of a client lands on the same backend
+unsigned int le_clienthash(const struct sockaddr* sa)
+{
+	if (sa->sa_family == AF_INET6)
+		return le_hash(&((struct sockaddr_in6*)sa)->sin6_addr, sizeof(struct in6_addr));
+	return le_hash(&((struct sockaddr_in*)sa)->sin_addr, sizeof(struct in_addr));
+}
+
+static void le_startpools(_TunnelsInfo* tunnelinfo)
+{
+	if (tunnelinfo->minidle <= 0 || tunnelinfo->splice || tunnelinfo->uring || tunnelinfo->rio
+		|| (tunnelinfo->balance == _BALANCE_TYPE::_CLIENT_HASH && tunnelinfo->vBackends.size() > 0))
+		return;
+
+	size_t count = (vWorkers.size() > 0) ? vWorkers.size() : 1;
+
+	for (size_t n = 0; n < count; n++) {
+		_UpstreamPool* pool = new _UpstreamPool;
+		pool->base = (vWorkers.size() > 0) ? vWorkers[n]->base : base;
+		pool->tunnelinfo = tunnelinfo;
+		pool->target = tunnelinfo->minidle;
+		pool->gen = tunnelinfo->localgen;
+
+		struct timeval tv = { POOL_TIMER_MSEC / 1000, (POOL_TIMER_MSEC % 1000) * 1000 };
+		pool->timer = event_new(pool->base, -1, EV_PERSIST, le_pooltimer_cb, (void*)pool);
+		event_add(pool->timer, &tv);
+
+		// first fill runs on the pool's own loop
+		event_active(pool->timer, EV_TIMEOUT, 0);
+
+		tunnelinfo->vPools.push_back(pool);
+	}
+
+	msglog(eMSGTYPE::DEBUG, "%s Upstream pool min idle %d max idle %d.", tunnelinfo->name, tunnelinfo->minidle, tunnelinfo->maxidle);
+}
+
+static void le_freepools(_TunnelsInfo* tunnelinfo)
+{
+	for (size_t n = 0; n < tunnelinfo->vPools.size(); n++) {
+		_UpstreamPool* pool = tunnelinfo->vPools[n];
+		event_free(pool->timer);
+		for (size_t i = 0; i < pool->vIdle.size(); i++)
+			bufferevent_free(pool->vIdle[i]);
+		for (size_t i = 0; i < pool->vConnecting.size(); i++)
+			bufferevent_free(pool->vConnecting[i]);
+		delete pool;
+	}
+	tunnelinfo->vPools.clear();
+}
+
+bufferevent* le_poolget(struct event_base* evbase, _TunnelsInfo* tunnelinfo)
+{
+	for (size_t n = 0; n < tunnelinfo->vPools.size(); n++) {
+		_UpstreamPool* pool = tunnelinfo->vPools[n];
+
+		if (pool->base != evbase)
+			continue;
+
+		if (pool->gen != tunnelinfo->localgen)
+			le_pooldrain(pool);
+
+		pool->accepts++;
+
+		if (pool->vIdle.size() == 0) {
+			tunnelinfo->stats.poolmisses++;
+			pool->missed = true;
+			if (pool->target < tunnelinfo->maxidle)
+				pool->target++;
+			le_poolfill(pool);
+			return NULL;
+		}
+
+		tunnelinfo->stats.poolhits++;
+		bufferevent* _bev = pool->vIdle.back();
+		pool->vIdle.pop_back();
+		le_poolfill(pool);
+		return _bev;
+	}
+	return NULL;
+}
+
+static void le_poolfill(_UpstreamPool* pool)
+{
+	struct sockaddr_storage ss;
+	int socklen;
+
+	if (!le_getlocaladdr(pool->tunnelinfo, &ss, &socklen))
+		return;
+
+	while ((int)(pool->vIdle.size() + pool->vConnecting.size()) < pool->target) {
+		bufferevent* _bev = le_connect(pool->base, (struct sockaddr*)&ss, socklen, le_ratelocked(pool->tunnelinfo), &pool->tunnelinfo->sockopts);
+
+		if (_bev == NULL)
+			return;
+
+		bufferevent_setcb(_bev, NULL, NULL, le_pooleventcb, (void*)pool);
+		bufferevent_enable(_bev, EV_READ);
+		pool->vConnecting.push_back(_bev);
+	}
+}
+
+static void le_pooltimer_cb(evutil_socket_t, short, void* arg)
+{
+	_UpstreamPool* pool = (_UpstreamPool*)arg;
+	_TunnelsInfo* tunnelinfo = pool->tunnelinfo;
+
+	if (pool->gen != tunnelinfo->localgen || tunnelinfo->retired)
+		le_pooldrain(pool);
+
+	if (tunnelinfo->retired) {
+		event_del(pool->timer);
+		return;
+	}
+
+	pool->acceptrate = POOL_RATE_WEIGHT * (pool->accepts * 1000.0 / POOL_TIMER_MSEC) + (1 - POOL_RATE_WEIGHT) * pool->acceptrate;
+	pool->accepts = 0;
+
+	// clients expected before a refill started now is connected, the pool is grown to cover them ahead of demand
+	unsigned long long connects = tunnelinfo->stats.connects;
+	double connectsec = (connects > 0) ? tunnelinfo->stats.connectusec / (connects * 1000000.0) : 0;
+	int predicted = (int)std::ceil(pool->acceptrate * (POOL_TIMER_MSEC / 1000.0 + connectsec));
+	predicted = std::min(std::max(predicted, tunnelinfo->minidle), tunnelinfo->maxidle);
+
+	if (predicted > pool->target) {
+		pool->target = predicted;
+		pool->quietticks = 0;
+	}
+
+	// misses grow the target too, shrink back toward the prediction after a quiet period
+	if (pool->missed) {
+		pool->missed = false;
+		pool->quietticks = 0;
+	}
+	else if (pool->target > predicted && ++pool->quietticks >= POOL_SHRINK_TICKS) {
+		pool->target--;
+		pool->quietticks = 0;
+		if ((int)pool->vIdle.size() > pool->target) {
+			bufferevent_free(pool->vIdle.front());
+			pool->vIdle.erase(pool->vIdle.begin());
+		}
+	}
+
+	le_poolfill(pool);
+}
+
+// connections made for an older local server or a retired tunnel
+static void le_pooldrain(_UpstreamPool* pool)
+{
+	for (size_t i = 0; i < pool->vIdle.size(); i++)
+		bufferevent_free(pool->vIdle[i]);
+	pool->vIdle.clear();
+	for (size_t i = 0; i < pool->vConnecting.size(); i++)
+		bufferevent_free(pool->vConnecting[i]);
+	pool->vConnecting.clear();
+	pool->gen = pool->tunnelinfo->localgen;
+}
+
+static void le_pooleventcb(struct bufferevent* bev, short events, void* user_data)
+{
+	_UpstreamPool* pool = (_UpstreamPool*)user_data;
+	std::vector<bufferevent*>::iterator iter = std::find(pool->vConnecting.begin(), pool->vConnecting.end(), bev);
+
+	if (events & BEV_EVENT_CONNECTED) {
+		if (iter != pool->vConnecting.end())
+			pool->vConnecting.erase(iter);
+		pool->vIdle.push_back(bev);
+		return;
+	}
+
+	if (events & BEV_EVENT_EOF || events & BEV_EVENT_ERROR) {
+		// refilled on the next pool tick so a down server isn't hammered
+		if (iter != pool->vConnecting.end())
+			pool->vConnecting.erase(iter);
+		else {
+			iter = std::find(pool->vIdle.begin(), pool->vIdle.end(), bev);
+			if (iter != pool->vIdle.end())
+				pool->vIdle.erase(iter);
+		}
+		bufferevent_free(bev);
+		msglog(eMSGTYPE::DEBUG, "%s Pooled upstream closed.", pool->tunnelinfo->name);
+	}
+}
+
+// a nonblocking TCP socket for sa with the options set, they have to be in place before connect
+evutil_socket_t le_socket(const struct sockaddr* sa, const _SockOpts* opts)
+{
+	evutil_socket_t fd = socket(sa->sa_family, SOCK_STREAM, 0);
+
+	if (fd == EVUTIL_INVALID_SOCKET) {
+		msglog(eMSGTYPE::ERROR, "socket failed, %s (%d).", __func__, __LINE__);
+		return EVUTIL_INVALID_SOCKET;
+	}
+
+	evutil_make_socket_nonblocking(fd);
+	evutil_make_socket_closeonexec(fd);
+	if (opts != NULL)
+		le_setsockopts(fd, *opts);
+	return fd;
+}
+
+struct bufferevent* le_connect(struct event_base* evbase, const struct sockaddr* sa, int socklen, bool threadsafe, const _SockOpts* opts)
+{
+	int result;
+
+	evutil_socket_t fd = le_socket(sa, opts);
+
+	if (fd == EVUTIL_INVALID_SOCKET)
+		return NULL;
+
+	struct bufferevent* _bev = bufferevent_socket_new(evbase, fd,
+		BEV_OPT_CLOSE_ON_FREE
+#ifdef _WIN32
+		| BEV_OPT_THREADSAFE
+#endif
+		| (threadsafe ? BEV_OPT_THREADSAFE : 0)
+	);
+
+	if (!_bev) {
+		msglog(eMSGTYPE::ERROR, "bufferevent_socket_new failed, %s (%d).", __func__, __LINE__);
+		evutil_closesocket(fd);
+		return NULL;
+	}
+
+	result = bufferevent_socket_connect(_bev, sa, socklen);
+
+	if (result == -1) {
+		msglog(eMSGTYPE::ERROR, "bufferevent_socket_connect failed, %s (%d).", __func__, __LINE__);
+		bufferevent_free(_bev);
+		return NULL;
+	}
+	return _bev;
+}
+
+static void le_loadsockopts(const YAML::Node& node, _SockOpts& opts)
+{
+	if (node["No Delay"])
+		opts.nodelay = node["No Delay"].as<bool>();
+	if (node["Keepalive Idle"])
+		opts.keepidle = node["Keepalive Idle"].as<int>();
+	if (node["Keepalive Interval"])
+		opts.keepintvl = node["Keepalive Interval"].as<int>();
+	if (node["Keepalive Count"])
+		opts.keepcnt = node["Keepalive Count"].as<int>();
+	if (node["Send Buffer"])
+		opts.sndbuf = node["Send Buffer"].as<int>();
+	if (node["Receive Buffer"])
+		opts.rcvbuf = node["Receive Buffer"].as<int>();
+	if (node["User Timeout"])
+		opts.usertimeout = node["User Timeout"].as<int>();
+	if (node["Fast Open"])
+		opts.fastopen = node["Fast Open"].as<int>();
+	if (node["Quick Ack"])
+		opts.quickack = node["Quick Ack"].as<bool>();
+	if (node["Busy Poll"])
+		opts.busypoll = node["Busy Poll"].as<int>();
+	if (node["Not Sent Low Water"])
+		opts.notsentlowat = node["Not Sent Low Water"].as<int>();
+	if (node["Congestion"])
+		strncpy(opts.congestion, node["Congestion"].as<std::string>().c_str(), sizeof(opts.congestion) - 1);
+}
+
+// what the system does not know is skipped, a refused option leaves the default and the socket is used anyway
+void le_setsockopts(evutil_socket_t fd, const _SockOpts& opts)
+{
+	int on = 1;
+
+	if (opts.nodelay)
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+
+	if (opts.keepidle > 0) {
+		setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (const char*)&on, sizeof(on));
+#if defined(TCP_KEEPIDLE)
+		setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, (const char*)&opts.keepidle, sizeof(opts.keepidle));
+#elif defined(TCP_KEEPALIVE)
+		setsockopt(fd, IPPROTO_TCP, TCP_KEEPALIVE, (const char*)&opts.keepidle, sizeof(opts.keepidle));
+#endif
+#ifdef TCP_KEEPINTVL
+		if (opts.keepintvl > 0)
+			setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, (const char*)&opts.keepintvl, sizeof(opts.keepintvl));
+#endif
+#ifdef TCP_KEEPCNT
+		if (opts.keepcnt > 0)
+			setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, (const char*)&opts.keepcnt, sizeof(opts.keepcnt));
+#endif
+	}
+
+	if (opts.sndbuf > 0)
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (const char*)&opts.sndbuf, sizeof(opts.sndbuf));
+	if (opts.rcvbuf > 0)
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char*)&opts.rcvbuf, sizeof(opts.rcvbuf));
+
+#ifdef TCP_USER_TIMEOUT
+	if (opts.usertimeout > 0)
+		setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, (const char*)&opts.usertimeout, sizeof(opts.usertimeout));
+#endif
+	// the kernel falls back to delayed acks on its own, this only covers the start of the connection
+#ifdef TCP_QUICKACK
+	if (opts.quickack)
+		setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, (const char*)&on, sizeof(on));
+#endif
+#ifdef SO_BUSY_POLL
+	if (opts.busypoll > 0)
+		setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, (const char*)&opts.busypoll, sizeof(opts.busypoll));
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+	if (opts.notsentlowat > 0)
+		setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, (const char*)&opts.notsentlowat, sizeof(opts.notsentlowat));
+#endif
+	// a module that is not loaded or not in net.ipv4.tcp_allowed_congestion_control is refused
+#ifdef TCP_CONGESTION
+	if (opts.congestion[0] != 0)
+		setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, opts.congestion, (socklen_t)strlen(opts.congestion));
+#endif
+}
+
+// the accepted sockets inherit the buffer sizes of the listener, fast open is of the listener only
+static void le_setlistenopts(struct evconnlistener* listener, const _SockOpts& opts)
+{
+	evutil_socket_t fd = evconnlistener_get_fd(listener);
+
+	if (opts.rcvbuf > 0)
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char*)&opts.rcvbuf, sizeof(opts.rcvbuf));
+	if (opts.sndbuf > 0)
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (const char*)&opts.sndbuf, sizeof(opts.sndbuf));
+
+	if (opts.fastopen > 0) {
+#if defined(TCP_FASTOPEN) && !defined(_WIN32)
+		if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, (const char*)&opts.fastopen, sizeof(opts.fastopen)) != 0)
+			msglog(eMSGTYPE::INFO, "TCP fast open is refused by the system, listener %d keeps plain handshakes.", (int)fd);
+#else
+		msglog(eMSGTYPE::INFO, "TCP fast open is not supported, listener %d keeps plain handshakes.", (int)fd);
+#endif
+	}
+}
+
+// link mode, the listen side accepts links on the link port and the connect side keeps link connections dialed to it
+static bool le_startlink(_TunnelsInfo* tunnelinfo)
+{
+	struct evutil_addrinfo hints, * res = NULL;
+	char linkport[8];
+
+	if (tunnelinfo->resume && tunnelinfo->pathtimer == NULL)
+		le_pathstart(tunnelinfo);
+
+	// both sides send, a link the peer stopped answering is closed and dialed or asked for again
+	if (tunnelinfo->keepalive > 0 && tunnelinfo->keepalivetimer == NULL) {
+		struct timeval tv = { tunnelinfo->keepalive, 0 };
+		tunnelinfo->keepalivetimer = event_new(base, -1, EV_PERSIST, le_keepalivetimer_cb, (void*)tunnelinfo);
+		event_add(tunnelinfo->keepalivetimer, &tv);
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN)
+		hints.ai_flags = EVUTIL_AI_PASSIVE;
+	sprintf(linkport, "%d", tunnelinfo->linkport);
+
+	if (tunnelinfo->tls) {
+#ifdef __linux__
+		if (!le_tlsinit(tunnelinfo))
+			return false;
+#else
+		msglog(eMSGTYPE::ERROR, "%s TLS is not supported, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		return false;
+#endif
+	}
+
+	if (evutil_getaddrinfo(tunnelinfo->linkip, linkport, &hints, &res) != 0) {
+		msglog(eMSGTYPE::ERROR, "%s failed to resolve link IP %s, %s (%d).", tunnelinfo->name, tunnelinfo->linkip, __func__, __LINE__);
+		return false;
+	}
+
+	if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN) {
+#ifndef _WIN32
+		evutil_socket_t fd = le_upgradetake(tunnelinfo, _UPGRADE_FD::_LINK, res->ai_addr);
+		if (fd != -1)
+			tunnelinfo->link_listener = evconnlistener_new(base, le_linklistener_cb, (void*)tunnelinfo, LEV_OPT_CLOSE_ON_FREE, -1, fd);
+		else
+#endif
+		tunnelinfo->link_listener = evconnlistener_new_bind(base, le_linklistener_cb, (void*)tunnelinfo,
+			LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, -1,
+			res->ai_addr,
+			(int)res->ai_addrlen);
+		evutil_freeaddrinfo(res);
+
+		if (!tunnelinfo->link_listener) {
+			msglog(eMSGTYPE::ERROR, "evconnlistener_new_bind failed at link port %d, %s (%d).", tunnelinfo->linkport, __func__, __LINE__);
+			return false;
+		}
+		le_setlistenopts(tunnelinfo->link_listener, tunnelinfo->sockopts);
+
+		msglog(eMSGTYPE::INFO, "%s Proxy Server is listening to link port %d.", tunnelinfo->name, tunnelinfo->linkport);
+		return true;
+	}
+
+	memcpy(&tunnelinfo->linkaddr, res->ai_addr, res->ai_addrlen);
+	tunnelinfo->linkaddrlen = (int)res->ai_addrlen;
+	evutil_freeaddrinfo(res);
+
+	tunnelinfo->vSourceAddrs.clear();
+	for (size_t n = 0; n < tunnelinfo->vLinkSources.size(); n++) {
+		_AddrInfo addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.addrlen = sizeof(addr.addr);
+		if (evutil_parse_sockaddr_port(tunnelinfo->vLinkSources[n].c_str(), (struct sockaddr*)&addr.addr, &addr.addrlen) != 0
+			|| addr.addr.ss_family != tunnelinfo->linkaddr.ss_family) {
+			msglog(eMSGTYPE::ERROR, "%s Link source %s is not an address of the link family, %s (%d).", tunnelinfo->name, tunnelinfo->vLinkSources[n].c_str(), __func__, __LINE__);
+			return false;
+		}
+		tunnelinfo->vSourceAddrs.push_back(addr);
+	}
+
+	// dropped links are dialed again on the next tick
+	struct timeval tv = { LINK_RETRY_MSEC / 1000, (LINK_RETRY_MSEC % 1000) * 1000 };
+	tunnelinfo->linktimer = event_new(base, -1, EV_PERSIST, le_linktimer_cb, (void*)tunnelinfo);
+	event_add(tunnelinfo->linktimer, &tv);
+	event_active(tunnelinfo->linktimer, EV_TIMEOUT, 0);
+
+	msglog(eMSGTYPE::INFO, "%s Proxy Server is linking to %s port %d with %d connections.", tunnelinfo->name, tunnelinfo->linkip, tunnelinfo->linkport, tunnelinfo->linkconnections);
+	return true;
+}
+
+// resumable streams, both sides ping their links, close the silent ones and give up on streams orphaned too long
+static void le_pathstart(_TunnelsInfo* tunnelinfo)
+{
+	struct timeval tv = { PATH_PING_MSEC / 1000, (PATH_PING_MSEC % 1000) * 1000 };
+
+	tunnelinfo->pathtimer = event_new(base, -1, EV_PERSIST, le_pathtimer_cb, (void*)tunnelinfo);
+	event_add(tunnelinfo->pathtimer, &tv);
+}
+
+static void le_stoplink(_TunnelsInfo* tunnelinfo)
+{
+	if (tunnelinfo->linktimer)
+		event_free(tunnelinfo->linktimer);
+	tunnelinfo->linktimer = NULL;
+
+	// without the timer closed links drop their streams instead of orphaning them
+	if (tunnelinfo->pathtimer)
+		event_free(tunnelinfo->pathtimer);
+	tunnelinfo->pathtimer = NULL;
+
+	if (tunnelinfo->keepalivetimer)
+		event_free(tunnelinfo->keepalivetimer);
+	tunnelinfo->keepalivetimer = NULL;
+
+	if (tunnelinfo->link_listener)
+		evconnlistener_free(tunnelinfo->link_listener);
+	tunnelinfo->link_listener = NULL;
+
+	while (tunnelinfo->vLinks.size() > 0)
+		le_linkclose(tunnelinfo->vLinks.back());
+
+	while (tunnelinfo->vOrphans.size() > 0)
+		le_streamclose(tunnelinfo->vOrphans.back(), false);
+
+#ifdef __linux__
+	if (tunnelinfo->tlssession)
+		SSL_SESSION_free(tunnelinfo->tlssession);
+	tunnelinfo->tlssession = NULL;
+
+	if (tunnelinfo->tlsctx)
+		SSL_CTX_free(tunnelinfo->tlsctx);
+	tunnelinfo->tlsctx = NULL;
+#endif
+}
+
+#ifdef __linux__
+// session tickets are on by default, the connect side keeps the newest one to resume with
+static bool le_tlsinit(_TunnelsInfo* tunnelinfo)
+{
+	bool listen = (tunnelinfo->linkmode == _LINK_MODE::_LISTEN);
+
+	tunnelinfo->tlsctx = SSL_CTX_new(listen ? TLS_server_method() : TLS_client_method());
+
+	if (tunnelinfo->tlsctx == NULL) {
+		msglog(eMSGTYPE::ERROR, "%s SSL_CTX_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		return false;
+	}
+
+	SSL_CTX_set_min_proto_version(tunnelinfo->tlsctx, TLS1_2_VERSION);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+	SSL_CTX_set_options(tunnelinfo->tlsctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
+	if (tunnelinfo->ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+		SSL_CTX_set_options(tunnelinfo->tlsctx, SSL_OP_ENABLE_KTLS);
+#else
+		msglog(eMSGTYPE::INFO, "%s KTLS is not supported by this OpenSSL.", tunnelinfo->name);
+#endif
+	}
+
+	if (listen) {
+		if (SSL_CTX_use_certificate_chain_file(tunnelinfo->tlsctx, tunnelinfo->tlscert) != 1
+			|| SSL_CTX_use_PrivateKey_file(tunnelinfo->tlsctx, tunnelinfo->tlskey, SSL_FILETYPE_PEM) != 1) {
+			msglog(eMSGTYPE::ERROR, "%s failed to load TLS certificate %s or key %s, %s (%d).", tunnelinfo->name, tunnelinfo->tlscert, tunnelinfo->tlskey, __func__, __LINE__);
+			return false;
+		}
+		SSL_CTX_set_session_cache_mode(tunnelinfo->tlsctx, SSL_SESS_CACHE_SERVER);
+		return true;
+	}
+
+	if (tunnelinfo->tlsca[0] != 0) {
+		if (SSL_CTX_load_verify_locations(tunnelinfo->tlsctx, tunnelinfo->tlsca, NULL) != 1) {
+			msglog(eMSGTYPE::ERROR, "%s failed to load TLS CA %s, %s (%d).", tunnelinfo->name, tunnelinfo->tlsca, __func__, __LINE__);
+			return false;
+		}
+		SSL_CTX_set_verify(tunnelinfo->tlsctx, SSL_VERIFY_PEER, NULL);
+	}
+	else
+		msglog(eMSGTYPE::INFO, "%s TLS CA is not set, the link peer is not verified.", tunnelinfo->name);
+
+	SSL_CTX_set_session_cache_mode(tunnelinfo->tlsctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(tunnelinfo->tlsctx, le_tlssession_cb);
+	return true;
+}
+
+static int le_tlssession_cb(SSL* ssl, SSL_SESSION* session)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)SSL_get_app_data(ssl);
+
+	if (tunnelinfo->tlssession)
+		SSL_SESSION_free(tunnelinfo->tlssession);
+	tunnelinfo->tlssession = session;
+	return 1;
+}
+#endif
+
+// source is an index of vSourceAddrs the socket is bound to, -1 leaves it to the routing table
+static struct bufferevent* le_linkconnect(_TunnelsInfo* tunnelinfo, int source)
+{
+	if (source >= 0) {
+		evutil_socket_t fd = le_socket((struct sockaddr*)&tunnelinfo->linkaddr, &tunnelinfo->sockopts);
+
+		if (fd == EVUTIL_INVALID_SOCKET)
+			return NULL;
+
+		_AddrInfo& addr = tunnelinfo->vSourceAddrs[source];
+		if (bind(fd, (struct sockaddr*)&addr.addr, addr.addrlen) != 0) {
+			msglog(eMSGTYPE::ERROR, "%s bind to link source %s failed, %s (%d).", tunnelinfo->name, tunnelinfo->vLinkSources[source].c_str(), __func__, __LINE__);
+			evutil_closesocket(fd);
+			return NULL;
+		}
+
+		if (!tunnelinfo->tls) {
+			struct bufferevent* _bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE
+#ifdef _WIN32
+				| BEV_OPT_THREADSAFE
+#endif
+			);
+
+			if (!_bev) {
+				msglog(eMSGTYPE::ERROR, "%s bufferevent_socket_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+				evutil_closesocket(fd);
+				return NULL;
+			}
+			if (bufferevent_socket_connect(_bev, (struct sockaddr*)&tunnelinfo->linkaddr, tunnelinfo->linkaddrlen) == -1) {
+				msglog(eMSGTYPE::ERROR, "bufferevent_socket_connect failed, %s (%d).", __func__, __LINE__);
+				bufferevent_free(_bev);
+				return NULL;
+			}
+			return _bev;
+		}
+#ifdef __linux__
+		return le_tlsconnect(tunnelinfo, fd);
+#else
+		evutil_closesocket(fd);
+		return NULL;
+#endif
+	}
+
+	if (!tunnelinfo->tls)
+		return le_connect(base, (struct sockaddr*)&tunnelinfo->linkaddr, tunnelinfo->linkaddrlen, false, &tunnelinfo->sockopts);
+
+#ifdef __linux__
+	evutil_socket_t fd = le_socket((struct sockaddr*)&tunnelinfo->linkaddr, &tunnelinfo->sockopts);
+
+	if (fd == EVUTIL_INVALID_SOCKET)
+		return NULL;
+	return le_tlsconnect(tunnelinfo, fd);
+#else
+	return NULL;
+#endif
+}
+
+#ifdef __linux__
+static struct bufferevent* le_tlsconnect(_TunnelsInfo* tunnelinfo, evutil_socket_t fd)
+{
+	SSL* ssl = SSL_new(tunnelinfo->tlsctx);
+
+	if (ssl == NULL) {
+		msglog(eMSGTYPE::ERROR, "%s SSL_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		evutil_closesocket(fd);
+		return NULL;
+	}
+
+	SSL_set_app_data(ssl, tunnelinfo);
+	if (tunnelinfo->tlssession)
+		SSL_set_session(ssl, tunnelinfo->tlssession);
+	if (tunnelinfo->tlsservername[0] != 0) {
+		SSL_set_tlsext_host_name(ssl, tunnelinfo->tlsservername);
+		SSL_set1_host(ssl, tunnelinfo->tlsservername);
+	}
+
+	struct bufferevent* _bev = bufferevent_openssl_socket_new(base, fd, ssl, BUFFEREVENT_SSL_CONNECTING, BEV_OPT_CLOSE_ON_FREE);
+
+	if (!_bev) {
+		msglog(eMSGTYPE::ERROR, "%s bufferevent_openssl_socket_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		SSL_free(ssl);
+		evutil_closesocket(fd);
+		return NULL;
+	}
+
+	// links are closed without a close_notify, a plain EOF is the peer going away
+	bufferevent_openssl_set_allow_dirty_shutdown(_bev, 1);
+
+	if (bufferevent_socket_connect(_bev, (struct sockaddr*)&tunnelinfo->linkaddr, tunnelinfo->linkaddrlen) == -1) {
+		msglog(eMSGTYPE::ERROR, "bufferevent_socket_connect failed, %s (%d).", __func__, __LINE__);
+		bufferevent_free(_bev);
+		return NULL;
+	}
+	return _bev;
+}
+#endif
+
+static void le_linklistener_cb(struct evconnlistener* listener, evutil_socket_t fd,
+	struct sockaddr* sa, int socklen, void* user_data) {
+
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)user_data;
+	struct bufferevent* _bev;
+
+	le_setsockopts(fd, tunnelinfo->sockopts);
+
+#ifdef __linux__
+	if (tunnelinfo->tls) {
+		SSL* ssl = SSL_new(tunnelinfo->tlsctx);
+		_bev = (ssl != NULL) ? bufferevent_openssl_socket_new(base, fd, ssl, BUFFEREVENT_SSL_ACCEPTING, BEV_OPT_CLOSE_ON_FREE) : NULL;
+		if (!_bev && ssl != NULL)
+			SSL_free(ssl);
+		if (_bev)
+			bufferevent_openssl_set_allow_dirty_shutdown(_bev, 1);
+	}
+	else
+#endif
+	_bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE
+#ifdef _WIN32
+		| BEV_OPT_THREADSAFE
+#endif
+	);
+
+	if (!_bev) {
+		msglog(eMSGTYPE::ERROR, "%s bufferevent_socket_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		evutil_closesocket(fd);
+		return;
+	}
+
+	le_linknew(tunnelinfo, _bev);
+	msglog(eMSGTYPE::INFO, "%s Link connection accepted, %d links.", tunnelinfo->name, (int)tunnelinfo->vLinks.size());
+
+	if (tunnelinfo->linkrequested > 0)
+		tunnelinfo->linkrequested--;
+	le_linkrequest(tunnelinfo);
+
+	if (tunnelinfo->vOrphans.size() > 0)
+		le_pathresume(tunnelinfo);
+}
+
+// listen side, a single CREATE_TUNNEL carrying the missing count has the connect side dial them all at once
+static void le_linkrequest(_TunnelsInfo* tunnelinfo)
+{
+	int missing = tunnelinfo->linkconnections - (int)tunnelinfo->vLinks.size() - tunnelinfo->linkrequested;
+
+	if (missing <= 0 || tunnelinfo->vLinks.size() == 0)
+		return;
+
+	WORD count = htons((WORD)missing);
+	le_linksend(tunnelinfo->vLinks[0], eREQTYPE::CREATE_TUNNEL, 0, &count, sizeof(count));
+	tunnelinfo->linkrequested += missing;
+
+	msglog(eMSGTYPE::DEBUG, "%s Requested %d more links.", tunnelinfo->name, missing);
+}
+
+static void le_linktimer_cb(evutil_socket_t, short, void* arg)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)arg;
+
+	while ((int)tunnelinfo->vLinks.size() < tunnelinfo->linkconnections) {
+		// a redialed link goes out the source that lost it
+		int source = -1;
+		if (tunnelinfo->vSourceAddrs.size() > 0) {
+			std::vector<int> vCount(tunnelinfo->vSourceAddrs.size(), 0);
+			for (size_t n = 0; n < tunnelinfo->vLinks.size(); n++)
+				vCount[tunnelinfo->vLinks[n]->source]++;
+			source = (int)(std::min_element(vCount.begin(), vCount.end()) - vCount.begin());
+		}
+
+		struct bufferevent* _bev = le_linkconnect(tunnelinfo, source);
+
+		if (_bev == NULL)
+			return;
+
+		le_linknew(tunnelinfo, _bev)->source = source;
+	}
+}
+
+static _MuxLink* le_linknew(_TunnelsInfo* tunnelinfo, struct bufferevent* bev)
+{
+	_MuxLink* link = new _MuxLink;
+	link->tunnelinfo = tunnelinfo;
+	link->bev = bev;
+	link->turns = 0;
+	link->source = -1;
+	link->lastrecv = le_nowusec();
+	link->srtt = 0;
+	link->rttvar = 0;
+	link->peerstamp = 0;
+	link->peerstampat = 0;
+	link->drained = 0;
+	link->rate = 0;
+
+	bufferevent_setcb(bev, le_linkreadcb, le_linkwritecb, le_linkeventcb, (void*)link);
+	bufferevent_setwatermark(bev, EV_WRITE, LINK_HIGH_WATER / 2, 0);
+	bufferevent_enable(bev, EV_READ | EV_WRITE);
+
+	tunnelinfo->vLinks.push_back(link);
+
+	// the first round trip is known before streams are placed on the link
+	if (tunnelinfo->resume) {
+		evbuffer_add_cb(bufferevent_get_output(bev), le_linkoutputcb, (void*)link);
+		unsigned long long now = le_nowusec();
+		le_linksend(link, eREQTYPE::LINK_PING, 0, &now, sizeof(now));
+	}
+	return link;
+}
+
+// every stream of the link is dropped, the peer does the same when it sees the link close.
+// resumable streams are orphaned instead, the listen side resumes them on another link
+static void le_linkclose(_MuxLink* link)
+{
+	_TunnelsInfo* tunnelinfo = link->tunnelinfo;
+
+	while (link->mStreams.size() > 0) {
+		_MuxStream* stream = link->mStreams.begin()->second;
+		if (tunnelinfo->pathtimer != NULL && stream->bev != NULL)
+			le_pathorphan(stream);
+		else
+			le_streamclose(stream, false);
+	}
+
+	std::vector<_MuxLink*>::iterator iter = std::find(tunnelinfo->vLinks.begin(), tunnelinfo->vLinks.end(), link);
+	if (iter != tunnelinfo->vLinks.end())
+		tunnelinfo->vLinks.erase(iter);
+
+	bufferevent_free(link->bev);
+	delete link;
+
+	// asked again over a surviving link, the connect side may not have seen this one drop yet
+	if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN && tunnelinfo->link_listener != NULL) {
+		tunnelinfo->linkrequested = 0;
+		le_linkrequest(tunnelinfo);
+	}
+
+	if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN && tunnelinfo->vOrphans.size() > 0)
+		le_pathresume(tunnelinfo);
+}
+
+static void le_linkoutputcb(struct evbuffer* buffer, const struct evbuffer_cb_info* info, void* arg)
+{
+	((_MuxLink*)arg)->drained += info->n_deleted;
+}
+
+static void le_pathtimer_cb(evutil_socket_t, short, void* arg)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)arg;
+	_LoopBusy busy("keepalive of proxy port", tunnelinfo->proxyport);
+	unsigned long long now = le_nowusec();
+
+	for (size_t n = 0; n < tunnelinfo->vLinks.size();) {
+		_MuxLink* link = tunnelinfo->vLinks[n];
+
+		// a dead uplink rarely closes the connection, the missing pongs tell
+		if (now - link->lastrecv > PATH_DEAD_MSEC * 1000ULL) {
+			msglog(eMSGTYPE::INFO, "%s Link silent for %d ms, closed with %d streams.", tunnelinfo->name, (int)((now - link->lastrecv) / 1000), (int)link->mStreams.size());
+			le_linkclose(link);
+			continue;
+		}
+
+		// the drained bytes are a floor of what the link carries, a link still holding output was running at its limit
+		double rate = link->drained * 1000.0 / PATH_PING_MSEC;
+		if (rate > link->rate)
+			link->rate = rate;
+		else if (evbuffer_get_length(bufferevent_get_output(link->bev)) > 0)
+			link->rate = (link->rate * 3 + rate) / 4;
+		link->drained = 0;
+
+		le_linksend(link, eREQTYPE::LINK_PING, 0, &now, sizeof(now));
+		n++;
+	}
+
+	while (tunnelinfo->vOrphans.size() > 0 && tunnelinfo->vOrphans.front()->orphaned + tunnelinfo->resumetimeout * 1000000ULL < now) {
+		msglog(eMSGTYPE::DEBUG, "%s Stream %u found no link to resume on, closed.", tunnelinfo->name, tunnelinfo->vOrphans.front()->id);
+		le_streamclose(tunnelinfo->vOrphans.front(), false);
+	}
+}
+
+// a link that missed its keepalives is as dead as a closed one, whatever it still holds in its socket
+static void le_keepalivetimer_cb(evutil_socket_t, short, void* arg)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)arg;
+	unsigned long long now = le_nowusec();
+
+	for (size_t n = 0; n < tunnelinfo->vLinks.size();) {
+		_MuxLink* link = tunnelinfo->vLinks[n];
+
+		if (now - link->lastrecv > tunnelinfo->keepalive * tunnelinfo->keepalivemisses * 1000000ULL) {
+			msglog(eMSGTYPE::INFO, "%s Link missed %d keepalives, closed with %d streams.", tunnelinfo->name,
+				tunnelinfo->keepalivemisses, (int)link->mStreams.size());
+			tunnelinfo->stats.linkreaped++;
+			le_linkclose(link);
+			continue;
+		}
+
+		_LinkKeepAlive keepalive;
+		keepalive.stamp = now;
+		keepalive.echo = link->peerstamp;
+		keepalive.held = htonl((link->peerstamp != 0) ? (DWORD)std::min(now - link->peerstampat, 0xFFFFFFFFULL) : 0);
+		link->peerstamp = 0;
+		le_linksend(link, eREQTYPE::KEEP_ALIVE, 0, &keepalive, sizeof(keepalive));
+		n++;
+	}
+}
+
+// smoothed like TCP does, the deviation is taken before the new sample moves the mean
+static void le_linkrtt(_MuxLink* link, unsigned long long rtt)
+{
+	if (link->srtt == 0) {
+		link->srtt = rtt;
+		link->rttvar = rtt / 2;
+		return;
+	}
+
+	unsigned long long delta = (rtt > link->srtt) ? rtt - link->srtt : link->srtt - rtt;
+	link->rttvar = (link->rttvar * 3 + delta) / 4;
+	link->srtt = (link->srtt * 7 + rtt) / 8;
+}
+
+// nothing arrived for a whole keepalive past the one it was due in
+static bool le_linkhealthy(_MuxLink* link, unsigned long long now)
+{
+	int keepalive = link->tunnelinfo->keepalive;
+
+	return keepalive <= 0 || now - link->lastrecv <= keepalive * 2000000ULL;
+}
+
+// the stream stays open without a link, reading stops until it resumes
+static void le_pathorphan(_MuxStream* stream)
+{
+	_MuxLink* link = stream->link;
+
+	if (stream->waiting) {
+		std::deque<_MuxStream*>& waiting = link->dWaiting[stream->bulk ? 1 : 0];
+		waiting.erase(std::find(waiting.begin(), waiting.end(), stream));
+		stream->waiting = false;
+	}
+
+	link->mStreams.erase(stream->id);
+	stream->link = NULL;
+	stream->resuming = false;
+	stream->orphaned = le_nowusec();
+	bufferevent_disable(stream->bev, EV_READ);
+	stream->tunnelinfo->vOrphans.push_back(stream);
+}
+
+// listen side, every orphan is placed on the cheapest link and asks the peer where it stands.
+// with a link given only the orphan id goes, on that link
+static void le_pathresume(_TunnelsInfo* tunnelinfo, _MuxLink* to, DWORD id)
+{
+	for (size_t n = 0; n < tunnelinfo->vOrphans.size();) {
+		if (to != NULL && tunnelinfo->vOrphans[n]->id != id) {
+			n++;
+			continue;
+		}
+
+		_MuxLink* link = (to != NULL) ? to : le_linkpick(tunnelinfo);
+		if (link == NULL)
+			return;
+
+		_MuxStream* stream = tunnelinfo->vOrphans[n];
+		tunnelinfo->vOrphans.erase(tunnelinfo->vOrphans.begin() + n);
+
+		stream->link = link;
+		stream->orphaned = 0;
+		stream->resuming = true;
+		link->mStreams[stream->id] = stream;
+
+		DWORD offsets[2] = { htonl(stream->received), htonl(stream->credited) };
+		le_linksend(link, eREQTYPE::STREAM_RESUME, stream->id, offsets, sizeof(offsets));
+		tunnelinfo->stats.resumed++;
+	}
+}
+
+// connect side, a new link asks the listen side to resume the orphans here instead of waiting for it to see the old link die
+static void le_pathhint(_MuxLink* link)
+{
+	std::vector<_MuxStream*>& vOrphans = link->tunnelinfo->vOrphans;
+
+	for (size_t n = 0; n < vOrphans.size(); n++)
+		le_linksend(link, eREQTYPE::STREAM_RESUME, vOrphans[n]->id, NULL, 0);
+}
+
+// peerrecv is what the peer got of the stream and peercredited what it credited of that, credits lost
+// with the old link are taken from the difference and the bytes past peerrecv are sent again
+static void le_streamresume(_MuxStream* stream, DWORD peerrecv, DWORD peercredited)
+{
+	DWORD lost = peercredited - stream->acked;
+	DWORD skip = peerrecv - peercredited;
+
+	if (lost > evbuffer_get_length(stream->unacked) || skip > evbuffer_get_length(stream->unacked) - lost) {
+		msglog(eMSGTYPE::ERROR, "%s Stream %u can't resume at %u, %s (%d).", stream->tunnelinfo->name, stream->id, peerrecv, __func__, __LINE__);
+		stream->tunnelinfo->stats.errors++;
+		le_streamclose(stream, true);
+		return;
+	}
+
+	evbuffer_drain(stream->unacked, lost);
+	stream->acked = peercredited;
+	stream->sendwindow += lost;
+
+	struct evbuffer_ptr pos;
+	unsigned char buf[MUX_MAX_PAYLOAD];
+	size_t left = evbuffer_get_length(stream->unacked) - skip;
+
+	evbuffer_ptr_set(stream->unacked, &pos, skip, EVBUFFER_PTR_SET);
+	while (left > 0) {
+		size_t len = std::min(left, sizeof(buf));
+		evbuffer_copyout_from(stream->unacked, &pos, buf, len);
+		evbuffer_ptr_set(stream->unacked, &pos, len, EVBUFFER_PTR_ADD);
+		le_linksend(stream->link, eREQTYPE::STREAM_DATA, stream->id, buf, (WORD)len);
+		left -= len;
+	}
+
+	msglog(eMSGTYPE::DEBUG, "%s Stream %u resumed, %d bytes sent again.", stream->tunnelinfo->name, stream->id, (int)(evbuffer_get_length(stream->unacked) - skip));
+
+	if (stream->finsent)
+		le_linksend(stream->link, eREQTYPE::STREAM_FIN, stream->id, NULL, 0);
+	else
+		le_streamflush(stream, false);
+}
+
+static void le_linksend(_MuxLink* link, BYTE cmd, DWORD stream, const void* data, WORD len)
+{
+	struct evbuffer* output = bufferevent_get_output(link->bev);
+	_MuxHdr hdr;
+
+	hdr.head = MUX_HEAD;
+	hdr.cmd = cmd;
+	hdr.stream = htonl(stream);
+	hdr.len = htons(len);
+
+	evbuffer_add(output, &hdr, sizeof(hdr));
+	if (len > 0)
+		evbuffer_add(output, data, len);
+}
+
+static void le_linkreadcb(struct bufferevent* bev, void* user_data)
+{
+	_MuxLink* link = (_MuxLink*)user_data;
+	_TunnelsInfo* tunnelinfo = link->tunnelinfo;
+	_LoopBusy busy("link read of proxy port", tunnelinfo->proxyport);
+	struct evbuffer* input = bufferevent_get_input(bev);
+	_MuxHdr hdr;
+
+	while (evbuffer_copyout(input, &hdr, sizeof(hdr)) == sizeof(hdr)) {
+		WORD len = ntohs(hdr.len);
+		DWORD id = ntohl(hdr.stream);
+
+		if (hdr.head != MUX_HEAD || len > MUX_MAX_PAYLOAD) {
+			msglog(eMSGTYPE::ERROR, "%s Invalid link frame, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+			tunnelinfo->stats.errors++;
+			le_linkclose(link);
+			return;
+		}
+
+		// wait for the whole frame
+		if (evbuffer_get_length(input) < sizeof(hdr) + len)
+			return;
+
+		evbuffer_drain(input, sizeof(hdr));
+		link->lastrecv = le_nowusec();
+
+		std::map<DWORD, _MuxStream*>::iterator iter = link->mStreams.find(id);
+		_MuxStream* stream = (iter != link->mStreams.end()) ? iter->second : NULL;
+
+		switch (hdr.cmd) {
+		case eREQTYPE::CREATE_TUNNEL:
+			if (len == sizeof(WORD) && tunnelinfo->linkmode == _LINK_MODE::_CONNECT) {
+				WORD count;
+				evbuffer_remove(input, &count, sizeof(count));
+				int wanted = std::min((int)tunnelinfo->vLinks.size() + ntohs(count), LINK_MAX_CONNECTIONS);
+				if (wanted > tunnelinfo->linkconnections)
+					tunnelinfo->linkconnections = wanted;
+				msglog(eMSGTYPE::DEBUG, "%s Link peer asked for %d more links.", tunnelinfo->name, (int)ntohs(count));
+				le_linktimer_cb(-1, EV_TIMEOUT, (void*)tunnelinfo);
+			}
+			else
+				evbuffer_drain(input, len);
+			break;
+		case eREQTYPE::STREAM_OPEN: {
+			_MuxOpen open;
+			bool isaddr = (len == sizeof(open));
+			open.type = 0;
+			if (len == sizeof(open.type) || isaddr)
+				evbuffer_remove(input, &open, len);
+			else
+				evbuffer_drain(input, len);
+			if (stream == NULL && tunnelinfo->linkmode == _LINK_MODE::_CONNECT) {
+				if (open.type == MUX_OPEN_UDP)
+					le_udpopen(link, id);
+				else
+					le_muxopen(link, id, isaddr ? &open : NULL);
+			}
+			break;
+		}
+		case eREQTYPE::STREAM_DATA:
+			if (stream == NULL || stream->finrecv) {
+				evbuffer_drain(input, len);
+				break;
+			}
+			if (stream->udpflow != NULL) {
+				le_udpforward(stream->udpflow, input, len);
+				break;
+			}
+			evbuffer_remove_buffer(input, bufferevent_get_output(stream->bev), len);
+			stream->received += len;
+			if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN)
+				tunnelinfo->stats.bytesout += len;
+			else
+				tunnelinfo->stats.bytesin += len;
+			break;
+		case eREQTYPE::STREAM_ZDATA:
+			if (stream == NULL || stream->finrecv || stream->bev == NULL) {
+				evbuffer_drain(input, len);
+				break;
+			}
+#ifdef __linux__
+			if (le_streaminflate(stream, input, len))
+				break;
+#else
+			evbuffer_drain(input, len);
+#endif
+			msglog(eMSGTYPE::ERROR, "%s Stream %u data can't be inflated, %s (%d).", tunnelinfo->name, id, __func__, __LINE__);
+			tunnelinfo->stats.errors++;
+			le_streamclose(stream, true);
+			break;
+		case eREQTYPE::STREAM_FIN:
+			evbuffer_drain(input, len);
+			if (stream != NULL && stream->bev != NULL && !stream->finrecv) {
+				stream->finrecv = true;
+				if (evbuffer_get_length(bufferevent_get_output(stream->bev)) == 0)
+					le_streamshutdown(stream);
+			}
+			break;
+		case eREQTYPE::STREAM_RST:
+			evbuffer_drain(input, len);
+			if (stream != NULL)
+				le_streamclose(stream, false);
+			break;
+		case eREQTYPE::STREAM_WINDOW:
+			if (stream != NULL && stream->bev != NULL && len == sizeof(DWORD)) {
+				DWORD credit;
+				evbuffer_remove(input, &credit, sizeof(credit));
+				stream->sendwindow += ntohl(credit);
+				stream->acked += ntohl(credit);
+				if (stream->unacked != NULL)
+					evbuffer_drain(stream->unacked, ntohl(credit));
+				le_streamflush(stream, false);
+			}
+			else
+				evbuffer_drain(input, len);
+			break;
+		case eREQTYPE::LINK_PING:
+			if (len == sizeof(unsigned long long)) {
+				unsigned long long stamp;
+				evbuffer_remove(input, &stamp, sizeof(stamp));
+				le_linksend(link, eREQTYPE::LINK_PONG, 0, &stamp, sizeof(stamp));
+			}
+			else
+				evbuffer_drain(input, len);
+			break;
+		case eREQTYPE::LINK_PONG:
+			if (len == sizeof(unsigned long long)) {
+				unsigned long long stamp;
+				evbuffer_remove(input, &stamp, sizeof(stamp));
+				le_linkrtt(link, link->lastrecv - stamp);
+			}
+			else
+				evbuffer_drain(input, len);
+			break;
+		case eREQTYPE::KEEP_ALIVE:
+			if (len == sizeof(_LinkKeepAlive)) {
+				_LinkKeepAlive keepalive;
+				evbuffer_remove(input, &keepalive, sizeof(keepalive));
+				link->peerstamp = keepalive.stamp;
+				link->peerstampat = link->lastrecv;
+				unsigned long long held = ntohl(keepalive.held);
+				if (keepalive.echo != 0 && link->lastrecv > keepalive.echo + held)
+					le_linkrtt(link, link->lastrecv - keepalive.echo - held);
+			}
+			else
+				evbuffer_drain(input, len);
+			break;
+		case eREQTYPE::STREAM_RESUME: {
+			DWORD offsets[2];
+			if ((len != sizeof(offsets) && len != 0) || !tunnelinfo->resume) {
+				evbuffer_drain(input, len);
+				break;
+			}
+
+			// listen side, an empty one is the connect side asking for an orphan it holds to be resumed on this link,
+			// it may still be on a link the listen side has not seen dying yet
+			if (len == 0) {
+				if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN && stream == NULL) {
+					for (size_t n = 0; n < tunnelinfo->vLinks.size() && stream == NULL; n++) {
+						std::map<DWORD, _MuxStream*>::iterator other = tunnelinfo->vLinks[n]->mStreams.find(id);
+						if (other != tunnelinfo->vLinks[n]->mStreams.end())
+							le_pathorphan(other->second);
+					}
+					le_pathresume(tunnelinfo, link, id);
+				}
+				break;
+			}
+			evbuffer_remove(input, offsets, sizeof(offsets));
+
+			// listen side, the answer to its own STREAM_RESUME
+			if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN) {
+				if (stream != NULL && stream->resuming) {
+					stream->resuming = false;
+					le_streamresume(stream, ntohl(offsets[0]), ntohl(offsets[1]));
+				}
+				break;
+			}
+
+			// connect side, the stream is an orphan or still on a link that has not been seen dying yet
+			if (stream == NULL) {
+				for (size_t n = 0; n < tunnelinfo->vOrphans.size() && stream == NULL; n++) {
+					if (tunnelinfo->vOrphans[n]->id == id) {
+						stream = tunnelinfo->vOrphans[n];
+						tunnelinfo->vOrphans.erase(tunnelinfo->vOrphans.begin() + n);
+					}
+				}
+				for (size_t n = 0; n < tunnelinfo->vLinks.size() && stream == NULL; n++) {
+					std::map<DWORD, _MuxStream*>::iterator other = tunnelinfo->vLinks[n]->mStreams.find(id);
+					if (other != tunnelinfo->vLinks[n]->mStreams.end()) {
+						stream = other->second;
+						le_pathorphan(stream);
+						tunnelinfo->vOrphans.pop_back();
+					}
+				}
+				if (stream == NULL) {
+					le_linksend(link, eREQTYPE::STREAM_RST, id, NULL, 0);
+					break;
+				}
+				stream->link = link;
+				stream->orphaned = 0;
+				link->mStreams[id] = stream;
+			}
+
+			DWORD answer[2] = { htonl(stream->received), htonl(stream->credited) };
+			le_linksend(link, eREQTYPE::STREAM_RESUME, id, answer, sizeof(answer));
+			tunnelinfo->stats.resumed++;
+			le_streamresume(stream, ntohl(offsets[0]), ntohl(offsets[1]));
+			break;
+		}
+		default:
+			evbuffer_drain(input, len);
+			break;
+		}
+	}
+}
+
+// the link output drained to half of LINK_HIGH_WATER, the waiting streams take turns,
+// interactive ones PRIORITY_WEIGHT times for each bulk one while both wait
+static void le_linkwritecb(struct bufferevent* bev, void* user_data)
+{
+	_MuxLink* link = (_MuxLink*)user_data;
+	struct evbuffer* output = bufferevent_get_output(bev);
+	unsigned long long now = 0;
+
+	while (evbuffer_get_length(output) < LINK_HIGH_WATER) {
+		int cls;
+		if (!link->dWaiting[0].empty() && (link->dWaiting[1].empty() || link->turns < PRIORITY_WEIGHT)) {
+			cls = 0;
+			link->turns++;
+		}
+		else if (!link->dWaiting[1].empty()) {
+			cls = 1;
+			link->turns = 0;
+		}
+		else
+			break;
+
+		if (now == 0)
+			now = le_nowusec();
+
+		_MuxStream* stream = link->dWaiting[cls].front();
+		link->dWaiting[cls].pop_front();
+		stream->waiting = false;
+		link->tunnelinfo->stats.linkwaits[cls]++;
+		link->tunnelinfo->stats.linkwaitusec[cls] += now - stream->waitstart;
+		le_streamflush(stream, true);
+	}
+}
+
+// a bulk stream sends only below LINK_HIGH_WATER and after every waiting stream, an interactive one
+// up to LINK_INTERACTIVE_WATER and after the waiting interactive ones, a stream on its turn sends one frame first
+static bool le_linkroom(_MuxStream* stream, bool turn)
+{
+	_MuxLink* link = stream->link;
+	size_t queued = evbuffer_get_length(bufferevent_get_output(link->bev));
+
+	if (stream->bulk)
+		return queued < LINK_HIGH_WATER && (turn || (link->dWaiting[0].empty() && link->dWaiting[1].empty()));
+	return queued < LINK_INTERACTIVE_WATER && (turn || link->dWaiting[0].empty());
+}
+
+static void le_linkeventcb(struct bufferevent* bev, short events, void* user_data)
+{
+	_MuxLink* link = (_MuxLink*)user_data;
+
+	if (events & BEV_EVENT_CONNECTED) {
+#ifdef __linux__
+		SSL* ssl = bufferevent_openssl_get_ssl(bev);
+		if (ssl != NULL) {
+			link->tunnelinfo->stats.tlshandshakes++;
+			if (SSL_session_reused(ssl))
+				link->tunnelinfo->stats.tlsresumed++;
+			msglog(eMSGTYPE::DEBUG, "%s Link TLS %s, session %s.", link->tunnelinfo->name, SSL_get_version(ssl), SSL_session_reused(ssl) ? "resumed" : "new");
+		}
+#endif
+		if (link->tunnelinfo->linkmode == _LINK_MODE::_CONNECT) {
+			msglog(eMSGTYPE::INFO, "%s Link connected to %s port %d.", link->tunnelinfo->name, link->tunnelinfo->linkip, link->tunnelinfo->linkport);
+			le_pathhint(link);
+		}
+		return;
+	}
+
+	if (events & BEV_EVENT_EOF || events & BEV_EVENT_ERROR) {
+		if (events & BEV_EVENT_ERROR) {
+			link->tunnelinfo->stats.errors++;
+#ifdef __linux__
+			unsigned long err = bufferevent_get_openssl_error(bev);
+			if (err != 0)
+				msglog(eMSGTYPE::ERROR, "%s Link TLS error, %s, %s (%d).", link->tunnelinfo->name, ERR_error_string(err, NULL), __func__, __LINE__);
+#endif
+		}
+		msglog(eMSGTYPE::INFO, "%s Link closed, %d streams %s.", link->tunnelinfo->name, (int)link->mStreams.size(), link->tunnelinfo->resume ? "to resume" : "reset");
+		le_linkclose(link);
+	}
+}
+
+// multipath, the time a frame queued now takes to arrive, times the streams it would share the link with
+static double le_linkcost(_MuxLink* link)
+{
+	size_t queued = evbuffer_get_length(bufferevent_get_output(link->bev));
+	double delay = link->srtt + queued * 1000000.0 / std::max(link->rate, (double)PATH_MIN_RATE);
+
+	return delay * (link->mStreams.size() + 1);
+}
+
+// a link late with its keepalive only gets streams when every link is, of the fewest streams the one
+// with the lowest round trip and jitter
+static _MuxLink* le_linkpick(_TunnelsInfo* tunnelinfo)
+{
+	_MuxLink* link = NULL;
+	unsigned long long now = le_nowusec();
+
+	for (size_t n = 0; n < tunnelinfo->vLinks.size(); n++) {
+		_MuxLink* next = tunnelinfo->vLinks[n];
+		bool healthy = le_linkhealthy(next, now);
+
+		if (link == NULL || healthy != le_linkhealthy(link, now)) {
+			if (link == NULL || healthy)
+				link = next;
+		}
+		else if (tunnelinfo->multipath ? le_linkcost(next) < le_linkcost(link)
+			: (next->mStreams.size() < link->mStreams.size() || (next->mStreams.size() == link->mStreams.size()
+				&& next->srtt + next->rttvar < link->srtt + link->rttvar)))
+			link = next;
+	}
+	return link;
+}
+
+// listen side, the client becomes a new stream of the link carrying the fewest streams
+static void le_muxaccept(_TunnelsInfo* tunnelinfo, evutil_socket_t fd)
+{
+	tunnelinfo->stats.accepted++;
+	le_setsockopts(fd, tunnelinfo->sockopts);
+
+	le_muxstream(tunnelinfo, fd, fd);
+}
+
+// listen side, fd is closed when no link takes it, the addresses of clientfd go along to the connect side
+bool le_muxstream(_TunnelsInfo* tunnelinfo, evutil_socket_t fd, evutil_socket_t clientfd)
+{
+	_MuxLink* link = le_linkpick(tunnelinfo);
+
+	if (link == NULL) {
+		msglog(eMSGTYPE::ERROR, "%s No link connected, client dropped, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		tunnelinfo->stats.errors++;
+		evutil_closesocket(fd);
+		return false;
+	}
+
+	struct bufferevent* _bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE
+#ifdef _WIN32
+		| BEV_OPT_THREADSAFE
+#endif
+	);
+
+	if (!_bev) {
+		msglog(eMSGTYPE::ERROR, "%s bufferevent_socket_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		evutil_closesocket(fd);
+		return false;
+	}
+
+	DWORD id = tunnelinfo->nextstream++;
+	_MuxOpen open;
+
+	le_proxyaddrs(clientfd, &open);
+	le_linksend(link, eREQTYPE::STREAM_OPEN, id, &open, sizeof(open));
+	le_streamnew(link, id, _bev);
+
+	msglog(eMSGTYPE::DEBUG, "%s Client connection accepted as stream %u.", tunnelinfo->name, id);
+	return true;
+}
+
+// connect side, data of the stream is queued in the upstream output until the local server is connected,
+// open is NULL from a peer that sent no addresses
+static void le_muxopen(_MuxLink* link, DWORD id, const _MuxOpen* open)
+{
+	_TunnelsInfo* tunnelinfo = link->tunnelinfo;
+	unsigned long long connectstart = 0;
+
+	tunnelinfo->stats.accepted++;
+
+	struct bufferevent* _bev = le_poolget(base, tunnelinfo);
+
+	if (_bev == NULL) {
+		struct sockaddr_storage ss;
+		int socklen;
+
+		connectstart = le_nowusec();
+		if (le_getlocaladdr(tunnelinfo, &ss, &socklen))
+			_bev = le_connect(base, (struct sockaddr*)&ss, socklen, false, &tunnelinfo->sockopts);
+	}
+
+	if (_bev == NULL) {
+		msglog(eMSGTYPE::ERROR, "%s connect to local server %s failed, %s (%d).", tunnelinfo->name, tunnelinfo->local_serverip, __func__, __LINE__);
+		tunnelinfo->stats.errors++;
+		le_linksend(link, eREQTYPE::STREAM_RST, id, NULL, 0);
+		return;
+	}
+
+	if (tunnelinfo->proxyprotocol)
+		le_proxyheader(_bev, open);
+
+	_MuxStream* stream = le_streamnew(link, id, _bev);
+	stream->connectstart = connectstart;
+
+	// a pooled upstream may already hold data like a server banner
+	le_streamflush(stream, false);
+}
+
+static _MuxStream* le_streamnew(_MuxLink* link, DWORD id, struct bufferevent* bev)
+{
+	_MuxStream* stream = new _MuxStream;
+	stream->id = id;
+	stream->link = link;
+	stream->tunnelinfo = link->tunnelinfo;
+	stream->bev = bev;
+	stream->sendwindow = link->tunnelinfo->streamwindow;
+	stream->consumed = 0;
+	stream->connectstart = 0;
+	stream->eofread = false;
+	stream->finsent = false;
+	stream->finrecv = false;
+	stream->shut = false;
+	stream->bulk = (link->tunnelinfo->priority == _PRIORITY::_BULK);
+	stream->waiting = false;
+	stream->burst = 0;
+	stream->waitstart = 0;
+	stream->lastsend = 0;
+	stream->unacked = (link->tunnelinfo->resume && bev != NULL) ? evbuffer_new() : NULL;
+	stream->sent = 0;
+	stream->acked = 0;
+	stream->received = 0;
+	stream->credited = 0;
+	stream->resuming = false;
+	stream->orphaned = 0;
+	stream->udpflow = NULL;
+#ifdef __linux__
+	stream->deflater = NULL;
+	stream->inflater = NULL;
+	stream->zsamples = 0;
+	stream->zsamplein = 0;
+	stream->zsampleout = 0;
+
+	if (link->tunnelinfo->compression && bev != NULL) {
+		stream->deflater = new z_stream;
+		memset(stream->deflater, 0, sizeof(z_stream));
+		if (deflateInit(stream->deflater, Z_BEST_SPEED) != Z_OK) {
+			delete stream->deflater;
+			stream->deflater = NULL;
+		}
+	}
+#endif
+
+	link->mStreams[id] = stream;
+
+	if (bev != NULL) {
+		bufferevent_setcb(bev, le_streamreadcb, le_streamwritecb, le_streameventcb, (void*)stream);
+		bufferevent_enable(bev, EV_READ | EV_WRITE);
+		evbuffer_add_cb(bufferevent_get_output(bev), le_streamoutputcb, (void*)stream);
+	}
+
+	link->tunnelinfo->stats.activepairs++;
+	return stream;
+}
+
+// sends what the peer's window and the link output allow, the FIN follows the last byte after EOF
+static void le_streamflush(_MuxStream* stream, bool turn)
+{
+	// its turn comes from le_linkwritecb, an orphan sends again once it resumed
+	if (stream->waiting || stream->link == NULL || stream->resuming)
+		return;
+
+	_TunnelsInfo* tunnelinfo = stream->tunnelinfo;
+	struct evbuffer* input = bufferevent_get_input(stream->bev);
+	struct evbuffer* output = bufferevent_get_output(stream->link->bev);
+
+	unsigned long long now = le_nowusec();
+	if (tunnelinfo->priority == _PRIORITY::_AUTO && stream->bulk && !turn && now - stream->lastsend >= PRIORITY_IDLE_MSEC * 1000ULL) {
+		stream->bulk = false;
+		stream->burst = 0;
+	}
+	else if (now - stream->lastsend >= PRIORITY_BURST_MSEC * 1000ULL)
+		stream->burst = 0;
+
+	while (stream->sendwindow > 0 && evbuffer_get_length(input) > 0) {
+		if (!le_linkroom(stream, turn)) {
+			stream->waiting = true;
+			stream->waitstart = now;
+			stream->link->dWaiting[stream->bulk ? 1 : 0].push_back(stream);
+			break;
+		}
+		turn = false;
+
+		size_t len = evbuffer_get_length(input);
+		size_t maxlen = MUX_MAX_PAYLOAD;
+#ifdef __linux__
+		if (stream->deflater != NULL)
+			maxlen = MUX_ZCHUNK;
+#endif
+		if (len > maxlen)
+			len = maxlen;
+		if ((long long)len > stream->sendwindow)
+			len = (size_t)stream->sendwindow;
+
+#ifdef __linux__
+		if (stream->deflater != NULL)
+			le_streamdeflate(stream, input, len);
+		else
+#endif
+		{
+			_MuxHdr hdr;
+			hdr.head = MUX_HEAD;
+			hdr.cmd = eREQTYPE::STREAM_DATA;
+			hdr.stream = htonl(stream->id);
+			hdr.len = htons((WORD)len);
+
+			evbuffer_add(output, &hdr, sizeof(hdr));
+			if (stream->unacked != NULL)
+				evbuffer_add(stream->unacked, evbuffer_pullup(input, len), len);
+			evbuffer_remove_buffer(input, output, len);
+		}
+		stream->sendwindow -= len;
+		stream->sent += len;
+		tunnelinfo->stats.linkframes[stream->bulk ? 1 : 0]++;
+		stream->lastsend = now;
+
+		stream->burst += len;
+		if (tunnelinfo->priority == _PRIORITY::_AUTO && stream->burst >= PRIORITY_BULK_BYTES)
+			stream->bulk = true;
+
+		if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN)
+			tunnelinfo->stats.bytesin += len;
+		else
+			tunnelinfo->stats.bytesout += len;
+	}
+
+	// the peer's window is full or the stream waits for its turn on the link, reading resumes after either
+	if (stream->sendwindow <= 0 || stream->waiting)
+		bufferevent_disable(stream->bev, EV_READ);
+	else if (!stream->eofread && !(bufferevent_get_enabled(stream->bev) & EV_READ))
+		bufferevent_enable(stream->bev, EV_READ);
+
+	if (stream->eofread && !stream->finsent && evbuffer_get_length(input) == 0) {
+		stream->finsent = true;
+		le_linksend(stream->link, eREQTYPE::STREAM_FIN, stream->id, NULL, 0);
+		if (stream->shut)
+			le_streamclose(stream, false);
+	}
+}
+
+// shuts down the write side of the stream, it is freed once a FIN went both ways
+static void le_streamshutdown(_MuxStream* stream)
+{
+	if (stream->shut == false) {
+		stream->shut = true;
+#ifdef _WIN32
+		shutdown(bufferevent_getfd(stream->bev), SD_SEND);
+#else
+		shutdown(bufferevent_getfd(stream->bev), SHUT_WR);
+#endif
+	}
+
+	if (stream->finsent)
+		le_streamclose(stream, false);
+}
+
+static void le_streamclose(_MuxStream* stream, bool reset)
+{
+	_MuxLink* link = stream->link;
+
+	if (link == NULL) {
+		std::vector<_MuxStream*>& vOrphans = stream->tunnelinfo->vOrphans;
+		vOrphans.erase(std::find(vOrphans.begin(), vOrphans.end(), stream));
+	}
+	else {
+		if (reset)
+			le_linksend(link, eREQTYPE::STREAM_RST, stream->id, NULL, 0);
+
+		if (stream->waiting) {
+			std::deque<_MuxStream*>& waiting = link->dWaiting[stream->bulk ? 1 : 0];
+			waiting.erase(std::find(waiting.begin(), waiting.end(), stream));
+		}
+
+		link->mStreams.erase(stream->id);
+	}
+
+	stream->tunnelinfo->stats.activepairs--;
+	if (stream->bev)
+		bufferevent_free(stream->bev);
+	if (stream->unacked)
+		evbuffer_free(stream->unacked);
+	if (stream->udpflow)
+		le_udpflowfree(stream->udpflow);
+#ifdef __linux__
+	if (stream->deflater) {
+		deflateEnd(stream->deflater);
+		delete stream->deflater;
+	}
+	if (stream->inflater) {
+		inflateEnd(stream->inflater);
+		delete stream->inflater;
+	}
+#endif
+	delete stream;
+}
+
+static void le_streamreadcb(struct bufferevent* bev, void* user_data)
+{
+	le_streamflush((_MuxStream*)user_data, false);
+}
+
+static void le_streamwritecb(struct bufferevent* bev, void* user_data)
+{
+	_MuxStream* stream = (_MuxStream*)user_data;
+
+	if (stream->finrecv && evbuffer_get_length(bufferevent_get_output(bev)) == 0)
+		le_streamshutdown(stream);
+}
+
+static void le_streameventcb(struct bufferevent* bev, short events, void* user_data)
+{
+	_MuxStream* stream = (_MuxStream*)user_data;
+
+	if (events & BEV_EVENT_ERROR)
+	{
+		stream->tunnelinfo->stats.errors++;
+		le_streamclose(stream, true);
+	}
+	else if (events & BEV_EVENT_EOF)
+	{
+		stream->eofread = true;
+		bufferevent_disable(bev, EV_READ);
+		le_streamflush(stream, false);
+	}
+	else if (events & BEV_EVENT_CONNECTED)
+	{
+		if (stream->connectstart != 0) {
+			le_statsconnected(stream->tunnelinfo, stream->connectstart);
+			stream->connectstart = 0;
+		}
+	}
+}
+
+// credits the peer once half of the window is flushed to the socket
+static void le_streamoutputcb(struct evbuffer* buffer, const struct evbuffer_cb_info* info, void* arg)
+{
+	_MuxStream* stream = (_MuxStream*)arg;
+
+	if (info->n_deleted == 0)
+		return;
+
+	stream->consumed += info->n_deleted;
+
+	// an orphan credits the peer after it resumed
+	if (stream->consumed >= (size_t)stream->tunnelinfo->streamwindow / 2 && stream->link != NULL && !stream->resuming) {
+		DWORD credit = htonl((DWORD)stream->consumed);
+		le_linksend(stream->link, eREQTYPE::STREAM_WINDOW, stream->id, &credit, sizeof(credit));
+		stream->credited += (DWORD)stream->consumed;
+		stream->consumed = 0;
+	}
+}
+
+#ifdef __linux__
+// deflates len bytes of the stream input into one STREAM_ZDATA frame, window accounting stays on the plain bytes
+static void le_streamdeflate(_MuxStream* stream, struct evbuffer* input, size_t len)
+{
+	_TunnelsInfo* tunnelinfo = stream->link->tunnelinfo;
+	unsigned char zbuf[MUX_MAX_PAYLOAD];
+	z_stream* zs = stream->deflater;
+
+	zs->next_in = evbuffer_pullup(input, len);
+	zs->avail_in = (uInt)len;
+	zs->next_out = zbuf;
+	zs->avail_out = sizeof(zbuf);
+	deflate(zs, Z_SYNC_FLUSH);
+
+	size_t zlen = sizeof(zbuf) - zs->avail_out;
+	evbuffer_drain(input, len);
+	le_linksend(stream->link, eREQTYPE::STREAM_ZDATA, stream->id, zbuf, (WORD)zlen);
+
+	tunnelinfo->stats.zbytesin += len;
+	tunnelinfo->stats.zbytesout += zlen;
+	stream->zsamplein += len;
+	stream->zsampleout += zlen;
+
+	// data like TLS or RDP doesn't shrink, the rest of the stream goes out in plain frames
+	if (++stream->zsamples == COMPRESS_SAMPLE_FRAMES && stream->zsampleout * 10 > stream->zsamplein * 9) {
+		deflateEnd(zs);
+		delete zs;
+		stream->deflater = NULL;
+		msglog(eMSGTYPE::DEBUG, "%s Stream %u is incompressible, compression bypassed.", tunnelinfo->name, stream->id);
+	}
+}
+
+static bool le_streaminflate(_MuxStream* stream, struct evbuffer* input, size_t len)
+{
+	_TunnelsInfo* tunnelinfo = stream->link->tunnelinfo;
+	struct evbuffer* output = bufferevent_get_output(stream->bev);
+	unsigned char zbuf[MUX_MAX_PAYLOAD];
+	size_t total = 0;
+
+	if (stream->inflater == NULL) {
+		stream->inflater = new z_stream;
+		memset(stream->inflater, 0, sizeof(z_stream));
+		if (inflateInit(stream->inflater) != Z_OK) {
+			delete stream->inflater;
+			stream->inflater = NULL;
+			evbuffer_drain(input, len);
+			return false;
+		}
+	}
+
+	z_stream* zs = stream->inflater;
+	zs->next_in = evbuffer_pullup(input, len);
+	zs->avail_in = (uInt)len;
+
+	do {
+		zs->next_out = zbuf;
+		zs->avail_out = sizeof(zbuf);
+
+		int result = inflate(zs, Z_SYNC_FLUSH);
+		if (result != Z_OK && result != Z_BUF_ERROR) {
+			evbuffer_drain(input, len);
+			return false;
+		}
+
+		evbuffer_add(output, zbuf, sizeof(zbuf) - zs->avail_out);
+		total += sizeof(zbuf) - zs->avail_out;
+	} while (zs->avail_out == 0);
+
+	evbuffer_drain(input, len);
+
+	if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN)
+		tunnelinfo->stats.bytesout += total;
+	else
+		tunnelinfo->stats.bytesin += total;
+	return true;
+}
+#endif
+
+// binds the client side of a UDP tunnel, datagrams are read in batches from the main loop
+static bool le_udpbind(_TunnelsInfo* tunnelinfo, const struct sockaddr* sa, int socklen)
+{
+#ifndef _WIN32
+	tunnelinfo->udpfd = le_upgradetake(tunnelinfo, _UPGRADE_FD::_UDP, sa);
+	if (tunnelinfo->udpfd != -1) {
+		tunnelinfo->udpev = event_new(base, tunnelinfo->udpfd, EV_READ | EV_PERSIST, le_udpreadcb, (void*)tunnelinfo);
+		event_add(tunnelinfo->udpev, NULL);
+		return true;
+	}
+#endif
+	tunnelinfo->udpfd = socket(sa->sa_family, SOCK_DGRAM, 0);
+
+	if (tunnelinfo->udpfd == -1)
+		return false;
+
+	evutil_make_listen_socket_reuseable(tunnelinfo->udpfd);
+	evutil_make_socket_nonblocking(tunnelinfo->udpfd);
+
+	if (bind(tunnelinfo->udpfd, sa, socklen) != 0) {
+		evutil_closesocket(tunnelinfo->udpfd);
+		tunnelinfo->udpfd = -1;
+		return false;
+	}
+
+	tunnelinfo->udpev = event_new(base, tunnelinfo->udpfd, EV_READ | EV_PERSIST, le_udpreadcb, (void*)tunnelinfo);
+	event_add(tunnelinfo->udpev, NULL);
+	return true;
+}
+
+static void le_udpstop(_TunnelsInfo* tunnelinfo)
+{
+	while (tunnelinfo->mUdpFlows.size() > 0)
+		le_udpflowfree(tunnelinfo->mUdpFlows.begin()->second);
+
+	if (tunnelinfo->udptimer)
+		event_free(tunnelinfo->udptimer);
+	tunnelinfo->udptimer = NULL;
+
+	if (tunnelinfo->udpev)
+		event_free(tunnelinfo->udpev);
+	tunnelinfo->udpev = NULL;
+
+	if (tunnelinfo->udpfd != -1)
+		evutil_closesocket(tunnelinfo->udpfd);
+	tunnelinfo->udpfd = -1;
+}
+
+// reads up to UDP_BATCH datagrams into udpbuf, a single recvmmsg on Linux
+static int le_udprecv(evutil_socket_t fd)
+{
+#ifdef __linux__
+	struct mmsghdr msgs[UDP_BATCH];
+	struct iovec iovs[UDP_BATCH];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (int n = 0; n < UDP_BATCH; n++) {
+		iovs[n].iov_base = udpbuf[n];
+		iovs[n].iov_len = UDP_DATAGRAM_MAX;
+		msgs[n].msg_hdr.msg_iov = &iovs[n];
+		msgs[n].msg_hdr.msg_iovlen = 1;
+		msgs[n].msg_hdr.msg_name = &udpdatagrams[n].addr;
+		msgs[n].msg_hdr.msg_namelen = sizeof(udpdatagrams[n].addr);
+	}
+
+	int count = recvmmsg(fd, msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+	if (count <= 0)
+		return 0;
+
+	for (int n = 0; n < count; n++) {
+		udpdatagrams[n].len = msgs[n].msg_len;
+		udpdatagrams[n].addrlen = msgs[n].msg_hdr.msg_namelen;
+	}
+	return count;
+#else
+	int count = 0;
+
+	while (count < UDP_BATCH) {
+		udpdatagrams[count].addrlen = sizeof(udpdatagrams[count].addr);
+		int len = recvfrom(fd, (char*)udpbuf[count], UDP_DATAGRAM_MAX, 0, (struct sockaddr*)&udpdatagrams[count].addr, &udpdatagrams[count].addrlen);
+		if (len < 0)
+			break;
+		udpdatagrams[count++].len = len;
+	}
+	return count;
+#endif
+}
+
+// sends count datagrams of udpbuf from first, to sa or to the connected peer when sa is NULL
+static void le_udpsend(evutil_socket_t fd, const struct sockaddr* sa, int socklen, int first, int count)
+{
+	// datagrams the socket can't take right now are dropped like on a congested network
+#ifdef __linux__
+	struct mmsghdr msgs[UDP_BATCH];
+	struct iovec iovs[UDP_BATCH];
+
+	memset(msgs, 0, sizeof(struct mmsghdr) * count);
+	for (int n = 0; n < count; n++) {
+		iovs[n].iov_base = udpbuf[first + n];
+		iovs[n].iov_len = udpdatagrams[first + n].len;
+		msgs[n].msg_hdr.msg_iov = &iovs[n];
+		msgs[n].msg_hdr.msg_iovlen = 1;
+		msgs[n].msg_hdr.msg_name = (void*)sa;
+		msgs[n].msg_hdr.msg_namelen = (sa != NULL) ? socklen : 0;
+	}
+
+	sendmmsg(fd, msgs, count, MSG_DONTWAIT);
+#else
+	for (int n = first; n < first + count; n++) {
+		if (sa != NULL)
+			sendto(fd, (const char*)udpbuf[n], (int)udpdatagrams[n].len, 0, sa, socklen);
+		else
+			send(fd, (const char*)udpbuf[n], (int)udpdatagrams[n].len, 0);
+	}
+#endif
+}
+
+// client datagrams, consecutive ones of a flow go out in one batch
+static void le_udpreadcb(evutil_socket_t fd, short, void* arg)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)arg;
+	_LoopBusy busy("udp read of proxy port", tunnelinfo->proxyport);
+	int count = le_udprecv(fd);
+	_UdpFlow* run = NULL;
+	int first = 0;
+
+	for (int n = 0; n <= count; n++) {
+		_UdpFlow* flow = (n < count) ? le_udpflowget(tunnelinfo, &udpdatagrams[n]) : NULL;
+
+		if (run != NULL && flow != run) {
+			le_udpsend(run->fd, NULL, 0, first, n - first);
+			run = NULL;
+		}
+
+		if (flow == NULL)
+			continue;
+
+		tunnelinfo->stats.bytesin += udpdatagrams[n].len;
+		flow->activetick = GetTickCount64();
+
+		if (flow->stream != NULL) {
+			if (udpdatagrams[n].len <= MUX_MAX_PAYLOAD)
+				le_linksend(flow->stream->link, eREQTYPE::STREAM_DATA, flow->stream->id, udpbuf[n], (WORD)udpdatagrams[n].len);
+			continue;
+		}
+
+		if (run == NULL) {
+			run = flow;
+			first = n;
+		}
+	}
+}
+
+// local server replies, forwarded to the client or framed on the flow's link stream
+static void le_udpflowreadcb(evutil_socket_t fd, short, void* arg)
+{
+	_UdpFlow* flow = (_UdpFlow*)arg;
+	_TunnelsInfo* tunnelinfo = flow->tunnelinfo;
+	int count = le_udprecv(fd);
+
+	if (count == 0)
+		return;
+
+	flow->activetick = GetTickCount64();
+
+	for (int n = 0; n < count; n++) {
+		tunnelinfo->stats.bytesout += udpdatagrams[n].len;
+		if (flow->stream != NULL && udpdatagrams[n].len <= MUX_MAX_PAYLOAD)
+			le_linksend(flow->stream->link, eREQTYPE::STREAM_DATA, flow->stream->id, udpbuf[n], (WORD)udpdatagrams[n].len);
+	}
+
+	if (flow->stream == NULL)
+		le_udpsend(tunnelinfo->udpfd, (struct sockaddr*)&flow->client, flow->clientlen, 0, count);
+}
+
+// a DATA frame of a UDP stream is one datagram
+static void le_udpforward(_UdpFlow* flow, struct evbuffer* input, size_t len)
+{
+	_TunnelsInfo* tunnelinfo = flow->tunnelinfo;
+
+	evbuffer_remove(input, udpbuf[0], len);
+	udpdatagrams[0].len = len;
+	flow->activetick = GetTickCount64();
+
+	if (flow->fd != -1) {
+		tunnelinfo->stats.bytesin += len;
+		le_udpsend(flow->fd, NULL, 0, 0, 1);
+	}
+	else {
+		tunnelinfo->stats.bytesout += len;
+		le_udpsend(tunnelinfo->udpfd, (struct sockaddr*)&flow->client, flow->clientlen, 0, 1);
+	}
+}
+
+static _UdpFlow* le_udpflownew(_TunnelsInfo* tunnelinfo, const std::string& key)
+{
+	_UdpFlow* flow = new _UdpFlow;
+	flow->tunnelinfo = tunnelinfo;
+	flow->key = key;
+	flow->clientlen = 0;
+	flow->fd = -1;
+	flow->readev = NULL;
+	flow->stream = NULL;
+	flow->activetick = GetTickCount64();
+
+	// idle flows are swept from the main loop
+	if (tunnelinfo->udptimer == NULL) {
+		struct timeval tv = { UDP_SWEEP_MSEC / 1000, (UDP_SWEEP_MSEC % 1000) * 1000 };
+		tunnelinfo->udptimer = event_new(base, -1, EV_PERSIST, le_udptimer_cb, (void*)tunnelinfo);
+		event_add(tunnelinfo->udptimer, &tv);
+	}
+	return flow;
+}
+
+// finds the flow of a client address, a new one is connected or opened as a link stream
+static _UdpFlow* le_udpflowget(_TunnelsInfo* tunnelinfo, _UdpDatagram* datagram)
+{
+	std::string key((const char*)&datagram->addr, datagram->addrlen);
+	std::map<std::string, _UdpFlow*>::iterator iter = tunnelinfo->mUdpFlows.find(key);
+
+	if (iter != tunnelinfo->mUdpFlows.end())
+		return iter->second;
+
+	_UdpFlow* flow = le_udpflownew(tunnelinfo, key);
+	memcpy(&flow->client, &datagram->addr, datagram->addrlen);
+	flow->clientlen = datagram->addrlen;
+
+	if (tunnelinfo->linkmode == _LINK_MODE::_LISTEN) {
+		_MuxLink* link = le_linkpick(tunnelinfo);
+
+		if (link == NULL) {
+			delete flow;
+			return NULL;
+		}
+
+		DWORD id = tunnelinfo->nextstream++;
+		BYTE type = MUX_OPEN_UDP;
+		le_linksend(link, eREQTYPE::STREAM_OPEN, id, &type, sizeof(type));
+		flow->stream = le_streamnew(link, id, NULL);
+		flow->stream->udpflow = flow;
+	}
+	else if (le_udpconnect(flow))
+		tunnelinfo->stats.activepairs++;
+	else {
+		delete flow;
+		return NULL;
+	}
+
+	tunnelinfo->stats.accepted++;
+	tunnelinfo->mUdpFlows[key] = flow;
+	msglog(eMSGTYPE::DEBUG, "%s UDP flow opened, %d flows.", tunnelinfo->name, (int)tunnelinfo->mUdpFlows.size());
+	return flow;
+}
+
+// connect side, a UDP stream opened by the link peer
+static void le_udpopen(_MuxLink* link, DWORD id)
+{
+	_TunnelsInfo* tunnelinfo = link->tunnelinfo;
+	std::string key = std::string((const char*)&link, sizeof(link)) + std::string((const char*)&id, sizeof(id));
+	_UdpFlow* flow = le_udpflownew(tunnelinfo, key);
+
+	if (!le_udpconnect(flow)) {
+		le_linksend(link, eREQTYPE::STREAM_RST, id, NULL, 0);
+		delete flow;
+		return;
+	}
+
+	flow->stream = le_streamnew(link, id, NULL);
+	flow->stream->udpflow = flow;
+
+	tunnelinfo->stats.accepted++;
+	tunnelinfo->mUdpFlows[key] = flow;
+}
+
+static bool le_udpconnect(_UdpFlow* flow)
+{
+	_TunnelsInfo* tunnelinfo = flow->tunnelinfo;
+	struct sockaddr_storage ss;
+	int socklen;
+
+	unsigned int clienthash = (tunnelinfo->linkmode == _LINK_MODE::_NONE) ? le_clienthash((struct sockaddr*)&flow->client) : 0;
+
+	if (!le_getlocaladdr(tunnelinfo, &ss, &socklen, clienthash))
+		return false;
+
+	flow->fd = socket(ss.ss_family, SOCK_DGRAM, 0);
+
+	if (flow->fd == -1 || connect(flow->fd, (struct sockaddr*)&ss, socklen) != 0) {
+		msglog(eMSGTYPE::ERROR, "%s UDP connect to local server %s failed, %s (%d).", tunnelinfo->name, tunnelinfo->local_serverip, __func__, __LINE__);
+		tunnelinfo->stats.errors++;
+		if (flow->fd != -1)
+			evutil_closesocket(flow->fd);
+		flow->fd = -1;
+		return false;
+	}
+
+	evutil_make_socket_nonblocking(flow->fd);
+	flow->readev = event_new(base, flow->fd, EV_READ | EV_PERSIST, le_udpflowreadcb, (void*)flow);
+	event_add(flow->readev, NULL);
+	return true;
+}
+
+// a flow carried by a link stream is freed through le_streamclose
+static void le_udpflowfree(_UdpFlow* flow)
+{
+	_TunnelsInfo* tunnelinfo = flow->tunnelinfo;
+
+	tunnelinfo->mUdpFlows.erase(flow->key);
+
+	if (flow->stream == NULL)
+		tunnelinfo->stats.activepairs--;
+	if (flow->readev)
+		event_free(flow->readev);
+	if (flow->fd != -1)
+		evutil_closesocket(flow->fd);
+	delete flow;
+}
+
+static void le_udptimer_cb(evutil_socket_t, short, void* arg)
+{
+	_TunnelsInfo* tunnelinfo = (_TunnelsInfo*)arg;
+	unsigned long long tick = GetTickCount64();
+	std::vector<_UdpFlow*> vExpired;
+
+	for (std::map<std::string, _UdpFlow*>::iterator iter = tunnelinfo->mUdpFlows.begin(); iter != tunnelinfo->mUdpFlows.end(); iter++) {
+		if (tick - iter->second->activetick >= (unsigned long long)tunnelinfo->udptimeout * 1000)
+			vExpired.push_back(iter->second);
+	}
+
+	for (size_t n = 0; n < vExpired.size(); n++) {
+		if (vExpired[n]->stream != NULL)
+			le_streamclose(vExpired[n]->stream, true);
+		else
+			le_udpflowfree(vExpired[n]);
+	}
+
+	if (vExpired.size() > 0)
+		msglog(eMSGTYPE::DEBUG, "%s %d idle UDP flows expired.", tunnelinfo->name, (int)vExpired.size());
+}
+
+static _TunnelsInfo* le_loadtunnel(const YAML::Node& _tunnelinfo)
+{
+	_TunnelsInfo* tunnelinfo = new _TunnelsInfo;
+
+	strncpy(tunnelinfo->name, _tunnelinfo["Name"].as<std::string>().c_str(), sizeof(tunnelinfo->name) - 1);
+
+	if (_tunnelinfo["Link Mode"]) {
+		std::string linkmode = _tunnelinfo["Link Mode"].as<std::string>();
+		if (linkmode == "Listen")
+			tunnelinfo->linkmode = _LINK_MODE::_LISTEN;
+		else if (linkmode == "Connect")
+			tunnelinfo->linkmode = _LINK_MODE::_CONNECT;
+	}
+
+	// a link mode tunnel only has the client side or the local server side
+	if (tunnelinfo->linkmode != _LINK_MODE::_CONNECT) {
+		tunnelinfo->proxyport = _tunnelinfo["Proxy Port"].as<int>();
+		strncpy(tunnelinfo->proxyip, _tunnelinfo["Proxy IP"].as<std::string>().c_str(), sizeof(tunnelinfo->proxyip) - 1);
+	}
+	if (tunnelinfo->linkmode != _LINK_MODE::_LISTEN && _tunnelinfo["Local Servers"]) {
+		const YAML::Node& backends = _tunnelinfo["Local Servers"];
+		for (YAML::const_iterator iter = backends.begin(); iter != backends.end(); iter++) {
+			_Backend* backend = new _Backend;
+			strncpy(backend->ip, (*iter)["IP"].as<std::string>().c_str(), sizeof(backend->ip) - 1);
+			backend->port = (*iter)["Port"].as<int>();
+			backend->tunnelinfo = tunnelinfo;
+			tunnelinfo->vBackends.push_back(backend);
+		}
+		// the first backend names the local server in logs
+		if (tunnelinfo->vBackends.size() > 0) {
+			memcpy(tunnelinfo->local_serverip, tunnelinfo->vBackends[0]->ip, sizeof(tunnelinfo->local_serverip));
+			tunnelinfo->local_serverport = tunnelinfo->vBackends[0]->port;
+		}
+		if (_tunnelinfo["Balance"] && _tunnelinfo["Balance"].as<std::string>() == "Client Hash")
+			tunnelinfo->balance = _BALANCE_TYPE::_CLIENT_HASH;
+		if (_tunnelinfo["Health Check"])
+			tunnelinfo->healthcheck = _tunnelinfo["Health Check"].as<int>();
+	}
+	else if (tunnelinfo->linkmode != _LINK_MODE::_LISTEN) {
+		tunnelinfo->local_serverport = _tunnelinfo["Local Server Port"].as<int>();
+		strncpy(tunnelinfo->local_serverip, _tunnelinfo["Local Server IP"].as<std::string>().c_str(), sizeof(tunnelinfo->local_serverip) - 1);
+	}
+	if (tunnelinfo->linkmode != _LINK_MODE::_NONE) {
+		tunnelinfo->linkport = _tunnelinfo["Link Port"].as<int>();
+		strncpy(tunnelinfo->linkip, _tunnelinfo["Link IP"] ? _tunnelinfo["Link IP"].as<std::string>().c_str() : "0.0.0.0", sizeof(tunnelinfo->linkip) - 1);
+		if (_tunnelinfo["Link Connections"])
+			tunnelinfo->linkconnections = _tunnelinfo["Link Connections"].as<int>();
+		if (_tunnelinfo["Multipath"])
+			tunnelinfo->multipath = _tunnelinfo["Multipath"].as<bool>();
+		if (_tunnelinfo["Stream Resume"])
+			tunnelinfo->resume = _tunnelinfo["Stream Resume"].as<bool>();
+		if (_tunnelinfo["Resume Timeout"])
+			tunnelinfo->resumetimeout = _tunnelinfo["Resume Timeout"].as<int>();
+		if (_tunnelinfo["Link Keepalive"])
+			tunnelinfo->keepalive = std::max(_tunnelinfo["Link Keepalive"].as<int>(), 0);
+		if (_tunnelinfo["Link Keepalive Misses"])
+			tunnelinfo->keepalivemisses = std::max(_tunnelinfo["Link Keepalive Misses"].as<int>(), 2);
+		if (tunnelinfo->multipath)
+			tunnelinfo->resume = true;
+		if (_tunnelinfo["Link Source IPs"] && tunnelinfo->linkmode == _LINK_MODE::_CONNECT) {
+			for (size_t n = 0; n < _tunnelinfo["Link Source IPs"].size(); n++)
+				tunnelinfo->vLinkSources.push_back(_tunnelinfo["Link Source IPs"][n].as<std::string>());
+		}
+		if (_tunnelinfo["Stream Window"])
+			tunnelinfo->streamwindow = _tunnelinfo["Stream Window"].as<int>();
+		if (tunnelinfo->streamwindow < MUX_MAX_PAYLOAD)
+			tunnelinfo->streamwindow = MUX_MAX_PAYLOAD;
+		if (_tunnelinfo["Priority"]) {
+			std::string priority = _tunnelinfo["Priority"].as<std::string>();
+			if (priority == "Interactive")
+				tunnelinfo->priority = _PRIORITY::_INTERACTIVE;
+			else if (priority == "Bulk")
+				tunnelinfo->priority = _PRIORITY::_BULK;
+		}
+		if (_tunnelinfo["Compression"] && _tunnelinfo["Compression"].as<std::string>() == "Deflate") {
+#ifdef __linux__
+			tunnelinfo->compression = true;
+#else
+			msglog(eMSGTYPE::INFO, "%s Compression is not supported, link data is sent as is.", tunnelinfo->name);
+#endif
+		}
+		if (_tunnelinfo["TLS"])
+			tunnelinfo->tls = _tunnelinfo["TLS"].as<bool>();
+		if (_tunnelinfo["KTLS"])
+			tunnelinfo->ktls = _tunnelinfo["KTLS"].as<bool>();
+		if (_tunnelinfo["TLS Certificate"])
+			strncpy(tunnelinfo->tlscert, _tunnelinfo["TLS Certificate"].as<std::string>().c_str(), sizeof(tunnelinfo->tlscert) - 1);
+		if (_tunnelinfo["TLS Key"])
+			strncpy(tunnelinfo->tlskey, _tunnelinfo["TLS Key"].as<std::string>().c_str(), sizeof(tunnelinfo->tlskey) - 1);
+		if (_tunnelinfo["TLS CA"])
+			strncpy(tunnelinfo->tlsca, _tunnelinfo["TLS CA"].as<std::string>().c_str(), sizeof(tunnelinfo->tlsca) - 1);
+		if (_tunnelinfo["TLS Server Name"])
+			strncpy(tunnelinfo->tlsservername, _tunnelinfo["TLS Server Name"].as<std::string>().c_str(), sizeof(tunnelinfo->tlsservername) - 1);
+	}
+
+	if (_tunnelinfo["Socket Options"])
+		le_loadsockopts(_tunnelinfo["Socket Options"], tunnelinfo->sockopts);
+	if (_tunnelinfo["Sharded Listener"])
+		tunnelinfo->sharded = _tunnelinfo["Sharded Listener"].as<bool>();
+	if (_tunnelinfo["Splice"])
+		tunnelinfo->splice = _tunnelinfo["Splice"].as<bool>();
+	if (_tunnelinfo["IO Uring"])
+		tunnelinfo->uring = _tunnelinfo["IO Uring"].as<bool>();
+	if (_tunnelinfo["Sockmap"])
+		tunnelinfo->sockmap = _tunnelinfo["Sockmap"].as<bool>();
+	if (_tunnelinfo["Proxy Protocol"])
+		tunnelinfo->proxyprotocol = _tunnelinfo["Proxy Protocol"].as<bool>();
+#ifdef _WIN32
+	if (_tunnelinfo["Registered IO"])
+		tunnelinfo->rio = _tunnelinfo["Registered IO"].as<bool>();
+#endif
+	if (_tunnelinfo["High Watermark"])
+		tunnelinfo->highwatermark = _tunnelinfo["High Watermark"].as<size_t>();
+	if (_tunnelinfo["Low Watermark"])
+		tunnelinfo->lowwatermark = _tunnelinfo["Low Watermark"].as<size_t>();
+	if (tunnelinfo->lowwatermark >= tunnelinfo->highwatermark)
+		tunnelinfo->lowwatermark = tunnelinfo->highwatermark / 2;
+	if (_tunnelinfo["Read Size Max"])
+		tunnelinfo->readsizemax = std::min(std::max(_tunnelinfo["Read Size Max"].as<int>(), 0), 16 * 1024 * 1024);
+	if (_tunnelinfo["Read Size Min"])
+		tunnelinfo->readsizemin = _tunnelinfo["Read Size Min"].as<int>();
+	if (tunnelinfo->readsizemin <= 0)
+		tunnelinfo->readsizemin = READ_SIZE_MIN;
+	if (tunnelinfo->readsizemin > tunnelinfo->readsizemax)
+		tunnelinfo->readsizemin = tunnelinfo->readsizemax;
+	if (_tunnelinfo["Min Idle"])
+		tunnelinfo->minidle = _tunnelinfo["Min Idle"].as<int>();
+	if (_tunnelinfo["Max Idle"])
+		tunnelinfo->maxidle = _tunnelinfo["Max Idle"].as<int>();
+	if (tunnelinfo->maxidle < tunnelinfo->minidle)
+		tunnelinfo->maxidle = tunnelinfo->minidle;
+	if (_tunnelinfo["DNS Refresh"])
+		tunnelinfo->dnsrefresh = _tunnelinfo["DNS Refresh"].as<int>();
+	if (_tunnelinfo["Read Timeout"])
+		tunnelinfo->readtimeout = _tunnelinfo["Read Timeout"].as<int>();
+	if (_tunnelinfo["Write Timeout"])
+		tunnelinfo->writetimeout = _tunnelinfo["Write Timeout"].as<int>();
+	if (_tunnelinfo["Rate Limit"])
+		tunnelinfo->ratelimit = _tunnelinfo["Rate Limit"].as<long long>();
+	if (_tunnelinfo["Client Rate Limit"])
+		tunnelinfo->clientratelimit = _tunnelinfo["Client Rate Limit"].as<long long>();
+	if (_tunnelinfo["Rate Limit Share"])
+		tunnelinfo->rateshare = _tunnelinfo["Rate Limit Share"].as<int>();
+	if (_tunnelinfo["Top Talkers"])
+		tunnelinfo->toptalkers = _tunnelinfo["Top Talkers"].as<int>();
+	if (_tunnelinfo["Top Talker Limit"])
+		tunnelinfo->talkerlimit = _tunnelinfo["Top Talker Limit"].as<long long>();
+	if (_tunnelinfo["Listen Backlog"])
+		tunnelinfo->backlog = _tunnelinfo["Listen Backlog"].as<int>();
+	if (_tunnelinfo["Max Connections"])
+		tunnelinfo->maxconnections = _tunnelinfo["Max Connections"].as<long long>();
+	if (_tunnelinfo["Accept Rate"])
+		tunnelinfo->acceptrate = _tunnelinfo["Accept Rate"].as<int>();
+	if (_tunnelinfo["Accept Burst"])
+		tunnelinfo->acceptburst = _tunnelinfo["Accept Burst"].as<int>();
+	if (_tunnelinfo["Circuit Breaker"])
+		tunnelinfo->breaker = std::max(_tunnelinfo["Circuit Breaker"].as<int>(), 0);
+	if (_tunnelinfo["Breaker Cooldown"])
+		tunnelinfo->breakercooldown = std::max(_tunnelinfo["Breaker Cooldown"].as<int>(), 1);
+	if (_tunnelinfo["Connect Timeout"])
+		tunnelinfo->connecttimeout = std::max(_tunnelinfo["Connect Timeout"].as<int>(), 0);
+
+	if (_tunnelinfo["HTTP Cache"])
+		tunnelinfo->httpcache = _tunnelinfo["HTTP Cache"].as<bool>();
+	if (_tunnelinfo["HTTP Cache Memory"])
+		tunnelinfo->httpmemory = _tunnelinfo["HTTP Cache Memory"].as<size_t>();
+	if (_tunnelinfo["HTTP Cache Object"])
+		tunnelinfo->httpobject = _tunnelinfo["HTTP Cache Object"].as<size_t>();
+	if (_tunnelinfo["HTTP Cache Dir"])
+		strncpy(tunnelinfo->httpdir, _tunnelinfo["HTTP Cache Dir"].as<std::string>().c_str(), sizeof(tunnelinfo->httpdir) - 1);
+	if (_tunnelinfo["HTTP Cache Disk"])
+		tunnelinfo->httpdisk = _tunnelinfo["HTTP Cache Disk"].as<size_t>();
+
+	if (_tunnelinfo["Protocol"] && _tunnelinfo["Protocol"].as<std::string>() == "UDP")
+		tunnelinfo->udp = true;
+	if (_tunnelinfo["UDP Timeout"])
+		tunnelinfo->udptimeout = _tunnelinfo["UDP Timeout"].as<int>();
+
+	if (_tunnelinfo["Virtual Hosts"] && tunnelinfo->linkmode != _LINK_MODE::_CONNECT) {
+		for (size_t n = 0; n < _tunnelinfo["Virtual Hosts"].size(); n++) {
+			std::string vhost = _tunnelinfo["Virtual Hosts"][n].as<std::string>();
+			std::transform(vhost.begin(), vhost.end(), vhost.begin(), ::tolower);
+			tunnelinfo->vVhosts.push_back(vhost);
+		}
+	}
+
+	// streams of a link and UDP flows all run on the main loop
+	if (tunnelinfo->linkmode != _LINK_MODE::_NONE || tunnelinfo->udp) {
+		tunnelinfo->sharded = false;
+		tunnelinfo->splice = false;
+		tunnelinfo->uring = false;
+		tunnelinfo->rio = false;
+		tunnelinfo->sockmap = false;
+	}
+	// splice already keeps the bytes in the kernel
+	if (tunnelinfo->splice)
+		tunnelinfo->uring = false;
+	// redirected bytes skip the bufferevents, so the rate buckets too
+	if (tunnelinfo->splice || tunnelinfo->uring || tunnelinfo->ratelimit > 0 || tunnelinfo->clientratelimit > 0)
+		tunnelinfo->sockmap = false;
+	if (tunnelinfo->udp)
+		tunnelinfo->minidle = 0;
+	// the cache has no proxy port to serve on the connect side, nor requests in datagrams
+	if (tunnelinfo->linkmode == _LINK_MODE::_CONNECT || tunnelinfo->udp)
+		tunnelinfo->httpcache = false;
+	// its clients are parsed on the main loop
+	if (tunnelinfo->httpcache) {
+		tunnelinfo->sharded = false;
+		tunnelinfo->splice = false;
+		tunnelinfo->uring = false;
+		tunnelinfo->rio = false;
+		tunnelinfo->sockmap = false;
+	}
+	// clients are counted on the pairs relaying through bufferevents
+	if (tunnelinfo->linkmode != _LINK_MODE::_NONE || tunnelinfo->udp || tunnelinfo->httpcache) {
+		tunnelinfo->toptalkers = 0;
+		tunnelinfo->talkerlimit = 0;
+	}
+	// every client already has a bucket of its own
+	if (tunnelinfo->clientratelimit > 0)
+		tunnelinfo->talkerlimit = 0;
+	if (tunnelinfo->talkerlimit > 0 && tunnelinfo->toptalkers <= 0)
+		tunnelinfo->toptalkers = 10;
+	if (tunnelinfo->toptalkers > 0) {
+		tunnelinfo->splice = false;
+		tunnelinfo->uring = false;
+		tunnelinfo->rio = false;
+		tunnelinfo->sockmap = false;
+	}
+	// the listen side always sends the client address, the connect side writes the header
+	if (tunnelinfo->udp || tunnelinfo->linkmode == _LINK_MODE::_LISTEN)
+		tunnelinfo->proxyprotocol = false;
+	// it goes out first through the bufferevent of the local side, a sockmap takes the pair after it
+	if (tunnelinfo->proxyprotocol) {
+		tunnelinfo->splice = false;
+		tunnelinfo->uring = false;
+		tunnelinfo->rio = false;
+	}
+	// the shared listener is on the main loop and datagrams carry no name to route by
+	if (tunnelinfo->udp)
+		tunnelinfo->vVhosts.clear();
+	if (tunnelinfo->vVhosts.size() > 0) {
+		tunnelinfo->sharded = false;
+		tunnelinfo->rio = false;
+	}
+	// a bucket holds a second of accepts unless told otherwise
+	if (tunnelinfo->acceptrate > 1000000)
+		tunnelinfo->acceptrate = 1000000;
+	if (tunnelinfo->acceptrate > 0 && tunnelinfo->acceptburst <= 0)
+		tunnelinfo->acceptburst = tunnelinfo->acceptrate;
+	if (tunnelinfo->backlog == 0)
+		tunnelinfo->backlog = -1;
+	// a resumed stream resends plain bytes, a deflater can't go back to them
+	if (tunnelinfo->resume && tunnelinfo->compression) {
+		msglog(eMSGTYPE::INFO, "%s Compression is off with Stream Resume.", tunnelinfo->name);
+		tunnelinfo->compression = false;
+	}
+	if (tunnelinfo->linkmode == _LINK_MODE::_CONNECT && (int)tunnelinfo->vLinkSources.size() > tunnelinfo->linkconnections)
+		tunnelinfo->linkconnections = (int)tunnelinfo->vLinkSources.size();
+
+	return tunnelinfo;
+}
+
+static bool le_starttunnel(_TunnelsInfo* tunnelinfo)
+{
+	struct evutil_addrinfo hints, * listenaddr;
+	char listenport[8];
+
+	if (tunnelinfo->linkmode != _LINK_MODE::_CONNECT) {
+		msglog(eMSGTYPE::INFO, "%s Proxy Server IP %s.", tunnelinfo->name, tunnelinfo->proxyip);
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = tunnelinfo->udp ? SOCK_DGRAM : SOCK_STREAM;
+		hints.ai_flags = EVUTIL_AI_PASSIVE;
+		sprintf(listenport, "%d", tunnelinfo->proxyport);
+
+		if (evutil_getaddrinfo(tunnelinfo->proxyip, listenport, &hints, &listenaddr) != 0) {
+			msglog(eMSGTYPE::ERROR, "%s failed to resolve proxy IP %s, %s (%d).", tunnelinfo->name, tunnelinfo->proxyip, __func__, __LINE__);
+			return false;
+		}
+
+		bool listening = tunnelinfo->udp ? le_udpbind(tunnelinfo, listenaddr->ai_addr, (int)listenaddr->ai_addrlen)
+			: le_listen(tunnelinfo, listenaddr->ai_addr, (int)listenaddr->ai_addrlen);
+		evutil_freeaddrinfo(listenaddr);
+
+		if (!listening) {
+			msglog(eMSGTYPE::ERROR, "evconnlistener_new_bind failed at port %d, %s (%d).", tunnelinfo->proxyport, __func__, __LINE__);
+			return false;
+		}
+
+		msglog(eMSGTYPE::INFO, "%s Proxy Server is listening to proxy port %d.", tunnelinfo->name, tunnelinfo->proxyport);
+	}
+
+	if (tunnelinfo->linkmode != _LINK_MODE::_LISTEN) {
+		if (tunnelinfo->vBackends.size() > 0)
+			le_backendstart(tunnelinfo);
+		else
+			le_resolve(tunnelinfo);
+		le_startpools(tunnelinfo);
+	}
+
+	le_ratestart(tunnelinfo);
+	le_talkerstart(tunnelinfo);
+
+	if (tunnelinfo->httpcache)
+		le_httpstart(tunnelinfo);
+
+	if (tunnelinfo->linkmode != _LINK_MODE::_NONE && !le_startlink(tunnelinfo))
+		return false;
+
+	return true;
+}
+
+static void le_tunneladd(_TunnelsInfo* tunnelinfo)
+{
+	tunnelinfo->slot = vTunnels.size();
+	vTunnels.push_back(tunnelinfo);
+	mTunnelNames[tunnelinfo->name] = tunnelinfo;
+	if (tunnelinfo->proxyport > 0 && tunnelinfo->vVhosts.size() == 0)
+		mTunnelPorts[tunnelinfo->proxyport] = tunnelinfo;
+}
+
+// the last tunnel takes its slot, the metrics list them in no particular order
+static void le_tunnelremove(_TunnelsInfo* tunnelinfo)
+{
+	vTunnels[tunnelinfo->slot] = vTunnels.back();
+	vTunnels[tunnelinfo->slot]->slot = tunnelinfo->slot;
+	vTunnels.pop_back();
+	mTunnelNames.erase(tunnelinfo->name);
+
+	std::unordered_map<int, _TunnelsInfo*>::iterator iter = mTunnelPorts.find(tunnelinfo->proxyport);
+	if (iter != mTunnelPorts.end() && iter->second == tunnelinfo)
+		mTunnelPorts.erase(iter);
+}
+
+// the running tunnel of another name holding the proxy port tunnelinfo wants to listen on
+static _TunnelsInfo* le_tunnelport(_TunnelsInfo* tunnelinfo)
+{
+	if (tunnelinfo->proxyport <= 0)
+		return NULL;
+
+	std::unordered_map<int, _TunnelsInfo*>::iterator iter = mTunnelPorts.find(tunnelinfo->proxyport);
+	if (iter == mTunnelPorts.end() || strcmp(iter->second->name, tunnelinfo->name) == 0)
+		return NULL;
+	return iter->second;
+}
+
+// running is updated in place when only what new connections read changed, otherwise it stops accepting
+// and loaded starts in its place. either may be NULL to start or stop a tunnel. false when loaded could
+// not start, it is retired then and running is gone either way
+static bool le_tunnelswap(_TunnelsInfo* running, _TunnelsInfo* loaded)
+{
+	if (running != NULL && loaded != NULL && !le_tunnelchanged(running, loaded)) {
+		le_updatetunnel(running, loaded);
+		le_backendstop(loaded);
+		delete loaded;
+		return true;
+	}
+
+	// listeners are freed first so a restarted tunnel can bind the same port
+	if (running != NULL) {
+		le_tunnelremove(running);
+		le_retiretunnel(running);
+		vRetired.push_back(running);
+	}
+
+	if (loaded == NULL)
+		return true;
+
+	if (le_starttunnel(loaded)) {
+		le_tunneladd(loaded);
+		return true;
+	}
+
+	msglog(eMSGTYPE::ERROR, "%s Proxy Server failed to start, %s (%d).", loaded->name, __func__, __LINE__);
+	le_retiretunnel(loaded);
+	vRetired.push_back(loaded);
+	return false;
+}
+
+#ifndef _WIN32
+// SIGUSR2, the bytes each subsystem holds, also at /metrics
+static void le_memdump_cb(evutil_socket_t, short, void*)
+{
+	std::string report = memtagreport();
+	size_t start = 0;
+
+	msglog(eMSGTYPE::INFO, "Memory by subsystem.");
+	while (start < report.size()) {
+		size_t end = report.find('\n', start);
+		msglog(eMSGTYPE::INFO, "%s", report.substr(start, end - start).c_str());
+		start = end + 1;
+	}
+}
+
+// SIGHUP, tunnels are matched by name; new ones start, removed ones stop accepting and their pairs drain,
+// a changed local server or timeout only applies to connections made after the reload
+static void le_reload_cb(evutil_socket_t, short, void*)
+{
+	_LoopBusy busy("reload", 0);
+	std::vector<_TunnelsInfo*> vLoaded;
+
+	msglog(eMSGTYPE::INFO, "Reloading proxy.yaml.");
+
+	try {
+		_CONF_SOURCE source;
+		YAML::Node configs = confcacheload("proxy.yaml", source);
+		YAML::Node tunnellist = configs["Proxy  Servers"];
+
+		for (YAML::iterator iter = tunnellist.begin(); iter != tunnellist.end(); iter++) {
+			const YAML::Node& _tunnelinfo = *iter;
+			if (_tunnelinfo["Enable"].as<bool>() == true)
+				vLoaded.push_back(le_loadtunnel(_tunnelinfo));
+		}
+
+		if (!confcachesave("proxy.yaml", source, configs))
+			msglog(eMSGTYPE::ERROR, "The image of proxy.yaml could not be written, it is parsed again next time.");
+	}
+	catch (const YAML::Exception& e) {
+		msglog(eMSGTYPE::ERROR, "YAML error, %s, running tunnels are kept.", e.msg.c_str());
+		for (size_t n = 0; n < vLoaded.size(); n++) {
+			le_backendstop(vLoaded[n]);
+			delete vLoaded[n];
+		}
+		return;
+	}
+
+	std::unordered_map<std::string, size_t> mLoaded;
+	for (size_t n = 0; n < vLoaded.size(); n++) {
+		if (!mLoaded.insert(std::make_pair(std::string(vLoaded[n]->name), n)).second) {
+			msglog(eMSGTYPE::ERROR, "%s Proxy Server is listed twice, the first one is kept.", vLoaded[n]->name);
+			le_backendstop(vLoaded[n]);
+			delete vLoaded[n];
+			vLoaded.erase(vLoaded.begin() + n--);
+		}
+	}
+
+	// every tunnel that stops or restarts frees its ports before any starts, two may trade them
+	std::vector<_TunnelsInfo*> vRunning = vTunnels;
+	for (size_t n = 0; n < vRunning.size(); n++) {
+		_TunnelsInfo* running = vRunning[n];
+		std::unordered_map<std::string, size_t>::iterator iter = mLoaded.find(running->name);
+
+		if (iter != mLoaded.end() && !le_tunnelchanged(running, vLoaded[iter->second])) {
+			le_tunnelswap(running, vLoaded[iter->second]);
+			vLoaded[iter->second] = NULL;
+		}
+		else
+			le_tunnelswap(running, NULL);
+	}
+
+	// in the order of proxy.yaml
+	for (size_t n = 0; n < vLoaded.size(); n++) {
+		if (vLoaded[n] != NULL)
+			le_tunnelswap(NULL, vLoaded[n]);
+	}
+
+	msglog(eMSGTYPE::INFO, "Reload done, %d proxy servers running.", (int)vTunnels.size());
+}
+
+// anything bound to a listener, a pool or a rate group restarts the tunnel, the rest is updated in place
+static bool le_tunnelchanged(_TunnelsInfo* running, _TunnelsInfo* loaded)
+{
+	if (running->vBackends.size() != loaded->vBackends.size() || running->balance != loaded->balance
+		|| running->healthcheck != loaded->healthcheck)
+		return true;
+
+	for (size_t n = 0; n < running->vBackends.size(); n++) {
+		if (strcmp(running->vBackends[n]->ip, loaded->vBackends[n]->ip) != 0 || running->vBackends[n]->port != loaded->vBackends[n]->port)
+			return true;
+	}
+
+	return strcmp(running->proxyip, loaded->proxyip) != 0
+		|| running->proxyport != loaded->proxyport
+		|| running->sharded != loaded->sharded
+		|| running->splice != loaded->splice
+		|| running->uring != loaded->uring
+		|| running->sockopts.fastopen != loaded->sockopts.fastopen
+		|| running->sockopts.sndbuf != loaded->sockopts.sndbuf
+		|| running->sockopts.rcvbuf != loaded->sockopts.rcvbuf
+		|| (running->minidle > 0) != (loaded->minidle > 0)
+		|| running->linkmode != loaded->linkmode
+		|| strcmp(running->linkip, loaded->linkip) != 0
+		|| running->linkport != loaded->linkport
+		|| running->linkconnections != loaded->linkconnections
+		|| running->multipath != loaded->multipath
+		|| running->resume != loaded->resume
+		|| running->resumetimeout != loaded->resumetimeout
+		|| running->keepalive != loaded->keepalive
+		|| running->keepalivemisses != loaded->keepalivemisses
+		|| running->vLinkSources != loaded->vLinkSources
+		|| running->streamwindow != loaded->streamwindow
+		|| running->compression != loaded->compression
+		|| running->tls != loaded->tls
+		|| running->ktls != loaded->ktls
+		|| strcmp(running->tlscert, loaded->tlscert) != 0
+		|| strcmp(running->tlskey, loaded->tlskey) != 0
+		|| strcmp(running->tlsca, loaded->tlsca) != 0
+		|| strcmp(running->tlsservername, loaded->tlsservername) != 0
+		|| running->udp != loaded->udp
+		|| running->udptimeout != loaded->udptimeout
+		|| running->ratelimit != loaded->ratelimit
+		|| running->clientratelimit != loaded->clientratelimit
+		|| running->rateshare != loaded->rateshare
+		|| running->toptalkers != loaded->toptalkers
+		|| running->talkerlimit != loaded->talkerlimit
+		|| running->httpcache != loaded->httpcache
+		|| running->httpmemory != loaded->httpmemory
+		|| running->httpobject != loaded->httpobject
+		|| strcmp(running->httpdir, loaded->httpdir) != 0
+		|| running->httpdisk != loaded->httpdisk
+		|| running->vVhosts != loaded->vVhosts
+		|| running->backlog != loaded->backlog
+		|| running->acceptrate != loaded->acceptrate
+		|| running->acceptburst != loaded->acceptburst;
+}
+
+static void le_updatetunnel(_TunnelsInfo* running, _TunnelsInfo* loaded)
+{
+	running->highwatermark = loaded->highwatermark;
+	running->lowwatermark = loaded->lowwatermark;
+	running->readsizemin = loaded->readsizemin;
+	running->readsizemax = loaded->readsizemax;
+	running->readtimeout = loaded->readtimeout;
+	running->writetimeout = loaded->writetimeout;
+	running->sockopts = loaded->sockopts;
+	running->minidle = loaded->minidle;
+	running->maxidle = loaded->maxidle;
+	running->sockmap = loaded->sockmap;
+	running->proxyprotocol = loaded->proxyprotocol;
+	running->priority = loaded->priority;
+	running->maxconnections = loaded->maxconnections.load();
+	running->breaker = loaded->breaker;
+	running->breakercooldown = loaded->breakercooldown;
+	running->connecttimeout = loaded->connecttimeout;
+
+	if (running->vBackends.size() > 0 || (strcmp(running->local_serverip, loaded->local_serverip) == 0
+		&& running->local_serverport == loaded->local_serverport && running->dnsrefresh == loaded->dnsrefresh))
+		return;
+
+	if (running->dnstimer)
+		event_free(running->dnstimer);
+	running->dnstimer = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(running->addrlock);
+		memcpy(running->local_serverip, loaded->local_serverip, sizeof(running->local_serverip));
+		running->local_serverport = loaded->local_serverport;
+	}
+	running->dnsrefresh = loaded->dnsrefresh;
+
+	// addresses are in place before the pools see the new generation
+	le_resolve(running);
+	running->localgen++;
+
+	msglog(eMSGTYPE::INFO, "%s Local server is now %s port %d, %lld pairs kept.", running->name,
+		running->local_serverip, running->local_serverport, (long long)running->stats.activepairs);
+}
+
+static void le_retiretunnel(_TunnelsInfo* tunnelinfo)
+{
+	tunnelinfo->retired = true;
+
+	if (tunnelinfo->proxy_listener)
+		evconnlistener_free(tunnelinfo->proxy_listener);
+	tunnelinfo->proxy_listener = NULL;
+
+	// the other tunnels of a shared port keep its listener
+	le_vhostleave(tunnelinfo);
+
+	// sharded listeners are freed on their own loops
+	for (size_t n = 0; n < tunnelinfo->vShardListeners.size(); n++) {
+		struct evconnlistener* listener = tunnelinfo->vShardListeners[n];
+		event_base_once(evconnlistener_get_base(listener), -1, EV_TIMEOUT, le_shardfree_cb, (void*)listener, NULL);
+	}
+	tunnelinfo->vShardListeners.clear();
+
+	if (tunnelinfo->dnstimer)
+		event_free(tunnelinfo->dnstimer);
+	tunnelinfo->dnstimer = NULL;
+
+	// backends outlive the retired tunnel's pairs, only the checks stop
+	if (tunnelinfo->healthtimer)
+		event_free(tunnelinfo->healthtimer);
+	tunnelinfo->healthtimer = NULL;
+
+	// established links stay up for their streams, nothing new is accepted or dialed
+	if (tunnelinfo->linktimer)
+		event_free(tunnelinfo->linktimer);
+	tunnelinfo->linktimer = NULL;
+
+	if (tunnelinfo->link_listener)
+		evconnlistener_free(tunnelinfo->link_listener);
+	tunnelinfo->link_listener = NULL;
+
+	// a flow can't be told apart from a new client once the socket is gone, UDP tunnels stop outright
+	le_udpstop(tunnelinfo);
+
+	// the clients finish their requests without it, the restarted tunnel starts a cache of its own
+	le_cacheclear(tunnelinfo);
+
+	msglog(eMSGTYPE::INFO, "%s Proxy Server stopped accepting, %lld pairs left to drain.", tunnelinfo->name,
+		(long long)tunnelinfo->stats.activepairs);
+}
+
+// every tunnel stops accepting and is freed on exit, a reload would bind the ports again
+void le_retiretunnels()
+{
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		le_retiretunnel(vTunnels[n]);
+		vRetired.push_back(vTunnels[n]);
+	}
+	vTunnels.clear();
+	mTunnelNames.clear();
+	mTunnelPorts.clear();
+
+	if (reloadev)
+		event_free(reloadev);
+	reloadev = NULL;
+}
+
+static void le_shardfree_cb(evutil_socket_t, short, void* arg)
+{
+	evconnlistener_free((struct evconnlistener*)arg);
+}
+#endif
+
+#ifdef __linux__
+static bool le_splicestart(struct event_base* evbase, _TunnelsInfo* tunnelinfo, evutil_socket_t fd)
+{
+	struct sockaddr_storage remote_address;
+	int socklen;
+
+	_SplicePair* pair = new _SplicePair;
+	pair->base = evbase;
+	pair->tunnelinfo = tunnelinfo;
+	pair->fd[0] = fd;
+
+	unsigned int clienthash = 0;
+	if (tunnelinfo->balance == _BALANCE_TYPE::_CLIENT_HASH) {
+		struct sockaddr_storage ss;
+		ev_socklen_t sslen = sizeof(ss);
+		if (getpeername(fd, (struct sockaddr*)&ss, &sslen) == 0)
+			clienthash = le_clienthash((struct sockaddr*)&ss);
+	}
+
+	if (!le_getlocaladdr(tunnelinfo, &remote_address, &socklen, clienthash)) {
+		le_splicefree(pair);
+		return false;
+	}
+
+	pair->fd[1] = socket(remote_address.ss_family, SOCK_STREAM, 0);
+
+	if (pair->fd[1] == -1 || evutil_make_socket_nonblocking(pair->fd[0]) == -1 || evutil_make_socket_nonblocking(pair->fd[1]) == -1) {
+		msglog(eMSGTYPE::ERROR, "%s socket setup failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		le_splicefree(pair);
+		return false;
+	}
+
+	for (int n = 0; n < 2; n++) {
+		if (pipe2(pair->pipefd[n], O_NONBLOCK | O_CLOEXEC) == -1) {
+			msglog(eMSGTYPE::ERROR, "%s pipe2 failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+			le_splicefree(pair);
+			return false;
+		}
+	}
+
+	if (connect(pair->fd[1], (struct sockaddr*)&remote_address, socklen) == -1 && errno != EINPROGRESS) {
+		msglog(eMSGTYPE::ERROR, "%s connect failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		le_splicefree(pair);
+		return false;
+	}
+
+	pair->connectstart = le_nowusec();
+	tunnelinfo->stats.activepairs++;
+
+	// client data waits in the socket buffer until the local server is connected
+	pair->writeev[0] = event_new(evbase, pair->fd[1], EV_WRITE, le_spliceconnect_cb, (void*)pair);
+	event_add(pair->writeev[0], NULL);
+
+	msglog(eMSGTYPE::DEBUG, "%s Client connection accepted, splice mode...", tunnelinfo->name);
+	return true;
+}
+
+static void le_spliceconnect_cb(evutil_socket_t fd, short events, void* arg)
+{
+	_SplicePair* pair = (_SplicePair*)arg;
+	int err = 0;
+	socklen_t len = sizeof(err);
+
+	event_free(pair->writeev[0]);
+	pair->writeev[0] = NULL;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0) {
+		msglog(eMSGTYPE::ERROR, "%s connect to local server failed (%d), %s (%d).", pair->tunnelinfo->name, err, __func__, __LINE__);
+		pair->tunnelinfo->stats.errors++;
+		le_breakerresult(pair->tunnelinfo, false);
+		le_spliceclose(pair);
+		return;
+	}
+
+	le_statsconnected(pair->tunnelinfo, pair->connectstart);
+	le_breakerresult(pair->tunnelinfo, true);
+	pair->activetick = GetTickCount64();
+
+	for (int n = 0; n < 2; n++) {
+		pair->readev[n] = event_new(pair->base, pair->fd[n], EV_READ | EV_PERSIST, le_splicereadcb, (void*)pair);
+		pair->writeev[n] = event_new(pair->base, pair->fd[1 - n], EV_WRITE | EV_PERSIST, le_splicewritecb, (void*)pair);
+		le_spliceread(pair, n);
+	}
+}
+
+static void le_spliceread(_SplicePair* pair, int dir)
+{
+	struct timeval tv = { pair->tunnelinfo->readtimeout, 0 };
+	event_add(pair->readev[dir], (pair->tunnelinfo->readtimeout > 0) ? &tv : NULL);
+}
+
+// a readable fd is the source of its direction
+static void le_splicereadcb(evutil_socket_t fd, short events, void* arg)
+{
+	_SplicePair* pair = (_SplicePair*)arg;
+	int dir = (fd == pair->fd[0]) ? 0 : 1;
+
+	if (events & EV_TIMEOUT) {
+		if (GetTickCount64() - pair->activetick < (unsigned long long)pair->tunnelinfo->readtimeout * 1000)
+			return;
+		msglog(eMSGTYPE::DEBUG, "%s Proxy idle timeout.", pair->tunnelinfo->name);
+		le_spliceclose(pair);
+		return;
+	}
+
+	if (!le_splicepump(pair, dir)) {
+		msglog(eMSGTYPE::DEBUG, "Proxy disconnected.");
+		le_spliceclose(pair);
+	}
+}
+
+// a writable fd is the sink of the other direction
+static void le_splicewritecb(evutil_socket_t fd, short events, void* arg)
+{
+	_SplicePair* pair = (_SplicePair*)arg;
+	int dir = (fd == pair->fd[1]) ? 0 : 1;
+
+	if (events & EV_TIMEOUT) {
+		msglog(eMSGTYPE::DEBUG, "%s Proxy write timeout.", pair->tunnelinfo->name);
+		le_spliceclose(pair);
+		return;
+	}
+
+	if (!le_splicepump(pair, dir)) {
+		msglog(eMSGTYPE::DEBUG, "Proxy disconnected.");
+		le_spliceclose(pair);
+	}
+}
+
+static bool le_splicepump(_SplicePair* pair, int dir)
+{
+	ssize_t n;
+
+	// bounded per callback so one bulk pair can't starve the loop, the read event is level triggered
+	for (int chunks = 0; chunks < SPLICE_MAX_CHUNKS_PERCB; chunks++) {
+		if (pair->pending[dir] == 0) {
+			n = splice(pair->fd[dir], NULL, pair->pipefd[dir][1], NULL, SPLICE_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (n == 0) {
+				// half close, the pipe is empty so the sink gets its FIN now
+				pair->eof[dir] = true;
+				event_del(pair->readev[dir]);
+				shutdown(pair->fd[1 - dir], SHUT_WR);
+				return !(pair->eof[0] && pair->eof[1]);
+			}
+			if (n == -1)
+				return (errno == EAGAIN || errno == EINTR);
+			pair->pending[dir] = (size_t)n;
+			pair->activetick = GetTickCount64();
+		}
+
+		n = splice(pair->pipefd[dir][0], NULL, pair->fd[1 - dir], NULL, pair->pending[dir], SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n == -1 && errno != EAGAIN && errno != EINTR) {
+			pair->tunnelinfo->stats.errors++;
+			return false;
+		}
+		if (n > 0) {
+			pair->pending[dir] -= (size_t)n;
+			if (dir == 0)
+				pair->tunnelinfo->stats.bytesin += n;
+			else
+				pair->tunnelinfo->stats.bytesout += n;
+		}
+
+		if (pair->pending[dir] > 0) {
+			// sink is full, stop reading the source until it drains
+			struct timeval tv = { pair->tunnelinfo->writetimeout, 0 };
+			event_del(pair->readev[dir]);
+			event_add(pair->writeev[dir], (pair->tunnelinfo->writetimeout > 0) ? &tv : NULL);
+			return true;
+		}
+
+		if (!event_pending(pair->readev[dir], EV_READ, NULL)) {
+			event_del(pair->writeev[dir]);
+			le_spliceread(pair, dir);
+		}
+	}
+	return true;
+}
+
+static void le_spliceclose(_SplicePair* pair)
+{
+	_RelayWorker* worker = le_getworker(pair->base);
+	if (worker != NULL)
+		worker->connections--;
+
+	pair->tunnelinfo->stats.activepairs--;
+	le_splicefree(pair);
+}
+
+static void le_splicefree(_SplicePair* pair)
+{
+	for (int n = 0; n < 2; n++) {
+		if (pair->readev[n])
+			event_free(pair->readev[n]);
+		if (pair->writeev[n])
+			event_free(pair->writeev[n]);
+		if (pair->fd[n] != -1)
+			evutil_closesocket(pair->fd[n]);
+		if (pair->pipefd[n][0] != -1)
+			close(pair->pipefd[n][0]);
+		if (pair->pipefd[n][1] != -1)
+			close(pair->pipefd[n][1]);
+	}
+
+	delete pair;
+}
+
+#endif
+
+static bool le_listen(_TunnelsInfo* tunnelinfo, const struct sockaddr* sa, int socklen)
+{
+	if (tunnelinfo->vVhosts.size() > 0)
+		return le_vhostjoin(tunnelinfo, sa, socklen);
+
+	if (tunnelinfo->sharded && vWorkers.size() > 0) {
+#ifndef _WIN32
+		// each relay loop binds its own listener to the proxy port and the kernel spreads the accepts, the
+		// main loop turns them off and on while it sheds
+		unsigned int shedflags = (shedlagmsec > 0) ? LEV_OPT_THREADSAFE : 0;
+		for (size_t n = 0; n < vWorkers.size(); n++) {
+			evutil_socket_t fd = le_upgradetake(tunnelinfo, _UPGRADE_FD::_PROXY, sa);
+			struct evconnlistener* listener = (fd != -1)
+				? evconnlistener_new(vWorkers[n]->base, le_shardlistener_cb, (void*)tunnelinfo, LEV_OPT_CLOSE_ON_FREE | shedflags, tunnelinfo->backlog, fd)
+				: evconnlistener_new_bind(vWorkers[n]->base, le_shardlistener_cb, (void*)tunnelinfo,
+				LEV_OPT_REUSEABLE | LEV_OPT_REUSEABLE_PORT | LEV_OPT_CLOSE_ON_FREE | shedflags, tunnelinfo->backlog,
+				sa,
+				socklen);
+
+			if (!listener) {
+				for (size_t i = 0; i < tunnelinfo->vShardListeners.size(); i++)
+					evconnlistener_free(tunnelinfo->vShardListeners[i]);
+				tunnelinfo->vShardListeners.clear();
+				return false;
+			}
+
+			le_setlistenopts(listener, tunnelinfo->sockopts);
+			tunnelinfo->vShardListeners.push_back(listener);
+		}
+
+		msglog(eMSGTYPE::DEBUG, "%s Proxy Server has %d sharded listeners.", tunnelinfo->name, (int)tunnelinfo->vShardListeners.size());
+		return true;
+#else
+		msglog(eMSGTYPE::INFO, "%s Sharded listener is not supported, using single listener.", tunnelinfo->name);
+#endif
+	}
+
+#ifdef _WIN32
+	if (tunnelinfo->rio && le_riolisten(tunnelinfo, sa, socklen))
+		return true;
+#endif
+
+#ifndef _WIN32
+	// handed over by the process this one took over from, its accept queue comes along
+	evutil_socket_t fd = le_upgradetake(tunnelinfo, _UPGRADE_FD::_PROXY, sa);
+	if (fd != -1)
+		tunnelinfo->proxy_listener = evconnlistener_new(base, le_proxylistener_cb, (void*)tunnelinfo, LEV_OPT_CLOSE_ON_FREE, tunnelinfo->backlog, fd);
+	else
+#endif
+	tunnelinfo->proxy_listener = evconnlistener_new_bind(base, le_proxylistener_cb, (void*)tunnelinfo,
+		LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, tunnelinfo->backlog,
+		sa,
+		socklen);
+
+	if (tunnelinfo->proxy_listener == NULL)
+		return false;
+	le_setlistenopts(tunnelinfo->proxy_listener, tunnelinfo->sockopts);
+	return true;
+}
+
+// the first tunnel on an address binds the listener, the next ones only add their names
+static bool le_vhostjoin(_TunnelsInfo* tunnelinfo, const struct sockaddr* sa, int socklen)
+{
+	for (size_t n = 0; n < vVhosts.size(); n++) {
+		if (evutil_sockaddr_cmp((const struct sockaddr*)&vVhosts[n]->addr, sa, 1) != 0)
+			continue;
+		vVhosts[n]->vTunnels.push_back(tunnelinfo);
+		tunnelinfo->vhost = vVhosts[n];
+		return true;
+	}
+
+	_VhostListener* vhost = new _VhostListener;
+	memcpy(vhost->ip, tunnelinfo->proxyip, sizeof(vhost->ip));
+	vhost->port = tunnelinfo->proxyport;
+	memcpy(&vhost->addr, sa, socklen);
+	vhost->addrlen = socklen;
+
+#ifndef _WIN32
+	evutil_socket_t fd = le_upgradetake(tunnelinfo, _UPGRADE_FD::_VHOST, sa);
+	if (fd != -1)
+		vhost->listener = evconnlistener_new(base, le_vhostlistener_cb, (void*)vhost, LEV_OPT_CLOSE_ON_FREE, tunnelinfo->backlog, fd);
+	else
+#endif
+	vhost->listener = evconnlistener_new_bind(base, le_vhostlistener_cb, (void*)vhost,
+		LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, tunnelinfo->backlog,
+		sa,
+		socklen);
+
+	if (vhost->listener == NULL) {
+		delete vhost;
+		return false;
+	}
+
+	// the socket options, backlog and Accept Rate of the listener are the ones of the tunnel that bound it
+	le_setlistenopts(vhost->listener, tunnelinfo->sockopts);
+	vhost->vTunnels.push_back(tunnelinfo);
+	tunnelinfo->vhost = vhost;
+	vVhosts.push_back(vhost);
+	return true;
+}
+
+static void le_vhostleave(_TunnelsInfo* tunnelinfo)
+{
+	_VhostListener* vhost = tunnelinfo->vhost;
+
+	if (vhost == NULL)
+		return;
+	tunnelinfo->vhost = NULL;
+
+	vhost->vTunnels.erase(std::find(vhost->vTunnels.begin(), vhost->vTunnels.end(), tunnelinfo));
+	if (vhost->vTunnels.size() == 0)
+		le_vhostfree(vhost);
+}
+
+// the last tunnel left, clients not routed yet are closed with the listener
+static void le_vhostfree(_VhostListener* vhost)
+{
+	for (size_t n = 0; n < vhost->vPeeks.size(); n++) {
+		_VhostPeek* peek = vhost->vPeeks[n];
+		event_free(peek->ev);
+#ifdef _WIN32
+		event_free(peek->retry);
+#endif
+		evutil_closesocket(peek->fd);
+		delete peek;
+	}
+
+	evconnlistener_free(vhost->listener);
+	vVhosts.erase(std::find(vVhosts.begin(), vVhosts.end(), vhost));
+	delete vhost;
+}
+
+#ifdef _WIN32
+static void le_vhostretry_cb(evutil_socket_t, short, void* arg)
+{
+	_VhostPeek* peek = (_VhostPeek*)arg;
+	struct timeval tv = { VHOST_PEEK_MSEC / 1000, (VHOST_PEEK_MSEC % 1000) * 1000 };
+	event_add(peek->ev, &tv);
+}
+#endif
+
+static void le_vhostlistener_cb(struct evconnlistener* listener, evutil_socket_t fd,
+	struct sockaddr* sa, int socklen, void* user_data) {
+
+	_VhostListener* vhost = (_VhostListener*)user_data;
+	struct timeval tv = { VHOST_PEEK_MSEC / 1000, (VHOST_PEEK_MSEC % 1000) * 1000 };
+
+	// a flood is turned away before it holds a peek, Max Connections is of the tunnel it is routed to
+	_TunnelsInfo* first = vhost->vTunnels[0];
+	if (first->acceptlimiter != NULL && !le_acceptrate(first, le_clienthash(sa))) {
+		first->stats.rejectedrate++;
+		evutil_closesocket(fd);
+		return;
+	}
+
+	_VhostPeek* peek = new _VhostPeek;
+	peek->vhost = vhost;
+	peek->fd = fd;
+	peek->peeked = 0;
+
+	// edge triggered so bytes already peeked at don't wake the loop again, only new ones do
+#ifdef _WIN32
+	peek->ev = event_new(base, fd, EV_READ | EV_PERSIST, le_vhostpeekcb, (void*)peek);
+	peek->retry = evtimer_new(base, le_vhostretry_cb, (void*)peek);
+#else
+	peek->ev = event_new(base, fd, EV_READ | EV_PERSIST | EV_ET, le_vhostpeekcb, (void*)peek);
+#endif
+	peek->index = vhost->vPeeks.size();
+	vhost->vPeeks.push_back(peek);
+	event_add(peek->ev, &tv);
+}
+
+static void le_vhostpeekcb(evutil_socket_t fd, short events, void* arg)
+{
+	_VhostPeek* peek = (_VhostPeek*)arg;
+	std::string name;
+
+	if (events & EV_TIMEOUT) {
+		le_vhostdone(peek, le_vhostroute(peek->vhost, name));
+		return;
+	}
+
+	int len = (int)recv(fd, (char*)vhostbuf, sizeof(vhostbuf), MSG_PEEK);
+#ifdef _WIN32
+	if (len < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+		return;
+#else
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+#endif
+	if (len <= 0) {
+		le_vhostdone(peek, NULL);
+		return;
+	}
+
+	int found = le_vhostsni(vhostbuf, len, name);
+	if (found == -1)
+		found = le_vhosthost(vhostbuf, len, name);
+
+	// a ClientHello or request line split over segments waits for the rest while the buffer has room
+	if (found == 0 && len < (int)sizeof(vhostbuf)) {
+#ifdef _WIN32
+		if (len == peek->peeked) {
+			struct timeval tv = { 0, 10000 };
+			event_del(peek->ev);
+			evtimer_add(peek->retry, &tv);
+		}
+#endif
+		peek->peeked = len;
+		return;
+	}
+
+	_TunnelsInfo* tunnelinfo = le_vhostroute(peek->vhost, name);
+	if (tunnelinfo == NULL)
+		msglog(eMSGTYPE::DEBUG, "%s:%d Client for \"%s\" matches no Virtual Hosts, closed.", peek->vhost->ip, peek->vhost->port, name.c_str());
+	le_vhostdone(peek, tunnelinfo);
+}
+
+// 1 with the server name of a TLS ClientHello, 0 while the record is incomplete, -1 when it is not one or names none
+static int le_vhostsni(const unsigned char* data, int len, std::string& name)
+{
+	if (len < 1 || data[0] != 0x16)
+		return -1;
+	if (len < 5)
+		return 0;
+
+	int end = 5 + ((data[3] << 8) | data[4]);
+	if (len < end)
+		return 0;
+
+	// handshake type and length, client version and random
+	int pos = 5;
+	if (pos + 39 > end || data[pos] != 0x01)
+		return -1;
+	pos += 38;
+
+	// session id, cipher suites and compression methods
+	pos += 1 + data[pos];
+	if (pos + 2 > end)
+		return -1;
+	pos += 2 + ((data[pos] << 8) | data[pos + 1]);
+	if (pos + 1 > end)
+		return -1;
+	pos += 1 + data[pos];
+	if (pos + 2 > end)
+		return -1;
+
+	int extend = pos + 2 + ((data[pos] << 8) | data[pos + 1]);
+	if (extend > end)
+		extend = end;
+	pos += 2;
+
+	while (pos + 4 <= extend) {
+		int type = (data[pos] << 8) | data[pos + 1];
+		int extlen = (data[pos + 2] << 8) | data[pos + 3];
+		pos += 4;
+		if (pos + extlen > extend)
+			return -1;
+
+		// server_name, a list of which the host_name entry counts
+		if (type == 0) {
+			int item = pos + 2;
+			while (item + 3 <= pos + extlen) {
+				int namelen = (data[item + 1] << 8) | data[item + 2];
+				if (item + 3 + namelen > pos + extlen)
+					return -1;
+				if (data[item] == 0) {
+					name.assign((const char*)data + item + 3, namelen);
+					std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+					return 1;
+				}
+				item += 3 + namelen;
+			}
+			return -1;
+		}
+		pos += extlen;
+	}
+	return -1;
+}
+
+// 1 with the Host of an HTTP/1 request head, 0 while its line hasn't arrived, -1 when it is not a request or has none
+static int le_vhosthost(const unsigned char* data, int len, std::string& name)
+{
+	int pos = 0;
+
+	// a method token and a space, anything else is not a request
+	while (pos < len && data[pos] >= 'A' && data[pos] <= 'Z')
+		pos++;
+	if (pos == len)
+		return 0;
+	if (pos == 0 || data[pos] != ' ')
+		return -1;
+
+	const unsigned char* line = (const unsigned char*)memchr(data, '\n', len);
+	while (line != NULL) {
+		int start = (int)(line - data) + 1;
+		const unsigned char* next = (const unsigned char*)memchr(data + start, '\n', len - start);
+		if (next == NULL)
+			return 0;
+
+		int linelen = (int)(next - data) - start;
+		if (linelen > 0 && data[start + linelen - 1] == '\r')
+			linelen--;
+		// the blank line ends the head
+		if (linelen == 0)
+			return -1;
+
+		if (linelen > 5 && evutil_ascii_strncasecmp((const char*)data + start, "host:", 5) == 0) {
+			name.assign((const char*)data + start + 5, linelen - 5);
+			name.erase(0, name.find_first_not_of(" \t"));
+			name.erase(name.find_last_not_of(" \t") + 1);
+
+			// without the port, or the brackets of an IPv6 address
+			if (name.size() > 0 && name[0] == '[')
+				name = name.substr(1, name.find(']') - 1);
+			else if (name.find(':') != std::string::npos)
+				name.erase(name.find(':'));
+			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+			return 1;
+		}
+		line = next;
+	}
+	return 0;
+}
+
+// an exact name wins over the longest "*.domain" that covers it, "*" takes whatever is left
+static _TunnelsInfo* le_vhostroute(_VhostListener* vhost, const std::string& name)
+{
+	_TunnelsInfo* found = NULL;
+	size_t foundlen = 0;
+	std::string host = name;
+
+	// a fully qualified name ends with a dot
+	if (host.size() > 0 && host.back() == '.')
+		host.pop_back();
+
+	for (size_t n = 0; n < vhost->vTunnels.size(); n++) {
+		_TunnelsInfo* tunnelinfo = vhost->vTunnels[n];
+
+		for (size_t i = 0; i < tunnelinfo->vVhosts.size(); i++) {
+			const std::string& vname = tunnelinfo->vVhosts[i];
+
+			if (vname == host && host.size() > 0)
+				return tunnelinfo;
+			if (vname == "*" && found == NULL)
+				found = tunnelinfo;
+			else if (vname.size() > 2 && vname[0] == '*' && vname[1] == '.' && host.size() > vname.size() - 1
+				&& host.compare(host.size() - (vname.size() - 1), vname.size() - 1, vname, 1, std::string::npos) == 0
+				&& vname.size() > foundlen) {
+				found = tunnelinfo;
+				foundlen = vname.size();
+			}
+		}
+	}
+	return found;
+}
+
+// the client goes to its tunnel as if that one had accepted it, with the peeked bytes still unread
+static void le_vhostdone(_VhostPeek* peek, _TunnelsInfo* tunnelinfo)
+{
+	_VhostListener* vhost = peek->vhost;
+	evutil_socket_t fd = peek->fd;
+
+	vhost->vPeeks[peek->index] = vhost->vPeeks.back();
+	vhost->vPeeks[peek->index]->index = peek->index;
+	vhost->vPeeks.pop_back();
+
+	event_free(peek->ev);
+#ifdef _WIN32
+	event_free(peek->retry);
+#endif
+	delete peek;
+
+	if (tunnelinfo == NULL) {
+		vhost->unmatched++;
+		evutil_closesocket(fd);
+		return;
+	}
+
+	le_proxylistener_cb(NULL, fd, NULL, 0, (void*)tunnelinfo);
+}
+
+static struct event_base* le_newbase()
+{
+	struct event_base* evbase;
+#ifdef _WIN32
+	SYSTEM_INFO SystemInfo;
+	GetSystemInfo(&SystemInfo);
+
+	event_config* pConfig = event_config_new();
+	event_config_set_flag(pConfig, EVENT_BASE_FLAG_STARTUP_IOCP);
+	event_config_set_num_cpus_hint(pConfig, SystemInfo.dwNumberOfProcessors);
+	evbase = event_base_new_with_config(pConfig);
+	event_config_free(pConfig);
+#else
+	evbase = event_base_new();
+#endif
+	return evbase;
+}
+
+static bool le_startworkers(int count)
+{
+	unsigned int cpus = std::thread::hardware_concurrency();
+
+	for (int n = 0; n < count; n++) {
+		_RelayWorker* worker = new _RelayWorker;
+		worker->index = n;
+		worker->base = le_newbase();
+
+		if (!worker->base) {
+			msglog(eMSGTYPE::ERROR, "event_base_new failed for worker %d, %s (%d).", n, __func__, __LINE__);
+			delete worker;
+			return false;
+		}
+
+		char name[32];
+		sprintf(name, "worker %d", n);
+		worker->probe.watch = loopwatchnew(name, SHED_PROBE_MSEC);
+
+		worker->thread = std::thread([worker]() {
+			loopwatchattach(worker->probe.watch);
+			event_base_loop(worker->base, EVLOOP_NO_EXIT_ON_EMPTY);
+		});
+
+		// pin each loop to its own core
+		if (cpus > 1) {
+#ifdef _WIN32
+			SetThreadAffinityMask(worker->thread.native_handle(), (DWORD_PTR)1 << (n % cpus));
+#else
+			cpu_set_t cpuset;
+			CPU_ZERO(&cpuset);
+			CPU_SET(n % cpus, &cpuset);
+			pthread_setaffinity_np(worker->thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+#endif
+		}
+
+		vWorkers.push_back(worker);
+	}
+
+	if (count > 0) {
+		msglog(eMSGTYPE::INFO, "Started %d relay workers, dispatch is %s.", count,
+			(workerdispatch == _DISPATCH_TYPE::_LEAST_CONNECTIONS) ? "least connections" : "round robin");
+	}
+	return true;
+}
+
+static void le_stopworkers()
+{
+	std::vector<_RelayWorker*>::iterator iter = vWorkers.begin();
+	while (iter != vWorkers.end()) {
+		_RelayWorker* worker = *iter;
+		event_base_loopbreak(worker->base);
+		if (worker->thread.joinable())
+			worker->thread.join();
+		iter++;
+	}
+
+	// sharded listeners and pools belong to the worker loops, free them before the bases
+	std::vector<_TunnelsInfo*>::iterator titer = vTunnels.begin();
+	while (titer != vTunnels.end()) {
+		_TunnelsInfo* tunnelinfo = *titer;
+		for (size_t n = 0; n < tunnelinfo->vShardListeners.size(); n++)
+			evconnlistener_free(tunnelinfo->vShardListeners[n]);
+		tunnelinfo->vShardListeners.clear();
+		le_freepools(tunnelinfo);
+		titer++;
+	}
+
+	iter = vWorkers.begin();
+	while (iter != vWorkers.end()) {
+		_RelayWorker* worker = *iter;
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+		le_uringfree(worker->uring);
+#endif
+		event_base_free(worker->base);
+		for (size_t n = 0; n < worker->vFreePairs.size(); n++)
+			delete worker->vFreePairs[n];
+		delete worker;
+		iter++;
+	}
+	vWorkers.clear();
+
+	for (size_t n = 0; n < vMainFreePairs.size(); n++)
+		delete vMainFreePairs[n];
+	vMainFreePairs.clear();
+}
+
+_RelayWorker* le_getworker()
+{
+	if (workerdispatch == _DISPATCH_TYPE::_LEAST_CONNECTIONS) {
+		_RelayWorker* worker = vWorkers[0];
+		for (size_t n = 1; n < vWorkers.size(); n++) {
+			if (vWorkers[n]->connections < worker->connections)
+				worker = vWorkers[n];
+		}
+		return worker;
+	}
+	return vWorkers[(workernext++) % vWorkers.size()];
+}
+
+_RelayWorker* le_getworker(struct event_base* evbase)
+{
+	for (size_t n = 0; n < vWorkers.size(); n++) {
+		if (vWorkers[n]->base == evbase)
+			return vWorkers[n];
+	}
+	return NULL;
+}
+
+std::vector<_RelayPair*>& le_pairlist(struct event_base* evbase)
+{
+	_RelayWorker* worker = le_getworker(evbase);
+	return (worker != NULL) ? worker->vPairs : vMainPairs;
+}
+
+static void
+le_readcb(struct bufferevent* bev, void* user_data)
+{
+	_RelayPair* pair = (_RelayPair*)user_data;
+	_LoopBusy busy("relay read of proxy port", pair->tunnelinfo->proxyport);
+	bufferevent* _bev = (bev == pair->proxy_bev) ? pair->local_bev : pair->proxy_bev;
+	struct evbuffer* output = bufferevent_get_output(_bev);
+	size_t len = evbuffer_get_length(bufferevent_get_input(bev));
+
+	if (bufferevent_read_buffer(bev, output) == -1) {
+		msglog(eMSGTYPE::ERROR, "bufferevent_read_buffer failed, %s (%d).", __func__, __LINE__);
+	}
+
+	if (pair->tunnelinfo->readsizemax > 0)
+		len += le_readsize(pair, bev, output, len);
+
+	if (bev == pair->proxy_bev) {
+		pair->tunnelinfo->stats.bytesin += len;
+		if (pair->trace != NULL && pair->bytes[0] == 0 && len > 0)
+			le_traceadd(pair->trace, _TRACE_EVENT::_FIRST_IN);
+		pair->bytes[0] += len;
+	}
+	else {
+		pair->tunnelinfo->stats.bytesout += len;
+		if (pair->trace != NULL && pair->bytes[1] == 0 && len > 0)
+			le_traceadd(pair->trace, _TRACE_EVENT::_FIRST_OUT);
+		pair->bytes[1] += len;
+	}
+
+	if (pair->tunnelinfo->readtimeout > 0)
+		pair->activetick = GetTickCount64();
+
+	// the sketch is updated per batch, a heavy client takes the list lock once per TALKER_BATCH bytes
+	if (!pair->talkerkey.empty()) {
+		pair->talkerbytes += len;
+		if (pair->talkerbytes >= TALKER_BATCH) {
+			le_talkeradd(pair->tunnelinfo, pair->talkerkey, pair->talkerbytes, 0, pair);
+			pair->talkerbytes = 0;
+		}
+	}
+
+	unsigned long long outputlen = evbuffer_get_length(output);
+	unsigned long long peak = pair->tunnelinfo->stats.peakoutput;
+	while (outputlen > peak && !pair->tunnelinfo->stats.peakoutput.compare_exchange_weak(peak, outputlen));
+
+	// peer can't keep up, stop reading until its output drains below the low watermark
+	if (pair->tunnelinfo->highwatermark > 0 && outputlen >= pair->tunnelinfo->highwatermark) {
+		bufferevent_disable(bev, EV_READ);
+		if (pair->trace != NULL)
+			le_traceadd(pair->trace, _TRACE_EVENT::_STALL);
+		return;
+	}
+
+	// over the global budget, the pairs holding more than their share wait for their output to drain
+	if (bufferbudget > 0 && bufferedbytes > bufferbudget) {
+		long long pairs = relaypairs;
+		if ((long long)outputlen > bufferbudget / ((pairs > 0) ? pairs : 1)) {
+			bufferevent_disable(bev, EV_READ);
+			budgetthrottled++;
+			if (pair->trace != NULL)
+				le_traceadd(pair->trace, _TRACE_EVENT::_BUDGET);
+		}
+	}
+}
+
+// a bulk side takes fewer and larger reads, an interactive one keeps small ones. the peer writes as much at
+// once and the socket buffers grow along, never shrunk below what the kernel tuned them to on its own.
+// libevent 2.1 reads READ_CHUNK bytes at most whatever the max single read, a side that filled it reads
+// the rest of its size here, straight into the peer's output, returns the bytes of that second read
+static size_t le_readsize(_RelayPair* pair, struct bufferevent* bev, struct evbuffer* output, size_t len)
+{
+	_TunnelsInfo* tunnelinfo = pair->tunnelinfo;
+	_ReadSizer& sizer = pair->sizer[(bev == pair->proxy_bev) ? 0 : 1];
+	size_t more = 0;
+
+#ifndef _WIN32
+	// rate limited bufferevents count their reads themselves, and an EOF or error read here is met again
+	// by the next read of the bufferevent
+	if (sizer.size > 0 && len >= READ_CHUNK && len < (size_t)sizer.size
+		&& tunnelinfo->rategroup == NULL && tunnelinfo->clientratecfg == NULL) {
+		struct evbuffer_iovec vec;
+		size_t want = sizer.size - len;
+
+		if (evbuffer_reserve_space(output, (ev_ssize_t)want, &vec, 1) == 1) {
+			ssize_t got = recv(bufferevent_getfd(bev), vec.iov_base, std::min(want, vec.iov_len), 0);
+			vec.iov_len = (got > 0) ? (size_t)got : 0;
+			evbuffer_commit_space(output, &vec, 1);
+			more = vec.iov_len;
+		}
+	}
+#endif
+	len += more;
+
+	int size = sizer.size;
+
+	if (len > sizer.peak)
+		sizer.peak = len;
+
+	if (size == 0)
+		size = tunnelinfo->readsizemin;
+	else if (len >= (size_t)size && size < tunnelinfo->readsizemax)
+		size = std::min(size * 2, tunnelinfo->readsizemax);
+	else {
+		unsigned long long now = GetTickCount64();
+		if (now - sizer.tick < READ_SIZE_MSEC)
+			return more;
+		if (sizer.peak <= (size_t)size / 4)
+			size = std::max(size / 2, tunnelinfo->readsizemin);
+		sizer.peak = 0;
+		sizer.tick = now;
+	}
+
+	if (size == sizer.size)
+		return more;
+
+	bool grown = size > sizer.size;
+	sizer.size = size;
+	sizer.peak = 0;
+	sizer.tick = GetTickCount64();
+
+	bufferevent* _bev = (bev == pair->proxy_bev) ? pair->local_bev : pair->proxy_bev;
+	bufferevent_set_max_single_read(bev, size);
+	bufferevent_set_max_single_write(_bev, size);
+
+	if (grown) {
+		le_growsockbuf(bufferevent_getfd(bev), SO_RCVBUF, size * 2);
+		le_growsockbuf(bufferevent_getfd(_bev), SO_SNDBUF, size * 2);
+	}
+	return more;
+}
+
+// setting a size turns the kernel's own tuning off, so a buffer it already made larger is left alone
+static void le_growsockbuf(evutil_socket_t fd, int opt, int size)
+{
+	int current = 0;
+	ev_socklen_t optlen = sizeof(current);
+
+	if (fd == EVUTIL_INVALID_SOCKET || getsockopt(fd, SOL_SOCKET, opt, (char*)&current, &optlen) != 0 || current >= size)
+		return;
+	setsockopt(fd, SOL_SOCKET, opt, (const char*)&size, sizeof(size));
+}
+
+static void le_outputcb(struct evbuffer* buffer, const struct evbuffer_cb_info* info, void* arg)
+{
+	bufferedbytes += (long long)info->n_added - (long long)info->n_deleted;
+}
+
+static void
+le_writecb(struct bufferevent* bev, void* user_data)
+{
+	_RelayPair* pair = (_RelayPair*)user_data;
+	bufferevent* _bev = (bev == pair->proxy_bev) ? pair->local_bev : pair->proxy_bev;
+	bool peereof = (bev == pair->proxy_bev) ? pair->localeof : pair->proxyeof;
+
+	if (peereof) {
+		if (evbuffer_get_length(bufferevent_get_output(bev)) == 0)
+			le_pairshutdown(pair, bev);
+		return;
+	}
+
+	if (!(bufferevent_get_enabled(_bev) & EV_READ)) {
+		bufferevent_enable(_bev, EV_READ);
+		if (pair->trace != NULL)
+			le_traceadd(pair->trace, _TRACE_EVENT::_RESUME);
+	}
+#ifdef __linux__
+	le_sockmaparm(pair);
+#endif
+}
+
+static void
+le_eventcb(struct bufferevent* bev, short events, void* user_data)
+{
+	_RelayPair* pair = (_RelayPair*)user_data;
+	bufferevent* _bev = (bev == pair->proxy_bev) ? pair->local_bev : pair->proxy_bev;
+
+	if (events & BEV_EVENT_ERROR)
+	{
+		pair->tunnelinfo->stats.errors++;
+		le_pairclose(pair);
+	}
+	else if (events & BEV_EVENT_EOF)
+	{
+		// half close, the peer gets the rest of the data followed by a FIN
+		if (bev == pair->proxy_bev)
+			pair->proxyeof = true;
+		else
+			pair->localeof = true;
+
+		bufferevent_disable(bev, EV_READ);
+
+#ifdef __linux__
+		// the kernel may still hold bytes on their way to _bev, its FIN waits for them
+		if (pair->sockmap != NULL && !le_sockmapdrained(pair, _bev))
+			return;
+#endif
+		if (evbuffer_get_length(bufferevent_get_output(_bev)) == 0)
+			le_pairshutdown(pair, _bev);
+	}
+	else if (events & BEV_EVENT_TIMEOUT)
+	{
+#ifdef __linux__
+		if (pair->sockmap != NULL)
+			le_sockmapactive(pair);
+#endif
+		unsigned long long idle = GetTickCount64() - pair->activetick;
+
+		if ((events & BEV_EVENT_WRITING) || pair->tunnelinfo->readtimeout <= 0
+			|| idle >= (unsigned long long)pair->tunnelinfo->readtimeout * 1000) {
+			msglog(eMSGTYPE::DEBUG, "%s Proxy idle timeout.", pair->tunnelinfo->name);
+			le_pairclose(pair);
+			return;
+		}
+
+		// traffic went the other way, keep waiting
+		bool eof = (bev == pair->proxy_bev) ? pair->proxyeof : pair->localeof;
+		if (!eof)
+			bufferevent_enable(bev, EV_READ);
+	}
+	else if (events & BEV_EVENT_CONNECTED)
+	{
+		if (pair->connectstart != 0) {
+			le_statsconnected(pair->tunnelinfo, pair->connectstart);
+			pair->connectstart = 0;
+		}
+	}
+}
+
+// shuts down the write side of bev, the pair is freed once both directions are done
+void le_pairshutdown(_RelayPair* pair, struct bufferevent* bev)
+{
+	bool* shut = (bev == pair->proxy_bev) ? &pair->proxyshut : &pair->localshut;
+
+	if (*shut == false) {
+		*shut = true;
+#ifdef _WIN32
+		shutdown(bufferevent_getfd(bev), SD_SEND);
+#else
+		shutdown(bufferevent_getfd(bev), SHUT_WR);
+#endif
+	}
+
+	if (pair->proxyshut && pair->localshut)
+		le_pairclose(pair);
+}
+
+void le_pairclose(_RelayPair* pair)
+{
+	_RelayWorker* worker = le_getworker(bufferevent_get_base(pair->proxy_bev));
+	if (worker != NULL)
+		worker->connections--;
+
+	std::vector<_RelayPair*>& vPairs = (worker != NULL) ? worker->vPairs : vMainPairs;
+	vPairs[pair->index] = vPairs.back();
+	vPairs[pair->index]->index = pair->index;
+	vPairs.pop_back();
+
+	if (bufferbudget > 0) {
+		bufferedbytes -= evbuffer_get_length(bufferevent_get_output(pair->proxy_bev));
+		bufferedbytes -= evbuffer_get_length(bufferevent_get_output(pair->local_bev));
+	}
+
+	if (pair->talkerbytes > 0)
+		le_talkeradd(pair->tunnelinfo, pair->talkerkey, pair->talkerbytes, 0, NULL);
+
+	le_ratedetach(pair);
+
+	if (pair->backend)
+		pair->backend->active--;
+
+#ifdef __linux__
+	if (pair->sockmap != NULL)
+		le_sockmapdisarm(pair);
+#endif
+
+	pair->tunnelinfo->stats.activepairs--;
+	relaypairs--;
+	if (pair->trace != NULL)
+		le_traceadd(pair->trace, _TRACE_EVENT::_CLOSE);
+	struct event_base* evbase = bufferevent_get_base(pair->proxy_bev);
+	bufferevent_free(pair->proxy_bev);
+	bufferevent_free(pair->local_bev);
+	le_pairfree(evbase, pair);
+	msglog(eMSGTYPE::DEBUG, "Proxy disconnected.");
+}
+
+// a closed pair of the loop if it kept one, its strings keep their capacity
+_RelayPair* le_pairnew(struct event_base* evbase, _TunnelsInfo* tunnelinfo)
+{
+	_RelayWorker* worker = le_getworker(evbase);
+	std::vector<_RelayPair*>& vFreePairs = (worker != NULL) ? worker->vFreePairs : vMainFreePairs;
+	_RelayPair* pair;
+
+	if (vFreePairs.empty())
+		pair = new _RelayPair;
+	else {
+		pair = vFreePairs.back();
+		vFreePairs.pop_back();
+	}
+
+	pair->tunnelinfo = tunnelinfo;
+	pair->proxy_bev = NULL;
+	pair->local_bev = NULL;
+	pair->connectstart = 0;
+	pair->activetick = GetTickCount64();
+	pair->proxyeof = false;
+	pair->localeof = false;
+	pair->proxyshut = false;
+	pair->localshut = false;
+	pair->clientkey.clear();
+	pair->clienthash = 0;
+	pair->backend = NULL;
+	pair->sockmap = NULL;
+	pair->talkerkey.clear();
+	pair->talkerbytes = 0;
+	memset(pair->sizer, 0, sizeof(pair->sizer));
+	pair->bytes[0] = 0;
+	pair->bytes[1] = 0;
+	pair->index = 0;
+	pair->trace = NULL;
+	return pair;
+}
+
+// only the loop of evbase takes it again, a burst of closes beyond PAIR_POOL_MAX is given back
+static void le_pairfree(struct event_base* evbase, _RelayPair* pair)
+{
+	_RelayWorker* worker = le_getworker(evbase);
+	std::vector<_RelayPair*>& vFreePairs = (worker != NULL) ? worker->vFreePairs : vMainFreePairs;
+
+	if (pair->trace != NULL)
+		le_tracedone(pair);
+
+	if (vFreePairs.size() >= PAIR_POOL_MAX) {
+		delete pair;
+		return;
+	}
+	vFreePairs.push_back(pair);
+}
+
+// group limits split each tick's tokens over the active members, so a busy client can't take the whole cap first
+static void le_ratestart(_TunnelsInfo* tunnelinfo)
+{
+	struct timeval tick = { 0, RATE_TICK_MSEC * 1000 };
+
+	if (tunnelinfo->ratelimit > 0) {
+		size_t rate = (size_t)(tunnelinfo->ratelimit * RATE_TICK_MSEC / 1000);
+		tunnelinfo->ratecfg = ev_token_bucket_cfg_new(rate, (size_t)tunnelinfo->ratelimit, rate, (size_t)tunnelinfo->ratelimit, &tick);
+		tunnelinfo->rategroup = bufferevent_rate_limit_group_new(base, tunnelinfo->ratecfg);
+		if (tunnelinfo->rategroup && tunnelinfo->rateshare > 0)
+			bufferevent_rate_limit_group_set_min_share(tunnelinfo->rategroup, tunnelinfo->rateshare);
+		msglog(eMSGTYPE::INFO, "%s Rate limit is %lld bytes per second.", tunnelinfo->name, tunnelinfo->ratelimit);
+	}
+
+	if (tunnelinfo->clientratelimit > 0) {
+		size_t rate = (size_t)(tunnelinfo->clientratelimit * RATE_TICK_MSEC / 1000);
+		tunnelinfo->clientratecfg = ev_token_bucket_cfg_new(rate, (size_t)tunnelinfo->clientratelimit, rate, (size_t)tunnelinfo->clientratelimit, &tick);
+		msglog(eMSGTYPE::INFO, "%s Client rate limit is %lld bytes per second.", tunnelinfo->name, tunnelinfo->clientratelimit);
+	}
+
+	if (tunnelinfo->talkerlimit > 0) {
+		size_t rate = (size_t)(tunnelinfo->talkerlimit * RATE_TICK_MSEC / 1000);
+		tunnelinfo->talkercfg = ev_token_bucket_cfg_new(rate, (size_t)tunnelinfo->talkerlimit, rate, (size_t)tunnelinfo->talkerlimit, &tick);
+		msglog(eMSGTYPE::INFO, "%s Top talkers are throttled to %lld bytes per second.", tunnelinfo->name, tunnelinfo->talkerlimit);
+	}
+
+	if (tunnelinfo->acceptrate > 0) {
+		tunnelinfo->acceptlimiter = new _AcceptLimiter;
+		msglog(eMSGTYPE::INFO, "%s Accept rate is %d connections per second of a client, %d at once.", tunnelinfo->name,
+			tunnelinfo->acceptrate, tunnelinfo->acceptburst);
+	}
+}
+
+static void le_ratestop(_TunnelsInfo* tunnelinfo)
+{
+	// pairs still open at exit keep their group
+	if (tunnelinfo->stats.activepairs == 0) {
+		if (tunnelinfo->rategroup)
+			bufferevent_rate_limit_group_free(tunnelinfo->rategroup);
+		tunnelinfo->rategroup = NULL;
+	}
+
+	if (tunnelinfo->ratecfg)
+		ev_token_bucket_cfg_free(tunnelinfo->ratecfg);
+	tunnelinfo->ratecfg = NULL;
+
+	if (tunnelinfo->clientratecfg)
+		ev_token_bucket_cfg_free(tunnelinfo->clientratecfg);
+	tunnelinfo->clientratecfg = NULL;
+
+	if (tunnelinfo->talkercfg)
+		ev_token_bucket_cfg_free(tunnelinfo->talkercfg);
+	tunnelinfo->talkercfg = NULL;
+
+	delete tunnelinfo->acceptlimiter;
+	tunnelinfo->acceptlimiter = NULL;
+}
+
+// the groups refill from the main loop, members on relay loops are created with their lock for that
+bool le_ratelocked(_TunnelsInfo* tunnelinfo)
+{
+	return (vWorkers.size() > 0 && (tunnelinfo->ratelimit > 0 || tunnelinfo->clientratelimit > 0 || tunnelinfo->talkerlimit > 0));
+}
+
+static void le_rateattach(_RelayPair* pair)
+{
+	_TunnelsInfo* tunnelinfo = pair->tunnelinfo;
+
+	if (tunnelinfo->rategroup == NULL && tunnelinfo->clientratecfg == NULL)
+		return;
+
+	if (tunnelinfo->rategroup)
+		bufferevent_add_to_rate_limit_group(pair->proxy_bev, tunnelinfo->rategroup);
+
+	if (tunnelinfo->clientratecfg == NULL)
+		return;
+
+	struct sockaddr_storage ss;
+	ev_socklen_t socklen = sizeof(ss);
+
+	if (getpeername(bufferevent_getfd(pair->proxy_bev), (struct sockaddr*)&ss, &socklen) != 0)
+		return;
+
+	if (ss.ss_family == AF_INET6)
+		pair->clientkey.assign((const char*)&((struct sockaddr_in6*)&ss)->sin6_addr, sizeof(struct in6_addr));
+	else
+		pair->clientkey.assign((const char*)&((struct sockaddr_in*)&ss)->sin_addr, sizeof(struct in_addr));
+
+	std::lock_guard<std::mutex> lock(tunnelinfo->ratelock);
+	_RateGroup& rategroup = tunnelinfo->mClientGroups[pair->clientkey];
+
+	if (rategroup.group == NULL) {
+		rategroup.group = bufferevent_rate_limit_group_new(base, tunnelinfo->clientratecfg);
+		if (rategroup.group && tunnelinfo->rateshare > 0)
+			bufferevent_rate_limit_group_set_min_share(rategroup.group, tunnelinfo->rateshare);
+	}
+
+	rategroup.members++;
+	if (rategroup.group)
+		bufferevent_add_to_rate_limit_group(pair->local_bev, rategroup.group);
+}
+
+static void le_ratedetach(_RelayPair* pair)
+{
+	_TunnelsInfo* tunnelinfo = pair->tunnelinfo;
+
+	if (pair->clientkey.empty())
+		return;
+
+	bufferevent_remove_from_rate_limit_group(pair->local_bev);
+
+	std::lock_guard<std::mutex> lock(tunnelinfo->ratelock);
+	std::map<std::string, _RateGroup>::iterator iter = tunnelinfo->mClientGroups.find(pair->clientkey);
+
+	if (iter != tunnelinfo->mClientGroups.end() && --iter->second.members == 0) {
+		if (iter->second.group)
+			bufferevent_rate_limit_group_free(iter->second.group);
+		tunnelinfo->mClientGroups.erase(iter);
+	}
+}
+
+static void le_talkerstart(_TunnelsInfo* tunnelinfo)
+{
+	struct timeval tv = { TALKER_DECAY_MSEC / 1000, (TALKER_DECAY_MSEC % 1000) * 1000 };
+
+	if (tunnelinfo->toptalkers <= 0)
+		return;
+
+	tunnelinfo->talkers = new _TalkerSketch;
+	tunnelinfo->talkers->timer = event_new(base, -1, EV_PERSIST, le_talkertimer_cb, (void*)tunnelinfo);
+	event_add(tunnelinfo->talkers->timer, &tv);
+}
+
+static void le_talkerstop(_TunnelsInfo* tunnelinfo)
+{
+	if (tunnelinfo->talkers == NULL)
+		return;
+
+	if (tunnelinfo->talkers->timer)
+		event_free(tunnelinfo->talkers->timer);
+	delete tunnelinfo->talkers;
+	tunnelinfo->talkers = NULL;
+}
+
+// min heap, the lightest of the list is at the front
+static bool le_talkerheavier(const _Talker& a, const _Talker& b)
+{
+	return a.rank > b.rank;
+}
+
+// old traffic fades so the list follows who is heavy now, a halving racing an add loses at most part of it
+static void le_talkertimer_cb(evutil_socket_t, short, void* arg)
+{
+	_TalkerSketch* sketch = ((_TunnelsInfo*)arg)->talkers;
+
+	for (int n = 0; n < TALKER_DEPTH; n++) {
+		for (int i = 0; i < TALKER_WIDTH; i++) {
+			sketch->bytes[n][i] -= sketch->bytes[n][i] / 2;
+			sketch->accepts[n][i] -= sketch->accepts[n][i] / 2;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(sketch->lock);
+	for (size_t n = 0; n < sketch->vTop.size(); n++)
+		sketch->vTop[n].rank /= 2;
+	sketch->vTop.erase(std::remove_if(sketch->vTop.begin(), sketch->vTop.end(),
+		[](const _Talker& talker) { return talker.rank == 0; }), sketch->vTop.end());
+	std::make_heap(sketch->vTop.begin(), sketch->vTop.end(), le_talkerheavier);
+	sketch->floor = (sketch->vTop.size() > 0) ? sketch->vTop.front().rank : 0;
+}
+
+bool le_talkerkey(evutil_socket_t fd, std::string& key)
+{
+	struct sockaddr_storage ss;
+	ev_socklen_t socklen = sizeof(ss);
+
+	if (getpeername(fd, (struct sockaddr*)&ss, &socklen) != 0)
+		return false;
+
+	if (ss.ss_family == AF_INET6)
+		key.assign((const char*)&((struct sockaddr_in6*)&ss)->sin6_addr, sizeof(struct in6_addr));
+	else
+		key.assign((const char*)&((struct sockaddr_in*)&ss)->sin_addr, sizeof(struct in_addr));
+	return true;
+}
+
+static std::string le_talkername(const std::string& key)
+{
+	char name[INET6_ADDRSTRLEN];
+
+	if (evutil_inet_ntop((key.size() == sizeof(struct in6_addr)) ? AF_INET6 : AF_INET, key.data(), name, sizeof(name)) == NULL)
+		return std::string();
+	return name;
+}
+
+static void le_talkerslots(const std::string& key, size_t* slots)
+{
+	for (int n = 0; n < TALKER_DEPTH; n++)
+		slots[n] = le_hash(key.data(), key.size(), 2166136261u + n * 0x9e3779b9u) % TALKER_WIDTH;
+}
+
+static unsigned long long le_talkerrank(_TalkerSketch* sketch, const size_t* slots)
+{
+	unsigned long long bytes = sketch->bytes[0][slots[0]];
+	unsigned long long accepts = sketch->accepts[0][slots[0]];
+
+	for (int n = 1; n < TALKER_DEPTH; n++) {
+		bytes = std::min(bytes, (unsigned long long)sketch->bytes[n][slots[n]]);
+		accepts = std::min(accepts, (unsigned long long)sketch->accepts[n][slots[n]]);
+	}
+	return bytes + accepts * TALKER_ACCEPT_BYTES;
+}
+
+// counted from every relay loop, only a client ranking above the lightest of a full list takes the lock
+static void le_talkeradd(_TunnelsInfo* tunnelinfo, const std::string& key, unsigned long long bytes, unsigned long long accepts, _RelayPair* pair)
+{
+	_TalkerSketch* sketch = tunnelinfo->talkers;
+	size_t slots[TALKER_DEPTH];
+	unsigned long long estbytes = ULLONG_MAX;
+	unsigned long long estaccepts = ULLONG_MAX;
+
+	le_talkerslots(key, slots);
+	for (int n = 0; n < TALKER_DEPTH; n++) {
+		estbytes = std::min(estbytes, (bytes > 0) ? (sketch->bytes[n][slots[n]] += bytes) : sketch->bytes[n][slots[n]].load());
+		estaccepts = std::min(estaccepts, (accepts > 0) ? (sketch->accepts[n][slots[n]] += accepts) : sketch->accepts[n][slots[n]].load());
+	}
+
+	// a steady rate settles at twice what it relays in one decay period
+	if (pair != NULL && tunnelinfo->talkercfg != NULL && pair->clientkey.empty()
+		&& estbytes * 1000 / (2 * TALKER_DECAY_MSEC) > (unsigned long long)tunnelinfo->talkerlimit)
+		le_talkerthrottle(pair);
+
+	unsigned long long rank = estbytes + estaccepts * TALKER_ACCEPT_BYTES;
+	if (rank <= sketch->floor)
+		return;
+
+	std::lock_guard<std::mutex> lock(sketch->lock);
+	std::vector<_Talker>& vTop = sketch->vTop;
+	size_t n = 0;
+
+	while (n < vTop.size() && vTop[n].key != key)
+		n++;
+
+	if (n < vTop.size())
+		vTop[n].rank = rank;
+	else if ((int)vTop.size() < tunnelinfo->toptalkers)
+		vTop.push_back({ key, rank });
+	else {
+		// the ranks kept in the list are from when each entry was last added, the sketch has newer ones
+		for (size_t i = 0; i < vTop.size(); i++) {
+			size_t topslots[TALKER_DEPTH];
+			le_talkerslots(vTop[i].key, topslots);
+			vTop[i].rank = le_talkerrank(sketch, topslots);
+		}
+		std::make_heap(vTop.begin(), vTop.end(), le_talkerheavier);
+		if (rank > vTop.front().rank) {
+			std::pop_heap(vTop.begin(), vTop.end(), le_talkerheavier);
+			vTop.back().key = key;
+			vTop.back().rank = rank;
+		}
+	}
+
+	std::make_heap(vTop.begin(), vTop.end(), le_talkerheavier);
+	sketch->floor = ((int)vTop.size() < tunnelinfo->toptalkers) ? 0 : vTop.front().rank;
+}
+
+// the local server side of each pair of the client joins one bucket, like a Client Rate Limit for the heavy ones only
+static void le_talkerthrottle(_RelayPair* pair)
+{
+	_TunnelsInfo* tunnelinfo = pair->tunnelinfo;
+
+	pair->clientkey = pair->talkerkey;
+
+	std::lock_guard<std::mutex> lock(tunnelinfo->ratelock);
+	_RateGroup& rategroup = tunnelinfo->mClientGroups[pair->clientkey];
+
+	if (rategroup.group == NULL) {
+		rategroup.group = bufferevent_rate_limit_group_new(base, tunnelinfo->talkercfg);
+		if (rategroup.group && tunnelinfo->rateshare > 0)
+			bufferevent_rate_limit_group_set_min_share(rategroup.group, tunnelinfo->rateshare);
+		msglog(eMSGTYPE::DEBUG, "%s Client %s is a top talker, throttled to %lld bytes per second.", tunnelinfo->name,
+			le_talkername(pair->clientkey).c_str(), tunnelinfo->talkerlimit);
+	}
+
+	rategroup.members++;
+	if (rategroup.group)
+		bufferevent_add_to_rate_limit_group(pair->local_bev, rategroup.group);
+	tunnelinfo->stats.talkerthrottled++;
+}
+
+// the cheapest no, before a bufferevent or a peek is made. sa is NULL for a client routed by a shared
+// listener, which already checked Accept Rate
+static bool le_acceptallow(_TunnelsInfo* tunnelinfo, evutil_socket_t fd, const struct sockaddr* sa)
+{
+	if (tunnelinfo->maxconnections > 0 && tunnelinfo->stats.activepairs >= tunnelinfo->maxconnections) {
+		tunnelinfo->stats.rejectedfull++;
+		evutil_closesocket(fd);
+		return false;
+	}
+
+	if (sa != NULL && tunnelinfo->acceptlimiter != NULL && !le_acceptrate(tunnelinfo, le_clienthash(sa))) {
+		tunnelinfo->stats.rejectedrate++;
+		evutil_closesocket(fd);
+		return false;
+	}
+
+	if (!le_breakerallow(tunnelinfo)) {
+		tunnelinfo->stats.rejectedbreaker++;
+		evutil_closesocket(fd);
+		return false;
+	}
+	return true;
+}
+
+// Circuit Breaker connects to the local server failing in a row open the breaker, the clients of the next
+// Breaker Cooldown seconds are closed at once instead of each holding a socket through a connect that times
+// out. the first client after it is let through as the probe and moves the end of the cooldown on, so the
+// rest keep failing at once until its connect closes the breaker or opens it again. a probe that never
+// reports, a pooled upstream or a closed client, only costs another cooldown
+static bool le_breakerallow(_TunnelsInfo* tunnelinfo)
+{
+	if (tunnelinfo->breaker <= 0 || tunnelinfo->connectfailures < tunnelinfo->breaker)
+		return true;
+
+	unsigned long long now = le_nowusec();
+	unsigned long long until = tunnelinfo->breakeruntil;
+	if (now < until)
+		return false;
+
+	return tunnelinfo->breakeruntil.compare_exchange_strong(until, now + (unsigned long long)tunnelinfo->breakercooldown * 1000000);
+}
+
+// every relay loop reports its connects, a success only writes the shared count when it is not 0 already
+void le_breakerresult(_TunnelsInfo* tunnelinfo, bool connected)
+{
+	if (tunnelinfo->breaker <= 0)
+		return;
+
+	if (connected) {
+		if (tunnelinfo->connectfailures != 0 && tunnelinfo->connectfailures.exchange(0) >= tunnelinfo->breaker)
+			msglog(eMSGTYPE::INFO, "%s Local server %s connects again, circuit breaker closed.", tunnelinfo->name, tunnelinfo->local_serverip);
+		return;
+	}
+
+	int failures = ++tunnelinfo->connectfailures;
+	if (failures < tunnelinfo->breaker)
+		return;
+
+	tunnelinfo->breakeruntil = le_nowusec() + (unsigned long long)tunnelinfo->breakercooldown * 1000000;
+	if (failures == tunnelinfo->breaker)
+		msglog(eMSGTYPE::ERROR, "%s %d connects to local server %s failed in a row, circuit breaker open, new clients are closed for %d seconds.",
+			tunnelinfo->name, failures, tunnelinfo->local_serverip, tunnelinfo->breakercooldown);
+}
+
+// a token bucket per client address hash, a few probes from its slot. an address not found takes a free
+// bucket or the fullest one of the probes, which says the least about its owner
+static bool le_acceptrate(_TunnelsInfo* tunnelinfo, unsigned int key)
+{
+	_AcceptLimiter* limiter = tunnelinfo->acceptlimiter;
+	long long cost = 1000000LL / tunnelinfo->acceptrate;
+	long long capacity = cost * tunnelinfo->acceptburst;
+	unsigned long long now = le_nowusec();
+	size_t slot = (size_t)(key * 0x9e3779b1u) & (ACCEPT_TABLE_SIZE - 1);
+	_AcceptBucket* bucket = NULL;
+	_AcceptBucket* victim = NULL;
+
+	std::lock_guard<std::mutex> lock(limiter->lock);
+
+	for (int n = 0; n < ACCEPT_PROBES; n++) {
+		_AcceptBucket* b = &limiter->buckets[(slot + n) & (ACCEPT_TABLE_SIZE - 1)];
+		if (b->used && b->key == key) {
+			bucket = b;
+			break;
+		}
+		if (victim == NULL || !b->used || (victim->used && b->credit + (long long)(now - b->tick) > victim->credit + (long long)(now - victim->tick)))
+			victim = b;
+	}
+
+	if (bucket == NULL) {
+		bucket = victim;
+		bucket->key = key;
+		bucket->used = true;
+		bucket->tick = now;
+		bucket->credit = capacity;
+	}
+
+	unsigned long long elapsed = now - bucket->tick;
+	bucket->tick = now;
+	bucket->credit = (elapsed >= (unsigned long long)capacity) ? capacity : std::min(capacity, bucket->credit + (long long)elapsed);
+
+	if (bucket->credit < cost)
+		return false;
+	bucket->credit -= cost;
+	return true;
+}
+
+// the probes always run for the lag histograms, they only shed with Shed Loop Lag
+static void le_shedstart()
+{
+	struct timeval tv = { 0, SHED_PROBE_MSEC * 1000 };
+
+	mainprobe.watch = loopwatchnew("main", SHED_PROBE_MSEC);
+	loopwatchattach(mainprobe.watch);
+	mainprobe.tick = le_nowusec();
+	mainprobe.timer = event_new(base, -1, EV_PERSIST, le_lagprobe_cb, (void*)&mainprobe);
+	event_add(mainprobe.timer, &tv);
+
+	for (size_t n = 0; n < vWorkers.size(); n++) {
+		vWorkers[n]->probe.tick = le_nowusec();
+		vWorkers[n]->probe.timer = event_new(vWorkers[n]->base, -1, EV_PERSIST, le_lagprobe_cb, (void*)&vWorkers[n]->probe);
+		event_add(vWorkers[n]->probe.timer, &tv);
+	}
+
+	if (loopwatchstart(stallmsec, le_stallreport))
+		msglog(eMSGTYPE::INFO, "A loop stuck in one callback for more than %d ms is reported.", stallmsec);
+	if (shedlagmsec > 0)
+		msglog(eMSGTYPE::INFO, "Proxy listeners stop accepting while a loop lags more than %d ms.", shedlagmsec);
+}
+
+static void le_stallreport(const char* text)
+{
+	msglog(eMSGTYPE::ERROR, "%s", text);
+}
+
+static void le_shedstop()
+{
+	if (mainprobe.timer)
+		event_free(mainprobe.timer);
+	mainprobe.timer = NULL;
+
+	for (size_t n = 0; n < vWorkers.size(); n++) {
+		if (vWorkers[n]->probe.timer)
+			event_free(vWorkers[n]->probe.timer);
+		vWorkers[n]->probe.timer = NULL;
+	}
+}
+
+// how much later than SHED_PROBE_MSEC the timer of its loop fired
+static void le_lagprobe_cb(evutil_socket_t, short, void* arg)
+{
+	_LagProbe* probe = (_LagProbe*)arg;
+	unsigned long long now = le_nowusec();
+	unsigned long long due = probe->tick + SHED_PROBE_MSEC * 1000;
+
+	probe->lag = (now > due) ? now - due : 0;
+	probe->tick = now;
+	loopwatchtick(probe->watch, probe->lag);
+
+	if (probe == &mainprobe) {
+		memtagsample();
+		if (shedlagmsec > 0)
+			le_shedcheck(now);
+	}
+}
+
+// a worker stuck in one callback fires no probe, how long it has been overdue counts as its lag
+static void le_shedcheck(unsigned long long now)
+{
+	unsigned long long threshold = (unsigned long long)shedlagmsec * 1000;
+	unsigned long long worst = mainprobe.lag;
+
+	for (size_t n = 0; n < vWorkers.size(); n++) {
+		unsigned long long due = vWorkers[n]->probe.tick + SHED_PROBE_MSEC * 1000;
+		worst = std::max(worst, (unsigned long long)vWorkers[n]->probe.lag);
+		if (now > due)
+			worst = std::max(worst, now - due);
+	}
+
+	if (worst > threshold) {
+		shedcalm = 0;
+		if (!shedding) {
+			shedding = true;
+			shedtotal++;
+			msglog(eMSGTYPE::INFO, "Loop lag of %llu ms, proxy listeners stop accepting.", worst / 1000);
+		}
+		// listeners a reload started meanwhile are turned off too
+		le_shedlisteners(false);
+		return;
+	}
+
+	if (!shedding)
+		return;
+
+	if (worst >= threshold / 2) {
+		shedcalm = 0;
+		return;
+	}
+
+	if (++shedcalm < SHED_RECOVER_PROBES)
+		return;
+
+	shedding = false;
+	le_shedlisteners(true);
+	msglog(eMSGTYPE::INFO, "Loop lag is back to %llu ms, proxy listeners accept again.", worst / 1000);
+}
+
+// clients wait in the accept queues meanwhile, the ones over the backlog are refused by the kernel
+static void le_shedlisteners(bool enable)
+{
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		std::vector<struct evconnlistener*> vListeners = vTunnels[n]->vShardListeners;
+		if (vTunnels[n]->proxy_listener)
+			vListeners.push_back(vTunnels[n]->proxy_listener);
+
+		for (size_t i = 0; i < vListeners.size(); i++) {
+			if (enable)
+				evconnlistener_enable(vListeners[i]);
+			else
+				evconnlistener_disable(vListeners[i]);
+		}
+	}
+
+	for (size_t n = 0; n < vVhosts.size(); n++) {
+		if (enable)
+			evconnlistener_enable(vVhosts[n]->listener);
+		else
+			evconnlistener_disable(vVhosts[n]->listener);
+	}
+}
+
+unsigned long long le_nowusec()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void le_statsconnected(_TunnelsInfo* tunnelinfo, unsigned long long startusec)
+{
+	unsigned long long usec = le_nowusec() - startusec;
+
+	tunnelinfo->stats.connects++;
+	tunnelinfo->stats.connectusec += usec;
+
+	for (int n = 0; n < STATS_LATENCY_BUCKETS; n++) {
+		if (usec <= statslatencybounds[n]) {
+			tunnelinfo->stats.latencybuckets[n]++;
+			break;
+		}
+	}
+}
+
+// one in tracesample accepted pairs, counted across the loops
+static void le_tracestart(_RelayPair* pair, evutil_socket_t fd)
+{
+	if (traceaccepts.fetch_add(1, std::memory_order_relaxed) % tracesample != 0)
+		return;
+
+	_PairTrace* trace = new _PairTrace;
+	struct sockaddr_storage ss;
+	ev_socklen_t socklen = sizeof(ss);
+	char ip[INET6_ADDRSTRLEN] = "";
+	int port = 0;
+
+	if (getpeername(fd, (struct sockaddr*)&ss, &socklen) == 0) {
+		if (ss.ss_family == AF_INET) {
+			evutil_inet_ntop(AF_INET, &((struct sockaddr_in*)&ss)->sin_addr, ip, sizeof(ip));
+			port = ntohs(((struct sockaddr_in*)&ss)->sin_port);
+		}
+		else if (ss.ss_family == AF_INET6) {
+			evutil_inet_ntop(AF_INET6, &((struct sockaddr_in6*)&ss)->sin6_addr, ip, sizeof(ip));
+			port = ntohs(((struct sockaddr_in6*)&ss)->sin6_port);
+		}
+	}
+
+	memcpy(trace->tunnel, pair->tunnelinfo->name, sizeof(trace->tunnel));
+	snprintf(trace->client, sizeof(trace->client), (strchr(ip, ':') != NULL) ? "[%s]:%d" : "%s:%d", ip, port);
+	trace->start = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	trace->startusec = le_nowusec();
+	trace->count = 0;
+	trace->dropped = 0;
+	pair->trace = trace;
+	le_traceadd(trace, _TRACE_EVENT::_ACCEPT);
+}
+
+static void le_traceadd(_PairTrace* trace, _TRACE_EVENT type)
+{
+	// the last slot is kept for the close
+	if (trace->count >= TRACE_EVENTS - 1 && type != _TRACE_EVENT::_CLOSE && type != _TRACE_EVENT::_FAILED) {
+		trace->dropped++;
+		return;
+	}
+	if (trace->count >= TRACE_EVENTS)
+		return;
+
+	_TraceEvent& event = trace->events[trace->count++];
+	event.type = type;
+	event.usec = (unsigned int)std::min(le_nowusec() - trace->startusec, (unsigned long long)UINT_MAX);
+}
+
+// the finished trace takes the next slot of the ring, a slot /traces did not empty yet loses its old one
+static void le_tracedone(_RelayPair* pair)
+{
+	unsigned long long slot = tracehead.fetch_add(1, std::memory_order_relaxed) % TRACE_RING;
+	_PairTrace* old = traceRing[slot].exchange(pair->trace, std::memory_order_acq_rel);
+
+	delete old;
+	pair->trace = NULL;
+}
+
+static void le_tracefree()
+{
+	for (size_t n = 0; n < TRACE_RING; n++)
+		delete traceRing[n].exchange(NULL);
+}
+
+static void le_jsonstring(struct evbuffer* reply, const char* text)
+{
+	evbuffer_add(reply, "\"", 1);
+	for (; *text != 0; text++) {
+		if (*text == '"' || *text == '\\')
+			evbuffer_add_printf(reply, "\\%c", *text);
+		else if ((unsigned char)*text < 0x20)
+			evbuffer_add_printf(reply, "\\u%04x", (unsigned char)*text);
+		else
+			evbuffer_add(reply, text, 1);
+	}
+	evbuffer_add(reply, "\"", 1);
+}
+
+// GET /traces takes the finished traces of sampled pairs out of the ring, one JSON object per line in the
+// order they were accepted, usec of each event counted from the accept. loopback only, they hold client addresses
+static void le_traces_cb(struct evhttp_request* req, void* arg)
+{
+	static const char* const names[] = { "accept", "addrs", "connect", "connected", "pooled", "first_in", "first_out",
+		"stall", "budget", "resume", "failed", "close" };
+
+	if (!le_loopbackonly(req))
+		return;
+
+	std::vector<_PairTrace*> vTraces;
+	for (size_t n = 0; n < TRACE_RING; n++) {
+		_PairTrace* trace = traceRing[n].exchange(NULL, std::memory_order_acq_rel);
+		if (trace != NULL)
+			vTraces.push_back(trace);
+	}
+	std::sort(vTraces.begin(), vTraces.end(), [](const _PairTrace* a, const _PairTrace* b) { return a->start < b->start; });
+
+	struct evbuffer* reply = evbuffer_new();
+	for (size_t n = 0; n < vTraces.size(); n++) {
+		_PairTrace* trace = vTraces[n];
+		evbuffer_add_printf(reply, "{\"tunnel\":");
+		le_jsonstring(reply, trace->tunnel);
+		evbuffer_add_printf(reply, ",\"client\":\"%s\",\"start\":%lld,\"dropped\":%d,\"events\":[", trace->client, trace->start, trace->dropped);
+		for (int i = 0; i < trace->count; i++)
+			evbuffer_add_printf(reply, "%s{\"event\":\"%s\",\"usec\":%u}", (i > 0) ? "," : "", names[(int)trace->events[i].type], trace->events[i].usec);
+		evbuffer_add_printf(reply, "]}\n");
+		delete trace;
+	}
+
+	evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", "application/x-ndjson");
+	evhttp_send_reply(req, HTTP_OK, "OK", reply);
+	evbuffer_free(reply);
+}
+
+// the token compared in time independent of where it first differs
+static bool le_controlallow(struct evhttp_request* req)
+{
+	const char* auth = evhttp_find_header(evhttp_request_get_input_headers(req), "Authorization");
+	std::string expected = "Bearer " + controltoken;
+	unsigned char diff = 0;
+
+	if (auth == NULL || strlen(auth) != expected.size()) {
+		evhttp_send_error(req, 401, NULL);
+		return false;
+	}
+	for (size_t n = 0; n < expected.size(); n++)
+		diff |= (unsigned char)(auth[n] ^ expected[n]);
+	if (diff != 0) {
+		evhttp_send_error(req, 401, NULL);
+		return false;
+	}
+	return true;
+}
+
+// the control API, with Control Token as a bearer token. GET lists the running tunnels as JSON lines,
+// PUT takes one tunnel in the YAML of a Proxy Servers entry and starts it, updates it in place or
+// restarts it like a reload would, DELETE /tunnels?name=N stops it. the others are not touched, the
+// next reload brings the tunnels back to proxy.yaml
+static void le_tunnels_cb(struct evhttp_request* req, void* arg)
+{
+	_LoopBusy busy("control", 0);
+	struct evbuffer* reply = evbuffer_new();
+
+	if (!le_controlallow(req)) {
+		evbuffer_free(reply);
+		return;
+	}
+
+	switch (evhttp_request_get_command(req)) {
+	case EVHTTP_REQ_GET:
+	case EVHTTP_REQ_HEAD:
+		for (size_t n = 0; n < vTunnels.size(); n++) {
+			_TunnelsInfo* tunnelinfo = vTunnels[n];
+			evbuffer_add_printf(reply, "{\"name\":");
+			le_jsonstring(reply, tunnelinfo->name);
+			evbuffer_add_printf(reply, ",\"proxy_port\":%d,\"active_pairs\":%lld,\"accepted\":%llu}\n", tunnelinfo->proxyport,
+				(long long)tunnelinfo->stats.activepairs, (unsigned long long)tunnelinfo->stats.accepted);
+		}
+		evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", "application/x-ndjson");
+		evhttp_send_reply(req, HTTP_OK, "OK", reply);
+		break;
+	case EVHTTP_REQ_PUT: {
+		struct evbuffer* input = evhttp_request_get_input_buffer(req);
+		std::string body((size_t)evbuffer_get_length(input), 0);
+		evbuffer_copyout(input, &body[0], body.size());
+
+		_TunnelsInfo* loaded = NULL;
+		try {
+			YAML::Node node = YAML::Load(body);
+			if (!node.IsMap() || !node["Name"])
+				throw YAML::Exception(YAML::Mark::null_mark(), "a tunnel with a Name is expected");
+			loaded = le_loadtunnel(node);
+		}
+		catch (const YAML::Exception& e) {
+			evbuffer_add_printf(reply, "%s\n", e.msg.c_str());
+			evhttp_send_reply(req, HTTP_BADREQUEST, "Bad Request", reply);
+			break;
+		}
+
+		_TunnelsInfo* holder = le_tunnelport(loaded);
+		if (holder != NULL) {
+			evbuffer_add_printf(reply, "port %d is taken by %s\n", loaded->proxyport, holder->name);
+			evhttp_send_reply(req, 409, "Conflict", reply);
+			le_backendstop(loaded);
+			delete loaded;
+			break;
+		}
+
+		std::unordered_map<std::string, _TunnelsInfo*>::iterator iter = mTunnelNames.find(loaded->name);
+		_TunnelsInfo* running = (iter != mTunnelNames.end()) ? iter->second : NULL;
+		std::string name = loaded->name;
+
+		if (!le_tunnelswap(running, loaded)) {
+			evbuffer_add_printf(reply, "%s failed to start\n", name.c_str());
+			evhttp_send_reply(req, HTTP_INTERNAL, "Internal Server Error", reply);
+			break;
+		}
+		msglog(eMSGTYPE::INFO, "%s Proxy Server %s by the control API.", name.c_str(), (running != NULL) ? "changed" : "added");
+		evhttp_send_reply(req, (running != NULL) ? HTTP_OK : 201, (running != NULL) ? "OK" : "Created", reply);
+		break;
+	}
+	case EVHTTP_REQ_DELETE: {
+		std::string name;
+		struct evkeyvalq query;
+		const char* querystr = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(req));
+		if (querystr != NULL && evhttp_parse_query_str(querystr, &query) == 0) {
+			const char* value = evhttp_find_header(&query, "name");
+			if (value != NULL)
+				name = value;
+			evhttp_clear_headers(&query);
+		}
+
+		std::unordered_map<std::string, _TunnelsInfo*>::iterator iter = mTunnelNames.find(name);
+		if (iter == mTunnelNames.end()) {
+			evhttp_send_reply(req, HTTP_NOTFOUND, "Not Found", reply);
+			break;
+		}
+		le_tunnelswap(iter->second, NULL);
+		msglog(eMSGTYPE::INFO, "%s Proxy Server removed by the control API.", name.c_str());
+		evhttp_send_reply(req, HTTP_OK, "OK", reply);
+		break;
+	}
+	default:
+		evhttp_send_reply(req, HTTP_BADMETHOD, "Method Not Allowed", reply);
+		break;
+	}
+	evbuffer_free(reply);
+}
+
+static bool le_startmetrics(const char* ip, int port)
+{
+	metricshttp = evhttp_new(base);
+
+	if (metricshttp == NULL || evhttp_bind_socket(metricshttp, ip, port) != 0) {
+		msglog(eMSGTYPE::ERROR, "Metrics failed to bind at %s port %d, %s (%d).", ip, port, __func__, __LINE__);
+		return false;
+	}
+
+	evhttp_set_cb(metricshttp, "/metrics", le_metrics_cb, NULL);
+#ifndef _WIN32
+	evhttp_set_cb(metricshttp, "/profile", le_profile_cb, NULL);
+#endif
+	evhttp_set_cb(metricshttp, "/traces", le_traces_cb, NULL);
+	if (!controltoken.empty()) {
+		evhttp_set_cb(metricshttp, "/tunnels", le_tunnels_cb, NULL);
+		evhttp_set_allowed_methods(metricshttp, EVHTTP_REQ_GET | EVHTTP_REQ_HEAD | EVHTTP_REQ_PUT | EVHTTP_REQ_DELETE);
+		evhttp_set_max_body_size(metricshttp, CONTROL_MAX_BODY);
+	}
+
+	msglog(eMSGTYPE::INFO, "Metrics is listening to %s port %d.", ip, port);
+	return true;
+}
+
+// answers 403 to a request from anywhere but this host
+static bool le_loopbackonly(struct evhttp_request* req)
+{
+	char* peer = NULL;
+	ev_uint16_t peerport = 0;
+	evhttp_connection_get_peer(evhttp_request_get_connection(req), &peer, &peerport);
+	if (peer == NULL || (strcmp(peer, "127.0.0.1") != 0 && strcmp(peer, "::1") != 0)) {
+		evhttp_send_error(req, 403, NULL);
+		return false;
+	}
+	return true;
+}
+
+#ifndef _WIN32
+static void le_profilereport(const char* text)
+{
+	msglog(eMSGTYPE::INFO, "%s", text);
+}
+
+// GET /profile?seconds=N samples the stacks of every thread for N seconds, 30 without it, into
+// tunnel-<pid>-<time>.folded in the working directory. loopback only, the metrics port may be public
+static void le_profile_cb(struct evhttp_request* req, void* arg)
+{
+	if (!le_loopbackonly(req))
+		return;
+
+	int seconds = 30;
+	struct evkeyvalq query;
+	const char* querystr = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(req));
+	if (querystr != NULL && evhttp_parse_query_str(querystr, &query) == 0) {
+		const char* value = evhttp_find_header(&query, "seconds");
+		if (value != NULL)
+			seconds = atoi(value);
+		evhttp_clear_headers(&query);
+	}
+	seconds = std::max(1, std::min(seconds, SAMPLER_MAX_SECONDS));
+
+	char path[128];
+	snprintf(path, sizeof(path), "tunnel-%d-%lld.folded", (int)getpid(), (long long)time(NULL));
+
+	if (samplerrunning()) {
+		evhttp_send_error(req, 409, "A profile is running");
+		return;
+	}
+	if (!samplerstart(path, seconds, le_profilereport)) {
+		evhttp_send_error(req, HTTP_INTERNAL, "The profile could not start");
+		return;
+	}
+	msglog(eMSGTYPE::INFO, "Profiling %d seconds into %s.", seconds, path);
+
+	struct evbuffer* reply = evbuffer_new();
+	evbuffer_add_printf(reply, "%s\n", path);
+	evhttp_send_reply(req, HTTP_OK, "OK", reply);
+	evbuffer_free(reply);
+}
+#endif
+
+// prometheus text format
+static void le_metrics_cb(struct evhttp_request* req, void* arg)
+{
+	_LoopBusy busy("metrics", 0);
+	struct evbuffer* reply = evbuffer_new();
+
+	evbuffer_add_printf(reply, "# HELP tunnel_active_pairs Relay pairs currently open.\n# TYPE tunnel_active_pairs gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_active_pairs{tunnel=\"%s\"} %lld\n", vTunnels[n]->name, (long long)vTunnels[n]->stats.activepairs);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_accepted_total Client connections accepted.\n# TYPE tunnel_accepted_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_accepted_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.accepted);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_bytes_in_total Bytes relayed from clients to the local server.\n# TYPE tunnel_bytes_in_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_bytes_in_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.bytesin);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_bytes_out_total Bytes relayed from the local server to clients.\n# TYPE tunnel_bytes_out_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_bytes_out_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.bytesout);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_errors_total Connect and socket errors.\n# TYPE tunnel_errors_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_errors_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.errors);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_output_buffer_peak_bytes Largest output buffer seen on a relay side.\n# TYPE tunnel_output_buffer_peak_bytes gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_output_buffer_peak_bytes{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.peakoutput);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_pool_target Idle upstream connections the pools aim to keep open.\n# TYPE tunnel_pool_target gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		int target = 0;
+		for (size_t i = 0; i < vTunnels[n]->vPools.size(); i++)
+			target += vTunnels[n]->vPools[i]->target;
+		evbuffer_add_printf(reply, "tunnel_pool_target{tunnel=\"%s\"} %d\n", vTunnels[n]->name, target);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_pool_accept_rate Smoothed clients per second asking the pools.\n# TYPE tunnel_pool_accept_rate gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		double rate = 0;
+		for (size_t i = 0; i < vTunnels[n]->vPools.size(); i++)
+			rate += vTunnels[n]->vPools[i]->acceptrate;
+		evbuffer_add_printf(reply, "tunnel_pool_accept_rate{tunnel=\"%s\"} %g\n", vTunnels[n]->name, rate);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_pool_hits_total Clients given a pooled upstream.\n# TYPE tunnel_pool_hits_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_pool_hits_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.poolhits);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_pool_misses_total Clients that found the pool empty.\n# TYPE tunnel_pool_misses_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_pool_misses_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.poolmisses);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_links Multiplexed link connections currently open.\n# TYPE tunnel_links gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->linkmode != _LINK_MODE::_NONE)
+			evbuffer_add_printf(reply, "tunnel_links{tunnel=\"%s\"} %d\n", vTunnels[n]->name, (int)vTunnels[n]->vLinks.size());
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_compress_in_bytes_total Link bytes given to the compressor.\n# TYPE tunnel_compress_in_bytes_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->compression)
+			evbuffer_add_printf(reply, "tunnel_compress_in_bytes_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.zbytesin);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_compress_out_bytes_total Compressed bytes sent on the link.\n# TYPE tunnel_compress_out_bytes_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->compression)
+			evbuffer_add_printf(reply, "tunnel_compress_out_bytes_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.zbytesout);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_tls_handshakes_total Link TLS handshakes completed.\n# TYPE tunnel_tls_handshakes_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->tls)
+			evbuffer_add_printf(reply, "tunnel_tls_handshakes_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.tlshandshakes);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_tls_resumed_total Link TLS handshakes that resumed a session.\n# TYPE tunnel_tls_resumed_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->tls)
+			evbuffer_add_printf(reply, "tunnel_tls_resumed_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.tlsresumed);
+	}
+
+	static const char* classes[PRIORITY_CLASSES] = { "interactive", "bulk" };
+
+	evbuffer_add_printf(reply, "# HELP tunnel_link_frames_total Stream data frames put on the links.\n# TYPE tunnel_link_frames_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		for (int i = 0; vTunnels[n]->linkmode != _LINK_MODE::_NONE && i < PRIORITY_CLASSES; i++)
+			evbuffer_add_printf(reply, "tunnel_link_frames_total{tunnel=\"%s\",class=\"%s\"} %llu\n", vTunnels[n]->name, classes[i], (unsigned long long)vTunnels[n]->stats.linkframes[i]);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_link_waits_total Turns streams waited for while the link output was full.\n# TYPE tunnel_link_waits_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		for (int i = 0; vTunnels[n]->linkmode != _LINK_MODE::_NONE && i < PRIORITY_CLASSES; i++)
+			evbuffer_add_printf(reply, "tunnel_link_waits_total{tunnel=\"%s\",class=\"%s\"} %llu\n", vTunnels[n]->name, classes[i], (unsigned long long)vTunnels[n]->stats.linkwaits[i]);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_link_wait_seconds_total Time streams waited for their turn on the links.\n# TYPE tunnel_link_wait_seconds_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		for (int i = 0; vTunnels[n]->linkmode != _LINK_MODE::_NONE && i < PRIORITY_CLASSES; i++)
+			evbuffer_add_printf(reply, "tunnel_link_wait_seconds_total{tunnel=\"%s\",class=\"%s\"} %g\n", vTunnels[n]->name, classes[i], vTunnels[n]->stats.linkwaitusec[i] / 1000000.0);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_link_rtt_seconds Smoothed round trip of a multipath or keepalive link.\n# TYPE tunnel_link_rtt_seconds gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		for (size_t i = 0; (vTunnels[n]->multipath || vTunnels[n]->keepalive > 0) && i < vTunnels[n]->vLinks.size(); i++)
+			evbuffer_add_printf(reply, "tunnel_link_rtt_seconds{tunnel=\"%s\",link=\"%d\"} %g\n", vTunnels[n]->name, (int)i, vTunnels[n]->vLinks[i]->srtt / 1000000.0);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_link_jitter_seconds Mean deviation of the round trips of a multipath or keepalive link.\n# TYPE tunnel_link_jitter_seconds gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		for (size_t i = 0; (vTunnels[n]->multipath || vTunnels[n]->keepalive > 0) && i < vTunnels[n]->vLinks.size(); i++)
+			evbuffer_add_printf(reply, "tunnel_link_jitter_seconds{tunnel=\"%s\",link=\"%d\"} %g\n", vTunnels[n]->name, (int)i, vTunnels[n]->vLinks[i]->rttvar / 1000000.0);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_link_reaped_total Links closed and replaced after missing their keepalives.\n# TYPE tunnel_link_reaped_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->keepalive > 0)
+			evbuffer_add_printf(reply, "tunnel_link_reaped_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.linkreaped);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_link_rate_bytes Bytes per second a multipath link was seen to carry.\n# TYPE tunnel_link_rate_bytes gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		for (size_t i = 0; vTunnels[n]->multipath && i < vTunnels[n]->vLinks.size(); i++)
+			evbuffer_add_printf(reply, "tunnel_link_rate_bytes{tunnel=\"%s\",link=\"%d\"} %.0f\n", vTunnels[n]->name, (int)i, vTunnels[n]->vLinks[i]->rate);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_stream_resumes_total Streams moved to another link after theirs closed.\n# TYPE tunnel_stream_resumes_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->resume)
+			evbuffer_add_printf(reply, "tunnel_stream_resumes_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.resumed);
+	}
+
+	le_httpmetrics(reply);
+
+	// estimates of the listed clients, both families print from the same snapshot
+	std::vector<std::pair<std::string, std::string>> vTalkerNames;
+	std::vector<std::pair<double, double>> vTalkerRates;
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		_TalkerSketch* sketch = vTunnels[n]->talkers;
+		std::vector<_Talker> vTop;
+
+		if (sketch == NULL)
+			continue;
+		{
+			std::lock_guard<std::mutex> lock(sketch->lock);
+			vTop = sketch->vTop;
+		}
+
+		for (size_t i = 0; i < vTop.size(); i++) {
+			size_t slots[TALKER_DEPTH];
+			unsigned long long bytes = ULLONG_MAX;
+			unsigned long long accepts = ULLONG_MAX;
+
+			le_talkerslots(vTop[i].key, slots);
+			for (int r = 0; r < TALKER_DEPTH; r++) {
+				bytes = std::min(bytes, (unsigned long long)sketch->bytes[r][slots[r]]);
+				accepts = std::min(accepts, (unsigned long long)sketch->accepts[r][slots[r]]);
+			}
+			vTalkerNames.push_back(std::make_pair(std::string(vTunnels[n]->name), le_talkername(vTop[i].key)));
+			vTalkerRates.push_back(std::make_pair(bytes * 1000.0 / (2 * TALKER_DECAY_MSEC), accepts * 1000.0 / (2 * TALKER_DECAY_MSEC)));
+		}
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_top_talker_rate_bytes Bytes per second relayed by the heaviest clients of a tunnel, estimated and decaying.\n# TYPE tunnel_top_talker_rate_bytes gauge\n");
+	for (size_t n = 0; n < vTalkerNames.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_top_talker_rate_bytes{tunnel=\"%s\",client=\"%s\"} %.0f\n", vTalkerNames[n].first.c_str(), vTalkerNames[n].second.c_str(), vTalkerRates[n].first);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_top_talker_accept_rate Connections per second of the same clients.\n# TYPE tunnel_top_talker_accept_rate gauge\n");
+	for (size_t n = 0; n < vTalkerNames.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_top_talker_accept_rate{tunnel=\"%s\",client=\"%s\"} %g\n", vTalkerNames[n].first.c_str(), vTalkerNames[n].second.c_str(), vTalkerRates[n].second);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_top_talker_throttled_total Pairs of top talkers put under Top Talker Limit.\n# TYPE tunnel_top_talker_throttled_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->talkerlimit > 0)
+			evbuffer_add_printf(reply, "tunnel_top_talker_throttled_total{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.talkerthrottled);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_accept_rejected_total Clients closed right after accept, over Max Connections or Accept Rate or while Circuit Breaker is open.\n# TYPE tunnel_accept_rejected_total counter\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->maxconnections > 0)
+			evbuffer_add_printf(reply, "tunnel_accept_rejected_total{tunnel=\"%s\",reason=\"full\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.rejectedfull);
+		if (vTunnels[n]->acceptrate > 0)
+			evbuffer_add_printf(reply, "tunnel_accept_rejected_total{tunnel=\"%s\",reason=\"rate\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.rejectedrate);
+		if (vTunnels[n]->breaker > 0)
+			evbuffer_add_printf(reply, "tunnel_accept_rejected_total{tunnel=\"%s\",reason=\"breaker\"} %llu\n", vTunnels[n]->name, (unsigned long long)vTunnels[n]->stats.rejectedbreaker);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_circuit_breaker_open 1 while the local server failed Circuit Breaker connects in a row and only probes go through.\n# TYPE tunnel_circuit_breaker_open gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->breaker > 0)
+			evbuffer_add_printf(reply, "tunnel_circuit_breaker_open{tunnel=\"%s\"} %d\n", vTunnels[n]->name, (vTunnels[n]->connectfailures >= vTunnels[n]->breaker) ? 1 : 0);
+	}
+
+	if (shedlagmsec > 0) {
+		evbuffer_add_printf(reply, "# HELP tunnel_shedding 1 while the proxy listeners are off for Shed Loop Lag.\n# TYPE tunnel_shedding gauge\ntunnel_shedding %d\n", shedding ? 1 : 0);
+		evbuffer_add_printf(reply, "# HELP tunnel_shed_total Times the proxy listeners were turned off for Shed Loop Lag.\n# TYPE tunnel_shed_total counter\ntunnel_shed_total %llu\n", (unsigned long long)shedtotal);
+	}
+
+	std::vector<_LoopWatchStats> vLoops;
+	loopwatchstats(vLoops);
+	evbuffer_add_printf(reply, "# HELP tunnel_loop_lag_seconds How late the %d ms probe timer of each loop fired.\n# TYPE tunnel_loop_lag_seconds histogram\n", SHED_PROBE_MSEC);
+	for (size_t n = 0; n < vLoops.size(); n++) {
+		unsigned long long cumulative = 0;
+		for (int i = 0; i < LOOPWATCH_BUCKETS; i++) {
+			cumulative += vLoops[n].buckets[i];
+			evbuffer_add_printf(reply, "tunnel_loop_lag_seconds_bucket{loop=\"%s\",le=\"%g\"} %llu\n", vLoops[n].name.c_str(), loopwatchbounds[i] / 1000.0, cumulative);
+		}
+		evbuffer_add_printf(reply, "tunnel_loop_lag_seconds_bucket{loop=\"%s\",le=\"+Inf\"} %llu\n", vLoops[n].name.c_str(), vLoops[n].count);
+		evbuffer_add_printf(reply, "tunnel_loop_lag_seconds_sum{loop=\"%s\"} %g\n", vLoops[n].name.c_str(), vLoops[n].sumusec / 1000000.0);
+		evbuffer_add_printf(reply, "tunnel_loop_lag_seconds_count{loop=\"%s\"} %llu\n", vLoops[n].name.c_str(), vLoops[n].count);
+	}
+	if (stallmsec > 0) {
+		evbuffer_add_printf(reply, "# HELP tunnel_loop_stalls_total Times a loop was stuck in one callback for more than Stall Report.\n# TYPE tunnel_loop_stalls_total counter\n");
+		for (size_t n = 0; n < vLoops.size(); n++)
+			evbuffer_add_printf(reply, "tunnel_loop_stalls_total{loop=\"%s\"} %llu\n", vLoops[n].name.c_str(), vLoops[n].stalls);
+	}
+
+	std::vector<_MemTagStats> vTags;
+	memtagstats(vTags);
+	evbuffer_add_printf(reply, "# HELP tunnel_mem_live_bytes Bytes held by a subsystem.\n# TYPE tunnel_mem_live_bytes gauge\n");
+	for (size_t n = 0; n < vTags.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_mem_live_bytes{tag=\"%s\"} %lld\n", vTags[n].name, vTags[n].live);
+	evbuffer_add_printf(reply, "# HELP tunnel_mem_peak_bytes Most bytes a subsystem was seen holding, sampled by the main loop.\n# TYPE tunnel_mem_peak_bytes gauge\n");
+	for (size_t n = 0; n < vTags.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_mem_peak_bytes{tag=\"%s\"} %lld\n", vTags[n].name, vTags[n].peak);
+	evbuffer_add_printf(reply, "# HELP tunnel_mem_allocs_total Allocations of a subsystem.\n# TYPE tunnel_mem_allocs_total counter\n");
+	for (size_t n = 0; n < vTags.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_mem_allocs_total{tag=\"%s\"} %llu\n", vTags[n].name, vTags[n].allocs);
+	evbuffer_add_printf(reply, "# HELP tunnel_mem_frees_total Frees of a subsystem.\n# TYPE tunnel_mem_frees_total counter\n");
+	for (size_t n = 0; n < vTags.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_mem_frees_total{tag=\"%s\"} %llu\n", vTags[n].name, vTags[n].frees);
+
+	_EvMemStats memstats;
+	evmemstats(memstats);
+	if (memstats.installed) {
+		evbuffer_add_printf(reply, "# HELP tunnel_evmem_allocs_total libevent allocations by where they came from, the size classes or malloc.\n# TYPE tunnel_evmem_allocs_total counter\n");
+		evbuffer_add_printf(reply, "tunnel_evmem_allocs_total{from=\"class\"} %llu\ntunnel_evmem_allocs_total{from=\"malloc\"} %llu\n", memstats.allocs, memstats.large);
+		evbuffer_add_printf(reply, "# HELP tunnel_evmem_class_blocks Size class blocks held by libevent.\n# TYPE tunnel_evmem_class_blocks gauge\ntunnel_evmem_class_blocks %lld\n", (long long)(memstats.allocs - memstats.frees));
+		evbuffer_add_printf(reply, "# HELP tunnel_evmem_transfers_total Batches moved between the thread caches and the shared pool, each one lock.\n# TYPE tunnel_evmem_transfers_total counter\n");
+		evbuffer_add_printf(reply, "tunnel_evmem_transfers_total{way=\"refill\"} %llu\ntunnel_evmem_transfers_total{way=\"spill\"} %llu\n", memstats.refills, memstats.spills);
+		evbuffer_add_printf(reply, "# HELP tunnel_evmem_slab_bytes Bytes the size classes took from malloc, kept for reuse.\n# TYPE tunnel_evmem_slab_bytes gauge\ntunnel_evmem_slab_bytes %llu\n", memstats.slabbytes);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_vhost_unmatched_total Clients of a shared proxy port whose name no Virtual Hosts entry took.\n# TYPE tunnel_vhost_unmatched_total counter\n");
+	for (size_t n = 0; n < vVhosts.size(); n++)
+		evbuffer_add_printf(reply, "tunnel_vhost_unmatched_total{listener=\"%s:%d\"} %llu\n", vVhosts[n]->ip, vVhosts[n]->port, vVhosts[n]->unmatched);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_udp_flows UDP client flows currently open.\n# TYPE tunnel_udp_flows gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		if (vTunnels[n]->udp || vTunnels[n]->linkmode == _LINK_MODE::_CONNECT)
+			evbuffer_add_printf(reply, "tunnel_udp_flows{tunnel=\"%s\"} %d\n", vTunnels[n]->name, (int)vTunnels[n]->mUdpFlows.size());
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_backend_up Local server of a balanced tunnel passing its health check.\n# TYPE tunnel_backend_up gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		for (size_t i = 0; i < vTunnels[n]->vBackends.size(); i++)
+			evbuffer_add_printf(reply, "tunnel_backend_up{tunnel=\"%s\",backend=\"%s:%d\"} %d\n", vTunnels[n]->name,
+				vTunnels[n]->vBackends[i]->ip, vTunnels[n]->vBackends[i]->port, vTunnels[n]->vBackends[i]->up ? 1 : 0);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_backend_active_pairs Relay pairs connected to each local server of a balanced tunnel.\n# TYPE tunnel_backend_active_pairs gauge\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		for (size_t i = 0; i < vTunnels[n]->vBackends.size(); i++)
+			evbuffer_add_printf(reply, "tunnel_backend_active_pairs{tunnel=\"%s\",backend=\"%s:%d\"} %d\n", vTunnels[n]->name,
+				vTunnels[n]->vBackends[i]->ip, vTunnels[n]->vBackends[i]->port, (int)vTunnels[n]->vBackends[i]->active);
+	}
+
+	evbuffer_add_printf(reply, "# HELP tunnel_buffered_bytes Bytes queued in relay output buffers of all tunnels.\n# TYPE tunnel_buffered_bytes gauge\n");
+	evbuffer_add_printf(reply, "tunnel_buffered_bytes %lld\n", (long long)bufferedbytes);
+	evbuffer_add_printf(reply, "# HELP tunnel_buffer_budget_bytes Configured cap of tunnel_buffered_bytes, 0 is unlimited.\n# TYPE tunnel_buffer_budget_bytes gauge\n");
+	evbuffer_add_printf(reply, "tunnel_buffer_budget_bytes %lld\n", bufferbudget);
+	evbuffer_add_printf(reply, "# HELP tunnel_budget_throttled_total Reads paused because the buffer budget was exceeded.\n# TYPE tunnel_budget_throttled_total counter\n");
+	evbuffer_add_printf(reply, "tunnel_budget_throttled_total %llu\n", (unsigned long long)budgetthrottled);
+
+	evbuffer_add_printf(reply, "# HELP tunnel_connect_latency_seconds Time to connect to the local server.\n# TYPE tunnel_connect_latency_seconds histogram\n");
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		_TunnelStats& stats = vTunnels[n]->stats;
+		unsigned long long cumulative = 0;
+		for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+			cumulative += stats.latencybuckets[i];
+			evbuffer_add_printf(reply, "tunnel_connect_latency_seconds_bucket{tunnel=\"%s\",le=\"%g\"} %llu\n", vTunnels[n]->name,
+				statslatencybounds[i] / 1000000.0, cumulative);
+		}
+		evbuffer_add_printf(reply, "tunnel_connect_latency_seconds_bucket{tunnel=\"%s\",le=\"+Inf\"} %llu\n", vTunnels[n]->name, (unsigned long long)stats.connects);
+		evbuffer_add_printf(reply, "tunnel_connect_latency_seconds_sum{tunnel=\"%s\"} %g\n", vTunnels[n]->name, stats.connectusec / 1000000.0);
+		evbuffer_add_printf(reply, "tunnel_connect_latency_seconds_count{tunnel=\"%s\"} %llu\n", vTunnels[n]->name, (unsigned long long)stats.connects);
+	}
+
+	evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", "text/plain; version=0.0.4");
+	evhttp_send_reply(req, HTTP_OK, "OK", reply);
+	evbuffer_free(reply);
 }
 
 
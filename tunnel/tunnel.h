@@ -0,0 +1,842 @@
+#ifndef TUNNEL_H
+#define TUNNEL_H
+
+#include "common.h"
+#include "evmem.h"
+#include "loopwatch.h"
+#include "memtag.h"
+#include "sampler.h"
+#include "confcache.h"
+#include <yaml-cpp/yaml.h>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <event2/dns.h>
+#include <event2/keyvalq_struct.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+#else
+#include <mswsock.h>
+#endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <zlib.h>
+#include <event2/bufferevent_ssl.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <linux/io_uring.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include <linux/bpf.h>
+#endif
+
+// the tunnels, the relay pairs and the relay loops, shared by tunnel.cpp and the relay paths and
+// subsystems that sit in their own files
+
+struct _TunnelsInfo;
+struct _RelayWorker;
+struct _SockmapPair;
+struct _UpstreamPool;
+struct _MuxLink;
+struct _MuxStream;
+struct _UdpFlow;
+struct _HttpCache;
+struct _VhostListener;
+struct _VhostPeek;
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+struct _UringLoop;
+#endif
+
+#define STATS_LATENCY_BUCKETS 8
+#define PRIORITY_CLASSES 2	// interactive and bulk link streams
+
+// updated from every relay loop, read by the metrics endpoint
+struct _TunnelStats
+{
+	_TunnelStats()
+	{
+		activepairs = 0;
+		accepted = 0;
+		bytesin = 0;
+		bytesout = 0;
+		errors = 0;
+		peakoutput = 0;
+		connects = 0;
+		connectusec = 0;
+		poolhits = 0;
+		poolmisses = 0;
+		zbytesin = 0;
+		zbytesout = 0;
+		tlshandshakes = 0;
+		tlsresumed = 0;
+		for (int n = 0; n < STATS_LATENCY_BUCKETS; n++)
+			latencybuckets[n] = 0;
+		resumed = 0;
+		linkreaped = 0;
+		for (int n = 0; n < PRIORITY_CLASSES; n++) {
+			linkframes[n] = 0;
+			linkwaits[n] = 0;
+			linkwaitusec[n] = 0;
+		}
+		httphits = 0;
+		httpmisses = 0;
+		httprevalidated = 0;
+		httphitbytes = 0;
+		talkerthrottled = 0;
+		rejectedfull = 0;
+		rejectedrate = 0;
+		rejectedbreaker = 0;
+	}
+
+	std::atomic<long long> activepairs;
+	std::atomic<unsigned long long> accepted;
+	std::atomic<unsigned long long> bytesin;	// client to local server
+	std::atomic<unsigned long long> bytesout;	// local server to client
+	std::atomic<unsigned long long> errors;
+	std::atomic<unsigned long long> peakoutput;
+	std::atomic<unsigned long long> connects;
+	std::atomic<unsigned long long> connectusec;
+	std::atomic<unsigned long long> poolhits;
+	std::atomic<unsigned long long> poolmisses;
+	std::atomic<unsigned long long> zbytesin;	// link bytes given to the deflater
+	std::atomic<unsigned long long> zbytesout;	// and the deflated bytes sent
+	std::atomic<unsigned long long> tlshandshakes;
+	std::atomic<unsigned long long> tlsresumed;
+	std::atomic<unsigned long long> latencybuckets[STATS_LATENCY_BUCKETS];
+	std::atomic<unsigned long long> resumed;	// streams moved to another link after theirs closed
+	std::atomic<unsigned long long> linkreaped;	// links closed for missing their keepalives
+	std::atomic<unsigned long long> linkframes[PRIORITY_CLASSES];	// stream data frames put on a link, interactive and bulk
+	std::atomic<unsigned long long> linkwaits[PRIORITY_CLASSES];	// turns a stream waited for while the link output was full
+	std::atomic<unsigned long long> linkwaitusec[PRIORITY_CLASSES];	// and the time it waited
+	std::atomic<unsigned long long> httphits;	// requests answered from the HTTP Cache
+	std::atomic<unsigned long long> httpmisses;	// cacheable requests sent to the local server
+	std::atomic<unsigned long long> httprevalidated;	// stale entries the local server answered with 304
+	std::atomic<unsigned long long> httphitbytes;	// body bytes sent from the cache
+	std::atomic<unsigned long long> talkerthrottled;	// pairs of a heavy client put under Top Talker Limit
+	std::atomic<unsigned long long> rejectedfull;	// clients closed on accept over Max Connections
+	std::atomic<unsigned long long> rejectedrate;	// over Accept Rate
+	std::atomic<unsigned long long> rejectedbreaker;	// while Circuit Breaker is open
+};
+
+#define HOST_NAME_LEN 256
+#define RATE_TICK_MSEC 100
+#define LINK_RETRY_MSEC 1000
+#define LINK_MAX_CONNECTIONS 64
+#define MUX_ZCHUNK 16000	// input per deflated frame, leaves room for incompressible data to grow within MUX_MAX_PAYLOAD
+#define COMPRESS_SAMPLE_FRAMES 4
+#define MUX_OPEN_UDP 1	// STREAM_OPEN payload of a stream carrying datagrams
+#define LINK_HIGH_WATER (64 * 1024)	// bulk streams wait for their turn while the link output holds this much
+#define LINK_INTERACTIVE_WATER (256 * 1024)	// and interactive ones past this
+#define PRIORITY_WEIGHT 8	// interactive turns for each bulk turn while both wait
+#define PRIORITY_BULK_BYTES (256 * 1024)	// sent in one burst make an auto stream bulk
+#define PRIORITY_BURST_MSEC 100	// sends closer than this are one burst
+#define PRIORITY_IDLE_MSEC 1000	// and a quiet second makes it interactive again
+#define PATH_PING_MSEC 1000	// links of resumable streams are pinged for their round trip time
+#define PATH_DEAD_MSEC 5000	// and closed when nothing arrived for this long
+#define PATH_MIN_RATE (1024 * 1024)	// bytes per second a link is assumed to drain before it is measured
+#define KEEPALIVE_MISSES 3	// Link Keepalive intervals a link may stay silent before it is replaced
+#define UDP_BATCH 32
+#define UDP_DATAGRAM_MAX MUX_MAX_PAYLOAD
+#define UDP_SWEEP_MSEC 1000
+#define RACE_DELAY_MSEC 250	// happy eyeballs connection attempt delay
+#define MAX_RACE_ADDRS 8
+#define BACKEND_VNODES 64	// points of each backend on the client hash ring
+#define HEALTH_TIMEOUT_MSEC 2000
+#define VHOST_PEEK_MAX (16 * 1024 + 5)	// a TLS record holding the ClientHello, or an HTTP request head up to its Host
+#define VHOST_PEEK_MSEC 5000	// a client quiet this long goes to the "*" tunnel, or is closed without one
+
+struct _AddrInfo
+{
+	struct sockaddr_storage addr;
+	int addrlen;
+};
+
+enum class _BALANCE_TYPE
+{
+	_LEAST_CONNECTIONS,
+	_CLIENT_HASH
+};
+
+// one of several local servers sharing a tunnel, the list is fixed once the tunnel starts
+struct _Backend
+{
+	_Backend()
+	{
+		memset(ip, 0, sizeof(ip));
+		port = -1;
+		up = true;
+		active = 0;
+		checkbev = NULL;
+		tunnelinfo = NULL;
+	}
+
+	char ip[HOST_NAME_LEN];
+	int port;
+	std::vector<_AddrInfo> vAddrs;
+	std::atomic<bool> up;
+	std::atomic<int> active;	// relay pairs connected to it
+	struct bufferevent* checkbev;	// health check in flight, main loop only
+	_TunnelsInfo* tunnelinfo;
+};
+
+// class of the link streams of a tunnel, auto starts every stream interactive and moves the ones sending full frames to bulk
+enum class _PRIORITY
+{
+	_AUTO,
+	_INTERACTIVE,
+	_BULK
+};
+
+enum class _LINK_MODE
+{
+	_NONE,
+	_LISTEN,	// clients arrive on the proxy port and are carried as streams over links accepted on the link port
+	_CONNECT	// dials the link port and connects a local server upstream per opened stream
+};
+
+// TCP options of the sockets of a tunnel, "Socket Options" of the tunnel, a zero keeps the system default.
+// set on every accepted socket and on every upstream and link socket before it connects
+struct _SockOpts
+{
+	_SockOpts()
+	{
+		nodelay = true;
+		keepidle = 0;
+		keepintvl = 0;
+		keepcnt = 0;
+		sndbuf = 0;
+		rcvbuf = 0;
+		usertimeout = 0;
+		fastopen = 0;
+		quickack = false;
+		busypoll = 0;
+		notsentlowat = 0;
+		memset(congestion, 0, sizeof(congestion));
+	}
+
+	bool nodelay;	// small writes leave at once instead of waiting for the ack of the last one
+	int keepidle;	// seconds idle before the first keepalive probe, keepalive stays off at 0
+	int keepintvl;	// seconds between probes
+	int keepcnt;	// probes unanswered before the connection is dropped
+	int sndbuf;	// bytes
+	int rcvbuf;	// bytes, set before connect and on the listener so the window scale covers it
+	int usertimeout;	// msec sent data may stay unacknowledged before the connection is dropped
+	int fastopen;	// pending fast open requests a listener queues
+	bool quickack;	// acks the first segments of a connection at once
+	int busypoll;	// usec a read busy polls the device queue, needs CAP_NET_ADMIN above the sysctl
+	int notsentlowat;	// bytes not sent yet the kernel queues, the rest waits in the bufferevent where link frames are still ordered
+	char congestion[16];	// congestion control of the socket, empty keeps the system one
+};
+
+// shared token bucket of the connections of one client IP
+struct _RateGroup
+{
+	_RateGroup()
+	{
+		group = NULL;
+		members = 0;
+	}
+
+	struct bufferevent_rate_limit_group* group;
+	int members;
+};
+
+#define TALKER_DEPTH 4	// rows of a count-min sketch, an estimate is the smallest of its counters
+#define TALKER_WIDTH 1024
+#define PAIR_POOL_MAX 1024	// closed pairs a loop keeps for its next accepts, above it they are deleted
+#define TALKER_BATCH (16 * 1024)	// bytes a pair relays before they are added, heavy clients take the list lock once per batch
+#define TALKER_DECAY_MSEC 10000	// the counts halve, a steady client settles at twice what it relays in this time
+#define TALKER_ACCEPT_BYTES (64 * 1024)	// a connection ranks like this many bytes relayed, floods of them make the list too
+
+#define ACCEPT_TABLE_SIZE 4096	// Accept Rate buckets of a tunnel, a power of two
+#define ACCEPT_PROBES 4
+#define SHED_PROBE_MSEC 100	// each loop measures how late this timer fires
+#define READ_SIZE_MIN 4096	// Read Size Min when only Read Size Max is set
+#define READ_CHUNK 4096	// bytes libevent 2.1 reads from a socket at once, EVBUFFER_MAX_READ
+#define READ_SIZE_MSEC 1000	// a side whose reads stayed below a quarter of its size for this long gets half of it
+#define SHED_RECOVER_PROBES 10	// probes below half of Shed Loop Lag before the proxy listeners accept again
+
+// token bucket of one client address, credit is kept in usec of refill
+struct _AcceptBucket
+{
+	unsigned int key;
+	bool used;
+	unsigned long long tick;
+	long long credit;
+};
+
+// Accept Rate of a tunnel in a fixed table, a scan from many addresses evicts the fullest buckets and takes
+// no memory. sharded listeners check it from their own loops
+struct _AcceptLimiter
+{
+	_AcceptLimiter()
+	{
+		memset(buckets, 0, sizeof(buckets));
+	}
+
+	std::mutex lock;
+	_AcceptBucket buckets[ACCEPT_TABLE_SIZE];
+};
+
+// how late the probe timer of a loop fired, tick is when it last did
+struct _LagProbe
+{
+	_LagProbe()
+	{
+		timer = NULL;
+		watch = NULL;
+		tick = 0;
+		lag = 0;
+	}
+
+	struct event* timer;
+	_LoopWatch* watch;	// lag histogram and stall reports of the loop
+	std::atomic<unsigned long long> tick;	// usec
+	std::atomic<unsigned long long> lag;
+};
+
+// a client on the top list of its tunnel and its rank when it last got there
+struct _Talker
+{
+	std::string key;	// address bytes, 4 or 16
+	unsigned long long rank;
+};
+
+// relayed bytes and accepts of the clients of a tunnel in count-min sketches, constant memory however many
+// addresses scan it, and the heaviest of them in a small heap, updated from every relay loop
+struct _TalkerSketch
+{
+	_TalkerSketch()
+	{
+		for (int n = 0; n < TALKER_DEPTH; n++) {
+			for (int i = 0; i < TALKER_WIDTH; i++) {
+				bytes[n][i] = 0;
+				accepts[n][i] = 0;
+			}
+		}
+		floor = 0;
+		timer = NULL;
+	}
+
+	std::atomic<unsigned long long> bytes[TALKER_DEPTH][TALKER_WIDTH];
+	std::atomic<unsigned long long> accepts[TALKER_DEPTH][TALKER_WIDTH];
+	std::vector<_Talker> vTop;	// min heap on rank, guarded by lock
+	std::mutex lock;
+	std::atomic<unsigned long long> floor;	// rank a client has to beat to enter the full list
+	struct event* timer;	// halves the counts, main loop
+};
+
+struct _TunnelsInfo
+{
+	_TunnelsInfo()
+	{
+		memset(name, 0, sizeof(name));
+		memset(proxyip, 0, sizeof(proxyip));
+		proxyport = -1;
+		memset(local_serverip, 0, sizeof(local_serverip));
+		local_serverport = -1;
+		proxy_listener = NULL;
+		sharded = false;
+		splice = false;
+		uring = false;
+		rio = false;
+		sockmap = false;
+		proxyprotocol = false;
+#ifdef _WIN32
+		riolistener = INVALID_SOCKET;
+#endif
+		highwatermark = 0;
+		lowwatermark = 0;
+		readsizemin = 0;
+		readsizemax = 0;
+		minidle = 0;
+		maxidle = 0;
+		readtimeout = 0;
+		writetimeout = 0;
+		preferfamily = AF_UNSPEC;
+		dnsrefresh = 300;
+		dnstimer = NULL;
+		linkmode = _LINK_MODE::_NONE;
+		memset(linkip, 0, sizeof(linkip));
+		linkport = -1;
+		linkconnections = 1;
+		linkrequested = 0;
+		nextstream = 1;
+		multipath = false;
+		resume = false;
+		resumetimeout = 30;
+		pathtimer = NULL;
+		keepalive = 0;
+		keepalivemisses = KEEPALIVE_MISSES;
+		keepalivetimer = NULL;
+		streamwindow = 262144;
+		priority = _PRIORITY::_AUTO;
+		compression = false;
+		tls = false;
+		ktls = false;
+		udp = false;
+		udptimeout = 60;
+		ratelimit = 0;
+		clientratelimit = 0;
+		rateshare = 0;
+		ratecfg = NULL;
+		clientratecfg = NULL;
+		rategroup = NULL;
+		udpfd = -1;
+		udpev = NULL;
+		udptimer = NULL;
+		memset(tlscert, 0, sizeof(tlscert));
+		memset(tlskey, 0, sizeof(tlskey));
+		memset(tlsca, 0, sizeof(tlsca));
+		memset(tlsservername, 0, sizeof(tlsservername));
+#ifdef __linux__
+		tlsctx = NULL;
+		tlssession = NULL;
+#endif
+		link_listener = NULL;
+		linktimer = NULL;
+		linkaddrlen = 0;
+		retired = false;
+		slot = 0;
+		localgen = 0;
+		balance = _BALANCE_TYPE::_LEAST_CONNECTIONS;
+		healthcheck = 0;
+		healthtimer = NULL;
+		nextbackend = 0;
+		httpcache = false;
+		httpmemory = 64 * 1024 * 1024;
+		httpobject = 8 * 1024 * 1024;
+		memset(httpdir, 0, sizeof(httpdir));
+		httpdisk = 1024 * 1024 * 1024;
+		cache = NULL;
+		vhost = NULL;
+		toptalkers = 0;
+		talkerlimit = 0;
+		talkercfg = NULL;
+		talkers = NULL;
+		backlog = -1;
+		maxconnections = 0;
+		acceptrate = 0;
+		acceptburst = 0;
+		acceptlimiter = NULL;
+		breaker = 0;
+		breakercooldown = 10;
+		connecttimeout = 0;
+		connectfailures = 0;
+		breakeruntil = 0;
+	}
+
+	char name[50];
+	char proxyip[HOST_NAME_LEN];
+	int proxyport;
+	char local_serverip[HOST_NAME_LEN];
+	int local_serverport;
+	struct evconnlistener* proxy_listener;
+	_SockOpts sockopts;
+	bool sharded;
+	bool splice;
+	bool uring;	// relay through io_uring where the kernel has it
+	bool rio;	// relay through registered I/O on Windows
+	bool sockmap;	// established pairs are forwarded by a BPF verdict program
+	bool proxyprotocol;	// a PROXY v2 header with the client address goes ahead of its data to the local server
+#ifdef _WIN32
+	SOCKET riolistener;	// in place of proxy_listener
+#endif
+	size_t highwatermark;
+	size_t lowwatermark;
+	int readsizemin;	// bytes, bounds of the adaptive read size of each side of a pair, 0 keeps the libevent default
+	int readsizemax;
+	int minidle;
+	int maxidle;
+	int readtimeout;	// seconds without traffic in either direction before the pair is closed
+	int writetimeout;	// seconds a side may hold unsent data
+	std::vector<_AddrInfo> vLocalAddrs;	// local server addresses resolved from local_serverip, guarded by addrlock
+	std::atomic<int> preferfamily;	// family of the last connect race winner
+	std::mutex addrlock;
+	int dnsrefresh;
+	struct event* dnstimer;
+	std::vector<struct evconnlistener*> vShardListeners;
+	std::vector<_UpstreamPool*> vPools;
+	_LINK_MODE linkmode;
+	char linkip[HOST_NAME_LEN];
+	int linkport;
+	int linkconnections;
+	int linkrequested;	// listen side, links asked for with CREATE_TUNNEL and not accepted yet
+	DWORD nextstream;	// listen side, ids are unique across the links so a stream can move to another one
+	bool multipath;	// links are spread over the sources and picked by cost, implies resume
+	bool resume;	// streams of a closed link wait for another one and resume on it
+	int resumetimeout;	// seconds an orphaned stream waits
+	std::vector<std::string> vLinkSources;	// connect side, local addresses the links are spread over
+	std::vector<_AddrInfo> vSourceAddrs;
+	struct event* pathtimer;
+	int keepalive;	// seconds between the KEEP_ALIVE frames of each link, 0 sends none
+	int keepalivemisses;
+	struct event* keepalivetimer;
+	std::vector<_MuxStream*> vOrphans;	// resumable streams between a closed link and the next one
+	int streamwindow;	// bytes a stream may send before the peer credits it with a window update
+	_PRIORITY priority;
+	bool compression;
+	bool tls;
+	bool ktls;
+	bool udp;
+	int udptimeout;	// seconds a UDP flow is kept without datagrams
+	evutil_socket_t udpfd;
+	struct event* udpev;
+	struct event* udptimer;
+	std::map<std::string, _UdpFlow*> mUdpFlows;	// keyed by client address, or by link and stream on the connect side
+	long long ratelimit;	// bytes per second of all clients, applied to the client side of each pair
+	long long clientratelimit;	// bytes per second of one client IP, applied to the local server side
+	int rateshare;	// smallest slice of a group's tokens a member may take per tick
+	struct ev_token_bucket_cfg* ratecfg;
+	struct ev_token_bucket_cfg* clientratecfg;
+	struct bufferevent_rate_limit_group* rategroup;
+	std::map<std::string, _RateGroup> mClientGroups;	// guarded by ratelock
+	std::mutex ratelock;
+	char tlscert[HOST_NAME_LEN];	// listen side certificate and key files
+	char tlskey[HOST_NAME_LEN];
+	char tlsca[HOST_NAME_LEN];	// connect side, verifies the listen side when set
+	char tlsservername[HOST_NAME_LEN];
+#ifdef __linux__
+	SSL_CTX* tlsctx;
+	SSL_SESSION* tlssession;	// connect side, last ticket so redialed links resume instead of a full handshake
+#endif
+	struct evconnlistener* link_listener;
+	struct event* linktimer;
+	struct sockaddr_storage linkaddr;
+	int linkaddrlen;
+	std::vector<_MuxLink*> vLinks;	// only touched from the main loop
+	std::atomic<bool> retired;	// dropped by a reload, accepts nothing new while its pairs drain
+	size_t slot;	// in vTunnels while it runs
+	std::atomic<int> localgen;	// bumped when a reload moves the local server, pooled connections to the old one are dropped
+	std::vector<_Backend*> vBackends;	// Local Servers, empty when the tunnel has a single local server
+	std::vector<std::pair<unsigned int, int>> vHashRing;	// sorted points to backend indexes
+	_BALANCE_TYPE balance;
+	int healthcheck;	// seconds between backend connect checks, 0 is off
+	struct event* healthtimer;
+	std::atomic<unsigned int> nextbackend;	// rotates least connections ties
+	bool httpcache;	// clients of the proxy port are parsed as HTTP and static responses served from the cache
+	size_t httpmemory;	// body bytes the cache keeps in memory
+	size_t httpobject;	// largest body stored
+	char httpdir[HOST_NAME_LEN];	// disk tier the bodies pushed out of memory go to, none when empty
+	size_t httpdisk;	// body bytes of the disk tier
+	_HttpCache* cache;	// main loop only
+	std::vector<std::string> vVhosts;	// lower case names this tunnel takes on a proxy port shared by name, "*.domain" for its subdomains, "*" for the rest
+	_VhostListener* vhost;	// the shared listener it joined
+	int toptalkers;	// clients kept on the top list, 0 tracks none
+	long long talkerlimit;	// bytes per second a client on the top list is throttled to once it relays more, applied to the local server side
+	struct ev_token_bucket_cfg* talkercfg;
+	_TalkerSketch* talkers;
+	int backlog;	// of the proxy listeners, -1 keeps the libevent default
+	std::atomic<long long> maxconnections;	// pairs at once, a client accepted above it is closed at once, 0 is unlimited
+	int acceptrate;	// connections per second of one client address, 0 is unlimited
+	int acceptburst;
+	_AcceptLimiter* acceptlimiter;
+	int breaker;	// connects to the local server failing in a row that open the circuit breaker, 0 is off
+	int breakercooldown;	// seconds an open breaker closes new clients at once before one goes through as a probe
+	int connecttimeout;	// seconds a connect to the local server may take, 0 leaves it to the system
+	std::atomic<int> connectfailures;	// in a row, from every relay loop
+	std::atomic<unsigned long long> breakeruntil;	// le_nowusec the open breaker lets the next probe through at
+	_TunnelStats stats;
+};
+
+// what one side of a pair reads at most per callback, doubled while reads fill it and halved while they stay small
+struct _ReadSizer
+{
+	int size;	// 0 until the first read of a tunnel with Read Size Max
+	size_t peak;	// largest read since tick
+	unsigned long long tick;
+};
+
+#define CONTROL_MAX_BODY (64 * 1024)	// bytes of a tunnel sent to /tunnels
+#define TRACE_EVENTS 32	// events a trace keeps, later stalls of a long connection are counted only
+#define TRACE_RING 1024	// finished traces kept for /traces, the oldest is dropped for a new one
+
+enum class _TRACE_EVENT : BYTE
+{
+	_ACCEPT,
+	_ADDRS,	// the local server addresses are taken from the last lookup
+	_CONNECT,
+	_CONNECTED,
+	_POOLED,	// a pooled upstream instead of a connect
+	_FIRST_IN,	// first bytes read from the client
+	_FIRST_OUT,	// and from the local server
+	_STALL,	// reading paused, the other side is over High Watermark
+	_BUDGET,	// or the pair is over its share of Buffer Budget
+	_RESUME,
+	_FAILED,	// no local server could be connected
+	_CLOSE
+};
+
+struct _TraceEvent
+{
+	_TRACE_EVENT type;
+	unsigned int usec;	// since the accept
+};
+
+// the timeline of a sampled pair, an unsampled one has none and pays one pointer test per event
+struct _PairTrace
+{
+	char tunnel[50];
+	char client[64];
+	long long start;	// usec since the epoch of the accept
+	unsigned long long startusec;	// le_nowusec of the accept
+	int count;
+	int dropped;	// events past TRACE_EVENTS
+	_TraceEvent events[TRACE_EVENTS];
+};
+
+// both sides of a client connection, the callback argument of each bufferevent
+struct _RelayPair : _MemTagged<_MEM_TAG::_RELAY_PAIR>
+{
+	_TunnelsInfo* tunnelinfo;
+	struct bufferevent* proxy_bev;
+	struct bufferevent* local_bev;
+	unsigned long long connectstart;	// usec, 0 once the local server is connected
+	unsigned long long activetick;
+	bool proxyeof;	// read side closed, the peer is shut down for writing once its output is flushed
+	bool localeof;
+	bool proxyshut;	// write side shut down
+	bool localshut;
+	std::string clientkey;	// client IP of the rate group local_bev is in
+	unsigned int clienthash;	// client IP hash when the tunnel balances by client
+	_Backend* backend;	// backend local_bev is connected to
+	_SockmapPair* sockmap;	// NULL unless the kernel forwards the pair
+	std::string talkerkey;	// client address with Top Talkers
+	unsigned long long talkerbytes;	// relayed and not added to the sketch yet
+	_ReadSizer sizer[2];	// of proxy_bev and local_bev
+	unsigned long long bytes[2];	// read from proxy_bev and local_bev
+	size_t index;	// in the pair list of its loop
+	_PairTrace* trace;	// NULL unless the pair is sampled
+};
+
+// candidate connects to the local server, the first one connected becomes the pair's local side
+struct _ConnectRace
+{
+	struct event_base* base;
+	_RelayPair* pair;
+	struct event* timer;
+	std::vector<_AddrInfo> vAddrs;
+	size_t next;
+	std::vector<struct bufferevent*> vAttempts;
+};
+
+// a long lived tunnel connection carrying many client streams, frames start with a _MuxHdr
+struct _MuxLink
+{
+	_TunnelsInfo* tunnelinfo;
+	struct bufferevent* bev;
+	std::map<DWORD, _MuxStream*> mStreams;
+	DWORD nextstream;
+	std::deque<_MuxStream*> dWaiting[PRIORITY_CLASSES];	// streams with data the full link output has no room for
+	int turns;	// interactive turns since the last bulk one
+	int source;	// connect side, index of its Link Source IPs address, -1 without
+	unsigned long long lastrecv;	// usec of the last frame read
+	unsigned long long srtt;	// smoothed round trip of the pings or keepalives, usec
+	unsigned long long rttvar;	// their mean deviation, the jitter
+	unsigned long long peerstamp;	// of the last keepalive read, echoed with the next one sent
+	unsigned long long peerstampat;
+	unsigned long long drained;	// bytes written to the socket since the last ping
+	double rate;	// bytes per second the link was seen to drain
+};
+
+// one client connection of a link, bev is the client on the listen side and the local server on the connect side
+struct _MuxStream
+{
+	DWORD id;
+	_MuxLink* link;	// NULL while orphaned
+	_TunnelsInfo* tunnelinfo;
+	struct bufferevent* bev;
+	long long sendwindow;	// bytes the peer still accepts
+	size_t consumed;	// bytes flushed to bev since the last window update sent to the peer
+	unsigned long long connectstart;
+	bool eofread;	// bev reached EOF, a FIN follows once its input is sent
+	bool finsent;
+	bool finrecv;	// peer is done, bev is shut down for writing once its output is flushed
+	bool shut;
+	bool bulk;
+	bool waiting;	// in the dWaiting of its link, reading resumes on its turn
+	size_t burst;	// bytes sent without a PRIORITY_BURST_MSEC pause
+	unsigned long long waitstart;
+	unsigned long long lastsend;
+	struct evbuffer* unacked;	// resumable, bytes sent and not credited yet, resent when the stream resumes on another link
+	DWORD sent;	// byte counts of the stream, they wrap, only the differences matter
+	DWORD acked;
+	DWORD received;
+	DWORD credited;
+	bool resuming;	// listen side, waits for the STREAM_RESUME answer before sending
+	unsigned long long orphaned;	// usec its link closed, 0 on a link
+	_UdpFlow* udpflow;	// datagram stream, bev is NULL
+#ifdef __linux__
+	z_stream* deflater;	// NULL without compression or once the stream is found incompressible
+	z_stream* inflater;	// created on the first STREAM_ZDATA
+	int zsamples;
+	unsigned long long zsamplein;
+	unsigned long long zsampleout;
+#endif
+};
+
+// client flow of a UDP tunnel, fd is connected to the local server unless the flow is carried by a link stream
+struct _UdpFlow
+{
+	_TunnelsInfo* tunnelinfo;
+	std::string key;
+	struct sockaddr_storage client;
+	int clientlen;
+	evutil_socket_t fd;
+	struct event* readev;
+	_MuxStream* stream;
+	unsigned long long activetick;
+};
+
+struct _UdpDatagram
+{
+	struct sockaddr_storage addr;
+	ev_socklen_t addrlen;
+	size_t len;
+};
+
+
+#define POOL_TIMER_MSEC 1000
+#define POOL_SHRINK_TICKS 30
+#define POOL_RATE_WEIGHT 0.3	// weight of the last tick in the smoothed accept rate
+
+// idle connected upstreams of one tunnel for one relay loop, only touched from that loop's thread
+struct _UpstreamPool
+{
+	_UpstreamPool()
+	{
+		base = NULL;
+		tunnelinfo = NULL;
+		timer = NULL;
+		target = 0;
+		missed = false;
+		quietticks = 0;
+		accepts = 0;
+		acceptrate = 0;
+		gen = 0;
+	}
+
+	struct event_base* base;
+	_TunnelsInfo* tunnelinfo;
+	struct event* timer;
+	std::vector<bufferevent*> vIdle;
+	std::vector<bufferevent*> vConnecting;
+	std::atomic<int> target;
+	bool missed;
+	int quietticks;
+	int accepts;	// clients that asked the pool since the last tick
+	std::atomic<double> acceptrate;	// smoothed clients per second
+	int gen;	// localgen of the tunnel the idle connections were made for
+};
+
+enum class _DISPATCH_TYPE
+{
+	_ROUND_ROBIN,
+	_LEAST_CONNECTIONS
+};
+
+// a relay loop running on its own thread, both sides of a pair stay on the same loop
+struct _RelayWorker
+{
+	_RelayWorker()
+	{
+		index = 0;
+		base = NULL;
+		connections = 0;
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+		uring = NULL;
+		uringfailed = false;
+#endif
+	}
+
+	int index;
+	struct event_base* base;
+	std::thread thread;
+	std::atomic<int> connections;
+	std::vector<_RelayPair*> vPairs;	// established, only touched from the worker thread
+	std::vector<_RelayPair*> vFreePairs;	// closed, reused by the next accepts of the loop
+	_LagProbe probe;
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+	_UringLoop* uring;	// made by the loop itself on its first IO Uring pair
+	bool uringfailed;
+#endif
+};
+
+// one listener shared by the tunnels with Virtual Hosts on the same proxy address, main loop only
+struct _VhostListener
+{
+	_VhostListener()
+	{
+		memset(ip, 0, sizeof(ip));
+		port = -1;
+		addrlen = 0;
+		listener = NULL;
+		unmatched = 0;
+	}
+
+	char ip[HOST_NAME_LEN];	// of the tunnel that bound it, for the logs and metrics
+	int port;
+	struct sockaddr_storage addr;
+	int addrlen;
+	struct evconnlistener* listener;
+	std::vector<_TunnelsInfo*> vTunnels;
+	std::vector<_VhostPeek*> vPeeks;
+	unsigned long long unmatched;	// clients no tunnel took
+};
+
+struct _AcceptInfo
+{
+	evutil_socket_t fd;
+	_TunnelsInfo* tunnelinfo;
+	_RelayWorker* worker;
+};
+
+// in tunnel.cpp, for the relay paths of the other files
+_RelayWorker* le_getworker();
+_RelayWorker* le_getworker(struct event_base* evbase);
+std::vector<_RelayPair*>& le_pairlist(struct event_base* evbase);
+_RelayPair* le_pairnew(struct event_base* evbase, _TunnelsInfo* tunnelinfo);
+void le_pairstart(_RelayPair* pair);
+void le_pairshutdown(_RelayPair* pair, struct bufferevent* bev);
+void le_pairclose(_RelayPair* pair);
+unsigned int le_clienthash(const struct sockaddr* sa);
+bool le_getlocaladdr(_TunnelsInfo* tunnelinfo, struct sockaddr_storage* ss, int* socklen, unsigned int clienthash = 0);
+evutil_socket_t le_socket(const struct sockaddr* sa, const _SockOpts* opts);
+struct bufferevent* le_connect(struct event_base* evbase, const struct sockaddr* sa, int socklen, bool threadsafe = false, const _SockOpts* opts = NULL);
+bufferevent* le_poolget(struct event_base* evbase, _TunnelsInfo* tunnelinfo);
+bool le_muxstream(_TunnelsInfo* tunnelinfo, evutil_socket_t fd, evutil_socket_t clientfd);
+void le_proxyaddrs(evutil_socket_t fd, _MuxOpen* open);
+void le_proxyheader(struct bufferevent* bev, const _MuxOpen* open);
+void le_setsockopts(evutil_socket_t fd, const _SockOpts& opts);
+bool le_ratelocked(_TunnelsInfo* tunnelinfo);
+bool le_talkerkey(evutil_socket_t fd, std::string& key);
+unsigned long long le_nowusec();
+void le_breakerresult(_TunnelsInfo* tunnelinfo, bool connected);
+void le_statsconnected(_TunnelsInfo* tunnelinfo, unsigned long long startusec);
+#ifndef _WIN32
+void le_retiretunnels();
+#endif
+
+extern struct event_base* base;
+extern std::vector<_TunnelsInfo*> vTunnels;
+extern std::vector<_TunnelsInfo*> vRetired;
+extern std::unordered_map<std::string, _TunnelsInfo*> mTunnelNames;
+extern std::vector<_VhostListener*> vVhosts;
+extern std::vector<_RelayWorker*> vWorkers;
+extern _DISPATCH_TYPE workerdispatch;
+extern long long bufferbudget;
+extern std::atomic<long long> bufferedbytes;
+
+#endif
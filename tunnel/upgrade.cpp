@@ -0,0 +1,615 @@
+#include "upgrade.h"
+
+#ifndef _WIN32
+#define UPGRADE_MAGIC 0x55474E54
+#define UPGRADE_TIMEOUT_SEC 10	// a stalled peer holds neither process longer than this
+#define UPGRADE_DRAIN_MSEC 1000
+#define UPGRADE_PAIRS 0x01	// _HELLO, the new process takes the established pairs too
+#define UPGRADE_PROXYEOF 0x01	// _PAIR
+#define UPGRADE_LOCALEOF 0x02
+#define UPGRADE_PROXYSHUT 0x04
+#define UPGRADE_LOCALSHUT 0x08
+
+enum class _UPGRADE_TYPE : unsigned char
+{
+	_HELLO,
+	_LISTENER,
+	_PAIR,
+	_DONE
+};
+
+// one message on the upgrade socket, its fds ride along as SCM_RIGHTS and the unsent bytes of a pair follow it
+struct _UpgradeMsg
+{
+	unsigned int magic;
+	_UPGRADE_TYPE type;
+	_UPGRADE_FD kind;	// of a listener
+	unsigned char flags;
+	unsigned char fds;
+	char name[64];	// of the tunnel, _TunnelsInfo::name isn't always terminated
+	unsigned int len[2];	// bytes still to write to the proxy side and to the local side
+};
+
+// a socket handed over by the old process, taken by its tunnel on start
+struct _UpgradeFd
+{
+	std::string name;
+	_UPGRADE_FD kind;
+	evutil_socket_t fd;
+};
+
+// an established pair handed over by the old process, index 0 is the proxy side
+struct _UpgradePair
+{
+	std::string name;
+	_TunnelsInfo* tunnelinfo;
+	_RelayWorker* worker;
+	evutil_socket_t fd[2];
+	unsigned char flags;
+	struct evbuffer* data[2];
+};
+
+std::string upgradepath;
+static evutil_socket_t upgradefd = -1;	// listening for the next binary
+static struct event* upgradeev = NULL;
+static evutil_socket_t upgradeconn = -1;	// to the new process while the loops hand over their pairs
+static std::mutex upgradelock;	// upgradeconn, each pair goes out whole
+static std::atomic<int> upgradeloops(0);
+static std::atomic<bool> upgradefailed(false);
+static struct event* upgradetimer = NULL;
+static bool upgraded = false;	// handed over, the socket path belongs to the new process now
+static std::vector<_UpgradeFd> vUpgradeFds;
+static std::vector<_UpgradePair*> vUpgradePairs;
+
+struct _UpgradePair;
+static void le_upgradeaccept_cb(evutil_socket_t, short, void*);
+static void le_upgradepairs_cb(evutil_socket_t, short, void*);
+static void le_upgradedone();
+static void le_upgradedrain_cb(evutil_socket_t, short, void*);
+static void le_upgradeadopt_cb(evutil_socket_t, short, void*);
+
+static bool le_upgradesend(evutil_socket_t fd, _UpgradeMsg* msg, const evutil_socket_t* fds, int count)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int) * 2)];
+	} control;
+	struct iovec iov = { (void*)msg, sizeof(*msg) };
+	struct msghdr mh;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	msg->magic = UPGRADE_MAGIC;
+	msg->fds = (unsigned char)count;
+
+	if (count > 0) {
+		memset(&control, 0, sizeof(control));
+		mh.msg_control = control.buf;
+		mh.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+		struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+		for (int n = 0; n < count; n++) {
+			int sendfd = (int)fds[n];
+			memcpy(CMSG_DATA(cmsg) + n * sizeof(int), &sendfd, sizeof(int));
+		}
+	}
+
+	return sendmsg(fd, &mh, MSG_NOSIGNAL) == (ssize_t)sizeof(*msg);
+}
+
+// a message with up to max fds, extra or unexpected fds are closed
+static bool le_upgraderecv(evutil_socket_t fd, _UpgradeMsg* msg, evutil_socket_t* fds, int max)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int) * 2)];
+	} control;
+	struct iovec iov = { (void*)msg, sizeof(*msg) };
+	struct msghdr mh;
+	int count = 0;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = control.buf;
+	mh.msg_controllen = sizeof(control.buf);
+
+	ssize_t len = recvmsg(fd, &mh, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+	if (len > 0) {
+		for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+			for (size_t n = 0; n < (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int); n++) {
+				int recvfd;
+				memcpy(&recvfd, CMSG_DATA(cmsg) + n * sizeof(int), sizeof(int));
+				if (count < max)
+					fds[count++] = recvfd;
+				else
+					close(recvfd);
+			}
+		}
+	}
+
+	if (len != (ssize_t)sizeof(*msg) || msg->magic != UPGRADE_MAGIC || msg->fds != count) {
+		for (int n = 0; n < count; n++)
+			close(fds[n]);
+		return false;
+	}
+
+	msg->name[sizeof(msg->name) - 1] = 0;
+	return true;
+}
+
+static bool le_upgradewrite(evutil_socket_t fd, struct evbuffer* buf)
+{
+	while (evbuffer_get_length(buf) > 0) {
+		struct evbuffer_iovec vec;
+		if (evbuffer_peek(buf, -1, NULL, &vec, 1) < 1)
+			return false;
+		ssize_t len = send(fd, vec.iov_base, vec.iov_len, MSG_NOSIGNAL);
+		if (len <= 0)
+			return false;
+		evbuffer_drain(buf, (size_t)len);
+	}
+	return true;
+}
+
+static bool le_upgraderead(evutil_socket_t fd, struct evbuffer* buf, size_t len)
+{
+	while (len > 0) {
+		int read = evbuffer_read(buf, fd, (int)std::min(len, (size_t)65536));
+		if (read <= 0)
+			return false;
+		len -= (size_t)read;
+	}
+	return true;
+}
+
+// the socket the next binary connects to, made again by every process that takes over
+bool le_upgradelisten()
+{
+	struct sockaddr_un sun;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (upgradepath.size() >= sizeof(sun.sun_path)) {
+		msglog(eMSGTYPE::ERROR, "Upgrade Socket %s is too long, %s (%d).", upgradepath.c_str(), __func__, __LINE__);
+		return false;
+	}
+	memcpy(sun.sun_path, upgradepath.c_str(), upgradepath.size());
+
+	upgradefd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (upgradefd == -1)
+		return false;
+
+	// the path of the process handed over from is taken over too
+	unlink(upgradepath.c_str());
+	if (bind(upgradefd, (struct sockaddr*)&sun, sizeof(sun)) != 0 || listen(upgradefd, 1) != 0) {
+		msglog(eMSGTYPE::ERROR, "Upgrade Socket %s can't be bound, %s (%d).", upgradepath.c_str(), __func__, __LINE__);
+		close(upgradefd);
+		upgradefd = -1;
+		return false;
+	}
+
+	evutil_make_socket_nonblocking(upgradefd);
+	upgradeev = event_new(base, upgradefd, EV_READ | EV_PERSIST, le_upgradeaccept_cb, NULL);
+	event_add(upgradeev, NULL);
+	msglog(eMSGTYPE::DEBUG, "Upgrade socket is %s.", upgradepath.c_str());
+	return true;
+}
+
+void le_upgradestop()
+{
+	if (upgradetimer)
+		event_free(upgradetimer);
+	upgradetimer = NULL;
+
+	if (upgradeev)
+		event_free(upgradeev);
+	upgradeev = NULL;
+
+	if (upgradefd != -1) {
+		close(upgradefd);
+		if (!upgraded)
+			unlink(upgradepath.c_str());
+	}
+	upgradefd = -1;
+}
+
+static bool le_upgradelistener(evutil_socket_t conn, _TunnelsInfo* tunnelinfo, _UPGRADE_FD kind, evutil_socket_t fd)
+{
+	_UpgradeMsg msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = _UPGRADE_TYPE::_LISTENER;
+	msg.kind = kind;
+	memcpy(msg.name, tunnelinfo->name, sizeof(tunnelinfo->name));
+	return le_upgradesend(conn, &msg, &fd, 1);
+}
+
+// a new binary connected, it gets every listening socket and when it asks the established pairs too,
+// this process then only drains what it kept and exits
+static void le_upgradeaccept_cb(evutil_socket_t fd, short, void*)
+{
+	_UpgradeMsg msg;
+	struct timeval tv = { UPGRADE_TIMEOUT_SEC, 0 };
+
+	evutil_socket_t conn = accept(fd, NULL, NULL);
+	if (conn == -1)
+		return;
+
+	setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+	setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof(tv));
+
+	if (!le_upgraderecv(conn, &msg, NULL, 0) || msg.type != _UPGRADE_TYPE::_HELLO) {
+		msglog(eMSGTYPE::ERROR, "Upgrade socket peer is not a tunnel, %s (%d).", __func__, __LINE__);
+		close(conn);
+		return;
+	}
+
+	msglog(eMSGTYPE::INFO, "Handing the listeners%s over to a new process.", (msg.flags & UPGRADE_PAIRS) ? " and pairs" : "");
+
+	for (size_t n = 0; n < vTunnels.size(); n++) {
+		_TunnelsInfo* tunnelinfo = vTunnels[n];
+		bool sent = true;
+
+		if (tunnelinfo->proxy_listener)
+			sent = sent && le_upgradelistener(conn, tunnelinfo, _UPGRADE_FD::_PROXY, evconnlistener_get_fd(tunnelinfo->proxy_listener));
+		for (size_t i = 0; i < tunnelinfo->vShardListeners.size(); i++)
+			sent = sent && le_upgradelistener(conn, tunnelinfo, _UPGRADE_FD::_PROXY, evconnlistener_get_fd(tunnelinfo->vShardListeners[i]));
+		if (tunnelinfo->link_listener)
+			sent = sent && le_upgradelistener(conn, tunnelinfo, _UPGRADE_FD::_LINK, evconnlistener_get_fd(tunnelinfo->link_listener));
+		if (tunnelinfo->udpfd != -1)
+			sent = sent && le_upgradelistener(conn, tunnelinfo, _UPGRADE_FD::_UDP, tunnelinfo->udpfd);
+
+		// the new process binds what it didn't get, a listener both have open is harmless
+		if (!sent) {
+			msglog(eMSGTYPE::ERROR, "Handing over failed, this process keeps running, %s (%d).", __func__, __LINE__);
+			close(conn);
+			return;
+		}
+	}
+
+	for (size_t n = 0; n < vVhosts.size(); n++) {
+		if (!le_upgradelistener(conn, vVhosts[n]->vTunnels[0], _UPGRADE_FD::_VHOST, evconnlistener_get_fd(vVhosts[n]->listener))) {
+			msglog(eMSGTYPE::ERROR, "Handing over failed, this process keeps running, %s (%d).", __func__, __LINE__);
+			close(conn);
+			return;
+		}
+	}
+
+	// the new process accepts from here on
+	le_retiretunnels();
+
+	event_free(upgradeev);
+	upgradeev = NULL;
+	close(upgradefd);
+	upgradefd = -1;
+	upgraded = true;
+
+	upgradeconn = conn;
+	upgradefailed = false;
+
+	if (msg.flags & UPGRADE_PAIRS) {
+		upgradeloops = (vWorkers.size() > 0) ? (int)vWorkers.size() : 1;
+		if (vWorkers.size() == 0)
+			le_upgradepairs_cb(-1, 0, (void*)base);
+		for (size_t n = 0; n < vWorkers.size(); n++) {
+			if (event_base_once(vWorkers[n]->base, -1, EV_TIMEOUT, le_upgradepairs_cb, (void*)vWorkers[n]->base, NULL) == -1 && --upgradeloops == 0)
+				le_upgradedone();
+		}
+	}
+	else
+		le_upgradedone();
+
+	struct timeval drain = { UPGRADE_DRAIN_MSEC / 1000, (UPGRADE_DRAIN_MSEC % 1000) * 1000 };
+	upgradetimer = event_new(base, -1, EV_PERSIST, le_upgradedrain_cb, NULL);
+	event_add(upgradetimer, &drain);
+}
+
+// whatever a loop read and did not forward yet goes after the unsent bytes of the other side
+static bool le_upgradepair(_RelayPair* pair)
+{
+	_UpgradeMsg msg;
+	struct evbuffer* data[2] = { evbuffer_new(), evbuffer_new() };
+	evutil_socket_t fds[2] = { bufferevent_getfd(pair->proxy_bev), bufferevent_getfd(pair->local_bev) };
+	bool sent = false;
+
+	evbuffer_add_buffer(data[0], bufferevent_get_output(pair->proxy_bev));
+	evbuffer_add_buffer(data[0], bufferevent_get_input(pair->local_bev));
+	evbuffer_add_buffer(data[1], bufferevent_get_output(pair->local_bev));
+	evbuffer_add_buffer(data[1], bufferevent_get_input(pair->proxy_bev));
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = _UPGRADE_TYPE::_PAIR;
+	memcpy(msg.name, pair->tunnelinfo->name, sizeof(pair->tunnelinfo->name));
+	msg.flags = (pair->proxyeof ? UPGRADE_PROXYEOF : 0) | (pair->localeof ? UPGRADE_LOCALEOF : 0)
+		| (pair->proxyshut ? UPGRADE_PROXYSHUT : 0) | (pair->localshut ? UPGRADE_LOCALSHUT : 0);
+	msg.len[0] = (unsigned int)evbuffer_get_length(data[0]);
+	msg.len[1] = (unsigned int)evbuffer_get_length(data[1]);
+
+	{
+		std::lock_guard<std::mutex> lock(upgradelock);
+		if (upgradeconn != -1 && !upgradefailed) {
+			sent = le_upgradesend(upgradeconn, &msg, fds, 2) && le_upgradewrite(upgradeconn, data[0]) && le_upgradewrite(upgradeconn, data[1]);
+			upgradefailed = !sent;
+		}
+	}
+
+	evbuffer_free(data[0]);
+	evbuffer_free(data[1]);
+	return sent;
+}
+
+// on each loop, its pairs go to the new process and its copies of the sockets are closed
+static void le_upgradepairs_cb(evutil_socket_t, short, void* arg)
+{
+	std::vector<_RelayPair*> vPairs = le_pairlist((struct event_base*)arg);
+	int handed = 0;
+
+	for (size_t n = 0; n < vPairs.size() && !upgradefailed; n++) {
+		_RelayPair* pair = vPairs[n];
+
+		// its redirects live in the maps of this process
+		if (pair->sockmap != NULL)
+			continue;
+
+		// a pair cut off halfway has lost bytes to the upgrade socket
+		if (le_upgradepair(pair))
+			handed++;
+		else
+			pair->tunnelinfo->stats.errors++;
+		le_pairclose(pair);
+	}
+
+	if (handed > 0)
+		msglog(eMSGTYPE::DEBUG, "%d pairs handed over.", handed);
+
+	if (--upgradeloops == 0)
+		le_upgradedone();
+}
+
+static void le_upgradedone()
+{
+	std::lock_guard<std::mutex> lock(upgradelock);
+	_UpgradeMsg msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = _UPGRADE_TYPE::_DONE;
+	if (upgradefailed || !le_upgradesend(upgradeconn, &msg, NULL, 0))
+		msglog(eMSGTYPE::ERROR, "Handing over the pairs failed, the rest drain here, %s (%d).", __func__, __LINE__);
+
+	close(upgradeconn);
+	upgradeconn = -1;
+}
+
+// handed over, the process exits once the pairs it kept are closed
+static void le_upgradedrain_cb(evutil_socket_t, short, void*)
+{
+	long long pairs = 0;
+
+	for (size_t n = 0; n < vRetired.size(); n++)
+		pairs += vRetired[n]->stats.activepairs;
+
+	if (pairs == 0 && upgradeloops == 0) {
+		msglog(eMSGTYPE::INFO, "Handed over and drained, exiting.");
+		event_base_loopbreak(base);
+	}
+}
+
+// at startup, takes the listeners and maybe the pairs of the process listening on the upgrade socket, if any
+void le_upgradereceive(bool pairs)
+{
+	struct sockaddr_un sun;
+	struct timeval tv = { UPGRADE_TIMEOUT_SEC, 0 };
+	_UpgradeMsg msg;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (upgradepath.size() >= sizeof(sun.sun_path))
+		return;
+	memcpy(sun.sun_path, upgradepath.c_str(), upgradepath.size());
+
+	evutil_socket_t conn = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (conn == -1)
+		return;
+
+	// nobody to take over from, a fresh start
+	if (connect(conn, (struct sockaddr*)&sun, sizeof(sun)) != 0) {
+		close(conn);
+		return;
+	}
+
+	setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+	setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof(tv));
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = _UPGRADE_TYPE::_HELLO;
+	msg.flags = pairs ? UPGRADE_PAIRS : 0;
+	if (!le_upgradesend(conn, &msg, NULL, 0)) {
+		close(conn);
+		return;
+	}
+
+	msglog(eMSGTYPE::INFO, "Taking over from the process at %s.", upgradepath.c_str());
+
+	while (true) {
+		evutil_socket_t fds[2] = { -1, -1 };
+
+		if (!le_upgraderecv(conn, &msg, fds, 2)) {
+			msglog(eMSGTYPE::ERROR, "Upgrade socket closed before the hand over was done, %s (%d).", __func__, __LINE__);
+			break;
+		}
+
+		if (msg.type == _UPGRADE_TYPE::_DONE)
+			break;
+
+		if (msg.type == _UPGRADE_TYPE::_LISTENER && msg.fds == 1) {
+			_UpgradeFd upgradefd;
+			upgradefd.name = msg.name;
+			upgradefd.kind = msg.kind;
+			upgradefd.fd = fds[0];
+			vUpgradeFds.push_back(upgradefd);
+			continue;
+		}
+
+		if (msg.type != _UPGRADE_TYPE::_PAIR || msg.fds != 2) {
+			for (int n = 0; n < msg.fds; n++)
+				close(fds[n]);
+			continue;
+		}
+
+		_UpgradePair* up = new _UpgradePair;
+		up->name = msg.name;
+		up->tunnelinfo = NULL;
+		up->worker = NULL;
+		up->flags = msg.flags;
+		bool read = true;
+		for (int n = 0; n < 2; n++) {
+			up->fd[n] = fds[n];
+			up->data[n] = evbuffer_new();
+			read = read && le_upgraderead(conn, up->data[n], msg.len[n]);
+		}
+
+		if (!read) {
+			msglog(eMSGTYPE::ERROR, "Upgrade socket closed in the middle of a pair, %s (%d).", __func__, __LINE__);
+			for (int n = 0; n < 2; n++) {
+				close(up->fd[n]);
+				evbuffer_free(up->data[n]);
+			}
+			delete up;
+			break;
+		}
+		vUpgradePairs.push_back(up);
+	}
+
+	close(conn);
+	msglog(eMSGTYPE::INFO, "Took over %d listeners and %d pairs.", (int)vUpgradeFds.size(), (int)vUpgradePairs.size());
+}
+
+// a handed over socket of the tunnel still bound to sa, -1 when there's none and the tunnel binds its own
+evutil_socket_t le_upgradetake(_TunnelsInfo* tunnelinfo, _UPGRADE_FD kind, const struct sockaddr* sa)
+{
+	for (size_t n = 0; n < vUpgradeFds.size(); n++) {
+		if (vUpgradeFds[n].kind != kind || (kind != _UPGRADE_FD::_VHOST
+			&& strncmp(vUpgradeFds[n].name.c_str(), tunnelinfo->name, sizeof(tunnelinfo->name)) != 0))
+			continue;
+
+		struct sockaddr_storage ss;
+		socklen_t sslen = sizeof(ss);
+		evutil_socket_t fd = vUpgradeFds[n].fd;
+
+		// a changed proxy address binds anew, the old socket is closed with the leftovers
+		if (getsockname(fd, (struct sockaddr*)&ss, &sslen) != 0 || evutil_sockaddr_cmp((struct sockaddr*)&ss, sa, 1) != 0)
+			continue;
+
+		vUpgradeFds.erase(vUpgradeFds.begin() + n);
+		evutil_make_socket_nonblocking(fd);
+		return fd;
+	}
+	return -1;
+}
+
+// after the tunnels started, the handed over pairs go to the relay loops and unclaimed sockets are closed
+void le_upgradeadopt()
+{
+	for (size_t n = 0; n < vUpgradeFds.size(); n++) {
+		msglog(eMSGTYPE::INFO, "%s Handed over socket is not used, closed.", vUpgradeFds[n].name.c_str());
+		close(vUpgradeFds[n].fd);
+	}
+	vUpgradeFds.clear();
+
+	for (size_t n = 0; n < vUpgradePairs.size(); n++) {
+		_UpgradePair* up = vUpgradePairs[n];
+
+		std::unordered_map<std::string, _TunnelsInfo*>::iterator iter = mTunnelNames.find(up->name);
+		if (iter != mTunnelNames.end())
+			up->tunnelinfo = iter->second;
+
+		// streams of a link and UDP flows are never handed over, a tunnel changed to one drops the pair
+		if (up->tunnelinfo == NULL || up->tunnelinfo->linkmode != _LINK_MODE::_NONE || up->tunnelinfo->udp) {
+			msglog(eMSGTYPE::INFO, "%s Handed over pair has no tunnel, closed.", up->name.c_str());
+			for (int i = 0; i < 2; i++) {
+				close(up->fd[i]);
+				evbuffer_free(up->data[i]);
+			}
+			delete up;
+			continue;
+		}
+
+		if (vWorkers.size() == 0) {
+			le_upgradeadopt_cb(-1, 0, (void*)up);
+			continue;
+		}
+
+		up->worker = le_getworker();
+		up->worker->connections++;
+		event_base_once(up->worker->base, -1, EV_TIMEOUT, le_upgradeadopt_cb, (void*)up, NULL);
+	}
+	vUpgradePairs.clear();
+}
+
+// a handed over pair continues on this loop as if it had been accepted here
+static void le_upgradeadopt_cb(evutil_socket_t, short, void* arg)
+{
+	_UpgradePair* up = (_UpgradePair*)arg;
+	_TunnelsInfo* tunnelinfo = up->tunnelinfo;
+	struct event_base* evbase = (up->worker != NULL) ? up->worker->base : base;
+	int options = BEV_OPT_CLOSE_ON_FREE | (le_ratelocked(tunnelinfo) ? BEV_OPT_THREADSAFE : 0);
+	struct bufferevent* bev[2];
+
+	for (int n = 0; n < 2; n++) {
+		evutil_make_socket_nonblocking(up->fd[n]);
+		bev[n] = bufferevent_socket_new(evbase, up->fd[n], options);
+	}
+
+	if (bev[0] == NULL || bev[1] == NULL) {
+		msglog(eMSGTYPE::ERROR, "%s bufferevent_socket_new failed, %s (%d).", tunnelinfo->name, __func__, __LINE__);
+		for (int n = 0; n < 2; n++) {
+			if (bev[n] != NULL)
+				bufferevent_free(bev[n]);
+			else
+				close(up->fd[n]);
+			evbuffer_free(up->data[n]);
+		}
+		if (up->worker != NULL)
+			up->worker->connections--;
+		delete up;
+		return;
+	}
+
+	// the unsent bytes go out first, the pair isn't given to a sockmap while they are queued
+	size_t unsent = evbuffer_get_length(up->data[0]) + evbuffer_get_length(up->data[1]);
+	evbuffer_add_buffer(bufferevent_get_output(bev[0]), up->data[0]);
+	evbuffer_add_buffer(bufferevent_get_output(bev[1]), up->data[1]);
+	evbuffer_free(up->data[0]);
+	evbuffer_free(up->data[1]);
+
+	_RelayPair* pair = le_pairnew(evbase, tunnelinfo);
+	pair->proxy_bev = bev[0];
+	pair->local_bev = bev[1];
+	pair->proxyeof = (up->flags & UPGRADE_PROXYEOF) != 0;
+	pair->localeof = (up->flags & UPGRADE_LOCALEOF) != 0;
+	pair->proxyshut = (up->flags & UPGRADE_PROXYSHUT) != 0;
+	pair->localshut = (up->flags & UPGRADE_LOCALSHUT) != 0;
+	if (tunnelinfo->talkers != NULL)
+		le_talkerkey(up->fd[0], pair->talkerkey);
+
+	le_pairstart(pair);
+
+	// queued before le_pairstart added the budget callbacks
+	if (bufferbudget > 0)
+		bufferedbytes += (long long)unsent;
+
+	// a side that read its EOF reads no more
+	if (pair->proxyeof)
+		bufferevent_disable(bev[0], EV_READ);
+	if (pair->localeof)
+		bufferevent_disable(bev[1], EV_READ);
+
+	delete up;
+}
+#endif
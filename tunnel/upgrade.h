@@ -0,0 +1,28 @@
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+#include "tunnel.h"
+
+// the binary upgrade through the Upgrade Socket. the running process hands its listeners, and with
+// Upgrade Pairs its established pairs, to the new one over a unix socket and drains what is left
+
+#ifndef _WIN32
+extern std::string upgradepath;	// Upgrade Socket, empty without one
+
+// the sockets the new process takes over from the old one
+enum class _UPGRADE_FD : unsigned char
+{
+	_PROXY,
+	_LINK,
+	_UDP,
+	_VHOST	// shared by several tunnels, taken by address only
+};
+
+bool le_upgradelisten();	// the socket the next binary connects to
+void le_upgradestop();
+void le_upgradereceive(bool pairs);	// from the running process, before the tunnels start
+evutil_socket_t le_upgradetake(_TunnelsInfo* tunnelinfo, _UPGRADE_FD kind, const struct sockaddr* sa);	// -1 when none was handed over
+void le_upgradeadopt();	// the pairs handed over, once the tunnels are up
+#endif
+
+#endif
@@ -0,0 +1,637 @@
+#include "uring.h"
+
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+struct _UringPair;
+
+#define URING_ENTRIES 1024
+#define URING_BUF_SIZE 16384
+#define URING_BUF_COUNT 512	// received and not yet sent chunks of all pairs of a loop, a power of two
+#define URING_MAX_CHAIN 16	// sends of one direction linked into a single chain
+#define URING_BUF_GROUP 0
+
+enum class _URING_OP
+{
+	_RECV0,
+	_RECV1,
+	_SEND0,
+	_SEND1,
+	_CONNECT,
+};
+
+// one ring per relay loop, made by the loop on its first pair. receives take their buffer from a
+// provided buffer ring, completions wake the loop through an eventfd and everything queued while the
+// loop runs its callbacks goes to the kernel with one io_uring_enter
+struct _UringLoop
+{
+	_UringLoop()
+	{
+		fd = -1;
+		efd = -1;
+		ev = NULL;
+		flushev = NULL;
+		sqptr = NULL;
+		sqptrsize = 0;
+		cqptr = NULL;
+		cqptrsize = 0;
+		sqes = NULL;
+		sqessize = 0;
+		sqtail = 0;
+		queued = 0;
+		bufring = NULL;
+		bufringsize = 0;
+		bufs = NULL;
+		buftail = 0;
+	}
+
+	int fd;
+	int efd;
+	struct event* ev;
+	struct event* flushev;
+	void* sqptr;
+	size_t sqptrsize;
+	void* cqptr;	// the same mapping as sqptr on kernels with IORING_FEAT_SINGLE_MMAP
+	size_t cqptrsize;
+	unsigned* sqhead;
+	unsigned* sqktail;
+	unsigned sqmask;
+	unsigned sqentries;
+	unsigned* sqarray;
+	struct io_uring_sqe* sqes;
+	size_t sqessize;
+	unsigned sqtail;	// ours, published to sqktail on submit
+	unsigned queued;
+	unsigned* cqhead;
+	unsigned* cqtail;
+	unsigned cqmask;
+	struct io_uring_cqe* cqes;
+	struct io_uring_buf* bufring;	// struct io_uring_buf_ring, its tail is the resv of the first entry
+	size_t bufringsize;
+	unsigned char* bufs;
+	unsigned short buftail;
+	std::vector<std::pair<_UringPair*, int>> vStarved;	// receives stopped for want of a buffer
+};
+
+struct _UringChunk
+{
+	unsigned short bid;
+	unsigned int len;
+};
+
+// relay pair forwarded through io_uring, dir 0 is client to local server
+struct _UringPair
+{
+	_UringPair()
+	{
+		ring = NULL;
+		tunnelinfo = NULL;
+		connectstart = 0;
+		activetick = 0;
+		inflight = 0;
+		closing = false;
+		addrlen = 0;
+		timer = NULL;
+		for (int n = 0; n < 2; n++) {
+			fd[n] = -1;
+			eof[n] = false;
+			recving[n] = false;
+			sending[n] = 0;
+			sendtick[n] = 0;
+		}
+	}
+
+	_UringLoop* ring;
+	_TunnelsInfo* tunnelinfo;
+	unsigned long long connectstart;
+	unsigned long long activetick;
+	evutil_socket_t fd[2];
+	bool eof[2];
+	bool recving[2];	// a multishot receive is armed
+	int sending[2];	// sends of the chain in flight
+	unsigned long long sendtick[2];	// when that chain went out
+	std::deque<_UringChunk> queue[2];	// received, waiting for the chain in flight
+	int inflight;	// requests the kernel still holds, the pair is freed at 0 once closing
+	bool closing;
+	struct sockaddr_storage addr;	// of the local server, read by the connect
+	int addrlen;
+	struct event* timer;
+};
+
+static _UringLoop* mainuring = NULL;
+static bool mainuringfailed = false;
+static std::atomic<bool> uringwarned(false);
+
+static _UringLoop* le_uringnew(struct event_base* evbase);
+static void le_uringcb(evutil_socket_t, short, void*);
+static void le_uringflush_cb(evutil_socket_t, short, void*);
+static void le_uringrecv(_UringPair* pair, int dir);
+static void le_uringsend(_UringPair* pair, int dir);
+static void le_uringcomplete(_UringLoop* ring, const struct io_uring_cqe* cqe);
+static void le_uringtimer_cb(evutil_socket_t, short, void*);
+static void le_uringclose(_UringPair* pair);
+static void le_uringpairfree(_UringPair* pair);
+
+static int le_uringenter(int fd, unsigned submit)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, submit, 0, 0, NULL, 0);
+}
+
+// multishot receives need 6.0, an older kernel or a ring refused by seccomp keeps the bufferevent relay
+static bool le_uringsupported()
+{
+	struct utsname un;
+	int major = 0;
+
+	if (uname(&un) != 0 || sscanf(un.release, "%d", &major) != 1)
+		return false;
+	return major >= 6;
+}
+
+// the ring of the loop of evbase, NULL when the kernel has none for it
+_UringLoop* le_uringloop(struct event_base* evbase)
+{
+	_RelayWorker* worker = le_getworker(evbase);
+	_UringLoop** ring = (worker != NULL) ? &worker->uring : &mainuring;
+	bool* failed = (worker != NULL) ? &worker->uringfailed : &mainuringfailed;
+
+	if (*ring == NULL && !*failed) {
+		*ring = le_uringnew(evbase);
+		*failed = (*ring == NULL);
+		if (*failed && !uringwarned.exchange(true)) {
+			msglog(eMSGTYPE::INFO, "io_uring is not available, IO Uring tunnels relay through bufferevents.");
+		}
+	}
+	return *ring;
+}
+
+static _UringLoop* le_uringnew(struct event_base* evbase)
+{
+	if (!le_uringsupported())
+		return NULL;
+
+	_UringLoop* ring = new _UringLoop;
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+	ring->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+	if (ring->fd < 0) {
+		ring->fd = -1;
+		le_uringfree(ring);
+		return NULL;
+	}
+
+	ring->sqptrsize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cqptrsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->sqptrsize = ring->cqptrsize = std::max(ring->sqptrsize, ring->cqptrsize);
+
+	ring->sqptr = mmap(NULL, ring->sqptrsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sqptr == MAP_FAILED) {
+		ring->sqptr = NULL;
+		le_uringfree(ring);
+		return NULL;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cqptr = ring->sqptr;
+	else {
+		ring->cqptr = mmap(NULL, ring->cqptrsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cqptr == MAP_FAILED) {
+			ring->cqptr = NULL;
+			le_uringfree(ring);
+			return NULL;
+		}
+	}
+
+	ring->sqessize = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		le_uringfree(ring);
+		return NULL;
+	}
+
+	unsigned char* sq = (unsigned char*)ring->sqptr;
+	unsigned char* cq = (unsigned char*)ring->cqptr;
+	ring->sqhead = (unsigned*)(sq + p.sq_off.head);
+	ring->sqktail = (unsigned*)(sq + p.sq_off.tail);
+	ring->sqmask = *(unsigned*)(sq + p.sq_off.ring_mask);
+	ring->sqentries = p.sq_entries;
+	ring->sqarray = (unsigned*)(sq + p.sq_off.array);
+	ring->sqtail = *ring->sqktail;
+	ring->cqhead = (unsigned*)(cq + p.cq_off.head);
+	ring->cqtail = (unsigned*)(cq + p.cq_off.tail);
+	ring->cqmask = *(unsigned*)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+	// the buffers the receives pick from, handed back once their bytes are sent
+	ring->bufringsize = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+	ring->bufring = (struct io_uring_buf*)mmap(NULL, ring->bufringsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring->bufring == MAP_FAILED) {
+		ring->bufring = NULL;
+		le_uringfree(ring);
+		return NULL;
+	}
+	ring->bufs = new unsigned char[(size_t)URING_BUF_COUNT * URING_BUF_SIZE];
+	for (unsigned short bid = 0; bid < URING_BUF_COUNT; bid++) {
+		struct io_uring_buf* buf = &ring->bufring[ring->buftail & (URING_BUF_COUNT - 1)];
+		buf->addr = (unsigned long long)(uintptr_t)(ring->bufs + (size_t)bid * URING_BUF_SIZE);
+		buf->len = URING_BUF_SIZE;
+		buf->bid = bid;
+		ring->buftail++;
+	}
+	__atomic_store_n(&ring->bufring[0].resv, ring->buftail, __ATOMIC_RELEASE);
+
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long long)(uintptr_t)ring->bufring;
+	reg.ring_entries = URING_BUF_COUNT;
+	reg.bgid = URING_BUF_GROUP;
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+		le_uringfree(ring);
+		return NULL;
+	}
+
+	ring->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ring->efd == -1 || syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_EVENTFD, &ring->efd, 1) != 0) {
+		le_uringfree(ring);
+		return NULL;
+	}
+
+	ring->ev = event_new(evbase, ring->efd, EV_READ | EV_PERSIST, le_uringcb, (void*)ring);
+	ring->flushev = event_new(evbase, -1, 0, le_uringflush_cb, (void*)ring);
+	event_add(ring->ev, NULL);
+
+	msglog(eMSGTYPE::DEBUG, "io_uring ready with %u entries and %d buffers of %d bytes.", p.sq_entries, URING_BUF_COUNT, URING_BUF_SIZE);
+	return ring;
+}
+
+// the pairs still on it are dropped with the process, only at shutdown
+void le_uringfree(_UringLoop* ring)
+{
+	if (ring == NULL)
+		return;
+	if (ring->ev)
+		event_free(ring->ev);
+	if (ring->flushev)
+		event_free(ring->flushev);
+	if (ring->efd != -1)
+		close(ring->efd);
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqessize);
+	if (ring->cqptr && ring->cqptr != ring->sqptr)
+		munmap(ring->cqptr, ring->cqptrsize);
+	if (ring->sqptr)
+		munmap(ring->sqptr, ring->sqptrsize);
+	if (ring->fd != -1)
+		close(ring->fd);
+	if (ring->bufring)
+		munmap(ring->bufring, ring->bufringsize);
+	delete[] ring->bufs;
+	delete ring;
+}
+
+static void le_uringsubmit(_UringLoop* ring)
+{
+	if (ring->queued == 0)
+		return;
+
+	__atomic_store_n(ring->sqktail, ring->sqtail, __ATOMIC_RELEASE);
+	if (le_uringenter(ring->fd, ring->queued) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		msglog(eMSGTYPE::ERROR, "io_uring_enter failed (%d), %s (%d).", errno, __func__, __LINE__);
+	ring->queued = 0;
+}
+
+// a zeroed request, queued for the submit at the end of this loop iteration
+static struct io_uring_sqe* le_uringsqe(_UringLoop* ring)
+{
+	if (ring->sqtail - __atomic_load_n(ring->sqhead, __ATOMIC_ACQUIRE) >= ring->sqentries)
+		le_uringsubmit(ring);
+
+	unsigned index = ring->sqtail & ring->sqmask;
+	struct io_uring_sqe* sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sqarray[index] = index;
+	ring->sqtail++;
+
+	if (ring->queued++ == 0)
+		event_active(ring->flushev, EV_TIMEOUT, 0);
+	return sqe;
+}
+
+static void le_uringflush_cb(evutil_socket_t, short, void* arg)
+{
+	le_uringsubmit((_UringLoop*)arg);
+}
+
+// the bytes of a buffer are out, it goes back to the kernel and a starved receive may go on
+static void le_uringrecycle(_UringLoop* ring, unsigned short bid)
+{
+	struct io_uring_buf* buf = &ring->bufring[ring->buftail & (URING_BUF_COUNT - 1)];
+	buf->addr = (unsigned long long)(uintptr_t)(ring->bufs + (size_t)bid * URING_BUF_SIZE);
+	buf->len = URING_BUF_SIZE;
+	buf->bid = bid;
+	ring->buftail++;
+	__atomic_store_n(&ring->bufring[0].resv, ring->buftail, __ATOMIC_RELEASE);
+
+	if (!ring->vStarved.empty()) {
+		std::pair<_UringPair*, int> starved = ring->vStarved.back();
+		ring->vStarved.pop_back();
+		le_uringrecv(starved.first, starved.second);
+	}
+}
+
+static void le_uringcb(evutil_socket_t fd, short, void* arg)
+{
+	_UringLoop* ring = (_UringLoop*)arg;
+	unsigned long long count;
+
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		return;
+
+	unsigned head = *ring->cqhead;
+	while (head != __atomic_load_n(ring->cqtail, __ATOMIC_ACQUIRE)) {
+		struct io_uring_cqe cqe = ring->cqes[head & ring->cqmask];
+		head++;
+		// handed back first, a completion may queue requests that fill the queue again
+		__atomic_store_n(ring->cqhead, head, __ATOMIC_RELEASE);
+		le_uringcomplete(ring, &cqe);
+	}
+
+	le_uringsubmit(ring);
+}
+
+static inline unsigned long long le_uringdata(_UringPair* pair, _URING_OP op)
+{
+	return (unsigned long long)(uintptr_t)pair | (unsigned long long)op;
+}
+
+bool le_uringstart(struct event_base* evbase, _TunnelsInfo* tunnelinfo, evutil_socket_t fd)
+{
+	_UringPair* pair = new _UringPair;
+	pair->ring = le_uringloop(evbase);
+	pair->tunnelinfo = tunnelinfo;
+	pair->fd[0] = fd;
+	evutil_make_socket_nonblocking(fd);
+
+	unsigned int clienthash = 0;
+	if (tunnelinfo->balance == _BALANCE_TYPE::_CLIENT_HASH) {
+		struct sockaddr_storage ss;
+		ev_socklen_t sslen = sizeof(ss);
+		if (getpeername(fd, (struct sockaddr*)&ss, &sslen) == 0)
+			clienthash = le_clienthash((struct sockaddr*)&ss);
+	}
+
+	if (!le_getlocaladdr(tunnelinfo, &pair->addr, &pair->addrlen, clienthash)) {
+		le_uringpairfree(pair);
+		return false;
+	}
+
+	pair->fd[1] = le_socket((struct sockaddr*)&pair->addr, &tunnelinfo->sockopts);
+	if (pair->fd[1] == -1) {
+		le_uringpairfree(pair);
+		return false;
+	}
+
+	pair->connectstart = le_nowusec();
+	pair->activetick = GetTickCount64();
+	tunnelinfo->stats.activepairs++;
+
+	// client data waits in the socket buffer until the local server is connected
+	struct io_uring_sqe* sqe = le_uringsqe(pair->ring);
+	sqe->opcode = IORING_OP_CONNECT;
+	sqe->fd = pair->fd[1];
+	sqe->addr = (unsigned long long)(uintptr_t)&pair->addr;
+	sqe->off = (unsigned long long)pair->addrlen;
+	sqe->user_data = le_uringdata(pair, _URING_OP::_CONNECT);
+	pair->inflight++;
+
+	if (tunnelinfo->readtimeout > 0 || tunnelinfo->writetimeout > 0) {
+		struct timeval tv = { 1, 0 };
+		pair->timer = event_new(evbase, -1, EV_PERSIST, le_uringtimer_cb, (void*)pair);
+		event_add(pair->timer, &tv);
+	}
+
+	msglog(eMSGTYPE::DEBUG, "%s Client connection accepted, io_uring mode...", tunnelinfo->name);
+	return true;
+}
+
+// one multishot receive per direction, it stays armed until eof, an error or the buffers run out
+static void le_uringrecv(_UringPair* pair, int dir)
+{
+	if (pair->closing || pair->eof[dir] || pair->recving[dir])
+		return;
+
+	struct io_uring_sqe* sqe = le_uringsqe(pair->ring);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = pair->fd[dir];
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUF_GROUP;
+	sqe->user_data = le_uringdata(pair, (dir == 0) ? _URING_OP::_RECV0 : _URING_OP::_RECV1);
+	pair->recving[dir] = true;
+	pair->inflight++;
+}
+
+// everything received for a direction goes out as one chain of linked sends, so the bytes keep their
+// order without waiting for each send. the next chain waits for this one
+static void le_uringsend(_UringPair* pair, int dir)
+{
+	if (pair->closing || pair->sending[dir] > 0 || pair->queue[dir].empty())
+		return;
+
+	size_t count = std::min(pair->queue[dir].size(), (size_t)URING_MAX_CHAIN);
+
+	for (size_t n = 0; n < count; n++) {
+		const _UringChunk& chunk = pair->queue[dir][n];
+		struct io_uring_sqe* sqe = le_uringsqe(pair->ring);
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = pair->fd[1 - dir];
+		sqe->addr = (unsigned long long)(uintptr_t)(pair->ring->bufs + (size_t)chunk.bid * URING_BUF_SIZE);
+		sqe->len = chunk.len;
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;	// a short send breaks the chain
+		sqe->flags = (n + 1 < count) ? IOSQE_IO_LINK : 0;
+		sqe->user_data = le_uringdata(pair, (dir == 0) ? _URING_OP::_SEND0 : _URING_OP::_SEND1);
+		pair->inflight++;
+	}
+
+	pair->sending[dir] = (int)count;
+	pair->sendtick[dir] = GetTickCount64();
+}
+
+// both directions are done once each source hit eof and its bytes are out
+static void le_uringdrained(_UringPair* pair, int dir)
+{
+	if (!pair->eof[dir] || pair->sending[dir] > 0 || !pair->queue[dir].empty())
+		return;
+
+	shutdown(pair->fd[1 - dir], SHUT_WR);
+	if (pair->eof[1 - dir] && pair->sending[1 - dir] == 0 && pair->queue[1 - dir].empty())
+		le_uringclose(pair);
+}
+
+static void le_uringcomplete(_UringLoop* ring, const struct io_uring_cqe* cqe)
+{
+	if (cqe->user_data == 0)
+		return;
+
+	_UringPair* pair = (_UringPair*)(uintptr_t)(cqe->user_data & ~7ULL);
+	_URING_OP op = (_URING_OP)(cqe->user_data & 7ULL);
+	bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+	if (!more)
+		pair->inflight--;
+
+	if (op == _URING_OP::_CONNECT) {
+		if (pair->closing)
+			;
+		else if (cqe->res < 0) {
+			msglog(eMSGTYPE::ERROR, "%s connect to local server failed (%d), %s (%d).", pair->tunnelinfo->name, -cqe->res, __func__, __LINE__);
+			pair->tunnelinfo->stats.errors++;
+			le_breakerresult(pair->tunnelinfo, false);
+			le_uringclose(pair);
+		}
+		else {
+			le_statsconnected(pair->tunnelinfo, pair->connectstart);
+			le_breakerresult(pair->tunnelinfo, true);
+			pair->activetick = GetTickCount64();
+			le_uringrecv(pair, 0);
+			le_uringrecv(pair, 1);
+		}
+	}
+	else if (op == _URING_OP::_RECV0 || op == _URING_OP::_RECV1) {
+		int dir = (op == _URING_OP::_RECV0) ? 0 : 1;
+		if (!more)
+			pair->recving[dir] = false;
+
+		if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+			_UringChunk chunk;
+			chunk.bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+			chunk.len = (unsigned int)cqe->res;
+			if (pair->closing)
+				le_uringrecycle(ring, chunk.bid);
+			else {
+				pair->queue[dir].push_back(chunk);
+				pair->activetick = GetTickCount64();
+				le_uringsend(pair, dir);
+				if (!more)
+					le_uringrecv(pair, dir);
+			}
+		}
+		else if (pair->closing)
+			;
+		else if (cqe->res == -ENOBUFS)
+			ring->vStarved.push_back(std::make_pair(pair, dir));
+		else if (cqe->res == 0) {
+			// half close, the sink gets its FIN once the bytes before it are out
+			pair->eof[dir] = true;
+			le_uringdrained(pair, dir);
+		}
+		else if (!more) {
+			msglog(eMSGTYPE::DEBUG, "Proxy disconnected.");
+			le_uringclose(pair);
+		}
+	}
+	else {
+		int dir = (op == _URING_OP::_SEND0) ? 0 : 1;
+		_UringChunk chunk = pair->queue[dir].front();
+		pair->queue[dir].pop_front();
+		pair->sending[dir]--;
+		le_uringrecycle(ring, chunk.bid);
+
+		if (pair->closing)
+			;
+		else if (cqe->res < (int)chunk.len) {
+			if (cqe->res != -ECANCELED)
+				pair->tunnelinfo->stats.errors++;
+			le_uringclose(pair);
+		}
+		else {
+			if (dir == 0)
+				pair->tunnelinfo->stats.bytesin += cqe->res;
+			else
+				pair->tunnelinfo->stats.bytesout += cqe->res;
+			if (pair->sending[dir] == 0) {
+				le_uringsend(pair, dir);
+				le_uringdrained(pair, dir);
+			}
+		}
+	}
+
+	if (pair->closing && pair->inflight == 0)
+		le_uringpairfree(pair);
+}
+
+static void le_uringtimer_cb(evutil_socket_t, short, void* arg)
+{
+	_UringPair* pair = (_UringPair*)arg;
+	_TunnelsInfo* tunnelinfo = pair->tunnelinfo;
+	unsigned long long now = GetTickCount64();
+
+	if (pair->closing)
+		return;
+
+	if (tunnelinfo->readtimeout > 0 && now - pair->activetick >= (unsigned long long)tunnelinfo->readtimeout * 1000)
+		msglog(eMSGTYPE::DEBUG, "%s Proxy idle timeout.", tunnelinfo->name);
+	else if (tunnelinfo->writetimeout > 0 && ((pair->sending[0] > 0 && now - pair->sendtick[0] >= (unsigned long long)tunnelinfo->writetimeout * 1000)
+		|| (pair->sending[1] > 0 && now - pair->sendtick[1] >= (unsigned long long)tunnelinfo->writetimeout * 1000)))
+		msglog(eMSGTYPE::DEBUG, "%s Proxy write timeout.", tunnelinfo->name);
+	else
+		return;
+
+	le_uringclose(pair);
+	if (pair->inflight == 0)
+		le_uringpairfree(pair);
+}
+
+// the requests still held by the kernel are cancelled, the caller frees the pair once none is left
+static void le_uringclose(_UringPair* pair)
+{
+	if (pair->closing)
+		return;
+	pair->closing = true;
+
+	_RelayWorker* worker = le_getworker(event_get_base(pair->ring->ev));
+	if (worker != NULL)
+		worker->connections--;
+	pair->tunnelinfo->stats.activepairs--;
+
+	std::vector<std::pair<_UringPair*, int>>& vStarved = pair->ring->vStarved;
+	vStarved.erase(std::remove_if(vStarved.begin(), vStarved.end(),
+		[pair](const std::pair<_UringPair*, int>& starved) { return starved.first == pair; }), vStarved.end());
+
+	for (int n = 0; n < 2; n++) {
+		while (!pair->queue[n].empty() && pair->sending[n] == 0) {
+			le_uringrecycle(pair->ring, pair->queue[n].front().bid);
+			pair->queue[n].pop_front();
+		}
+		if (pair->fd[n] == -1)
+			continue;
+		struct io_uring_sqe* sqe = le_uringsqe(pair->ring);
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = pair->fd[n];
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+		sqe->user_data = 0;
+		shutdown(pair->fd[n], SHUT_RDWR);
+	}
+}
+
+static void le_uringpairfree(_UringPair* pair)
+{
+	if (pair->timer)
+		event_free(pair->timer);
+	for (int n = 0; n < 2; n++) {
+		if (pair->fd[n] != -1)
+			evutil_closesocket(pair->fd[n]);
+		while (!pair->queue[n].empty()) {
+			le_uringrecycle(pair->ring, pair->queue[n].front().bid);
+			pair->queue[n].pop_front();
+		}
+	}
+	delete pair;
+}
+
+void le_uringstop()
+{
+	le_uringfree(mainuring);
+	mainuring = NULL;
+}
+#endif
@@ -0,0 +1,17 @@
+#ifndef URING_H
+#define URING_H
+
+#include "tunnel.h"
+
+// the io_uring relay path of IO Uring tunnels, Linux 6.0 and later. each relay loop owns a ring made on
+// its first pair, receives are multishot into a buffer ring shared by the pairs of the loop and each
+// direction goes out as one chain of linked sends
+
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+_UringLoop* le_uringloop(struct event_base* evbase);	// the ring of the loop of evbase, NULL when the kernel has none for it
+bool le_uringstart(struct event_base* evbase, _TunnelsInfo* tunnelinfo, evutil_socket_t fd);
+void le_uringfree(_UringLoop* ring);	// a relay loop's, after the loop returned
+void le_uringstop();	// the main loop's, after the loop returned
+#endif
+
+#endif
@@ -0,0 +1,1035 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 phit666
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+ /** @file tunnel_bench.cpp
+	Relay benchmark, runs the tunnel binary against a local source server for each forwarding mode,
+	optionally across a WAN shim with round trip, jitter, loss and a bandwidth cap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <random>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <event2/event.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/listener.h>
+#include <event2/thread.h>
+
+#define BENCH_SOURCE_PORT 18500
+#define BENCH_PROXY_PORT 18501
+#define BENCH_LINK_PORT 18502
+#define BENCH_SHIM_PORT 18503
+#define BENCH_CHUNK 65536
+#define BENCH_READY_MSEC 5000
+#define BENCH_KEEP (1ULL << 63)	// request flag, the source waits for the next request instead of closing
+#define BENCH_INTERACTIVE_BYTES 1024	// reply of each interactive request
+#define BENCH_INTERACTIVE_MSEC 20	// pause between the requests of an interactive stream
+#define BENCH_SOAK_SAMPLE_MSEC 60000	// a soak line this often
+#define SHIM_SEGMENT 1448	// bytes a loss is rolled for, one TCP segment
+#define SHIM_READ 16384
+#define SHIM_QUEUE (4 * 1024 * 1024)	// bytes a direction holds without a bandwidth cap, its router buffer
+
+struct _BenchConfig
+{
+	std::string tunnel;	// path of the tunnel binary
+	int concurrency;
+	int connections;
+	long long bytes;	// bytes the source sends on each connection
+	int storm;	// connections opened at once, 0 skips the storm
+	int workers;
+	int interactive;	// request and response streams run alongside the bulk phase
+	int soak;	// seconds the bulk phase repeats on the same relay after the storm, 0 skips the soak
+	std::string modes;
+};
+
+// the WAN between the client side and the local side, in the bench process on a loop of its own. a TCP
+// stream cannot lose bytes, a lost segment holds back everything after it for one more round trip like a
+// fast retransmit would
+struct _ShimConfig
+{
+	int rttmsec;
+	int jittermsec;	// up to this much more delay on each chunk, a stream is never reordered
+	double loss;	// percent of segments
+	long long kbit;	// per direction, shared by all connections, 0 is uncapped
+};
+
+// one load phase, every connection fetches config bytes through the relay
+struct _BenchRun
+{
+	struct event_base* base;
+	struct sockaddr_in sa;
+	int concurrency;
+	int connections;
+	long long bytes;
+	int launched;
+	int done;
+	int failed;
+	long long received;
+	std::vector<unsigned long long> vLatency;	// usec from connect to the first byte
+	int interactive;
+	int interfailed;
+	std::vector<struct bufferevent*> vInteractive;	// open interactive streams, closed once the bulk is done
+	std::vector<unsigned long long> vRequest;	// usec from an interactive request to the end of its reply
+};
+
+struct _BenchClient
+{
+	_BenchRun* run;
+	unsigned long long start;
+	bool first;
+	long long received;
+};
+
+struct _InteractiveClient
+{
+	_BenchRun* run;
+	struct event* pause;
+	unsigned long long start;
+	long long received;
+};
+
+struct _SourceConn
+{
+	long long left;
+	bool started;
+	bool keep;
+};
+
+struct _ShimConn;
+
+struct _ShimChunk
+{
+	unsigned long long release;	// usec
+	struct evbuffer* data;
+};
+
+// one direction of a shim connection
+struct _ShimPipe
+{
+	_ShimConn* conn;
+	int dir;	// 0 toward the target, 1 back
+	struct bufferevent* from;
+	struct bufferevent* to;
+	std::deque<_ShimChunk> queue;
+	size_t queued;
+	unsigned long long last;	// release of the newest chunk
+	struct event* timer;
+	bool eof;
+};
+
+struct _ShimConn
+{
+	_ShimPipe pipes[2];
+};
+
+static char chunk[BENCH_CHUNK];
+static _ShimConfig shim;
+static bool shimon = false;
+static std::atomic<int> shimtarget(0);	// port the shim forwards to, set by each mode before it starts
+static unsigned long long shimnextfree[2];	// usec the capped wire of each direction is free again
+static size_t shimwindow = SHIM_QUEUE;
+static std::mt19937 shimrandom(1);
+
+static unsigned long long le_nowusec();
+static void le_sourcelistener_cb(struct evconnlistener*, evutil_socket_t, struct sockaddr*, int, void*);
+static void le_sourcereadcb(struct bufferevent*, void*);
+static void le_sourcewritecb(struct bufferevent*, void*);
+static void le_sourceeventcb(struct bufferevent*, short, void*);
+static void le_clientlaunch(_BenchRun* run);
+static void le_clientreadcb(struct bufferevent*, void*);
+static void le_clienteventcb(struct bufferevent*, short, void*);
+static void le_clientdone(struct bufferevent* bev, _BenchClient* client, bool ok);
+static void le_interactivelaunch(_BenchRun* run);
+static void le_interactiverequest(evutil_socket_t, short, void*);
+static void le_interactivereadcb(struct bufferevent*, void*);
+static void le_interactiveeventcb(struct bufferevent*, short, void*);
+static void le_interactivefree(struct bufferevent* bev);
+static void le_shimlistener_cb(struct evconnlistener*, evutil_socket_t, struct sockaddr*, int, void*);
+static void le_shimreadcb(struct bufferevent*, void*);
+static void le_shimwritecb(struct bufferevent*, void*);
+static void le_shimeventcb(struct bufferevent*, short, void*);
+static void le_shimtimer(evutil_socket_t, short, void*);
+static void le_shimflush(_ShimConn* conn);
+static void le_shimfree(_ShimConn* conn);
+static bool le_runload(_BenchRun* run);
+static pid_t le_spawn(const _BenchConfig& config, const std::string& dir, const std::string& yaml);
+static void le_stop(pid_t pid);
+static double le_cpuseconds(pid_t pid);
+static long long le_rsskb(pid_t pid);
+static int le_fds(pid_t pid);
+static bool le_waitrelay();
+static unsigned long long le_percentile(std::vector<unsigned long long>& v, double p);
+static void le_report(const char* mode, const char* phase, _BenchRun* run, unsigned long long usec, double cpu);
+static void le_reportinteractive(const char* mode, _BenchRun* run);
+static bool le_benchmode(const _BenchConfig& config, const std::string& mode, const std::string& dir);
+
+int main(int argc, char* argv[])
+{
+	_BenchConfig config;
+	config.tunnel = "./tunnel";
+	config.concurrency = 32;
+	config.connections = 256;
+	config.bytes = 16 * 1024 * 1024;
+	config.storm = 2000;
+	config.workers = 0;
+	config.interactive = 0;
+	config.soak = 0;
+	config.modes = "plain,splice,mux";
+	memset(&shim, 0, sizeof(shim));
+
+	for (int n = 1; n < argc; n++) {
+		std::string arg = argv[n];
+		const char* value = (n + 1 < argc) ? argv[n + 1] : NULL;
+
+		if (value == NULL) {
+			printf("usage: tunnel_bench [-t tunnel] [-c concurrency] [-n connections] [-b bytes] [-s storm] [-w workers] [-i interactive]\n"
+				"                    [-d soak seconds] [-r rtt msec] [-j jitter msec] [-l loss percent] [-k kbit/s] [-m plain,splice,mux,deflate,multipath]\n");
+			return -1;
+		}
+
+		if (arg == "-t")
+			config.tunnel = value;
+		else if (arg == "-c")
+			config.concurrency = atoi(value);
+		else if (arg == "-n")
+			config.connections = atoi(value);
+		else if (arg == "-b")
+			config.bytes = atoll(value);
+		else if (arg == "-s")
+			config.storm = atoi(value);
+		else if (arg == "-w")
+			config.workers = atoi(value);
+		else if (arg == "-i")
+			config.interactive = atoi(value);
+		else if (arg == "-d")
+			config.soak = atoi(value);
+		else if (arg == "-r")
+			shim.rttmsec = atoi(value);
+		else if (arg == "-j")
+			shim.jittermsec = atoi(value);
+		else if (arg == "-l")
+			shim.loss = atof(value);
+		else if (arg == "-k")
+			shim.kbit = atoll(value);
+		else if (arg == "-m")
+			config.modes = value;
+		n++;
+	}
+
+	if (access(config.tunnel.c_str(), X_OK) != 0) {
+		printf("%s is not executable.\n", config.tunnel.c_str());
+		return -1;
+	}
+	if (config.tunnel[0] != '/') {
+		char cwd[1024];
+		if (getcwd(cwd, sizeof(cwd)) != NULL)
+			config.tunnel = std::string(cwd) + "/" + config.tunnel;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	evthread_use_pthreads();
+	// lowercase letters at random, about what deflate makes of text, a constant would flatter Compression
+	std::mt19937 letters(1);
+	for (size_t n = 0; n < sizeof(chunk); n++)
+		chunk[n] = 'a' + letters() % 26;
+
+	// the source server has its own loop so it doesn't compete with the load generator
+	struct event_base* sourcebase = event_base_new();
+	struct sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(BENCH_SOURCE_PORT);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	struct evconnlistener* listener = evconnlistener_new_bind(sourcebase, le_sourcelistener_cb, NULL,
+		LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, -1, (struct sockaddr*)&sa, sizeof(sa));
+
+	if (listener == NULL) {
+		printf("Source server failed to listen to port %d.\n", BENCH_SOURCE_PORT);
+		return -1;
+	}
+
+	std::thread sourcethread([sourcebase]() { event_base_loop(sourcebase, EVLOOP_NO_EXIT_ON_EMPTY); });
+
+	// the shim gets a loop of its own as well, its timers would lag behind a busy load generator
+	shimon = (shim.rttmsec > 0 || shim.jittermsec > 0 || shim.loss > 0 || shim.kbit > 0);
+	struct event_base* shimbase = NULL;
+	struct evconnlistener* shimlistener = NULL;
+	std::thread shimthread;
+	if (shimon) {
+		// a capped direction holds its bandwidth delay product and a buffer of 64KB on top
+		if (shim.kbit > 0)
+			shimwindow = (size_t)(shim.kbit * 1000 / 8 * (shim.rttmsec + shim.jittermsec) / 1000) + 65536;
+		shimbase = event_base_new();
+		sa.sin_port = htons(BENCH_SHIM_PORT);
+		shimlistener = evconnlistener_new_bind(shimbase, le_shimlistener_cb, NULL,
+			LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, -1, (struct sockaddr*)&sa, sizeof(sa));
+		if (shimlistener == NULL) {
+			printf("WAN shim failed to listen to port %d.\n", BENCH_SHIM_PORT);
+			return -1;
+		}
+		shimthread = std::thread([shimbase]() { event_base_loop(shimbase, EVLOOP_NO_EXIT_ON_EMPTY); });
+		printf("WAN rtt %d ms jitter %d ms loss %.2f%% bandwidth %lld kbit/s, between the client and the local side.\n",
+			shim.rttmsec, shim.jittermsec, shim.loss, shim.kbit);
+	}
+
+	char dirtemplate[] = "/tmp/tunnel_bench.XXXXXX";
+	std::string dir = mkdtemp(dirtemplate) ? dirtemplate : "/tmp";
+
+	printf("%-9s %-6s %10s %10s %10s %10s %10s %8s %8s\n", "mode", "phase", "conns", "Gbit/s", "p50 us", "p99 us", "p999 us", "failed", "cpu s/GB");
+
+	bool ok = true;
+	size_t pos = 0;
+	while (pos <= config.modes.size()) {
+		size_t next = config.modes.find(',', pos);
+		if (next == std::string::npos)
+			next = config.modes.size();
+		std::string mode = config.modes.substr(pos, next - pos);
+		if (mode.size() > 0 && !le_benchmode(config, mode, dir))
+			ok = false;
+		pos = next + 1;
+	}
+
+	if (shimon) {
+		event_base_loopbreak(shimbase);
+		shimthread.join();
+		evconnlistener_free(shimlistener);
+		event_base_free(shimbase);
+	}
+
+	event_base_loopbreak(sourcebase);
+	sourcethread.join();
+	evconnlistener_free(listener);
+	event_base_free(sourcebase);
+
+	return ok ? 0 : -1;
+}
+
+static unsigned long long le_nowusec()
+{
+	struct timeval tv;
+	evutil_gettimeofday(&tv, NULL);
+	return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// the request is the byte count to send as 8 bytes big endian, the reply is that many bytes. with
+// BENCH_KEEP in the count the connection stays open for the next request
+static void le_sourcelistener_cb(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr*, int, void*)
+{
+	struct bufferevent* bev = bufferevent_socket_new(evconnlistener_get_base(listener), fd, BEV_OPT_CLOSE_ON_FREE);
+	_SourceConn* conn = new _SourceConn;
+	conn->left = 0;
+	conn->started = false;
+	conn->keep = false;
+	bufferevent_setcb(bev, le_sourcereadcb, le_sourcewritecb, le_sourceeventcb, (void*)conn);
+	bufferevent_enable(bev, EV_READ | EV_WRITE);
+}
+
+static void le_sourcereadcb(struct bufferevent* bev, void* arg)
+{
+	_SourceConn* conn = (_SourceConn*)arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+	unsigned char request[8];
+
+	if (conn->started || evbuffer_remove(input, request, sizeof(request)) != sizeof(request))
+		return;
+
+	unsigned long long count = 0;
+	for (int n = 0; n < 8; n++)
+		count = (count << 8) | request[n];
+	conn->keep = (count & BENCH_KEEP) != 0;
+	conn->left = (long long)(count & ~BENCH_KEEP);
+	conn->started = true;
+	le_sourcewritecb(bev, arg);
+}
+
+static void le_sourcewritecb(struct bufferevent* bev, void* arg)
+{
+	_SourceConn* conn = (_SourceConn*)arg;
+	struct evbuffer* output = bufferevent_get_output(bev);
+
+	if (!conn->started)
+		return;
+
+	if (conn->left == 0 && evbuffer_get_length(output) == 0) {
+		if (conn->keep) {
+			conn->started = false;
+			le_sourcereadcb(bev, arg);
+			return;
+		}
+		bufferevent_free(bev);
+		delete conn;
+		return;
+	}
+
+	while (conn->left > 0 && evbuffer_get_length(output) < BENCH_CHUNK * 4) {
+		size_t len = (size_t)std::min<long long>(conn->left, BENCH_CHUNK);
+		evbuffer_add_reference(output, chunk, len, NULL, NULL);
+		conn->left -= len;
+	}
+}
+
+static void le_sourceeventcb(struct bufferevent* bev, short events, void* arg)
+{
+	bufferevent_free(bev);
+	delete (_SourceConn*)arg;
+}
+
+static void le_clientlaunch(_BenchRun* run)
+{
+	while (run->launched < run->connections && run->launched - run->done < run->concurrency) {
+		struct bufferevent* bev = bufferevent_socket_new(run->base, -1, BEV_OPT_CLOSE_ON_FREE);
+		_BenchClient* client = new _BenchClient;
+		client->run = run;
+		client->first = false;
+		client->received = 0;
+		client->start = le_nowusec();
+		run->launched++;
+
+		bufferevent_setcb(bev, le_clientreadcb, NULL, le_clienteventcb, (void*)client);
+		bufferevent_enable(bev, EV_READ | EV_WRITE);
+
+		if (bufferevent_socket_connect(bev, (struct sockaddr*)&run->sa, sizeof(run->sa)) != 0) {
+			le_clientdone(bev, client, false);
+			continue;
+		}
+
+		unsigned char request[8];
+		for (int n = 0; n < 8; n++)
+			request[n] = (unsigned char)(run->bytes >> ((7 - n) * 8));
+		bufferevent_write(bev, request, sizeof(request));
+	}
+}
+
+static void le_clientreadcb(struct bufferevent* bev, void* arg)
+{
+	_BenchClient* client = (_BenchClient*)arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+	size_t len = evbuffer_get_length(input);
+
+	if (!client->first && len > 0) {
+		client->first = true;
+		client->run->vLatency.push_back(le_nowusec() - client->start);
+	}
+
+	client->received += len;
+	client->run->received += len;
+	evbuffer_drain(input, len);
+
+	if (client->received >= client->run->bytes)
+		le_clientdone(bev, client, true);
+}
+
+static void le_clienteventcb(struct bufferevent* bev, short events, void* arg)
+{
+	if (events & BEV_EVENT_CONNECTED)
+		return;
+	le_clientdone(bev, (_BenchClient*)arg, false);
+}
+
+static void le_clientdone(struct bufferevent* bev, _BenchClient* client, bool ok)
+{
+	_BenchRun* run = client->run;
+
+	if (!ok)
+		run->failed++;
+	run->done++;
+
+	bufferevent_free(bev);
+	delete client;
+
+	if (run->done == run->connections) {
+		while (!run->vInteractive.empty())
+			le_interactivefree(run->vInteractive.back());
+		event_base_loopbreak(run->base);
+	}
+	else
+		le_clientlaunch(run);
+}
+
+// small requests on long lived connections next to the bulk ones, their reply times are what a
+// player or a remote desktop would feel while the link is full
+static void le_interactivelaunch(_BenchRun* run)
+{
+	for (int n = 0; n < run->interactive; n++) {
+		struct bufferevent* bev = bufferevent_socket_new(run->base, -1, BEV_OPT_CLOSE_ON_FREE);
+		_InteractiveClient* client = new _InteractiveClient;
+		client->run = run;
+		client->pause = evtimer_new(run->base, le_interactiverequest, (void*)bev);
+		client->received = 0;
+		client->start = 0;
+		run->vInteractive.push_back(bev);
+
+		bufferevent_setcb(bev, le_interactivereadcb, NULL, le_interactiveeventcb, (void*)client);
+		bufferevent_enable(bev, EV_READ | EV_WRITE);
+
+		if (bufferevent_socket_connect(bev, (struct sockaddr*)&run->sa, sizeof(run->sa)) != 0) {
+			run->interfailed++;
+			le_interactivefree(bev);
+			continue;
+		}
+		le_interactiverequest(-1, 0, (void*)bev);
+	}
+}
+
+static void le_interactiverequest(evutil_socket_t, short, void* arg)
+{
+	struct bufferevent* bev = (struct bufferevent*)arg;
+	_InteractiveClient* client;
+	bufferevent_getcb(bev, NULL, NULL, NULL, (void**)&client);
+
+	unsigned long long count = BENCH_KEEP | BENCH_INTERACTIVE_BYTES;
+	unsigned char request[8];
+	for (int n = 0; n < 8; n++)
+		request[n] = (unsigned char)(count >> ((7 - n) * 8));
+
+	client->start = le_nowusec();
+	client->received = 0;
+	bufferevent_write(bev, request, sizeof(request));
+}
+
+static void le_interactivereadcb(struct bufferevent* bev, void* arg)
+{
+	_InteractiveClient* client = (_InteractiveClient*)arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+	size_t len = evbuffer_get_length(input);
+
+	client->received += len;
+	evbuffer_drain(input, len);
+
+	if (client->received < BENCH_INTERACTIVE_BYTES)
+		return;
+
+	client->run->vRequest.push_back(le_nowusec() - client->start);
+	struct timeval tv = { 0, BENCH_INTERACTIVE_MSEC * 1000 };
+	evtimer_add(client->pause, &tv);
+}
+
+static void le_interactiveeventcb(struct bufferevent* bev, short events, void* arg)
+{
+	if (events & BEV_EVENT_CONNECTED)
+		return;
+	((_InteractiveClient*)arg)->run->interfailed++;
+	le_interactivefree(bev);
+}
+
+static void le_interactivefree(struct bufferevent* bev)
+{
+	_InteractiveClient* client;
+	bufferevent_getcb(bev, NULL, NULL, NULL, (void**)&client);
+	std::vector<struct bufferevent*>& vInteractive = client->run->vInteractive;
+
+	vInteractive.erase(std::find(vInteractive.begin(), vInteractive.end(), bev));
+	event_free(client->pause);
+	bufferevent_free(bev);
+	delete client;
+}
+
+static bool le_runload(_BenchRun* run)
+{
+	run->base = event_base_new();
+	memset(&run->sa, 0, sizeof(run->sa));
+	run->sa.sin_family = AF_INET;
+	run->sa.sin_port = htons(BENCH_PROXY_PORT);
+	run->sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	run->launched = 0;
+	run->done = 0;
+	run->failed = 0;
+	run->received = 0;
+	run->vLatency.clear();
+	run->interfailed = 0;
+	run->vRequest.clear();
+
+	le_interactivelaunch(run);
+	le_clientlaunch(run);
+	if (run->done < run->connections)
+		event_base_dispatch(run->base);
+	event_base_free(run->base);
+
+	return (run->failed == 0);
+}
+
+static pid_t le_spawn(const _BenchConfig& config, const std::string& dir, const std::string& yaml)
+{
+	mkdir(dir.c_str(), 0700);
+	std::string file = dir + "/proxy.yaml";
+	FILE* fp = fopen(file.c_str(), "w");
+	if (fp == NULL)
+		return -1;
+	fputs(yaml.c_str(), fp);
+	fclose(fp);
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		// the tunnel reads proxy.yaml from its working directory and logs to stdout
+		if (chdir(dir.c_str()) != 0)
+			_exit(1);
+		freopen("log", "w", stdout);
+		execl(config.tunnel.c_str(), config.tunnel.c_str(), (char*)NULL);
+		_exit(1);
+	}
+	return pid;
+}
+
+static void le_stop(pid_t pid)
+{
+	if (pid <= 0)
+		return;
+	kill(pid, SIGINT);
+	waitpid(pid, NULL, 0);
+}
+
+static double le_cpuseconds(pid_t pid)
+{
+	char path[64];
+	char stat[1024];
+	sprintf(path, "/proc/%d/stat", (int)pid);
+
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+		return 0;
+	size_t len = fread(stat, 1, sizeof(stat) - 1, fp);
+	fclose(fp);
+	stat[len] = 0;
+
+	// fields after the command name, utime and stime are the 12th and 13th
+	char* p = strrchr(stat, ')');
+	unsigned long utime = 0, stime = 0;
+	if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+		return 0;
+
+	return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+// resident set of a relay, a soak watches it grow
+static long long le_rsskb(pid_t pid)
+{
+	char path[64];
+	char line[256];
+	long long kb = 0;
+	sprintf(path, "/proc/%d/status", (int)pid);
+
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+		return 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "VmRSS: %lld", &kb) == 1)
+			break;
+	}
+	fclose(fp);
+	return kb;
+}
+
+static int le_fds(pid_t pid)
+{
+	char path[64];
+	int count = 0;
+	sprintf(path, "/proc/%d/fd", (int)pid);
+
+	DIR* dir = opendir(path);
+	if (dir == NULL)
+		return 0;
+	while (struct dirent* entry = readdir(dir)) {
+		if (entry->d_name[0] != '.')
+			count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+// a one byte fetch through the relay, a mux link only forwards once the connect side has dialed in
+static bool le_waitrelay()
+{
+	_BenchRun run;
+	run.concurrency = 1;
+	run.connections = 1;
+	run.bytes = 1;
+	run.interactive = 0;
+
+	for (int waited = 0; waited < BENCH_READY_MSEC; waited += 100) {
+		if (le_runload(&run))
+			return true;
+		usleep(100 * 1000);
+	}
+	return false;
+}
+
+static unsigned long long le_percentile(std::vector<unsigned long long>& v, double p)
+{
+	if (v.size() == 0)
+		return 0;
+	size_t index = std::min(v.size() - 1, (size_t)(v.size() * p));
+	return v[index];
+}
+
+static void le_report(const char* mode, const char* phase, _BenchRun* run, unsigned long long usec, double cpu)
+{
+	std::sort(run->vLatency.begin(), run->vLatency.end());
+
+	double gbit = (usec > 0) ? run->received * 8.0 / (usec * 1000.0) : 0;
+	double gb = run->received / 1e9;
+
+	printf("%-9s %-6s %10d %10.2f %10llu %10llu %10llu %8d", mode, phase, run->connections, gbit,
+		le_percentile(run->vLatency, 0.5), le_percentile(run->vLatency, 0.99), le_percentile(run->vLatency, 0.999),
+		run->failed);
+
+	// a storm moves next to no bytes, its cost is per connection instead
+	if (run->bytes > 1)
+		printf(" %8.2f\n", (gb > 0) ? cpu / gb : 0);
+	else
+		printf("   %.0f conn/s, %.2f cpu ms per 1k conns\n", (usec > 0) ? run->connections * 1e6 / usec : 0,
+			cpu * 1e6 / run->connections);
+}
+
+// the reply times of the interactive requests during the bulk phase, in the latency columns
+static void le_reportinteractive(const char* mode, _BenchRun* run)
+{
+	std::sort(run->vRequest.begin(), run->vRequest.end());
+
+	printf("%-9s %-6s %10d %10s %10llu %10llu %10llu %8d   %zu requests\n", mode, "inter", run->interactive, "-",
+		le_percentile(run->vRequest, 0.5), le_percentile(run->vRequest, 0.99), le_percentile(run->vRequest, 0.999),
+		run->interfailed, run->vRequest.size());
+}
+
+// plain and splice run one relay, the link modes a listen and a connect side linked over loopback. the
+// shim sits where the WAN would, between a relay and its local server or on the link
+static bool le_benchmode(const _BenchConfig& config, const std::string& mode, const std::string& dir)
+{
+	char yaml[1024];
+	std::vector<pid_t> vPids;
+
+	if (mode == "plain" || mode == "splice") {
+		shimtarget = BENCH_SOURCE_PORT;
+		snprintf(yaml, sizeof(yaml),
+			"Debug Message: false\n"
+			"Worker Threads: %d\n"
+			"Proxy  Servers:\n"
+			"  - Name: \"bench\"\n"
+			"    Enable: true\n"
+			"    Proxy IP: 127.0.0.1\n"
+			"    Proxy Port: %d\n"
+			"    Local Server IP: 127.0.0.1\n"
+			"    Local Server Port: %d\n"
+			"    Splice: %s\n",
+			config.workers, BENCH_PROXY_PORT, shimon ? BENCH_SHIM_PORT : BENCH_SOURCE_PORT, (mode == "splice") ? "true" : "false");
+		vPids.push_back(le_spawn(config, dir + "/" + mode, yaml));
+	}
+	else if (mode == "mux" || mode == "deflate" || mode == "multipath") {
+		// deflate compresses the streams, multipath stripes them over two links by their round trip
+		const char* transport = "";
+		if (mode == "deflate")
+			transport = "    Compression: \"Deflate\"\n";
+		else if (mode == "multipath")
+			transport = "    Link Connections: 2\n    Multipath: true\n";
+
+		shimtarget = BENCH_LINK_PORT;
+		snprintf(yaml, sizeof(yaml),
+			"Debug Message: false\n"
+			"Proxy  Servers:\n"
+			"  - Name: \"bench\"\n"
+			"    Enable: true\n"
+			"    Link Mode: Connect\n"
+			"    Link IP: 127.0.0.1\n"
+			"    Link Port: %d\n"
+			"    Local Server IP: 127.0.0.1\n"
+			"    Local Server Port: %d\n"
+			"%s",
+			shimon ? BENCH_SHIM_PORT : BENCH_LINK_PORT, BENCH_SOURCE_PORT, transport);
+		vPids.push_back(le_spawn(config, dir + "/" + mode + "connect", yaml));
+
+		snprintf(yaml, sizeof(yaml),
+			"Debug Message: false\n"
+			"Proxy  Servers:\n"
+			"  - Name: \"bench\"\n"
+			"    Enable: true\n"
+			"    Link Mode: Listen\n"
+			"    Link IP: 127.0.0.1\n"
+			"    Link Port: %d\n"
+			"    Proxy IP: 127.0.0.1\n"
+			"    Proxy Port: %d\n"
+			"%s",
+			BENCH_LINK_PORT, BENCH_PROXY_PORT, transport);
+		vPids.push_back(le_spawn(config, dir + "/" + mode + "listen", yaml));
+	}
+	else {
+		printf("Unknown mode %s.\n", mode.c_str());
+		return false;
+	}
+
+	bool ready = le_waitrelay();
+
+	_BenchRun run;
+	bool ok = ready;
+
+	if (!ready)
+		printf("%s relay did not start, see %s/%s*.\n", mode.c_str(), dir.c_str(), mode.c_str());
+
+	if (ready) {
+		run.concurrency = config.concurrency;
+		run.connections = config.connections;
+		run.bytes = config.bytes;
+		run.interactive = config.interactive;
+
+		double cpu = 0;
+		for (size_t n = 0; n < vPids.size(); n++)
+			cpu -= le_cpuseconds(vPids[n]);
+		unsigned long long start = le_nowusec();
+		ok = le_runload(&run) && ok;
+		unsigned long long usec = le_nowusec() - start;
+		for (size_t n = 0; n < vPids.size(); n++)
+			cpu += le_cpuseconds(vPids[n]);
+
+		le_report(mode.c_str(), "bulk", &run, usec, cpu);
+		if (run.interactive > 0)
+			le_reportinteractive(mode.c_str(), &run);
+	}
+
+	// connection storm, every connection at once with a one byte reply
+	if (ready && config.storm > 0) {
+		run.concurrency = config.storm;
+		run.connections = config.storm;
+		run.bytes = 1;
+		run.interactive = 0;
+
+		double cpu = 0;
+		for (size_t n = 0; n < vPids.size(); n++)
+			cpu -= le_cpuseconds(vPids[n]);
+		unsigned long long start = le_nowusec();
+		ok = le_runload(&run) && ok;
+		unsigned long long usec = le_nowusec() - start;
+		for (size_t n = 0; n < vPids.size(); n++)
+			cpu += le_cpuseconds(vPids[n]);
+
+		le_report(mode.c_str(), "storm", &run, usec, cpu);
+	}
+
+	// the bulk phase over and over against the relays that ran the storm, a line a minute with the answer
+	// times of that minute and what the relays hold by then. soak.sh fits the slope of the columns
+	if (ready && config.soak > 0) {
+		unsigned long long start = le_nowusec();
+		unsigned long long sample = start + BENCH_SOAK_SAMPLE_MSEC * 1000ULL;
+		unsigned long long end = start + config.soak * 1000000ULL;
+		unsigned long long windowstart = start;
+		std::vector<unsigned long long> vWindow;
+		long long received = 0;
+		int connections = 0, failed = 0;
+
+		run.concurrency = config.concurrency;
+		run.connections = config.connections;
+		run.bytes = config.bytes;
+		run.interactive = 0;
+
+		while (le_nowusec() < end) {
+			ok = le_runload(&run) && ok;
+			vWindow.insert(vWindow.end(), run.vLatency.begin(), run.vLatency.end());
+			received += run.received;
+			connections += run.connections;
+			failed += run.failed;
+
+			unsigned long long now = le_nowusec();
+			if (now < sample && now < end)
+				continue;
+
+			long long rss = 0;
+			int fds = 0;
+			for (size_t n = 0; n < vPids.size(); n++) {
+				rss += le_rsskb(vPids[n]);
+				fds += le_fds(vPids[n]);
+			}
+			std::sort(vWindow.begin(), vWindow.end());
+			printf("%-9s %-6s %10d %10.2f %10llu %10llu %10llu %8d   %lld kB rss %d fds %.0f s\n", mode.c_str(), "soak",
+				connections, received * 8.0 / ((now - windowstart) * 1000.0), le_percentile(vWindow, 0.5),
+				le_percentile(vWindow, 0.99), le_percentile(vWindow, 0.999), failed, rss, fds, (now - start) / 1e6);
+			fflush(stdout);
+
+			vWindow.clear();
+			received = 0;
+			connections = 0;
+			failed = 0;
+			windowstart = now;
+			while (sample <= now)
+				sample += BENCH_SOAK_SAMPLE_MSEC * 1000ULL;
+		}
+	}
+
+	for (size_t n = 0; n < vPids.size(); n++)
+		le_stop(vPids[n]);
+
+	return ok;
+}
+
+// every connection to the shim gets one to shimtarget, the bytes of each direction are held until the
+// chunk they came in would have crossed the WAN
+static void le_shimlistener_cb(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr*, int, void*)
+{
+	struct event_base* base = evconnlistener_get_base(listener);
+	struct sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons((unsigned short)shimtarget.load());
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	_ShimConn* conn = new _ShimConn;
+	struct bufferevent* accepted = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE);
+	struct bufferevent* target = bufferevent_socket_new(base, -1, BEV_OPT_CLOSE_ON_FREE);
+
+	for (int dir = 0; dir < 2; dir++) {
+		_ShimPipe* pipe = &conn->pipes[dir];
+		pipe->conn = conn;
+		pipe->dir = dir;
+		pipe->from = (dir == 0) ? accepted : target;
+		pipe->to = (dir == 0) ? target : accepted;
+		pipe->queued = 0;
+		pipe->last = 0;
+		pipe->timer = evtimer_new(base, le_shimtimer, (void*)pipe);
+		pipe->eof = false;
+		bufferevent_setcb(pipe->from, le_shimreadcb, le_shimwritecb, le_shimeventcb, (void*)pipe);
+		bufferevent_enable(pipe->from, EV_READ | EV_WRITE);
+	}
+
+	if (bufferevent_socket_connect(target, (struct sockaddr*)&sa, sizeof(sa)) != 0)
+		le_shimfree(conn);
+}
+
+static void le_shimreadcb(struct bufferevent* bev, void* arg)
+{
+	_ShimPipe* pipe = (_ShimPipe*)arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+	unsigned long long now = le_nowusec();
+	std::uniform_real_distribution<double> percent(0, 100);
+
+	while (evbuffer_get_length(input) > 0) {
+		_ShimChunk chunk;
+		size_t len = std::min(evbuffer_get_length(input), (size_t)SHIM_READ);
+		chunk.data = evbuffer_new();
+		evbuffer_remove_buffer(input, chunk.data, len);
+
+		// on the wire after the bytes ahead of it in this direction, then half a round trip and the jitter
+		unsigned long long sent = now;
+		if (shim.kbit > 0) {
+			sent = std::max(now, shimnextfree[pipe->dir]) + len * 8000 / shim.kbit;
+			shimnextfree[pipe->dir] = sent;
+		}
+		chunk.release = sent + shim.rttmsec * 500ULL;
+		if (shim.jittermsec > 0)
+			chunk.release += shimrandom() % (shim.jittermsec * 1000ULL);
+		for (size_t segment = 0; shim.loss > 0 && segment < len; segment += SHIM_SEGMENT) {
+			if (percent(shimrandom) < shim.loss)
+				chunk.release += shim.rttmsec * 1000ULL;
+		}
+		chunk.release = std::max(chunk.release, pipe->last);
+		pipe->last = chunk.release;
+
+		pipe->queue.push_back(chunk);
+		pipe->queued += len;
+	}
+
+	if (!evtimer_pending(pipe->timer, NULL))
+		le_shimtimer(-1, 0, arg);
+	// a full queue pushes back on the sender through TCP flow control
+	if (pipe->queued >= shimwindow)
+		bufferevent_disable(bev, EV_READ);
+}
+
+static void le_shimtimer(evutil_socket_t, short, void* arg)
+{
+	_ShimPipe* pipe = (_ShimPipe*)arg;
+	unsigned long long now = le_nowusec();
+
+	while (!pipe->queue.empty() && pipe->queue.front().release <= now) {
+		_ShimChunk& chunk = pipe->queue.front();
+		pipe->queued -= evbuffer_get_length(chunk.data);
+		bufferevent_write_buffer(pipe->to, chunk.data);
+		evbuffer_free(chunk.data);
+		pipe->queue.pop_front();
+	}
+
+	if (!pipe->queue.empty()) {
+		unsigned long long wait = pipe->queue.front().release - now;
+		struct timeval tv = { (time_t)(wait / 1000000), (suseconds_t)(wait % 1000000) };
+		evtimer_add(pipe->timer, &tv);
+	}
+	if (pipe->queued < shimwindow && !pipe->eof)
+		bufferevent_enable(pipe->from, EV_READ);
+	if (pipe->eof)
+		le_shimflush(pipe->conn);
+}
+
+static void le_shimwritecb(struct bufferevent*, void* arg)
+{
+	le_shimflush(((_ShimPipe*)arg)->conn);
+}
+
+// an end that closes is passed on once what it sent has crossed and been written
+static void le_shimeventcb(struct bufferevent*, short events, void* arg)
+{
+	_ShimPipe* pipe = (_ShimPipe*)arg;
+
+	if (events & BEV_EVENT_CONNECTED)
+		return;
+	if (events & BEV_EVENT_ERROR) {
+		le_shimfree(pipe->conn);
+		return;
+	}
+	pipe->eof = true;
+	le_shimflush(pipe->conn);
+}
+
+static void le_shimflush(_ShimConn* conn)
+{
+	for (int dir = 0; dir < 2; dir++) {
+		_ShimPipe* pipe = &conn->pipes[dir];
+		if (pipe->eof && pipe->queue.empty() && evbuffer_get_length(bufferevent_get_output(pipe->to)) == 0) {
+			le_shimfree(conn);
+			return;
+		}
+	}
+}
+
+static void le_shimfree(_ShimConn* conn)
+{
+	for (int dir = 0; dir < 2; dir++) {
+		_ShimPipe* pipe = &conn->pipes[dir];
+		event_free(pipe->timer);
+		for (size_t n = 0; n < pipe->queue.size(); n++)
+			evbuffer_free(pipe->queue[n].data);
+		bufferevent_free(pipe->from);
+	}
+	delete conn;
+}
@@ -1,1294 +0,0 @@
-#pragma once
-
-#ifndef _MD5_KEYVAL_H_
-
-// ü Ű  256 x 4 = 1024
-
-#define	MAX_KEY_INDEX	256		// Ű Ѱġ
-
-
-const unsigned int MD5_KEYVAL[] = {
-	0xb53e0951,	// 0000-000
-	0x17115c7a,	// 0000-001
-	0xf065da08,	// 0000-002
-	0x89294e3a,	// 0000-003
-
-	0xb3707602,	// 0001-000
-	0x135fb6c4,	// 0001-001
-	0xbe4a0e5a,	// 0001-002
-	0x061a4a5b,	// 0001-003
-
-	0x93f2789d,	// 0002-000
-	0xb5129ff8,	// 0002-001
-	0xf8fbae4d,	// 0002-002
-	0xf9d3b3c7,	// 0002-003
-
-	0x790c4d61,	// 0003-000
-	0xb04164a9,	// 0003-001
-	0xe36017c3,	// 0003-002
-	0x390ef6b0,	// 0003-003
-
-	0xcb4772d1,	// 0004-000
-	0xfa4591a6,	// 0004-001
-	0x05a4e7dc,	// 0004-002
-	0xdbc3c187,	// 0004-003
-
-	0x2d6da3ac,	// 0005-000
-	0xc8b9f502,	// 0005-001
-	0x222ef9f9,	// 0005-002
-	0x322b00fc,	// 0005-003
-
-	0x8586def3,	// 0006-000
-	0x8f749b0d,	// 0006-001
-	0x3fa96bbc,	// 0006-002
-	0xd6c0e001,	// 0006-003
-
-	0xf8dc5fe9,	// 0007-000
-	0x0390d158,	// 0007-001
-	0xa1fc9a05,	// 0007-002
-	0x9939cfc6,	// 0007-003
-
-	0xebf8a30e,	// 0008-000
-	0x1b6523b3,	// 0008-001
-	0xcd5224f5,	// 0008-002
-	0x929179bd,	// 0008-003
-
-	0x02a16922,	// 0009-000
-	0x0b8e6031,	// 0009-001
-	0x8812e4ee,	// 0009-002
-	0x1500cb96,	// 0009-003
-
-	0x22e2ab27,	// 0010-000
-	0x47e19322,	// 0010-001
-	0xd7e6f890,	// 0010-002
-	0xb8fff243,	// 0010-003
-
-	0x7204a95e,	// 0011-000
-	0x857a0918,	// 0011-001
-	0x00b7bebc,	// 0011-002
-	0x4f475cf4,	// 0011-003
-
-	0x558fdd48,	// 0012-000
-	0xbbb051e2,	// 0012-001
-	0x87afd194,	// 0012-002
-	0xf0d2b51c,	// 0012-003
-
-	0x704d07a6,	// 0013-000
-	0x1c1d3792,	// 0013-001
-	0x31350f78,	// 0013-002
-	0xefd8ea69,	// 0013-003
-
-	0xaa462178,	// 0014-000
-	0x1e9ac779,	// 0014-001
-	0x03f39609,	// 0014-002
-	0xe1d228cf,	// 0014-003
-
-	0x26c36b01,	// 0015-000
-	0x76404f29,	// 0015-001
-	0x42d2c129,	// 0015-002
-	0x9c79dd7c,	// 0015-003
-
-	0x494e5fc0,	// 0016-000
-	0x18675b71,	// 0016-001
-	0x73fb2ff8,	// 0016-002
-	0x34c6b5e4,	// 0016-003
-
-	0xbaafbd77,	// 0017-000
-	0x3ba9ba64,	// 0017-001
-	0x5bd7bbd7,	// 0017-002
-	0xfef39db6,	// 0017-003
-
-	0x5bf07f26,	// 0018-000
-	0x53de7752,	// 0018-001
-	0x000f8368,	// 0018-002
-	0x9078c3e3,	// 0018-003
-
-	0x5459e510,	// 0019-000
-	0x1421e0cb,	// 0019-001
-	0xa68ce58a,	// 0019-002
-	0xbe0e929e,	// 0019-003
-
-	0x08746ab5,	// 0020-000
-	0x74c982a2,	// 0020-001
-	0xd2767c61,	// 0020-002
-	0x9eaeb955,	// 0020-003
-
-	0x1d09cbd5,	// 0021-000
-	0xa96f29e7,	// 0021-001
-	0x4838274b,	// 0021-002
-	0x849125bc,	// 0021-003
-
-	0x77220672,	// 0022-000
-	0x26eee4eb,	// 0022-001
-	0x107a01eb,	// 0022-002
-	0x063101c2,	// 0022-003
-
-	0x3c0757cd,	// 0023-000
-	0xa15dfe3f,	// 0023-001
-	0x6c246921,	// 0023-002
-	0xf746bc98,	// 0023-003
-
-	0xd1413c67,	// 0024-000
-	0x0f1504b4,	// 0024-001
-	0xe261fb0f,	// 0024-002
-	0x6fc902b0,	// 0024-003
-
-	0xda9a7200,	// 0025-000
-	0xa4b1c55c,	// 0025-001
-	0x38999315,	// 0025-002
-	0xc0f3c1bb,	// 0025-003
-
-	0x3d1bf59b,	// 0026-000
-	0xd7084c86,	// 0026-001
-	0x717450d4,	// 0026-002
-	0x813d24a9,	// 0026-003
-
-	0x1f0c0277,	// 0027-000
-	0x5c34e8c4,	// 0027-001
-	0xd4dd8d2e,	// 0027-002
-	0x87619aac,	// 0027-003
-
-	0xe4f61716,	// 0028-000
-	0x278e23e8,	// 0028-001
-	0xe5fbe943,	// 0028-002
-	0xe557cf34,	// 0028-003
-
-	0x32a3f039,	// 0029-000
-	0x6eaecd01,	// 0029-001
-	0x69383f74,	// 0029-002
-	0xf358b1f3,	// 0029-003
-
-	0xee1b8be1,	// 0030-000
-	0xa76ef162,	// 0030-001
-	0x663eae62,	// 0030-002
-	0x43dd6bda,	// 0030-003
-
-	0x3ca8254e,	// 0031-000
-	0x85e7de9b,	// 0031-001
-	0x1ff492ef,	// 0031-002
-	0xaca06c19,	// 0031-003
-
-	0x82d23a03,	// 0032-000
-	0xfe711f7c,	// 0032-001
-	0x1a84873b,	// 0032-002
-	0x42986021,	// 0032-003
-
-	0x646288bf,	// 0033-000
-	0x47a68118,	// 0033-001
-	0x1d586ca8,	// 0033-002
-	0x5b0035a5,	// 0033-003
-
-	0xc8630b84,	// 0034-000
-	0xd45f13bf,	// 0034-001
-	0x2c175dd6,	// 0034-002
-	0x8b501794,	// 0034-003
-
-	0xd31b0093,	// 0035-000
-	0x5cb52002,	// 0035-001
-	0x8cabb7a6,	// 0035-002
-	0xa841731f,	// 0035-003
-
-	0xe915e56d,	// 0036-000
-	0xd30036b2,	// 0036-001
-	0xc23d1639,	// 0036-002
-	0xc6cdf6b8,	// 0036-003
-
-	0xb01977d2,	// 0037-000
-	0x6dda22e0,	// 0037-001
-	0x933659f1,	// 0037-002
-	0x3a2b8d0f,	// 0037-003
-
-	0x0d31b2c5,	// 0038-000
-	0xa11bf0de,	// 0038-001
-	0x053f9c6e,	// 0038-002
-	0x9ad66617,	// 0038-003
-
-	0x24a6d485,	// 0039-000
-	0x22deef3b,	// 0039-001
-	0x5b413c92,	// 0039-002
-	0xba86edfe,	// 0039-003
-
-	0x5bff5994,	// 0040-000
-	0xe67aaac9,	// 0040-001
-	0x1c65d57d,	// 0040-002
-	0xaf35d038,	// 0040-003
-
-	0x5708ffb3,	// 0041-000
-	0x2288ef9a,	// 0041-001
-	0x0c134690,	// 0041-002
-	0xcf1afa74,	// 0041-003
-
-	0xfcc7c2e2,	// 0042-000
-	0x4be3cafd,	// 0042-001
-	0x2ff6ab6c,	// 0042-002
-	0xaeb09aa3,	// 0042-003
-
-	0x7087df64,	// 0043-000
-	0x16a28a85,	// 0043-001
-	0xcdf661f3,	// 0043-002
-	0x22af1cf7,	// 0043-003
-
-	0x18d1d5b8,	// 0044-000
-	0x771fba02,	// 0044-001
-	0x683c0545,	// 0044-002
-	0x3f102ee1,	// 0044-003
-
-	0x986d5ea0,	// 0045-000
-	0xa5f22884,	// 0045-001
-	0xc63074c4,	// 0045-002
-	0x5a0cbb11,	// 0045-003
-
-	0xd6647a1d,	// 0046-000
-	0x14f6e05e,	// 0046-001
-	0xed7dca10,	// 0046-002
-	0x091cf279,	// 0046-003
-
-	0xf6006370,	// 0047-000
-	0x78423120,	// 0047-001
-	0x200a660a,	// 0047-002
-	0x20fa3f49,	// 0047-003
-
-	0x5eca991a,	// 0048-000
-	0xc72fa69b,	// 0048-001
-	0xe602e4d3,	// 0048-002
-	0xb59e50f3,	// 0048-003
-
-	0xb38ad7db,	// 0049-000
-	0x36580de0,	// 0049-001
-	0x03cc21cd,	// 0049-002
-	0x1c411127,	// 0049-003
-
-	0xd9491ab6,	// 0050-000
-	0x3a947340,	// 0050-001
-	0x7c133a98,	// 0050-002
-	0xea5cafd8,	// 0050-003
-
-	0xf651a0ea,	// 0051-000
-	0x88fc244d,	// 0051-001
-	0x96be8c15,	// 0051-002
-	0xf5a99734,	// 0051-003
-
-	0x6f2ae5f9,	// 0052-000
-	0x15ebaed6,	// 0052-001
-	0xd6f7b466,	// 0052-002
-	0x512076ae,	// 0052-003
-
-	0xe89ea7a4,	// 0053-000
-	0x16f8deed,	// 0053-001
-	0x02288feb,	// 0053-002
-	0x54fa3af7,	// 0053-003
-
-	0x47b5e2eb,	// 0054-000
-	0xfffdc1e4,	// 0054-001
-	0x1ef83a46,	// 0054-002
-	0x92b00f00,	// 0054-003
-
-	0xb0b8d411,	// 0055-000
-	0x8713a44b,	// 0055-001
-	0x6e511256,	// 0055-002
-	0xe0fb62f9,	// 0055-003
-
-	0x8a31fa95,	// 0056-000
-	0xa19213f2,	// 0056-001
-	0x795cb43e,	// 0056-002
-	0x54d4e153,	// 0056-003
-
-	0x78e91039,	// 0057-000
-	0x8414dcec,	// 0057-001
-	0x0382fd5f,	// 0057-002
-	0x427578c0,	// 0057-003
-
-	0x5fe813fe,	// 0058-000
-	0xa3720c89,	// 0058-001
-	0x116c0a59,	// 0058-002
-	0x3f565431,	// 0058-003
-
-	0x65774125,	// 0059-000
-	0xb4c4f05a,	// 0059-001
-	0xe903380d,	// 0059-002
-	0x2130e2d6,	// 0059-003
-
-	0xef20162e,	// 0060-000
-	0xac641430,	// 0060-001
-	0x0e70259c,	// 0060-002
-	0xfcfdd021,	// 0060-003
-
-	0xa1ab50dc,	// 0061-000
-	0xc0eb461c,	// 0061-001
-	0x471cac68,	// 0061-002
-	0x26f40ac3,	// 0061-003
-
-	0x6122ec2e,	// 0062-000
-	0x6431936f,	// 0062-001
-	0x98b0eb11,	// 0062-002
-	0x3390bdac,	// 0062-003
-
-	0x54cd2666,	// 0063-000
-	0x4f5148ba,	// 0063-001
-	0x45153f78,	// 0063-002
-	0xf989560d,	// 0063-003
-
-	0xde367b05,	// 0064-000
-	0x75a1f1ce,	// 0064-001
-	0xd57345bf,	// 0064-002
-	0x8bd88358,	// 0064-003
-
-	0xa525a9cc,	// 0065-000
-	0x0abd5cbc,	// 0065-001
-	0x0d35da46,	// 0065-002
-	0x41b6303e,	// 0065-003
-
-	0x8ea3adbb,	// 0066-000
-	0x847c96d6,	// 0066-001
-	0xf0031bae,	// 0066-002
-	0xad9d8ab0,	// 0066-003
-
-	0xbdfac315,	// 0067-000
-	0x98f8ecab,	// 0067-001
-	0xc4c566d9,	// 0067-002
-	0xa644ffdd,	// 0067-003
-
-	0x98b36959,	// 0068-000
-	0x3c8aeb0e,	// 0068-001
-	0x0fa656e7,	// 0068-002
-	0x41a63b39,	// 0068-003
-
-	0xc4965b49,	// 0069-000
-	0xa3cb5f0f,	// 0069-001
-	0x950dc939,	// 0069-002
-	0xd2fc2b73,	// 0069-003
-
-	0x25ac96e6,	// 0070-000
-	0x429356fe,	// 0070-001
-	0x5ba5dc71,	// 0070-002
-	0xeebdfc7d,	// 0070-003
-
-	0xe13f5971,	// 0071-000
-	0xd0fb1d6e,	// 0071-001
-	0xa655ed6f,	// 0071-002
-	0x6aa31c87,	// 0071-003
-
-	0x5cd71e6a,	// 0072-000
-	0x415e402f,	// 0072-001
-	0xfb489754,	// 0072-002
-	0x5ca83603,	// 0072-003
-
-	0x3c3ea493,	// 0073-000
-	0xc9538e52,	// 0073-001
-	0x1fe5b882,	// 0073-002
-	0x190439a1,	// 0073-003
-
-	0x667ce8ee,	// 0074-000
-	0xdfb41228,	// 0074-001
-	0x17d66e99,	// 0074-002
-	0x34305253,	// 0074-003
-
-	0xfedb26ba,	// 0075-000
-	0x369a1a42,	// 0075-001
-	0x2904147a,	// 0075-002
-	0x85e6ec4a,	// 0075-003
-
-	0x6ae3dc78,	// 0076-000
-	0xc45d3271,	// 0076-001
-	0xd9994847,	// 0076-002
-	0x1e1db6f6,	// 0076-003
-
-	0x4f5dc6eb,	// 0077-000
-	0xbe9729c7,	// 0077-001
-	0xecfce860,	// 0077-002
-	0x56109d08,	// 0077-003
-
-	0x9153e213,	// 0078-000
-	0x99210a93,	// 0078-001
-	0x67d70f66,	// 0078-002
-	0xc137cc73,	// 0078-003
-
-	0x560e6c30,	// 0079-000
-	0x0a132368,	// 0079-001
-	0x8f131c3b,	// 0079-002
-	0x354bb266,	// 0079-003
-
-	0x0316e2c4,	// 0080-000
-	0x06c80015,	// 0080-001
-	0xe9d9aaff,	// 0080-002
-	0xc646fb52,	// 0080-003
-
-	0x3c340090,	// 0081-000
-	0xc2d670ad,	// 0081-001
-	0x3a929713,	// 0081-002
-	0xca5f94e9,	// 0081-003
-
-	0xe772c495,	// 0082-000
-	0xb2197e7f,	// 0082-001
-	0x88e70118,	// 0082-002
-	0xd411aa1c,	// 0082-003
-
-	0x28186b14,	// 0083-000
-	0x8da8781e,	// 0083-001
-	0x17c143f0,	// 0083-002
-	0xbc14ab1b,	// 0083-003
-
-	0x65b0708d,	// 0084-000
-	0x46ddeb5a,	// 0084-001
-	0x6b48fcbc,	// 0084-002
-	0x94614358,	// 0084-003
-
-	0x430293c2,	// 0085-000
-	0x1351a344,	// 0085-001
-	0x4be707db,	// 0085-002
-	0xb3325f83,	// 0085-003
-
-	0xa717cfb4,	// 0086-000
-	0x69dcaf2d,	// 0086-001
-	0xbc4683f0,	// 0086-002
-	0xaefe2d8e,	// 0086-003
-
-	0xb53961a4,	// 0087-000
-	0xfd985aa6,	// 0087-001
-	0x014dcbdb,	// 0087-002
-	0x598019a9,	// 0087-003
-
-	0xd2f1c713,	// 0088-000
-	0xc4de3280,	// 0088-001
-	0xa0277ebe,	// 0088-002
-	0xc9b0d046,	// 0088-003
-
-	0xa507bdc2,	// 0089-000
-	0xf34703cc,	// 0089-001
-	0x5f3c77f9,	// 0089-002
-	0x53c73f16,	// 0089-003
-
-	0x118441b1,	// 0090-000
-	0xffabdbdc,	// 0090-001
-	0x4134d52d,	// 0090-002
-	0x8d3f9409,	// 0090-003
-
-	0x3bb29022,	// 0091-000
-	0x9c24083f,	// 0091-001
-	0x8dfaf43c,	// 0091-002
-	0x4ccf3b51,	// 0091-003
-
-	0x8a1a2697,	// 0092-000
-	0xc10a14c7,	// 0092-001
-	0xc7b57045,	// 0092-002
-	0xa472e15e,	// 0092-003
-
-	0xa183c0ce,	// 0093-000
-	0xa1f8cf86,	// 0093-001
-	0xb4cf28ac,	// 0093-002
-	0xea6073e2,	// 0093-003
-
-	0x65f95ccb,	// 0094-000
-	0xb2c545cb,	// 0094-001
-	0x5af2370f,	// 0094-002
-	0xb3121fce,	// 0094-003
-
-	0xfcc237ce,	// 0095-000
-	0xa98ac229,	// 0095-001
-	0xfc05fc51,	// 0095-002
-	0xd5425152,	// 0095-003
-
-	0xcb69cd57,	// 0096-000
-	0x7ba2d470,	// 0096-001
-	0x20321392,	// 0096-002
-	0x65e7b6e0,	// 0096-003
-
-	0x77b7db28,	// 0097-000
-	0x5da447b1,	// 0097-001
-	0x8ce35834,	// 0097-002
-	0xb63c3b28,	// 0097-003
-
-	0xe4b45f42,	// 0098-000
-	0xc46a2a3d,	// 0098-001
-	0x44bfead7,	// 0098-002
-	0x5fb90e1c,	// 0098-003
-
-	0x37aa96e6,	// 0099-000
-	0x650cc8a5,	// 0099-001
-	0x8db0255c,	// 0099-002
-	0x35189bec,	// 0099-003
-
-	0xd721fc95,	// 0100-000
-	0x34e4afba,	// 0100-001
-	0xecdfa6e4,	// 0100-002
-	0x4c508f0a,	// 0100-003
-
-	0x67e24f10,	// 0101-000
-	0x688bac8d,	// 0101-001
-	0x26b549d1,	// 0101-002
-	0xf99cd827,	// 0101-003
-
-	0xcdf78b57,	// 0102-000
-	0x74dacb6f,	// 0102-001
-	0x41db2dc3,	// 0102-002
-	0xd274a233,	// 0102-003
-
-	0x2da8eeac,	// 0103-000
-	0x0fe95bf2,	// 0103-001
-	0x803aae9c,	// 0103-002
-	0xab915a60,	// 0103-003
-
-	0xed7ff490,	// 0104-000
-	0x2c12e7e5,	// 0104-001
-	0x6afb697c,	// 0104-002
-	0x99ecad1e,	// 0104-003
-
-	0xb1445ac4,	// 0105-000
-	0x01ee3d5a,	// 0105-001
-	0xc2863ac4,	// 0105-002
-	0xf2be891f,	// 0105-003
-
-	0x60011f49,	// 0106-000
-	0x035669a3,	// 0106-001
-	0x8f864015,	// 0106-002
-	0x4a811a53,	// 0106-003
-
-	0x1cfe7d5f,	// 0107-000
-	0xe662ba50,	// 0107-001
-	0x15e3d751,	// 0107-002
-	0x77edcdec,	// 0107-003
-
-	0x4dc4f489,	// 0108-000
-	0xa16cbb31,	// 0108-001
-	0xdac69c98,	// 0108-002
-	0x8dfb4f5b,	// 0108-003
-
-	0x961d3e86,	// 0109-000
-	0x680c3a59,	// 0109-001
-	0xa1976c4c,	// 0109-002
-	0xe2e48e50,	// 0109-003
-
-	0xdd125b58,	// 0110-000
-	0xaf1c4318,	// 0110-001
-	0x7101640c,	// 0110-002
-	0x0922b6bd,	// 0110-003
-
-	0x46eb8540,	// 0111-000
-	0x2db525ff,	// 0111-001
-	0x8debe1bc,	// 0111-002
-	0xda6c34d2,	// 0111-003
-
-	0x37313cbe,	// 0112-000
-	0xd5306bdf,	// 0112-001
-	0x7c80807a,	// 0112-002
-	0x67bdb501,	// 0112-003
-
-	0x55ae3a95,	// 0113-000
-	0xdd25e3c9,	// 0113-001
-	0x02271ea9,	// 0113-002
-	0x074d27fb,	// 0113-003
-
-	0x856a7fc4,	// 0114-000
-	0xba6e9a0e,	// 0114-001
-	0x248bd7e9,	// 0114-002
-	0x4e96b6b0,	// 0114-003
-
-	0xebaf468d,	// 0115-000
-	0x2124dc3f,	// 0115-001
-	0x27930a1b,	// 0115-002
-	0x124fcf51,	// 0115-003
-
-	0xec050c71,	// 0116-000
-	0x07a0372e,	// 0116-001
-	0x90695361,	// 0116-002
-	0x67732051,	// 0116-003
-
-	0x2e368f31,	// 0117-000
-	0xa17a78ea,	// 0117-001
-	0x25778f1b,	// 0117-002
-	0xa33a955e,	// 0117-003
-
-	0x964acbce,	// 0118-000
-	0x638cacc6,	// 0118-001
-	0xea64dbeb,	// 0118-002
-	0x5a1d5b6c,	// 0118-003
-
-	0x498bfe88,	// 0119-000
-	0x04ee2051,	// 0119-001
-	0x231a94b0,	// 0119-002
-	0x61d5dfaa,	// 0119-003
-
-	0xab81a4e1,	// 0120-000
-	0x77fb605e,	// 0120-001
-	0x57c2588d,	// 0120-002
-	0xce5ccf89,	// 0120-003
-
-	0x62f57b9a,	// 0121-000
-	0xf24a3afd,	// 0121-001
-	0x4ac502e3,	// 0121-002
-	0xf5e916bb,	// 0121-003
-
-	0x52f180b4,	// 0122-000
-	0xebb4bb7e,	// 0122-001
-	0x01ccb051,	// 0122-002
-	0x6cf7e431,	// 0122-003
-
-	0xa2bdef70,	// 0123-000
-	0x15543074,	// 0123-001
-	0xc2c0bfbb,	// 0123-002
-	0x063ea31b,	// 0123-003
-
-	0xb4e3454f,	// 0124-000
-	0x668125af,	// 0124-001
-	0x10cacc3f,	// 0124-002
-	0xdbb802eb,	// 0124-003
-
-	0x302c4011,	// 0125-000
-	0x12d56840,	// 0125-001
-	0xb253b440,	// 0125-002
-	0x3d9cec52,	// 0125-003
-
-	0xf99fddb8,	// 0126-000
-	0x90280678,	// 0126-001
-	0xac04945e,	// 0126-002
-	0xc3659140,	// 0126-003
-
-	0x35885885,	// 0127-000
-	0x94944ce8,	// 0127-001
-	0x42c6c97a,	// 0127-002
-	0x42cb5be6,	// 0127-003
-
-	0x486d2ef9,	// 0128-000
-	0x1272c662,	// 0128-001
-	0xfbc1f0b6,	// 0128-002
-	0xcec7f9b7,	// 0128-003
-
-	0xd8191dd5,	// 0129-000
-	0x415b42f5,	// 0129-001
-	0x9c60e772,	// 0129-002
-	0xbc925761,	// 0129-003
-
-	0xc995221a,	// 0130-000
-	0x9427cdf4,	// 0130-001
-	0x284bc94f,	// 0130-002
-	0xa2a6a2d8,	// 0130-003
-
-	0x42297908,	// 0131-000
-	0xc1f0b4ee,	// 0131-001
-	0xe56af42f,	// 0131-002
-	0x54bb474b,	// 0131-003
-
-	0xa65ea021,	// 0132-000
-	0xbd0f84b6,	// 0132-001
-	0x59e80532,	// 0132-002
-	0xe7caf42b,	// 0132-003
-
-	0x9afe5326,	// 0133-000
-	0xbd1c095b,	// 0133-001
-	0x482cd9b9,	// 0133-002
-	0xb10c952a,	// 0133-003
-
-	0x04128f18,	// 0134-000
-	0x36f15130,	// 0134-001
-	0xb7e18e66,	// 0134-002
-	0x46fa5839,	// 0134-003
-
-	0x09e19238,	// 0135-000
-	0xdda7a9c5,	// 0135-001
-	0xebee7f19,	// 0135-002
-	0x7c4ea888,	// 0135-003
-
-	0x0ef7d906,	// 0136-000
-	0xa6979deb,	// 0136-001
-	0x697e4af3,	// 0136-002
-	0x66003489,	// 0136-003
-
-	0xb71a2045,	// 0137-000
-	0xc859fcb3,	// 0137-001
-	0xf6f8cd56,	// 0137-002
-	0x5c48e8ec,	// 0137-003
-
-	0xe95565f4,	// 0138-000
-	0xb6c7d16e,	// 0138-001
-	0x970623e2,	// 0138-002
-	0xf1a2f1a3,	// 0138-003
-
-	0xcbf1e455,	// 0139-000
-	0x27fa6aad,	// 0139-001
-	0x9291aa78,	// 0139-002
-	0xfac4bddf,	// 0139-003
-
-	0xc0761be9,	// 0140-000
-	0x0e4a5341,	// 0140-001
-	0x6bc3003a,	// 0140-002
-	0x8ca9f810,	// 0140-003
-
-	0x6daec671,	// 0141-000
-	0xa1515b3b,	// 0141-001
-	0xe7030088,	// 0141-002
-	0xfd888fe8,	// 0141-003
-
-	0xb9a1e3ed,	// 0142-000
-	0x55e88ded,	// 0142-001
-	0x0bfbc803,	// 0142-002
-	0xe1dcb057,	// 0142-003
-
-	0xc798ae9f,	// 0143-000
-	0xdf2737e6,	// 0143-001
-	0x1c94b68c,	// 0143-002
-	0x0e5ec68f,	// 0143-003
-
-	0xfc1da508,	// 0144-000
-	0x3468e5f9,	// 0144-001
-	0x9ff76545,	// 0144-002
-	0x98058000,	// 0144-003
-
-	0xfef884e9,	// 0145-000
-	0x88446635,	// 0145-001
-	0x598db48f,	// 0145-002
-	0xd50cca5c,	// 0145-003
-
-	0xb2334943,	// 0146-000
-	0x5294c5ed,	// 0146-001
-	0x50ffbe09,	// 0146-002
-	0x59ead294,	// 0146-003
-
-	0x3d163057,	// 0147-000
-	0x457050b1,	// 0147-001
-	0xc836e296,	// 0147-002
-	0xf95a04d8,	// 0147-003
-
-	0x032bb7a5,	// 0148-000
-	0x58329452,	// 0148-001
-	0x455abb56,	// 0148-002
-	0xcb550d9a,	// 0148-003
-
-	0xaa3a9bf0,	// 0149-000
-	0xbe735de0,	// 0149-001
-	0x8ed628ab,	// 0149-002
-	0x2312da8a,	// 0149-003
-
-	0x164dd837,	// 0150-000
-	0xed0bbaae,	// 0150-001
-	0xa8524435,	// 0150-002
-	0x960c989a,	// 0150-003
-
-	0x6dacabbc,	// 0151-000
-	0x9a14f64c,	// 0151-001
-	0xd6b66ed5,	// 0151-002
-	0xfafab5fa,	// 0151-003
-
-	0x14e09200,	// 0152-000
-	0xbae79f8c,	// 0152-001
-	0x9e2d41ad,	// 0152-002
-	0x63d7dd1c,	// 0152-003
-
-	0xafb349c3,	// 0153-000
-	0x821c817d,	// 0153-001
-	0xc61f9c1d,	// 0153-002
-	0x27dcfeb1,	// 0153-003
-
-	0x242ece08,	// 0154-000
-	0x668eab71,	// 0154-001
-	0x51349ac6,	// 0154-002
-	0xda8043a9,	// 0154-003
-
-	0x98995e0e,	// 0155-000
-	0x1d5468fa,	// 0155-001
-	0x86579a89,	// 0155-002
-	0x517e1b36,	// 0155-003
-
-	0x6f7d7557,	// 0156-000
-	0x9ac746e7,	// 0156-001
-	0xe9af3888,	// 0156-002
-	0xa2cd32c8,	// 0156-003
-
-	0x4fa4d0a4,	// 0157-000
-	0x1481114b,	// 0157-001
-	0x3fa65024,	// 0157-002
-	0x21a87611,	// 0157-003
-
-	0x1d166df6,	// 0158-000
-	0xfe5bd875,	// 0158-001
-	0x8de601fc,	// 0158-002
-	0x64881202,	// 0158-003
-
-	0xfd1d898d,	// 0159-000
-	0x0e6ee6f8,	// 0159-001
-	0x1956a6f3,	// 0159-002
-	0x3e2475cb,	// 0159-003
-
-	0x5541a0ec,	// 0160-000
-	0x3913c9a4,	// 0160-001
-	0x6620de29,	// 0160-002
-	0xc7774cde,	// 0160-003
-
-	0xc94c6fd2,	// 0161-000
-	0xb4e24d89,	// 0161-001
-	0x3bae8500,	// 0161-002
-	0x52b982eb,	// 0161-003
-
-	0x3f46f441,	// 0162-000
-	0xf4b581fa,	// 0162-001
-	0x9ca7b718,	// 0162-002
-	0x746346e4,	// 0162-003
-
-	0xdc786c7a,	// 0163-000
-	0xaea4b087,	// 0163-001
-	0xcef5d352,	// 0163-002
-	0x022e04f9,	// 0163-003
-
-	0x046c53fd,	// 0164-000
-	0xd6096801,	// 0164-001
-	0x56c175cf,	// 0164-002
-	0x1213699c,	// 0164-003
-
-	0x5dea678d,	// 0165-000
-	0xa37d767a,	// 0165-001
-	0xf9747af1,	// 0165-002
-	0xf84c637e,	// 0165-003
-
-	0xccfca429,	// 0166-000
-	0x88d9e641,	// 0166-001
-	0xbcb7fe58,	// 0166-002
-	0x4a511d8f,	// 0166-003
-
-	0x75eb4714,	// 0167-000
-	0x3b3507e8,	// 0167-001
-	0xe57360e6,	// 0167-002
-	0xdcdb0601,	// 0167-003
-
-	0xbe3ecfcd,	// 0168-000
-	0xb1eb6441,	// 0168-001
-	0xf8d13cbb,	// 0168-002
-	0xc4e3cb44,	// 0168-003
-
-	0x4cc1f615,	// 0169-000
-	0x1f94cb5b,	// 0169-001
-	0xb9396f38,	// 0169-002
-	0x55a3570a,	// 0169-003
-
-	0x037abbef,	// 0170-000
-	0xfa084889,	// 0170-001
-	0x2f5616fe,	// 0170-002
-	0x2792d943,	// 0170-003
-
-	0x09b45b9b,	// 0171-000
-	0xf7622a5a,	// 0171-001
-	0x9e108def,	// 0171-002
-	0x0c6bbd21,	// 0171-003
-
-	0xc2f85299,	// 0172-000
-	0x0bf8fca1,	// 0172-001
-	0x8c90732b,	// 0172-002
-	0x1b26b115,	// 0172-003
-
-	0xd50e5eab,	// 0173-000
-	0x6a668c6e,	// 0173-001
-	0xbc3ea414,	// 0173-002
-	0xa9fda0cf,	// 0173-003
-
-	0x24ff7bd2,	// 0174-000
-	0x8b83e612,	// 0174-001
-	0x34c53d49,	// 0174-002
-	0x4a67b941,	// 0174-003
-
-	0xd715e74f,	// 0175-000
-	0x2169591d,	// 0175-001
-	0x3a0c9bad,	// 0175-002
-	0xd31f689b,	// 0175-003
-
-	0x51d91ea3,	// 0176-000
-	0x23717062,	// 0176-001
-	0x523e5b61,	// 0176-002
-	0x591d5b4f,	// 0176-003
-
-	0x3813de8e,	// 0177-000
-	0xc433f9f2,	// 0177-001
-	0x41c25ac5,	// 0177-002
-	0x329a7e0e,	// 0177-003
-
-	0x70cc2412,	// 0178-000
-	0x7a89011c,	// 0178-001
-	0x0c43b57a,	// 0178-002
-	0xf30ffec8,	// 0178-003
-
-	0x1f4e2b71,	// 0179-000
-	0xfa8cd472,	// 0179-001
-	0xf8a8c961,	// 0179-002
-	0x6f3548ae,	// 0179-003
-
-	0xaa21732a,	// 0180-000
-	0x399400c5,	// 0180-001
-	0x8a1b339c,	// 0180-002
-	0xbe060933,	// 0180-003
-
-	0xb50fb7fe,	// 0181-000
-	0x6b3c5227,	// 0181-001
-	0x8806d08b,	// 0181-002
-	0x32ba2f06,	// 0181-003
-
-	0x2620f4f0,	// 0182-000
-	0x075bd7e7,	// 0182-001
-	0xf510bdcf,	// 0182-002
-	0x62cae618,	// 0182-003
-
-	0x219d683f,	// 0183-000
-	0xc00adc98,	// 0183-001
-	0x1823574a,	// 0183-002
-	0x22ef9c9b,	// 0183-003
-
-	0x0d108f6e,	// 0184-000
-	0x8da3ed09,	// 0184-001
-	0x75683b1c,	// 0184-002
-	0x8823fcff,	// 0184-003
-
-	0x8c42273c,	// 0185-000
-	0xa1bfd84d,	// 0185-001
-	0xd14846a7,	// 0185-002
-	0xe89ef5f7,	// 0185-003
-
-	0x863b2dab,	// 0186-000
-	0x7237aab4,	// 0186-001
-	0x316c958a,	// 0186-002
-	0xd8d9b371,	// 0186-003
-
-	0x1e44ddfc,	// 0187-000
-	0xb523b0cf,	// 0187-001
-	0xdbbd85a8,	// 0187-002
-	0x2c8da3a1,	// 0187-003
-
-	0xbae7b4af,	// 0188-000
-	0x5fde766f,	// 0188-001
-	0x5264b322,	// 0188-002
-	0xf9b373f5,	// 0188-003
-
-	0xfeec7087,	// 0189-000
-	0xa5fecaa5,	// 0189-001
-	0x5dcafc58,	// 0189-002
-	0x95850f21,	// 0189-003
-
-	0xd05d0e83,	// 0190-000
-	0xfc5fb9c2,	// 0190-001
-	0xff987deb,	// 0190-002
-	0x947aa414,	// 0190-003
-
-	0x5582cae5,	// 0191-000
-	0x18189057,	// 0191-001
-	0x7fb794bc,	// 0191-002
-	0xcb4da000,	// 0191-003
-
-	0xf1e5212e,	// 0192-000
-	0xf083db35,	// 0192-001
-	0x614fdced,	// 0192-002
-	0x50f6ae55,	// 0192-003
-
-	0x4a4ed11f,	// 0193-000
-	0xb739686e,	// 0193-001
-	0x6bcb33de,	// 0193-002
-	0x77afbdc5,	// 0193-003
-
-	0x45c6d7b8,	// 0194-000
-	0xe4124451,	// 0194-001
-	0xa0d3b630,	// 0194-002
-	0xd6effa40,	// 0194-003
-
-	0x06976f3b,	// 0195-000
-	0x2a28bc71,	// 0195-001
-	0x464fc2c5,	// 0195-002
-	0x4171d0f8,	// 0195-003
-
-	0xf34a162a,	// 0196-000
-	0x7fd45d9d,	// 0196-001
-	0xe36af5bd,	// 0196-002
-	0xcd2dee5d,	// 0196-003
-
-	0xb1a78b44,	// 0197-000
-	0x18aef3e8,	// 0197-001
-	0x3b8b2a79,	// 0197-002
-	0xd05c4021,	// 0197-003
-
-	0x24b7c88b,	// 0198-000
-	0x6a908ca2,	// 0198-001
-	0x525d7f9b,	// 0198-002
-	0xde77f335,	// 0198-003
-
-	0x72c40c3f,	// 0199-000
-	0x2a93755b,	// 0199-001
-	0x6fc75103,	// 0199-002
-	0xcd3875c9,	// 0199-003
-
-	0xff56d4e3,	// 0200-000
-	0x4c103ae6,	// 0200-001
-	0x17f43ed2,	// 0200-002
-	0xb197724f,	// 0200-003
-
-	0x7137dc36,	// 0201-000
-	0x079faa53,	// 0201-001
-	0x0d4b216a,	// 0201-002
-	0xdfcdd777,	// 0201-003
-
-	0xad6f223a,	// 0202-000
-	0xce1ad0f3,	// 0202-001
-	0x5776186b,	// 0202-002
-	0xed53d133,	// 0202-003
-
-	0xd748e230,	// 0203-000
-	0x5799fa58,	// 0203-001
-	0x3b5e81b6,	// 0203-002
-	0xafe2ceb4,	// 0203-003
-
-	0x554a9a99,	// 0204-000
-	0x9877b451,	// 0204-001
-	0x3d2df76d,	// 0204-002
-	0x3a747a6a,	// 0204-003
-
-	0xcc3e0636,	// 0205-000
-	0xc44bcdf0,	// 0205-001
-	0x214a58ef,	// 0205-002
-	0xe441c207,	// 0205-003
-
-	0x202e2407,	// 0206-000
-	0x51ef5086,	// 0206-001
-	0xee5fc2e0,	// 0206-002
-	0x42c2d37b,	// 0206-003
-
-	0x7763304f,	// 0207-000
-	0xf47b8ba5,	// 0207-001
-	0xe955901e,	// 0207-002
-	0x27b01bf8,	// 0207-003
-
-	0x3665a88d,	// 0208-000
-	0xa1490b1c,	// 0208-001
-	0x955561cc,	// 0208-002
-	0xaa0446ee,	// 0208-003
-
-	0x01fd4883,	// 0209-000
-	0x8ff29cfe,	// 0209-001
-	0xb8c8104b,	// 0209-002
-	0x20f8410f,	// 0209-003
-
-	0xbe350e32,	// 0210-000
-	0x324f4c9b,	// 0210-001
-	0x5857bb3a,	// 0210-002
-	0x1d04394c,	// 0210-003
-
-	0x915536da,	// 0211-000
-	0x3e786883,	// 0211-001
-	0xb9ebc07c,	// 0211-002
-	0x76e19cd5,	// 0211-003
-
-	0xe0e73efe,	// 0212-000
-	0xa9c77d89,	// 0212-001
-	0x5facba31,	// 0212-002
-	0x4188161c,	// 0212-003
-
-	0x50b3e25d,	// 0213-000
-	0xa9d558bd,	// 0213-001
-	0x110588bb,	// 0213-002
-	0xd23294d1,	// 0213-003
-
-	0xc6c220f9,	// 0214-000
-	0xb17a0570,	// 0214-001
-	0xd39e45ba,	// 0214-002
-	0xbe5944e6,	// 0214-003
-
-	0x665e3513,	// 0215-000
-	0x77d0d233,	// 0215-001
-	0xeb60500f,	// 0215-002
-	0xdbb5928c,	// 0215-003
-
-	0x95109d2c,	// 0216-000
-	0xf0304cd7,	// 0216-001
-	0xdc7344dc,	// 0216-002
-	0x3d3f2b33,	// 0216-003
-
-	0xfaa01505,	// 0217-000
-	0x50323f6d,	// 0217-001
-	0x6d420081,	// 0217-002
-	0x3a30fc8c,	// 0217-003
-
-	0x78179b9e,	// 0218-000
-	0x0eb0ba47,	// 0218-001
-	0xa174a09f,	// 0218-002
-	0x66013389,	// 0218-003
-
-	0x34bf6b39,	// 0219-000
-	0xdec308f4,	// 0219-001
-	0xbff48017,	// 0219-002
-	0x966c3c5b,	// 0219-003
-
-	0x95210357,	// 0220-000
-	0xb4c4b747,	// 0220-001
-	0x4be93f0b,	// 0220-002
-	0xe069c473,	// 0220-003
-
-	0x3d0420b9,	// 0221-000
-	0xc64b934f,	// 0221-001
-	0x0abeb8db,	// 0221-002
-	0x9831b881,	// 0221-003
-
-	0x1474be60,	// 0222-000
-	0x8a32ab5f,	// 0222-001
-	0x011a0a29,	// 0222-002
-	0x543d4676,	// 0222-003
-
-	0x3db71a8d,	// 0223-000
-	0xb3924a06,	// 0223-001
-	0x76e791d5,	// 0223-002
-	0xe846da84,	// 0223-003
-
-	0x1e58b3c0,	// 0224-000
-	0x37c3fe17,	// 0224-001
-	0xec4ee900,	// 0224-002
-	0x6946211c,	// 0224-003
-
-	0x5b2043bb,	// 0225-000
-	0x4b5f94a2,	// 0225-001
-	0x2ab9f10c,	// 0225-002
-	0x2d7509ee,	// 0225-003
-
-	0xdb17c97f,	// 0226-000
-	0x643f18f8,	// 0226-001
-	0x34cfc598,	// 0226-002
-	0xc84cbdec,	// 0226-003
-
-	0xc087824d,	// 0227-000
-	0x367cd8aa,	// 0227-001
-	0x4f7ac288,	// 0227-002
-	0x0f84ac46,	// 0227-003
-
-	0x72f8eaa6,	// 0228-000
-	0xb86e6189,	// 0228-001
-	0x00e384fa,	// 0228-002
-	0x1817836e,	// 0228-003
-
-	0x9433be4a,	// 0229-000
-	0x1daf80a6,	// 0229-001
-	0x0c73ea51,	// 0229-002
-	0x383c2d15,	// 0229-003
-
-	0x0b42fd3c,	// 0230-000
-	0xdc184252,	// 0230-001
-	0x78d3102d,	// 0230-002
-	0x026ed92b,	// 0230-003
-
-	0xfe6de1bb,	// 0231-000
-	0xa8c1f31f,	// 0231-001
-	0x8aec5370,	// 0231-002
-	0x4d65f3e2,	// 0231-003
-
-	0xd03ee949,	// 0232-000
-	0x770421dc,	// 0232-001
-	0xc6e74f39,	// 0232-002
-	0x2e1a28aa,	// 0232-003
-
-	0x267dd2a7,	// 0233-000
-	0x7e7a999c,	// 0233-001
-	0xf02ce3ec,	// 0233-002
-	0xf9c76635,	// 0233-003
-
-	0xe73498d6,	// 0234-000
-	0x32fb67ae,	// 0234-001
-	0x0f662b27,	// 0234-002
-	0x43e4d973,	// 0234-003
-
-	0x35ab7916,	// 0235-000
-	0x48a1daa5,	// 0235-001
-	0x677d84cd,	// 0235-002
-	0xe229ee96,	// 0235-003
-
-	0x786bf1e9,	// 0236-000
-	0xb5c57d51,	// 0236-001
-	0x7e9a8bfe,	// 0236-002
-	0xea91520f,	// 0236-003
-
-	0x533fbe11,	// 0237-000
-	0xad001ec2,	// 0237-001
-	0x17251d1b,	// 0237-002
-	0xb055f38e,	// 0237-003
-
-	0xac2ddc8d,	// 0238-000
-	0xa72ac94b,	// 0238-001
-	0x38c956c6,	// 0238-002
-	0xcaecfd05,	// 0238-003
-
-	0xa780899e,	// 0239-000
-	0x565dcd7c,	// 0239-001
-	0x276d95df,	// 0239-002
-	0x0c11dda4,	// 0239-003
-
-	0xaac041c7,	// 0240-000
-	0xb0f2b526,	// 0240-001
-	0x683c7688,	// 0240-002
-	0x8cbc41dd,	// 0240-003
-
-	0x5ab7c2c8,	// 0241-000
-	0xea814f5a,	// 0241-001
-	0xc09dd621,	// 0241-002
-	0x9e261461,	// 0241-003
-
-	0x9b6d08a1,	// 0242-000
-	0x79e4a869,	// 0242-001
-	0x343bd24b,	// 0242-002
-	0xd7c88520,	// 0242-003
-
-	0x932c5194,	// 0243-000
-	0x12340ce5,	// 0243-001
-	0x09fdc7e7,	// 0243-002
-	0x0d5c004c,	// 0243-003
-
-	0xa77c1a22,	// 0244-000
-	0xaac90a9d,	// 0244-001
-	0xc40d5217,	// 0244-002
-	0x54d93355,	// 0244-003
-
-	0x7b271e0c,	// 0245-000
-	0x763d6da3,	// 0245-001
-	0x2bd5503b,	// 0245-002
-	0x017a0aed,	// 0245-003
-
-	0xf5355d52,	// 0246-000
-	0xeb694249,	// 0246-001
-	0x41fcdef4,	// 0246-002
-	0xaab7b204,	// 0246-003
-
-	0x3af01237,	// 0247-000
-	0xbd66d81e,	// 0247-001
-	0x4d6c5924,	// 0247-002
-	0x244a98cc,	// 0247-003
-
-	0xaee0ba3a,	// 0248-000
-	0xe28cbaf5,	// 0248-001
-	0xd34e5eeb,	// 0248-002
-	0x822a6ab6,	// 0248-003
-
-	0xf7ce131d,	// 0249-000
-	0x9075b6de,	// 0249-001
-	0x980bcaab,	// 0249-002
-	0x1b921472,	// 0249-003
-
-	0xf9c419e1,	// 0250-000
-	0x3afad92a,	// 0250-001
-	0xa14cba03,	// 0250-002
-	0x84fac3f1,	// 0250-003
-
-	0xdb0b0ac7,	// 0251-000
-	0x96337069,	// 0251-001
-	0x34fa8bd6,	// 0251-002
-	0x911be466,	// 0251-003
-
-	0xff2a6350,	// 0252-000
-	0x997a076e,	// 0252-001
-	0xd43eda45,	// 0252-002
-	0x57ee2540,	// 0252-003
-
-	0x0dede03c,	// 0253-000
-	0x78686c49,	// 0253-001
-	0x488185af,	// 0253-002
-	0x2cad7230,	// 0253-003
-
-	0xe85a7e8d,	// 0254-000
-	0xa8d6ac4c,	// 0254-001
-	0x936ca7b7,	// 0254-002
-	0xa4d0f828,	// 0254-003
-
-	0xb5bd7b84,	// 0255-000
-	0xdddc1406,	// 0255-001
-	0xfce89e3e,	// 0255-002
-	0x94102459,	// 0255-003
-};
-
-
-#endif
-
@@ -1,4 +0,0 @@
-#include "mydb.h"
-#define NO_STD_OPTIONAL
-#include "mysql+++.h"
-